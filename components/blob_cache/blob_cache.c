@@ -0,0 +1,802 @@
+#include "blob_cache.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *TAG = "blob_cache";
+
+#define PSRAM_CAPS          (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#define CLOCK_SET_AFTER     1704067200      // 2024-01-01: time() before it is the unset clock
+#define COMPACT_TARGET(b)   ((b) / 4 * 3)   // Live bytes kept by a compaction
+#define SCAN_CHUNK          512
+#define FLUSH_POLL_MS       10
+
+// On disk: this header, the key without its terminator, then the data
+typedef struct __attribute__((packed)) {
+    uint32_t magic;             // BLOB_CACHE_MAGIC
+    uint32_t crc;               // CRC32 of the rest of the header, the key and the data
+    uint32_t expires;           // time(), 0 for never
+    uint32_t data_len;
+    uint16_t key_len;
+    uint16_t flags;
+} record_header_t;
+
+#define RECORD_TOMBSTONE    0x0001  // The key was removed
+
+// A blob in the front, or one on its way to the log; one allocation
+typedef struct entry {
+    struct entry *next;         // In its bucket
+    struct entry *newer;        // LRU list
+    struct entry *older;
+    struct entry *queue_next;   // In its cache's write queue
+    uint32_t refs;              // The front's and the write queue's
+    uint32_t hash;
+    uint32_t expires;
+    bool linked;                // In the front
+    bool pending;               // Queued, at most once: not evicted until written
+    bool tombstone;             // Queued to record a removal
+    uint16_t key_len;
+    size_t len;
+    uint8_t *data;              // Past the key
+    char key[];
+} entry_t;
+
+// Where a key's latest record is; the key itself is only in the file
+typedef struct {
+    uint32_t hash;
+    uint32_t offset;
+    uint32_t size;              // The whole record
+    uint32_t expires;
+} index_entry_t;
+
+struct blob_cache {
+    blob_cache_config_t config;
+    char *path;
+    SemaphoreHandle_t lock;         // The front, the index and the stats
+    SemaphoreHandle_t file_lock;    // file, file_size; taken before lock
+    entry_t *buckets[BLOB_CACHE_BUCKETS];
+    entry_t *newest;
+    entry_t *oldest;
+    size_t front_count;
+    index_entry_t *index;
+    size_t index_count;
+    size_t index_capacity;
+    FILE *file;                     // NULL: RAM only
+    size_t file_size;
+    size_t compact_after;           // Raised past file_size when a compaction failed
+    entry_t *queue_head;            // Writes in order; under lock
+    entry_t *queue_tail;
+    size_t queue_bytes;
+    uint32_t queued;                // Writes not yet done, for blob_cache_flush()
+    blob_cache_stats_t stats;
+    struct blob_cache *next;        // In g_caches
+};
+
+static TaskHandle_t g_writer;
+static uint32_t g_writer_state;     // 0 none, 1 starting, 2 running
+static blob_cache_handle_t g_caches;    // Those with a log; pushed, never unlinked
+
+static uint32_t hash_key(const char *key) {
+    uint32_t hash = 2166136261u;    // FNV-1a
+    for (const char *p = key; *p; ++p) {
+        hash = (hash ^ (uint8_t)*p) * 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t now_s(void) {
+    time_t now = time(NULL);
+    return now > 0 ? (uint32_t)now : 0;
+}
+
+static bool fresh(uint32_t expires, uint32_t now) {
+    return expires == 0 || now < CLOCK_SET_AFTER || now < expires;
+}
+
+static size_t entry_cost(const entry_t *entry) {
+    return sizeof(entry_t) + entry->key_len + 1 + entry->len;
+}
+
+static entry_t *entry_alloc(const char *key, size_t key_len, size_t len) {
+    entry_t *entry = heap_caps_malloc(sizeof(entry_t) + key_len + 1 + len, PSRAM_CAPS);
+    if (!entry) {
+        return NULL;
+    }
+    memset(entry, 0, sizeof(*entry));
+    memcpy(entry->key, key, key_len);
+    entry->key[key_len] = '\0';
+    entry->key_len = key_len;
+    entry->hash = hash_key(entry->key);
+    entry->len = len;
+    entry->data = (uint8_t *)entry->key + key_len + 1;
+    entry->refs = 1;
+    return entry;
+}
+
+// Caller holds lock
+static void entry_unref(entry_t *entry) {
+    if (--entry->refs == 0) {
+        heap_caps_free(entry);
+    }
+}
+
+// ---- The front; caller holds lock ----
+
+static entry_t *front_find(blob_cache_handle_t cache, const char *key, uint32_t hash) {
+    for (entry_t *entry = cache->buckets[hash % BLOB_CACHE_BUCKETS]; entry; entry = entry->next) {
+        if (entry->hash == hash && strcmp(entry->key, key) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void lru_detach(blob_cache_handle_t cache, entry_t *entry) {
+    if (entry->newer) {
+        entry->newer->older = entry->older;
+    } else {
+        cache->newest = entry->older;
+    }
+    if (entry->older) {
+        entry->older->newer = entry->newer;
+    } else {
+        cache->oldest = entry->newer;
+    }
+    entry->newer = entry->older = NULL;
+}
+
+static void lru_push(blob_cache_handle_t cache, entry_t *entry) {
+    entry->older = cache->newest;
+    entry->newer = NULL;
+    if (cache->newest) {
+        cache->newest->newer = entry;
+    } else {
+        cache->oldest = entry;
+    }
+    cache->newest = entry;
+}
+
+static void front_unlink(blob_cache_handle_t cache, entry_t *entry) {
+    entry_t **link = &cache->buckets[entry->hash % BLOB_CACHE_BUCKETS];
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+    entry->next = NULL;
+    lru_detach(cache, entry);
+    entry->linked = false;
+    cache->stats.ram_used -= entry_cost(entry);
+    cache->front_count--;
+    entry_unref(entry);
+}
+
+// Takes over the caller's reference
+static void front_insert(blob_cache_handle_t cache, entry_t *entry) {
+    entry_t *old = front_find(cache, entry->key, entry->hash);
+    if (old) {
+        front_unlink(cache, old);
+    }
+    entry_t **bucket = &cache->buckets[entry->hash % BLOB_CACHE_BUCKETS];
+    entry->next = *bucket;
+    *bucket = entry;
+    lru_push(cache, entry);
+    entry->linked = true;
+    cache->stats.ram_used += entry_cost(entry);
+    cache->front_count++;
+
+    // Least recently used first, passing over those still to be written
+    entry_t *victim = cache->oldest;
+    while (cache->stats.ram_used > cache->config.ram_bytes && victim) {
+        entry_t *newer = victim->newer;
+        if (victim != entry && !victim->pending) {
+            front_unlink(cache, victim);
+        }
+        victim = newer;
+    }
+}
+
+// A PSRAM copy of a fresh front entry, which becomes the most recently used
+static void *front_copy(blob_cache_handle_t cache, const char *key, uint32_t hash, size_t *len) {
+    entry_t *entry = front_find(cache, key, hash);
+    if (!entry) {
+        return NULL;
+    }
+    if (!fresh(entry->expires, now_s())) {
+        if (!entry->pending) {
+            front_unlink(cache, entry);
+        }
+        return NULL;
+    }
+    void *copy = heap_caps_malloc(entry->len ? entry->len : 1, PSRAM_CAPS);
+    if (!copy) {
+        return NULL;
+    }
+    memcpy(copy, entry->data, entry->len);
+    *len = entry->len;
+    lru_detach(cache, entry);
+    lru_push(cache, entry);
+    return copy;
+}
+
+// ---- The index; caller holds lock ----
+
+static index_entry_t *index_find(blob_cache_handle_t cache, uint32_t hash) {
+    for (size_t i = 0; i < cache->index_count; ++i) {
+        if (cache->index[i].hash == hash) {
+            return &cache->index[i];
+        }
+    }
+    return NULL;
+}
+
+static void index_drop(blob_cache_handle_t cache, uint32_t hash) {
+    index_entry_t *at = index_find(cache, hash);
+    if (at) {
+        cache->stats.disk_live -= at->size;
+        *at = cache->index[--cache->index_count];
+    }
+}
+
+static bool index_set(blob_cache_handle_t cache, uint32_t hash, uint32_t offset, uint32_t size, uint32_t expires) {
+    index_entry_t *at = index_find(cache, hash);
+    if (at) {
+        cache->stats.disk_live -= at->size;
+    } else {
+        if (cache->index_count == cache->index_capacity) {
+            size_t capacity = cache->index_capacity ? 2 * cache->index_capacity : 32;
+            index_entry_t *index = heap_caps_realloc(cache->index, capacity * sizeof(*index), PSRAM_CAPS);
+            if (!index) {
+                return false;
+            }
+            cache->index = index;
+            cache->index_capacity = capacity;
+        }
+        at = &cache->index[cache->index_count++];
+        at->hash = hash;
+    }
+    at->offset = offset;
+    at->size = size;
+    at->expires = expires;
+    cache->stats.disk_live += size;
+    return true;
+}
+
+// ---- The log; caller holds file_lock ----
+
+static uint32_t record_crc(const record_header_t *header, const void *key, const void *data) {
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)header + 8, sizeof(*header) - 8);
+    crc = esp_rom_crc32_le(crc, key, header->key_len);
+    return esp_rom_crc32_le(crc, data, header->data_len);
+}
+
+static bool read_header(FILE *file, uint32_t offset, record_header_t *header) {
+    return fseek(file, offset, SEEK_SET) == 0 && fread(header, 1, sizeof(*header), file) == sizeof(*header) &&
+           header->magic == BLOB_CACHE_MAGIC && header->key_len > 0 && header->key_len < BLOB_CACHE_KEY_MAX;
+}
+
+// key's record at offset, checked, as a new unlinked entry
+static entry_t *read_record(blob_cache_handle_t cache, const index_entry_t *at, const char *key) {
+    record_header_t header;
+    size_t key_len = strlen(key);
+    if (!read_header(cache->file, at->offset, &header) || header.key_len != key_len ||
+        sizeof(header) + key_len + header.data_len != at->size || (header.flags & RECORD_TOMBSTONE)) {
+        return NULL;
+    }
+    entry_t *entry = entry_alloc(key, key_len, header.data_len);
+    if (!entry) {
+        return NULL;
+    }
+    char stored[BLOB_CACHE_KEY_MAX];
+    if (fread(stored, 1, key_len, cache->file) != key_len || memcmp(stored, key, key_len) != 0 ||
+        fread(entry->data, 1, entry->len, cache->file) != entry->len ||
+        record_crc(&header, stored, entry->data) != header.crc) {
+        heap_caps_free(entry);
+        return NULL;
+    }
+    entry->expires = header.expires;
+    return entry;
+}
+
+static bool append_record(blob_cache_handle_t cache, const entry_t *entry, bool remove, uint32_t *size) {
+    record_header_t header = {
+        .magic = BLOB_CACHE_MAGIC,
+        .expires = entry->expires,
+        .data_len = remove ? 0 : entry->len,
+        .key_len = entry->key_len,
+        .flags = remove ? RECORD_TOMBSTONE : 0,
+    };
+    header.crc = record_crc(&header, entry->key, entry->data);
+    *size = sizeof(header) + header.key_len + header.data_len;
+
+    // A failed append is overwritten by the next one, which starts at file_size again
+    bool ok = fseek(cache->file, cache->file_size, SEEK_SET) == 0 &&
+              fwrite(&header, 1, sizeof(header), cache->file) == sizeof(header) &&
+              fwrite(entry->key, 1, header.key_len, cache->file) == header.key_len &&
+              fwrite(entry->data, 1, header.data_len, cache->file) == header.data_len &&
+              fflush(cache->file) == 0 && fsync(fileno(cache->file)) == 0;
+    if (!ok) {
+        ESP_LOGW(TAG, "Append to %s failed", cache->path);
+        return false;
+    }
+    cache->file_size += *size;
+    return true;
+}
+
+// Index the log, stopping at the first record that does not check out
+static void scan_log(blob_cache_handle_t cache) {
+    uint8_t *chunk = heap_caps_malloc(SCAN_CHUNK, PSRAM_CAPS);
+    if (!chunk) {
+        return;
+    }
+    uint32_t now = now_s();
+    uint32_t offset = 0;
+    bool indexed = true;
+    record_header_t header;
+    char key[BLOB_CACHE_KEY_MAX];
+    while (read_header(cache->file, offset, &header) && header.data_len <= cache->config.disk_bytes &&
+           fread(key, 1, header.key_len, cache->file) == header.key_len) {
+        uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)&header + 8, sizeof(header) - 8);
+        crc = esp_rom_crc32_le(crc, (const uint8_t *)key, header.key_len);
+        size_t left = header.data_len;
+        while (left > 0) {
+            size_t n = left < SCAN_CHUNK ? left : SCAN_CHUNK;
+            if (fread(chunk, 1, n, cache->file) != n) {
+                break;
+            }
+            crc = esp_rom_crc32_le(crc, chunk, n);
+            left -= n;
+        }
+        if (left > 0) {
+            break;
+        }
+
+        key[header.key_len] = '\0';
+        uint32_t hash = hash_key(key);
+        uint32_t size = sizeof(header) + header.key_len + header.data_len;
+        if (crc != header.crc) {
+            // Whole but damaged; the header's lengths got us to a next record, or to the end
+            ESP_LOGW(TAG, "%s: bad record at %u skipped", cache->path, (unsigned)offset);
+            cache->stats.corrupt++;
+        } else if ((header.flags & RECORD_TOMBSTONE) || !fresh(header.expires, now)) {
+            index_drop(cache, hash);
+        } else if (!index_set(cache, hash, offset, size, header.expires)) {
+            indexed = false;
+            break;
+        }
+        offset += size;
+    }
+    heap_caps_free(chunk);
+
+    struct stat st;
+    if (!indexed) {
+        // Out of RAM, not a bad record: the rest is kept, unindexed, and appends go after it
+        ESP_LOGW(TAG, "%s: index full at %u keys", cache->path, (unsigned)cache->index_count);
+        offset = fstat(fileno(cache->file), &st) == 0 ? st.st_size : offset;
+    } else if (fstat(fileno(cache->file), &st) == 0 && (size_t)st.st_size > offset) {
+        // A torn append at power loss, most likely: the next one goes where it started
+        ESP_LOGW(TAG, "%s: %u bytes past the last good record dropped", cache->path,
+                 (unsigned)(st.st_size - offset));
+        cache->stats.corrupt++;
+        ftruncate(fileno(cache->file), offset);
+    }
+    cache->file_size = offset;
+}
+
+// A record as indexed when a compaction started, and where it went
+typedef struct {
+    index_entry_t at;
+    uint32_t moved_to;
+    bool kept;
+} compact_item_t;
+
+static int by_offset(const void *a, const void *b) {
+    uint32_t x = ((const compact_item_t *)a)->at.offset, y = ((const compact_item_t *)b)->at.offset;
+    return x < y ? -1 : x > y;
+}
+
+// Writer task. Rewrites the fresh indexed records into a new file renamed
+// over the log, dropping the oldest written first if they do not all fit
+static void compact(blob_cache_handle_t cache) {
+    size_t retry_at = cache->file_size + cache->config.disk_bytes / 4;
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    size_t count = cache->index_count;
+    compact_item_t *items = count ? heap_caps_calloc(count, sizeof(*items), PSRAM_CAPS) : NULL;
+    for (size_t i = 0; items && i < count; ++i) {
+        items[i].at = cache->index[i];
+    }
+    xSemaphoreGive(cache->lock);
+    if (count && !items) {
+        cache->compact_after = retry_at;
+        return;
+    }
+
+    qsort(items, count, sizeof(*items), by_offset);
+    uint32_t now = now_s();
+    size_t live = 0, largest = 0;
+    for (size_t i = 0; i < count; ++i) {
+        items[i].kept = fresh(items[i].at.expires, now);
+        if (items[i].kept) {
+            live += items[i].at.size;
+            largest = items[i].at.size > largest ? items[i].at.size : largest;
+        }
+    }
+    for (size_t i = 0; i < count && live > COMPACT_TARGET(cache->config.disk_bytes); ++i) {
+        if (items[i].kept) {
+            items[i].kept = false;
+            live -= items[i].at.size;
+        }
+    }
+
+    size_t path_len = strlen(cache->path);
+    char temp[path_len + sizeof(".tmp")];
+    memcpy(temp, cache->path, path_len);
+    memcpy(temp + path_len, ".tmp", sizeof(".tmp"));
+    FILE *out = fopen(temp, "wb");
+    uint8_t *buffer = largest ? heap_caps_malloc(largest, PSRAM_CAPS) : NULL;
+    bool ok = out && (buffer || largest == 0);
+    uint32_t offset = 0;
+    for (size_t i = 0; ok && i < count; ++i) {
+        if (!items[i].kept) {
+            continue;
+        }
+        const index_entry_t *at = &items[i].at;
+        ok = fseek(cache->file, at->offset, SEEK_SET) == 0 && fread(buffer, 1, at->size, cache->file) == at->size &&
+             fwrite(buffer, 1, at->size, out) == at->size;
+        items[i].moved_to = offset;
+        offset += at->size;
+    }
+    heap_caps_free(buffer);
+    if (out) {
+        ok = fflush(out) == 0 && fsync(fileno(out)) == 0 && ok;
+        fclose(out);
+    }
+    if (!ok) {
+        ESP_LOGW(TAG, "Compacting %s failed", cache->path);
+        unlink(temp);
+        heap_caps_free(items);
+        cache->compact_after = retry_at;
+        return;
+    }
+
+    // FATFS does not rename over a file
+    fclose(cache->file);
+    unlink(cache->path);
+    cache->file = rename(temp, cache->path) == 0 ? fopen(cache->path, "r+b") : NULL;
+    if (!cache->file) {
+        ESP_LOGE(TAG, "Reopening %s failed: the cache is RAM only now", cache->path);
+    }
+
+    // Keys removed or written again meanwhile are left as the index has them
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    for (size_t i = 0; i < count; ++i) {
+        index_entry_t *at = index_find(cache, items[i].at.hash);
+        if (!at || at->offset != items[i].at.offset) {
+            continue;
+        }
+        if (items[i].kept && cache->file) {
+            at->offset = items[i].moved_to;
+        } else {
+            index_drop(cache, items[i].at.hash);
+        }
+    }
+    cache->stats.compactions++;
+    xSemaphoreGive(cache->lock);
+    heap_caps_free(items);
+
+    ESP_LOGI(TAG, "%s compacted: %u -> %u bytes", cache->path, (unsigned)cache->file_size, (unsigned)offset);
+    cache->file_size = cache->file ? offset : 0;
+    cache->compact_after = 0;
+}
+
+// ---- The writer task ----
+
+static void write_one(blob_cache_handle_t cache, entry_t *entry) {
+    xSemaphoreTake(cache->file_lock, portMAX_DELAY);
+    uint32_t offset = cache->file_size;
+    uint32_t size = 0;
+    bool written = cache->file && append_record(cache, entry, entry->tombstone, &size);
+
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    if (entry->tombstone || !written) {
+        // A removal again, in case a write queued before it re-indexed the
+        // key; a failed write, as the log only has an older blob
+        index_drop(cache, entry->hash);
+    } else if (entry->linked) {
+        // Only the blob the front holds: one replaced or removed meanwhile
+        // has a later record on the way
+        if (!index_set(cache, entry->hash, offset, size, entry->expires)) {
+            index_drop(cache, entry->hash);
+        }
+    }
+    entry->pending = false;
+    entry_unref(entry);
+    xSemaphoreGive(cache->lock);
+
+    if (cache->file && cache->file_size > cache->config.disk_bytes && cache->file_size > cache->compact_after) {
+        compact(cache);
+    }
+    xSemaphoreGive(cache->file_lock);
+    __atomic_sub_fetch(&cache->queued, 1, __ATOMIC_RELEASE);
+}
+
+// Caller holds lock
+static entry_t *queue_pop(blob_cache_handle_t cache) {
+    entry_t *entry = cache->queue_head;
+    if (entry) {
+        cache->queue_head = entry->queue_next;
+        if (!cache->queue_head) {
+            cache->queue_tail = NULL;
+        }
+        entry->queue_next = NULL;
+        cache->queue_bytes -= entry_cost(entry);
+    }
+    return entry;
+}
+
+// One write per cache in turn, so a cache with a backlog does not hold up the others
+static void writer_task(void *arg) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        bool wrote;
+        do {
+            wrote = false;
+            for (blob_cache_handle_t cache = __atomic_load_n(&g_caches, __ATOMIC_ACQUIRE); cache;
+                 cache = cache->next) {
+                xSemaphoreTake(cache->lock, portMAX_DELAY);
+                entry_t *entry = queue_pop(cache);
+                xSemaphoreGive(cache->lock);
+                if (entry) {
+                    write_one(cache, entry);
+                    wrote = true;
+                }
+            }
+        } while (wrote);
+    }
+}
+
+static bool start_writer(void) {
+    uint32_t state = 0;
+    if (__atomic_compare_exchange_n(&g_writer_state, &state, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        if (xTaskCreate(writer_task, "blob_cache", BLOB_CACHE_WRITER_STACK, NULL, BLOB_CACHE_WRITER_PRIORITY,
+                        &g_writer) != pdPASS) {
+            ESP_LOGE(TAG, "Writer task not started");
+            __atomic_store_n(&g_writer_state, 0, __ATOMIC_RELEASE);
+            return false;
+        }
+        __atomic_store_n(&g_writer_state, 2, __ATOMIC_RELEASE);
+        return true;
+    }
+    // Another cache is starting it
+    while (state == 1) {
+        vTaskDelay(1);
+        state = __atomic_load_n(&g_writer_state, __ATOMIC_ACQUIRE);
+    }
+    return state == 2;
+}
+
+// Caller holds lock; the queue takes a reference
+static bool queue_write(blob_cache_handle_t cache, entry_t *entry) {
+    size_t cost = entry_cost(entry);
+    if (cache->queue_bytes + cost > cache->config.ram_bytes) {
+        if (cache->stats.dropped_writes++ % 64 == 0) {
+            ESP_LOGW(TAG, "Write backlog full: %s not persisted (%u dropped)", entry->key,
+                     (unsigned)cache->stats.dropped_writes);
+        }
+        return false;
+    }
+    entry->refs++;
+    entry->pending = true;
+    if (cache->queue_tail) {
+        cache->queue_tail->queue_next = entry;
+    } else {
+        cache->queue_head = entry;
+    }
+    cache->queue_tail = entry;
+    cache->queue_bytes += cost;
+    __atomic_add_fetch(&cache->queued, 1, __ATOMIC_ACQ_REL);
+    xTaskNotifyGive(g_writer);
+    return true;
+}
+
+// ---- API ----
+
+blob_cache_handle_t blob_cache_create(const blob_cache_config_t *config) {
+    blob_cache_handle_t cache = heap_caps_calloc(1, sizeof(*cache), PSRAM_CAPS);
+    if (!cache) {
+        return NULL;
+    }
+    cache->config = *config;
+    cache->lock = xSemaphoreCreateMutex();
+    cache->file_lock = xSemaphoreCreateMutex();
+    if (!cache->lock || !cache->file_lock) {
+        if (cache->lock) {
+            vSemaphoreDelete(cache->lock);
+        }
+        if (cache->file_lock) {
+            vSemaphoreDelete(cache->file_lock);
+        }
+        heap_caps_free(cache);
+        return NULL;
+    }
+
+    if (config->dir && config->name && config->disk_bytes > 0) {
+        size_t len = strlen(config->dir) + 1 + strlen(config->name) + 1;
+        cache->path = heap_caps_malloc(len, PSRAM_CAPS);
+        if (cache->path) {
+            snprintf(cache->path, len, "%s/%s", config->dir, config->name);
+            cache->file = fopen(cache->path, "r+b");
+            if (!cache->file) {
+                cache->file = fopen(cache->path, "w+b");
+            }
+        }
+        if (cache->file && !start_writer()) {
+            fclose(cache->file);
+            cache->file = NULL;
+        }
+        if (cache->file) {
+            scan_log(cache);
+            cache->next = __atomic_load_n(&g_caches, __ATOMIC_ACQUIRE);
+            while (!__atomic_compare_exchange_n(&g_caches, &cache->next, cache, false, __ATOMIC_ACQ_REL,
+                                                __ATOMIC_ACQUIRE)) {
+            }
+            ESP_LOGI(TAG, "%s: %u keys, %u of %u bytes live", cache->path, (unsigned)cache->index_count,
+                     (unsigned)cache->stats.disk_live, (unsigned)cache->file_size);
+        } else {
+            ESP_LOGW(TAG, "%s not opened: RAM only", cache->path ? cache->path : config->name);
+        }
+    }
+    cache->config.name = NULL;      // Not kept; the path is
+    cache->config.dir = NULL;
+    return cache;
+}
+
+bool blob_cache_put(blob_cache_handle_t cache, const char *key, const void *data, size_t len, uint32_t ttl_s) {
+    size_t key_len = strlen(key);
+    size_t cost = sizeof(entry_t) + key_len + 1 + len;
+    if (key_len == 0 || key_len >= BLOB_CACHE_KEY_MAX || cost > cache->config.ram_bytes / 2 ||
+        (cache->file && sizeof(record_header_t) + key_len + len > cache->config.disk_bytes / 2)) {
+        return false;
+    }
+    entry_t *entry = entry_alloc(key, key_len, len);
+    if (!entry) {
+        return false;
+    }
+    memcpy(entry->data, data, len);
+    uint32_t ttl = ttl_s ? ttl_s : cache->config.default_ttl_s;
+    entry->expires = ttl ? now_s() + ttl : 0;
+
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    front_insert(cache, entry);
+    if (cache->file && !queue_write(cache, entry)) {
+        index_drop(cache, entry->hash);     // What the log has is older than the front now
+    }
+    xSemaphoreGive(cache->lock);
+    return true;
+}
+
+void *blob_cache_peek(blob_cache_handle_t cache, const char *key, size_t *len) {
+    uint32_t hash = hash_key(key);
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    void *copy = front_copy(cache, key, hash, len);
+    if (copy) {
+        cache->stats.ram_hits++;
+    } else {
+        cache->stats.misses++;
+    }
+    xSemaphoreGive(cache->lock);
+    return copy;
+}
+
+void *blob_cache_get(blob_cache_handle_t cache, const char *key, size_t *len) {
+    uint32_t hash = hash_key(key);
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    void *copy = front_copy(cache, key, hash, len);
+    if (copy || !cache->file) {
+        if (copy) {
+            cache->stats.ram_hits++;
+        } else {
+            cache->stats.misses++;
+        }
+        xSemaphoreGive(cache->lock);
+        return copy;
+    }
+    xSemaphoreGive(cache->lock);
+
+    xSemaphoreTake(cache->file_lock, portMAX_DELAY);
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    index_entry_t *found = index_find(cache, hash);
+    index_entry_t at = found ? *found : (index_entry_t){0};
+    xSemaphoreGive(cache->lock);
+    entry_t *entry = NULL;
+    bool corrupt = false;
+    if (found && cache->file && fresh(at.expires, now_s())) {
+        entry = read_record(cache, &at, key);
+        corrupt = !entry;
+    }
+    xSemaphoreGive(cache->file_lock);
+
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    if (entry) {
+        // Unless a put got there while the file was read
+        if (!front_find(cache, key, hash)) {
+            front_insert(cache, entry);
+        } else {
+            entry_unref(entry);
+        }
+        copy = front_copy(cache, key, hash, len);
+    } else if (corrupt) {
+        // A hash collision reads as a mismatched key too; either way the record is not key's
+        index_entry_t *now = index_find(cache, hash);
+        if (now && now->offset == at.offset) {
+            index_drop(cache, hash);
+        }
+        cache->stats.corrupt++;
+    }
+    if (copy) {
+        cache->stats.disk_hits++;
+    } else {
+        cache->stats.misses++;
+    }
+    xSemaphoreGive(cache->lock);
+    return copy;
+}
+
+bool blob_cache_contains(blob_cache_handle_t cache, const char *key) {
+    uint32_t hash = hash_key(key);
+    uint32_t now = now_s();
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    entry_t *entry = front_find(cache, key, hash);
+    index_entry_t *at = entry ? NULL : index_find(cache, hash);
+    bool found = entry ? fresh(entry->expires, now) : at && fresh(at->expires, now);
+    xSemaphoreGive(cache->lock);
+    return found;
+}
+
+void blob_cache_remove(blob_cache_handle_t cache, const char *key) {
+    uint32_t hash = hash_key(key);
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    entry_t *entry = front_find(cache, key, hash);
+    bool writing = entry && entry->pending;
+    if (entry) {
+        front_unlink(cache, entry);
+    }
+    // A record for key in the log, or on its way there, would be found again at the next boot
+    if (cache->file && (writing || index_find(cache, hash))) {
+        index_drop(cache, hash);
+        entry_t *tombstone = entry_alloc(key, strlen(key), 0);
+        if (tombstone) {
+            tombstone->tombstone = true;
+            queue_write(cache, tombstone);
+            entry_unref(tombstone);
+        }
+    }
+    xSemaphoreGive(cache->lock);
+}
+
+bool blob_cache_flush(blob_cache_handle_t cache, uint32_t timeout_ms) {
+    TickType_t start = xTaskGetTickCount();
+    while (__atomic_load_n(&cache->queued, __ATOMIC_ACQUIRE) > 0) {
+        if (xTaskGetTickCount() - start >= pdMS_TO_TICKS(timeout_ms)) {
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(FLUSH_POLL_MS));
+    }
+    return true;
+}
+
+void blob_cache_get_stats(blob_cache_handle_t cache, blob_cache_stats_t *stats) {
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    *stats = cache->stats;
+    stats->disk_used = cache->file_size;
+    stats->entries = cache->file ? cache->index_count : cache->front_count;
+    xSemaphoreGive(cache->lock);
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "task_plan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Blob cache - keyed blobs kept hot in PSRAM and persisted behind
+ *
+ * Album art, API responses with their ETags, the media index, TLS session
+ * tickets and the discovery table all want the same thing: a blob by key,
+ * the recently used ones in RAM, the rest on a FAT volume across reboots.
+ * Each subsystem creates its own cache, with its own budgets and file.
+ *
+ * The front is an LRU of whole blobs in PSRAM, evicted least recently used
+ * first once it holds more than ram_bytes.
+ *
+ * The back is an append-only log, one file per cache in the directory
+ * given: records carry the key, the expiry and a CRC32 over all of it. The
+ * log is scanned when the cache is created: a record failing its CRC is
+ * skipped, and a torn write at power loss is cut off the end. Only a small
+ * index (hash, offset, expiry per key) stays in RAM. Once the file
+ * passes disk_bytes it is compacted into a new file renamed over the old,
+ * keeping the live records and dropping the oldest written if they alone
+ * would not fit.
+ *
+ * blob_cache_put() and blob_cache_remove() never touch the file: the blob
+ * goes into the front and the write is queued to one writer task shared by
+ * all caches, below the real-time tasks. A blob is not evicted from the
+ * front until it is written, so reads see it meanwhile, and the front may
+ * grow to twice ram_bytes while writes back up. Past that a write is
+ * dropped and counted; the blob then lives only in RAM.
+ *
+ * TTLs are in wall-clock seconds (time()), so they hold across reboots;
+ * until the clock is set, persisted entries count as fresh. A TTL of 0
+ * never expires.
+ *
+ * Any task may call these; a cache is never destroyed. Only
+ * blob_cache_get() may read the file, on the calling task:
+ * blob_cache_peek() is the one for the LVGL thread and other hot paths.
+ */
+
+#define BLOB_CACHE_KEY_MAX          192         // With the terminator
+#define BLOB_CACHE_BUCKETS          64          // Front hash table, per cache
+#define BLOB_CACHE_WRITER_PRIORITY  (TASK_PLAN_BACKGROUND_PRIORITY + 1)    // Below the audio, speech and LVGL tasks
+#define BLOB_CACHE_WRITER_STACK     4096
+#define BLOB_CACHE_MAGIC            0x31434C42  // "BLC1", per record
+
+typedef struct blob_cache *blob_cache_handle_t;
+
+typedef struct {
+    const char *name;           // File name in dir, e.g. ".art.log"; copied
+    const char *dir;            // e.g. "/flash" or "/sdcard", mounted already; NULL for RAM only
+    size_t ram_bytes;           // Front budget
+    size_t disk_bytes;          // Log size that triggers compaction; 0 for RAM only
+    uint32_t default_ttl_s;     // For blob_cache_put() with ttl_s 0; 0 never expires
+} blob_cache_config_t;
+
+typedef struct {
+    uint32_t ram_hits;
+    uint32_t disk_hits;
+    uint32_t misses;
+    uint32_t corrupt;           // Records failing their CRC or key check
+    uint32_t dropped_writes;    // Write backlog past ram_bytes
+    uint32_t compactions;
+    size_t ram_used;
+    size_t disk_used;           // Log file size
+    size_t disk_live;           // Bytes of records still indexed
+    size_t entries;             // Keys in the index, or in the front for RAM only
+} blob_cache_stats_t;
+
+/**
+ * @brief Create a cache, loading the index of an existing log
+ *
+ * Scans the whole log once (on the calling task).
+ * @return NULL without memory; a log that cannot be opened leaves a RAM-only cache
+ */
+blob_cache_handle_t blob_cache_create(const blob_cache_config_t *config);
+
+/**
+ * @brief Store a copy of data under key, replacing what was there
+ *
+ * @param ttl_s Seconds until it expires; 0 for the cache's default
+ * @return false if key or len is too large, or without memory
+ */
+bool blob_cache_put(blob_cache_handle_t cache, const char *key, const void *data, size_t len, uint32_t ttl_s);
+
+/**
+ * @brief A copy of key's blob, from the front or else read from the log
+ *
+ * A blob read from the log is put back in the front.
+ * @return A heap_caps_malloc'd PSRAM copy the caller frees, or NULL if
+ *         missing or expired; *len is its size
+ */
+void *blob_cache_get(blob_cache_handle_t cache, const char *key, size_t *len);
+
+/**
+ * @brief blob_cache_get() from the front only: never touches the file
+ */
+void *blob_cache_peek(blob_cache_handle_t cache, const char *key, size_t *len);
+
+/**
+ * @brief Whether key is cached and fresh, in the front or the log, without reading it
+ */
+bool blob_cache_contains(blob_cache_handle_t cache, const char *key);
+
+/**
+ * @brief Drop key from the front and, behind, from the log
+ */
+void blob_cache_remove(blob_cache_handle_t cache, const char *key);
+
+/**
+ * @brief Wait until this cache's queued writes are in the file
+ *
+ * @return false if some were still queued after timeout_ms
+ */
+bool blob_cache_flush(blob_cache_handle_t cache, uint32_t timeout_ms);
+
+void blob_cache_get_stats(blob_cache_handle_t cache, blob_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,139 @@
+#include <string.h>
+#include <stdlib.h>
+#include "audio_aac.h"
+#include "esp_aac_dec.h"
+
+static const char *TAG = "aac";
+
+#define AAC_DATA_BUF_SIZE       (6 * 1024)      /*< several max-size (768 byte/channel) ADTS frames */
+
+void aac_free(aac_instance *pInstance)
+{
+    if(pInstance->decoder) {
+        esp_aac_dec_close(pInstance->decoder);
+    }
+    free(pInstance->data_buf);
+    free(pInstance->pcm);
+    memset(pInstance, 0, sizeof(*pInstance));
+}
+
+bool aac_probe(FILE *fp)
+{
+    fseek(fp, 0, SEEK_SET);
+
+    // ADTS: 12-bit sync, then MPEG version, layer 00
+    uint8_t magic[2];
+    bool adts = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) &&
+                magic[0] == 0xFF && (magic[1] & 0xF6) == 0xF0;
+    fseek(fp, 0, SEEK_SET);
+    return adts;
+}
+
+bool is_aac(FILE *fp, aac_instance *pInstance)
+{
+    if(!aac_probe(fp)) {
+        return false;
+    }
+
+    aac_free(pInstance);
+    esp_aac_dec_cfg_t config = ESP_AAC_DEC_CONFIG_DEFAULT();
+    if(esp_aac_dec_open(&config, sizeof(config), &pInstance->decoder) != ESP_AUDIO_ERR_OK) {
+        ESP_LOGE(TAG, "failed to open decoder");
+        pInstance->decoder = NULL;
+        return false;
+    }
+    pInstance->data_buf_size = AAC_DATA_BUF_SIZE;
+    pInstance->data_buf = static_cast<uint8_t*>(malloc(pInstance->data_buf_size));
+    if(!pInstance->data_buf) {
+        aac_free(pInstance);
+        return false;
+    }
+    pInstance->read_ptr = pInstance->data_buf;
+    return true;
+}
+
+static void refill(FILE *fp, aac_instance *pInstance)
+{
+    size_t unread = pInstance->bytes_in_data_buf - (pInstance->read_ptr - pInstance->data_buf);
+    if(pInstance->eof_reached || unread >= pInstance->data_buf_size / 2) {
+        return;
+    }
+    memmove(pInstance->data_buf, pInstance->read_ptr, unread);
+    size_t n = fread(pInstance->data_buf + unread, 1, pInstance->data_buf_size - unread, fp);
+    pInstance->bytes_in_data_buf = unread + n;
+    pInstance->read_ptr = pInstance->data_buf;
+    if(n == 0 || feof(fp)) {
+        pInstance->eof_reached = true;
+    }
+}
+
+static void output_pcm(decode_data *pData, aac_instance *pInstance)
+{
+    size_t frame_bytes = pInstance->fmt.channels * (pInstance->fmt.bits_per_sample / BITS_PER_BYTE);
+    size_t bytes = pInstance->pcm_len - pInstance->pcm_pos;
+    size_t capacity = (pData->samples_capacity / frame_bytes) * frame_bytes;
+    if(bytes > capacity) {
+        bytes = capacity;
+    }
+    memcpy(pData->samples, pInstance->pcm + pInstance->pcm_pos, bytes);
+    pInstance->pcm_pos += bytes;
+    pData->fmt = pInstance->fmt;
+    pData->frame_count = bytes / frame_bytes;
+}
+
+DECODE_STATUS decode_aac(FILE *fp, decode_data *pData, aac_instance *pInstance)
+{
+    if(pInstance->pcm_pos < pInstance->pcm_len) {
+        output_pcm(pData, pInstance);
+        return DECODE_STATUS_CONTINUE;
+    }
+
+    refill(fp, pInstance);
+    size_t unread = pInstance->bytes_in_data_buf - (pInstance->read_ptr - pInstance->data_buf);
+    if(unread == 0) {
+        return DECODE_STATUS_DONE;
+    }
+
+    esp_audio_dec_in_raw_t raw = {};
+    raw.buffer = pInstance->read_ptr;
+    raw.len = unread;
+    raw.eos = pInstance->eof_reached;
+    esp_audio_dec_out_frame_t frame = {};
+    esp_audio_dec_info_t info = {};
+
+    esp_audio_err_t err;
+    while(true) {
+        frame.buffer = pInstance->pcm;
+        frame.len = pInstance->pcm_size;
+        err = esp_aac_dec_decode(pInstance->decoder, &raw, &frame, &info);
+        if(err != ESP_AUDIO_ERR_BUFF_NOT_ENOUGH) {
+            break;
+        }
+        // First frame, or SBR doubled the frame size: grow the PCM buffer
+        uint8_t *pcm = static_cast<uint8_t*>(realloc(pInstance->pcm, frame.needed_size));
+        if(!pcm) {
+            ESP_LOGE(TAG, "no memory for %d byte frames", (int)frame.needed_size);
+            return DECODE_STATUS_ERROR;
+        }
+        pInstance->pcm = pcm;
+        pInstance->pcm_size = frame.needed_size;
+    }
+
+    // Skip a byte when nothing was consumed so a damaged frame cannot stall us
+    pInstance->read_ptr += raw.consumed ? raw.consumed : 1;
+    if(err != ESP_AUDIO_ERR_OK || frame.decoded_size == 0) {
+        if(err != ESP_AUDIO_ERR_OK) {
+            LOGI_1("decode error %d", err);
+        }
+        pData->frame_count = 0;
+        return pInstance->eof_reached && unread <= raw.consumed ? DECODE_STATUS_DONE : DECODE_STATUS_NO_DATA_CONTINUE;
+    }
+
+    pInstance->fmt.sample_rate = info.sample_rate;
+    pInstance->fmt.channels = info.channel;
+    pInstance->fmt.bits_per_sample = info.bits_per_sample;
+    pInstance->pcm_len = frame.decoded_size;
+    pInstance->pcm_pos = 0;
+    output_pcm(pData, pInstance);
+    return DECODE_STATUS_CONTINUE;
+}
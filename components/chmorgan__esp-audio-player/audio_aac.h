@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdio.h>
+#include "audio_log.h"
+#include "audio_decode_types.h"
+
+/**
+ * AAC-LC / HE-AAC (v1, v2) in ADTS framing, decoded with the AAC decoder of
+ * espressif/esp_audio_codec. A decoded frame (up to 2048 frames with SBR)
+ * is larger than decode_data::samples, so it is buffered here and handed
+ * out over several decode_aac() calls.
+ */
+typedef struct {
+    void *decoder;
+
+    uint8_t *data_buf;          /*< ADTS input */
+    size_t data_buf_size;
+    size_t bytes_in_data_buf;
+    uint8_t *read_ptr;
+    bool eof_reached;
+
+    uint8_t *pcm;               /*< last decoded frame, interleaved 16-bit */
+    size_t pcm_size;
+    size_t pcm_len;
+    size_t pcm_pos;
+    format fmt;
+} aac_instance;
+
+/** @return true if fp starts with an ADTS frame; no allocation, fp is rewound */
+bool aac_probe(FILE *fp);
+/** @return true if fp starts with an ADTS frame; opens the decoder */
+bool is_aac(FILE *fp, aac_instance *pInstance);
+DECODE_STATUS decode_aac(FILE *fp, decode_data *pData, aac_instance *pInstance);
+void aac_free(aac_instance *pInstance);
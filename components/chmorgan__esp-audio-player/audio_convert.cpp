@@ -0,0 +1,171 @@
+#include <string.h>
+#include "audio_log.h"
+#include "audio_player.h"
+#include "audio_convert.h"
+
+static const char *TAG = "convert";
+
+format audio_convert_negotiate(const format &in, uint32_t caps)
+{
+    format out = in;
+    if(caps == 0) {
+        /* Before output_caps: stereo at whatever width was decoded */
+        out.channels = 2;
+        return out;
+    }
+    if(in.channels == 1 && !(caps & AUDIO_PLAYER_OUTPUT_MONO)) {
+        out.channels = 2;
+    } else if(in.channels == 2 && !(caps & AUDIO_PLAYER_OUTPUT_STEREO)) {
+        out.channels = 1;
+    }
+    uint32_t width_cap = (in.bits_per_sample == 8) ? AUDIO_PLAYER_OUTPUT_8BIT :
+                         (in.bits_per_sample == 16) ? AUDIO_PLAYER_OUTPUT_16BIT :
+                         (in.bits_per_sample == 24) ? AUDIO_PLAYER_OUTPUT_24BIT :
+                         (in.bits_per_sample == 32) ? AUDIO_PLAYER_OUTPUT_32BIT : 0;
+    if(!(caps & width_cap)) {
+        out.bits_per_sample = 16;
+    }
+    return out;
+}
+
+/* Unsigned 8-bit to signed 16-bit, back to front */
+static void widen_8(uint8_t *buf, size_t count)
+{
+    const uint8_t *in = buf + count;
+    int16_t *out = reinterpret_cast<int16_t*>(buf) + count;
+    while(count--) {
+        *--out = (int16_t)((*--in - 128) << 8);
+    }
+}
+
+/* Packed little-endian 24-bit to 16-bit, front to back: the top two bytes */
+static void narrow_24(uint8_t *buf, size_t count)
+{
+    const uint8_t *in = buf;
+    uint16_t *out = reinterpret_cast<uint16_t*>(buf);
+    for(size_t n = 0; n < count; n++, in += 3) {
+        out[n] = (uint16_t)(in[1] | (in[2] << 8));
+    }
+}
+
+/* 32-bit to 16-bit, front to back: two high halves per output word */
+static void narrow_32(uint8_t *buf, size_t count)
+{
+    const uint32_t *in = reinterpret_cast<const uint32_t*>(buf);
+    uint32_t *out = reinterpret_cast<uint32_t*>(buf);
+    size_t pairs = count / 2;
+    size_t n = 0;
+    for(; n + 4 <= pairs; n += 4) {
+        uint32_t a0 = in[2 * n], a1 = in[2 * n + 1], b0 = in[2 * n + 2], b1 = in[2 * n + 3];
+        uint32_t c0 = in[2 * n + 4], c1 = in[2 * n + 5], d0 = in[2 * n + 6], d1 = in[2 * n + 7];
+        out[n] = (a0 >> 16) | (a1 & 0xFFFF0000);
+        out[n + 1] = (b0 >> 16) | (b1 & 0xFFFF0000);
+        out[n + 2] = (c0 >> 16) | (c1 & 0xFFFF0000);
+        out[n + 3] = (d0 >> 16) | (d1 & 0xFFFF0000);
+    }
+    for(; n < pairs; n++) {
+        out[n] = (in[2 * n] >> 16) | (in[2 * n + 1] & 0xFFFF0000);
+    }
+    if(count & 1) {
+        reinterpret_cast<uint16_t*>(buf)[count - 1] = (uint16_t)(in[count - 1] >> 16);
+    }
+}
+
+/* 16-bit mono to stereo, back to front: each input word (two frames) becomes two output words */
+static void upmix_16(uint8_t *buf, size_t frames)
+{
+    const uint16_t *in16 = reinterpret_cast<const uint16_t*>(buf);
+    uint32_t *out = reinterpret_cast<uint32_t*>(buf);
+    size_t n = frames;
+    if(n & 1) {
+        /* The odd last frame, so the rest is whole words */
+        n--;
+        uint32_t s = in16[n];
+        out[n] = s | (s << 16);
+    }
+    const uint32_t *in = reinterpret_cast<const uint32_t*>(buf);
+    size_t words = n / 2;
+    /* Output word 2k+1 is written after input word k+1 .. are read: in place is safe back to front */
+    while(words >= 4) {
+        words -= 4;
+        uint32_t w3 = in[words + 3], w2 = in[words + 2], w1 = in[words + 1], w0 = in[words];
+        out[2 * words + 7] = (w3 & 0xFFFF0000) | (w3 >> 16);
+        out[2 * words + 6] = (w3 << 16) | (w3 & 0xFFFF);
+        out[2 * words + 5] = (w2 & 0xFFFF0000) | (w2 >> 16);
+        out[2 * words + 4] = (w2 << 16) | (w2 & 0xFFFF);
+        out[2 * words + 3] = (w1 & 0xFFFF0000) | (w1 >> 16);
+        out[2 * words + 2] = (w1 << 16) | (w1 & 0xFFFF);
+        out[2 * words + 1] = (w0 & 0xFFFF0000) | (w0 >> 16);
+        out[2 * words] = (w0 << 16) | (w0 & 0xFFFF);
+    }
+    while(words--) {
+        uint32_t w = in[words];
+        out[2 * words + 1] = (w & 0xFFFF0000) | (w >> 16);
+        out[2 * words] = (w << 16) | (w & 0xFFFF);
+    }
+}
+
+/* 16-bit stereo to mono, front to back: the mean of each frame */
+static void downmix_16(uint8_t *buf, size_t frames)
+{
+    const uint32_t *in = reinterpret_cast<const uint32_t*>(buf);
+    int16_t *out = reinterpret_cast<int16_t*>(buf);
+    for(size_t n = 0; n < frames; n++) {
+        uint32_t w = in[n];
+        out[n] = (int16_t)(((int32_t)(int16_t)(w & 0xFFFF) + (int32_t)(int16_t)(w >> 16)) >> 1);
+    }
+}
+
+esp_err_t audio_convert(decode_data &adata, const format &out)
+{
+    format &fmt = adata.fmt;
+    if(fmt.channels == out.channels && fmt.bits_per_sample == out.bits_per_sample) {
+        return ESP_OK;
+    }
+    if(out.bits_per_sample != fmt.bits_per_sample && out.bits_per_sample != 16) {
+        ESP_LOGE(TAG, "%d-bit output to %d-bit not supported", (int)fmt.bits_per_sample, (int)out.bits_per_sample);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if(out.channels != fmt.channels && out.bits_per_sample != 16) {
+        ESP_LOGE(TAG, "channel conversion needs 16-bit samples, have %d-bit", (int)fmt.bits_per_sample);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    size_t out_bytes = adata.frame_count * out.channels * (out.bits_per_sample / BITS_PER_BYTE);
+    size_t in_bytes = adata.frame_count * fmt.channels * (fmt.bits_per_sample / BITS_PER_BYTE);
+    /* Narrowing runs before an upmix, so the widest point is one of the two ends */
+    size_t peak = (out_bytes > in_bytes) ? out_bytes : in_bytes;
+    if(peak > adata.samples_capacity_max) {
+        ESP_LOGE(TAG, "no room to convert %d frames, need %d, have %d", (int)adata.frame_count, (int)peak,
+                 (int)adata.samples_capacity_max);
+        return ESP_ERR_NO_MEM;
+    }
+
+    size_t samples = adata.frame_count * fmt.channels;
+    switch(fmt.bits_per_sample) {
+        case 8:
+            if(out.bits_per_sample == 16) {
+                widen_8(adata.samples, samples);
+            }
+            break;
+        case 24:
+            narrow_24(adata.samples, samples);
+            break;
+        case 32:
+            narrow_32(adata.samples, samples);
+            break;
+        default:
+            break;
+    }
+    fmt.bits_per_sample = out.bits_per_sample;
+
+    if(fmt.channels == 1 && out.channels == 2) {
+        upmix_16(adata.samples, adata.frame_count);
+    } else if(fmt.channels == 2 && out.channels == 1) {
+        downmix_16(adata.samples, adata.frame_count);
+    } else if(fmt.channels != out.channels) {
+        ESP_LOGE(TAG, "%d to %d channels not supported", (int)fmt.channels, (int)out.channels);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    fmt.channels = out.channels;
+    return ESP_OK;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "audio_decode_types.h"
+
+/**
+ * Output format negotiation between the decoders and write_fn.
+ *
+ * The sink declares the slot modes and sample widths it takes in
+ * audio_player_config_t::output_caps; audio_convert_negotiate() picks the
+ * format closest to the decoded one within them, and audio_convert() only
+ * runs when the two differ. Mono stays mono for a sink that takes mono,
+ * halving the buffer fill and the I2S bandwidth. Widths a sink does not
+ * take become 16-bit.
+ *
+ * The kernels work in place on 32-bit words (two 16-bit samples at a time,
+ * unrolled), front to back when the data shrinks and back to front when it
+ * grows. Growth is at most 2x, which samples_capacity_max allows for.
+ *
+ * With CONFIG_AUDIO_PLAYER_RESAMPLE the converter does its own channel
+ * handling and the output is always 16-bit stereo, for the mixer.
+ */
+
+/** The format write_fn is given for decoded audio in `in` */
+format audio_convert_negotiate(const format &in, uint32_t caps);
+
+/** adata from its format to `out` (from audio_convert_negotiate()), in place */
+esp_err_t audio_convert(decode_data &adata, const format &out);
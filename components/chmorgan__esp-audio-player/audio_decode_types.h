@@ -36,8 +36,8 @@ typedef struct {
     size_t samples_capacity;
 
     /**
-     * 2x samples_capacity to allow for in-place conversion of
-     * mono to stereo
+     * 2x samples_capacity to allow for in-place conversion to the
+     * sink's format (mono to stereo, 8 to 16-bit)
      */
     size_t samples_capacity_max;
 
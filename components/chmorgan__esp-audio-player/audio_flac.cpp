@@ -0,0 +1,534 @@
+#include <string.h>
+#include <stdlib.h>
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "audio_flac.h"
+
+static const char *TAG = "flac";
+
+#define FLAC_MAX_CHANNELS       8
+#define FLAC_MAX_LPC_ORDER      32
+#define FLAC_FRAME_HEADER_MAX   16
+
+/* **************** BIT READER **************** */
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;                 /*< next byte to load into cache */
+    uint64_t cache;
+    int bits;                   /*< valid bits (MSB-aligned) in cache */
+} bit_reader;
+
+static inline void br_init(bit_reader *br, const uint8_t *data, size_t size)
+{
+    br->data = data;
+    br->size = size;
+    br->pos = 0;
+    br->cache = 0;
+    br->bits = 0;
+}
+
+/** True once more bits were consumed than the buffer holds (the cache reads ahead as zeros) */
+static inline bool br_overrun(const bit_reader *br)
+{
+    return br->pos * 8 - br->bits > br->size * 8;
+}
+
+static inline void IRAM_ATTR br_fill(bit_reader *br)
+{
+    while(br->bits <= 56) {
+        uint64_t byte = br->pos < br->size ? br->data[br->pos] : 0;
+        br->pos++;
+        br->cache |= byte << (56 - br->bits);
+        br->bits += 8;
+    }
+}
+
+/** n in 0..32 */
+static inline uint32_t IRAM_ATTR br_read(bit_reader *br, int n)
+{
+    if(n == 0) {
+        return 0;
+    }
+    if(br->bits < n) {
+        br_fill(br);
+    }
+    uint32_t value = (uint32_t)(br->cache >> (64 - n));
+    br->cache <<= n;
+    br->bits -= n;
+    return value;
+}
+
+static inline int32_t IRAM_ATTR br_read_signed(bit_reader *br, int n)
+{
+    if(n == 0) {
+        return 0;
+    }
+    uint32_t value = br_read(br, n);
+    uint32_t sign = 1u << (n - 1);
+    return (int32_t)((value ^ sign) - sign);
+}
+
+/** Count of 0 bits before the next 1 bit (which is consumed) */
+static inline uint32_t IRAM_ATTR br_read_unary(bit_reader *br)
+{
+    uint32_t count = 0;
+    while(true) {
+        if(br->bits == 0 || br->cache == 0) {
+            count += br->bits;
+            br->cache = 0;
+            br->bits = 0;
+            br_fill(br);
+            if(br->pos > br->size + 16) {
+                return count;       // ran off the end; the caller sees br_overrun()
+            }
+            continue;
+        }
+        int zeros = __builtin_clzll(br->cache);
+        if(zeros >= br->bits) {
+            count += br->bits;
+            br->cache = 0;
+            br->bits = 0;
+            continue;
+        }
+        count += zeros;
+        br->cache <<= zeros + 1;
+        br->bits -= zeros + 1;
+        return count;
+    }
+}
+
+static inline void br_align(bit_reader *br)
+{
+    int drop = br->bits & 7;
+    br->cache <<= drop;
+    br->bits -= drop;
+}
+
+/** Bytes consumed so far (valid when byte-aligned) */
+static inline size_t br_byte_pos(const bit_reader *br)
+{
+    return br->pos - br->bits / 8;
+}
+
+/* **************** FRAME DECODE **************** */
+static uint8_t crc8(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0;
+    for(size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for(int b = 0; b < 8; b++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static bool IRAM_ATTR decode_residual(bit_reader *br, int32_t *out, uint32_t block_size, uint32_t order)
+{
+    uint32_t method = br_read(br, 2);
+    if(method > 1) {
+        return false;
+    }
+    int param_bits = method == 0 ? 4 : 5;
+    uint32_t escape = method == 0 ? 15 : 31;
+    uint32_t partition_order = br_read(br, 4);
+    uint32_t partitions = 1u << partition_order;
+    uint32_t partition_size = block_size >> partition_order;
+    if((partition_size << partition_order) != block_size || partition_size < order) {
+        return false;
+    }
+
+    uint32_t n = order;
+    for(uint32_t p = 0; p < partitions; p++) {
+        uint32_t count = (p == 0) ? partition_size - order : partition_size;
+        uint32_t k = br_read(br, param_bits);
+        if(k == escape) {
+            int raw_bits = br_read(br, 5);
+            for(uint32_t i = 0; i < count; i++) {
+                out[n++] = br_read_signed(br, raw_bits);
+            }
+        } else {
+            for(uint32_t i = 0; i < count; i++) {
+                uint32_t value = (br_read_unary(br) << k) | br_read(br, k);
+                out[n++] = (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+            }
+        }
+    }
+    return !br_overrun(br);
+}
+
+static void IRAM_ATTR restore_fixed(int32_t *s, uint32_t block_size, uint32_t order)
+{
+    switch(order) {
+        case 0:
+            break;
+        case 1:
+            for(uint32_t i = 1; i < block_size; i++) s[i] += s[i - 1];
+            break;
+        case 2:
+            for(uint32_t i = 2; i < block_size; i++) s[i] += 2 * s[i - 1] - s[i - 2];
+            break;
+        case 3:
+            for(uint32_t i = 3; i < block_size; i++) s[i] += 3 * s[i - 1] - 3 * s[i - 2] + s[i - 3];
+            break;
+        case 4:
+            for(uint32_t i = 4; i < block_size; i++) s[i] += 4 * s[i - 1] - 6 * s[i - 2] + 4 * s[i - 3] - s[i - 4];
+            break;
+    }
+}
+
+static void IRAM_ATTR restore_lpc(int32_t *s, uint32_t block_size, const int32_t *coefs, uint32_t order,
+                                  int shift, bool wide)
+{
+    if(wide) {
+        for(uint32_t i = order; i < block_size; i++) {
+            int64_t sum = 0;
+            for(uint32_t j = 0; j < order; j++) {
+                sum += (int64_t)coefs[j] * s[i - 1 - j];
+            }
+            s[i] += (int32_t)(sum >> shift);
+        }
+    } else {
+        // 16-bit audio with the usual coefficient precision fits in 32 bits
+        for(uint32_t i = order; i < block_size; i++) {
+            int32_t sum = 0;
+            for(uint32_t j = 0; j < order; j++) {
+                sum += coefs[j] * s[i - 1 - j];
+            }
+            s[i] += sum >> shift;
+        }
+    }
+}
+
+static bool decode_subframe(bit_reader *br, int32_t *s, uint32_t block_size, uint32_t bps)
+{
+    if(br_read(br, 1) != 0) {
+        return false;
+    }
+    uint32_t type = br_read(br, 6);
+    uint32_t wasted = 0;
+    if(br_read(br, 1)) {
+        wasted = br_read_unary(br) + 1;
+        if(wasted >= bps) {
+            return false;
+        }
+        bps -= wasted;
+    }
+
+    if(type == 0) {
+        int32_t value = br_read_signed(br, bps);
+        for(uint32_t i = 0; i < block_size; i++) s[i] = value;
+    } else if(type == 1) {
+        for(uint32_t i = 0; i < block_size; i++) s[i] = br_read_signed(br, bps);
+    } else if(type >= 8 && type <= 12) {
+        uint32_t order = type & 7;
+        if(order > block_size) {
+            return false;
+        }
+        for(uint32_t i = 0; i < order; i++) s[i] = br_read_signed(br, bps);
+        if(!decode_residual(br, s, block_size, order)) {
+            return false;
+        }
+        restore_fixed(s, block_size, order);
+    } else if(type >= 32) {
+        uint32_t order = (type & 31) + 1;
+        if(order > block_size) {
+            return false;
+        }
+        for(uint32_t i = 0; i < order; i++) s[i] = br_read_signed(br, bps);
+        uint32_t precision = br_read(br, 4) + 1;
+        if(precision == 16) {
+            return false;
+        }
+        int shift = br_read_signed(br, 5);
+        if(shift < 0) {
+            return false;
+        }
+        int32_t coefs[FLAC_MAX_LPC_ORDER];
+        for(uint32_t i = 0; i < order; i++) coefs[i] = br_read_signed(br, precision);
+        if(!decode_residual(br, s, block_size, order)) {
+            return false;
+        }
+        // bps + precision + log2(order) bits are needed for the sum
+        bool wide = bps + precision + (32 - __builtin_clz(order)) > 32;
+        restore_lpc(s, block_size, coefs, order, shift, wide);
+    } else {
+        return false;
+    }
+
+    if(wasted) {
+        for(uint32_t i = 0; i < block_size; i++) s[i] <<= wasted;
+    }
+    return !br_overrun(br);
+}
+
+/**
+ * Decode the frame at data[0..size) into pInstance->block.
+ * @return bytes consumed, 0 if this is not a valid frame
+ */
+static size_t decode_frame(flac_instance *pInstance, const uint8_t *data, size_t size)
+{
+    bit_reader br;
+    br_init(&br, data, size);
+
+    if(br_read(&br, 15) != 0x7FFC) {
+        return 0;
+    }
+    br_read(&br, 1);    // blocking strategy
+    uint32_t bs_code = br_read(&br, 4);
+    uint32_t sr_code = br_read(&br, 4);
+    uint32_t ch_code = br_read(&br, 4);
+    uint32_t ss_code = br_read(&br, 3);
+    if(br_read(&br, 1) != 0 || bs_code == 0 || sr_code == 15 || ch_code > 10 || ss_code == 3) {
+        return 0;
+    }
+
+    // UTF-8 style frame/sample number
+    uint32_t first = br_read(&br, 8);
+    int extra = 0;
+    while(extra < 7 && (first & (0x80 >> extra))) extra++;
+    if(extra == 1 || extra > 7) {
+        return 0;
+    }
+    for(int i = 1; i < extra; i++) {
+        if((br_read(&br, 8) & 0xC0) != 0x80) {
+            return 0;
+        }
+    }
+
+    uint32_t block_size;
+    if(bs_code == 1) block_size = 192;
+    else if(bs_code <= 5) block_size = 576u << (bs_code - 2);
+    else if(bs_code == 6) block_size = br_read(&br, 8) + 1;
+    else if(bs_code == 7) block_size = br_read(&br, 16) + 1;
+    else block_size = 256u << (bs_code - 8);
+
+    if(sr_code == 12) br_read(&br, 8);
+    else if(sr_code == 13 || sr_code == 14) br_read(&br, 16);
+
+    static const uint8_t sample_sizes[8] = { 0, 8, 12, 0, 16, 20, 24, 32 };
+    uint32_t bps = ss_code ? sample_sizes[ss_code] : pInstance->bits_per_sample;
+
+    size_t header_len = br_byte_pos(&br);
+    uint8_t crc = (uint8_t)br_read(&br, 8);
+    if(br_overrun(&br) || crc != crc8(data, header_len)) {
+        return 0;
+    }
+
+    uint32_t channels = ch_code < 8 ? ch_code + 1 : 2;
+    if(channels != pInstance->channels || block_size > pInstance->max_blocksize || bps == 0 || bps > 32) {
+        return 0;
+    }
+
+    int32_t *ch[FLAC_MAX_CHANNELS];
+    for(uint32_t c = 0; c < channels; c++) {
+        ch[c] = pInstance->block + c * pInstance->max_blocksize;
+        // The side channel carries one extra bit
+        uint32_t sub_bps = bps;
+        if((ch_code == 8 && c == 1) || (ch_code == 9 && c == 0) || (ch_code == 10 && c == 1)) {
+            sub_bps++;
+        }
+        if(!decode_subframe(&br, ch[c], block_size, sub_bps)) {
+            return 0;
+        }
+    }
+
+    int32_t *l = ch[0];
+    int32_t *r = channels > 1 ? ch[1] : NULL;
+    if(ch_code == 8) {              // left/side
+        for(uint32_t i = 0; i < block_size; i++) r[i] = l[i] - r[i];
+    } else if(ch_code == 9) {       // side/right
+        for(uint32_t i = 0; i < block_size; i++) l[i] += r[i];
+    } else if(ch_code == 10) {      // mid/side
+        for(uint32_t i = 0; i < block_size; i++) {
+            int32_t side = r[i];
+            int32_t mid = (int32_t)((uint32_t)l[i] << 1) | (side & 1);
+            l[i] = (mid + side) >> 1;
+            r[i] = (mid - side) >> 1;
+        }
+    }
+
+    br_align(&br);
+    br_read(&br, 16);               // CRC-16 of the frame; the header CRC-8 already rules out false syncs
+    if(br_overrun(&br)) {
+        return 0;
+    }
+
+    pInstance->block_frames = block_size;
+    pInstance->block_pos = 0;
+    pInstance->block_bits = bps;
+    return br_byte_pos(&br);
+}
+
+/* **************** STREAM **************** */
+void flac_free(flac_instance *pInstance)
+{
+    free(pInstance->data_buf);
+    heap_caps_free(pInstance->block);
+    pInstance->data_buf = NULL;
+    pInstance->block = NULL;
+}
+
+bool flac_probe(FILE *fp)
+{
+    fseek(fp, 0, SEEK_SET);
+    uint8_t magic[4];
+    bool flac = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) && memcmp(magic, "fLaC", 4) == 0;
+    fseek(fp, 0, SEEK_SET);
+    return flac;
+}
+
+bool is_flac(FILE *fp, flac_instance *pInstance)
+{
+    fseek(fp, 0, SEEK_SET);
+
+    uint8_t magic[4];
+    if(fread(magic, 1, sizeof(magic), fp) != sizeof(magic) || memcmp(magic, "fLaC", 4) != 0) {
+        fseek(fp, 0, SEEK_SET);
+        return false;
+    }
+
+    // Metadata blocks: only STREAMINFO (always first) matters
+    bool have_info = false;
+    uint32_t max_framesize = 0;
+    bool last = false;
+    while(!last) {
+        uint8_t header[4];
+        if(fread(header, 1, sizeof(header), fp) != sizeof(header)) {
+            return false;
+        }
+        last = header[0] & 0x80;
+        uint32_t type = header[0] & 0x7F;
+        uint32_t length = ((uint32_t)header[1] << 16) | ((uint32_t)header[2] << 8) | header[3];
+        if(type == 0 && length >= 34) {
+            uint8_t info[34];
+            if(fread(info, 1, sizeof(info), fp) != sizeof(info)) {
+                return false;
+            }
+            pInstance->max_blocksize = ((uint32_t)info[2] << 8) | info[3];
+            max_framesize = ((uint32_t)info[7] << 16) | ((uint32_t)info[8] << 8) | info[9];
+            pInstance->sample_rate = ((uint32_t)info[10] << 12) | ((uint32_t)info[11] << 4) | (info[12] >> 4);
+            pInstance->channels = ((info[12] >> 1) & 0x07) + 1;
+            pInstance->bits_per_sample = (((info[12] & 0x01) << 4) | (info[13] >> 4)) + 1;
+            have_info = true;
+            length -= sizeof(info);
+        }
+        if(length && fseek(fp, length, SEEK_CUR) != 0) {
+            return false;
+        }
+    }
+    if(!have_info || pInstance->max_blocksize < 16 || pInstance->channels > FLAC_MAX_CHANNELS) {
+        return false;
+    }
+
+    // Room for the largest frame twice over, so a whole one is always buffered
+    // after a refill; verbatim frames bound it when STREAMINFO does not
+    if(max_framesize == 0) {
+        max_framesize = pInstance->max_blocksize * pInstance->channels * ((pInstance->bits_per_sample + 8) / 8) +
+                        FLAC_FRAME_HEADER_MAX + 2;
+    }
+    flac_free(pInstance);
+    pInstance->data_buf_size = max_framesize * 2;
+    pInstance->data_buf = static_cast<uint8_t*>(malloc(pInstance->data_buf_size));
+    // The decoded block is hit on every sample: keep it in internal RAM when possible
+    size_t block_bytes = sizeof(int32_t) * pInstance->channels * pInstance->max_blocksize;
+    pInstance->block = static_cast<int32_t*>(heap_caps_malloc(block_bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    if(!pInstance->block) {
+        pInstance->block = static_cast<int32_t*>(heap_caps_malloc(block_bytes, MALLOC_CAP_8BIT));
+    }
+    if(!pInstance->data_buf || !pInstance->block) {
+        ESP_LOGE(TAG, "no memory for %d byte frames", (int)max_framesize);
+        flac_free(pInstance);
+        return false;
+    }
+
+    pInstance->bytes_in_data_buf = 0;
+    pInstance->read_ptr = pInstance->data_buf;
+    pInstance->eof_reached = false;
+    pInstance->block_frames = 0;
+    pInstance->block_pos = 0;
+
+    LOGI_2("sample_rate=%d, channels=%d, bps=%d, max_blocksize=%d",
+            (int)pInstance->sample_rate, (int)pInstance->channels,
+            (int)pInstance->bits_per_sample, (int)pInstance->max_blocksize);
+    return true;
+}
+
+static void refill(FILE *fp, flac_instance *pInstance)
+{
+    size_t unread = pInstance->bytes_in_data_buf - (pInstance->read_ptr - pInstance->data_buf);
+    if(pInstance->eof_reached || unread >= pInstance->data_buf_size / 2) {
+        return;
+    }
+    memmove(pInstance->data_buf, pInstance->read_ptr, unread);
+    size_t n = fread(pInstance->data_buf + unread, 1, pInstance->data_buf_size - unread, fp);
+    pInstance->bytes_in_data_buf = unread + n;
+    pInstance->read_ptr = pInstance->data_buf;
+    if(n == 0 || feof(fp)) {
+        pInstance->eof_reached = true;
+    }
+}
+
+/** Interleave up to the output capacity from the decoded block, as 16-bit */
+static void IRAM_ATTR output_block(decode_data *pData, flac_instance *pInstance)
+{
+    uint32_t channels = pInstance->channels;
+    uint32_t capacity = pData->samples_capacity / (sizeof(int16_t) * channels);
+    uint32_t frames = pInstance->block_frames - pInstance->block_pos;
+    if(frames > capacity) {
+        frames = capacity;
+    }
+    int shift = (int)pInstance->block_bits - 16;
+    int16_t *out = reinterpret_cast<int16_t*>(pData->samples);
+    for(uint32_t c = 0; c < channels; c++) {
+        const int32_t *in = pInstance->block + c * pInstance->max_blocksize + pInstance->block_pos;
+        int16_t *o = out + c;
+        if(shift > 0) {
+            for(uint32_t i = 0; i < frames; i++, o += channels) *o = (int16_t)(in[i] >> shift);
+        } else {
+            for(uint32_t i = 0; i < frames; i++, o += channels) *o = (int16_t)(in[i] << -shift);
+        }
+    }
+    pInstance->block_pos += frames;
+
+    pData->fmt.sample_rate = pInstance->sample_rate;
+    pData->fmt.bits_per_sample = 16;
+    pData->fmt.channels = channels;
+    pData->frame_count = frames;
+}
+
+DECODE_STATUS decode_flac(FILE *fp, decode_data *pData, flac_instance *pInstance)
+{
+    if(pInstance->block_pos < pInstance->block_frames) {
+        output_block(pData, pInstance);
+        return DECODE_STATUS_CONTINUE;
+    }
+
+    refill(fp, pInstance);
+    size_t unread = pInstance->bytes_in_data_buf - (pInstance->read_ptr - pInstance->data_buf);
+    if(unread == 0) {
+        return DECODE_STATUS_DONE;
+    }
+
+    size_t used = decode_frame(pInstance, pInstance->read_ptr, unread);
+    if(used == 0) {
+        // Lost sync: skip ahead to the next candidate sync code
+        size_t skip = 1;
+        while(skip + 1 < unread &&
+              !(pInstance->read_ptr[skip] == 0xFF && (pInstance->read_ptr[skip + 1] & 0xFE) == 0xF8)) {
+            skip++;
+        }
+        if(skip + 1 >= unread) {
+            skip = unread;
+        }
+        ESP_LOGW(TAG, "frame decode failed, skipping %d bytes", (int)skip);
+        pInstance->read_ptr += skip;
+        pData->frame_count = 0;
+        return DECODE_STATUS_NO_DATA_CONTINUE;
+    }
+    pInstance->read_ptr += used;
+
+    output_block(pData, pInstance);
+    return DECODE_STATUS_CONTINUE;
+}
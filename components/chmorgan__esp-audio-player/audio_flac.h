@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdio.h>
+#include "audio_log.h"
+#include "audio_decode_types.h"
+
+/**
+ * Native FLAC decoder (fixed and LPC subframes, Rice residuals, all stereo
+ * decorrelation modes). Output is 16-bit: deeper streams are shifted down.
+ *
+ * A FLAC block (commonly 4096 frames) is larger than decode_data::samples,
+ * so each block is decoded into per-channel int32 buffers and handed out
+ * over several decode_flac() calls.
+ */
+typedef struct {
+    // From STREAMINFO
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint32_t bits_per_sample;
+    uint32_t max_blocksize;
+
+    uint8_t *data_buf;          /*< encoded input, holds at least one whole frame */
+    size_t data_buf_size;
+    size_t bytes_in_data_buf;
+    uint8_t *read_ptr;
+    bool eof_reached;
+
+    int32_t *block;             /*< channels x max_blocksize decoded samples */
+    uint32_t block_frames;      /*< frames in the current block */
+    uint32_t block_pos;         /*< frames of it already output */
+    uint32_t block_bits;        /*< sample size of the current block */
+} flac_instance;
+
+/** @return true if fp starts with the FLAC signature; no allocation, fp is rewound */
+bool flac_probe(FILE *fp);
+
+/**
+ * Parses STREAMINFO, allocates buffers and leaves fp at the first frame.
+ * @return true if the file is FLAC and the decoder is ready
+ */
+bool is_flac(FILE *fp, flac_instance *pInstance);
+DECODE_STATUS decode_flac(FILE *fp, decode_data *pData, flac_instance *pInstance);
+void flac_free(flac_instance *pInstance);
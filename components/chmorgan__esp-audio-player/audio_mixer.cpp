@@ -0,0 +1,204 @@
+#include <math.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "dsps_add.h"
+#include "dsps_mulc.h"
+#include "audio_log.h"
+#include "audio_mixer.h"
+
+static const char *TAG = "mixer";
+
+#define MIXER_REQUEST_QUEUE_LENGTH  4
+#define MIXER_CHUNK_BYTES           (AUDIO_MIXER_CHUNK_FRAMES * 2 * sizeof(int16_t))
+#define MIXER_DEFAULT_DUCK          0.25f   /*< -12 dB */
+
+int16_t audio_mixer_gain_q15(float gain)
+{
+    if(gain <= 0.0f) {
+        return 0;
+    }
+    return (gain >= 1.0f) ? INT16_MAX : (int16_t)lrintf(gain * INT16_MAX);
+}
+
+bool audio_mixer_init(audio_mixer *m)
+{
+    memset(m, 0, sizeof(*m));
+    m->duck_q15 = audio_mixer_gain_q15(MIXER_DEFAULT_DUCK);
+    m->music_q15 = INT16_MAX;
+    m->requests = xQueueCreate(MIXER_REQUEST_QUEUE_LENGTH, sizeof(audio_mixer_voice));
+    // 16-byte aligned for the SIMD adds; the bus goes to write_fn, so DMA-capable too
+    m->bus = static_cast<int16_t*>(heap_caps_aligned_alloc(16, MIXER_CHUNK_BYTES, MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA));
+    m->scratch = static_cast<int16_t*>(heap_caps_aligned_alloc(16, MIXER_CHUNK_BYTES, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    if(!m->requests || !m->bus || !m->scratch) {
+        audio_mixer_free(m);
+        return false;
+    }
+    return true;
+}
+
+void audio_mixer_free(audio_mixer *m)
+{
+    if(m->requests) vQueueDelete(m->requests);
+    heap_caps_free(m->bus);
+    heap_caps_free(m->scratch);
+    memset(m, 0, sizeof(*m));
+}
+
+bool audio_mixer_start(audio_mixer *m, const audio_player_clip_t *clip, float gain, bool duck)
+{
+    audio_mixer_voice voice;
+    voice.clip = *clip;
+    voice.pos = 0;
+    voice.gain = audio_mixer_gain_q15(gain);
+    voice.duck = duck;
+    return xQueueSend(m->requests, &voice, 0) == pdPASS;
+}
+
+void audio_mixer_set_duck(audio_mixer *m, float gain)
+{
+    m->duck_q15 = audio_mixer_gain_q15(gain);
+}
+
+bool audio_mixer_busy(audio_mixer *m)
+{
+    return m->active > 0 || m->music_q15 != INT16_MAX || uxQueueMessagesWaiting(m->requests) > 0;
+}
+
+// The ae32 kernel reads sample pairs as words: an aligned, even run goes to it, the rest is done here
+static void scale(const int16_t *in, int16_t *out, size_t count, int16_t gain, int step_out)
+{
+    size_t n = 0;
+    if(((uintptr_t)in & 3) == 0) {
+        n = count & ~(size_t)1;
+        if(n) {
+            dsps_mulc_s16(in, out, n, gain, 1, step_out);
+        }
+    }
+    for(; n < count; n++) {
+        out[n * step_out] = (int16_t)(((int32_t)in[n] * gain) >> 15);
+    }
+}
+
+// bus += voice, saturating
+static void mix(int16_t *bus, const int16_t *voice, size_t count)
+{
+    size_t n = 0;
+#if (dsps_add_s16_aes3_enabled == 1)
+    // Only the S3 kernel saturates, and only on its aligned, 8-sample path
+    if((((uintptr_t)bus | (uintptr_t)voice) & 15) == 0) {
+        n = count & ~(size_t)7;
+        if(n) {
+            dsps_add_s16(bus, voice, bus, n, 1, 1, 1, 0);
+        }
+    }
+#endif
+    for(; n < count; n++) {
+        int32_t sum = (int32_t)bus[n] + voice[n];
+        bus[n] = (int16_t)(sum > INT16_MAX ? INT16_MAX : sum < INT16_MIN ? INT16_MIN : sum);
+    }
+}
+
+static void take_requests(audio_mixer *m)
+{
+    audio_mixer_voice voice;
+    while(xQueueReceive(m->requests, &voice, 0) == pdPASS) {
+        if(voice.clip.frames == 0 || !voice.clip.samples ||
+                voice.clip.channels < 1 || voice.clip.channels > 2) {
+            ESP_LOGE(TAG, "bad clip: %d frames, %d channels", (int)voice.clip.frames, (int)voice.clip.channels);
+            continue;
+        }
+        if(m->active == AUDIO_MIXER_VOICES) {
+            // All voices busy: the oldest gives way
+            memmove(&m->voices[0], &m->voices[1], (AUDIO_MIXER_VOICES - 1) * sizeof(audio_mixer_voice));
+            m->active--;
+            LOGI_2("voice stolen");
+        }
+        m->voices[m->active++] = voice;
+    }
+}
+
+static void duck_music(audio_mixer *m, int16_t *samples, size_t frames)
+{
+    int32_t target = m->duck_held ? m->duck_q15 : INT16_MAX;
+    for(size_t v = 0; v < m->active && target == INT16_MAX; v++) {
+        if(m->voices[v].duck) {
+            target = m->duck_q15;
+            break;
+        }
+    }
+
+    size_t n = 0;
+    for(; n < frames && m->music_q15 != target; n++) {
+        int32_t diff = target - m->music_q15;
+        m->music_q15 += diff > AUDIO_MIXER_DUCK_STEP ? AUDIO_MIXER_DUCK_STEP :
+                        diff < -AUDIO_MIXER_DUCK_STEP ? -AUDIO_MIXER_DUCK_STEP : diff;
+        samples[2 * n] = (int16_t)(((int32_t)samples[2 * n] * m->music_q15) >> 15);
+        samples[2 * n + 1] = (int16_t)(((int32_t)samples[2 * n + 1] * m->music_q15) >> 15);
+    }
+    if(n < frames && m->music_q15 < INT16_MAX) {
+        scale(samples + 2 * n, samples + 2 * n, (frames - n) * 2, (int16_t)m->music_q15, 1);
+    }
+}
+
+/** @return false once the clip is used up */
+static bool mix_voice(audio_mixer *m, audio_mixer_voice *v, int16_t *bus, size_t frames)
+{
+    const audio_player_clip_t &clip = v->clip;
+    size_t n = clip.frames - v->pos;
+    if(n > frames) {
+        n = frames;
+    }
+    if(clip.channels == 2) {
+        scale(clip.samples + 2 * v->pos, m->scratch, 2 * n, v->gain, 1);
+    } else {
+        // Mono to both sides
+        const int16_t *in = clip.samples + v->pos;
+        scale(in, m->scratch, n, v->gain, 2);
+        scale(in, m->scratch + 1, n, v->gain, 2);
+    }
+    mix(bus, m->scratch, 2 * n);
+    v->pos += n;
+    return v->pos < clip.frames;
+}
+
+void audio_mixer_process(audio_mixer *m, int16_t *samples, size_t frames)
+{
+    take_requests(m);
+    duck_music(m, samples, frames);
+
+    for(size_t offset = 0; offset < frames && m->active > 0; offset += AUDIO_MIXER_CHUNK_FRAMES) {
+        size_t n = frames - offset;
+        if(n > AUDIO_MIXER_CHUNK_FRAMES) {
+            n = AUDIO_MIXER_CHUNK_FRAMES;
+        }
+        for(size_t v = 0; v < m->active; ) {
+            if(mix_voice(m, &m->voices[v], samples + 2 * offset, n)) {
+                v++;
+            } else {
+                m->active--;
+                memmove(&m->voices[v], &m->voices[v + 1], (m->active - v) * sizeof(audio_mixer_voice));
+            }
+        }
+    }
+}
+
+void audio_mixer_hold_duck(audio_mixer *m, bool hold)
+{
+    m->duck_held = hold;
+}
+
+void audio_mixer_add(audio_mixer *m, int16_t *bus, const int16_t *in, size_t frames, int16_t gain)
+{
+    if(gain == INT16_MAX) {
+        mix(bus, in, 2 * frames);
+        return;
+    }
+    for(size_t offset = 0; offset < frames; offset += AUDIO_MIXER_CHUNK_FRAMES) {
+        size_t n = frames - offset;
+        if(n > AUDIO_MIXER_CHUNK_FRAMES) {
+            n = AUDIO_MIXER_CHUNK_FRAMES;
+        }
+        scale(in + 2 * offset, m->scratch, 2 * n, gain, 1);
+        mix(bus + 2 * offset, m->scratch, 2 * n);
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "audio_player.h"
+
+/**
+ * Mixes short in-memory clips (UI clicks, notifications) onto the output
+ * stream, after decode and resampling and just before write_fn, so a
+ * clip's latency is the I2S DMA depth rather than the decode pipeline.
+ *
+ * Everything is 16-bit stereo at CONFIG_AUDIO_PLAYER_OUTPUT_RATE. Each
+ * voice is scaled by its gain (dsps_mulc_s16) into a scratch chunk and
+ * added onto the bus with dsps_add_s16, which on the S3 is the saturating
+ * ee.vadds.s16 eight samples wide; the bus and scratch are 16-byte aligned
+ * and chunks a multiple of eight samples so the SIMD path is always taken.
+ * While a voice started with duck sounds, or the writer holds the duck for
+ * another player instance, the music is ramped down to the duck gain and
+ * back up after. audio_mixer_add() puts other instances' PCM onto the bus
+ * the same way as the voices.
+ *
+ * audio_mixer_start() and audio_mixer_set_duck() may be called from any
+ * task; everything else runs on the writer task.
+ */
+#define AUDIO_MIXER_VOICES          CONFIG_AUDIO_PLAYER_MIXER_VOICES
+#define AUDIO_MIXER_CHUNK_FRAMES    256     /*< scratch size, and what is written when only clips sound */
+#define AUDIO_MIXER_DUCK_STEP       64      /*< Q15 per frame, ~10 ms for full scale at 48 kHz */
+
+typedef struct {
+    audio_player_clip_t clip;
+    size_t pos;                 /*< frames already mixed */
+    int16_t gain;               /*< Q15 */
+    bool duck;
+} audio_mixer_voice;
+
+typedef struct {
+    QueueHandle_t requests;     /*< audio_mixer_voice, from audio_mixer_start() */
+    audio_mixer_voice voices[AUDIO_MIXER_VOICES];  /*< oldest first */
+    size_t active;
+    volatile int32_t duck_q15;  /*< music gain while a ducking voice sounds */
+    bool duck_held;             /*< duck as if a ducking voice sounded */
+    int32_t music_q15;          /*< present music gain, ramps */
+    int16_t *bus;               /*< AUDIO_MIXER_CHUNK_FRAMES stereo, for clips over silence */
+    int16_t *scratch;           /*< AUDIO_MIXER_CHUNK_FRAMES stereo */
+} audio_mixer;
+
+/** 0.0 - 1.0 to Q15 */
+int16_t audio_mixer_gain_q15(float gain);
+
+bool audio_mixer_init(audio_mixer *m);
+void audio_mixer_free(audio_mixer *m);
+
+/** Any task. @return false if the request queue is full */
+bool audio_mixer_start(audio_mixer *m, const audio_player_clip_t *clip, float gain, bool duck);
+void audio_mixer_set_duck(audio_mixer *m, float gain);
+
+/** @return true while a voice sounds, a request waits or the music is still coming back up */
+bool audio_mixer_busy(audio_mixer *m);
+
+/** Ducks the music in samples (stereo, 16-byte aligned) and mixes the voices onto it */
+void audio_mixer_process(audio_mixer *m, int16_t *samples, size_t frames);
+
+/** Ducks the music from the next audio_mixer_process() on, until released */
+void audio_mixer_hold_duck(audio_mixer *m, bool hold);
+
+/** Adds frames of stereo in at gain (Q15) onto bus, saturating */
+void audio_mixer_add(audio_mixer *m, int16_t *bus, const int16_t *in, size_t frames, int16_t gain);
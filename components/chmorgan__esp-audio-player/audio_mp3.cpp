@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include <string.h>
 #include "audio_log.h"
 #include "audio_mp3.h"
@@ -167,3 +168,280 @@ DECODE_STATUS decode_mp3(HMP3Decoder mp3_decoder, FILE *fp, decode_data *pData,
 
     return DECODE_STATUS_CONTINUE;
 }
+
+static uint32_t read_be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t read_be16(const uint8_t *p) {
+    return ((uint32_t)p[0] << 8) | p[1];
+}
+
+bool mp3_parse_header(const uint8_t *h, mp3_frame_header *pHeader) {
+    if(h[0] != 0xFF || (h[1] & 0xE0) != 0xE0 || ((h[1] >> 1) & 0x03) != 0x01) {
+        return false;   // not a Layer III frame
+    }
+
+    static const uint16_t kbps_mpeg1[16] = { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 };
+    static const uint16_t kbps_mpeg2[16] = { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0 };
+    static const uint16_t rate_mpeg1[4] = { 44100, 48000, 32000, 0 };
+    uint32_t version = (h[1] >> 3) & 0x03;     // 3: MPEG1, 2: MPEG2, 0: MPEG2.5
+    bool mpeg1 = version == 3;
+    uint32_t kbps = (mpeg1 ? kbps_mpeg1 : kbps_mpeg2)[h[2] >> 4];
+    uint32_t sample_rate = rate_mpeg1[(h[2] >> 2) & 0x03] >> (mpeg1 ? 0 : (version == 2 ? 1 : 2));
+    if(version == 1 || kbps == 0 || sample_rate == 0) {
+        return false;   // reserved or free format
+    }
+    bool mono = (h[3] >> 6) == 3;
+
+    pHeader->sample_rate = sample_rate;
+    pHeader->kbps = kbps;
+    pHeader->samples = mpeg1 ? 1152 : 576;
+    pHeader->bytes = (mpeg1 ? 144000 : 72000) * kbps / sample_rate + ((h[2] >> 1) & 0x01);
+    pHeader->side_info = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+    return true;
+}
+
+/**
+ * VBRI (Fraunhofer) keeps a table of byte sizes, one per frames_per_entry
+ * frames; it is turned into the Xing kind of TOC so there is one way to
+ * look it up.
+ */
+static void read_vbri(FILE *fp, long table_offset, uint32_t entries, uint32_t scale, uint32_t entry_bytes,
+                      uint32_t frames_per_entry, mp3_info *pInfo) {
+    if(entries == 0 || entry_bytes == 0 || entry_bytes > 4 || frames_per_entry == 0 ||
+            pInfo->total_frames == 0 || pInfo->audio_bytes == 0) {
+        return;
+    }
+    fseek(fp, table_offset, SEEK_SET);
+    uint64_t offset = 0;        // bytes before the entry about to be read
+    uint32_t entry = 0;
+    for(int percent = 0; percent < 100; percent++) {
+        uint64_t frame = (uint64_t)pInfo->total_frames * percent / 100;
+        while(entry < entries && (uint64_t)(entry + 1) * frames_per_entry <= frame) {
+            uint8_t b[4];
+            if(fread(b, 1, entry_bytes, fp) != entry_bytes) {
+                return;
+            }
+            uint32_t size = 0;
+            for(uint32_t n = 0; n < entry_bytes; n++) {
+                size = (size << 8) | b[n];
+            }
+            offset += (uint64_t)size * scale;
+            entry++;
+        }
+        uint64_t toc = offset * 256 / pInfo->audio_bytes;
+        pInfo->toc[percent] = toc > 255 ? 255 : (uint8_t)toc;
+    }
+    pInfo->has_toc = true;
+}
+
+void mp3_read_info(FILE *fp, mp3_info *pInfo) {
+    memset(pInfo, 0, sizeof(*pInfo));
+
+    // Sources that cannot seek to the end have no size; all that needs it is estimates
+    long file_bytes = -1;
+    if(fseek(fp, 0, SEEK_END) == 0) {
+        file_bytes = ftell(fp);
+    }
+    pInfo->file_bytes = (file_bytes > 0) ? (uint32_t)file_bytes : 0;
+
+    fseek(fp, 0, SEEK_SET);
+    mp3_id3_header_v2_t id3;
+    if(sizeof(id3) == fread(&id3, 1, sizeof(id3), fp) && memcmp("ID3", id3.header, sizeof(id3.header)) == 0) {
+        // Syncsafe size, excluding the 10 byte header (and footer, flag bit 4)
+        const uint8_t *size = reinterpret_cast<const uint8_t *>(id3.size);
+        pInfo->data_offset = sizeof(id3) + (((size[0] & 0x7F) << 21) | ((size[1] & 0x7F) << 14) |
+                                            ((size[2] & 0x7F) << 7) | (size[3] & 0x7F));
+        if(id3.flag & 0x10) {
+            pInfo->data_offset += sizeof(id3);
+        }
+    }
+
+    // Header, side info, "Xing"/"Info", flags, frames, bytes, TOC, quality, LAME tag
+    uint8_t frame[192];
+    fseek(fp, pInfo->data_offset, SEEK_SET);
+    size_t n = fread(frame, 1, sizeof(frame), fp);
+    fseek(fp, 0, SEEK_SET);
+    mp3_frame_header header;
+    if(n < 4 || !mp3_parse_header(frame, &header)) {
+        return;
+    }
+    pInfo->sample_rate = header.sample_rate;
+    pInfo->frame_samples = header.samples;
+    pInfo->kbps = header.kbps;
+    if(pInfo->file_bytes > pInfo->data_offset) {
+        pInfo->audio_bytes = pInfo->file_bytes - pInfo->data_offset;
+    }
+
+    // VBRI sits 32 bytes after the header whatever the mode
+    const uint8_t *vbri = frame + 4 + 32;
+    if(vbri + 26 <= frame + n && memcmp(vbri, "VBRI", 4) == 0) {
+        pInfo->data_offset += header.bytes;
+        pInfo->audio_bytes = read_be32(vbri + 10);
+        pInfo->total_frames = read_be32(vbri + 14);
+        read_vbri(fp, pInfo->data_offset - header.bytes + 4 + 32 + 26, read_be16(vbri + 18), read_be16(vbri + 20),
+                  read_be16(vbri + 22), read_be16(vbri + 24), pInfo);
+        fseek(fp, 0, SEEK_SET);
+        LOGI_1("vbri: frames %d, bytes %d", (int)pInfo->total_frames, (int)pInfo->audio_bytes);
+        return;
+    }
+
+    const uint8_t *tag = frame + 4 + header.side_info;
+    if(tag + 8 > frame + n || (memcmp(tag, "Xing", 4) != 0 && memcmp(tag, "Info", 4) != 0)) {
+        return;
+    }
+
+    // The Info frame decodes to silence; start on the frame after it
+    pInfo->data_offset += header.bytes;
+    if(pInfo->audio_bytes > header.bytes) {
+        pInfo->audio_bytes -= header.bytes;
+    }
+
+    uint32_t flags = read_be32(tag + 4);
+    const uint8_t *p = tag + 8;
+    if(flags & 0x01) {
+        if(p + 4 > frame + n) {
+            return;
+        }
+        pInfo->total_frames = read_be32(p);
+        p += 4;
+    }
+    if(flags & 0x02) {
+        if(p + 4 > frame + n) {
+            return;
+        }
+        pInfo->audio_bytes = read_be32(p);
+        p += 4;
+    }
+    if(flags & 0x04) {
+        if(p + 100 > frame + n) {
+            return;
+        }
+        memcpy(pInfo->toc, p, sizeof(pInfo->toc));
+        pInfo->has_toc = pInfo->total_frames != 0 && pInfo->audio_bytes != 0;
+        p += 100;
+    }
+    if(flags & 0x08) p += 4;        // quality
+
+    // LAME tag: 9 byte version string, then delay/padding 12 bits each at offset 21
+    if(p + 24 > frame + n || (memcmp(p, "LAME", 4) != 0 && memcmp(p, "Lavc", 4) != 0 && memcmp(p, "Lavf", 4) != 0)) {
+        return;
+    }
+    uint32_t delay = ((uint32_t)p[21] << 4) | (p[22] >> 4);
+    uint32_t padding = ((uint32_t)(p[22] & 0x0F) << 8) | p[23];
+    pInfo->skip_frames = delay + MP3_DECODER_DELAY;
+
+    uint64_t total = (uint64_t)pInfo->total_frames * header.samples;
+    if(total > delay + padding) {
+        pInfo->length = total - delay - padding;
+    }
+
+    LOGI_1("gapless: delay %d, padding %d, frames %d", (int)delay, (int)padding, (int)pInfo->total_frames);
+}
+
+long mp3_frame_offset(const mp3_info *pInfo, uint32_t frame) {
+    if(pInfo->has_toc) {
+        // Linear between the TOC entries either side
+        float percent = frame * 100.0f / pInfo->total_frames;
+        if(percent > 99.99f) {
+            percent = 99.99f;
+        }
+        int a = (int)percent;
+        float lo = pInfo->toc[a];
+        float hi = (a < 99) ? pInfo->toc[a + 1] : 256.0f;
+        float at = lo + (hi - lo) * (percent - a);
+        return pInfo->data_offset + (long)(at * (1.0f / 256.0f) * pInfo->audio_bytes);
+    }
+    // Constant bitrate, or the best guess there is without an index
+    return pInfo->data_offset + (long)((uint64_t)frame * pInfo->frame_samples * pInfo->kbps * 125 / pInfo->sample_rate);
+}
+
+long mp3_walk_frames(FILE *fp, long offset, uint32_t frames) {
+    uint8_t h[4];
+    mp3_frame_header header;
+    for(uint32_t n = 0; n < frames; n++) {
+        fseek(fp, offset, SEEK_SET);
+        if(fread(h, 1, sizeof(h), fp) != sizeof(h) || !mp3_parse_header(h, &header)) {
+            break;      // the decoder finds its way from here
+        }
+        offset += header.bytes;
+    }
+    return offset;
+}
+
+#define INDEX_CHUNK_BYTES       4096
+
+bool mp3_build_index(FILE *fp, const mp3_info *pInfo, uint32_t step_frames, audio_player_seek_index_t *pIndex) {
+    memset(pIndex, 0, sizeof(*pIndex));
+    if(pInfo->sample_rate == 0 || step_frames == 0) {
+        return false;
+    }
+    uint8_t *chunk = static_cast<uint8_t*>(malloc(INDEX_CHUNK_BYTES));
+    if(!chunk) {
+        return false;
+    }
+
+    // Sized from the first frame's bitrate, grown if the file is denser than that
+    uint32_t capacity = 64;
+    if(pInfo->audio_bytes && pInfo->kbps) {
+        uint32_t frame_bytes = (uint32_t)pInfo->frame_samples * pInfo->kbps * 125 / pInfo->sample_rate;
+        capacity += pInfo->audio_bytes / (frame_bytes * step_frames + 1);
+    }
+    pIndex->offsets = static_cast<uint32_t*>(malloc(capacity * sizeof(uint32_t)));
+
+    long chunk_start = pInfo->data_offset;
+    size_t chunk_len = 0;
+    long offset = pInfo->data_offset;
+    uint32_t frames = 0;
+    uint32_t resync = 0;        // bytes searched since the last good header
+    bool ok = pIndex->offsets != NULL;
+    while(ok) {
+        if(offset < chunk_start || offset + 4 > chunk_start + (long)chunk_len) {
+            fseek(fp, offset, SEEK_SET);
+            chunk_start = offset;
+            chunk_len = fread(chunk, 1, INDEX_CHUNK_BYTES, fp);
+            if(chunk_len < 4) {
+                break;
+            }
+        }
+        mp3_frame_header header;
+        const uint8_t *h = chunk + (offset - chunk_start);
+        if(!mp3_parse_header(h, &header) || header.sample_rate != pInfo->sample_rate) {
+            // Junk between frames, or the ID3v1/APE tag at the end
+            if(++resync > INDEX_CHUNK_BYTES) {
+                break;
+            }
+            offset++;
+            continue;
+        }
+        resync = 0;
+        if(frames % step_frames == 0) {
+            if(pIndex->count == capacity) {
+                capacity *= 2;
+                uint32_t *grown = static_cast<uint32_t*>(realloc(pIndex->offsets, capacity * sizeof(uint32_t)));
+                if(!grown) {
+                    ok = false;
+                    break;
+                }
+                pIndex->offsets = grown;
+            }
+            pIndex->offsets[pIndex->count++] = (uint32_t)offset;
+        }
+        frames++;
+        offset += header.bytes;
+    }
+    free(chunk);
+    fseek(fp, 0, SEEK_SET);
+
+    if(!ok || frames == 0) {
+        free(pIndex->offsets);
+        memset(pIndex, 0, sizeof(*pIndex));
+        return false;
+    }
+    pIndex->step_frames = step_frames;
+    pIndex->total_frames = frames;
+    pIndex->file_bytes = pInfo->file_bytes;
+    LOGI_1("index: %d frames, %d entries", (int)frames, (int)pIndex->count);
+    return true;
+}
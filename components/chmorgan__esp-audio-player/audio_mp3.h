@@ -2,6 +2,7 @@
 
 #include <stdio.h>
 #include "audio_decode_types.h"
+#include "audio_player.h"
 #include "mp3dec.h"
 
 typedef struct {
@@ -44,5 +45,54 @@ typedef struct {
     bool eof_reached;
 } mp3_instance;
 
+/**
+ * What the start of the file says about it: gapless trimming from the
+ * Xing/Info frame and its LAME extension, and for seeking the frame count
+ * and TOC of a Xing or VBRI tag. Without a LAME tag nothing is trimmed;
+ * without a tag at all only the first frame and the file size are known.
+ */
+typedef struct {
+    long data_offset;           /*< first audio frame, past ID3v2 and the Info frame */
+    uint32_t skip_frames;       /*< encoder delay + decoder delay */
+    uint64_t length;            /*< frames to play after the skip, 0 if unknown */
+
+    uint32_t sample_rate;       /*< of the first frame, 0 if it is not Layer III */
+    uint16_t frame_samples;     /*< 1152 (MPEG1) or 576 */
+    uint32_t kbps;              /*< of the first frame, for a constant bitrate estimate */
+    uint32_t file_bytes;        /*< 0 if the source cannot tell */
+    uint32_t total_frames;      /*< MP3 frames from the tag, 0 if unknown */
+    uint32_t audio_bytes;       /*< from data_offset on, 0 if unknown */
+    bool has_toc;
+    uint8_t toc[100];           /*< offset at each percent of the duration, in 1/256 of audio_bytes */
+} mp3_info;
+
+typedef struct {
+    uint32_t sample_rate;
+    uint32_t kbps;
+    uint16_t samples;           /*< per channel */
+    uint16_t bytes;             /*< including the header */
+    uint8_t side_info;
+} mp3_frame_header;
+
+/** Helix (like every MP3 decoder) outputs this many frames before the first encoded sample */
+#define MP3_DECODER_DELAY       529
+
 bool is_mp3(FILE *fp);
+void mp3_read_info(FILE *fp, mp3_info *pInfo);
 DECODE_STATUS decode_mp3(HMP3Decoder mp3_decoder, FILE *fp, decode_data *pData, mp3_instance *pInstance);
+
+/** @return false unless h is a Layer III header with a bitrate */
+bool mp3_parse_header(const uint8_t *h, mp3_frame_header *pHeader);
+
+/** Where MP3 frame number frame starts, from the TOC or else the first frame's bitrate */
+long mp3_frame_offset(const mp3_info *pInfo, uint32_t frame);
+
+/** Follows frame headers from offset; where the walk ends if one does not parse */
+long mp3_walk_frames(FILE *fp, long offset, uint32_t frames);
+
+/**
+ * Reads every frame header of the file, noting the offset of one frame in
+ * step_frames. Reads the whole file: seconds on an SD card.
+ * @return false if no frames were found or memory ran out
+ */
+bool mp3_build_index(FILE *fp, const mp3_info *pInfo, uint32_t step_frames, audio_player_seek_index_t *pIndex);
@@ -0,0 +1,295 @@
+#include <string.h>
+#include <stdlib.h>
+#include "audio_opus.h"
+#include "esp_opus_dec.h"
+
+static const char *TAG = "opus";
+
+#define OGG_PAGE_HEADER         27
+#define OGG_RESYNC_LIMIT        (64 * 1024)     /*< bytes searched for a capture pattern before giving up */
+#define OPUS_SAMPLE_RATE        48000
+#define OPUS_MAX_PACKET         (8 * 1024)      /*< larger packets are dropped; encoders stay well under */
+#define OPUS_MAX_FRAMES         5760            /*< 120 ms at 48 kHz, the longest packet */
+
+static inline uint16_t le16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void opus_free(opus_instance *pInstance)
+{
+    if(pInstance->decoder) {
+        esp_opus_dec_close(pInstance->decoder);
+    }
+    free(pInstance->packet);
+    free(pInstance->pcm);
+    memset(pInstance, 0, sizeof(*pInstance));
+}
+
+bool opus_probe(FILE *fp)
+{
+    fseek(fp, 0, SEEK_SET);
+
+    // First page: capture pattern, version 0, beginning of stream, and a
+    // first packet starting with the OpusHead magic
+    uint8_t header[OGG_PAGE_HEADER];
+    bool opus = fread(header, 1, sizeof(header), fp) == sizeof(header) &&
+                memcmp(header, "OggS", 4) == 0 && header[4] == 0 && (header[5] & 0x02) &&
+                header[26] > 0 && fseek(fp, header[26], SEEK_CUR) == 0;
+    if(opus) {
+        uint8_t magic[8];
+        opus = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) && memcmp(magic, "OpusHead", 8) == 0;
+    }
+    fseek(fp, 0, SEEK_SET);
+    return opus;
+}
+
+static bool skip_bytes(FILE *fp, size_t n)
+{
+    uint8_t scratch[64];
+    while(n > 0) {
+        size_t chunk = n < sizeof(scratch) ? n : sizeof(scratch);
+        if(fread(scratch, 1, chunk, fp) != chunk) {
+            return false;
+        }
+        n -= chunk;
+    }
+    return true;
+}
+
+/** Reads the next page header and segment table of our logical stream */
+static bool read_page(FILE *fp, opus_instance *pInstance)
+{
+    uint8_t header[OGG_PAGE_HEADER];
+    while(true) {
+        if(fread(header, 1, 4, fp) != 4) {
+            return false;
+        }
+        // Lost sync (a damaged stream or one joined mid-page): slide along to the next capture pattern
+        size_t skipped = 0;
+        while(memcmp(header, "OggS", 4) != 0) {
+            if(++skipped > OGG_RESYNC_LIMIT) {
+                ESP_LOGE(TAG, "no Ogg page found");
+                return false;
+            }
+            memmove(header, header + 1, 3);
+            if(fread(header + 3, 1, 1, fp) != 1) {
+                return false;
+            }
+        }
+        if(fread(header + 4, 1, OGG_PAGE_HEADER - 4, fp) != OGG_PAGE_HEADER - 4) {
+            return false;
+        }
+        uint8_t segments = header[26];
+        if(header[4] != 0 || fread(pInstance->lacing, 1, segments, fp) != segments) {
+            continue;
+        }
+
+        uint8_t type = header[5];
+        uint32_t serial = le32(header + 14);
+        if(type & 0x02) {
+            // Beginning of a logical stream: a chained stream's next track starts over with OpusHead
+            pInstance->serial = serial;
+            pInstance->head_seen = false;
+            pInstance->tags_seen = false;
+            pInstance->packet_len = 0;
+            pInstance->discard = false;
+        } else if(serial != pInstance->serial) {
+            size_t body = 0;
+            for(int n = 0; n < segments; n++) {
+                body += pInstance->lacing[n];
+            }
+            if(!skip_bytes(fp, body)) {
+                return false;
+            }
+            continue;
+        }
+
+        bool continued = type & 0x01;
+        if(continued && pInstance->packet_len == 0) {
+            pInstance->discard = true;          // its first part was on a page we did not see
+        } else if(!continued && pInstance->packet_len > 0) {
+            pInstance->packet_len = 0;          // the page finishing it was lost
+        }
+        pInstance->segments = segments;
+        pInstance->segment = 0;
+        return true;
+    }
+}
+
+/** Reassembles the next whole packet into pInstance->packet */
+static bool next_packet(FILE *fp, opus_instance *pInstance)
+{
+    pInstance->packet_len = 0;
+    while(true) {
+        if(pInstance->segment == pInstance->segments) {
+            if(!read_page(fp, pInstance)) {
+                return false;
+            }
+            continue;
+        }
+        size_t n = pInstance->lacing[pInstance->segment++];
+        if(pInstance->discard || pInstance->packet_len + n > pInstance->packet_size) {
+            pInstance->discard = true;
+            pInstance->packet_len = 0;
+            if(!skip_bytes(fp, n)) {
+                return false;
+            }
+        } else {
+            if(fread(pInstance->packet + pInstance->packet_len, 1, n, fp) != n) {
+                return false;
+            }
+            pInstance->packet_len += n;
+        }
+        if(n < 255) {
+            // A lacing value under 255 ends the packet; empty ones (DTX) carry nothing to decode
+            if(!pInstance->discard && pInstance->packet_len > 0) {
+                return true;
+            }
+            pInstance->discard = false;
+            pInstance->packet_len = 0;
+        }
+    }
+}
+
+/** OpusHead (RFC 7845 section 5.1): (re)opens the decoder for its channel count */
+static bool parse_head(opus_instance *pInstance)
+{
+    const uint8_t *p = pInstance->packet;
+    if(pInstance->packet_len < 19 || memcmp(p, "OpusHead", 8) != 0 || (p[8] & 0xF0) != 0) {
+        return false;
+    }
+    uint32_t channels = p[9];
+    if(channels < 1 || channels > 2 || p[18] > 1) {
+        ESP_LOGE(TAG, "unsupported channel layout (%d channels, family %d)", (int)channels, p[18]);
+        return false;
+    }
+
+    if(!pInstance->decoder || pInstance->channels != channels) {
+        if(pInstance->decoder) {
+            esp_opus_dec_close(pInstance->decoder);
+            pInstance->decoder = NULL;
+        }
+        esp_opus_dec_cfg_t config = ESP_OPUS_DEC_CONFIG_DEFAULT();
+        config.sample_rate = OPUS_SAMPLE_RATE;
+        config.channel = channels;
+        if(esp_opus_dec_open(&config, sizeof(config), &pInstance->decoder) != ESP_AUDIO_ERR_OK) {
+            ESP_LOGE(TAG, "failed to open decoder");
+            pInstance->decoder = NULL;
+            return false;
+        }
+        pInstance->channels = channels;
+    }
+    pInstance->skip_left = le16(p + 10);
+    pInstance->fmt.sample_rate = OPUS_SAMPLE_RATE;
+    pInstance->fmt.channels = channels;
+    pInstance->fmt.bits_per_sample = 16;
+    pInstance->head_seen = true;
+    LOGI_1("%d channels, pre-skip %d", (int)channels, (int)pInstance->skip_left);
+    return true;
+}
+
+bool is_opus(FILE *fp, opus_instance *pInstance)
+{
+    if(!opus_probe(fp)) {
+        return false;
+    }
+
+    opus_free(pInstance);
+    pInstance->packet_size = OPUS_MAX_PACKET;
+    pInstance->packet = static_cast<uint8_t*>(malloc(pInstance->packet_size));
+    pInstance->pcm_size = OPUS_MAX_FRAMES * 2 * sizeof(int16_t);
+    pInstance->pcm = static_cast<uint8_t*>(malloc(pInstance->pcm_size));
+    if(!pInstance->packet || !pInstance->pcm || !next_packet(fp, pInstance) || !parse_head(pInstance)) {
+        opus_free(pInstance);
+        return false;
+    }
+    return true;
+}
+
+static void output_pcm(decode_data *pData, opus_instance *pInstance)
+{
+    size_t frame_bytes = pInstance->fmt.channels * (pInstance->fmt.bits_per_sample / BITS_PER_BYTE);
+    size_t bytes = pInstance->pcm_len - pInstance->pcm_pos;
+    size_t capacity = (pData->samples_capacity / frame_bytes) * frame_bytes;
+    if(bytes > capacity) {
+        bytes = capacity;
+    }
+    memcpy(pData->samples, pInstance->pcm + pInstance->pcm_pos, bytes);
+    pInstance->pcm_pos += bytes;
+    pData->fmt = pInstance->fmt;
+    pData->frame_count = bytes / frame_bytes;
+}
+
+DECODE_STATUS decode_opus(FILE *fp, decode_data *pData, opus_instance *pInstance)
+{
+    if(pInstance->pcm_pos < pInstance->pcm_len) {
+        output_pcm(pData, pInstance);
+        return DECODE_STATUS_CONTINUE;
+    }
+
+    pData->frame_count = 0;
+    if(!next_packet(fp, pInstance)) {
+        return DECODE_STATUS_DONE;
+    }
+    if(!pInstance->head_seen) {
+        // A chained stream's next OpusHead; audio before it has no decoder set up for it
+        if(pInstance->packet_len >= 8 && memcmp(pInstance->packet, "OpusHead", 8) == 0 && !parse_head(pInstance)) {
+            return DECODE_STATUS_ERROR;
+        }
+        return DECODE_STATUS_NO_DATA_CONTINUE;
+    }
+    if(!pInstance->tags_seen) {
+        pInstance->tags_seen = true;
+        if(pInstance->packet_len >= 8 && memcmp(pInstance->packet, "OpusTags", 8) == 0) {
+            return DECODE_STATUS_NO_DATA_CONTINUE;
+        }
+    }
+
+    esp_audio_dec_in_raw_t raw = {};
+    raw.buffer = pInstance->packet;
+    raw.len = pInstance->packet_len;
+    esp_audio_dec_out_frame_t frame = {};
+    esp_audio_dec_info_t info = {};
+
+    esp_audio_err_t err;
+    while(true) {
+        frame.buffer = pInstance->pcm;
+        frame.len = pInstance->pcm_size;
+        err = esp_opus_dec_decode(pInstance->decoder, &raw, &frame, &info);
+        if(err != ESP_AUDIO_ERR_BUFF_NOT_ENOUGH) {
+            break;
+        }
+        uint8_t *pcm = static_cast<uint8_t*>(realloc(pInstance->pcm, frame.needed_size));
+        if(!pcm) {
+            ESP_LOGE(TAG, "no memory for %d byte packets", (int)frame.needed_size);
+            return DECODE_STATUS_ERROR;
+        }
+        pInstance->pcm = pcm;
+        pInstance->pcm_size = frame.needed_size;
+    }
+    if(err != ESP_AUDIO_ERR_OK || frame.decoded_size == 0) {
+        if(err != ESP_AUDIO_ERR_OK) {
+            LOGI_1("decode error %d", err);
+        }
+        return DECODE_STATUS_NO_DATA_CONTINUE;
+    }
+
+    // Drop the pre-skip: decoder warm-up the encoder put ahead of the audio
+    size_t frame_bytes = pInstance->fmt.channels * (pInstance->fmt.bits_per_sample / BITS_PER_BYTE);
+    size_t frames = frame.decoded_size / frame_bytes;
+    size_t drop = frames < pInstance->skip_left ? frames : pInstance->skip_left;
+    pInstance->skip_left -= drop;
+    pInstance->pcm_len = frames * frame_bytes;
+    pInstance->pcm_pos = drop * frame_bytes;
+    if(pInstance->pcm_pos == pInstance->pcm_len) {
+        return DECODE_STATUS_NO_DATA_CONTINUE;
+    }
+    output_pcm(pData, pInstance);
+    return DECODE_STATUS_CONTINUE;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdio.h>
+#include "audio_log.h"
+#include "audio_decode_types.h"
+
+/**
+ * Opus in an Ogg container (RFC 7845: .opus files, Icecast Opus streams),
+ * decoded at 48 kHz with the Opus decoder of espressif/esp_audio_codec.
+ *
+ * Pages are read straight from fp and their packets reassembled across
+ * page boundaries; a new OpusHead (a chained stream, e.g. the next track
+ * of a radio station) restarts the decoder. The pre-skip is dropped here.
+ * Mono and stereo (mapping families 0 and 1 with up to two channels) only;
+ * the output gain field is ignored. A decoded packet (up to 120 ms) is
+ * larger than decode_data::samples, so it is buffered here and handed out
+ * over several decode_opus() calls.
+ */
+typedef struct {
+    void *decoder;
+    uint32_t channels;          /*< of the open decoder */
+
+    // Ogg framing
+    uint32_t serial;            /*< logical stream being decoded */
+    uint8_t lacing[255];        /*< segment table of the current page */
+    uint8_t segments;
+    uint8_t segment;            /*< next entry of lacing */
+    bool discard;               /*< rest of a packet whose start was lost */
+
+    uint8_t *packet;            /*< packet being reassembled */
+    size_t packet_size;
+    size_t packet_len;
+    bool head_seen;             /*< OpusHead parsed for this logical stream */
+    bool tags_seen;
+
+    uint8_t *pcm;               /*< last decoded packet, interleaved 16-bit */
+    size_t pcm_size;
+    size_t pcm_len;
+    size_t pcm_pos;
+    uint32_t skip_left;         /*< pre-skip frames still to drop */
+    format fmt;
+} opus_instance;
+
+/** @return true if fp starts with an Ogg page carrying OpusHead; no allocation, fp is rewound */
+bool opus_probe(FILE *fp);
+/** @return true if fp is Ogg Opus; allocates buffers, fp is left at the first page */
+bool is_opus(FILE *fp, opus_instance *pInstance);
+DECODE_STATUS decode_opus(FILE *fp, decode_data *pData, opus_instance *pInstance);
+void opus_free(opus_instance *pInstance);
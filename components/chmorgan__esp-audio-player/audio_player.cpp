@@ -31,13 +31,38 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
 
 #include "sdkconfig.h"
 
 #include "audio_player.h"
+#include "audio_convert.h"
+#include "telemetry.h"
+#include "telemetry_hist.h"
+#include "telemetry_trace.h"
 
 #include "audio_wav.h"
 #include "audio_mp3.h"
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
+#include "audio_flac.h"
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+#include "audio_aac.h"
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_OPUS)
+#include "audio_opus.h"
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_RESAMPLE)
+#include "audio_src.h"
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_MIXER)
+#include "audio_mixer.h"
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_SPECTRUM)
+#include "audio_spectrum.h"
+#endif
 
 static const char *TAG = "audio";
 
@@ -46,7 +71,10 @@ typedef enum {
     AUDIO_PLAYER_REQUEST_PAUSE,              /**< pause playback */
     AUDIO_PLAYER_REQUEST_RESUME,             /**< resumed paused playback */
     AUDIO_PLAYER_REQUEST_PLAY,               /**< initiate playing a new file */
+    AUDIO_PLAYER_REQUEST_QUEUE,              /**< play a file after the present one */
     AUDIO_PLAYER_REQUEST_STOP,               /**< stop playback */
+    AUDIO_PLAYER_REQUEST_SEEK,               /**< jump within the present file */
+    AUDIO_PLAYER_REQUEST_SEEK_INDEX,         /**< attach a seek index to a file */
     AUDIO_PLAYER_REQUEST_SHUTDOWN_THREAD,    /**< shutdown audio playback thread */
     AUDIO_PLAYER_REQUEST_MAX
 } audio_player_event_type_t;
@@ -54,8 +82,14 @@ typedef enum {
 typedef struct {
     audio_player_event_type_t type;
 
-    // valid if type == AUDIO_PLAYER_EVENT_TYPE_PLAY
+    // valid if type == AUDIO_PLAYER_EVENT_TYPE_PLAY, AUDIO_PLAYER_REQUEST_QUEUE or AUDIO_PLAYER_REQUEST_SEEK_INDEX
     FILE* fp;
+
+    // valid if type == AUDIO_PLAYER_REQUEST_SEEK
+    uint32_t position_ms;
+
+    // valid if type == AUDIO_PLAYER_REQUEST_SEEK_INDEX; owned by the request until handled
+    audio_player_seek_index_t index;
 } audio_player_event_t;
 
 typedef enum {
@@ -64,10 +98,77 @@ typedef enum {
     FILE_TYPE_MP3,
 #endif
 #if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
-    FILE_TYPE_WAV
+    FILE_TYPE_WAV,
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
+    FILE_TYPE_FLAC,
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+    FILE_TYPE_AAC,
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_OPUS)
+    FILE_TYPE_OPUS,
 #endif
 } FILE_TYPE;
 
+/**
+ * Decoded PCM on its way to I2S. The decode task fills buffers taken from
+ * pcm_free and queues them on pcm_filled; the writer task hands them to
+ * write_fn and returns them. A buffer whose generation is stale (playback
+ * was stopped or replaced after it was decoded) is dropped unplayed.
+ */
+typedef struct {
+    uint8_t *samples;
+    size_t bytes;
+    format fmt;
+    uint32_t generation;
+    uint32_t position_ms;       /*< in the track, at the end of this buffer */
+    uint32_t duration_ms;
+} pcm_buffer_t;
+
+#define PCM_BUFFER_COUNT        CONFIG_AUDIO_PLAYER_PCM_BUFFERS
+#define PCM_SLOT_SHUTDOWN       0xFF    /*< queued on pcm_filled to end the writer task */
+#define PCM_SLOT_NONE           0xFE    /*< decoding into decode_buf, not a PCM buffer */
+#define PCM_SLOT_MIX            0xFD    /*< queued on pcm_filled to wake the writer for a clip */
+
+#if defined(CONFIG_AUDIO_PLAYER_RESAMPLE)
+static const format output_format = { CONFIG_AUDIO_PLAYER_OUTPUT_RATE, 16, 2 };
+#endif
+
+#define SEEK_INDEX_STEP         32      /*< MP3 frames per seek index entry, ~0.8 s */
+#define SEEK_PREROLL_FRAMES     2       /*< decoded before a seek target, for the bit reservoir */
+
+#if defined(CONFIG_AUDIO_PLAYER_MIXER)
+#define MIXER_MUSIC_WAIT_MS     30      /*< while playing, how long clips wait for the next music buffer */
+#define MIXER_STREAMS           (CONFIG_AUDIO_PLAYER_INSTANCES - 1)    /*< instances beyond the main one */
+#endif
+
+/**
+ * A file that is playing or lined up to play next. Probing (type, WAV
+ * header, MP3 gapless and seek info) happens once, when the track is lined
+ * up, and leaves the decoders alone, so the next track is probed while the
+ * present one still decodes.
+ */
+typedef struct {
+    FILE *fp;
+    FILE_TYPE type;
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
+    wav_instance wav;
+    long wav_data_offset;       /*< first sample */
+    uint32_t wav_data_bytes;
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
+    mp3_info mp3;
+    audio_player_seek_index_t index;    /*< from audio_player_set_seek_index(), count 0 if none */
+#endif
+    uint32_t skip_frames;       /*< decoded frames still to drop (encoder + decoder delay) */
+    uint64_t frames_left;       /*< decoded frames still to play, UINT64_MAX if unknown */
+    uint64_t position;          /*< frames played so far, after the trim */
+    uint32_t duration_ms;       /*< 0 if unknown */
+} track_t;
+
+#define TRACK_QUEUE_LENGTH      4       /*< files waiting behind the lined-up one */
+
 typedef struct audio_instance {
     /**
      * Set to true before task is created, false immediately before the
@@ -79,6 +180,54 @@ typedef struct audio_instance {
 
     QueueHandle_t event_queue;
 
+    QueueHandle_t track_queue;          /*< FILE*s from audio_player_queue(), in order */
+    track_t next;                       /*< probed head of track_queue; fp is NULL if none */
+
+    pcm_buffer_t pcm[PCM_BUFFER_COUNT];
+    QueueHandle_t pcm_free;             /*< uint8_t slot indices */
+    QueueHandle_t pcm_filled;
+    volatile uint32_t pcm_generation;
+
+    /* Buffers beyond pcm_depth, held back by the writer task until the
+     * depth goes up again; the others circulate */
+    uint8_t pcm_parked[PCM_BUFFER_COUNT];
+    volatile uint8_t pcm_parked_count;
+    volatile uint8_t pcm_depth;
+
+    portMUX_TYPE stats_lock;
+    audio_player_decode_stats_t stats;  /*< since audio_player_take_decode_stats() */
+
+    volatile uint32_t position_ms;      /*< of the last buffer written, for audio_player_get_position() */
+    volatile uint32_t duration_ms;
+
+#if defined(CONFIG_AUDIO_PLAYER_RESAMPLE)
+    /* Everything leaves at CONFIG_AUDIO_PLAYER_OUTPUT_RATE: the decoder
+     * writes to decode_buf and the converter fills the PCM buffers */
+    uint8_t *decode_buf;
+    audio_src src;
+#endif
+
+#if defined(CONFIG_AUDIO_PLAYER_MIXER)
+    audio_mixer mixer;                  /*< clips, mixed in by the writer task */
+
+    /* The main instance's writer also mixes in the instances from
+     * audio_player_instance_new(), which have no writer of their own */
+    SemaphoreHandle_t streams_lock;
+    struct audio_instance *streams[MIXER_STREAMS];
+
+    /* Such an instance: which writer takes its PCM, at what gain, and the
+     * buffer that writer is part way through */
+    struct audio_instance *sink;        /*< NULL for the main instance */
+    int16_t gain_q15;
+    bool duck;
+    uint8_t mix_slot;                   /*< PCM_SLOT_NONE if none */
+    size_t mix_pos;                     /*< frames of it already mixed */
+#endif
+
+#if defined(CONFIG_AUDIO_PLAYER_SPECTRUM)
+    audio_spectrum spectrum;            /*< fed by the writer task, before the clips go in */
+#endif
+
     /* **************** AUDIO CALLBACK **************** */
     audio_player_cb_t s_audio_cb;
     void *audio_cb_usrt_ctx;
@@ -94,16 +243,41 @@ typedef struct audio_instance {
     HMP3Decoder mp3_decoder;
     mp3_instance mp3_data;
 #endif
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
+    flac_instance flac_data;
+#endif
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+    aac_instance aac_data;
+#endif
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_OPUS)
+    opus_instance opus_data;
+#endif
 } audio_instance_t;
 
+/** The one audio_player_new() sets up, driven by the calls without a handle; it owns the writer */
 static audio_instance_t instance;
 
+audio_player_handle_t audio_player_get_handle(void)
+{
+    return instance.running ? &instance : NULL;
+}
+
+audio_player_state_t audio_player_instance_get_state(audio_player_handle_t handle)
+{
+    return handle ? handle->state : AUDIO_PLAYER_STATE_SHUTDOWN;
+}
+
 audio_player_state_t audio_player_get_state() {
-    return instance.state;
+    return audio_player_instance_get_state(&instance);
 }
 
-esp_err_t audio_player_callback_register(audio_player_cb_t call_back, void *user_ctx)
+esp_err_t audio_player_instance_callback_register(audio_player_handle_t handle, audio_player_cb_t call_back,
+                                                  void *user_ctx)
 {
+    ESP_RETURN_ON_FALSE(NULL != handle, ESP_ERR_INVALID_ARG, TAG, "handle");
 #if CONFIG_IDF_TARGET_ARCH_XTENSA
     ESP_RETURN_ON_FALSE(esp_ptr_executable(reinterpret_cast<void*>(call_back)), ESP_ERR_INVALID_ARG,
         TAG, "Not a valid call back");
@@ -111,12 +285,17 @@ esp_err_t audio_player_callback_register(audio_player_cb_t call_back, void *user
     ESP_RETURN_ON_FALSE(reinterpret_cast<void*>(call_back), ESP_ERR_INVALID_ARG,
         TAG, "Not a valid call back");
 #endif
-    instance.s_audio_cb = call_back;
-    instance.audio_cb_usrt_ctx = user_ctx;
+    handle->s_audio_cb = call_back;
+    handle->audio_cb_usrt_ctx = user_ctx;
 
     return ESP_OK;
 }
 
+esp_err_t audio_player_callback_register(audio_player_cb_t call_back, void *user_ctx)
+{
+    return audio_player_instance_callback_register(&instance, call_back, user_ctx);
+}
+
 // This function is used in some optional logging functions so we don't want to
 // have a cppcheck warning here
 // cppcheck-suppress unusedFunction
@@ -186,96 +365,759 @@ static void set_state(audio_instance_t *i, audio_player_state_t new_state) {
     }
 }
 
+static bool audio_has_sink(const audio_instance_t *i)
+{
+#if defined(CONFIG_AUDIO_PLAYER_MIXER)
+    return i->sink != NULL;
+#else
+    (void)i;
+    return false;
+#endif
+}
+
 static void audio_instance_init(audio_instance_t &i) {
     i.event_queue = NULL;
+    i.track_queue = NULL;
+    memset(&i.next, 0, sizeof(i.next));
+    i.pcm_free = NULL;
+    i.pcm_filled = NULL;
+    i.pcm_generation = 0;
+    memset(i.pcm, 0, sizeof(i.pcm));
+    i.pcm_parked_count = 0;
+    i.pcm_depth = PCM_BUFFER_COUNT;
+    portMUX_INITIALIZE(&i.stats_lock);
+    memset(&i.stats, 0, sizeof(i.stats));
+    i.position_ms = 0;
+    i.duration_ms = 0;
+#if defined(CONFIG_AUDIO_PLAYER_RESAMPLE)
+    i.decode_buf = NULL;
+    memset(&i.src, 0, sizeof(i.src));
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_MIXER)
+    memset(&i.mixer, 0, sizeof(i.mixer));
+    i.streams_lock = NULL;
+    memset(i.streams, 0, sizeof(i.streams));
+    i.sink = NULL;
+    i.gain_q15 = INT16_MAX;
+    i.duck = false;
+    i.mix_slot = PCM_SLOT_NONE;
+    i.mix_pos = 0;
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_SPECTRUM)
+    memset(&i.spectrum, 0, sizeof(i.spectrum));
+#endif
     i.s_audio_cb = NULL;
     i.audio_cb_usrt_ctx = NULL;
     i.state = AUDIO_PLAYER_STATE_IDLE;
 }
 
-static esp_err_t mono_to_stereo(uint32_t output_bits_per_sample, decode_data &adata)
+/**
+ * Wait until the writer has returned every PCM buffer, so the caller's
+ * following state change or mute lines up with the end of the audio.
+ * With flush the queued buffers are invalidated first and skipped.
+ */
+static void pcm_drain(audio_instance_t *i, bool flush)
 {
-    size_t data = adata.frame_count * (output_bits_per_sample / BITS_PER_BYTE);
-    data *= 2;
+    if(flush) {
+        i->pcm_generation++;
+    }
+    while(uxQueueMessagesWaiting(i->pcm_free) + i->pcm_parked_count < PCM_BUFFER_COUNT) {
+        vTaskDelay(1);
+    }
+}
 
-    // do we have enough space in the output buffer to convert mono to stereo?
-    if(data > adata.samples_capacity_max) {
-        ESP_LOGE(TAG, "insufficient space in output.samples to convert mono to stereo, need %d, have %d", data, adata.samples_capacity_max);
-        return ESP_ERR_NO_MEM;
+/**
+ * A buffer the writer is done with: back to pcm_free, or parked while more
+ * than pcm_depth are in use. Parked ones go back once the depth is raised.
+ * Only the writer task parks, so only it changes pcm_parked_count.
+ */
+static void pcm_recycle(audio_instance_t *i, uint8_t slot)
+{
+    uint8_t depth = i->pcm_depth;
+    if(PCM_BUFFER_COUNT - i->pcm_parked_count > depth) {
+        i->pcm_parked[i->pcm_parked_count] = slot;
+        i->pcm_parked_count++;
+        return;
+    }
+    xQueueSend(i->pcm_free, &slot, 0);
+    // Free before it stops counting as parked, so pcm_drain() never comes up short
+    while(i->pcm_parked_count > 0 && PCM_BUFFER_COUNT - i->pcm_parked_count < depth) {
+        xQueueSend(i->pcm_free, &i->pcm_parked[i->pcm_parked_count - 1], 0);
+        i->pcm_parked_count--;
+    }
+}
+
+/**
+ * Configure I2S clock if the output format changed; done on the writer
+ * task so it takes effect between the buffers of the old and new format
+ */
+static void writer_set_format(audio_instance_t *i, format *i2s_format, const format &fmt)
+{
+    if ((i2s_format->sample_rate == fmt.sample_rate) &&
+            (i2s_format->channels == fmt.channels) &&
+            (i2s_format->bits_per_sample == fmt.bits_per_sample)) {
+        return;
+    }
+    *i2s_format = fmt;
+    LOGI_1("format change: sr=%d, bit=%d, ch=%d",
+            i2s_format->sample_rate,
+            i2s_format->bits_per_sample,
+            i2s_format->channels);
+    i2s_slot_mode_t channel_setting = (i2s_format->channels == 1) ? I2S_SLOT_MODE_MONO : I2S_SLOT_MODE_STEREO;
+    esp_err_t ret = i->config.clk_set_fn(i2s_format->sample_rate,
+                i2s_format->bits_per_sample,
+                channel_setting);
+    if(ret != ESP_OK) {
+        ESP_LOGE(TAG, "i2s_set_clk %d", ret);
+        memset(i2s_format, 0, sizeof(*i2s_format));    // retry on the next buffer
+    }
+}
+
+static void writer_write(audio_instance_t *i, void *samples, size_t bytes)
+{
+    // Blocks while the I2S DMA descriptors are full; meanwhile the
+    // decode task keeps filling the other buffers
+    size_t i2s_bytes_written = 0;
+    i->config.write_fn(samples, bytes, &i2s_bytes_written, portMAX_DELAY);
+    if(bytes != i2s_bytes_written) {
+        ESP_LOGE(TAG, "to write %d != written %d", bytes, i2s_bytes_written);
+    }
+}
+
+#if defined(CONFIG_AUDIO_PLAYER_MIXER)
+/** Points s->mix_slot at its next PCM buffer that is still to play; under streams_lock */
+static bool stream_take(audio_instance_t *s)
+{
+    uint8_t slot;
+    while(s->mix_slot == PCM_SLOT_NONE && pdPASS == xQueueReceive(s->pcm_filled, &slot, 0)) {
+        if(s->pcm[slot].generation == s->pcm_generation) {
+            s->mix_slot = slot;
+            s->mix_pos = 0;
+        } else {
+            xQueueSend(s->pcm_free, &slot, 0);
+        }
+    }
+    return s->mix_slot != PCM_SLOT_NONE;
+}
+
+static void stream_release(audio_instance_t *s)
+{
+    xQueueSend(s->pcm_free, &s->mix_slot, 0);
+    s->mix_slot = PCM_SLOT_NONE;
+}
+
+/**
+ * Adds what the other instances have decoded onto samples. They decode
+ * ahead into their own PCM buffers and are paced by this: one that has
+ * nothing ready yet is simply not heard in this buffer.
+ */
+static void writer_mix_streams(audio_instance_t *i, int16_t *samples, size_t frames)
+{
+    xSemaphoreTake(i->streams_lock, portMAX_DELAY);
+    for(int n = 0; n < MIXER_STREAMS; n++) {
+        audio_instance_t *s = i->streams[n];
+        size_t done = 0;
+        while(s && done < frames && stream_take(s)) {
+            pcm_buffer_t *pcm = &s->pcm[s->mix_slot];
+            if(pcm->generation != s->pcm_generation) {
+                stream_release(s);          // flushed part way through
+                continue;
+            }
+            size_t count = pcm->bytes / (2 * sizeof(int16_t)) - s->mix_pos;
+            if(count > frames - done) {
+                count = frames - done;
+            }
+            audio_mixer_add(&i->mixer, samples + 2 * done,
+                            reinterpret_cast<const int16_t*>(pcm->samples) + 2 * s->mix_pos, count, s->gain_q15);
+            done += count;
+            s->mix_pos += count;
+            if(s->mix_pos * 2 * sizeof(int16_t) >= pcm->bytes) {
+                s->position_ms = pcm->position_ms;
+                s->duration_ms = pcm->duration_ms;
+                stream_release(s);
+            }
+        }
+    }
+    xSemaphoreGive(i->streams_lock);
+}
+
+/** @return true while another instance plays or has PCM waiting; with duck, only ducking ones playing */
+static bool writer_streams_active(audio_instance_t *i, bool duck)
+{
+    bool active = false;
+    xSemaphoreTake(i->streams_lock, portMAX_DELAY);
+    for(int n = 0; n < MIXER_STREAMS && !active; n++) {
+        audio_instance_t *s = i->streams[n];
+        if(!s) {
+            continue;
+        }
+        if(duck) {
+            active = s->duck && s->state == AUDIO_PLAYER_STATE_PLAYING;
+        } else {
+            active = s->state == AUDIO_PLAYER_STATE_PLAYING || s->mix_slot != PCM_SLOT_NONE ||
+                     uxQueueMessagesWaiting(s->pcm_filled) > 0;
+        }
+    }
+    xSemaphoreGive(i->streams_lock);
+    return active;
+}
+
+/** The clips and the other instances onto samples, the music in it ducked for either */
+static void writer_mix(audio_instance_t *i, int16_t *samples, size_t frames)
+{
+    audio_mixer_hold_duck(&i->mixer, writer_streams_active(i, true));
+    audio_mixer_process(&i->mixer, samples, frames);
+    writer_mix_streams(i, samples, frames);
+}
+
+/** No music coming: one chunk of the clips and other instances over silence */
+static void writer_write_clips(audio_instance_t *i, format *i2s_format)
+{
+    writer_set_format(i, i2s_format, output_format);
+    memset(i->mixer.bus, 0, AUDIO_MIXER_CHUNK_FRAMES * 2 * sizeof(int16_t));
+    writer_mix(i, i->mixer.bus, AUDIO_MIXER_CHUNK_FRAMES);
+    writer_write(i, i->mixer.bus, AUDIO_MIXER_CHUNK_FRAMES * 2 * sizeof(int16_t));
+}
+#endif
+
+static void audio_writer_task(void *pvParam)
+{
+    audio_instance_t *i = static_cast<audio_instance_t*>(pvParam);
+    format i2s_format;
+    memset(&i2s_format, 0, sizeof(i2s_format));
+    uint8_t slot;
+
+    while(true) {
+#if defined(CONFIG_AUDIO_PLAYER_MIXER)
+        /* With clips or other instances sounding, wait for music only as
+         * long as it is due, so they keep going over a pause or stop without it */
+        TickType_t wait = portMAX_DELAY;
+        if(audio_mixer_busy(&i->mixer) || writer_streams_active(i, false)) {
+            wait = (i->state == AUDIO_PLAYER_STATE_PLAYING) ? pdMS_TO_TICKS(MIXER_MUSIC_WAIT_MS) : 0;
+        }
+        if(xQueueReceive(i->pcm_filled, &slot, wait) != pdPASS) {
+            writer_write_clips(i, &i2s_format);
+            continue;
+        }
+        if(slot == PCM_SLOT_MIX) {
+            continue;
+        }
+#else
+        xQueueReceive(i->pcm_filled, &slot, portMAX_DELAY);
+#endif
+        if(slot == PCM_SLOT_SHUTDOWN) {
+            break;
+        }
+
+        pcm_buffer_t *pcm = &i->pcm[slot];
+        if(pcm->generation == i->pcm_generation) {
+            writer_set_format(i, &i2s_format, pcm->fmt);
+#if defined(CONFIG_AUDIO_PLAYER_SPECTRUM)
+            audio_spectrum_feed(&i->spectrum, reinterpret_cast<const int16_t*>(pcm->samples),
+                                pcm->bytes / (pcm->fmt.channels * sizeof(int16_t)), &pcm->fmt);
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_MIXER)
+            writer_mix(i, reinterpret_cast<int16_t*>(pcm->samples), pcm->bytes / (2 * sizeof(int16_t)));
+#endif
+            writer_write(i, pcm->samples, pcm->bytes);
+            // Unless a seek flushed it meanwhile, this is what is playing now
+            if(pcm->generation == i->pcm_generation) {
+                i->position_ms = pcm->position_ms;
+                i->duration_ms = pcm->duration_ms;
+            }
+        }
+        pcm_recycle(i, slot);
+    }
+    vTaskDelete(NULL);
+}
+
+/**
+ * Best known length of the track: the gapless length, the frame count of
+ * the Xing/VBRI tag or seek index, or the size over the first bitrate.
+ */
+static void set_duration(track_t *t)
+{
+    t->duration_ms = 0;
+    switch(t->type) {
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
+        case FILE_TYPE_MP3: {
+            const mp3_info &m = t->mp3;
+            uint32_t total = t->index.total_frames ? t->index.total_frames : m.total_frames;
+            uint64_t frames = m.length ? m.length : (uint64_t)total * m.frame_samples;
+            if(frames && m.sample_rate) {
+                t->duration_ms = (uint32_t)(frames * 1000 / m.sample_rate);
+            } else if(m.audio_bytes && m.kbps) {
+                t->duration_ms = (uint32_t)((uint64_t)m.audio_bytes * 8 / m.kbps);
+            }
+            break;
+        }
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
+        case FILE_TYPE_WAV:
+            if(t->wav.header.ByteRate > 0) {
+                t->duration_ms = (uint32_t)((uint64_t)t->wav_data_bytes * 1000 / t->wav.header.ByteRate);
+            }
+            break;
+#endif
+        default:
+            break;
+    }
+}
+
+/**
+ * Works out the type of t->fp and what to trim from it. Touches only the
+ * track, never the decoders.
+ * @return false if the type is unknown
+ */
+static bool probe_track(track_t *t)
+{
+    t->type = FILE_TYPE_UNKNOWN;
+    t->skip_frames = 0;
+    t->frames_left = UINT64_MAX;
+    t->position = 0;
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
+    if(is_mp3(t->fp)) {
+        t->type = FILE_TYPE_MP3;
+        LOGI_1("file is mp3");
+        mp3_read_info(t->fp, &t->mp3);
+        t->skip_frames = t->mp3.skip_frames;
+        if(t->mp3.length) {
+            t->frames_left = t->mp3.length;
+        }
+    }
+#endif
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
+    // This can be a pointless condition depending on the build options, no reason to warn about it
+    // cppcheck-suppress knownConditionTrueFalse
+    if(t->type == FILE_TYPE_UNKNOWN)
+    {
+        if(is_wav(t->fp, &t->wav)) {
+            t->type = FILE_TYPE_WAV;
+            LOGI_1("file is wav");
+            // The rest of the file is taken as samples, as decode_wav() plays it
+            t->wav_data_offset = ftell(t->fp);
+            t->wav_data_bytes = 0;
+            if(fseek(t->fp, 0, SEEK_END) == 0 && ftell(t->fp) > t->wav_data_offset) {
+                t->wav_data_bytes = (uint32_t)(ftell(t->fp) - t->wav_data_offset);
+            }
+            fseek(t->fp, t->wav_data_offset, SEEK_SET);
+        }
+    }
+#endif
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
+    // cppcheck-suppress knownConditionTrueFalse
+    if(t->type == FILE_TYPE_UNKNOWN)
+    {
+        if(flac_probe(t->fp)) {
+            t->type = FILE_TYPE_FLAC;
+            LOGI_1("file is flac");
+        }
+    }
+#endif
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+    // cppcheck-suppress knownConditionTrueFalse
+    if(t->type == FILE_TYPE_UNKNOWN)
+    {
+        if(aac_probe(t->fp)) {
+            t->type = FILE_TYPE_AAC;
+            LOGI_1("file is aac");
+        }
+    }
+#endif
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_OPUS)
+    // cppcheck-suppress knownConditionTrueFalse
+    if(t->type == FILE_TYPE_UNKNOWN)
+    {
+        if(opus_probe(t->fp)) {
+            t->type = FILE_TYPE_OPUS;
+            LOGI_1("file is opus");
+        }
     }
+#endif
+
+    set_duration(t);
+    return t->type != FILE_TYPE_UNKNOWN;
+}
 
-    size_t new_sample_count = adata.frame_count * 2;
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
+/** Fresh decoder and input buffer, reading from offset */
+static bool restart_mp3(audio_instance_t *i, FILE *fp, long offset)
+{
+    if(i->mp3_decoder) MP3FreeDecoder(i->mp3_decoder);
+    i->mp3_decoder = MP3InitDecoder();
+    if(!i->mp3_decoder) {
+        ESP_LOGE(TAG, "Failed create MP3 decoder");
+        return false;
+    }
+    i->mp3_data.bytes_in_data_buf = 0;
+    i->mp3_data.read_ptr = i->mp3_data.data_buf;
+    i->mp3_data.eof_reached = false;
+    fseek(fp, offset, SEEK_SET);
+    return true;
+}
+#endif
 
-    // convert from back to front to allow conversion in-place
-    //
-    // NOTE: -1 is because we want to shift to the sample at position X
-    //       but if we do (ptr + X) we end up at the sample at index X instead
-    //       which is one further
-    int16_t *out = reinterpret_cast<int16_t*>(adata.samples) + (new_sample_count - 1);
-    int16_t *in = reinterpret_cast<int16_t*>(adata.samples) + (adata.frame_count - 1);
-    size_t samples = adata.frame_count;
-    while(samples) {
-        // write right channel
-        *out = *in;
-        out--;
+/**
+ * Points the decoder for t->type at t->fp.
+ * @return false if the decoder could not be set up
+ */
+static bool start_track(audio_instance_t *i, track_t *t)
+{
+    switch(t->type) {
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
+        case FILE_TYPE_MP3:
+            // Fresh synthesis state: the LAME delay assumes the decoder starts from silence
+            return restart_mp3(i, t->fp, t->mp3.data_offset);
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
+        case FILE_TYPE_WAV:
+            // the probe left fp at the start of the samples
+            i->wav_data = t->wav;
+            return true;
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
+        case FILE_TYPE_FLAC:
+            return is_flac(t->fp, &i->flac_data);
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+        case FILE_TYPE_AAC:
+            return is_aac(t->fp, &i->aac_data);
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_OPUS)
+        case FILE_TYPE_OPUS:
+            return is_opus(t->fp, &i->opus_data);
+#endif
+        case FILE_TYPE_UNKNOWN:
+            break;
+    }
+    return false;
+}
 
-        // write left channel
-        *out = *in;
-        out--;
+/** Drops the encoder/decoder delay at the start of a track and the padding at its end */
+static void trim_output(track_t *t, decode_data &adata)
+{
+    if(t->skip_frames) {
+        size_t frame_bytes = adata.fmt.channels * (adata.fmt.bits_per_sample / BITS_PER_BYTE);
+        size_t drop = (adata.frame_count < t->skip_frames) ? adata.frame_count : t->skip_frames;
+        memmove(adata.samples, adata.samples + drop * frame_bytes, (adata.frame_count - drop) * frame_bytes);
+        adata.frame_count -= drop;
+        t->skip_frames -= drop;
+    }
+    if(adata.frame_count > t->frames_left) {
+        adata.frame_count = t->frames_left;
+    }
+    t->frames_left -= adata.frame_count;
+    t->position += adata.frame_count;
+}
 
-        // move input buffer back and decrement samples
-        in--;
-        samples--;
+/**
+ * Moves the present track to position_ms. MP3 restarts the decoder a
+ * couple of frames early, found from the seek index, the TOC or the
+ * bitrate, and drops what comes before the target; WAV lands on the
+ * sample. What was already decoded is flushed so the jump is heard at once.
+ */
+static esp_err_t seek_track(audio_instance_t *i, track_t *t, uint32_t position_ms)
+{
+    uint32_t sample_rate = 0;
+    switch(t->type) {
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
+        case FILE_TYPE_MP3: {
+            const mp3_info &m = t->mp3;
+            if(m.sample_rate == 0) {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            sample_rate = m.sample_rate;
+            uint64_t target = (uint64_t)position_ms * sample_rate / 1000;
+            if(m.length && target > m.length) {
+                target = m.length;
+            }
+            uint64_t decoded = target + m.skip_frames;      // counting the delay at the start
+            uint32_t frame = (uint32_t)(decoded / m.frame_samples);
+            frame = (frame > SEEK_PREROLL_FRAMES) ? frame - SEEK_PREROLL_FRAMES : 0;
+
+            long offset = m.data_offset;
+            if(frame && t->index.count) {
+                uint32_t entry = frame / t->index.step_frames;
+                if(entry >= t->index.count) {
+                    entry = t->index.count - 1;
+                }
+                offset = mp3_walk_frames(t->fp, t->index.offsets[entry], frame - entry * t->index.step_frames);
+            } else if(frame) {
+                offset = mp3_frame_offset(&m, frame);
+            }
+            pcm_drain(i, true);
+            if(!restart_mp3(i, t->fp, offset)) {
+                return ESP_FAIL;
+            }
+            t->skip_frames = (uint32_t)(decoded - (uint64_t)frame * m.frame_samples);
+            t->frames_left = m.length ? m.length - target : UINT64_MAX;
+            t->position = target;
+            LOGI_1("seek %d ms: frame %d at %ld", (int)position_ms, (int)frame, offset);
+            break;
+        }
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
+        case FILE_TYPE_WAV: {
+            const wav_header_t &h = t->wav.header;
+            if(h.SampleRate <= 0 || h.BlockAlign <= 0) {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            sample_rate = h.SampleRate;
+            uint64_t target = (uint64_t)position_ms * sample_rate / 1000;
+            uint64_t frames = t->wav_data_bytes / h.BlockAlign;
+            if(target > frames) {
+                target = frames;
+            }
+            pcm_drain(i, true);
+            fseek(t->fp, t->wav_data_offset + (long)(target * h.BlockAlign), SEEK_SET);
+            t->position = target;
+            break;
+        }
+#endif
+        default:
+            return ESP_ERR_NOT_SUPPORTED;
+    }
+#if defined(CONFIG_AUDIO_PLAYER_RESAMPLE)
+    audio_src_reset(&i->src);
+#endif
+    // Shows at once, even paused; the writer carries on from here
+    i->position_ms = (uint32_t)(t->position * 1000 / sample_rate);
+    return ESP_OK;
+}
+
+static void close_track(track_t *t)
+{
+    fclose(t->fp);
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
+    free(t->index.offsets);
+#endif
+    memset(t, 0, sizeof(*t));
+}
+
+static void enqueue_track(audio_instance_t *i, FILE *fp)
+{
+    if(pdPASS != xQueueSend(i->track_queue, &fp, 0)) {
+        ESP_LOGE(TAG, "play queue full, dropping file");
+        fclose(fp);
+    }
+}
+
+/** Opens up the next queued track for probing if none is lined up yet */
+static void line_up_next(audio_instance_t *i)
+{
+    while(!i->next.fp && pdPASS == xQueueReceive(i->track_queue, &i->next.fp, 0)) {
+        if(!probe_track(&i->next)) {
+            ESP_LOGE(TAG, "queued file of unknown type, skipping");
+            dispatch_callback(i, AUDIO_PLAYER_CALLBACK_EVENT_UNKNOWN_FILE_TYPE);
+            close_track(&i->next);
+        }
+    }
+}
+
+static void clear_queue(audio_instance_t *i)
+{
+    FILE *fp;
+    if(i->next.fp) {
+        close_track(&i->next);
+    }
+    while(pdPASS == xQueueReceive(i->track_queue, &fp, 0)) {
+        fclose(fp);
+    }
+}
+
+/**
+ * Switches to the lined-up track at the end of the present one. The old
+ * track's PCM is still queued to I2S, so the new decoder starts while it
+ * plays out: no drain, no gap at the boundary.
+ * @return false if nothing is lined up; track->fp is still the caller's to close
+ */
+static bool advance_track(audio_instance_t *i, track_t *track)
+{
+    for(line_up_next(i); i->next.fp; line_up_next(i)) {
+        close_track(track);
+        *track = i->next;
+        memset(&i->next, 0, sizeof(i->next));
+        if(start_track(i, track)) {
+            dispatch_callback(i, AUDIO_PLAYER_CALLBACK_EVENT_COMPLETED_PLAYING_NEXT);
+            return true;
+        }
+        ESP_LOGE(TAG, "failed to start queued file");
+    }
+    return false;
+}
+
+/** Decode timing for audio_player_take_decode_stats(); decode task */
+static void record_decode(audio_instance_t *i, uint32_t decode_us, size_t frames, int sample_rate)
+{
+    taskENTER_CRITICAL(&i->stats_lock);
+    i->stats.frames++;
+    i->stats.decode_sum_us += decode_us;
+    if(decode_us > i->stats.decode_max_us) {
+        i->stats.decode_max_us = decode_us;
+    }
+    if(frames > 0) {
+        i->stats.frame_us = (uint32_t)((uint64_t)frames * 1000000 / sample_rate);
+    }
+    taskEXIT_CRITICAL(&i->stats_lock);
+}
+
+static void pcm_release(audio_instance_t *i, uint8_t slot)
+{
+    if(slot != PCM_SLOT_NONE) {
+        xQueueSend(i->pcm_free, &slot, 0);
+    }
+}
+
+static void pcm_publish(audio_instance_t *i, uint8_t slot, const format &fmt, size_t frames, uint32_t position_ms,
+                        uint32_t duration_ms)
+{
+    pcm_buffer_t *pcm = &i->pcm[slot];
+    pcm->fmt = fmt;
+    pcm->bytes = frames * fmt.channels * (fmt.bits_per_sample / BITS_PER_BYTE);
+    pcm->generation = i->pcm_generation;
+    pcm->position_ms = position_ms;
+    pcm->duration_ms = duration_ms;
+    LOGI_2("c %d, bps %d, bytes %d, frame_count %d",
+        fmt.channels,
+        fmt.bits_per_sample,
+        pcm->bytes,
+        frames);
+    xQueueSend(i->pcm_filled, &slot, portMAX_DELAY);
+#if defined(CONFIG_AUDIO_PLAYER_MIXER)
+    // The sink's writer only waits for music of its own; wake it when none is coming
+    if(i->sink && i->sink->state != AUDIO_PLAYER_STATE_PLAYING) {
+        uint8_t wake = PCM_SLOT_MIX;
+        xQueueSend(i->sink->pcm_filled, &wake, 0);
+    }
+#endif
+}
+
+/**
+ * Hands the decoded frames in i->output to the writer: in slot itself, or
+ * resampled into as many free PCM buffers as it takes.
+ */
+static esp_err_t output_pcm(audio_instance_t *i, uint8_t slot, const track_t *track)
+{
+    decode_data &adata = i->output;
+    uint32_t position_ms = (adata.fmt.sample_rate > 0) ? (uint32_t)(track->position * 1000 / adata.fmt.sample_rate) : 0;
+
+#if defined(CONFIG_AUDIO_PLAYER_RESAMPLE)
+    const size_t capacity = adata.samples_capacity_max / (2 * sizeof(int16_t));
+    const int16_t *samples = reinterpret_cast<const int16_t*>(adata.samples);
+    size_t done = 0;
+    while(done < adata.frame_count) {
+        size_t taken = audio_src_push(&i->src, samples + done * adata.fmt.channels, adata.frame_count - done, &adata.fmt);
+        if(taken == 0) {
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        done += taken;
+
+        size_t frames;
+        do {
+            xQueueReceive(i->pcm_free, &slot, portMAX_DELAY);
+            frames = audio_src_pull(&i->src, reinterpret_cast<int16_t*>(i->pcm[slot].samples), capacity);
+            if(frames) {
+                pcm_publish(i, slot, output_format, frames, position_ms, track->duration_ms);
+            } else {
+                pcm_release(i, slot);
+            }
+        } while(frames == capacity);
+    }
+    return ESP_OK;
+#else
+    if(adata.frame_count == 0) {
+        pcm_release(i, slot);
+        return ESP_OK;
     }
 
-    // adjust channels to 2
-    adata.fmt.channels = 2;
+    // Only what the sink cannot take is converted
+    format out = audio_convert_negotiate(adata.fmt, i->config.output_caps);
+    esp_err_t ret = audio_convert(adata, out);
+    if(ret != ESP_OK) {
+        pcm_release(i, slot);
+        return ret;
+    }
 
+    pcm_publish(i, slot, adata.fmt, adata.frame_count, position_ms, track->duration_ms);
     return ESP_OK;
+#endif
 }
 
-static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
-{
-    LOGI_1("start to decode");
-
-    format i2s_format;
-    memset(&i2s_format, 0, sizeof(i2s_format));
-
-    esp_err_t ret = ESP_OK;
-    audio_player_event_t audio_event = { .type = AUDIO_PLAYER_REQUEST_NONE, .fp = NULL };
-
-    FILE_TYPE file_type = FILE_TYPE_UNKNOWN;
-
 #if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
-    if(is_mp3(fp)) {
-        file_type = FILE_TYPE_MP3;
-        LOGI_1("file is mp3");
-
-        // initialize mp3_instance
-        i->mp3_data.bytes_in_data_buf = 0;
-        i->mp3_data.read_ptr = i->mp3_data.data_buf;
-        i->mp3_data.eof_reached = false;
+/** Hands the index to the present or lined-up track it was built from, or frees it */
+static void attach_index(audio_instance_t *i, track_t *track, const audio_player_event_t &e)
+{
+    track_t *t = (track->fp == e.fp) ? track : (i->next.fp == e.fp) ? &i->next : NULL;
+    // A FILE* can be reused once closed; the size makes sure it is the same file
+    if(t && t->type == FILE_TYPE_MP3 && e.index.count && e.index.file_bytes == t->mp3.file_bytes) {
+        free(t->index.offsets);
+        t->index = e.index;
+        set_duration(t);
+        LOGI_1("seek index attached, %d entries", (int)e.index.count);
+        return;
     }
+    LOGI_1("seek index is for no track lined up, dropped");
+    free(e.index.offsets);
+}
 #endif
 
-#if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
-    // This can be a pointless condition depending on the build options, no reason to warn about it
-    // cppcheck-suppress knownConditionTrueFalse
-    if(file_type == FILE_TYPE_UNKNOWN)
-    {
-        if(is_wav(fp, &i->wav_data)) {
-            file_type = FILE_TYPE_WAV;
-            LOGI_1("file is wav");
+/**
+ * Requests that change the playback without ending it, handled in place
+ * whether playing or paused.
+ * @return false for any other request
+ */
+static bool handle_request(audio_instance_t *i, track_t *track, const audio_player_event_t &e)
+{
+    switch(e.type) {
+        case AUDIO_PLAYER_REQUEST_QUEUE:
+            enqueue_track(i, e.fp);
+            return true;
+        case AUDIO_PLAYER_REQUEST_SEEK: {
+            esp_err_t ret = seek_track(i, track, e.position_ms);
+            if(ret != ESP_OK) {
+                ESP_LOGE(TAG, "seek %d", ret);
+            }
+            return true;
         }
-    }
+        case AUDIO_PLAYER_REQUEST_SEEK_INDEX:
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
+            attach_index(i, track, e);
+#else
+            free(e.index.offsets);
 #endif
+            return true;
+        default:
+            return false;
+    }
+}
 
-    // cppcheck-suppress knownConditionTrueFalse
-    if(file_type == FILE_TYPE_UNKNOWN) {
+static esp_err_t aplay_file(audio_instance_t *i, track_t *track)
+{
+    LOGI_1("start to decode");
+
+    esp_err_t ret = ESP_OK;
+    bool flush = false;     // drop queued PCM instead of letting it play out
+    audio_player_event_t audio_event = { .type = AUDIO_PLAYER_REQUEST_NONE, .fp = NULL, .position_ms = 0, .index = {} };
+
+    if(!probe_track(track)) {
         ESP_LOGE(TAG, "unknown file type, cleaning up");
         dispatch_callback(i, AUDIO_PLAYER_CALLBACK_EVENT_UNKNOWN_FILE_TYPE);
         goto clean_up;
     }
+    if(!start_track(i, track)) {
+        ESP_LOGE(TAG, "failed to start decoder");
+        ret = ESP_FAIL;
+        goto clean_up;
+    }
+#if defined(CONFIG_AUDIO_PLAYER_RESAMPLE)
+    // Nothing before this playback joins onto it; queued tracks do
+    audio_src_reset(&i->src);
+#endif
 
     do {
         /* Process audio event sent from other task */
@@ -292,7 +1134,9 @@ static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
                 while(1) {
                     xQueuePeek(i->event_queue, &audio_event, portMAX_DELAY);
 
-                    if((AUDIO_PLAYER_REQUEST_PLAY != audio_event.type) &&
+                    if(handle_request(i, track, audio_event)) {
+                        xQueueReceive(i->event_queue, &audio_event, 0);
+                    } else if((AUDIO_PLAYER_REQUEST_PLAY != audio_event.type) &&
                        (AUDIO_PLAYER_REQUEST_STOP != audio_event.type) &&
                        (AUDIO_PLAYER_REQUEST_RESUME != audio_event.type))
                     {
@@ -316,7 +1160,11 @@ static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
             if ((AUDIO_PLAYER_REQUEST_STOP == audio_event.type) ||
                 (AUDIO_PLAYER_REQUEST_PLAY == audio_event.type)) {
                 ret = ESP_OK;
+                flush = true;
                 goto clean_up;
+            } else if (handle_request(i, track, audio_event)) {
+                xQueueReceive(i->event_queue, &audio_event, 0);
+                continue;
             } else {
                 // receive to discard the event, this event has no
                 // impact on the state of playback
@@ -327,9 +1175,25 @@ static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
 
         set_state(i, AUDIO_PLAYER_STATE_PLAYING);
 
+        // Open up whatever is queued now, not at the end of this track
+        line_up_next(i);
+
+        // Decode straight into the next free PCM buffer; blocks only while
+        // the writer is still working through all of them
+        uint8_t slot = PCM_SLOT_NONE;
+#if defined(CONFIG_AUDIO_PLAYER_RESAMPLE)
+        i->output.samples = i->decode_buf;
+#else
+        xQueueReceive(i->pcm_free, &slot, portMAX_DELAY);
+        i->output.samples = i->pcm[slot].samples;
+#endif
+
         DECODE_STATUS decode_status = DECODE_STATUS_ERROR;
 
-        switch(file_type) {
+        FILE *fp = track->fp;
+        TELEMETRY_TRACE_BEGIN(TELEMETRY_TRACE_AUDIO_DECODE);
+        int64_t decode_start_us = esp_timer_get_time();
+        switch(track->type) {
 #if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
             case FILE_TYPE_MP3:
                 decode_status = decode_mp3(i->mp3_decoder, fp, &i->output, &i->mp3_data);
@@ -339,69 +1203,65 @@ static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
             case FILE_TYPE_WAV:
                 decode_status = decode_wav(fp, &i->output, &i->wav_data);
                 break;
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
+            case FILE_TYPE_FLAC:
+                decode_status = decode_flac(fp, &i->output, &i->flac_data);
+                break;
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+            case FILE_TYPE_AAC:
+                decode_status = decode_aac(fp, &i->output, &i->aac_data);
+                break;
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_OPUS)
+            case FILE_TYPE_OPUS:
+                decode_status = decode_opus(fp, &i->output, &i->opus_data);
+                break;
 #endif
             case FILE_TYPE_UNKNOWN:
                 ESP_LOGE(TAG, "unexpected unknown file type when decoding");
                 break;
         }
+        TELEMETRY_TRACE_END(TELEMETRY_TRACE_AUDIO_DECODE);
+        uint32_t decode_us = (uint32_t)(esp_timer_get_time() - decode_start_us);
+        TELEMETRY_HIST_RECORD("decode", TELEMETRY_HIST_US, decode_us);
+        telemetry_record(TELEMETRY_AUDIO_DECODE, decode_us);
+        if(!audio_has_sink(i)) {
+            bool produced = decode_status == DECODE_STATUS_CONTINUE && i->output.fmt.sample_rate > 0;
+            record_decode(i, decode_us, produced ? i->output.frame_count : 0, i->output.fmt.sample_rate);
+        }
 
         // break out and exit if we aren't supposed to continue decoding
         if(decode_status == DECODE_STATUS_CONTINUE)
         {
-            // if mono, convert to stereo as es8311 requires stereo input
-            // even though it is mono output
-            if(i->output.fmt.channels ==  1) {
-                LOGI_3("c == 1, mono -> stereo");
-                ret = mono_to_stereo(i->output.fmt.bits_per_sample, i->output);
-                if(ret != ESP_OK) {
-                    goto clean_up;
-                }
-            }
-
-            /* Configure I2S clock if the output format changed */
-            if ((i2s_format.sample_rate != i->output.fmt.sample_rate) ||
-                    (i2s_format.channels != i->output.fmt.channels) ||
-                    (i2s_format.bits_per_sample != i->output.fmt.bits_per_sample)) {
-                i2s_format = i->output.fmt;
-                LOGI_1("format change: sr=%d, bit=%d, ch=%d",
-                        i2s_format.sample_rate,
-                        i2s_format.bits_per_sample,
-                        i2s_format.channels);
-                i2s_slot_mode_t channel_setting = (i2s_format.channels == 1) ? I2S_SLOT_MODE_MONO : I2S_SLOT_MODE_STEREO;
-                ret = i->config.clk_set_fn(i2s_format.sample_rate,
-                            i2s_format.bits_per_sample,
-                            channel_setting);
-                ESP_GOTO_ON_ERROR(ret, clean_up, TAG, "i2s_set_clk");
+            trim_output(track, i->output);
+            ret = output_pcm(i, slot, track);
+            if(ret != ESP_OK) {
+                goto clean_up;
             }
 
-            /**
-             * Block until all data has been accepted into the i2s driver, however
-             * the i2s driver has been configured with a buffer to allow for the next round of
-             * audio decoding to occur while the previous set of samples is finishing playback, in order
-             * to ensure playback without interruption.
-             */
-            size_t i2s_bytes_written = 0;
-            size_t bytes_to_write = i->output.frame_count * i->output.fmt.channels * (i2s_format.bits_per_sample / 8);
-            LOGI_2("c %d, bps %d, bytes %d, frame_count %d",
-                i->output.fmt.channels,
-                i2s_format.bits_per_sample,
-                bytes_to_write,
-                i->output.frame_count);
-
-            i->config.write_fn(i->output.samples, bytes_to_write, &i2s_bytes_written, portMAX_DELAY);
-            if(bytes_to_write != i2s_bytes_written) {
-                ESP_LOGE(TAG, "to write %d != written %d", bytes_to_write, i2s_bytes_written);
+            // the rest of the file is encoder padding
+            if(track->frames_left == 0 && !advance_track(i, track)) {
+                break;
             }
         } else if(decode_status == DECODE_STATUS_NO_DATA_CONTINUE)
         {
             LOGI_2("no data");
+            pcm_release(i, slot);
         } else { // DECODE_STATUS_DONE || DECODE_STATUS_ERROR
-            LOGI_1("breaking out of playback");
-            break;
+            pcm_release(i, slot);
+            if(!advance_track(i, track)) {
+                LOGI_1("breaking out of playback");
+                break;
+            }
         }
     } while (true);
 
 clean_up:
+    // Whatever is still queued was meant to follow this playback
+    clear_queue(i);
+    pcm_drain(i, flush);
     return ret;
 }
 
@@ -424,8 +1284,10 @@ static void audio_task(void *pvParam)
             if (pdPASS == retval) { // item on the queue, process it
                 xQueueReceive(i->event_queue, &audio_event, 0);
 
-                // if the item is a play request, process it
-                if(AUDIO_PLAYER_REQUEST_PLAY == audio_event.type) {
+                // if the item is a play request, process it; a queued file
+                // with nothing playing starts right away
+                if((AUDIO_PLAYER_REQUEST_PLAY == audio_event.type) ||
+                   (AUDIO_PLAYER_REQUEST_QUEUE == audio_event.type)) {
                     if(i->state == AUDIO_PLAYER_STATE_PLAYING) {
                         dispatch_callback(i, AUDIO_PLAYER_CALLBACK_EVENT_COMPLETED_PLAYING_NEXT);
                     } else {
@@ -434,12 +1296,19 @@ static void audio_task(void *pvParam)
 
                     break;
                 } else if(AUDIO_PLAYER_REQUEST_SHUTDOWN_THREAD == audio_event.type) {
+                    // Only the main instance has a writer of its own to end
+                    if(!audio_has_sink(i)) {
+                        uint8_t shutdown = PCM_SLOT_SHUTDOWN;
+                        xQueueSend(i->pcm_filled, &shutdown, portMAX_DELAY);
+                    }
                     set_state(i, AUDIO_PLAYER_STATE_SHUTDOWN);
                     i->running = false;
 
                     // should never return
                     vTaskDelete(NULL);
                     break;
+                } else if(AUDIO_PLAYER_REQUEST_SEEK_INDEX == audio_event.type) {
+                    free(audio_event.index.offsets);    // its track has ended
                 } else {
                     // ignore other events when not playing
                 }
@@ -451,20 +1320,28 @@ static void audio_task(void *pvParam)
             }
         }
 
-        i->config.mute_fn(AUDIO_PLAYER_UNMUTE);
-        esp_err_t ret_val = aplay_file(i, audio_event.fp);
+        // aplay_file() moves track on to each queued file it plays
+        track_t track;
+        memset(&track, 0, sizeof(track));
+        track.fp = audio_event.fp;
+
+        if(i->config.mute_fn) i->config.mute_fn(AUDIO_PLAYER_UNMUTE);
+        esp_err_t ret_val = aplay_file(i, &track);
         if(ret_val != ESP_OK)
         {
             ESP_LOGE(TAG, "aplay_file() %d", ret_val);
         }
-        i->config.mute_fn(AUDIO_PLAYER_MUTE);
+        if(i->config.mute_fn) i->config.mute_fn(AUDIO_PLAYER_MUTE);
+        i->position_ms = 0;
+        i->duration_ms = 0;
 
-        if(audio_event.fp) fclose(audio_event.fp);
+        if(track.fp) close_track(&track);
     }
 }
 
 /* **************** AUDIO PLAY CONTROL **************** */
 static esp_err_t audio_send_event(audio_instance_t *i, audio_player_event_t event) {
+    ESP_RETURN_ON_FALSE(NULL != i, ESP_ERR_INVALID_ARG, TAG, "handle");
     ESP_RETURN_ON_FALSE(NULL != i->event_queue, ESP_ERR_INVALID_STATE,
         TAG, "Audio task not started yet");
 
@@ -476,43 +1353,327 @@ static esp_err_t audio_send_event(audio_instance_t *i, audio_player_event_t even
     return ESP_OK;
 }
 
+esp_err_t audio_player_instance_play(audio_player_handle_t handle, FILE *fp)
+{
+    LOGI_1("%s", __FUNCTION__);
+    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_PLAY, .fp = fp, .position_ms = 0, .index = {} };
+    return audio_send_event(handle, event);
+}
+
 esp_err_t audio_player_play(FILE *fp)
+{
+    return audio_player_instance_play(&instance, fp);
+}
+
+esp_err_t audio_player_instance_queue(audio_player_handle_t handle, FILE *fp)
+{
+    LOGI_1("%s", __FUNCTION__);
+    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_QUEUE, .fp = fp, .position_ms = 0, .index = {} };
+    return audio_send_event(handle, event);
+}
+
+esp_err_t audio_player_queue(FILE *fp)
+{
+    return audio_player_instance_queue(&instance, fp);
+}
+
+/**
+ * A source is wrapped in a stdio stream (newlib fopencookie) so the
+ * decoders keep reading through fread/fseek whatever the bytes come from.
+ * The position is tracked here to resolve SEEK_CUR/SEEK_END.
+ */
+typedef struct {
+    audio_player_source_t source;
+    int64_t position;
+} source_cookie_t;
+
+static ssize_t source_cookie_read(void *cookie, char *buf, size_t size)
+{
+    source_cookie_t *c = static_cast<source_cookie_t*>(cookie);
+    int n = c->source.read(c->source.ctx, buf, size);
+    if(n > 0) {
+        c->position += n;
+    }
+    return n;
+}
+
+// The offset type is whatever newlib's cookie_seek_function_t uses (off_t or _off64_t)
+template <typename Offset>
+static int source_cookie_seek(void *cookie, Offset *offset, int whence)
+{
+    source_cookie_t *c = static_cast<source_cookie_t*>(cookie);
+    int64_t target = *offset;
+    if(whence == SEEK_CUR) {
+        target += c->position;
+    } else if(whence == SEEK_END) {
+        int64_t size = c->source.size ? c->source.size(c->source.ctx) : -1;
+        if(size < 0) {
+            return -1;
+        }
+        target += size;
+    }
+    if(target != c->position) {
+        if(target < 0 || !c->source.seek || c->source.seek(c->source.ctx, target) != 0) {
+            return -1;
+        }
+        c->position = target;
+    }
+    *offset = static_cast<Offset>(target);
+    return 0;
+}
+
+static int source_cookie_close(void *cookie)
+{
+    source_cookie_t *c = static_cast<source_cookie_t*>(cookie);
+    if(c->source.close) {
+        c->source.close(c->source.ctx);
+    }
+    free(c);
+    return 0;
+}
+
+esp_err_t audio_player_instance_play_source(audio_player_handle_t handle, const audio_player_source_t *source)
 {
     LOGI_1("%s", __FUNCTION__);
-    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_PLAY, .fp = fp };
-    return audio_send_event(&instance, event);
+    ESP_RETURN_ON_FALSE(source && source->read, ESP_ERR_INVALID_ARG, TAG, "Invalid source");
+
+    source_cookie_t *cookie = static_cast<source_cookie_t*>(malloc(sizeof(source_cookie_t)));
+    ESP_RETURN_ON_FALSE(cookie, ESP_ERR_NO_MEM, TAG, "Failed allocate source");
+    cookie->source = *source;
+    cookie->position = 0;
+
+    cookie_io_functions_t functions = {};
+    functions.read = source_cookie_read;
+    functions.seek = source_cookie_seek;
+    functions.close = source_cookie_close;
+    FILE *fp = fopencookie(cookie, "r", functions);
+    if(!fp) {
+        free(cookie);
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = audio_player_instance_play(handle, fp);
+    if(ret != ESP_OK) {
+        // Hand the source back unclosed, as documented
+        cookie->source.close = NULL;
+        fclose(fp);
+    }
+    return ret;
+}
+
+esp_err_t audio_player_play_source(const audio_player_source_t *source)
+{
+    return audio_player_instance_play_source(&instance, source);
+}
+
+esp_err_t audio_player_instance_pause(audio_player_handle_t handle)
+{
+    LOGI_1("%s", __FUNCTION__);
+    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_PAUSE, .fp = NULL, .position_ms = 0, .index = {} };
+    return audio_send_event(handle, event);
 }
 
 esp_err_t audio_player_pause(void)
+{
+    return audio_player_instance_pause(&instance);
+}
+
+esp_err_t audio_player_instance_resume(audio_player_handle_t handle)
 {
     LOGI_1("%s", __FUNCTION__);
-    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_PAUSE, .fp = NULL };
-    return audio_send_event(&instance, event);
+    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_RESUME, .fp = NULL, .position_ms = 0, .index = {} };
+    return audio_send_event(handle, event);
 }
 
 esp_err_t audio_player_resume(void)
+{
+    return audio_player_instance_resume(&instance);
+}
+
+esp_err_t audio_player_instance_stop(audio_player_handle_t handle)
 {
     LOGI_1("%s", __FUNCTION__);
-    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_RESUME, .fp = NULL };
-    return audio_send_event(&instance, event);
+    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_STOP, .fp = NULL, .position_ms = 0, .index = {} };
+    return audio_send_event(handle, event);
 }
 
 esp_err_t audio_player_stop(void)
+{
+    return audio_player_instance_stop(&instance);
+}
+
+esp_err_t audio_player_instance_seek(audio_player_handle_t handle, uint32_t position_ms)
 {
     LOGI_1("%s", __FUNCTION__);
-    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_STOP, .fp = NULL };
-    return audio_send_event(&instance, event);
+    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_SEEK, .fp = NULL, .position_ms = position_ms, .index = {} };
+    return audio_send_event(handle, event);
+}
+
+esp_err_t audio_player_seek(uint32_t position_ms)
+{
+    return audio_player_instance_seek(&instance, position_ms);
+}
+
+esp_err_t audio_player_instance_get_position(audio_player_handle_t handle, uint32_t *position_ms, uint32_t *duration_ms)
+{
+    ESP_RETURN_ON_FALSE(NULL != handle, ESP_ERR_INVALID_ARG, TAG, "handle");
+    ESP_RETURN_ON_FALSE(NULL != position_ms || NULL != duration_ms, ESP_ERR_INVALID_ARG, TAG, "nothing to fill");
+    if(position_ms) *position_ms = handle->position_ms;
+    if(duration_ms) *duration_ms = handle->duration_ms;
+    return ESP_OK;
+}
+
+esp_err_t audio_player_get_position(uint32_t *position_ms, uint32_t *duration_ms)
+{
+    return audio_player_instance_get_position(&instance, position_ms, duration_ms);
+}
+
+esp_err_t audio_player_build_seek_index(FILE *fp, audio_player_seek_index_t *index)
+{
+    ESP_RETURN_ON_FALSE(NULL != fp && NULL != index, ESP_ERR_INVALID_ARG, TAG, "fp, index");
+    memset(index, 0, sizeof(*index));
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
+    if(!is_mp3(fp)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    mp3_info info;
+    mp3_read_info(fp, &info);
+    if(info.sample_rate == 0 || info.has_toc) {
+        return ESP_ERR_NOT_SUPPORTED;       // the tag's TOC is what seeks
+    }
+    ESP_RETURN_ON_FALSE(mp3_build_index(fp, &info, SEEK_INDEX_STEP, index), ESP_FAIL, TAG, "index not built");
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t audio_player_set_seek_index(FILE *fp, audio_player_seek_index_t *index)
+{
+    ESP_RETURN_ON_FALSE(NULL != fp && NULL != index, ESP_ERR_INVALID_ARG, TAG, "fp, index");
+    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_SEEK_INDEX, .fp = fp, .position_ms = 0, .index = *index };
+    esp_err_t ret = audio_send_event(&instance, event);
+    if(ret != ESP_OK) {
+        free(index->offsets);
+    }
+    // The player's now either way
+    memset(index, 0, sizeof(*index));
+    return ret;
+}
+
+void audio_player_free_seek_index(audio_player_seek_index_t *index)
+{
+    if(index) {
+        free(index->offsets);
+        memset(index, 0, sizeof(*index));
+    }
+}
+
+esp_err_t audio_player_get_file_duration(FILE *fp, uint32_t *duration_ms)
+{
+    ESP_RETURN_ON_FALSE(NULL != fp && NULL != duration_ms, ESP_ERR_INVALID_ARG, TAG, "fp, duration_ms");
+    // probe_track() only reads the file; the decoders are not touched
+    track_t t = {};
+    t.fp = fp;
+    bool known = probe_track(&t);
+    *duration_ms = t.duration_ms;
+    return known ? ESP_OK : ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t audio_player_play_clip(const audio_player_clip_t *clip, float gain, bool duck)
+{
+#if defined(CONFIG_AUDIO_PLAYER_MIXER)
+    ESP_RETURN_ON_FALSE(NULL != clip && NULL != clip->samples, ESP_ERR_INVALID_ARG, TAG, "clip");
+    ESP_RETURN_ON_FALSE(NULL != instance.mixer.requests, ESP_ERR_INVALID_STATE, TAG, "not running");
+    ESP_RETURN_ON_FALSE(audio_mixer_start(&instance.mixer, clip, gain, duck), ESP_ERR_NO_MEM,
+        TAG, "too many clips waiting");
+    // Wake the writer in case no music is keeping it busy; if the queue is
+    // full it is, and takes the clip with the next buffer
+    uint8_t wake = PCM_SLOT_MIX;
+    xQueueSend(instance.pcm_filled, &wake, 0);
+    return ESP_OK;
+#else
+    (void)clip;
+    (void)gain;
+    (void)duck;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t audio_player_get_spectrum(uint8_t *levels, size_t count)
+{
+#if defined(CONFIG_AUDIO_PLAYER_SPECTRUM)
+    if(NULL == levels || NULL == instance.spectrum.fft) {
+        return 0;
+    }
+    return audio_spectrum_read(&instance.spectrum, levels, count);
+#else
+    (void)levels;
+    (void)count;
+    return 0;
+#endif
+}
+
+esp_err_t audio_player_set_pcm_depth(uint8_t depth)
+{
+    ESP_RETURN_ON_FALSE(depth >= 2 && depth <= PCM_BUFFER_COUNT, ESP_ERR_INVALID_ARG, TAG, "depth");
+    instance.pcm_depth = depth;
+    return ESP_OK;
+}
+
+uint8_t audio_player_get_pcm_depth(void)
+{
+    return instance.pcm_depth;
+}
+
+esp_err_t audio_player_take_decode_stats(audio_player_decode_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(NULL != stats, ESP_ERR_INVALID_ARG, TAG, "stats");
+    taskENTER_CRITICAL(&instance.stats_lock);
+    *stats = instance.stats;
+    uint32_t frame_us = instance.stats.frame_us;
+    memset(&instance.stats, 0, sizeof(instance.stats));
+    instance.stats.frame_us = frame_us;     // Still the frame length until another is decoded
+    taskEXIT_CRITICAL(&instance.stats_lock);
+    return ESP_OK;
+}
+
+esp_err_t audio_player_set_duck_gain(float gain)
+{
+#if defined(CONFIG_AUDIO_PLAYER_MIXER)
+    audio_mixer_set_duck(&instance.mixer, gain);
+    return ESP_OK;
+#else
+    (void)gain;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
 }
 
 /**
  * Can only shut down the playback thread if the thread is not presently playing audio.
  * Call audio_player_stop()
  */
-static esp_err_t _internal_audio_player_shutdown_thread(void)
+static esp_err_t _internal_audio_player_shutdown_thread(audio_instance_t *i)
 {
     LOGI_1("%s", __FUNCTION__);
-    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_SHUTDOWN_THREAD, .fp = NULL };
-    return audio_send_event(&instance, event);
+    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_SHUTDOWN_THREAD, .fp = NULL, .position_ms = 0, .index = {} };
+    return audio_send_event(i, event);
+}
+
+/** Stops playback and ends the decode task. @return false if it did not end */
+static bool shutdown_instance(audio_instance_t *i)
+{
+    const int MAX_RETRIES = 5;
+    int retries = MAX_RETRIES;
+    while(i->running && retries) {
+        // stop any playback and shutdown the thread
+        audio_player_instance_stop(i);
+        _internal_audio_player_shutdown_thread(i);
+
+        vTaskDelay(pdMS_TO_TICKS(100));
+        retries--;
+    }
+    return retries > 0;
 }
 
 static void cleanup_memory(audio_instance_t &i)
@@ -521,9 +1682,107 @@ static void cleanup_memory(audio_instance_t &i)
     if(i.mp3_decoder) MP3FreeDecoder(i.mp3_decoder);
     if(i.mp3_data.data_buf) free(i.mp3_data.data_buf);
 #endif
-    if(i.output.samples) free(i.output.samples);
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
+    flac_free(&i.flac_data);
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+    aac_free(&i.aac_data);
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_OPUS)
+    opus_free(&i.opus_data);
+#endif
+    for(int n = 0; n < PCM_BUFFER_COUNT; n++) {
+        if(i.pcm[n].samples) heap_caps_free(i.pcm[n].samples);
+        i.pcm[n].samples = NULL;
+    }
+    i.output.samples = NULL;
+#if defined(CONFIG_AUDIO_PLAYER_RESAMPLE)
+    if(i.decode_buf) heap_caps_free(i.decode_buf);
+    i.decode_buf = NULL;
+    audio_src_free(&i.src);
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_MIXER)
+    audio_mixer_free(&i.mixer);
+    if(i.streams_lock) vSemaphoreDelete(i.streams_lock);
+    i.streams_lock = NULL;
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_SPECTRUM)
+    audio_spectrum_free(&i.spectrum);
+#endif
+
+    if(i.track_queue) {
+        clear_queue(&i);
+        vQueueDelete(i.track_queue);
+    }
+    if(i.pcm_free) vQueueDelete(i.pcm_free);
+    if(i.pcm_filled) vQueueDelete(i.pcm_filled);
+    if(i.event_queue) vQueueDelete(i.event_queue);
+}
+
+/** What every instance decodes with: queues, PCM buffers, resampler, MP3 decoder */
+static esp_err_t alloc_decode(audio_instance_t &i)
+{
+    /* Audio control event queue */
+    i.event_queue = xQueueCreate(4, sizeof(audio_player_event_t));
+    ESP_RETURN_ON_FALSE(NULL != i.event_queue, ESP_ERR_NO_MEM, TAG, "xQueueCreate");
+
+    /** See https://github.com/ultraembedded/libhelix-mp3/blob/0a0e0673f82bc6804e5a3ddb15fb6efdcde747cd/testwrap/main.c#L74 */
+    i.output.samples_capacity = MAX_NCHAN * MAX_NGRAN * MAX_NSAMP;
+    i.output.samples_capacity_max = i.output.samples_capacity * 2;
+    LOGI_1("samples_capacity %d bytes x %d buffers", i.output.samples_capacity_max, PCM_BUFFER_COUNT);
+
+    i.track_queue = xQueueCreate(TRACK_QUEUE_LENGTH, sizeof(FILE*));
+    ESP_RETURN_ON_FALSE(NULL != i.track_queue, ESP_ERR_NO_MEM, TAG, "Failed create track queue");
+
+    i.pcm_free = xQueueCreate(PCM_BUFFER_COUNT, sizeof(uint8_t));
+    i.pcm_filled = xQueueCreate(PCM_BUFFER_COUNT + 2, sizeof(uint8_t));   // + shutdown, clip wake-up
+    ESP_RETURN_ON_FALSE(NULL != i.pcm_free && NULL != i.pcm_filled, ESP_ERR_NO_MEM, TAG, "Failed create PCM queues");
+    for(uint8_t n = 0; n < PCM_BUFFER_COUNT; n++) {
+        // Internal, DMA-capable: the write path may hand it to I2S DMA without a bounce copy;
+        // 16-byte aligned for the mixer's SIMD adds
+        i.pcm[n].samples = static_cast<uint8_t*>(heap_caps_aligned_alloc(16, i.output.samples_capacity_max,
+            MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA));
+        ESP_RETURN_ON_FALSE(NULL != i.pcm[n].samples, ESP_ERR_NO_MEM, TAG, "Failed allocate output buffer");
+        xQueueSend(i.pcm_free, &n, 0);
+    }
+    i.output.samples = i.pcm[0].samples;
+
+#if defined(CONFIG_AUDIO_PLAYER_RESAMPLE)
+    i.decode_buf = static_cast<uint8_t*>(heap_caps_malloc(i.output.samples_capacity_max,
+        MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    ESP_RETURN_ON_FALSE(NULL != i.decode_buf, ESP_ERR_NO_MEM, TAG, "Failed allocate decode buffer");
+    ESP_RETURN_ON_FALSE(audio_src_init(&i.src, CONFIG_AUDIO_PLAYER_OUTPUT_RATE), ESP_ERR_NO_MEM,
+        TAG, "Failed create resampler");
+#endif
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
+    i.mp3_data.data_buf_size = MAINBUF_SIZE * 3;
+    i.mp3_data.data_buf = static_cast<uint8_t*>(malloc(i.mp3_data.data_buf_size));
+    ESP_RETURN_ON_FALSE(NULL != i.mp3_data.data_buf, ESP_ERR_NO_MEM, TAG, "Failed allocate mp3 data buffer");
+
+    i.mp3_decoder = MP3InitDecoder();
+    ESP_RETURN_ON_FALSE(NULL != i.mp3_decoder, ESP_ERR_NO_MEM, TAG, "Failed create MP3 decoder");
+#endif
+    return ESP_OK;
+}
 
-    vQueueDelete(i.event_queue);
+static esp_err_t start_decode_task(audio_instance_t &i, const char *name)
+{
+    i.running = true;
+    BaseType_t task_val = xTaskCreatePinnedToCore(
+        (TaskFunction_t)        audio_task,
+                                name,
+                                4 * 1024,
+                                &i,
+        (UBaseType_t)           i.config.priority,
+                                NULL,
+        (BaseType_t)            i.config.coreID);
+    if(pdPASS != task_val) {
+        i.running = false;
+        ESP_LOGE(TAG, "Failed create %s", name);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
 }
 
 esp_err_t audio_player_new(audio_player_config_t config)
@@ -534,42 +1793,37 @@ esp_err_t audio_player_new(audio_player_config_t config)
 
     instance.config = config;
 
-    /* Audio control event queue */
-    instance.event_queue = xQueueCreate(4, sizeof(audio_player_event_t));
-    ESP_RETURN_ON_FALSE(NULL != instance.event_queue, -1, TAG, "xQueueCreate");
-
-    /** See https://github.com/ultraembedded/libhelix-mp3/blob/0a0e0673f82bc6804e5a3ddb15fb6efdcde747cd/testwrap/main.c#L74 */
-    instance.output.samples_capacity = MAX_NCHAN * MAX_NGRAN * MAX_NSAMP;
-    instance.output.samples_capacity_max = instance.output.samples_capacity * 2;
-    instance.output.samples = static_cast<uint8_t*>(malloc(instance.output.samples_capacity_max));
-    LOGI_1("samples_capacity %d bytes", instance.output.samples_capacity_max);
-    int ret = ESP_OK;
-    ESP_GOTO_ON_FALSE(NULL != instance.output.samples, ESP_ERR_NO_MEM, cleanup,
-        TAG, "Failed allocate output buffer");
+    esp_err_t ret = alloc_decode(instance);
+    ESP_GOTO_ON_FALSE(ESP_OK == ret, ret, cleanup, TAG, "Failed allocate decoder");
 
-#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
-    instance.mp3_data.data_buf_size = MAINBUF_SIZE * 3;
-    instance.mp3_data.data_buf = static_cast<uint8_t*>(malloc(instance.mp3_data.data_buf_size));
-    ESP_GOTO_ON_FALSE(NULL != instance.mp3_data.data_buf, ESP_ERR_NO_MEM, cleanup,
-        TAG, "Failed allocate mp3 data buffer");
+#if defined(CONFIG_AUDIO_PLAYER_MIXER)
+    ESP_GOTO_ON_FALSE(audio_mixer_init(&instance.mixer), ESP_ERR_NO_MEM, cleanup,
+        TAG, "Failed create mixer");
+    instance.streams_lock = xSemaphoreCreateMutex();
+    ESP_GOTO_ON_FALSE(NULL != instance.streams_lock, ESP_ERR_NO_MEM, cleanup,
+        TAG, "Failed create mixer lock");
+#endif
 
-    instance.mp3_decoder = MP3InitDecoder();
-    ESP_GOTO_ON_FALSE(NULL != instance.mp3_decoder, ESP_ERR_NO_MEM, cleanup,
-        TAG, "Failed create MP3 decoder");
+#if defined(CONFIG_AUDIO_PLAYER_SPECTRUM)
+    ESP_GOTO_ON_FALSE(audio_spectrum_init(&instance.spectrum), ESP_ERR_NO_MEM, cleanup,
+        TAG, "Failed create spectrum analyser");
 #endif
 
-    instance.running = true;
+    ret = start_decode_task(instance, "Audio Task");
+    ESP_GOTO_ON_FALSE(ESP_OK == ret, ret, cleanup, TAG, "Failed create audio task");
+
+    // One above the decoder so a finished buffer reaches I2S before the next decode
     task_val = xTaskCreatePinnedToCore(
-        (TaskFunction_t)        audio_task,
-                                "Audio Task",
-                                4 * 1024,
+        (TaskFunction_t)        audio_writer_task,
+                                "Audio Writer",
+                                3 * 1024,
                                 &instance,
-        (UBaseType_t)           instance.config.priority,
+        (UBaseType_t)           instance.config.priority + 1,
                                 NULL,
         (BaseType_t)            instance.config.coreID);
 
     ESP_GOTO_ON_FALSE(pdPASS == task_val, ESP_ERR_NO_MEM, cleanup,
-        TAG, "Failed create audio task");
+        TAG, "Failed create audio writer task");
 
     // start muted
     instance.config.mute_fn(AUDIO_PLAYER_MUTE);
@@ -586,23 +1840,99 @@ cleanup:
 }
 
 esp_err_t audio_player_delete() {
-    const int MAX_RETRIES = 5;
-    int retries = MAX_RETRIES;
-    while(instance.running && retries) {
-        // stop any playback and shutdown the thread
-        audio_player_stop();
-        _internal_audio_player_shutdown_thread();
-
-        vTaskDelay(pdMS_TO_TICKS(100));
-        retries--;
+#if defined(CONFIG_AUDIO_PLAYER_MIXER)
+    for(int n = 0; n < MIXER_STREAMS; n++) {
+        ESP_RETURN_ON_FALSE(NULL == instance.streams[n], ESP_ERR_INVALID_STATE,
+            TAG, "Delete the other instances first");
     }
+#endif
+    bool stopped = shutdown_instance(&instance);
 
     cleanup_memory(instance);
 
     // if we ran out of retries, return fail code
-    if(retries == 0) {
+    if(!stopped) {
         return ESP_FAIL;
     }
 
     return ESP_OK;
 }
+
+esp_err_t audio_player_instance_new(const audio_player_instance_config_t *config, audio_player_handle_t *handle)
+{
+#if defined(CONFIG_AUDIO_PLAYER_MIXER)
+    ESP_RETURN_ON_FALSE(NULL != config && NULL != handle, ESP_ERR_INVALID_ARG, TAG, "config, handle");
+    ESP_RETURN_ON_FALSE(instance.running, ESP_ERR_INVALID_STATE, TAG, "audio_player_new() first");
+
+    audio_instance_t *i = static_cast<audio_instance_t*>(calloc(1, sizeof(audio_instance_t)));
+    ESP_RETURN_ON_FALSE(NULL != i, ESP_ERR_NO_MEM, TAG, "Failed allocate instance");
+    audio_instance_init(*i);
+    // Decodes like the main instance; its PCM goes to the main writer, not to the sink's callbacks
+    i->config.priority = config->priority;
+    i->config.coreID = config->coreID;
+    i->sink = &instance;
+    i->gain_q15 = audio_mixer_gain_q15(config->gain);
+    i->duck = config->duck;
+
+    int slot = -1;
+    esp_err_t ret = alloc_decode(*i);
+    ESP_GOTO_ON_FALSE(ESP_OK == ret, ret, cleanup, TAG, "Failed allocate decoder");
+
+    xSemaphoreTake(instance.streams_lock, portMAX_DELAY);
+    for(int n = 0; n < MIXER_STREAMS && slot < 0; n++) {
+        if(NULL == instance.streams[n]) {
+            instance.streams[n] = i;
+            slot = n;
+        }
+    }
+    xSemaphoreGive(instance.streams_lock);
+    ESP_GOTO_ON_FALSE(slot >= 0, ESP_ERR_NO_MEM, cleanup, TAG, "CONFIG_AUDIO_PLAYER_INSTANCES reached");
+
+    ret = start_decode_task(*i, "Audio Task 2");
+    ESP_GOTO_ON_FALSE(ESP_OK == ret, ret, cleanup, TAG, "Failed create audio task");
+
+    *handle = i;
+    return ESP_OK;
+
+// cppcheck-suppress unusedLabelConfiguration
+cleanup:
+    if(slot >= 0) {
+        xSemaphoreTake(instance.streams_lock, portMAX_DELAY);
+        instance.streams[slot] = NULL;
+        xSemaphoreGive(instance.streams_lock);
+    }
+    cleanup_memory(*i);
+    free(i);
+    return ret;
+#else
+    (void)config;
+    (void)handle;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t audio_player_instance_delete(audio_player_handle_t handle)
+{
+#if defined(CONFIG_AUDIO_PLAYER_MIXER)
+    ESP_RETURN_ON_FALSE(NULL != handle && NULL != handle->sink, ESP_ERR_INVALID_ARG,
+        TAG, "Not from audio_player_instance_new()");
+    // Its task may still be using it; left in place rather than freed under it
+    ESP_RETURN_ON_FALSE(shutdown_instance(handle), ESP_FAIL, TAG, "Audio task did not end");
+
+    // Once out of the list the writer no longer touches its buffers
+    xSemaphoreTake(instance.streams_lock, portMAX_DELAY);
+    for(int n = 0; n < MIXER_STREAMS; n++) {
+        if(instance.streams[n] == handle) {
+            instance.streams[n] = NULL;
+        }
+    }
+    xSemaphoreGive(instance.streams_lock);
+
+    cleanup_memory(*handle);
+    free(handle);
+    return ESP_OK;
+#else
+    (void)handle;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
@@ -0,0 +1,126 @@
+#include <math.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "dsps_fft2r.h"
+#include "dsps_wind_hann.h"
+#include "audio_log.h"
+#include "audio_spectrum.h"
+
+static const char *TAG = "spectrum";
+
+#define FFT_N                   AUDIO_SPECTRUM_FFT_SIZE
+/* A full scale sine through the Hann window peaks at N/4 in its bin; both
+ * channels at full scale are 0 dB */
+#define FULL_SCALE_POWER        (2.0f * (FFT_N / 4) * (FFT_N / 4))
+
+bool audio_spectrum_init(audio_spectrum *s)
+{
+    memset(s, 0, sizeof(*s));
+    // The twiddle table is shared by every user of the library; a bigger one is as good
+    esp_err_t ret = dsps_fft2r_init_fc32(NULL, FFT_N);
+    if(ret != ESP_OK && ret != ESP_ERR_DSP_REINITIALIZED) {
+        ESP_LOGE(TAG, "fft init %d", ret);
+        return false;
+    }
+    s->window = static_cast<float*>(heap_caps_aligned_alloc(16, FFT_N * sizeof(float), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    s->fft = static_cast<float*>(heap_caps_aligned_alloc(16, 2 * FFT_N * sizeof(float), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    if(!s->window || !s->fft) {
+        audio_spectrum_free(s);
+        return false;
+    }
+    dsps_wind_hann_f32(s->window, FFT_N);
+    return true;
+}
+
+void audio_spectrum_free(audio_spectrum *s)
+{
+    heap_caps_free(s->window);
+    heap_caps_free(s->fft);
+    memset(s, 0, sizeof(*s));
+}
+
+// Log spaced; a band narrower than a bin still gets one of its own
+static void set_rate(audio_spectrum *s, int sample_rate)
+{
+    const float ratio = (float)AUDIO_SPECTRUM_HIGH_HZ / AUDIO_SPECTRUM_LOW_HZ;
+    const uint16_t last = FFT_N / 2;
+    uint16_t edge = 1;      // bin 0 is DC
+    for(int b = 0; b <= AUDIO_SPECTRUM_BANDS; b++) {
+        float hz = AUDIO_SPECTRUM_LOW_HZ * powf(ratio, (float)b / AUDIO_SPECTRUM_BANDS);
+        uint16_t bin = (uint16_t)lrintf(hz * FFT_N / sample_rate);
+        edge = (b == 0) ? (bin > 1 ? bin : 1) : (bin > edge ? bin : edge + 1);
+        s->edges[b] = (edge < last) ? edge : last;
+    }
+    s->sample_rate = sample_rate;
+    LOGI_1("%d bands over %d Hz", AUDIO_SPECTRUM_BANDS, sample_rate);
+}
+
+static void analyse(audio_spectrum *s, const int16_t *samples, uint32_t channels)
+{
+    const float scale = 1.0f / 32768.0f;
+    float *fft = s->fft;
+    for(int n = 0; n < FFT_N; n++) {
+        float w = s->window[n] * scale;
+        fft[2 * n] = samples[0] * w;
+        fft[2 * n + 1] = samples[channels - 1] * w;
+        samples += channels;
+    }
+    dsps_fft2r_fc32(fft, FFT_N);
+    dsps_bit_rev_fc32(fft, FFT_N);
+    dsps_cplx2reC_fc32(fft, FFT_N);     // left bins from fft[0], right from fft[FFT_N]
+
+    uint8_t levels[AUDIO_SPECTRUM_BANDS];
+    for(int b = 0; b < AUDIO_SPECTRUM_BANDS; b++) {
+        float power = 0;
+        for(int k = s->edges[b]; k < s->edges[b + 1]; k++) {
+            const float *left = fft + 2 * k;
+            const float *right = fft + FFT_N + 2 * k;
+            power += left[0] * left[0] + left[1] * left[1] + right[0] * right[0] + right[1] * right[1];
+        }
+        float db = (power > 0) ? 10.0f * log10f(power / FULL_SCALE_POWER) : AUDIO_SPECTRUM_FLOOR_DB;
+        float level = (db - AUDIO_SPECTRUM_FLOOR_DB) * (255.0f / -AUDIO_SPECTRUM_FLOOR_DB);
+        levels[b] = (level <= 0) ? 0 : (level >= 255) ? 255 : (uint8_t)level;
+    }
+
+    // Sequence lock: odd while the levels change
+    uint32_t sequence = s->sequence;
+    __atomic_store_n(&s->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(s->levels, levels, sizeof(levels));
+    __atomic_store_n(&s->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+void audio_spectrum_feed(audio_spectrum *s, const int16_t *samples, size_t frames, const format *fmt)
+{
+    if(fmt->bits_per_sample != 16 || fmt->channels < 1 || fmt->channels > 2 || fmt->sample_rate <= 0) {
+        return;
+    }
+    if(s->countdown > frames) {
+        s->countdown -= frames;
+        return;
+    }
+    if(frames < FFT_N) {
+        s->countdown = 0;       // analyse the next buffer that is long enough
+        return;
+    }
+    if(fmt->sample_rate != s->sample_rate) {
+        set_rate(s, fmt->sample_rate);
+    }
+    s->countdown = fmt->sample_rate / AUDIO_SPECTRUM_RATE;
+    analyse(s, samples + (frames - FFT_N) * fmt->channels, fmt->channels);
+}
+
+uint32_t audio_spectrum_read(audio_spectrum *s, uint8_t *levels, size_t count)
+{
+    if(count > AUDIO_SPECTRUM_BANDS) {
+        count = AUDIO_SPECTRUM_BANDS;
+    }
+    uint32_t before, after;
+    do {
+        before = __atomic_load_n(&s->sequence, __ATOMIC_ACQUIRE);
+        memcpy(levels, s->levels, count);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&s->sequence, __ATOMIC_RELAXED);
+    } while((before & 1) || before != after);
+    return before / 2;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "audio_decode_types.h"
+
+/**
+ * Spectrum analyser tap for a visualiser, fed by the writer task with
+ * each PCM buffer on its way to I2S.
+ *
+ * About AUDIO_SPECTRUM_RATE times a second the newest AUDIO_SPECTRUM_FFT_SIZE
+ * frames are Hann windowed and transformed with dsps_fft2r_fc32. Left
+ * and right go in as the real and imaginary parts of one complex FFT and
+ * are separated afterwards (dsps_cplx2reC_fc32), so stereo costs the same
+ * as mono. The power is summed into AUDIO_SPECTRUM_BANDS log spaced bands
+ * and scaled to 0..255 over AUDIO_SPECTRUM_FLOOR_DB..0 dB.
+ *
+ * The levels are published under a sequence lock: the writer never
+ * waits, and a reader on another task retries if it catches an update
+ * half way.
+ */
+#define AUDIO_SPECTRUM_FFT_SIZE     512     /*< 10.7 ms at 48 kHz, 94 Hz per bin */
+#define AUDIO_SPECTRUM_BANDS        CONFIG_AUDIO_PLAYER_SPECTRUM_BANDS
+#define AUDIO_SPECTRUM_RATE         30      /*< analyses per second */
+#define AUDIO_SPECTRUM_LOW_HZ       60
+#define AUDIO_SPECTRUM_HIGH_HZ      16000
+#define AUDIO_SPECTRUM_FLOOR_DB     -60
+
+typedef struct {
+    float *window;
+    float *fft;                 /*< AUDIO_SPECTRUM_FFT_SIZE complex */
+    int sample_rate;            /*< edges are for this rate */
+    uint16_t edges[AUDIO_SPECTRUM_BANDS + 1];  /*< first bin of each band */
+    uint32_t countdown;         /*< frames until the next analysis */
+
+    volatile uint32_t sequence; /*< odd while levels are being written */
+    uint8_t levels[AUDIO_SPECTRUM_BANDS];
+} audio_spectrum;
+
+bool audio_spectrum_init(audio_spectrum *s);
+void audio_spectrum_free(audio_spectrum *s);
+
+/** Writer task: 16-bit mono or stereo frames about to be played */
+void audio_spectrum_feed(audio_spectrum *s, const int16_t *samples, size_t frames, const format *fmt);
+
+/**
+ * Any task. Copies up to AUDIO_SPECTRUM_BANDS levels.
+ * @return analysis count, 0 before the first
+ */
+uint32_t audio_spectrum_read(audio_spectrum *s, uint8_t *levels, size_t count);
@@ -0,0 +1,229 @@
+#include <math.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "dsps_dotprod.h"
+#include "audio_log.h"
+#include "audio_src.h"
+
+static const char *TAG = "src";
+
+#define HISTORY_SAMPLES         (AUDIO_SRC_TAPS + AUDIO_SRC_BLOCK_FRAMES)
+#define SRC_KAISER_BETA         7.0     /*< ~70 dB stop band */
+#define SRC_CUTOFF              0.45    /*< of the lower of the two rates */
+#define SRC_GAIN                0.891   /*< -1 dB, headroom for the filter's overshoot */
+#define SRC_GAIN_Q15            ((int32_t)(SRC_GAIN * 32767.0))  /*< applied in bypass too, so loudness does not depend on the rate */
+
+static void *alloc_internal(size_t bytes)
+{
+    void *p = heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    return p ? p : heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+}
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+    while(b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Zeroth order modified Bessel function, for the Kaiser window
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for(int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if(term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+/**
+ * Prototype of AUDIO_SRC_TAPS * L taps at L times the input rate, split
+ * into L phases. Each phase is normalised on its own so the DC gain does
+ * not ripple from one output sample to the next.
+ */
+static void design_filter(audio_src *s)
+{
+    const size_t length = (size_t)AUDIO_SRC_TAPS * s->L;
+    const double centre = (length - 1) / 2.0;
+    const double cutoff = SRC_CUTOFF * (s->out_rate < s->in_rate ? (double)s->out_rate / s->in_rate : 1.0);
+    const double i0_beta = bessel_i0(SRC_KAISER_BETA);
+
+    double taps[AUDIO_SRC_TAPS];
+    for(uint32_t p = 0; p < s->L; p++) {
+        double sum = 0;
+        for(int k = 0; k < AUDIO_SRC_TAPS; k++) {
+            size_t m = p + (size_t)k * s->L;
+            double t = (m - centre) / s->L;             // in input samples
+            double x = 2.0 * cutoff * t;
+            double sinc = (fabs(x) < 1e-9) ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            double r = (m - centre) / centre;
+            double window = bessel_i0(SRC_KAISER_BETA * sqrt(fmax(0.0, 1.0 - r * r))) / i0_beta;
+            taps[k] = sinc * window;
+            sum += taps[k];
+        }
+        // Tap k weighs the sample k behind the newest, so store them reversed
+        int16_t *phase = s->coeffs + p * AUDIO_SRC_TAPS;
+        for(int k = 0; k < AUDIO_SRC_TAPS; k++) {
+            phase[AUDIO_SRC_TAPS - 1 - k] = (int16_t)lrint(taps[k] / sum * SRC_GAIN * 32767.0);
+        }
+    }
+}
+
+void audio_src_reset(audio_src *s)
+{
+    // Start from silence, one window's worth
+    for(int c = 0; c < 2; c++) {
+        memset(s->history[c], 0, HISTORY_SAMPLES * sizeof(int16_t));
+        memset(s->history_odd[c], 0, HISTORY_SAMPLES * sizeof(int16_t));
+    }
+    s->fill = AUDIO_SRC_TAPS - 1;
+    s->pos = AUDIO_SRC_TAPS - 1;
+    s->phase = 0;
+}
+
+void audio_src_free(audio_src *s)
+{
+    heap_caps_free(s->coeffs);
+    for(int c = 0; c < 2; c++) {
+        heap_caps_free(s->history[c]);
+        heap_caps_free(s->history_odd[c]);
+    }
+    memset(s, 0, sizeof(*s));
+}
+
+bool audio_src_init(audio_src *s, uint32_t out_rate)
+{
+    memset(s, 0, sizeof(*s));
+    s->out_rate = out_rate;
+    for(int c = 0; c < 2; c++) {
+        s->history[c] = static_cast<int16_t*>(alloc_internal(HISTORY_SAMPLES * sizeof(int16_t)));
+        s->history_odd[c] = static_cast<int16_t*>(alloc_internal(HISTORY_SAMPLES * sizeof(int16_t)));
+        if(!s->history[c] || !s->history_odd[c]) {
+            audio_src_free(s);
+            return false;
+        }
+    }
+    audio_src_reset(s);
+    return true;
+}
+
+static bool configure(audio_src *s, uint32_t in_rate)
+{
+    uint32_t g = gcd(s->out_rate, in_rate);
+    uint32_t L = s->out_rate / g;
+    uint32_t M = in_rate / g;
+    if(L > AUDIO_SRC_MAX_PHASES) {
+        ESP_LOGE(TAG, "%d Hz -> %d Hz needs %d phases, max %d", (int)in_rate, (int)s->out_rate,
+                 (int)L, AUDIO_SRC_MAX_PHASES);
+        return false;
+    }
+
+    heap_caps_free(s->coeffs);
+    s->coeffs = NULL;
+    s->in_rate = 0;
+    s->L = L;
+    s->M = M;
+    s->bypass = (L == 1 && M == 1);
+    if(!s->bypass) {
+        s->coeffs = static_cast<int16_t*>(alloc_internal((size_t)L * AUDIO_SRC_TAPS * sizeof(int16_t)));
+        if(!s->coeffs) {
+            ESP_LOGE(TAG, "no memory for %d phases", (int)L);
+            return false;
+        }
+        design_filter(s);
+    }
+    s->in_rate = in_rate;
+    audio_src_reset(s);
+    LOGI_1("%d Hz -> %d Hz, %d/%d", (int)in_rate, (int)s->out_rate, (int)L, (int)M);
+    return true;
+}
+
+// Drops the samples no window needs any more
+static void compact(audio_src *s, size_t channels)
+{
+    size_t first = s->pos - (AUDIO_SRC_TAPS - 1);
+    if(first == 0) {
+        return;
+    }
+    size_t keep = (s->fill > first) ? s->fill - first : 0;
+    for(size_t c = 0; c < channels; c++) {
+        memmove(s->history[c], s->history[c] + first, keep * sizeof(int16_t));
+        if(keep > 1) {
+            memcpy(s->history_odd[c], s->history[c] + 1, (keep - 1) * sizeof(int16_t));
+        }
+    }
+    s->fill = keep;
+    s->pos -= first;
+}
+
+size_t audio_src_push(audio_src *s, const int16_t *samples, size_t frames, const format *fmt)
+{
+    if(fmt->bits_per_sample != 16 || fmt->channels < 1 || fmt->channels > 2) {
+        ESP_LOGE(TAG, "unsupported format: %d bit, %d channels", (int)fmt->bits_per_sample, (int)fmt->channels);
+        return 0;
+    }
+    if((uint32_t)fmt->sample_rate != s->in_rate && !configure(s, fmt->sample_rate)) {
+        return 0;
+    }
+    if(fmt->channels != s->channels) {
+        s->channels = fmt->channels;
+        audio_src_reset(s);
+    }
+
+    compact(s, s->channels);
+    if(frames > HISTORY_SAMPLES - s->fill) {
+        frames = HISTORY_SAMPLES - s->fill;
+    }
+    for(size_t c = 0; c < s->channels; c++) {
+        int16_t *history = s->history[c] + s->fill;
+        int16_t *history_odd = s->history_odd[c] + s->fill - 1;
+        const int16_t *in = samples + c;
+        for(size_t n = 0; n < frames; n++) {
+            history[n] = history_odd[n] = *in;
+            in += s->channels;
+        }
+    }
+    s->fill += frames;
+    return frames;
+}
+
+size_t IRAM_ATTR audio_src_pull(audio_src *s, int16_t *out, size_t max_frames)
+{
+    size_t frames = 0;
+    while(frames < max_frames && s->pos < s->fill) {
+        int16_t y[2] = { 0, 0 };
+        if(s->bypass) {
+            for(size_t c = 0; c < s->channels; c++) {
+                y[c] = (int16_t)(((int32_t)s->history[c][s->pos] * SRC_GAIN_Q15) >> 15);
+            }
+            s->pos++;
+        } else {
+            // Window history[pos - TAPS + 1 .. pos], read from whichever copy is word aligned there
+            size_t start = s->pos - (AUDIO_SRC_TAPS - 1);
+            const int16_t *taps = s->coeffs + s->phase * AUDIO_SRC_TAPS;
+            for(size_t c = 0; c < s->channels; c++) {
+                const int16_t *window = (start & 1) ? s->history_odd[c] + start - 1 : s->history[c] + start;
+                dsps_dotprod_s16(window, taps, &y[c], AUDIO_SRC_TAPS, 0);
+            }
+            s->phase += s->M;
+            s->pos += s->phase / s->L;
+            s->phase %= s->L;
+        }
+        if(s->channels == 1) {
+            y[1] = y[0];
+        }
+        out[0] = y[0];
+        out[1] = y[1];
+        out += 2;
+        frames++;
+    }
+    return frames;
+}
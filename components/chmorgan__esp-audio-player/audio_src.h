@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "audio_decode_types.h"
+
+/**
+ * Polyphase sample rate converter to a fixed 16-bit stereo output rate.
+ *
+ * The ratio out/in is reduced to L/M; each output sample is one
+ * AUDIO_SRC_TAPS long dot product (dsps_dotprod_s16) of the input history
+ * with one of the L phases of a Kaiser windowed sinc. The kernel loads
+ * 32 bits at a time, so each channel keeps a second copy of its history
+ * shifted by one sample and every window starts on an aligned address.
+ *
+ * Input is pushed a decoded block at a time (mono or stereo, any rate
+ * with L <= AUDIO_SRC_MAX_PHASES) and pulled out in PCM buffer sized
+ * pieces until it is used up.
+ */
+#define AUDIO_SRC_TAPS          32      /*< per phase; multiple of 4 for the dot product kernel */
+#define AUDIO_SRC_MAX_PHASES    320     /*< 22.05 kHz -> 48 kHz; 20 KB of coefficients */
+#define AUDIO_SRC_BLOCK_FRAMES  1152    /*< input frames taken per push */
+
+typedef struct {
+    uint32_t out_rate;
+    uint32_t in_rate;           /*< 0 until the first push */
+    uint32_t channels;
+    uint32_t L, M;              /*< interpolation, decimation */
+    bool bypass;                /*< in_rate == out_rate: copy */
+
+    int16_t *coeffs;            /*< L phases x AUDIO_SRC_TAPS, each reversed */
+    int16_t *history[2];        /*< per channel */
+    int16_t *history_odd[2];    /*< history_odd[c][k] == history[c][k + 1] */
+    size_t fill;                /*< samples in history */
+    size_t pos;                 /*< newest sample of the next output's window */
+    uint32_t phase;
+} audio_src;
+
+bool audio_src_init(audio_src *s, uint32_t out_rate);
+void audio_src_free(audio_src *s);
+
+/** Forget the input history, e.g. before unrelated audio follows */
+void audio_src_reset(audio_src *s);
+
+/**
+ * Appends up to AUDIO_SRC_BLOCK_FRAMES frames of 16-bit audio; a new input
+ * rate redesigns the filter and resets the history.
+ * @return frames taken (pull them out before pushing the rest), 0 if the
+ *         format is not supported
+ */
+size_t audio_src_push(audio_src *s, const int16_t *samples, size_t frames, const format *fmt);
+
+/** @return interleaved stereo frames written to out, 0 once the pushed input is used up */
+size_t audio_src_pull(audio_src *s, int16_t *out, size_t max_frames);
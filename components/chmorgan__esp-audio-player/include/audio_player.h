@@ -27,6 +27,30 @@
  * vs. detecting that the audio file transitioned by looking at
  * events indicating IDLE and then PLAYING within a short period of time.
  *
+ * - Files passed to audio_player_queue() play back to back with no gap:
+ * the next file is opened up and probed while the present one plays, and
+ * its decoder takes over at the last sample of the old one while the old
+ * PCM is still on its way to I2S. MP3 files with a LAME tag are trimmed
+ * to their real length (encoder delay and padding removed). Each switch
+ * is reported as COMPLETED_PLAYING_NEXT.
+ *
+ * - audio_player_seek() jumps within the present file. MP3 files without
+ * a Xing/VBRI TOC seek exactly once given an index of their frames, built
+ * off the audio task with audio_player_build_seek_index() and attached
+ * with audio_player_set_seek_index(); the application may cache it.
+ *
+ * - With CONFIG_AUDIO_PLAYER_MIXER, short clips passed to
+ * audio_player_play_clip() are mixed onto whatever is playing, or onto
+ * silence when nothing is, without touching the player state. They are
+ * added in just before write_fn, so they sound within the I2S DMA depth.
+ *
+ * - Every call without a handle drives the player audio_player_new() sets
+ * up. With CONFIG_AUDIO_PLAYER_MIXER, audio_player_instance_new() makes
+ * more, each with its own decoder, track queue, state and callback, driven
+ * by the audio_player_instance_*() calls. They have no output of their
+ * own: the main player's writer mixes their PCM in with the clips, over
+ * its music or over silence, and they may duck its music meanwhile.
+ *
  * State machine diagram
  *
  * cb is the callback function registered with audio_player_callback_register()
@@ -47,7 +71,9 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include "esp_err.h"
 #include "freertos/FreeRTOS.h"
@@ -57,6 +83,9 @@
 extern "C" {
 #endif
 
+/** A player instance; see audio_player_instance_new() */
+typedef struct audio_instance *audio_player_handle_t;
+
 typedef enum {
     AUDIO_PLAYER_STATE_IDLE,
     AUDIO_PLAYER_STATE_PLAYING,
@@ -104,6 +133,50 @@ typedef void (*audio_player_cb_t)(audio_player_cb_ctx_t *);
  */
 esp_err_t audio_player_play(FILE *fp);
 
+/**
+ * @brief Queue a file to play once the present one ends, without a gap.
+ *
+ * Starts it right away if nothing is playing. audio_player_play() and
+ * audio_player_stop() drop whatever is queued. Up to four files wait behind
+ * the one lined up next.
+ *
+ * @param fp - Same ownership rules as audio_player_play()
+ * @return
+ *    - ESP_OK: Success in queuing the file
+ *    - Others: Fail
+ */
+esp_err_t audio_player_queue(FILE *fp);
+
+/**
+ * @brief Byte source for audio_player_play_source()
+ *
+ * Lets the player decode from something other than a file, e.g. a network
+ * stream. The callbacks run on the audio task.
+ */
+typedef struct {
+    /** Up to len bytes into buf; returns the count, 0 at the end, -1 on error. May block. */
+    int (*read)(void *ctx, void *buf, size_t len);
+    /** Move to an absolute byte offset; returns 0, or -1 if the source cannot get there */
+    int (*seek)(void *ctx, int64_t offset);
+    /** Total size in bytes, or -1 if unknown (live streams). May be NULL. */
+    int64_t (*size)(void *ctx);
+    /** Release the source; called once when playback of it is over */
+    void (*close)(void *ctx);
+    void *ctx;
+} audio_player_source_t;
+
+/**
+ * @brief Play from a source instead of a FILE*
+ *
+ * Same semantics as audio_player_play(): on ESP_OK the player owns the source
+ * and calls its close() when done; otherwise the caller still does.
+ *
+ * @return
+ *    - ESP_OK: Success in queuing play request
+ *    - Others: Fail
+ */
+esp_err_t audio_player_play_source(const audio_player_source_t *source);
+
 /**
  * @brief Pause playback
  *
@@ -133,6 +206,166 @@ esp_err_t audio_player_resume(void);
  */
 esp_err_t audio_player_stop(void);
 
+/**
+ * @brief Jump to a position in the present file, playing or paused
+ *
+ * What was already decoded is dropped, so the jump is heard at once. WAV
+ * lands on the sample. MP3 lands within a frame (26 ms at 44.1 kHz) with a
+ * seek index, on the Xing/VBRI TOC if the file has one, and otherwise on
+ * an estimate from the bitrate that is exact only for constant bitrate.
+ * Not supported for FLAC, AAC and Opus.
+ *
+ * @return
+ *    - ESP_OK: Success in queuing seek request
+ *    - Others: Fail
+ */
+esp_err_t audio_player_seek(uint32_t position_ms);
+
+/**
+ * @brief Where playback of the present file is, for a progress bar
+ *
+ * The position is that of the audio last handed to write_fn; 0 when idle.
+ * The duration is the best known: exact for WAV, for MP3 with a LAME tag
+ * or seek index, estimated from the tag or bitrate otherwise, 0 if unknown.
+ * Either pointer may be NULL.
+ */
+esp_err_t audio_player_get_position(uint32_t *position_ms, uint32_t *duration_ms);
+
+/**
+ * @brief Offsets of MP3 frames, for seeking files without a TOC
+ *
+ * Entry n is where frame n * step_frames starts. Small enough to cache
+ * alongside the file: about 5 bytes per second of audio.
+ */
+typedef struct {
+    uint32_t step_frames;
+    uint32_t count;
+    uint32_t total_frames;      /*< MP3 frames in the file */
+    uint32_t file_bytes;        /*< of the file it was built from */
+    uint32_t *offsets;          /*< malloc()ed */
+} audio_player_seek_index_t;
+
+/**
+ * @brief Read every frame header of an MP3 file to build its seek index
+ *
+ * Blocks for as long as reading the file takes, so call it from a low
+ * priority task with a FILE* of its own, not the one being played.
+ *
+ * @return
+ *    - ESP_OK: index filled, free with audio_player_free_seek_index()
+ *    - ESP_ERR_NOT_SUPPORTED: not MP3, or it has a TOC of its own and needs no index
+ *    - Others: Fail
+ */
+esp_err_t audio_player_build_seek_index(FILE *fp, audio_player_seek_index_t *index);
+
+/**
+ * @brief Give the player the index of fp, playing or queued
+ *
+ * Also gives the exact duration. The player takes the offsets over
+ * whatever the outcome, and index is cleared; if fp is neither playing
+ * nor lined up next (or the sizes do not match) they are freed.
+ */
+esp_err_t audio_player_set_seek_index(FILE *fp, audio_player_seek_index_t *index);
+
+void audio_player_free_seek_index(audio_player_seek_index_t *index);
+
+/**
+ * @brief Length of a file, probed as the player would probe it
+ *
+ * For a library scanner: it reads only fp, so any task may call it with
+ * a FILE* of its own while something else plays. The length is what
+ * audio_player_get_position() would report before a seek index arrives.
+ *
+ * @param duration_ms - 0 if the length is not known
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_NOT_SUPPORTED: not a type the player decodes
+ *    - Others: Fail
+ */
+esp_err_t audio_player_get_file_duration(FILE *fp, uint32_t *duration_ms);
+
+/**
+ * @brief A sound effect for audio_player_play_clip()
+ *
+ * Raw 16-bit PCM at CONFIG_AUDIO_PLAYER_OUTPUT_RATE, kept in memory so it
+ * costs nothing to decode: const data in flash or a buffer in PSRAM.
+ * samples should be 4-byte aligned and must stay valid while the clip sounds.
+ */
+typedef struct {
+    const int16_t *samples;
+    size_t frames;
+    uint8_t channels;       /*< 1 (both sides) or 2 (interleaved) */
+} audio_player_clip_t;
+
+/**
+ * @brief Mix a clip onto the output, over music or silence
+ *
+ * Up to CONFIG_AUDIO_PLAYER_MIXER_VOICES clips sound at once; another
+ * replaces the oldest. Sums saturate rather than wrap.
+ *
+ * @param gain - 0.0 to 1.0
+ * @param duck - lower the music to the duck gain while the clip sounds
+ * @return
+ *    - ESP_OK: Success in queuing the clip
+ *    - ESP_ERR_NOT_SUPPORTED: built without CONFIG_AUDIO_PLAYER_MIXER
+ *    - Others: Fail
+ */
+esp_err_t audio_player_play_clip(const audio_player_clip_t *clip, float gain, bool duck);
+
+/**
+ * @brief Music gain (0.0 to 1.0) while a ducking clip sounds; 0.25 (-12 dB) by default
+ */
+esp_err_t audio_player_set_duck_gain(float gain);
+
+/**
+ * @brief Latest spectrum of what is playing, for a visualiser
+ *
+ * With CONFIG_AUDIO_PLAYER_SPECTRUM the output is analysed about 30 times
+ * a second. Lock-free; callable from any task, e.g. an LVGL timer.
+ *
+ * @param levels - filled low to high frequency, 0 (-60 dB or less) to 255 (full scale)
+ * @param count - at most CONFIG_AUDIO_PLAYER_SPECTRUM_BANDS are filled
+ * @return number of the analysis read; the same as last time means nothing
+ *         new has played (paused, stopped). 0 before the first, or if not
+ *         supported.
+ */
+uint32_t audio_player_get_spectrum(uint8_t *levels, size_t count);
+
+/**
+ * @brief How many of the CONFIG_AUDIO_PLAYER_PCM_BUFFERS are in use
+ *
+ * All of them are allocated up front; fewer in use means less audio
+ * decoded ahead, so pause, stop and seek are heard sooner. A lower depth
+ * takes effect as the writer hands buffers back, a higher one with the
+ * next buffer it hands back. All are in use until this is called.
+ *
+ * @param depth - 2 to CONFIG_AUDIO_PLAYER_PCM_BUFFERS
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: depth out of range
+ */
+esp_err_t audio_player_set_pcm_depth(uint8_t depth);
+
+uint8_t audio_player_get_pcm_depth(void);
+
+/**
+ * @brief Decode timing of the main player since the last call
+ *
+ * A decode that takes longer than the decoded PCM buffers last is heard
+ * as an underrun; compare decode_max_us with frame_us times the depth.
+ */
+typedef struct {
+    uint32_t frames;            /*< decoder calls, reading included */
+    uint32_t decode_sum_us;
+    uint32_t decode_max_us;     /*< slowest single call */
+    uint32_t frame_us;          /*< audio in the last frame that produced any, 0 if none did */
+} audio_player_decode_stats_t;
+
+/**
+ * @brief Copy the decode timing and start counting afresh; any task
+ */
+esp_err_t audio_player_take_decode_stats(audio_player_decode_stats_t *stats);
+
 /**
  * @brief Register callback for audio event
  *
@@ -153,12 +386,28 @@ typedef esp_err_t (*audio_player_mute_fn)(AUDIO_PLAYER_MUTE_SETTING setting);
 typedef esp_err_t (*audio_reconfig_std_clock)(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch);
 typedef esp_err_t (*audio_player_write_fn)(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms);
 
+/**
+ * What write_fn and clk_set_fn take, for audio_player_config_t::output_caps.
+ * Decoded audio is handed over as it is when the sink takes its format and
+ * converted to the nearest one it takes otherwise: mono and stereo into
+ * each other, other widths to 16-bit (which a sink must then take).
+ * 0 keeps the old behaviour: stereo, at whatever width was decoded.
+ * Ignored with CONFIG_AUDIO_PLAYER_RESAMPLE, whose output is 16-bit stereo.
+ */
+#define AUDIO_PLAYER_OUTPUT_MONO    (1 << 0)
+#define AUDIO_PLAYER_OUTPUT_STEREO  (1 << 1)
+#define AUDIO_PLAYER_OUTPUT_8BIT    (1 << 2)    /*< unsigned, as in WAV */
+#define AUDIO_PLAYER_OUTPUT_16BIT   (1 << 3)
+#define AUDIO_PLAYER_OUTPUT_24BIT   (1 << 4)    /*< packed */
+#define AUDIO_PLAYER_OUTPUT_32BIT   (1 << 5)
+
 typedef struct {
     audio_player_mute_fn mute_fn;
     audio_reconfig_std_clock clk_set_fn;
     audio_player_write_fn write_fn;
     UBaseType_t priority; /*< FreeRTOS task priority */
     BaseType_t coreID; /*< ESP32 core ID */
+    uint32_t output_caps; /*< AUDIO_PLAYER_OUTPUT_* flags */
 } audio_player_config_t;
 
 /**
@@ -177,6 +426,59 @@ esp_err_t audio_player_new(audio_player_config_t config);
  */
 esp_err_t audio_player_delete();
 
+/**
+ * @brief The instance audio_player_new() set up, which the calls without a handle drive
+ *
+ * @return NULL if there is none
+ */
+audio_player_handle_t audio_player_get_handle(void);
+
+typedef struct {
+    UBaseType_t priority; /*< FreeRTOS task priority of its decoder */
+    BaseType_t coreID; /*< ESP32 core ID */
+    float gain; /*< 0.0 to 1.0, as it is mixed in */
+    bool duck; /*< lower the main player's music to the duck gain while this plays */
+} audio_player_instance_config_t;
+
+/**
+ * @brief Another player, decoding on its own and mixed onto the main one's output
+ *
+ * Plays anything the main player does, on a task of its own, and is
+ * mixed in by the main player's writer after the clips: over its music,
+ * paused or not, or over silence. Its decoder is paced by that writer, so
+ * if it falls behind it is briefly not heard rather than delaying the
+ * music. Up to CONFIG_AUDIO_PLAYER_INSTANCES - 1 at once, after
+ * audio_player_new() and deleted before audio_player_delete().
+ *
+ * @return
+ *    - ESP_OK: *handle is ready for the audio_player_instance_*() calls
+ *    - ESP_ERR_NOT_SUPPORTED: built without CONFIG_AUDIO_PLAYER_MIXER
+ *    - ESP_ERR_INVALID_STATE: there is no main player
+ *    - ESP_ERR_NO_MEM: out of memory, or all instances taken
+ */
+esp_err_t audio_player_instance_new(const audio_player_instance_config_t *config, audio_player_handle_t *handle);
+
+/**
+ * @brief Stop an instance from audio_player_instance_new() and free it
+ *
+ * @return ESP_FAIL if its task did not end, when the handle stays valid
+ */
+esp_err_t audio_player_instance_delete(audio_player_handle_t handle);
+
+/** As the calls of the same name without "instance_", for the given instance (the main one included) */
+audio_player_state_t audio_player_instance_get_state(audio_player_handle_t handle);
+esp_err_t audio_player_instance_callback_register(audio_player_handle_t handle, audio_player_cb_t call_back,
+                                                  void *user_ctx);
+esp_err_t audio_player_instance_play(audio_player_handle_t handle, FILE *fp);
+esp_err_t audio_player_instance_queue(audio_player_handle_t handle, FILE *fp);
+esp_err_t audio_player_instance_play_source(audio_player_handle_t handle, const audio_player_source_t *source);
+esp_err_t audio_player_instance_pause(audio_player_handle_t handle);
+esp_err_t audio_player_instance_resume(audio_player_handle_t handle);
+esp_err_t audio_player_instance_stop(audio_player_handle_t handle);
+esp_err_t audio_player_instance_seek(audio_player_handle_t handle, uint32_t position_ms);
+esp_err_t audio_player_instance_get_position(audio_player_handle_t handle, uint32_t *position_ms,
+                                             uint32_t *duration_ms);
+
 #ifdef __cplusplus
 }
 #endif
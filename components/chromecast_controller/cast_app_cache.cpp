@@ -0,0 +1,123 @@
+#include "cast_app_cache.h"
+#include <cstring>
+
+CastAppCache::Entry CastAppCache::entries[MAX_DEVICES];
+uint32_t CastAppCache::use_counter = 0;
+portMUX_TYPE CastAppCache::lock = portMUX_INITIALIZER_UNLOCKED;
+
+template <size_t N>
+static void copy_string(char (&dest)[N], const char* src) {
+    strncpy(dest, src, N - 1);
+    dest[N - 1] = '\0';
+}
+
+CastAppCache::Entry* CastAppCache::find(const char* device) {
+    if (!device || device[0] == '\0') {
+        return nullptr;
+    }
+    for (Entry& entry : entries) {
+        if (strncmp(entry.device, device, sizeof(entry.device) - 1) == 0) {
+            entry.last_used = ++use_counter;
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+CastAppCache::Entry* CastAppCache::find_or_add(const char* device) {
+    Entry* entry = find(device);
+    if (entry || !device || device[0] == '\0') {
+        return entry;
+    }
+
+    // An unused entry has last_used 0, so it goes before any in use
+    Entry* oldest = &entries[0];
+    for (Entry& candidate : entries) {
+        if (candidate.last_used < oldest->last_used) {
+            oldest = &candidate;
+        }
+    }
+    memset(oldest, 0, sizeof(*oldest));
+    copy_string(oldest->device, device);
+    oldest->last_used = ++use_counter;
+    return oldest;
+}
+
+void CastAppCache::store_session(const char* device, const Session& session) {
+    taskENTER_CRITICAL(&lock);
+    Entry* entry = find_or_add(device);
+    if (entry) {
+        entry->session = session;
+        entry->has_session = true;
+    }
+    taskEXIT_CRITICAL(&lock);
+}
+
+bool CastAppCache::find_session(const char* device, Session& out) {
+    taskENTER_CRITICAL(&lock);
+    Entry* entry = find(device);
+    bool found = entry && entry->has_session;
+    if (found) {
+        out = entry->session;
+    }
+    taskEXIT_CRITICAL(&lock);
+    return found;
+}
+
+void CastAppCache::forget_session(const char* device) {
+    taskENTER_CRITICAL(&lock);
+    Entry* entry = find(device);
+    if (entry) {
+        entry->has_session = false;
+    }
+    taskEXIT_CRITICAL(&lock);
+}
+
+void CastAppCache::store_availability(const char* device, const char* app_id, bool available) {
+    if (!app_id || app_id[0] == '\0') {
+        return;
+    }
+
+    taskENTER_CRITICAL(&lock);
+    Entry* entry = find_or_add(device);
+    if (entry) {
+        // Slots fill in order and are never freed: the app's own slot comes
+        // before any free one; with neither, the oldest answer goes
+        TickType_t now = xTaskGetTickCount();
+        AppAvailability* slot = &entry->apps[0];
+        for (AppAvailability& app : entry->apps) {
+            if (app.app_id[0] == '\0' || strcmp(app.app_id, app_id) == 0) {
+                slot = &app;
+                break;
+            }
+            if (now - app.stored_at > now - slot->stored_at) {
+                slot = &app;
+            }
+        }
+        copy_string(slot->app_id, app_id);
+        slot->available = available;
+        slot->stored_at = now;
+    }
+    taskEXIT_CRITICAL(&lock);
+}
+
+CastAppCache::Availability CastAppCache::find_availability(const char* device, const char* app_id) {
+    Availability result = AVAILABILITY_UNKNOWN;
+    if (!app_id) {
+        return result;
+    }
+
+    taskENTER_CRITICAL(&lock);
+    Entry* entry = find(device);
+    if (entry) {
+        for (const AppAvailability& app : entry->apps) {
+            if (app.app_id[0] != '\0' && strcmp(app.app_id, app_id) == 0 &&
+                xTaskGetTickCount() - app.stored_at < pdMS_TO_TICKS(AVAILABILITY_TTL_MS)) {
+                result = app.available ? AVAILABILITY_AVAILABLE : AVAILABILITY_UNAVAILABLE;
+                break;
+            }
+        }
+    }
+    taskEXIT_CRITICAL(&lock);
+    return result;
+}
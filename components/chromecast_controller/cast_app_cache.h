@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "cast_payload_parser.h"
+
+/**
+ * CastAppCache - What each Cast device last said about its receiver apps
+ *
+ * Features:
+ * - Per device (UUID, else address): the app session last connected to, so
+ *   a reconnect can open the app's virtual connection and ask for its
+ *   MEDIA_STATUS in the same write as the receiver GET_STATUS, instead of
+ *   waiting for RECEIVER_STATUS to name the transport first
+ * - Per device and app: the last GET_APP_AVAILABILITY answer, kept for
+ *   AVAILABILITY_TTL_MS
+ * - Shared by every controller in the process, least recently used device
+ *   evicted; RAM only, a session does not outlive the speaker's app anyway
+ *
+ * Thread-safe; every call copies in or out under a spinlock.
+ */
+class CastAppCache {
+public:
+    static constexpr size_t MAX_DEVICES = 8;
+    static constexpr size_t MAX_APPS = 4;           // Availability answers per device
+    static constexpr uint32_t AVAILABILITY_TTL_MS = 10 * 60 * 1000;
+
+    enum Availability {
+        AVAILABILITY_UNKNOWN,
+        AVAILABILITY_AVAILABLE,
+        AVAILABILITY_UNAVAILABLE
+    };
+
+    using Session = CastPayload::Application;
+
+    // The session is only a guess until the device's RECEIVER_STATUS confirms it
+    static void store_session(const char* device, const Session& session);
+    static bool find_session(const char* device, Session& out);
+    static void forget_session(const char* device);
+
+    static void store_availability(const char* device, const char* app_id, bool available);
+    static Availability find_availability(const char* device, const char* app_id);
+
+private:
+    struct AppAvailability {
+        char app_id[sizeof(Session::app_id)];
+        bool available;
+        TickType_t stored_at;
+    };
+
+    struct Entry {
+        char device[48];            // Empty: unused
+        uint32_t last_used;
+        bool has_session;
+        Session session;
+        AppAvailability apps[MAX_APPS];
+    };
+
+    static Entry entries[MAX_DEVICES];
+    static uint32_t use_counter;
+    static portMUX_TYPE lock;
+
+    static Entry* find(const char* device);
+    static Entry* find_or_add(const char* device);
+};
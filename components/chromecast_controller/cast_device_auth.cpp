@@ -0,0 +1,343 @@
+#include "cast_device_auth.h"
+#include <cstring>
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "mbedtls/md.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/ssl.h"
+#include "mem_tag.h"
+#include "chromecast_protobuf/cast_channel.pb-c.h"
+
+static const char* TAG = "CastDeviceAuth";
+
+// certs/cast_roots.pem, NUL-terminated (EMBED_TXTFILES)
+extern const uint8_t cast_roots_pem_start[] asm("_binary_cast_roots_pem_start");
+extern const uint8_t cast_roots_pem_end[] asm("_binary_cast_roots_pem_end");
+
+namespace {
+
+// NVS blob: TLS peer certificate fingerprint followed by the device certificate fingerprint
+struct CachedAuth {
+    uint8_t peer_fingerprint[CastDeviceAuth::FINGERPRINT_SIZE];
+    uint8_t device_fingerprint[CastDeviceAuth::FINGERPRINT_SIZE];
+};
+
+void sha256(const uint8_t* data, size_t length, uint8_t* out) {
+    mbedtls_sha256(data, length, out, 0);
+}
+
+void* protobuf_alloc(void*, size_t size) {
+    return mem_tag_malloc(MEM_TAG_CAST, size);
+}
+
+void protobuf_free(void*, void* ptr) {
+    mem_tag_free(MEM_TAG_CAST, ptr);
+}
+
+ProtobufCAllocator protobuf_allocator = { protobuf_alloc, protobuf_free, nullptr };
+
+}  // namespace
+
+CastDeviceAuth::CastDeviceAuth()
+    : status(AUTH_IDLE)
+    , device_key()
+    , peer_cert(nullptr)
+    , peer_cert_length(0)
+    , peer_fingerprint()
+    , nonce()
+    , has_nonce(false)
+    , has_trusted_roots(false)
+{
+    mbedtls_x509_crt_init(&trusted_roots);
+}
+
+CastDeviceAuth::~CastDeviceAuth() {
+    mbedtls_x509_crt_free(&trusted_roots);
+}
+
+const char* CastDeviceAuth::status_name(Status status) {
+    switch (status) {
+        case AUTH_IDLE:     return "idle";
+        case AUTH_PENDING:  return "pending";
+        case AUTH_VERIFIED: return "verified";
+        case AUTH_CACHED:   return "cached";
+        case AUTH_FAILED:   return "failed";
+    }
+    return "unknown";
+}
+
+void CastDeviceAuth::reset() {
+    status = AUTH_IDLE;
+    peer_cert = nullptr;
+    peer_cert_length = 0;
+    has_nonce = false;
+}
+
+bool CastDeviceAuth::set_trusted_roots(const uint8_t* certs, size_t length) {
+    mbedtls_x509_crt_free(&trusted_roots);
+    mbedtls_x509_crt_init(&trusted_roots);
+    has_trusted_roots = false;
+
+    if (!certs || length == 0) {
+        return true;
+    }
+
+    // PEM input must include its terminating NUL; anything else is parsed as DER
+    int ret = mbedtls_x509_crt_parse(&trusted_roots, certs, length);
+    if (ret < 0) {
+        ESP_LOGE(TAG, "Failed to parse trusted roots: -0x%04x", -ret);
+        return false;
+    }
+    has_trusted_roots = true;
+    return true;
+}
+
+bool CastDeviceAuth::load_bundled_roots(mbedtls_x509_crt* roots) const {
+    // Comments alone parse as no certificate at all
+    int ret = mbedtls_x509_crt_parse(roots, cast_roots_pem_start, cast_roots_pem_end - cast_roots_pem_start);
+    if (ret < 0 || roots->raw.p == nullptr) {
+        ESP_LOGE(TAG, "No Cast root CA in certs/cast_roots.pem (-0x%04x), devices cannot be authenticated", -ret);
+        return false;
+    }
+    if (ret > 0) {
+        ESP_LOGW(TAG, "%d bundled Cast root certificates could not be parsed", ret);
+    }
+    return true;
+}
+
+bool CastDeviceAuth::begin(esp_tls_t* tls, const std::string& key) {
+    reset();
+    device_key = key;
+
+    mbedtls_ssl_context* ssl = tls ? static_cast<mbedtls_ssl_context*>(esp_tls_get_ssl_context(tls)) : nullptr;
+    const mbedtls_x509_crt* cert = ssl ? mbedtls_ssl_get_peer_cert(ssl) : nullptr;
+    if (!cert) {
+        ESP_LOGW(TAG, "TLS peer certificate not available, device cannot be authenticated");
+        return false;
+    }
+
+    peer_cert = cert->raw.p;
+    peer_cert_length = cert->raw.len;
+    sha256(peer_cert, peer_cert_length, peer_fingerprint);
+    return true;
+}
+
+bool CastDeviceAuth::nvs_key(char (&key)[16]) const {
+    if (device_key.empty()) {
+        return false;
+    }
+
+    // NVS keys are limited to 15 characters, so use a short digest of the UUID.
+    // 'a' keys were written before the chain had to be anchored and are ignored
+    uint8_t digest[32];
+    sha256(reinterpret_cast<const uint8_t*>(device_key.data()), device_key.size(), digest);
+    key[0] = 'b';
+    for (int i = 0; i < 7; i++) {
+        snprintf(&key[1 + i * 2], 3, "%02x", digest[i]);
+    }
+    return true;
+}
+
+bool CastDeviceAuth::check_cache() {
+    char key[16];
+    if (!peer_cert || !nvs_key(key)) {
+        return false;
+    }
+
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+
+    CachedAuth cached;
+    size_t size = sizeof(cached);
+    esp_err_t err = nvs_get_blob(handle, key, &cached, &size);
+    nvs_close(handle);
+
+    // The TLS handshake already proved possession of this certificate's key
+    if (err == ESP_OK && size == sizeof(cached) &&
+        memcmp(cached.peer_fingerprint, peer_fingerprint, FINGERPRINT_SIZE) == 0) {
+        ESP_LOGI(TAG, "Device %s matches cached authentication", device_key.c_str());
+        status = AUTH_CACHED;
+        return true;
+    }
+    return false;
+}
+
+bool CastDeviceAuth::store_cache(const uint8_t* device_fingerprint) {
+    char key[16];
+    if (!nvs_key(key)) {
+        return false;
+    }
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to open NVS for auth cache: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    CachedAuth cached;
+    memcpy(cached.peer_fingerprint, peer_fingerprint, FINGERPRINT_SIZE);
+    memcpy(cached.device_fingerprint, device_fingerprint, FINGERPRINT_SIZE);
+    err = nvs_set_blob(handle, key, &cached, sizeof(cached));
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to store auth cache: %s", esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+size_t CastDeviceAuth::build_challenge(uint8_t* out, size_t max_size) {
+    esp_fill_random(nonce, sizeof(nonce));
+    has_nonce = true;
+
+    Extensions__Api__CastChannel__AuthChallenge challenge = EXTENSIONS__API__CAST_CHANNEL__AUTH_CHALLENGE__INIT;
+    challenge.has_signature_algorithm = true;
+    challenge.signature_algorithm = EXTENSIONS__API__CAST_CHANNEL__SIGNATURE_ALGORITHM__RSASSA_PKCS1v15;
+    challenge.has_sender_nonce = true;
+    challenge.sender_nonce.data = nonce;
+    challenge.sender_nonce.len = sizeof(nonce);
+    challenge.has_hash_algorithm = true;
+    challenge.hash_algorithm = EXTENSIONS__API__CAST_CHANNEL__HASH_ALGORITHM__SHA256;
+
+    Extensions__Api__CastChannel__DeviceAuthMessage message = EXTENSIONS__API__CAST_CHANNEL__DEVICE_AUTH_MESSAGE__INIT;
+    message.challenge = &challenge;
+
+    size_t size = extensions__api__cast_channel__device_auth_message__get_packed_size(&message);
+    if (size > max_size) {
+        ESP_LOGE(TAG, "Auth challenge does not fit in %d bytes", max_size);
+        return 0;
+    }
+    extensions__api__cast_channel__device_auth_message__pack(&message, out);
+    status = AUTH_PENDING;
+    return size;
+}
+
+bool CastDeviceAuth::verify_response(const uint8_t* data, size_t length) {
+    if (status != AUTH_PENDING || !peer_cert) {
+        ESP_LOGW(TAG, "Unexpected auth response (status: %s)", status_name(status));
+        return false;
+    }
+
+    // Runs once per connection; the certificates and signature it unpacks go to PSRAM
+    Extensions__Api__CastChannel__DeviceAuthMessage* message =
+        extensions__api__cast_channel__device_auth_message__unpack(&protobuf_allocator, length, data);
+    if (!message) {
+        ESP_LOGE(TAG, "Failed to unpack DeviceAuthMessage (%u bytes)", length);
+        status = AUTH_FAILED;
+        return false;
+    }
+
+    bool verified = false;
+    int64_t start_us = esp_timer_get_time();
+    const Extensions__Api__CastChannel__AuthResponse* response = message->response;
+    mbedtls_x509_crt device_cert;
+    mbedtls_x509_crt_init(&device_cert);
+    mbedtls_x509_crt bundled_roots;
+    mbedtls_x509_crt_init(&bundled_roots);
+
+    do {
+        if (message->error) {
+            ESP_LOGE(TAG, "Device reported auth error %d", message->error->error_type);
+            break;
+        }
+        if (!response) {
+            ESP_LOGE(TAG, "DeviceAuthMessage has no response");
+            break;
+        }
+
+        // The device must echo our nonce if it signed over one
+        bool with_nonce = response->has_sender_nonce;
+        if (with_nonce && (!has_nonce || response->sender_nonce.len != sizeof(nonce) ||
+                           memcmp(response->sender_nonce.data, nonce, sizeof(nonce)) != 0)) {
+            ESP_LOGE(TAG, "Auth response nonce mismatch");
+            break;
+        }
+
+        int ret = mbedtls_x509_crt_parse_der(&device_cert, response->client_auth_certificate.data,
+                                             response->client_auth_certificate.len);
+        if (ret != 0) {
+            ESP_LOGE(TAG, "Failed to parse device certificate: -0x%04x", -ret);
+            break;
+        }
+
+        // A self-signed device certificate would sign anything: the chain must be anchored
+        mbedtls_x509_crt* roots = &trusted_roots;
+        if (!has_trusted_roots) {
+            if (!load_bundled_roots(&bundled_roots)) {
+                break;
+            }
+            roots = &bundled_roots;
+        }
+        for (size_t i = 0; i < response->n_intermediate_certificate; i++) {
+            mbedtls_x509_crt_parse_der(&device_cert, response->intermediate_certificate[i].data,
+                                       response->intermediate_certificate[i].len);
+        }
+        uint32_t flags = 0;
+        ret = mbedtls_x509_crt_verify(&device_cert, roots, nullptr, nullptr, &flags, nullptr, nullptr);
+        if (ret != 0) {
+            ESP_LOGE(TAG, "Device certificate chain rejected (flags 0x%08x)", flags);
+            break;
+        }
+
+        // Signed data is the sender nonce (when echoed) followed by the TLS peer certificate
+        bool use_sha256 = response->has_hash_algorithm &&
+                          response->hash_algorithm == EXTENSIONS__API__CAST_CHANNEL__HASH_ALGORITHM__SHA256;
+        mbedtls_md_type_t md_type = use_sha256 ? MBEDTLS_MD_SHA256 : MBEDTLS_MD_SHA1;
+        const mbedtls_md_info_t* md_info = mbedtls_md_info_from_type(md_type);
+        uint8_t hash[32];
+        mbedtls_md_context_t md;
+        mbedtls_md_init(&md);
+        ret = mbedtls_md_setup(&md, md_info, 0);
+        if (ret == 0) ret = mbedtls_md_starts(&md);
+        if (ret == 0 && with_nonce) ret = mbedtls_md_update(&md, response->sender_nonce.data, response->sender_nonce.len);
+        if (ret == 0) ret = mbedtls_md_update(&md, peer_cert, peer_cert_length);
+        if (ret == 0) ret = mbedtls_md_finish(&md, hash);
+        mbedtls_md_free(&md);
+        if (ret != 0) {
+            ESP_LOGE(TAG, "Failed to hash signed data: -0x%04x", -ret);
+            break;
+        }
+
+        if (response->has_signature_algorithm &&
+            response->signature_algorithm == EXTENSIONS__API__CAST_CHANNEL__SIGNATURE_ALGORITHM__RSASSA_PSS) {
+            mbedtls_pk_rsassa_pss_options options = { md_type, MBEDTLS_RSA_SALT_LEN_ANY };
+            ret = mbedtls_pk_verify_ext(MBEDTLS_PK_RSASSA_PSS, &options, &device_cert.pk, md_type,
+                                        hash, mbedtls_md_get_size(md_info),
+                                        response->signature.data, response->signature.len);
+        } else {
+            ret = mbedtls_pk_verify(&device_cert.pk, md_type, hash, mbedtls_md_get_size(md_info),
+                                    response->signature.data, response->signature.len);
+        }
+        if (ret != 0) {
+            ESP_LOGE(TAG, "Auth response signature invalid: -0x%04x", -ret);
+            break;
+        }
+
+        verified = true;
+    } while (false);
+
+    // Only an anchored chain gets here, so only such a result is cached
+    if (verified) {
+        uint8_t device_fingerprint[FINGERPRINT_SIZE];
+        sha256(response->client_auth_certificate.data, response->client_auth_certificate.len, device_fingerprint);
+        store_cache(device_fingerprint);
+        ESP_LOGI(TAG, "Device %s authenticated in %lld ms", device_key.c_str(),
+                 (esp_timer_get_time() - start_us) / 1000);
+    }
+
+    mbedtls_x509_crt_free(&bundled_roots);
+    mbedtls_x509_crt_free(&device_cert);
+    extensions__api__cast_channel__device_auth_message__free_unpacked(message, &protobuf_allocator);
+    status = verified ? AUTH_VERIFIED : AUTH_FAILED;
+    return verified;
+}
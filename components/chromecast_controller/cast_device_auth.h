@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "esp_tls.h"
+#include "mbedtls/x509_crt.h"
+
+/**
+ * CastDeviceAuth - urn:x-cast:com.google.cast.tp.deviceauth handshake
+ *
+ * Features:
+ * - Builds the binary DeviceAuthMessage challenge with a fresh sender nonce
+ * - Verifies the AuthResponse signature over (nonce || TLS peer certificate)
+ *   with the device certificate key, RSASSA-PKCS1v15 or RSASSA-PSS
+ * - Chain check of the device certificate against the Cast roots bundled in
+ *   certs/cast_roots.pem, or the roots given to set_trusted_roots(); with
+ *   no root to anchor the chain every response fails
+ * - Per-device NVS cache of verified fingerprints, so reconnecting to a known
+ *   device with the same TLS certificate skips the RSA verify entirely
+ *
+ * Not thread-safe; ChromecastController drives it from its connect and
+ * receive paths, which never run concurrently for one connection.
+ */
+class CastDeviceAuth {
+public:
+    static constexpr size_t NONCE_SIZE = 16;
+    static constexpr size_t FINGERPRINT_SIZE = 32;    // SHA-256
+    static constexpr size_t CHALLENGE_MAX_SIZE = 64;
+    static constexpr const char* NVS_NAMESPACE = "cast_auth";
+
+    enum Status {
+        AUTH_IDLE,
+        AUTH_PENDING,       // Challenge sent, waiting for the response
+        AUTH_VERIFIED,      // Signature checked on this connection
+        AUTH_CACHED,        // TLS certificate matched a previously verified device
+        AUTH_FAILED
+    };
+
+    CastDeviceAuth();
+    ~CastDeviceAuth();
+
+    /**
+     * Capture the TLS peer certificate of a freshly established connection.
+     * @return false if the certificate is not available (e.g. not kept by mbedtls)
+     */
+    bool begin(esp_tls_t* tls, const std::string& device_key);
+
+    // True if the TLS certificate matches the cached fingerprint for this device
+    bool check_cache();
+
+    // Serialise a DeviceAuthMessage challenge into out; returns its size or 0
+    size_t build_challenge(uint8_t* out, size_t max_size);
+
+    // Verify a binary DeviceAuthMessage response and cache the result on success
+    bool verify_response(const uint8_t* data, size_t length);
+
+    // PEM or DER trust anchors in place of the bundled roots; nullptr goes back to them
+    bool set_trusted_roots(const uint8_t* certs, size_t length);
+
+    void reset();
+    Status get_status() const { return status; }
+    static const char* status_name(Status status);
+
+private:
+    Status status;
+    std::string device_key;
+    const uint8_t* peer_cert;       // Owned by the TLS session, valid while it is open
+    size_t peer_cert_length;
+    uint8_t peer_fingerprint[FINGERPRINT_SIZE];
+    uint8_t nonce[NONCE_SIZE];
+    bool has_nonce;
+
+    mbedtls_x509_crt trusted_roots;
+    bool has_trusted_roots;         // Set with set_trusted_roots(); else the bundle, parsed per verify
+
+    bool nvs_key(char (&key)[16]) const;
+    bool load_bundled_roots(mbedtls_x509_crt* roots) const;
+    bool store_cache(const uint8_t* device_fingerprint);
+};
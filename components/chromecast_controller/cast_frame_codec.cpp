@@ -0,0 +1,30 @@
+#include "cast_frame_codec.h"
+
+void CastFrameCodec::write_header(uint8_t* out, uint32_t message_length) {
+    out[0] = (message_length >> 24) & 0xFF;
+    out[1] = (message_length >> 16) & 0xFF;
+    out[2] = (message_length >> 8) & 0xFF;
+    out[3] = message_length & 0xFF;
+}
+
+uint32_t CastFrameCodec::read_header(const uint8_t* in) {
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | (uint32_t)in[3];
+}
+
+CastFrameCodec::Status CastFrameCodec::next_frame(const uint8_t* data, size_t length, size_t max_message_length,
+                                                  const uint8_t*& message, uint32_t& message_length) {
+    message = nullptr;
+    message_length = 0;
+    if (length < HEADER_SIZE) {
+        return FRAME_PARTIAL;
+    }
+    message_length = read_header(data);
+    if (message_length == 0 || message_length > max_message_length) {
+        return FRAME_INVALID;
+    }
+    if (length - HEADER_SIZE < message_length) {
+        return FRAME_PARTIAL;
+    }
+    message = data + HEADER_SIZE;
+    return FRAME_OK;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * CastFrameCodec - Length-prefixed framing of the Cast v2 stream
+ *
+ * Each CastMessage travels as a 4-byte big-endian length followed by the
+ * serialised protobuf. The codec only splits and prefixes frames; decoding
+ * the message is CastMessageDecoder's job. No ESP-IDF dependency, so the
+ * host build can fuzz it.
+ */
+class CastFrameCodec {
+public:
+    static constexpr size_t HEADER_SIZE = 4;
+
+    enum Status {
+        FRAME_OK,           // A complete frame is at the start of the data
+        FRAME_PARTIAL,      // More bytes are needed
+        FRAME_INVALID,      // Length prefix of 0 or over the limit; the stream cannot be resynchronised
+    };
+
+    static void write_header(uint8_t* out, uint32_t message_length);
+    static uint32_t read_header(const uint8_t* in);
+
+    /**
+     * Look for a frame at the start of data.
+     * @param message_length set whenever the header is complete, so a
+     *        FRAME_PARTIAL caller knows how much room the frame needs
+     * @param message set on FRAME_OK; the frame is HEADER_SIZE + message_length bytes
+     */
+    static Status next_frame(const uint8_t* data, size_t length, size_t max_message_length,
+                             const uint8_t*& message, uint32_t& message_length);
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include "json_writer.h"
+
+/**
+ * CastJsonWriter - the shared compact JsonWriter with an inline buffer,
+ * under the name the Cast senders have always used
+ *
+ * Typical use:
+ *   CastJsonWriter<128> w;
+ *   w.field("type", "PING").field_uint("requestId", 7).end();
+ *   send(w.c_str());
+ */
+template <size_t N>
+using CastJsonWriter = JsonBuffer<N>;
@@ -0,0 +1,123 @@
+#include "cast_message_view.h"
+
+namespace {
+
+// Protobuf wire types
+constexpr uint32_t WIRE_VARINT = 0;
+constexpr uint32_t WIRE_FIXED64 = 1;
+constexpr uint32_t WIRE_LENGTH_DELIMITED = 2;
+constexpr uint32_t WIRE_FIXED32 = 5;
+
+// CastMessage field numbers (cast_channel.proto)
+constexpr uint32_t FIELD_PROTOCOL_VERSION = 1;
+constexpr uint32_t FIELD_SOURCE_ID = 2;
+constexpr uint32_t FIELD_DESTINATION_ID = 3;
+constexpr uint32_t FIELD_NAMESPACE = 4;
+constexpr uint32_t FIELD_PAYLOAD_TYPE = 5;
+constexpr uint32_t FIELD_PAYLOAD_UTF8 = 6;
+constexpr uint32_t FIELD_PAYLOAD_BINARY = 7;
+
+constexpr uint32_t REQUIRED_FIELDS = (1u << FIELD_PROTOCOL_VERSION) | (1u << FIELD_SOURCE_ID) |
+                                     (1u << FIELD_DESTINATION_ID) | (1u << FIELD_NAMESPACE) |
+                                     (1u << FIELD_PAYLOAD_TYPE);
+
+}  // namespace
+
+bool CastMessageDecoder::read_varint(const uint8_t*& pos, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= end) {
+            return false;
+        }
+        uint8_t byte = *pos++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false; // More than 10 bytes
+}
+
+bool CastMessageDecoder::skip_field(const uint8_t*& pos, const uint8_t* end, uint32_t wire_type) {
+    uint64_t value;
+    switch (wire_type) {
+        case WIRE_VARINT:
+            return read_varint(pos, end, value);
+        case WIRE_FIXED64:
+            if (end - pos < 8) {
+                return false;
+            }
+            pos += 8;
+            return true;
+        case WIRE_LENGTH_DELIMITED:
+            if (!read_varint(pos, end, value) || value > (uint64_t)(end - pos)) {
+                return false;
+            }
+            pos += value;
+            return true;
+        case WIRE_FIXED32:
+            if (end - pos < 4) {
+                return false;
+            }
+            pos += 4;
+            return true;
+        default:
+            return false; // Groups are not used by cast_channel
+    }
+}
+
+bool CastMessageDecoder::decode(const uint8_t* data, size_t length, CastMessageView& out) {
+    memset(&out, 0, sizeof(out));
+
+    const uint8_t* pos = data;
+    const uint8_t* end = data + length;
+    uint32_t seen = 0;
+
+    while (pos < end) {
+        uint64_t key;
+        if (!read_varint(pos, end, key)) {
+            return false;
+        }
+        uint32_t field = (uint32_t)(key >> 3);
+        uint32_t wire_type = (uint32_t)(key & 0x07);
+
+        CastSlice* slice = nullptr;
+        uint32_t* number = nullptr;
+        switch (field) {
+            case FIELD_PROTOCOL_VERSION: number = &out.protocol_version; break;
+            case FIELD_SOURCE_ID:        slice = &out.source_id; break;
+            case FIELD_DESTINATION_ID:   slice = &out.destination_id; break;
+            case FIELD_NAMESPACE:        slice = &out.namespace_; break;
+            case FIELD_PAYLOAD_TYPE:     number = &out.payload_type; break;
+            case FIELD_PAYLOAD_UTF8:     slice = &out.payload_utf8; out.has_payload_utf8 = true; break;
+            case FIELD_PAYLOAD_BINARY:   slice = &out.payload_binary; out.has_payload_binary = true; break;
+            default: break;
+        }
+
+        if (number && wire_type == WIRE_VARINT) {
+            uint64_t value;
+            if (!read_varint(pos, end, value)) {
+                return false;
+            }
+            *number = (uint32_t)value;
+        } else if (slice && wire_type == WIRE_LENGTH_DELIMITED) {
+            uint64_t slice_length;
+            if (!read_varint(pos, end, slice_length) || slice_length > (uint64_t)(end - pos)) {
+                return false;
+            }
+            slice->data = (const char*)pos;
+            slice->length = (size_t)slice_length;
+            pos += slice_length;
+        } else if (number || slice) {
+            return false; // Known field with the wrong wire type
+        } else if (!skip_field(pos, end, wire_type)) {
+            return false;
+        }
+
+        if (field < 32) {
+            seen |= 1u << field;
+        }
+    }
+
+    return (seen & REQUIRED_FIELDS) == REQUIRED_FIELDS;
+}
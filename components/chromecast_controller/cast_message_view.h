@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * CastSlice - Non-owning (pointer, length) view of a protobuf string or bytes field
+ *
+ * The data is not NUL-terminated and is only valid while the buffer it was
+ * decoded from is untouched.
+ */
+struct CastSlice {
+    const char* data;
+    size_t length;
+
+    bool empty() const { return length == 0; }
+    bool equals(const char* str) const {
+        return strlen(str) == length && (length == 0 || memcmp(data, str, length) == 0);
+    }
+};
+
+/**
+ * CastMessageView - Zero-copy decoded CastMessage
+ *
+ * Mirrors Extensions__Api__CastChannel__CastMessage, but every string and
+ * bytes field points straight into the receive buffer.
+ */
+struct CastMessageView {
+    uint32_t protocol_version;
+    CastSlice source_id;
+    CastSlice destination_id;
+    CastSlice namespace_;
+    uint32_t payload_type;
+    bool has_payload_utf8;
+    CastSlice payload_utf8;
+    bool has_payload_binary;
+    CastSlice payload_binary;
+};
+
+/**
+ * CastMessageDecoder - Static-allocation decoder for the cast_channel CastMessage
+ *
+ * Features:
+ * - Hand-rolled protobuf wire decoder for the seven CastMessage fields
+ * - No heap allocation: fields are slices over the caller's buffer
+ * - Unknown fields are skipped, malformed varints and lengths are rejected
+ * - Required-field check equivalent to protobuf-c unpack
+ */
+class CastMessageDecoder {
+public:
+    /**
+     * Decode a serialised CastMessage (without the 4-byte length prefix).
+     * @return false if the message is malformed or missing required fields
+     */
+    static bool decode(const uint8_t* data, size_t length, CastMessageView& out);
+
+private:
+    static bool read_varint(const uint8_t*& pos, const uint8_t* end, uint64_t& value);
+    static bool skip_field(const uint8_t*& pos, const uint8_t* end, uint32_t wire_type);
+};
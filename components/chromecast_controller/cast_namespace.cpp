@@ -0,0 +1,66 @@
+#include "cast_namespace.h"
+
+static constexpr char PLATFORM_PREFIX[] = "urn:x-cast:com.google.cast.";
+static constexpr size_t PLATFORM_PREFIX_LENGTH = sizeof(PLATFORM_PREFIX) - 1;
+
+uint8_t CastNamespaceRegistry::platform_id(const char* data, size_t length) {
+    if (length <= PLATFORM_PREFIX_LENGTH || memcmp(data, PLATFORM_PREFIX, PLATFORM_PREFIX_LENGTH) != 0) {
+        return CAST_NS_UNKNOWN;
+    }
+
+    // The suffix length picks the only candidate; tp.connection and
+    // tp.deviceauth share theirs and differ in the fourth character
+    const char* suffix = data + PLATFORM_PREFIX_LENGTH;
+    size_t suffix_length = length - PLATFORM_PREFIX_LENGTH;
+    uint8_t id;
+    const char* expected;
+    switch (suffix_length) {
+        case 5:  id = CAST_NS_MEDIA;      expected = "media";        break;
+        case 8:  id = CAST_NS_RECEIVER;   expected = "receiver";     break;
+        case 9:  id = CAST_NS_MULTIZONE;  expected = "multizone";    break;
+        case 12: id = CAST_NS_HEARTBEAT;  expected = "tp.heartbeat"; break;
+        case 13:
+            if (suffix[3] == 'c') {
+                id = CAST_NS_CONNECTION;
+                expected = "tp.connection";
+            } else {
+                id = CAST_NS_DEVICE_AUTH;
+                expected = "tp.deviceauth";
+            }
+            break;
+        default:
+            return CAST_NS_UNKNOWN;
+    }
+    if (memcmp(suffix, expected, suffix_length) != 0) {
+        return CAST_NS_UNKNOWN;
+    }
+    return id;
+}
+
+uint8_t CastNamespaceRegistry::lookup(const CastSlice& ns) const {
+    uint8_t id = platform_id(ns.data, ns.length);
+    if (id != CAST_NS_UNKNOWN) {
+        return id;
+    }
+    for (size_t i = 0; i < custom_count; i++) {
+        if (ns.length == custom[i].size() && memcmp(ns.data, custom[i].data(), ns.length) == 0) {
+            return CAST_NS_FIRST_CUSTOM + i;
+        }
+    }
+    return CAST_NS_UNKNOWN;
+}
+
+uint8_t CastNamespaceRegistry::add(const char* ns) {
+    if (!ns || !*ns) {
+        return CAST_NS_UNKNOWN;
+    }
+    uint8_t id = lookup(CastSlice{ns, strlen(ns)});
+    if (id != CAST_NS_UNKNOWN) {
+        return id;
+    }
+    if (custom_count == MAX_CUSTOM) {
+        return CAST_NS_UNKNOWN;
+    }
+    custom[custom_count] = ns;
+    return CAST_NS_FIRST_CUSTOM + custom_count++;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "cast_message_view.h"
+
+/**
+ * CastNamespaceRegistry - Small integer IDs for Cast message namespaces
+ *
+ * Features:
+ * - The platform namespaces (urn:x-cast:com.google.cast.*) are recognised
+ *   with one prefix compare, a switch on the suffix length and one memcmp
+ * - App namespaces (custom receivers) are registered at run time and get
+ *   IDs from CAST_NS_FIRST_CUSTOM up
+ * - IDs index a dispatch table, so finding a message's handler is one
+ *   array lookup however many namespaces there are
+ *
+ * Register app namespaces before messages arrive; lookups are not locked.
+ * No ESP-IDF dependency, so the host build can test it.
+ */
+enum CastNamespaceId : uint8_t {
+    CAST_NS_UNKNOWN = 0,
+    CAST_NS_CONNECTION,
+    CAST_NS_HEARTBEAT,
+    CAST_NS_RECEIVER,
+    CAST_NS_MEDIA,
+    CAST_NS_DEVICE_AUTH,
+    CAST_NS_MULTIZONE,
+    CAST_NS_FIRST_CUSTOM
+};
+
+class CastNamespaceRegistry {
+public:
+    static constexpr size_t MAX_CUSTOM = 8;
+    static constexpr size_t MAX_IDS = CAST_NS_FIRST_CUSTOM + MAX_CUSTOM;
+
+    // Platform namespace ID of a name, CAST_NS_UNKNOWN for anything else
+    static uint8_t platform_id(const char* data, size_t length);
+
+    // ID of a namespace, CAST_NS_UNKNOWN if it is neither a platform nor a registered one
+    uint8_t lookup(const CastSlice& ns) const;
+
+    // Register an app namespace (or find it again); CAST_NS_UNKNOWN when full
+    uint8_t add(const char* ns);
+
+private:
+    std::string custom[MAX_CUSTOM];
+    size_t custom_count = 0;
+};
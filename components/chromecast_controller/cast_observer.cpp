@@ -0,0 +1,338 @@
+#include "cast_observer.h"
+#include <cstdlib>
+#include <cstring>
+#include "esp_log.h"
+#include "chromecast_controller.h"
+#include "cast_frame_codec.h"
+#include "cast_json_writer.h"
+#include "cast_namespace.h"
+#include "telemetry_ui.h"
+#include "tls_profile.h"
+#include "chromecast_protobuf/cast_channel.pb-c.h"
+
+static const char* TAG = "CastObserver";
+
+static constexpr const char* SENDER_ID = "sender-0";
+
+CastObserver::CastObserver(const std::string& ip, int port, StatusCallback callback)
+    : ip(ip)
+    , port(port)
+    , callback(std::move(callback))
+    , tls_handle(nullptr)
+    , rx_buffer(nullptr)
+    , rx_capacity(0)
+    , rx_length(0)
+    , transport_id()
+    , status()
+    , last_rx_tick(0)
+    , last_ping_tick(0)
+    , request_id_counter(0)
+{
+}
+
+CastObserver::~CastObserver() {
+    // unobserve() asked for this; only a lost link is reported
+    callback = nullptr;
+    close();
+}
+
+bool CastObserver::connect() {
+    esp_tls_cfg_t cfg = {};
+    cfg.timeout_ms = TLS_CONNECT_TIMEOUT_MS;
+    // Self-signed device certificates, as for ChromecastController
+    tls_profile_apply(&cfg, TLS_PROFILE_CAST);
+    tls_profile_session_offer(&cfg, ip.c_str());
+
+    tls_handle = esp_tls_init();
+    if (!tls_handle) {
+        ESP_LOGE(TAG, "Failed to initialize TLS handle");
+        tls_profile_session_finish(&cfg, nullptr, ip.c_str());
+        return false;
+    }
+    telemetry_ui_blocking("cast tls");
+    bool connected = esp_tls_conn_new_sync(ip.c_str(), ip.length(), port, &cfg, tls_handle) == 1;
+    tls_profile_session_finish(&cfg, connected ? tls_handle : nullptr, ip.c_str());
+    if (!connected) {
+        ESP_LOGE(TAG, "TLS connection to %s:%d failed", ip.c_str(), port);
+        close();
+        return false;
+    }
+
+    last_rx_tick = xTaskGetTickCount();
+    last_ping_tick = last_rx_tick;
+    if (!send(ChromecastController::NAMESPACE_CONNECTION, "CONNECT") ||
+        !send(ChromecastController::NAMESPACE_RECEIVER, "GET_STATUS")) {
+        close();
+        return false;
+    }
+
+    status.connected = true;
+    ESP_LOGI(TAG, "Observing %s:%d", ip.c_str(), port);
+    return true;
+}
+
+void CastObserver::close() {
+    if (tls_handle) {
+        esp_tls_conn_destroy(tls_handle);
+        tls_handle = nullptr;
+    }
+    free(rx_buffer);
+    rx_buffer = nullptr;
+    rx_capacity = 0;
+    rx_length = 0;
+    transport_id[0] = '\0';
+
+    if (status.connected) {
+        status.connected = false;
+        notify();
+    }
+}
+
+bool CastObserver::send(const char* namespace_str, const char* type, const char* destination) {
+    // Broadcasts carry requestId 0; ours are only there because receivers expect one
+    if (++request_id_counter == 0) {
+        request_id_counter = 1;
+    }
+    CastJsonWriter<CONTROL_MESSAGE_SIZE> json;
+    json.field("type", type).field_uint("requestId", request_id_counter).end();
+
+    Extensions__Api__CastChannel__CastMessage message = EXTENSIONS__API__CAST_CHANNEL__CAST_MESSAGE__INIT;
+    message.protocol_version = EXTENSIONS__API__CAST_CHANNEL__CAST_MESSAGE__PROTOCOL_VERSION__CASTV2_1_0;
+    message.source_id = const_cast<char*>(SENDER_ID);
+    message.destination_id = const_cast<char*>(destination);
+    message.namespace_ = const_cast<char*>(namespace_str);
+    message.payload_type = EXTENSIONS__API__CAST_CHANNEL__CAST_MESSAGE__PAYLOAD_TYPE__STRING;
+    message.payload_utf8 = const_cast<char*>(json.c_str());
+
+    // Namespace, two IDs, a transport ID and the JSON: well inside one stack frame
+    uint8_t frame[CONTROL_MESSAGE_SIZE + 192];
+    size_t message_size = extensions__api__cast_channel__cast_message__get_packed_size(&message);
+    if (!json.ok() || CastFrameCodec::HEADER_SIZE + message_size > sizeof(frame)) {
+        ESP_LOGE(TAG, "%s message does not fit in %d bytes", type, sizeof(frame));
+        return false;
+    }
+    CastFrameCodec::write_header(frame, message_size);
+    extensions__api__cast_channel__cast_message__pack(&message, frame + CastFrameCodec::HEADER_SIZE);
+    return write_all(frame, CastFrameCodec::HEADER_SIZE + message_size);
+}
+
+bool CastObserver::write_all(const uint8_t* data, size_t length) {
+    size_t written = 0;
+    while (written < length && tls_handle) {
+        ssize_t sent = esp_tls_conn_write(tls_handle, data + written, length - written);
+        if (sent == ESP_TLS_ERR_SSL_WANT_READ || sent == ESP_TLS_ERR_SSL_WANT_WRITE) {
+            continue;
+        }
+        if (sent <= 0) {
+            break;
+        }
+        written += sent;
+    }
+    if (written != length) {
+        ESP_LOGW(TAG, "Failed to send to %s: sent %d of %d bytes", ip.c_str(), written, length);
+        return false;
+    }
+    return true;
+}
+
+bool CastObserver::ensure_rx_capacity(size_t required) {
+    if (required <= rx_capacity) {
+        return true;
+    }
+    if (required > MAX_MESSAGE_SIZE + CastFrameCodec::HEADER_SIZE) {
+        return false;
+    }
+
+    // Exactly what the frame needs; it is given back once the frame is handled
+    size_t new_capacity = required < RX_BUFFER_IDLE_SIZE ? RX_BUFFER_IDLE_SIZE : required;
+    uint8_t* new_buffer = (uint8_t*)realloc(rx_buffer, new_capacity);
+    if (!new_buffer) {
+        ESP_LOGE(TAG, "Failed to grow receive buffer to %d bytes", new_capacity);
+        return false;
+    }
+    rx_buffer = new_buffer;
+    rx_capacity = new_capacity;
+    return true;
+}
+
+CastObserver::ReadResult CastObserver::read_available() {
+    if (!tls_handle || !ensure_rx_capacity(RX_BUFFER_IDLE_SIZE)) {
+        return READ_FAILED;
+    }
+
+    ssize_t len_read = esp_tls_conn_read(tls_handle, rx_buffer + rx_length, rx_capacity - rx_length);
+    if (len_read == ESP_TLS_ERR_SSL_WANT_READ || len_read == ESP_TLS_ERR_SSL_WANT_WRITE) {
+        return READ_AGAIN;
+    }
+    if (len_read <= 0) {
+        ESP_LOGW(TAG, "Observed %s closed (%d)", ip.c_str(), len_read);
+        return READ_FAILED;
+    }
+    rx_length += len_read;
+
+    return process_frames() < 0 ? READ_FAILED : READ_OK;
+}
+
+int CastObserver::process_frames() {
+    size_t offset = 0;
+    int processed = 0;
+
+    const uint8_t* body = nullptr;
+    uint32_t message_length = 0;
+    CastFrameCodec::Status frame_status;
+    while ((frame_status = CastFrameCodec::next_frame(rx_buffer + offset, rx_length - offset, MAX_MESSAGE_SIZE,
+                                                      body, message_length)) == CastFrameCodec::FRAME_OK) {
+        CastMessageView message;
+        if (CastMessageDecoder::decode(body, message_length, message)) {
+            handle_message(message);
+            processed++;
+        }
+        offset += CastFrameCodec::HEADER_SIZE + message_length;
+    }
+    if (frame_status == CastFrameCodec::FRAME_INVALID) {
+        ESP_LOGE(TAG, "Invalid frame length from %s: %u bytes", ip.c_str(), message_length);
+        return -1;
+    }
+
+    if (offset > 0) {
+        rx_length -= offset;
+        if (rx_length > 0) {
+            memmove(rx_buffer, rx_buffer + offset, rx_length);
+        }
+    }
+
+    // A large status frame borrowed memory only until it was handled
+    if (rx_capacity > RX_BUFFER_IDLE_SIZE && rx_length <= RX_BUFFER_IDLE_SIZE) {
+        uint8_t* shrunk = (uint8_t*)realloc(rx_buffer, RX_BUFFER_IDLE_SIZE);
+        if (shrunk) {
+            rx_buffer = shrunk;
+            rx_capacity = RX_BUFFER_IDLE_SIZE;
+        }
+    }
+    if (rx_length >= CastFrameCodec::HEADER_SIZE &&
+        !ensure_rx_capacity(CastFrameCodec::read_header(rx_buffer) + CastFrameCodec::HEADER_SIZE)) {
+        return -1;
+    }
+    return processed;
+}
+
+bool CastObserver::has_buffered_input() const {
+    return tls_handle && esp_tls_get_bytes_avail(tls_handle) > 0;
+}
+
+int CastObserver::get_socket_fd() const {
+    int sockfd = -1;
+    if (tls_handle && esp_tls_get_conn_sockfd(tls_handle, &sockfd) == ESP_OK) {
+        return sockfd;
+    }
+    return -1;
+}
+
+bool CastObserver::tick(TickType_t now) {
+    if (!tls_handle) {
+        return false;
+    }
+    if (now - last_rx_tick > pdMS_TO_TICKS(LIVENESS_TIMEOUT_MS)) {
+        ESP_LOGW(TAG, "Observed %s silent for %u ms", ip.c_str(), (unsigned)LIVENESS_TIMEOUT_MS);
+        return false;
+    }
+    if (now - last_ping_tick < pdMS_TO_TICKS(OBSERVER_HEARTBEAT_INTERVAL_MS)) {
+        return true;
+    }
+    last_ping_tick = now;
+    return send(ChromecastController::NAMESPACE_HEARTBEAT, "PING");
+}
+
+void CastObserver::handle_message(const CastMessageView& message) {
+    last_rx_tick = xTaskGetTickCount();
+    if (!message.has_payload_utf8) {
+        return;
+    }
+
+    uint8_t ns_id = CastNamespaceRegistry::platform_id(message.namespace_.data, message.namespace_.length);
+    if (ns_id != CAST_NS_HEARTBEAT && ns_id != CAST_NS_RECEIVER && ns_id != CAST_NS_MEDIA) {
+        return;
+    }
+
+    CastPayload payload;
+    if (!CastPayloadParser::parse(message.payload_utf8.data, message.payload_utf8.length, payload)) {
+        return;
+    }
+
+    if (ns_id == CAST_NS_HEARTBEAT) {
+        if (strcmp(payload.type, "PING") == 0) {
+            send(ChromecastController::NAMESPACE_HEARTBEAT, "PONG");
+        }
+    } else if (ns_id == CAST_NS_RECEIVER && strcmp(payload.type, "RECEIVER_STATUS") == 0) {
+        handle_receiver_status(payload);
+    } else if (ns_id == CAST_NS_MEDIA && strcmp(payload.type, "MEDIA_STATUS") == 0) {
+        handle_media_status(payload);
+    }
+}
+
+void CastObserver::handle_receiver_status(const CastPayload& payload) {
+    if (payload.has_volume) {
+        status.has_volume = true;
+        status.volume_level = payload.volume_level;
+        status.volume_muted = payload.volume_muted;
+    }
+
+    // Status broadcasts always list every running app, so none listed means none running
+    const CastPayload::Application* app = nullptr;
+    for (uint8_t i = 0; i < payload.application_count && !app; i++) {
+        if (payload.applications[i].transport_id[0] != '\0') {
+            app = &payload.applications[i];
+        }
+    }
+    follow_app(app);
+
+    status.updated_at = xTaskGetTickCount();
+    notify();
+}
+
+void CastObserver::follow_app(const CastPayload::Application* app) {
+    if (app && strcmp(app->transport_id, transport_id) == 0) {
+        return;
+    }
+
+    strlcpy(status.app_id, app ? app->app_id : "", sizeof(status.app_id));
+    strlcpy(status.app_name, app ? app->display_name : "", sizeof(status.app_name));
+    status.player_state[0] = '\0';
+    status.current_time = 0.0;
+    status.duration = 0.0;
+    transport_id[0] = '\0';
+    if (!app) {
+        return;
+    }
+
+    // MEDIA_STATUS is only broadcast to senders connected to the app's transport
+    if (send(ChromecastController::NAMESPACE_CONNECTION, "CONNECT", app->transport_id) &&
+        send(ChromecastController::NAMESPACE_MEDIA, "GET_STATUS", app->transport_id)) {
+        strlcpy(transport_id, app->transport_id, sizeof(transport_id));
+    }
+}
+
+void CastObserver::handle_media_status(const CastPayload& payload) {
+    if (!payload.has_media_status) {
+        status.player_state[0] = '\0';
+        status.current_time = 0.0;
+        status.duration = 0.0;
+    } else {
+        // Updates are partial, as in ChromecastController::process_media_message
+        if (payload.player_state[0] != '\0') {
+            strlcpy(status.player_state, payload.player_state, sizeof(status.player_state));
+        }
+        status.current_time = payload.current_time;
+        if (payload.duration > 0.0) {
+            status.duration = payload.duration;
+        }
+    }
+    status.updated_at = xTaskGetTickCount();
+    notify();
+}
+
+void CastObserver::notify() {
+    if (callback) {
+        callback(status);
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "freertos/FreeRTOS.h"
+#include "esp_tls.h"
+
+#include "cast_message_view.h"
+#include "cast_payload_parser.h"
+
+/**
+ * CastObserver - Listen-only Cast connection that follows a speaker's status
+ *
+ * Features:
+ * - Opens the platform virtual connection and, once an app is running, one
+ *   to the app's transport, so RECEIVER_STATUS and MEDIA_STATUS broadcasts
+ *   arrive without polling; one GET_STATUS each when the link comes up
+ * - Answers PINGs and sends its own at OBSERVER_HEARTBEAT_INTERVAL_MS,
+ *   twice the controller's interval
+ * - No send queue, request table, timers or task: ChromecastConnectionPool
+ *   does every read and write on its I/O task, frames are built on the stack
+ * - The receive buffer sits at RX_BUFFER_IDLE_SIZE and only grows for the
+ *   frame that needs it
+ *
+ * Everything but connect() and the constructor runs on the pool's I/O task.
+ */
+class CastObserver {
+public:
+    static constexpr uint32_t OBSERVER_HEARTBEAT_INTERVAL_MS = 10000;
+    static constexpr uint32_t LIVENESS_TIMEOUT_MS = 3 * OBSERVER_HEARTBEAT_INTERVAL_MS;
+    static constexpr int TLS_CONNECT_TIMEOUT_MS = 10000;
+    static constexpr size_t RX_BUFFER_IDLE_SIZE = 512;
+    static constexpr size_t MAX_MESSAGE_SIZE = 65536;
+    static constexpr size_t CONTROL_MESSAGE_SIZE = 192;
+
+    // What the speaker last reported
+    struct Status {
+        bool connected;
+        bool has_volume;
+        float volume_level;
+        bool volume_muted;
+        char app_id[24];            // Empty when nothing is running
+        char app_name[48];
+        char player_state[16];      // IDLE, BUFFERING, PLAYING, PAUSED; empty without media
+        double current_time;        // Seconds at updated_at
+        double duration;
+        TickType_t updated_at;
+    };
+
+    // On the pool's I/O task; a final call with connected false when the link is lost
+    using StatusCallback = std::function<void(const Status&)>;
+
+    enum ReadResult {
+        READ_OK,
+        READ_AGAIN,
+        READ_FAILED
+    };
+
+    CastObserver(const std::string& ip, int port, StatusCallback callback);
+    ~CastObserver();
+
+    // TLS handshake and virtual connection; blocks, on the caller's task
+    bool connect();
+    void close();
+
+    ReadResult read_available();
+    bool has_buffered_input() const;
+    int get_socket_fd() const;
+    // Called on each pass of the observer's heartbeat wheel slot
+    bool tick(TickType_t now);
+
+    const std::string& get_ip() const { return ip; }
+    const Status& get_status() const { return status; }
+
+private:
+    std::string ip;
+    int port;
+    StatusCallback callback;
+    esp_tls_t* tls_handle;
+
+    uint8_t* rx_buffer;
+    size_t rx_capacity;
+    size_t rx_length;
+
+    char transport_id[48];          // App transport connected to, empty if none
+    Status status;
+    TickType_t last_rx_tick;
+    TickType_t last_ping_tick;
+    uint32_t request_id_counter;
+
+    bool send(const char* namespace_str, const char* type, const char* destination = "receiver-0");
+    bool write_all(const uint8_t* data, size_t length);
+    bool ensure_rx_capacity(size_t required);
+    int process_frames();
+    void handle_message(const CastMessageView& message);
+    void handle_receiver_status(const CastPayload& payload);
+    void handle_media_status(const CastPayload& payload);
+    void follow_app(const CastPayload::Application* app);
+    void notify();
+};
@@ -0,0 +1,365 @@
+#include "cast_payload_parser.h"
+#include <cstring>
+#include <cstdlib>
+
+static constexpr size_t MAX_KEY_LENGTH = 32;
+
+bool CastPayloadParser::parse(const char* json, size_t length, CastPayload& out) {
+    memset(&out, 0, sizeof(out));
+    if (!json || length == 0) {
+        return false;
+    }
+
+    CastPayloadParser parser(json, length, out);
+    parser.skip_whitespace();
+    if (parser.pos >= parser.end || *parser.pos != '{') {
+        return false;
+    }
+    return parser.parse_object(CTX_ROOT, 0);
+}
+
+CastPayloadParser::CastPayloadParser(const char* json, size_t length, CastPayload& payload)
+    : pos(json)
+    , end(json + length)
+    , out(payload)
+    , current_app(nullptr)
+    , current_member(nullptr)
+{
+}
+
+void CastPayloadParser::skip_whitespace() {
+    while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r')) {
+        pos++;
+    }
+}
+
+CastPayloadParser::Context CastPayloadParser::child_context(Context parent, const char* key, bool is_array) const {
+    if (!key) {
+        return CTX_IGNORED;
+    }
+
+    switch (parent) {
+        case CTX_ROOT:
+            if (strcmp(key, "status") == 0) {
+                // RECEIVER_STATUS and MULTIZONE_STATUS carry an object, MEDIA_STATUS an array
+                return is_array ? CTX_MEDIA_STATUS_ARRAY : CTX_RECEIVER_STATUS;
+            }
+            if (!is_array && strcmp(key, "device") == 0) return CTX_MEMBER;
+            if (!is_array && strcmp(key, "availability") == 0) return CTX_AVAILABILITY;
+            break;
+        case CTX_RECEIVER_STATUS:
+            if (!is_array && strcmp(key, "volume") == 0) return CTX_VOLUME;
+            if (is_array && strcmp(key, "applications") == 0) return CTX_APPLICATIONS;
+            if (is_array && strcmp(key, "devices") == 0) return CTX_MEMBERS;
+            break;
+        case CTX_MEMBER:
+            if (!is_array && strcmp(key, "volume") == 0) return CTX_MEMBER_VOLUME;
+            break;
+        case CTX_MEDIA_STATUS:
+            if (!is_array && strcmp(key, "media") == 0) return CTX_MEDIA_INFO;
+            break;
+        default:
+            break;
+    }
+    return CTX_IGNORED;
+}
+
+char* CastPayloadParser::string_target(Context ctx, const char* key, size_t& size) {
+    if (!key) {
+        return nullptr;
+    }
+
+    switch (ctx) {
+        case CTX_ROOT:
+            if (strcmp(key, "type") == 0 || strcmp(key, "responseType") == 0) { size = sizeof(out.type); return out.type; }
+            if (strcmp(key, "deviceId") == 0) { size = sizeof(out.device_id); return out.device_id; }
+            break;
+        case CTX_MEMBER:
+            if (!current_member) break;
+            if (strcmp(key, "deviceId") == 0) { size = sizeof(current_member->device_id); return current_member->device_id; }
+            if (strcmp(key, "name") == 0) { size = sizeof(current_member->name); return current_member->name; }
+            break;
+        case CTX_APPLICATION:
+            if (!current_app) break;
+            if (strcmp(key, "appId") == 0) { size = sizeof(current_app->app_id); return current_app->app_id; }
+            if (strcmp(key, "sessionId") == 0) { size = sizeof(current_app->session_id); return current_app->session_id; }
+            if (strcmp(key, "transportId") == 0) { size = sizeof(current_app->transport_id); return current_app->transport_id; }
+            if (strcmp(key, "displayName") == 0) { size = sizeof(current_app->display_name); return current_app->display_name; }
+            break;
+        case CTX_MEDIA_STATUS:
+            if (strcmp(key, "playerState") == 0) { size = sizeof(out.player_state); return out.player_state; }
+            if (strcmp(key, "idleReason") == 0) { size = sizeof(out.idle_reason); return out.idle_reason; }
+            break;
+        default:
+            break;
+    }
+    return nullptr;
+}
+
+void CastPayloadParser::store_number(Context ctx, const char* key, double value) {
+    if (!key) {
+        return;
+    }
+
+    if (ctx == CTX_ROOT && strcmp(key, "requestId") == 0) {
+        out.request_id = (uint32_t)value;
+        out.has_request_id = true;
+    } else if (ctx == CTX_VOLUME && strcmp(key, "level") == 0) {
+        out.volume_level = (float)value;
+        out.has_volume = true;
+    } else if (ctx == CTX_MEDIA_STATUS && strcmp(key, "mediaSessionId") == 0) {
+        out.media_session_id = (uint32_t)value;
+    } else if (ctx == CTX_MEDIA_STATUS && strcmp(key, "currentTime") == 0) {
+        out.current_time = value;
+    } else if (ctx == CTX_MEDIA_INFO && strcmp(key, "duration") == 0) {
+        out.duration = value;
+    } else if (ctx == CTX_MEMBER && current_member && strcmp(key, "capabilities") == 0) {
+        current_member->capabilities = (uint32_t)value;
+    } else if (ctx == CTX_MEMBER_VOLUME && current_member && strcmp(key, "level") == 0) {
+        current_member->volume_level = (float)value;
+        current_member->has_volume = true;
+    }
+}
+
+void CastPayloadParser::store_bool(Context ctx, const char* key, bool value) {
+    if (key && ctx == CTX_VOLUME && strcmp(key, "muted") == 0) {
+        out.volume_muted = value;
+        out.has_volume = true;
+    } else if (key && ctx == CTX_MEMBER_VOLUME && current_member && strcmp(key, "muted") == 0) {
+        current_member->volume_muted = value;
+        current_member->has_volume = true;
+    }
+}
+
+bool CastPayloadParser::parse_value(Context ctx, const char* key, int depth) {
+    if (depth > MAX_DEPTH) {
+        return false;
+    }
+
+    skip_whitespace();
+    if (pos >= end) {
+        return false;
+    }
+
+    switch (*pos) {
+        case '{': {
+            Context child = child_context(ctx, key, false);
+            if (child == CTX_MEMBER) {
+                // DEVICE_ADDED/DEVICE_UPDATED carry one member object at the root
+                if (out.member_count >= CastPayload::MAX_GROUP_MEMBERS) {
+                    return parse_object(CTX_IGNORED, depth + 1);
+                }
+                current_member = &out.members[out.member_count++];
+                bool ok = parse_object(CTX_MEMBER, depth + 1);
+                current_member = nullptr;
+                return ok;
+            }
+            return parse_object(child, depth + 1);
+        }
+        case '[':
+            return parse_array(child_context(ctx, key, true), key, depth + 1);
+        case '"': {
+            if (ctx == CTX_AVAILABILITY && key && out.availability_count < CastPayload::MAX_APPLICATIONS) {
+                // Keyed by appId, so the key is the field
+                char value[16];
+                if (!parse_string(value, sizeof(value))) return false;
+                CastPayload::AppAvailability& app = out.availability[out.availability_count++];
+                strncpy(app.app_id, key, sizeof(app.app_id) - 1);
+                app.available = strcmp(value, "APP_AVAILABLE") == 0;
+                return true;
+            }
+            size_t size = 0;
+            char* target = string_target(ctx, key, size);
+            return parse_string(target, size);
+        }
+        case 't':
+            if (!parse_literal("true")) return false;
+            store_bool(ctx, key, true);
+            return true;
+        case 'f':
+            if (!parse_literal("false")) return false;
+            store_bool(ctx, key, false);
+            return true;
+        case 'n':
+            return parse_literal("null");
+        default: {
+            double value = 0;
+            if (!parse_number(value)) return false;
+            store_number(ctx, key, value);
+            return true;
+        }
+    }
+}
+
+bool CastPayloadParser::parse_object(Context ctx, int depth) {
+    if (depth > MAX_DEPTH) {
+        return false;
+    }
+
+    pos++; // '{'
+    skip_whitespace();
+    if (pos < end && *pos == '}') {
+        pos++;
+        return true;
+    }
+
+    char key[MAX_KEY_LENGTH];
+    while (pos < end) {
+        skip_whitespace();
+        if (pos >= end || *pos != '"' || !parse_string(key, sizeof(key))) {
+            return false;
+        }
+
+        skip_whitespace();
+        if (pos >= end || *pos != ':') {
+            return false;
+        }
+        pos++;
+
+        if (!parse_value(ctx, key, depth)) {
+            return false;
+        }
+
+        skip_whitespace();
+        if (pos >= end) {
+            return false;
+        }
+        if (*pos == ',') {
+            pos++;
+            continue;
+        }
+        if (*pos == '}') {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+    return false;
+}
+
+bool CastPayloadParser::parse_array(Context ctx, const char* key, int depth) {
+    if (depth > MAX_DEPTH) {
+        return false;
+    }
+
+    pos++; // '['
+    skip_whitespace();
+    if (pos < end && *pos == ']') {
+        pos++;
+        return true;
+    }
+
+    int index = 0;
+    while (pos < end) {
+        skip_whitespace();
+        bool is_object = pos < end && *pos == '{';
+        bool ok;
+
+        if (is_object && ctx == CTX_APPLICATIONS && out.application_count < CastPayload::MAX_APPLICATIONS) {
+            current_app = &out.applications[out.application_count++];
+            ok = parse_object(CTX_APPLICATION, depth + 1);
+            current_app = nullptr;
+        } else if (is_object && ctx == CTX_MEMBERS && out.member_count < CastPayload::MAX_GROUP_MEMBERS) {
+            current_member = &out.members[out.member_count++];
+            ok = parse_object(CTX_MEMBER, depth + 1);
+            current_member = nullptr;
+        } else if (is_object && ctx == CTX_MEDIA_STATUS_ARRAY && index == 0) {
+            out.has_media_status = true;
+            ok = parse_object(CTX_MEDIA_STATUS, depth + 1);
+        } else {
+            ok = parse_value(CTX_IGNORED, nullptr, depth);
+        }
+
+        if (!ok) {
+            return false;
+        }
+        index++;
+
+        skip_whitespace();
+        if (pos >= end) {
+            return false;
+        }
+        if (*pos == ',') {
+            pos++;
+            continue;
+        }
+        if (*pos == ']') {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+    return false;
+}
+
+bool CastPayloadParser::parse_string(char* dest, size_t dest_size) {
+    pos++; // opening quote
+    size_t written = 0;
+
+    while (pos < end && *pos != '"') {
+        char c = *pos++;
+        if (c == '\\') {
+            if (pos >= end) {
+                return false;
+            }
+            char esc = *pos++;
+            switch (esc) {
+                case 'n': c = '\n'; break;
+                case 'r': c = '\r'; break;
+                case 't': c = '\t'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'u':
+                    // Non-ASCII escapes are not needed for the fields we keep
+                    if (end - pos < 4) {
+                        return false;
+                    }
+                    pos += 4;
+                    c = '?';
+                    break;
+                default: c = esc; break; // '"', '\\', '/'
+            }
+        }
+
+        if (dest && written + 1 < dest_size) {
+            dest[written++] = c;
+        }
+    }
+
+    if (pos >= end) {
+        return false;
+    }
+    pos++; // closing quote
+
+    if (dest && dest_size > 0) {
+        dest[written] = '\0';
+    }
+    return true;
+}
+
+bool CastPayloadParser::parse_number(double& value) {
+    // Copy the token so strtod never reads past the payload
+    char token[32];
+    size_t n = 0;
+    while (pos < end && n + 1 < sizeof(token) &&
+           (strchr("+-.eE", *pos) || (*pos >= '0' && *pos <= '9'))) {
+        token[n++] = *pos++;
+    }
+    if (n == 0) {
+        return false;
+    }
+    token[n] = '\0';
+
+    char* parsed_end = nullptr;
+    value = strtod(token, &parsed_end);
+    return parsed_end != token;
+}
+
+bool CastPayloadParser::parse_literal(const char* literal) {
+    size_t len = strlen(literal);
+    if ((size_t)(end - pos) < len || strncmp(pos, literal, len) != 0) {
+        return false;
+    }
+    pos += len;
+    return true;
+}
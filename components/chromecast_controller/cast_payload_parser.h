@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * CastPayload - Fields the controller extracts from incoming Cast JSON payloads
+ *
+ * Only the handful of fields the controller acts on are kept; everything else
+ * in the payload is skipped without being stored.
+ */
+struct CastPayload {
+    static constexpr size_t MAX_APPLICATIONS = 4;
+    static constexpr size_t MAX_GROUP_MEMBERS = 8;
+
+    struct Application {
+        char app_id[24];
+        char session_id[48];
+        char transport_id[48];
+        char display_name[48];
+    };
+
+    struct AppAvailability {
+        char app_id[24];
+        bool available;
+    };
+
+    struct GroupMember {
+        char device_id[40];
+        char name[48];
+        uint32_t capabilities;
+        bool has_volume;
+        float volume_level;
+        bool volume_muted;
+    };
+
+    char type[32];
+    uint32_t request_id;
+    bool has_request_id;
+
+    // Receiver volume (RECEIVER_STATUS status.volume)
+    bool has_volume;
+    float volume_level;
+    bool volume_muted;
+
+    // RECEIVER_STATUS status.applications[]
+    Application applications[MAX_APPLICATIONS];
+    uint8_t application_count;
+
+    // GET_APP_AVAILABILITY availability{appId: "APP_AVAILABLE", ...}; the
+    // answer names its type in responseType, which lands in type
+    AppAvailability availability[MAX_APPLICATIONS];
+    uint8_t availability_count;
+
+    // MEDIA_STATUS status[0] (duration comes from status[0].media)
+    bool has_media_status;
+    char player_state[16];
+    char idle_reason[16];
+    uint32_t media_session_id;
+    double current_time;
+    double duration;
+
+    // Multizone group members: MULTIZONE_STATUS status.devices[], or the
+    // single "device" of DEVICE_ADDED/DEVICE_UPDATED
+    GroupMember members[MAX_GROUP_MEMBERS];
+    uint8_t member_count;
+    char device_id[40];         // DEVICE_REMOVED deviceId
+};
+
+/**
+ * CastPayloadParser - SAX-style, allocation-free extractor for Cast payloads
+ *
+ * Features:
+ * - Single pass over the JSON text, no DOM and no heap allocation
+ * - Directed extraction: only known paths are decoded, the rest is skipped
+ * - Bounded recursion depth and truncating string copies
+ * - Works under memory pressure where cJSON_Parse would fail
+ */
+class CastPayloadParser {
+public:
+    static constexpr int MAX_DEPTH = 16;
+
+    /**
+     * Parse a Cast JSON payload into a CastPayload.
+     * @return false if the payload is not well-formed JSON
+     */
+    static bool parse(const char* json, size_t length, CastPayload& out);
+
+private:
+    enum Context {
+        CTX_ROOT,
+        CTX_RECEIVER_STATUS,
+        CTX_VOLUME,
+        CTX_APPLICATIONS,
+        CTX_APPLICATION,
+        CTX_MEDIA_STATUS_ARRAY,
+        CTX_MEDIA_STATUS,
+        CTX_MEDIA_INFO,
+        CTX_MEMBERS,
+        CTX_MEMBER,
+        CTX_MEMBER_VOLUME,
+        CTX_AVAILABILITY,
+        CTX_IGNORED
+    };
+
+    const char* pos;
+    const char* end;
+    CastPayload& out;
+    CastPayload::Application* current_app;
+    CastPayload::GroupMember* current_member;
+
+    CastPayloadParser(const char* json, size_t length, CastPayload& payload);
+
+    void skip_whitespace();
+    bool parse_value(Context ctx, const char* key, int depth);
+    bool parse_object(Context ctx, int depth);
+    bool parse_array(Context ctx, const char* key, int depth);
+    bool parse_string(char* dest, size_t dest_size);
+    bool parse_number(double& value);
+    bool parse_literal(const char* literal);
+
+    Context child_context(Context parent, const char* key, bool is_array) const;
+    char* string_target(Context ctx, const char* key, size_t& size);
+    void store_number(Context ctx, const char* key, double value);
+    void store_bool(Context ctx, const char* key, bool value);
+};
@@ -0,0 +1,185 @@
+#include "cast_request_table.h"
+#include <cstdio>
+#include <cstring>
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "telemetry.h"
+
+static_assert((CastRequestTable::CAPACITY & (CastRequestTable::CAPACITY - 1)) == 0,
+              "CastRequestTable::CAPACITY must be a power of two");
+
+CastRequestTable::CastRequestTable()
+    : entries()
+    , count(0)
+    , stats()
+    , stat_count(0)
+{
+}
+
+int CastRequestTable::find_slot(uint32_t request_id) const {
+    size_t index = request_id & (CAPACITY - 1);
+    for (size_t probe = 0; probe < CAPACITY; probe++) {
+        const Entry& entry = entries[index];
+        if (entry.request_id == request_id) {
+            return index;
+        }
+        if (entry.request_id == EMPTY) {
+            return -1;
+        }
+        index = (index + 1) & (CAPACITY - 1);
+    }
+    return -1;
+}
+
+bool CastRequestTable::insert(uint32_t request_id, const char* type, TickType_t timeout, Callback callback) {
+    if (request_id == EMPTY || request_id == TOMBSTONE || count >= CAPACITY) {
+        return false;
+    }
+
+    size_t index = request_id & (CAPACITY - 1);
+    for (size_t probe = 0; probe < CAPACITY; probe++) {
+        Entry& entry = entries[index];
+        if (entry.request_id == EMPTY || entry.request_id == TOMBSTONE) {
+            entry.request_id = request_id;
+            entry.type = type;
+            entry.sent_us = esp_timer_get_time();
+            entry.deadline = xTaskGetTickCount() + timeout;
+            entry.callback = std::move(callback);
+            count++;
+            return true;
+        }
+        index = (index + 1) & (CAPACITY - 1);
+    }
+    return false;
+}
+
+void CastRequestTable::record(const char* type, bool timed_out, uint32_t rtt_ms) {
+    LatencyStats* slot = nullptr;
+    for (size_t i = 0; i < stat_count; i++) {
+        if (stats[i].type == type || strcmp(stats[i].type, type) == 0) {
+            slot = &stats[i];
+            break;
+        }
+    }
+    if (!slot) {
+        if (stat_count >= MAX_STAT_TYPES) {
+            return;
+        }
+        slot = &stats[stat_count++];
+        slot->type = type;
+        slot->min_ms = UINT32_MAX;
+    }
+
+    if (timed_out) {
+        slot->timeouts++;
+        return;
+    }
+    telemetry_record(TELEMETRY_CAST_RTT, rtt_ms);
+    char name[TELEMETRY_HIST_NAME_MAX];
+    snprintf(name, sizeof(name), "cast %s", type);
+    telemetry_hist_record(telemetry_hist_get(name, TELEMETRY_HIST_MS), rtt_ms);
+    slot->count++;
+    slot->total_ms += rtt_ms;
+    slot->min_ms = rtt_ms < slot->min_ms ? rtt_ms : slot->min_ms;
+    slot->max_ms = rtt_ms > slot->max_ms ? rtt_ms : slot->max_ms;
+}
+
+void CastRequestTable::release(Entry& entry, Result result, uint32_t rtt_ms, Completion& completion) {
+    completion.callback = std::move(entry.callback);
+    completion.result = result;
+    completion.rtt_ms = rtt_ms;
+
+    entry.callback = nullptr;
+    entry.type = nullptr;
+    entry.request_id = TOMBSTONE;
+    count--;
+
+    // With no live entries left, clear tombstones so probes stay short
+    if (count == 0) {
+        for (Entry& e : entries) {
+            e.request_id = EMPTY;
+        }
+    }
+}
+
+bool CastRequestTable::complete(uint32_t request_id, Result result, Completion& completion) {
+    int slot = find_slot(request_id);
+    if (slot < 0) {
+        return false;
+    }
+
+    Entry& entry = entries[slot];
+    uint32_t rtt_ms = (uint32_t)((esp_timer_get_time() - entry.sent_us) / 1000);
+    record(entry.type, false, rtt_ms);
+    release(entry, result, rtt_ms, completion);
+    return true;
+}
+
+bool CastRequestTable::discard(uint32_t request_id) {
+    int slot = find_slot(request_id);
+    if (slot < 0) {
+        return false;
+    }
+
+    // Never sent, so it does not count towards latency statistics
+    Completion dropped;
+    release(entries[slot], RESULT_CANCELLED, 0, dropped);
+    return true;
+}
+
+size_t CastRequestTable::expire(TickType_t now, Completion* out, size_t max_out) {
+    size_t expired = 0;
+    for (Entry& entry : entries) {
+        if (expired >= max_out) {
+            break;
+        }
+        if (entry.request_id == EMPTY || entry.request_id == TOMBSTONE) {
+            continue;
+        }
+        if ((int32_t)(now - entry.deadline) >= 0) {
+            uint32_t rtt_ms = (uint32_t)((esp_timer_get_time() - entry.sent_us) / 1000);
+            record(entry.type, true, rtt_ms);
+            release(entry, RESULT_TIMEOUT, rtt_ms, out[expired++]);
+        }
+    }
+    return expired;
+}
+
+size_t CastRequestTable::cancel_all(Completion* out, size_t max_out) {
+    size_t cancelled = 0;
+    for (Entry& entry : entries) {
+        if (entry.request_id == EMPTY || entry.request_id == TOMBSTONE) {
+            continue;
+        }
+        if (cancelled < max_out) {
+            release(entry, RESULT_CANCELLED, 0, out[cancelled++]);
+        } else {
+            Completion dropped;
+            release(entry, RESULT_CANCELLED, 0, dropped);
+        }
+    }
+    return cancelled;
+}
+
+TickType_t CastRequestTable::next_deadline(TickType_t now) const {
+    TickType_t earliest = portMAX_DELAY;
+    for (const Entry& entry : entries) {
+        if (entry.request_id == EMPTY || entry.request_id == TOMBSTONE) {
+            continue;
+        }
+        int32_t remaining = (int32_t)(entry.deadline - now);
+        TickType_t wait = remaining > 0 ? (TickType_t)remaining : 0;
+        if (wait < earliest) {
+            earliest = wait;
+        }
+    }
+    return earliest;
+}
+
+size_t CastRequestTable::get_stats(LatencyStats* out, size_t max_out) const {
+    size_t n = stat_count < max_out ? stat_count : max_out;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = stats[i];
+    }
+    return n;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include "freertos/FreeRTOS.h"
+
+#include "cast_payload_parser.h"
+
+/**
+ * CastRequestTable - Fixed-size, open-addressed table of outstanding Cast requests
+ *
+ * Features:
+ * - Keyed by requestId with linear probing and tombstones (no heap per request)
+ * - Each entry carries a completion callback, send timestamp and deadline
+ * - Per-command round-trip latency statistics (count, min, max, mean, timeouts)
+ *
+ * The table itself is not thread-safe; ChromecastController serialises access.
+ */
+class CastRequestTable {
+public:
+    static constexpr size_t CAPACITY = 16;           // Must be a power of two
+    static constexpr size_t MAX_STAT_TYPES = 12;
+
+    enum Result {
+        RESULT_OK,
+        RESULT_ERROR,       // Receiver answered with an error type (LOAD_FAILED, ...)
+        RESULT_TIMEOUT,
+        RESULT_CANCELLED
+    };
+
+    using Callback = std::function<void(Result result, const CastPayload* response, uint32_t rtt_ms)>;
+
+    struct LatencyStats {
+        const char* type;   // Command type literal, e.g. "GET_STATUS"
+        uint32_t count;
+        uint32_t timeouts;
+        uint32_t min_ms;
+        uint32_t max_ms;
+        uint64_t total_ms;
+    };
+
+    // A completed entry handed back to the caller so callbacks run unlocked
+    struct Completion {
+        Callback callback;
+        Result result;
+        uint32_t rtt_ms;
+    };
+
+    CastRequestTable();
+
+    bool insert(uint32_t request_id, const char* type, TickType_t timeout, Callback callback);
+    bool complete(uint32_t request_id, Result result, Completion& completion);
+    bool discard(uint32_t request_id);
+    size_t expire(TickType_t now, Completion* out, size_t max_out);
+    size_t cancel_all(Completion* out, size_t max_out);
+
+    // Ticks until the earliest deadline, or portMAX_DELAY if nothing is pending
+    TickType_t next_deadline(TickType_t now) const;
+    size_t pending() const { return count; }
+    size_t get_stats(LatencyStats* out, size_t max_out) const;
+
+private:
+    static constexpr uint32_t EMPTY = 0;
+    static constexpr uint32_t TOMBSTONE = 0xFFFFFFFFu;
+
+    struct Entry {
+        uint32_t request_id;
+        const char* type;
+        int64_t sent_us;
+        TickType_t deadline;
+        Callback callback;
+    };
+
+    Entry entries[CAPACITY];
+    size_t count;
+    LatencyStats stats[MAX_STAT_TYPES];
+    size_t stat_count;
+
+    int find_slot(uint32_t request_id) const;
+    void record(const char* type, bool timed_out, uint32_t rtt_ms);
+    void release(Entry& entry, Result result, uint32_t rtt_ms, Completion& completion);
+};
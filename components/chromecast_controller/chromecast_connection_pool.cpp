@@ -0,0 +1,558 @@
+#include "chromecast_connection_pool.h"
+#include "mem_task.h"
+#include "esp_timer.h"
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <sys/select.h>
+
+static const char* TAG = "ChromecastPool";
+
+ChromecastConnectionPool::ChromecastConnectionPool()
+    : entries()
+    , observers()
+    , wheel()
+    , wheel_position(0)
+    , next_wheel_tick(0)
+    , pool_mutex(nullptr)
+    , io_task_handle(nullptr)
+    , running(false)
+{
+}
+
+ChromecastConnectionPool::~ChromecastConnectionPool() {
+    stop();
+    for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+        release_entry(i);
+    }
+    for (size_t i = 0; i < MAX_OBSERVERS; i++) {
+        release_observer(i);
+    }
+    if (pool_mutex) {
+        vSemaphoreDelete(pool_mutex);
+        pool_mutex = nullptr;
+    }
+}
+
+bool ChromecastConnectionPool::start() {
+    if (running) {
+        return true;
+    }
+
+    if (!pool_mutex) {
+        pool_mutex = xSemaphoreCreateMutex();
+        if (!pool_mutex) {
+            ESP_LOGE(TAG, "Failed to create pool mutex");
+            return false;
+        }
+    }
+
+    running = true;
+    next_wheel_tick = xTaskGetTickCount() + pdMS_TO_TICKS(WHEEL_TICK_MS);
+    // Internal stack: the members' device auth responses are written to NVS from here
+    if (!mem_task_create(io_task, "chromecast_pool", IO_TASK_STACK_SIZE, this, IO_TASK_PRIORITY,
+                         &io_task_handle, TASK_PLAN_NETWORK_CORE, MEM_TASK_STACK_INTERNAL)) {
+        ESP_LOGE(TAG, "Failed to create pool I/O task");
+        running = false;
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Connection pool started (max %d devices)", MAX_CONNECTIONS);
+    return true;
+}
+
+void ChromecastConnectionPool::stop() {
+    if (!running) {
+        return;
+    }
+
+    // The I/O task notices within one wheel tick and deletes itself
+    running = false;
+    while (io_task_handle) {
+        vTaskDelay(pdMS_TO_TICKS(WHEEL_TICK_MS / 5));
+    }
+    ESP_LOGI(TAG, "Connection pool stopped");
+}
+
+int ChromecastConnectionPool::find_index(const std::string& ip) const {
+    for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+        if (entries[i].controller && entries[i].ip == ip) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int ChromecastConnectionPool::find_observer(const std::string& ip) const {
+    for (size_t i = 0; i < MAX_OBSERVERS; i++) {
+        if (observers[i].observer && observers[i].observer->get_ip() == ip) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int ChromecastConnectionPool::pick_wheel_slot() const {
+    // Least-loaded slot keeps heartbeats spread across the interval
+    int best = 0;
+    int best_load = __builtin_popcount(wheel[0]);
+    for (int i = 1; i < WHEEL_SLOTS; i++) {
+        int load = __builtin_popcount(wheel[i]);
+        if (load < best_load) {
+            best = i;
+            best_load = load;
+        }
+    }
+    return best;
+}
+
+void ChromecastConnectionPool::release_entry(int index) {
+    Entry& entry = entries[index];
+    if (entry.wheel_slot >= 0) {
+        wheel[entry.wheel_slot] &= ~(1u << index);
+        entry.wheel_slot = -1;
+    }
+    if (entry.controller) {
+        entry.controller->disconnect();
+        entry.controller.reset();
+    }
+    entry.ip.clear();
+}
+
+void ChromecastConnectionPool::release_observer(int index) {
+    ObserverEntry& entry = observers[index];
+    if (entry.wheel_slot >= 0) {
+        wheel[entry.wheel_slot] &= ~(1u << (OBSERVER_BIT + index));
+        entry.wheel_slot = -1;
+    }
+    entry.observer.reset();
+}
+
+ChromecastController* ChromecastConnectionPool::add(const std::string& ip, const SetupCallback& setup) {
+    if (!pool_mutex && !start()) {
+        return nullptr;
+    }
+
+    ChromecastController* existing = find(ip);
+    if (existing) {
+        return existing;
+    }
+
+    // Connect outside the pool lock; the TLS handshake blocks
+    std::unique_ptr<ChromecastController> controller(new (std::nothrow) ChromecastController());
+    if (!controller) {
+        ESP_LOGE(TAG, "Out of memory creating controller for %s", ip.c_str());
+        return nullptr;
+    }
+
+    controller->set_external_io(true);
+    if (setup) {
+        setup(*controller);
+    }
+    if (!controller->initialize() || !controller->connect_to_chromecast(ip)) {
+        ESP_LOGE(TAG, "Failed to connect pooled device %s", ip.c_str());
+        return nullptr;
+    }
+
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+
+    int index = -1;
+    for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+        if (!entries[i].controller) {
+            index = i;
+            break;
+        }
+    }
+
+    if (index < 0) {
+        xSemaphoreGive(pool_mutex);
+        ESP_LOGW(TAG, "Pool full, dropping %s", ip.c_str());
+        return nullptr;
+    }
+
+    Entry& entry = entries[index];
+    entry.controller = std::move(controller);
+    entry.ip = ip;
+    entry.wheel_slot = pick_wheel_slot();
+    wheel[entry.wheel_slot] |= (1u << index);
+    ChromecastController* result = entry.controller.get();
+
+    xSemaphoreGive(pool_mutex);
+
+    ESP_LOGI(TAG, "Added %s to pool (slot %d, heartbeat phase %d)", ip.c_str(), index, entry.wheel_slot);
+    return result;
+}
+
+bool ChromecastConnectionPool::remove(const std::string& ip) {
+    if (!pool_mutex) {
+        return false;
+    }
+
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    int index = find_index(ip);
+    if (index >= 0) {
+        release_entry(index);
+    }
+    xSemaphoreGive(pool_mutex);
+
+    if (index >= 0) {
+        ESP_LOGI(TAG, "Removed %s from pool", ip.c_str());
+    }
+    return index >= 0;
+}
+
+ChromecastController* ChromecastConnectionPool::find(const std::string& ip) {
+    if (!pool_mutex) {
+        return nullptr;
+    }
+
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    int index = find_index(ip);
+    ChromecastController* result = index >= 0 ? entries[index].controller.get() : nullptr;
+    xSemaphoreGive(pool_mutex);
+    return result;
+}
+
+size_t ChromecastConnectionPool::size() const {
+    size_t count = 0;
+    for (const Entry& entry : entries) {
+        if (entry.controller) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void ChromecastConnectionPool::for_each(const std::function<void(ChromecastController&)>& fn) {
+    if (!pool_mutex || !fn) {
+        return;
+    }
+
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    for (Entry& entry : entries) {
+        if (entry.controller && entry.controller->is_connected()) {
+            fn(*entry.controller);
+        }
+    }
+    xSemaphoreGive(pool_mutex);
+}
+
+// Shared by the requests of one fan_out(); whichever finishes last reports
+struct ChromecastConnectionPool::FanoutState {
+    std::array<FanoutResult, MAX_CONNECTIONS> results;
+    std::array<std::atomic<bool>, MAX_CONNECTIONS> finished{};     // Per result, so each counts once
+    size_t count = 0;
+    std::atomic<int> remaining{1};      // The issuer's share, until every request is out
+    FanoutCallback done;
+
+    void finish_one() {
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1 && done) {
+            done(results.data(), count);
+        }
+    }
+
+    bool claim(size_t slot) { return !finished[slot].exchange(true, std::memory_order_acq_rel); }
+};
+
+static bool fan_out_send(ChromecastController& controller, ChromecastConnectionPool::FanoutCommand command,
+                         float level, ChromecastController::ResponseCallback callback, uint32_t timeout_ms) {
+    switch (command) {
+        case ChromecastConnectionPool::FANOUT_SET_VOLUME:
+            return controller.set_volume(level, false, std::move(callback), timeout_ms);
+        case ChromecastConnectionPool::FANOUT_MUTE:
+            return controller.set_muted(true, std::move(callback), timeout_ms);
+        case ChromecastConnectionPool::FANOUT_UNMUTE:
+            return controller.set_muted(false, std::move(callback), timeout_ms);
+        case ChromecastConnectionPool::FANOUT_PLAY:
+            return controller.play(std::move(callback), timeout_ms);
+        case ChromecastConnectionPool::FANOUT_PAUSE:
+            return controller.pause(std::move(callback), timeout_ms);
+        case ChromecastConnectionPool::FANOUT_STOP:
+            return controller.stop_media(std::move(callback), timeout_ms);
+    }
+    return false;
+}
+
+size_t ChromecastConnectionPool::fan_out(FanoutCommand command, float level, const FanoutCallback& done,
+                                         uint32_t timeout_ms) {
+    std::shared_ptr<FanoutState> state = std::make_shared<FanoutState>();
+    state->done = done;
+    if (!pool_mutex) {
+        state->finish_one();
+        return 0;
+    }
+
+    size_t sent = 0;
+    int64_t start_us = esp_timer_get_time();
+    // Sends only queue the frame and wake the I/O task, which writes every
+    // device's queue in its next pass
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    for (Entry& entry : entries) {
+        if (!entry.controller || !entry.controller->is_connected()) {
+            continue;
+        }
+        size_t slot = state->count++;
+        FanoutResult& result = state->results[slot];
+        result.ip = entry.ip;
+        result.sent = false;
+        result.result = CastRequestTable::RESULT_CANCELLED;
+        result.rtt_ms = 0;
+
+        state->remaining.fetch_add(1, std::memory_order_relaxed);
+        auto callback = [state, slot](CastRequestTable::Result outcome, const CastPayload*, uint32_t rtt_ms) {
+            if (state->claim(slot)) {
+                state->results[slot].result = outcome;
+                state->results[slot].rtt_ms = rtt_ms;
+                state->finish_one();
+            }
+        };
+        // Marked before sending: the ack may arrive before the send returns
+        result.sent = true;
+        if (fan_out_send(*entry.controller, command, level, callback, timeout_ms)) {
+            sent++;
+        } else if (state->claim(slot)) {
+            // Discarded untracked: the callback will not run
+            result.sent = false;
+            state->finish_one();
+        }
+    }
+    xSemaphoreGive(pool_mutex);
+
+    ESP_LOGI(TAG, "Fan-out command %d queued to %u of %u devices in %lld us", command, (unsigned)sent,
+             (unsigned)state->count, (long long)(esp_timer_get_time() - start_us));
+    state->finish_one();
+    return sent;
+}
+
+bool ChromecastConnectionPool::observe(const std::string& ip, int port, const CastObserver::StatusCallback& callback) {
+    if (!pool_mutex && !start()) {
+        return false;
+    }
+
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    bool known = find_observer(ip) >= 0;
+    xSemaphoreGive(pool_mutex);
+    if (known) {
+        return true;
+    }
+
+    // Handshake outside the pool lock, as in add()
+    std::unique_ptr<CastObserver> observer(new (std::nothrow) CastObserver(ip, port, callback));
+    if (!observer || !observer->connect()) {
+        ESP_LOGE(TAG, "Failed to observe %s", ip.c_str());
+        return false;
+    }
+
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    int index = -1;
+    for (size_t i = 0; i < MAX_OBSERVERS; i++) {
+        if (!observers[i].observer) {
+            index = i;
+            break;
+        }
+    }
+    if (index < 0) {
+        xSemaphoreGive(pool_mutex);
+        ESP_LOGW(TAG, "No observer slot left for %s", ip.c_str());
+        return false;
+    }
+
+    ObserverEntry& entry = observers[index];
+    entry.observer = std::move(observer);
+    entry.wheel_slot = pick_wheel_slot();
+    wheel[entry.wheel_slot] |= (1u << (OBSERVER_BIT + index));
+    xSemaphoreGive(pool_mutex);
+
+    ESP_LOGI(TAG, "Observing %s (observer %d, heartbeat phase %d)", ip.c_str(), index, entry.wheel_slot);
+    return true;
+}
+
+bool ChromecastConnectionPool::unobserve(const std::string& ip) {
+    if (!pool_mutex) {
+        return false;
+    }
+
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    int index = find_observer(ip);
+    if (index >= 0) {
+        release_observer(index);
+    }
+    xSemaphoreGive(pool_mutex);
+    return index >= 0;
+}
+
+bool ChromecastConnectionPool::get_observed_status(const std::string& ip, CastObserver::Status& out) {
+    if (!pool_mutex) {
+        return false;
+    }
+
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    int index = find_observer(ip);
+    if (index >= 0) {
+        out = observers[index].observer->get_status();
+    }
+    xSemaphoreGive(pool_mutex);
+    return index >= 0;
+}
+
+void ChromecastConnectionPool::advance_wheel() {
+    wheel_position = (wheel_position + 1) % WHEEL_SLOTS;
+
+    uint32_t due = wheel[wheel_position];
+    for (size_t i = 0; due && i < MAX_CONNECTIONS; i++) {
+        if ((due & (1u << i)) && entries[i].controller) {
+            entries[i].controller->send_heartbeat();
+        }
+    }
+
+    // Each observer pings on every other visit to its slot
+    TickType_t now = xTaskGetTickCount();
+    for (size_t i = 0; due && i < MAX_OBSERVERS; i++) {
+        if ((due & (1u << (OBSERVER_BIT + i))) && observers[i].observer && !observers[i].observer->tick(now)) {
+            drop_observer(i);
+        }
+    }
+}
+
+// Caller holds pool_mutex
+void ChromecastConnectionPool::drop_entry(int index) {
+    ESP_LOGW(TAG, "Pooled device %s dropped", entries[index].ip.c_str());
+    if (entries[index].wheel_slot >= 0) {
+        wheel[entries[index].wheel_slot] &= ~(1u << index);
+        entries[index].wheel_slot = -1;
+    }
+    entries[index].controller->mark_connection_failed();
+}
+
+// Caller holds pool_mutex
+void ChromecastConnectionPool::drop_observer(int index) {
+    ESP_LOGW(TAG, "Observed device %s dropped", observers[index].observer->get_ip().c_str());
+    // The callback hears connected false once; the slot is free for the next observe()
+    observers[index].observer->close();
+    release_observer(index);
+}
+
+void ChromecastConnectionPool::service_connections() {
+    fd_set read_fds;
+    FD_ZERO(&read_fds);
+    int max_fd = -1;
+    bool buffered = false;
+
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+        ChromecastController* controller = entries[i].controller.get();
+        if (!controller || !controller->is_connected()) {
+            continue;
+        }
+        // Write what was queued since the last pass (heartbeats, PONGs, commands)
+        if (!controller->flush_tx()) {
+            drop_entry(i);
+            continue;
+        }
+        int fd = controller->get_socket_fd();
+        if (fd >= 0) {
+            FD_SET(fd, &read_fds);
+            max_fd = std::max(max_fd, fd);
+        }
+        // Another thread queueing a message wakes select() through this
+        int wake_fd = controller->get_tx_wake_fd();
+        if (wake_fd >= 0) {
+            FD_SET(wake_fd, &read_fds);
+            max_fd = std::max(max_fd, wake_fd);
+        }
+        buffered = buffered || controller->has_buffered_input();
+    }
+    for (const ObserverEntry& entry : observers) {
+        int fd = entry.observer ? entry.observer->get_socket_fd() : -1;
+        if (fd >= 0) {
+            FD_SET(fd, &read_fds);
+            max_fd = std::max(max_fd, fd);
+            buffered = buffered || entry.observer->has_buffered_input();
+        }
+    }
+    xSemaphoreGive(pool_mutex);
+
+    // Sleep until a socket is readable or the next heartbeat slot is due
+    TickType_t now = xTaskGetTickCount();
+    TickType_t wait_ticks = (int32_t)(next_wheel_tick - now) > 0 ? next_wheel_tick - now : 0;
+    if (buffered) {
+        wait_ticks = 0;
+    }
+
+    if (max_fd >= 0) {
+        struct timeval timeout;
+        uint32_t wait_ms = pdTICKS_TO_MS(wait_ticks);
+        timeout.tv_sec = wait_ms / 1000;
+        timeout.tv_usec = (wait_ms % 1000) * 1000;
+        int ready = select(max_fd + 1, &read_fds, nullptr, nullptr, &timeout);
+        if (ready < 0) {
+            // A socket was closed under us by remove(); rebuild the set
+            FD_ZERO(&read_fds);
+        }
+    } else if (wait_ticks > 0) {
+        vTaskDelay(wait_ticks);
+    }
+
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+        ChromecastController* controller = entries[i].controller.get();
+        if (!controller || !controller->is_connected()) {
+            continue;
+        }
+
+        int wake_fd = controller->get_tx_wake_fd();
+        if (wake_fd >= 0 && FD_ISSET(wake_fd, &read_fds)) {
+            // Cleared before the write, so a message queued meanwhile wakes us again
+            controller->clear_tx_wake();
+            if (!controller->flush_tx()) {
+                drop_entry(i);
+                continue;
+            }
+        }
+
+        int fd = controller->get_socket_fd();
+        bool readable = (fd >= 0 && FD_ISSET(fd, &read_fds)) || controller->has_buffered_input();
+        if (!readable) {
+            continue;
+        }
+
+        int processed = 0;
+        ChromecastController::ReceiveResult result = controller->receive_available(processed);
+        if (result == ChromecastController::RECEIVE_CLOSED ||
+            result == ChromecastController::RECEIVE_READ_ERROR ||
+            result == ChromecastController::RECEIVE_STREAM_ERROR) {
+            drop_entry(i);
+        }
+    }
+
+    for (size_t i = 0; i < MAX_OBSERVERS; i++) {
+        CastObserver* observer = observers[i].observer.get();
+        int fd = observer ? observer->get_socket_fd() : -1;
+        if (fd < 0 || (!FD_ISSET(fd, &read_fds) && !observer->has_buffered_input())) {
+            continue;
+        }
+        if (observer->read_available() == CastObserver::READ_FAILED) {
+            drop_observer(i);
+        }
+    }
+
+    if ((int32_t)(xTaskGetTickCount() - next_wheel_tick) >= 0) {
+        next_wheel_tick += pdMS_TO_TICKS(WHEEL_TICK_MS);
+        advance_wheel();
+    }
+    xSemaphoreGive(pool_mutex);
+}
+
+void ChromecastConnectionPool::io_task(void* parameter) {
+    ChromecastConnectionPool* pool = static_cast<ChromecastConnectionPool*>(parameter);
+
+    ESP_LOGI(TAG, "Pool I/O task started - Free heap: %d bytes", esp_get_free_heap_size());
+
+    while (pool->running) {
+        pool->service_connections();
+    }
+
+    ESP_LOGI(TAG, "Pool I/O task ended");
+    pool->io_task_handle = nullptr;
+    mem_task_delete(nullptr);
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "chromecast_controller.h"
+#include "cast_observer.h"
+
+/**
+ * ChromecastConnectionPool - Drives several Chromecast connections from one task
+ *
+ * Features:
+ * - A single I/O task multiplexes every TLS session with select()
+ * - Heartbeats are scheduled on a shared timing wheel instead of one
+ *   FreeRTOS timer per device, and are staggered across wheel slots
+ * - Each pooled ChromecastController keeps its own callbacks
+ * - Saves the per-device 8KB receive task stack and timer
+ * - Writes every controller's send queue from the I/O task, so sends from
+ *   other threads never touch a TLS session
+ * - Observers (observe()): listen-only connections to further speakers that
+ *   follow their receiver and media status broadcasts, a CastObserver each
+ *   instead of a full controller
+ * - Fan-out (fan_out()): one command queued to every connected device at
+ *   once, written in the same I/O pass, its acks collected through each
+ *   controller's requestId table; a whole-house action takes one round
+ *   trip instead of one per device
+ *
+ * Callbacks run on the pool's I/O task. They must not call remove() or
+ * stop() on the pool that invoked them.
+ */
+class ChromecastConnectionPool {
+public:
+    static constexpr size_t MAX_CONNECTIONS = 4;
+    static constexpr size_t MAX_OBSERVERS = 8;
+    static constexpr int WHEEL_SLOTS = 10;
+    static constexpr int WHEEL_TICK_MS = ChromecastController::HEARTBEAT_INTERVAL_MS / WHEEL_SLOTS;
+    static constexpr uint32_t IO_TASK_STACK_SIZE = 6144;
+    static constexpr UBaseType_t IO_TASK_PRIORITY = TASK_PLAN_CAST_POOL_PRIORITY;
+
+    static constexpr uint32_t FANOUT_TIMEOUT_MS = 2000;
+
+    // Invoked before connecting so callers can install per-device callbacks
+    using SetupCallback = std::function<void(ChromecastController&)>;
+
+    enum FanoutCommand {
+        FANOUT_SET_VOLUME,      // To level, unmuted
+        FANOUT_MUTE,            // Levels kept
+        FANOUT_UNMUTE,
+        FANOUT_PLAY,            // Media commands skip devices with no media loaded
+        FANOUT_PAUSE,
+        FANOUT_STOP
+    };
+
+    struct FanoutResult {
+        std::string ip;
+        bool sent;                          // false: no media session, or the send failed
+        CastRequestTable::Result result;    // RESULT_CANCELLED when not sent
+        uint32_t rtt_ms;
+    };
+
+    // Called once, after the last device answered or timed out
+    using FanoutCallback = std::function<void(const FanoutResult* results, size_t count)>;
+
+private:
+    struct Entry {
+        std::unique_ptr<ChromecastController> controller;
+        std::string ip;
+        int wheel_slot = -1;
+    };
+
+    struct ObserverEntry {
+        std::unique_ptr<CastObserver> observer;
+        int wheel_slot = -1;
+    };
+
+    struct FanoutState;
+
+    std::array<Entry, MAX_CONNECTIONS> entries;
+    std::array<ObserverEntry, MAX_OBSERVERS> observers;
+    // Bitmask per slot: entry indices, then observer indices from OBSERVER_BIT
+    std::array<uint32_t, WHEEL_SLOTS> wheel;
+    int wheel_position;
+    TickType_t next_wheel_tick;
+
+    SemaphoreHandle_t pool_mutex;
+    TaskHandle_t io_task_handle;
+    volatile bool running;
+
+    static constexpr int OBSERVER_BIT = MAX_CONNECTIONS;
+    static_assert(MAX_CONNECTIONS + MAX_OBSERVERS <= 32, "wheel slots are 32-bit masks");
+
+    int find_index(const std::string& ip) const;
+    int find_observer(const std::string& ip) const;
+    int pick_wheel_slot() const;
+    void release_entry(int index);
+    void drop_entry(int index);
+    void release_observer(int index);
+    void drop_observer(int index);
+    void service_connections();
+    void advance_wheel();
+
+    static void io_task(void* parameter);
+
+public:
+    ChromecastConnectionPool();
+    ~ChromecastConnectionPool();
+
+    bool start();
+    void stop();
+
+    /**
+     * Connect to a device and add it to the pool.
+     * @return the pooled controller, or nullptr on failure. Owned by the pool.
+     */
+    ChromecastController* add(const std::string& ip, const SetupCallback& setup = nullptr);
+    bool remove(const std::string& ip);
+    ChromecastController* find(const std::string& ip);
+    size_t size() const;
+
+    // Apply fn to every connected controller (under the pool lock)
+    void for_each(const std::function<void(ChromecastController&)>& fn);
+
+    /**
+     * Send command to every connected device concurrently. Each device's
+     * request carries its own deadline of timeout_ms, so the whole action
+     * ends after the slowest ack or the timeout, whichever comes first.
+     * done gets one result per connected device, partial failures included.
+     * It runs on the I/O task, the request timer task, or (when nothing
+     * could be sent) the caller's, before fan_out() returns.
+     * Not from a pool callback: the pool lock is taken.
+     * @param level For FANOUT_SET_VOLUME, 0.0 to 1.0
+     * @return the number of devices the command went to
+     */
+    size_t fan_out(FanoutCommand command, float level, const FanoutCallback& done,
+                   uint32_t timeout_ms = FANOUT_TIMEOUT_MS);
+
+    /**
+     * Follow a speaker's status without controlling it. Connects on the
+     * caller's task; callback then runs on the I/O task with each status
+     * broadcast, and once with connected false if the link is lost, after
+     * which the observer is gone and can be added again.
+     * @return false if the connection failed or MAX_OBSERVERS are in use
+     */
+    bool observe(const std::string& ip, int port, const CastObserver::StatusCallback& callback);
+    bool unobserve(const std::string& ip);
+    bool get_observed_status(const std::string& ip, CastObserver::Status& out);
+};
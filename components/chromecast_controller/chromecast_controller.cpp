@@ -1,9 +1,29 @@
 #include "chromecast_controller.h"
+#include "cast_json_writer.h"
 #include <cstring>
 #include <sstream>
 #include <iomanip>
 #include "esp_crt_bundle.h"
 #include "esp_heap_caps.h"
+#include "media_server.h"
+#include "mem_budget.h"
+#include "mem_tag.hpp"
+#include "mem_task.h"
+#include "telemetry.h"
+#include "telemetry_trace.h"
+#include "tls_profile.h"
+#include "traffic_capture.h"
+#include <fcntl.h>
+#include <algorithm>
+#include <cmath>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include "esp_random.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "esp_vfs_eventfd.h"
+#include "sdkconfig.h"
+#include <unistd.h>
 
 static const char* TAG = "ChromecastController";
 
@@ -17,27 +37,177 @@ ChromecastController::ChromecastController()
     , current_state(DISCONNECTED)
     , request_id_counter(1)
     , virtual_connection_established(false)
+    , launch_request_id(0)
+    , app_connection_established(false)
+    , app_connection_speculative(false)
+    , media_status()
+    , pending_load()
+    , rx_buffer(nullptr)
+    , rx_capacity(0)
+    , rx_length(0)
+    , tx_queue(nullptr)
+    , tx_flush(nullptr)
+    , tx_length(0)
+    , send_mutex(nullptr)
+    , write_mutex(nullptr)
+    , tx_wake_fd(-1)
+    , external_io(false)
+    , connect_task_handle(nullptr)
+    , connect_cancelled(false)
+    , pending_connect_port(CHROMECAST_PORT)
+    , auto_reconnect(true)
+    , reconnect_stop(false)
+    , reconnect_task_handle(nullptr)
+    , liveness_timeout_ms(LIVENESS_TIMEOUT_MS)
+    , last_rx_tick(0)
+    , last_pong_tick(0)
+    , volume_lock(portMUX_INITIALIZER_UNLOCKED)
+    , volume_task_handle(nullptr)
+    , volume_task_stop(false)
+    , volume_target{0.0f, false}
+    , volume_sent{-1.0f, false}
+    , volume_reported{-1.0f, false}
+    , volume_target_pending(false)
+    , volume_in_flight(false)
+    , volume_last_request_tick(0)
+    , volume_min_interval_ms(1000 / VOLUME_DEFAULT_RATE_HZ)
+    , request_table()
+    , request_mutex(nullptr)
+    , request_timer(nullptr)
+    , device_auth()
+#ifdef CONFIG_CAST_DEVICE_AUTH_REQUIRED
+    , device_auth_required(true)
+#else
+    , device_auth_required(false)
+#endif
+    , device_auth_rejected(false)
+    , replaying(false)
+    , group_member_count(0)
+    , group_lock(portMUX_INITIALIZER_UNLOCKED)
 {
+    // Device auth is binary and handled before the JSON parse
+    namespace_handlers[CAST_NS_HEARTBEAT] = [this](const CastMessageView& message, const CastPayload& payload) {
+        process_heartbeat_message(message, payload);
+    };
+    namespace_handlers[CAST_NS_CONNECTION] = [this](const CastMessageView&, const CastPayload& payload) {
+        process_connection_message(payload);
+    };
+    namespace_handlers[CAST_NS_RECEIVER] = [this](const CastMessageView&, const CastPayload& payload) {
+        process_receiver_message(payload);
+    };
+    namespace_handlers[CAST_NS_MEDIA] = [this](const CastMessageView&, const CastPayload& payload) {
+        process_media_message(payload);
+    };
+    namespace_handlers[CAST_NS_MULTIZONE] = [this](const CastMessageView&, const CastPayload& payload) {
+        process_multizone_message(payload);
+    };
+}
+
+bool ChromecastController::register_namespace_handler(const char* ns, NamespaceHandler handler) {
+    if (!ns || CastNamespaceRegistry::platform_id(ns, strlen(ns)) != CAST_NS_UNKNOWN) {
+        return false;
+    }
+    uint8_t id = namespaces.add(ns);
+    if (id == CAST_NS_UNKNOWN) {
+        ESP_LOGE(TAG, "No room to register namespace %s", ns);
+        return false;
+    }
+    namespace_handlers[id] = std::move(handler);
+    return true;
 }
 
 ChromecastController::~ChromecastController() {
+    // Let an in-flight async connect or reconnect unwind before tearing down
+    stop_volume_task();
+    stop_reconnect();
+    cancel_connect();
+    while (connect_task_handle) {
+        vTaskDelay(pdMS_TO_TICKS(TLS_CONNECT_POLL_MS));
+    }
+
     disconnect();
+
+    if (heartbeat_timer) {
+        xTimerDelete(heartbeat_timer, portMAX_DELAY);
+        heartbeat_timer = nullptr;
+    }
+    if (send_mutex) {
+        vSemaphoreDelete(send_mutex);
+        send_mutex = nullptr;
+    }
+    if (write_mutex) {
+        vSemaphoreDelete(write_mutex);
+        write_mutex = nullptr;
+    }
+    if (tx_wake_fd >= 0) {
+        close(tx_wake_fd);
+        tx_wake_fd = -1;
+    }
+    if (request_timer) {
+        xTimerDelete(request_timer, portMAX_DELAY);
+        request_timer = nullptr;
+    }
+    if (request_mutex) {
+        vSemaphoreDelete(request_mutex);
+        request_mutex = nullptr;
+    }
+    heap_caps_free(tx_queue);
+    heap_caps_free(tx_flush);
+    tx_queue = nullptr;
+    tx_flush = nullptr;
 }
 
 bool ChromecastController::initialize() {
     ESP_LOGI(TAG, "Initializing ChromecastController");
 
-    // Create heartbeat timer
-    heartbeat_timer = xTimerCreate(
+    // Pooled controllers are driven by ChromecastConnectionPool's timing wheel
+    if (!external_io) {
+        heartbeat_timer = xTimerCreate(
         "heartbeat_timer",
-        pdMS_TO_TICKS(HEARTBEAT_INTERVAL_MS),
-        pdTRUE,  // Auto-reload
-        this,    // Timer ID (pass this instance)
-        heartbeat_timer_callback
-    );
+            pdMS_TO_TICKS(HEARTBEAT_INTERVAL_MS),
+            pdTRUE,  // Auto-reload
+            this,    // Timer ID (pass this instance)
+            heartbeat_timer_callback
+        );
+
+        if (heartbeat_timer == nullptr) {
+            ESP_LOGE(TAG, "Failed to create heartbeat timer");
+            return false;
+        }
+    }
+
+    // Sends are queued by the caller, the heartbeat timer and the receive task
+    send_mutex = xSemaphoreCreateMutex();
+    write_mutex = xSemaphoreCreateMutex();
+    if (send_mutex == nullptr || write_mutex == nullptr) {
+        ESP_LOGE(TAG, "Failed to create send mutexes");
+        return false;
+    }
+
+    // Wakes the I/O task out of select() when another thread queues a message
+    esp_vfs_eventfd_config_t eventfd_config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+    eventfd_config.max_fds = TX_WAKE_MAX_FDS;
+    esp_err_t err = esp_vfs_eventfd_register(&eventfd_config);
+    if (err == ESP_OK || err == ESP_ERR_INVALID_STATE) {
+        tx_wake_fd = eventfd(0, 0);
+    }
+    if (tx_wake_fd < 0) {
+        ESP_LOGW(TAG, "No eventfd for the send queue, senders will write themselves");
+    }
+
+    request_mutex = xSemaphoreCreateMutex();
+    request_timer = xTimerCreate("cast_req_timeout", pdMS_TO_TICKS(REQUEST_TIMEOUT_MS), pdFALSE,
+                                 this, request_timer_callback);
+    if (request_mutex == nullptr || request_timer == nullptr) {
+        ESP_LOGE(TAG, "Failed to create request tracking primitives");
+        return false;
+    }
 
-    if (heartbeat_timer == nullptr) {
-        ESP_LOGE(TAG, "Failed to create heartbeat timer");
+    // Keep the send queue in internal RAM so every PING/PONG reuses it
+    tx_queue = (uint8_t*)heap_caps_malloc(TX_QUEUE_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    tx_flush = (uint8_t*)heap_caps_malloc(TX_QUEUE_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (tx_queue == nullptr || tx_flush == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate 2 x %d byte send queue", TX_QUEUE_SIZE);
         return false;
     }
 
@@ -46,50 +216,117 @@ bool ChromecastController::initialize() {
     return true;
 }
 
+// The sessions live in the TLS profile's cache, shared with the other clients
+size_t ChromecastController::export_sessions(uint8_t* out, size_t capacity) {
+    return tls_profile_sessions_export(out, capacity);
+}
+
+size_t ChromecastController::import_sessions(const uint8_t* data, size_t length) {
+    return tls_profile_sessions_import(data, length);
+}
+
+void ChromecastController::report_connect_stage(ConnectStage stage) {
+    if (connect_progress_callback) {
+        connect_progress_callback(stage);
+    }
+}
+
 bool ChromecastController::establish_tls_connection() {
     ESP_LOGI(TAG, "Establishing TLS connection to %s:%d (skipping certificate verification)", chromecast_ip.c_str(), chromecast_port);
 
     esp_tls_cfg_t cfg = {};
-    cfg.timeout_ms = 10000;
+    cfg.timeout_ms = TLS_CONNECT_TIMEOUT_MS;
     cfg.use_secure_element = false;
-    cfg.skip_common_name = true;
-    // Skip certificate verification for Chromecast connections
-    // This is necessary because Chromecast devices use self-signed certificates
-    // With CONFIG_ESP_TLS_INSECURE=y and CONFIG_ESP_TLS_SKIP_SERVER_CERT_VERIFY=y,
-    // setting crt_bundle_attach to nullptr will skip certificate verification
-    cfg.crt_bundle_attach = nullptr;
+    cfg.non_block = true;
+    // Chromecast devices use self-signed certificates: the Cast profile
+    // attaches no bundle, which with CONFIG_ESP_TLS_SKIP_SERVER_CERT_VERIFY=y
+    // skips certificate verification
+    tls_profile_apply(&cfg, TLS_PROFILE_CAST);
+
+    // Offer the previous session so a known speaker can skip the full handshake
+    const std::string cache_key = device_key();
+    tls_profile_session_offer(&cfg, cache_key.c_str());
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    const bool session_offered = cfg.client_session != nullptr;
+#endif
 
     tls_handle = esp_tls_init();
     if (!tls_handle) {
         ESP_LOGE(TAG, "Failed to initialize TLS handle");
+        tls_profile_session_finish(&cfg, nullptr, cache_key.c_str());
         current_state = ERROR_STATE;
         if (state_callback) state_callback(current_state);
         return false;
     }
 
-    int ret = esp_tls_conn_new_sync(chromecast_ip.c_str(), chromecast_ip.length(), chromecast_port, &cfg, tls_handle);
+    current_state = CONNECTING;
+    if (state_callback) state_callback(current_state);
+    report_connect_stage(CONNECT_STAGE_TLS_HANDSHAKE);
+
+    // Keep the CPU at full clock for the key exchange; with DFS it would
+    // otherwise run at the idle minimum between polls
+    static esp_pm_lock_handle_t handshake_lock = [] {
+        esp_pm_lock_handle_t lock = nullptr;
+        esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "cast_tls", &lock);
+        return lock;
+    }();
+    if (handshake_lock) esp_pm_lock_acquire(handshake_lock);
+
+    // Drive the handshake step by step so it can be cancelled and timed out
+    telemetry_ui_blocking("cast tls");
+    TickType_t start = xTaskGetTickCount();
+    int64_t handshake_start_us = esp_timer_get_time();
+    int ret = 0;
+    while ((ret = esp_tls_conn_new_async(chromecast_ip.c_str(), chromecast_ip.length(), chromecast_port, &cfg, tls_handle)) == 0) {
+        if (connect_cancelled) {
+            ESP_LOGW(TAG, "TLS connection to %s cancelled", chromecast_ip.c_str());
+            break;
+        }
+        if (xTaskGetTickCount() - start > pdMS_TO_TICKS(TLS_CONNECT_TIMEOUT_MS)) {
+            ESP_LOGE(TAG, "TLS connection to %s timed out", chromecast_ip.c_str());
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(TLS_CONNECT_POLL_MS));
+    }
+    if (handshake_lock) esp_pm_lock_release(handshake_lock);
+    if (ret == 1) {
+        uint32_t handshake_ms = (uint32_t)((esp_timer_get_time() - handshake_start_us) / 1000);
+        telemetry_record(TELEMETRY_TLS_HANDSHAKE, handshake_ms);
+        TELEMETRY_HIST_RECORD("tls cast", TELEMETRY_HIST_MS, handshake_ms);
+    }
+
+    tls_profile_session_finish(&cfg, ret == 1 ? tls_handle : nullptr, cache_key.c_str());
+
     if (ret != 1) {
         ESP_LOGE(TAG, "Failed to establish TLS connection, ret=%d", ret);
         esp_tls_conn_destroy(tls_handle);
         tls_handle = nullptr;
-        current_state = ERROR_STATE;
+        current_state = connect_cancelled ? DISCONNECTED : ERROR_STATE;
         if (state_callback) state_callback(current_state);
         return false;
     }
 
-    ESP_LOGI(TAG, "TLS connection established successfully");
-    current_state = CONNECTING;
-    if (state_callback) state_callback(current_state);
+    // The receive path expects blocking reads once the handshake is done
+    int sockfd = get_socket_fd();
+    if (sockfd >= 0) {
+        int flags = fcntl(sockfd, F_GETFL, 0);
+        fcntl(sockfd, F_SETFL, flags & ~O_NONBLOCK);
+    }
+
+    uint32_t handshake_ms = pdTICKS_TO_MS(xTaskGetTickCount() - start);
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    ESP_LOGI(TAG, "TLS connection established in %u ms (%s)", handshake_ms,
+             session_offered ? "cached session offered" : "full handshake");
+#else
+    ESP_LOGI(TAG, "TLS connection established in %u ms", handshake_ms);
+#endif
     return true;
 }
 
 bool ChromecastController::send_virtual_connect() {
     ESP_LOGI(TAG, "Sending virtual CONNECT message");
 
-    // Create CONNECT message
-    std::string connect_msg = create_json_message("CONNECT");
-
-    bool result = send_protobuf_message(NAMESPACE_CONNECTION, connect_msg);
+    bool result = send_control_message(NAMESPACE_CONNECTION, "CONNECT");
     if (result) {
         virtual_connection_established = true;
         current_state = CONNECTED;
@@ -102,119 +339,350 @@ bool ChromecastController::send_virtual_connect() {
     return result;
 }
 
-bool ChromecastController::send_protobuf_message(const std::string& namespace_str, const std::string& payload) {
-    if (!tls_handle) {
-        ESP_LOGE(TAG, "TLS connection not established");
+bool ChromecastController::send_protobuf_message(const char* namespace_str, const char* payload, const char* destination) {
+    // Create protobuf message; all fields point at existing storage
+    Extensions__Api__CastChannel__CastMessage message = EXTENSIONS__API__CAST_CHANNEL__CAST_MESSAGE__INIT;
+
+    message.protocol_version = EXTENSIONS__API__CAST_CHANNEL__CAST_MESSAGE__PROTOCOL_VERSION__CASTV2_1_0;
+    message.source_id = const_cast<char*>(sender_id.c_str());
+    message.destination_id = const_cast<char*>(destination ? destination : destination_id.c_str());
+    message.namespace_ = const_cast<char*>(namespace_str);
+    message.payload_type = EXTENSIONS__API__CAST_CHANNEL__CAST_MESSAGE__PAYLOAD_TYPE__STRING;
+    message.payload_utf8 = const_cast<char*>(payload);
+
+    if (!send_cast_message(message)) {
         return false;
     }
+    ESP_LOGD(TAG, "SENT -> Payload: %s", payload);
+    return true;
+}
 
-    // Create protobuf message
+bool ChromecastController::send_binary_message(const char* namespace_str, const uint8_t* data, size_t length,
+                                               const char* destination) {
     Extensions__Api__CastChannel__CastMessage message = EXTENSIONS__API__CAST_CHANNEL__CAST_MESSAGE__INIT;
 
     message.protocol_version = EXTENSIONS__API__CAST_CHANNEL__CAST_MESSAGE__PROTOCOL_VERSION__CASTV2_1_0;
     message.source_id = const_cast<char*>(sender_id.c_str());
-    message.destination_id = const_cast<char*>(destination_id.c_str());
-    message.namespace_ = const_cast<char*>(namespace_str.c_str());
-    message.payload_type = EXTENSIONS__API__CAST_CHANNEL__CAST_MESSAGE__PAYLOAD_TYPE__STRING;
-    message.payload_utf8 = const_cast<char*>(payload.c_str());
+    message.destination_id = const_cast<char*>(destination ? destination : destination_id.c_str());
+    message.namespace_ = const_cast<char*>(namespace_str);
+    message.payload_type = EXTENSIONS__API__CAST_CHANNEL__CAST_MESSAGE__PAYLOAD_TYPE__BINARY;
+    message.has_payload_binary = true;
+    message.payload_binary.data = const_cast<uint8_t*>(data);
+    message.payload_binary.len = length;
+
+    return send_cast_message(message);
+}
+
+bool ChromecastController::io_task_writes() const {
+    // Before the receive task starts (the virtual CONNECT) the sender writes itself
+    return tx_wake_fd >= 0 && (external_io || receive_task_handle);
+}
+
+bool ChromecastController::send_cast_message(const Extensions__Api__CastChannel__CastMessage& message) {
+    if (replaying) {
+        return true;        // Replies to recorded traffic go nowhere
+    }
+    if (!tls_handle || !tx_queue || !send_mutex) {
+        ESP_LOGE(TAG, "TLS connection not established");
+        return false;
+    }
+    if (!device_auth_allows(message)) {
+        ESP_LOGW(TAG, "Not sending %s message: device not authenticated (%s)", message.namespace_,
+                 CastDeviceAuth::status_name(device_auth.get_status()));
+        return false;
+    }
 
-    // Serialize the message
     size_t message_size = extensions__api__cast_channel__cast_message__get_packed_size(&message);
-    uint8_t* buffer = (uint8_t*)malloc(message_size + 4); // +4 for length prefix
+    size_t total_size = message_size + CastFrameCodec::HEADER_SIZE;
+    if (total_size > TX_QUEUE_SIZE) {
+        return send_oversized_message(message, message_size);
+    }
+
+    xSemaphoreTake(send_mutex, portMAX_DELAY);
+    if (tx_length + total_size > TX_QUEUE_SIZE) {
+        // The I/O task is behind: write what is queued to make room
+        xSemaphoreGive(send_mutex);
+        if (!flush_tx()) {
+            return false;
+        }
+        xSemaphoreTake(send_mutex, portMAX_DELAY);
+        if (tx_length + total_size > TX_QUEUE_SIZE) {
+            xSemaphoreGive(send_mutex);
+            ESP_LOGE(TAG, "Send queue full, dropping %s message", message.namespace_);
+            return false;
+        }
+    }
+
+    // Big-endian length, then the protobuf message straight after it
+    uint8_t* frame = tx_queue + tx_length;
+    CastFrameCodec::write_header(frame, message_size);
+    extensions__api__cast_channel__cast_message__pack(&message, frame + CastFrameCodec::HEADER_SIZE);
+    bool was_empty = tx_length == 0;
+    tx_length += total_size;
+    xSemaphoreGive(send_mutex);
+
+    ESP_LOGD(TAG, "QUEUED -> Namespace: %s, Size: %d bytes", message.namespace_, total_size);
+    if (!io_task_writes()) {
+        return flush_tx();
+    }
+    if (was_empty) {
+        // Timer callbacks and the GUI only queue; the I/O task writes
+        uint64_t one = 1;
+        write(tx_wake_fd, &one, sizeof(one));
+    }
+    return true;
+}
 
+bool ChromecastController::send_oversized_message(const Extensions__Api__CastChannel__CastMessage& message,
+                                                  size_t message_size) {
+    size_t total_size = message_size + CastFrameCodec::HEADER_SIZE;
+    uint8_t* buffer = (uint8_t*)malloc(total_size);
     if (!buffer) {
         ESP_LOGE(TAG, "Memory allocation failed");
         return false;
     }
+    CastFrameCodec::write_header(buffer, message_size);
+    extensions__api__cast_channel__cast_message__pack(&message, buffer + CastFrameCodec::HEADER_SIZE);
+
+    // Rare (media LOADs with long metadata): written by the sender, after
+    // whatever is queued so the order on the wire holds
+    xSemaphoreTake(write_mutex, portMAX_DELAY);
+    bool ok = write_queued() && write_all(buffer, total_size);
+    xSemaphoreGive(write_mutex);
+    free(buffer);
 
-    // Pack message size (big-endian)
-    buffer[0] = (message_size >> 24) & 0xFF;
-    buffer[1] = (message_size >> 16) & 0xFF;
-    buffer[2] = (message_size >> 8) & 0xFF;
-    buffer[3] = message_size & 0xFF;
+    if (ok) {
+        ESP_LOGD(TAG, "SENT -> Namespace: %s, Size: %d bytes", message.namespace_, total_size);
+    }
+    return ok;
+}
 
-    // Pack the protobuf message
-    extensions__api__cast_channel__cast_message__pack(&message, buffer + 4);
+bool ChromecastController::write_all(const uint8_t* data, size_t length) {
+    size_t written = 0;
+    while (written < length && tls_handle) {
+        ssize_t sent = esp_tls_conn_write(tls_handle, data + written, length - written);
+        if (sent == ESP_TLS_ERR_SSL_WANT_READ || sent == ESP_TLS_ERR_SSL_WANT_WRITE) {
+            continue;
+        }
+        if (sent <= 0) {
+            break;
+        }
+        written += sent;
+    }
+    if (written != length) {
+        ESP_LOGE(TAG, "Failed to send: sent %d of %d bytes", written, length);
+        return false;
+    }
+    return true;
+}
 
-    // Send via TLS
-    size_t total_size = message_size + 4;
-    ssize_t sent = esp_tls_conn_write(tls_handle, buffer, total_size);
+// Caller holds write_mutex
+bool ChromecastController::write_queued() {
+    xSemaphoreTake(send_mutex, portMAX_DELAY);
+    size_t length = tx_length;
+    if (length > 0) {
+        // Senders carry on queueing into the other buffer during the write
+        std::swap(tx_queue, tx_flush);
+        tx_length = 0;
+    }
+    xSemaphoreGive(send_mutex);
 
-    free(buffer);
+    if (length == 0) {
+        return true;
+    }
+    // Everything queued since the last write goes out as one TLS record
+    if (!write_all(tx_flush, length)) {
+        return false;
+    }
+    ESP_LOGD(TAG, "SENT -> %d bytes", length);
+    return true;
+}
+
+bool ChromecastController::flush_tx() {
+    if (!write_mutex || !send_mutex) {
+        return false;
+    }
+
+    xSemaphoreTake(write_mutex, portMAX_DELAY);
+    bool ok = write_queued();
+    xSemaphoreGive(write_mutex);
+    return ok;
+}
 
-    if (sent != total_size) {
-        ESP_LOGE(TAG, "Failed to send message: sent %d of %d bytes", sent, total_size);
+void ChromecastController::clear_tx_wake() {
+    uint64_t count;
+    if (tx_wake_fd >= 0) {
+        read(tx_wake_fd, &count, sizeof(count));
+    }
+}
+
+bool ChromecastController::send_control_message(const char* namespace_str, const char* type, const char* destination,
+                                               ResponseCallback callback, uint32_t timeout_ms) {
+    uint32_t request_id = begin_request(type, std::move(callback), timeout_ms);
+
+    // Fixed {"type":...,"requestId":N} messages are written on the stack
+    CastJsonWriter<CONTROL_MESSAGE_SIZE> json;
+    json.field("type", type).field_uint("requestId", request_id).end();
+    if (!json.ok()) {
+        ESP_LOGE(TAG, "Control message %s does not fit in %d bytes", type, CONTROL_MESSAGE_SIZE);
+        discard_request(request_id);
         return false;
     }
+    return send_request(namespace_str, json.c_str(), destination, request_id);
+}
+
+// Commands the receiver answers with a status carrying our requestId
+static bool expects_response(const char* type) {
+    static const char* const tracked[] = {
+        "GET_STATUS", "SET_VOLUME", "LAUNCH", "STOP", "LOAD", "PLAY", "PAUSE", "SEEK", "GET_APP_AVAILABILITY"
+    };
+    for (const char* t : tracked) {
+        if (strcmp(type, t) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t ChromecastController::begin_request(const char* type, ResponseCallback callback, uint32_t timeout_ms) {
+    // 0 means "no requestId" on the wire and 0xFFFFFFFF is the table's tombstone
+    uint32_t request_id = request_id_counter++;
+    if (request_id == 0 || request_id == 0xFFFFFFFFu) {
+        request_id_counter = 2;
+        request_id = 1;
+    }
+
+    if (!request_mutex || (!callback && !expects_response(type))) {
+        return request_id;
+    }
+
+    // insert() only fails when full; checked first so the callback is still ours then
+    xSemaphoreTake(request_mutex, portMAX_DELAY);
+    bool tracked = request_table.pending() < CastRequestTable::CAPACITY &&
+                   request_table.insert(request_id, type, pdMS_TO_TICKS(timeout_ms), std::move(callback));
+    xSemaphoreGive(request_mutex);
+
+    if (tracked) {
+        arm_request_timer();
+    } else {
+        ESP_LOGW(TAG, "Request table full, %s #%u will not be tracked", type, request_id);
+        // A caller waiting on it would otherwise wait forever
+        if (callback) {
+            callback(CastRequestTable::RESULT_CANCELLED, nullptr, 0);
+        }
+    }
+    return request_id;
+}
 
-    ESP_LOGI(TAG, "SENT -> Namespace: %s, Size: %d bytes", namespace_str.c_str(), total_size);
-    ESP_LOGD(TAG, "SENT -> Payload: %s", payload.c_str());
+bool ChromecastController::send_request(const char* namespace_str, const char* payload, const char* destination,
+                                        uint32_t request_id) {
+    if (!send_protobuf_message(namespace_str, payload, destination)) {
+        discard_request(request_id);
+        return false;
+    }
     return true;
 }
 
-std::string ChromecastController::create_json_message(const std::string& type, uint32_t request_id, const cJSON* additional_data) {
-    // Check available memory before creating JSON
-    size_t free_heap = esp_get_free_heap_size();
-    if (free_heap < 8192) { // Require at least 8KB free heap
-        ESP_LOGW(TAG, "Insufficient memory for JSON creation: %d bytes available", free_heap);
-        return "{}"; // Return minimal valid JSON
+void ChromecastController::discard_request(uint32_t request_id) {
+    if (!request_mutex) {
+        return;
     }
+    xSemaphoreTake(request_mutex, portMAX_DELAY);
+    request_table.discard(request_id);
+    xSemaphoreGive(request_mutex);
+}
 
-    cJSON* json = cJSON_CreateObject();
-    if (!json) {
-        ESP_LOGE(TAG, "Failed to create JSON object");
-        return "{}";
-    }
-
-    // Add type field
-    if (!cJSON_AddStringToObject(json, "type", type.c_str())) {
-        ESP_LOGE(TAG, "Failed to add type to JSON");
-        cJSON_Delete(json);
-        return "{}";
-    }
-
-    // Add request ID
-    if (request_id == 0) {
-        request_id = request_id_counter++;
-    }
-    if (!cJSON_AddNumberToObject(json, "requestId", request_id)) {
-        ESP_LOGE(TAG, "Failed to add requestId to JSON");
-        cJSON_Delete(json);
-        return "{}";
-    }
-
-    // Add additional data if provided
-    if (additional_data) {
-        cJSON* item = nullptr;
-        cJSON_ArrayForEach(item, additional_data) {
-            if (item->string) {
-                cJSON* duplicate = cJSON_Duplicate(item, true);
-                if (duplicate) {
-                    if (!cJSON_AddItemToObject(json, item->string, duplicate)) {
-                        ESP_LOGW(TAG, "Failed to add item %s to JSON", item->string);
-                        cJSON_Delete(duplicate);
-                    }
-                }
-            }
+void ChromecastController::complete_request(const CastPayload& response) {
+    if (!response.has_request_id || response.request_id == 0 || !request_mutex) {
+        return;
+    }
+
+    bool failed = strcmp(response.type, "LOAD_FAILED") == 0 || strcmp(response.type, "LOAD_CANCELLED") == 0 ||
+                  strcmp(response.type, "INVALID_REQUEST") == 0 || strcmp(response.type, "LAUNCH_ERROR") == 0 ||
+                  strcmp(response.type, "INVALID_PLAYER_STATE") == 0;
+
+    CastRequestTable::Completion completion;
+    xSemaphoreTake(request_mutex, portMAX_DELAY);
+    bool found = request_table.complete(response.request_id,
+                                        failed ? CastRequestTable::RESULT_ERROR : CastRequestTable::RESULT_OK,
+                                        completion);
+    xSemaphoreGive(request_mutex);
+
+    if (found) {
+        ESP_LOGD(TAG, "Request #%u answered with %s in %u ms", response.request_id, response.type, completion.rtt_ms);
+        if (completion.callback) {
+            completion.callback(completion.result, &response, completion.rtt_ms);
+        }
+    }
+}
+
+void ChromecastController::cancel_pending_requests() {
+    if (!request_mutex) {
+        return;
+    }
+
+    CastRequestTable::Completion cancelled[CastRequestTable::CAPACITY];
+    xSemaphoreTake(request_mutex, portMAX_DELAY);
+    size_t count = request_table.cancel_all(cancelled, CastRequestTable::CAPACITY);
+    xSemaphoreGive(request_mutex);
+
+    for (size_t i = 0; i < count; i++) {
+        if (cancelled[i].callback) {
+            cancelled[i].callback(CastRequestTable::RESULT_CANCELLED, nullptr, 0);
         }
     }
+}
+
+void ChromecastController::arm_request_timer() {
+    if (!request_timer || !request_mutex) {
+        return;
+    }
 
-    char* json_string = cJSON_Print(json);
-    std::string result;
+    xSemaphoreTake(request_mutex, portMAX_DELAY);
+    TickType_t wait = request_table.next_deadline(xTaskGetTickCount());
+    xSemaphoreGive(request_mutex);
 
-    if (json_string) {
-        result = std::string(json_string);
-        cJSON_free(json_string);
+    // One one-shot timer tracks the earliest deadline; nothing polls the table
+    if (wait == portMAX_DELAY) {
+        xTimerStop(request_timer, 0);
     } else {
-        ESP_LOGE(TAG, "Failed to print JSON to string");
-        result = "{}";
+        xTimerChangePeriod(request_timer, wait > 0 ? wait : 1, 0);
     }
+}
 
-    cJSON_Delete(json);
-    return result;
+void ChromecastController::request_timer_callback(TimerHandle_t timer) {
+    ChromecastController* controller = static_cast<ChromecastController*>(pvTimerGetTimerID(timer));
+    if (!controller || !controller->request_mutex) {
+        return;
+    }
+
+    CastRequestTable::Completion expired[CastRequestTable::CAPACITY];
+    xSemaphoreTake(controller->request_mutex, portMAX_DELAY);
+    size_t count = controller->request_table.expire(xTaskGetTickCount(), expired, CastRequestTable::CAPACITY);
+    xSemaphoreGive(controller->request_mutex);
+
+    for (size_t i = 0; i < count; i++) {
+        ESP_LOGW(TAG, "Cast request timed out after %u ms", expired[i].rtt_ms);
+        if (expired[i].callback) {
+            expired[i].callback(CastRequestTable::RESULT_TIMEOUT, nullptr, expired[i].rtt_ms);
+        }
+    }
+
+    controller->arm_request_timer();
+}
+
+size_t ChromecastController::get_latency_stats(LatencyStats* out, size_t max_out) {
+    if (!out || !request_mutex) {
+        return 0;
+    }
+
+    xSemaphoreTake(request_mutex, portMAX_DELAY);
+    size_t count = request_table.get_stats(out, max_out);
+    xSemaphoreGive(request_mutex);
+    return count;
 }
 
-bool ChromecastController::connect_to_chromecast(const std::string& ip) {
+bool ChromecastController::connect_to_chromecast(const std::string& ip, int port) {
     ESP_LOGI(TAG, "Connecting to Chromecast...");
     log_memory_status("Before connection");
 
@@ -224,380 +692,1480 @@ bool ChromecastController::connect_to_chromecast(const std::string& ip) {
     }
 
     chromecast_ip = ip;
-    chromecast_port = CHROMECAST_PORT; // Use default port
+    chromecast_port = port;
+    device_auth_rejected = false;
     ESP_LOGI(TAG, "Using provided IP: %s:%d", chromecast_ip.c_str(), chromecast_port);
     
     // Establish TLS connection
     if (!establish_tls_connection()) {
+        report_connect_stage(connect_cancelled ? CONNECT_STAGE_CANCELLED : CONNECT_STAGE_FAILED);
         return false;
     }
 
     // Send virtual connect
+    report_connect_stage(CONNECT_STAGE_VIRTUAL_CONNECT);
     if (!send_virtual_connect()) {
+        esp_tls_conn_destroy(tls_handle);
+        tls_handle = nullptr;
+        current_state = ERROR_STATE;
+        if (state_callback) state_callback(current_state);
+        report_connect_stage(CONNECT_STAGE_FAILED);
         return false;
     }
 
-    // Start receive task with larger stack size
-    xTaskCreate(receive_task, "chromecast_receive", 8192, this, 5, &receive_task_handle);
+    rx_length = 0;
+    last_rx_tick = xTaskGetTickCount();
+    last_pong_tick = last_rx_tick;
+    volume_sent.level = -1.0f; // Force the next requested volume out
+    volume_reported.level = -1.0f;
+    if (!external_io) {
+        // Internal stack: device auth responses are written to NVS from here
+        mem_task_create(receive_task, "chromecast_receive", RECEIVE_TASK_STACK_SIZE, this, RECEIVE_TASK_PRIORITY,
+                        &receive_task_handle, TASK_PLAN_NETWORK_CORE, MEM_TASK_STACK_INTERNAL);
+
+        // Start heartbeat
+        start_heartbeat();
+    }
 
-    // Start heartbeat
-    start_heartbeat();
+    // Receiver, app and media traffic waits for the device to prove itself
+    start_device_auth();
+    if (!wait_device_auth()) {
+        // Out of CONNECTED first, so the receive task ends without scheduling a reconnect
+        current_state = ERROR_STATE;
+        close_transport();
+        if (state_callback) state_callback(current_state);
+        report_connect_stage(connect_cancelled ? CONNECT_STAGE_CANCELLED : CONNECT_STAGE_FAILED);
+        return false;
+    }
 
     // Get initial status
     get_status();
+    resume_cached_session();
+    if (is_group()) {
+        // Membership and per-member volume; the receiver volume is the group's
+        send_control_message(NAMESPACE_MULTIZONE, "GET_STATUS");
+    }
 
     log_memory_status("After connection");
     ESP_LOGI(TAG, "Successfully connected to Chromecast at %s:%d", chromecast_ip.c_str(), chromecast_port);
+    report_connect_stage(CONNECT_STAGE_COMPLETE);
+    return true;
+}
+
+bool ChromecastController::connect_to_chromecast_async(const std::string& ip, int port, UBaseType_t priority) {
+    if (connect_task_handle) {
+        ESP_LOGW(TAG, "Connection attempt already in progress");
+        return false;
+    }
+    if (ip.empty()) {
+        return false;
+    }
+
+    pending_connect_ip = ip;
+    pending_connect_port = port;
+    connect_cancelled = false;
+
+    if (!mem_task_create(connect_task, "chromecast_connect", CONNECT_TASK_STACK_SIZE, this, priority,
+                         &connect_task_handle, TASK_PLAN_NETWORK_CORE, MEM_TASK_STACK_INTERNAL)) {
+        ESP_LOGE(TAG, "Failed to create connect task");
+        connect_task_handle = nullptr;
+        return false;
+    }
     return true;
 }
 
+void ChromecastController::cancel_connect() {
+    if (connect_task_handle) {
+        ESP_LOGI(TAG, "Cancelling connection attempt to %s", pending_connect_ip.c_str());
+        connect_cancelled = true;
+    }
+}
+
+void ChromecastController::connect_task(void* parameter) {
+    ChromecastController* controller = static_cast<ChromecastController*>(parameter);
+
+    // Progress and the final result are reported through connect_progress_callback
+    controller->connect_to_chromecast(controller->pending_connect_ip, controller->pending_connect_port);
+
+    controller->connect_task_handle = nullptr;
+    mem_task_delete(nullptr);
+}
+
 void ChromecastController::disconnect() {
     ESP_LOGI(TAG, "Disconnecting from Chromecast");
 
+    // A user disconnect ends any background reconnect attempts
+    stop_reconnect();
     stop_heartbeat();
 
+    // Close the app session connection before the platform one
+    if ((app_connection_established || app_connection_speculative) && tls_handle) {
+        send_control_message(NAMESPACE_CONNECTION, "CLOSE", app_transport_id.c_str());
+    }
+    reset_app_session();
+    pending_load.active = false;
+
     // Send CLOSE message if connected
     if (virtual_connection_established) {
-        std::string close_msg = create_json_message("CLOSE");
-        send_protobuf_message(NAMESPACE_CONNECTION, close_msg);
+        send_control_message(NAMESPACE_CONNECTION, "CLOSE");
         virtual_connection_established = false;
     }
 
-    // Clean up receive task
-    if (receive_task_handle) {
-        vTaskDelete(receive_task_handle);
-        receive_task_handle = nullptr;
-    }
-
-    // Close TLS connection
+    // The CLOSEs must be on the wire before the socket is shut down
     if (tls_handle) {
-        esp_tls_conn_destroy(tls_handle);
-        tls_handle = nullptr;
+        flush_tx();
     }
+    close_transport();
 
     current_state = DISCONNECTED;
     if (state_callback) state_callback(current_state);
     ESP_LOGI(TAG, "Disconnected from Chromecast");
 }
 
+void ChromecastController::close_transport() {
+    stop_heartbeat();
+
+    // Unblock a pending esp_tls_conn_read so the receive task can exit cleanly
+    int sockfd = get_socket_fd();
+    if (sockfd >= 0) {
+        shutdown(sockfd, SHUT_RDWR);
+    }
+
+    if (receive_task_handle && receive_task_handle != xTaskGetCurrentTaskHandle()) {
+        TickType_t start = xTaskGetTickCount();
+        while (receive_task_handle && xTaskGetTickCount() - start < pdMS_TO_TICKS(RECEIVE_TASK_EXIT_TIMEOUT_MS)) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+        if (receive_task_handle) {
+            ESP_LOGW(TAG, "Receive task did not exit, deleting it");
+            mem_task_delete(receive_task_handle);
+            receive_task_handle = nullptr;
+        }
+    }
+    release_rx_buffer();
+
+    // Frames queued for the old transport are dropped with it
+    if (send_mutex) {
+        xSemaphoreTake(send_mutex, portMAX_DELAY);
+        tx_length = 0;
+        xSemaphoreGive(send_mutex);
+    }
+
+    // Nothing in flight can be answered on a new transport
+    cancel_pending_requests();
+
+    // Membership is re-read with MULTIZONE GET_STATUS on the next connect
+    taskENTER_CRITICAL(&group_lock);
+    group_member_count = 0;
+    taskEXIT_CRITICAL(&group_lock);
+
+    // Close TLS connection; the captured peer certificate goes with it
+    device_auth.reset();
+    if (tls_handle) {
+        esp_tls_conn_destroy(tls_handle);
+        tls_handle = nullptr;
+    }
+    virtual_connection_established = false;
+}
+
 bool ChromecastController::set_volume(float level, bool muted) {
+    return set_volume(level, muted, nullptr);
+}
+
+bool ChromecastController::set_volume(float level, bool muted, ResponseCallback callback, uint32_t timeout_ms) {
     if (!is_connected()) {
         ESP_LOGE(TAG, "Not connected to Chromecast");
         return false;
     }
 
-    // Check available memory before creating JSON
-    size_t free_heap = esp_get_free_heap_size();
-    if (free_heap < 8192) { // Require at least 8KB free heap
-        ESP_LOGW(TAG, "Insufficient memory for volume command: %d bytes available", free_heap);
-        return false;
-    }
-
     // Clamp volume level between 0.0 and 1.0
     level = std::max(0.0f, std::min(1.0f, level));
 
     ESP_LOGI(TAG, "Setting volume to %.2f, muted: %s", level, muted ? "true" : "false");
 
-    // Create volume object
-    cJSON* volume = cJSON_CreateObject();
-    if (!volume) {
-        ESP_LOGE(TAG, "Failed to create volume JSON object");
-        return false;
-    }
+    uint32_t request_id = begin_request("SET_VOLUME", std::move(callback), timeout_ms);
 
-    if (!cJSON_AddNumberToObject(volume, "level", level)) {
-        ESP_LOGE(TAG, "Failed to add level to volume JSON");
-        cJSON_Delete(volume);
-        return false;
-    }
+    CastJsonWriter<CONTROL_MESSAGE_SIZE> json;
+    json.field("type", "SET_VOLUME")
+        .field_uint("requestId", request_id)
+        .begin_object("volume")
+            .field_number("level", level)
+            .field_bool("muted", muted)
+        .end_object()
+        .end();
 
-    if (!cJSON_AddBoolToObject(volume, "muted", muted)) {
-        ESP_LOGE(TAG, "Failed to add muted to volume JSON");
-        cJSON_Delete(volume);
+    if (!json.ok()) {
+        ESP_LOGE(TAG, "SET_VOLUME message does not fit in %d bytes", CONTROL_MESSAGE_SIZE);
+        discard_request(request_id);
         return false;
     }
 
-    // Create SET_VOLUME message
-    cJSON* message_data = cJSON_CreateObject();
-    if (!message_data) {
-        ESP_LOGE(TAG, "Failed to create message data JSON object");
-        cJSON_Delete(volume);
-        return false;
-    }
+    return send_request(NAMESPACE_RECEIVER, json.c_str(), nullptr, request_id);
+}
 
-    if (!cJSON_AddItemToObject(message_data, "volume", volume)) {
-        ESP_LOGE(TAG, "Failed to add volume to message data");
-        cJSON_Delete(volume);
-        cJSON_Delete(message_data);
+bool ChromecastController::set_muted(bool muted, ResponseCallback callback, uint32_t timeout_ms) {
+    if (!is_connected()) {
+        ESP_LOGE(TAG, "Not connected to Chromecast");
         return false;
     }
 
-    std::string set_volume_msg = create_json_message("SET_VOLUME", 0, message_data);
+    ESP_LOGI(TAG, "Setting muted: %s", muted ? "true" : "false");
+
+    uint32_t request_id = begin_request("SET_VOLUME", std::move(callback), timeout_ms);
 
-    cJSON_Delete(message_data);
+    CastJsonWriter<CONTROL_MESSAGE_SIZE> json;
+    json.field("type", "SET_VOLUME")
+        .field_uint("requestId", request_id)
+        .begin_object("volume")
+            .field_bool("muted", muted)
+        .end_object()
+        .end();
 
-    return send_protobuf_message(NAMESPACE_RECEIVER, set_volume_msg);
+    if (!json.ok()) {
+        ESP_LOGE(TAG, "SET_VOLUME message does not fit in %d bytes", CONTROL_MESSAGE_SIZE);
+        discard_request(request_id);
+        return false;
+    }
+
+    return send_request(NAMESPACE_RECEIVER, json.c_str(), nullptr, request_id);
 }
 
-bool ChromecastController::get_status() {
+bool ChromecastController::request_volume(float level, bool muted) {
     if (!is_connected()) {
-        ESP_LOGE(TAG, "Not connected to Chromecast");
         return false;
     }
 
-    ESP_LOGD(TAG, "Requesting status");
-    std::string get_status_msg = create_json_message("GET_STATUS");
-    return send_protobuf_message(NAMESPACE_RECEIVER, get_status_msg);
-}
+    level = std::max(0.0f, std::min(1.0f, level));
 
-void ChromecastController::start_heartbeat() {
-    if (heartbeat_timer) {
-        ESP_LOGI(TAG, "Starting heartbeat");
-        xTimerStart(heartbeat_timer, 0);
+    taskENTER_CRITICAL(&volume_lock);
+    volume_target.level = level;
+    volume_target.muted = muted;
+    volume_target_pending = true;
+    volume_last_request_tick = xTaskGetTickCount();
+    taskEXIT_CRITICAL(&volume_lock);
+
+    if (!volume_task_handle) {
+        // The new task finds the target pending on its first wake-up
+        if (!start_volume_task()) {
+            return false;
+        }
     }
+    xTaskNotifyGive(volume_task_handle);
+    return true;
 }
 
-void ChromecastController::stop_heartbeat() {
-    if (heartbeat_timer) {
-        ESP_LOGI(TAG, "Stopping heartbeat");
-        xTimerStop(heartbeat_timer, 0);
+bool ChromecastController::start_volume_task() {
+    if (volume_task_handle) {
+        return true;
+    }
+    volume_task_stop = false;
+    // Only sends on the socket, so its stack can live in PSRAM
+    if (!mem_task_create(volume_task, "chromecast_volume", VOLUME_TASK_STACK_SIZE, this, VOLUME_TASK_PRIORITY,
+                         &volume_task_handle, TASK_PLAN_NETWORK_CORE, MEM_TASK_STACK_PSRAM)) {
+        ESP_LOGE(TAG, "Failed to create volume task");
+        volume_task_handle = nullptr;
+        return false;
     }
+    return true;
 }
 
-void ChromecastController::heartbeat_timer_callback(TimerHandle_t timer) {
-    ChromecastController* controller = static_cast<ChromecastController*>(pvTimerGetTimerID(timer));
+bool ChromecastController::get_volume(VolumeInfo& out) {
+    taskENTER_CRITICAL(&volume_lock);
+    out = volume_reported;
+    taskEXIT_CRITICAL(&volume_lock);
+    return out.level >= 0.0f;
+}
 
-    if (controller && controller->is_connection_healthy()) {
-        // Check memory before sending heartbeat
-        size_t free_heap = esp_get_free_heap_size();
-        if (free_heap < 16384) { // Less than 16KB
-            ESP_LOGW(TAG, "Skipping heartbeat due to low memory: %d bytes", free_heap);
-            return;
-        }
+void ChromecastController::prewarm() {
+    if (!is_connected()) {
+        return;
+    }
+    start_volume_task();
+
+    if (xTaskGetTickCount() - last_rx_tick >= pdMS_TO_TICKS(HEARTBEAT_INTERVAL_MS)) {
+        ESP_LOGD(TAG, "Link quiet, pinging ahead of a command");
+        send_heartbeat();
+    }
+}
+
+void ChromecastController::set_volume_rate_limit(uint32_t max_hz) {
+    volume_min_interval_ms = max_hz > 0 ? 1000 / max_hz : 0;
+}
+
+void ChromecastController::stop_volume_task() {
+    if (!volume_task_handle) {
+        return;
+    }
+
+    volume_task_stop = true;
+    xTaskNotifyGive(volume_task_handle);
+    while (volume_task_handle) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+void ChromecastController::volume_task(void* parameter) {
+    ChromecastController* controller = static_cast<ChromecastController*>(parameter);
+
+    while (!controller->volume_task_stop) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Keep sending until the speaker has the latest target
+        while (!controller->volume_task_stop && controller->is_connected()) {
+            VolumeInfo target;
+            taskENTER_CRITICAL(&controller->volume_lock);
+            bool pending = controller->volume_target_pending;
+            target = controller->volume_target;
+            controller->volume_target_pending = false;
+            taskEXIT_CRITICAL(&controller->volume_lock);
+
+            if (!pending) {
+                break;
+            }
+            if (target.level == controller->volume_sent.level && target.muted == controller->volume_sent.muted) {
+                continue;
+            }
+
+            TickType_t sent_at = xTaskGetTickCount();
+            controller->volume_in_flight = true;
+            if (controller->set_volume(target.level, target.muted)) {
+                controller->volume_sent = target;
+            } else {
+                controller->volume_in_flight = false;
+                break;
+            }
+
+            // One command per round trip: wait for the RECEIVER_STATUS echo
+            // (which clears volume_in_flight) or the ack timeout
+            while (controller->volume_in_flight && !controller->volume_task_stop &&
+                   xTaskGetTickCount() - sent_at < pdMS_TO_TICKS(VOLUME_ACK_TIMEOUT_MS)) {
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(VOLUME_ACK_TIMEOUT_MS));
+                // Newer targets arriving during the wait are picked up next loop
+                taskENTER_CRITICAL(&controller->volume_lock);
+                bool newer = controller->volume_target_pending;
+                taskEXIT_CRITICAL(&controller->volume_lock);
+                if (newer && !controller->volume_in_flight) {
+                    break;
+                }
+            }
+            controller->volume_in_flight = false;
+
+            // Honour the configured maximum rate
+            TickType_t elapsed = xTaskGetTickCount() - sent_at;
+            TickType_t min_interval = pdMS_TO_TICKS(controller->volume_min_interval_ms);
+            if (elapsed < min_interval) {
+                vTaskDelay(min_interval - elapsed);
+            }
+        }
+    }
+
+    controller->volume_task_handle = nullptr;
+    mem_task_delete(nullptr);
+}
+
+bool ChromecastController::reconcile_volume_echo(const VolumeInfo& reported) {
+    taskENTER_CRITICAL(&volume_lock);
+    bool pending = volume_target_pending;
+    VolumeInfo target = volume_target;
+    TickType_t since_request = xTaskGetTickCount() - volume_last_request_tick;
+    taskEXIT_CRITICAL(&volume_lock);
+
+    if (volume_in_flight && volume_task_handle) {
+        volume_in_flight = false;
+        xTaskNotifyGive(volume_task_handle);
+    }
+
+    // While the user is still dragging, stale echoes would yank the slider back
+    bool settling = volume_last_request_tick != 0 && since_request < pdMS_TO_TICKS(VOLUME_SETTLE_MS);
+    bool matches_target = fabsf(reported.level - target.level) < 0.005f && reported.muted == target.muted;
+    if ((pending || settling) && !matches_target) {
+        ESP_LOGD(TAG, "Suppressing stale volume echo %.2f (target %.2f)", reported.level, target.level);
+        return false;
+    }
+    return true;
+}
+
+bool ChromecastController::get_status() {
+    if (!is_connected()) {
+        ESP_LOGE(TAG, "Not connected to Chromecast");
+        return false;
+    }
+
+    ESP_LOGD(TAG, "Requesting status");
+    return send_control_message(NAMESPACE_RECEIVER, "GET_STATUS");
+}
+
+bool ChromecastController::get_status(ResponseCallback callback, uint32_t timeout_ms) {
+    if (!is_connected()) {
+        ESP_LOGE(TAG, "Not connected to Chromecast");
+        return false;
+    }
+
+    ESP_LOGD(TAG, "Requesting status (tracked, %u ms)", timeout_ms);
+    return send_control_message(NAMESPACE_RECEIVER, "GET_STATUS", nullptr, std::move(callback), timeout_ms);
+}
+
+bool ChromecastController::get_app_availability(const char* const* app_ids, size_t count, ResponseCallback callback,
+                                                uint32_t timeout_ms) {
+    if (!is_connected()) {
+        ESP_LOGE(TAG, "Not connected to Chromecast");
+        return false;
+    }
+    if (count == 0 || count > CastPayload::MAX_APPLICATIONS) {
+        return false;
+    }
+
+    uint32_t request_id = begin_request("GET_APP_AVAILABILITY", std::move(callback), timeout_ms);
+
+    CastJsonWriter<CONTROL_MESSAGE_SIZE> json;
+    json.field("type", "GET_APP_AVAILABILITY")
+        .field_uint("requestId", request_id)
+        .begin_array("appId");
+    for (size_t i = 0; i < count; i++) {
+        json.field(nullptr, app_ids[i]);
+    }
+    json.end();
+
+    if (!json.ok()) {
+        ESP_LOGE(TAG, "GET_APP_AVAILABILITY message does not fit in %d bytes", CONTROL_MESSAGE_SIZE);
+        discard_request(request_id);
+        return false;
+    }
+
+    return send_request(NAMESPACE_RECEIVER, json.c_str(), nullptr, request_id);
+}
+
+bool ChromecastController::launch_app(const std::string& app) {
+    if (!is_connected()) {
+        ESP_LOGE(TAG, "Not connected to Chromecast");
+        return false;
+    }
+
+    if (get_cached_app_availability(app.c_str()) == CastAppCache::AVAILABILITY_UNAVAILABLE) {
+        ESP_LOGW(TAG, "Receiver app %s is not available on this device", app.c_str());
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Launching receiver app %s", app.c_str());
+
+    uint32_t request_id = begin_request("LAUNCH");
+
+    CastJsonWriter<CONTROL_MESSAGE_SIZE> json;
+    json.field("type", "LAUNCH")
+        .field_uint("requestId", request_id)
+        .field("appId", app.c_str())
+        .end();
+
+    if (!json.ok()) {
+        ESP_LOGE(TAG, "LAUNCH message does not fit in %d bytes", CONTROL_MESSAGE_SIZE);
+        discard_request(request_id);
+        return false;
+    }
+
+    // Whichever comes first, the send returning or the RECEIVER_STATUS
+    // answering it, makes app the one to track
+    lock_app_state();
+    launch_app_id = app;
+    launch_request_id = request_id;
+    unlock_app_state();
+
+    bool sent = send_request(NAMESPACE_RECEIVER, json.c_str(), nullptr, request_id);
+    lock_app_state();
+    if (launch_request_id == request_id) {
+        if (sent) {
+            app_id = launch_app_id;
+        }
+        launch_request_id = 0;
+        launch_app_id.clear();
+    }
+    unlock_app_state();
+    return sent;
+}
+
+bool ChromecastController::send_app_message(const char* ns, const char* payload) {
+    if (!ns || !payload || !app_connection_established) {
+        ESP_LOGE(TAG, "No app session to send %s on", ns ? ns : "(null)");
+        return false;
+    }
+    return send_protobuf_message(ns, payload, app_transport_id.c_str());
+}
+
+bool ChromecastController::load_media(const std::string& url, const std::string& content_type,
+                                      const std::string& title, bool autoplay, double start_time) {
+    if (!is_connected()) {
+        ESP_LOGE(TAG, "Not connected to Chromecast");
+        return false;
+    }
+
+    if (url.empty()) {
+        ESP_LOGE(TAG, "Media URL is empty");
+        return false;
+    }
+
+    PendingLoad load;
+    load.active = true;
+    load.url = url;
+    load.content_type = content_type.empty() ? "audio/mpeg" : content_type;
+    load.title = title;
+    load.autoplay = autoplay;
+    load.start_time = start_time;
+
+    if (app_connection_established) {
+        return send_load_message(load);
+    }
+
+    // Launch the media receiver first; LOAD goes out once it reports a transportId
+    ESP_LOGI(TAG, "No media session yet, deferring LOAD until %s is running", DEFAULT_MEDIA_RECEIVER_APP_ID);
+    pending_load = load;
+    return launch_app(DEFAULT_MEDIA_RECEIVER_APP_ID);
+}
+
+bool ChromecastController::load_file(const std::string& path, const std::string& title,
+                                     bool autoplay, double start_time) {
+    char url[MEDIA_SERVER_URL_MAX];
+    if (!media_server_url(path.c_str(), url, sizeof(url))) {
+        ESP_LOGE(TAG, "No media server URL for %s", path.c_str());
+        return false;
+    }
+    return load_media(url, media_server_mime_type(path.c_str()), title, autoplay, start_time);
+}
+
+bool ChromecastController::send_load_message(const PendingLoad& load) {
+    uint32_t request_id = begin_request("LOAD");
+
+    CastJsonWriter<MEDIA_LOAD_MESSAGE_SIZE> json;
+    json.field("type", "LOAD")
+        .field_uint("requestId", request_id)
+        .begin_object("media")
+            .field("contentId", load.url.c_str())
+            .field("contentType", load.content_type.c_str())
+            .field("streamType", "BUFFERED");
+    if (!load.title.empty()) {
+        json.begin_object("metadata")
+                .field_uint("metadataType", 0)
+                .field("title", load.title.c_str())
+            .end_object();
+    }
+    json.end_object()
+        .field_bool("autoplay", load.autoplay)
+        .field_number("currentTime", load.start_time)
+        .end();
+
+    if (!json.ok()) {
+        ESP_LOGE(TAG, "LOAD message does not fit in %d bytes", MEDIA_LOAD_MESSAGE_SIZE);
+        discard_request(request_id);
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Loading media %s (%s)", load.url.c_str(), load.content_type.c_str());
+    return send_request(NAMESPACE_MEDIA, json.c_str(), app_transport_id.c_str(), request_id);
+}
+
+bool ChromecastController::send_media_command(const char* type, double seek_time, ResponseCallback callback,
+                                             uint32_t timeout_ms) {
+    if (!is_connected() || !app_connection_established) {
+        ESP_LOGE(TAG, "No active media session for %s", type);
+        return false;
+    }
+
+    lock_app_state();
+    uint32_t media_session_id = media_status.media_session_id;
+    unlock_app_state();
+    if (media_session_id == 0) {
+        ESP_LOGW(TAG, "No media loaded, ignoring %s", type);
+        return false;
+    }
+
+    uint32_t request_id = begin_request(type, std::move(callback), timeout_ms);
+
+    CastJsonWriter<CONTROL_MESSAGE_SIZE> json;
+    json.field("type", type)
+        .field_uint("requestId", request_id)
+        .field_uint("mediaSessionId", media_session_id);
+    if (seek_time >= 0.0) {
+        json.field_number("currentTime", seek_time);
+    }
+    json.end();
+
+    if (!json.ok()) {
+        ESP_LOGE(TAG, "%s message does not fit in %d bytes", type, CONTROL_MESSAGE_SIZE);
+        discard_request(request_id);
+        return false;
+    }
+
+    return send_request(NAMESPACE_MEDIA, json.c_str(), app_transport_id.c_str(), request_id);
+}
+
+bool ChromecastController::play() {
+    return send_media_command("PLAY");
+}
+
+bool ChromecastController::pause() {
+    return send_media_command("PAUSE");
+}
+
+bool ChromecastController::stop_media() {
+    return send_media_command("STOP");
+}
+
+bool ChromecastController::play(ResponseCallback callback, uint32_t timeout_ms) {
+    return send_media_command("PLAY", -1.0, std::move(callback), timeout_ms);
+}
+
+bool ChromecastController::pause(ResponseCallback callback, uint32_t timeout_ms) {
+    return send_media_command("PAUSE", -1.0, std::move(callback), timeout_ms);
+}
+
+bool ChromecastController::stop_media(ResponseCallback callback, uint32_t timeout_ms) {
+    return send_media_command("STOP", -1.0, std::move(callback), timeout_ms);
+}
+
+bool ChromecastController::seek(double position_seconds) {
+    if (position_seconds < 0.0) {
+        position_seconds = 0.0;
+    }
+    return send_media_command("SEEK", position_seconds);
+}
+
+bool ChromecastController::get_media_status() {
+    if (!is_connected() || !app_connection_established) {
+        ESP_LOGE(TAG, "No active media session");
+        return false;
+    }
+    return send_control_message(NAMESPACE_MEDIA, "GET_STATUS", app_transport_id.c_str());
+}
+
+ChromecastController::MediaStatus ChromecastController::get_cached_media_status() const {
+    lock_app_state();
+    MediaStatus status = media_status;
+    unlock_app_state();
+    return status;
+}
+
+double ChromecastController::get_estimated_position() const {
+    // Extrapolate locally so the UI does not need to poll while playing
+    lock_app_state();
+    double position = media_status.current_time;
+    if (media_status.player_state == "PLAYING") {
+        TickType_t elapsed = xTaskGetTickCount() - media_status.updated_at;
+        position += (double)pdTICKS_TO_MS(elapsed) / 1000.0;
+    }
+    if (media_status.duration > 0.0 && position > media_status.duration) {
+        position = media_status.duration;
+    }
+    unlock_app_state();
+    return position;
+}
+
+std::string ChromecastController::wanted_app_id() const {
+    lock_app_state();
+    std::string wanted = app_id.empty() ? DEFAULT_MEDIA_RECEIVER_APP_ID : app_id;
+    unlock_app_state();
+    return wanted;
+}
+
+void ChromecastController::notify_media_status() {
+    if (!media_status_callback) {
+        return;
+    }
+    media_status_callback(get_cached_media_status());
+}
+
+void ChromecastController::connect_to_app(const CastPayload::Application& app) {
+    ESP_LOGI(TAG, "Connecting to app %s session %s (transport %s)",
+             app.app_id, app.session_id, app.transport_id);
+
+    app_session_id = app.session_id;
+    app_transport_id = app.transport_id;
+
+    // Each app session needs its own virtual connection
+    if (!send_control_message(NAMESPACE_CONNECTION, "CONNECT", app_transport_id.c_str())) {
+        ESP_LOGE(TAG, "Failed to open virtual connection to %s", app_transport_id.c_str());
+        app_transport_id.clear();
+        app_session_id.clear();
+        return;
+    }
+    app_connection_established = true;
+    CastAppCache::store_session(device_key().c_str(), app);
+
+    if (pending_load.active) {
+        pending_load.active = false;
+        send_load_message(pending_load);
+    } else {
+        send_control_message(NAMESPACE_MEDIA, "GET_STATUS", app_transport_id.c_str());
+    }
+}
+
+void ChromecastController::resume_cached_session() {
+    CastAppCache::Session session;
+    if (!CastAppCache::find_session(device_key().c_str(), session) || wanted_app_id() != session.app_id) {
+        return;
+    }
+
+    // Queued behind the receiver GET_STATUS, so when the app is still running
+    // its MEDIA_STATUS comes back in the same round trip; the RECEIVER_STATUS
+    // then only has to confirm the transport
+    ESP_LOGI(TAG, "Resuming cached app session %s (transport %s)", session.session_id, session.transport_id);
+    app_session_id = session.session_id;
+    app_transport_id = session.transport_id;
+    if (!send_control_message(NAMESPACE_CONNECTION, "CONNECT", app_transport_id.c_str())) {
+        app_transport_id.clear();
+        app_session_id.clear();
+        return;
+    }
+    app_connection_speculative = true;
+    send_control_message(NAMESPACE_MEDIA, "GET_STATUS", app_transport_id.c_str());
+}
+
+void ChromecastController::drop_speculative_session() {
+    if (!app_connection_speculative) {
+        return;
+    }
+    ESP_LOGI(TAG, "Cached app session %s is gone", app_session_id.c_str());
+    send_control_message(NAMESPACE_CONNECTION, "CLOSE", app_transport_id.c_str());
+    CastAppCache::forget_session(device_key().c_str());
+    app_connection_speculative = false;
+    app_session_id.clear();
+    app_transport_id.clear();
+}
+
+void ChromecastController::reset_app_session() {
+    app_session_id.clear();
+    app_transport_id.clear();
+    app_connection_established = false;
+    app_connection_speculative = false;
+    lock_app_state();
+    media_status.player_state = "IDLE";
+    media_status.idle_reason.clear();
+    media_status.media_session_id = 0;
+    media_status.current_time = 0.0;
+    media_status.duration = 0.0;
+    media_status.updated_at = xTaskGetTickCount();
+    unlock_app_state();
+}
+
+void ChromecastController::start_device_auth() {
+    const std::string& key = device_key();
+    if (!device_auth.begin(tls_handle, key)) {
+        return;
+    }
+
+    // A known device presenting the same TLS certificate needs no RSA verify
+    if (device_auth.check_cache()) {
+        return;
+    }
+
+    uint8_t challenge[CastDeviceAuth::CHALLENGE_MAX_SIZE];
+    size_t length = device_auth.build_challenge(challenge, sizeof(challenge));
+    if (length == 0 || !send_binary_message(NAMESPACE_DEVICE_AUTH, challenge, length)) {
+        ESP_LOGW(TAG, "Failed to send device auth challenge");
+        device_auth.reset();
+    }
+}
+
+bool ChromecastController::wait_device_auth() {
+    if (!device_auth_required) {
+        return true;
+    }
+
+    TickType_t start = xTaskGetTickCount();
+    while (device_auth.get_status() == CastDeviceAuth::AUTH_PENDING && !connect_cancelled) {
+        if (xTaskGetTickCount() - start >= pdMS_TO_TICKS(DEVICE_AUTH_TIMEOUT_MS)) {
+            ESP_LOGE(TAG, "No device auth response from %s in %u ms, closing connection",
+                     chromecast_ip.c_str(), (unsigned)DEVICE_AUTH_TIMEOUT_MS);
+            device_auth_rejected = true;
+            return false;
+        }
+        if (receive_task_handle) {
+            vTaskDelay(pdMS_TO_TICKS(TLS_CONNECT_POLL_MS));
+            continue;
+        }
+
+        // Pooled: the pool serves this connection only once it is added, so read here
+        if (!flush_tx()) {
+            return false;
+        }
+        if (wait_readable(TLS_CONNECT_POLL_MS)) {
+            int processed = 0;
+            ReceiveResult result = receive_available(processed);
+            if (result != RECEIVE_OK && result != RECEIVE_AGAIN) {
+                return false;
+            }
+        }
+    }
+
+    if (is_device_authenticated()) {
+        return true;
+    }
+    // No challenge could be sent (no peer certificate) or the answer failed
+    if (!connect_cancelled) {
+        ESP_LOGE(TAG, "Device %s not authenticated (%s)", chromecast_ip.c_str(),
+                 CastDeviceAuth::status_name(device_auth.get_status()));
+        device_auth_rejected = true;
+    }
+    return false;
+}
+
+bool ChromecastController::device_auth_allows(const Extensions__Api__CastChannel__CastMessage& message) const {
+    if (!device_auth_required || is_device_authenticated()) {
+        return true;
+    }
+    // The platform connection, its heartbeat and the challenge itself
+    const char* ns = message.namespace_;
+    if (strcmp(ns, NAMESPACE_HEARTBEAT) == 0 || strcmp(ns, NAMESPACE_DEVICE_AUTH) == 0) {
+        return true;
+    }
+    return strcmp(ns, NAMESPACE_CONNECTION) == 0 && destination_id == message.destination_id;
+}
+
+void ChromecastController::handle_device_auth(const CastMessageView& message) {
+    if (!message.has_payload_binary) {
+        ESP_LOGW(TAG, "Device auth message without binary payload");
+        return;
+    }
+
+    if (device_auth.verify_response(reinterpret_cast<const uint8_t*>(message.payload_binary.data),
+                                    message.payload_binary.length)) {
+        return;
+    }
+
+    if (!device_auth_required) {
+        ESP_LOGW(TAG, "Device authentication failed, continuing (not required)");
+        return;
+    }
+
+    // Close the socket; the receive task then fails the connection without reconnecting
+    ESP_LOGE(TAG, "Device authentication failed, closing connection to %s", chromecast_ip.c_str());
+    device_auth_rejected = true;
+    int sockfd = get_socket_fd();
+    if (sockfd >= 0) {
+        shutdown(sockfd, SHUT_RDWR);
+    }
+}
+
+void ChromecastController::start_heartbeat() {
+    if (heartbeat_timer) {
+        ESP_LOGI(TAG, "Starting heartbeat");
+        xTimerStart(heartbeat_timer, 0);
+    }
+}
+
+void ChromecastController::stop_heartbeat() {
+    if (heartbeat_timer) {
+        ESP_LOGI(TAG, "Stopping heartbeat");
+        xTimerStop(heartbeat_timer, 0);
+    }
+}
+
+void ChromecastController::heartbeat_timer_callback(TimerHandle_t timer) {
+    ChromecastController* controller = static_cast<ChromecastController*>(pvTimerGetTimerID(timer));
+    if (controller) {
+        controller->send_heartbeat();
+    }
+}
+
+void ChromecastController::send_heartbeat() {
+    check_liveness();
+
+    if (is_connection_healthy()) {
+        // Never held back for memory (MEM_BUDGET_CRITICAL): a missed PING
+        // costs the session, and rebuilding it costs far more than the PING
 
         ESP_LOGD(TAG, "Sending heartbeat PING");
-        std::string ping_msg = controller->create_json_message("PING");
-        bool success = controller->send_protobuf_message(NAMESPACE_HEARTBEAT, ping_msg);
+        bool success = send_control_message(NAMESPACE_HEARTBEAT, "PING");
 
         if (!success) {
             ESP_LOGW(TAG, "Failed to send heartbeat PING - connection may be lost");
-            // Note: Connection state will be updated by the receive task if it fails
+            // Note: Connection state will be updated by the receive path if it fails
         }
-    } else if (controller) {
+    } else {
         ESP_LOGD(TAG, "Skipping heartbeat - connection not healthy (state: %d, tls_handle: %p, virtual_connection: %s)",
-                 controller->current_state, controller->tls_handle,
-                 controller->virtual_connection_established ? "true" : "false");
+                 current_state, tls_handle, virtual_connection_established ? "true" : "false");
     }
 }
 
-void ChromecastController::receive_task(void* parameter) {
-    ChromecastController* controller = static_cast<ChromecastController*>(parameter);
+bool ChromecastController::ensure_rx_capacity(size_t required) {
+    if (required <= rx_capacity) {
+        return true;
+    }
 
-    // Allocate buffer on heap instead of stack to prevent stack overflow
-    uint8_t* buffer = (uint8_t*)malloc(2048);
-    if (!buffer) {
+    // Grow geometrically so a burst of large status frames settles quickly
+    size_t new_capacity = rx_capacity ? rx_capacity : RX_BUFFER_INITIAL_SIZE;
+    while (new_capacity < required) {
+        new_capacity *= 2;
+    }
+    if (new_capacity > MAX_MESSAGE_SIZE + 4) {
+        new_capacity = MAX_MESSAGE_SIZE + 4;
+    }
+    if (new_capacity < required) {
+        return false;
+    }
+
+    uint8_t* new_buffer = (uint8_t*)realloc(rx_buffer, new_capacity);
+    if (!new_buffer) {
+        ESP_LOGE(TAG, "Failed to grow receive buffer to %d bytes", new_capacity);
+        return false;
+    }
+
+    ESP_LOGD(TAG, "Receive buffer grown: %d -> %d bytes", rx_capacity, new_capacity);
+    rx_buffer = new_buffer;
+    rx_capacity = new_capacity;
+    return true;
+}
+
+void ChromecastController::release_rx_buffer() {
+    free(rx_buffer);
+    rx_buffer = nullptr;
+    rx_capacity = 0;
+    rx_length = 0;
+}
+
+bool ChromecastController::replay_message(const uint8_t* message, size_t length) {
+    CastMessageView view;
+    if (!CastMessageDecoder::decode(message, length, view)) {
+        return false;
+    }
+    replaying = true;
+    handle_incoming_message(view);
+    replaying = false;
+    return true;
+}
+
+int ChromecastController::process_rx_frames() {
+    size_t offset = 0;
+    int processed = 0;
+
+    // Split out every complete length-prefixed frame currently buffered
+    const uint8_t* body = nullptr;
+    uint32_t message_length = 0;
+    CastFrameCodec::Status status;
+    while ((status = CastFrameCodec::next_frame(rx_buffer + offset, rx_length - offset, MAX_MESSAGE_SIZE,
+                                                body, message_length)) == CastFrameCodec::FRAME_OK) {
+        traffic_capture_record(TRAFFIC_CAST_FRAME, nullptr, 0, body, message_length);
+        // Decode in place; the view stays valid until the buffer is compacted below
+        CastMessageView message;
+        if (CastMessageDecoder::decode(body, message_length, message)) {
+            handle_incoming_message(message);
+            processed++;
+        } else {
+            ESP_LOGE(TAG, "Failed to unpack protobuf message (%u bytes)", message_length);
+        }
+
+        offset += CastFrameCodec::HEADER_SIZE + message_length;
+    }
+    if (status == CastFrameCodec::FRAME_INVALID) {
+        // The stream cannot be resynchronised after a bad length prefix
+        ESP_LOGE(TAG, "Invalid frame length: %u bytes (max: %d)", message_length, MAX_MESSAGE_SIZE);
+        return -1;
+    }
+
+    // Compact the remaining partial frame to the front of the buffer
+    if (offset > 0) {
+        rx_length -= offset;
+        if (rx_length > 0) {
+            memmove(rx_buffer, rx_buffer + offset, rx_length);
+        }
+    }
+
+    // Make sure a partially received frame has room to complete
+    if (rx_length >= CastFrameCodec::HEADER_SIZE) {
+        if (!ensure_rx_capacity(CastFrameCodec::read_header(rx_buffer) + CastFrameCodec::HEADER_SIZE)) {
+            return -1;
+        }
+    }
+
+    return processed;
+}
+
+ChromecastController::ReceiveResult ChromecastController::receive_available(int& processed) {
+    processed = 0;
+
+    if (!tls_handle) {
+        return RECEIVE_CLOSED;
+    }
+    if (!ensure_rx_capacity(RX_BUFFER_INITIAL_SIZE)) {
         ESP_LOGE(TAG, "Failed to allocate receive buffer");
-        vTaskDelete(nullptr);
+        return RECEIVE_STREAM_ERROR;
+    }
+
+    // Read as much as TLS has ready into the free tail of the frame buffer
+    size_t space = rx_capacity - rx_length;
+    ssize_t len_read = esp_tls_conn_read(tls_handle, rx_buffer + rx_length, space);
+    if (len_read <= 0) {
+        if (len_read == ESP_TLS_ERR_SSL_WANT_READ || len_read == ESP_TLS_ERR_SSL_WANT_WRITE) {
+            return RECEIVE_AGAIN;
+        }
+        if (len_read == 0) {
+            ESP_LOGW(TAG, "Connection closed by remote");
+            return RECEIVE_CLOSED;
+        }
+        ESP_LOGE(TAG, "TLS read error: %d", len_read);
+        return RECEIVE_READ_ERROR;
+    }
+
+    rx_length += len_read;
+
+    int64_t read_us = esp_timer_get_time();
+    TELEMETRY_TRACE_BEGIN(TELEMETRY_TRACE_CAST_RECEIVE);
+    processed = process_rx_frames();
+    TELEMETRY_TRACE_END(TELEMETRY_TRACE_CAST_RECEIVE);
+    if (processed < 0) {
+        processed = 0;
+        return RECEIVE_STREAM_ERROR;
+    }
+    if (processed > 0) {
+        telemetry_record(TELEMETRY_CAST_RX_LATENCY, (uint32_t)(esp_timer_get_time() - read_us));
+    }
+    return RECEIVE_OK;
+}
+
+bool ChromecastController::has_buffered_input() const {
+    // mbedTLS may hold decrypted bytes that select() cannot see
+    return tls_handle && esp_tls_get_bytes_avail(tls_handle) > 0;
+}
+
+int ChromecastController::get_socket_fd() const {
+    int sockfd = -1;
+    if (tls_handle && esp_tls_get_conn_sockfd(tls_handle, &sockfd) == ESP_OK) {
+        return sockfd;
+    }
+    return -1;
+}
+
+void ChromecastController::mark_connection_failed() {
+    ESP_LOGE(TAG, "Receive stream failed, marking connection as failed");
+    current_state = ERROR_STATE;
+    if (state_callback) {
+        state_callback(current_state);
+    }
+    schedule_reconnect();
+}
+
+void ChromecastController::schedule_reconnect() {
+    // Pooled connections are re-added by their owner
+    if (!auto_reconnect || external_io || reconnect_task_handle || chromecast_ip.empty()) {
         return;
     }
+    if (device_auth_rejected) {
+        ESP_LOGW(TAG, "Not reconnecting to %s: device failed authentication", chromecast_ip.c_str());
+        return;
+    }
+
+    reconnect_stop = false;
+    if (!mem_task_create(reconnect_task, "chromecast_reconn", CONNECT_TASK_STACK_SIZE, this, CONNECT_TASK_PRIORITY,
+                         &reconnect_task_handle, TASK_PLAN_NETWORK_CORE, MEM_TASK_STACK_INTERNAL)) {
+        ESP_LOGE(TAG, "Failed to create reconnect task");
+        reconnect_task_handle = nullptr;
+    }
+}
+
+void ChromecastController::stop_reconnect() {
+    if (!reconnect_task_handle || reconnect_task_handle == xTaskGetCurrentTaskHandle()) {
+        return;
+    }
+
+    reconnect_stop = true;
+    connect_cancelled = true;
+    xTaskNotifyGive(reconnect_task_handle);
+    while (reconnect_task_handle) {
+        vTaskDelay(pdMS_TO_TICKS(TLS_CONNECT_POLL_MS));
+    }
+    connect_cancelled = false;
+}
+
+void ChromecastController::reconnect_task(void* parameter) {
+    ChromecastController* controller = static_cast<ChromecastController*>(parameter);
+    uint32_t backoff_ms = RECONNECT_BACKOFF_MIN_MS;
+    int attempt = 0;
+
+    // Drop the dead transport; the receive task exits once the socket is shut down
+    controller->close_transport();
+    controller->reset_app_session();
+
+    while (!controller->reconnect_stop) {
+        // Equal jitter: half fixed, half random, so several units do not retry in lockstep
+        uint32_t delay_ms = backoff_ms / 2 + esp_random() % (backoff_ms / 2 + 1);
+        attempt++;
+        ESP_LOGI(TAG, "Reconnecting to %s in %u ms (attempt %d)", controller->chromecast_ip.c_str(), delay_ms, attempt);
+
+        // disconnect() wakes us early through a task notification
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(delay_ms));
+        if (controller->reconnect_stop) {
+            break;
+        }
+
+        if (controller->connect_to_chromecast(controller->chromecast_ip, controller->chromecast_port)) {
+            ESP_LOGI(TAG, "Reconnected to %s after %d attempts", controller->chromecast_ip.c_str(), attempt);
+            break;
+        }
+        if (controller->device_auth_rejected) {
+            ESP_LOGW(TAG, "Not reconnecting to %s: device failed authentication", controller->chromecast_ip.c_str());
+            controller->close_transport();
+            break;
+        }
+
+        controller->close_transport();
+        backoff_ms = std::min<uint32_t>(backoff_ms * 2, RECONNECT_BACKOFF_MAX_MS);
+    }
+
+    controller->reconnect_task_handle = nullptr;
+    mem_task_delete(nullptr);
+}
+
+void ChromecastController::check_liveness() {
+    if (!is_connection_healthy() || liveness_timeout_ms == 0) {
+        return;
+    }
+
+    // Any inbound message (PONG, status, ...) proves the link is alive
+    TickType_t silent = xTaskGetTickCount() - last_rx_tick;
+    if (silent > pdMS_TO_TICKS(liveness_timeout_ms)) {
+        ESP_LOGW(TAG, "No message from %s for %u ms, declaring link dead",
+                 chromecast_ip.c_str(), (unsigned)pdTICKS_TO_MS(silent));
+        mark_connection_failed();
+    }
+}
+
+uint32_t ChromecastController::receive_error_backoff_ms(int consecutive_errors) {
+    // Doubles with every error in a row: a glitch costs little, a dead link is not spun on
+    uint32_t backoff_ms = RECEIVE_BACKOFF_MIN_MS << std::min(consecutive_errors - 1, 8);
+    return std::min(backoff_ms, RECEIVE_BACKOFF_MAX_MS);
+}
+
+bool ChromecastController::wait_readable(uint32_t timeout_ms) {
+    // Decrypted bytes already in mbedTLS do not wake select()
+    if (has_buffered_input()) {
+        return true;
+    }
+    int sockfd = get_socket_fd();
+    if (sockfd < 0) {
+        return false;
+    }
+
+    fd_set read_fds;
+    FD_ZERO(&read_fds);
+    FD_SET(sockfd, &read_fds);
+    if (tx_wake_fd >= 0) {
+        FD_SET(tx_wake_fd, &read_fds);
+    }
+    struct timeval timeout;
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+    if (select(std::max(sockfd, tx_wake_fd) + 1, &read_fds, nullptr, nullptr, &timeout) <= 0) {
+        return false;
+    }
+    // Cleared before the queue is written, so a message queued meanwhile wakes us again
+    if (tx_wake_fd >= 0 && FD_ISSET(tx_wake_fd, &read_fds)) {
+        clear_tx_wake();
+    }
+    // Readable also covers a peer close and the shutdown() from close_transport()
+    return FD_ISSET(sockfd, &read_fds);
+}
+
+void ChromecastController::receive_task(void* parameter) {
+    ChromecastController* controller = static_cast<ChromecastController*>(parameter);
+
+    controller->rx_length = 0;
 
     int consecutive_errors = 0;
-    const int MAX_CONSECUTIVE_ERRORS = 5;
     int message_count = 0;
+    bool stream_broken = false;
 
     ESP_LOGI(TAG, "Receive task started - Free heap: %d bytes", esp_get_free_heap_size());
 
-    while (controller->is_connected() && consecutive_errors < MAX_CONSECUTIVE_ERRORS) {
-        // Read message length (4 bytes, big-endian)
-        ssize_t len_read = esp_tls_conn_read(controller->tls_handle, buffer, 4);
-        if (len_read != 4) {
-            if (len_read == 0) {
-                ESP_LOGW(TAG, "Connection closed by remote");
-            } else if (len_read < 0) {
-                ESP_LOGE(TAG, "TLS read error: %d", len_read);
-            } else {
-                ESP_LOGE(TAG, "Incomplete length read: %d bytes", len_read);
-            }
-            consecutive_errors++;
-            vTaskDelay(pdMS_TO_TICKS(100)); // Brief delay before retry
+    // Block on the socket and read whatever is ready as soon as it is: a
+    // burst of frames is drained back to back, with no sleep between them.
+    // Queued messages (PONGs, heartbeats, GUI commands) are written first.
+    while (controller->is_connected() && consecutive_errors < RECEIVE_MAX_ERRORS) {
+        if (!controller->flush_tx()) {
+            stream_broken = true;
+            break;
+        }
+        if (!controller->wait_readable(RECEIVE_WAIT_MS)) {
             continue;
         }
 
-        uint32_t message_length = (buffer[0] << 24) | (buffer[1] << 16) | (buffer[2] << 8) | buffer[3];
+        int processed = 0;
+        ReceiveResult result = controller->receive_available(processed);
 
-        if (message_length == 0) {
-            ESP_LOGW(TAG, "Received zero-length message");
-            consecutive_errors++;
+        if (result == RECEIVE_AGAIN) {
             continue;
         }
-
-        if (message_length > 2048) {
-            ESP_LOGE(TAG, "Message too large: %d bytes (max: 2048)", message_length);
+        if (result == RECEIVE_STREAM_ERROR) {
+            stream_broken = true;
+            break;
+        }
+        if (result != RECEIVE_OK) {
             consecutive_errors++;
+            if (consecutive_errors < RECEIVE_MAX_ERRORS && controller->is_connected()) {
+                vTaskDelay(pdMS_TO_TICKS(receive_error_backoff_ms(consecutive_errors)));
+            }
             continue;
         }
-
-        // Read message data
-        ssize_t data_read = esp_tls_conn_read(controller->tls_handle, buffer, message_length);
-        if (data_read != message_length) {
-            if (data_read < 0) {
-                ESP_LOGE(TAG, "TLS read error for message data: %d", data_read);
-            } else {
-                ESP_LOGE(TAG, "Incomplete message read: %d of %d bytes", data_read, message_length);
-            }
-            consecutive_errors++;
-            vTaskDelay(pdMS_TO_TICKS(100)); // Brief delay before retry
+        if (processed == 0) {
             continue;
         }
 
-        // Unpack protobuf message
-        Extensions__Api__CastChannel__CastMessage* message =
-            extensions__api__cast_channel__cast_message__unpack(nullptr, message_length, buffer);
+        consecutive_errors = 0; // Reset error counter on successful message
+        int previous_count = message_count;
+        message_count += processed;
 
-        if (message) {
-            controller->handle_incoming_message(message);
-            extensions__api__cast_channel__cast_message__free_unpacked(message, nullptr);
-            consecutive_errors = 0; // Reset error counter on successful message
-            message_count++;
-
-            // Log memory status every 10 messages
-            if (message_count % 10 == 0) {
-                size_t free_heap = esp_get_free_heap_size();
-                ESP_LOGD(TAG, "Processed %d messages, Free heap: %d bytes", message_count, free_heap);
-
-                // Force garbage collection if memory is getting low
-                if (free_heap < 16384) { // Less than 16KB
-                    ESP_LOGW(TAG, "Low memory detected (%d bytes), forcing delay", free_heap);
-                    vTaskDelay(pdMS_TO_TICKS(100)); // Longer delay to allow cleanup
-                }
-            }
-        } else {
-            ESP_LOGE(TAG, "Failed to unpack protobuf message");
-            consecutive_errors++;
+        // Log memory status every 10 messages
+        if (message_count / 10 != previous_count / 10) {
+            ESP_LOGD(TAG, "Processed %d messages, internal free: %d bytes", message_count, mem_budget_internal_free());
         }
-
-        vTaskDelay(pdMS_TO_TICKS(10)); // Small delay to prevent tight loop
     }
 
     // If we exit due to errors, update connection state
-    if (consecutive_errors >= MAX_CONSECUTIVE_ERRORS) {
-        ESP_LOGE(TAG, "Too many consecutive errors, marking connection as failed");
-        controller->current_state = ChromecastController::ERROR_STATE;
-        if (controller->state_callback) {
-            controller->state_callback(controller->current_state);
-        }
+    if (stream_broken || consecutive_errors >= RECEIVE_MAX_ERRORS) {
+        controller->mark_connection_failed();
     }
 
     ESP_LOGI(TAG, "Receive task ended");
 
-    // Clean up allocated buffer
-    free(buffer);
-    vTaskDelete(nullptr);
+    // Frame buffer is kept for the next connection and released on disconnect
+    controller->rx_length = 0;
+    controller->receive_task_handle = nullptr;
+    mem_task_delete(nullptr);
 }
 
-void ChromecastController::handle_incoming_message(const Extensions__Api__CastChannel__CastMessage* message) {
-    if (!message->namespace_ || !message->payload_utf8) {
+void ChromecastController::handle_incoming_message(const CastMessageView& message) {
+    uint8_t ns_id = namespaces.lookup(message.namespace_);
+
+    // Device auth is the only namespace that carries binary payloads
+    if (ns_id == CAST_NS_DEVICE_AUTH) {
+        last_rx_tick = xTaskGetTickCount();
+        handle_device_auth(message);
+        return;
+    }
+
+    if (message.namespace_.empty() || !message.has_payload_utf8) {
         ESP_LOGW(TAG, "Received message with missing namespace or payload");
         return;
     }
 
-    // Use const char* directly to avoid string copying and reduce stack usage
-    const char* namespace_str = message->namespace_;
-    const char* payload = message->payload_utf8;
-    size_t payload_len = strlen(payload);
-
-    ESP_LOGI(TAG, "RECV <- Namespace: %s, Size: %d bytes", namespace_str, payload_len);
-    ESP_LOGD(TAG, "RECV <- Payload: %s", payload);
-
-    // Handle heartbeat messages
-    if (strcmp(namespace_str, NAMESPACE_HEARTBEAT) == 0) {
-        std::string payload_str(payload);
-        cJSON* json = safe_json_parse(payload_str, 4096);
-        if (json) {
-            cJSON* type = cJSON_GetObjectItem(json, "type");
-            if (type && cJSON_IsString(type)) {
-                if (strcmp(type->valuestring, "PING") == 0) {
-                    ESP_LOGD(TAG, "Received PING, responding with PONG");
-                    std::string pong_msg = create_json_message("PONG");
-                    bool success = send_protobuf_message(NAMESPACE_HEARTBEAT, pong_msg);
-                    if (!success) {
-                        ESP_LOGW(TAG, "Failed to send PONG response");
-                    }
-                } else if (strcmp(type->valuestring, "PONG") == 0) {
-                    ESP_LOGD(TAG, "Received PONG - heartbeat acknowledged");
-                }
-            }
-            cJSON_Delete(json);
-        } else {
-            ESP_LOGW(TAG, "Failed to parse heartbeat JSON: %s", payload);
-        }
-    }
-    // Handle connection messages
-    else if (namespace_str == NAMESPACE_CONNECTION) {
-        cJSON* json = safe_json_parse(payload, 4096);
-        if (json) {
-            cJSON* type = cJSON_GetObjectItem(json, "type");
-            if (type && cJSON_IsString(type)) {
-                ESP_LOGI(TAG, "Connection message type: %s", type->valuestring);
-                if (strcmp(type->valuestring, "CLOSE") == 0) {
-                    ESP_LOGW(TAG, "Received CLOSE message from Chromecast");
-                }
-            }
-            cJSON_Delete(json);
+    last_rx_tick = xTaskGetTickCount();
+
+    // Both slices point into rx_buffer and are not NUL-terminated
+    const CastSlice& ns = message.namespace_;
+    const char* payload = message.payload_utf8.data;
+    size_t payload_len = message.payload_utf8.length;
+
+    ESP_LOGD(TAG, "RECV <- Namespace: %.*s, Size: %d bytes", (int)ns.length, ns.data, payload_len);
+    ESP_LOGD(TAG, "RECV <- Payload: %.*s", (int)payload_len, payload);
+
+    // Extract the fields we act on in one allocation-free pass
+    CastPayload parsed;
+    if (!CastPayloadParser::parse(payload, payload_len, parsed)) {
+        ESP_LOGW(TAG, "Malformed JSON payload on %.*s", (int)ns.length, ns.data);
+    }
+
+    // One table lookup, however many namespaces are registered
+    const NamespaceHandler& handler = namespace_handlers[ns_id];
+    if (handler) {
+        handler(message, parsed);
+    } else {
+        ESP_LOGD(TAG, "Unhandled namespace: %.*s", (int)ns.length, ns.data);
+    }
+
+    // Resolve the matching request after cached state has been updated
+    complete_request(parsed);
+
+    // Views into rx_buffer: nothing is copied for the listener
+    if (message_callback) {
+        message_callback(std::string_view(ns.data, ns.length), std::string_view(payload, payload_len));
+    }
+}
+
+void ChromecastController::process_heartbeat_message(const CastMessageView& message, const CastPayload& payload) {
+    if (strcmp(payload.type, "PING") == 0) {
+        ESP_LOGD(TAG, "Received PING, responding with PONG");
+        bool success = send_control_message(NAMESPACE_HEARTBEAT, "PONG");
+        if (!success) {
+            ESP_LOGW(TAG, "Failed to send PONG response");
         }
+    } else if (strcmp(payload.type, "PONG") == 0) {
+        ESP_LOGD(TAG, "Received PONG - heartbeat acknowledged");
+        last_pong_tick = last_rx_tick;
+    } else {
+        ESP_LOGW(TAG, "Unexpected heartbeat payload: %.*s",
+                 (int)message.payload_utf8.length, message.payload_utf8.data);
     }
-    // Handle receiver messages
-    else if (namespace_str == NAMESPACE_RECEIVER) {
-        process_receiver_message(payload);
+}
+
+void ChromecastController::process_connection_message(const CastPayload& payload) {
+    ESP_LOGD(TAG, "Connection message type: %s", payload.type);
+    if (strcmp(payload.type, "CLOSE") == 0) {
+        ESP_LOGW(TAG, "Received CLOSE message from Chromecast");
+    }
+}
+
+void ChromecastController::process_receiver_message(const CastPayload& payload) {
+    if (strcmp(payload.type, "GET_APP_AVAILABILITY") == 0) {
+        for (uint8_t i = 0; i < payload.availability_count; i++) {
+            const CastPayload::AppAvailability& app = payload.availability[i];
+            ESP_LOGD(TAG, "App %s %savailable", app.app_id, app.available ? "" : "not ");
+            CastAppCache::store_availability(device_key().c_str(), app.app_id, app.available);
+        }
+        return;
     }
-    else {
-        ESP_LOGD(TAG, "Unhandled namespace: %s", namespace_str);
+    if (strcmp(payload.type, "RECEIVER_STATUS") != 0) {
+        return;
     }
 
-    // Call user callback if set
-    if (message_callback) {
-        message_callback(namespace_str, payload);
+    // The answer to a LAUNCH whose send has not returned yet
+    if (payload.has_request_id && payload.request_id != 0) {
+        lock_app_state();
+        if (launch_request_id == payload.request_id) {
+            app_id = launch_app_id;
+            launch_request_id = 0;
+            launch_app_id.clear();
+        }
+        unlock_app_state();
+    }
+
+    // Track the session of the app we launched (or the media receiver if already running)
+    const std::string wanted = wanted_app_id();
+    const CastPayload::Application* session_app = nullptr;
+    for (uint8_t i = 0; i < payload.application_count; i++) {
+        const CastPayload::Application& app = payload.applications[i];
+        ESP_LOGD(TAG, "Running app %s (%s), transport: %s", app.app_id, app.display_name, app.transport_id);
+        if (wanted == app.app_id && app.transport_id[0] != '\0') {
+            session_app = &app;
+        }
+    }
+
+    if (session_app && app_connection_speculative && app_transport_id == session_app->transport_id) {
+        // The cached session is still the app's: already connected, MEDIA_STATUS asked for
+        ESP_LOGI(TAG, "Resumed app session %s", session_app->session_id);
+        app_connection_speculative = false;
+        app_connection_established = true;
+        if (pending_load.active) {
+            pending_load.active = false;
+            send_load_message(pending_load);
+        }
+    } else if (session_app) {
+        drop_speculative_session();
+        if (!app_connection_established || app_transport_id != session_app->transport_id) {
+            connect_to_app(*session_app);
+        }
+    } else if (app_connection_speculative) {
+        drop_speculative_session();
+    } else if (app_connection_established) {
+        ESP_LOGI(TAG, "App session %s ended", app_session_id.c_str());
+        CastAppCache::forget_session(device_key().c_str());
+        reset_app_session();
+        notify_media_status();
+    }
+
+    if (payload.has_volume) {
+        VolumeInfo volume_info = {payload.volume_level, payload.volume_muted};
+        taskENTER_CRITICAL(&volume_lock);
+        volume_reported = volume_info;
+        taskEXIT_CRITICAL(&volume_lock);
+
+        ESP_LOGD(TAG, "Volume status - Level: %.2f, Muted: %s",
+                volume_info.level, volume_info.muted ? "true" : "false");
+
+        if (reconcile_volume_echo(volume_info) && volume_callback) {
+            volume_callback(volume_info);
+        }
     }
 }
 
-void ChromecastController::process_receiver_message(const std::string& payload) {
-    cJSON* json = safe_json_parse(payload, 8192);
-    if (!json) {
+void ChromecastController::process_multizone_message(const CastPayload& payload) {
+    bool full_status = strcmp(payload.type, "MULTIZONE_STATUS") == 0;
+    bool upsert = strcmp(payload.type, "DEVICE_ADDED") == 0 || strcmp(payload.type, "DEVICE_UPDATED") == 0;
+    bool removed = strcmp(payload.type, "DEVICE_REMOVED") == 0;
+    if (!full_status && !upsert && !removed) {
+        ESP_LOGD(TAG, "Unhandled multizone message: %s", payload.type);
         return;
     }
 
-    cJSON* type = cJSON_GetObjectItem(json, "type");
-    if (type && cJSON_IsString(type)) {
-        if (strcmp(type->valuestring, "RECEIVER_STATUS") == 0) {
-            // Extract volume information
-            cJSON* status = cJSON_GetObjectItem(json, "status");
-            if (status) {
-                cJSON* volume_obj = cJSON_GetObjectItem(status, "volume");
-                if (volume_obj) {
-                    VolumeInfo volume_info = {0.0f, false};
-
-                    cJSON* level = cJSON_GetObjectItem(volume_obj, "level");
-                    if (level && cJSON_IsNumber(level)) {
-                        volume_info.level = level->valuedouble;
-                    }
-
-                    cJSON* muted = cJSON_GetObjectItem(volume_obj, "muted");
-                    if (muted && cJSON_IsBool(muted)) {
-                        volume_info.muted = cJSON_IsTrue(muted);
-                    }
-
-                    ESP_LOGI(TAG, "Volume status - Level: %.2f, Muted: %s",
-                            volume_info.level, volume_info.muted ? "true" : "false");
-
-                    if (volume_callback) {
-                        volume_callback(volume_info);
-                    }
-                }
+    // Copied out under the lock so the callback runs without it
+    GroupMember snapshot[CastPayload::MAX_GROUP_MEMBERS];
+    size_t count;
+
+    taskENTER_CRITICAL(&group_lock);
+    if (full_status) {
+        group_member_count = payload.member_count;
+        memcpy(group_members, payload.members, payload.member_count * sizeof(GroupMember));
+    } else {
+        const char* id = upsert ? payload.members[0].device_id : payload.device_id;
+        size_t index = 0;
+        while (index < group_member_count && strcmp(group_members[index].device_id, id) != 0) {
+            index++;
+        }
+
+        if (removed && index < group_member_count) {
+            group_members[index] = group_members[--group_member_count];
+        } else if (upsert && payload.member_count > 0 && index < CastPayload::MAX_GROUP_MEMBERS) {
+            group_members[index] = payload.members[0];
+            if (index == group_member_count) {
+                group_member_count++;
             }
         }
     }
+    count = group_member_count;
+    memcpy(snapshot, group_members, count * sizeof(GroupMember));
+    taskEXIT_CRITICAL(&group_lock);
+
+    ESP_LOGD(TAG, "Group %s: %d members", payload.type, count);
+    if (group_callback) {
+        group_callback(snapshot, count);
+    }
+}
+
+size_t ChromecastController::get_group_members(GroupMember* out, size_t max_out) {
+    if (!out || max_out == 0) {
+        return 0;
+    }
 
-    cJSON_Delete(json);
+    taskENTER_CRITICAL(&group_lock);
+    size_t count = std::min(group_member_count, max_out);
+    memcpy(out, group_members, count * sizeof(GroupMember));
+    taskEXIT_CRITICAL(&group_lock);
+    return count;
+}
+
+void ChromecastController::process_media_message(const CastPayload& payload) {
+    if (strcmp(payload.type, "MEDIA_STATUS") != 0) {
+        if (strcmp(payload.type, "LOAD_FAILED") == 0 || strcmp(payload.type, "LOAD_CANCELLED") == 0 ||
+            strcmp(payload.type, "INVALID_REQUEST") == 0) {
+            ESP_LOGW(TAG, "Media request %u failed: %s", payload.request_id, payload.type);
+        }
+        return;
+    }
+
+    lock_app_state();
+    if (!payload.has_media_status) {
+        // An empty status array means the media session is gone
+        media_status.player_state = "IDLE";
+        media_status.media_session_id = 0;
+        media_status.current_time = 0.0;
+        media_status.duration = 0.0;
+    } else {
+        // MEDIA_STATUS updates are partial; only overwrite what was sent
+        if (payload.media_session_id != 0) {
+            media_status.media_session_id = payload.media_session_id;
+        }
+        if (payload.player_state[0] != '\0') {
+            media_status.player_state = payload.player_state;
+        }
+        media_status.idle_reason = payload.idle_reason;
+        media_status.current_time = payload.current_time;
+        if (payload.duration > 0.0) {
+            media_status.duration = payload.duration;
+        }
+    }
+    media_status.updated_at = xTaskGetTickCount();
+
+    ESP_LOGD(TAG, "Media status - %s at %.1f/%.1fs (session %u)",
+             media_status.player_state.c_str(), media_status.current_time,
+             media_status.duration, media_status.media_session_id);
+    unlock_app_state();
+
+    notify_media_status();
 }
 
 void ChromecastController::run_message_loop() {
@@ -613,12 +2181,9 @@ void ChromecastController::run_message_loop() {
     ESP_LOGI(TAG, "Message loop ended");
 }
 
-cJSON* ChromecastController::safe_json_parse(const std::string& payload, size_t min_free_heap) {
+cJSON* ChromecastController::safe_json_parse(std::string_view payload, size_t min_free_heap) {
     // Check available memory before parsing
-    size_t free_heap = esp_get_free_heap_size();
-    if (free_heap < min_free_heap) {
-        ESP_LOGW(TAG, "Insufficient memory for JSON parsing: %d bytes available, %d required",
-                 free_heap, min_free_heap);
+    if (!mem_budget_admit(MEM_BUDGET_FOREGROUND, min_free_heap)) {
         return nullptr;
     }
 
@@ -629,7 +2194,8 @@ cJSON* ChromecastController::safe_json_parse(const std::string& payload, size_t
     }
 
     // Attempt to parse with error handling
-    cJSON* json = cJSON_Parse(payload.c_str());
+    // The view need not be NUL-terminated
+    cJSON* json = cJSON_ParseWithLength(payload.data(), payload.length());
     if (!json) {
         const char* error_ptr = cJSON_GetErrorPtr();
         if (error_ptr != nullptr) {
@@ -646,21 +2212,7 @@ cJSON* ChromecastController::safe_json_parse(const std::string& payload, size_t
 }
 
 void ChromecastController::log_memory_status(const char* context) {
-    size_t free_heap = esp_get_free_heap_size();
-    size_t min_free_heap = esp_get_minimum_free_heap_size();
-
-    if (context) {
-        ESP_LOGI(TAG, "Memory status [%s]: Free: %d bytes, Min free: %d bytes",
-                 context, free_heap, min_free_heap);
-    } else {
-        ESP_LOGI(TAG, "Memory status: Free: %d bytes, Min free: %d bytes",
-                 free_heap, min_free_heap);
-    }
-
-    // Log warning if memory is getting low
-    if (free_heap < 32768) { // Less than 32KB
-        ESP_LOGW(TAG, "Low memory warning: Only %d bytes free", free_heap);
-    }
+    mem_budget_log(context);
 }
 
 bool ChromecastController::is_connection_healthy() const {
@@ -1,26 +1,50 @@
 #pragma once
 
+#include <array>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <functional>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/timers.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
+#include "task_plan.h"
 #include "cJSON.h"
 
 #include "chromecast_protobuf/cast_channel.pb-c.h"
 #include "esp_tls.h"
+#include "cast_app_cache.h"
+#include "cast_device_auth.h"
+#include "cast_frame_codec.h"
+#include "cast_message_view.h"
+#include "cast_namespace.h"
+#include "cast_payload_parser.h"
+#include "cast_request_table.h"
 
 /**
  * ChromecastController - ESP-IDF C++ class for controlling Chromecast devices
  * 
  * Features:
- * - TLS connection establishment
+ * - Non-blocking TLS connection establishment with session resumption
  * - Protobuf message handling
- * - Volume control
- * - Heartbeat/ping management
+ * - deviceauth challenge with NVS-cached verification
+ * - requestId correlation with timeouts and round-trip latency stats
+ * - Streaming length-prefixed frame decoding
+ * - Volume control; on a multizone group one SET_VOLUME to the leader covers every member
+ * - Group membership tracking (urn:x-cast:com.google.cast.multizone)
+ * - Media playback (LAUNCH/LOAD/PLAY/PAUSE/SEEK) with cached MEDIA_STATUS
+ * - Per-device cache of app availability and the last app session: a
+ *   reconnect opens the cached session speculatively alongside GET_STATUS
+ *   and checks it against the first RECEIVER_STATUS
+ * - Heartbeat/ping management with liveness timeout and auto-reconnect
+ * - One outbound queue per connection, written by the I/O task only;
+ *   messages queued together go out in one TLS write
  * - JSON message serialization/deserialization
+ * - Incoming messages dispatched by namespace ID; app namespaces of custom
+ *   receivers can register their own handlers
+ * - Allocation-free extraction of status fields from incoming payloads
  */
 class ChromecastController {
 public:
@@ -28,11 +52,70 @@ public:
     static constexpr const char* NAMESPACE_CONNECTION = "urn:x-cast:com.google.cast.tp.connection";
     static constexpr const char* NAMESPACE_HEARTBEAT = "urn:x-cast:com.google.cast.tp.heartbeat";
     static constexpr const char* NAMESPACE_RECEIVER = "urn:x-cast:com.google.cast.receiver";
+    static constexpr const char* NAMESPACE_MEDIA = "urn:x-cast:com.google.cast.media";
+    static constexpr const char* NAMESPACE_DEVICE_AUTH = "urn:x-cast:com.google.cast.tp.deviceauth";
+    static constexpr const char* NAMESPACE_MULTIZONE = "urn:x-cast:com.google.cast.multizone";
+
+    // Google's Default Media Receiver application
+    static constexpr const char* DEFAULT_MEDIA_RECEIVER_APP_ID = "CC1AD845";
 
     // Default Chromecast port
     static constexpr int CHROMECAST_PORT = 8009;
     static constexpr int HEARTBEAT_INTERVAL_MS = 5000;
 
+    // TLS connect tuning
+    static constexpr int TLS_CONNECT_TIMEOUT_MS = 10000;
+    static constexpr int TLS_CONNECT_POLL_MS = 20;
+    static constexpr uint32_t CONNECT_TASK_STACK_SIZE = 6144;
+    static constexpr UBaseType_t CONNECT_TASK_PRIORITY = TASK_PLAN_CAST_CONNECT_PRIORITY;
+    // Speculative connects (warm standby) handshake below everything interactive
+    static constexpr UBaseType_t BACKGROUND_CONNECT_PRIORITY = TASK_PLAN_CAST_PREWARM_PRIORITY;
+
+    // Liveness and reconnect tuning
+    static constexpr uint32_t LIVENESS_TIMEOUT_MS = 3 * HEARTBEAT_INTERVAL_MS;
+    static constexpr uint32_t RECONNECT_BACKOFF_MIN_MS = 1000;
+    static constexpr uint32_t RECONNECT_BACKOFF_MAX_MS = 60000;
+    static constexpr uint32_t RECEIVE_TASK_EXIT_TIMEOUT_MS = 1000;
+    static constexpr uint32_t RECEIVE_TASK_STACK_SIZE = 8192;
+    static constexpr UBaseType_t RECEIVE_TASK_PRIORITY = TASK_PLAN_CAST_RECEIVE_PRIORITY;
+
+    // Receive task: longest wait on the socket before the connection is
+    // re-checked, and the backoff after read errors (doubling per error in
+    // a row, the link is dropped after RECEIVE_MAX_ERRORS)
+    static constexpr uint32_t RECEIVE_WAIT_MS = 500;
+    static constexpr uint32_t RECEIVE_BACKOFF_MIN_MS = 20;
+    static constexpr uint32_t RECEIVE_BACKOFF_MAX_MS = 320;
+    static constexpr int RECEIVE_MAX_ERRORS = 5;
+
+    // Coalesced volume pipeline (request_volume)
+    static constexpr uint32_t VOLUME_DEFAULT_RATE_HZ = 10;
+    static constexpr uint32_t VOLUME_ACK_TIMEOUT_MS = 500;
+    static constexpr uint32_t VOLUME_SETTLE_MS = 750;
+    static constexpr uint32_t VOLUME_TASK_STACK_SIZE = 3072;
+    static constexpr UBaseType_t VOLUME_TASK_PRIORITY = TASK_PLAN_CAST_VOLUME_PRIORITY;
+
+    // Default deadline for requests that expect a reply
+    static constexpr uint32_t REQUEST_TIMEOUT_MS = 5000;
+    // A device that has not answered the auth challenge by then is rejected
+    static constexpr uint32_t DEVICE_AUTH_TIMEOUT_MS = 5000;
+
+    // Receive frame buffer sizing. Cast frames are capped at 64KB by the protocol.
+    static constexpr size_t RX_BUFFER_INITIAL_SIZE = 2048;
+    static constexpr size_t MAX_MESSAGE_SIZE = 65536;
+
+    // Stack buffer size for fixed control messages (PING, SET_VOLUME, ...)
+    static constexpr size_t CONTROL_MESSAGE_SIZE = 192;
+
+    // Stack buffer size for LOAD messages (URL + metadata); a media server URL
+    // with an escaped non-ASCII path takes up to MEDIA_SERVER_URL_MAX
+    static constexpr size_t MEDIA_LOAD_MESSAGE_SIZE = 1024;
+
+    // Outbound queue, and the buffer it is swapped into while being written;
+    // holds a LOAD plus the control messages queued with it
+    static constexpr size_t TX_QUEUE_SIZE = 1536;
+    // eventfds registered with the VFS: one per controller, pooled ones included
+    static constexpr size_t TX_WAKE_MAX_FDS = 8;
+
     // Connection states
     enum ConnectionState {
         DISCONNECTED,
@@ -47,10 +130,39 @@ public:
         bool muted;
     };
 
+    // Progress of connect_to_chromecast / connect_to_chromecast_async
+    enum ConnectStage {
+        CONNECT_STAGE_TLS_HANDSHAKE,
+        CONNECT_STAGE_VIRTUAL_CONNECT,
+        CONNECT_STAGE_COMPLETE,
+        CONNECT_STAGE_FAILED,
+        CONNECT_STAGE_CANCELLED
+    };
+
+    // Media session status, updated incrementally from MEDIA_STATUS
+    struct MediaStatus {
+        std::string player_state;   // IDLE, BUFFERING, PLAYING, PAUSED
+        std::string idle_reason;    // FINISHED, CANCELLED, ERROR, INTERRUPTED
+        uint32_t media_session_id;  // 0 when no media is loaded
+        double current_time;        // Position in seconds at updated_at
+        double duration;            // Seconds, 0 if unknown/live
+        TickType_t updated_at;
+    };
+
     // Callback function types
-    using MessageCallback = std::function<void(const std::string&, const std::string&)>;
+    // Namespace and payload are views into the receive buffer, valid only for
+    // the call; a listener that keeps either must copy it (std::string(view))
+    using MessageCallback = std::function<void(std::string_view namespace_str, std::string_view payload)>;
     using StateCallback = std::function<void(ConnectionState)>;
     using VolumeCallback = std::function<void(const VolumeInfo&)>;
+    using MediaStatusCallback = std::function<void(const MediaStatus&)>;
+    using GroupMember = CastPayload::GroupMember;
+    using GroupCallback = std::function<void(const GroupMember* members, size_t count)>;
+    using ConnectProgressCallback = std::function<void(ConnectStage)>;
+    using ResponseCallback = CastRequestTable::Callback;
+    using LatencyStats = CastRequestTable::LatencyStats;
+    // Messages on one namespace; payload holds the fields parsed from its JSON
+    using NamespaceHandler = std::function<void(const CastMessageView& message, const CastPayload& payload)>;
 
 private:
     // ESP-IDF specific members
@@ -63,34 +175,205 @@ private:
     int chromecast_port;
     std::string sender_id;
     std::string destination_id;
+    std::string device_id;          // Device UUID, keys the TLS session cache
 
     // State management
     ConnectionState current_state;
     uint32_t request_id_counter;
     bool virtual_connection_established;
 
+    // Receiver application session (media namespace target). app_id,
+    // launch_* and media_status are read by other tasks and guarded by
+    // request_mutex; app_id only changes once a LAUNCH is sent, or when the
+    // RECEIVER_STATUS answering it comes in first.
+    std::string app_id;
+    std::string launch_app_id;
+    uint32_t launch_request_id;         // 0 when no LAUNCH is outstanding
+    std::string app_session_id;
+    std::string app_transport_id;
+    bool app_connection_established;
+    bool app_connection_speculative;    // CONNECT sent to the cached session, not yet confirmed
+    MediaStatus media_status;
+
+    // LOAD deferred until the launched app reports its transportId
+    struct PendingLoad {
+        bool active;
+        std::string url;
+        std::string content_type;
+        std::string title;
+        bool autoplay;
+        double start_time;
+    } pending_load;
+
+    // Receive frame buffer (owned by receive_task)
+    uint8_t* rx_buffer;
+    size_t rx_capacity;
+    size_t rx_length;
+
+    // Outbound queue (internal RAM). Any thread packs frames into tx_queue
+    // under send_mutex, held only for the copy; the I/O task, woken through
+    // tx_wake_fd, swaps it with tx_flush and writes it under write_mutex.
+    // Only the I/O task touches the TLS session once it runs.
+    uint8_t* tx_queue;
+    uint8_t* tx_flush;
+    size_t tx_length;
+    SemaphoreHandle_t send_mutex;
+    SemaphoreHandle_t write_mutex;
+    int tx_wake_fd;                 // eventfd, -1 if none: senders then write themselves
+
+    // When set, receive and heartbeat are driven by ChromecastConnectionPool
+    bool external_io;
+
+    // Incoming dispatch: namespace -> ID -> handler (empty: unhandled)
+    CastNamespaceRegistry namespaces;
+    std::array<NamespaceHandler, CastNamespaceRegistry::MAX_IDS> namespace_handlers;
+
+    // Background connect (connect_to_chromecast_async)
+    TaskHandle_t connect_task_handle;
+    volatile bool connect_cancelled;
+    std::string pending_connect_ip;
+    int pending_connect_port;
+
+    // Liveness monitor and background reconnect
+    bool auto_reconnect;
+    volatile bool reconnect_stop;
+    TaskHandle_t reconnect_task_handle;
+    uint32_t liveness_timeout_ms;
+    volatile TickType_t last_rx_tick;
+    volatile TickType_t last_pong_tick;
+
+    // Latest-value-wins volume channel, guarded by volume_lock
+    portMUX_TYPE volume_lock;
+    TaskHandle_t volume_task_handle;
+    volatile bool volume_task_stop;
+    VolumeInfo volume_target;
+    VolumeInfo volume_sent;
+    VolumeInfo volume_reported;     // Last RECEIVER_STATUS volume, level < 0 until one arrives
+    bool volume_target_pending;
+    bool volume_in_flight;
+    TickType_t volume_last_request_tick;
+    uint32_t volume_min_interval_ms;
+
+    // Outstanding requests by requestId, guarded by request_mutex (which
+    // also guards the app and media state above)
+    CastRequestTable request_table;
+    SemaphoreHandle_t request_mutex;
+    TimerHandle_t request_timer;
+
+    // Device authentication (deviceauth namespace)
+    CastDeviceAuth device_auth;
+    bool device_auth_required;
+    volatile bool device_auth_rejected;
+
+    // Set while replay_message() handles a recorded frame: sends are dropped
+    bool replaying;
+
+    // Members of the connected multizone group, guarded by group_lock
+    GroupMember group_members[CastPayload::MAX_GROUP_MEMBERS];
+    size_t group_member_count;
+    portMUX_TYPE group_lock;
+
     // Callbacks
     MessageCallback message_callback;
     StateCallback state_callback;
     VolumeCallback volume_callback;
+    GroupCallback group_callback;
+    MediaStatusCallback media_status_callback;
+    ConnectProgressCallback connect_progress_callback;
 
     // Internal methods
     bool establish_tls_connection();
+    void report_connect_stage(ConnectStage stage);
     bool send_virtual_connect();
-    bool send_protobuf_message(const std::string& namespace_str, const std::string& payload);
-    void handle_incoming_message(const Extensions__Api__CastChannel__CastMessage* message);
-    void process_receiver_message(const std::string& payload);
-    std::string create_json_message(const std::string& type, uint32_t request_id = 0, const cJSON* additional_data = nullptr);
+    bool send_protobuf_message(const char* namespace_str, const char* payload, const char* destination = nullptr);
+    bool send_binary_message(const char* namespace_str, const uint8_t* data, size_t length, const char* destination = nullptr);
+    bool send_cast_message(const Extensions__Api__CastChannel__CastMessage& message);
+    bool send_oversized_message(const Extensions__Api__CastChannel__CastMessage& message, size_t message_size);
+    bool io_task_writes() const;
+    bool write_queued();
+    bool write_all(const uint8_t* data, size_t length);
+    void start_device_auth();
+    void handle_device_auth(const CastMessageView& message);
+    bool wait_device_auth();
+    bool device_auth_allows(const Extensions__Api__CastChannel__CastMessage& message) const;
+    bool send_protobuf_message(const char* namespace_str, const std::string& payload, const char* destination = nullptr) {
+        return send_protobuf_message(namespace_str, payload.c_str(), destination);
+    }
+    bool send_control_message(const char* namespace_str, const char* type, const char* destination = nullptr,
+                              ResponseCallback callback = nullptr, uint32_t timeout_ms = REQUEST_TIMEOUT_MS);
+    uint32_t begin_request(const char* type, ResponseCallback callback = nullptr, uint32_t timeout_ms = REQUEST_TIMEOUT_MS);
+    bool send_request(const char* namespace_str, const char* payload, const char* destination, uint32_t request_id);
+    void discard_request(uint32_t request_id);
+    void complete_request(const CastPayload& response);
+    void cancel_pending_requests();
+    void arm_request_timer();
+    bool send_media_command(const char* type, double seek_time = -1.0, ResponseCallback callback = nullptr,
+                            uint32_t timeout_ms = REQUEST_TIMEOUT_MS);
+    bool send_load_message(const PendingLoad& load);
+    void connect_to_app(const CastPayload::Application& app);
+    void resume_cached_session();
+    void drop_speculative_session();
+    void reset_app_session();
+    // request_mutex around app_id and media_status; a no-op before initialize()
+    void lock_app_state() const { if (request_mutex) xSemaphoreTake(request_mutex, portMAX_DELAY); }
+    void unlock_app_state() const { if (request_mutex) xSemaphoreGive(request_mutex); }
+    // app_id, or the default media receiver before anything was launched
+    std::string wanted_app_id() const;
+    // Hands media_status_callback a copy taken under the lock
+    void notify_media_status();
+    // Keys the per-device caches (TLS session, device auth, apps)
+    const std::string& device_key() const { return device_id.empty() ? chromecast_ip : device_id; }
+    void handle_incoming_message(const CastMessageView& message);
+    void process_heartbeat_message(const CastMessageView& message, const CastPayload& payload);
+    void process_connection_message(const CastPayload& payload);
+    void process_receiver_message(const CastPayload& payload);
+    void process_media_message(const CastPayload& payload);
+    void process_multizone_message(const CastPayload& payload);
+    bool ensure_rx_capacity(size_t required);
+    int process_rx_frames();
+    void release_rx_buffer();
 
     // Memory-safe JSON parsing helper
-    cJSON* safe_json_parse(const std::string& payload, size_t min_free_heap = 4096);
+    cJSON* safe_json_parse(std::string_view payload, size_t min_free_heap = 4096);
 
     // Memory management helpers
     void log_memory_status(const char* context = nullptr);
 
+    // Receive path shared by receive_task and ChromecastConnectionPool
+    enum ReceiveResult {
+        RECEIVE_OK,
+        RECEIVE_AGAIN,
+        RECEIVE_READ_ERROR,
+        RECEIVE_CLOSED,
+        RECEIVE_STREAM_ERROR
+    };
+    ReceiveResult receive_available(int& processed);
+    bool has_buffered_input() const;
+    bool wait_readable(uint32_t timeout_ms);
+    bool flush_tx();
+    int get_tx_wake_fd() const { return tx_wake_fd; }
+    void clear_tx_wake();
+    static uint32_t receive_error_backoff_ms(int consecutive_errors);
+    int get_socket_fd() const;
+    void mark_connection_failed();
+    void close_transport();
+    void check_liveness();
+    void schedule_reconnect();
+    void stop_reconnect();
+    bool reconcile_volume_echo(const VolumeInfo& reported);
+    bool start_volume_task();
+    void stop_volume_task();
+    void send_heartbeat();
+    void set_external_io(bool enabled) { external_io = enabled; }
+    friend class ChromecastConnectionPool;
+
     // Static callback functions for FreeRTOS
     static void heartbeat_timer_callback(TimerHandle_t timer);
     static void receive_task(void* parameter);
+    static void connect_task(void* parameter);
+    static void reconnect_task(void* parameter);
+    static void volume_task(void* parameter);
+    static void request_timer_callback(TimerHandle_t timer);
 
 public:
     ChromecastController();
@@ -98,24 +381,136 @@ public:
 
     // Main control methods
     bool initialize();
-    bool connect_to_chromecast(const std::string& ip = "");
+    // Speaker groups listen on their own port on the leader's address
+    bool connect_to_chromecast(const std::string& ip = "", int port = CHROMECAST_PORT);
+    bool connect_to_chromecast_async(const std::string& ip, int port = CHROMECAST_PORT,
+                                     UBaseType_t priority = CONNECT_TASK_PRIORITY);
+    void cancel_connect();
+    bool is_connecting() const { return connect_task_handle != nullptr; }
+    void set_device_id(const std::string& uuid) { device_id = uuid; }
+
+    // Challenge the device over the deviceauth namespace after connecting. When
+    // required (CONFIG_CAST_DEVICE_AUTH_REQUIRED by default), the connect waits
+    // up to DEVICE_AUTH_TIMEOUT_MS for the answer and only the transport
+    // namespaces go out until then; a failed or missing answer closes the link
+    // and suppresses auto-reconnect
+    void set_device_auth_required(bool required) { device_auth_required = required; }
+    bool is_device_auth_required() const { return device_auth_required; }
+    bool set_device_auth_roots(const uint8_t* certs, size_t length) { return device_auth.set_trusted_roots(certs, length); }
+    CastDeviceAuth::Status get_device_auth_status() const { return device_auth.get_status(); }
+    bool is_device_authenticated() const {
+        CastDeviceAuth::Status status = device_auth.get_status();
+        return status == CastDeviceAuth::AUTH_VERIFIED || status == CastDeviceAuth::AUTH_CACHED;
+    }
+    // The last connect failed because the device did not authenticate
+    bool is_device_auth_rejected() const { return device_auth_rejected; }
+
+    // Reconnect in the background with jittered exponential backoff when the
+    // link drops or stays silent for longer than the liveness timeout
+    void set_auto_reconnect(bool enabled) { auto_reconnect = enabled; }
+    void set_liveness_timeout(uint32_t timeout_ms) { liveness_timeout_ms = timeout_ms; }
+    bool is_reconnecting() const { return reconnect_task_handle != nullptr; }
+    TickType_t get_last_pong_tick() const { return last_pong_tick; }
     void disconnect();
     bool set_volume(float level, bool muted = false);
+    // Tracked: callback hears the RECEIVER_STATUS answering it, or the timeout
+    bool set_volume(float level, bool muted, ResponseCallback callback, uint32_t timeout_ms = REQUEST_TIMEOUT_MS);
+    // SET_VOLUME with only the muted flag: each speaker keeps its own level
+    bool set_muted(bool muted, ResponseCallback callback = nullptr, uint32_t timeout_ms = REQUEST_TIMEOUT_MS);
+
+    // Non-blocking volume update for sliders: only the latest value is sent,
+    // at most one SET_VOLUME in flight and no faster than the configured rate
+    bool request_volume(float level, bool muted = false);
+    void set_volume_rate_limit(uint32_t max_hz);
+    // Speaker volume from the last RECEIVER_STATUS; false until one arrived
+    bool get_volume(VolumeInfo& out);
+
+    // A command is about to be issued (e.g. a wake word was heard): start the
+    // volume task now, and PING a link that has been quiet for a heartbeat
+    // interval so a dead one is found and reconnected before the command
+    void prewarm();
     bool get_status();
+    bool get_status(ResponseCallback callback, uint32_t timeout_ms = REQUEST_TIMEOUT_MS);
     void start_heartbeat();
     void stop_heartbeat();
 
+    // GET_APP_AVAILABILITY for up to CastPayload::MAX_APPLICATIONS app IDs;
+    // the answers are cached per device (get_cached_app_availability)
+    bool get_app_availability(const char* const* app_ids, size_t count, ResponseCallback callback = nullptr,
+                              uint32_t timeout_ms = REQUEST_TIMEOUT_MS);
+    CastAppCache::Availability get_cached_app_availability(const char* app) const {
+        return CastAppCache::find_availability(device_key().c_str(), app);
+    }
+
+    // Media control (urn:x-cast:com.google.cast.media)
+    // Refused without a round trip if the device last said the app is unavailable
+    bool launch_app(const std::string& app = DEFAULT_MEDIA_RECEIVER_APP_ID);
+    // Send on an app namespace to the launched app's session (has_app_session())
+    bool send_app_message(const char* ns, const char* payload);
+    bool load_media(const std::string& url, const std::string& content_type,
+                    const std::string& title = "", bool autoplay = true, double start_time = 0.0);
+    // load_media() for a file under MEDIA_SERVER_ROOT, fetched by the receiver
+    // from the on-device media server; false if that is not running
+    bool load_file(const std::string& path, const std::string& title = "",
+                   bool autoplay = true, double start_time = 0.0);
+    bool play();
+    bool pause();
+    bool stop_media();
+    // Tracked: callback hears the MEDIA_STATUS answering it, or the timeout
+    bool play(ResponseCallback callback, uint32_t timeout_ms = REQUEST_TIMEOUT_MS);
+    bool pause(ResponseCallback callback, uint32_t timeout_ms = REQUEST_TIMEOUT_MS);
+    bool stop_media(ResponseCallback callback, uint32_t timeout_ms = REQUEST_TIMEOUT_MS);
+    bool seek(double position_seconds);
+    bool get_media_status();
+
     // Callback setters
     void set_message_callback(MessageCallback callback) { message_callback = callback; }
     void set_state_callback(StateCallback callback) { state_callback = callback; }
     void set_volume_callback(VolumeCallback callback) { volume_callback = callback; }
+    void set_group_callback(GroupCallback callback) { group_callback = callback; }
+    void set_media_status_callback(MediaStatusCallback callback) { media_status_callback = callback; }
+    void set_connect_progress_callback(ConnectProgressCallback callback) { connect_progress_callback = callback; }
+
+    /**
+     * Route messages on an app namespace (e.g. a custom receiver's channel)
+     * to handler, on the receive path. Register before connecting.
+     * @return false if CastNamespaceRegistry::MAX_CUSTOM namespaces are taken
+     *         or ns is a platform namespace, which the controller handles itself
+     */
+    bool register_namespace_handler(const char* ns, NamespaceHandler handler);
+
+    /**
+     * Handle one recorded CastMessage (a frame body from traffic_capture) as
+     * if it had just been received, without a connection. Replies it would
+     * send are dropped. Call from one task, not alongside the receive task.
+     * @return false if message does not decode
+     */
+    bool replay_message(const uint8_t* message, size_t length);
 
     // Getters
     ConnectionState get_state() const { return current_state; }
     std::string get_connected_device() const { return chromecast_ip; }
+    int get_connected_port() const { return chromecast_port; }
+    // Cast groups never use the default port; speakers always do
+    bool is_group() const { return chromecast_port != CHROMECAST_PORT; }
+    size_t get_group_members(GroupMember* out, size_t max_out);
+    // A copy: the receive task updates it
+    MediaStatus get_cached_media_status() const;
+    double get_estimated_position() const;
+    bool has_app_session() const { return app_connection_established; }
+    const std::string& get_app_transport_id() const { return app_transport_id; }
 
     // Utility methods
     void run_message_loop();
     bool is_connected() const { return current_state == CONNECTED; }
     bool is_connection_healthy() const;
+    size_t get_latency_stats(LatencyStats* out, size_t max_out);
+    size_t get_pending_request_count() const { return request_table.pending(); }
+
+    // The shared TLS session cache (tls_profile), serialised so it survives deep
+    // sleep; sessions that do not fit are skipped. Both return 0 without
+    // CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS.
+    static size_t export_sessions(uint8_t* out, size_t capacity);
+    // Returns the number of sessions restored; records mbedTLS cannot load are dropped
+    static size_t import_sessions(const uint8_t* data, size_t length);
 };
@@ -30,9 +30,9 @@ void chromecast_example_task(void* parameter) {
         }
     });
     
-    controller.set_message_callback([](const std::string& namespace_str, const std::string& payload) {
-        ESP_LOGI(TAG, "Message callback - Namespace: %s", namespace_str.c_str());
-        ESP_LOGD(TAG, "Message payload: %s", payload.c_str());
+    controller.set_message_callback([](std::string_view namespace_str, std::string_view payload) {
+        ESP_LOGI(TAG, "Message callback - Namespace: %.*s", (int)namespace_str.length(), namespace_str.data());
+        ESP_LOGD(TAG, "Message payload: %.*s", (int)payload.length(), payload.data());
     });
     
     controller.set_volume_callback([](const ChromecastController::VolumeInfo& volume) {
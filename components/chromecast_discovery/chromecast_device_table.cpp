@@ -0,0 +1,400 @@
+#include "chromecast_device_table.h"
+#include <algorithm>
+#include <cstring>
+#include "esp_log.h"
+
+static const char* TAG = "ChromecastDeviceTable";
+
+ChromecastDeviceTable::ChromecastDeviceTable() {
+    clear();
+}
+
+void ChromecastDeviceTable::clear() {
+    memset(records, 0, sizeof(records));
+    count = 0;
+    memset(uuid_index, 0, sizeof(uuid_index));
+    memset(name_index, 0, sizeof(name_index));
+    memset(ip_index, 0, sizeof(ip_index));
+    memset(intern_index, 0, sizeof(intern_index));
+    pool[0] = '\0';     // Offset 0 is the shared empty string
+    pool_used = 1;
+    change_epoch++;
+    set_change_epoch++;
+}
+
+uint32_t ChromecastDeviceTable::hash_bytes(const void* data, size_t length) {
+    // FNV-1a
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+uint32_t ChromecastDeviceTable::hash_string(const char* str) {
+    return hash_bytes(str, strlen(str));
+}
+
+bool ChromecastDeviceTable::parse_uuid(const char* text, uint8_t (&out)[16]) {
+    if (!text) {
+        return false;
+    }
+
+    // Chromecasts publish 32 hex digits; tolerate the dashed form too
+    size_t digits = 0;
+    for (const char* p = text; *p; p++) {
+        char c = *p;
+        int value;
+        if (c >= '0' && c <= '9') value = c - '0';
+        else if (c >= 'a' && c <= 'f') value = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') value = c - 'A' + 10;
+        else if (c == '-') continue;
+        else return false;
+
+        if (digits >= 32) {
+            return false;
+        }
+        if (digits % 2 == 0) {
+            out[digits / 2] = value << 4;
+        } else {
+            out[digits / 2] |= value;
+        }
+        digits++;
+    }
+    return digits == 32;
+}
+
+uint16_t ChromecastDeviceTable::intern(const char* str) {
+    if (!str || !*str) {
+        return 0;
+    }
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        uint32_t bucket = hash_string(str) & (INDEX_SIZE - 1);
+        for (size_t probe = 0; probe < INDEX_SIZE; probe++) {
+            uint16_t offset = intern_index[bucket];
+            if (offset == 0) {
+                break;
+            }
+            if (strcmp(&pool[offset], str) == 0) {
+                return offset;
+            }
+            bucket = (bucket + 1) & (INDEX_SIZE - 1);
+        }
+
+        size_t length = strlen(str) + 1;
+        if (pool_used + length <= STRING_POOL_SIZE && intern_index[bucket] == 0) {
+            uint16_t offset = pool_used;
+            memcpy(&pool[offset], str, length);
+            pool_used += length;
+            intern_index[bucket] = offset;
+            return offset;
+        }
+
+        // Out of pool space or intern buckets: drop strings no record uses any more
+        compact_pool();
+    }
+
+    ESP_LOGW(TAG, "String pool full, dropping \"%s\"", str);
+    return 0;
+}
+
+void ChromecastDeviceTable::compact_pool() {
+    // Collect every live offset; the pool is append-only, so moving strings
+    // down in offset order never overwrites one that has not moved yet
+    uint16_t live[MAX_DEVICES * 5];
+    size_t live_count = 0;
+    for (const Record& r : records) {
+        if (!r.in_use) continue;
+        for (uint16_t offset : {r.uuid_text, r.name, r.instance_name, r.model, r.status}) {
+            if (offset != 0) live[live_count++] = offset;
+        }
+    }
+    std::sort(live, live + live_count);
+    live_count = std::unique(live, live + live_count) - live;
+
+    uint16_t moved[MAX_DEVICES * 5];
+    size_t write = 1;
+    for (size_t i = 0; i < live_count; i++) {
+        size_t length = strlen(&pool[live[i]]) + 1;
+        memmove(&pool[write], &pool[live[i]], length);
+        moved[i] = write;
+        write += length;
+    }
+    pool_used = write;
+
+    auto remap = [&](uint16_t& offset) {
+        if (offset == 0) return;
+        size_t i = std::lower_bound(live, live + live_count, offset) - live;
+        offset = moved[i];
+    };
+    memset(intern_index, 0, sizeof(intern_index));
+    for (Record& r : records) {
+        if (!r.in_use) continue;
+        remap(r.uuid_text);
+        remap(r.name);
+        remap(r.instance_name);
+        remap(r.model);
+        remap(r.status);
+    }
+
+    for (size_t i = 0; i < live_count; i++) {
+        uint32_t bucket = hash_string(&pool[moved[i]]) & (INDEX_SIZE - 1);
+        while (intern_index[bucket] != 0) {
+            bucket = (bucket + 1) & (INDEX_SIZE - 1);
+        }
+        intern_index[bucket] = moved[i];
+    }
+    ESP_LOGD(TAG, "String pool compacted to %d bytes", pool_used);
+}
+
+void ChromecastDeviceTable::index_insert(uint8_t* index, uint32_t hash, int slot) {
+    uint32_t bucket = hash & (INDEX_SIZE - 1);
+    while (index[bucket] != 0) {
+        bucket = (bucket + 1) & (INDEX_SIZE - 1);
+    }
+    index[bucket] = slot + 1;
+}
+
+void ChromecastDeviceTable::rebuild_indexes() {
+    // At most MAX_DEVICES records, and only rebuilt when a key field changes
+    memset(uuid_index, 0, sizeof(uuid_index));
+    memset(name_index, 0, sizeof(name_index));
+    memset(ip_index, 0, sizeof(ip_index));
+
+    for (int slot = 0; slot < (int)MAX_DEVICES; slot++) {
+        const Record& r = records[slot];
+        if (!r.in_use) continue;
+        if (r.has_uuid) {
+            index_insert(uuid_index, hash_bytes(r.uuid, sizeof(r.uuid)), slot);
+        }
+        if (r.name != 0) {
+            index_insert(name_index, hash_string(str(r.name)), slot);
+        }
+        if (r.instance_name != 0 && r.instance_name != r.name) {
+            index_insert(name_index, hash_string(str(r.instance_name)), slot);
+        }
+        if (r.ipv4 != 0) {
+            index_insert(ip_index, hash_bytes(&r.ipv4, sizeof(r.ipv4)), slot);
+        }
+    }
+}
+
+int ChromecastDeviceTable::find_by_uuid(const char* uuid) const {
+    uint8_t key[16];
+    if (!parse_uuid(uuid, key)) {
+        return -1;
+    }
+
+    uint32_t bucket = hash_bytes(key, sizeof(key)) & (INDEX_SIZE - 1);
+    for (size_t probe = 0; probe < INDEX_SIZE && uuid_index[bucket] != 0; probe++) {
+        int slot = uuid_index[bucket] - 1;
+        if (memcmp(records[slot].uuid, key, sizeof(key)) == 0) {
+            return slot;
+        }
+        bucket = (bucket + 1) & (INDEX_SIZE - 1);
+    }
+    return -1;
+}
+
+int ChromecastDeviceTable::find_by_name(const char* name) const {
+    if (!name || !*name) {
+        return -1;
+    }
+
+    uint32_t bucket = hash_string(name) & (INDEX_SIZE - 1);
+    for (size_t probe = 0; probe < INDEX_SIZE && name_index[bucket] != 0; probe++) {
+        int slot = name_index[bucket] - 1;
+        const Record& r = records[slot];
+        if (strcmp(str(r.name), name) == 0 || strcmp(str(r.instance_name), name) == 0) {
+            return slot;
+        }
+        bucket = (bucket + 1) & (INDEX_SIZE - 1);
+    }
+    return -1;
+}
+
+int ChromecastDeviceTable::find_by_ip(uint32_t ipv4, uint32_t exclude_capabilities) const {
+    if (ipv4 == 0) {
+        return -1;
+    }
+
+    uint32_t bucket = hash_bytes(&ipv4, sizeof(ipv4)) & (INDEX_SIZE - 1);
+    for (size_t probe = 0; probe < INDEX_SIZE && ip_index[bucket] != 0; probe++) {
+        int slot = ip_index[bucket] - 1;
+        if (records[slot].ipv4 == ipv4 && (records[slot].capabilities & exclude_capabilities) == 0) {
+            return slot;
+        }
+        bucket = (bucket + 1) & (INDEX_SIZE - 1);
+    }
+    return -1;
+}
+
+int ChromecastDeviceTable::find(const char* uuid, const char* instance_name) const {
+    int slot = find_by_uuid(uuid);
+    if (slot < 0 && instance_name && *instance_name) {
+        // Answers without TXT records only carry the instance name
+        slot = find_by_name(instance_name);
+        if (slot >= 0 && strcmp(str(records[slot].instance_name), instance_name) != 0) {
+            slot = -1;
+        }
+    }
+    return slot;
+}
+
+bool ChromecastDeviceTable::set_string(uint16_t& field, const char* value) {
+    // Empty values never overwrite: a partial answer must not erase known data
+    if (!value || !*value || strcmp(str(field), value) == 0) {
+        return false;
+    }
+    field = intern(value);
+    return true;
+}
+
+ChromecastDeviceTable::Change ChromecastDeviceTable::merge(const Answer& answer, TickType_t now, int& slot) {
+    // A UPnP UDN may equal the Cast UUID of the same box; only Cast UUIDs are keys
+    bool cast = answer.protocol == PROTOCOL_CAST;
+    slot = find(cast ? answer.uuid : nullptr, answer.instance_name);
+    if (slot >= 0 && records[slot].protocol != answer.protocol) {
+        slot = -1;
+    }
+
+    if (slot < 0) {
+        // The controller needs an IPv4 address; IPv6-only answers only refresh known devices
+        if (answer.ipv4 == 0) {
+            return CHANGE_NONE;
+        }
+        for (int i = 0; i < (int)MAX_DEVICES; i++) {
+            if (!records[i].in_use) {
+                slot = i;
+                break;
+            }
+        }
+        if (slot < 0) {
+            ESP_LOGW(TAG, "Device table full (%d), ignoring %s", MAX_DEVICES,
+                     answer.name ? answer.name : answer.instance_name);
+            return CHANGE_NONE;
+        }
+
+        Record& r = records[slot];
+        memset(&r, 0, sizeof(r));
+        r.in_use = true;
+        r.protocol = answer.protocol;
+        r.has_uuid = cast && parse_uuid(answer.uuid, r.uuid);
+        r.uuid_text = intern(answer.uuid);
+        r.instance_name = intern(answer.instance_name);
+        r.name = intern(answer.name && *answer.name ? answer.name : answer.instance_name);
+        r.model = intern(answer.model);
+        r.status = intern(answer.status);
+        r.capabilities = answer.capabilities;
+        r.ipv4 = answer.ipv4;
+        r.port = answer.port;
+        r.last_seen = now;
+        r.ttl_ms = answer.ttl_ms;
+        count++;
+        rebuild_indexes();
+        change_epoch++;
+        set_change_epoch++;
+        return CHANGE_ADDED;
+    }
+
+    Record& r = records[slot];
+    r.last_seen = now;
+    r.ttl_ms = answer.ttl_ms;
+
+    // Any answer confirms a device restored from flash
+    bool changed = r.probable;
+    bool rekey = false;
+    r.probable = false;
+    if (cast && !r.has_uuid && parse_uuid(answer.uuid, r.uuid)) {
+        r.has_uuid = true;
+        rekey = true;
+    }
+    set_string(r.uuid_text, answer.uuid);
+    rekey |= set_string(r.name, answer.name);
+    rekey |= set_string(r.instance_name, answer.instance_name);
+    changed |= set_string(r.model, answer.model);
+    if (answer.ipv4 != 0 && answer.ipv4 != r.ipv4) {
+        r.ipv4 = answer.ipv4;
+        rekey = true;
+    }
+    if (answer.port != 0 && answer.port != r.port) {
+        r.port = answer.port;
+        changed = true;
+    }
+
+    if (answer.has_capabilities && answer.capabilities != r.capabilities) {
+        r.capabilities = answer.capabilities;
+        changed = true;
+    }
+
+    // Unlike the other fields an empty status is meaningful (no app running);
+    // only answers without TXT records pass nullptr
+    bool status_changed = answer.status && strcmp(str(r.status), answer.status) != 0;
+    if (status_changed) {
+        r.status = intern(answer.status);
+    }
+
+    if (rekey) {
+        rebuild_indexes();
+    }
+    if (changed || rekey || status_changed) {
+        change_epoch++;
+    }
+    if (changed || rekey) {
+        set_change_epoch++;
+        return CHANGE_UPDATED;
+    }
+    return status_changed ? CHANGE_STATUS : CHANGE_NONE;
+}
+
+void ChromecastDeviceTable::confirm(int slot, TickType_t now, uint32_t ttl_ms) {
+    if (!in_use(slot)) {
+        return;
+    }
+    if (records[slot].probable) {
+        change_epoch++;
+        set_change_epoch++;
+    }
+    records[slot].probable = false;
+    records[slot].last_seen = now;
+    records[slot].ttl_ms = ttl_ms;
+}
+
+void ChromecastDeviceTable::set_probable(int slot, TickType_t now, uint32_t ttl_ms) {
+    if (!in_use(slot)) {
+        return;
+    }
+    set_probable(slot);
+    records[slot].last_seen = now;
+    records[slot].ttl_ms = ttl_ms;
+}
+
+void ChromecastDeviceTable::remove(int slot) {
+    if (!in_use(slot)) {
+        return;
+    }
+    records[slot].in_use = false;
+    count--;
+    rebuild_indexes();
+    change_epoch++;
+    set_change_epoch++;
+}
+
+int ChromecastDeviceTable::next_expired(TickType_t now) const {
+    for (int slot = 0; slot < (int)MAX_DEVICES; slot++) {
+        if (expired(slot, now)) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+bool ChromecastDeviceTable::expired(int slot, TickType_t now) const {
+    return in_use(slot) && now - records[slot].last_seen > pdMS_TO_TICKS(records[slot].ttl_ms);
+}
+
+bool ChromecastDeviceTable::refresh_due(int slot, TickType_t now) const {
+    return in_use(slot) && now - records[slot].last_seen > pdMS_TO_TICKS(records[slot].ttl_ms / 2);
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "freertos/FreeRTOS.h"
+
+/**
+ * ChromecastDeviceTable - Compact, indexed table of discovered Chromecasts
+ *
+ * Features:
+ * - Fixed-capacity records with a 16-byte binary UUID key
+ * - Interned strings in a single pool (no per-field heap allocation)
+ * - Open-addressed hash indexes by UUID, name/instance name and IPv4 address
+ * - Duplicate answers (IPv4/IPv6, several interfaces, TXT-less answers)
+ *   merge into one record
+ * - TTL bookkeeping per record
+ * - "Probable" records (restored from flash) until an answer or probe confirms them
+ * - Cast and UPnP records side by side, each keyed only against its own kind
+ * - An epoch that moves on whenever a record changes, so copies can be reused
+ *
+ * Not thread-safe; ChromecastDiscovery guards it with its table mutex.
+ */
+class ChromecastDeviceTable {
+public:
+    static constexpr size_t MAX_DEVICES = 20;
+    static constexpr size_t STRING_POOL_SIZE = 3072;
+    static constexpr size_t INDEX_SIZE = 64;        // Power of two, > 2 * MAX_DEVICES
+
+    // Where a record came from, and so how the device is controlled
+    enum Protocol : uint8_t {
+        PROTOCOL_CAST,      // _googlecast._tcp over mDNS
+        PROTOCOL_UPNP       // UPnP/DLNA media renderer found with SSDP
+    };
+
+    // One mDNS or SSDP answer; pointers are only read during merge()
+    struct Answer {
+        const char* uuid;           // TXT "id"
+        const char* name;           // TXT "fn", falls back to the instance name
+        const char* instance_name;
+        const char* model;          // TXT "md"
+        uint32_t ipv4;              // Network byte order, 0 if the answer had no A record
+        uint16_t port;
+        uint32_t ttl_ms;
+        bool has_capabilities;      // TXT "ca" present
+        uint32_t capabilities;
+        const char* status;         // TXT "rs", "" if TXT had none, nullptr without TXT
+        Protocol protocol;          // UPnP: instance_name is the UDN, uuid is never indexed
+    };
+
+    struct Record {
+        bool in_use;
+        bool has_uuid;
+        bool probable;              // Restored from flash, not yet seen on the network
+        Protocol protocol;
+        uint8_t uuid[16];
+        uint16_t uuid_text;         // String pool offsets, 0 is the empty string
+        uint16_t name;
+        uint16_t instance_name;
+        uint16_t model;
+        uint16_t status;
+        uint32_t capabilities;
+        uint32_t ipv4;
+        uint16_t port;
+        TickType_t last_seen;
+        uint32_t ttl_ms;
+    };
+
+    enum Change {
+        CHANGE_NONE,
+        CHANGE_ADDED,
+        CHANGE_UPDATED,
+        CHANGE_STATUS       // Only the receiver status text changed
+    };
+
+    ChromecastDeviceTable();
+
+    // Merge an answer into the table; slot receives the affected record or -1
+    Change merge(const Answer& answer, TickType_t now, int& slot);
+    void remove(int slot);
+    void set_probable(int slot) { records[slot].probable = true; change_epoch++; set_change_epoch++; }
+    // Back to probable with a new TTL, e.g. a record that lapsed while nobody asked
+    void set_probable(int slot, TickType_t now, uint32_t ttl_ms);
+    // Mark a probable record as seen, e.g. after a successful TCP probe
+    void confirm(int slot, TickType_t now, uint32_t ttl_ms);
+    void clear();
+
+    int find(const char* uuid, const char* instance_name) const;
+    int find_by_uuid(const char* uuid) const;
+    int find_by_name(const char* name) const;      // Friendly or instance name
+    // Records whose capabilities intersect exclude_capabilities are skipped,
+    // e.g. speaker groups that share their leader's address
+    int find_by_ip(uint32_t ipv4, uint32_t exclude_capabilities = 0) const;
+
+    // First record whose TTL has run out, or -1
+    int next_expired(TickType_t now) const;
+    bool expired(int slot, TickType_t now) const;
+    // Past half its TTL: time to ask the device again, like an mDNS cache would
+    bool refresh_due(int slot, TickType_t now) const;
+
+    size_t size() const { return count; }
+    // Changes with every added, changed or removed record (last_seen/TTL excepted)
+    uint32_t epoch() const { return change_epoch; }
+    // As epoch(), but receiver status text changes leave it alone
+    uint32_t set_epoch() const { return set_change_epoch; }
+    bool in_use(int slot) const { return slot >= 0 && slot < (int)MAX_DEVICES && records[slot].in_use; }
+    const Record& record(int slot) const { return records[slot]; }
+    const char* str(uint16_t offset) const { return &pool[offset]; }
+
+private:
+    Record records[MAX_DEVICES];
+    size_t count;
+    uint32_t change_epoch = 0;
+    uint32_t set_change_epoch = 0;
+
+    // Indexes hold slot + 1, 0 marks an empty bucket
+    uint8_t uuid_index[INDEX_SIZE];
+    uint8_t name_index[INDEX_SIZE];
+    uint8_t ip_index[INDEX_SIZE];
+
+    char pool[STRING_POOL_SIZE];
+    size_t pool_used;
+    uint16_t intern_index[INDEX_SIZE];
+
+    static uint32_t hash_bytes(const void* data, size_t length);
+    static uint32_t hash_string(const char* str);
+    static bool parse_uuid(const char* text, uint8_t (&out)[16]);
+
+    uint16_t intern(const char* str);
+    void compact_pool();
+    void rebuild_indexes();
+    static void index_insert(uint8_t* index, uint32_t hash, int slot);
+    bool set_string(uint16_t& field, const char* value);
+};
@@ -1,21 +1,41 @@
 #include "chromecast_discovery.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <sstream>
-
-extern "C" {
-    #include "lvgl.h"
-}
+#include "nvs.h"
+#include "mem_task.h"
+#include "task_plan.h"
+#include "lwip/sockets.h"
 
 static const char* TAG = "ChromecastDiscovery";
 
+ChromecastDiscovery* ChromecastDiscovery::browse_owner = nullptr;
+
 ChromecastDiscovery::ChromecastDiscovery()
     : initialized(false)
     , discovery_active(false)
     , current_mode(SYNC_ONCE)
+    , browse_handle(nullptr)
+    , sweep_search(nullptr)
+    , abandoned_lock(portMUX_INITIALIZER_UNLOCKED)
+    , abandoned_searches{}
+    , abandoned_count(0)
+    , peers(nullptr)
     , periodic_timer(nullptr)
+    , sweep_timer(nullptr)
     , periodic_interval_ms(DEFAULT_PERIODIC_INTERVAL_MS)
+    , interest(INTEREST_BACKGROUND)
+    , sweep_interval_ms(DEFAULT_PERIODIC_INTERVAL_MS)
+    , last_sweep(0)
+    , sweep_set_epoch(0)
     , timeout_ms(DEFAULT_TIMEOUT_MS)
     , max_results(DEFAULT_MAX_RESULTS)
+    , table_mutex(nullptr)
+    , table_dirty(false)
+    , probe_active(false)
 {
 }
 
@@ -42,7 +62,31 @@ bool ChromecastDiscovery::initialize() {
 
     ESP_LOGI(TAG, "mDNS initialized successfully");
 
+    table_mutex = xSemaphoreCreateMutex();
+    periodic_timer = xTimerCreate("cc_discovery", pdMS_TO_TICKS(periodic_interval_ms), pdTRUE,
+                                  this, periodic_timer_callback);
+    sweep_timer = xTimerCreate("cc_sweep", pdMS_TO_TICKS(timeout_ms), pdFALSE, this, sweep_timer_callback);
+    if (!table_mutex || !periodic_timer || !sweep_timer) {
+        ESP_LOGE(TAG, "Failed to create discovery timer or table mutex");
+        if (periodic_timer) xTimerDelete(periodic_timer, 0);
+        if (sweep_timer) xTimerDelete(sweep_timer, 0);
+        if (table_mutex) vSemaphoreDelete(table_mutex);
+        periodic_timer = nullptr;
+        sweep_timer = nullptr;
+        table_mutex = nullptr;
+        mdns_free();
+        return false;
+    }
+
+    // Known speakers are listed straight away, before any mDNS traffic
+    load_persisted_devices();
+
     initialized = true;
+
+    // Until a leader is heard this unit discovers on its own
+    if (peers && !peers->start(this)) {
+        ESP_LOGW(TAG, "Cooperative discovery not started");
+    }
     ESP_LOGI(TAG, "ChromecastDiscovery initialized successfully");
     return true;
 }
@@ -54,14 +98,35 @@ void ChromecastDiscovery::deinitialize() {
 
     ESP_LOGI(TAG, "Deinitializing ChromecastDiscovery");
 
+    if (peers) {
+        peers->stop();
+    }
     stop_periodic_discovery();
+    stop_continuous_browse();
+    for (DiscoveryBackend* backend : backends) {
+        backend->stop();
+    }
 
     if (periodic_timer) {
         xTimerDelete(periodic_timer, 0);
         periodic_timer = nullptr;
     }
+    if (sweep_timer) {
+        xTimerDelete(sweep_timer, 0);
+        sweep_timer = nullptr;
+    }
 
+    save_persisted_devices();
+    if (table_mutex) {
+        vSemaphoreDelete(table_mutex);
+        table_mutex = nullptr;
+    }
+    device_table.clear();
+
+    // mdns_free() takes the searches still running with it
+    reap_searches();
     mdns_free();
+    abandoned_count = 0;
     initialized = false;
     ESP_LOGI(TAG, "ChromecastDiscovery deinitialized");
 }
@@ -77,7 +142,177 @@ bool ChromecastDiscovery::discover_devices_sync(std::vector<DeviceInfo>& devices
         return false;
     }
 
-    // Check if WiFi is connected
+    if (!wifi_connected()) {
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Starting synchronous device discovery...");
+    if (!skip_active_check) {
+        discovery_active = true;
+    }
+
+    std::vector<DeviceChange> changes;
+    bool result = run_query(changes);
+    if (!skip_active_check) {
+        discovery_active = false;
+    }
+    if (!result) {
+        return false;
+    }
+
+    save_persisted_devices();
+    publish_changes(changes);
+
+    // Callbacks run on the calling task in sync mode
+    dispatch_changes(changes);
+
+    get_cached_devices(devices);
+    ESP_LOGI(TAG, "Discovery completed, %d devices known (%d changes)", devices.size(), changes.size());
+
+    // Call discovery callback if set
+    if (discovery_callback) {
+        discovery_callback(devices);
+    }
+
+    return true;
+}
+
+void ChromecastDiscovery::merge_results(mdns_result_t* results, std::vector<DeviceChange>& changes) {
+    // A device answering on several interfaces or address families merges into one record
+    std::vector<Resolution> pending;
+    for (mdns_result_t* current = results; current; current = current->next) {
+        ChromecastDeviceTable::Answer answer;
+        if (!parse_answer(current, answer)) {
+            continue;
+        }
+
+        bool has_srv = current->hostname && current->port;
+        bool has_txt = current->txt_count > 0;
+        if ((has_srv && has_txt && answer.ipv4) || pending.size() >= MAX_PARALLEL_RESOLVE) {
+            ESP_LOGD(TAG, "Answer from %s (ttl %u s)", answer.instance_name, current->ttl);
+            merge_device(answer, changes);
+            continue;
+        }
+
+        // Ask for the missing records now instead of waiting for the next sweep
+        Resolution res = {};
+        res.ptr = current;
+        if (!has_srv) {
+            res.srv_search = mdns_query_async_new(current->instance_name, CHROMECAST_SERVICE, CHROMECAST_PROTOCOL,
+                                                  MDNS_TYPE_SRV, RESOLVE_TIMEOUT_MS, 1, nullptr);
+        }
+        if (!has_txt) {
+            res.txt_search = mdns_query_async_new(current->instance_name, CHROMECAST_SERVICE, CHROMECAST_PROTOCOL,
+                                                  MDNS_TYPE_TXT, RESOLVE_TIMEOUT_MS, 1, nullptr);
+        }
+        if (has_srv && !answer.ipv4) {
+            res.a_search = mdns_query_async_new(current->hostname, nullptr, nullptr,
+                                                MDNS_TYPE_A, RESOLVE_TIMEOUT_MS, 1, nullptr);
+        }
+        pending.push_back(res);
+    }
+
+    if (!pending.empty()) {
+        resolve_incomplete(pending, changes);
+    }
+}
+
+mdns_result_t* ChromecastDiscovery::collect_search(mdns_search_once_t* search) {
+    if (!search) {
+        return nullptr;
+    }
+
+    // The search ends on its own timeout, so this only waits for the slowest one
+    mdns_result_t* results = nullptr;
+    if (!mdns_query_async_get_results(search, RESOLVE_TIMEOUT_MS * 2, &results, nullptr)) {
+        ESP_LOGW(TAG, "Follow-up mDNS query did not finish");
+        abandon_search(search);
+        return nullptr;
+    }
+    mdns_query_async_delete(search);
+    return results;
+}
+
+// For a search whose results were never taken: frees it with whatever it
+// found, or, still running, keeps it for reap_searches()
+void ChromecastDiscovery::abandon_search(mdns_search_once_t* search) {
+    mdns_result_t* results = nullptr;
+    if (mdns_query_async_get_results(search, 0, &results, nullptr)) {
+        if (results) {
+            mdns_query_results_free(results);
+        }
+        mdns_query_async_delete(search);
+        return;
+    }
+
+    taskENTER_CRITICAL(&abandoned_lock);
+    bool kept = abandoned_count < MAX_ABANDONED_SEARCHES;
+    if (kept) {
+        abandoned_searches[abandoned_count++] = search;
+    }
+    taskEXIT_CRITICAL(&abandoned_lock);
+    if (!kept) {
+        ESP_LOGE(TAG, "Too many unfinished mDNS searches, one is leaked");
+    }
+}
+
+void ChromecastDiscovery::reap_searches() {
+    mdns_search_once_t* searches[MAX_ABANDONED_SEARCHES];
+    taskENTER_CRITICAL(&abandoned_lock);
+    size_t count = abandoned_count;
+    memcpy(searches, abandoned_searches, count * sizeof(searches[0]));
+    abandoned_count = 0;
+    taskEXIT_CRITICAL(&abandoned_lock);
+
+    for (size_t i = 0; i < count; i++) {
+        abandon_search(searches[i]);
+    }
+}
+
+void ChromecastDiscovery::resolve_incomplete(std::vector<Resolution>& pending, std::vector<DeviceChange>& changes) {
+    ESP_LOGD(TAG, "Resolving %d incomplete answers", pending.size());
+
+    // SRV answers name the host, which may still need an A query of its own
+    for (Resolution& res : pending) {
+        res.srv_result = collect_search(res.srv_search);
+        const mdns_result_t* srv = res.srv_result;
+        if (!res.a_search && srv && srv->hostname && !first_ipv4(srv->addr) && !first_ipv4(res.ptr->addr)) {
+            res.a_search = mdns_query_async_new(srv->hostname, nullptr, nullptr,
+                                                MDNS_TYPE_A, RESOLVE_TIMEOUT_MS, 1, nullptr);
+        }
+    }
+
+    for (Resolution& res : pending) {
+        res.txt_result = collect_search(res.txt_search);
+        res.a_result = collect_search(res.a_search);
+
+        ChromecastDeviceTable::Answer answer;
+        parse_answer(res.ptr, answer);
+        if (res.srv_result) {
+            if (res.srv_result->port) {
+                answer.port = res.srv_result->port;
+            }
+            if (!answer.ipv4) {
+                answer.ipv4 = first_ipv4(res.srv_result->addr);
+            }
+        }
+        if (res.txt_result) {
+            apply_txt(res.txt_result, answer);
+        }
+        if (!answer.ipv4 && res.a_result) {
+            answer.ipv4 = first_ipv4(res.a_result->addr);
+        }
+        merge_device(answer, changes);
+
+        for (mdns_result_t* result : {res.srv_result, res.txt_result, res.a_result}) {
+            if (result) {
+                mdns_query_results_free(result);
+            }
+        }
+    }
+}
+
+bool ChromecastDiscovery::wifi_connected() {
     esp_netif_t* netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
     if (netif) {
         esp_netif_ip_info_t ip_info;
@@ -89,13 +324,146 @@ bool ChromecastDiscovery::discover_devices_sync(std::vector<DeviceInfo>& devices
         ESP_LOGW(TAG, "WiFi interface not found, cannot perform mDNS discovery");
         return false;
     }
+    return true;
+}
 
-    ESP_LOGI(TAG, "Starting synchronous device discovery...");
-    if (!skip_active_check) {
-        discovery_active = true;
-        current_mode = SYNC_ONCE;
+void ChromecastDiscovery::start_backends() {
+    // Each reports on its own task while the mDNS sweep runs; one still busy sits this sweep out
+    for (DiscoveryBackend* backend : backends) {
+        if (!backend->start_search(timeout_ms, this)) {
+            ESP_LOGD(TAG, "%s search not started", backend->name());
+        }
     }
-    devices.clear();
+}
+
+void ChromecastDiscovery::backend_answer(const ChromecastDeviceTable::Answer& answer) {
+    // A speaker that also speaks Cast (many TVs, some soundbars) is listed once, as Cast
+    xSemaphoreTake(table_mutex, portMAX_DELAY);
+    int slot = device_table.find_by_ip(answer.ipv4, DeviceInfo::CAP_MULTIZONE_GROUP);
+    bool cast = slot >= 0 && device_table.record(slot).protocol == ChromecastDeviceTable::PROTOCOL_CAST;
+    xSemaphoreGive(table_mutex);
+    if (cast) {
+        return;
+    }
+
+    std::vector<DeviceChange> changes;
+    merge_device(answer, changes);
+    post_changes(changes);
+}
+
+bool ChromecastDiscovery::backend_knows(const char* instance_name) {
+    xSemaphoreTake(table_mutex, portMAX_DELAY);
+    int slot = device_table.find(nullptr, instance_name);
+    // The table names a record after its instance until a friendly name arrives
+    bool known = slot >= 0 && device_table.record(slot).name != device_table.record(slot).instance_name;
+    xSemaphoreGive(table_mutex);
+    return known;
+}
+
+void ChromecastDiscovery::peer_apply(const DiscoveryPeers::Record* records, size_t count) {
+    std::vector<DeviceChange> changes;
+    for (size_t i = 0; i < count; i++) {
+        const DiscoveryPeers::Record& r = records[i];
+        if (r.op == DiscoveryPeers::OP_REMOVE) {
+            remove_device(r.uuid, r.instance_name, changes);
+            continue;
+        }
+        if (r.protocol > ChromecastDeviceTable::PROTOCOL_UPNP) {
+            continue;
+        }
+        // Kept for as long as the leader's snapshots keep coming
+        ChromecastDeviceTable::Answer answer = {
+            r.uuid, r.name, r.instance_name, r.model,
+            r.ipv4, r.port, DiscoveryPeers::RECORD_TTL_MS,
+            true, r.capabilities, r.status,
+            static_cast<ChromecastDeviceTable::Protocol>(r.protocol)
+        };
+        merge_device(answer, changes);
+    }
+    post_changes(changes);
+}
+
+void ChromecastDiscovery::peer_snapshot(std::vector<DiscoveryPeers::Record>& records) {
+    // Probable records go out once the probe has confirmed them
+    xSemaphoreTake(table_mutex, portMAX_DELAY);
+    records.reserve(device_table.size());
+    for (int slot = 0; slot < (int)ChromecastDeviceTable::MAX_DEVICES; slot++) {
+        if (!device_table.in_use(slot) || device_table.record(slot).probable) {
+            continue;
+        }
+        const ChromecastDeviceTable::Record& r = device_table.record(slot);
+        DiscoveryPeers::Record record = {};
+        record.op = DiscoveryPeers::OP_UPSERT;
+        record.protocol = r.protocol;
+        record.port = r.port;
+        record.ipv4 = r.ipv4;
+        record.capabilities = r.capabilities;
+        strlcpy(record.uuid, device_table.str(r.uuid_text), sizeof(record.uuid));
+        strlcpy(record.name, device_table.str(r.name), sizeof(record.name));
+        strlcpy(record.instance_name, device_table.str(r.instance_name), sizeof(record.instance_name));
+        strlcpy(record.model, device_table.str(r.model), sizeof(record.model));
+        strlcpy(record.status, device_table.str(r.status), sizeof(record.status));
+        records.push_back(record);
+    }
+    xSemaphoreGive(table_mutex);
+}
+
+void ChromecastDiscovery::publish_changes(const std::vector<DeviceChange>& changes) {
+    if (!peers || !peers->leading() || changes.empty()) {
+        return;
+    }
+
+    std::vector<DiscoveryPeers::Record> records;
+    records.reserve(changes.size());
+    for (const DeviceChange& change : changes) {
+        const DeviceInfo& device = change.device;
+        bool removed = change.event == DEVICE_REMOVED;
+        if (device.probable && !removed) {
+            continue;
+        }
+        DiscoveryPeers::Record record = {};
+        record.op = removed ? DiscoveryPeers::OP_REMOVE : DiscoveryPeers::OP_UPSERT;
+        record.protocol = device.protocol;
+        record.port = device.port;
+        record.ipv4 = esp_ip4addr_aton(device.ip_address.c_str());
+        record.capabilities = device.capabilities;
+        strlcpy(record.uuid, device.uuid.c_str(), sizeof(record.uuid));
+        strlcpy(record.name, device.name.c_str(), sizeof(record.name));
+        strlcpy(record.instance_name, device.instance_name.c_str(), sizeof(record.instance_name));
+        strlcpy(record.model, device.model.c_str(), sizeof(record.model));
+        strlcpy(record.status, device.status.c_str(), sizeof(record.status));
+        records.push_back(record);
+    }
+    peers->publish(records.data(), records.size());
+}
+
+void ChromecastDiscovery::peer_role(bool now_following) {
+    if (!now_following && xTimerPendFunctionCall(take_over, this, 0, 0) != pdPASS) {
+        ESP_LOGW(TAG, "Failed to queue discovery take-over");
+    }
+}
+
+bool ChromecastDiscovery::peer_watching() {
+    return interest == INTEREST_VISIBLE;
+}
+
+void ChromecastDiscovery::take_over(void* parameter, uint32_t unused) {
+    ChromecastDiscovery* discovery = static_cast<ChromecastDiscovery*>(parameter);
+    if (!discovery->initialized || discovery->interest == INTEREST_IDLE ||
+        (discovery->current_mode != PERIODIC && discovery->current_mode != CONTINUOUS_BROWSE)) {
+        return;
+    }
+
+    // The leader went quiet or this unit was elected: sweep now rather than
+    // wait out a backoff the leader's sweeps never reset
+    ESP_LOGI(TAG, "Discovering for this unit again");
+    discovery->last_sweep = xTaskGetTickCount() - pdMS_TO_TICKS(discovery->sweep_interval_ms);
+    periodic_timer_callback(discovery->periodic_timer);
+}
+
+bool ChromecastDiscovery::run_query(std::vector<DeviceChange>& changes) {
+    reap_searches();
+    start_backends();
 
     // Query for Chromecast devices using mDNS
     mdns_result_t* results = nullptr;
@@ -103,50 +471,253 @@ bool ChromecastDiscovery::discover_devices_sync(std::vector<DeviceInfo>& devices
 
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "mDNS query failed: %s", esp_err_to_name(err));
-        if (!skip_active_check) {
-            discovery_active = false;
-        }
         return false;
     }
 
-    if (!results) {
-        ESP_LOGW(TAG, "No Chromecast devices found");
-        if (!skip_active_check) {
-            discovery_active = false;
+    // Devices that did not answer this sweep stay until their records expire
+    merge_results(results, changes);
+
+    if (results) {
+        mdns_query_results_free(results);
+    }
+    expire_devices(changes);
+    return true;
+}
+
+void ChromecastDiscovery::record_to_info(int slot, DeviceInfo& device) const {
+    const ChromecastDeviceTable::Record& r = device_table.record(slot);
+    char ip_str[16];
+    esp_ip4_addr_t addr = { .addr = r.ipv4 };
+    esp_ip4addr_ntoa(&addr, ip_str, sizeof(ip_str));
+
+    device.name = device_table.str(r.name);
+    device.ip_address = ip_str;
+    device.port = r.port;
+    device.instance_name = device_table.str(r.instance_name);
+    device.model = device_table.str(r.model);
+    device.uuid = device_table.str(r.uuid_text);
+    device.probable = r.probable;
+    device.capabilities = r.capabilities;
+    device.status = device_table.str(r.status);
+    device.protocol = r.protocol;
+
+    // A group resolves to whichever member currently leads it
+    device.leader_uuid.clear();
+    if (r.capabilities & DeviceInfo::CAP_MULTIZONE_GROUP) {
+        int leader = device_table.find_by_ip(r.ipv4, DeviceInfo::CAP_MULTIZONE_GROUP);
+        if (leader >= 0) {
+            device.leader_uuid = device_table.str(device_table.record(leader).uuid_text);
         }
-        return true; // Not an error, just no devices found
     }
+}
 
-    // Process results
-    mdns_result_t* current = results;
-    while (current) {
-        DeviceInfo device;
-        if (parse_device_info(current, device)) {
-            devices.push_back(device);
-            ESP_LOGI(TAG, "Found device: %s at %s:%d",
-                    device.name.c_str(), device.ip_address.c_str(), device.port);
+void ChromecastDiscovery::merge_device(const ChromecastDeviceTable::Answer& answer, std::vector<DeviceChange>& changes) {
+    xSemaphoreTake(table_mutex, portMAX_DELAY);
+
+    // DeviceInfo strings are only built when the listener has something to hear
+    int slot;
+    ChromecastDeviceTable::Change change = device_table.merge(answer, xTaskGetTickCount(), slot);
+    if (change != ChromecastDeviceTable::CHANGE_NONE) {
+        // Status text changes with every app launch and is not worth a flash write
+        if (change != ChromecastDeviceTable::CHANGE_STATUS) {
+            table_dirty = true;
+        }
+        changes.push_back({change == ChromecastDeviceTable::CHANGE_ADDED ? DEVICE_ADDED : DEVICE_UPDATED, DeviceInfo()});
+        record_to_info(slot, changes.back().device);
+    }
+
+    xSemaphoreGive(table_mutex);
+}
+
+void ChromecastDiscovery::expire_devices(std::vector<DeviceChange>& changes) {
+    xSemaphoreTake(table_mutex, portMAX_DELAY);
+
+    TickType_t now = xTaskGetTickCount();
+    for (int slot = device_table.next_expired(now); slot >= 0; slot = device_table.next_expired(now)) {
+        changes.push_back({DEVICE_REMOVED, DeviceInfo()});
+        record_to_info(slot, changes.back().device);
+        ESP_LOGI(TAG, "Device %s expired", changes.back().device.name.c_str());
+        device_table.remove(slot);
+        table_dirty = true;
+    }
 
-            // Call device found callback if set
+    xSemaphoreGive(table_mutex);
+}
+
+void ChromecastDiscovery::remove_device(const char* uuid, const char* instance_name, std::vector<DeviceChange>& changes) {
+    xSemaphoreTake(table_mutex, portMAX_DELAY);
+    int slot = device_table.find(uuid, instance_name);
+    if (slot >= 0) {
+        changes.push_back({DEVICE_REMOVED, DeviceInfo()});
+        record_to_info(slot, changes.back().device);
+        ESP_LOGI(TAG, "Device %s said goodbye", changes.back().device.name.c_str());
+        device_table.remove(slot);
+        table_dirty = true;
+    }
+    xSemaphoreGive(table_mutex);
+}
+
+void ChromecastDiscovery::start_refresh() {
+    // Names are copied out: the string pool can be compacted once the mutex is given back
+    std::vector<std::string> names;
+    xSemaphoreTake(table_mutex, portMAX_DELAY);
+    TickType_t now = xTaskGetTickCount();
+    for (int slot = 0; slot < (int)ChromecastDeviceTable::MAX_DEVICES && names.size() < MAX_PARALLEL_RESOLVE; slot++) {
+        // Renderers from other backends are refreshed by their own searches
+        if (!device_table.refresh_due(slot, now) || device_table.record(slot).protocol != ChromecastDeviceTable::PROTOCOL_CAST) {
+            continue;
+        }
+        const char* instance_name = device_table.str(device_table.record(slot).instance_name);
+        if (*instance_name) {
+            names.emplace_back(instance_name);
+        }
+    }
+    xSemaphoreGive(table_mutex);
+
+    // Anything but PTR goes out as a QU question: only that device answers,
+    // and to us rather than to every listener on the network
+    for (const std::string& name : names) {
+        for (uint16_t type : {MDNS_TYPE_SRV, MDNS_TYPE_TXT}) {
+            mdns_search_once_t* search = mdns_query_async_new(name.c_str(), CHROMECAST_SERVICE, CHROMECAST_PROTOCOL,
+                                                              type, RESOLVE_TIMEOUT_MS, 1, nullptr);
+            if (search) {
+                refresh_searches.push_back(search);
+            }
+        }
+    }
+    if (!names.empty()) {
+        ESP_LOGD(TAG, "Refreshing %d known devices", names.size());
+    }
+}
+
+void ChromecastDiscovery::collect_refresh(std::vector<DeviceChange>& changes) {
+    // A SRV or TXT answer alone only fills in what it carries; one still running waits for the next tick
+    size_t running = 0;
+    for (mdns_search_once_t* search : refresh_searches) {
+        mdns_result_t* results = nullptr;
+        if (!mdns_query_async_get_results(search, 0, &results, nullptr)) {
+            refresh_searches[running++] = search;
+            continue;
+        }
+        for (mdns_result_t* current = results; current; current = current->next) {
+            ChromecastDeviceTable::Answer answer;
+            if (parse_answer(current, answer)) {
+                merge_device(answer, changes);
+            }
+        }
+        if (results) {
+            mdns_query_results_free(results);
+        }
+        mdns_query_async_delete(search);
+    }
+    refresh_searches.resize(running);
+}
+
+void ChromecastDiscovery::free_refresh() {
+    // A running search can only be freed once it has finished
+    for (mdns_search_once_t* search : refresh_searches) {
+        mdns_result_t* results = nullptr;
+        if (mdns_query_async_get_results(search, RESOLVE_TIMEOUT_MS, &results, nullptr)) {
+            if (results) {
+                mdns_query_results_free(results);
+            }
+            mdns_query_async_delete(search);
+        } else {
+            abandon_search(search);
+        }
+    }
+    refresh_searches.clear();
+}
+
+void ChromecastDiscovery::suspect_lapsed() {
+    // Nothing was refreshed while paused: records that ran out meanwhile go
+    // back to probable for the TCP probe to settle, instead of disappearing
+    // from the list and coming back with the next answer
+    std::vector<DeviceChange> changes;
+    xSemaphoreTake(table_mutex, portMAX_DELAY);
+    TickType_t now = xTaskGetTickCount();
+    for (int slot = 0; slot < (int)ChromecastDeviceTable::MAX_DEVICES; slot++) {
+        if (device_table.expired(slot, now)) {
+            device_table.set_probable(slot, now, PROBABLE_TTL_S * 1000);
+            changes.push_back({DEVICE_UPDATED, DeviceInfo()});
+            record_to_info(slot, changes.back().device);
+        }
+    }
+    xSemaphoreGive(table_mutex);
+    post_changes(changes);
+}
+
+void ChromecastDiscovery::dispatch_changes(const std::vector<DeviceChange>& changes) {
+    for (const auto& change : changes) {
+        if (change.event == DEVICE_ADDED) {
+            ESP_LOGI(TAG, "Found device: %s at %s:%d",
+                     change.device.name.c_str(), change.device.ip_address.c_str(), change.device.port);
             if (device_found_callback) {
-                device_found_callback(device);
+                device_found_callback(change.device);
             }
         }
-        current = current->next;
+        if (device_event_callback) {
+            device_event_callback(change.event, change.device);
+        }
     }
+}
 
-    mdns_query_results_free(results);
-    if (!skip_active_check) {
-        discovery_active = false;
+size_t ChromecastDiscovery::get_cached_devices(std::vector<DeviceInfo>& devices, uint32_t* epoch) {
+    devices.clear();
+    if (!table_mutex) {
+        return 0;
     }
 
-    ESP_LOGI(TAG, "Discovery completed, found %d devices", devices.size());
+    xSemaphoreTake(table_mutex, portMAX_DELAY);
+    devices.resize(device_table.size());
+    size_t count = 0;
+    for (int slot = 0; slot < (int)ChromecastDeviceTable::MAX_DEVICES; slot++) {
+        if (device_table.in_use(slot)) {
+            record_to_info(slot, devices[count++]);
+        }
+    }
+    if (epoch) {
+        *epoch = device_table.epoch();
+    }
+    xSemaphoreGive(table_mutex);
+    return devices.size();
+}
 
-    // Call discovery callback if set
-    if (discovery_callback) {
-        discovery_callback(devices);
+uint32_t ChromecastDiscovery::get_table_epoch() {
+    if (!table_mutex) {
+        return 0;
     }
 
-    return true;
+    xSemaphoreTake(table_mutex, portMAX_DELAY);
+    uint32_t epoch = device_table.epoch();
+    xSemaphoreGive(table_mutex);
+    return epoch;
+}
+
+bool ChromecastDiscovery::find_cached_device(const char* key, DeviceInfo& device) {
+    if (!table_mutex || !key) {
+        return false;
+    }
+
+    esp_ip4_addr_t addr = { .addr = esp_ip4addr_aton(key) };
+
+    xSemaphoreTake(table_mutex, portMAX_DELAY);
+    int slot = device_table.find_by_uuid(key);
+    if (slot < 0) {
+        slot = device_table.find_by_name(key);
+    }
+    if (slot < 0) {
+        // Prefer the speaker over groups it leads on the same address
+        slot = device_table.find_by_ip(addr.addr, DeviceInfo::CAP_MULTIZONE_GROUP);
+    }
+    if (slot < 0) {
+        slot = device_table.find_by_ip(addr.addr);
+    }
+    if (slot >= 0) {
+        record_to_info(slot, device);
+    }
+    xSemaphoreGive(table_mutex);
+    return slot >= 0;
 }
 
 bool ChromecastDiscovery::discover_devices_async() {
@@ -160,90 +731,128 @@ bool ChromecastDiscovery::discover_devices_async() {
         return false;
     }
 
-    // Check if WiFi is connected
-    esp_netif_t* netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
-    if (netif) {
-        esp_netif_ip_info_t ip_info;
-        if (esp_netif_get_ip_info(netif, &ip_info) != ESP_OK || ip_info.ip.addr == 0) {
-            ESP_LOGW(TAG, "WiFi not connected, cannot perform mDNS discovery");
-            return false;
-        }
-    } else {
-        ESP_LOGW(TAG, "WiFi interface not found, cannot perform mDNS discovery");
+    if (!wifi_connected()) {
         return false;
     }
 
     ESP_LOGI(TAG, "Starting asynchronous device discovery...");
     discovery_active = true;
-    current_mode = ASYNC_ONCE;
 
-    // Create a task to run discovery asynchronously
-    BaseType_t task_created = xTaskCreate(
+    // While browsing, answers to a PTR query reach browse_notify one device at a
+    // time; the sweep only sends the query and reports when it is over
+    if (current_mode == CONTINUOUS_BROWSE) {
+        if (xTimerPendFunctionCall(start_sweep, this, 0, 0) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to queue browse sweep");
+            discovery_active = false;
+            return false;
+        }
+        return true;
+    }
+
+    if (current_mode == SYNC_ONCE) {
+        current_mode = ASYNC_ONCE;
+    }
+
+    if (!start_discovery_task()) {
+        discovery_active = false;
+        if (current_mode == ASYNC_ONCE) {
+            current_mode = SYNC_ONCE;
+        }
+        return false;
+    }
+
+    return true;
+}
+
+bool ChromecastDiscovery::start_discovery_task() {
+    // Create a task to run discovery asynchronously; internal stack, it
+    // saves the device table to NVS
+    bool task_created = mem_task_create(
         async_discovery_task,           // Task function
         "chromecast_discovery",         // Task name
         4096,                          // Stack size (4KB)
         this,                          // Task parameter (this instance)
-        5,                             // Priority
-        nullptr                        // Task handle (not needed)
+        TASK_PLAN_DISCOVERY_PRIORITY,  // Priority
+        nullptr,                       // Task handle (not needed)
+        TASK_PLAN_NETWORK_CORE,
+        MEM_TASK_STACK_INTERNAL
     );
 
-    if (task_created != pdPASS) {
+    if (!task_created) {
         ESP_LOGE(TAG, "Failed to create async discovery task");
-        discovery_active = false;
-        current_mode = SYNC_ONCE;
-        return false;
     }
-
-    return true;
+    return task_created;
 }
 
-bool ChromecastDiscovery::parse_device_info(const mdns_result_t* result, DeviceInfo& device) {
-    if (!result || !result->addr) {
+bool ChromecastDiscovery::parse_answer(const mdns_result_t* result, ChromecastDeviceTable::Answer& answer) {
+    if (!result || !result->instance_name) {
         return false;
     }
 
-    // Extract IP address
-    if (result->addr->addr.type == ESP_IPADDR_TYPE_V4) {
-        char ip_str[16];
-        esp_ip4addr_ntoa(&result->addr->addr.u_addr.ip4, ip_str, sizeof(ip_str));
-        device.ip_address = std::string(ip_str);
-    } else {
-        ESP_LOGW(TAG, "IPv6 addresses not supported yet");
-        return false;
-    }
-    device.port = result->port;
+    // Use the first IPv4 address; IPv6-only answers still refresh a known device's TTL
+    answer = {};
+    answer.ipv4 = first_ipv4(result->addr);
 
-    // Extract instance name
-    if (result->instance_name) {
-        device.instance_name = std::string(result->instance_name);
-        device.name = device.instance_name; // Default name to instance name
-    }
+    // Point straight at the mdns result; the table copies what it keeps
+    answer.instance_name = result->instance_name;
+    answer.port = result->port;
+    answer.ttl_ms = (result->ttl ? result->ttl : DEFAULT_RECORD_TTL_S) * 1000;
+    apply_txt(result, answer);
+    return true;
+}
 
-    // Extract additional info from TXT records
-    device.model = extract_txt_value(result, "md");
-    device.uuid = extract_txt_value(result, "id");
+uint32_t ChromecastDiscovery::first_ipv4(const mdns_ip_addr_t* addr) {
+    for (; addr; addr = addr->next) {
+        if (addr->addr.type == ESP_IPADDR_TYPE_V4 && addr->addr.u_addr.ip4.addr != 0) {
+            return addr->addr.u_addr.ip4.addr;
+        }
+    }
+    return 0;
+}
 
-    // Try to get friendly name from TXT records
-    std::string friendly_name = extract_txt_value(result, "fn");
-    if (!friendly_name.empty()) {
-        device.name = friendly_name;
+void ChromecastDiscovery::apply_txt(const mdns_result_t* result, ChromecastDeviceTable::Answer& answer) {
+    if (!result || result->txt_count == 0) {
+        return;     // Leave status as nullptr: no TXT is not the same as an empty status
     }
 
-    return device.is_valid();
+    TxtFields txt;
+    parse_txt(result, txt);
+    answer.uuid = txt.id;
+    answer.name = txt.fn;
+    answer.model = txt.md;
+    answer.status = txt.rs ? txt.rs : "";
+    answer.has_capabilities = txt.has_ca;
+    answer.capabilities = txt.ca;
 }
 
-std::string ChromecastDiscovery::extract_txt_value(const mdns_result_t* result, const char* key) {
-    if (!result || !result->txt || !key || result->txt_count == 0) {
-        return "";
+void ChromecastDiscovery::parse_txt(const mdns_result_t* result, TxtFields& txt) {
+    txt = {};
+    if (!result || !result->txt) {
+        return;
     }
 
-    // Iterate through TXT records using array indexing instead of linked list
+    // One pass over the items; every Cast key is two characters long
     for (size_t i = 0; i < result->txt_count; i++) {
-        if (result->txt[i].key && strcmp(result->txt[i].key, key) == 0 && result->txt[i].value) {
-            return std::string(result->txt[i].value);
+        const char* key = result->txt[i].key;
+        const char* value = result->txt[i].value;
+        if (!key || !value || key[0] == '\0' || key[1] == '\0' || key[2] != '\0') {
+            continue;
+        }
+
+        switch ((key[0] << 8) | key[1]) {
+            case ('i' << 8) | 'd': txt.id = value; break;
+            case ('f' << 8) | 'n': txt.fn = value; break;
+            case ('m' << 8) | 'd': txt.md = value; break;
+            case ('r' << 8) | 's': txt.rs = value; break;
+            case ('b' << 8) | 's': txt.bs = value; break;
+            case ('c' << 8) | 'a':
+                txt.ca = strtoul(value, nullptr, 10);
+                txt.has_ca = true;
+                break;
+            default:
+                break;
         }
     }
-    return "";
 }
 
 bool ChromecastDiscovery::start_periodic_discovery(uint32_t interval_ms) {
@@ -256,17 +865,14 @@ bool ChromecastDiscovery::start_periodic_discovery(uint32_t interval_ms) {
         ESP_LOGW(TAG, "Periodic discovery already running");
         return true;
     }
+    stop_continuous_browse();
 
     ESP_LOGI(TAG, "Starting periodic discovery with interval %d ms", interval_ms);
 
     periodic_interval_ms = interval_ms;
     current_mode = PERIODIC;
 
-    // Update timer period
-    xTimerChangePeriod(periodic_timer, pdMS_TO_TICKS(periodic_interval_ms), 0);
-
-    // Start the timer
-    if (xTimerStart(periodic_timer, 0) != pdPASS) {
+    if (!start_pacing()) {
         ESP_LOGE(TAG, "Failed to start periodic timer");
         current_mode = SYNC_ONCE;
         return false;
@@ -279,57 +885,168 @@ void ChromecastDiscovery::stop_periodic_discovery() {
     if (current_mode == PERIODIC && periodic_timer) {
         ESP_LOGI(TAG, "Stopping periodic discovery");
         xTimerStop(periodic_timer, 0);
+        free_refresh();
         current_mode = SYNC_ONCE;
     }
 }
 
+void ChromecastDiscovery::set_interest(Interest interest) {
+    if (xTimerPendFunctionCall(apply_interest, this, interest, 0) != pdPASS) {
+        ESP_LOGW(TAG, "Failed to queue discovery interest change");
+    }
+}
+
+bool ChromecastDiscovery::start_pacing() {
+    // The first sweep comes one periodic interval after the start, as before
+    sweep_interval_ms = periodic_interval_ms;
+    last_sweep = xTaskGetTickCount();
+    if (interest == INTEREST_IDLE) {
+        return true;    // apply_interest() starts the timer when the screen wakes
+    }
+    xTimerChangePeriod(periodic_timer, pdMS_TO_TICKS(tick_period_ms()), 0);
+    return xTimerStart(periodic_timer, 0) == pdPASS;
+}
+
+uint32_t ChromecastDiscovery::tick_period_ms() const {
+    // Between sweeps a tick expires and refreshes records, so it stays well inside their TTL
+    return interest == INTEREST_VISIBLE ? FAST_SWEEP_INTERVAL_MS : periodic_interval_ms;
+}
+
+bool ChromecastDiscovery::sweep_due() const {
+    // A follower watching its list is served by this unit's sweeps
+    return interest == INTEREST_VISIBLE || (peers && peers->remote_watching()) ||
+           xTaskGetTickCount() - last_sweep >= pdMS_TO_TICKS(sweep_interval_ms);
+}
+
+void ChromecastDiscovery::apply_interest(void* parameter, uint32_t value) {
+    ChromecastDiscovery* discovery = static_cast<ChromecastDiscovery*>(parameter);
+    Interest previous = discovery->interest;
+    discovery->interest = static_cast<Interest>(value);
+    if (discovery->interest == previous || !discovery->initialized ||
+        (discovery->current_mode != PERIODIC && discovery->current_mode != CONTINUOUS_BROWSE)) {
+        return;
+    }
+
+    if (discovery->interest == INTEREST_IDLE) {
+        ESP_LOGI(TAG, "Screen idle, discovery paused");
+        xTimerStop(discovery->periodic_timer, 0);
+        return;
+    }
+    if (previous == INTEREST_IDLE) {
+        discovery->suspect_lapsed();
+    }
+    xTimerChangePeriod(discovery->periodic_timer, pdMS_TO_TICKS(discovery->tick_period_ms()), 0);
+
+    // The list just came on screen, or the table went unrefreshed: tick now, not a period from now
+    if (discovery->interest == INTEREST_VISIBLE || previous == INTEREST_IDLE) {
+        periodic_timer_callback(discovery->periodic_timer);
+    }
+}
+
+void ChromecastDiscovery::sweep_finished(void* parameter, uint32_t unused) {
+    ChromecastDiscovery* discovery = static_cast<ChromecastDiscovery*>(parameter);
+
+    xSemaphoreTake(discovery->table_mutex, portMAX_DELAY);
+    uint32_t set_epoch = discovery->device_table.set_epoch();
+    xSemaphoreGive(discovery->table_mutex);
+
+    // Each sweep that finds the set as the last one left it doubles the wait for
+    // the next; any change, seen by a sweep or announced in between, resets it
+    if (set_epoch != discovery->sweep_set_epoch || discovery->interest == INTEREST_VISIBLE ||
+        (discovery->peers && discovery->peers->remote_watching())) {
+        discovery->sweep_interval_ms = discovery->periodic_interval_ms;
+    } else {
+        discovery->sweep_interval_ms = std::min(discovery->sweep_interval_ms * 2, MAX_SWEEP_INTERVAL_MS);
+    }
+    discovery->sweep_set_epoch = set_epoch;
+    discovery->last_sweep = xTaskGetTickCount();
+    ESP_LOGD(TAG, "Next background sweep in %u s", discovery->sweep_interval_ms / 1000);
+}
+
 void ChromecastDiscovery::periodic_timer_callback(TimerHandle_t timer) {
     ChromecastDiscovery* discovery = static_cast<ChromecastDiscovery*>(pvTimerGetTimerID(timer));
+    if (!discovery || !discovery->initialized) {
+        return;
+    }
 
-    if (discovery && discovery->initialized && discovery->current_mode == PERIODIC) {
-        ESP_LOGD(TAG, "Periodic discovery triggered");
+    // Devices restored from NVS are probed once WiFi is up, whatever the mode
+    discovery->start_probe_task();
 
-        std::vector<DeviceInfo> devices;
-        discovery->discover_devices_sync(devices);
+    if (discovery->current_mode == PERIODIC || discovery->current_mode == CONTINUOUS_BROWSE) {
+        discovery->maintenance();
     }
 }
 
-// Structure to pass data to the main thread callback
-struct AsyncCallbackData {
-    ChromecastDiscovery* discovery;
-    std::vector<ChromecastDiscovery::DeviceInfo>* devices;
-    bool success;
-
-    AsyncCallbackData(ChromecastDiscovery* disc, std::vector<ChromecastDiscovery::DeviceInfo>* devs, bool succ)
-        : discovery(disc), devices(devs), success(succ) {}
-};
+void ChromecastDiscovery::maintenance() {
+    // Answers to the refreshes sent last tick, then whatever they did not save
+    std::vector<DeviceChange> changes;
+    collect_refresh(changes);
+    reap_searches();
+    expire_devices(changes);
+    post_changes(changes);
+    save_persisted_devices();
+
+    // A follower's table comes from the leader; it only expires what the leader stops sending
+    if (discovery_active || following() || !wifi_connected()) {
+        return;
+    }
 
-// Callback function that runs in the main LVGL thread
-void ChromecastDiscovery::async_callback_main_thread(void* user_data) {
-    AsyncCallbackData* data = static_cast<AsyncCallbackData*>(user_data);
+    // Sweeps find new devices; known ones are asked one by one in between
+    if (sweep_due()) {
+        ESP_LOGD(TAG, "Sweep for Chromecast devices");
+        discovery_active = true;
+        if (current_mode == CONTINUOUS_BROWSE) {
+            start_sweep(this, 0);
+        } else if (!start_discovery_task()) {
+            // Never block the timer service task on a multi-second mDNS query
+            discovery_active = false;
+        }
+    } else if (refresh_searches.empty()) {
+        start_refresh();
+    }
+}
 
-    if (!data || !data->discovery) {
-        ESP_LOGE(TAG, "Invalid callback data");
-        delete data;
+void ChromecastDiscovery::start_sweep(void* parameter, uint32_t unused) {
+    ChromecastDiscovery* discovery = static_cast<ChromecastDiscovery*>(parameter);
+    if (discovery->current_mode != CONTINUOUS_BROWSE) {
+        discovery->discovery_active = false;
         return;
     }
 
-    ChromecastDiscovery* discovery = data->discovery;
+    discovery->start_backends();
+    discovery->sweep_search = mdns_query_async_new(nullptr, CHROMECAST_SERVICE, CHROMECAST_PROTOCOL,
+                                                   MDNS_TYPE_PTR, discovery->timeout_ms,
+                                                   discovery->max_results, nullptr);
+    if (!discovery->sweep_search) {
+        ESP_LOGE(TAG, "Failed to start browse sweep");
+        discovery->discovery_active = false;
+        return;
+    }
+    xTimerChangePeriod(discovery->sweep_timer, pdMS_TO_TICKS(discovery->timeout_ms + SWEEP_POLL_MS), 0);
+}
 
-    if (data->success && data->devices) {
-        ESP_LOGI(TAG, "Triggering callbacks from main thread for %d devices", data->devices->size());
+void ChromecastDiscovery::sweep_timer_callback(TimerHandle_t timer) {
+    ChromecastDiscovery* discovery = static_cast<ChromecastDiscovery*>(pvTimerGetTimerID(timer));
 
-        // Call discovery callback if set (this will update the GUI)
-        if (discovery->discovery_callback) {
-            discovery->discovery_callback(*data->devices);
+    // Answers went to browse_notify; the results are only freed
+    if (discovery->sweep_search) {
+        mdns_result_t* results = nullptr;
+        if (!mdns_query_async_get_results(discovery->sweep_search, 0, &results, nullptr)) {
+            xTimerChangePeriod(timer, pdMS_TO_TICKS(SWEEP_POLL_MS), 0);
+            return;
         }
-    } else {
-        ESP_LOGE(TAG, "Discovery failed, not triggering callbacks");
+        mdns_query_results_free(results);
+        mdns_query_async_delete(discovery->sweep_search);
+        discovery->sweep_search = nullptr;
     }
 
-    // Cleanup
-    delete data->devices;
-    delete data;
+    std::vector<DeviceChange> changes;
+    discovery->expire_devices(changes);
+    discovery->save_persisted_devices();
+    sweep_finished(discovery, 0);
+    discovery->discovery_active = false;
+    ESP_LOGI(TAG, "Browse sweep completed");
+    discovery->post_changes(changes, true);
 }
 
 void ChromecastDiscovery::async_discovery_task(void* parameter) {
@@ -340,53 +1057,375 @@ void ChromecastDiscovery::async_discovery_task(void* parameter) {
         if (discovery) {
             discovery->discovery_active = false;
         }
-        vTaskDelete(nullptr);
+        mem_task_delete(nullptr);
         return;
     }
 
     ESP_LOGI(TAG, "Async discovery task started");
 
-    // Perform the actual discovery
-    std::vector<ChromecastDiscovery::DeviceInfo>* devices = new std::vector<ChromecastDiscovery::DeviceInfo>();
-    bool result = false;
-
-    // Temporarily call the sync version but without triggering callbacks
-    // We'll trigger them from the main thread instead
-    auto original_callback = discovery->discovery_callback;
-    auto original_device_callback = discovery->device_found_callback;
-
-    // Temporarily disable callbacks during sync discovery
-    discovery->discovery_callback = nullptr;
-    discovery->device_found_callback = nullptr;
-
-    result = discovery->discover_devices_sync(*devices, true); // Skip active check since we're already in async mode
-
-    // Restore original callbacks
-    discovery->discovery_callback = original_callback;
-    discovery->device_found_callback = original_device_callback;
+    std::vector<DeviceChange> changes;
+    bool result = discovery->run_query(changes);
+    discovery->save_persisted_devices();
 
     // Mark discovery as no longer active
     discovery->discovery_active = false;
+    if (discovery->current_mode == ASYNC_ONCE) {
+        discovery->current_mode = SYNC_ONCE;
+    }
 
     if (!result) {
         ESP_LOGE(TAG, "Async discovery failed");
-        delete devices;
+        discovery->publish_changes(changes);
     } else {
-        ESP_LOGI(TAG, "Async discovery completed successfully, found %d devices", devices->size());
+        ESP_LOGI(TAG, "Async discovery completed (%d changes)", changes.size());
+        xTimerPendFunctionCall(sweep_finished, discovery, 0, 0);
+        discovery->post_changes(changes, true);
+    }
 
-        // Schedule callback to run in main thread using LVGL's async mechanism
-        AsyncCallbackData* callback_data = new AsyncCallbackData(discovery, devices, result);
+    // Task cleanup - delete itself
+    mem_task_delete(nullptr);
+}
+
+void ChromecastDiscovery::post_changes(const std::vector<DeviceChange>& changes, bool done) {
+    if (changes.empty() && !done) {
+        return;
+    }
+    publish_changes(changes);
 
-        // Use LVGL's async call to execute the callback in the main thread
-        if (lv_async_call(async_callback_main_thread, callback_data) != LV_RES_OK) {
-            ESP_LOGE(TAG, "Failed to schedule async callback");
-            delete devices;
-            delete callback_data;
+    // Deltas first so listeners can diff, then the full list for simple consumers.
+    // A browse answer carries its own change; the whole list is only copied at
+    // the end of a sweep
+    dispatch_changes(changes);
+    if (done && discovery_callback) {
+        std::vector<DeviceInfo> devices;
+        get_cached_devices(devices);
+        discovery_callback(devices);
+    }
+}
+
+bool ChromecastDiscovery::start_continuous_browse() {
+    if (!initialized) {
+        ESP_LOGE(TAG, "Not initialized");
+        return false;
+    }
+
+    if (current_mode == CONTINUOUS_BROWSE) {
+        ESP_LOGW(TAG, "Continuous browse already running");
+        return true;
+    }
+
+    if (browse_owner && browse_owner != this) {
+        ESP_LOGE(TAG, "Another discovery instance is already browsing");
+        return false;
+    }
+
+    stop_periodic_discovery();
+
+    browse_owner = this;
+    browse_handle = mdns_browse_new(CHROMECAST_SERVICE, CHROMECAST_PROTOCOL, browse_notify);
+    if (!browse_handle) {
+        ESP_LOGE(TAG, "Failed to start mDNS browse");
+        browse_owner = nullptr;
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Continuous browse started, maintenance every %d ms", periodic_interval_ms);
+    current_mode = CONTINUOUS_BROWSE;
+
+    // Announcements arrive on their own; the timer paces sweeps and refreshes
+    if (!start_pacing()) {
+        ESP_LOGW(TAG, "Failed to start browse maintenance timer");
+    }
+    start_probe_task();
+    return true;
+}
+
+void ChromecastDiscovery::stop_continuous_browse() {
+    if (current_mode != CONTINUOUS_BROWSE) {
+        return;
+    }
+
+    ESP_LOGI(TAG, "Stopping continuous browse");
+    if (periodic_timer) {
+        xTimerStop(periodic_timer, 0);
+    }
+    mdns_browse_delete(CHROMECAST_SERVICE, CHROMECAST_PROTOCOL);
+    browse_handle = nullptr;
+
+    // A running search can only be freed once it has finished
+    if (sweep_search) {
+        mdns_result_t* results = nullptr;
+        if (mdns_query_async_get_results(sweep_search, timeout_ms, &results, nullptr)) {
+            mdns_query_results_free(results);
+            mdns_query_async_delete(sweep_search);
+        } else {
+            abandon_search(sweep_search);
         }
+        sweep_search = nullptr;
     }
+    free_refresh();
 
-    // Task cleanup - delete itself
-    vTaskDelete(nullptr);
+    browse_owner = nullptr;
+    current_mode = SYNC_ONCE;
+}
+
+void ChromecastDiscovery::browse_notify(mdns_result_t* result) {
+    ChromecastDiscovery* discovery = browse_owner;
+    if (!discovery || !result || discovery->current_mode != CONTINUOUS_BROWSE) {
+        return;
+    }
+
+    // result->next links other browse results; only this one is new
+    std::vector<DeviceChange> changes;
+    if (result->ttl == 0) {
+        TxtFields txt;
+        parse_txt(result, txt);
+        discovery->remove_device(txt.id, result->instance_name, changes);
+    } else {
+        // SRV/TXT may arrive before the A record; the next notification completes it
+        ChromecastDeviceTable::Answer answer;
+        if (discovery->parse_answer(result, answer)) {
+            discovery->merge_device(answer, changes);
+        }
+    }
+
+    discovery->post_changes(changes);
+}
+
+bool ChromecastDiscovery::find_group_leader(const DeviceInfo& group, DeviceInfo& leader) {
+    if (!table_mutex || !group.is_group()) {
+        return false;
+    }
+
+    esp_ip4_addr_t addr = { .addr = esp_ip4addr_aton(group.ip_address.c_str()) };
+
+    xSemaphoreTake(table_mutex, portMAX_DELAY);
+    int slot = device_table.find_by_ip(addr.addr, DeviceInfo::CAP_MULTIZONE_GROUP);
+    if (slot >= 0) {
+        record_to_info(slot, leader);
+    }
+    xSemaphoreGive(table_mutex);
+    return slot >= 0;
+}
+
+void ChromecastDiscovery::load_persisted_devices() {
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;     // Nothing saved yet
+    }
+
+    size_t size = 0;
+    std::vector<PersistedDevice> saved;
+    esp_err_t err = nvs_get_blob(handle, NVS_DEVICES_KEY, nullptr, &size);
+    if (err == ESP_OK && size % sizeof(PersistedDevice) == 0) {
+        saved.resize(size / sizeof(PersistedDevice));
+        err = nvs_get_blob(handle, NVS_DEVICES_KEY, saved.data(), &size);
+    }
+    nvs_close(handle);
+    if (err != ESP_OK || saved.empty()) {
+        return;
+    }
+
+    // With the RTC unset and no SNTP yet the clock starts at 1970; age is only checked once it is set
+    time_t now_s = time(nullptr);
+    bool clock_valid = now_s > CLOCK_VALID_EPOCH;
+
+    xSemaphoreTake(table_mutex, portMAX_DELAY);
+    TickType_t now = xTaskGetTickCount();
+    size_t restored = 0;
+    for (PersistedDevice& entry : saved) {
+        entry.uuid[sizeof(entry.uuid) - 1] = '\0';
+        entry.name[sizeof(entry.name) - 1] = '\0';
+        entry.instance_name[sizeof(entry.instance_name) - 1] = '\0';
+        entry.model[sizeof(entry.model) - 1] = '\0';
+        if (clock_valid && entry.last_seen != 0 && now_s - entry.last_seen > PERSIST_MAX_AGE_S) {
+            continue;
+        }
+        if (entry.protocol > ChromecastDeviceTable::PROTOCOL_UPNP) {
+            continue;
+        }
+
+        ChromecastDeviceTable::Answer answer = {
+            entry.uuid, entry.name, entry.instance_name, entry.model,
+            entry.ipv4, entry.port, PROBABLE_TTL_S * 1000,
+            true, entry.capabilities, nullptr,
+            static_cast<ChromecastDeviceTable::Protocol>(entry.protocol)
+        };
+        int slot;
+        if (device_table.merge(answer, now, slot) == ChromecastDeviceTable::CHANGE_ADDED) {
+            device_table.set_probable(slot);
+            restored++;
+        }
+    }
+    xSemaphoreGive(table_mutex);
+
+    ESP_LOGI(TAG, "Restored %d known devices from NVS", restored);
+}
+
+void ChromecastDiscovery::save_persisted_devices() {
+    if (!table_mutex) {
+        return;
+    }
+
+    // Only written when a device was added, changed or removed, not on TTL refreshes
+    xSemaphoreTake(table_mutex, portMAX_DELAY);
+    if (!table_dirty) {
+        xSemaphoreGive(table_mutex);
+        return;
+    }
+    table_dirty = false;
+
+    // Heap, not stack: this runs on the timer service task too
+    std::vector<PersistedDevice> saved;
+    saved.reserve(device_table.size());
+    time_t now_s = time(nullptr);
+    bool clock_valid = now_s > CLOCK_VALID_EPOCH;
+    TickType_t now = xTaskGetTickCount();
+    for (int slot = 0; slot < (int)ChromecastDeviceTable::MAX_DEVICES; slot++) {
+        if (!device_table.in_use(slot)) continue;
+        const ChromecastDeviceTable::Record& r = device_table.record(slot);
+
+        PersistedDevice entry = {};
+        strlcpy(entry.uuid, device_table.str(r.uuid_text), sizeof(entry.uuid));
+        strlcpy(entry.name, device_table.str(r.name), sizeof(entry.name));
+        strlcpy(entry.instance_name, device_table.str(r.instance_name), sizeof(entry.instance_name));
+        strlcpy(entry.model, device_table.str(r.model), sizeof(entry.model));
+        entry.ipv4 = r.ipv4;
+        entry.port = r.port;
+        entry.capabilities = r.capabilities;
+        entry.protocol = r.protocol;
+        if (clock_valid) {
+            entry.last_seen = now_s - (now - r.last_seen) / configTICK_RATE_HZ;
+        }
+        saved.push_back(entry);
+    }
+    xSemaphoreGive(table_mutex);
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = saved.empty() ? nvs_erase_key(handle, NVS_DEVICES_KEY)
+                            : nvs_set_blob(handle, NVS_DEVICES_KEY, saved.data(), saved.size() * sizeof(PersistedDevice));
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to persist device table: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGD(TAG, "Persisted %d devices", saved.size());
+    }
+}
+
+void ChromecastDiscovery::start_probe_task() {
+    // Probing is the leader's, whose snapshot confirms whatever it reaches
+    if (probe_active || !table_mutex || following()) {
+        return;
+    }
+
+    xSemaphoreTake(table_mutex, portMAX_DELAY);
+    bool pending = false;
+    for (int slot = 0; slot < (int)ChromecastDeviceTable::MAX_DEVICES && !pending; slot++) {
+        pending = device_table.in_use(slot) && device_table.record(slot).probable;
+    }
+    xSemaphoreGive(table_mutex);
+
+    if (!pending || !wifi_connected()) {
+        return;
+    }
+
+    probe_active = true;
+    // Internal stack: it saves the device table to NVS
+    if (!mem_task_create(probe_task, "cc_probe", 3072, this, TASK_PLAN_DISCOVERY_PRIORITY, nullptr,
+                         TASK_PLAN_NETWORK_CORE, MEM_TASK_STACK_INTERNAL)) {
+        ESP_LOGE(TAG, "Failed to create device probe task");
+        probe_active = false;
+    }
+}
+
+bool ChromecastDiscovery::probe_tcp(uint32_t ipv4, uint16_t port, uint32_t timeout_ms) {
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (sock < 0) {
+        return false;
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = ipv4;
+
+    // A completed handshake is enough; the Cast TLS session is not started
+    bool reachable = connect(sock, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+    if (!reachable && errno == EINPROGRESS) {
+        fd_set write_set;
+        FD_ZERO(&write_set);
+        FD_SET(sock, &write_set);
+        struct timeval tv = { .tv_sec = (long)(timeout_ms / 1000), .tv_usec = (long)((timeout_ms % 1000) * 1000) };
+        if (select(sock + 1, nullptr, &write_set, nullptr, &tv) > 0) {
+            int error = 0;
+            socklen_t len = sizeof(error);
+            reachable = getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0;
+        }
+    }
+
+    close(sock);
+    return reachable;
+}
+
+void ChromecastDiscovery::probe_task(void* parameter) {
+    ChromecastDiscovery* discovery = static_cast<ChromecastDiscovery*>(parameter);
+
+    struct Target {
+        uint32_t ipv4;
+        uint16_t port;
+    };
+    Target targets[ChromecastDeviceTable::MAX_DEVICES];
+    size_t target_count = 0;
+
+    xSemaphoreTake(discovery->table_mutex, portMAX_DELAY);
+    for (int slot = 0; slot < (int)ChromecastDeviceTable::MAX_DEVICES; slot++) {
+        if (discovery->device_table.in_use(slot) && discovery->device_table.record(slot).probable) {
+            const ChromecastDeviceTable::Record& r = discovery->device_table.record(slot);
+            targets[target_count++] = {r.ipv4, r.port};
+        }
+    }
+    xSemaphoreGive(discovery->table_mutex);
+
+    ESP_LOGI(TAG, "Probing %d devices restored from NVS", target_count);
+
+    std::vector<DeviceChange> changes;
+    for (size_t i = 0; i < target_count; i++) {
+        bool reachable = probe_tcp(targets[i].ipv4, targets[i].port, PROBE_TIMEOUT_MS);
+
+        // mDNS may have confirmed or moved the device while the probe ran
+        xSemaphoreTake(discovery->table_mutex, portMAX_DELAY);
+        int slot = discovery->device_table.find_by_ip(targets[i].ipv4);
+        if (slot >= 0 && discovery->device_table.record(slot).probable) {
+            DeviceChange change = {reachable ? DEVICE_UPDATED : DEVICE_REMOVED, DeviceInfo()};
+            if (reachable) {
+                discovery->device_table.confirm(slot, xTaskGetTickCount(), DEFAULT_RECORD_TTL_S * 1000);
+                discovery->record_to_info(slot, change.device);
+            } else {
+                discovery->record_to_info(slot, change.device);
+                ESP_LOGI(TAG, "Device %s did not answer the probe", change.device.name.c_str());
+                discovery->device_table.remove(slot);
+                discovery->table_dirty = true;
+            }
+            changes.push_back(change);
+        }
+        xSemaphoreGive(discovery->table_mutex);
+    }
+
+    discovery->post_changes(changes);
+    discovery->save_persisted_devices();
+    discovery->probe_active = false;
+    mem_task_delete(nullptr);
 }
 
 std::string ChromecastDiscovery::device_info_to_string(const DeviceInfo& device) {
@@ -403,6 +1442,10 @@ std::string ChromecastDiscovery::device_info_to_string(const DeviceInfo& device)
         ss << " [UUID: " << device.uuid << "]";
     }
 
+    if (!device.is_cast()) {
+        ss << " [UPnP]";
+    }
+
     return ss.str();
 }
 
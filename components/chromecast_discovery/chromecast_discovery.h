@@ -3,49 +3,114 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <ctime>
 #include "esp_log.h"
 #include "esp_netif.h"
 #include "mdns.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/timers.h"
+#include "freertos/semphr.h"
+#include "chromecast_device_table.h"
+#include "discovery_backend.h"
+#include "discovery_peers.h"
 
 /**
  * ChromecastDiscovery - ESP-IDF C++ class for discovering Chromecast devices via mDNS
  * 
  * Features:
  * - Synchronous and asynchronous mDNS discovery
- * - Device information extraction
+ * - Device information extraction, single-pass TXT parsing (fn, md, id, ca, rs, bs)
+ * - Incomplete PTR answers resolved with parallel SRV/TXT/A follow-up queries
+ * - Speaker groups as first-class targets, linked to the speaker leading them
  * - Callback-based notifications
- * - Automatic periodic discovery
+ * - Automatic periodic discovery, paced by how closely the list is watched:
+ *   fast while it is on screen, backing off while the set is unchanged,
+ *   paused while the screen sleeps
+ * - Known devices kept fresh with unicast-response (QU) SRV/TXT queries
+ *   instead of multicast PTR sweeps
+ * - Continuous mDNS browse: devices appear as soon as they announce
+ * - Persistent device table updated incrementally, expiring on record TTL
+ * - Added/updated/removed events so listeners can diff instead of rebuilding
+ * - Duplicate answers merged; O(1) lookup by UUID, name or IP
+ * - Device table persisted to NVS: known speakers are listed at boot as
+ *   "probably available" and validated in the background with a TCP probe
+ * - Other discovery backends (SSDP for UPnP/DLNA renderers) searched with
+ *   every sweep, their devices merged into the same table
+ * - Optionally cooperative (DiscoveryPeers): with other ESPCaster units on
+ *   the LAN one leader sweeps and probes, the rest merge its table changes
  */
-class ChromecastDiscovery {
+class ChromecastDiscovery : private DiscoveryBackend::Sink, private DiscoveryPeers::Sink {
 public:
     // Chromecast device information
     struct DeviceInfo {
+        // TXT "ca" capability bits
+        enum Capability : uint32_t {
+            CAP_VIDEO_OUT = 1 << 0,
+            CAP_VIDEO_IN = 1 << 1,
+            CAP_AUDIO_OUT = 1 << 2,
+            CAP_AUDIO_IN = 1 << 3,
+            CAP_DEV_MODE = 1 << 4,
+            CAP_MULTIZONE_GROUP = 1 << 5
+        };
+
         std::string name;           // Device friendly name
         std::string ip_address;     // IP address as string
         int port;                   // Port number (usually 8009)
         std::string instance_name;  // mDNS instance name
         std::string model;          // Device model (if available)
         std::string uuid;           // Device UUID (if available)
+        bool probable;              // Restored from NVS, not yet confirmed on the network
+        uint32_t capabilities;      // Capability bits (TXT "ca")
+        std::string status;         // Receiver status text (TXT "rs"), e.g. the running app
+        std::string leader_uuid;    // Groups: speaker currently hosting the group, if known
+        ChromecastDeviceTable::Protocol protocol;   // UPnP renderers are listed but not Cast-controlled
         
-        DeviceInfo() : port(8009) {}
+        DeviceInfo() : port(8009), probable(false), capabilities(0), protocol(ChromecastDeviceTable::PROTOCOL_CAST) {}
         
         bool is_valid() const {
             return !ip_address.empty() && port > 0;
         }
+
+        bool is_cast() const {
+            return protocol == ChromecastDeviceTable::PROTOCOL_CAST;
+        }
+
+        bool is_group() const {
+            return (capabilities & CAP_MULTIZONE_GROUP) != 0;
+        }
+    };
+
+    // Changes to the device table
+    enum DeviceEvent {
+        DEVICE_ADDED,
+        DEVICE_UPDATED,     // Name, address, port or model changed
+        DEVICE_REMOVED      // TTL expired or goodbye received
+    };
+
+    struct DeviceChange {
+        DeviceEvent event;
+        DeviceInfo device;
     };
 
     // Discovery result callback
     using DiscoveryCallback = std::function<void(const std::vector<DeviceInfo>&)>;
     using DeviceFoundCallback = std::function<void(const DeviceInfo&)>;
+    using DeviceEventCallback = std::function<void(DeviceEvent, const DeviceInfo&)>;
 
     // Discovery modes
     enum DiscoveryMode {
         SYNC_ONCE,      // Single synchronous discovery
         ASYNC_ONCE,     // Single asynchronous discovery
-        PERIODIC        // Periodic discovery with timer
+        PERIODIC,           // Periodic discovery with timer
+        CONTINUOUS_BROWSE   // Passive mdns_browse, paced sweeps and unicast refreshes
+    };
+
+    // How closely the device list is watched; sets the pace of PTR sweeps
+    enum Interest {
+        INTEREST_BACKGROUND,    // Sweeps back off from the periodic interval while nothing changes
+        INTEREST_VISIBLE,       // Device list on screen: a sweep every FAST_SWEEP_INTERVAL_MS
+        INTEREST_IDLE           // Screen asleep: no queries at all until it wakes
     };
 
 private:
@@ -55,6 +120,56 @@ private:
     static constexpr uint32_t DEFAULT_TIMEOUT_MS = 3000;
     static constexpr size_t DEFAULT_MAX_RESULTS = 20;
     static constexpr uint32_t DEFAULT_PERIODIC_INTERVAL_MS = 30000; // 30 seconds
+    static constexpr uint32_t DEFAULT_RECORD_TTL_S = 120;           // mDNS default for SRV/TXT
+    static constexpr uint32_t RESOLVE_TIMEOUT_MS = 1000;            // Follow-up SRV/TXT/A queries
+    static constexpr size_t MAX_PARALLEL_RESOLVE = 8;               // Incomplete answers resolved per sweep
+    static constexpr size_t MAX_ABANDONED_SEARCHES = 8;             // Given up on, freed once they finish
+    static constexpr uint32_t SWEEP_POLL_MS = 100;                  // Browse sweeps: wait for the query to end
+    static constexpr uint32_t FAST_SWEEP_INTERVAL_MS = 5000;        // Device list on screen
+    static constexpr uint32_t MAX_SWEEP_INTERVAL_MS = 8 * 60 * 1000;    // Backoff ceiling
+
+    // Device table persistence and boot-time validation
+    static constexpr const char* NVS_NAMESPACE = "cc_discovery";
+    static constexpr const char* NVS_DEVICES_KEY = "devices_v3";    // Bump on PersistedDevice change
+    static constexpr uint32_t PROBABLE_TTL_S = 600;                 // Kept while waiting for WiFi/probe
+    static constexpr uint32_t PERSIST_MAX_AGE_S = 30 * 24 * 3600;   // Only checked with a valid clock
+    static constexpr uint32_t PROBE_TIMEOUT_MS = 1500;
+    static constexpr time_t CLOCK_VALID_EPOCH = 1704067200;         // 2024-01-01, SNTP has run
+
+    // NVS image of one device table record
+    struct PersistedDevice {
+        char uuid[33];
+        char name[64];
+        char instance_name[64];
+        char model[32];
+        uint32_t ipv4;
+        uint16_t port;
+        uint32_t last_seen;         // Unix time, 0 if the clock was not set
+        uint32_t capabilities;
+        uint8_t protocol;           // ChromecastDeviceTable::Protocol
+    };
+
+    // Known Cast TXT keys, pointing into the mdns result
+    struct TxtFields {
+        const char* id;             // UUID
+        const char* fn;             // Friendly name
+        const char* md;             // Model
+        const char* rs;             // Receiver status
+        const char* bs;             // Cloud device id; parsed but not tracked
+        bool has_ca;
+        uint32_t ca;                // Capability bitmask
+    };
+
+    // Follow-up queries for a PTR answer that arrived without SRV, TXT or A records
+    struct Resolution {
+        const mdns_result_t* ptr;
+        mdns_search_once_t* srv_search;
+        mdns_search_once_t* txt_search;
+        mdns_search_once_t* a_search;
+        mdns_result_t* srv_result;
+        mdns_result_t* txt_result;
+        mdns_result_t* a_result;
+    };
 
     // Internal state
     bool initialized;
@@ -64,28 +179,113 @@ private:
     // Callbacks
     DiscoveryCallback discovery_callback;
     DeviceFoundCallback device_found_callback;
+    DeviceEventCallback device_event_callback;
+
+    // Device table, guarded by table_mutex
+    ChromecastDeviceTable device_table;
+    SemaphoreHandle_t table_mutex;
+    bool table_dirty;               // Table changed since it was last written to NVS
+    bool probe_active;
     
-    // Periodic discovery
+    // Continuous browse; the mdns notifier has no user context, so one instance owns it
+    static ChromecastDiscovery* browse_owner;
+    mdns_browse_t* browse_handle;
+    mdns_search_once_t* sweep_search;
+    std::vector<mdns_search_once_t*> refresh_searches;  // Unicast refreshes, collected on the next tick
+
+    // Searches waited for in vain: mdns only frees one it has finished, so
+    // these are retried from whichever task reaps next
+    portMUX_TYPE abandoned_lock;
+    mdns_search_once_t* abandoned_searches[MAX_ABANDONED_SEARCHES];
+    size_t abandoned_count;
+
+    // Searched alongside every sweep; not owned
+    std::vector<DiscoveryBackend*> backends;
+
+    // Cooperative discovery, if set; not owned
+    DiscoveryPeers* peers;
+
+    // Periodic discovery (also drives browse-mode expiry)
     TimerHandle_t periodic_timer;
+    TimerHandle_t sweep_timer;      // One-shot: ends a sweep started while browsing
     uint32_t periodic_interval_ms;
+
+    // Sweep pacing; past starting a mode, only the timer service task touches it
+    Interest interest;
+    uint32_t sweep_interval_ms;     // periodic_interval_ms, doubled per sweep that changed nothing
+    TickType_t last_sweep;
+    uint32_t sweep_set_epoch;       // Device table set epoch at the end of the last sweep
     
     // Discovery parameters
     uint32_t timeout_ms;
     size_t max_results;
     
     // Internal methods
-    bool parse_device_info(const mdns_result_t* result, DeviceInfo& device);
-    std::string extract_txt_value(const mdns_result_t* result, const char* key);
+    bool parse_answer(const mdns_result_t* result, ChromecastDeviceTable::Answer& answer);
+    static void parse_txt(const mdns_result_t* result, TxtFields& txt);
+    static void apply_txt(const mdns_result_t* result, ChromecastDeviceTable::Answer& answer);
+    static uint32_t first_ipv4(const mdns_ip_addr_t* addr);
+    void merge_results(mdns_result_t* results, std::vector<DeviceChange>& changes);
+    void resolve_incomplete(std::vector<Resolution>& pending, std::vector<DeviceChange>& changes);
+    mdns_result_t* collect_search(mdns_search_once_t* search);
+    void abandon_search(mdns_search_once_t* search);
+    void reap_searches();
+    bool wifi_connected();
+    void record_to_info(int slot, DeviceInfo& device) const;
     void process_discovery_results(mdns_result_t* results);
+    bool run_query(std::vector<DeviceChange>& changes);
+    void merge_device(const ChromecastDeviceTable::Answer& answer, std::vector<DeviceChange>& changes);
+    void remove_device(const char* uuid, const char* instance_name, std::vector<DeviceChange>& changes);
+    void expire_devices(std::vector<DeviceChange>& changes);
+    void start_refresh();
+    void collect_refresh(std::vector<DeviceChange>& changes);
+    void free_refresh();
+    bool start_discovery_task();
+    bool start_pacing();
+    uint32_t tick_period_ms() const;
+    bool sweep_due() const;
+    void suspect_lapsed();
+    void start_backends();
+
+    // DiscoveryBackend::Sink, called on the backends' tasks
+    void backend_answer(const ChromecastDeviceTable::Answer& answer) override;
+    bool backend_knows(const char* instance_name) override;
+    // DiscoveryPeers::Sink, called on the peers task
+    void peer_apply(const DiscoveryPeers::Record* records, size_t count) override;
+    void peer_snapshot(std::vector<DiscoveryPeers::Record>& records) override;
+    void peer_role(bool following) override;
+    bool peer_watching() override;
+    bool following() const { return peers && peers->following(); }
+    void publish_changes(const std::vector<DeviceChange>& changes);
+    static void take_over(void* parameter, uint32_t unused);
+
+    void post_changes(const std::vector<DeviceChange>& changes, bool done = false);
+    void maintenance();
+    void dispatch_changes(const std::vector<DeviceChange>& changes);
+    void load_persisted_devices();
+    void save_persisted_devices();
+    void start_probe_task();
+    static bool probe_tcp(uint32_t ipv4, uint16_t port, uint32_t timeout_ms);
     
     // Static callback for periodic timer
     static void periodic_timer_callback(TimerHandle_t timer);
 
+    // Browse sweeps, both on the timer service task like maintenance
+    static void start_sweep(void* parameter, uint32_t unused);
+    static void sweep_timer_callback(TimerHandle_t timer);
+
+    // Pacing updates, pended to the timer service task
+    static void sweep_finished(void* parameter, uint32_t unused);
+    static void apply_interest(void* parameter, uint32_t value);
+
+    // mdns browse notifier, runs on the mdns service task
+    static void browse_notify(mdns_result_t* result);
+
     // Static task function for async discovery
     static void async_discovery_task(void* parameter);
 
-    // Static callback function for main thread execution
-    static void async_callback_main_thread(void* user_data);
+    // Validates probable devices with a TCP connect to the Cast port
+    static void probe_task(void* parameter);
 
 public:
     ChromecastDiscovery();
@@ -95,20 +295,45 @@ public:
     bool initialize();
     void deinitialize();
 
+    // Before initialize(); the backend must outlive this instance's deinitialize()
+    void add_backend(DiscoveryBackend* backend) { backends.push_back(backend); }
+    // Before initialize(); started and stopped with this instance
+    void set_peers(DiscoveryPeers* peers) { this->peers = peers; }
+
     // Discovery methods
     bool discover_devices_sync(std::vector<DeviceInfo>& devices, bool skip_active_check = false);
     bool discover_devices_async();
     bool start_periodic_discovery(uint32_t interval_ms = DEFAULT_PERIODIC_INTERVAL_MS);
     void stop_periodic_discovery();
+    bool start_continuous_browse();
+    void stop_continuous_browse();
 
     // Configuration
     void set_timeout(uint32_t timeout_ms) { this->timeout_ms = timeout_ms; }
     void set_max_results(size_t max_results) { this->max_results = max_results; }
     void set_periodic_interval(uint32_t interval_ms) { this->periodic_interval_ms = interval_ms; }
+    // Any task; takes effect on the next timer tick, at once when the list comes on screen
+    void set_interest(Interest interest);
 
-    // Callbacks
+    // Callbacks, set before initialize(). They run on the task that found the
+    // change: the caller in sync mode, otherwise the discovery, backend, peers,
+    // mdns or timer service task. Keep them short and hand GUI work to its own
+    // task; nothing here touches LVGL
     void set_discovery_callback(DiscoveryCallback callback) { discovery_callback = callback; }
     void set_device_found_callback(DeviceFoundCallback callback) { device_found_callback = callback; }
+    void set_device_event_callback(DeviceEventCallback callback) { device_event_callback = callback; }
+
+    // Snapshot of the device table without touching the network; epoch, if
+    // given, receives the table epoch the snapshot was taken at
+    size_t get_cached_devices(std::vector<DeviceInfo>& devices, uint32_t* epoch = nullptr);
+    // Moves on whenever the device table changes
+    uint32_t get_table_epoch();
+
+    // Indexed lookup in the device table by UUID, name/instance name or IPv4 address
+    bool find_cached_device(const char* key, DeviceInfo& device);
+
+    // Speaker currently hosting a group (the group is served from the leader's address)
+    bool find_group_leader(const DeviceInfo& group, DeviceInfo& leader);
 
     // Getters
     bool is_initialized() const { return initialized; }
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include "chromecast_device_table.h"
+
+/**
+ * DiscoveryBackend - a way of finding speakers other than Cast mDNS
+ *
+ * ChromecastDiscovery starts every backend added to it with each of its own
+ * sweeps. A backend searches on a task of its own and reports through the
+ * Sink; its answers are merged into the same device table as Cast answers,
+ * tagged with their protocol, so listeners and the GUI see one list.
+ */
+class DiscoveryBackend {
+public:
+    // Implemented by ChromecastDiscovery; safe to call from the backend's task
+    class Sink {
+    public:
+        // A device answered; pointers in answer are only read during the call
+        virtual void backend_answer(const ChromecastDeviceTable::Answer& answer) = 0;
+        // Already listed under its friendly name, so nothing more to fetch for it
+        virtual bool backend_knows(const char* instance_name) = 0;
+
+    protected:
+        ~Sink() = default;
+    };
+
+    virtual ~DiscoveryBackend() = default;
+
+    virtual const char* name() const = 0;
+    // Returns at once; false if the last search is still running or this one could not start
+    virtual bool start_search(uint32_t timeout_ms, Sink* sink) = 0;
+    // Ends a running search early and waits for it; the sink is not called after
+    virtual void stop() = 0;
+};
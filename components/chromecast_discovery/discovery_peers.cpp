@@ -0,0 +1,488 @@
+#include "discovery_peers.h"
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_netif.h"
+#include "mdns.h"
+#include "lwip/sockets.h"
+#include "mem_task.h"
+#include "task_plan.h"
+
+static const char* TAG = "DiscoveryPeers";
+
+const char* DiscoveryPeers::role_name(uint8_t role) {
+    switch (role) {
+        case ROLE_LEADER: return "leader";
+        case ROLE_FOLLOWER: return "follower";
+        default: return "electing";
+    }
+}
+
+DiscoveryPeers::DiscoveryPeers()
+    : sink(nullptr)
+    , stopping(false)
+    , sock(-1)
+    , joined_ip(0)
+    , unit(0)
+    , role(ROLE_ELECTING)
+    , watching_peers(false)
+    , peers_heard(false)
+    , advertised(false)
+    , peer_count(0)
+    , leader(0)
+    , leader_heard(0)
+    , electing_since(0)
+    , seq(0)
+    , in_sync(false)
+    , last_heartbeat(0)
+    , last_snapshot(0)
+    , last_resync(0)
+    , snapshot_wanted(false)
+{
+    idle = xSemaphoreCreateBinaryStatic(&idle_buffer);
+    xSemaphoreGive(idle);
+    lock = xSemaphoreCreateMutexStatic(&lock_buffer);
+}
+
+DiscoveryPeers::~DiscoveryPeers() {
+    stop();
+}
+
+bool DiscoveryPeers::start(Sink* sink) {
+    if (xSemaphoreTake(idle, 0) != pdTRUE) {
+        return false;   // Already running
+    }
+
+    // The STA MAC: unique per unit and stable across reboots, so elections come out the same
+    uint8_t mac[6] = {};
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    unit = 0;
+    for (uint8_t byte : mac) {
+        unit = (unit << 8) | byte;
+    }
+
+    this->sink = sink;
+    stopping = false;
+    role = ROLE_ELECTING;
+    peer_count = 0;
+    peers_heard = false;
+    watching_peers = false;
+
+    // PSRAM stack: sockets and mDNS TXT updates only, nothing that reaches flash
+    if (!mem_task_create(peers_task, "cc_peers", TASK_STACK_SIZE, this, TASK_PLAN_DISCOVERY_PRIORITY,
+                         nullptr, TASK_PLAN_NETWORK_CORE, MEM_TASK_STACK_PSRAM)) {
+        ESP_LOGE(TAG, "Failed to create discovery peers task");
+        xSemaphoreGive(idle);
+        return false;
+    }
+    return true;
+}
+
+void DiscoveryPeers::stop() {
+    stopping = true;
+    xSemaphoreTake(idle, portMAX_DELAY);
+    xSemaphoreGive(idle);
+}
+
+void DiscoveryPeers::peers_task(void* parameter) {
+    DiscoveryPeers* peers = static_cast<DiscoveryPeers*>(parameter);
+    peers->run();
+
+    // Nothing of peers is touched past this: stop() may return and delete it
+    xSemaphoreGive(peers->idle);
+    mem_task_delete(nullptr);
+}
+
+void DiscoveryPeers::run() {
+    ESP_LOGI(TAG, "Cooperative discovery as unit %012" PRIx64, unit);
+    advertise();
+
+    while (!stopping) {
+        // Rejoined on every address change; nothing is led or followed without one
+        uint32_t ip = station_ip();
+        if (ip != joined_ip) {
+            close_socket();
+            if (ip != 0 && !open_socket(ip)) {
+                ESP_LOGW(TAG, "No multicast socket for peers: errno %d", errno);
+            }
+        }
+        if (sock < 0) {
+            vTaskDelay(pdMS_TO_TICKS(POLL_MS));
+            continue;
+        }
+
+        fd_set read_set;
+        FD_ZERO(&read_set);
+        FD_SET(sock, &read_set);
+        struct timeval tv = { .tv_sec = 0, .tv_usec = (long)(POLL_MS * 1000) };
+        if (select(sock + 1, &read_set, nullptr, nullptr, &tv) > 0) {
+            receive();
+        }
+
+        TickType_t now = xTaskGetTickCount();
+        if (now - last_heartbeat >= pdMS_TO_TICKS(HEARTBEAT_MS)) {
+            last_heartbeat = now;
+            elect(now);
+            send_heartbeat();
+        }
+
+        if (leading() && peers_heard && now - last_snapshot >= pdMS_TO_TICKS(SNAPSHOT_INTERVAL_MS)) {
+            snapshot_wanted = true;
+        }
+        if (snapshot_wanted && leading() && now - last_snapshot >= pdMS_TO_TICKS(SNAPSHOT_MIN_GAP_MS)) {
+            send_snapshot();
+        }
+        if (following() && !in_sync && now - last_resync >= pdMS_TO_TICKS(RESYNC_MIN_GAP_MS)) {
+            send_resync();
+        }
+    }
+
+    close_socket();
+    if (advertised) {
+        mdns_service_remove(MDNS_SERVICE, MDNS_PROTOCOL);
+        advertised = false;
+    }
+    // The sink is being torn down: no role callback
+    role = ROLE_ELECTING;
+}
+
+uint32_t DiscoveryPeers::station_ip() {
+    esp_netif_t* netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    esp_netif_ip_info_t ip_info;
+    if (!netif || esp_netif_get_ip_info(netif, &ip_info) != ESP_OK) {
+        return 0;
+    }
+    return ip_info.ip.addr;
+}
+
+bool DiscoveryPeers::open_socket(uint32_t ip) {
+    int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd < 0) {
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in bind_addr = {};
+    bind_addr.sin_family = AF_INET;
+    bind_addr.sin_port = htons(GROUP_PORT);
+    bind_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    struct ip_mreq membership = {};
+    inet_aton(GROUP_ADDRESS, &membership.imr_multiaddr);
+    membership.imr_interface.s_addr = ip;
+    struct in_addr interface = { .s_addr = ip };
+    uint8_t ttl = MULTICAST_TTL;
+    uint8_t loop = 0;   // Our own datagrams are of no use to us
+
+    if (bind(fd, (struct sockaddr*)&bind_addr, sizeof(bind_addr)) < 0 ||
+        setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) < 0 ||
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &interface, sizeof(interface)) < 0) {
+        close(fd);
+        return false;
+    }
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    sock = fd;
+    joined_ip = ip;
+    xSemaphoreGive(lock);
+
+    // Heard from the others before anyone is elected
+    electing_since = xTaskGetTickCount();
+    last_heartbeat = electing_since - pdMS_TO_TICKS(HEARTBEAT_MS);
+    ESP_LOGI(TAG, "Joined %s:%u", GROUP_ADDRESS, (unsigned)GROUP_PORT);
+    return true;
+}
+
+void DiscoveryPeers::close_socket() {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (sock >= 0) {
+        close(sock);
+    }
+    sock = -1;
+    joined_ip = 0;
+    xSemaphoreGive(lock);
+
+    peer_count = 0;
+    peers_heard = false;
+    watching_peers = false;
+    if (role != ROLE_ELECTING && !stopping) {
+        set_role(ROLE_ELECTING, 0);
+    }
+}
+
+void DiscoveryPeers::advertise() {
+    char unit_text[13];
+    snprintf(unit_text, sizeof(unit_text), "%012" PRIx64, unit);
+    mdns_txt_item_t txt[] = {
+        { "unit", unit_text },
+        { "role", role_name(role) },
+    };
+    esp_err_t err = mdns_service_add("ESPCaster", MDNS_SERVICE, MDNS_PROTOCOL, GROUP_PORT,
+                                     txt, sizeof(txt) / sizeof(txt[0]));
+    advertised = err == ESP_OK;
+    if (!advertised) {
+        ESP_LOGW(TAG, "Not advertised over mDNS: %s", esp_err_to_name(err));
+    }
+}
+
+void DiscoveryPeers::set_role(Role next, uint64_t leader_unit) {
+    bool was_following = following();
+    bool same = next == role.load() && leader_unit == leader;
+    leader = leader_unit;
+    in_sync = false;
+    role = next;
+    if (next == ROLE_ELECTING) {
+        electing_since = xTaskGetTickCount();
+    }
+    if (same) {
+        return;
+    }
+
+    if (next == ROLE_FOLLOWER) {
+        ESP_LOGI(TAG, "Following unit %012" PRIx64 "; discovery left to it", leader_unit);
+    } else {
+        ESP_LOGI(TAG, "Now %s", role_name(next));
+    }
+    if (advertised) {
+        mdns_service_txt_item_set(MDNS_SERVICE, MDNS_PROTOCOL, "role", role_name(next));
+    }
+    if (next == ROLE_LEADER) {
+        // The followers' tables start from ours
+        snapshot_wanted = true;
+    }
+    if (following() != was_following) {
+        sink->peer_role(following());
+    }
+}
+
+void DiscoveryPeers::receive() {
+    struct sockaddr_in from = {};
+    socklen_t from_length = sizeof(from);
+    int length = recvfrom(sock, &rx, sizeof(rx), 0, (struct sockaddr*)&from, &from_length);
+    if (length < (int)sizeof(Header)) {
+        return;
+    }
+
+    const Header& header = rx.header;
+    if (header.magic != MAGIC || header.version != VERSION || header.unit == unit ||
+        header.count > RECORDS_PER_DATAGRAM ||
+        (size_t)length != sizeof(Header) + header.count * sizeof(Record)) {
+        return;
+    }
+    handle(rx);
+}
+
+void DiscoveryPeers::handle(Datagram& datagram) {
+    const Header& header = datagram.header;
+    TickType_t now = xTaskGetTickCount();
+
+    switch (header.type) {
+        case MSG_HEARTBEAT:
+            heard(header.unit, header.flags & FLAG_WATCHING);
+            if (!(header.flags & FLAG_LEADER)) {
+                break;
+            }
+            if (leading()) {
+                // Two leaders after a partition heals: the lower unit id keeps it
+                if (header.unit < unit) {
+                    set_role(ROLE_FOLLOWER, header.unit);
+                    leader_heard = now;
+                }
+                break;
+            }
+            if (following() && header.unit != leader && header.unit > leader &&
+                now - leader_heard < pdMS_TO_TICKS(LEADER_TIMEOUT_MS)) {
+                break;      // It steps down once it hears ours
+            }
+            if (!following() || header.unit != leader) {
+                set_role(ROLE_FOLLOWER, header.unit);
+            }
+            leader_heard = now;
+            // Behind the leader: a delta went missing
+            if (in_sync && header.seq != seq) {
+                ESP_LOGD(TAG, "Behind the leader (%" PRIu32 " of %" PRIu32 ")", seq, header.seq);
+                in_sync = false;
+            }
+            break;
+
+        case MSG_DELTA:
+        case MSG_SNAPSHOT:
+            if (!following() || header.unit != leader) {
+                break;
+            }
+            for (size_t i = 0; i < header.count; i++) {
+                Record& r = datagram.records[i];
+                r.uuid[sizeof(r.uuid) - 1] = '\0';
+                r.name[sizeof(r.name) - 1] = '\0';
+                r.instance_name[sizeof(r.instance_name) - 1] = '\0';
+                r.model[sizeof(r.model) - 1] = '\0';
+                r.status[sizeof(r.status) - 1] = '\0';
+            }
+            // Applied even out of order: an upsert or a removal can be repeated
+            sink->peer_apply(datagram.records, header.count);
+            if (header.type == MSG_DELTA) {
+                if (in_sync && header.seq != seq + 1) {
+                    ESP_LOGD(TAG, "Delta %" PRIu32 " after %" PRIu32 ", resyncing", header.seq, seq);
+                    in_sync = false;
+                }
+                seq = header.seq;
+            } else if (header.flags & FLAG_LAST) {
+                seq = header.seq;
+                in_sync = true;
+                ESP_LOGD(TAG, "Snapshot applied at delta %" PRIu32, seq);
+            }
+            break;
+
+        case MSG_RESYNC:
+            heard(header.unit, false);
+            snapshot_wanted = leading();
+            break;
+
+        default:
+            break;
+    }
+}
+
+void DiscoveryPeers::heard(uint64_t from, bool watching) {
+    TickType_t now = xTaskGetTickCount();
+    Peer* peer = nullptr;
+    for (size_t i = 0; i < peer_count && !peer; i++) {
+        if (peers[i].unit == from) {
+            peer = &peers[i];
+        }
+    }
+    if (!peer) {
+        if (peer_count == MAX_PEERS) {
+            return;     // A site this size shares one leader all the same
+        }
+        peer = &peers[peer_count++];
+        peer->unit = from;
+        ESP_LOGI(TAG, "Unit %012" PRIx64 " joined", from);
+    }
+    peer->last_heard = now;
+    peer->watching = watching;
+    peers_heard = true;
+    if (watching) {
+        watching_peers = true;
+    }
+}
+
+void DiscoveryPeers::expire_peers(TickType_t now) {
+    size_t kept = 0;
+    bool watching = false;
+    for (size_t i = 0; i < peer_count; i++) {
+        if (now - peers[i].last_heard > pdMS_TO_TICKS(LEADER_TIMEOUT_MS)) {
+            ESP_LOGI(TAG, "Unit %012" PRIx64 " went quiet", peers[i].unit);
+            continue;
+        }
+        watching |= peers[i].watching;
+        peers[kept++] = peers[i];
+    }
+    peer_count = kept;
+    peers_heard = kept > 0;
+    watching_peers = watching;
+}
+
+void DiscoveryPeers::elect(TickType_t now) {
+    expire_peers(now);
+
+    if (following() && now - leader_heard > pdMS_TO_TICKS(LEADER_TIMEOUT_MS)) {
+        ESP_LOGW(TAG, "Leader %012" PRIx64 " went quiet, electing", leader);
+        set_role(ROLE_ELECTING, 0);
+        return;
+    }
+    if (role != ROLE_ELECTING || now - electing_since < pdMS_TO_TICKS(LEADER_TIMEOUT_MS)) {
+        return;
+    }
+
+    // Every unit waits as long, so the lowest id heard is the one to take over
+    bool lowest = std::none_of(peers, peers + peer_count, [this](const Peer& p) { return p.unit < unit; });
+    if (lowest) {
+        set_role(ROLE_LEADER, unit);
+    }
+}
+
+void DiscoveryPeers::publish(const Record* records, size_t count) {
+    if (!leading() || !peers_heard || count == 0) {
+        return;
+    }
+    xSemaphoreTake(lock, portMAX_DELAY);
+    send_records(MSG_DELTA, records, count);
+    xSemaphoreGive(lock);
+}
+
+void DiscoveryPeers::send_heartbeat() {
+    uint8_t flags = (leading() ? FLAG_LEADER : 0) | (sink->peer_watching() ? FLAG_WATCHING : 0);
+    xSemaphoreTake(lock, portMAX_DELAY);
+    send(MSG_HEARTBEAT, flags, 0);
+    xSemaphoreGive(lock);
+}
+
+void DiscoveryPeers::send_resync() {
+    last_resync = xTaskGetTickCount();
+    xSemaphoreTake(lock, portMAX_DELAY);
+    send(MSG_RESYNC, 0, 0);
+    xSemaphoreGive(lock);
+}
+
+void DiscoveryPeers::send_snapshot() {
+    snapshot_wanted = false;
+    last_snapshot = xTaskGetTickCount();
+
+    // Held throughout, so no delta is numbered between the table copy and the last datagram
+    std::vector<Record> records;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    sink->peer_snapshot(records);
+    send_records(MSG_SNAPSHOT, records.data(), records.size());
+    xSemaphoreGive(lock);
+    ESP_LOGD(TAG, "Snapshot of %d devices sent", records.size());
+}
+
+void DiscoveryPeers::send_records(Type type, const Record* records, size_t count) {
+    // An empty snapshot still goes out, to end the followers' resync
+    size_t sent = 0;
+    do {
+        size_t batch = std::min(count - sent, RECORDS_PER_DATAGRAM);
+        memcpy(tx.records, records + sent, batch * sizeof(Record));
+        sent += batch;
+        uint8_t flags = FLAG_LEADER;
+        if (type == MSG_DELTA) {
+            seq++;
+        } else if (sent == count) {
+            flags |= FLAG_LAST;
+        }
+        send(type, flags, batch);
+    } while (sent < count);
+}
+
+bool DiscoveryPeers::send(Type type, uint8_t flags, size_t count) {
+    if (sock < 0) {
+        return false;
+    }
+
+    tx.header.magic = MAGIC;
+    tx.header.version = VERSION;
+    tx.header.type = type;
+    tx.header.flags = flags;
+    tx.header.count = count;
+    tx.header.unit = unit;
+    tx.header.seq = seq;
+
+    struct sockaddr_in group = {};
+    group.sin_family = AF_INET;
+    group.sin_port = htons(GROUP_PORT);
+    inet_aton(GROUP_ADDRESS, &group.sin_addr);
+    size_t length = sizeof(Header) + count * sizeof(Record);
+    if (sendto(sock, &tx, length, 0, (struct sockaddr*)&group, sizeof(group)) < 0) {
+        ESP_LOGD(TAG, "Peer datagram not sent: errno %d", errno);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+/**
+ * DiscoveryPeers - one discovery leader for all the ESPCaster units on a LAN
+ *
+ * Features:
+ * - Each unit advertises itself as _espcaster._udp over mDNS, its unit id
+ *   (the STA MAC) and current role in the TXT record
+ * - Heartbeats on a multicast group elect a leader: a live leader is kept,
+ *   and when none is heard for LEADER_TIMEOUT_MS the lowest unit id heard
+ *   takes over; of two leaders that hear each other, the higher steps down
+ * - The leader sweeps, refreshes and probes as a lone unit would and sends
+ *   each device table change as a numbered delta; followers merge them into
+ *   their own tables and send nothing to the speakers themselves
+ * - A follower that misses a delta (a gap in the numbers, or a heartbeat
+ *   ahead of it) asks for a snapshot; the leader also sends one every
+ *   SNAPSHOT_INTERVAL_MS, which keeps the followers' records from expiring
+ * - A follower with its device list on screen says so in its heartbeat,
+ *   and the leader sweeps as if its own list were on screen
+ *
+ * Until a leader is known the unit discovers on its own, as it does when
+ * the leader goes quiet; its table stays as the leader left it meanwhile.
+ */
+class DiscoveryPeers {
+public:
+    static constexpr size_t UUID_LEN = 33;
+    static constexpr size_t NAME_LEN = 64;
+    static constexpr size_t MODEL_LEN = 32;
+    static constexpr size_t STATUS_LEN = 48;
+    static constexpr uint32_t SNAPSHOT_INTERVAL_MS = 60000;
+    // Records from the leader outlive two lost snapshots
+    static constexpr uint32_t RECORD_TTL_MS = 3 * SNAPSHOT_INTERVAL_MS;
+
+    enum Op : uint8_t {
+        OP_UPSERT,
+        OP_REMOVE
+    };
+
+    // One device table record on the wire
+    struct Record {
+        uint8_t op;
+        uint8_t protocol;           // ChromecastDeviceTable::Protocol
+        uint16_t port;
+        uint32_t ipv4;              // Network byte order
+        uint32_t capabilities;
+        char uuid[UUID_LEN];
+        char name[NAME_LEN];
+        char instance_name[NAME_LEN];
+        char model[MODEL_LEN];
+        char status[STATUS_LEN];
+    } __attribute__((packed));
+
+    // Implemented by ChromecastDiscovery; called on the peers task
+    class Sink {
+    public:
+        // Changes from the leader, while following
+        virtual void peer_apply(const Record* records, size_t count) = 0;
+        // The whole table, confirmed records only, while leading
+        virtual void peer_snapshot(std::vector<Record>& records) = 0;
+        // Following a leader, or back to discovering alone
+        virtual void peer_role(bool following) = 0;
+        // The device list is on screen here
+        virtual bool peer_watching() = 0;
+
+    protected:
+        ~Sink() = default;
+    };
+
+    DiscoveryPeers();
+    ~DiscoveryPeers();
+
+    // After mdns_init(); the sink must outlive stop()
+    bool start(Sink* sink);
+    // Waits for the peers task to end; the sink is not called after
+    void stop();
+
+    // Any task; sent only while leading, and only once a follower has been heard
+    void publish(const Record* records, size_t count);
+
+    // Any task
+    bool following() const { return role.load() == ROLE_FOLLOWER; }
+    bool leading() const { return role.load() == ROLE_LEADER; }
+    // A follower has its device list on screen
+    bool remote_watching() const { return watching_peers.load(); }
+
+private:
+    static constexpr const char* GROUP_ADDRESS = "239.255.67.83";
+    static constexpr uint16_t GROUP_PORT = 45680;
+    static constexpr uint8_t MULTICAST_TTL = 1;         // The site's own subnet
+    static constexpr const char* MDNS_SERVICE = "_espcaster";
+    static constexpr const char* MDNS_PROTOCOL = "_udp";
+    static constexpr uint32_t MAGIC = 0x50444345;       // "ECDP"
+    static constexpr uint8_t VERSION = 1;
+    static constexpr uint32_t HEARTBEAT_MS = 2000;
+    static constexpr uint32_t LEADER_TIMEOUT_MS = 3 * HEARTBEAT_MS;
+    static constexpr uint32_t SNAPSHOT_MIN_GAP_MS = 1000;   // Resync requests answered at most this often
+    static constexpr uint32_t RESYNC_MIN_GAP_MS = 2000;
+    static constexpr uint32_t POLL_MS = 250;
+    static constexpr size_t MAX_PEERS = 8;
+    static constexpr size_t RECORDS_PER_DATAGRAM = 5;   // Stays under one Ethernet MTU
+    static constexpr uint32_t TASK_STACK_SIZE = 4096;
+
+    enum Role : uint8_t {
+        ROLE_ELECTING,      // No leader heard yet: discovering alone
+        ROLE_LEADER,
+        ROLE_FOLLOWER
+    };
+
+    enum Type : uint8_t {
+        MSG_HEARTBEAT,
+        MSG_DELTA,
+        MSG_SNAPSHOT,
+        MSG_RESYNC          // Follower to leader: send a snapshot
+    };
+
+    enum Flags : uint8_t {
+        FLAG_LEADER = 1 << 0,
+        FLAG_WATCHING = 1 << 1,
+        FLAG_LAST = 1 << 2      // Last datagram of a snapshot
+    };
+
+    struct Header {
+        uint32_t magic;
+        uint8_t version;
+        uint8_t type;
+        uint8_t flags;
+        uint8_t count;          // Records after the header
+        uint64_t unit;
+        uint32_t seq;           // Leader: the last delta sent; a delta: its own number
+    } __attribute__((packed));
+
+    struct Datagram {
+        Header header;
+        Record records[RECORDS_PER_DATAGRAM];
+    } __attribute__((packed));
+
+    struct Peer {
+        uint64_t unit;
+        TickType_t last_heard;
+        bool watching;
+    };
+
+    Sink* sink;
+    volatile bool stopping;
+    SemaphoreHandle_t idle;         // Taken while the task runs
+    StaticSemaphore_t idle_buffer;
+    SemaphoreHandle_t lock;         // Socket and sequence, shared with publish()
+    StaticSemaphore_t lock_buffer;
+
+    int sock;
+    uint32_t joined_ip;
+    uint64_t unit;
+    std::atomic<uint8_t> role;
+    std::atomic<bool> watching_peers;
+    std::atomic<bool> peers_heard;
+    bool advertised;
+
+    // Peers task only, but for seq (under lock)
+    Peer peers[MAX_PEERS];
+    size_t peer_count;
+    uint64_t leader;
+    TickType_t leader_heard;
+    TickType_t electing_since;
+    uint32_t seq;                   // Leading: deltas sent; following: deltas applied
+    bool in_sync;
+    TickType_t last_heartbeat;
+    TickType_t last_snapshot;
+    TickType_t last_resync;
+    bool snapshot_wanted;
+
+    // Off the task stack; tx under lock
+    Datagram rx;
+    Datagram tx;
+
+    static const char* role_name(uint8_t role);
+    static void peers_task(void* parameter);
+    void run();
+    bool open_socket(uint32_t ip);
+    void close_socket();
+    static uint32_t station_ip();
+    void advertise();
+    void set_role(Role next, uint64_t leader_unit);
+
+    void receive();
+    void handle(Datagram& datagram);
+    void heard(uint64_t from, bool watching);
+    void expire_peers(TickType_t now);
+    void elect(TickType_t now);
+
+    void send_heartbeat();
+    void send_snapshot();
+    void send_resync();
+    void send_records(Type type, const Record* records, size_t count);
+    bool send(Type type, uint8_t flags, size_t count);
+};
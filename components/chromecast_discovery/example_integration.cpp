@@ -47,8 +47,9 @@ void chromecast_integration_example_task(void* parameter) {
         }
     });
     
-    controller.set_message_callback([](const std::string& namespace_str, const std::string& payload) {
-        ESP_LOGI(TAG, "Message from %s: %s", namespace_str.c_str(), payload.c_str());
+    controller.set_message_callback([](std::string_view namespace_str, std::string_view payload) {
+        ESP_LOGI(TAG, "Message from %.*s: %.*s", (int)namespace_str.length(), namespace_str.data(),
+                 (int)payload.length(), payload.data());
     });
     
     controller.set_volume_callback([](const ChromecastController::VolumeInfo& volume) {
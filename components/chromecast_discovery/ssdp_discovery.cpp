@@ -0,0 +1,434 @@
+#include "ssdp_discovery.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include "chromecast_discovery.h"
+#include "mem_task.h"
+#include "task_plan.h"
+
+static const char* TAG = "SsdpDiscovery";
+
+SsdpDiscovery::SsdpDiscovery()
+    : sink(nullptr)
+    , stopping(false)
+    , timeout_ms(0)
+{
+    idle = xSemaphoreCreateBinaryStatic(&idle_buffer);
+    xSemaphoreGive(idle);
+}
+
+SsdpDiscovery::~SsdpDiscovery() {
+    stop();
+}
+
+bool SsdpDiscovery::start_search(uint32_t timeout_ms, Sink* sink) {
+    if (xSemaphoreTake(idle, 0) != pdTRUE) {
+        return false;   // The last search is still describing what it found
+    }
+
+    this->sink = sink;
+    this->timeout_ms = timeout_ms;
+    stopping = false;
+
+    // PSRAM stack: sockets and plain HTTP only, nothing that reaches flash
+    if (!mem_task_create(search_task, "ssdp_search", TASK_STACK_SIZE, this, TASK_PLAN_DISCOVERY_PRIORITY,
+                         nullptr, TASK_PLAN_NETWORK_CORE, MEM_TASK_STACK_PSRAM)) {
+        ESP_LOGE(TAG, "Failed to create SSDP search task");
+        xSemaphoreGive(idle);
+        return false;
+    }
+    return true;
+}
+
+void SsdpDiscovery::stop() {
+    stopping = true;
+    xSemaphoreTake(idle, portMAX_DELAY);
+    xSemaphoreGive(idle);
+}
+
+void SsdpDiscovery::search_task(void* parameter) {
+    SsdpDiscovery* ssdp = static_cast<SsdpDiscovery*>(parameter);
+    ssdp->search();
+
+    // Nothing of ssdp is touched past this: stop() may return and delete it
+    xSemaphoreGive(ssdp->idle);
+    mem_task_delete(nullptr);
+}
+
+void SsdpDiscovery::search() {
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        ESP_LOGW(TAG, "No socket for M-SEARCH: errno %d", errno);
+        return;
+    }
+    uint8_t ttl = MULTICAST_TTL;
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+    struct sockaddr_in group = {};
+    group.sin_family = AF_INET;
+    group.sin_port = htons(SSDP_PORT);
+    inet_aton(SSDP_ADDRESS, &group.sin_addr);
+
+    char request[256];
+    int length = snprintf(request, sizeof(request),
+                          "M-SEARCH * HTTP/1.1\r\n"
+                          "HOST: %s:%u\r\n"
+                          "MAN: \"ssdp:discover\"\r\n"
+                          "MX: %u\r\n"
+                          "ST: %s\r\n"
+                          "USER-AGENT: ESP-IDF UPnP/1.1 ESPCaster/1.0\r\n"
+                          "\r\n",
+                          SSDP_ADDRESS, (unsigned)SSDP_PORT, (unsigned)SEARCH_MX_S, SEARCH_TARGET);
+
+    // Answers come to this socket's port, unicast, while the search is repeated
+    for (int i = 0; i < SEARCH_REPEAT && !stopping; i++) {
+        if (sendto(sock, request, length, 0, (struct sockaddr*)&group, sizeof(group)) < 0) {
+            ESP_LOGW(TAG, "M-SEARCH not sent: errno %d", errno);
+        }
+        if (i + 1 < SEARCH_REPEAT) {
+            vTaskDelay(pdMS_TO_TICKS(SEARCH_GAP_MS));
+        }
+    }
+
+    std::vector<Pending> pending;
+    receive(sock, pending);
+    close(sock);
+
+    // Descriptions one at a time, after the window, so no answer is missed waiting on HTTP
+    for (const Pending& device : pending) {
+        if (stopping) {
+            break;
+        }
+        describe(device);
+    }
+    ESP_LOGD(TAG, "Search done, %d renderers described", pending.size());
+}
+
+void SsdpDiscovery::receive(int sock, std::vector<Pending>& pending) {
+    char buffer[MAX_RESPONSE + 1];
+    std::vector<uint32_t> seen;
+
+    TickType_t start = xTaskGetTickCount();
+    TickType_t window = pdMS_TO_TICKS(timeout_ms);
+    while (!stopping) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= window) {
+            break;
+        }
+
+        // Short waits, so stop() is not held up by the whole window
+        uint32_t wait_ms = std::min<uint32_t>(pdTICKS_TO_MS(window - elapsed), 250);
+        fd_set read_set;
+        FD_ZERO(&read_set);
+        FD_SET(sock, &read_set);
+        struct timeval tv = { .tv_sec = (long)(wait_ms / 1000), .tv_usec = (long)((wait_ms % 1000) * 1000) };
+        int ready = select(sock + 1, &read_set, nullptr, nullptr, &tv);
+        if (ready < 0) {
+            break;
+        }
+        if (ready == 0) {
+            continue;
+        }
+
+        struct sockaddr_in from = {};
+        socklen_t from_length = sizeof(from);
+        ssize_t received = recvfrom(sock, buffer, MAX_RESPONSE, 0, (struct sockaddr*)&from, &from_length);
+        if (received > 0) {
+            buffer[received] = '\0';
+            handle_response(buffer, (size_t)received, from.sin_addr.s_addr, pending, seen);
+        }
+    }
+}
+
+void SsdpDiscovery::handle_response(char* data, size_t length, uint32_t sender, std::vector<Pending>& pending,
+                                    std::vector<uint32_t>& seen) {
+    Response response;
+    if (!parse_response(data, length, response)) {
+        return;
+    }
+
+    // USN is uuid:<UDN>[::<type>]; a renderer answers once per device and service it has
+    const char* usn = response.usn;
+    if (strncmp(usn, "uuid:", 5) != 0) {
+        return;
+    }
+    const char* type = strstr(usn, "::");
+    size_t udn_length = type ? (size_t)(type - usn) : strlen(usn);
+    uint32_t hash = hash_udn(usn, udn_length);
+    if (std::find(seen.begin(), seen.end(), hash) != seen.end()) {
+        return;
+    }
+    seen.push_back(hash);
+
+    Pending device;
+    if (!parse_location(response.location, &device.ipv4, &device.port)) {
+        return;
+    }
+    if (device.ipv4 == 0) {
+        device.ipv4 = sender;   // A host name: the answer came from the renderer itself
+    }
+    device.udn.assign(usn, udn_length);
+    device.location = response.location;
+    device.max_age_s = response.max_age_s;
+
+    if (sink->backend_knows(device.udn.c_str())) {
+        report(device, nullptr, nullptr);
+    } else if (pending.size() < MAX_DESCRIPTIONS) {
+        pending.push_back(std::move(device));
+    }
+}
+
+void SsdpDiscovery::describe(const Pending& device) {
+    DescriptionScanner scanner;
+    if (!fetch_description(device.location.c_str(), scanner) || !scanner.friendly_name[0]) {
+        ESP_LOGW(TAG, "No description from %s", device.location.c_str());
+        return;     // Asked for again by the next search
+    }
+
+    ESP_LOGI(TAG, "Renderer %s (%s) at %s", scanner.friendly_name, scanner.model_name, device.location.c_str());
+    report(device, scanner.friendly_name, scanner.model_name);
+}
+
+void SsdpDiscovery::report(const Pending& device, const char* friendly_name, const char* model_name) {
+    if (stopping) {
+        return;
+    }
+
+    ChromecastDeviceTable::Answer answer = {};
+    answer.protocol = ChromecastDeviceTable::PROTOCOL_UPNP;
+    answer.instance_name = device.udn.c_str();
+    answer.uuid = device.udn.c_str() + 5;      // Past "uuid:"
+    answer.name = friendly_name;
+    answer.model = model_name;
+    answer.ipv4 = device.ipv4;
+    answer.port = device.port;
+    answer.ttl_ms = std::min<uint32_t>(device.max_age_s, 24 * 3600) * 1000;
+    answer.has_capabilities = true;
+    answer.capabilities = ChromecastDiscovery::DeviceInfo::CAP_AUDIO_OUT;
+    sink->backend_answer(answer);
+}
+
+bool SsdpDiscovery::parse_response(char* data, size_t length, Response& response) {
+    response = { nullptr, nullptr, DEFAULT_MAX_AGE_S };
+
+    // Each line is cut in place as it is reached; the status line first,
+    // then the headers up to the blank line
+    char* line = data;
+    char* limit = data + length;
+    bool status_seen = false;
+    while (line < limit) {
+        char* newline = static_cast<char*>(memchr(line, '\n', limit - line));
+        char* next = newline ? newline + 1 : limit;
+        char* end = newline ? newline : limit;
+        if (end > line && end[-1] == '\r') {
+            end--;
+        }
+        *end = '\0';
+
+        if (!status_seen) {
+            // NOTIFYs and other hosts' M-SEARCHes are not answers
+            if (strncmp(line, "HTTP/1.", 7) != 0 || strncmp(line + 8, " 200", 4) != 0) {
+                return false;
+            }
+            status_seen = true;
+        } else if (*line == '\0') {
+            break;
+        } else if (char* colon = strchr(line, ':')) {
+            *colon = '\0';
+            char* value = colon + 1;
+            while (*value == ' ' || *value == '\t') {
+                value++;
+            }
+            if (strcasecmp(line, "LOCATION") == 0) {
+                response.location = value;
+            } else if (strcasecmp(line, "USN") == 0) {
+                response.usn = value;
+            } else if (strcasecmp(line, "CACHE-CONTROL") == 0) {
+                // max-age = <seconds>, possibly among other directives
+                for (const char* p = value; *p; p++) {
+                    if (strncasecmp(p, "max-age", 7) == 0) {
+                        const char* equals = strchr(p, '=');
+                        uint32_t max_age = equals ? strtoul(equals + 1, nullptr, 10) : 0;
+                        if (max_age > 0) {
+                            response.max_age_s = max_age;
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+        line = next;
+    }
+    return response.location && response.usn;
+}
+
+bool SsdpDiscovery::parse_location(const char* location, uint32_t* ipv4, uint16_t* port) {
+    // http://<host>[:<port>]/<path>; renderers give an IPv4 literal in practice
+    static const char prefix[] = "http://";
+    if (strncasecmp(location, prefix, sizeof(prefix) - 1) != 0) {
+        return false;
+    }
+    const char* host = location + sizeof(prefix) - 1;
+    size_t host_length = strcspn(host, ":/");
+
+    *ipv4 = 0;
+    char host_text[16];
+    struct in_addr addr;
+    if (host_length < sizeof(host_text)) {
+        memcpy(host_text, host, host_length);
+        host_text[host_length] = '\0';
+        if (inet_aton(host_text, &addr)) {
+            *ipv4 = addr.s_addr;
+        }
+    }
+
+    *port = 80;
+    if (host[host_length] == ':') {
+        unsigned long value = strtoul(host + host_length + 1, nullptr, 10);
+        if (value == 0 || value > 65535) {
+            return false;
+        }
+        *port = (uint16_t)value;
+    }
+    return true;
+}
+
+bool SsdpDiscovery::fetch_description(const char* location, DescriptionScanner& scanner) {
+    esp_http_client_config_t config = {};
+    config.url = location;
+    config.timeout_ms = DESCRIPTION_TIMEOUT_MS;
+
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (!client) {
+        return false;
+    }
+
+    bool ok = false;
+    if (esp_http_client_open(client, 0) == ESP_OK) {
+        esp_http_client_fetch_headers(client);
+        if (esp_http_client_get_status_code(client) == 200) {
+            // Hang up once both names are in: the service lists after them run to kilobytes
+            char chunk[DESCRIPTION_CHUNK];
+            size_t total = 0;
+            int n;
+            while (!scanner.complete() && total < DESCRIPTION_MAX_BYTES &&
+                   (n = esp_http_client_read(client, chunk, sizeof(chunk))) > 0) {
+                scanner.feed(chunk, (size_t)n);
+                total += n;
+            }
+            ok = true;
+        }
+    }
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    return ok;
+}
+
+uint32_t SsdpDiscovery::hash_udn(const char* udn, size_t length) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)udn[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void SsdpDiscovery::DescriptionScanner::feed(const char* data, size_t length) {
+    // Tags and text may be split anywhere between chunks; all state lives in the scanner
+    for (size_t i = 0; i < length; i++) {
+        char c = data[i];
+        if (in_tag) {
+            if (c == '>') {
+                end_tag();
+            } else if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '/') {
+                tag_name_done = true;   // A leading '/' leaves the name empty: closing tags never match
+            } else if (!tag_name_done) {
+                if (tag_length < TAG_LEN - 1) {
+                    tag[tag_length++] = c;
+                } else {
+                    tag_overflow = true;
+                }
+            }
+        } else if (c == '<') {
+            end_capture();
+            in_tag = true;
+            tag_name_done = false;
+            tag_overflow = false;
+            tag_length = 0;
+        } else if (capture && capture_length < capture_size - 1) {
+            capture[capture_length++] = c;
+        }
+    }
+}
+
+void SsdpDiscovery::DescriptionScanner::end_tag() {
+    in_tag = false;
+    tag[tag_length] = '\0';
+    if (tag_overflow) {
+        return;
+    }
+
+    if (strcmp(tag, "friendlyName") == 0 && !friendly_name[0]) {
+        capture = friendly_name;
+        capture_size = sizeof(friendly_name);
+    } else if (strcmp(tag, "modelName") == 0 && !model_name[0]) {
+        capture = model_name;
+        capture_size = sizeof(model_name);
+    } else {
+        return;
+    }
+    capture_length = 0;
+}
+
+void SsdpDiscovery::DescriptionScanner::end_capture() {
+    if (!capture) {
+        return;
+    }
+    capture[capture_length] = '\0';
+
+    // Plain text but for the predefined entities
+    static const struct {
+        const char* entity;
+        char value;
+    } entities[] = {
+        {"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}, {"&apos;", '\''},
+    };
+    char* out = capture;
+    for (const char* in = capture; *in;) {
+        bool replaced = false;
+        for (const auto& e : entities) {
+            size_t n = strlen(e.entity);
+            if (*in == '&' && strncmp(in, e.entity, n) == 0) {
+                *out++ = e.value;
+                in += n;
+                replaced = true;
+                break;
+            }
+        }
+        if (!replaced) {
+            *out++ = *in++;
+        }
+    }
+    *out = '\0';
+
+    // A name cut at the buffer end must not end in half a UTF-8 character
+    size_t end = out - capture;
+    size_t lead = end;
+    while (lead > 0 && ((uint8_t)capture[lead - 1] & 0xC0) == 0x80) {
+        lead--;
+    }
+    if (lead > 0 && ((uint8_t)capture[lead - 1] & 0x80)) {
+        uint8_t first = capture[lead - 1];
+        size_t needed = first >= 0xF0 ? 4 : first >= 0xE0 ? 3 : 2;
+        if (end - (lead - 1) < needed) {
+            capture[lead - 1] = '\0';
+        }
+    }
+    capture = nullptr;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "discovery_backend.h"
+
+/**
+ * SsdpDiscovery - UPnP/DLNA media renderers (Sonos included) found with SSDP
+ *
+ * Features:
+ * - M-SEARCH for urn:schemas-upnp-org:device:MediaRenderer:1, sent twice
+ *   against datagram loss, answers collected for the caller's timeout
+ * - Responses parsed in place in the receive buffer, one header line at a
+ *   time; duplicates (root and embedded devices answer alike) dropped by UDN
+ * - Device descriptions fetched lazily: only for renderers not yet in the
+ *   table, after the answer window, and read in small chunks through a tag
+ *   scanner that hangs up as soon as it has the friendly and model names
+ * - Known renderers are refreshed from the M-SEARCH answer alone, for the
+ *   CACHE-CONTROL max-age they announce
+ */
+class SsdpDiscovery : public DiscoveryBackend {
+public:
+    SsdpDiscovery();
+    ~SsdpDiscovery() override;
+
+    const char* name() const override { return "SSDP"; }
+    bool start_search(uint32_t timeout_ms, Sink* sink) override;
+    void stop() override;
+
+private:
+    static constexpr const char* SSDP_ADDRESS = "239.255.255.250";
+    static constexpr uint16_t SSDP_PORT = 1900;
+    static constexpr const char* SEARCH_TARGET = "urn:schemas-upnp-org:device:MediaRenderer:1";
+    static constexpr uint32_t SEARCH_MX_S = 2;              // Answers are spread over this
+    static constexpr int SEARCH_REPEAT = 2;
+    static constexpr uint32_t SEARCH_GAP_MS = 100;
+    static constexpr uint8_t MULTICAST_TTL = 2;             // As UDA 2.0 recommends
+    static constexpr size_t MAX_RESPONSE = 768;             // Longer datagrams are truncated
+    static constexpr uint32_t DEFAULT_MAX_AGE_S = 1800;
+    static constexpr size_t MAX_DESCRIPTIONS = 8;           // Fetched per search
+    static constexpr uint32_t DESCRIPTION_TIMEOUT_MS = 2000;
+    static constexpr size_t DESCRIPTION_CHUNK = 256;
+    static constexpr size_t DESCRIPTION_MAX_BYTES = 16384;  // Give up on the names past this
+    static constexpr uint32_t TASK_STACK_SIZE = 4096;
+
+    // An M-SEARCH answer; pointers into the receive buffer
+    struct Response {
+        const char* location;
+        const char* usn;
+        uint32_t max_age_s;
+    };
+
+    // A renderer heard from this search, described once the window is over
+    struct Pending {
+        std::string udn;
+        std::string location;
+        uint32_t ipv4;
+        uint16_t port;
+        uint32_t max_age_s;
+    };
+
+    // The few description fields kept, picked out of the XML as it arrives.
+    // The root device comes first, so the first occurrence of each wins.
+    class DescriptionScanner {
+    public:
+        static constexpr size_t FRIENDLY_NAME_LEN = 64;
+        static constexpr size_t MODEL_NAME_LEN = 32;
+
+        char friendly_name[FRIENDLY_NAME_LEN] = {};
+        char model_name[MODEL_NAME_LEN] = {};
+
+        void feed(const char* data, size_t length);
+        bool complete() const { return friendly_name[0] && model_name[0]; }
+
+    private:
+        static constexpr size_t TAG_LEN = 16;   // Longest tag matched, plus one
+
+        bool in_tag = false;
+        bool tag_name_done = false;     // Past the name, in attributes
+        bool tag_overflow = false;
+        char tag[TAG_LEN] = {};
+        size_t tag_length = 0;
+        char* capture = nullptr;
+        size_t capture_length = 0;
+        size_t capture_size = 0;
+
+        void end_tag();
+        void end_capture();
+    };
+
+    Sink* sink;
+    volatile bool stopping;
+    uint32_t timeout_ms;
+    SemaphoreHandle_t idle;         // Taken while a search runs
+    StaticSemaphore_t idle_buffer;
+
+    static void search_task(void* parameter);
+    void search();
+    void receive(int sock, std::vector<Pending>& pending);
+    void handle_response(char* data, size_t length, uint32_t sender, std::vector<Pending>& pending,
+                         std::vector<uint32_t>& seen);
+    void describe(const Pending& device);
+    void report(const Pending& device, const char* friendly_name, const char* model_name);
+
+    static bool parse_response(char* data, size_t length, Response& response);
+    static bool parse_location(const char* location, uint32_t* ipv4, uint16_t* port);
+    static bool fetch_description(const char* location, DescriptionScanner& scanner);
+    static uint32_t hash_udn(const char* udn, size_t length);
+};
@@ -0,0 +1,511 @@
+#include "deferred_log.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mem_task.h"
+#include "task_plan.h"
+
+#if CONFIG_DEFERRED_LOG
+
+/*
+ * Record: length (2, own header included, 4-byte multiple), kind (1), then
+ * for RECORD_ENCODED the format pointer and each argument in the order the
+ * format takes them: 4 bytes for int, long, size_t and pointers, 8 for long
+ * long and double, and %s as its bytes and a terminator. RECORD_TEXT holds
+ * the formatted line itself. A length of 0 pads to the end of the ring.
+ */
+#define RECORD_HEADER           4
+#define RECORD_ENCODED          1
+#define RECORD_TEXT             2
+#define LINE_MAX                160     // Formatted per write; longer lines take several
+
+typedef struct {
+    uint8_t *buffer;
+    uint32_t size;                      // A power of two
+    uint32_t head;                      // Written by the core's own tasks, interrupts masked
+    uint32_t tail;                      // Written by the drain
+    uint32_t dropped;
+} log_ring_t;
+
+typedef enum {
+    ARG_NONE,                           // %%
+    ARG_INT,                            // 4 bytes
+    ARG_INT64,
+    ARG_DOUBLE,
+    ARG_STRING,
+    ARG_UNKNOWN,
+} arg_kind_t;
+
+// One conversion of a format: where it ends, what it takes, * width and precision
+typedef struct {
+    const char *end;                    // Just past the conversion character
+    arg_kind_t kind;
+    bool star_width;
+    bool star_precision;
+    int precision;                      // -1: none, or given by *
+} conversion_t;
+
+static log_ring_t rings[portNUM_PROCESSORS];
+static vprintf_like_t console_vprintf;
+static SemaphoreHandle_t drain_lock;
+static uint32_t dropped_reported;
+
+/* Parse the conversion starting at p (just past the '%') */
+static conversion_t Parse_Conversion(const char *p)
+{
+    conversion_t c = { .precision = -1 };
+    while (*p && strchr("-+ #0", *p)) {
+        p++;
+    }
+    if (*p == '*') {
+        c.star_width = true;
+        p++;
+    }
+    while (*p >= '0' && *p <= '9') {
+        p++;
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            c.star_precision = true;
+            p++;
+        } else {
+            c.precision = 0;
+        }
+        while (*p >= '0' && *p <= '9') {
+            c.precision = c.precision * 10 + (*p++ - '0');
+        }
+    }
+
+    int longs = 0;
+    bool wide = false;                  // intmax_t
+    while (*p && strchr("hlzjtL", *p)) {
+        longs += *p == 'l';
+        wide |= *p == 'j';
+        if (*p == 'L') {
+            c.kind = ARG_UNKNOWN;
+        }
+        p++;
+    }
+    char conversion = *p;
+    c.end = conversion ? p + 1 : p;
+    if (c.kind == ARG_UNKNOWN) {
+        return c;
+    }
+
+    switch (conversion) {
+    case '%':
+        c.kind = ARG_NONE;
+        break;
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+        c.kind = longs >= 2 || wide ? ARG_INT64 : ARG_INT;
+        break;
+    case 'p':
+        c.kind = ARG_INT;
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        c.kind = ARG_DOUBLE;
+        break;
+    case 's':
+        c.kind = longs ? ARG_UNKNOWN : ARG_STRING;
+        break;
+    default:
+        c.kind = ARG_UNKNOWN;
+        break;
+    }
+    return c;
+}
+
+/* The record for format and args in out, or 0 if it needs formatting here */
+static size_t Encode(uint8_t *out, const char *format, va_list args)
+{
+    uint8_t *p = out + RECORD_HEADER, *end = out + DEFERRED_LOG_RECORD_MAX;
+    memcpy(p, &format, sizeof(format));
+    p += sizeof(format);
+
+    for (const char *f = strchr(format, '%'); f; f = strchr(f, '%')) {
+        conversion_t c = Parse_Conversion(f + 1);
+        f = c.end;
+        if (c.kind == ARG_UNKNOWN || end - p < 2 * 4 + 8) {
+            return 0;
+        }
+        int precision = c.precision;
+        if (c.star_width) {
+            int width = va_arg(args, int);
+            memcpy(p, &width, 4);
+            p += 4;
+        }
+        if (c.star_precision) {
+            precision = va_arg(args, int);
+            memcpy(p, &precision, 4);
+            p += 4;
+        }
+
+        switch (c.kind) {
+        case ARG_INT: {
+            uint32_t value = va_arg(args, uint32_t);
+            memcpy(p, &value, 4);
+            p += 4;
+            break;
+        }
+        case ARG_INT64: {
+            uint64_t value = va_arg(args, uint64_t);
+            memcpy(p, &value, 8);
+            p += 8;
+            break;
+        }
+        case ARG_DOUBLE: {
+            double value = va_arg(args, double);
+            memcpy(p, &value, 8);
+            p += 8;
+            break;
+        }
+        case ARG_STRING: {
+            const char *s = va_arg(args, const char *);
+            if (!s) {
+                s = "(null)";
+            }
+            // A precision may bound a string that has no terminator
+            size_t limit = precision >= 0 && precision < DEFERRED_LOG_STRING_MAX ?
+                           (size_t)precision : DEFERRED_LOG_STRING_MAX;
+            size_t length = strnlen(s, limit);
+            if ((size_t)(end - p) < length + 1) {
+                return 0;
+            }
+            memcpy(p, s, length);
+            p[length] = '\0';
+            p += length + 1;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    size_t length = (p - out + 3) & ~(size_t)3;
+    out[0] = (uint8_t)length;
+    out[1] = (uint8_t)(length >> 8);
+    out[2] = RECORD_ENCODED;
+    return length;
+}
+
+static size_t Encode_Text(uint8_t *out, const char *format, va_list args)
+{
+    int text = vsnprintf((char *)out + RECORD_HEADER, DEFERRED_LOG_RECORD_MAX - RECORD_HEADER, format, args);
+    if (text < 0) {
+        return 0;
+    }
+    size_t length = RECORD_HEADER + ((size_t)text < DEFERRED_LOG_RECORD_MAX - RECORD_HEADER ?
+                                     (size_t)text + 1 : DEFERRED_LOG_RECORD_MAX - RECORD_HEADER);
+    length = (length + 3) & ~(size_t)3;
+    if (length > DEFERRED_LOG_RECORD_MAX) {
+        length = DEFERRED_LOG_RECORD_MAX;
+    }
+    out[0] = (uint8_t)length;
+    out[1] = (uint8_t)(length >> 8);
+    out[2] = RECORD_TEXT;
+    return length;
+}
+
+static int Deferred_Vprintf(const char *format, va_list args)
+{
+    uint8_t record[DEFERRED_LOG_RECORD_MAX];
+    va_list copy;
+    va_copy(copy, args);
+    size_t length = Encode(record, format, args);
+    if (!length) {
+        length = Encode_Text(record, format, copy);
+    }
+    va_end(copy);
+    if (!length) {
+        return 0;
+    }
+
+    // Masking this core's interrupts keeps its other tasks out; the other
+    // core has a ring of its own
+    UBaseType_t state = portSET_INTERRUPT_MASK_FROM_ISR();
+    log_ring_t *ring = &rings[esp_cpu_get_core_id()];
+    uint32_t head = ring->head;
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint32_t offset = head & (ring->size - 1);
+    uint32_t to_end = ring->size - offset;
+    uint32_t needed = length <= to_end ? length : length + to_end;
+    if (ring->size - (head - tail) < needed) {
+        ring->dropped++;
+        portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+        return 0;
+    }
+    if (length > to_end) {
+        memset(ring->buffer + offset, 0, 2);
+        head += to_end;
+        offset = 0;
+    }
+    memcpy(ring->buffer + offset, record, length);
+    __atomic_store_n(&ring->head, head + length, __ATOMIC_RELEASE);
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+    return (int)length;
+}
+
+static void Console_Write(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    console_vprintf(format, args);
+    va_end(args);
+}
+
+typedef struct {
+    char text[LINE_MAX];
+    size_t used;
+} line_t;
+
+static void Line_Flush(line_t *line)
+{
+    if (line->used) {
+        Console_Write("%.*s", (int)line->used, line->text);
+        line->used = 0;
+    }
+}
+
+static void Line_Append(line_t *line, const char *spec, ...)
+{
+    for (int attempt = 0; attempt < 2; attempt++) {
+        va_list args;
+        va_start(args, spec);
+        size_t room = sizeof(line->text) - line->used;
+        int written = vsnprintf(line->text + line->used, room, spec, args);
+        va_end(args);
+        if (written < 0) {
+            return;
+        }
+        if ((size_t)written < room) {
+            line->used += written;
+            return;
+        }
+        if (!line->used) {
+            // Longer than a whole line on its own: cut
+            line->used = sizeof(line->text) - 1;
+            return;
+        }
+        Line_Flush(line);
+    }
+}
+
+/* Append the literal text from start to end, in line-sized pieces */
+static void Line_Literal(line_t *line, const char *start, const char *end)
+{
+    while (start < end) {
+        size_t room = sizeof(line->text) - 1 - line->used;
+        size_t length = (size_t)(end - start) < room ? (size_t)(end - start) : room;
+        memcpy(line->text + line->used, start, length);
+        line->used += length;
+        start += length;
+        if (start < end) {
+            Line_Flush(line);
+        }
+    }
+}
+
+static int32_t Take_Int(const uint8_t **p)
+{
+    int32_t value;
+    memcpy(&value, *p, 4);
+    *p += 4;
+    return value;
+}
+
+static void Decode(const uint8_t *record, size_t length)
+{
+    line_t line = { .used = 0 };
+    const uint8_t *p = record + RECORD_HEADER;
+    if (record[2] == RECORD_TEXT) {
+        Line_Literal(&line, (const char *)p, (const char *)p + strnlen((const char *)p, length - RECORD_HEADER));
+        Line_Flush(&line);
+        return;
+    }
+
+    const char *format;
+    memcpy(&format, p, sizeof(format));
+    p += sizeof(format);
+    const char *literal = format;
+    for (const char *f = strchr(format, '%'); f; f = strchr(f, '%')) {
+        Line_Literal(&line, literal, f);
+        conversion_t c = Parse_Conversion(f + 1);
+
+        // The conversion again with the * values written in
+        char spec[32];
+        size_t used = 0;
+        for (const char *s = f; s < c.end && used < sizeof(spec) - 12; s++) {
+            if (*s != '*') {
+                spec[used++] = *s;
+                continue;
+            }
+            int value = Take_Int(&p);
+            if (s[-1] == '.' && value < 0) {
+                used--;                 // A negative precision is none
+            } else {
+                used += snprintf(spec + used, sizeof(spec) - used, "%d", value);
+            }
+        }
+        spec[used] = '\0';
+
+        switch (c.kind) {
+        case ARG_NONE:
+            Line_Append(&line, "%%");
+            break;
+        case ARG_INT:
+            Line_Append(&line, spec, (uint32_t)Take_Int(&p));
+            break;
+        case ARG_INT64: {
+            uint64_t value;
+            memcpy(&value, p, 8);
+            p += 8;
+            Line_Append(&line, spec, value);
+            break;
+        }
+        case ARG_DOUBLE: {
+            double value;
+            memcpy(&value, p, 8);
+            p += 8;
+            Line_Append(&line, spec, value);
+            break;
+        }
+        case ARG_STRING:
+            Line_Append(&line, spec, (const char *)p);
+            p += strlen((const char *)p) + 1;
+            break;
+        default:
+            break;
+        }
+        f = literal = c.end;
+    }
+    Line_Literal(&line, literal, literal + strlen(literal));
+    Line_Flush(&line);
+}
+
+/* Write out what ring holds; false if it was empty */
+static bool Drain_Ring(log_ring_t *ring)
+{
+    uint32_t tail = ring->tail;
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (tail == head) {
+        return false;
+    }
+    while (tail != head) {
+        uint32_t offset = tail & (ring->size - 1);
+        const uint8_t *record = ring->buffer + offset;
+        size_t length = record[0] | (record[1] << 8);
+        if (!length) {
+            tail += ring->size - offset;
+            continue;
+        }
+        Decode(record, length);
+        tail += length;
+        // Frees the space as it goes, so a long drain does not drop lines
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    return true;
+}
+
+static bool Drain(void)
+{
+    bool any = false;
+    xSemaphoreTake(drain_lock, portMAX_DELAY);
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        any |= Drain_Ring(&rings[core]);
+    }
+    uint32_t dropped = deferred_log_dropped();
+    if (dropped != dropped_reported) {
+        Console_Write("W (%lu) log: %lu lines dropped\n", (unsigned long)esp_log_timestamp(),
+                      (unsigned long)(dropped - dropped_reported));
+        dropped_reported = dropped;
+    }
+    xSemaphoreGive(drain_lock);
+    return any;
+}
+
+static void Drain_Task(void *parameter)
+{
+    for (;;) {
+        if (!Drain()) {
+            vTaskDelay(pdMS_TO_TICKS(DEFERRED_LOG_POLL_MS));
+        }
+    }
+}
+
+bool deferred_log_init(void)
+{
+    if (console_vprintf) {
+        return true;
+    }
+    // Rounded down to a power of two, so positions wrap with a mask
+    uint32_t size = 1u << (31 - __builtin_clz(CONFIG_DEFERRED_LOG_RING_KB * 1024));
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        rings[core].buffer = heap_caps_malloc_prefer(size, 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT,
+                                                     MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (!rings[core].buffer) {
+            return false;
+        }
+        rings[core].size = size;
+    }
+    drain_lock = xSemaphoreCreateMutex();
+    if (!drain_lock) {
+        return false;
+    }
+
+    console_vprintf = esp_log_set_vprintf(Deferred_Vprintf);
+    // The console may block on the host, so the drain writes with an internal stack
+    if (!mem_task_create(Drain_Task, "Log drain", DEFERRED_LOG_STACK_SIZE, NULL, TASK_PLAN_LOG_PRIORITY,
+                         NULL, TASK_PLAN_BACKGROUND_CORE, MEM_TASK_STACK_INTERNAL)) {
+        esp_log_set_vprintf(console_vprintf);
+        console_vprintf = NULL;
+        return false;
+    }
+    esp_register_shutdown_handler(deferred_log_flush);
+    return true;
+}
+
+void deferred_log_flush(void)
+{
+    if (console_vprintf) {
+        Drain();
+    }
+}
+
+uint32_t deferred_log_dropped(void)
+{
+    uint32_t dropped = 0;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        dropped += rings[core].dropped;
+    }
+    return dropped;
+}
+
+#else
+
+bool deferred_log_init(void)
+{
+    return false;
+}
+
+void deferred_log_flush(void)
+{
+}
+
+uint32_t deferred_log_dropped(void)
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Deferred log - ESP_LOGx lines formatted off the calling task
+ *
+ * deferred_log_init() puts itself behind esp_log_set_vprintf(). A log call
+ * then only encodes a record - the format pointer and the argument values,
+ * strings copied - and appends it to a ring of the core it runs on, with
+ * that core's interrupts masked for the copy: no lock is shared between
+ * the cores and nothing waits for the console. A background task takes
+ * the records in order, formats them and writes them through the previous
+ * vprintf. When a ring is full the line is dropped and counted; the drain
+ * reports the count in a line of its own.
+ *
+ * A format with a conversion the encoder does not know (%n, %ls, %Lf) is
+ * formatted on the calling task into the record instead, and so is a line
+ * whose arguments do not fit one record; either way it still comes out in
+ * order. The two cores' lines are interleaved by when the drain reaches
+ * them, not strictly by time; each keeps the timestamp it was logged with.
+ *
+ * Lines still queued are written out by deferred_log_flush(), which is
+ * also registered as a shutdown handler for esp_restart(). A panic prints
+ * straight to the console and loses them.
+ */
+
+#define DEFERRED_LOG_RECORD_MAX     256     // Bytes per record, arguments and copied strings included
+#define DEFERRED_LOG_STRING_MAX     120     // Longest %s kept; longer ones are cut
+#define DEFERRED_LOG_POLL_MS        20      // How often the drain looks at empty rings
+#define DEFERRED_LOG_STACK_SIZE     3072
+
+/**
+ * @brief Take over ESP_LOGx output; lines logged before stay synchronous
+ * @return false if the rings or the task could not be made (logging goes on
+ *         synchronously)
+ */
+bool deferred_log_init(void);
+
+/**
+ * @brief Write out every queued line on the calling task, before it returns
+ */
+void deferred_log_flush(void);
+
+/**
+ * @brief Lines dropped on full rings since boot
+ */
+uint32_t deferred_log_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
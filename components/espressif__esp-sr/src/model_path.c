@@ -385,6 +385,47 @@ srmodel_list_t *srmodel_load(const void *root)
     return models;
 }
 
+// End of the packed image (the last file's start + size), read from its header
+// so only the image is mapped, not the unused tail of the partition.
+static uint32_t srmodel_image_size(const esp_partition_t *partition)
+{
+    uint32_t offset = 0;
+    uint32_t end = 0;
+    uint8_t word[4];
+    if (esp_partition_read(partition, offset, word, 4) != ESP_OK) {
+        return 0;
+    }
+    int model_num = read_int32((char *)word);
+    offset += 4;
+    for (int i = 0; i < model_num; i++) {
+        offset += SRMODEL_STRING_LENGTH;
+        if (esp_partition_read(partition, offset, word, 4) != ESP_OK) {
+            return 0;
+        }
+        int file_num = read_int32((char *)word);
+        offset += 4;
+        for (int j = 0; j < file_num; j++) {
+            uint8_t entry[8];
+            offset += SRMODEL_STRING_LENGTH;
+            if (esp_partition_read(partition, offset, entry, 8) != ESP_OK) {
+                return 0;
+            }
+            uint32_t file_end = read_int32((char *)entry) + read_int32((char *)entry + 4);
+            if (file_end > end) {
+                end = file_end;
+            }
+            offset += 8;
+        }
+        if (offset > partition->size) {
+            return 0;
+        }
+    }
+    if (end < offset || end > partition->size) {
+        return 0;
+    }
+    return end;
+}
+
 srmodel_list_t *srmodel_mmap_init(const esp_partition_t *partition)
 {
     if (static_srmodels == NULL) {
@@ -395,27 +436,32 @@ srmodel_list_t *srmodel_mmap_init(const esp_partition_t *partition)
 
     srmodel_list_t *models = static_srmodels;
     const void *root;
+    uint32_t image_size = srmodel_image_size(partition);
+    if (image_size == 0) {
+        ESP_LOGW(TAG, "Can not read the model header, mapping the whole %s partition", partition->label);
+        image_size = partition->size;
+    }
 
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
     int free_pages = spi_flash_mmap_get_free_pages(ESP_PARTITION_MMAP_DATA);
     uint32_t storage_size = free_pages * 64 * 1024; // Byte
     ESP_LOGI(TAG, "The storage free size is %ld KB", storage_size / 1024);
-    ESP_LOGI(TAG, "The partition size is %ld KB", partition->size / 1024);
-    if (storage_size < partition->size) {
+    ESP_LOGI(TAG, "The partition size is %ld KB, the models use %ld KB", partition->size / 1024, image_size / 1024);
+    if (storage_size < image_size) {
         ESP_LOGE(TAG, "The storage free size of this board is less than %s partition required size", partition->label);
     }
     models->mmap_handle = (esp_partition_mmap_handle_t*)malloc(sizeof(esp_partition_mmap_handle_t));
-    ESP_ERROR_CHECK(esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &root, models->mmap_handle));
+    ESP_ERROR_CHECK(esp_partition_mmap(partition, 0, image_size, ESP_PARTITION_MMAP_DATA, &root, models->mmap_handle));
 #else
     int free_pages = spi_flash_mmap_get_free_pages(SPI_FLASH_MMAP_DATA);
     uint32_t storage_size = free_pages * 64 * 1024; // Byte
     ESP_LOGI(TAG, "The storage free size is %d KB", storage_size / 1024);
-    ESP_LOGI(TAG, "The partition size is %d KB", partition->size / 1024);
-    if (storage_size < partition->size) {
+    ESP_LOGI(TAG, "The partition size is %d KB, the models use %d KB", partition->size / 1024, image_size / 1024);
+    if (storage_size < image_size) {
         ESP_LOGE(TAG, "The storage free size of board is less than %s partition size", partition->label);
     }
     models->mmap_handle = (spi_flash_mmap_handle_t*)malloc(sizeof(spi_flash_mmap_handle_t));
-    ESP_ERROR_CHECK(esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &root, models->mmap_handle));
+    ESP_ERROR_CHECK(esp_partition_mmap(partition, 0, image_size, SPI_FLASH_MMAP_DATA, &root, models->mmap_handle));
 #endif
     
 
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * JsonWriter - Compact JSON written straight into a caller's buffer
+ *
+ * Features:
+ * - No heap: a stack buffer (JsonBuffer<N> carries its own) or an arena slice
+ * - Compact output with no whitespace, so nothing goes over TLS twice
+ * - String escaping for quotes, backslashes and control characters
+ * - Nested objects and arrays; end() closes whatever is still open
+ * - Typed field helpers (field_uint, field_number, ...) to avoid overload
+ *   ambiguity between int32_t/uint32_t on Xtensa
+ * - Overflow is sticky: ok() reports whether the output is complete
+ *
+ * The root is an object, opened by the constructor. Inside an array the
+ * item_* calls add elements and begin_object()/begin_array() take no key.
+ *
+ * Typical use:
+ *   JsonBuffer<128> w;
+ *   w.field("type", "PING").field_uint("requestId", 7).end();
+ *   send(w.c_str());
+ */
+class JsonWriter {
+public:
+    static constexpr int MAX_DEPTH = 16;    // Containers open below the root
+
+    JsonWriter(char* buffer, size_t capacity)
+        : buffer(buffer), capacity(capacity), length(0), depth(0), arrays(0), need_comma(false),
+          overflow(capacity == 0) {
+        if (capacity > 0) {
+            buffer[0] = '\0';
+        }
+        put('{');
+    }
+
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    JsonWriter& field(const char* key, const char* value) {
+        write_key(key);
+        write_string(value);
+        return *this;
+    }
+
+    JsonWriter& field_uint(const char* key, uint32_t value) {
+        write_key(key);
+        char tmp[12];
+        int n = snprintf(tmp, sizeof(tmp), "%u", (unsigned)value);
+        put_raw(tmp, n);
+        return *this;
+    }
+
+    JsonWriter& field_int(const char* key, int32_t value) {
+        write_key(key);
+        char tmp[12];
+        int n = snprintf(tmp, sizeof(tmp), "%d", (int)value);
+        put_raw(tmp, n);
+        return *this;
+    }
+
+    JsonWriter& field_number(const char* key, double value) {
+        write_key(key);
+        char tmp[24];
+        int n = snprintf(tmp, sizeof(tmp), "%.6g", value);
+        put_raw(tmp, n);
+        return *this;
+    }
+
+    JsonWriter& field_bool(const char* key, bool value) {
+        write_key(key);
+        if (value) {
+            put_raw("true", 4);
+        } else {
+            put_raw("false", 5);
+        }
+        return *this;
+    }
+
+    // Insert a pre-serialised JSON value (object, array or literal) verbatim
+    JsonWriter& raw_field(const char* key, const char* json) {
+        write_key(key);
+        while (json && *json) {
+            put(*json++);
+        }
+        return *this;
+    }
+
+    // Array elements
+    JsonWriter& item(const char* value) { return field(nullptr, value); }
+    JsonWriter& item_uint(uint32_t value) { return field_uint(nullptr, value); }
+    JsonWriter& item_int(int32_t value) { return field_int(nullptr, value); }
+    JsonWriter& item_number(double value) { return field_number(nullptr, value); }
+    JsonWriter& item_bool(bool value) { return field_bool(nullptr, value); }
+
+    JsonWriter& begin_object(const char* key = nullptr) {
+        write_key(key);
+        open('{', false);
+        return *this;
+    }
+
+    JsonWriter& end_object() {
+        if (depth > 0 && !in_array()) {
+            close();
+        }
+        return *this;
+    }
+
+    JsonWriter& begin_array(const char* key = nullptr) {
+        write_key(key);
+        open('[', true);
+        return *this;
+    }
+
+    JsonWriter& end_array() {
+        if (depth > 0 && in_array()) {
+            close();
+        }
+        return *this;
+    }
+
+    // Close any open nested containers and the root object
+    JsonWriter& end() {
+        while (depth > 0) {
+            close();
+        }
+        put('}');
+        return *this;
+    }
+
+    bool ok() const { return !overflow; }
+    const char* c_str() const { return buffer; }
+    size_t size() const { return length; }
+
+private:
+    char* buffer;
+    size_t capacity;
+    size_t length;
+    int depth;
+    uint32_t arrays;        // Bit per open container below the root: set for an array
+    bool need_comma;
+    bool overflow;
+
+    bool in_array() const { return depth > 0 && (arrays & (1u << (depth - 1))); }
+
+    void open(char c, bool array) {
+        if (depth >= MAX_DEPTH) {
+            overflow = true;
+            return;
+        }
+        put(c);
+        arrays = array ? (arrays | (1u << depth)) : (arrays & ~(1u << depth));
+        depth++;
+        need_comma = false;
+    }
+
+    void close() {
+        put(in_array() ? ']' : '}');
+        depth--;
+        need_comma = true;
+    }
+
+    void put(char c) {
+        if (length + 1 >= capacity) {
+            overflow = true;
+            return;
+        }
+        buffer[length++] = c;
+        buffer[length] = '\0';
+    }
+
+    void put_raw(const char* s, int n) {
+        for (int i = 0; i < n; i++) {
+            put(s[i]);
+        }
+    }
+
+    // A null key is an array element: only the separator
+    void write_key(const char* key) {
+        if (need_comma) {
+            put(',');
+        }
+        if (key) {
+            write_string(key);
+            put(':');
+        }
+        need_comma = true;
+    }
+
+    void write_string(const char* s) {
+        static const char hex[] = "0123456789abcdef";
+        put('"');
+        for (; s && *s; s++) {
+            unsigned char c = (unsigned char)*s;
+            switch (c) {
+                case '"':  put('\\'); put('"'); break;
+                case '\\': put('\\'); put('\\'); break;
+                case '\n': put('\\'); put('n'); break;
+                case '\r': put('\\'); put('r'); break;
+                case '\t': put('\\'); put('t'); break;
+                default:
+                    if (c < 0x20) {
+                        put('\\'); put('u'); put('0'); put('0');
+                        put(hex[c >> 4]); put(hex[c & 0x0F]);
+                    } else {
+                        put((char)c);
+                    }
+                    break;
+            }
+        }
+        put('"');
+    }
+};
+
+// The buffer, as a base so it exists before JsonWriter opens the root in it
+template <size_t N>
+struct JsonBufferStorage {
+    char storage[N];
+};
+
+/**
+ * JsonBuffer - JsonWriter with an inline buffer sized at compile time,
+ * meant for the stack
+ */
+template <size_t N>
+class JsonBuffer : private JsonBufferStorage<N>, public JsonWriter {
+public:
+    JsonBuffer() : JsonWriter(JsonBufferStorage<N>::storage, N) {}
+};
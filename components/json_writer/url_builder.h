@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+/**
+ * UrlBuilder - Paths, query strings and form bodies written into a caller's buffer
+ *
+ * Features:
+ * - No heap: a stack buffer (UrlBuffer<N> carries its own)
+ * - param() percent-encodes the value, keeping only RFC 3986 unreserved
+ *   characters; the first one on a path adds '?', later ones '&'
+ * - Started on an empty buffer the params form an
+ *   application/x-www-form-urlencoded body, with no '?'
+ * - param_raw() for values already encoded or known to be URL-safe
+ * - Overflow is sticky: ok() reports whether the output is complete
+ *
+ * Typical use:
+ *   UrlBuffer<256> url;
+ *   url.append("/me/player/volume").param_int("volume_percent", 40).param("device_id", id);
+ *   request(url.c_str());
+ */
+class UrlBuilder {
+public:
+    UrlBuilder(char* buffer, size_t capacity)
+        : buffer(buffer), capacity(capacity), length(0), has_query(false), overflow(capacity == 0) {
+        if (capacity > 0) {
+            buffer[0] = '\0';
+        }
+    }
+
+    UrlBuilder(const UrlBuilder&) = delete;
+    UrlBuilder& operator=(const UrlBuilder&) = delete;
+
+    // Verbatim text: scheme, host, path
+    UrlBuilder& append(const char* text) {
+        while (text && *text) {
+            put(*text++);
+        }
+        return *this;
+    }
+
+    // One path segment, percent-encoded
+    UrlBuilder& segment(const char* value) {
+        put('/');
+        put_encoded(value);
+        return *this;
+    }
+
+    UrlBuilder& param(const char* key, const char* value) {
+        write_key(key);
+        put_encoded(value);
+        return *this;
+    }
+
+    UrlBuilder& param_raw(const char* key, const char* value) {
+        write_key(key);
+        append(value);
+        return *this;
+    }
+
+    UrlBuilder& param_int(const char* key, int32_t value) {
+        char tmp[12];
+        snprintf(tmp, sizeof(tmp), "%d", (int)value);
+        return param_raw(key, tmp);
+    }
+
+    UrlBuilder& param_bool(const char* key, bool value) {
+        return param_raw(key, value ? "true" : "false");
+    }
+
+    // Left out entirely when the value is null or empty
+    UrlBuilder& param_if_set(const char* key, const char* value) {
+        if (value && *value) {
+            param(key, value);
+        }
+        return *this;
+    }
+
+    bool ok() const { return !overflow; }
+    const char* c_str() const { return buffer; }
+    size_t size() const { return length; }
+
+private:
+    char* buffer;
+    size_t capacity;
+    size_t length;
+    bool has_query;
+    bool overflow;
+
+    void put(char c) {
+        if (length + 1 >= capacity) {
+            overflow = true;
+            return;
+        }
+        buffer[length++] = c;
+        buffer[length] = '\0';
+    }
+
+    void write_key(const char* key) {
+        if (has_query) {
+            put('&');
+        } else if (length > 0) {
+            put('?');
+        }
+        has_query = true;
+        append(key);
+        put('=');
+    }
+
+    void put_encoded(const char* s) {
+        static const char hex[] = "0123456789ABCDEF";
+        for (; s && *s; s++) {
+            unsigned char c = (unsigned char)*s;
+            if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+                c == '-' || c == '_' || c == '.' || c == '~') {
+                put((char)c);
+            } else {
+                put('%');
+                put(hex[c >> 4]);
+                put(hex[c & 0x0F]);
+            }
+        }
+    }
+};
+
+// The buffer, as a base so it exists before UrlBuilder writes to it
+template <size_t N>
+struct UrlBufferStorage {
+    char storage[N];
+};
+
+/**
+ * UrlBuffer - UrlBuilder with an inline buffer sized at compile time,
+ * meant for the stack
+ */
+template <size_t N>
+class UrlBuffer : private UrlBufferStorage<N>, public UrlBuilder {
+public:
+    UrlBuffer() : UrlBuilder(UrlBufferStorage<N>::storage, N) {}
+};
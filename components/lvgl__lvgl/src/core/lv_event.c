@@ -14,6 +14,15 @@
  *********************/
 #define MY_CLASS &lv_obj_class
 
+#ifdef LV_CB_HOOK_INCLUDE
+    #include LV_CB_HOOK_INCLUDE
+#endif
+
+/*Calls an event callback, e.g. to time it. A plain call by default.*/
+#ifndef LV_EVENT_CB_CALL
+    #define LV_EVENT_CB_CALL(cb, e) (cb)(e)
+#endif
+
 /**********************
  *      TYPEDEFS
  **********************/
@@ -444,7 +453,7 @@ static lv_res_t event_send_core(lv_event_t * e)
            && (event_dsc->filter == (LV_EVENT_ALL | LV_EVENT_PREPROCESS) ||
                (event_dsc->filter & ~LV_EVENT_PREPROCESS) == e->code)) {
             e->user_data = event_dsc->user_data;
-            event_dsc->cb(e);
+            LV_EVENT_CB_CALL(event_dsc->cb, e);
 
             if(e->stop_processing) return LV_RES_OK;
             /*Stop if the object is deleted*/
@@ -464,7 +473,7 @@ static lv_res_t event_send_core(lv_event_t * e)
         if(event_dsc->cb && ((event_dsc->filter & LV_EVENT_PREPROCESS) == 0)
            && (event_dsc->filter == LV_EVENT_ALL || event_dsc->filter == e->code)) {
             e->user_data = event_dsc->user_data;
-            event_dsc->cb(e);
+            LV_EVENT_CB_CALL(event_dsc->cb, e);
 
             if(e->stop_processing) return LV_RES_OK;
             /*Stop if the object is deleted*/
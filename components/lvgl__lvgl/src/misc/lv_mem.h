@@ -21,6 +21,18 @@ extern "C" {
 
 #include "lv_types.h"
 
+#ifdef LV_MEM_POOL_INCLUDE
+    #include LV_MEM_POOL_INCLUDE
+#endif
+
+/*Allocator of the render-time buffers (lv_mem_buf_get) and SW layers, e.g. to keep them in
+ *fast memory while the work memory pool is elsewhere. The work memory pool by default.*/
+#ifndef LV_MEM_BUF_ALLOC
+    #define LV_MEM_BUF_ALLOC    lv_mem_alloc
+    #define LV_MEM_BUF_REALLOC  lv_mem_realloc
+    #define LV_MEM_BUF_FREE     lv_mem_free
+#endif
+
 /*********************
  *      DEFINES
  *********************/
@@ -18,6 +18,15 @@
 #define IDLE_MEAS_PERIOD 500 /*[ms]*/
 #define DEF_PERIOD 500
 
+#ifdef LV_CB_HOOK_INCLUDE
+    #include LV_CB_HOOK_INCLUDE
+#endif
+
+/*Calls a timer callback, e.g. to time it. A plain call by default.*/
+#ifndef LV_TIMER_CB_CALL
+    #define LV_TIMER_CB_CALL(cb, timer) (cb)(timer)
+#endif
+
 /**********************
  *      TYPEDEFS
  **********************/
@@ -310,7 +319,7 @@ static bool lv_timer_exec(lv_timer_t * timer)
         if(timer->repeat_count > 0) timer->repeat_count--;
         timer->last_run = lv_tick_get();
         TIMER_TRACE("calling timer callback: %p", *((void **)&timer->timer_cb));
-        if(timer->timer_cb && original_repeat_count != 0) timer->timer_cb(timer);
+        if(timer->timer_cb && original_repeat_count != 0) LV_TIMER_CB_CALL(timer->timer_cb, timer);
         TIMER_TRACE("timer callback %p finished", *((void **)&timer->timer_cb));
         LV_ASSERT_MEM_INTEGRITY();
         exec = true;
@@ -0,0 +1,403 @@
+#include "media_server.h"
+#include <string.h>
+#include <strings.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+static const struct {
+    const char *ext;
+    const char *type;
+} mime_types[] = {
+    { ".mp3",  "audio/mpeg" },
+    { ".flac", "audio/flac" },
+    { ".wav",  "audio/wav" },
+    { ".aac",  "audio/aac" },
+    { ".m4a",  "audio/mp4" },
+    { ".ogg",  "audio/ogg" },
+    { ".opus", "audio/ogg" },
+    { ".jpg",  "image/jpeg" },
+    { ".png",  "image/png" },
+};
+
+const char *media_server_mime_type(const char *path) {
+    const char *ext = path ? strrchr(path, '.') : NULL;
+    if (ext) {
+        for (size_t i = 0; i < sizeof(mime_types) / sizeof(mime_types[0]); i++) {
+            if (strcasecmp(ext, mime_types[i].ext) == 0) {
+                return mime_types[i].type;
+            }
+        }
+    }
+    return "application/octet-stream";
+}
+
+#if CONFIG_MEDIA_SERVER
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_http_server.h"
+#include "esp_netif.h"
+#include "mem_budget.h"
+
+static const char *TAG = "media_server";
+
+#define MEDIA_SERVER_ALIGN      64          // Cache line, for DMA straight into the buffer
+#define MEDIA_HEADER_MAX        320
+
+typedef struct {
+    httpd_req_t *req;           // Async copy, owned by the sender
+    int fd;
+    off_t start;
+    size_t length;
+    off_t total;
+    bool partial;               // 206 with Content-Range
+    const char *type;
+} media_job_t;
+
+typedef enum {
+    RANGE_NONE,                 // Absent or not one we serve: the whole file
+    RANGE_OK,
+    RANGE_UNSATISFIABLE,
+} range_result_t;
+
+static httpd_handle_t server;
+static QueueHandle_t jobs;
+static SemaphoreHandle_t idle_senders;      // Counts senders free to take a job
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// The file a request URI names: %-decoded below MEDIA_SERVER_ROOT, no ".." segments
+static bool resolve_path(const char *uri, char *path, size_t size) {
+    const char *src = uri + strlen(MEDIA_SERVER_URI_PREFIX);
+    size_t pos = snprintf(path, size, "%s/", MEDIA_SERVER_ROOT);
+    size_t segment = pos;
+
+    for (; *src && *src != '?'; src++) {
+        char c = *src;
+        if (c == '%') {
+            int hi = hex_value(src[1]);
+            int lo = hi < 0 ? -1 : hex_value(src[2]);
+            if (lo < 0) {
+                return false;
+            }
+            c = (char)(hi << 4 | lo);
+            src += 2;
+        }
+        if (c == '\0' || c == '\\' || pos + 1 >= size) {
+            return false;
+        }
+        if (c == '/') {
+            if (pos - segment == 2 && path[segment] == '.' && path[segment + 1] == '.') {
+                return false;
+            }
+            segment = pos + 1;
+        }
+        path[pos++] = c;
+    }
+    path[pos] = '\0';
+    return pos > segment && !(pos - segment == 2 && strcmp(path + segment, "..") == 0);
+}
+
+// "bytes=a-b", "bytes=a-" or "bytes=-n" into start..end (inclusive)
+static range_result_t parse_range(const char *value, off_t total, off_t *start, off_t *end) {
+    if (strncmp(value, "bytes=", 6) != 0 || strchr(value, ',')) {
+        return RANGE_NONE;
+    }
+    const char *spec = value + 6;
+    char *rest = NULL;
+
+    if (*spec == '-') {
+        long long suffix = strtoll(spec + 1, &rest, 10);
+        if (rest == spec + 1 || *rest != '\0') {
+            return RANGE_NONE;
+        }
+        if (suffix <= 0 || total == 0) {
+            return RANGE_UNSATISFIABLE;
+        }
+        *start = suffix >= total ? 0 : total - (off_t)suffix;
+        *end = total - 1;
+        return RANGE_OK;
+    }
+
+    long long first = strtoll(spec, &rest, 10);
+    if (rest == spec || *rest != '-') {
+        return RANGE_NONE;
+    }
+    const char *last_spec = rest + 1;
+    long long last = total - 1;
+    if (*last_spec != '\0') {
+        last = strtoll(last_spec, &rest, 10);
+        if (rest == last_spec || *rest != '\0' || last < first) {
+            return RANGE_NONE;
+        }
+    }
+    if (first >= total) {
+        return RANGE_UNSATISFIABLE;
+    }
+    *start = (off_t)first;
+    *end = last >= total ? total - 1 : (off_t)last;
+    return RANGE_OK;
+}
+
+static bool send_all(httpd_req_t *req, const uint8_t *data, size_t length) {
+    while (length > 0) {
+        int sent = httpd_send(req, (const char *)data, length);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return true;
+}
+
+// Written by hand: httpd_resp_* would either want the whole body or chunk it,
+// and a receiver can only seek in a body whose length it knows
+static bool send_header(httpd_req_t *req, const media_job_t *job) {
+    char header[MEDIA_HEADER_MAX];
+    char range[64] = "";
+    if (job->partial) {
+        snprintf(range, sizeof(range), "Content-Range: bytes %ld-%ld/%ld\r\n",
+                 (long)job->start, (long)(job->start + (off_t)job->length - 1), (long)job->total);
+    }
+    int length = snprintf(header, sizeof(header),
+                          "HTTP/1.1 %s\r\n"
+                          "Content-Type: %s\r\n"
+                          "Content-Length: %u\r\n"
+                          "%s"
+                          "Accept-Ranges: bytes\r\n"
+                          "Access-Control-Allow-Origin: *\r\n"
+                          "\r\n",
+                          job->partial ? "206 Partial Content" : "200 OK",
+                          job->type, (unsigned)job->length, range);
+    return length > 0 && length < (int)sizeof(header) &&
+           send_all(req, (const uint8_t *)header, (size_t)length);
+}
+
+static bool send_body(const media_job_t *job, uint8_t *buffer) {
+    if (lseek(job->fd, job->start, SEEK_SET) != job->start) {
+        return false;
+    }
+    off_t offset = job->start;
+    size_t remaining = job->length;
+    while (remaining > 0) {
+        // Up to the next chunk boundary, so every read after the first is sector aligned
+        size_t want = MEDIA_SERVER_CHUNK - (size_t)(offset % MEDIA_SERVER_CHUNK);
+        if (want > remaining) {
+            want = remaining;
+        }
+        ssize_t got = read(job->fd, buffer, want);
+        if (got <= 0 || !send_all(job->req, buffer, (size_t)got)) {
+            return false;
+        }
+        offset += got;
+        remaining -= (size_t)got;
+    }
+    return true;
+}
+
+static void sender_task(void *arg) {
+    uint8_t *buffer = arg;
+    media_job_t job;
+    for (;;) {
+        xQueueReceive(jobs, &job, portMAX_DELAY);
+        if (!send_header(job.req, &job) || !send_body(&job, buffer)) {
+            // Receivers drop a stream to seek or once buffered enough; the
+            // connection is mid-body and cannot take another request
+            ESP_LOGD(TAG, "Stream ended early, closing its connection");
+            httpd_sess_trigger_close(server, httpd_req_to_sockfd(job.req));
+        }
+        close(job.fd);
+        httpd_req_async_handler_complete(job.req);
+        xSemaphoreGive(idle_senders);
+    }
+}
+
+static esp_err_t send_status(httpd_req_t *req, const char *status, const char *name, const char *value) {
+    httpd_resp_set_status(req, status);
+    if (name) {
+        httpd_resp_set_hdr(req, name, value);
+    }
+    return httpd_resp_send(req, NULL, 0);
+}
+
+static esp_err_t media_handler(httpd_req_t *req) {
+    char path[MEDIA_SERVER_PATH_MAX];
+    struct stat st;
+    int fd = -1;
+    if (!resolve_path(req->uri, path, sizeof(path)) || (fd = open(path, O_RDONLY)) < 0 ||
+        fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+    }
+
+    media_job_t job = {
+        .fd = fd,
+        .start = 0,
+        .total = st.st_size,
+        .type = media_server_mime_type(path),
+    };
+    off_t end = st.st_size - 1;
+    char value[64];
+    if (httpd_req_get_hdr_value_str(req, "Range", value, sizeof(value)) == ESP_OK) {
+        range_result_t range = parse_range(value, st.st_size, &job.start, &end);
+        if (range == RANGE_UNSATISFIABLE) {
+            close(fd);
+            snprintf(value, sizeof(value), "bytes */%ld", (long)st.st_size);
+            return send_status(req, "416 Range Not Satisfiable", "Content-Range", value);
+        }
+        job.partial = range == RANGE_OK;
+    }
+    job.length = (size_t)(end + 1 - job.start);
+
+    if (req->method == HTTP_HEAD) {
+        bool ok = send_header(req, &job);
+        close(fd);
+        return ok ? ESP_OK : ESP_FAIL;
+    }
+
+    // Every sender busy, or too little internal RAM for another socket's send buffer
+    if (!mem_budget_admit(MEM_BUDGET_FOREGROUND, CONFIG_LWIP_TCP_SND_BUF_DEFAULT) ||
+        xSemaphoreTake(idle_senders, 0) != pdTRUE) {
+        close(fd);
+        return send_status(req, "503 Service Unavailable", "Retry-After", "1");
+    }
+    if (httpd_req_async_handler_begin(req, &job.req) != ESP_OK) {
+        close(fd);
+        xSemaphoreGive(idle_senders);
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+    }
+    ESP_LOGD(TAG, "Streaming %s from %ld (%u bytes)", path, (long)job.start, (unsigned)job.length);
+    xQueueSend(jobs, &job, portMAX_DELAY);      // A sender is free, so the queue has room
+    return ESP_OK;
+}
+
+bool media_server_start(void) {
+    if (server) {
+        return true;
+    }
+
+    jobs = xQueueCreate(CONFIG_MEDIA_SERVER_CLIENTS, sizeof(media_job_t));
+    idle_senders = xSemaphoreCreateCounting(CONFIG_MEDIA_SERVER_CLIENTS, 0);
+    if (!jobs || !idle_senders) {
+        ESP_LOGE(TAG, "No memory for the media server queue");
+        return false;
+    }
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = CONFIG_MEDIA_SERVER_PORT;
+    config.ctrl_port = CONFIG_MEDIA_SERVER_PORT + 1;
+    config.max_open_sockets = CONFIG_MEDIA_SERVER_CLIENTS + 1;     // Room to answer a 503
+    config.lru_purge_enable = true;
+    config.send_wait_timeout = MEDIA_SERVER_SEND_TIMEOUT_S;
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    config.stack_size = 4096;
+    config.task_priority = MEDIA_SERVER_TASK_PRIORITY;
+    if (httpd_start(&server, &config) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the media server on port %d", CONFIG_MEDIA_SERVER_PORT);
+        server = NULL;
+        return false;
+    }
+
+    const httpd_method_t methods[] = { HTTP_GET, HTTP_HEAD };
+    for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++) {
+        const httpd_uri_t uri = {
+            .uri = MEDIA_SERVER_URI_PREFIX "*",
+            .method = methods[i],
+            .handler = media_handler,
+        };
+        httpd_register_uri_handler(server, &uri);
+    }
+
+    // Until a sender is up every GET gets a 503
+    int senders = 0;
+    for (int i = 0; i < CONFIG_MEDIA_SERVER_CLIENTS; i++) {
+        uint8_t *buffer = heap_caps_aligned_alloc(MEDIA_SERVER_ALIGN, MEDIA_SERVER_CHUNK,
+                                                  MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!buffer) {
+            break;
+        }
+        if (xTaskCreate(sender_task, "media_send", MEDIA_SERVER_TASK_STACK, buffer,
+                        MEDIA_SERVER_TASK_PRIORITY, NULL) != pdPASS) {
+            heap_caps_free(buffer);
+            break;
+        }
+        xSemaphoreGive(idle_senders);
+        senders++;
+    }
+    if (senders == 0) {
+        ESP_LOGE(TAG, "No memory for a media sender");
+        httpd_stop(server);
+        server = NULL;
+        vQueueDelete(jobs);
+        vSemaphoreDelete(idle_senders);
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Serving %s on port %d, %d streams at once", MEDIA_SERVER_ROOT, CONFIG_MEDIA_SERVER_PORT, senders);
+    return true;
+}
+
+bool media_server_url(const char *path, char *url, size_t size) {
+    const size_t root_len = strlen(MEDIA_SERVER_ROOT);
+    if (!server || !path || strncmp(path, MEDIA_SERVER_ROOT "/", root_len + 1) != 0) {
+        return false;
+    }
+
+    esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    esp_netif_ip_info_t ip_info;
+    if (!netif || esp_netif_get_ip_info(netif, &ip_info) != ESP_OK || ip_info.ip.addr == 0) {
+        return false;
+    }
+
+    int pos = snprintf(url, size, "http://" IPSTR ":%d" MEDIA_SERVER_URI_PREFIX,
+                       IP2STR(&ip_info.ip), CONFIG_MEDIA_SERVER_PORT);
+    if (pos < 0 || (size_t)pos >= size) {
+        return false;
+    }
+
+    // Unreserved characters and '/' as they are, everything else %-escaped
+    static const char hex[] = "0123456789ABCDEF";
+    for (const unsigned char *src = (const unsigned char *)path + root_len + 1; *src; src++) {
+        unsigned char c = *src;
+        bool plain = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                     c == '-' || c == '_' || c == '.' || c == '~' || c == '/';
+        if ((size_t)pos + (plain ? 1 : 3) >= size) {
+            return false;
+        }
+        if (plain) {
+            url[pos++] = (char)c;
+        } else {
+            url[pos++] = '%';
+            url[pos++] = hex[c >> 4];
+            url[pos++] = hex[c & 0x0f];
+        }
+    }
+    url[pos] = '\0';
+    return true;
+}
+#else
+bool media_server_start(void) {
+    return false;
+}
+
+bool media_server_url(const char *path, char *url, size_t size) {
+    (void)path;
+    (void)url;
+    (void)size;
+    return false;
+}
+#endif
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "task_plan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Media server - the SD card's music over HTTP, for Cast receivers
+ *
+ * A Chromecast only plays what it can fetch, so a local track is cast by
+ * LOADing a URL on this server (media_server_url()). GET and HEAD on
+ * /media/<path below MEDIA_SERVER_ROOT> answer with the file's MIME type,
+ * Content-Length and Accept-Ranges; a single "Range: bytes=" range gets a
+ * 206 with Content-Range, which the receiver uses to seek and to resume a
+ * stream it dropped while paused.
+ *
+ * The httpd task only parses the request and opens the file; the body is
+ * handed over as an async request to one of MEDIA_SERVER_CLIENTS sender
+ * tasks, so each receiver streams on its own and the server still answers
+ * the next request. A sender reads MEDIA_SERVER_CHUNK bytes at a time at
+ * chunk-aligned file offsets, with read() rather than stdio, so FATFS
+ * transfers whole sectors straight into the sender's cache-aligned buffer,
+ * and passes the chunk to the socket unchanged: one copy into lwIP's send
+ * buffers, no re-chunking or encoding.
+ *
+ * Nothing is served unless MEDIA_SERVER is enabled.
+ */
+
+#define MEDIA_SERVER_ROOT           "/sdcard"
+#define MEDIA_SERVER_URI_PREFIX     "/media/"
+#define MEDIA_SERVER_PATH_MAX       160
+#define MEDIA_SERVER_URL_MAX        384         // Every path byte may be %-escaped
+#define MEDIA_SERVER_CHUNK          (32 * 1024) // Per read() and send; PSRAM, one per sender
+#define MEDIA_SERVER_SEND_TIMEOUT_S 20          // A receiver that stops reading this long is dropped
+#define MEDIA_SERVER_TASK_STACK     4096
+#define MEDIA_SERVER_TASK_PRIORITY  TASK_PLAN_MEDIA_SERVER_PRIORITY     // Below the audio and network tasks
+
+/**
+ * @brief Start the server on MEDIA_SERVER_PORT and its sender tasks
+ *
+ * Call once the network stack is up (after esp_netif_init()).
+ * @return false if disabled or it could not start
+ */
+bool media_server_start(void);
+
+/**
+ * @brief The URL a receiver on the LAN fetches a file under MEDIA_SERVER_ROOT at
+ *
+ * @param path Absolute path, e.g. "/sdcard/Music/a.mp3"
+ * @return false if the server is not running, there is no station address
+ *         yet, the path is outside the root or the URL does not fit
+ */
+bool media_server_url(const char *path, char *url, size_t size);
+
+/**
+ * @brief MIME type for a file, by its extension
+ * @return "application/octet-stream" for unknown extensions
+ */
+const char *media_server_mime_type(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include "esp_heap_caps.h"
+
+/**
+ * @brief Where LVGL's memory comes from with MEM_BUDGET_LVGL_POOL_PSRAM
+ *
+ * Included by LVGL's lv_mem.h (LV_MEM_POOL_INCLUDE, set in the project
+ * CMakeLists.txt) and only used inside LVGL:
+ *
+ * - LV_MEM_POOL_ALLOC: the one PSRAM block LVGL runs its TLSF heap in, for
+ *   objects, styles and everything else lv_mem_alloc() returns
+ * - LV_MEM_BUF_*: render-time buffers and software layers, in internal RAM
+ *   while it lasts (PSRAM otherwise), so masks and blends stay fast
+ *
+ * Inline, so LVGL needs nothing but the heap component to link.
+ */
+
+static inline void *lvgl_mem_pool_alloc(size_t size) {
+    return heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+}
+
+static inline void *lvgl_mem_pool_buf_alloc(size_t size) {
+    return heap_caps_malloc_prefer(size, 2, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+                                   MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+}
+
+static inline void *lvgl_mem_pool_buf_realloc(void *p, size_t size) {
+    return heap_caps_realloc_prefer(p, size, 2, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+                                    MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+}
+
+static inline void lvgl_mem_pool_buf_free(void *p) {
+    heap_caps_free(p);
+}
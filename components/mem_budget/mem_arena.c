@@ -0,0 +1,86 @@
+#include "mem_arena.h"
+#include <stdint.h>
+
+struct mem_arena_chunk {
+    mem_arena_chunk_t *next;
+    size_t size;                // Of data
+    size_t used;
+    uint8_t data[] __attribute__((aligned(MEM_ARENA_ALIGN)));
+};
+
+void mem_arena_init(mem_arena_t *arena, mem_tag_t tag, size_t chunk_bytes) {
+    arena->tag = tag;
+    arena->chunk_bytes = chunk_bytes ? chunk_bytes : MEM_ARENA_CHUNK_BYTES;
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->used = 0;
+}
+
+void *mem_arena_alloc(mem_arena_t *arena, size_t size) {
+    size = (size + MEM_ARENA_ALIGN - 1) & ~(size_t)(MEM_ARENA_ALIGN - 1);
+    mem_arena_chunk_t *chunk = arena->current;
+    if (!chunk || chunk->size - chunk->used < size) {
+        size_t bytes = size > arena->chunk_bytes ? size : arena->chunk_bytes;
+        mem_arena_chunk_t *fresh = mem_tag_malloc(arena->tag, sizeof(*fresh) + bytes);
+        if (!fresh) {
+            return NULL;
+        }
+        fresh->next = NULL;
+        fresh->size = bytes;
+        fresh->used = 0;
+        if (chunk) {
+            chunk->next = fresh;
+        } else {
+            arena->first = fresh;
+        }
+        arena->current = chunk = fresh;
+    }
+    void *ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    arena->used += size;
+    return ptr;
+}
+
+bool mem_arena_owns(const mem_arena_t *arena, const void *ptr) {
+    const uint8_t *p = ptr;
+    for (const mem_arena_chunk_t *chunk = arena->first; chunk; chunk = chunk->next) {
+        if (p >= chunk->data && p < chunk->data + chunk->size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void free_chunks(mem_arena_t *arena, mem_arena_chunk_t *chunk) {
+    while (chunk) {
+        mem_arena_chunk_t *next = chunk->next;
+        mem_tag_free(arena->tag, chunk);
+        chunk = next;
+    }
+}
+
+void mem_arena_reset(mem_arena_t *arena) {
+    mem_tag_note_arena(arena->tag, arena->used);
+    arena->used = 0;
+    mem_arena_chunk_t *first = arena->first;
+    if (!first) {
+        return;
+    }
+    // A first chunk sized for one large block is not kept either
+    if (first->size != arena->chunk_bytes) {
+        free_chunks(arena, first);
+        arena->first = arena->current = NULL;
+        return;
+    }
+    free_chunks(arena, first->next);
+    first->next = NULL;
+    first->used = 0;
+    arena->current = first;
+}
+
+void mem_arena_release(mem_arena_t *arena) {
+    mem_tag_note_arena(arena->tag, arena->used);
+    free_chunks(arena, arena->first);
+    arena->first = arena->current = NULL;
+    arena->used = 0;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "mem_tag.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Memory arena - bump allocation for one message's scratch
+ *
+ * Parsing a message into a cJSON tree takes a block per node and per
+ * string, all freed together a moment later. An arena hands them out of
+ * larger chunks (mem_tag_malloc()'d, so PSRAM and counted against its tag)
+ * and frees nothing until mem_arena_reset(), which keeps the first chunk
+ * for the next message and drops the rest.
+ *
+ * Not locked: an arena belongs to one task at a time.
+ */
+
+#define MEM_ARENA_CHUNK_BYTES   8192    // Default chunk; a larger block gets a chunk of its own
+#define MEM_ARENA_ALIGN         8
+
+typedef struct mem_arena_chunk mem_arena_chunk_t;
+
+struct mem_arena {
+    mem_tag_t tag;
+    size_t chunk_bytes;
+    mem_arena_chunk_t *first;   // Kept across resets
+    mem_arena_chunk_t *current;
+    size_t used;                // Handed out since the last reset
+};
+
+/**
+ * @brief Set up an empty arena; the first chunk comes with the first block
+ *
+ * @param chunk_bytes 0 for MEM_ARENA_CHUNK_BYTES
+ */
+void mem_arena_init(mem_arena_t *arena, mem_tag_t tag, size_t chunk_bytes);
+
+/**
+ * @brief size bytes, MEM_ARENA_ALIGN aligned; NULL without memory
+ */
+void *mem_arena_alloc(mem_arena_t *arena, size_t size);
+
+/**
+ * @brief Whether ptr came from one of the arena's chunks
+ */
+bool mem_arena_owns(const mem_arena_t *arena, const void *ptr);
+
+/**
+ * @brief Take back every block, keeping the first chunk
+ */
+void mem_arena_reset(mem_arena_t *arena);
+
+/**
+ * @brief Take back every block and free all chunks
+ */
+void mem_arena_release(mem_arena_t *arena);
+
+#ifdef __cplusplus
+}
+#endif
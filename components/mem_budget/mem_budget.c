@@ -0,0 +1,80 @@
+#include "mem_budget.h"
+#include "mem_tag.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "mem_budget";
+
+#define INTERNAL_CAPS   (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+
+static const size_t reserves[MEM_BUDGET_CLASS_COUNT] = {
+    [MEM_BUDGET_CRITICAL]   = 0,
+    [MEM_BUDGET_FOREGROUND] = CONFIG_MEM_BUDGET_FOREGROUND_RESERVE_KB * 1024,
+    [MEM_BUDGET_BACKGROUND] = CONFIG_MEM_BUDGET_BACKGROUND_RESERVE_KB * 1024,
+};
+
+static uint32_t refused[MEM_BUDGET_CLASS_COUNT];
+
+bool mem_budget_admit(mem_budget_class_t cls, size_t bytes) {
+    if (cls == MEM_BUDGET_CRITICAL) {
+        return true;
+    }
+
+    size_t free_internal = heap_caps_get_free_size(INTERNAL_CAPS);
+    if (free_internal >= reserves[cls] + bytes &&
+        (bytes == 0 || heap_caps_get_largest_free_block(INTERNAL_CAPS) >= bytes)) {
+        return true;
+    }
+
+    uint32_t count = __atomic_add_fetch(&refused[cls], 1, __ATOMIC_RELAXED);
+    // The first refusal and every 64th after, not one line per retry
+    if (count == 1 || count % 64 == 0) {
+        ESP_LOGW(TAG, "Holding back %s work: %u bytes internal free, %u reserved, %u asked (%u refusals)",
+                 cls == MEM_BUDGET_FOREGROUND ? "foreground" : "background",
+                 (unsigned)free_internal, (unsigned)reserves[cls], (unsigned)bytes, (unsigned)count);
+    }
+    return false;
+}
+
+bool mem_budget_wait(mem_budget_class_t cls, size_t bytes, uint32_t timeout_ms) {
+    TickType_t start = xTaskGetTickCount();
+    while (!mem_budget_admit(cls, bytes)) {
+        if (xTaskGetTickCount() - start >= pdMS_TO_TICKS(timeout_ms)) {
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(MEM_BUDGET_RETRY_MS));
+    }
+    return true;
+}
+
+size_t mem_budget_internal_free(void) {
+    return heap_caps_get_free_size(INTERNAL_CAPS);
+}
+
+void mem_budget_log(const char *context) {
+    size_t free_internal = heap_caps_get_free_size(INTERNAL_CAPS);
+    ESP_LOGI(TAG, "[%s] internal: %u free, %u min, %u largest; PSRAM: %u free; refused: %u fg, %u bg",
+             context ? context : "-",
+             (unsigned)free_internal,
+             (unsigned)heap_caps_get_minimum_free_size(INTERNAL_CAPS),
+             (unsigned)heap_caps_get_largest_free_block(INTERNAL_CAPS),
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM),
+             (unsigned)__atomic_load_n(&refused[MEM_BUDGET_FOREGROUND], __ATOMIC_RELAXED),
+             (unsigned)__atomic_load_n(&refused[MEM_BUDGET_BACKGROUND], __ATOMIC_RELAXED));
+    if (free_internal < reserves[MEM_BUDGET_FOREGROUND]) {
+        ESP_LOGW(TAG, "Internal RAM below the foreground reserve");
+    }
+
+    mem_tag_stats_t tags[MEM_TAG_COUNT];
+    mem_tag_get_stats(tags);
+    for (int i = 0; i < MEM_TAG_COUNT; i++) {
+        if (tags[i].allocs) {
+            ESP_LOGI(TAG, "[%s] %s: %u live, %u peak, %u allocs (%u internal, %u failed), arena peak %u",
+                     context ? context : "-", mem_tag_name(i),
+                     (unsigned)tags[i].live, (unsigned)tags[i].peak, (unsigned)tags[i].allocs,
+                     (unsigned)tags[i].internal, (unsigned)tags[i].failures, (unsigned)tags[i].arena_peak);
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Memory budget - one admission policy for internal RAM
+ *
+ * The Chromecast session, the Spotify API and accounts clients, the auth
+ * callback server and the Wi-Fi driver all draw on the same internal heap,
+ * while TLS record buffers live in PSRAM (MBEDTLS_EXTERNAL_MEM_ALLOC) and
+ * are only allocated while a record is in flight (MBEDTLS_DYNAMIC_BUFFER).
+ * Work asks here before it starts, by class:
+ *
+ * - CRITICAL: keepalives (Cast heartbeats, PONGs). Always admitted; dropping
+ *   one costs the whole session, which then has to be rebuilt.
+ * - FOREGROUND: what the user just asked for. Admitted while
+ *   MEM_BUDGET_FOREGROUND_RESERVE_KB would remain.
+ * - BACKGROUND: polling, prefetches, album art. Admitted while
+ *   MEM_BUDGET_BACKGROUND_RESERVE_KB would remain; otherwise the caller
+ *   keeps the work queued and asks again after MEM_BUDGET_RETRY_MS.
+ *
+ * Only the heap is consulted, so admission is advisory: nothing is reserved,
+ * and two callers admitted at once may together overdraw the reserve.
+ * Any task may call these.
+ */
+
+#define MEM_BUDGET_RETRY_MS     250
+
+typedef enum {
+    MEM_BUDGET_CRITICAL,
+    MEM_BUDGET_FOREGROUND,
+    MEM_BUDGET_BACKGROUND,
+    MEM_BUDGET_CLASS_COUNT
+} mem_budget_class_t;
+
+/**
+ * @brief Whether work of this class that needs bytes of internal RAM may start
+ */
+bool mem_budget_admit(mem_budget_class_t cls, size_t bytes);
+
+/**
+ * @brief mem_budget_admit(), retried every MEM_BUDGET_RETRY_MS up to timeout_ms
+ *
+ * @return false if still refused when the timeout ran out
+ */
+bool mem_budget_wait(mem_budget_class_t cls, size_t bytes, uint32_t timeout_ms);
+
+/**
+ * @brief Free internal RAM in bytes
+ */
+size_t mem_budget_internal_free(void);
+
+/**
+ * @brief Log internal and PSRAM headroom and refusals per class
+ */
+void mem_budget_log(const char *context);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,125 @@
+#include "mem_tag.h"
+#include "mem_arena.h"
+#include "cJSON.h"
+#include "esp_heap_caps.h"
+#include "esp_memory_utils.h"
+
+typedef struct {
+    uint32_t live;
+    uint32_t peak;
+    uint32_t allocs;
+    uint32_t internal;
+    uint32_t failures;
+    uint32_t arena_peak;
+} counters_t;
+
+static counters_t counters[MEM_TAG_COUNT];
+
+static const char *const names[MEM_TAG_COUNT] = {
+    [MEM_TAG_OTHER]    = "other",
+    [MEM_TAG_CAST]     = "cast",
+    [MEM_TAG_SPOTIFY]  = "spotify",
+    [MEM_TAG_CONTROL]  = "control",
+    [MEM_TAG_SNAPCAST] = "snapcast",
+};
+
+// Zero: MEM_TAG_OTHER from the heap
+static __thread mem_tag_scope_t current;
+
+static void raise_to(uint32_t *peak, uint32_t value) {
+    uint32_t seen = __atomic_load_n(peak, __ATOMIC_RELAXED);
+    while (value > seen &&
+           !__atomic_compare_exchange_n(peak, &seen, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+void *mem_tag_malloc(mem_tag_t tag, size_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+    counters_t *c = &counters[tag < MEM_TAG_COUNT ? tag : MEM_TAG_OTHER];
+#if CONFIG_MEM_BUDGET_ROUTE_PSRAM
+    void *ptr = heap_caps_malloc_prefer(size, 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT,
+                                        MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#else
+    void *ptr = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#endif
+    if (!ptr) {
+        __atomic_add_fetch(&c->failures, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    __atomic_add_fetch(&c->allocs, 1, __ATOMIC_RELAXED);
+    if (!esp_ptr_external_ram(ptr)) {
+        __atomic_add_fetch(&c->internal, 1, __ATOMIC_RELAXED);
+    }
+    uint32_t live = __atomic_add_fetch(&c->live, heap_caps_get_allocated_size(ptr), __ATOMIC_RELAXED);
+    raise_to(&c->peak, live);
+    return ptr;
+}
+
+void mem_tag_free(mem_tag_t tag, void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    counters_t *c = &counters[tag < MEM_TAG_COUNT ? tag : MEM_TAG_OTHER];
+    uint32_t size = heap_caps_get_allocated_size(ptr);
+    heap_caps_free(ptr);
+
+    // Never below zero: the block may have been counted against another tag
+    uint32_t live = __atomic_load_n(&c->live, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&c->live, &live, live > size ? live - size : 0, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+mem_tag_scope_t mem_tag_enter(mem_tag_t tag, mem_arena_t *arena) {
+    mem_tag_scope_t previous = current;
+    current.tag = tag < MEM_TAG_COUNT ? tag : MEM_TAG_OTHER;
+    current.arena = arena;
+    return previous;
+}
+
+void mem_tag_leave(mem_tag_scope_t previous) {
+    current = previous;
+}
+
+static void *cjson_malloc(size_t size) {
+    if (current.arena) {
+        return mem_arena_alloc(current.arena, size);
+    }
+    return mem_tag_malloc(current.tag, size);
+}
+
+static void cjson_free(void *ptr) {
+    if (!ptr || (current.arena && mem_arena_owns(current.arena, ptr))) {
+        return;
+    }
+    mem_tag_free(current.tag, ptr);
+}
+
+void mem_tag_install_cjson(void) {
+    cJSON_Hooks hooks = {
+        .malloc_fn = cjson_malloc,
+        .free_fn = cjson_free,
+    };
+    cJSON_InitHooks(&hooks);
+}
+
+void mem_tag_note_arena(mem_tag_t tag, size_t used) {
+    raise_to(&counters[tag < MEM_TAG_COUNT ? tag : MEM_TAG_OTHER].arena_peak, used);
+}
+
+void mem_tag_get_stats(mem_tag_stats_t *out) {
+    for (int i = 0; i < MEM_TAG_COUNT; i++) {
+        out[i].live = __atomic_load_n(&counters[i].live, __ATOMIC_RELAXED);
+        out[i].peak = __atomic_load_n(&counters[i].peak, __ATOMIC_RELAXED);
+        out[i].allocs = __atomic_load_n(&counters[i].allocs, __ATOMIC_RELAXED);
+        out[i].internal = __atomic_load_n(&counters[i].internal, __ATOMIC_RELAXED);
+        out[i].failures = __atomic_load_n(&counters[i].failures, __ATOMIC_RELAXED);
+        out[i].arena_peak = __atomic_load_n(&counters[i].arena_peak, __ATOMIC_RELAXED);
+    }
+}
+
+const char *mem_tag_name(mem_tag_t tag) {
+    return tag < MEM_TAG_COUNT ? names[tag] : "?";
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Memory tags - subsystem allocations routed to PSRAM and counted
+ *
+ * cJSON, protobuf-c unpacking and the components' own buffers would
+ * otherwise all come from malloc(), which is internal RAM only here
+ * (SPIRAM_USE_MALLOC is off), in many small blocks that fragment it.
+ * mem_tag_malloc() prefers PSRAM instead (MEM_BUDGET_ROUTE_PSRAM) and
+ * counts every block against a tag, so telemetry can tell who holds what.
+ *
+ * cJSON has one set of hooks for the whole program (mem_tag_install_cjson()).
+ * They charge the tag of the calling task's current scope (mem_tag_enter()),
+ * MEM_TAG_OTHER outside any; a free is taken off the tag current at the
+ * free, so a tree built under one tag and deleted under another moves
+ * between the two. Inside a scope with an arena (mem_arena.h) cJSON takes
+ * its nodes from the arena and its frees cost nothing: nothing it returns
+ * may outlive the scope, and cJSON_free() must be used for what it prints,
+ * never free().
+ *
+ * Any task may call these; not ISRs.
+ */
+
+typedef enum {
+    MEM_TAG_OTHER,
+    MEM_TAG_CAST,           // chromecast_controller: payload JSON, device auth protobuf
+    MEM_TAG_SPOTIFY,        // spotify_controller: Web API, accounts and dealer JSON
+    MEM_TAG_CONTROL,        // The local control API and its WebSocket
+    MEM_TAG_SNAPCAST,       // Snapcast client messages
+    MEM_TAG_COUNT
+} mem_tag_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t live;          // Bytes held now, arena chunks included
+    uint32_t peak;          // Highest live
+    uint32_t allocs;        // Blocks since boot
+    uint32_t internal;      // Of those, how many fell back to internal RAM
+    uint32_t failures;
+    uint32_t arena_peak;    // Most scratch one arena scope took
+} mem_tag_stats_t;
+
+typedef struct mem_arena mem_arena_t;
+
+// What mem_tag_enter() replaced, to hand back to mem_tag_leave()
+typedef struct {
+    mem_tag_t tag;
+    mem_arena_t *arena;
+} mem_tag_scope_t;
+
+/**
+ * @brief size bytes for tag, from PSRAM while it lasts, else internal RAM
+ *
+ * Free with mem_tag_free() (or free(), which leaves the count behind).
+ */
+void *mem_tag_malloc(mem_tag_t tag, size_t size);
+
+void mem_tag_free(mem_tag_t tag, void *ptr);
+
+/**
+ * @brief Make tag and arena (NULL for the heap) current for this task's cJSON calls
+ *
+ * Scopes nest. A tree taken from an arena must be deleted in its scope,
+ * not in an inner one.
+ * @return The scope to restore with mem_tag_leave()
+ */
+mem_tag_scope_t mem_tag_enter(mem_tag_t tag, mem_arena_t *arena);
+
+void mem_tag_leave(mem_tag_scope_t previous);
+
+/**
+ * @brief Route cJSON through the current scope; once at boot, before it parses
+ */
+void mem_tag_install_cjson(void);
+
+/**
+ * @brief Copy the counters, MEM_TAG_COUNT of them, by tag
+ */
+void mem_tag_get_stats(mem_tag_stats_t *out);
+
+const char *mem_tag_name(mem_tag_t tag);
+
+// mem_arena.c: an arena scope's high-water mark
+void mem_tag_note_arena(mem_tag_t tag, size_t used);
+
+#ifdef __cplusplus
+}
+#endif
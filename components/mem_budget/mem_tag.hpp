@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+#include "mem_tag.h"
+#include "mem_arena.h"
+
+/**
+ * @brief C++ side of mem_tag.h: a tagged allocator for the std:: containers
+ * and scopes for cJSON
+ */
+namespace mem_tag {
+
+// PSRAM first, charged to Tag; aborts when out of memory, as operator new
+// does without exceptions
+template <typename T, mem_tag_t Tag>
+struct Allocator {
+    using value_type = T;
+    template <typename U>
+    struct rebind {
+        using other = Allocator<U, Tag>;
+    };
+
+    Allocator() noexcept = default;
+    template <typename U>
+    Allocator(const Allocator<U, Tag>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        void* ptr = mem_tag_malloc(Tag, n * sizeof(T));
+        if (!ptr) {
+            std::abort();
+        }
+        return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T* ptr, std::size_t) noexcept {
+        mem_tag_free(Tag, ptr);
+    }
+};
+
+template <typename T, typename U, mem_tag_t Tag>
+bool operator==(const Allocator<T, Tag>&, const Allocator<U, Tag>&) noexcept {
+    return true;
+}
+
+template <typename T, typename U, mem_tag_t Tag>
+bool operator!=(const Allocator<T, Tag>&, const Allocator<U, Tag>&) noexcept {
+    return false;
+}
+
+template <mem_tag_t Tag>
+using string = std::basic_string<char, std::char_traits<char>, Allocator<char, Tag>>;
+
+// Charges this task's cJSON calls to tag until the end of the block
+class Scope {
+public:
+    explicit Scope(mem_tag_t tag) : previous(mem_tag_enter(tag, nullptr)) {}
+    ~Scope() { mem_tag_leave(previous); }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    mem_tag_scope_t previous;
+};
+
+// A Scope whose cJSON allocations come from an arena, all taken back at the
+// end of the block: a reused arena is reset for the next message, an own
+// one freed. Whatever cJSON returned must be gone by then.
+class MessageScope {
+public:
+    explicit MessageScope(mem_tag_t tag, mem_arena_t* reused = nullptr)
+        : arena(reused ? reused : &own), owned(!reused) {
+        if (owned) {
+            mem_arena_init(&own, tag, 0);
+        }
+        previous = mem_tag_enter(tag, arena);
+    }
+
+    ~MessageScope() {
+        mem_tag_leave(previous);
+        if (owned) {
+            mem_arena_release(&own);
+        } else {
+            mem_arena_reset(arena);
+        }
+    }
+
+    MessageScope(const MessageScope&) = delete;
+    MessageScope& operator=(const MessageScope&) = delete;
+
+private:
+    mem_arena_t own;
+    mem_arena_t* arena;
+    bool owned;
+    mem_tag_scope_t previous;
+};
+
+}  // namespace mem_tag
@@ -0,0 +1,180 @@
+#include "mem_task.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_memory_utils.h"
+#include "esp_timer.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "mem_task";
+
+#define PSRAM_STACK_CAPS    (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+
+#if CONFIG_MEM_TASK_STACK_PROFILE
+#define STACK_SCALE         MEM_TASK_PROFILE_SCALE
+#else
+#define STACK_SCALE         1
+#endif
+
+typedef struct {
+    TaskHandle_t handle;
+    uint32_t asked;
+    bool psram;
+} entry_t;
+
+static entry_t entries[MEM_TASK_MAX];
+
+// Held across creating and tracking a task, so one that ends at once is
+// found by mem_task_delete(), and across reading one, so it cannot end then
+static SemaphoreHandle_t lock;
+static StaticSemaphore_t lock_buffer;
+static portMUX_TYPE lock_init = portMUX_INITIALIZER_UNLOCKED;
+
+static void take_lock(void) {
+    portENTER_CRITICAL(&lock_init);
+    if (!lock) {
+        lock = xSemaphoreCreateMutexStatic(&lock_buffer);
+    }
+    portEXIT_CRITICAL(&lock_init);
+    xSemaphoreTake(lock, portMAX_DELAY);
+}
+
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t asked;
+    uint32_t used;
+    bool psram;
+} reading_t;
+
+static void read_stack(const entry_t *e, reading_t *r) {
+    uint32_t size = e->asked * STACK_SCALE;
+    uint32_t free_bytes = uxTaskGetStackHighWaterMark(e->handle) * sizeof(StackType_t);
+    strlcpy(r->name, pcTaskGetName(e->handle), sizeof(r->name));
+    r->asked = e->asked;
+    r->used = size > free_bytes ? size - free_bytes : 0;
+    r->psram = e->psram;
+}
+
+static void log_stack(const reading_t *r) {
+    uint32_t margin = r->used / 4 > MEM_TASK_STACK_MARGIN ? r->used / 4 : MEM_TASK_STACK_MARGIN;
+    uint32_t suggested = (r->used + margin + 255) & ~255u;
+    // Plain printf, a line to grep out of the monitor like the BENCH ones
+    printf("STACK,%s,%u,%u,%u,%s\n", r->name, (unsigned)r->asked, (unsigned)r->used,
+           (unsigned)suggested, r->psram ? "psram" : "internal");
+    if (r->used > r->asked) {
+        ESP_LOGW(TAG, "%s used %u bytes of stack, more than the %u it asks for",
+                 r->name, (unsigned)r->used, (unsigned)r->asked);
+    }
+}
+
+static void track(TaskHandle_t handle, uint32_t asked, bool psram) {
+    for (int i = 0; i < MEM_TASK_MAX; i++) {
+        if (!entries[i].handle) {
+            entries[i] = (entry_t){ handle, asked, psram };
+            break;
+        }
+    }
+}
+
+static bool untrack(TaskHandle_t handle, reading_t *out) {
+    bool found = false;
+    take_lock();
+    for (int i = 0; i < MEM_TASK_MAX; i++) {
+        if (entries[i].handle == handle) {
+            read_stack(&entries[i], out);
+            entries[i].handle = NULL;
+            found = true;
+            break;
+        }
+    }
+    xSemaphoreGive(lock);
+    return found;
+}
+
+#if CONFIG_MEM_TASK_STACK_PROFILE
+static void profile_timer(void *arg) {
+    mem_task_log_stacks();
+}
+
+static void start_profile(void) {
+    static esp_timer_handle_t timer;
+    if (timer) {
+        return;
+    }
+    const esp_timer_create_args_t args = {
+        .callback = profile_timer,
+        .name = "mem_task",
+    };
+    if (esp_timer_create(&args, &timer) == ESP_OK) {
+        esp_timer_start_periodic(timer, (uint64_t)MEM_TASK_PROFILE_PERIOD_S * 1000000);
+    }
+}
+#endif
+
+bool mem_task_create(TaskFunction_t fn, const char *name, uint32_t stack_bytes, void *arg,
+                     UBaseType_t priority, TaskHandle_t *handle, BaseType_t core, mem_task_stack_t stack) {
+    TaskHandle_t created = NULL;
+    uint32_t size = stack_bytes * STACK_SCALE;
+    bool psram = false;
+
+    take_lock();
+#if CONFIG_MEM_TASK_PSRAM_STACKS
+    if (stack == MEM_TASK_STACK_PSRAM) {
+        psram = xTaskCreatePinnedToCoreWithCaps(fn, name, size, arg, priority, &created, core,
+                                                PSRAM_STACK_CAPS) == pdPASS;
+        if (!psram) {
+            ESP_LOGW(TAG, "No PSRAM stack for %s, using internal RAM", name);
+        }
+    }
+#endif
+    if (!psram && xTaskCreatePinnedToCore(fn, name, size, arg, priority, &created, core) != pdPASS) {
+        xSemaphoreGive(lock);
+        ESP_LOGE(TAG, "Failed to create %s (%u byte stack)", name, (unsigned)size);
+        return false;
+    }
+    track(created, stack_bytes, psram);
+    xSemaphoreGive(lock);
+
+#if CONFIG_MEM_TASK_STACK_PROFILE
+    start_profile();
+#endif
+    if (handle) {
+        *handle = created;
+    }
+    return true;
+}
+
+void mem_task_delete(TaskHandle_t task) {
+    if (!task) {
+        task = xTaskGetCurrentTaskHandle();
+    }
+    reading_t r;
+    if (untrack(task, &r)) {
+#if CONFIG_MEM_TASK_STACK_PROFILE
+        // Short-lived tasks never see the periodic report
+        log_stack(&r);
+#endif
+    }
+    if (esp_ptr_external_ram(pxTaskGetStackStart(task))) {
+        vTaskDeleteWithCaps(task);
+    } else {
+        vTaskDelete(task);
+    }
+}
+
+void mem_task_log_stacks(void) {
+    reading_t readings[MEM_TASK_MAX];
+    int count = 0;
+    take_lock();
+    for (int i = 0; i < MEM_TASK_MAX; i++) {
+        if (entries[i].handle) {
+            read_stack(&entries[i], &readings[count++]);
+        }
+    }
+    xSemaphoreGive(lock);
+
+    for (int i = 0; i < count; i++) {
+        log_stack(&readings[i]);
+    }
+}
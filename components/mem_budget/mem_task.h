@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Memory tasks - task stacks in PSRAM where a task allows it
+ *
+ * A stack in PSRAM is reached through the same cache as flash, so its
+ * task cannot run while the cache is off, and must never be the one to
+ * turn it off: no NVS (reads included), no esp_partition, no FAT on
+ * /flash, nothing that calls into esp_flash, and no ISR work. Real-time
+ * tasks (audio out, touch) keep internal stacks as well, for the latency.
+ * Everything else (sockets, parsing, recognition) can move its stack out
+ * and leave the internal RAM to the DMA draw buffers, Wi-Fi and TLS.
+ *
+ * mem_task_create() takes the placement per task. MEM_TASK_STACK_PSRAM
+ * falls back to internal RAM without PSRAM or with MEM_TASK_PSRAM_STACKS
+ * off. A task created here must end through mem_task_delete(), itself or
+ * from outside, never vTaskDelete().
+ *
+ * With MEM_TASK_STACK_PROFILE every stack is made MEM_TASK_PROFILE_SCALE
+ * times the size asked, and each task's high-water mark is logged every
+ * MEM_TASK_PROFILE_PERIOD_S as
+ *
+ *   STACK,<name>,<asked>,<used>,<suggested>,<internal|psram>
+ *
+ * where suggested is the most used so far plus a quarter (at least
+ * MEM_TASK_STACK_MARGIN), rounded up to 256 bytes: what to set the task's
+ * stack constant to once the profiling build has run through its paths.
+ */
+
+#define MEM_TASK_MAX                24      // Tasks tracked for the report at once
+#define MEM_TASK_STACK_MARGIN       512
+#define MEM_TASK_PROFILE_SCALE      2
+#define MEM_TASK_PROFILE_PERIOD_S   60
+
+typedef enum {
+    MEM_TASK_STACK_INTERNAL,    // Touches flash, or is real-time
+    MEM_TASK_STACK_PSRAM,       // Neither
+} mem_task_stack_t;
+
+/**
+ * @brief xTaskCreatePinnedToCore() with the stack where asked
+ *
+ * @param core tskNO_AFFINITY for either
+ * @return false if the task could not be created
+ */
+bool mem_task_create(TaskFunction_t fn, const char *name, uint32_t stack_bytes, void *arg,
+                     UBaseType_t priority, TaskHandle_t *handle, BaseType_t core, mem_task_stack_t stack);
+
+/**
+ * @brief Delete a task made by mem_task_create(); NULL for the calling one
+ */
+void mem_task_delete(TaskHandle_t task);
+
+/**
+ * @brief Log the STACK line of every task made here and still running
+ */
+void mem_task_log_stacks(void);
+
+#ifdef __cplusplus
+}
+#endif
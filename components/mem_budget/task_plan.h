@@ -0,0 +1,82 @@
+#pragma once
+
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+
+/**
+ * @brief Task plan - which core and priority each task runs at
+ *
+ * Every task belongs to one of four classes, each with a core and a base
+ * priority (menu "Task scheduling"):
+ *
+ *   - Audio: the decoder, its I2S writer, the Snapcast player and the card
+ *     reads ahead of them. Above everything else on their core, so a frame
+ *     is never late because LVGL is drawing.
+ *   - UI: LVGL, touch, wake word and command recognition. Below audio.
+ *   - Network: Cast, Spotify, Snapcast and stream sockets, on the core the
+ *     Wi-Fi driver and lwIP are pinned to, off the audio core.
+ *   - Background: indexing, art, settings flushes and anything else that
+ *     can wait, on either core and below all of the above.
+ *
+ * Producers that feed playback (microphone capture, touch reads, the
+ * recorder) run on the other core from the one they would compete with.
+ * The rows below are the only place task priorities and cores are set;
+ * a module's own *_PRIORITY constant refers to its row here.
+ */
+
+#define TASK_PLAN_OTHER_CORE(core)      ((core) ? 0 : 1)
+
+// Audio
+#define TASK_PLAN_AUDIO_DECODE_PRIORITY     CONFIG_TASK_PLAN_AUDIO_PRIORITY     // The writer runs one above
+#define TASK_PLAN_AUDIO_DECODE_CORE         CONFIG_TASK_PLAN_AUDIO_CORE
+#define TASK_PLAN_SNAPCAST_PLAY_PRIORITY    (CONFIG_TASK_PLAN_AUDIO_PRIORITY + 1)
+#define TASK_PLAN_SNAPCAST_PLAY_CORE        CONFIG_TASK_PLAN_AUDIO_CORE
+#define TASK_PLAN_SD_READ_AHEAD_PRIORITY    (CONFIG_TASK_PLAN_AUDIO_PRIORITY + 1)   // Mostly waits on the card
+#define TASK_PLAN_SD_READ_AHEAD_CORE        CONFIG_TASK_PLAN_AUDIO_CORE
+#define TASK_PLAN_SPEECH_FEED_PRIORITY      CONFIG_TASK_PLAN_AUDIO_PRIORITY         // Keeps up with the mic DMA
+#define TASK_PLAN_SPEECH_FEED_CORE          TASK_PLAN_OTHER_CORE(CONFIG_TASK_PLAN_AUDIO_CORE)
+
+// UI
+#define TASK_PLAN_LVGL_PRIORITY             CONFIG_TASK_PLAN_UI_PRIORITY
+#define TASK_PLAN_LVGL_CORE                 CONFIG_TASK_PLAN_UI_CORE
+#define TASK_PLAN_TOUCH_PRIORITY            (CONFIG_TASK_PLAN_UI_PRIORITY + 1)
+#define TASK_PLAN_TOUCH_CORE                TASK_PLAN_OTHER_CORE(CONFIG_TASK_PLAN_UI_CORE)
+#define TASK_PLAN_SPEECH_DETECT_PRIORITY    CONFIG_TASK_PLAN_UI_PRIORITY
+#define TASK_PLAN_SPEECH_DETECT_CORE        TASK_PLAN_OTHER_CORE(CONFIG_TASK_PLAN_AUDIO_CORE)
+#define TASK_PLAN_DRIVER_PRIORITY           (CONFIG_TASK_PLAN_UI_PRIORITY - 1)      // Keys, battery, RTC
+#define TASK_PLAN_DRIVER_CORE               TASK_PLAN_OTHER_CORE(CONFIG_TASK_PLAN_UI_CORE)
+#define TASK_PLAN_LVGL_BLEND_PRIORITY       CONFIG_TASK_PLAN_UI_PRIORITY            // Half of each large blend
+#define TASK_PLAN_LVGL_BLEND_CORE           TASK_PLAN_OTHER_CORE(CONFIG_TASK_PLAN_UI_CORE)
+
+// Network
+#define TASK_PLAN_NETWORK_CORE              CONFIG_TASK_PLAN_NETWORK_CORE
+#define TASK_PLAN_CAST_RECEIVE_PRIORITY     CONFIG_TASK_PLAN_NETWORK_PRIORITY
+#define TASK_PLAN_CAST_POOL_PRIORITY        CONFIG_TASK_PLAN_NETWORK_PRIORITY
+#define TASK_PLAN_CAST_CONNECT_PRIORITY     (CONFIG_TASK_PLAN_NETWORK_PRIORITY - 1)
+#define TASK_PLAN_CAST_VOLUME_PRIORITY      (CONFIG_TASK_PLAN_NETWORK_PRIORITY - 1)
+#define TASK_PLAN_DISCOVERY_PRIORITY        (CONFIG_TASK_PLAN_NETWORK_PRIORITY - 1)
+#define TASK_PLAN_SPOTIFY_DEALER_PRIORITY   CONFIG_TASK_PLAN_NETWORK_PRIORITY
+#define TASK_PLAN_SNAPCAST_NET_PRIORITY     (CONFIG_TASK_PLAN_NETWORK_PRIORITY - 1)
+#define TASK_PLAN_AUDIO_STREAM_PRIORITY     (CONFIG_TASK_PLAN_NETWORK_PRIORITY - 1)
+
+// Background
+#define TASK_PLAN_BACKGROUND_CORE           tskNO_AFFINITY
+#define TASK_PLAN_BACKGROUND_PRIORITY       CONFIG_TASK_PLAN_BACKGROUND_PRIORITY
+#define TASK_PLAN_SPOTIFY_WORKER_PRIORITY   (CONFIG_TASK_PLAN_BACKGROUND_PRIORITY + 1)
+#define TASK_PLAN_CAST_PREWARM_PRIORITY     CONFIG_TASK_PLAN_BACKGROUND_PRIORITY    // Speculative connects
+#define TASK_PLAN_RECORDER_PRIORITY         (CONFIG_TASK_PLAN_BACKGROUND_PRIORITY + 1)
+#define TASK_PLAN_RECORDER_CORE             TASK_PLAN_OTHER_CORE(CONFIG_TASK_PLAN_AUDIO_CORE)   // Opus is heavy
+#define TASK_PLAN_IMU_PRIORITY              (CONFIG_TASK_PLAN_BACKGROUND_PRIORITY + 1)
+#define TASK_PLAN_IMU_CORE                  TASK_PLAN_OTHER_CORE(CONFIG_TASK_PLAN_AUDIO_CORE)
+#define TASK_PLAN_MEDIA_SERVER_PRIORITY     (CONFIG_TASK_PLAN_BACKGROUND_PRIORITY + 1)
+#define TASK_PLAN_PROMPT_PRIORITY           CONFIG_TASK_PLAN_BACKGROUND_PRIORITY    // Spoken feedback, synthesised rarely
+#define TASK_PLAN_PROMPT_CORE               TASK_PLAN_OTHER_CORE(CONFIG_TASK_PLAN_AUDIO_CORE)
+#define TASK_PLAN_CAST_LOOP_PRIORITY        CONFIG_TASK_PLAN_BACKGROUND_PRIORITY
+#define TASK_PLAN_LOG_PRIORITY              CONFIG_TASK_PLAN_BACKGROUND_PRIORITY    // Console writes of queued lines
+
+#if CONFIG_TASK_PLAN_AUDIO_PRIORITY <= CONFIG_TASK_PLAN_UI_PRIORITY
+#error "Audio tasks must run above the UI"
+#endif
+#if CONFIG_TASK_PLAN_UI_PRIORITY - 1 <= CONFIG_TASK_PLAN_BACKGROUND_PRIORITY + 1
+#error "Background tasks must run below the UI"
+#endif
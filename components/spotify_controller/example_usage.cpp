@@ -208,9 +208,9 @@ void spotify_chromecast_example() {
     
     // Example track URI (replace with actual track)
     std::string track_uri = "spotify:track:4iV5W9uYEdYUVa79Axb7Rh"; // "Never Gonna Give You Up"
-    std::string chromecast_ip = "192.168.1.100"; // Replace with actual Chromecast IP
+    std::string device_name = "Living Room speaker"; // A Cast device running the Spotify receiver
     
-    bool success = spotify_controller->cast_to_chromecast(chromecast_ip, track_uri);
+    bool success = spotify_controller->cast_to_device(device_name, track_uri);
     if (success) {
         ESP_LOGI(TAG, "Successfully initiated casting to Chromecast");
     } else {
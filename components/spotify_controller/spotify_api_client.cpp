@@ -1,22 +1,102 @@
 #include "spotify_api_client.h"
+#include "spotify_response_parser.h"
+#include "json_writer.h"
+#include "url_builder.h"
 #include "esp_log.h"
+#include "mem_tag.hpp"
+#include "traffic_capture.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <cstring>
-#include <sstream>
+#include <strings.h>
 
 static const char *TAG = "spotify_api_client";
 
+// A player command's path with the optional device_id every one of them takes
+static void player_endpoint(UrlBuilder& url, const char* path, const std::string& device_id) {
+    url.append(path).param_if_set("device_id", device_id.c_str());
+}
+
+// Query strings carrying user text can outgrow the buffer; those are refused
+static bool endpoint_ok(const UrlBuilder& url) {
+    if (!url.ok()) {
+        ESP_LOGE(TAG, "Endpoint longer than %d bytes: %.48s...", (int)url.size(), url.c_str());
+        return false;
+    }
+    return true;
+}
+
+#ifdef CONFIG_SPOTIFY_HTTP2
+// Offset of the path in an absolute URL (npos if there is none)
+static size_t url_path_offset(const std::string& url) {
+    size_t scheme_end = url.find("://");
+    return url.find('/', scheme_end == std::string::npos ? 0 : scheme_end + 3);
+}
+#endif
+
+// Only what the track list shows; drops available_markets, preview_url,
+// external_ids and the per-item added_by/added_at blocks from every page
+static const char *PLAYLIST_TRACK_FIELDS =
+    "items(track(id,name,uri,duration_ms,artists(name),album(name,images(url,width))))";
+
+// Cache payload for playlist pages: per record, NUL-terminated id, name,
+// uri, image_url, owner and decimal track_count
+static void encode_playlist(std::string& out, const SpotifyPlaylist& playlist) {
+    const std::string* fields[] = {
+        &playlist.id, &playlist.name, &playlist.uri, &playlist.image_url, &playlist.owner
+    };
+    for (const std::string* field : fields) {
+        out.append(field->c_str(), strlen(field->c_str()) + 1);
+    }
+    out += std::to_string(playlist.track_count);
+    out.push_back('\0');
+}
+
+static bool decode_playlists(const std::string& in, const SpotifyApiClient::PlaylistSink& sink) {
+    // Decode everything before emitting so a corrupt payload emits nothing
+    std::vector<SpotifyPlaylist> playlists;
+    size_t pos = 0;
+    while (pos < in.length()) {
+        std::string fields[6];
+        for (std::string& field : fields) {
+            size_t end = in.find('\0', pos);
+            if (end == std::string::npos) {
+                return false;
+            }
+            field.assign(in, pos, end - pos);
+            pos = end + 1;
+        }
+
+        SpotifyPlaylist playlist = {};
+        playlist.id = fields[0];
+        playlist.name = fields[1];
+        playlist.uri = fields[2];
+        playlist.image_url = fields[3];
+        playlist.owner = fields[4];
+        playlist.track_count = atoi(fields[5].c_str());
+        playlists.push_back(playlist);
+    }
+
+    for (const SpotifyPlaylist& playlist : playlists) {
+        sink(playlist);
+    }
+    return true;
+}
+
 SpotifyApiClient::SpotifyApiClient() 
-    : http_client(nullptr)
+    : http_ready(false)
+    , access_token_expires_at(0)
     , base_url(SPOTIFY_API_BASE_URL)
+    , image_target(SpotifyStreamParser::DEFAULT_IMAGE_TARGET)
     , response_callback(nullptr)
     , playback_callback(nullptr)
     , playlists_callback(nullptr)
     , tracks_callback(nullptr)
     , devices_callback(nullptr)
     , error_callback(nullptr)
-    , callback_user_data(nullptr)
-    , last_request_time(0)
-    , requests_per_second_limit(DEFAULT_RATE_LIMIT) {
+    , token_refresh_callback(nullptr)
+    , callback_user_data(nullptr) {
 }
 
 SpotifyApiClient::~SpotifyApiClient() {
@@ -41,36 +121,73 @@ void SpotifyApiClient::deinitialize() {
     ESP_LOGI(TAG, "Deinitializing Spotify API client");
     cleanup_http_client();
     access_token.clear();
+    access_token_expires_at = 0;
 }
 
-void SpotifyApiClient::set_access_token(const std::string& token) {
+void SpotifyApiClient::set_access_token(const std::string& token, time_t expires_at) {
     access_token = token;
+    access_token_expires_at = expires_at;
     ESP_LOGI(TAG, "Access token updated");
 }
 
+// Normally the auth client has refreshed in the background long before this
+// point; this only catches a token that the background refresh missed
+void SpotifyApiClient::ensure_fresh_token() {
+    if (!token_refresh_callback || access_token_expires_at == 0) {
+        return;
+    }
+
+    time_t now;
+    time(&now);
+    if (access_token_expires_at - now > TOKEN_EXPIRY_SLACK_SECONDS) {
+        return;
+    }
+
+    ESP_LOGI(TAG, "Access token about to expire, refreshing before request");
+    if (!token_refresh_callback(callback_user_data)) {
+        ESP_LOGW(TAG, "Token refresh failed, sending with current token");
+    }
+}
+
+bool SpotifyApiClient::prewarm() {
+    if (!http_ready) {
+        return false;
+    }
+    ensure_fresh_token();
+#ifdef CONFIG_SPOTIFY_HTTP2
+    // HTTP/2 can open its connection without sending a request
+    if (h2_client && h2_client->available()) {
+        return h2_client->warm_up();
+    }
+#endif
+    return http_pool->is_warm(base_url.c_str());
+}
+
 bool SpotifyApiClient::setup_http_client() {
-    esp_http_client_config_t config = {};
-    config.url = base_url.c_str();
-    config.event_handler = http_event_handler;
-    config.user_data = this;
-    config.timeout_ms = HTTP_TIMEOUT_MS;
-    config.buffer_size = 4096;
-    config.buffer_size_tx = 2048;
+    // Share the controller's pool when one was provided so the token refresh
+    // and the API call that follows ride already-open connections
+    if (!http_pool) {
+        http_pool = std::make_shared<SpotifyHttpPool>();
+    }
     
-    http_client = esp_http_client_init(&config);
-    if (!http_client) {
-        ESP_LOGE(TAG, "Failed to initialize HTTP client");
-        return false;
+#ifdef CONFIG_SPOTIFY_HTTP2
+    if (!h2_client) {
+        size_t host_start = base_url.find("://") + 3;
+        std::string host = base_url.substr(host_start, url_path_offset(base_url) - host_start);
+        h2_client = std::make_unique<SpotifyH2Client>(host.c_str());
     }
+#endif
     
+    http_ready = true;
     return true;
 }
 
 void SpotifyApiClient::cleanup_http_client() {
-    if (http_client) {
-        esp_http_client_cleanup(http_client);
-        http_client = nullptr;
-    }
+    // The pool outlives a disconnect so a reconnect reuses its connections
+    http_ready = false;
+#ifdef CONFIG_SPOTIFY_HTTP2
+    prefetched.clear();
+#endif
 }
 
 std::string SpotifyApiClient::build_url(const std::string& endpoint) {
@@ -87,14 +204,14 @@ std::string SpotifyApiClient::build_url(const std::string& endpoint) {
     return url;
 }
 
-bool SpotifyApiClient::add_auth_header() {
+bool SpotifyApiClient::add_auth_header(esp_http_client_handle_t client) {
     if (access_token.empty()) {
         ESP_LOGE(TAG, "No access token available");
         return false;
     }
     
     std::string auth_header = "Bearer " + access_token;
-    esp_err_t err = esp_http_client_set_header(http_client, "Authorization", auth_header.c_str());
+    esp_err_t err = esp_http_client_set_header(client, "Authorization", auth_header.c_str());
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to set authorization header: %s", esp_err_to_name(err));
         return false;
@@ -103,109 +220,408 @@ bool SpotifyApiClient::add_auth_header() {
     return true;
 }
 
-bool SpotifyApiClient::check_rate_limit() {
-    time_t now;
-    time(&now);
+static bool parse_method(const std::string& name, esp_http_client_method_t* method) {
+    if (name == "GET") {
+        *method = HTTP_METHOD_GET;
+    } else if (name == "POST") {
+        *method = HTTP_METHOD_POST;
+    } else if (name == "PUT") {
+        *method = HTTP_METHOD_PUT;
+    } else if (name == "DELETE") {
+        *method = HTTP_METHOD_DELETE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool SpotifyApiClient::begin_request(const SpotifyApiRequest& request, SpotifyApiResponse& response,
+                                     const AbortCallback* should_abort) {
+    if (should_abort && (*should_abort)()) {
+        response.cancelled = true;
+        response.error_message = "Cancelled";
+        return false;
+    }
+    
+    if (!http_ready) {
+        response.error_message = "HTTP client not initialized";
+        ESP_LOGE(TAG, "%s", response.error_message.c_str());
+        return false;
+    }
+    
+    esp_http_client_method_t method;
+    if (!parse_method(request.method, &method)) {
+        response.error_message = "Unsupported HTTP method: " + request.method;
+        ESP_LOGE(TAG, "%s", response.error_message.c_str());
+        return false;
+    }
     
-    // Simple rate limiting - ensure minimum time between requests
-    if (now == last_request_time) {
-        // Wait a bit if making requests too quickly
-        vTaskDelay(pdMS_TO_TICKS(100));
+    // Never wait here: the worker defers the request until there is budget
+    if (!rate_limiter.try_acquire(SpotifyRateLimiter::classify(request.endpoint))) {
+        response.rate_limited = true;
+        response.error_message = "Rate limited";
+        ESP_LOGW(TAG, "Rate limited, not sending %s %s", request.method.c_str(), request.endpoint.c_str());
+        return false;
     }
     
-    last_request_time = now;
+    // Renew a nearly expired token before sending, rather than eat a 401
+    if (request.requires_auth) {
+        ensure_fresh_token();
+        if (access_token.empty()) {
+            response.error_message = "Failed to add authorization header";
+            ESP_LOGE(TAG, "No access token available");
+            return false;
+        }
+    }
     return true;
 }
 
-SpotifyApiResponse SpotifyApiClient::make_request(const SpotifyApiRequest& request) {
+void SpotifyApiClient::finish_response(SpotifyApiResponse& response, bool revalidated, int retry_after_s) {
+    if (response.status_code >= 200 && response.status_code < 300) {
+        response.success = true;
+    } else if (response.status_code == 304 && revalidated) {
+        response.success = true;
+        response.not_modified = true;
+    } else if (response.status_code == 429) {
+        // Throttled: back off every endpoint; the worker retries the request
+        response.rate_limited = true;
+        rate_limiter.retry_after(retry_after_s >= 0 ? retry_after_s * 1000 : SpotifyRateLimiter::DEFAULT_RETRY_AFTER_MS);
+        response.error_message = "Rate limited by Spotify";
+    } else {
+        response.success = false;
+        handle_api_error(response.status_code, response.body);
+    }
+}
+
+SpotifyApiResponse SpotifyApiClient::make_request(const SpotifyApiRequest& request,
+                                                  const SpotifyHttpPool::DataCallback* stream,
+                                                  const AbortCallback* should_abort) {
+    if (replay_source) {
+        return replay_request(request, stream);
+    }
+    if (!traffic_capture_active()) {
+        return perform_request(request, stream, should_abort);
+    }
+
+    // Keep a copy of what the caller streams: the record holds the whole body
+    std::string streamed;
+    SpotifyHttpPool::DataCallback tee;
+    if (stream) {
+        tee = [&streamed, stream](const char* data, size_t length) {
+            streamed.append(data, length);
+            (*stream)(data, length);
+        };
+    }
+    SpotifyApiResponse response = perform_request(request, stream ? &tee : nullptr, should_abort);
+    if (!response.cancelled && response.status_code != 0) {
+        std::string key = request.method + " " + request.endpoint;
+        streamed += response.body;
+        traffic_capture_record(TRAFFIC_SPOTIFY_RESPONSE, key.c_str(), response.status_code,
+                               streamed.data(), streamed.size());
+    }
+    return response;
+}
+
+SpotifyApiResponse SpotifyApiClient::replay_request(const SpotifyApiRequest& request,
+                                                    const SpotifyHttpPool::DataCallback* stream) {
+    SpotifyApiResponse response = {};
+    response.success = false;
+    if (!replay_source(request, response)) {
+        response.status_code = 0;
+        response.body.clear();
+        response.error_message = "Not in the replay";
+        ESP_LOGD(TAG, "%s %s: %s", request.method.c_str(), request.endpoint.c_str(), response.error_message.c_str());
+        return response;
+    }
+    // As the transports do: a streaming caller gets successful bodies only
+    if (stream && response.status_code >= 200 && response.status_code < 300) {
+        for (size_t offset = 0; offset < response.body.size(); offset += REPLAY_CHUNK_SIZE) {
+            (*stream)(response.body.data() + offset, std::min(REPLAY_CHUNK_SIZE, response.body.size() - offset));
+        }
+        response.body.clear();
+    }
+    finish_response(response, request.conditional && response.status_code == 304, -1);
+    return response;
+}
+
+SpotifyApiResponse SpotifyApiClient::perform_request(const SpotifyApiRequest& request,
+                                                     const SpotifyHttpPool::DataCallback* stream,
+                                                     const AbortCallback* should_abort) {
     SpotifyApiResponse response = {};
     response.success = false;
     
-    if (!http_client) {
-        response.error_message = "HTTP client not initialized";
-        ESP_LOGE(TAG, "%s", response.error_message.c_str());
+#ifdef CONFIG_SPOTIFY_HTTP2
+    if (!(should_abort && (*should_abort)()) && take_prefetched(request, stream, response)) {
         return response;
     }
+#endif
     
-    // Check rate limit
-    if (!check_rate_limit()) {
-        response.error_message = "Rate limit exceeded";
-        ESP_LOGE(TAG, "%s", response.error_message.c_str());
+    if (!begin_request(request, response, should_abort)) {
+        return response;
+    }
+    
+#ifdef CONFIG_SPOTIFY_HTTP2
+    const SpotifyApiRequest* requests[] = { &request };
+    if (perform_h2(requests, &response, 1, stream, should_abort)) {
         return response;
     }
+#endif
+    
+    esp_http_client_method_t method;
+    parse_method(request.method, &method);
     
-    // Build full URL
+    // Build full URL and lease the pooled client for the API host
     std::string url = build_url(request.endpoint);
-    esp_http_client_set_url(http_client, url.c_str());
-    
-    // Set HTTP method
-    if (request.method == "GET") {
-        esp_http_client_set_method(http_client, HTTP_METHOD_GET);
-    } else if (request.method == "POST") {
-        esp_http_client_set_method(http_client, HTTP_METHOD_POST);
-    } else if (request.method == "PUT") {
-        esp_http_client_set_method(http_client, HTTP_METHOD_PUT);
-    } else if (request.method == "DELETE") {
-        esp_http_client_set_method(http_client, HTTP_METHOD_DELETE);
-    } else {
-        response.error_message = "Unsupported HTTP method: " + request.method;
+    esp_http_client_handle_t client = http_pool->acquire(url.c_str());
+    if (!client) {
+        response.error_message = "No HTTP connection available";
         ESP_LOGE(TAG, "%s", response.error_message.c_str());
         return response;
     }
     
-    // Set headers
-    esp_http_client_set_header(http_client, "Content-Type", "application/json");
+    esp_http_client_set_method(client, method);
+    
+    // Set headers; the pool inflates gzip bodies before anyone sees them
+    esp_http_client_set_header(client, "Content-Type", "application/json");
+    esp_http_client_set_header(client, "Accept-Encoding", "gzip");
     
-    if (request.requires_auth && !add_auth_header()) {
+    if (request.requires_auth && !add_auth_header(client)) {
+        http_pool->release(client);
         response.error_message = "Failed to add authorization header";
         return response;
     }
     
+    // Revalidate instead of re-downloading when we hold an ETag
+    std::string cached_etag;
+    if (request.conditional && method == HTTP_METHOD_GET &&
+        response_cache.get_etag(request.endpoint, cached_etag)) {
+        esp_http_client_set_header(client, "If-None-Match", cached_etag.c_str());
+    }
+    int retry_after_s = -1;
+    SpotifyHttpPool::HeaderCallback on_header = [&response, &retry_after_s](const char* key, const char* value) {
+        if (strcasecmp(key, "ETag") == 0) {
+            response.etag = value;
+        } else if (strcasecmp(key, "Retry-After") == 0) {
+            retry_after_s = atoi(value);
+        }
+    };
+    
     // Set request body for POST/PUT
     if (!request.body.empty() && (request.method == "POST" || request.method == "PUT")) {
-        esp_http_client_set_post_field(http_client, request.body.c_str(), request.body.length());
+        esp_http_client_set_post_field(client, request.body.c_str(), request.body.length());
     }
     
-    // Perform request
-    esp_err_t err = esp_http_client_perform(http_client);
+    // Perform request. A streaming caller gets successful bodies chunk by
+    // chunk; error bodies are still collected for handle_api_error().
+    esp_err_t err;
+    if (stream) {
+        err = http_pool->perform(client, [&](const char* data, size_t length) {
+            int status = esp_http_client_get_status_code(client);
+            if (status >= 200 && status < 300) {
+                (*stream)(data, length);
+            } else {
+                response.body.append(data, length);
+            }
+        }, &on_header, should_abort);
+    } else {
+        err = http_pool->perform(client, response.body, &on_header);
+    }
+    if (err == ESP_ERR_NOT_FINISHED) {
+        http_pool->release(client, false);
+        response.cancelled = true;
+        response.error_message = "Cancelled";
+        ESP_LOGD(TAG, "%s %s cancelled", request.method.c_str(), request.endpoint.c_str());
+        return response;
+    }
     if (err != ESP_OK) {
+        http_pool->release(client, false);
         response.error_message = "HTTP request failed: " + std::string(esp_err_to_name(err));
         ESP_LOGE(TAG, "%s", response.error_message.c_str());
         return response;
     }
     
     // Get response status
-    response.status_code = esp_http_client_get_status_code(http_client);
-    int content_length = esp_http_client_get_content_length(http_client);
+    response.status_code = esp_http_client_get_status_code(client);
+    http_pool->release(client);
     
     ESP_LOGD(TAG, "API request: %s %s -> %d (%d bytes)", 
              request.method.c_str(), request.endpoint.c_str(), 
-             response.status_code, content_length);
-    
-    // Read response body
-    if (content_length > 0) {
-        char* buffer = (char*)malloc(content_length + 1);
-        if (buffer) {
-            int data_read = esp_http_client_read_response(http_client, buffer, content_length);
-            buffer[data_read] = '\0';
-            response.body = buffer;
-            free(buffer);
-        } else {
-            response.error_message = "Failed to allocate response buffer";
-            ESP_LOGE(TAG, "%s", response.error_message.c_str());
-            return response;
+             response.status_code, (int)response.body.length());
+    
+    finish_response(response, !cached_etag.empty(), retry_after_s);
+    return response;
+}
+
+#ifdef CONFIG_SPOTIFY_HTTP2
+// requests have been through begin_request(); false if the HTTP/2
+// connection could not be used and nothing was sent (the pool takes over)
+bool SpotifyApiClient::perform_h2(const SpotifyApiRequest* const* requests, SpotifyApiResponse* responses, size_t count,
+                                  const SpotifyHttpPool::DataCallback* stream, const AbortCallback* should_abort) {
+    if (!h2_client || !h2_client->available() || count > SpotifyH2Client::MAX_STREAMS) {
+        return false;
+    }
+    
+    // On the heap: the worker's stack already carries the TLS session
+    std::vector<SpotifyH2Client::Exchange> exchanges(count);
+    std::vector<std::string> etags(count);
+    std::vector<int> retry_after_s(count, -1);
+    std::vector<SpotifyHttpPool::HeaderCallback> on_header(count);
+    SpotifyHttpPool::DataCallback on_data;
+    std::string authorization = "Bearer " + access_token;
+    size_t path_offset = url_path_offset(base_url);
+    
+    for (size_t i = 0; i < count; i++) {
+        const SpotifyApiRequest& request = *requests[i];
+        SpotifyApiResponse& response = responses[i];
+        SpotifyH2Client::Exchange& exchange = exchanges[i];
+        
+        exchange.method = request.method.c_str();
+        exchange.path = build_url(request.endpoint).substr(path_offset);
+        exchange.headers[exchange.header_count++] = { "content-type", "application/json" };
+        exchange.headers[exchange.header_count++] = { "accept-encoding", "gzip" };
+        // Same value on every stream, so HPACK sends the token once per connection
+        if (request.requires_auth) {
+            exchange.headers[exchange.header_count++] = { "authorization", authorization.c_str() };
+        }
+        if (request.conditional && request.method == "GET" &&
+            response_cache.get_etag(request.endpoint, etags[i])) {
+            exchange.headers[exchange.header_count++] = { "if-none-match", etags[i].c_str() };
+        }
+        if (!request.body.empty() && (request.method == "POST" || request.method == "PUT")) {
+            exchange.body = &request.body;
         }
+        
+        int* retry_after = &retry_after_s[i];
+        on_header[i] = [&response, retry_after](const char* key, const char* value) {
+            if (strcasecmp(key, "etag") == 0) {
+                response.etag = value;
+            } else if (strcasecmp(key, "retry-after") == 0) {
+                *retry_after = atoi(value);
+            }
+        };
+        exchange.on_header = &on_header[i];
+        exchange.body_out = &response.body;
+        exchange.should_abort = should_abort;
     }
     
-    // Check if request was successful
-    if (response.status_code >= 200 && response.status_code < 300) {
-        response.success = true;
-    } else {
-        response.success = false;
-        handle_api_error(response.status_code, response.body);
+    // Only a single request streams; batches are buffered
+    if (stream && count == 1) {
+        SpotifyH2Client::Exchange& exchange = exchanges[0];
+        SpotifyApiResponse& response = responses[0];
+        on_data = [&exchange, &response, stream](const char* data, size_t length) {
+            if (exchange.status >= 200 && exchange.status < 300) {
+                (*stream)(data, length);
+            } else {
+                response.body.append(data, length);
+            }
+        };
+        exchange.on_data = &on_data;
     }
     
-    return response;
+    esp_err_t err = h2_client->perform(exchanges.data(), count);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "HTTP/2 unavailable (%s), using HTTP/1.1", esp_err_to_name(err));
+        return false;
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        const SpotifyApiRequest& request = *requests[i];
+        SpotifyApiResponse& response = responses[i];
+        const SpotifyH2Client::Exchange& exchange = exchanges[i];
+        if (exchange.err == ESP_ERR_NOT_FINISHED) {
+            response.cancelled = true;
+            response.error_message = "Cancelled";
+            ESP_LOGD(TAG, "%s %s cancelled", request.method.c_str(), request.endpoint.c_str());
+            continue;
+        }
+        if (exchange.err != ESP_OK || exchange.status == 0) {
+            response.error_message = "HTTP/2 stream failed";
+            ESP_LOGE(TAG, "%s %s: %s", request.method.c_str(), request.endpoint.c_str(), response.error_message.c_str());
+            continue;
+        }
+        
+        response.status_code = exchange.status;
+        ESP_LOGD(TAG, "API request (h2): %s %s -> %d (%d bytes)",
+                 request.method.c_str(), request.endpoint.c_str(),
+                 response.status_code, (int)response.body.length());
+        finish_response(response, !etags[i].empty(), retry_after_s[i]);
+    }
+    return true;
+}
+
+bool SpotifyApiClient::take_prefetched(const SpotifyApiRequest& request, const SpotifyHttpPool::DataCallback* stream,
+                                       SpotifyApiResponse& response) {
+    if (request.method != "GET") {
+        return false;
+    }
+    for (auto it = prefetched.begin(); it != prefetched.end(); ++it) {
+        if (it->endpoint != request.endpoint) {
+            continue;
+        }
+        bool fresh = (xTaskGetTickCount() - it->fetched_at) <= pdMS_TO_TICKS(PREFETCH_MAX_AGE_MS);
+        if (fresh) {
+            response = std::move(it->response);
+        }
+        prefetched.erase(it);
+        if (!fresh) {
+            return false;
+        }
+        
+        // A streaming caller gets the buffered body as one chunk
+        if (stream && response.success && !response.not_modified) {
+            (*stream)(response.body.data(), response.body.length());
+            response.body.clear();
+        }
+        return true;
+    }
+    return false;
+}
+#endif
+
+bool SpotifyApiClient::prefetch_user_data(bool devices) {
+#ifdef CONFIG_SPOTIFY_HTTP2
+    prefetched.clear();
+    if (!h2_client || !h2_client->available()) {
+        return false;
+    }
+    
+    SpotifyApiRequest candidates[] = {
+        { .method = "GET", .endpoint = playlists_endpoint("me", 20, 0), .body = "", .requires_auth = true, .conditional = true },
+        { .method = "GET", .endpoint = "/me/player/devices", .body = "", .requires_auth = true, .conditional = true },
+        { .method = "GET", .endpoint = "/me/player", .body = "", .requires_auth = true, .conditional = true },
+    };
+    constexpr size_t CANDIDATES = sizeof(candidates) / sizeof(candidates[0]);
+    
+    // Whatever the rate limiter holds back is left to its own call
+    const SpotifyApiRequest* requests[CANDIDATES];
+    SpotifyApiResponse responses[CANDIDATES] = {};
+    size_t count = 0;
+    for (const SpotifyApiRequest& request : candidates) {
+        if (!devices && request.endpoint == "/me/player/devices") {
+            continue;
+        }
+        SpotifyApiResponse refused = {};
+        if (begin_request(request, refused, nullptr)) {
+            requests[count++] = &request;
+        }
+    }
+    if (count == 0 || !perform_h2(requests, responses, count, nullptr, nullptr)) {
+        return false;
+    }
+    
+    // Answers (errors included: they have been reported) wait for their call;
+    // a failed stream or a 429 is left to the call to retry
+    TickType_t now = xTaskGetTickCount();
+    for (size_t i = 0; i < count; i++) {
+        if (responses[i].status_code != 0 && responses[i].status_code != 429) {
+            prefetched.push_back({ requests[i]->endpoint, std::move(responses[i]), now });
+        }
+    }
+    ESP_LOGD(TAG, "Prefetched %d of %d user data requests", (int)prefetched.size(), (int)count);
+    return !prefetched.empty();
+#else
+    return false;
+#endif
 }
 
 void SpotifyApiClient::handle_api_error(int status_code, const std::string& response_body) {
@@ -213,6 +629,7 @@ void SpotifyApiClient::handle_api_error(int status_code, const std::string& resp
     
     // Try to parse error details from response
     if (!response_body.empty()) {
+        mem_tag::MessageScope scope(MEM_TAG_SPOTIFY);
         cJSON* json = cJSON_Parse(response_body.c_str());
         if (json) {
             cJSON* error = cJSON_GetObjectItem(json, "error");
@@ -233,42 +650,14 @@ void SpotifyApiClient::handle_api_error(int status_code, const std::string& resp
     }
 }
 
-esp_err_t SpotifyApiClient::http_event_handler(esp_http_client_event_t* evt) {
-    switch (evt->event_id) {
-        case HTTP_EVENT_ERROR:
-            ESP_LOGD(TAG, "HTTP_EVENT_ERROR");
-            break;
-        case HTTP_EVENT_ON_CONNECTED:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_CONNECTED");
-            break;
-        case HTTP_EVENT_HEADER_SENT:
-            ESP_LOGD(TAG, "HTTP_EVENT_HEADER_SENT");
-            break;
-        case HTTP_EVENT_ON_HEADER:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
-            break;
-        case HTTP_EVENT_ON_DATA:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
-            break;
-        case HTTP_EVENT_ON_FINISH:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_FINISH");
-            break;
-        case HTTP_EVENT_DISCONNECTED:
-            ESP_LOGD(TAG, "HTTP_EVENT_DISCONNECTED");
-            break;
-        default:
-            break;
-    }
-    return ESP_OK;
-}
-
 // Player API methods
 bool SpotifyApiClient::get_playback_state() {
     SpotifyApiRequest request = {
         .method = "GET",
         .endpoint = "/me/player",
         .body = "",
-        .requires_auth = true
+        .requires_auth = true,
+        .conditional = true
     };
 
     SpotifyApiResponse response = make_request(request);
@@ -276,21 +665,32 @@ bool SpotifyApiClient::get_playback_state() {
         return false;
     }
 
+    // Nothing changed since the last state we reported
+    if (response.not_modified) {
+        ESP_LOGD(TAG, "Playback state not modified");
+        return true;
+    }
+
     // Handle empty response (no active device)
     if (response.body.empty() || response.status_code == 204) {
         ESP_LOGI(TAG, "No active playback device");
+        response_cache.invalidate(request.endpoint);
         return true;
     }
 
-    // Parse playback state
-    cJSON* json = cJSON_Parse(response.body.c_str());
-    if (!json) {
-        ESP_LOGE(TAG, "Failed to parse playback state JSON");
-        return false;
+    // Parse playback state; the tree is scratch, gone before the callback runs
+    SpotifyPlaybackState state;
+    {
+        mem_tag::MessageScope scope(MEM_TAG_SPOTIFY);
+        cJSON* json = cJSON_Parse(response.body.c_str());
+        if (!json) {
+            ESP_LOGE(TAG, "Failed to parse playback state JSON");
+            return false;
+        }
+        state = SpotifyResponseParser::playback_state(json, image_target);
+        cJSON_Delete(json);
     }
-
-    SpotifyPlaybackState state = parse_playback_state(json);
-    cJSON_Delete(json);
+    response_cache.store(request.endpoint, response.etag);
 
     if (playback_callback) {
         playback_callback(state, callback_user_data);
@@ -299,35 +699,39 @@ bool SpotifyApiClient::get_playback_state() {
     return true;
 }
 
-bool SpotifyApiClient::start_resume_playback(const std::string& device_id, const std::string& context_uri) {
-    std::string endpoint = "/me/player/play";
-    if (!device_id.empty()) {
-        endpoint += "?device_id=" + device_id;
-    }
-
-    std::string body = "{}";
-    if (!context_uri.empty()) {
-        cJSON* json = cJSON_CreateObject();
-        if (context_uri.find("spotify:track:") == 0) {
-            // Single track
-            cJSON* uris = cJSON_CreateArray();
-            cJSON_AddItemToArray(uris, cJSON_CreateString(context_uri.c_str()));
-            cJSON_AddItemToObject(json, "uris", uris);
-        } else {
-            // Context (playlist, album, etc.)
-            cJSON_AddStringToObject(json, "context_uri", context_uri.c_str());
+bool SpotifyApiClient::apply_pushed_playback_state(const std::string& state_json) {
+    SpotifyPlaybackState state;
+    {
+        mem_tag::MessageScope scope(MEM_TAG_SPOTIFY);
+        cJSON* json = cJSON_Parse(state_json.c_str());
+        if (!json) {
+            ESP_LOGE(TAG, "Failed to parse pushed playback state JSON");
+            return false;
         }
-
-        char* json_string = cJSON_Print(json);
-        body = json_string;
-        free(json_string);
+        state = SpotifyResponseParser::playback_state(json, image_target);
         cJSON_Delete(json);
     }
 
+    // The cached ETag describes an older state; the next poll must not 304
+    response_cache.invalidate("/me/player");
+
+    if (playback_callback) {
+        playback_callback(state, callback_user_data);
+    }
+    return true;
+}
+
+bool SpotifyApiClient::subscribe_player_notifications(const std::string& connection_id) {
+    UrlBuffer<ENDPOINT_SIZE> endpoint;
+    endpoint.append("/me/notifications/player").param("connection_id", connection_id.c_str());
+    if (!endpoint_ok(endpoint)) {
+        return false;
+    }
+
     SpotifyApiRequest request = {
         .method = "PUT",
-        .endpoint = endpoint,
-        .body = body,
+        .endpoint = endpoint.c_str(),
+        .body = "",
         .requires_auth = true
     };
 
@@ -335,15 +739,41 @@ bool SpotifyApiClient::start_resume_playback(const std::string& device_id, const
     return response.success;
 }
 
-bool SpotifyApiClient::pause_playback(const std::string& device_id) {
-    std::string endpoint = "/me/player/pause";
-    if (!device_id.empty()) {
-        endpoint += "?device_id=" + device_id;
+bool SpotifyApiClient::start_resume_playback(const std::string& device_id, const std::string& context_uri) {
+    UrlBuffer<ENDPOINT_SIZE> endpoint;
+    player_endpoint(endpoint, "/me/player/play", device_id);
+
+    JsonBuffer<PLAYER_BODY_SIZE> body;
+    if (context_uri.find("spotify:track:") == 0) {
+        // Single track
+        body.begin_array("uris").item(context_uri.c_str());
+    } else if (!context_uri.empty()) {
+        // Context (playlist, album, etc.)
+        body.field("context_uri", context_uri.c_str());
+    }
+    body.end();
+    if (!endpoint_ok(endpoint) || !body.ok()) {
+        return false;
     }
 
     SpotifyApiRequest request = {
         .method = "PUT",
-        .endpoint = endpoint,
+        .endpoint = endpoint.c_str(),
+        .body = body.c_str(),
+        .requires_auth = true
+    };
+
+    SpotifyApiResponse response = make_request(request);
+    return response.success;
+}
+
+bool SpotifyApiClient::pause_playback(const std::string& device_id) {
+    UrlBuffer<ENDPOINT_SIZE> endpoint;
+    player_endpoint(endpoint, "/me/player/pause", device_id);
+
+    SpotifyApiRequest request = {
+        .method = "PUT",
+        .endpoint = endpoint.c_str(),
         .body = "",
         .requires_auth = true
     };
@@ -353,14 +783,12 @@ bool SpotifyApiClient::pause_playback(const std::string& device_id) {
 }
 
 bool SpotifyApiClient::skip_to_next(const std::string& device_id) {
-    std::string endpoint = "/me/player/next";
-    if (!device_id.empty()) {
-        endpoint += "?device_id=" + device_id;
-    }
+    UrlBuffer<ENDPOINT_SIZE> endpoint;
+    player_endpoint(endpoint, "/me/player/next", device_id);
 
     SpotifyApiRequest request = {
         .method = "POST",
-        .endpoint = endpoint,
+        .endpoint = endpoint.c_str(),
         .body = "",
         .requires_auth = true
     };
@@ -370,14 +798,12 @@ bool SpotifyApiClient::skip_to_next(const std::string& device_id) {
 }
 
 bool SpotifyApiClient::skip_to_previous(const std::string& device_id) {
-    std::string endpoint = "/me/player/previous";
-    if (!device_id.empty()) {
-        endpoint += "?device_id=" + device_id;
-    }
+    UrlBuffer<ENDPOINT_SIZE> endpoint;
+    player_endpoint(endpoint, "/me/player/previous", device_id);
 
     SpotifyApiRequest request = {
         .method = "POST",
-        .endpoint = endpoint,
+        .endpoint = endpoint.c_str(),
         .body = "",
         .requires_auth = true
     };
@@ -387,14 +813,13 @@ bool SpotifyApiClient::skip_to_previous(const std::string& device_id) {
 }
 
 bool SpotifyApiClient::seek_to_position(int position_ms, const std::string& device_id) {
-    std::string endpoint = "/me/player/seek?position_ms=" + std::to_string(position_ms);
-    if (!device_id.empty()) {
-        endpoint += "&device_id=" + device_id;
-    }
+    UrlBuffer<ENDPOINT_SIZE> endpoint;
+    endpoint.append("/me/player/seek").param_int("position_ms", position_ms);
+    endpoint.param_if_set("device_id", device_id.c_str());
 
     SpotifyApiRequest request = {
         .method = "PUT",
-        .endpoint = endpoint,
+        .endpoint = endpoint.c_str(),
         .body = "",
         .requires_auth = true
     };
@@ -404,14 +829,13 @@ bool SpotifyApiClient::seek_to_position(int position_ms, const std::string& devi
 }
 
 bool SpotifyApiClient::set_repeat_mode(const std::string& state, const std::string& device_id) {
-    std::string endpoint = "/me/player/repeat?state=" + state;
-    if (!device_id.empty()) {
-        endpoint += "&device_id=" + device_id;
-    }
+    UrlBuffer<ENDPOINT_SIZE> endpoint;
+    endpoint.append("/me/player/repeat").param("state", state.c_str());
+    endpoint.param_if_set("device_id", device_id.c_str());
 
     SpotifyApiRequest request = {
         .method = "PUT",
-        .endpoint = endpoint,
+        .endpoint = endpoint.c_str(),
         .body = "",
         .requires_auth = true
     };
@@ -421,14 +845,13 @@ bool SpotifyApiClient::set_repeat_mode(const std::string& state, const std::stri
 }
 
 bool SpotifyApiClient::set_playback_volume(int volume_percent, const std::string& device_id) {
-    std::string endpoint = "/me/player/volume?volume_percent=" + std::to_string(volume_percent);
-    if (!device_id.empty()) {
-        endpoint += "&device_id=" + device_id;
-    }
+    UrlBuffer<ENDPOINT_SIZE> endpoint;
+    endpoint.append("/me/player/volume").param_int("volume_percent", volume_percent);
+    endpoint.param_if_set("device_id", device_id.c_str());
 
     SpotifyApiRequest request = {
         .method = "PUT",
-        .endpoint = endpoint,
+        .endpoint = endpoint.c_str(),
         .body = "",
         .requires_auth = true
     };
@@ -438,14 +861,13 @@ bool SpotifyApiClient::set_playback_volume(int volume_percent, const std::string
 }
 
 bool SpotifyApiClient::toggle_playback_shuffle(bool state, const std::string& device_id) {
-    std::string endpoint = "/me/player/shuffle?state=" + std::string(state ? "true" : "false");
-    if (!device_id.empty()) {
-        endpoint += "&device_id=" + device_id;
-    }
+    UrlBuffer<ENDPOINT_SIZE> endpoint;
+    endpoint.append("/me/player/shuffle").param_bool("state", state);
+    endpoint.param_if_set("device_id", device_id.c_str());
 
     SpotifyApiRequest request = {
         .method = "PUT",
-        .endpoint = endpoint,
+        .endpoint = endpoint.c_str(),
         .body = "",
         .requires_auth = true
     };
@@ -455,21 +877,17 @@ bool SpotifyApiClient::toggle_playback_shuffle(bool state, const std::string& de
 }
 
 bool SpotifyApiClient::transfer_playback(const std::string& device_id, bool play) {
-    cJSON* json = cJSON_CreateObject();
-    cJSON* device_ids = cJSON_CreateArray();
-    cJSON_AddItemToArray(device_ids, cJSON_CreateString(device_id.c_str()));
-    cJSON_AddItemToObject(json, "device_ids", device_ids);
-    cJSON_AddBoolToObject(json, "play", play);
-
-    char* json_string = cJSON_Print(json);
-    std::string body = json_string;
-    free(json_string);
-    cJSON_Delete(json);
+    JsonBuffer<PLAYER_BODY_SIZE> body;
+    body.begin_array("device_ids").item(device_id.c_str()).end_array();
+    body.field_bool("play", play).end();
+    if (!body.ok()) {
+        return false;
+    }
 
     SpotifyApiRequest request = {
         .method = "PUT",
         .endpoint = "/me/player",
-        .body = body,
+        .body = body.c_str(),
         .requires_auth = true
     };
 
@@ -478,14 +896,13 @@ bool SpotifyApiClient::transfer_playback(const std::string& device_id, bool play
 }
 
 bool SpotifyApiClient::add_to_queue(const std::string& uri, const std::string& device_id) {
-    std::string endpoint = "/me/player/queue?uri=" + uri;
-    if (!device_id.empty()) {
-        endpoint += "&device_id=" + device_id;
-    }
+    UrlBuffer<ENDPOINT_SIZE> endpoint;
+    endpoint.append("/me/player/queue").param("uri", uri.c_str());
+    endpoint.param_if_set("device_id", device_id.c_str());
 
     SpotifyApiRequest request = {
         .method = "POST",
-        .endpoint = endpoint,
+        .endpoint = endpoint.c_str(),
         .body = "",
         .requires_auth = true
     };
@@ -500,7 +917,8 @@ bool SpotifyApiClient::get_available_devices() {
         .method = "GET",
         .endpoint = "/me/player/devices",
         .body = "",
-        .requires_auth = true
+        .requires_auth = true,
+        .conditional = true
     };
 
     SpotifyApiResponse response = make_request(request);
@@ -508,14 +926,23 @@ bool SpotifyApiClient::get_available_devices() {
         return false;
     }
 
-    cJSON* json = cJSON_Parse(response.body.c_str());
-    if (!json) {
-        ESP_LOGE(TAG, "Failed to parse devices JSON");
-        return false;
+    if (response.not_modified) {
+        ESP_LOGD(TAG, "Device list not modified");
+        return true;
     }
 
-    std::vector<SpotifyDevice> devices = parse_devices(json);
-    cJSON_Delete(json);
+    std::vector<SpotifyDevice> devices;
+    {
+        mem_tag::MessageScope scope(MEM_TAG_SPOTIFY);
+        cJSON* json = cJSON_Parse(response.body.c_str());
+        if (!json) {
+            ESP_LOGE(TAG, "Failed to parse devices JSON");
+            return false;
+        }
+        devices = SpotifyResponseParser::devices(json);
+        cJSON_Delete(json);
+    }
+    response_cache.store(request.endpoint, response.etag);
 
     if (devices_callback) {
         devices_callback(devices, callback_user_data);
@@ -525,360 +952,277 @@ bool SpotifyApiClient::get_available_devices() {
 }
 
 // Playlist API methods
-bool SpotifyApiClient::get_user_playlists(const std::string& user_id, int limit, int offset) {
-    std::string endpoint = "/" + user_id + "/playlists?limit=" + std::to_string(limit) + "&offset=" + std::to_string(offset);
-
+bool SpotifyApiClient::make_streaming_request(const std::string& endpoint, SpotifyStreamParser& parser,
+                                              SpotifyApiResponse* conditional, const AbortCallback* should_abort) {
     SpotifyApiRequest request = {
         .method = "GET",
         .endpoint = endpoint,
         .body = "",
-        .requires_auth = true
+        .requires_auth = true,
+        .conditional = conditional != nullptr
     };
 
-    SpotifyApiResponse response = make_request(request);
+    parser.set_image_target(image_target);
+    
+    bool parse_ok = true;
+    SpotifyHttpPool::DataCallback feed = [&](const char* data, size_t length) {
+        if (parse_ok) {
+            parse_ok = parser.feed(data, length);
+        }
+    };
+
+    SpotifyApiResponse response = make_request(request, &feed, should_abort);
     if (!response.success) {
         return false;
     }
 
-    cJSON* json = cJSON_Parse(response.body.c_str());
-    if (!json) {
-        ESP_LOGE(TAG, "Failed to parse playlists JSON");
-        return false;
+    if (conditional) {
+        conditional->status_code = response.status_code;
+        conditional->not_modified = response.not_modified;
+        conditional->etag = response.etag;
+        if (response.not_modified) {
+            return true;
+        }
     }
 
-    std::vector<SpotifyPlaylist> playlists = parse_playlists(json);
-    cJSON_Delete(json);
-
-    if (playlists_callback) {
-        playlists_callback(playlists, callback_user_data);
+    if (!parse_ok || !parser.finish()) {
+        ESP_LOGE(TAG, "Malformed JSON from %s (%d records parsed)", endpoint.c_str(), (int)parser.emitted());
+        return false;
     }
 
     return true;
 }
 
-bool SpotifyApiClient::get_playlist_tracks(const std::string& playlist_id, int limit, int offset) {
-    std::string endpoint = "/playlists/" + playlist_id + "/tracks?limit=" + std::to_string(limit) + "&offset=" + std::to_string(offset);
+std::string SpotifyApiClient::playlists_endpoint(const std::string& user_id, int limit, int offset) {
+    UrlBuffer<ENDPOINT_SIZE> endpoint;
+    endpoint.append("/").append(user_id.c_str()).append("/playlists");
+    endpoint.param_int("limit", limit).param_int("offset", offset);
+    return endpoint.c_str();
+}
 
-    SpotifyApiRequest request = {
-        .method = "GET",
-        .endpoint = endpoint,
-        .body = "",
-        .requires_auth = true
-    };
+bool SpotifyApiClient::stream_user_playlists(const PlaylistSink& sink, const std::string& user_id, int limit, int offset,
+                                             bool* not_modified) {
+    std::string endpoint = playlists_endpoint(user_id, limit, offset);
 
-    SpotifyApiResponse response = make_request(request);
-    if (!response.success) {
-        return false;
-    }
+    // The page is re-encoded compactly as it streams, so a later 304 (even
+    // after a reboot) can be answered from the cache without any JSON
+    std::string payload;
+    SpotifyStreamParser parser([&](const SpotifyPlaylist& playlist) {
+        encode_playlist(payload, playlist);
+        sink(playlist);
+    });
 
-    cJSON* json = cJSON_Parse(response.body.c_str());
-    if (!json) {
-        ESP_LOGE(TAG, "Failed to parse playlist tracks JSON");
+    SpotifyApiResponse result = {};
+    if (!make_streaming_request(endpoint, parser, &result)) {
         return false;
     }
 
-    std::vector<SpotifyTrack> tracks = parse_tracks(json);
-    cJSON_Delete(json);
-
-    if (tracks_callback) {
-        tracks_callback(tracks, callback_user_data);
+    if (not_modified) {
+        *not_modified = result.not_modified;
     }
 
-    return true;
-}
-
-bool SpotifyApiClient::search(const std::string& query, const std::string& type, int limit, int offset) {
-    std::string endpoint = "/search?q=" + query + "&type=" + type + "&limit=" + std::to_string(limit) + "&offset=" + std::to_string(offset);
-
-    SpotifyApiRequest request = {
-        .method = "GET",
-        .endpoint = endpoint,
-        .body = "",
-        .requires_auth = true
-    };
-
-    SpotifyApiResponse response = make_request(request);
-    if (!response.success) {
-        return false;
-    }
-
-    cJSON* json = cJSON_Parse(response.body.c_str());
-    if (!json) {
-        ESP_LOGE(TAG, "Failed to parse search results JSON");
-        return false;
+    if (!result.not_modified) {
+        response_cache.store(endpoint, result.etag, payload, true);
+        return true;
     }
 
-    // Parse tracks from search results
-    cJSON* tracks_obj = cJSON_GetObjectItem(json, "tracks");
-    if (tracks_obj) {
-        std::vector<SpotifyTrack> tracks = parse_tracks(tracks_obj);
-        if (tracks_callback) {
-            tracks_callback(tracks, callback_user_data);
+    ESP_LOGD(TAG, "Playlists not modified");
+    if (!not_modified) {
+        const std::string* cached = response_cache.payload(endpoint);
+        if (cached && !decode_playlists(*cached, sink)) {
+            ESP_LOGW(TAG, "Cached playlists unreadable, refetching");
+            response_cache.invalidate(endpoint);
+            return stream_user_playlists(sink, user_id, limit, offset);
         }
     }
-
-    cJSON_Delete(json);
     return true;
 }
 
-// JSON parsing helper functions
-SpotifyPlaybackState SpotifyApiClient::parse_playback_state(cJSON* json) {
-    SpotifyPlaybackState state = {};
-
-    if (!json) return state;
-
-    cJSON* is_playing = cJSON_GetObjectItem(json, "is_playing");
-    if (is_playing && cJSON_IsBool(is_playing)) {
-        state.is_playing = cJSON_IsTrue(is_playing);
+bool SpotifyApiClient::stream_playlist_tracks(const std::string& playlist_id, const TrackSink& sink, int limit, int offset,
+                                              size_t* page_items) {
+    UrlBuffer<ENDPOINT_SIZE> endpoint;
+    endpoint.append("/playlists").segment(playlist_id.c_str()).append("/tracks");
+    endpoint.param_int("limit", limit).param_int("offset", offset).param_raw("fields", PLAYLIST_TRACK_FIELDS);
+    if (!endpoint_ok(endpoint)) {
+        return false;
     }
 
-    cJSON* progress_ms = cJSON_GetObjectItem(json, "progress_ms");
-    if (progress_ms && cJSON_IsNumber(progress_ms)) {
-        state.progress_ms = cJSON_GetNumberValue(progress_ms);
+    SpotifyStreamParser parser(sink);
+    bool ok = make_streaming_request(endpoint.c_str(), parser);
+    if (page_items) {
+        *page_items = parser.items();
     }
+    return ok;
+}
 
-    cJSON* shuffle_state = cJSON_GetObjectItem(json, "shuffle_state");
-    if (shuffle_state && cJSON_IsBool(shuffle_state)) {
-        state.shuffle_state = cJSON_IsTrue(shuffle_state);
+bool SpotifyApiClient::stream_search_tracks(const std::string& query, const TrackSink& sink, int limit, int offset,
+                                            size_t* page_items, const AbortCallback& should_abort) {
+    UrlBuffer<ENDPOINT_SIZE> endpoint;
+    endpoint.append("/search").param("q", query.c_str()).param_raw("type", "track");
+    endpoint.param_int("limit", limit).param_int("offset", offset);
+    if (!endpoint_ok(endpoint)) {
+        return false;
     }
 
-    cJSON* repeat_state = cJSON_GetObjectItem(json, "repeat_state");
-    if (repeat_state && cJSON_IsString(repeat_state)) {
-        state.repeat_state = cJSON_GetStringValue(repeat_state);
+    SpotifyStreamParser parser(sink);
+    bool ok = make_streaming_request(endpoint.c_str(), parser, nullptr, should_abort ? &should_abort : nullptr);
+    if (page_items) {
+        *page_items = parser.items();
     }
+    return ok;
+}
 
-    cJSON* device = cJSON_GetObjectItem(json, "device");
-    if (device) {
-        cJSON* device_id = cJSON_GetObjectItem(device, "id");
-        if (device_id && cJSON_IsString(device_id)) {
-            state.device_id = cJSON_GetStringValue(device_id);
-        }
-
-        cJSON* device_name = cJSON_GetObjectItem(device, "name");
-        if (device_name && cJSON_IsString(device_name)) {
-            state.device_name = cJSON_GetStringValue(device_name);
-        }
+bool SpotifyApiClient::stream_queue(const TrackSink& sink) {
+    SpotifyStreamParser parser(sink);
+    return make_streaming_request("/me/player/queue", parser);
+}
 
-        cJSON* volume_percent = cJSON_GetObjectItem(device, "volume_percent");
-        if (volume_percent && cJSON_IsNumber(volume_percent)) {
-            state.volume_percent = cJSON_GetNumberValue(volume_percent);
+static std::string join_ids(const std::vector<std::string>& ids) {
+    std::string joined;
+    for (const std::string& id : ids) {
+        if (!joined.empty()) {
+            joined += ',';
         }
+        joined += id;
     }
+    return joined;
+}
 
-    cJSON* item = cJSON_GetObjectItem(json, "item");
-    if (item) {
-        state.current_track = parse_track(item);
+bool SpotifyApiClient::stream_several_tracks(const std::vector<std::string>& track_ids, const TrackSink& sink) {
+    if (track_ids.empty() || track_ids.size() > MAX_SEVERAL_TRACKS) {
+        ESP_LOGE(TAG, "Several tracks: %d ids, expected 1-%d", (int)track_ids.size(), (int)MAX_SEVERAL_TRACKS);
+        return false;
     }
 
-    return state;
+    SpotifyStreamParser parser(sink);
+    return make_streaming_request("/tracks?ids=" + join_ids(track_ids), parser);
 }
 
-std::vector<SpotifyPlaylist> SpotifyApiClient::parse_playlists(cJSON* json) {
-    std::vector<SpotifyPlaylist> playlists;
-
-    if (!json) return playlists;
-
-    cJSON* items = cJSON_GetObjectItem(json, "items");
-    if (!items || !cJSON_IsArray(items)) return playlists;
-
-    cJSON* item;
-    cJSON_ArrayForEach(item, items) {
-        SpotifyPlaylist playlist = {};
-
-        cJSON* id = cJSON_GetObjectItem(item, "id");
-        if (id && cJSON_IsString(id)) {
-            playlist.id = cJSON_GetStringValue(id);
-        }
-
-        cJSON* name = cJSON_GetObjectItem(item, "name");
-        if (name && cJSON_IsString(name)) {
-            playlist.name = cJSON_GetStringValue(name);
-        }
-
-        cJSON* description = cJSON_GetObjectItem(item, "description");
-        if (description && cJSON_IsString(description)) {
-            playlist.description = cJSON_GetStringValue(description);
-        }
-
-        cJSON* uri = cJSON_GetObjectItem(item, "uri");
-        if (uri && cJSON_IsString(uri)) {
-            playlist.uri = cJSON_GetStringValue(uri);
-        }
-
-        cJSON* tracks = cJSON_GetObjectItem(item, "tracks");
-        if (tracks) {
-            cJSON* total = cJSON_GetObjectItem(tracks, "total");
-            if (total && cJSON_IsNumber(total)) {
-                playlist.track_count = cJSON_GetNumberValue(total);
-            }
-        }
-
-        cJSON* images = cJSON_GetObjectItem(item, "images");
-        if (images && cJSON_IsArray(images)) {
-            cJSON* first_image = cJSON_GetArrayItem(images, 0);
-            if (first_image) {
-                cJSON* url = cJSON_GetObjectItem(first_image, "url");
-                if (url && cJSON_IsString(url)) {
-                    playlist.image_url = cJSON_GetStringValue(url);
-                }
-            }
-        }
-
-        cJSON* owner = cJSON_GetObjectItem(item, "owner");
-        if (owner) {
-            cJSON* display_name = cJSON_GetObjectItem(owner, "display_name");
-            if (display_name && cJSON_IsString(display_name)) {
-                playlist.owner = cJSON_GetStringValue(display_name);
-            }
-        }
-
-        playlists.push_back(playlist);
+bool SpotifyApiClient::stream_several_albums(const std::vector<std::string>& album_ids, const AlbumSink& sink) {
+    if (album_ids.empty() || album_ids.size() > MAX_SEVERAL_ALBUMS) {
+        ESP_LOGE(TAG, "Several albums: %d ids, expected 1-%d", (int)album_ids.size(), (int)MAX_SEVERAL_ALBUMS);
+        return false;
     }
 
-    return playlists;
+    SpotifyStreamParser parser(sink);
+    return make_streaming_request("/albums?ids=" + join_ids(album_ids), parser);
 }
 
-std::vector<SpotifyTrack> SpotifyApiClient::parse_tracks(cJSON* json) {
-    std::vector<SpotifyTrack> tracks;
-
-    if (!json) return tracks;
-
-    cJSON* items = cJSON_GetObjectItem(json, "items");
-    if (!items || !cJSON_IsArray(items)) return tracks;
-
-    cJSON* item;
-    cJSON_ArrayForEach(item, items) {
-        // Handle both direct track objects and playlist track objects
-        cJSON* track_obj = cJSON_GetObjectItem(item, "track");
-        if (!track_obj) {
-            track_obj = item; // Direct track object
-        }
-
-        if (track_obj) {
-            SpotifyTrack track = parse_track(track_obj);
-            tracks.push_back(track);
-        }
+bool SpotifyApiClient::stream_several_artists(const std::vector<std::string>& artist_ids, const ArtistSink& sink) {
+    if (artist_ids.empty() || artist_ids.size() > MAX_SEVERAL_ARTISTS) {
+        ESP_LOGE(TAG, "Several artists: %d ids, expected 1-%d", (int)artist_ids.size(), (int)MAX_SEVERAL_ARTISTS);
+        return false;
     }
 
-    return tracks;
+    SpotifyStreamParser parser(sink);
+    return make_streaming_request("/artists?ids=" + join_ids(artist_ids), parser);
 }
 
-std::vector<SpotifyDevice> SpotifyApiClient::parse_devices(cJSON* json) {
-    std::vector<SpotifyDevice> devices;
-
-    if (!json) return devices;
-
-    cJSON* devices_array = cJSON_GetObjectItem(json, "devices");
-    if (!devices_array || !cJSON_IsArray(devices_array)) return devices;
-
-    cJSON* device;
-    cJSON_ArrayForEach(device, devices_array) {
-        SpotifyDevice dev = {};
-
-        cJSON* id = cJSON_GetObjectItem(device, "id");
-        if (id && cJSON_IsString(id)) {
-            dev.id = cJSON_GetStringValue(id);
-        }
+bool SpotifyApiClient::get_user_playlists(const std::string& user_id, int limit, int offset) {
+    std::vector<SpotifyPlaylist> playlists;
+    bool not_modified = false;
+    bool ok = stream_user_playlists([&playlists](const SpotifyPlaylist& playlist) {
+        playlists.push_back(playlist);
+    }, user_id, limit, offset, &not_modified);
 
-        cJSON* name = cJSON_GetObjectItem(device, "name");
-        if (name && cJSON_IsString(name)) {
-            dev.name = cJSON_GetStringValue(name);
-        }
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to fetch playlists");
+        return false;
+    }
 
-        cJSON* type = cJSON_GetObjectItem(device, "type");
-        if (type && cJSON_IsString(type)) {
-            dev.type = cJSON_GetStringValue(type);
-        }
+    // Listeners already have this page
+    if (not_modified) {
+        return true;
+    }
 
-        cJSON* is_active = cJSON_GetObjectItem(device, "is_active");
-        if (is_active && cJSON_IsBool(is_active)) {
-            dev.is_active = cJSON_IsTrue(is_active);
-        }
+    if (playlists_callback) {
+        playlists_callback(playlists, callback_user_data);
+    }
 
-        cJSON* is_private_session = cJSON_GetObjectItem(device, "is_private_session");
-        if (is_private_session && cJSON_IsBool(is_private_session)) {
-            dev.is_private_session = cJSON_IsTrue(is_private_session);
-        }
+    return true;
+}
 
-        cJSON* is_restricted = cJSON_GetObjectItem(device, "is_restricted");
-        if (is_restricted && cJSON_IsBool(is_restricted)) {
-            dev.is_restricted = cJSON_IsTrue(is_restricted);
-        }
+bool SpotifyApiClient::get_playlist_tracks(const std::string& playlist_id, int limit, int offset) {
+    std::vector<SpotifyTrack> tracks;
+    bool ok = stream_playlist_tracks(playlist_id, [&tracks](const SpotifyTrack& track) {
+        tracks.push_back(track);
+    }, limit, offset);
 
-        cJSON* volume_percent = cJSON_GetObjectItem(device, "volume_percent");
-        if (volume_percent && cJSON_IsNumber(volume_percent)) {
-            dev.volume_percent = cJSON_GetNumberValue(volume_percent);
-        }
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to fetch playlist tracks");
+        return false;
+    }
 
-        devices.push_back(dev);
+    if (tracks_callback) {
+        tracks_callback(tracks, callback_user_data);
     }
 
-    return devices;
+    return true;
 }
 
-SpotifyTrack SpotifyApiClient::parse_track(cJSON* track_json) {
-    SpotifyTrack track = {};
+bool SpotifyApiClient::search(const std::string& query, const std::string& type, int limit, int offset) {
+    UrlBuffer<ENDPOINT_SIZE> endpoint;
+    endpoint.append("/search").param("q", query.c_str()).param("type", type.c_str());
+    endpoint.param_int("limit", limit).param_int("offset", offset);
+    if (!endpoint_ok(endpoint)) {
+        return false;
+    }
 
-    if (!track_json) return track;
+    // Only the tracks section of the results is parsed
+    std::vector<SpotifyTrack> tracks;
+    SpotifyStreamParser parser([&tracks](const SpotifyTrack& track) {
+        tracks.push_back(track);
+    });
 
-    cJSON* id = cJSON_GetObjectItem(track_json, "id");
-    if (id && cJSON_IsString(id)) {
-        track.id = cJSON_GetStringValue(id);
+    if (!make_streaming_request(endpoint.c_str(), parser)) {
+        ESP_LOGE(TAG, "Failed to fetch search results");
+        return false;
     }
 
-    cJSON* name = cJSON_GetObjectItem(track_json, "name");
-    if (name && cJSON_IsString(name)) {
-        track.name = cJSON_GetStringValue(name);
+    if (tracks_callback && !tracks.empty()) {
+        tracks_callback(tracks, callback_user_data);
     }
 
-    cJSON* uri = cJSON_GetObjectItem(track_json, "uri");
-    if (uri && cJSON_IsString(uri)) {
-        track.uri = cJSON_GetStringValue(uri);
-    }
+    return true;
+}
 
-    cJSON* duration_ms = cJSON_GetObjectItem(track_json, "duration_ms");
-    if (duration_ms && cJSON_IsNumber(duration_ms)) {
-        track.duration_ms = cJSON_GetNumberValue(duration_ms);
+bool SpotifyApiClient::fetch_image(const std::string& url, const SpotifyHttpPool::DataCallback& on_data,
+                                   const AbortCallback& should_abort) {
+    if (!http_ready || url.empty()) {
+        return false;
     }
-
-    cJSON* preview_url = cJSON_GetObjectItem(track_json, "preview_url");
-    if (preview_url && cJSON_IsString(preview_url)) {
-        track.preview_url = cJSON_GetStringValue(preview_url);
+    
+    // i.scdn.co has its own pooled connection, so art never waits on API calls
+    esp_http_client_handle_t client = http_pool->acquire(url.c_str());
+    if (!client) {
+        ESP_LOGE(TAG, "No HTTP connection available for image");
+        return false;
     }
-
-    // Parse artists
-    cJSON* artists = cJSON_GetObjectItem(track_json, "artists");
-    if (artists && cJSON_IsArray(artists)) {
-        cJSON* first_artist = cJSON_GetArrayItem(artists, 0);
-        if (first_artist) {
-            cJSON* artist_name = cJSON_GetObjectItem(first_artist, "name");
-            if (artist_name && cJSON_IsString(artist_name)) {
-                track.artist = cJSON_GetStringValue(artist_name);
-            }
+    esp_http_client_set_method(client, HTTP_METHOD_GET);
+    
+    esp_err_t err = http_pool->perform(client, [&](const char* data, size_t length) {
+        if (esp_http_client_get_status_code(client) == 200) {
+            on_data(data, length);
         }
+    }, nullptr, should_abort ? &should_abort : nullptr);
+    if (err == ESP_ERR_NOT_FINISHED) {
+        http_pool->release(client, false);
+        ESP_LOGD(TAG, "Image request cancelled");
+        return false;
     }
-
-    // Parse album
-    cJSON* album = cJSON_GetObjectItem(track_json, "album");
-    if (album) {
-        cJSON* album_name = cJSON_GetObjectItem(album, "name");
-        if (album_name && cJSON_IsString(album_name)) {
-            track.album = cJSON_GetStringValue(album_name);
-        }
-
-        cJSON* images = cJSON_GetObjectItem(album, "images");
-        if (images && cJSON_IsArray(images)) {
-            cJSON* first_image = cJSON_GetArrayItem(images, 0);
-            if (first_image) {
-                cJSON* url = cJSON_GetObjectItem(first_image, "url");
-                if (url && cJSON_IsString(url)) {
-                    track.image_url = cJSON_GetStringValue(url);
-                }
-            }
-        }
+    if (err != ESP_OK) {
+        http_pool->release(client, false);
+        ESP_LOGE(TAG, "Image request failed: %s", esp_err_to_name(err));
+        return false;
     }
-
-    return track;
+    
+    int status_code = esp_http_client_get_status_code(client);
+    http_pool->release(client);
+    if (status_code != 200) {
+        ESP_LOGW(TAG, "Image request returned %d", status_code);
+        return false;
+    }
+    return true;
 }
 
 std::string SpotifyApiClient::get_last_error() const {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <ctime>
 #include <string>
 #include <vector>
 #include <functional>
@@ -8,12 +9,22 @@
 #include "esp_http_client.h"
 #include "cJSON.h"
 #include "spotify_controller.h"
+#include "spotify_http_pool.h"
+#include "spotify_stream_parser.h"
+#include "spotify_response_cache.h"
+#include "spotify_rate_limiter.h"
+#include "spotify_h2_client.h"
 
 /**
  * SpotifyApiClient - HTTP client for Spotify Web API
  * 
  * Provides methods to interact with Spotify Web API endpoints including
  * playback control, playlist management, search, and user data.
+ *
+ * With SPOTIFY_HTTP2 the API host is reached over one multiplexed HTTP/2
+ * connection (SpotifyH2Client) instead of the HTTP/1.1 pool, which is
+ * still used for images, for the accounts host and whenever the API host
+ * does not negotiate h2.
  */
 
 /**
@@ -23,6 +34,10 @@ struct SpotifyApiResponse {
     int status_code;
     std::string body;
     bool success;
+    bool rate_limited;      // Not sent (bucket empty) or answered with 429
+    bool not_modified;      // 304 to a conditional GET; body is empty
+    bool cancelled;         // Abandoned by the caller's abort check
+    std::string etag;       // ETag response header, if any
     std::string error_message;
 };
 
@@ -34,6 +49,7 @@ struct SpotifyApiRequest {
     std::string endpoint;   // API endpoint path
     std::string body;       // Request body (for POST/PUT)
     bool requires_auth;     // Whether request needs authorization header
+    bool conditional;       // GET: send If-None-Match with the cached ETag
 };
 
 class SpotifyApiClient {
@@ -45,12 +61,27 @@ public:
     using TracksCallback = std::function<void(const std::vector<SpotifyTrack>&, void*)>;
     using DevicesCallback = std::function<void(const std::vector<SpotifyDevice>&, void*)>;
     using ErrorCallback = std::function<void(const std::string&, void*)>;
+    using TokenRefreshCallback = std::function<bool(void*)>;
+    using TrackSink = SpotifyStreamParser::TrackSink;
+    using PlaylistSink = SpotifyStreamParser::PlaylistSink;
+    using AlbumSink = SpotifyStreamParser::AlbumSink;
+    using ArtistSink = SpotifyStreamParser::ArtistSink;
+    using AbortCallback = SpotifyHttpPool::AbortCallback;
+    // Answers a request from recorded traffic instead of the network: fills
+    // in status_code and body; false if the recording has nothing for it
+    using ReplaySource = std::function<bool(const SpotifyApiRequest&, SpotifyApiResponse&)>;
 
 private:
-    // HTTP client configuration
-    esp_http_client_handle_t http_client;
+    // HTTP client configuration (pooled keep-alive connection to the API host)
+    std::shared_ptr<SpotifyHttpPool> http_pool;
+    bool http_ready;
     std::string access_token;
+    time_t access_token_expires_at;     // 0: unknown, never refreshed up front
+    
+    // ETags (and compact results) of GETs that can be revalidated
+    SpotifyResponseCache response_cache;
     std::string base_url;
+    int image_target;   // Preferred album art width in pixels
     
     // Callback storage
     ResponseCallback response_callback;
@@ -59,31 +90,58 @@ private:
     TracksCallback tracks_callback;
     DevicesCallback devices_callback;
     ErrorCallback error_callback;
+    TokenRefreshCallback token_refresh_callback;
     void* callback_user_data;
+    ReplaySource replay_source;
+    
+    // Rate limiting (token bucket per endpoint class, 429 Retry-After)
+    SpotifyRateLimiter rate_limiter;
+    
+#ifdef CONFIG_SPOTIFY_HTTP2
+    // Multiplexed connection to the API host, and GETs it answered ahead of
+    // their make_request() call (see prefetch_user_data())
+    struct Prefetched {
+        std::string endpoint;
+        SpotifyApiResponse response;
+        TickType_t fetched_at;
+    };
+    std::unique_ptr<SpotifyH2Client> h2_client;
+    std::vector<Prefetched> prefetched;
     
-    // Rate limiting
-    time_t last_request_time;
-    int requests_per_second_limit;
+    bool perform_h2(const SpotifyApiRequest* const* requests, SpotifyApiResponse* responses, size_t count,
+                    const SpotifyHttpPool::DataCallback* stream, const AbortCallback* should_abort);
+    bool take_prefetched(const SpotifyApiRequest& request, const SpotifyHttpPool::DataCallback* stream,
+                         SpotifyApiResponse& response);
+#endif
     
     // Internal methods
-    SpotifyApiResponse make_request(const SpotifyApiRequest& request);
+    // Checks every request goes through before it is sent, whatever the
+    // transport; false with response filled in if it must not be sent
+    bool begin_request(const SpotifyApiRequest& request, SpotifyApiResponse& response,
+                       const AbortCallback* should_abort);
+    void finish_response(SpotifyApiResponse& response, bool revalidated, int retry_after_s);
+    // Replays or records the exchange around perform_request() (traffic_capture)
+    SpotifyApiResponse make_request(const SpotifyApiRequest& request,
+                                    const SpotifyHttpPool::DataCallback* stream = nullptr,
+                                    const AbortCallback* should_abort = nullptr);
+    SpotifyApiResponse perform_request(const SpotifyApiRequest& request,
+                                       const SpotifyHttpPool::DataCallback* stream,
+                                       const AbortCallback* should_abort);
+    SpotifyApiResponse replay_request(const SpotifyApiRequest& request,
+                                      const SpotifyHttpPool::DataCallback* stream);
+    // With conditional set, the GET is revalidated against the cached ETag and
+    // the response status/ETag is returned there (not_modified: parser unfed)
+    bool make_streaming_request(const std::string& endpoint, SpotifyStreamParser& parser,
+                                SpotifyApiResponse* conditional = nullptr,
+                                const AbortCallback* should_abort = nullptr);
     bool setup_http_client();
     void cleanup_http_client();
     std::string build_url(const std::string& endpoint);
-    bool add_auth_header();
-    bool check_rate_limit();
+    bool add_auth_header(esp_http_client_handle_t client);
+    static std::string playlists_endpoint(const std::string& user_id, int limit, int offset);
+    void ensure_fresh_token();
     void handle_api_error(int status_code, const std::string& response_body);
     
-    // JSON parsing helpers
-    SpotifyPlaybackState parse_playback_state(cJSON* json);
-    std::vector<SpotifyPlaylist> parse_playlists(cJSON* json);
-    std::vector<SpotifyTrack> parse_tracks(cJSON* json);
-    std::vector<SpotifyDevice> parse_devices(cJSON* json);
-    SpotifyTrack parse_track(cJSON* track_json);
-    
-    // HTTP client event handler
-    static esp_err_t http_event_handler(esp_http_client_event_t* evt);
-    
 public:
     SpotifyApiClient();
     ~SpotifyApiClient();
@@ -91,7 +149,14 @@ public:
     // Initialization
     bool initialize(const std::string& access_token);
     void deinitialize();
-    void set_access_token(const std::string& token);
+    void set_access_token(const std::string& token, time_t expires_at = 0);
+    void set_http_pool(std::shared_ptr<SpotifyHttpPool> pool) { http_pool = pool; }
+    // Refresh a token that is about to expire now rather than in front of
+    // the next request; returns whether the API connection is already open
+    bool prewarm();
+    void clear_response_cache() { response_cache.clear(); }
+    // Image variant chosen when parsing: smallest at least this wide
+    void set_image_target(int pixels) { image_target = pixels; }
     
     // Player API methods
     bool get_playback_state();
@@ -106,14 +171,47 @@ public:
     bool transfer_playback(const std::string& device_id, bool play = false);
     bool add_to_queue(const std::string& uri, const std::string& device_id = "");
     
+    // Player events: register a dealer connection for PLAYER_STATE_CHANGED
+    // pushes, and report a pushed state like a fetched one
+    bool subscribe_player_notifications(const std::string& connection_id);
+    bool apply_pushed_playback_state(const std::string& state_json);
+    
     // Device API methods
     bool get_available_devices();
     
+    // Send the first playlists page, device list and playback state GETs
+    // at once over HTTP/2, so that get_user_playlists(),
+    // get_available_devices() and get_playback_state() right after are
+    // answered without a round trip each; the device list only if devices.
+    // false (and nothing fetched) without SPOTIFY_HTTP2 or an h2 connection.
+    bool prefetch_user_data(bool devices = true);
+    
     // Playlist API methods
     bool get_user_playlists(const std::string& user_id = "me", int limit = 20, int offset = 0);
     bool get_playlist_tracks(const std::string& playlist_id, int limit = 100, int offset = 0);
     bool get_featured_playlists(int limit = 20, int offset = 0);
     
+    // Streaming variants: records go to the sink one at a time as the body
+    // arrives, without buffering the page or building a cJSON tree
+    // A 304 replays the cached page into sink, unless not_modified is given:
+    // then *not_modified is set and sink is not called.
+    bool stream_user_playlists(const PlaylistSink& sink, const std::string& user_id = "me", int limit = 20, int offset = 0,
+                               bool* not_modified = nullptr);
+    // page_items: entries on the page, unavailable (unemitted) ones included
+    bool stream_playlist_tracks(const std::string& playlist_id, const TrackSink& sink, int limit = 100, int offset = 0,
+                                size_t* page_items = nullptr);
+    // should_abort: checked before sending and per chunk; true abandons the
+    // search (returns false, nothing more reaches sink)
+    bool stream_search_tracks(const std::string& query, const TrackSink& sink, int limit = 20, int offset = 0,
+                              size_t* page_items = nullptr, const AbortCallback& should_abort = nullptr);
+    // Upcoming tracks in play order (currently_playing is not passed to sink)
+    bool stream_queue(const TrackSink& sink);
+    // One call for several ids (at most MAX_SEVERAL_TRACKS / _ALBUMS /
+    // _ARTISTS); unknown ids are left out, so match the results by id
+    bool stream_several_tracks(const std::vector<std::string>& track_ids, const TrackSink& sink);
+    bool stream_several_albums(const std::vector<std::string>& album_ids, const AlbumSink& sink);
+    bool stream_several_artists(const std::vector<std::string>& artist_ids, const ArtistSink& sink);
+    
     // Search API methods
     bool search(const std::string& query, const std::string& type = "track", int limit = 20, int offset = 0);
     
@@ -127,6 +225,12 @@ public:
     bool get_several_tracks(const std::vector<std::string>& track_ids);
     bool get_audio_features(const std::string& track_id);
     
+    // Image API methods: fetch an image (e.g. album art from i.scdn.co) and
+    // hand the body to on_data chunk by chunk. No auth, no rate limit.
+    // should_abort, if set, is asked before each chunk and cancels the download.
+    bool fetch_image(const std::string& url, const SpotifyHttpPool::DataCallback& on_data,
+                     const AbortCallback& should_abort = nullptr);
+    
     // Callback setters
     void set_response_callback(ResponseCallback callback, void* user_data = nullptr) {
         response_callback = callback;
@@ -152,13 +256,30 @@ public:
         error_callback = callback;
         callback_user_data = user_data;
     }
+    // Called before a request when the token is about to expire, so the
+    // request goes out with a fresh token instead of failing with a 401
+    void set_token_refresh_callback(TokenRefreshCallback callback, void* user_data = nullptr) {
+        token_refresh_callback = callback;
+        callback_user_data = user_data;
+    }
+    // While set, every API request is answered by source and nothing is sent;
+    // the parsers, cache and callbacks run as for a live response
+    void set_replay_source(ReplaySource source) { replay_source = std::move(source); }
     
     // Utility methods
-    bool is_initialized() const { return http_client != nullptr; }
+    bool is_initialized() const { return http_ready; }
+    uint32_t rate_limit_delay_ms(SpotifyRateLimiter::EndpointClass cls) const { return rate_limiter.delay_ms(cls); }
     std::string get_last_error() const;
     
     // Constants
     static constexpr const char* SPOTIFY_API_BASE_URL = "https://api.spotify.com/v1";
-    static constexpr int DEFAULT_RATE_LIMIT = 100; // requests per second
     static constexpr int HTTP_TIMEOUT_MS = 10000;
+    static constexpr int TOKEN_EXPIRY_SLACK_SECONDS = 60;  // Refresh inline this close to expiry
+    static constexpr size_t MAX_SEVERAL_TRACKS = 50;        // Web API limits for ?ids=
+    static constexpr size_t MAX_SEVERAL_ALBUMS = 20;
+    static constexpr size_t MAX_SEVERAL_ARTISTS = 50;
+    static constexpr uint32_t PREFETCH_MAX_AGE_MS = 5000;   // Older prefetched answers are refetched
+    static constexpr size_t ENDPOINT_SIZE = 512;            // Path and query, built on the stack
+    static constexpr size_t PLAYER_BODY_SIZE = 256;         // play and transfer bodies
+    static constexpr size_t REPLAY_CHUNK_SIZE = 1024;       // Recorded bodies reach stream parsers in pieces this big
 };
@@ -1,13 +1,15 @@
 #include "spotify_auth.h"
 #include "spotify_controller.h"
+#include "spotify_dns_cache.h"
+#include "url_builder.h"
+#include "time_service.h"
 #include "esp_log.h"
+#include "mem_tag.hpp"
 #include "esp_random.h"
 #include "esp_http_server.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 #include <cstring>
-#include <sstream>
-#include <iomanip>
 
 static const char *TAG = "spotify_auth";
 
@@ -18,9 +20,15 @@ static const char* NVS_REFRESH_TOKEN_KEY = "refresh_token";
 static const char* NVS_TOKEN_TYPE_KEY = "token_type";
 static const char* NVS_EXPIRES_AT_KEY = "expires_at";
 static const char* NVS_SCOPE_KEY = "scope";
+static const char* NVS_PKCE_VERIFIER_KEY = "pkce_verifier";
+static const char* NVS_PKCE_STATE_KEY = "pkce_state";
 
 SpotifyAuth::SpotifyAuth() 
     : auth_state(SpotifyAuthState::NOT_AUTHENTICATED)
+    , next_refresh_at(0)
+    , refresh_mutex(xSemaphoreCreateRecursiveMutex())
+    , refresh_generation(0)
+    , last_refresh_ok(false)
     , callback_server(nullptr)
     , server_running(false)
     , auth_state_callback(nullptr)
@@ -34,6 +42,10 @@ SpotifyAuth::SpotifyAuth()
 
 SpotifyAuth::~SpotifyAuth() {
     deinitialize();
+    
+    if (refresh_mutex) {
+        vSemaphoreDelete(refresh_mutex);
+    }
 }
 
 bool SpotifyAuth::initialize(const std::string& client_id, 
@@ -45,19 +57,17 @@ bool SpotifyAuth::initialize(const std::string& client_id,
     this->redirect_uri = redirect_uri;
     this->scope = scope;
     
-    // Generate PKCE parameters
-    code_verifier = generate_code_verifier();
-    code_challenge = generate_code_challenge(code_verifier);
-    state = generate_random_string(16);
-    
-    ESP_LOGI(TAG, "Generated PKCE parameters");
-    ESP_LOGD(TAG, "Code verifier length: %d", code_verifier.length());
-    ESP_LOGD(TAG, "Code challenge: %s", code_challenge.c_str());
-    
-    // Try to load existing tokens
+    // Stored tokens need no PKCE or callback server: an expired one is
+    // refreshed by run_periodic_tasks() on the first pass
     if (load_tokens_from_nvs()) {
         ESP_LOGI(TAG, "Loaded existing tokens from NVS");
-        if (is_token_valid()) {
+        schedule_refresh();
+        // The expiry is wall-clock: with the RTC unset it cannot be checked, so refresh
+        if (!time_service_clock_valid()) {
+            ESP_LOGI(TAG, "Clock not set, refreshing the stored token");
+            next_refresh_at = 0;
+            update_auth_state(SpotifyAuthState::TOKEN_EXPIRED);
+        } else if (is_token_valid()) {
             update_auth_state(SpotifyAuthState::AUTHENTICATED);
         } else {
             ESP_LOGI(TAG, "Existing tokens are expired, will need to refresh");
@@ -65,6 +75,11 @@ bool SpotifyAuth::initialize(const std::string& client_id,
         }
     } else {
         ESP_LOGI(TAG, "No existing tokens found");
+        // Authorization started before a reboot can still be completed
+        if (load_pkce_from_nvs()) {
+            ESP_LOGI(TAG, "Resuming pending authorization");
+            start_callback_server();
+        }
         update_auth_state(SpotifyAuthState::NOT_AUTHENTICATED);
     }
     
@@ -140,22 +155,37 @@ std::string SpotifyAuth::generate_code_challenge(const std::string& verifier) {
     return result;
 }
 
-std::string SpotifyAuth::url_encode(const std::string& value) {
-    std::ostringstream escaped;
-    escaped.fill('0');
-    escaped << std::hex;
+bool SpotifyAuth::ensure_pkce() {
+    if (!code_verifier.empty()) {
+        return true;
+    }
     
-    for (char c : value) {
-        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
-            escaped << c;
-        } else {
-            escaped << std::uppercase;
-            escaped << '%' << std::setw(2) << int((unsigned char)c);
-            escaped << std::nouppercase;
-        }
+    code_verifier = generate_code_verifier();
+    code_challenge = generate_code_challenge(code_verifier);
+    state = generate_random_string(16);
+    if (code_challenge.empty()) {
+        clear_pkce();
+        return false;
     }
     
-    return escaped.str();
+    ESP_LOGI(TAG, "Generated PKCE parameters");
+    ESP_LOGD(TAG, "Code verifier length: %d", (int)code_verifier.length());
+    save_pkce_to_nvs();
+    return true;
+}
+
+void SpotifyAuth::clear_pkce() {
+    code_verifier.clear();
+    code_challenge.clear();
+    state.clear();
+    
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) == ESP_OK) {
+        nvs_erase_key(nvs_handle, NVS_PKCE_VERIFIER_KEY);
+        nvs_erase_key(nvs_handle, NVS_PKCE_STATE_KEY);
+        nvs_commit(nvs_handle);
+        nvs_close(nvs_handle);
+    }
 }
 
 std::string SpotifyAuth::get_authorization_url() {
@@ -164,18 +194,29 @@ std::string SpotifyAuth::get_authorization_url() {
         return "";
     }
     
-    std::ostringstream url;
-    url << SPOTIFY_AUTH_URL << "?"
-        << "response_type=code"
-        << "&client_id=" << url_encode(client_id)
-        << "&scope=" << url_encode(scope)
-        << "&redirect_uri=" << url_encode(redirect_uri)
-        << "&state=" << url_encode(state)
-        << "&code_challenge_method=S256"
-        << "&code_challenge=" << url_encode(code_challenge);
+    // Interactive authorization: the only point PKCE and the server are needed
+    if (!ensure_pkce()) {
+        ESP_LOGE(TAG, "Failed to generate PKCE parameters");
+        return "";
+    }
+    start_callback_server();
+    
+    UrlBuffer<AUTH_URL_SIZE> url;
+    url.append(SPOTIFY_AUTH_URL)
+        .param_raw("response_type", "code")
+        .param("client_id", client_id.c_str())
+        .param("scope", scope.c_str())
+        .param("redirect_uri", redirect_uri.c_str())
+        .param("state", state.c_str())
+        .param_raw("code_challenge_method", "S256")
+        .param("code_challenge", code_challenge.c_str());
+    if (!url.ok()) {
+        ESP_LOGE(TAG, "Authorization URL longer than %d bytes", (int)AUTH_URL_SIZE);
+        return "";
+    }
     
     ESP_LOGI(TAG, "Generated authorization URL");
-    return url.str();
+    return url.c_str();
 }
 
 bool SpotifyAuth::start_callback_server() {
@@ -327,72 +368,38 @@ bool SpotifyAuth::exchange_code_for_tokens(const std::string& auth_code) {
 
     update_auth_state(SpotifyAuthState::AUTHENTICATING);
 
-    // Prepare HTTP client
-    esp_http_client_config_t config = {};
-    config.url = SPOTIFY_TOKEN_URL;
-    config.method = HTTP_METHOD_POST;
-    config.timeout_ms = 10000;
-
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) {
-        ESP_LOGE(TAG, "Failed to initialize HTTP client");
+    // Prepare POST data
+    UrlBuffer<TOKEN_FORM_SIZE> post_data;
+    post_data.param_raw("grant_type", "authorization_code")
+        .param("code", auth_code.c_str())
+        .param("redirect_uri", redirect_uri.c_str())
+        .param("client_id", client_id.c_str())
+        .param("code_verifier", code_verifier.c_str());
+    if (!post_data.ok()) {
+        ESP_LOGE(TAG, "Token request longer than %d bytes", (int)TOKEN_FORM_SIZE);
         update_auth_state(SpotifyAuthState::ERROR_STATE);
         return false;
     }
 
-    // Prepare POST data
-    std::ostringstream post_data;
-    post_data << "grant_type=authorization_code"
-              << "&code=" << url_encode(auth_code)
-              << "&redirect_uri=" << url_encode(redirect_uri)
-              << "&client_id=" << url_encode(client_id)
-              << "&code_verifier=" << url_encode(code_verifier);
-
-    std::string post_data_str = post_data.str();
-
-    // Set headers
-    esp_http_client_set_header(client, "Content-Type", "application/x-www-form-urlencoded");
-    esp_http_client_set_post_field(client, post_data_str.c_str(), post_data_str.length());
-
     // Perform request
-    esp_err_t err = esp_http_client_perform(client);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
-        esp_http_client_cleanup(client);
+    int status_code = 0;
+    std::string response_body;
+    if (!post_token_request(post_data.c_str(), status_code, response_body)) {
         update_auth_state(SpotifyAuthState::ERROR_STATE);
         return false;
     }
 
-    // Check response status
-    int status_code = esp_http_client_get_status_code(client);
-    int content_length = esp_http_client_get_content_length(client);
-
-    ESP_LOGI(TAG, "Token exchange response: status=%d, length=%d", status_code, content_length);
+    ESP_LOGI(TAG, "Token exchange response: status=%d, length=%d", status_code, (int)response_body.length());
 
     if (status_code != 200) {
         ESP_LOGE(TAG, "Token exchange failed with status: %d", status_code);
-        esp_http_client_cleanup(client);
-        update_auth_state(SpotifyAuthState::ERROR_STATE);
-        return false;
-    }
-
-    // Read response
-    char* response_buffer = (char*)malloc(content_length + 1);
-    if (!response_buffer) {
-        ESP_LOGE(TAG, "Failed to allocate response buffer");
-        esp_http_client_cleanup(client);
         update_auth_state(SpotifyAuthState::ERROR_STATE);
         return false;
     }
 
-    int data_read = esp_http_client_read_response(client, response_buffer, content_length);
-    response_buffer[data_read] = '\0';
-
-    esp_http_client_cleanup(client);
-
     // Parse JSON response
-    cJSON* json = cJSON_Parse(response_buffer);
-    free(response_buffer);
+    mem_tag::Scope tag_scope(MEM_TAG_SPOTIFY);
+    cJSON* json = cJSON_Parse(response_body.c_str());
 
     if (!json) {
         ESP_LOGE(TAG, "Failed to parse token response JSON");
@@ -429,13 +436,15 @@ bool SpotifyAuth::exchange_code_for_tokens(const std::string& auth_code) {
     time_t now;
     time(&now);
     current_tokens.expires_at = now + current_tokens.expires_in;
+    schedule_refresh();
 
     cJSON_Delete(json);
 
     ESP_LOGI(TAG, "Successfully obtained tokens, expires in %d seconds", current_tokens.expires_in);
 
-    // Save tokens to NVS
+    // Save tokens to NVS; the PKCE parameters are spent
     save_tokens_to_nvs();
+    clear_pkce();
 
     update_auth_state(SpotifyAuthState::AUTHENTICATED);
 
@@ -447,73 +456,68 @@ bool SpotifyAuth::exchange_code_for_tokens(const std::string& auth_code) {
     return true;
 }
 
-bool SpotifyAuth::refresh_access_token() {
-    if (current_tokens.refresh_token.empty()) {
-        ESP_LOGE(TAG, "No refresh token available");
-        return false;
+bool SpotifyAuth::post_token_request(const std::string& form, int& status_code, std::string& body) {
+    if (!http_pool) {
+        http_pool = std::make_shared<SpotifyHttpPool>();
     }
 
-    ESP_LOGI(TAG, "Refreshing access token");
-
-    // Prepare HTTP client
-    esp_http_client_config_t config = {};
-    config.url = SPOTIFY_TOKEN_URL;
-    config.method = HTTP_METHOD_POST;
-    config.timeout_ms = 10000;
-
-    esp_http_client_handle_t client = esp_http_client_init(&config);
+    // Lease the pooled accounts-host client instead of a fresh handshake per call
+    esp_http_client_handle_t client = http_pool->acquire(SPOTIFY_TOKEN_URL);
     if (!client) {
-        ESP_LOGE(TAG, "Failed to initialize HTTP client for token refresh");
+        ESP_LOGE(TAG, "Failed to get HTTP client for token request");
         return false;
     }
 
-    // Prepare POST data
-    std::ostringstream post_data;
-    post_data << "grant_type=refresh_token"
-              << "&refresh_token=" << url_encode(current_tokens.refresh_token)
-              << "&client_id=" << url_encode(client_id);
-
-    std::string post_data_str = post_data.str();
-
-    // Set headers
+    esp_http_client_set_method(client, HTTP_METHOD_POST);
     esp_http_client_set_header(client, "Content-Type", "application/x-www-form-urlencoded");
-    esp_http_client_set_post_field(client, post_data_str.c_str(), post_data_str.length());
+    esp_http_client_set_post_field(client, form.c_str(), form.length());
 
-    // Perform request
-    esp_err_t err = esp_http_client_perform(client);
+    esp_err_t err = http_pool->perform(client, body);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Token refresh request failed: %s", esp_err_to_name(err));
-        esp_http_client_cleanup(client);
+        ESP_LOGE(TAG, "Token request failed: %s", esp_err_to_name(err));
+        http_pool->release(client, false);
         return false;
     }
 
-    // Check response status
-    int status_code = esp_http_client_get_status_code(client);
-    int content_length = esp_http_client_get_content_length(client);
+    status_code = esp_http_client_get_status_code(client);
+    http_pool->release(client);
+    return true;
+}
 
-    if (status_code != 200) {
-        ESP_LOGE(TAG, "Token refresh failed with status: %d", status_code);
-        esp_http_client_cleanup(client);
-        update_auth_state(SpotifyAuthState::ERROR_STATE);
+bool SpotifyAuth::refresh_access_token() {
+    if (current_tokens.refresh_token.empty()) {
+        ESP_LOGE(TAG, "No refresh token available");
         return false;
     }
 
-    // Read response
-    char* response_buffer = (char*)malloc(content_length + 1);
-    if (!response_buffer) {
-        ESP_LOGE(TAG, "Failed to allocate response buffer for token refresh");
-        esp_http_client_cleanup(client);
+    ESP_LOGI(TAG, "Refreshing access token");
+
+    // Prepare POST data
+    UrlBuffer<TOKEN_FORM_SIZE> post_data;
+    post_data.param_raw("grant_type", "refresh_token")
+        .param("refresh_token", current_tokens.refresh_token.c_str())
+        .param("client_id", client_id.c_str());
+    if (!post_data.ok()) {
+        ESP_LOGE(TAG, "Token request longer than %d bytes", (int)TOKEN_FORM_SIZE);
         return false;
     }
 
-    int data_read = esp_http_client_read_response(client, response_buffer, content_length);
-    response_buffer[data_read] = '\0';
+    // Perform request
+    int status_code = 0;
+    std::string response_body;
+    if (!post_token_request(post_data.c_str(), status_code, response_body)) {
+        return false;
+    }
 
-    esp_http_client_cleanup(client);
+    if (status_code != 200) {
+        ESP_LOGE(TAG, "Token refresh failed with status: %d", status_code);
+        update_auth_state(SpotifyAuthState::ERROR_STATE);
+        return false;
+    }
 
     // Parse JSON response
-    cJSON* json = cJSON_Parse(response_buffer);
-    free(response_buffer);
+    mem_tag::Scope tag_scope(MEM_TAG_SPOTIFY);
+    cJSON* json = cJSON_Parse(response_body.c_str());
 
     if (!json) {
         ESP_LOGE(TAG, "Failed to parse token refresh response JSON");
@@ -543,19 +547,32 @@ bool SpotifyAuth::refresh_access_token() {
     time_t now;
     time(&now);
     current_tokens.expires_at = now + current_tokens.expires_in;
+    schedule_refresh();
 
     cJSON_Delete(json);
 
-    ESP_LOGI(TAG, "Successfully refreshed access token");
+    ESP_LOGI(TAG, "Successfully refreshed access token, next refresh in %d seconds",
+             (int)(next_refresh_at - now));
 
     // Save updated tokens to NVS
     save_tokens_to_nvs();
 
     update_auth_state(SpotifyAuthState::AUTHENTICATED);
 
+    // Hand the new token to the API client
+    if (token_callback) {
+        token_callback(current_tokens, callback_user_data);
+    }
+
     return true;
 }
 
+// Refresh once TOKEN_REFRESH_LIFETIME_PERCENT of the token lifetime has passed
+void SpotifyAuth::schedule_refresh() {
+    int lifetime = current_tokens.expires_in > 0 ? current_tokens.expires_in : DEFAULT_TOKEN_LIFETIME_SECONDS;
+    next_refresh_at = current_tokens.expires_at - lifetime * (100 - TOKEN_REFRESH_LIFETIME_PERCENT) / 100;
+}
+
 void SpotifyAuth::update_auth_state(SpotifyAuthState new_state) {
     if (auth_state != new_state) {
         auth_state = new_state;
@@ -568,7 +585,13 @@ void SpotifyAuth::update_auth_state(SpotifyAuthState new_state) {
 }
 
 bool SpotifyAuth::handle_authorization_response(const std::string& auth_code, const std::string& received_state) {
-    if (received_state != state) {
+    if (code_verifier.empty()) {
+        ESP_LOGE(TAG, "No authorization in progress");
+        update_auth_state(SpotifyAuthState::ERROR_STATE);
+        return false;
+    }
+    // A code entered by hand comes without the redirect's state
+    if (!received_state.empty() && received_state != state) {
         ESP_LOGE(TAG, "State parameter mismatch");
         update_auth_state(SpotifyAuthState::ERROR_STATE);
         return false;
@@ -578,7 +601,29 @@ bool SpotifyAuth::handle_authorization_response(const std::string& auth_code, co
 }
 
 bool SpotifyAuth::refresh_token() {
-    return refresh_access_token();
+    if (!refresh_mutex) {
+        return refresh_access_token();
+    }
+
+    // Single flight: whoever takes the mutex first does the exchange, and
+    // callers that queued behind it reuse its result instead of repeating it.
+    // Recursive because a successful refresh reconnects, and a 401 on one of
+    // those requests comes back in here on the same task.
+    uint32_t generation = refresh_generation;
+    xSemaphoreTakeRecursive(refresh_mutex, portMAX_DELAY);
+
+    bool ok;
+    if (refresh_generation != generation) {
+        ESP_LOGD(TAG, "Joined in-flight token refresh");
+        ok = last_refresh_ok;
+    } else {
+        ok = refresh_access_token();
+        last_refresh_ok = ok;
+        refresh_generation++;
+    }
+
+    xSemaphoreGiveRecursive(refresh_mutex);
+    return ok;
 }
 
 void SpotifyAuth::logout() {
@@ -586,9 +631,11 @@ void SpotifyAuth::logout() {
 
     // Clear tokens
     memset(&current_tokens, 0, sizeof(current_tokens));
+    next_refresh_at = 0;
 
     // Clear stored tokens
     clear_stored_tokens();
+    clear_pkce();
 
     update_auth_state(SpotifyAuthState::NOT_AUTHENTICATED);
 }
@@ -609,13 +656,45 @@ bool SpotifyAuth::is_token_valid() const {
     return (current_tokens.expires_at - now) > TOKEN_REFRESH_MARGIN_SECONDS;
 }
 
+bool SpotifyAuth::needs_refresh(int lead_seconds) const {
+    if (current_tokens.refresh_token.empty() ||
+        (auth_state != SpotifyAuthState::AUTHENTICATED &&
+         auth_state != SpotifyAuthState::TOKEN_EXPIRED)) {
+        return false;
+    }
+
+    time_t now;
+    time(&now);
+    return now + lead_seconds >= next_refresh_at;
+}
+
 void SpotifyAuth::run_periodic_tasks() {
-    if (auth_state == SpotifyAuthState::AUTHENTICATED && !is_token_valid()) {
-        ESP_LOGI(TAG, "Token expired, attempting refresh");
-        if (!refresh_access_token()) {
-            ESP_LOGE(TAG, "Failed to refresh token");
-            update_auth_state(SpotifyAuthState::TOKEN_EXPIRED);
+    // Not from the callback handler itself: httpd_stop() waits for handlers
+    if (server_running && auth_state == SpotifyAuthState::AUTHENTICATED) {
+        stop_callback_server();
+    }
+    
+    if (!needs_refresh()) {
+        // The refresh then starts with its TLS handshake, not a DNS lookup
+        if (needs_refresh(TOKEN_PREWARM_SECONDS)) {
+            SpotifyDnsCache::shared().refresh(SPOTIFY_ACCOUNTS_HOST);
         }
+        return;
+    }
+
+    ESP_LOGI(TAG, "Access token due for refresh");
+    if (refresh_token()) {
+        return;
+    }
+
+    // Keep the current token while it lasts and try again shortly
+    time_t now;
+    time(&now);
+    next_refresh_at = now + TOKEN_REFRESH_RETRY_SECONDS;
+
+    if (auth_state == SpotifyAuthState::AUTHENTICATED && !is_token_valid()) {
+        ESP_LOGE(TAG, "Failed to refresh token");
+        update_auth_state(SpotifyAuthState::TOKEN_EXPIRED);
     }
 }
 
@@ -746,6 +825,49 @@ bool SpotifyAuth::load_tokens_from_nvs() {
     return success;
 }
 
+bool SpotifyAuth::save_pkce_to_nvs() {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    bool success = nvs_set_str(nvs_handle, NVS_PKCE_VERIFIER_KEY, code_verifier.c_str()) == ESP_OK &&
+                   nvs_set_str(nvs_handle, NVS_PKCE_STATE_KEY, state.c_str()) == ESP_OK &&
+                   nvs_commit(nvs_handle) == ESP_OK;
+    if (!success) {
+        ESP_LOGW(TAG, "Failed to save PKCE parameters to NVS");
+    }
+
+    nvs_close(nvs_handle);
+    return success;
+}
+
+bool SpotifyAuth::load_pkce_from_nvs() {
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return false;
+    }
+
+    // Verifier is 128 characters, state 16
+    char verifier[160];
+    char saved_state[32];
+    size_t verifier_len = sizeof(verifier);
+    size_t state_len = sizeof(saved_state);
+    bool success = nvs_get_str(nvs_handle, NVS_PKCE_VERIFIER_KEY, verifier, &verifier_len) == ESP_OK &&
+                   nvs_get_str(nvs_handle, NVS_PKCE_STATE_KEY, saved_state, &state_len) == ESP_OK &&
+                   verifier[0] != '\0';
+    nvs_close(nvs_handle);
+
+    if (success) {
+        code_verifier = verifier;
+        code_challenge = generate_code_challenge(code_verifier);
+        state = saved_state;
+    }
+    return success;
+}
+
 void SpotifyAuth::clear_stored_tokens() {
     nvs_handle_t nvs_handle;
     esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
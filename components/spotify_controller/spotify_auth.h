@@ -1,19 +1,35 @@
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <functional>
+#include <memory>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "esp_http_client.h"
 #include "esp_http_server.h"
 #include "cJSON.h"
 #include "mbedtls/base64.h"
 #include "mbedtls/sha256.h"
+#include "spotify_http_pool.h"
 
 /**
  * SpotifyAuth - OAuth2 authentication with PKCE for Spotify Web API
  * 
  * Implements the Authorization Code with PKCE flow suitable for embedded devices
  * that cannot securely store client secrets.
+ *
+ * The access token is refreshed in the background once 90% of its lifetime
+ * has passed (run_periodic_tasks), so API calls rarely see a 401. Concurrent
+ * refresh_token() calls are single-flight: callers that arrive while an
+ * exchange is in progress wait for it and share its result.
+ *
+ * Tokens persist in NVS, so a reboot only refreshes in the background. The
+ * PKCE verifier/state and the callback server exist only while interactive
+ * authorization is actually pending (from get_authorization_url() until
+ * the code is exchanged); the verifier is kept in NVS too, so a reboot
+ * between the browser step and the callback does not break the exchange.
  */
 
 /**
@@ -61,10 +77,19 @@ private:
     SpotifyTokens current_tokens;
     SpotifyAuthState auth_state;
     
+    // Background refresh schedule and single-flight guard
+    time_t next_refresh_at;
+    SemaphoreHandle_t refresh_mutex;
+    std::atomic<uint32_t> refresh_generation;
+    bool last_refresh_ok;
+    
     // HTTP server for callback handling
     httpd_handle_t callback_server;
     bool server_running;
     
+    // Pooled keep-alive connection to the accounts host
+    std::shared_ptr<SpotifyHttpPool> http_pool;
+    
     // Callbacks
     AuthStateCallback auth_state_callback;
     TokenCallback token_callback;
@@ -75,11 +100,16 @@ private:
     std::string generate_random_string(size_t length);
     std::string generate_code_verifier();
     std::string generate_code_challenge(const std::string& verifier);
-    std::string url_encode(const std::string& value);
+    bool ensure_pkce();
+    bool save_pkce_to_nvs();
+    bool load_pkce_from_nvs();
+    void clear_pkce();
     bool start_callback_server();
     void stop_callback_server();
     bool exchange_code_for_tokens(const std::string& auth_code);
     bool refresh_access_token();
+    bool post_token_request(const std::string& form, int& status_code, std::string& body);
+    void schedule_refresh();
     void update_auth_state(SpotifyAuthState new_state);
     
     // HTTP server callback handlers
@@ -95,6 +125,7 @@ public:
                    const std::string& redirect_uri = "http://localhost:8888/callback",
                    const std::string& scope = "user-read-playback-state user-modify-playback-state user-read-currently-playing playlist-read-private playlist-read-collaborative");
     void deinitialize();
+    void set_http_pool(std::shared_ptr<SpotifyHttpPool> pool) { http_pool = pool; }
     
     // Authentication flow
     std::string get_authorization_url();
@@ -105,6 +136,7 @@ public:
     // Token management
     bool is_authenticated() const;
     bool is_token_valid() const;
+    bool needs_refresh(int lead_seconds = 0) const;    // Due within lead_seconds
     const SpotifyTokens& get_tokens() const { return current_tokens; }
     std::string get_access_token() const { return current_tokens.access_token; }
     time_t get_token_expiry() const { return current_tokens.expires_at; }
@@ -136,5 +168,12 @@ public:
     static constexpr const char* SPOTIFY_AUTH_URL = "https://accounts.spotify.com/authorize";
     static constexpr const char* SPOTIFY_TOKEN_URL = "https://accounts.spotify.com/api/token";
     static constexpr int CALLBACK_SERVER_PORT = 8888;
-    static constexpr int TOKEN_REFRESH_MARGIN_SECONDS = 300; // Refresh 5 minutes before expiry
+    static constexpr int TOKEN_REFRESH_MARGIN_SECONDS = 300; // Treat as expired 5 minutes early
+    static constexpr int TOKEN_REFRESH_LIFETIME_PERCENT = 90; // Background refresh point
+    static constexpr int TOKEN_REFRESH_RETRY_SECONDS = 30;
+    static constexpr int TOKEN_PREWARM_SECONDS = 30;    // Resolve the token host this far ahead
+    static constexpr const char* SPOTIFY_ACCOUNTS_HOST = "accounts.spotify.com";
+    static constexpr int DEFAULT_TOKEN_LIFETIME_SECONDS = 3600;
+    static constexpr size_t AUTH_URL_SIZE = 1024;
+    static constexpr size_t TOKEN_FORM_SIZE = 768;      // An authorization code exchange, the longest form
 };
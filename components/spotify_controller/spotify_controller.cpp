@@ -1,7 +1,14 @@
 #include "spotify_controller.h"
 #include "spotify_auth.h"
 #include "spotify_api_client.h"
+#include "spotify_http_pool.h"
+#include "spotify_media_store.h"
+#include "spotify_request_batcher.h"
+#include "spotify_dealer_client.h"
+#include "spotify_dns_cache.h"
 #include "esp_log.h"
+#include "mem_budget.h"
+#include <ctime>
 #include <memory>
 
 static const char *TAG = "spotify_controller";
@@ -9,13 +16,25 @@ static const char *TAG = "spotify_controller";
 SpotifyController::SpotifyController()
     : auth_state(SpotifyAuthState::NOT_AUTHENTICATED)
     , connection_state(SpotifyConnectionState::DISCONNECTED)
+    , playback_synced_at(0)
+    , next_playback_poll(0)
+    , devices_fetched_at(0)
+    , devices_valid(false)
+    , paused_poll_interval_ms(0)
+    , playback_state_received(false)
+    , display_active(true)
+    , push_subscribed(false)
+    , has_queue_next(false)
+    , optimistic()
     , auth_state_callback(nullptr)
     , connection_state_callback(nullptr)
     , playback_state_callback(nullptr)
     , playlists_callback(nullptr)
     , tracks_callback(nullptr)
     , devices_callback(nullptr)
-    , error_callback(nullptr) {
+    , error_callback(nullptr)
+    , queue_callback(nullptr)
+    , command_failed_callback(nullptr) {
     
     // Initialize playback state
     memset(&current_playback_state, 0, sizeof(current_playback_state));
@@ -34,12 +53,16 @@ bool SpotifyController::initialize(const std::string& client_id,
     this->client_secret = client_secret;
     this->redirect_uri = redirect_uri;
     
+    // Connection pool shared by the auth and API clients
+    http_pool = std::make_shared<SpotifyHttpPool>();
+    
     // Create authentication client
     auth_client = std::make_unique<SpotifyAuth>();
     if (!auth_client) {
         ESP_LOGE(TAG, "Failed to create authentication client");
         return false;
     }
+    auth_client->set_http_pool(http_pool);
     
     // Initialize authentication
     if (!auth_client->initialize(client_id, redirect_uri)) {
@@ -56,13 +79,15 @@ bool SpotifyController::initialize(const std::string& client_id,
         ESP_LOGE(TAG, "Failed to create API client");
         return false;
     }
+    api_client->set_http_pool(http_pool);
+    lookup_batcher = std::make_unique<SpotifyRequestBatcher>();
+#ifdef CONFIG_SPOTIFY_PUSH_PLAYBACK_UPDATES
+    dealer = std::make_unique<SpotifyDealerClient>();
+#endif
     
     // Set up API client callbacks
     api_client->set_playback_callback([this](const SpotifyPlaybackState& state, void* user_data) {
-        this->current_playback_state = state;
-        if (this->playback_state_callback) {
-            this->playback_state_callback(state);
-        }
+        this->handle_playback_state(state);
     });
     
     api_client->set_playlists_callback([this](const std::vector<SpotifyPlaylist>& playlists, void* user_data) {
@@ -80,6 +105,8 @@ bool SpotifyController::initialize(const std::string& client_id,
     
     api_client->set_devices_callback([this](const std::vector<SpotifyDevice>& devices, void* user_data) {
         this->available_devices = devices;
+        this->devices_fetched_at = xTaskGetTickCount();
+        this->devices_valid = true;
         if (this->devices_callback) {
             this->devices_callback(devices);
         }
@@ -89,6 +116,19 @@ bool SpotifyController::initialize(const std::string& client_id,
         this->handle_api_error(error);
     });
     
+    // Keep the API client's token in step with background refreshes
+    auth_client->set_token_callback([this](const SpotifyTokens& tokens, void* user_data) {
+        if (this->api_client) {
+            this->api_client->set_access_token(tokens.access_token, tokens.expires_at);
+        }
+        if (this->dealer) {
+            this->dealer->set_access_token(tokens.access_token);
+        }
+    }, this);
+    api_client->set_token_refresh_callback([this](void* user_data) {
+        return this->refresh_token();
+    }, this);
+    
     ESP_LOGI(TAG, "Spotify controller initialized successfully");
     return true;
 }
@@ -98,6 +138,8 @@ void SpotifyController::deinitialize() {
     
     disconnect();
     
+    dealer.reset();
+    lookup_batcher.reset();
     if (api_client) {
         api_client->deinitialize();
         api_client.reset();
@@ -108,11 +150,17 @@ void SpotifyController::deinitialize() {
         auth_client.reset();
     }
     
+    http_pool.reset();
+    
     // Clear state
     auth_state = SpotifyAuthState::NOT_AUTHENTICATED;
     connection_state = SpotifyConnectionState::DISCONNECTED;
     user_playlists.clear();
     available_devices.clear();
+    devices_valid = false;
+    track_history.clear();
+    history_track = SpotifyTrack();
+    queue_track_id.clear();
     memset(&current_playback_state, 0, sizeof(current_playback_state));
 }
 
@@ -153,6 +201,11 @@ void SpotifyController::logout() {
     if (auth_client) {
         auth_client->logout();
     }
+    
+    // Cached pages belong to the account that just logged out
+    if (api_client) {
+        api_client->clear_response_cache();
+    }
 }
 
 bool SpotifyController::is_authenticated() const {
@@ -181,9 +234,15 @@ bool SpotifyController::connect() {
         handle_connection_state_change(SpotifyConnectionState::ERROR_STATE);
         return false;
     }
+    api_client->set_access_token(access_token, auth_client->get_token_expiry());
     
     handle_connection_state_change(SpotifyConnectionState::CONNECTED);
     
+    // Polling carries on until the dealer connection is subscribed
+    if (dealer) {
+        dealer->start(access_token);
+    }
+    
     // Refresh initial data
     refresh_user_data();
     
@@ -193,6 +252,15 @@ bool SpotifyController::connect() {
 void SpotifyController::disconnect() {
     ESP_LOGI(TAG, "Disconnecting from Spotify API");
     
+    if (lookup_batcher) {
+        lookup_batcher->cancel();
+    }
+    if (dealer) {
+        dealer->stop();
+    }
+    push_subscribed = false;
+    push_connection_id.clear();
+    optimistic.active = false;
     if (api_client) {
         api_client->deinitialize();
     }
@@ -211,7 +279,8 @@ bool SpotifyController::play(const std::string& uri) {
         return false;
     }
     
-    return api_client->start_resume_playback("", uri);
+    begin_optimistic(SpotifyTransportCommand::PLAY, uri);
+    return finish_optimistic(api_client->start_resume_playback("", uri));
 }
 
 bool SpotifyController::pause() {
@@ -220,7 +289,21 @@ bool SpotifyController::pause() {
         return false;
     }
     
-    return api_client->pause_playback();
+    begin_optimistic(SpotifyTransportCommand::PAUSE);
+    return finish_optimistic(api_client->pause_playback());
+}
+
+void SpotifyController::prewarm() {
+    // Even before connecting: the first requests then skip their lookups
+    SpotifyDnsCache::shared().refresh_expiring(true);
+    if (!is_connected()) {
+        return;
+    }
+    
+    if (!api_client->prewarm()) {
+        ESP_LOGD(TAG, "API connection closed, reopening ahead of a command");
+        get_current_playback_state();
+    }
 }
 
 bool SpotifyController::next_track() {
@@ -229,7 +312,8 @@ bool SpotifyController::next_track() {
         return false;
     }
     
-    return api_client->skip_to_next();
+    begin_optimistic(SpotifyTransportCommand::NEXT);
+    return finish_optimistic(api_client->skip_to_next());
 }
 
 bool SpotifyController::previous_track() {
@@ -238,7 +322,8 @@ bool SpotifyController::previous_track() {
         return false;
     }
     
-    return api_client->skip_to_previous();
+    begin_optimistic(SpotifyTransportCommand::PREVIOUS);
+    return finish_optimistic(api_client->skip_to_previous());
 }
 
 bool SpotifyController::seek_to_position(int position_ms) {
@@ -247,7 +332,7 @@ bool SpotifyController::seek_to_position(int position_ms) {
         return false;
     }
     
-    return api_client->seek_to_position(position_ms);
+    return after_user_action(api_client->seek_to_position(position_ms));
 }
 
 bool SpotifyController::set_volume(int volume_percent) {
@@ -256,7 +341,7 @@ bool SpotifyController::set_volume(int volume_percent) {
         return false;
     }
     
-    return api_client->set_playback_volume(volume_percent);
+    return after_user_action(api_client->set_playback_volume(volume_percent));
 }
 
 bool SpotifyController::set_shuffle(bool shuffle) {
@@ -265,7 +350,7 @@ bool SpotifyController::set_shuffle(bool shuffle) {
         return false;
     }
     
-    return api_client->toggle_playback_shuffle(shuffle);
+    return after_user_action(api_client->toggle_playback_shuffle(shuffle));
 }
 
 bool SpotifyController::set_repeat(const std::string& repeat_state) {
@@ -274,26 +359,54 @@ bool SpotifyController::set_repeat(const std::string& repeat_state) {
         return false;
     }
     
-    return api_client->set_repeat_mode(repeat_state);
+    return after_user_action(api_client->set_repeat_mode(repeat_state));
 }
 
 // Device management
-bool SpotifyController::get_available_devices() {
+bool SpotifyController::devices_fresh() const {
+    return devices_valid && (xTaskGetTickCount() - devices_fetched_at) < pdMS_TO_TICKS(DEVICES_TTL_MS);
+}
+
+bool SpotifyController::get_available_devices(bool refresh) {
     if (!is_connected()) {
         ESP_LOGE(TAG, "Not connected to Spotify API");
         return false;
     }
     
+    if (!refresh && devices_fresh()) {
+        ESP_LOGD(TAG, "Devices served from cache");
+        if (devices_callback) {
+            devices_callback(available_devices);
+        }
+        return true;
+    }
     return api_client->get_available_devices();
 }
 
+// Playback moved to a device the cached list does not show as playing:
+// someone switched speakers from another app
+void SpotifyController::check_active_device(const SpotifyPlaybackState& state) {
+    if (!devices_valid || state.device_id.empty()) {
+        return;
+    }
+    for (const SpotifyDevice& device : available_devices) {
+        if (device.id == state.device_id && device.is_active) {
+            return;
+        }
+    }
+    ESP_LOGD(TAG, "Active device changed, devices to be fetched again");
+    devices_valid = false;
+}
+
 bool SpotifyController::transfer_playback(const std::string& device_id) {
     if (!is_connected()) {
         ESP_LOGE(TAG, "Not connected to Spotify API");
         return false;
     }
     
-    return api_client->transfer_playback(device_id, true);
+    bool ok = api_client->transfer_playback(device_id, true);
+    invalidate_devices();
+    return after_user_action(ok);
 }
 
 // Content methods
@@ -324,53 +437,281 @@ bool SpotifyController::search_tracks(const std::string& query, int limit) {
     return api_client->search(query, "track", limit);
 }
 
-bool SpotifyController::get_current_playback_state() {
+bool SpotifyController::get_user_playlists(SpotifyMediaStore& store, bool* not_modified, int limit, int offset) {
     if (!is_connected()) {
         ESP_LOGE(TAG, "Not connected to Spotify API");
         return false;
     }
     
-    return api_client->get_playback_state();
+    return api_client->stream_user_playlists([&store](const SpotifyPlaylist& playlist) {
+        store.add_playlist(playlist);
+    }, "me", limit, offset, not_modified);
 }
 
-// Casting integration
-bool SpotifyController::cast_to_chromecast(const std::string& chromecast_ip, const std::string& track_uri) {
-    ESP_LOGI(TAG, "Attempting to cast Spotify track to Chromecast: %s", chromecast_ip.c_str());
+bool SpotifyController::get_playlist_tracks(const std::string& playlist_id, SpotifyMediaStore& store, int limit, int offset,
+                                            size_t* page_items) {
+    if (!is_connected()) {
+        ESP_LOGE(TAG, "Not connected to Spotify API");
+        return false;
+    }
+    
+    return api_client->stream_playlist_tracks(playlist_id, [&store](const SpotifyTrack& track) {
+        store.add_track(track);
+    }, limit, offset, page_items);
+}
 
+bool SpotifyController::search_tracks(const std::string& query, int limit, SpotifyMediaStore& store, int offset,
+                                      size_t* page_items, const AbortCallback& should_abort) {
     if (!is_connected()) {
         ESP_LOGE(TAG, "Not connected to Spotify API");
         return false;
     }
+    
+    return api_client->stream_search_tracks(query, [&store](const SpotifyTrack& track) {
+        store.add_track(track);
+    }, limit, offset, page_items, should_abort);
+}
 
-    if (chromecast_ip.empty() || track_uri.empty()) {
-        ESP_LOGE(TAG, "Invalid parameters for casting");
+void SpotifyController::set_image_target(int pixels) {
+    if (api_client) {
+        api_client->set_image_target(pixels);
+    }
+}
+
+bool SpotifyController::fetch_image(const std::string& url, const std::function<void(const char*, size_t)>& on_data,
+                                    const AbortCallback& should_abort) {
+    if (!is_connected()) {
+        ESP_LOGE(TAG, "Not connected to Spotify API");
         return false;
     }
+    
+    return api_client->fetch_image(url, on_data, should_abort);
+}
 
-    // For now, we'll implement a basic approach:
-    // 1. Get track information from Spotify
-    // 2. Use the preview URL if available
-    // 3. Send to Chromecast via HTTP streaming
+bool SpotifyController::lookup_track(const std::string& track_id, TrackLookupCallback callback) {
+    if (!is_connected()) {
+        ESP_LOGE(TAG, "Not connected to Spotify API");
+        return false;
+    }
+    
+    return lookup_batcher->lookup_track(track_id, std::move(callback));
+}
 
-    // First, try to get track details
-    std::string track_id = track_uri;
-    if (track_uri.find("spotify:track:") == 0) {
-        track_id = track_uri.substr(14); // Remove "spotify:track:" prefix
+bool SpotifyController::lookup_album(const std::string& album_id, AlbumLookupCallback callback) {
+    if (!is_connected()) {
+        ESP_LOGE(TAG, "Not connected to Spotify API");
+        return false;
     }
+    
+    return lookup_batcher->lookup_album(album_id, std::move(callback));
+}
 
-    // For this implementation, we'll use a simplified approach
-    // In a full implementation, you would:
-    // 1. Use Spotify Connect API to transfer playback to a Chromecast-enabled device
-    // 2. Or stream the preview URL to Chromecast
-    // 3. Or integrate with a media server that can handle Spotify URLs
+bool SpotifyController::lookup_artist(const std::string& artist_id, ArtistLookupCallback callback) {
+    if (!is_connected()) {
+        ESP_LOGE(TAG, "Not connected to Spotify API");
+        return false;
+    }
+    
+    return lookup_batcher->lookup_artist(artist_id, std::move(callback));
+}
 
-    ESP_LOGI(TAG, "Casting functionality requires additional integration with Chromecast media streaming");
-    ESP_LOGI(TAG, "Track URI: %s, Chromecast IP: %s", track_uri.c_str(), chromecast_ip.c_str());
+uint32_t SpotifyController::get_lookup_delay_ms() const {
+    if (!lookup_batcher) {
+        return SpotifyRequestBatcher::NOTHING_PENDING;
+    }
+    
+    // A due batch still waits for rate-limit budget rather than failing
+    uint32_t delay_ms = lookup_batcher->delay_ms();
+    if (delay_ms == 0) {
+        delay_ms = api_client->rate_limit_delay_ms(SpotifyRateLimiter::EndpointClass::BROWSE);
+    }
+    return delay_ms;
+}
 
-    // For demonstration, we'll return true but log that full implementation is needed
-    ESP_LOGW(TAG, "Casting simulation - full implementation requires media streaming setup");
+void SpotifyController::flush_lookups() {
+    if (!lookup_batcher) {
+        return;
+    }
+    
+    if (!is_connected()) {
+        lookup_batcher->cancel();
+        return;
+    }
+    lookup_batcher->flush(*api_client);
+}
 
-    return true; // Return true for demo purposes
+bool SpotifyController::get_current_playback_state() {
+    if (!is_connected()) {
+        ESP_LOGE(TAG, "Not connected to Spotify API");
+        return false;
+    }
+    
+    playback_state_received = false;
+    bool ok = api_client->get_playback_state();
+    
+    uint32_t delay_ms;
+    const SpotifyPlaybackState& state = current_playback_state;
+    if (!ok) {
+        delay_ms = POLL_RETRY_MS;
+        uint32_t limited_ms = api_client->rate_limit_delay_ms(SpotifyRateLimiter::EndpointClass::PLAYER);
+        if (limited_ms > delay_ms) delay_ms = limited_ms;
+    } else if (playback_state_received && state.is_playing && state.current_track.duration_ms > 0) {
+        // Nothing to learn until the track ends, unless the user acts
+        paused_poll_interval_ms = 0;
+        int remaining_ms = state.current_track.duration_ms - get_estimated_progress_ms();
+        delay_ms = remaining_ms > 0 ? remaining_ms + POLL_TRACK_END_MARGIN_MS : POLL_TRACK_END_MARGIN_MS;
+        if (delay_ms < POLL_PLAYING_MIN_MS) delay_ms = POLL_PLAYING_MIN_MS;
+        if (delay_ms > POLL_PLAYING_MAX_MS) delay_ms = POLL_PLAYING_MAX_MS;
+    } else {
+        // Paused, unchanged (304) or no active device: back off to the max
+        paused_poll_interval_ms = paused_poll_interval_ms ? paused_poll_interval_ms * 2 : POLL_PAUSED_MIN_MS;
+        if (paused_poll_interval_ms > POLL_PAUSED_MAX_MS) paused_poll_interval_ms = POLL_PAUSED_MAX_MS;
+        delay_ms = paused_poll_interval_ms;
+    }
+    // An unconfirmed command: look again soon, not at the end of the track
+    if (optimistic.active && delay_ms > POLL_AFTER_ACTION_MS) {
+        delay_ms = POLL_AFTER_ACTION_MS;
+    }
+    schedule_playback_poll(delay_ms);
+    
+    // The queue still follows the old track until the command has landed
+    if (ok && playback_state_received && !optimistic.active) {
+        prefetch_track_neighbours();
+    }
+    
+    return ok;
+}
+
+// On a track change, note the track we left and fetch what plays next, so
+// a skip can be shown before Spotify confirms it
+void SpotifyController::prefetch_track_neighbours() {
+    const SpotifyTrack& current = current_playback_state.current_track;
+    if (current.id.empty() || current.id == queue_track_id) {
+        return;
+    }
+    
+    if (current.id != history_track.id) {
+        // Skipping back returns to the newest history entry; anything else
+        // pushes the track that was playing
+        if (!track_history.empty() && track_history.back().id == current.id) {
+            track_history.pop_back();
+        } else if (!history_track.id.empty()) {
+            track_history.push_back(history_track);
+            if (track_history.size() > TRACK_HISTORY_LEN) {
+                track_history.erase(track_history.begin());
+            }
+        }
+        history_track = current;
+    }
+    
+    // A prefetch is background work; retried on the next poll if held back
+    if (!mem_budget_admit(MEM_BUDGET_BACKGROUND, 0)) {
+        return;
+    }
+
+    SpotifyTrack next;
+    bool have_next = false;
+    has_queue_next = false;
+    bool ok = api_client->stream_queue([&next, &have_next](const SpotifyTrack& track) {
+        if (!have_next) {
+            next = track;
+            have_next = true;
+        }
+    });
+    if (!ok) {
+        // Retried on the next poll
+        return;
+    }
+    queue_track_id = current.id;
+    queue_next = next;
+    has_queue_next = have_next;
+    
+    ESP_LOGD(TAG, "Next track: %s", have_next ? next.name.c_str() : "(none)");
+    if (queue_callback) {
+        queue_callback(track_history.empty() ? nullptr : &track_history.back(), have_next ? &next : nullptr);
+    }
+}
+
+uint32_t SpotifyController::get_rate_limit_delay_ms(SpotifyRateLimiter::EndpointClass cls) const {
+    return api_client ? api_client->rate_limit_delay_ms(cls) : 0;
+}
+
+int SpotifyController::get_estimated_progress_ms() const {
+    const SpotifyPlaybackState& state = current_playback_state;
+    if (!state.is_playing) {
+        return state.progress_ms;
+    }
+    
+    uint32_t elapsed_ms = (xTaskGetTickCount() - playback_synced_at) * portTICK_PERIOD_MS;
+    int64_t progress_ms = (int64_t)state.progress_ms + elapsed_ms;
+    if (state.current_track.duration_ms > 0 && progress_ms > state.current_track.duration_ms) {
+        progress_ms = state.current_track.duration_ms;
+    }
+    return (int)progress_ms;
+}
+
+// Casting integration
+bool SpotifyController::get_access_token(std::string& token, uint32_t& expires_in_s) {
+    if (!auth_client || !auth_client->is_authenticated()) {
+        ESP_LOGE(TAG, "Not authenticated");
+        return false;
+    }
+    if (auth_client->needs_refresh() && !auth_client->refresh_token()) {
+        return false;
+    }
+
+    token = auth_client->get_access_token();
+    time_t remaining = auth_client->get_token_expiry() - time(nullptr);
+    expires_in_s = remaining > 0 ? (uint32_t)remaining : 0;
+    return !token.empty() && expires_in_s > 0;
+}
+
+bool SpotifyController::cast_to_device(const std::string& device_name, const std::string& track_uri) {
+    if (!is_connected()) {
+        ESP_LOGE(TAG, "Not connected to Spotify API");
+        return false;
+    }
+    if (device_name.empty()) {
+        ESP_LOGE(TAG, "Invalid parameters for casting");
+        return false;
+    }
+
+    // The receiver registers with Spotify a moment after it takes the token;
+    // the cache is only trusted for a device it already lists
+    std::string device_id;
+    if (devices_fresh()) {
+        for (const SpotifyDevice& device : available_devices) {
+            if (device.name == device_name) {
+                device_id = device.id;
+                break;
+            }
+        }
+    }
+    for (uint32_t waited = 0; device_id.empty(); waited += CAST_DEVICE_POLL_MS) {
+        if (get_available_devices(true)) {
+            for (const SpotifyDevice& device : available_devices) {
+                if (device.name == device_name) {
+                    device_id = device.id;
+                    break;
+                }
+            }
+        }
+        if (device_id.empty()) {
+            if (waited >= CAST_DEVICE_WAIT_MS) {
+                handle_api_error("Cast device " + device_name + " did not appear in Spotify Connect");
+                return false;
+            }
+            vTaskDelay(pdMS_TO_TICKS(CAST_DEVICE_POLL_MS));
+        }
+    }
+
+    ESP_LOGI(TAG, "Transferring playback to %s (%s)", device_name.c_str(), device_id.c_str());
+    bool ok = api_client->transfer_playback(device_id, track_uri.empty());
+    if (ok && !track_uri.empty()) {
+        ok = api_client->start_resume_playback(device_id, track_uri);
+    }
+    invalidate_devices();
+    return after_user_action(ok);
 }
 
 // Utility methods
@@ -393,20 +734,76 @@ void SpotifyController::run_periodic_tasks() {
         auth_client->run_periodic_tasks();
     }
 
-    // Update playback state periodically if connected
-    if (is_connected()) {
-        static time_t last_update = 0;
-        time_t now;
-        time(&now);
-
-        // Update every 5 seconds
-        if (now - last_update >= 5) {
-            get_current_playback_state();
-            last_update = now;
+    // Drop keep-alive connections nobody has used for a while, and re-resolve
+    // the hosts still in use before their DNS records run out
+    if (http_pool) {
+        http_pool->close_idle();
+    }
+    SpotifyDnsCache::shared().refresh_expiring(false);
+
+    if (dealer && is_connected()) {
+        service_push_updates();
+    }
+    
+    expire_optimistic();
+
+    // Poll playback state when the adaptive schedule says it is due (not at
+    // all while player events are pushed)
+    if (is_connected() && display_active && !push_subscribed &&
+        (int32_t)(xTaskGetTickCount() - next_playback_poll) >= 0) {
+        get_current_playback_state();
+    }
+}
+
+// Keep the dealer subscription alive and apply the latest pushed state
+void SpotifyController::service_push_updates() {
+    dealer->run_periodic_tasks();
+    
+    if (push_subscribed && !dealer->is_connected()) {
+        ESP_LOGW(TAG, "Player event connection lost, polling playback state");
+        push_subscribed = false;
+        schedule_playback_poll(0);
+    }
+    
+    // Every (re)connect has to be registered; a throttled attempt is retried
+    std::string connection_id;
+    if (dealer->take_connection_id(connection_id)) {
+        push_connection_id = connection_id;
+    }
+    if (!push_connection_id.empty() &&
+        api_client->rate_limit_delay_ms(SpotifyRateLimiter::EndpointClass::BROWSE) == 0) {
+        push_subscribed = api_client->subscribe_player_notifications(push_connection_id);
+        if (push_subscribed ||
+            api_client->rate_limit_delay_ms(SpotifyRateLimiter::EndpointClass::BROWSE) == 0) {
+            push_connection_id.clear();
+        }
+        ESP_LOGI(TAG, "Player event subscription %s", push_subscribed ? "active, polling stopped" : "failed");
+    }
+    
+    std::string state_json;
+    if (dealer->take_player_state(state_json) && push_subscribed) {
+        playback_state_received = false;
+        if (api_client->apply_pushed_playback_state(state_json) && playback_state_received) {
+            paused_poll_interval_ms = 0;
+            if (!optimistic.active) {
+                prefetch_track_neighbours();
+            }
         }
     }
 }
 
+void SpotifyController::set_display_active(bool active) {
+    if (display_active == active) {
+        return;
+    }
+    
+    ESP_LOGI(TAG, "Display %s, playback polling %s", active ? "on" : "off", active ? "resumed" : "stopped");
+    display_active = active;
+    if (active) {
+        schedule_playback_poll(0);
+    }
+}
+
 // Internal methods
 void SpotifyController::handle_auth_state_change(SpotifyAuthState new_state) {
     if (auth_state != new_state) {
@@ -457,6 +854,159 @@ void SpotifyController::handle_api_error(const std::string& error) {
     }
 }
 
+void SpotifyController::schedule_playback_poll(uint32_t delay_ms) {
+    next_playback_poll = xTaskGetTickCount() + pdMS_TO_TICKS(delay_ms);
+}
+
+// Playback commands change what the server reports; resync shortly after
+bool SpotifyController::after_user_action(bool ok) {
+    if (ok) {
+        paused_poll_interval_ms = 0;
+        schedule_playback_poll(POLL_AFTER_ACTION_MS);
+    }
+    return ok;
+}
+
+// Every reported state, polled or pushed. One that still shows the state
+// from before an optimistic command is held back until the deadline.
+void SpotifyController::handle_playback_state(const SpotifyPlaybackState& state) {
+    playback_state_received = true;
+    
+    bool failed = false;
+    if (optimistic.active) {
+        if (!optimistic_confirmed(state)) {
+            if ((int32_t)(xTaskGetTickCount() - optimistic.deadline) < 0) {
+                ESP_LOGD(TAG, "Playback state predates command %d, keeping the expected state",
+                         (int)optimistic.command);
+                return;
+            }
+            ESP_LOGW(TAG, "Command %d not confirmed, showing the reported state", (int)optimistic.command);
+            failed = true;
+        }
+        optimistic.active = false;
+    }
+    
+    check_active_device(state);
+    current_playback_state = state;
+    playback_synced_at = xTaskGetTickCount();
+    if (playback_state_callback) {
+        playback_state_callback(state);
+    }
+    if (failed && command_failed_callback) {
+        command_failed_callback(optimistic.command);
+    }
+}
+
+// Report what the command should lead to, before it goes out. Commands in
+// quick succession each predict from the last prediction but keep the last
+// reported state to fall back to.
+void SpotifyController::begin_optimistic(SpotifyTransportCommand command, const std::string& uri) {
+    int progress_ms = get_estimated_progress_ms();
+    if (!optimistic.active) {
+        optimistic.before = current_playback_state;
+        optimistic.before_synced_at = playback_synced_at;
+        optimistic.from_progress_ms = progress_ms;
+    }
+    optimistic.active = true;
+    optimistic.command = command;
+    optimistic.from_uri = uri;
+    optimistic.deadline = xTaskGetTickCount() + pdMS_TO_TICKS(OPTIMISTIC_SETTLE_MS);
+    
+    SpotifyPlaybackState& predicted = current_playback_state;
+    switch (command) {
+        case SpotifyTransportCommand::PLAY:
+        case SpotifyTransportCommand::PAUSE:
+            predicted.is_playing = command == SpotifyTransportCommand::PLAY;
+            predicted.progress_ms = progress_ms;
+            break;
+        case SpotifyTransportCommand::NEXT:
+            // Without the queue only the play state is predicted
+            if (has_queue_next && queue_track_id == predicted.current_track.id) {
+                predicted.current_track = queue_next;
+                predicted.progress_ms = 0;
+            }
+            predicted.is_playing = true;
+            break;
+        case SpotifyTransportCommand::PREVIOUS:
+            // Spotify restarts the current track instead once it is a few seconds in
+            if (progress_ms <= PREVIOUS_RESTART_MS && !track_history.empty() &&
+                track_history.back().id != predicted.current_track.id) {
+                predicted.current_track = track_history.back();
+            }
+            predicted.progress_ms = 0;
+            predicted.is_playing = true;
+            break;
+    }
+    playback_synced_at = xTaskGetTickCount();
+    
+    if (playback_state_callback) {
+        playback_state_callback(predicted);
+    }
+}
+
+bool SpotifyController::finish_optimistic(bool ok) {
+    if (ok) {
+        return after_user_action(true);
+    }
+    
+    // Throttled: the worker sends it again once the limit lifts, so the
+    // prediction stands until then
+    uint32_t retry_ms = api_client->rate_limit_delay_ms(SpotifyRateLimiter::EndpointClass::PLAYER);
+    if (retry_ms > 0) {
+        optimistic.deadline = xTaskGetTickCount() + pdMS_TO_TICKS(retry_ms + OPTIMISTIC_SETTLE_MS);
+        return false;
+    }
+    rollback_optimistic();
+    return false;
+}
+
+bool SpotifyController::optimistic_confirmed(const SpotifyPlaybackState& state) const {
+    const SpotifyPlaybackState& before = optimistic.before;
+    switch (optimistic.command) {
+        case SpotifyTransportCommand::PLAY:
+            // A track given by URI has to be the one playing; a context cannot be told apart
+            if (optimistic.from_uri.rfind("spotify:track:", 0) == 0 && state.current_track.uri != optimistic.from_uri) {
+                return false;
+            }
+            return state.is_playing;
+        case SpotifyTransportCommand::PAUSE:
+            return !state.is_playing;
+        case SpotifyTransportCommand::NEXT:
+            return state.current_track.id != before.current_track.id;
+        case SpotifyTransportCommand::PREVIOUS:
+            // Another track, or the same one restarted
+            return state.current_track.id != before.current_track.id || state.progress_ms < optimistic.from_progress_ms;
+    }
+    return true;
+}
+
+void SpotifyController::rollback_optimistic() {
+    ESP_LOGW(TAG, "Command %d failed, restoring the reported playback state", (int)optimistic.command);
+    optimistic.active = false;
+    current_playback_state = optimistic.before;
+    playback_synced_at = optimistic.before_synced_at;
+    if (playback_state_callback) {
+        playback_state_callback(current_playback_state);
+    }
+    if (command_failed_callback) {
+        command_failed_callback(optimistic.command);
+    }
+}
+
+// Nothing has confirmed the command by its deadline (pushed events, or polls
+// that kept failing): ask once more, and roll back if that settles nothing
+void SpotifyController::expire_optimistic() {
+    if (!optimistic.active || (int32_t)(xTaskGetTickCount() - optimistic.deadline) < 0) {
+        return;
+    }
+    if (is_connected()) {
+        get_current_playback_state();
+    }
+    if (optimistic.active) {
+        rollback_optimistic();
+    }
+}
+
 void SpotifyController::update_playback_state() {
     if (is_connected()) {
         get_current_playback_state();
@@ -470,6 +1020,10 @@ void SpotifyController::refresh_user_data() {
 
     ESP_LOGI(TAG, "Refreshing user data");
 
+    // Over HTTP/2 the GETs below go out together and are then answered
+    // from what came back; devices only if the cache has gone stale
+    api_client->prefetch_user_data(!devices_fresh());
+
     // Get user playlists
     get_user_playlists();
 
@@ -10,6 +10,8 @@
 #include "esp_log.h"
 #include "cJSON.h"
 #include "esp_http_client.h"
+#include "spotify_rate_limiter.h"
+#include "spotify_types.h"
 
 /**
  * SpotifyController - ESP-IDF C++ class for Spotify Web API integration
@@ -17,68 +19,20 @@
  * Features:
  * - OAuth2 authentication with PKCE
  * - Spotify Web API client
- * - Playback control
+ * - Playback control, shown before Spotify confirms it (optimistic
+ *   play/pause/skip, reconciled with the next state fetched and rolled
+ *   back if the command fails)
  * - Playlist and track management
- * - Integration with Chromecast for casting
+ * - Casting: playback moved to a Spotify receiver running on a Cast device
  */
 
 // Forward declarations
 class SpotifyAuth;
 class SpotifyApiClient;
-
-/**
- * @brief Spotify track information
- */
-struct SpotifyTrack {
-    std::string id;
-    std::string name;
-    std::string artist;
-    std::string album;
-    std::string uri;
-    int duration_ms;
-    std::string preview_url;
-    std::string image_url;
-};
-
-/**
- * @brief Spotify playlist information
- */
-struct SpotifyPlaylist {
-    std::string id;
-    std::string name;
-    std::string description;
-    std::string uri;
-    int track_count;
-    std::string image_url;
-    std::string owner;
-};
-
-/**
- * @brief Spotify playback state
- */
-struct SpotifyPlaybackState {
-    bool is_playing;
-    int progress_ms;
-    int volume_percent;
-    bool shuffle_state;
-    std::string repeat_state; // "off", "track", "context"
-    SpotifyTrack current_track;
-    std::string device_id;
-    std::string device_name;
-};
-
-/**
- * @brief Spotify device information
- */
-struct SpotifyDevice {
-    std::string id;
-    std::string name;
-    std::string type;
-    bool is_active;
-    bool is_private_session;
-    bool is_restricted;
-    int volume_percent;
-};
+class SpotifyHttpPool;
+class SpotifyMediaStore;
+class SpotifyRequestBatcher;
+class SpotifyDealerClient;
 
 // Forward declaration - defined in spotify_auth.h
 enum class SpotifyAuthState;
@@ -93,6 +47,16 @@ enum class SpotifyConnectionState {
     ERROR_STATE
 };
 
+/**
+ * @brief Playback command whose outcome is shown before Spotify confirms it
+ */
+enum class SpotifyTransportCommand {
+    PLAY,
+    PAUSE,
+    NEXT,
+    PREVIOUS
+};
+
 class SpotifyController {
 public:
     // Callback function types
@@ -103,11 +67,25 @@ public:
     using TracksCallback = std::function<void(const std::vector<SpotifyTrack>&)>;
     using DevicesCallback = std::function<void(const std::vector<SpotifyDevice>&)>;
     using ErrorCallback = std::function<void(const std::string&)>;
+    // Tracks either side of the current one; nullptr when not known
+    using QueueCallback = std::function<void(const SpotifyTrack* previous, const SpotifyTrack* next)>;
+    // A command already reported as done did not take; the playback state
+    // callback has just been given the state it was rolled back to
+    using CommandFailedCallback = std::function<void(SpotifyTransportCommand)>;
+    // Batched lookup result; nullptr if the id is unknown or the call failed
+    using TrackLookupCallback = std::function<void(const SpotifyTrack*)>;
+    using AlbumLookupCallback = std::function<void(const SpotifyAlbum*)>;
+    using ArtistLookupCallback = std::function<void(const SpotifyArtist*)>;
+    // Polled while a cancellable request runs; true abandons it
+    using AbortCallback = std::function<bool()>;
 
 private:
-    // Component instances
+    // Component instances (auth and API share one keep-alive connection pool)
+    std::shared_ptr<SpotifyHttpPool> http_pool;
     std::unique_ptr<SpotifyAuth> auth_client;
     std::unique_ptr<SpotifyApiClient> api_client;
+    std::unique_ptr<SpotifyRequestBatcher> lookup_batcher;
+    std::unique_ptr<SpotifyDealerClient> dealer;    // Pushed player events (optional)
 
     // State management
     SpotifyAuthState auth_state;
@@ -116,6 +94,48 @@ private:
     std::vector<SpotifyPlaylist> user_playlists;
     std::vector<SpotifyDevice> available_devices;
 
+    // Connect devices are served from available_devices until a transfer,
+    // a playback state naming a device the list does not show as active,
+    // or DEVICES_TTL_MS
+    TickType_t devices_fetched_at;
+    bool devices_valid;
+
+    // Adaptive playback polling: progress is extrapolated from the last
+    // fetched state, so /me/player is only polled around the predicted end
+    // of the track, shortly after a user action, or slowly while paused
+    TickType_t playback_synced_at;      // When current_playback_state was fetched
+    TickType_t next_playback_poll;
+    uint32_t paused_poll_interval_ms;   // Current paused back-off, 0 while playing
+    bool playback_state_received;
+    bool display_active;                // No polling while the screen is off
+
+    // Pushed player events: while subscribed, polling only resumes once the
+    // dealer connection drops
+    bool push_subscribed;
+    std::string push_connection_id;     // Waiting for rate-limit budget to subscribe
+
+    // Skip prefetch: the queue is fetched once per track change, so the GUI
+    // can show the next/previous track as soon as the user skips
+    std::vector<SpotifyTrack> track_history;    // Played before the current track, newest last
+    SpotifyTrack history_track;                 // Current track as of the last history update
+    std::string queue_track_id;                 // Track the queue was last fetched for
+    SpotifyTrack queue_next;                    // Up next after queue_track_id
+    bool has_queue_next;
+
+    // Optimistic transport commands: the predicted state is reported before
+    // the request goes out. States fetched before Spotify has applied it are
+    // held back until OPTIMISTIC_SETTLE_MS; a failed request, or no
+    // confirmation by then, restores the last state Spotify reported.
+    struct Optimistic {
+        bool active;
+        SpotifyTransportCommand command;
+        SpotifyPlaybackState before;            // Last reported state, restored on failure
+        TickType_t before_synced_at;
+        std::string from_uri;                   // play(uri): a track URI that should start
+        int from_progress_ms;                   // Progress when the first command went out
+        TickType_t deadline;
+    } optimistic;
+
     // Callbacks
     AuthStateCallback auth_state_callback;
     ConnectionStateCallback connection_state_callback;
@@ -124,6 +144,8 @@ private:
     TracksCallback tracks_callback;
     DevicesCallback devices_callback;
     ErrorCallback error_callback;
+    QueueCallback queue_callback;
+    CommandFailedCallback command_failed_callback;
 
     // Configuration
     std::string client_id;
@@ -135,12 +157,38 @@ private:
     void handle_api_error(const std::string& error);
     void update_playback_state();
     void refresh_user_data();
+    void schedule_playback_poll(uint32_t delay_ms);
+    bool after_user_action(bool ok);
+    void handle_playback_state(const SpotifyPlaybackState& state);
+    void begin_optimistic(SpotifyTransportCommand command, const std::string& uri = "");
+    bool finish_optimistic(bool ok);
+    bool optimistic_confirmed(const SpotifyPlaybackState& state) const;
+    void rollback_optimistic();
+    void expire_optimistic();
+    void prefetch_track_neighbours();
+    bool devices_fresh() const;
+    void check_active_device(const SpotifyPlaybackState& state);
+    void service_push_updates();
 
     // Static callback functions for components
     static void auth_state_callback_wrapper(SpotifyAuthState state, void* user_data);
     static void api_response_callback_wrapper(const std::string& response, void* user_data);
 
 public:
+    static constexpr uint32_t POLL_AFTER_ACTION_MS = 1500;      // Let Spotify apply the change first
+    static constexpr uint32_t POLL_TRACK_END_MARGIN_MS = 1500;  // Poll just after the predicted end
+    static constexpr uint32_t POLL_PLAYING_MIN_MS = 2000;
+    static constexpr uint32_t POLL_PLAYING_MAX_MS = 120000;     // Catch changes made from other devices
+    static constexpr uint32_t POLL_PAUSED_MIN_MS = 30000;
+    static constexpr uint32_t POLL_PAUSED_MAX_MS = 60000;
+    static constexpr uint32_t POLL_RETRY_MS = 10000;
+    static constexpr size_t TRACK_HISTORY_LEN = 8;              // Previous tracks remembered
+    static constexpr uint32_t CAST_DEVICE_WAIT_MS = 10000;      // For a receiver to join Connect
+    static constexpr uint32_t CAST_DEVICE_POLL_MS = 1000;
+    static constexpr uint32_t OPTIMISTIC_SETTLE_MS = 5000;      // For Spotify to report a command applied
+    static constexpr int PREVIOUS_RESTART_MS = 3000;            // Past this, "previous" restarts the track
+    static constexpr uint32_t DEVICES_TTL_MS = 60000;           // Devices joining or leaving Connect meanwhile
+
     SpotifyController();
     ~SpotifyController();
 
@@ -161,7 +209,9 @@ public:
     void disconnect();
     bool is_connected() const;
 
-    // Playback control methods
+    // Playback control methods. play/pause/next/previous report the state
+    // they are expected to lead to through the playback state callback
+    // before the request goes out.
     bool play(const std::string& uri = "");
     bool pause();
     bool next_track();
@@ -171,18 +221,57 @@ public:
     bool set_shuffle(bool shuffle);
     bool set_repeat(const std::string& repeat_state);
 
-    // Device management
-    bool get_available_devices();
+    // A playback command is about to follow (e.g. a wake word was heard, the
+    // Spotify tab was opened): refresh DNS records and a token about to
+    // expire and, if the API connection has closed, reopen it (HTTP/2: just
+    // the connection; HTTP/1.1: with a playback state fetch), so the command
+    // goes straight out
+    void prewarm();
+
+    // Device management. The list is delivered through the devices callback,
+    // from the cache while it is fresh unless refresh is set.
+    bool get_available_devices(bool refresh = false);
     bool transfer_playback(const std::string& device_id);
+    void invalidate_devices() { devices_valid = false; }
 
     // Content methods
     bool get_user_playlists();
     bool get_playlist_tracks(const std::string& playlist_id);
     bool search_tracks(const std::string& query, int limit = 20);
+
+    // Store variants: the page is streamed straight into store instead of
+    // going through the playlists/tracks callbacks. With not_modified given,
+    // an unchanged playlists page sets it and leaves store empty. page_items
+    // counts the page's entries including unavailable tracks not stored.
+    // A search is dropped mid-download once should_abort returns true.
+    bool get_user_playlists(SpotifyMediaStore& store, bool* not_modified = nullptr, int limit = 20, int offset = 0);
+    bool get_playlist_tracks(const std::string& playlist_id, SpotifyMediaStore& store, int limit = 100, int offset = 0,
+                             size_t* page_items = nullptr);
+    bool search_tracks(const std::string& query, int limit, SpotifyMediaStore& store, int offset = 0,
+                       size_t* page_items = nullptr, const AbortCallback& should_abort = nullptr);
     bool get_current_playback_state();
 
-    // Casting integration
-    bool cast_to_chromecast(const std::string& chromecast_ip, const std::string& track_uri);
+    // Album art: choose image variants at least pixels wide, and download
+    // one, passing the body to on_data as it arrives, until should_abort
+    void set_image_target(int pixels);
+    bool fetch_image(const std::string& url, const std::function<void(const char*, size_t)>& on_data,
+                     const AbortCallback& should_abort = nullptr);
+
+    // Single-item lookups, collected for a short window and sent as one
+    // several-ids call. Nothing is sent until flush_lookups(); run it once
+    // get_lookup_delay_ms() reaches 0.
+    bool lookup_track(const std::string& track_id, TrackLookupCallback callback);
+    bool lookup_album(const std::string& album_id, AlbumLookupCallback callback);
+    bool lookup_artist(const std::string& artist_id, ArtistLookupCallback callback);
+    uint32_t get_lookup_delay_ms() const;   // UINT32_MAX: nothing pending
+    void flush_lookups();
+
+    // Casting integration. A Cast device's Spotify receiver is handed the
+    // access token (refreshed first if it is about to expire); once it shows
+    // up as a Connect device named device_name, playback is transferred to
+    // it and track_uri, if given, started there. Waits up to CAST_DEVICE_WAIT_MS.
+    bool get_access_token(std::string& token, uint32_t& expires_in_s);
+    bool cast_to_device(const std::string& device_name, const std::string& track_uri);
 
     // Callback setters
     void set_auth_state_callback(AuthStateCallback callback) { auth_state_callback = callback; }
@@ -192,6 +281,8 @@ public:
     void set_tracks_callback(TracksCallback callback) { tracks_callback = callback; }
     void set_devices_callback(DevicesCallback callback) { devices_callback = callback; }
     void set_error_callback(ErrorCallback callback) { error_callback = callback; }
+    void set_queue_callback(QueueCallback callback) { queue_callback = callback; }
+    void set_command_failed_callback(CommandFailedCallback callback) { command_failed_callback = callback; }
 
     // State change handlers
     void handle_connection_state_change(SpotifyConnectionState new_state);
@@ -200,6 +291,11 @@ public:
     SpotifyAuthState get_auth_state() const { return auth_state; }
     SpotifyConnectionState get_connection_state() const { return connection_state; }
     const SpotifyPlaybackState& get_playback_state() const { return current_playback_state; }
+    int get_estimated_progress_ms() const;
+
+    // Milliseconds until a call of this class may go out (0: now). The worker
+    // defers queued requests by this much instead of sending them.
+    uint32_t get_rate_limit_delay_ms(SpotifyRateLimiter::EndpointClass cls) const;
     const std::vector<SpotifyPlaylist>& get_playlists() const { return user_playlists; }
     const std::vector<SpotifyDevice>& get_devices() const { return available_devices; }
 
@@ -207,4 +303,8 @@ public:
     std::string get_auth_url() const;
     bool is_token_valid() const;
     void run_periodic_tasks();
+
+    // Stop playback polling while the display is off; turning it back on
+    // resyncs immediately
+    void set_display_active(bool active);
 };
@@ -0,0 +1,266 @@
+#include "spotify_dealer_client.h"
+#include "freertos/task.h"
+#include "tls_profile.h"
+#include "esp_log.h"
+#include "cJSON.h"
+#include <cstring>
+
+static const char *TAG = "spotify_dealer";
+
+// Websocket frame opcodes passed through WEBSOCKET_EVENT_DATA
+static constexpr uint8_t WS_OPCODE_CONTINUATION = 0x0;
+static constexpr uint8_t WS_OPCODE_TEXT = 0x1;
+
+static const char PING_MESSAGE[] = "{\"type\":\"ping\"}";
+
+SpotifyDealerClient::SpotifyDealerClient()
+    : client(nullptr)
+    , mailbox_lock(xSemaphoreCreateMutex())
+    , connected(false)
+    , pong_pending(false)
+    , last_ping(0)
+    , connection_id_pending(false)
+    , player_state_pending(false)
+    , message_too_large(false) {
+    mem_arena_init(&message_arena, MEM_TAG_SPOTIFY, 0);
+}
+
+SpotifyDealerClient::~SpotifyDealerClient() {
+    stop();
+    if (mailbox_lock) {
+        vSemaphoreDelete(mailbox_lock);
+    }
+    mem_arena_release(&message_arena);
+}
+
+std::string SpotifyDealerClient::build_uri(const std::string& access_token) {
+    return std::string(DEALER_URL) + "?access_token=" + access_token;
+}
+
+bool SpotifyDealerClient::start(const std::string& access_token) {
+    if (client) {
+        return true;
+    }
+    if (!mailbox_lock || access_token.empty()) {
+        return false;
+    }
+
+    std::string uri = build_uri(access_token);
+    esp_websocket_client_config_t config = {};
+    config.uri = uri.c_str();
+    config.crt_bundle_attach = tls_profile_crt_bundle(TLS_PROFILE_WEB);
+    config.reconnect_timeout_ms = RECONNECT_TIMEOUT_MS;
+    config.network_timeout_ms = NETWORK_TIMEOUT_MS;
+    config.buffer_size = BUFFER_SIZE;
+    config.task_stack = TASK_STACK_SIZE;
+    config.task_prio = TASK_PRIORITY;
+
+    client = esp_websocket_client_init(&config);
+    if (!client) {
+        ESP_LOGE(TAG, "Failed to initialize dealer websocket");
+        return false;
+    }
+    esp_websocket_register_events(client, WEBSOCKET_EVENT_ANY, event_handler, this);
+
+    if (esp_websocket_client_start(client) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start dealer websocket");
+        esp_websocket_client_destroy(client);
+        client = nullptr;
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Dealer websocket started");
+    return true;
+}
+
+void SpotifyDealerClient::stop() {
+    if (!client) {
+        return;
+    }
+
+    esp_websocket_client_stop(client);
+    esp_websocket_client_destroy(client);
+    client = nullptr;
+    connected = false;
+    pong_pending = false;
+
+    xSemaphoreTake(mailbox_lock, portMAX_DELAY);
+    connection_id.clear();
+    connection_id_pending = false;
+    player_state.clear();
+    player_state_pending = false;
+    xSemaphoreGive(mailbox_lock);
+
+    message.clear();
+    ESP_LOGI(TAG, "Dealer websocket stopped");
+}
+
+void SpotifyDealerClient::set_access_token(const std::string& access_token) {
+    if (client && !access_token.empty()) {
+        esp_websocket_client_set_uri(client, build_uri(access_token).c_str());
+    }
+}
+
+bool SpotifyDealerClient::take_connection_id(std::string& id) {
+    xSemaphoreTake(mailbox_lock, portMAX_DELAY);
+    bool pending = connection_id_pending;
+    if (pending) {
+        id = connection_id;
+        connection_id_pending = false;
+    }
+    xSemaphoreGive(mailbox_lock);
+    return pending;
+}
+
+bool SpotifyDealerClient::take_player_state(std::string& state_json) {
+    xSemaphoreTake(mailbox_lock, portMAX_DELAY);
+    bool pending = player_state_pending;
+    if (pending) {
+        state_json.swap(player_state);
+        player_state.clear();
+        player_state_pending = false;
+    }
+    xSemaphoreGive(mailbox_lock);
+    return pending;
+}
+
+void SpotifyDealerClient::run_periodic_tasks() {
+    if (!client || !connected) {
+        return;
+    }
+
+    TickType_t now = xTaskGetTickCount();
+    if (pong_pending && (now - last_ping) > pdMS_TO_TICKS(PONG_TIMEOUT_MS)) {
+        // Half-open socket: reconnect instead of waiting for TCP to notice
+        ESP_LOGW(TAG, "No pong from dealer, reconnecting");
+        pong_pending = false;
+        connected = false;
+        esp_websocket_client_close(client, pdMS_TO_TICKS(NETWORK_TIMEOUT_MS));
+        esp_websocket_client_start(client);
+        return;
+    }
+
+    if ((now - last_ping) >= pdMS_TO_TICKS(PING_INTERVAL_MS)) {
+        if (esp_websocket_client_send_text(client, PING_MESSAGE, sizeof(PING_MESSAGE) - 1,
+                                           pdMS_TO_TICKS(NETWORK_TIMEOUT_MS)) >= 0) {
+            pong_pending = true;
+        }
+        last_ping = now;
+    }
+}
+
+void SpotifyDealerClient::event_handler(void* handler_args, esp_event_base_t base, int32_t event_id, void* event_data) {
+    SpotifyDealerClient* dealer = static_cast<SpotifyDealerClient*>(handler_args);
+    esp_websocket_event_data_t* data = static_cast<esp_websocket_event_data_t*>(event_data);
+
+    switch (event_id) {
+        case WEBSOCKET_EVENT_CONNECTED:
+            ESP_LOGI(TAG, "Connected to dealer");
+            dealer->last_ping = xTaskGetTickCount();
+            dealer->pong_pending = false;
+            dealer->connected = true;
+            break;
+        case WEBSOCKET_EVENT_DISCONNECTED:
+        case WEBSOCKET_EVENT_CLOSED:
+            ESP_LOGW(TAG, "Disconnected from dealer");
+            dealer->connected = false;
+            break;
+        case WEBSOCKET_EVENT_DATA:
+            dealer->on_data(data);
+            break;
+        case WEBSOCKET_EVENT_ERROR:
+            ESP_LOGW(TAG, "Dealer websocket error");
+            break;
+        default:
+            break;
+    }
+}
+
+// Frames can arrive in several chunks (payload_offset) and messages in
+// several frames (continuations); process once the last byte is in
+void SpotifyDealerClient::on_data(const esp_websocket_event_data_t* data) {
+    if (data->op_code != WS_OPCODE_TEXT && data->op_code != WS_OPCODE_CONTINUATION) {
+        return;
+    }
+    if (data->op_code == WS_OPCODE_TEXT && data->payload_offset == 0) {
+        message.clear();
+        message_too_large = false;
+    }
+
+    if (!message_too_large && data->data_len > 0) {
+        if (message.size() + data->data_len > MAX_MESSAGE_LEN) {
+            ESP_LOGW(TAG, "Dealer message over %d bytes, skipped", (int)MAX_MESSAGE_LEN);
+            message_too_large = true;
+            message.clear();
+        } else {
+            message.append(data->data_ptr, data->data_len);
+        }
+    }
+
+    bool frame_done = data->payload_offset + data->data_len >= data->payload_len;
+    if (frame_done && data->fin) {
+        if (!message_too_large) {
+            on_message(message.c_str());
+        }
+        message.clear();
+        message_too_large = false;
+    }
+}
+
+void SpotifyDealerClient::on_message(const char* text) {
+    mem_tag::MessageScope scope(MEM_TAG_SPOTIFY, &message_arena);
+    cJSON* json = cJSON_Parse(text);
+    if (!json) {
+        ESP_LOGW(TAG, "Malformed dealer message");
+        return;
+    }
+
+    const char* type = cJSON_GetStringValue(cJSON_GetObjectItem(json, "type"));
+    if (type && strcmp(type, "pong") == 0) {
+        pong_pending = false;
+        cJSON_Delete(json);
+        return;
+    }
+    if (!type || strcmp(type, "message") != 0) {
+        cJSON_Delete(json);
+        return;
+    }
+
+    // First message of every connection carries the id to subscribe with
+    cJSON* headers = cJSON_GetObjectItem(json, "headers");
+    const char* id = cJSON_GetStringValue(cJSON_GetObjectItem(headers, "Spotify-Connection-Id"));
+    if (id) {
+        ESP_LOGI(TAG, "Dealer connection established");
+        xSemaphoreTake(mailbox_lock, portMAX_DELAY);
+        connection_id = id;
+        connection_id_pending = true;
+        xSemaphoreGive(mailbox_lock);
+    }
+
+    // Player events: payloads[].events[] of type PLAYER_STATE_CHANGED, each
+    // with the same state object /me/player returns. The last one wins.
+    cJSON* latest_state = nullptr;
+    cJSON* payload;
+    cJSON_ArrayForEach(payload, cJSON_GetObjectItem(json, "payloads")) {
+        cJSON* event;
+        cJSON_ArrayForEach(event, cJSON_GetObjectItem(payload, "events")) {
+            const char* event_type = cJSON_GetStringValue(cJSON_GetObjectItem(event, "type"));
+            cJSON* state = cJSON_GetObjectItem(cJSON_GetObjectItem(event, "event"), "state");
+            if (event_type && strcmp(event_type, "PLAYER_STATE_CHANGED") == 0 && cJSON_IsObject(state)) {
+                latest_state = state;
+            }
+        }
+    }
+
+    if (latest_state) {
+        char* state_json = cJSON_PrintUnformatted(latest_state);
+        if (state_json) {
+            xSemaphoreTake(mailbox_lock, portMAX_DELAY);
+            player_state = state_json;
+            player_state_pending = true;
+            xSemaphoreGive(mailbox_lock);
+            cJSON_free(state_json);
+        }
+    }
+    cJSON_Delete(json);
+}
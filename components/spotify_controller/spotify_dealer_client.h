@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_event.h"
+#include "esp_websocket_client.h"
+#include "mem_tag.hpp"
+#include "task_plan.h"
+
+/**
+ * SpotifyDealerClient - Spotify Connect state events over the dealer websocket
+ *
+ * Features:
+ * - Connects to wss://dealer.spotify.com with the Web API access token and
+ *   reconnects on its own when the socket drops
+ * - Reports the Spotify-Connection-Id of each new connection, which has to
+ *   be registered with the Web API before any player events are pushed
+ * - Keeps only the latest PLAYER_STATE_CHANGED state; bursts of events
+ *   collapse into one update for the worker
+ * - JSON ping every PING_INTERVAL_MS; a missing pong drops the connection
+ *
+ * The websocket task only fills the mailbox; the Spotify worker polls it
+ * with take_connection_id() / take_player_state() and run_periodic_tasks().
+ *
+ * Typical use:
+ *   dealer.start(access_token);
+ *   if (dealer.take_connection_id(id)) api.subscribe_player_notifications(id);
+ *   if (dealer.take_player_state(json)) api.apply_pushed_playback_state(json);
+ */
+class SpotifyDealerClient {
+public:
+    static constexpr const char* DEALER_URL = "wss://dealer.spotify.com/";
+    static constexpr uint32_t PING_INTERVAL_MS = 30000;
+    static constexpr uint32_t PONG_TIMEOUT_MS = 10000;
+    static constexpr int RECONNECT_TIMEOUT_MS = 10000;
+    static constexpr int NETWORK_TIMEOUT_MS = 10000;
+    static constexpr int BUFFER_SIZE = 2048;
+    static constexpr int TASK_STACK_SIZE = 6144;
+    static constexpr int TASK_PRIORITY = TASK_PLAN_SPOTIFY_DEALER_PRIORITY;
+    static constexpr size_t MAX_MESSAGE_LEN = 32768;     // Larger messages are skipped
+
+    SpotifyDealerClient();
+    ~SpotifyDealerClient();
+
+    bool start(const std::string& access_token);
+    void stop();
+
+    // Token for the next (re)connect; the open connection is left alone
+    void set_access_token(const std::string& access_token);
+
+    // Socket open (says nothing about the subscription)
+    bool is_connected() const { return connected; }
+
+    // Connection that needs registering, once per (re)connect
+    bool take_connection_id(std::string& connection_id);
+
+    // Latest pushed player state as /me/player JSON, if a new one arrived
+    bool take_player_state(std::string& state_json);
+
+    // Worker: send the keep-alive ping and check the last one was answered
+    void run_periodic_tasks();
+
+private:
+    esp_websocket_client_handle_t client;
+    SemaphoreHandle_t mailbox_lock;
+    std::atomic<bool> connected;
+    std::atomic<bool> pong_pending;
+    TickType_t last_ping;
+
+    // Mailbox: written by the websocket task, read by the worker
+    std::string connection_id;
+    bool connection_id_pending;
+    std::string player_state;
+    bool player_state_pending;
+
+    // Reassembly of fragmented messages, and the arena each is parsed in
+    // (websocket task only)
+    mem_tag::string<MEM_TAG_SPOTIFY> message;
+    bool message_too_large;
+    mem_arena_t message_arena;
+
+    static std::string build_uri(const std::string& access_token);
+    static void event_handler(void* handler_args, esp_event_base_t base, int32_t event_id, void* event_data);
+    void on_data(const esp_websocket_event_data_t* data);
+    void on_message(const char* text);
+};
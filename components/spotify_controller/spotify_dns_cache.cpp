@@ -0,0 +1,328 @@
+#include "spotify_dns_cache.h"
+#include <cstring>
+#include <sys/time.h>
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_random.h"
+#include "lwip/api.h"
+#include "lwip/ip_addr.h"
+#include "lwip/sockets.h"
+
+static const char *TAG = "spotify_dns";
+
+static constexpr size_t DNS_HEADER_LEN = 12;
+static constexpr uint16_t DNS_PORT = 53;
+static constexpr uint16_t DNS_TYPE_A = 1;
+static constexpr uint16_t DNS_CLASS_IN = 1;
+static constexpr uint16_t DNS_FLAG_RESPONSE = 0x8000;
+static constexpr uint16_t DNS_FLAG_TRUNCATED = 0x0200;
+static constexpr uint16_t DNS_FLAG_RECURSION = 0x0100;
+static constexpr uint16_t DNS_RCODE_MASK = 0x000f;
+
+static uint16_t read_u16(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t read_u32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static bool ticks_before(TickType_t a, TickType_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+SpotifyDnsCache& SpotifyDnsCache::shared() {
+    static SpotifyDnsCache cache;
+    return cache;
+}
+
+SpotifyDnsCache::SpotifyDnsCache()
+    : entries{}
+    , lock(xSemaphoreCreateMutex()) {
+}
+
+SpotifyDnsCache::Entry* SpotifyDnsCache::find(const char* host) {
+    for (Entry& entry : entries) {
+        if (entry.host[0] != '\0' && strcmp(entry.host, host) == 0) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+void SpotifyDnsCache::watch(const char* host) {
+    if (!host || !lock || strlen(host) >= MAX_HOST_LEN) {
+        return;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (!find(host)) {
+        Entry* slot = &entries[0];
+        for (Entry& entry : entries) {
+            if (entry.host[0] == '\0') {
+                slot = &entry;
+                break;
+            }
+            if (ticks_before(entry.watched_at, slot->watched_at)) {
+                slot = &entry;
+            }
+        }
+        memset(slot, 0, sizeof(*slot));
+        strcpy(slot->host, host);
+        slot->watched_at = xTaskGetTickCount();
+    }
+    xSemaphoreGive(lock);
+}
+
+bool SpotifyDnsCache::lookup(const char* host, uint32_t* addr) {
+    if (!host || !lock) {
+        return false;
+    }
+
+    bool found = false;
+    TickType_t now = xTaskGetTickCount();
+    xSemaphoreTake(lock, portMAX_DELAY);
+    Entry* entry = find(host);
+    if (entry) {
+        entry->last_lookup = now;
+        if (entry->resolved && ticks_before(now, entry->expires)) {
+            *addr = entry->addr;
+            found = true;
+        }
+    }
+    xSemaphoreGive(lock);
+    return found;
+}
+
+bool SpotifyDnsCache::needs_refresh(const char* host, bool* usable) {
+    TickType_t now = xTaskGetTickCount();
+    TickType_t soon = now + pdMS_TO_TICKS(REFRESH_AHEAD_S * 1000);
+    xSemaphoreTake(lock, portMAX_DELAY);
+    Entry* entry = find(host);
+    *usable = entry && entry->resolved && ticks_before(now, entry->expires);
+    bool stale = entry && (!entry->resolved || ticks_before(entry->expires, soon)) &&
+                 !ticks_before(now, entry->retry_at);
+    xSemaphoreGive(lock);
+    return stale;
+}
+
+bool SpotifyDnsCache::refresh(const char* host) {
+    if (!host || !lock) {
+        return false;
+    }
+    bool usable = false;
+    if (!needs_refresh(host, &usable)) {
+        return usable;
+    }
+
+    // No lock held over the network; two tasks racing here both just query
+    uint32_t addr = 0;
+    uint32_t ttl_s = 0;
+    if (!query(host, &addr, &ttl_s)) {
+        // Offline or a silent server: the worker must not wait on it every pass
+        xSemaphoreTake(lock, portMAX_DELAY);
+        Entry* entry = find(host);
+        if (entry) {
+            entry->retry_at = xTaskGetTickCount() + pdMS_TO_TICKS(RETRY_S * 1000);
+        }
+        xSemaphoreGive(lock);
+        ESP_LOGD(TAG, "No answer for %s, leaving it to lwIP", host);
+        return usable;
+    }
+    ttl_s = ttl_s < MIN_TTL_S ? MIN_TTL_S : (ttl_s > MAX_TTL_S ? MAX_TTL_S : ttl_s);
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    Entry* entry = find(host);
+    if (entry) {
+        entry->addr = addr;
+        entry->expires = xTaskGetTickCount() + pdMS_TO_TICKS(ttl_s * 1000);
+        entry->resolved = true;
+    }
+    xSemaphoreGive(lock);
+
+    ESP_LOGD(TAG, "%s cached for %u s", host, (unsigned)ttl_s);
+    return entry != nullptr;
+}
+
+void SpotifyDnsCache::refresh_expiring(bool all) {
+    if (!lock) {
+        return;
+    }
+
+    char hosts[MAX_HOSTS][MAX_HOST_LEN];
+    size_t count = 0;
+    TickType_t now = xTaskGetTickCount();
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (const Entry& entry : entries) {
+        if (entry.host[0] != '\0' &&
+            (all || (now - entry.last_lookup) <= pdMS_TO_TICKS(ACTIVE_WINDOW_S * 1000))) {
+            strcpy(hosts[count++], entry.host);
+        }
+    }
+    xSemaphoreGive(lock);
+
+    for (size_t i = 0; i < count; i++) {
+        refresh(hosts[i]);
+    }
+}
+
+size_t SpotifyDnsCache::build_query(const char* host, uint16_t id, uint8_t* packet) {
+    // Header: ID, recursion desired, one question
+    memset(packet, 0, DNS_HEADER_LEN);
+    packet[0] = id >> 8;
+    packet[1] = id & 0xff;
+    packet[2] = DNS_FLAG_RECURSION >> 8;
+    packet[5] = 1;
+
+    // QNAME as length-prefixed labels
+    size_t pos = DNS_HEADER_LEN;
+    const char* label = host;
+    while (*label) {
+        const char* dot = strchr(label, '.');
+        size_t length = dot ? (size_t)(dot - label) : strlen(label);
+        if (length == 0 || length > 63) {
+            return 0;
+        }
+        packet[pos++] = (uint8_t)length;
+        memcpy(packet + pos, label, length);
+        pos += length;
+        label += length + (dot ? 1 : 0);
+    }
+    packet[pos++] = 0;
+
+    packet[pos++] = 0;
+    packet[pos++] = DNS_TYPE_A;
+    packet[pos++] = 0;
+    packet[pos++] = DNS_CLASS_IN;
+    return pos;
+}
+
+// Step over a (possibly compressed) name
+static bool skip_name(const uint8_t* packet, size_t length, size_t* pos) {
+    while (*pos < length) {
+        uint8_t label = packet[*pos];
+        if ((label & 0xc0) == 0xc0) {
+            *pos += 2;
+            return *pos <= length;
+        }
+        if (label & 0xc0) {
+            return false;
+        }
+        *pos += 1 + label;
+        if (label == 0) {
+            return *pos <= length;
+        }
+    }
+    return false;
+}
+
+bool SpotifyDnsCache::parse_response(const uint8_t* packet, size_t length, uint16_t id,
+                                     uint32_t* addr, uint32_t* ttl_s) {
+    if (length < DNS_HEADER_LEN || read_u16(packet) != id) {
+        return false;
+    }
+    uint16_t flags = read_u16(packet + 2);
+    if (!(flags & DNS_FLAG_RESPONSE) || (flags & DNS_FLAG_TRUNCATED) || (flags & DNS_RCODE_MASK) != 0) {
+        return false;
+    }
+
+    size_t pos = DNS_HEADER_LEN;
+    for (uint16_t questions = read_u16(packet + 4); questions > 0; questions--) {
+        if (!skip_name(packet, length, &pos) || pos + 4 > length) {
+            return false;
+        }
+        pos += 4;
+    }
+
+    // Answers run down the CNAME chain to the A record; the record lasts as
+    // long as the shortest-lived link
+    uint32_t ttl = UINT32_MAX;
+    for (uint16_t answers = read_u16(packet + 6); answers > 0; answers--) {
+        if (!skip_name(packet, length, &pos) || pos + 10 > length) {
+            return false;
+        }
+        uint16_t type = read_u16(packet + pos);
+        uint16_t rclass = read_u16(packet + pos + 2);
+        uint32_t record_ttl = read_u32(packet + pos + 4);
+        uint16_t rdlength = read_u16(packet + pos + 8);
+        pos += 10;
+        if (pos + rdlength > length) {
+            return false;
+        }
+        if (record_ttl < ttl) {
+            ttl = record_ttl;
+        }
+        if (type == DNS_TYPE_A && rclass == DNS_CLASS_IN && rdlength == 4) {
+            memcpy(addr, packet + pos, 4);
+            *ttl_s = ttl;
+            return true;
+        }
+        pos += rdlength;
+    }
+    return false;
+}
+
+bool SpotifyDnsCache::query(const char* host, uint32_t* addr, uint32_t* ttl_s) {
+    esp_netif_t* netif = esp_netif_get_default_netif();
+    esp_netif_dns_info_t dns = {};
+    if (!netif || esp_netif_get_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns) != ESP_OK ||
+        dns.ip.type != ESP_IPADDR_TYPE_V4 || dns.ip.u_addr.ip4.addr == 0) {
+        return false;
+    }
+
+    uint8_t packet[MAX_PACKET_LEN];
+    uint16_t id = (uint16_t)esp_random();
+    size_t query_length = build_query(host, id, packet);
+    if (query_length == 0) {
+        return false;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        return false;
+    }
+    struct timeval timeout = { QUERY_TIMEOUT_MS / 1000, (QUERY_TIMEOUT_MS % 1000) * 1000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // Connected, so only the server's datagrams arrive
+    struct sockaddr_in server = {};
+    server.sin_family = AF_INET;
+    server.sin_port = htons(DNS_PORT);
+    server.sin_addr.s_addr = dns.ip.u_addr.ip4.addr;
+
+    bool ok = false;
+    if (connect(sock, (struct sockaddr*)&server, sizeof(server)) == 0 &&
+        send(sock, packet, query_length, 0) == (ssize_t)query_length) {
+        // A late answer to an earlier query is skipped by its ID
+        for (int attempt = 0; attempt < 2 && !ok; attempt++) {
+            ssize_t received = recv(sock, packet, sizeof(packet), 0);
+            if (received <= 0) {
+                break;
+            }
+            ok = parse_response(packet, (size_t)received, id, addr, ttl_s);
+        }
+    }
+    close(sock);
+    return ok;
+}
+
+#ifdef CONFIG_LWIP_HOOK_NETCONN_EXT_RESOLVE_CUSTOM
+// Called by netconn_gethostbyname() (so getaddrinfo()) on the resolving
+// task; returning 0 lets lwIP resolve the name itself
+extern "C" int lwip_hook_netconn_external_resolve(const char* name, ip_addr_t* addr, u8_t addrtype, err_t* err) {
+#if LWIP_IPV6
+    if (addrtype == NETCONN_DNS_IPV6 || addrtype == NETCONN_DNS_IPV6_IPV4) {
+        return 0;
+    }
+#endif
+
+    SpotifyDnsCache& cache = SpotifyDnsCache::shared();
+    uint32_t value = 0;
+    if (!cache.lookup(name, &value) && !(cache.refresh(name) && cache.lookup(name, &value))) {
+        return 0;
+    }
+    ip_addr_set_ip4_u32(addr, value);
+    *err = ERR_OK;
+    return 1;
+}
+#endif
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+/**
+ * SpotifyDnsCache - TTL-aware address cache for the hosts we talk to
+ *
+ * Features:
+ * - Every host the HTTP pool or the HTTP/2 client connects to is watched;
+ *   lwIP asks the cache first (netconn external resolve hook), so a new
+ *   connection to a cached host starts straight with its TCP handshake
+ * - Records are resolved with a query of our own to the interface's DNS
+ *   server, so the answer's TTL is known (the lowest along a CNAME chain)
+ *   and kept, clamped to MIN_TTL_S..MAX_TTL_S; lwIP's own four-entry table
+ *   hides it and is shared with everything else on the device
+ * - refresh_expiring() re-resolves hosts in use shortly before their records
+ *   expire, on the calling (worker) task's time instead of a command's
+ * - A host that is not watched, an IPv6 lookup and a failed query all go to
+ *   lwIP's resolver as before
+ *
+ * The hook needs CONFIG_LWIP_HOOK_NETCONN_EXT_RESOLVE_CUSTOM; without it the
+ * cache is only filled and lwIP resolves every connection itself.
+ *
+ * Typical use:
+ *   SpotifyDnsCache::shared().watch("api.spotify.com");
+ *   SpotifyDnsCache::shared().refresh_expiring(true);   // A command is likely soon
+ */
+class SpotifyDnsCache {
+public:
+    static constexpr size_t MAX_HOSTS = 4;
+    static constexpr size_t MAX_HOST_LEN = 32;
+    static constexpr uint32_t MIN_TTL_S = 30;
+    static constexpr uint32_t MAX_TTL_S = 3600;
+    static constexpr uint32_t REFRESH_AHEAD_S = 20;     // Re-resolve this close to expiry
+    static constexpr uint32_t ACTIVE_WINDOW_S = 600;    // Looked up this recently: kept fresh
+    static constexpr int QUERY_TIMEOUT_MS = 2000;
+    static constexpr uint32_t RETRY_S = 30;             // Back off after a query failed
+    static constexpr size_t MAX_PACKET_LEN = 512;       // Plain UDP DNS
+
+    static SpotifyDnsCache& shared();
+
+    // Cache the host's address from now on (the oldest host makes room)
+    void watch(const char* host);
+
+    /**
+     * Address of a watched host whose record has not expired, in network
+     * byte order. Counts as a use for refresh_expiring().
+     */
+    bool lookup(const char* host, uint32_t* addr);
+
+    /**
+     * Resolve a watched host unless its record lasts another REFRESH_AHEAD_S.
+     * @return true if the host has a usable record afterwards
+     */
+    bool refresh(const char* host);
+
+    // refresh() the hosts looked up within ACTIVE_WINDOW_S, or every host
+    void refresh_expiring(bool all);
+
+private:
+    struct Entry {
+        char host[MAX_HOST_LEN];
+        uint32_t addr;
+        TickType_t expires;         // Valid while resolved
+        TickType_t last_lookup;
+        TickType_t watched_at;
+        TickType_t retry_at;        // After a failed query
+        bool resolved;
+    };
+
+    Entry entries[MAX_HOSTS];
+    SemaphoreHandle_t lock;
+
+    SpotifyDnsCache();
+    SpotifyDnsCache(const SpotifyDnsCache&) = delete;
+    SpotifyDnsCache& operator=(const SpotifyDnsCache&) = delete;
+
+    Entry* find(const char* host);
+    bool needs_refresh(const char* host, bool* usable);
+
+    static bool query(const char* host, uint32_t* addr, uint32_t* ttl_s);
+    static size_t build_query(const char* host, uint16_t id, uint8_t* packet);
+    static bool parse_response(const uint8_t* packet, size_t length, uint16_t id,
+                               uint32_t* addr, uint32_t* ttl_s);
+};
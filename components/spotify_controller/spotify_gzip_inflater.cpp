@@ -0,0 +1,226 @@
+#include "spotify_gzip_inflater.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+static const char *TAG = "spotify_gzip";
+
+// RFC 1952 header flags
+static constexpr uint8_t FLAG_HCRC = 0x02;
+static constexpr uint8_t FLAG_EXTRA = 0x04;
+static constexpr uint8_t FLAG_NAME = 0x08;
+static constexpr uint8_t FLAG_COMMENT = 0x10;
+static constexpr size_t FIXED_HEADER_LEN = 10;
+
+SpotifyGzipInflater::SpotifyGzipInflater()
+    : decompressor(nullptr)
+    , window(nullptr) {
+    reset();
+}
+
+SpotifyGzipInflater::~SpotifyGzipInflater() {
+    release();
+}
+
+void SpotifyGzipInflater::reset() {
+    window_pos = 0;
+    state = State::HEADER;
+    header_step = HeaderStep::FIXED;
+    flags = 0;
+    step_pos = 0;
+    extra_len = 0;
+    inflated = 0;
+    consumed = 0;
+    if (decompressor) {
+        tinfl_init(decompressor);
+    }
+}
+
+void SpotifyGzipInflater::release() {
+    heap_caps_free(decompressor);
+    heap_caps_free(window);
+    decompressor = nullptr;
+    window = nullptr;
+}
+
+bool SpotifyGzipInflater::allocate() {
+    if (decompressor && window) {
+        return true;
+    }
+    if (!decompressor) {
+        decompressor = static_cast<tinfl_decompressor*>(
+            heap_caps_malloc(sizeof(tinfl_decompressor), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    }
+    if (!window) {
+        window = static_cast<uint8_t*>(heap_caps_malloc(WINDOW_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    }
+    if (!decompressor || !window) {
+        ESP_LOGE(TAG, "No memory for the inflate window");
+        release();
+        return false;
+    }
+    tinfl_init(decompressor);
+    return true;
+}
+
+bool SpotifyGzipInflater::feed(const char* data, size_t length, const DataCallback& on_data) {
+    if (state == State::FAILED) {
+        return false;
+    }
+    if (state == State::HEADER && consumed == 0 && !allocate()) {
+        state = State::FAILED;
+        return false;
+    }
+    consumed += length;
+
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(data);
+    while (length > 0 && state != State::FAILED && state != State::DONE) {
+        size_t used = 0;
+        switch (state) {
+            case State::HEADER:
+                used = parse_header(in, length);
+                break;
+            case State::BODY:
+                used = inflate(in, length, on_data);
+                break;
+            case State::TRAILER:
+                used = parse_trailer(in, length);
+                break;
+            default:
+                break;
+        }
+        in += used;
+        length -= used;
+    }
+    // Bytes after the trailer (a second member) are not expected from a server
+    return state != State::FAILED;
+}
+
+size_t SpotifyGzipInflater::parse_header(const uint8_t* data, size_t length) {
+    size_t pos = 0;
+    while (pos < length && state == State::HEADER) {
+        uint8_t byte = data[pos++];
+        switch (header_step) {
+            case HeaderStep::FIXED:
+                // ID1 ID2 CM FLG MTIME(4) XFL OS
+                if ((step_pos == 0 && byte != 0x1f) || (step_pos == 1 && byte != 0x8b) ||
+                    (step_pos == 2 && byte != 8)) {
+                    ESP_LOGW(TAG, "Body is not gzip");
+                    state = State::FAILED;
+                    return pos;
+                }
+                if (step_pos == 3) {
+                    flags = byte;
+                }
+                if (++step_pos < FIXED_HEADER_LEN) {
+                    continue;
+                }
+                step_pos = 0;
+                header_step = HeaderStep::EXTRA_LEN;
+                break;
+            case HeaderStep::EXTRA_LEN:
+                extra_len |= (size_t)byte << (8 * step_pos);
+                if (++step_pos < 2) {
+                    continue;
+                }
+                step_pos = 0;
+                header_step = HeaderStep::EXTRA;
+                break;
+            case HeaderStep::EXTRA:
+                if (++step_pos < extra_len) {
+                    continue;
+                }
+                step_pos = 0;
+                header_step = HeaderStep::NAME;
+                break;
+            case HeaderStep::NAME:
+                if (byte != 0) {
+                    continue;
+                }
+                header_step = HeaderStep::COMMENT;
+                break;
+            case HeaderStep::COMMENT:
+                if (byte != 0) {
+                    continue;
+                }
+                header_step = HeaderStep::HCRC;
+                break;
+            case HeaderStep::HCRC:
+                if (++step_pos < 2) {
+                    continue;
+                }
+                step_pos = 0;
+                state = State::BODY;
+                break;
+        }
+
+        // Skip the optional fields the flags leave out; each step above
+        // consumes a byte, so stop at the first one that is present
+        while (state == State::HEADER) {
+            if (header_step == HeaderStep::EXTRA_LEN && !(flags & FLAG_EXTRA)) {
+                header_step = HeaderStep::NAME;
+            } else if (header_step == HeaderStep::EXTRA && extra_len == 0) {
+                header_step = HeaderStep::NAME;
+            } else if (header_step == HeaderStep::NAME && !(flags & FLAG_NAME)) {
+                header_step = HeaderStep::COMMENT;
+            } else if (header_step == HeaderStep::COMMENT && !(flags & FLAG_COMMENT)) {
+                header_step = HeaderStep::HCRC;
+            } else if (header_step == HeaderStep::HCRC && !(flags & FLAG_HCRC)) {
+                state = State::BODY;
+            } else {
+                break;
+            }
+        }
+    }
+    return pos;
+}
+
+size_t SpotifyGzipInflater::inflate(const uint8_t* data, size_t length, const DataCallback& on_data) {
+    size_t used = 0;
+    for (;;) {
+        size_t in_bytes = length - used;
+        size_t out_bytes = WINDOW_SIZE - window_pos;
+        tinfl_status status = tinfl_decompress(decompressor, data + used, &in_bytes, window, window + window_pos,
+                                               &out_bytes, TINFL_FLAG_HAS_MORE_INPUT);
+        used += in_bytes;
+        if (out_bytes > 0) {
+            on_data(reinterpret_cast<const char*>(window + window_pos), out_bytes);
+            inflated += out_bytes;
+            // The window wraps: tinfl refers back into it for matches
+            window_pos = (window_pos + out_bytes) & (WINDOW_SIZE - 1);
+        }
+
+        if (status == TINFL_STATUS_DONE) {
+            state = State::TRAILER;
+            step_pos = 0;
+            return used;
+        }
+        if (status < 0) {
+            ESP_LOGW(TAG, "Corrupt deflate stream (%d)", (int)status);
+            state = State::FAILED;
+            return used;
+        }
+        if (status == TINFL_STATUS_NEEDS_MORE_INPUT && used == length) {
+            return used;
+        }
+    }
+}
+
+size_t SpotifyGzipInflater::parse_trailer(const uint8_t* data, size_t length) {
+    size_t pos = 0;
+    while (pos < length && step_pos < sizeof(trailer)) {
+        trailer[step_pos++] = data[pos++];
+    }
+    if (step_pos < sizeof(trailer)) {
+        return pos;
+    }
+
+    // CRC32 (unchecked), then ISIZE, both little endian
+    uint32_t size = trailer[4] | (trailer[5] << 8) | (trailer[6] << 16) | ((uint32_t)trailer[7] << 24);
+    if (size != inflated) {
+        ESP_LOGW(TAG, "Inflated %u bytes, trailer says %u", (unsigned)inflated, (unsigned)size);
+        state = State::FAILED;
+        return pos;
+    }
+    state = State::DONE;
+    return length;
+}
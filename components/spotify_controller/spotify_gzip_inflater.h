@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include "rom/miniz.h"
+
+/**
+ * SpotifyGzipInflater - Streaming decoder for gzip response bodies
+ *
+ * Features:
+ * - Content-Encoding: gzip bodies are inflated chunk by chunk as they
+ *   arrive, with the ROM's tinfl, and passed on in pieces of at most
+ *   WINDOW_SIZE bytes; neither the compressed nor the inflated body is ever
+ *   held whole
+ * - Memory is the 32 KB deflate window and the decompressor state, in PSRAM,
+ *   allocated on first use and kept for the next response until release()
+ * - The gzip header (FEXTRA, FNAME, FCOMMENT, FHCRC) may be split across
+ *   chunks; the trailer's length is checked (TLS already guards the bytes,
+ *   so the CRC is not)
+ *
+ * Typical use:
+ *   inflater.reset();
+ *   for each chunk: inflater.feed(data, length, on_data);
+ *   if (inflater.failed() || inflater.truncated()) { discard the body }
+ */
+class SpotifyGzipInflater {
+public:
+    using DataCallback = std::function<void(const char* data, size_t length)>;
+
+    static constexpr size_t WINDOW_SIZE = TINFL_LZ_DICT_SIZE;
+
+    SpotifyGzipInflater();
+    ~SpotifyGzipInflater();
+
+    SpotifyGzipInflater(const SpotifyGzipInflater&) = delete;
+    SpotifyGzipInflater& operator=(const SpotifyGzipInflater&) = delete;
+
+    // Start a new body
+    void reset();
+
+    /**
+     * Inflate the next chunk of the compressed body into on_data.
+     * @return false once the body is malformed (or out of memory); later
+     *         chunks are then ignored
+     */
+    bool feed(const char* data, size_t length, const DataCallback& on_data);
+
+    bool failed() const { return state == State::FAILED; }
+    // Some of a body was fed, but it ended before the gzip trailer
+    bool truncated() const { return state != State::DONE && state != State::FAILED && consumed > 0; }
+
+    // Free the window and decompressor until the next feed()
+    void release();
+
+private:
+    enum class State { HEADER, BODY, TRAILER, DONE, FAILED };
+    enum class HeaderStep { FIXED, EXTRA_LEN, EXTRA, NAME, COMMENT, HCRC };
+
+    tinfl_decompressor* decompressor;
+    uint8_t* window;
+    size_t window_pos;
+    State state;
+    HeaderStep header_step;
+    uint8_t flags;
+    size_t step_pos;        // Bytes seen of the current header step or trailer
+    size_t extra_len;
+    uint8_t trailer[8];
+    uint32_t inflated;      // Output length mod 2^32, as the trailer has it
+    size_t consumed;
+
+    bool allocate();
+    size_t parse_header(const uint8_t* data, size_t length);
+    size_t inflate(const uint8_t* data, size_t length, const DataCallback& on_data);
+    size_t parse_trailer(const uint8_t* data, size_t length);
+};
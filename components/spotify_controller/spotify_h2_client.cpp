@@ -0,0 +1,454 @@
+#include "spotify_h2_client.h"
+#include "spotify_dns_cache.h"
+#include "telemetry_hist.h"
+#include "telemetry_ui.h"
+#include "tls_profile.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mbedtls/ssl.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/select.h>
+
+static const char *TAG = "spotify_h2_client";
+
+static const char* ALPN_PROTOS[] = { "h2", nullptr };
+
+SpotifyH2Client::SpotifyH2Client(const char* host)
+    : lock(xSemaphoreCreateMutex())
+    , tls(nullptr)
+    , session(nullptr)
+    , sockfd(-1)
+    , unsupported(false)
+    , goaway(false)
+    , last_used(0)
+    , pending(0) {
+    strncpy(this->host, host, sizeof(this->host) - 1);
+    this->host[sizeof(this->host) - 1] = '\0';
+    SpotifyDnsCache::shared().watch(this->host);
+}
+
+SpotifyH2Client::~SpotifyH2Client() {
+    close_connection();
+    if (lock) {
+        vSemaphoreDelete(lock);
+    }
+}
+
+void SpotifyH2Client::close() {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    close_connection();
+    xSemaphoreGive(lock);
+}
+
+void SpotifyH2Client::close_connection() {
+    if (session) {
+        nghttp2_session_del(session);
+        session = nullptr;
+    }
+    if (tls) {
+        esp_tls_conn_destroy(tls);
+        tls = nullptr;
+    }
+    sockfd = -1;
+}
+
+bool SpotifyH2Client::warm_up() {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (session && (goaway || (xTaskGetTickCount() - last_used) > pdMS_TO_TICKS(IDLE_TIMEOUT_MS))) {
+        close_connection();
+    }
+    bool warm = session != nullptr;
+    if (!warm && !unsupported && connect() == ESP_OK) {
+        // Counts as a use, or perform() would drop it as idle straight away
+        last_used = xTaskGetTickCount();
+        warm = true;
+    }
+    xSemaphoreGive(lock);
+    return warm;
+}
+
+esp_err_t SpotifyH2Client::connect() {
+    esp_tls_cfg_t cfg = {};
+    cfg.alpn_protos = ALPN_PROTOS;
+    cfg.timeout_ms = HTTP_TIMEOUT_MS;
+    tls_profile_apply(&cfg, TLS_PROFILE_WEB);
+    // Reconnects after the idle timeout resume instead of redoing the handshake
+    tls_profile_session_offer(&cfg, host);
+
+    tls = esp_tls_init();
+    if (!tls) {
+        tls_profile_session_finish(&cfg, nullptr, host);
+        return ESP_ERR_NO_MEM;
+    }
+    telemetry_ui_blocking("h2 connect");
+    int64_t connect_start_us = esp_timer_get_time();
+    bool connected = esp_tls_conn_new_sync(host, strlen(host), 443, &cfg, tls) == 1;
+    if (connected) {
+        TELEMETRY_HIST_RECORD("tls spotify", TELEMETRY_HIST_MS,
+                              (uint32_t)((esp_timer_get_time() - connect_start_us) / 1000));
+    }
+    tls_profile_session_finish(&cfg, connected ? tls : nullptr, host);
+    if (!connected) {
+        ESP_LOGW(TAG, "TLS connection to %s failed", host);
+        close_connection();
+        return ESP_FAIL;
+    }
+
+    // Without h2 there is nothing to multiplex; the pool does HTTP/1.1 better
+    mbedtls_ssl_context* ssl = static_cast<mbedtls_ssl_context*>(esp_tls_get_ssl_context(tls));
+    const char* protocol = ssl ? mbedtls_ssl_get_alpn_protocol(ssl) : nullptr;
+    if (!protocol || strcmp(protocol, "h2") != 0) {
+        ESP_LOGW(TAG, "%s did not negotiate h2, using HTTP/1.1", host);
+        unsupported = true;
+        close_connection();
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    if (esp_tls_get_conn_sockfd(tls, &sockfd) != ESP_OK ||
+        fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL, 0) | O_NONBLOCK) != 0) {
+        close_connection();
+        return ESP_FAIL;
+    }
+
+    nghttp2_session_callbacks* callbacks;
+    if (nghttp2_session_callbacks_new(&callbacks) != 0) {
+        close_connection();
+        return ESP_ERR_NO_MEM;
+    }
+    nghttp2_session_callbacks_set_send_callback(callbacks, send_callback);
+    nghttp2_session_callbacks_set_recv_callback(callbacks, recv_callback);
+    nghttp2_session_callbacks_set_on_header_callback(callbacks, on_header_callback);
+    nghttp2_session_callbacks_set_on_data_chunk_recv_callback(callbacks, on_data_chunk_recv_callback);
+    nghttp2_session_callbacks_set_on_stream_close_callback(callbacks, on_stream_close_callback);
+    nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks, on_frame_recv_callback);
+    int rv = nghttp2_session_client_new(&session, callbacks, this);
+    nghttp2_session_callbacks_del(callbacks);
+    if (rv != 0) {
+        session = nullptr;
+        close_connection();
+        return ESP_ERR_NO_MEM;
+    }
+
+    const nghttp2_settings_entry settings[] = {
+        { NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS, MAX_STREAMS },
+        { NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, STREAM_WINDOW_SIZE },
+        { NGHTTP2_SETTINGS_ENABLE_PUSH, 0 },
+    };
+    nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, settings, sizeof(settings) / sizeof(settings[0]));
+
+    goaway = false;
+    ESP_LOGI(TAG, "HTTP/2 connection to %s open", host);
+    return ESP_OK;
+}
+
+bool SpotifyH2Client::submit(Exchange& exchange) {
+    nghttp2_nv nva[4 + MAX_HEADERS + 1];
+    size_t count = 0;
+    auto add = [&](const char* name, const char* value) {
+        nva[count++] = { (uint8_t*)name, (uint8_t*)value, strlen(name), strlen(value), NGHTTP2_NV_FLAG_NONE };
+    };
+
+    add(":method", exchange.method);
+    add(":scheme", "https");
+    add(":authority", host);
+    add(":path", exchange.path.c_str());
+    for (size_t i = 0; i < exchange.header_count && i < MAX_HEADERS; i++) {
+        add(exchange.headers[i].name, exchange.headers[i].value);
+    }
+
+    // nghttp2 copies the headers; only the body has to outlive the call
+    std::string content_length;
+    nghttp2_data_provider provider = {};
+    const nghttp2_data_provider* data = nullptr;
+    if (exchange.body) {
+        content_length = std::to_string(exchange.body->length());
+        add("content-length", content_length.c_str());
+        provider.source.ptr = &exchange;
+        provider.read_callback = body_read_callback;
+        data = &provider;
+    }
+
+    exchange.sent_us = esp_timer_get_time();
+    exchange.stream_id = nghttp2_submit_request(session, nullptr, nva, count, data, &exchange);
+    if (exchange.stream_id < 0) {
+        ESP_LOGE(TAG, "Cannot submit %s %s: %s", exchange.method, exchange.path.c_str(),
+                 nghttp2_strerror(exchange.stream_id));
+        return false;
+    }
+    return true;
+}
+
+esp_err_t SpotifyH2Client::run() {
+    while (pending > 0) {
+        if (nghttp2_session_send(session) != 0) {
+            return ESP_FAIL;
+        }
+        bool want_write = nghttp2_session_want_write(session);
+        if (!nghttp2_session_want_read(session) && !want_write) {
+            // The server finished the connection with streams still open
+            return ESP_FAIL;
+        }
+
+        // Records mbedTLS already decrypted do not show up on the socket
+        if (esp_tls_get_bytes_avail(tls) <= 0) {
+            fd_set read_fds;
+            fd_set write_fds;
+            FD_ZERO(&read_fds);
+            FD_ZERO(&write_fds);
+            FD_SET(sockfd, &read_fds);
+            if (want_write) {
+                FD_SET(sockfd, &write_fds);
+            }
+            struct timeval timeout = { HTTP_TIMEOUT_MS / 1000, (HTTP_TIMEOUT_MS % 1000) * 1000 };
+            int ready = select(sockfd + 1, &read_fds, want_write ? &write_fds : nullptr, nullptr, &timeout);
+            if (ready == 0) {
+                ESP_LOGW(TAG, "No data from %s in time", host);
+                return ESP_ERR_TIMEOUT;
+            }
+            if (ready < 0) {
+                return ESP_FAIL;
+            }
+        }
+
+        if (nghttp2_session_recv(session) != 0) {
+            return ESP_FAIL;
+        }
+    }
+
+    // WINDOW_UPDATE and RST_STREAM frames queued by the last reads
+    return nghttp2_session_send(session) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t SpotifyH2Client::perform(Exchange* exchanges, size_t count) {
+    if (count == 0) {
+        return ESP_OK;
+    }
+    if (count > MAX_STREAMS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (unsupported) {
+        xSemaphoreGive(lock);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    if (session && (goaway || (xTaskGetTickCount() - last_used) > pdMS_TO_TICKS(IDLE_TIMEOUT_MS))) {
+        ESP_LOGD(TAG, "Connection to %s idle or going away, reconnecting", host);
+        close_connection();
+    }
+
+    esp_err_t result = ESP_OK;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = session != nullptr;
+        if (!session) {
+            esp_err_t err = connect();
+            if (err != ESP_OK) {
+                if (attempt == 0) {
+                    result = err;
+                }
+                break;
+            }
+        }
+
+        // The retry only resends what got no answer at all
+        pending = 0;
+        for (size_t i = 0; i < count; i++) {
+            Exchange& exchange = exchanges[i];
+            if (attempt > 0 && (exchange.done || exchange.status != 0)) {
+                continue;
+            }
+            exchange.status = 0;
+            exchange.err = ESP_OK;
+            exchange.stream_id = 0;
+            exchange.body_sent = 0;
+            exchange.done = false;
+            exchange.inflater.reset();
+            if (submit(exchange)) {
+                pending++;
+            } else {
+                exchange.done = true;
+                exchange.err = ESP_FAIL;
+            }
+        }
+
+        esp_err_t err = pending > 0 ? run() : ESP_OK;
+        last_used = xTaskGetTickCount();
+        bool refused = goaway;
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "HTTP/2 connection to %s failed: %s", host, esp_err_to_name(err));
+            close_connection();
+        }
+
+        bool unanswered = false;
+        for (size_t i = 0; i < count; i++) {
+            if (!exchanges[i].done && exchanges[i].status == 0) {
+                unanswered = true;
+            }
+        }
+        if (!unanswered || !(reused || refused)) {
+            break;
+        }
+        close_connection();
+    }
+
+    // Streams the connection took down with it
+    for (size_t i = 0; i < count; i++) {
+        if (!exchanges[i].done) {
+            exchanges[i].done = true;
+            exchanges[i].err = ESP_FAIL;
+        }
+    }
+    if (goaway) {
+        close_connection();
+    }
+
+    xSemaphoreGive(lock);
+    return result;
+}
+
+ssize_t SpotifyH2Client::send_callback(nghttp2_session* session, const uint8_t* data, size_t length,
+                                       int flags, void* user_data) {
+    SpotifyH2Client* self = static_cast<SpotifyH2Client*>(user_data);
+    ssize_t written = esp_tls_conn_write(self->tls, data, length);
+    if (written == ESP_TLS_ERR_SSL_WANT_WRITE || written == ESP_TLS_ERR_SSL_WANT_READ) {
+        return NGHTTP2_ERR_WOULDBLOCK;
+    }
+    return written > 0 ? written : NGHTTP2_ERR_CALLBACK_FAILURE;
+}
+
+ssize_t SpotifyH2Client::recv_callback(nghttp2_session* session, uint8_t* buf, size_t length,
+                                       int flags, void* user_data) {
+    SpotifyH2Client* self = static_cast<SpotifyH2Client*>(user_data);
+    ssize_t read = esp_tls_conn_read(self->tls, buf, length);
+    if (read == ESP_TLS_ERR_SSL_WANT_READ || read == ESP_TLS_ERR_SSL_WANT_WRITE) {
+        return NGHTTP2_ERR_WOULDBLOCK;
+    }
+    if (read == 0) {
+        return NGHTTP2_ERR_EOF;
+    }
+    return read > 0 ? read : NGHTTP2_ERR_CALLBACK_FAILURE;
+}
+
+int SpotifyH2Client::on_header_callback(nghttp2_session* session, const nghttp2_frame* frame,
+                                        const uint8_t* name, size_t namelen, const uint8_t* value,
+                                        size_t valuelen, uint8_t flags, void* user_data) {
+    if (frame->hd.type != NGHTTP2_HEADERS) {
+        return 0;
+    }
+    Exchange* exchange = static_cast<Exchange*>(nghttp2_session_get_stream_user_data(session, frame->hd.stream_id));
+    if (!exchange) {
+        return 0;
+    }
+
+    // nghttp2 NUL-terminates both
+    if (namelen == 7 && memcmp(name, ":status", 7) == 0) {
+        exchange->status = atoi(reinterpret_cast<const char*>(value));
+    } else if (namelen == 16 && memcmp(name, "content-encoding", 16) == 0 &&
+               strcasecmp(reinterpret_cast<const char*>(value), "gzip") == 0) {
+        exchange->inflater = std::make_unique<SpotifyGzipInflater>();
+    }
+    if (exchange->on_header && name[0] != ':') {
+        (*exchange->on_header)(reinterpret_cast<const char*>(name), reinterpret_cast<const char*>(value));
+    }
+    return 0;
+}
+
+int SpotifyH2Client::on_data_chunk_recv_callback(nghttp2_session* session, uint8_t flags, int32_t stream_id,
+                                                 const uint8_t* data, size_t len, void* user_data) {
+    Exchange* exchange = static_cast<Exchange*>(nghttp2_session_get_stream_user_data(session, stream_id));
+    if (!exchange || exchange->err != ESP_OK) {
+        return 0;
+    }
+
+    // Only this stream goes; the connection stays up for the others
+    if (exchange->should_abort && (*exchange->should_abort)()) {
+        exchange->err = ESP_ERR_NOT_FINISHED;
+        nghttp2_submit_rst_stream(session, NGHTTP2_FLAG_NONE, stream_id, NGHTTP2_CANCEL);
+        return 0;
+    }
+
+    if (!exchange->inflater) {
+        deliver(*exchange, reinterpret_cast<const char*>(data), len);
+    } else if (!exchange->inflater->feed(reinterpret_cast<const char*>(data), len,
+                                         [exchange](const char* plain, size_t length) {
+                                             deliver(*exchange, plain, length);
+                                         })) {
+        exchange->err = ESP_FAIL;
+        nghttp2_submit_rst_stream(session, NGHTTP2_FLAG_NONE, stream_id, NGHTTP2_CANCEL);
+    }
+    return 0;
+}
+
+void SpotifyH2Client::deliver(Exchange& exchange, const char* data, size_t length) {
+    if (exchange.on_data) {
+        (*exchange.on_data)(data, length);
+    } else if (exchange.body_out) {
+        exchange.body_out->append(data, length);
+    }
+}
+
+int SpotifyH2Client::on_stream_close_callback(nghttp2_session* session, int32_t stream_id,
+                                              uint32_t error_code, void* user_data) {
+    SpotifyH2Client* self = static_cast<SpotifyH2Client*>(user_data);
+    Exchange* exchange = static_cast<Exchange*>(nghttp2_session_get_stream_user_data(session, stream_id));
+    if (!exchange) {
+        return 0;
+    }
+    if (self->pending > 0) {
+        self->pending--;
+    }
+
+    // A stream refused before the server looked at it is left for the retry
+    if (error_code == NGHTTP2_REFUSED_STREAM && exchange->status == 0) {
+        return 0;
+    }
+    exchange->done = true;
+    if (exchange->err == ESP_OK && error_code != NGHTTP2_NO_ERROR) {
+        ESP_LOGW(TAG, "Stream %d reset: %s", (int)stream_id, nghttp2_http2_strerror(error_code));
+        exchange->err = ESP_FAIL;
+    }
+    if (exchange->err == ESP_OK && exchange->status != 0) {
+        // Same histograms as the HTTP/1.1 pool; streams of a batch overlap
+        char endpoint[TELEMETRY_HIST_NAME_MAX];
+        SpotifyHttpPool::endpoint_name(exchange->path.c_str(), endpoint, sizeof(endpoint));
+        telemetry_hist_record(telemetry_hist_get(endpoint, TELEMETRY_HIST_MS),
+                              (uint32_t)((esp_timer_get_time() - exchange->sent_us) / 1000));
+    }
+    if (exchange->inflater) {
+        if (exchange->err == ESP_OK && exchange->inflater->truncated()) {
+            ESP_LOGW(TAG, "Stream %d ended inside its gzip body", (int)stream_id);
+            exchange->err = ESP_FAIL;
+        }
+        exchange->inflater.reset();
+    }
+    return 0;
+}
+
+int SpotifyH2Client::on_frame_recv_callback(nghttp2_session* session, const nghttp2_frame* frame,
+                                            void* user_data) {
+    if (frame->hd.type == NGHTTP2_GOAWAY) {
+        SpotifyH2Client* self = static_cast<SpotifyH2Client*>(user_data);
+        ESP_LOGD(TAG, "GOAWAY from %s", self->host);
+        self->goaway = true;
+    }
+    return 0;
+}
+
+ssize_t SpotifyH2Client::body_read_callback(nghttp2_session* session, int32_t stream_id, uint8_t* buf,
+                                            size_t length, uint32_t* data_flags, nghttp2_data_source* source,
+                                            void* user_data) {
+    Exchange* exchange = static_cast<Exchange*>(source->ptr);
+    size_t left = exchange->body->length() - exchange->body_sent;
+    size_t chunk = std::min(left, length);
+    memcpy(buf, exchange->body->data() + exchange->body_sent, chunk);
+    exchange->body_sent += chunk;
+    if (exchange->body_sent == exchange->body->length()) {
+        *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+    }
+    return chunk;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "esp_tls.h"
+#include "nghttp2/nghttp2.h"
+#include "spotify_http_pool.h"
+#include "spotify_gzip_inflater.h"
+
+/**
+ * SpotifyH2Client - Multiplexed HTTP/2 connection to one API host
+ *
+ * Features:
+ * - One TLS connection (ALPN "h2") carries up to MAX_STREAMS requests at
+ *   once; a batch passed to perform() is sent as concurrent streams and
+ *   the responses are collected as they interleave
+ * - Header compression by nghttp2 (HPACK): the Authorization header and the
+ *   other repeated headers go out as table indexes after the first request
+ * - Per-stream status, headers and body, with the same callbacks as
+ *   SpotifyHttpPool, so the API client treats both transports alike
+ * - A content-encoding: gzip body (ask with accept-encoding: gzip) is
+ *   inflated as it arrives, with a window of its own per stream
+ * - An aborted stream is reset on its own (RST_STREAM); the connection and
+ *   the other streams carry on
+ * - Connections left idle longer than IDLE_TIMEOUT_MS, or closed by the
+ *   server (GOAWAY), are reopened on the next perform()
+ * - A server that does not negotiate h2 marks the client unavailable, so the
+ *   caller falls back to HTTP/1.1 for good
+ *
+ * One perform() at a time; callbacks run on the calling task.
+ *
+ * Typical use:
+ *   SpotifyH2Client::Exchange exchange = {};
+ *   exchange.method = "GET"; exchange.path = "/v1/me/player"; exchange.body_out = &body;
+ *   if (h2.perform(&exchange, 1) == ESP_OK && exchange.err == ESP_OK) { use exchange.status }
+ */
+class SpotifyH2Client {
+public:
+    using DataCallback = SpotifyHttpPool::DataCallback;
+    using HeaderCallback = SpotifyHttpPool::HeaderCallback;
+    using AbortCallback = SpotifyHttpPool::AbortCallback;
+
+    static constexpr size_t MAX_STREAMS = 8;            // Per perform(), and advertised to the server
+    static constexpr size_t MAX_HEADERS = 8;            // Extra request headers per exchange
+    static constexpr size_t MAX_HOST_LEN = 32;
+    static constexpr uint32_t IDLE_TIMEOUT_MS = 60000;
+    static constexpr int HTTP_TIMEOUT_MS = 10000;
+    static constexpr int32_t STREAM_WINDOW_SIZE = 65535;
+
+    struct Header {
+        const char* name;       // Lower case, as HTTP/2 requires
+        const char* value;
+    };
+
+    // One request and, once perform() returns, its response
+    struct Exchange {
+        const char* method;
+        std::string path;                       // Path and query, e.g. /v1/me/player
+        Header headers[MAX_HEADERS];
+        size_t header_count;
+        const std::string* body;                // POST/PUT body, or nullptr
+        std::string* body_out;                  // Collects the body unless on_data is set
+        const DataCallback* on_data;
+        const HeaderCallback* on_header;
+        const AbortCallback* should_abort;      // Asked before each body chunk
+
+        // Results
+        int status;                             // 0 if no response headers arrived
+        esp_err_t err;                          // ESP_OK, ESP_FAIL (reset/transport), ESP_ERR_NOT_FINISHED (aborted)
+
+        // Internal
+        int32_t stream_id;
+        int64_t sent_us;
+        size_t body_sent;
+        bool done;
+        std::unique_ptr<SpotifyGzipInflater> inflater;   // Set by a gzip response
+    };
+
+    explicit SpotifyH2Client(const char* host);
+    ~SpotifyH2Client();
+
+    /**
+     * Send every exchange as a concurrent stream and wait for all responses
+     * (at most MAX_STREAMS). A reused connection that fails before any
+     * response arrives is retried once on a fresh one.
+     * @return ESP_OK once every exchange has its err set; ESP_ERR_NOT_SUPPORTED
+     *         if the server does not speak HTTP/2; other errors if no
+     *         connection could be opened
+     */
+    esp_err_t perform(Exchange* exchanges, size_t count);
+
+    // false once the server turned down h2; use HTTP/1.1 instead
+    bool available() const { return !unsupported; }
+
+    // Open the connection now (TLS handshake, SETTINGS sent) unless one is
+    // already usable, so the next perform() goes straight out
+    bool warm_up();
+
+    void close();
+
+private:
+    char host[MAX_HOST_LEN];
+    SemaphoreHandle_t lock;
+    esp_tls_t* tls;
+    nghttp2_session* session;
+    int sockfd;
+    bool unsupported;
+    bool goaway;
+    TickType_t last_used;
+    size_t pending;         // Streams of the current perform() still open
+
+    esp_err_t connect();
+    void close_connection();
+    esp_err_t run();
+    bool submit(Exchange& exchange);
+    static void deliver(Exchange& exchange, const char* data, size_t length);
+
+    static ssize_t send_callback(nghttp2_session* session, const uint8_t* data, size_t length,
+                                 int flags, void* user_data);
+    static ssize_t recv_callback(nghttp2_session* session, uint8_t* buf, size_t length,
+                                 int flags, void* user_data);
+    static int on_header_callback(nghttp2_session* session, const nghttp2_frame* frame,
+                                  const uint8_t* name, size_t namelen, const uint8_t* value,
+                                  size_t valuelen, uint8_t flags, void* user_data);
+    static int on_data_chunk_recv_callback(nghttp2_session* session, uint8_t flags, int32_t stream_id,
+                                           const uint8_t* data, size_t len, void* user_data);
+    static int on_stream_close_callback(nghttp2_session* session, int32_t stream_id,
+                                        uint32_t error_code, void* user_data);
+    static int on_frame_recv_callback(nghttp2_session* session, const nghttp2_frame* frame,
+                                      void* user_data);
+    static ssize_t body_read_callback(nghttp2_session* session, int32_t stream_id, uint8_t* buf,
+                                      size_t length, uint32_t* data_flags, nghttp2_data_source* source,
+                                      void* user_data);
+};
@@ -0,0 +1,415 @@
+#include "spotify_http_pool.h"
+#include "spotify_dns_cache.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "telemetry.h"
+#include "telemetry_trace.h"
+#include "tls_profile.h"
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <strings.h>
+
+static const char *TAG = "spotify_http_pool";
+
+SpotifyHttpPool::SpotifyHttpPool()
+    : pool_mutex(xSemaphoreCreateMutex()) {
+    for (int i = 0; i < MAX_HOSTS; i++) {
+        entries[i].host[0] = '\0';
+        entries[i].client = nullptr;
+        entries[i].lock = xSemaphoreCreateMutex();
+        entries[i].users = 0;
+        entries[i].connected = false;
+        entries[i].last_used = 0;
+        entries[i].on_data = nullptr;
+        entries[i].on_header = nullptr;
+        entries[i].received = 0;
+        entries[i].should_abort = nullptr;
+        entries[i].aborted = false;
+        entries[i].gzip = false;
+    }
+}
+
+SpotifyHttpPool::~SpotifyHttpPool() {
+    close_all();
+    for (int i = 0; i < MAX_HOSTS; i++) {
+        if (entries[i].lock) {
+            vSemaphoreDelete(entries[i].lock);
+        }
+    }
+    if (pool_mutex) {
+        vSemaphoreDelete(pool_mutex);
+    }
+}
+
+esp_http_client_handle_t SpotifyHttpPool::acquire(const char* url) {
+    char host[MAX_HOST_LEN];
+    if (!parse_host(url, host, sizeof(host))) {
+        ESP_LOGE(TAG, "Cannot pool URL without a usable host: %s", url ? url : "(null)");
+        return nullptr;
+    }
+
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    Entry* entry = reserve_entry(host);
+    xSemaphoreGive(pool_mutex);
+
+    if (!entry) {
+        ESP_LOGE(TAG, "No free HTTP pool slot for %s", host);
+        return nullptr;
+    }
+
+    xSemaphoreTake(entry->lock, portMAX_DELAY);
+
+    // Servers drop idle keep-alive sockets on their own schedule; reconnect
+    // up front rather than failing the first write on a dead connection.
+    if (entry->connected &&
+        (xTaskGetTickCount() - entry->last_used) > pdMS_TO_TICKS(IDLE_TIMEOUT_MS)) {
+        ESP_LOGD(TAG, "Connection to %s idle too long, reconnecting", entry->host);
+        esp_http_client_close(entry->client);
+        entry->connected = false;
+    }
+
+    if (!entry->client) {
+        esp_http_client_config_t config = {};
+        config.url = url;
+        config.event_handler = http_event_handler;
+        config.user_data = entry;
+        config.timeout_ms = HTTP_TIMEOUT_MS;
+        config.crt_bundle_attach = tls_profile_crt_bundle(TLS_PROFILE_WEB);
+        config.buffer_size = 4096;
+        config.buffer_size_tx = 2048;
+        config.keep_alive_enable = true;
+        config.keep_alive_idle = KEEP_ALIVE_IDLE_S;
+        config.keep_alive_interval = KEEP_ALIVE_INTERVAL_S;
+        config.keep_alive_count = KEEP_ALIVE_COUNT;
+
+        entry->client = esp_http_client_init(&config);
+        if (!entry->client) {
+            ESP_LOGE(TAG, "Failed to initialize HTTP client for %s", entry->host);
+            xSemaphoreGive(entry->lock);
+            xSemaphoreTake(pool_mutex, portMAX_DELAY);
+            entry->users--;
+            xSemaphoreGive(pool_mutex);
+            return nullptr;
+        }
+        ESP_LOGI(TAG, "Created pooled HTTP client for %s", entry->host);
+    } else {
+        esp_http_client_set_url(entry->client, url);
+        esp_http_client_delete_header(entry->client, "Authorization");
+        esp_http_client_delete_header(entry->client, "If-None-Match");
+        esp_http_client_delete_header(entry->client, "Accept-Encoding");
+        esp_http_client_set_post_field(entry->client, nullptr, 0);
+    }
+
+    return entry->client;
+}
+
+void SpotifyHttpPool::release(esp_http_client_handle_t client, bool reusable) {
+    Entry* entry = find_entry(client);
+    if (!entry) {
+        return;
+    }
+
+    if (!reusable && entry->connected) {
+        esp_http_client_close(client);
+        entry->connected = false;
+    }
+    entry->last_used = xTaskGetTickCount();
+    xSemaphoreGive(entry->lock);
+
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    entry->users--;
+    xSemaphoreGive(pool_mutex);
+}
+
+esp_err_t SpotifyHttpPool::perform(esp_http_client_handle_t client, std::string& body,
+                                   const HeaderCallback* on_header) {
+    body.clear();
+    return perform(client, [&body](const char* data, size_t length) {
+        body.append(data, length);
+    }, on_header);
+}
+
+esp_err_t SpotifyHttpPool::perform(esp_http_client_handle_t client, const DataCallback& on_data,
+                                   const HeaderCallback* on_header, const AbortCallback* should_abort) {
+    Entry* entry = find_entry(client);
+    if (!entry) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bool reused = entry->connected;
+    entry->on_data = &on_data;
+    entry->on_header = on_header;
+    entry->received = 0;
+    entry->should_abort = should_abort;
+    entry->aborted = false;
+    entry->gzip = false;
+
+    // A new connection starts with a TLS handshake: hold full clock for it
+    static esp_pm_lock_handle_t handshake_lock = [] {
+        esp_pm_lock_handle_t lock = nullptr;
+        esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "spotify_tls", &lock);
+        return lock;
+    }();
+    bool handshake = !reused && handshake_lock;
+    if (handshake) esp_pm_lock_acquire(handshake_lock);
+
+    telemetry_ui_blocking("http perform");
+    int64_t start_us = esp_timer_get_time();
+    TELEMETRY_TRACE_BEGIN(TELEMETRY_TRACE_SPOTIFY_HTTP);
+    esp_err_t err = esp_http_client_perform(client);
+    if (err != ESP_OK && reused && entry->received == 0 && !entry->aborted) {
+        ESP_LOGD(TAG, "Reused connection to %s failed (%s), retrying on a new one",
+                 entry->host, esp_err_to_name(err));
+        esp_http_client_close(client);
+        entry->gzip = false;
+        handshake = handshake_lock != nullptr;
+        if (handshake) esp_pm_lock_acquire(handshake_lock);
+        err = esp_http_client_perform(client);
+    }
+    if (handshake) esp_pm_lock_release(handshake_lock);
+    TELEMETRY_TRACE_END(TELEMETRY_TRACE_SPOTIFY_HTTP);
+    uint32_t latency_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    telemetry_record(TELEMETRY_HTTP_LATENCY, latency_ms);
+    char url[MAX_URL_LEN];
+    char endpoint[TELEMETRY_HIST_NAME_MAX];
+    if (esp_http_client_get_url(client, url, sizeof(url)) == ESP_OK) {
+        endpoint_name(url, endpoint, sizeof(endpoint));
+        telemetry_hist_record(telemetry_hist_get(endpoint, TELEMETRY_HIST_MS), latency_ms);
+    }
+
+    entry->on_data = nullptr;
+    entry->on_header = nullptr;
+    entry->should_abort = nullptr;
+    if (entry->aborted) {
+        ESP_LOGD(TAG, "Request to %s aborted after %d bytes", entry->host, (int)entry->received);
+        err = ESP_ERR_NOT_FINISHED;
+    } else if (err == ESP_OK && entry->gzip && (entry->inflater.failed() || entry->inflater.truncated())) {
+        ESP_LOGW(TAG, "Undecodable gzip body from %s", entry->host);
+        err = ESP_ERR_INVALID_RESPONSE;
+    }
+    if (err != ESP_OK) {
+        entry->connected = false;
+    }
+    return err;
+}
+
+bool SpotifyHttpPool::is_warm(const char* url) {
+    char host[MAX_HOST_LEN];
+    if (!parse_host(url, host, sizeof(host))) {
+        return false;
+    }
+
+    bool warm = false;
+    TickType_t now = xTaskGetTickCount();
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    for (int i = 0; i < MAX_HOSTS; i++) {
+        const Entry& entry = entries[i];
+        if (entry.host[0] != '\0' && strcmp(entry.host, host) == 0) {
+            warm = entry.connected && (now - entry.last_used) <= pdMS_TO_TICKS(IDLE_TIMEOUT_MS);
+            break;
+        }
+    }
+    xSemaphoreGive(pool_mutex);
+    return warm;
+}
+
+void SpotifyHttpPool::close_idle() {
+    TickType_t now = xTaskGetTickCount();
+
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    for (int i = 0; i < MAX_HOSTS; i++) {
+        Entry& entry = entries[i];
+        if (entry.client && entry.users == 0 &&
+            (now - entry.last_used) > pdMS_TO_TICKS(IDLE_TIMEOUT_MS)) {
+            ESP_LOGI(TAG, "Closing idle HTTP client for %s", entry.host);
+            close_entry(entry);
+        }
+    }
+    xSemaphoreGive(pool_mutex);
+}
+
+void SpotifyHttpPool::close_all() {
+    if (!pool_mutex) {
+        return;
+    }
+
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    for (int i = 0; i < MAX_HOSTS; i++) {
+        if (entries[i].users > 0) {
+            ESP_LOGW(TAG, "HTTP client for %s still leased, not closing", entries[i].host);
+            continue;
+        }
+        close_entry(entries[i]);
+    }
+    xSemaphoreGive(pool_mutex);
+}
+
+SpotifyHttpPool::Entry* SpotifyHttpPool::find_entry(esp_http_client_handle_t client) {
+    if (!client) {
+        return nullptr;
+    }
+    for (int i = 0; i < MAX_HOSTS; i++) {
+        if (entries[i].client == client) {
+            return &entries[i];
+        }
+    }
+    return nullptr;
+}
+
+// Caller holds pool_mutex
+SpotifyHttpPool::Entry* SpotifyHttpPool::reserve_entry(const char* host) {
+    Entry* free_entry = nullptr;
+    Entry* lru_entry = nullptr;
+
+    for (int i = 0; i < MAX_HOSTS; i++) {
+        Entry& entry = entries[i];
+        if (entry.host[0] != '\0' && strcmp(entry.host, host) == 0) {
+            entry.users++;
+            return &entry;
+        }
+        if (entry.host[0] == '\0') {
+            if (!free_entry) {
+                free_entry = &entry;
+            }
+        } else if (entry.users == 0 &&
+                   (!lru_entry || entry.last_used < lru_entry->last_used)) {
+            lru_entry = &entry;
+        }
+    }
+
+    Entry* entry = free_entry;
+    if (!entry && lru_entry) {
+        ESP_LOGD(TAG, "Evicting HTTP client for %s", lru_entry->host);
+        close_entry(*lru_entry);
+        entry = lru_entry;
+    }
+    if (!entry) {
+        return nullptr;
+    }
+
+    strncpy(entry->host, host, sizeof(entry->host) - 1);
+    entry->host[sizeof(entry->host) - 1] = '\0';
+    entry->users = 1;
+    SpotifyDnsCache::shared().watch(entry->host);
+    entry->last_used = xTaskGetTickCount();
+    return entry;
+}
+
+void SpotifyHttpPool::close_entry(Entry& entry) {
+    if (entry.client) {
+        esp_http_client_cleanup(entry.client);
+        entry.client = nullptr;
+    }
+    entry.inflater.release();
+    entry.connected = false;
+    entry.host[0] = '\0';
+}
+
+bool SpotifyHttpPool::parse_host(const char* url, char* host, size_t host_size) {
+    if (!url) {
+        return false;
+    }
+
+    const char* start = strstr(url, "://");
+    start = start ? start + 3 : url;
+
+    size_t len = strcspn(start, "/:?#");
+    if (len == 0 || len >= host_size) {
+        return false;
+    }
+
+    memcpy(host, start, len);
+    host[len] = '\0';
+    return true;
+}
+
+// Spotify IDs are 22 base62 characters; numeric segments are offsets or IDs too
+static bool is_id_segment(const char* segment, size_t length) {
+    bool digit = false;
+    bool digits_only = true;
+    for (size_t i = 0; i < length; i++) {
+        if (isdigit((unsigned char)segment[i])) {
+            digit = true;
+        } else {
+            digits_only = false;
+        }
+    }
+    return digits_only || (digit && length >= 16);
+}
+
+void SpotifyHttpPool::endpoint_name(const char* url, char* out, size_t size) {
+    const char* path = url ? url : "";
+    const char* scheme = strstr(path, "://");
+    if (scheme) {
+        path = scheme + 3;
+        path += strcspn(path, "/?#");
+    }
+    if (strncmp(path, "/v1/", 4) == 0) {
+        path += 3;
+    }
+
+    size_t used = snprintf(out, size, "http");
+    for (int segments = 0; segments < MAX_ENDPOINT_SEGMENTS && *path == '/' && used < size; segments++) {
+        path++;
+        size_t length = strcspn(path, "/?#");
+        if (length == 0) {
+            break;
+        }
+        char separator = segments == 0 ? ' ' : '/';
+        if (is_id_segment(path, length)) {
+            used += snprintf(out + used, size - used, "%c*", separator);
+        } else {
+            used += snprintf(out + used, size - used, "%c%.*s", separator, (int)length, path);
+        }
+        path += length;
+    }
+}
+
+esp_err_t SpotifyHttpPool::http_event_handler(esp_http_client_event_t* evt) {
+    Entry* entry = static_cast<Entry*>(evt->user_data);
+
+    switch (evt->event_id) {
+        case HTTP_EVENT_ON_CONNECTED:
+            ESP_LOGD(TAG, "Connected to %s", entry ? entry->host : "?");
+            if (entry) {
+                entry->connected = true;
+            }
+            break;
+        case HTTP_EVENT_ON_HEADER:
+            if (entry && evt->header_key && evt->header_value &&
+                strcasecmp(evt->header_key, "Content-Encoding") == 0 && strcasecmp(evt->header_value, "gzip") == 0) {
+                entry->gzip = true;
+                entry->inflater.reset();
+            }
+            if (entry && entry->on_header && evt->header_key && evt->header_value) {
+                (*entry->on_header)(evt->header_key, evt->header_value);
+            }
+            break;
+        case HTTP_EVENT_ON_DATA:
+            if (entry && !entry->aborted && entry->should_abort && (*entry->should_abort)()) {
+                // Drop the connection rather than read a body nobody wants
+                entry->aborted = true;
+                esp_http_client_cancel_request(evt->client);
+            }
+            if (entry && !entry->aborted && entry->on_data && evt->data_len > 0) {
+                entry->received += evt->data_len;
+                if (entry->gzip) {
+                    entry->inflater.feed(static_cast<const char*>(evt->data), evt->data_len, *entry->on_data);
+                } else {
+                    (*entry->on_data)(static_cast<const char*>(evt->data), evt->data_len);
+                }
+            }
+            break;
+        case HTTP_EVENT_DISCONNECTED:
+            ESP_LOGD(TAG, "Disconnected from %s", entry ? entry->host : "?");
+            if (entry) {
+                entry->connected = false;
+            }
+            break;
+        default:
+            break;
+    }
+    return ESP_OK;
+}
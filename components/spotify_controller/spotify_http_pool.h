@@ -0,0 +1,127 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_http_client.h"
+#include "spotify_gzip_inflater.h"
+
+/**
+ * SpotifyHttpPool - Per-host pool of keep-alive HTTP clients
+ *
+ * Features:
+ * - One esp_http_client per host (api.spotify.com, accounts.spotify.com,
+ *   i.scdn.co), so consecutive requests to the same host reuse the TLS session
+ * - TCP keep-alive on every pooled connection
+ * - Connections left idle longer than IDLE_TIMEOUT_MS are closed on the next
+ *   acquire() or close_idle(), before the server drops them under us
+ * - One request at a time per host; other hosts are not blocked
+ * - Response bodies are collected from HTTP_EVENT_ON_DATA so the connection is
+ *   fully drained before it goes back to the pool
+ * - Response headers can be observed during perform() (e.g. ETag)
+ * - A streaming perform() can be abandoned part way by an abort check; the
+ *   connection is dropped instead of draining the rest of the body
+ * - A Content-Encoding: gzip body (ask with an Accept-Encoding: gzip
+ *   header) is inflated as it arrives; callbacks only ever see plain data
+ *
+ * Typical use:
+ *   esp_http_client_handle_t client = pool.acquire(url);
+ *   esp_http_client_set_method(client, HTTP_METHOD_GET);
+ *   esp_err_t err = pool.perform(client, body);
+ *   pool.release(client, err == ESP_OK);
+ */
+class SpotifyHttpPool {
+public:
+    using DataCallback = std::function<void(const char* data, size_t length)>;
+    using HeaderCallback = std::function<void(const char* key, const char* value)>;
+    using AbortCallback = std::function<bool()>;
+
+    static constexpr int MAX_HOSTS = 3;
+    static constexpr size_t MAX_HOST_LEN = 32;
+    static constexpr uint32_t IDLE_TIMEOUT_MS = 60000;
+    static constexpr int HTTP_TIMEOUT_MS = 10000;
+    static constexpr int KEEP_ALIVE_IDLE_S = 15;
+    static constexpr int KEEP_ALIVE_INTERVAL_S = 5;
+    static constexpr int KEEP_ALIVE_COUNT = 3;
+    static constexpr int MAX_ENDPOINT_SEGMENTS = 3;
+    static constexpr size_t MAX_URL_LEN = 256;      // Longer URLs are named by what fits
+
+    SpotifyHttpPool();
+    ~SpotifyHttpPool();
+
+    /**
+     * Lease the pooled client for the host of url, pointed at url.
+     * Blocks while another task holds the same host. Headers and post field
+     * left over from the previous lease are cleared.
+     * @return nullptr if the URL has no host, the pool is full or init failed
+     */
+    esp_http_client_handle_t acquire(const char* url);
+
+    /**
+     * Return a leased client. Pass reusable = false after a transport error
+     * so the connection is closed instead of being kept alive.
+     */
+    void release(esp_http_client_handle_t client, bool reusable = true);
+
+    /**
+     * Run the request on a leased client and collect the response body.
+     * A reused connection the server already closed is retried once on a
+     * fresh connection.
+     */
+    esp_err_t perform(esp_http_client_handle_t client, std::string& body,
+                      const HeaderCallback* on_header = nullptr);
+
+    /**
+     * Run the request and hand each body chunk to on_data as it arrives.
+     * Only retried if the stale connection failed before any body data.
+     * should_abort is asked before each chunk; once it returns true the
+     * request is cancelled and ESP_ERR_NOT_FINISHED returned (release the
+     * client with reusable = false).
+     */
+    esp_err_t perform(esp_http_client_handle_t client, const DataCallback& on_data,
+                      const HeaderCallback* on_header = nullptr,
+                      const AbortCallback* should_abort = nullptr);
+
+    // The host of url has an open connection that acquire() will not drop
+    // as idle, so a request to it starts without a TLS handshake
+    bool is_warm(const char* url);
+
+    // The latency histogram a request to url (or a bare path) is counted in:
+    // "http " and up to MAX_ENDPOINT_SEGMENTS of the path after /v1, with
+    // IDs as "*", e.g. "http playlists/*/tracks"
+    static void endpoint_name(const char* url, char* out, size_t size);
+
+    // Close connections that have been idle longer than IDLE_TIMEOUT_MS
+    void close_idle();
+
+    // Close and free every pooled client (no lease may be outstanding)
+    void close_all();
+
+private:
+    struct Entry {
+        char host[MAX_HOST_LEN];
+        esp_http_client_handle_t client;
+        SemaphoreHandle_t lock;
+        int users;                 // Leases held or waited for
+        bool connected;            // Socket is open (kept alive between requests)
+        TickType_t last_used;
+        const DataCallback* on_data;   // Body sink while perform() runs
+        const HeaderCallback* on_header;   // Header observer while perform() runs
+        size_t received;               // Body bytes seen by the current perform()
+        const AbortCallback* should_abort; // Abort check while perform() runs
+        bool aborted;                  // Current perform() was cancelled
+        bool gzip;                     // Current response is gzip encoded
+        SpotifyGzipInflater inflater;
+    };
+
+    Entry entries[MAX_HOSTS];
+    SemaphoreHandle_t pool_mutex;
+
+    Entry* find_entry(esp_http_client_handle_t client);
+    Entry* reserve_entry(const char* host);
+    void close_entry(Entry& entry);
+
+    static bool parse_host(const char* url, char* host, size_t host_size);
+    static esp_err_t http_event_handler(esp_http_client_event_t* evt);
+};
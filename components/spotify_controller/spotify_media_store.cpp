@@ -0,0 +1,209 @@
+#include "spotify_media_store.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <cstdlib>
+#include <cstring>
+
+static const char *TAG = "spotify_media_store";
+
+// Shared by every empty field so "" costs no arena space
+static const char EMPTY_STRING[] = "";
+
+SpotifyMediaStore::SpotifyMediaStore()
+    : blocks(nullptr)
+    , arena_used(0)
+    , intern_table(nullptr)
+    , intern_slots(0)
+    , intern_count(0)
+    , track_records(nullptr)
+    , track_len(0)
+    , track_cap(0)
+    , playlist_records(nullptr)
+    , playlist_len(0)
+    , playlist_cap(0) {
+}
+
+SpotifyMediaStore::~SpotifyMediaStore() {
+    clear();
+}
+
+void SpotifyMediaStore::clear() {
+    while (blocks) {
+        Block* next = blocks->next;
+        free(blocks);
+        blocks = next;
+    }
+    arena_used = 0;
+
+    free(intern_table);
+    intern_table = nullptr;
+    intern_slots = 0;
+    intern_count = 0;
+
+    free(track_records);
+    track_records = nullptr;
+    track_len = 0;
+    track_cap = 0;
+
+    free(playlist_records);
+    playlist_records = nullptr;
+    playlist_len = 0;
+    playlist_cap = 0;
+}
+
+bool SpotifyMediaStore::add_track(const SpotifyTrack& track) {
+    if (!reserve_one(track_records, track_len, track_cap)) {
+        return false;
+    }
+
+    Track record;
+    record.id = intern(track.id);
+    record.name = intern(track.name);
+    record.artist = intern(track.artist);
+    record.album = intern(track.album);
+    record.uri = intern(track.uri);
+    record.image_url = intern(track.image_url);
+    record.duration_ms = track.duration_ms;
+
+    if (!record.id || !record.name || !record.artist || !record.album ||
+        !record.uri || !record.image_url) {
+        ESP_LOGW(TAG, "Arena full, dropping track %s", track.id.c_str());
+        return false;
+    }
+
+    track_records[track_len++] = record;
+    return true;
+}
+
+bool SpotifyMediaStore::add_playlist(const SpotifyPlaylist& playlist) {
+    if (!reserve_one(playlist_records, playlist_len, playlist_cap)) {
+        return false;
+    }
+
+    Playlist record;
+    record.id = intern(playlist.id);
+    record.name = intern(playlist.name);
+    record.uri = intern(playlist.uri);
+    record.image_url = intern(playlist.image_url);
+    record.owner = intern(playlist.owner);
+    record.track_count = playlist.track_count;
+
+    if (!record.id || !record.name || !record.uri || !record.image_url || !record.owner) {
+        ESP_LOGW(TAG, "Arena full, dropping playlist %s", playlist.id.c_str());
+        return false;
+    }
+
+    playlist_records[playlist_len++] = record;
+    return true;
+}
+
+const char* SpotifyMediaStore::intern(const std::string& value) {
+    if (value.empty()) {
+        return EMPTY_STRING;
+    }
+
+    // Keep the table at most 3/4 full so probes stay short
+    if ((intern_count + 1) * 4 > intern_slots * 3 && !grow_intern_table()) {
+        return nullptr;
+    }
+
+    size_t mask = intern_slots - 1;
+    size_t slot = hash(value.data(), value.size()) & mask;
+    while (intern_table[slot]) {
+        if (strcmp(intern_table[slot], value.c_str()) == 0) {
+            return intern_table[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    char* copy = allocate(value.size() + 1);
+    if (!copy) {
+        return nullptr;
+    }
+    memcpy(copy, value.c_str(), value.size() + 1);
+
+    intern_table[slot] = copy;
+    intern_count++;
+    return copy;
+}
+
+char* SpotifyMediaStore::allocate(size_t size) {
+    if (!blocks || blocks->size - blocks->used < size) {
+        size_t block_size = size > BLOCK_SIZE ? size : BLOCK_SIZE;
+        Block* block = static_cast<Block*>(psram_realloc(nullptr, sizeof(Block) + block_size));
+        if (!block) {
+            return nullptr;
+        }
+        block->next = blocks;
+        block->size = block_size;
+        block->used = 0;
+        blocks = block;
+    }
+
+    char* ptr = blocks->data() + blocks->used;
+    blocks->used += size;
+    arena_used += size;
+    return ptr;
+}
+
+bool SpotifyMediaStore::grow_intern_table() {
+    size_t new_slots = intern_slots ? intern_slots * 2 : INITIAL_INTERN_SLOTS;
+    const char** new_table = static_cast<const char**>(psram_realloc(nullptr, new_slots * sizeof(const char*)));
+    if (!new_table) {
+        return false;
+    }
+    memset(new_table, 0, new_slots * sizeof(const char*));
+
+    size_t mask = new_slots - 1;
+    for (size_t i = 0; i < intern_slots; i++) {
+        const char* entry = intern_table[i];
+        if (!entry) {
+            continue;
+        }
+        size_t slot = hash(entry, strlen(entry)) & mask;
+        while (new_table[slot]) {
+            slot = (slot + 1) & mask;
+        }
+        new_table[slot] = entry;
+    }
+
+    free(intern_table);
+    intern_table = new_table;
+    intern_slots = new_slots;
+    return true;
+}
+
+template <typename T>
+bool SpotifyMediaStore::reserve_one(T*& array, size_t len, size_t& cap) {
+    if (len < cap) {
+        return true;
+    }
+
+    size_t new_cap = cap ? cap * 2 : 16;
+    T* grown = static_cast<T*>(psram_realloc(array, new_cap * sizeof(T)));
+    if (!grown) {
+        ESP_LOGW(TAG, "Out of memory growing record array to %d", (int)new_cap);
+        return false;
+    }
+    array = grown;
+    cap = new_cap;
+    return true;
+}
+
+uint32_t SpotifyMediaStore::hash(const char* data, size_t length) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        h ^= (uint8_t)data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void* SpotifyMediaStore::psram_realloc(void* ptr, size_t size) {
+    void* result = heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!result) {
+        result = realloc(ptr, size);
+    }
+    return result;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "spotify_controller.h"
+
+/**
+ * SpotifyMediaStore - Compact, arena-backed page of Spotify tracks or playlists
+ *
+ * Features:
+ * - Records are plain structs of const char* views, no std::string per field
+ * - Strings live in a block arena allocated from PSRAM (internal RAM fallback)
+ * - Repeated strings (artist, album, cover URL, owner) are interned once
+ * - Records stay put until clear() or destruction, so views handed to the
+ *   GUI remain valid for the life of the store
+ * - Only the fields the GUI displays are kept (no description/preview URL)
+ */
+class SpotifyMediaStore {
+public:
+    static constexpr size_t BLOCK_SIZE = 4096;
+    static constexpr size_t INITIAL_INTERN_SLOTS = 64;
+
+    struct Track {
+        const char* id;
+        const char* name;
+        const char* artist;
+        const char* album;
+        const char* uri;
+        const char* image_url;
+        int32_t duration_ms;
+    };
+
+    struct Playlist {
+        const char* id;
+        const char* name;
+        const char* uri;
+        const char* image_url;
+        const char* owner;
+        int32_t track_count;
+    };
+
+    SpotifyMediaStore();
+    ~SpotifyMediaStore();
+
+    SpotifyMediaStore(const SpotifyMediaStore&) = delete;
+    SpotifyMediaStore& operator=(const SpotifyMediaStore&) = delete;
+
+    /**
+     * Copy a parsed record into the store.
+     * @return false if the arena could not grow (record dropped)
+     */
+    bool add_track(const SpotifyTrack& track);
+    bool add_playlist(const SpotifyPlaylist& playlist);
+
+    void clear();
+
+    const Track* tracks() const { return track_records; }
+    size_t track_count() const { return track_len; }
+    const Playlist* playlists() const { return playlist_records; }
+    size_t playlist_count() const { return playlist_len; }
+
+    // Arena bytes in use (strings only)
+    size_t bytes_used() const { return arena_used; }
+
+private:
+    struct Block {
+        Block* next;
+        size_t size;
+        size_t used;
+        // Block data follows the header
+        char* data() { return reinterpret_cast<char*>(this + 1); }
+    };
+
+    Block* blocks;
+    size_t arena_used;
+
+    const char** intern_table;
+    size_t intern_slots;
+    size_t intern_count;
+
+    Track* track_records;
+    size_t track_len;
+    size_t track_cap;
+    Playlist* playlist_records;
+    size_t playlist_len;
+    size_t playlist_cap;
+
+    const char* intern(const std::string& value);
+    char* allocate(size_t size);
+    bool grow_intern_table();
+
+    template <typename T>
+    bool reserve_one(T*& array, size_t len, size_t& cap);
+
+    static uint32_t hash(const char* data, size_t length);
+    static void* psram_realloc(void* ptr, size_t size);
+};
@@ -0,0 +1,97 @@
+#include "spotify_rate_limiter.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+static const char *TAG = "spotify_rate_limiter";
+
+SpotifyRateLimiter::SpotifyRateLimiter()
+    : blocked_until(0)
+    , blocked(false) {
+    TickType_t now = xTaskGetTickCount();
+
+    Bucket& player = buckets[(int)EndpointClass::PLAYER];
+    player.burst = PLAYER_BURST;
+    player.refill_ticks = pdMS_TO_TICKS(PLAYER_REFILL_MS);
+    player.tokens = PLAYER_BURST;
+    player.last_refill = now;
+
+    Bucket& browse = buckets[(int)EndpointClass::BROWSE];
+    browse.burst = BROWSE_BURST;
+    browse.refill_ticks = pdMS_TO_TICKS(BROWSE_REFILL_MS);
+    browse.tokens = BROWSE_BURST;
+    browse.last_refill = now;
+}
+
+SpotifyRateLimiter::EndpointClass SpotifyRateLimiter::classify(const std::string& endpoint) {
+    return endpoint.compare(0, 10, "/me/player") == 0 ? EndpointClass::PLAYER : EndpointClass::BROWSE;
+}
+
+uint32_t SpotifyRateLimiter::delay_ms(EndpointClass cls) const {
+    TickType_t now = xTaskGetTickCount();
+    TickType_t wait = 0;
+
+    if (blocked && (int32_t)(blocked_until - now) > 0) {
+        wait = blocked_until - now;
+    }
+
+    const Bucket& bucket = buckets[(int)cls];
+    TickType_t elapsed = now - bucket.last_refill;
+    if (bucket.tokens == 0 && elapsed < bucket.refill_ticks) {
+        TickType_t refill_wait = bucket.refill_ticks - elapsed;
+        if (refill_wait > wait) {
+            wait = refill_wait;
+        }
+    }
+
+    return wait * portTICK_PERIOD_MS;
+}
+
+bool SpotifyRateLimiter::try_acquire(EndpointClass cls) {
+    TickType_t now = xTaskGetTickCount();
+
+    if (blocked) {
+        if ((int32_t)(blocked_until - now) > 0) {
+            return false;
+        }
+        blocked = false;
+    }
+
+    Bucket& bucket = buckets[(int)cls];
+    refill(bucket, now);
+    if (bucket.tokens == 0) {
+        return false;
+    }
+
+    bucket.tokens--;
+    return true;
+}
+
+void SpotifyRateLimiter::retry_after(uint32_t backoff_ms) {
+    if (backoff_ms > MAX_RETRY_AFTER_MS) {
+        backoff_ms = MAX_RETRY_AFTER_MS;
+    }
+
+    TickType_t until = xTaskGetTickCount() + pdMS_TO_TICKS(backoff_ms);
+    if (!blocked || (int32_t)(until - blocked_until) > 0) {
+        blocked_until = until;
+    }
+    blocked = true;
+
+    ESP_LOGW(TAG, "Spotify asked us to back off for %d ms", (int)backoff_ms);
+}
+
+void SpotifyRateLimiter::refill(Bucket& bucket, TickType_t now) {
+    TickType_t elapsed = now - bucket.last_refill;
+    if (elapsed < bucket.refill_ticks) {
+        return;
+    }
+
+    uint32_t earned = elapsed / bucket.refill_ticks;
+    if (bucket.tokens + earned >= bucket.burst) {
+        bucket.tokens = bucket.burst;
+        bucket.last_refill = now;
+    } else {
+        bucket.tokens += earned;
+        bucket.last_refill += earned * bucket.refill_ticks;
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "freertos/FreeRTOS.h"
+
+/**
+ * SpotifyRateLimiter - Non-blocking token buckets for Spotify Web API calls
+ *
+ * Features:
+ * - One bucket per endpoint class: player calls (/me/player...) and
+ *   browse calls (playlists, search, everything else)
+ * - Bursts up to the bucket size, then one request per refill interval
+ * - A 429 Retry-After blocks every class until it has elapsed
+ * - Never sleeps: callers ask how long to wait and defer the request
+ *
+ * Not thread-safe; all API calls run on the Spotify worker task.
+ *
+ * Typical use:
+ *   uint32_t wait_ms = limiter.delay_ms(cls);   // 0: may send now
+ *   if (limiter.try_acquire(cls)) { send }
+ *   on 429: limiter.retry_after(retry_after_s * 1000);
+ */
+class SpotifyRateLimiter {
+public:
+    enum class EndpointClass : uint8_t {
+        PLAYER,
+        BROWSE,
+        COUNT
+    };
+
+    static constexpr uint32_t PLAYER_BURST = 5;
+    static constexpr uint32_t PLAYER_REFILL_MS = 1000;
+    static constexpr uint32_t BROWSE_BURST = 4;
+    static constexpr uint32_t BROWSE_REFILL_MS = 2000;
+    static constexpr uint32_t DEFAULT_RETRY_AFTER_MS = 5000;    // 429 without Retry-After
+    static constexpr uint32_t MAX_RETRY_AFTER_MS = 300000;
+
+    SpotifyRateLimiter();
+
+    static EndpointClass classify(const std::string& endpoint);
+
+    // Milliseconds until a request of this class may be sent (0: now)
+    uint32_t delay_ms(EndpointClass cls) const;
+
+    // Take a token if one is available and no Retry-After is pending
+    bool try_acquire(EndpointClass cls);
+
+    // Apply a server-requested backoff to every class
+    void retry_after(uint32_t backoff_ms);
+
+private:
+    struct Bucket {
+        uint32_t burst;
+        TickType_t refill_ticks;
+        uint32_t tokens;
+        TickType_t last_refill;
+    };
+
+    Bucket buckets[(int)EndpointClass::COUNT];
+    TickType_t blocked_until;
+    bool blocked;
+
+    void refill(Bucket& bucket, TickType_t now);
+};
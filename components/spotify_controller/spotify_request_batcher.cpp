@@ -0,0 +1,155 @@
+#include "spotify_request_batcher.h"
+#include <algorithm>
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "spotify_api_client.h"
+
+static const char *TAG = "spotify_batcher";
+
+SpotifyRequestBatcher::SpotifyRequestBatcher() {
+    tracks.opened_at = 0;
+    tracks.max_ids = SpotifyApiClient::MAX_SEVERAL_TRACKS;
+    albums.opened_at = 0;
+    albums.max_ids = SpotifyApiClient::MAX_SEVERAL_ALBUMS;
+    artists.opened_at = 0;
+    artists.max_ids = SpotifyApiClient::MAX_SEVERAL_ARTISTS;
+}
+
+template <typename Record>
+bool SpotifyRequestBatcher::add(Batch<Record>& batch, const std::string& id, std::function<void(const Record*)> callback) {
+    if (id.empty()) {
+        return false;
+    }
+    if (batch.lookups.size() >= MAX_PENDING) {
+        ESP_LOGW(TAG, "Too many pending lookups, dropping %s", id.c_str());
+        return false;
+    }
+
+    // The window opens with the first lookup of a batch
+    if (batch.lookups.empty()) {
+        batch.opened_at = xTaskGetTickCount();
+    }
+    batch.lookups.push_back({id, std::move(callback)});
+    return true;
+}
+
+bool SpotifyRequestBatcher::lookup_track(const std::string& track_id, TrackCallback callback) {
+    return add(tracks, track_id, std::move(callback));
+}
+
+bool SpotifyRequestBatcher::lookup_album(const std::string& album_id, AlbumCallback callback) {
+    return add(albums, album_id, std::move(callback));
+}
+
+bool SpotifyRequestBatcher::lookup_artist(const std::string& artist_id, ArtistCallback callback) {
+    return add(artists, artist_id, std::move(callback));
+}
+
+template <typename Record>
+uint32_t SpotifyRequestBatcher::batch_delay_ms(const Batch<Record>& batch, TickType_t now) {
+    if (batch.lookups.empty()) {
+        return NOTHING_PENDING;
+    }
+    if (batch.lookups.size() >= batch.max_ids) {
+        return 0;
+    }
+
+    TickType_t elapsed = now - batch.opened_at;
+    TickType_t window = pdMS_TO_TICKS(BATCH_WINDOW_MS);
+    return elapsed >= window ? 0 : (uint32_t)((window - elapsed) * portTICK_PERIOD_MS);
+}
+
+uint32_t SpotifyRequestBatcher::delay_ms() const {
+    TickType_t now = xTaskGetTickCount();
+    return std::min({batch_delay_ms(tracks, now), batch_delay_ms(albums, now), batch_delay_ms(artists, now)});
+}
+
+// One call for the first max_ids distinct ids; their lookups are answered
+// and removed, the rest stay queued (and due) for the next call
+template <typename Record, typename Fetch>
+bool SpotifyRequestBatcher::send(Batch<Record>& batch, Fetch fetch) {
+    std::vector<std::string> ids;
+    for (const auto& lookup : batch.lookups) {
+        if (ids.size() >= batch.max_ids) {
+            break;
+        }
+        if (std::find(ids.begin(), ids.end(), lookup.id) == ids.end()) {
+            ids.push_back(lookup.id);
+        }
+    }
+
+    std::vector<Record> results;
+    results.reserve(ids.size());
+    bool ok = fetch(ids, [&results](const Record& record) {
+        results.push_back(record);
+    });
+    ESP_LOGD(TAG, "Batched %d ids into one call: %d found", (int)ids.size(), (int)results.size());
+
+    // Split off the answered lookups first, so a callback may queue new ones
+    std::vector<typename Batch<Record>::Lookup> answered;
+    auto remaining = std::stable_partition(batch.lookups.begin(), batch.lookups.end(),
+        [&ids](const typename Batch<Record>::Lookup& lookup) {
+            return std::find(ids.begin(), ids.end(), lookup.id) == ids.end();
+        });
+    answered.assign(std::make_move_iterator(remaining), std::make_move_iterator(batch.lookups.end()));
+    batch.lookups.erase(remaining, batch.lookups.end());
+    if (!batch.lookups.empty()) {
+        // Overflow has waited its window already
+        batch.opened_at = xTaskGetTickCount() - pdMS_TO_TICKS(BATCH_WINDOW_MS);
+    }
+
+    for (const auto& lookup : answered) {
+        const Record* found = nullptr;
+        for (const Record& record : results) {
+            if (record.id == lookup.id) {
+                found = &record;
+                break;
+            }
+        }
+        if (lookup.callback) {
+            lookup.callback(found);
+        }
+    }
+    return ok;
+}
+
+// One call per kind at most, so the caller can check the rate limiter in
+// between; lookups left over are still due on the next flush
+bool SpotifyRequestBatcher::flush(SpotifyApiClient& api, bool force) {
+    bool ok = true;
+    TickType_t now = xTaskGetTickCount();
+
+    if (!tracks.lookups.empty() && (force || batch_delay_ms(tracks, now) == 0)) {
+        ok &= send(tracks, [&api](const std::vector<std::string>& ids, const SpotifyApiClient::TrackSink& sink) {
+            return api.stream_several_tracks(ids, sink);
+        });
+    }
+    if (!albums.lookups.empty() && (force || batch_delay_ms(albums, now) == 0)) {
+        ok &= send(albums, [&api](const std::vector<std::string>& ids, const SpotifyApiClient::AlbumSink& sink) {
+            return api.stream_several_albums(ids, sink);
+        });
+    }
+    if (!artists.lookups.empty() && (force || batch_delay_ms(artists, now) == 0)) {
+        ok &= send(artists, [&api](const std::vector<std::string>& ids, const SpotifyApiClient::ArtistSink& sink) {
+            return api.stream_several_artists(ids, sink);
+        });
+    }
+    return ok;
+}
+
+template <typename Record>
+void SpotifyRequestBatcher::fail_all(Batch<Record>& batch) {
+    std::vector<typename Batch<Record>::Lookup> lookups;
+    lookups.swap(batch.lookups);
+    for (const auto& lookup : lookups) {
+        if (lookup.callback) {
+            lookup.callback(nullptr);
+        }
+    }
+}
+
+void SpotifyRequestBatcher::cancel() {
+    fail_all(tracks);
+    fail_all(albums);
+    fail_all(artists);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "spotify_controller.h"
+
+class SpotifyApiClient;
+
+/**
+ * SpotifyRequestBatcher - Groups single track/album/artist lookups into
+ * several-ids Web API calls
+ *
+ * Features:
+ * - Lookups are collected for BATCH_WINDOW_MS after the first one arrives,
+ *   then sent as one /tracks?ids=, /albums?ids= or /artists?ids= call
+ * - A batch that reaches the Web API id limit is due at once; lookups past
+ *   the limit go out in the next call
+ * - The same id asked for twice is sent once and answered twice
+ * - Each result is handed to the callback of its own lookup; ids Spotify
+ *   does not know, and lookups whose call failed, get nullptr
+ *
+ * Not thread-safe; all API calls run on the Spotify worker task.
+ *
+ * Typical use:
+ *   batcher.lookup_track(id, [](const SpotifyTrack* track) { ... });
+ *   if (batcher.delay_ms() == 0) batcher.flush(api);
+ */
+class SpotifyRequestBatcher {
+public:
+    using TrackCallback = std::function<void(const SpotifyTrack*)>;
+    using AlbumCallback = std::function<void(const SpotifyAlbum*)>;
+    using ArtistCallback = std::function<void(const SpotifyArtist*)>;
+
+    static constexpr uint32_t BATCH_WINDOW_MS = 50;
+    static constexpr size_t MAX_PENDING = 200;          // Per kind; further lookups are refused
+    static constexpr uint32_t NOTHING_PENDING = UINT32_MAX;
+
+    SpotifyRequestBatcher();
+
+    // false if the id is empty or too many lookups are already waiting
+    bool lookup_track(const std::string& track_id, TrackCallback callback);
+    bool lookup_album(const std::string& album_id, AlbumCallback callback);
+    bool lookup_artist(const std::string& artist_id, ArtistCallback callback);
+
+    // Milliseconds until a batch is due (0: now, NOTHING_PENDING: no lookups)
+    uint32_t delay_ms() const;
+
+    /**
+     * Send the next call of every batch that is due (of every non-empty one
+     * with force).
+     * @return false if any call failed (its lookups are answered with nullptr)
+     */
+    bool flush(SpotifyApiClient& api, bool force = false);
+
+    // Answer every pending lookup with nullptr
+    void cancel();
+
+private:
+    template <typename Record>
+    struct Batch {
+        struct Lookup {
+            std::string id;
+            std::function<void(const Record*)> callback;
+        };
+        std::vector<Lookup> lookups;
+        TickType_t opened_at;
+        size_t max_ids;
+    };
+
+    Batch<SpotifyTrack> tracks;
+    Batch<SpotifyAlbum> albums;
+    Batch<SpotifyArtist> artists;
+
+    template <typename Record>
+    static bool add(Batch<Record>& batch, const std::string& id, std::function<void(const Record*)> callback);
+    template <typename Record>
+    static uint32_t batch_delay_ms(const Batch<Record>& batch, TickType_t now);
+    template <typename Record, typename Fetch>
+    static bool send(Batch<Record>& batch, Fetch fetch);
+    template <typename Record>
+    static void fail_all(Batch<Record>& batch);
+};
@@ -0,0 +1,228 @@
+#include "spotify_response_cache.h"
+#include "esp_log.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include <cstdio>
+#include <cstring>
+
+static const char *TAG = "spotify_cache";
+
+static const char* NVS_NAMESPACE = "spotify_cache";
+
+SpotifyResponseCache::SpotifyResponseCache() {
+    entries.reserve(MAX_ENTRIES);
+}
+
+bool SpotifyResponseCache::get_etag(const std::string& key, std::string& etag) {
+    Entry* entry = find(key);
+    if (!entry && load_persisted(key)) {
+        entry = find(key);
+    }
+    if (!entry) {
+        // Remember the miss so polling does not hit NVS on every request
+        entry = insert(key);
+    }
+
+    entry->last_used = xTaskGetTickCount();
+    if (entry->etag.empty()) {
+        return false;
+    }
+
+    etag = entry->etag;
+    return true;
+}
+
+const std::string* SpotifyResponseCache::payload(const std::string& key) {
+    Entry* entry = find(key);
+    if (!entry || entry->etag.empty()) {
+        return nullptr;
+    }
+    return &entry->payload;
+}
+
+void SpotifyResponseCache::store(const std::string& key, const std::string& etag,
+                                 const std::string& payload, bool persist) {
+    Entry* entry = find(key);
+    if (!entry) {
+        entry = insert(key);
+    }
+
+    bool was_persisted = entry->persist && !entry->etag.empty();
+
+    if (etag.empty() || etag.length() > MAX_ETAG_LEN) {
+        entry->etag.clear();
+        entry->payload.clear();
+        entry->persist = false;
+        if (was_persisted) {
+            erase_persisted(key);
+        }
+        return;
+    }
+
+    bool unchanged = entry->etag == etag && entry->payload == payload;
+    entry->etag = etag;
+    entry->payload = payload;
+    entry->persist = persist && payload.length() <= MAX_PERSISTED_PAYLOAD;
+    entry->last_used = xTaskGetTickCount();
+
+    if (entry->persist && !unchanged) {
+        save_persisted(*entry);
+    } else if (was_persisted && !entry->persist) {
+        erase_persisted(key);
+    }
+}
+
+void SpotifyResponseCache::invalidate(const std::string& key) {
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->key == key) {
+            if (it->persist) {
+                erase_persisted(key);
+            }
+            entries.erase(it);
+            return;
+        }
+    }
+}
+
+void SpotifyResponseCache::clear() {
+    entries.clear();
+
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK) {
+        return;
+    }
+    nvs_erase_all(nvs_handle);
+    nvs_commit(nvs_handle);
+    nvs_close(nvs_handle);
+}
+
+SpotifyResponseCache::Entry* SpotifyResponseCache::find(const std::string& key) {
+    for (Entry& entry : entries) {
+        if (entry.key == key) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+SpotifyResponseCache::Entry* SpotifyResponseCache::insert(const std::string& key) {
+    if ((int)entries.size() >= MAX_ENTRIES) {
+        // Persisted entries survive eviction in NVS and reload on demand
+        auto lru = entries.begin();
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->last_used < lru->last_used) {
+                lru = it;
+            }
+        }
+        ESP_LOGD(TAG, "Evicting %s", lru->key.c_str());
+        entries.erase(lru);
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.persist = false;
+    entry.last_used = xTaskGetTickCount();
+    entries.push_back(entry);
+    return &entries.back();
+}
+
+// Blob layout: u16 key length, key, u16 ETag length, ETag, payload
+bool SpotifyResponseCache::load_persisted(const std::string& key) {
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return false;
+    }
+
+    char name[NVS_KEY_NAME_MAX_SIZE];
+    nvs_key(key, name, sizeof(name));
+
+    size_t size = 0;
+    std::string blob;
+    bool ok = nvs_get_blob(nvs_handle, name, nullptr, &size) == ESP_OK && size >= 4;
+    if (ok) {
+        blob.resize(size);
+        ok = nvs_get_blob(nvs_handle, name, &blob[0], &size) == ESP_OK;
+    }
+    nvs_close(nvs_handle);
+    if (!ok) {
+        return false;
+    }
+
+    size_t pos = 0;
+    uint16_t key_len = (uint8_t)blob[pos] | ((uint8_t)blob[pos + 1] << 8);
+    pos += 2;
+    if (pos + key_len + 2 > size || blob.compare(pos, key_len, key) != 0) {
+        // Hash collision with another endpoint, or a truncated record
+        return false;
+    }
+    pos += key_len;
+
+    uint16_t etag_len = (uint8_t)blob[pos] | ((uint8_t)blob[pos + 1] << 8);
+    pos += 2;
+    if (etag_len == 0 || pos + etag_len > size) {
+        return false;
+    }
+
+    Entry* entry = insert(key);
+    entry->etag = blob.substr(pos, etag_len);
+    entry->payload = blob.substr(pos + etag_len);
+    entry->persist = true;
+
+    ESP_LOGI(TAG, "Loaded cached %s (%d bytes)", key.c_str(), (int)entry->payload.length());
+    return true;
+}
+
+void SpotifyResponseCache::save_persisted(const Entry& entry) {
+    std::string blob;
+    blob.reserve(4 + entry.key.length() + entry.etag.length() + entry.payload.length());
+    blob.push_back((char)(entry.key.length() & 0xFF));
+    blob.push_back((char)(entry.key.length() >> 8));
+    blob += entry.key;
+    blob.push_back((char)(entry.etag.length() & 0xFF));
+    blob.push_back((char)(entry.etag.length() >> 8));
+    blob += entry.etag;
+    blob += entry.payload;
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to open NVS for cache: %s", esp_err_to_name(err));
+        return;
+    }
+
+    char name[NVS_KEY_NAME_MAX_SIZE];
+    nvs_key(entry.key, name, sizeof(name));
+
+    err = nvs_set_blob(nvs_handle, name, blob.data(), blob.length());
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to persist %s: %s", entry.key.c_str(), esp_err_to_name(err));
+    }
+    nvs_close(nvs_handle);
+}
+
+void SpotifyResponseCache::erase_persisted(const std::string& key) {
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK) {
+        return;
+    }
+
+    char name[NVS_KEY_NAME_MAX_SIZE];
+    nvs_key(key, name, sizeof(name));
+    if (nvs_erase_key(nvs_handle, name) == ESP_OK) {
+        nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+}
+
+// NVS keys are limited to 15 characters, so endpoints are stored by hash
+void SpotifyResponseCache::nvs_key(const std::string& key, char* out, size_t out_size) {
+    uint32_t h = 2166136261u;   // FNV-1a
+    for (char c : key) {
+        h ^= (uint8_t)c;
+        h *= 16777619u;
+    }
+    snprintf(out, out_size, "r%08lx", (unsigned long)h);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+
+/**
+ * SpotifyResponseCache - ETag cache for conditional Spotify Web API GETs
+ *
+ * Features:
+ * - Entries keyed by endpoint + query string
+ * - Each entry keeps the ETag and an optional opaque payload (the caller's
+ *   compact encoding of the parsed result), so a 304 can be answered without
+ *   re-downloading or re-parsing
+ * - Persistent entries are written to NVS and reloaded on demand after a
+ *   reboot; payloads over MAX_PERSISTED_PAYLOAD stay in RAM only
+ * - At most MAX_ENTRIES in RAM, least recently used evicted first
+ *
+ * Typical use:
+ *   std::string etag;
+ *   if (cache.get_etag(endpoint, etag)) { add If-None-Match: etag }
+ *   on 200: cache.store(endpoint, response_etag, payload, true);
+ *   on 304: const std::string* payload = cache.payload(endpoint);
+ */
+class SpotifyResponseCache {
+public:
+    static constexpr int MAX_ENTRIES = 8;
+    static constexpr size_t MAX_ETAG_LEN = 128;
+    static constexpr size_t MAX_PERSISTED_PAYLOAD = 4096;
+
+    SpotifyResponseCache();
+
+    // ETag to send as If-None-Match; loads a persisted entry on first use
+    bool get_etag(const std::string& key, std::string& etag);
+
+    // Cached payload for key, or nullptr. Valid until the next store/invalidate.
+    const std::string* payload(const std::string& key);
+
+    /**
+     * Remember the ETag (and payload) of a 200 response. An empty ETag
+     * invalidates the key, since the response cannot be revalidated.
+     */
+    void store(const std::string& key, const std::string& etag,
+               const std::string& payload = "", bool persist = false);
+
+    void invalidate(const std::string& key);
+
+    // Drop every entry, including persisted ones (e.g. on logout)
+    void clear();
+
+private:
+    struct Entry {
+        std::string key;
+        std::string etag;
+        std::string payload;
+        bool persist;
+        TickType_t last_used;
+    };
+
+    std::vector<Entry> entries;
+
+    Entry* find(const std::string& key);
+    Entry* insert(const std::string& key);
+    bool load_persisted(const std::string& key);
+    void save_persisted(const Entry& entry);
+    void erase_persisted(const std::string& key);
+
+    static void nvs_key(const std::string& key, char* out, size_t out_size);
+};
@@ -0,0 +1,176 @@
+#include "spotify_response_parser.h"
+#include "spotify_stream_parser.h"
+
+SpotifyPlaybackState SpotifyResponseParser::playback_state(cJSON* json, int image_target) {
+    SpotifyPlaybackState state = {};
+
+    if (!json) return state;
+
+    cJSON* is_playing = cJSON_GetObjectItem(json, "is_playing");
+    if (is_playing && cJSON_IsBool(is_playing)) {
+        state.is_playing = cJSON_IsTrue(is_playing);
+    }
+
+    cJSON* progress_ms = cJSON_GetObjectItem(json, "progress_ms");
+    if (progress_ms && cJSON_IsNumber(progress_ms)) {
+        state.progress_ms = cJSON_GetNumberValue(progress_ms);
+    }
+
+    cJSON* shuffle_state = cJSON_GetObjectItem(json, "shuffle_state");
+    if (shuffle_state && cJSON_IsBool(shuffle_state)) {
+        state.shuffle_state = cJSON_IsTrue(shuffle_state);
+    }
+
+    cJSON* repeat_state = cJSON_GetObjectItem(json, "repeat_state");
+    if (repeat_state && cJSON_IsString(repeat_state)) {
+        state.repeat_state = cJSON_GetStringValue(repeat_state);
+    }
+
+    cJSON* device = cJSON_GetObjectItem(json, "device");
+    if (device) {
+        cJSON* device_id = cJSON_GetObjectItem(device, "id");
+        if (device_id && cJSON_IsString(device_id)) {
+            state.device_id = cJSON_GetStringValue(device_id);
+        }
+
+        cJSON* device_name = cJSON_GetObjectItem(device, "name");
+        if (device_name && cJSON_IsString(device_name)) {
+            state.device_name = cJSON_GetStringValue(device_name);
+        }
+
+        cJSON* volume_percent = cJSON_GetObjectItem(device, "volume_percent");
+        if (volume_percent && cJSON_IsNumber(volume_percent)) {
+            state.volume_percent = cJSON_GetNumberValue(volume_percent);
+        }
+    }
+
+    cJSON* item = cJSON_GetObjectItem(json, "item");
+    if (item) {
+        state.current_track = track(item, image_target);
+    }
+
+    return state;
+}
+
+std::vector<SpotifyDevice> SpotifyResponseParser::devices(cJSON* json) {
+    std::vector<SpotifyDevice> devices;
+
+    if (!json) return devices;
+
+    cJSON* devices_array = cJSON_GetObjectItem(json, "devices");
+    if (!devices_array || !cJSON_IsArray(devices_array)) return devices;
+
+    cJSON* device;
+    cJSON_ArrayForEach(device, devices_array) {
+        SpotifyDevice dev = {};
+
+        cJSON* id = cJSON_GetObjectItem(device, "id");
+        if (id && cJSON_IsString(id)) {
+            dev.id = cJSON_GetStringValue(id);
+        }
+
+        cJSON* name = cJSON_GetObjectItem(device, "name");
+        if (name && cJSON_IsString(name)) {
+            dev.name = cJSON_GetStringValue(name);
+        }
+
+        cJSON* type = cJSON_GetObjectItem(device, "type");
+        if (type && cJSON_IsString(type)) {
+            dev.type = cJSON_GetStringValue(type);
+        }
+
+        cJSON* is_active = cJSON_GetObjectItem(device, "is_active");
+        if (is_active && cJSON_IsBool(is_active)) {
+            dev.is_active = cJSON_IsTrue(is_active);
+        }
+
+        cJSON* is_private_session = cJSON_GetObjectItem(device, "is_private_session");
+        if (is_private_session && cJSON_IsBool(is_private_session)) {
+            dev.is_private_session = cJSON_IsTrue(is_private_session);
+        }
+
+        cJSON* is_restricted = cJSON_GetObjectItem(device, "is_restricted");
+        if (is_restricted && cJSON_IsBool(is_restricted)) {
+            dev.is_restricted = cJSON_IsTrue(is_restricted);
+        }
+
+        cJSON* volume_percent = cJSON_GetObjectItem(device, "volume_percent");
+        if (volume_percent && cJSON_IsNumber(volume_percent)) {
+            dev.volume_percent = cJSON_GetNumberValue(volume_percent);
+        }
+
+        devices.push_back(dev);
+    }
+
+    return devices;
+}
+
+SpotifyTrack SpotifyResponseParser::track(cJSON* track_json, int image_target) {
+    SpotifyTrack track = {};
+
+    if (!track_json) return track;
+
+    cJSON* id = cJSON_GetObjectItem(track_json, "id");
+    if (id && cJSON_IsString(id)) {
+        track.id = cJSON_GetStringValue(id);
+    }
+
+    cJSON* name = cJSON_GetObjectItem(track_json, "name");
+    if (name && cJSON_IsString(name)) {
+        track.name = cJSON_GetStringValue(name);
+    }
+
+    cJSON* uri = cJSON_GetObjectItem(track_json, "uri");
+    if (uri && cJSON_IsString(uri)) {
+        track.uri = cJSON_GetStringValue(uri);
+    }
+
+    cJSON* duration_ms = cJSON_GetObjectItem(track_json, "duration_ms");
+    if (duration_ms && cJSON_IsNumber(duration_ms)) {
+        track.duration_ms = cJSON_GetNumberValue(duration_ms);
+    }
+
+    cJSON* preview_url = cJSON_GetObjectItem(track_json, "preview_url");
+    if (preview_url && cJSON_IsString(preview_url)) {
+        track.preview_url = cJSON_GetStringValue(preview_url);
+    }
+
+    // Parse artists
+    cJSON* artists = cJSON_GetObjectItem(track_json, "artists");
+    if (artists && cJSON_IsArray(artists)) {
+        cJSON* first_artist = cJSON_GetArrayItem(artists, 0);
+        if (first_artist) {
+            cJSON* artist_name = cJSON_GetObjectItem(first_artist, "name");
+            if (artist_name && cJSON_IsString(artist_name)) {
+                track.artist = cJSON_GetStringValue(artist_name);
+            }
+        }
+    }
+
+    // Parse album
+    cJSON* album = cJSON_GetObjectItem(track_json, "album");
+    if (album) {
+        cJSON* album_name = cJSON_GetObjectItem(album, "name");
+        if (album_name && cJSON_IsString(album_name)) {
+            track.album = cJSON_GetStringValue(album_name);
+        }
+
+        cJSON* images = cJSON_GetObjectItem(album, "images");
+        if (images && cJSON_IsArray(images)) {
+            int best_width = -1;
+            cJSON* image;
+            cJSON_ArrayForEach(image, images) {
+                cJSON* url = cJSON_GetObjectItem(image, "url");
+                cJSON* width = cJSON_GetObjectItem(image, "width");
+                int image_width = width && cJSON_IsNumber(width) ? width->valueint : 0;
+                if (url && cJSON_IsString(url) &&
+                    SpotifyStreamParser::prefer_image(image_width, best_width, image_target)) {
+                    track.image_url = cJSON_GetStringValue(url);
+                    best_width = image_width;
+                }
+            }
+        }
+    }
+
+    return track;
+}
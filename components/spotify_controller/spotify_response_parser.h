@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+#include "cJSON.h"
+#include "spotify_types.h"
+
+/**
+ * SpotifyResponseParser - Decoders for the small Web API responses read as cJSON
+ *
+ * The player state (GET /me/player) and device list (GET /me/player/devices)
+ * are small enough to parse whole; paged lists go through SpotifyStreamParser
+ * instead. No ESP-IDF dependency, so the host build can fuzz them.
+ */
+class SpotifyResponseParser {
+public:
+    /**
+     * @param image_target preferred album art width in pixels, see
+     *        SpotifyStreamParser::prefer_image()
+     */
+    static SpotifyPlaybackState playback_state(cJSON* json, int image_target);
+    static std::vector<SpotifyDevice> devices(cJSON* json);
+    static SpotifyTrack track(cJSON* track_json, int image_target);
+};
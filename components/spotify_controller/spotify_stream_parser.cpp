@@ -0,0 +1,565 @@
+#include "spotify_stream_parser.h"
+#include <cstdlib>
+#include <cstring>
+
+SpotifyStreamParser::SpotifyStreamParser(TrackSink sink)
+    : mode(MODE_TRACKS)
+    , track_sink(std::move(sink))
+    , playlist_sink(nullptr)
+    , album_sink(nullptr)
+    , artist_sink(nullptr)
+    , image_target(DEFAULT_IMAGE_TARGET) {
+    reset();
+}
+
+SpotifyStreamParser::SpotifyStreamParser(PlaylistSink sink)
+    : mode(MODE_PLAYLISTS)
+    , track_sink(nullptr)
+    , playlist_sink(std::move(sink))
+    , album_sink(nullptr)
+    , artist_sink(nullptr)
+    , image_target(DEFAULT_IMAGE_TARGET) {
+    reset();
+}
+
+SpotifyStreamParser::SpotifyStreamParser(AlbumSink sink)
+    : mode(MODE_ALBUMS)
+    , track_sink(nullptr)
+    , playlist_sink(nullptr)
+    , album_sink(std::move(sink))
+    , artist_sink(nullptr)
+    , image_target(DEFAULT_IMAGE_TARGET) {
+    reset();
+}
+
+SpotifyStreamParser::SpotifyStreamParser(ArtistSink sink)
+    : mode(MODE_ARTISTS)
+    , track_sink(nullptr)
+    , playlist_sink(nullptr)
+    , album_sink(nullptr)
+    , artist_sink(std::move(sink))
+    , image_target(DEFAULT_IMAGE_TARGET) {
+    reset();
+}
+
+void SpotifyStreamParser::reset() {
+    state = STATE_VALUE;
+    expect_key = false;
+    string_is_key = false;
+    depth = 0;
+    key[0] = '\0';
+    token_len = 0;
+    token[0] = '\0';
+    unicode_value = 0;
+    unicode_digits = 0;
+    pending_high_surrogate = 0;
+    track = SpotifyTrack();
+    playlist = SpotifyPlaylist();
+    album = SpotifyAlbum();
+    artist = SpotifyArtist();
+    emitted_count = 0;
+    item_count = 0;
+    image_url.clear();
+    image_width = 0;
+    image_best_width = -1;
+}
+
+bool SpotifyStreamParser::prefer_image(int width, int best_width, int target) {
+    if (best_width < 0) {
+        return true;
+    }
+    if (width <= 0) {
+        return false;
+    }
+    if (best_width < target) {
+        // Still below target (or unknown): anything bigger is an improvement
+        return width > best_width;
+    }
+    return width >= target && width < best_width;
+}
+
+bool SpotifyStreamParser::feed(const char* data, size_t length) {
+    for (size_t i = 0; i < length && state != STATE_ERROR; i++) {
+        if (!process(data[i])) {
+            state = STATE_ERROR;
+        }
+    }
+    return state != STATE_ERROR;
+}
+
+bool SpotifyStreamParser::finish() {
+    // A bare top-level literal has no delimiter after it
+    if (state == STATE_BARE && depth == 0) {
+        end_value();
+        state = STATE_DONE;
+    }
+    return state == STATE_DONE && depth == 0;
+}
+
+static bool is_whitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool SpotifyStreamParser::process(char c) {
+    switch (state) {
+        case STATE_VALUE:
+            if (is_whitespace(c)) {
+                return true;
+            }
+            if (c == '{') {
+                return begin_container(true);
+            }
+            if (c == '[') {
+                return begin_container(false);
+            }
+            // Empty object / array
+            if (c == '}' && depth > 0 && stack[depth - 1].is_object && expect_key) {
+                return end_container(true);
+            }
+            if (c == ']' && depth > 0 && !stack[depth - 1].is_object) {
+                return end_container(false);
+            }
+            if (c == '"') {
+                string_is_key = depth > 0 && stack[depth - 1].is_object && expect_key;
+                token_len = 0;
+                pending_high_surrogate = 0;
+                state = STATE_STRING;
+                return true;
+            }
+            if (expect_key) {
+                return false;
+            }
+            if (c == '-' || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z')) {
+                token_len = 0;
+                append_token(c);
+                state = STATE_BARE;
+                return true;
+            }
+            return false;
+
+        case STATE_STRING:
+            if (c == '\\') {
+                state = STATE_ESCAPE;
+            } else if (c == '"') {
+                token[token_len] = '\0';
+                if (string_is_key) {
+                    strncpy(key, token, sizeof(key) - 1);
+                    key[sizeof(key) - 1] = '\0';
+                    state = STATE_COLON;
+                } else {
+                    on_string(depth > 0 ? stack[depth - 1].ctx : CTX_IGNORED, token);
+                    end_value();
+                }
+            } else {
+                append_token(c);
+            }
+            return true;
+
+        case STATE_ESCAPE:
+            state = STATE_STRING;
+            switch (c) {
+                case '"':  append_token('"'); return true;
+                case '\\': append_token('\\'); return true;
+                case '/':  append_token('/'); return true;
+                case 'b':  append_token('\b'); return true;
+                case 'f':  append_token('\f'); return true;
+                case 'n':  append_token('\n'); return true;
+                case 'r':  append_token('\r'); return true;
+                case 't':  append_token('\t'); return true;
+                case 'u':
+                    unicode_value = 0;
+                    unicode_digits = 0;
+                    state = STATE_UNICODE;
+                    return true;
+                default:
+                    return false;
+            }
+
+        case STATE_UNICODE: {
+            uint32_t digit;
+            if (c >= '0' && c <= '9') {
+                digit = c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                digit = c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                digit = c - 'A' + 10;
+            } else {
+                return false;
+            }
+            unicode_value = (unicode_value << 4) | digit;
+            if (++unicode_digits < 4) {
+                return true;
+            }
+            state = STATE_STRING;
+            if (unicode_value >= 0xD800 && unicode_value <= 0xDBFF) {
+                pending_high_surrogate = unicode_value;
+            } else if (unicode_value >= 0xDC00 && unicode_value <= 0xDFFF) {
+                if (pending_high_surrogate) {
+                    append_utf8(0x10000 + ((pending_high_surrogate - 0xD800) << 10) +
+                                (unicode_value - 0xDC00));
+                } else {
+                    append_token('?');
+                }
+                pending_high_surrogate = 0;
+            } else {
+                append_utf8(unicode_value);
+            }
+            return true;
+        }
+
+        case STATE_BARE:
+            if (c == ',' || c == '}' || c == ']' || is_whitespace(c)) {
+                token[token_len] = '\0';
+                if (token[0] == '-' || (token[0] >= '0' && token[0] <= '9')) {
+                    on_number(depth > 0 ? stack[depth - 1].ctx : CTX_IGNORED, token);
+                } else if (strcmp(token, "true") != 0 && strcmp(token, "false") != 0 &&
+                           strcmp(token, "null") != 0) {
+                    return false;
+                }
+                end_value();
+                return process(c);
+            }
+            append_token(c);
+            return true;
+
+        case STATE_COLON:
+            if (is_whitespace(c)) {
+                return true;
+            }
+            if (c != ':') {
+                return false;
+            }
+            expect_key = false;
+            state = STATE_VALUE;
+            return true;
+
+        case STATE_AFTER_VALUE:
+            if (is_whitespace(c)) {
+                return true;
+            }
+            if (depth == 0) {
+                return false;
+            }
+            if (c == ',') {
+                Frame& top = stack[depth - 1];
+                if (!top.is_object) {
+                    top.index++;
+                }
+                expect_key = top.is_object;
+                state = STATE_VALUE;
+                return true;
+            }
+            if (c == '}') {
+                return end_container(true);
+            }
+            if (c == ']') {
+                return end_container(false);
+            }
+            return false;
+
+        case STATE_DONE:
+            return is_whitespace(c);
+
+        case STATE_ERROR:
+        default:
+            return false;
+    }
+}
+
+bool SpotifyStreamParser::begin_container(bool is_object) {
+    if (depth >= MAX_DEPTH) {
+        return false;
+    }
+
+    Frame frame;
+    frame.ctx = depth == 0 ? CTX_ROOT : child_context(stack[depth - 1], !is_object);
+    frame.is_object = is_object;
+    frame.index = 0;
+
+    // The root must be an object; a root array is not a Spotify page
+    if (depth == 0 && !is_object) {
+        frame.ctx = CTX_IGNORED;
+    }
+
+    stack[depth++] = frame;
+    expect_key = is_object;
+    state = STATE_VALUE;
+    return true;
+}
+
+bool SpotifyStreamParser::end_container(bool is_object) {
+    if (depth == 0 || stack[depth - 1].is_object != is_object) {
+        return false;
+    }
+
+    Context ctx = stack[depth - 1].ctx;
+    depth--;
+    if (ctx == CTX_IMAGE) {
+        on_image_end();
+    } else if (ctx == CTX_ITEM) {
+        on_item_end();
+    }
+    end_value();
+    return true;
+}
+
+void SpotifyStreamParser::end_value() {
+    state = depth == 0 ? STATE_DONE : STATE_AFTER_VALUE;
+}
+
+void SpotifyStreamParser::append_token(char c) {
+    // Overlong values are truncated; nothing we keep needs more
+    if (token_len + 1 < sizeof(token)) {
+        token[token_len++] = c;
+    }
+}
+
+void SpotifyStreamParser::append_utf8(uint32_t cp) {
+    if (cp < 0x80) {
+        append_token((char)cp);
+    } else if (cp < 0x800) {
+        append_token((char)(0xC0 | (cp >> 6)));
+        append_token((char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        append_token((char)(0xE0 | (cp >> 12)));
+        append_token((char)(0x80 | ((cp >> 6) & 0x3F)));
+        append_token((char)(0x80 | (cp & 0x3F)));
+    } else {
+        append_token((char)(0xF0 | (cp >> 18)));
+        append_token((char)(0x80 | ((cp >> 12) & 0x3F)));
+        append_token((char)(0x80 | ((cp >> 6) & 0x3F)));
+        append_token((char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+SpotifyStreamParser::Context SpotifyStreamParser::child_context(const Frame& parent, bool is_array) const {
+    // Array elements have no key; only the first artist is kept, and every
+    // image is looked at so the best-sized variant can be picked
+    if (!parent.is_object) {
+        switch (parent.ctx) {
+            case CTX_ITEMS:   return is_array ? CTX_IGNORED : CTX_ITEM;
+            case CTX_ARTISTS: return (!is_array && parent.index == 0) ? CTX_ARTIST : CTX_IGNORED;
+            case CTX_IMAGES:  return is_array ? CTX_IGNORED : CTX_IMAGE;
+            default:          return CTX_IGNORED;
+        }
+    }
+
+    switch (parent.ctx) {
+        case CTX_ROOT:
+            if (is_array && strcmp(key, "items") == 0) return CTX_ITEMS;
+            if (!is_array && mode == MODE_TRACKS && strcmp(key, "tracks") == 0) return CTX_SEARCH_RESULTS;
+            // Queue entries are bare tracks, like search results
+            if (is_array && mode == MODE_TRACKS && strcmp(key, "queue") == 0) return CTX_ITEMS;
+            // Several-item lookups: {"tracks": [...]}, {"albums": [...]}, {"artists": [...]}
+            if (is_array && mode == MODE_TRACKS && strcmp(key, "tracks") == 0) return CTX_ITEMS;
+            if (is_array && mode == MODE_ALBUMS && strcmp(key, "albums") == 0) return CTX_ITEMS;
+            if (is_array && mode == MODE_ARTISTS && strcmp(key, "artists") == 0) return CTX_ITEMS;
+            break;
+        case CTX_SEARCH_RESULTS:
+            if (is_array && strcmp(key, "items") == 0) return CTX_ITEMS;
+            break;
+        case CTX_ITEM:
+            if (mode == MODE_PLAYLISTS) {
+                if (!is_array && strcmp(key, "tracks") == 0) return CTX_PLAYLIST_TRACKS;
+                if (!is_array && strcmp(key, "owner") == 0) return CTX_OWNER;
+                if (is_array && strcmp(key, "images") == 0) return CTX_IMAGES;
+                break;
+            }
+            if (mode == MODE_ALBUMS) {
+                if (is_array && strcmp(key, "artists") == 0) return CTX_ARTISTS;
+                if (is_array && strcmp(key, "images") == 0) return CTX_IMAGES;
+                break;
+            }
+            if (mode == MODE_ARTISTS) {
+                if (is_array && strcmp(key, "images") == 0) return CTX_IMAGES;
+                break;
+            }
+            if (!is_array && strcmp(key, "track") == 0) return CTX_TRACK;
+            // Search results carry the track fields on the item itself
+            if (is_array && strcmp(key, "artists") == 0) return CTX_ARTISTS;
+            if (!is_array && strcmp(key, "album") == 0) return CTX_ALBUM;
+            break;
+        case CTX_TRACK:
+            if (is_array && strcmp(key, "artists") == 0) return CTX_ARTISTS;
+            if (!is_array && strcmp(key, "album") == 0) return CTX_ALBUM;
+            break;
+        case CTX_ALBUM:
+            if (is_array && strcmp(key, "images") == 0) return CTX_IMAGES;
+            break;
+        default:
+            break;
+    }
+    return CTX_IGNORED;
+}
+
+void SpotifyStreamParser::on_string(Context ctx, const char* value) {
+    if (mode == MODE_PLAYLISTS) {
+        switch (ctx) {
+            case CTX_ITEM:
+                if (strcmp(key, "id") == 0) playlist.id = value;
+                else if (strcmp(key, "name") == 0) playlist.name = value;
+                else if (strcmp(key, "description") == 0) playlist.description = value;
+                else if (strcmp(key, "uri") == 0) playlist.uri = value;
+                break;
+            case CTX_IMAGE:
+                if (strcmp(key, "url") == 0) image_url = value;
+                break;
+            case CTX_OWNER:
+                if (strcmp(key, "display_name") == 0) playlist.owner = value;
+                break;
+            default:
+                break;
+        }
+        return;
+    }
+
+    if (mode == MODE_ALBUMS) {
+        switch (ctx) {
+            case CTX_ITEM:
+                if (strcmp(key, "id") == 0) album.id = value;
+                else if (strcmp(key, "name") == 0) album.name = value;
+                else if (strcmp(key, "uri") == 0) album.uri = value;
+                break;
+            case CTX_ARTIST:
+                if (strcmp(key, "name") == 0) album.artist = value;
+                break;
+            case CTX_IMAGE:
+                if (strcmp(key, "url") == 0) image_url = value;
+                break;
+            default:
+                break;
+        }
+        return;
+    }
+
+    if (mode == MODE_ARTISTS) {
+        switch (ctx) {
+            case CTX_ITEM:
+                if (strcmp(key, "id") == 0) artist.id = value;
+                else if (strcmp(key, "name") == 0) artist.name = value;
+                else if (strcmp(key, "uri") == 0) artist.uri = value;
+                break;
+            case CTX_IMAGE:
+                if (strcmp(key, "url") == 0) image_url = value;
+                break;
+            default:
+                break;
+        }
+        return;
+    }
+
+    switch (ctx) {
+        case CTX_ITEM:
+        case CTX_TRACK:
+            if (strcmp(key, "id") == 0) track.id = value;
+            else if (strcmp(key, "name") == 0) track.name = value;
+            else if (strcmp(key, "uri") == 0) track.uri = value;
+            else if (strcmp(key, "preview_url") == 0) track.preview_url = value;
+            break;
+        case CTX_ARTIST:
+            if (strcmp(key, "name") == 0) track.artist = value;
+            break;
+        case CTX_ALBUM:
+            if (strcmp(key, "name") == 0) track.album = value;
+            break;
+        case CTX_IMAGE:
+            if (strcmp(key, "url") == 0) image_url = value;
+            break;
+        default:
+            break;
+    }
+}
+
+void SpotifyStreamParser::on_number(Context ctx, const char* value) {
+    if (ctx == CTX_IMAGE) {
+        if (strcmp(key, "width") == 0) image_width = atoi(value);
+        return;
+    }
+
+    if (mode == MODE_PLAYLISTS) {
+        if (ctx == CTX_PLAYLIST_TRACKS && strcmp(key, "total") == 0) {
+            playlist.track_count = atoi(value);
+        }
+        return;
+    }
+
+    if (mode == MODE_ALBUMS) {
+        if (ctx == CTX_ITEM && strcmp(key, "total_tracks") == 0) {
+            album.track_count = atoi(value);
+        }
+        return;
+    }
+
+    if (mode == MODE_ARTISTS) {
+        return;
+    }
+
+    if ((ctx == CTX_ITEM || ctx == CTX_TRACK) && strcmp(key, "duration_ms") == 0) {
+        track.duration_ms = atoi(value);
+    }
+}
+
+std::string& SpotifyStreamParser::best_image_url() {
+    switch (mode) {
+        case MODE_PLAYLISTS: return playlist.image_url;
+        case MODE_ALBUMS:    return album.image_url;
+        case MODE_ARTISTS:   return artist.image_url;
+        default:             return track.image_url;
+    }
+}
+
+void SpotifyStreamParser::on_image_end() {
+    if (!image_url.empty() && prefer_image(image_width, image_best_width, image_target)) {
+        best_image_url().swap(image_url);
+        image_best_width = image_width;
+    }
+    image_url.clear();
+    image_width = 0;
+}
+
+void SpotifyStreamParser::on_item_end() {
+    image_best_width = -1;
+    item_count++;
+    if (mode == MODE_PLAYLISTS) {
+        if (!playlist.id.empty() || !playlist.uri.empty()) {
+            emitted_count++;
+            if (playlist_sink) {
+                playlist_sink(playlist);
+            }
+        }
+        playlist = SpotifyPlaylist();
+        return;
+    }
+
+    // Unknown ids in a lookup come back as null entries; nothing to emit
+    if (mode == MODE_ALBUMS) {
+        if (!album.id.empty()) {
+            emitted_count++;
+            if (album_sink) {
+                album_sink(album);
+            }
+        }
+        album = SpotifyAlbum();
+        return;
+    }
+
+    if (mode == MODE_ARTISTS) {
+        if (!artist.id.empty()) {
+            emitted_count++;
+            if (artist_sink) {
+                artist_sink(artist);
+            }
+        }
+        artist = SpotifyArtist();
+        return;
+    }
+
+    // Unavailable entries come back as "track": null; nothing to emit
+    if (!track.id.empty() || !track.uri.empty()) {
+        emitted_count++;
+        if (track_sink) {
+            track_sink(track);
+        }
+    }
+    track = SpotifyTrack();
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include "spotify_types.h"
+
+/**
+ * SpotifyStreamParser - Incremental JSON parser for Spotify paging responses
+ *
+ * Features:
+ * - Push interface: feed() accepts the body in arbitrary chunks as they
+ *   arrive from HTTP_EVENT_ON_DATA, including chunked transfer encoding
+ * - Emits one SpotifyTrack / SpotifyPlaylist / SpotifyAlbum / SpotifyArtist
+ *   per entry into a caller-provided sink, so peak memory is one record,
+ *   not the whole page
+ * - Understands playlist track pages (items[].track), search results
+ *   (tracks.items[]), the player queue (queue[]), playlist pages (items[])
+ *   and several-item lookups (tracks[], albums[], artists[])
+ * - Only known paths are decoded; everything else is skipped unstored
+ * - Of the image variants, keeps the smallest one at least as wide as the
+ *   image target (or the widest if none is), see prefer_image()
+ * - Bounded nesting depth and truncating token buffer
+ *
+ * Typical use:
+ *   SpotifyStreamParser parser([&](const SpotifyTrack& track) { ... });
+ *   parser.feed(chunk, chunk_len);   // repeatedly
+ *   bool ok = parser.finish();
+ */
+class SpotifyStreamParser {
+public:
+    using TrackSink = std::function<void(const SpotifyTrack&)>;
+    using PlaylistSink = std::function<void(const SpotifyPlaylist&)>;
+    using AlbumSink = std::function<void(const SpotifyAlbum&)>;
+    using ArtistSink = std::function<void(const SpotifyArtist&)>;
+
+    static constexpr int MAX_DEPTH = 16;
+    static constexpr size_t MAX_TOKEN_LEN = 512;
+    static constexpr size_t MAX_KEY_LEN = 32;
+    static constexpr int DEFAULT_IMAGE_TARGET = 300;    // Pixels; Spotify serves 64, 300 and 640
+
+    /**
+     * Image variant choice: true if an image of width should replace the
+     * current best (best_width < 0: none yet, 0: width unknown).
+     */
+    static bool prefer_image(int width, int best_width, int target);
+
+    explicit SpotifyStreamParser(TrackSink sink);
+    explicit SpotifyStreamParser(PlaylistSink sink);
+    explicit SpotifyStreamParser(AlbumSink sink);
+    explicit SpotifyStreamParser(ArtistSink sink);
+
+    /**
+     * Consume the next chunk of the response body.
+     * @return false once the input is known to be malformed
+     */
+    bool feed(const char* data, size_t length);
+
+    /**
+     * Signal end of input.
+     * @return true if a complete JSON document was parsed
+     */
+    bool finish();
+
+    size_t emitted() const { return emitted_count; }
+    // Entries seen, including unavailable ones that were not emitted; a
+    // page with fewer than its limit is the last one
+    size_t items() const { return item_count; }
+    void set_image_target(int pixels) { image_target = pixels; }
+
+private:
+    enum Mode {
+        MODE_TRACKS,
+        MODE_PLAYLISTS,
+        MODE_ALBUMS,
+        MODE_ARTISTS
+    };
+
+    enum Context : uint8_t {
+        CTX_ROOT,
+        CTX_SEARCH_RESULTS,     // search: root.tracks
+        CTX_ITEMS,
+        CTX_ITEM,
+        CTX_TRACK,              // playlist page: items[].track
+        CTX_ARTISTS,
+        CTX_ARTIST,
+        CTX_ALBUM,
+        CTX_IMAGES,
+        CTX_IMAGE,
+        CTX_PLAYLIST_TRACKS,    // playlist page: items[].tracks {total}
+        CTX_OWNER,
+        CTX_IGNORED
+    };
+
+    enum State : uint8_t {
+        STATE_VALUE,
+        STATE_STRING,
+        STATE_ESCAPE,
+        STATE_UNICODE,
+        STATE_BARE,
+        STATE_COLON,
+        STATE_AFTER_VALUE,
+        STATE_DONE,
+        STATE_ERROR
+    };
+
+    struct Frame {
+        Context ctx;
+        bool is_object;
+        uint16_t index;
+    };
+
+    Mode mode;
+    TrackSink track_sink;
+    PlaylistSink playlist_sink;
+    AlbumSink album_sink;
+    ArtistSink artist_sink;
+
+    State state;
+    bool expect_key;
+    bool string_is_key;
+    Frame stack[MAX_DEPTH];
+    int depth;
+
+    char key[MAX_KEY_LEN];
+    char token[MAX_TOKEN_LEN];
+    size_t token_len;
+    uint32_t unicode_value;
+    uint8_t unicode_digits;
+    uint32_t pending_high_surrogate;
+
+    SpotifyTrack track;
+    SpotifyPlaylist playlist;
+    SpotifyAlbum album;
+    SpotifyArtist artist;
+    size_t emitted_count;
+    size_t item_count;
+
+    // Image variant being read and the best one kept for the current item
+    std::string image_url;
+    int image_width;
+    int image_best_width;
+    int image_target;
+
+    void reset();
+    bool process(char c);
+    bool begin_container(bool is_object);
+    bool end_container(bool is_object);
+    void end_value();
+    void append_token(char c);
+    void append_utf8(uint32_t codepoint);
+
+    Context child_context(const Frame& parent, bool is_array) const;
+    void on_string(Context ctx, const char* value);
+    void on_number(Context ctx, const char* value);
+    std::string& best_image_url();
+    void on_image_end();
+    void on_item_end();
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+
+/*
+ * Records the Spotify Web API parsers produce. Plain C++ with no ESP-IDF
+ * dependency, so the parsers also build for the host (see host_test/).
+ */
+
+/**
+ * @brief Spotify track information
+ */
+struct SpotifyTrack {
+    std::string id;
+    std::string name;
+    std::string artist;
+    std::string album;
+    std::string uri;
+    int duration_ms;
+    std::string preview_url;
+    std::string image_url;
+};
+
+/**
+ * @brief Spotify playlist information
+ */
+struct SpotifyPlaylist {
+    std::string id;
+    std::string name;
+    std::string description;
+    std::string uri;
+    int track_count;
+    std::string image_url;
+    std::string owner;
+};
+
+/**
+ * @brief Spotify album information
+ */
+struct SpotifyAlbum {
+    std::string id;
+    std::string name;
+    std::string artist;
+    std::string uri;
+    int track_count;
+    std::string image_url;
+};
+
+/**
+ * @brief Spotify artist information
+ */
+struct SpotifyArtist {
+    std::string id;
+    std::string name;
+    std::string uri;
+    std::string image_url;
+};
+
+/**
+ * @brief Spotify playback state
+ */
+struct SpotifyPlaybackState {
+    bool is_playing;
+    int progress_ms;
+    int volume_percent;
+    bool shuffle_state;
+    std::string repeat_state; // "off", "track", "context"
+    SpotifyTrack current_track;
+    std::string device_id;
+    std::string device_name;
+};
+
+/**
+ * @brief Spotify device information
+ */
+struct SpotifyDevice {
+    std::string id;
+    std::string name;
+    std::string type;
+    bool is_active;
+    bool is_private_session;
+    bool is_restricted;
+    int volume_percent;
+};
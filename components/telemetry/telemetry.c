@@ -0,0 +1,269 @@
+#include "telemetry.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "mbedtls/base64.h"
+
+static const char *TAG = "telemetry";
+
+#define INTERNAL_CAPS   (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static telemetry_counter_t current[TELEMETRY_METRIC_COUNT];    // Open window; internal, ISRs write it
+static uint32_t lvgl_used;                                      // Latest telemetry_set_lvgl_mem()
+static uint32_t lvgl_largest;
+static telemetry_sample_t *ring;                                // Closed windows
+static size_t ring_head;                                        // Next slot to write
+static size_t ring_count;
+static esp_timer_handle_t sample_timer;
+static telemetry_boot_t boot[TELEMETRY_BOOT_PHASE_COUNT];      // Under lock
+static telemetry_storage_t storage;                             // Under lock
+static SemaphoreHandle_t task_mutex;                          // The task table's static buffers
+
+void telemetry_record(telemetry_metric_t metric, uint32_t value) {
+    if ((unsigned)metric >= TELEMETRY_METRIC_COUNT) {
+        return;
+    }
+    uint16_t clamped = value > 0xFFFF ? 0xFFFF : (uint16_t)value;
+    portENTER_CRITICAL_SAFE(&lock);
+    telemetry_counter_t *c = &current[metric];
+    if (c->count < 0xFFFF) {
+        c->count++;
+    }
+    c->sum += value;
+    if (clamped > c->max) {
+        c->max = clamped;
+    }
+    portEXIT_CRITICAL_SAFE(&lock);
+}
+
+void telemetry_set_lvgl_mem(uint32_t used, uint32_t largest_free) {
+    portENTER_CRITICAL(&lock);
+    lvgl_used = used;
+    lvgl_largest = largest_free;
+    portEXIT_CRITICAL(&lock);
+}
+
+static void sample_timer_cb(void *arg) {
+    telemetry_sample_t sample;
+    sample.uptime_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    sample.internal_free = heap_caps_get_free_size(INTERNAL_CAPS);
+    sample.internal_min = heap_caps_get_minimum_free_size(INTERNAL_CAPS);
+    sample.internal_largest = heap_caps_get_largest_free_block(INTERNAL_CAPS);
+    sample.psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    sample.psram_largest = heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM);
+
+    portENTER_CRITICAL(&lock);
+    sample.lvgl_used = lvgl_used;
+    sample.lvgl_largest = lvgl_largest;
+    memcpy(sample.metrics, current, sizeof(current));
+    memset(current, 0, sizeof(current));
+    ring[ring_head] = sample;
+    ring_head = (ring_head + 1) % TELEMETRY_RING_LEN;
+    if (ring_count < TELEMETRY_RING_LEN) {
+        ring_count++;
+    }
+    portEXIT_CRITICAL(&lock);
+}
+
+bool telemetry_init(void) {
+    if (ring) {
+        return true;
+    }
+    // Read a few times a minute, so PSRAM is fine; producers never touch it
+    ring = heap_caps_calloc(TELEMETRY_RING_LEN, sizeof(telemetry_sample_t), MALLOC_CAP_SPIRAM);
+    if (!ring) {
+        ring = heap_caps_calloc(TELEMETRY_RING_LEN, sizeof(telemetry_sample_t), INTERNAL_CAPS);
+    }
+    if (!ring) {
+        ESP_LOGE(TAG, "No memory for the telemetry ring");
+        return false;
+    }
+
+    task_mutex = xSemaphoreCreateMutex();
+
+    const esp_timer_create_args_t args = {
+        .callback = sample_timer_cb,
+        .name = "telemetry",
+        .skip_unhandled_events = true,
+    };
+    if (esp_timer_create(&args, &sample_timer) != ESP_OK ||
+        esp_timer_start_periodic(sample_timer, TELEMETRY_PERIOD_MS * 1000ULL) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the telemetry timer");
+        return false;
+    }
+    return true;
+}
+
+void telemetry_boot_phase(telemetry_boot_phase_t phase, int64_t start_us, int64_t end_us) {
+    if ((unsigned)phase >= TELEMETRY_BOOT_PHASE_COUNT) {
+        return;
+    }
+    portENTER_CRITICAL(&lock);
+    boot[phase].start_ms = (uint32_t)(start_us / 1000);
+    boot[phase].duration_ms = (uint32_t)((end_us - start_us + 500) / 1000);
+    portEXIT_CRITICAL(&lock);
+}
+
+void telemetry_get_boot(telemetry_boot_t *out) {
+    portENTER_CRITICAL(&lock);
+    memcpy(out, boot, sizeof(boot));
+    portEXIT_CRITICAL(&lock);
+}
+
+void telemetry_set_storage(const telemetry_storage_t *record) {
+    portENTER_CRITICAL(&lock);
+    storage = *record;
+    portEXIT_CRITICAL(&lock);
+}
+
+void telemetry_get_storage(telemetry_storage_t *out) {
+    portENTER_CRITICAL(&lock);
+    *out = storage;
+    portEXIT_CRITICAL(&lock);
+}
+
+size_t telemetry_get_samples(telemetry_sample_t *out, size_t max) {
+    if (!ring) {
+        return 0;
+    }
+    size_t n = 0;
+    portENTER_CRITICAL(&lock);
+    for (; n < max && n < ring_count; n++) {
+        out[n] = ring[(ring_head + TELEMETRY_RING_LEN - 1 - n) % TELEMETRY_RING_LEN];
+    }
+    portEXIT_CRITICAL(&lock);
+    return n;
+}
+
+size_t telemetry_get_tasks(telemetry_task_t *out, size_t max) {
+#if configUSE_TRACE_FACILITY
+    // Static: TaskStatus_t is too large for callers' stacks; serialised by task_mutex
+    static TaskStatus_t status[TELEMETRY_MAX_TASKS];
+    static struct {
+        TaskHandle_t handle;
+        configRUN_TIME_COUNTER_TYPE runtime;
+    } previous[TELEMETRY_MAX_TASKS];
+    static size_t previous_count;
+    static configRUN_TIME_COUNTER_TYPE previous_total;
+
+    if (!task_mutex) {
+        return 0;
+    }
+    xSemaphoreTake(task_mutex, portMAX_DELAY);
+
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t count = uxTaskGetSystemState(status, TELEMETRY_MAX_TASKS, &total);
+    configRUN_TIME_COUNTER_TYPE elapsed = total - previous_total;
+
+    size_t n = 0;
+    for (UBaseType_t i = 0; i < count && n < max; i++) {
+        telemetry_task_t *t = &out[n++];
+        memset(t, 0, sizeof(*t));
+        strncpy(t->name, status[i].pcTaskName, sizeof(t->name) - 1);
+        t->stack_free = status[i].usStackHighWaterMark;    // Bytes on ESP-IDF
+        t->priority = (uint8_t)status[i].uxCurrentPriority;
+        BaseType_t core = xTaskGetCoreID(status[i].xHandle);
+        t->core = core == tskNO_AFFINITY ? -1 : (int8_t)core;
+
+        for (size_t j = 0; j < previous_count; j++) {
+            if (previous[j].handle == status[i].xHandle && elapsed > 0) {
+                uint64_t busy = (uint64_t)(status[i].ulRunTimeCounter - previous[j].runtime) * 100 / elapsed;
+                t->cpu_percent = busy > 100 ? 100 : (uint8_t)busy;
+                break;
+            }
+        }
+    }
+
+    previous_count = count;
+    for (UBaseType_t i = 0; i < count; i++) {
+        previous[i].handle = status[i].xHandle;
+        previous[i].runtime = status[i].ulRunTimeCounter;
+    }
+    previous_total = total;
+
+    xSemaphoreGive(task_mutex);
+    return n;
+#else
+    return 0;
+#endif
+}
+
+size_t telemetry_dump(uint8_t *buf, size_t size) {
+    if (size < 12) {
+        return 0;
+    }
+    size_t max_samples = (size - 12) / sizeof(telemetry_sample_t);
+    if (max_samples > TELEMETRY_RING_LEN) {
+        max_samples = TELEMETRY_RING_LEN;
+    }
+
+    // Newest first from the ring; reversed into the dump
+    telemetry_sample_t *samples = (telemetry_sample_t *)(buf + 12);
+    size_t sample_count = telemetry_get_samples(samples, max_samples);
+    for (size_t i = 0; i < sample_count / 2; i++) {
+        telemetry_sample_t tmp = samples[i];
+        samples[i] = samples[sample_count - 1 - i];
+        samples[sample_count - 1 - i] = tmp;
+    }
+
+    size_t used = 12 + sample_count * sizeof(telemetry_sample_t);
+    size_t task_count = telemetry_get_tasks((telemetry_task_t *)(buf + used), (size - used) / sizeof(telemetry_task_t));
+    used += task_count * sizeof(telemetry_task_t);
+
+    size_t boot_count = 0;
+    if (size - used >= sizeof(boot)) {
+        telemetry_get_boot((telemetry_boot_t *)(buf + used));
+        boot_count = TELEMETRY_BOOT_PHASE_COUNT;
+        used += sizeof(boot);
+        if (size - used >= sizeof(storage)) {
+            telemetry_get_storage((telemetry_storage_t *)(buf + used));
+            used += sizeof(storage);
+            if (size - used >= 1 + MEM_TAG_COUNT * sizeof(mem_tag_stats_t)) {
+                buf[used++] = MEM_TAG_COUNT;
+                mem_tag_get_stats((mem_tag_stats_t *)(buf + used));
+                used += MEM_TAG_COUNT * sizeof(mem_tag_stats_t);
+                if (size - used >= 1) {
+                    size_t stall_count = telemetry_get_ui_stalls((telemetry_ui_stall_t *)(buf + used + 1),
+                                                                 (size - used - 1) / sizeof(telemetry_ui_stall_t));
+                    buf[used++] = (uint8_t)stall_count;
+                    used += stall_count * sizeof(telemetry_ui_stall_t);
+                }
+            }
+        }
+    }
+
+    uint32_t magic = TELEMETRY_DUMP_MAGIC;
+    uint16_t period = TELEMETRY_PERIOD_MS;
+    uint16_t sample_size = sizeof(telemetry_sample_t);
+    memcpy(buf, &magic, 4);
+    buf[4] = TELEMETRY_METRIC_COUNT;
+    buf[5] = (uint8_t)sample_count;
+    buf[6] = (uint8_t)task_count;
+    buf[7] = (uint8_t)boot_count;
+    memcpy(buf + 8, &period, 2);
+    memcpy(buf + 10, &sample_size, 2);
+    return used;
+}
+
+void telemetry_dump_console(void) {
+    size_t text_size = (TELEMETRY_DUMP_MAX_SIZE + 2) / 3 * 4 + 1;
+    uint8_t *raw = heap_caps_malloc(TELEMETRY_DUMP_MAX_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    unsigned char *text = heap_caps_malloc(text_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (raw && text) {
+        size_t len = telemetry_dump(raw, TELEMETRY_DUMP_MAX_SIZE);
+        size_t text_len = 0;
+        if (mbedtls_base64_encode(text, text_size, &text_len, raw, len) == 0) {
+            printf("TELEMETRY %.*s\n", (int)text_len, (const char *)text);
+        }
+    } else {
+        ESP_LOGW(TAG, "No memory for the telemetry dump");
+    }
+    heap_caps_free(raw);
+    heap_caps_free(text);
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "mem_tag.h"
+#include "telemetry_hist.h"
+#include "telemetry_ui.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Telemetry - heap, task and latency counters in a fixed-size ring
+ *
+ * Producers call telemetry_record() on their hot paths (any task, or an
+ * ISR): it adds the value to the current window's count, sum and max for
+ * that metric under a spinlock, and nothing else. Every
+ * TELEMETRY_PERIOD_MS an esp_timer closes the window and stores it, with
+ * a heap snapshot, in a ring of TELEMETRY_RING_LEN samples; nothing
+ * allocates after telemetry_init().
+ *
+ * The LVGL heap can only be walked on the LVGL thread, which reports its
+ * usage with telemetry_set_lvgl_mem(); each sample carries the latest report.
+ *
+ * Per-task stack high-water marks and CPU use come from FreeRTOS run-time
+ * stats and are read on demand (telemetry_get_tasks()), not sampled.
+ *
+ * Boot phases are timed once (telemetry_boot_phase()) and kept apart from
+ * the ring, which would have rotated them out a minute after boot; so is
+ * the SD card's bus and measured throughput (telemetry_set_storage()).
+ * Memory per subsystem (mem_tag.h) is read when the dump is made. LVGL
+ * passes and callbacks over the frame budget are kept in a ring of their
+ * own (telemetry_ui.h), and latency distributions since boot in fixed
+ * histograms (telemetry_hist.h).
+ *
+ * The ring and the task table can be dumped as one little-endian blob
+ * (telemetry_dump(), layout below): on the console as a base64 line, or
+ * from GET /telemetry when TELEMETRY_HTTP is enabled.
+ */
+
+#define TELEMETRY_PERIOD_MS     1000
+#define TELEMETRY_RING_LEN      60          // One minute at TELEMETRY_PERIOD_MS
+#define TELEMETRY_MAX_TASKS     32
+#define TELEMETRY_DUMP_MAGIC    0x314D4C54  // "TLM1"
+
+typedef enum {
+    TELEMETRY_LVGL_FRAME,       // ms to render and flush one refresh; count per window is the FPS
+    TELEMETRY_CAST_RTT,         // ms from a Cast request to its answer
+    TELEMETRY_TLS_HANDSHAKE,    // ms for a Cast TLS handshake
+    TELEMETRY_HTTP_LATENCY,     // ms for one Spotify Web API request
+    TELEMETRY_AUDIO_UNDERRUN,   // 1 per time the I2S DMA ran dry while playing
+    TELEMETRY_CAST_RX_LATENCY,  // us from reading Cast frames to their callbacks returning
+    TELEMETRY_SYNC_ERROR,       // us a multi-room block was heard off its due time, per block
+    TELEMETRY_UI_STALL,         // ms of an LVGL pass or callback over budget (telemetry_ui.h)
+    TELEMETRY_AUDIO_DECODE,     // us to read and decode one frame of a local file
+    TELEMETRY_AUDIO_DEPTH,      // ms buffered ahead of the DAC, PCM ring + DMA, per Audio_Depth step
+    TELEMETRY_METRIC_COUNT
+} telemetry_metric_t;
+
+typedef enum {
+    TELEMETRY_BOOT_POWER,       // Power rails, key, battery ADC, I2C and the IO expander
+    TELEMETRY_BOOT_DISPLAY,     // Panel, backlight, touch, LVGL and the splash on screen
+    TELEMETRY_BOOT_STORAGE,     // Flash FAT partition (fonts)
+    TELEMETRY_BOOT_SENSORS,     // RTC and IMU
+    TELEMETRY_BOOT_NETWORK,     // Wi-Fi manager, mDNS discovery and the local servers
+    TELEMETRY_BOOT_SPOTIFY,     // Stored configuration and the controller
+    TELEMETRY_BOOT_GUI,         // Building the tabs
+    TELEMETRY_BOOT_INTERACTIVE, // From esp_timer start to the first GUI frame
+    TELEMETRY_BOOT_PHASE_COUNT
+} telemetry_boot_phase_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t start_ms;          // esp_timer time; it starts in the second-stage startup, after the bootloader
+    uint32_t duration_ms;       // 0 with start_ms 0: not run (yet)
+} telemetry_boot_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t read_kbps;         // KB/s, sequential; 0: not measured
+    uint32_t write_kbps;
+    uint16_t read_max_ms;       // Slowest single block
+    uint16_t write_max_ms;
+    uint16_t freq_khz;          // Bus clock in use, 0: no card
+    uint8_t bus_width;
+    uint8_t reserved;
+} telemetry_storage_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t count;             // Saturates at 0xFFFF
+    uint16_t max;               // Saturates at 0xFFFF
+    uint32_t sum;
+} telemetry_counter_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t uptime_ms;         // End of the window
+    uint32_t internal_free;
+    uint32_t internal_min;      // Lowest ever, not per window
+    uint32_t internal_largest;
+    uint32_t psram_free;
+    uint32_t psram_largest;
+    uint32_t lvgl_used;         // LVGL heap (lv_mem_alloc), 0 until reported
+    uint32_t lvgl_largest;      // Largest free LVGL block
+    telemetry_counter_t metrics[TELEMETRY_METRIC_COUNT];
+} telemetry_sample_t;
+
+typedef struct __attribute__((packed)) {
+    char name[16];
+    uint32_t stack_free;        // Bytes never used, the high-water mark
+    uint8_t cpu_percent;        // Of one core, since the previous telemetry_get_tasks()
+    uint8_t priority;
+    int8_t core;                // -1 if not pinned
+    uint8_t reserved;
+} telemetry_task_t;
+
+/*
+ * Dump layout:
+ *   uint32_t magic             TELEMETRY_DUMP_MAGIC
+ *   uint8_t  metric_count      TELEMETRY_METRIC_COUNT
+ *   uint8_t  sample_count
+ *   uint8_t  task_count
+ *   uint8_t  boot_count        TELEMETRY_BOOT_PHASE_COUNT (0 in older dumps)
+ *   uint16_t period_ms
+ *   uint16_t sample_size       sizeof(telemetry_sample_t)
+ *   telemetry_sample_t[sample_count]   oldest first
+ *   telemetry_task_t[task_count]
+ *   telemetry_boot_t[boot_count]       by telemetry_boot_phase_t
+ *   telemetry_storage_t                if the dump is long enough (not in older dumps)
+ *   uint8_t  mem_tag_count     MEM_TAG_COUNT, then
+ *   mem_tag_stats_t[mem_tag_count]     by mem_tag_t, read at the dump; likewise
+ *   uint8_t  stall_count
+ *   telemetry_ui_stall_t[stall_count]  newest first
+ */
+#define TELEMETRY_DUMP_MAX_SIZE (12 + TELEMETRY_RING_LEN * sizeof(telemetry_sample_t) + \
+                                 TELEMETRY_MAX_TASKS * sizeof(telemetry_task_t) + \
+                                 TELEMETRY_BOOT_PHASE_COUNT * sizeof(telemetry_boot_t) + \
+                                 sizeof(telemetry_storage_t) + \
+                                 1 + MEM_TAG_COUNT * sizeof(mem_tag_stats_t) + \
+                                 1 + TELEMETRY_UI_STALL_LEN * sizeof(telemetry_ui_stall_t))
+
+/**
+ * @brief Allocate the ring and start the sampling timer; once, early in boot
+ */
+bool telemetry_init(void);
+
+/**
+ * @brief Add one value to the current window; any task or ISR
+ */
+void telemetry_record(telemetry_metric_t metric, uint32_t value);
+
+/**
+ * @brief Report the LVGL heap's usage; any task, meant for the LVGL thread
+ */
+void telemetry_set_lvgl_mem(uint32_t used, uint32_t largest_free);
+
+/**
+ * @brief Record when a boot phase ran; any task, once per phase
+ *
+ * @param start_us esp_timer_get_time() at its start
+ * @param end_us esp_timer_get_time() at its end
+ */
+void telemetry_boot_phase(telemetry_boot_phase_t phase, int64_t start_us, int64_t end_us);
+
+/**
+ * @brief Copy the boot phases, TELEMETRY_BOOT_PHASE_COUNT of them, by phase
+ */
+void telemetry_get_boot(telemetry_boot_t *out);
+
+/**
+ * @brief Record the SD card's bus and throughput; any task
+ */
+void telemetry_set_storage(const telemetry_storage_t *storage);
+
+/**
+ * @brief Copy the SD card's record (all zero until one was set)
+ */
+void telemetry_get_storage(telemetry_storage_t *out);
+
+/**
+ * @brief Copy up to max samples, newest first
+ *
+ * @return number copied
+ */
+size_t telemetry_get_samples(telemetry_sample_t *out, size_t max);
+
+/**
+ * @brief Stack high-water marks and CPU use per task
+ *
+ * Needs FREERTOS_USE_TRACE_FACILITY (and FREERTOS_GENERATE_RUN_TIME_STATS
+ * for CPU use); returns 0 without it. Not for ISRs.
+ *
+ * @return number of tasks written
+ */
+size_t telemetry_get_tasks(telemetry_task_t *out, size_t max);
+
+/**
+ * @brief Write the dump into buf
+ *
+ * @return bytes written, 0 if size is too small for the header
+ */
+size_t telemetry_dump(uint8_t *buf, size_t size);
+
+/**
+ * @brief Print the dump on the console as one "TELEMETRY <base64>" line
+ */
+void telemetry_dump_console(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,177 @@
+#include "telemetry_hist.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "telemetry_hist";
+
+#define EXACT       (1u << (TELEMETRY_HIST_SUB_BITS + 1))      // Values below get a bucket each
+#define SUB_COUNT   (1u << TELEMETRY_HIST_SUB_BITS)
+
+_Static_assert(EXACT + SUB_COUNT * (31 - __builtin_clz(TELEMETRY_HIST_RANGE) - TELEMETRY_HIST_SUB_BITS - 1) ==
+               TELEMETRY_HIST_BUCKETS, "TELEMETRY_HIST_RANGE does not end at the last bucket");
+
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static telemetry_hist_t table[CONFIG_TELEMETRY_HIST_SLOTS];    // Claimed in order, under lock
+static size_t used;
+static bool full_logged;
+
+static inline size_t IRAM_ATTR bucket_of(uint32_t value) {
+    if (value < EXACT) {
+        return value;
+    }
+    if (value >= TELEMETRY_HIST_RANGE) {
+        return TELEMETRY_HIST_BUCKETS - 1;
+    }
+    // The top bit picks the power of two, the next SUB_BITS the bucket in it
+    uint32_t shift = 31 - __builtin_clz(value) - TELEMETRY_HIST_SUB_BITS;
+    return EXACT + (shift - 1) * SUB_COUNT + ((value >> shift) & (SUB_COUNT - 1));
+}
+
+// The last value of the bucket
+static uint32_t bucket_top(size_t index) {
+    if (index < EXACT) {
+        return index;
+    }
+    if (index == TELEMETRY_HIST_BUCKETS - 1) {
+        return UINT32_MAX;
+    }
+    uint32_t shift = (index - EXACT) / SUB_COUNT + 1;
+    uint32_t sub = (index - EXACT) % SUB_COUNT;
+    return ((SUB_COUNT + sub + 1) << shift) - 1;
+}
+
+telemetry_hist_t *telemetry_hist_get(const char *name, telemetry_hist_unit_t unit) {
+    telemetry_hist_t *hist = NULL;
+    portENTER_CRITICAL(&lock);
+    for (size_t i = 0; i < used && !hist; i++) {
+        if (strncmp(table[i].name, name, TELEMETRY_HIST_NAME_MAX - 1) == 0) {
+            hist = &table[i];
+        }
+    }
+    bool full = !hist && used == CONFIG_TELEMETRY_HIST_SLOTS;
+    if (!hist && !full) {
+        hist = &table[used++];
+        strlcpy(hist->name, name, sizeof(hist->name));
+        hist->unit = (uint8_t)unit;
+    }
+    bool log_full = full && !full_logged;
+    full_logged |= full;
+    portEXIT_CRITICAL(&lock);
+
+    if (log_full) {
+        ESP_LOGW(TAG, "No histogram slot for %s; raise TELEMETRY_HIST_SLOTS", name);
+    }
+    return hist;
+}
+
+void IRAM_ATTR telemetry_hist_record(telemetry_hist_t *hist, uint32_t value) {
+    if (!hist) {
+        return;
+    }
+    __atomic_fetch_add(&hist->buckets[bucket_of(value)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->count, 1, __ATOMIC_RELAXED);
+    uint32_t max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+    while (value > max &&
+           !__atomic_compare_exchange_n(&hist->max, &max, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+void telemetry_hist_merge(telemetry_hist_t *into, const telemetry_hist_t *from) {
+    for (size_t i = 0; i < TELEMETRY_HIST_BUCKETS; i++) {
+        uint32_t n = __atomic_load_n(&from->buckets[i], __ATOMIC_RELAXED);
+        if (n) {
+            __atomic_fetch_add(&into->buckets[i], n, __ATOMIC_RELAXED);
+        }
+    }
+    __atomic_fetch_add(&into->count, __atomic_load_n(&from->count, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    uint32_t from_max = __atomic_load_n(&from->max, __ATOMIC_RELAXED);
+    uint32_t max = __atomic_load_n(&into->max, __ATOMIC_RELAXED);
+    while (from_max > max &&
+           !__atomic_compare_exchange_n(&into->max, &max, from_max, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+uint32_t telemetry_hist_percentile(const telemetry_hist_t *hist, float percent) {
+    uint32_t buckets[TELEMETRY_HIST_BUCKETS];
+    uint64_t total = 0;
+    for (size_t i = 0; i < TELEMETRY_HIST_BUCKETS; i++) {
+        buckets[i] = __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+        total += buckets[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    // Counted from the buckets, not count: they may be a value or two ahead
+    uint64_t rank = (uint64_t)(percent / 100.0f * total + 0.5f);
+    rank = rank < 1 ? 1 : rank > total ? total : rank;
+    uint32_t max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < TELEMETRY_HIST_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            uint32_t top = bucket_top(i);
+            return top < max ? top : max;
+        }
+    }
+    return max;
+}
+
+static void summarize(const telemetry_hist_t *hist, const char *name, telemetry_hist_summary_t *out) {
+    strlcpy(out->name, name, sizeof(out->name));
+    out->unit = hist->unit;
+    out->count = __atomic_load_n(&hist->count, __ATOMIC_RELAXED);
+    out->max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+    out->p50 = telemetry_hist_percentile(hist, 50.0f);
+    out->p95 = telemetry_hist_percentile(hist, 95.0f);
+    out->p99 = telemetry_hist_percentile(hist, 99.0f);
+}
+
+size_t telemetry_hist_list(telemetry_hist_summary_t *out, size_t max) {
+    portENTER_CRITICAL(&lock);
+    size_t count = used;
+    portEXIT_CRITICAL(&lock);
+    // Claimed slots keep their name and unit: only the counts move
+    size_t n = 0;
+    for (; n < max && n < count; n++) {
+        summarize(&table[n], table[n].name, &out[n]);
+    }
+    return n;
+}
+
+bool telemetry_hist_summarize(const char *prefix, telemetry_hist_summary_t *out) {
+    // Too big for most stacks; internal, since merging adds atomically
+    telemetry_hist_t *merged = heap_caps_calloc(1, sizeof(*merged), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!merged) {
+        return false;
+    }
+    portENTER_CRITICAL(&lock);
+    size_t count = used;
+    portEXIT_CRITICAL(&lock);
+    size_t length = strlen(prefix);
+    size_t matched = 0;
+    bool mixed = false;
+    for (size_t i = 0; i < count; i++) {
+        if (strncmp(table[i].name, prefix, length) != 0) {
+            continue;
+        }
+        if (matched++ == 0) {
+            merged->unit = table[i].unit;
+        } else if (merged->unit != table[i].unit) {
+            mixed = true;
+        }
+        telemetry_hist_merge(merged, &table[i]);
+    }
+    bool ok = matched > 0 && !mixed;
+    if (ok) {
+        char name[TELEMETRY_HIST_NAME_MAX];
+        snprintf(name, sizeof(name), "%.*s*", (int)(sizeof(name) - 2), prefix);
+        summarize(merged, name, out);
+    }
+    free(merged);
+    return ok;
+}
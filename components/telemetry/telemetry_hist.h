@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Latency histograms - fixed buckets, no locks on the hot path
+ *
+ * The telemetry ring keeps a count, sum and max per window, which says
+ * nothing about the tail. A histogram keeps every value since boot in
+ * log-linear buckets: exact below 16, then 8 buckets per power of two, so
+ * a percentile read from it is within 12.5% of the true value. Values at
+ * or past TELEMETRY_HIST_RANGE land in the last bucket; the max is kept
+ * exactly.
+ *
+ * Histograms live in a table of TELEMETRY_HIST_SLOTS in internal RAM
+ * (atomics on PSRAM are not safe) and are found by name, e.g.
+ * "cast GET_STATUS" or "http me/player". telemetry_hist_get() claims a
+ * slot on first use and returns NULL when the table is full, which
+ * telemetry_hist_record() ignores. Recording is two relaxed atomic adds and
+ * a compare-and-swap for the max, from any task or an ISR. A reader sees
+ * buckets as they are mid-update, off by the values recorded meanwhile.
+ *
+ * Histograms merge by adding buckets: telemetry_hist_summarize() with a
+ * name prefix gives, say, the percentiles of every Cast request type
+ * together.
+ */
+
+#define TELEMETRY_HIST_NAME_MAX     32          // With the terminator
+#define TELEMETRY_HIST_SUB_BITS     3           // 8 buckets per power of two
+#define TELEMETRY_HIST_BUCKETS      128
+#define TELEMETRY_HIST_RANGE        (1u << 18)  // Values from here on count in the last bucket
+
+typedef enum {
+    TELEMETRY_HIST_MS,
+    TELEMETRY_HIST_US,
+} telemetry_hist_unit_t;
+
+typedef struct {
+    char name[TELEMETRY_HIST_NAME_MAX];
+    uint8_t unit;                               // telemetry_hist_unit_t
+    uint32_t count;
+    uint32_t max;
+    uint32_t buckets[TELEMETRY_HIST_BUCKETS];
+} telemetry_hist_t;
+
+typedef struct {
+    char name[TELEMETRY_HIST_NAME_MAX];
+    uint8_t unit;
+    uint32_t count;
+    uint32_t max;
+    uint32_t p50;
+    uint32_t p95;
+    uint32_t p99;
+} telemetry_hist_summary_t;
+
+/**
+ * @brief The histogram of this name, claimed on first use
+ *
+ * Scans the table under a spinlock, from a task: keep the pointer where
+ * the name is fixed (TELEMETRY_HIST_RECORD does), and look it up before an
+ * ISR records into it.
+ *
+ * @param name cut to TELEMETRY_HIST_NAME_MAX - 1
+ * @return NULL if the table is full
+ */
+telemetry_hist_t *telemetry_hist_get(const char *name, telemetry_hist_unit_t unit);
+
+/**
+ * @brief Count one value; any task or an ISR, hist may be NULL
+ */
+void telemetry_hist_record(telemetry_hist_t *hist, uint32_t value);
+
+/**
+ * @brief Add from's values to into, which may be a histogram of the caller's
+ */
+void telemetry_hist_merge(telemetry_hist_t *into, const telemetry_hist_t *from);
+
+/**
+ * @brief The value percent of the values are at or under, 0 for no values
+ *
+ * @return the top of the bucket it falls in, no more than the max
+ */
+uint32_t telemetry_hist_percentile(const telemetry_hist_t *hist, float percent);
+
+/**
+ * @brief Count, max and percentiles of every histogram, in the order claimed
+ *
+ * @return number written, up to max
+ */
+size_t telemetry_hist_list(telemetry_hist_summary_t *out, size_t max);
+
+/**
+ * @brief Merge every histogram whose name starts with prefix into one summary
+ *
+ * @param out named prefix with a trailing "*"
+ * @return false if none matched or they have different units
+ */
+bool telemetry_hist_summarize(const char *prefix, telemetry_hist_summary_t *out);
+
+/**
+ * @brief Record into a histogram of a fixed name, looked up once per call site
+ */
+#define TELEMETRY_HIST_RECORD(name, unit, value) do {               \
+        static telemetry_hist_t *_hist;                             \
+        if (!_hist) {                                               \
+            _hist = telemetry_hist_get((name), (unit));             \
+        }                                                           \
+        telemetry_hist_record(_hist, (value));                      \
+    } while (0)
+
+#ifdef __cplusplus
+}
+#endif
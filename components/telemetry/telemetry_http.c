@@ -0,0 +1,57 @@
+#include "telemetry_http.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#if CONFIG_TELEMETRY_HTTP
+#include "esp_http_server.h"
+
+static const char *TAG = "telemetry_http";
+
+static httpd_handle_t server;
+
+static esp_err_t telemetry_get_handler(httpd_req_t *req) {
+    uint8_t *raw = heap_caps_malloc(TELEMETRY_DUMP_MAX_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!raw) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No memory");
+    }
+    size_t len = telemetry_dump(raw, TELEMETRY_DUMP_MAX_SIZE);
+    httpd_resp_set_type(req, "application/octet-stream");
+    esp_err_t err = httpd_resp_send(req, (const char *)raw, len);
+    heap_caps_free(raw);
+    return err;
+}
+
+bool telemetry_http_start(void) {
+    if (server) {
+        return true;
+    }
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = CONFIG_TELEMETRY_HTTP_PORT;
+    config.ctrl_port = CONFIG_TELEMETRY_HTTP_PORT + 1;     // Apart from the Spotify callback server's
+    config.max_open_sockets = 2;
+    config.stack_size = 3072;
+    config.task_priority = tskIDLE_PRIORITY + 1;
+#if CONFIG_MEM_TASK_PSRAM_STACKS
+    config.task_caps = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;    // Serves RAM only
+#endif
+    if (httpd_start(&server, &config) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the telemetry server on port %d", CONFIG_TELEMETRY_HTTP_PORT);
+        server = NULL;
+        return false;
+    }
+
+    const httpd_uri_t uri = {
+        .uri = "/telemetry",
+        .method = HTTP_GET,
+        .handler = telemetry_get_handler,
+    };
+    httpd_register_uri_handler(server, &uri);
+    ESP_LOGI(TAG, "GET /telemetry on port %d", CONFIG_TELEMETRY_HTTP_PORT);
+    return true;
+}
+#else
+bool telemetry_http_start(void) {
+    return false;
+}
+#endif
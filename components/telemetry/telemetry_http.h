@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdbool.h>
+#include "telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Serve telemetry_dump() at GET /telemetry on TELEMETRY_HTTP_PORT
+ *
+ * Call once the network stack is up (after esp_netif_init()). Returns false,
+ * and serves nothing, unless TELEMETRY_HTTP is enabled.
+ */
+bool telemetry_http_start(void);
+
+#ifdef __cplusplus
+}
+#endif
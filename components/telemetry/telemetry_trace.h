@@ -0,0 +1,34 @@
+#pragma once
+
+#include "sdkconfig.h"
+
+/**
+ * @brief Hot-path markers for SEGGER SystemView
+ *
+ * TELEMETRY_TRACE_BEGIN/END wrap a span as a SystemView user event
+ * (OnUserStart/OnUserStop with the ids below), recorded through
+ * esp_app_trace. They are only compiled in when APPTRACE_SV_ENABLE is set,
+ * which the sdkconfig.trace overlay does (see README, "Tracing"); in a
+ * normal build they expand to nothing.
+ *
+ * Spans must begin and end on the same task, and may nest.
+ */
+
+typedef enum {
+    TELEMETRY_TRACE_LVGL_TIMER,     // lv_timer_handler(): render and input
+    TELEMETRY_TRACE_LVGL_FLUSH,     // Flush callback: queueing or copying out an area
+    TELEMETRY_TRACE_TOUCH_READ,     // SPD2010 touch I2C read on the touch task
+    TELEMETRY_TRACE_SPOTIFY_HTTP,   // One Spotify Web API request
+    TELEMETRY_TRACE_CAST_RECEIVE,   // Cast frames parsed and dispatched after a TLS read
+    TELEMETRY_TRACE_AUDIO_DECODE,   // One decode_*() call on the decode task
+    TELEMETRY_TRACE_AUDIO_WRITE,    // Gain and I2S write of one PCM buffer
+} telemetry_trace_id_t;
+
+#if CONFIG_APPTRACE_SV_ENABLE
+#include "SEGGER_SYSVIEW.h"
+#define TELEMETRY_TRACE_BEGIN(id)   SEGGER_SYSVIEW_OnUserStart((unsigned)(id))
+#define TELEMETRY_TRACE_END(id)     SEGGER_SYSVIEW_OnUserStop((unsigned)(id))
+#else
+#define TELEMETRY_TRACE_BEGIN(id)   ((void)0)
+#define TELEMETRY_TRACE_END(id)     ((void)0)
+#endif
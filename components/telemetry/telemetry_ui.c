@@ -0,0 +1,185 @@
+#include "telemetry_ui.h"
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_cpu.h"
+#include "esp_debug_helpers.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "telemetry.h"
+
+static const char *TAG = "telemetry_ui";
+
+#define BUDGET_US   (CONFIG_TELEMETRY_UI_BUDGET_MS * 1000LL)
+
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static telemetry_ui_stall_t stalls[TELEMETRY_UI_STALL_LEN];    // Under lock
+static size_t stall_head;                                       // Next slot to write
+static size_t stall_count;
+static uint32_t stall_total;
+
+// LVGL runs one callback at a time, under its lock: the rest is its thread's
+static TaskHandle_t ui_task;
+static int64_t pass_start_us;
+static uint8_t depth;                   // Callbacks under way, nested ones included
+static bool chain_recorded;             // A callback of the running chain stalled already
+static bool pass_recorded;              // Or one of this pass
+
+static struct {
+    int64_t duration_us;
+    const void *callback;
+    uint32_t event;
+} slowest;                              // Of the pass so far
+
+static struct {
+    const char *api;                    // NULL: none since the chain began
+    uint8_t count;
+    uint32_t backtrace[TELEMETRY_UI_BACKTRACE_DEPTH];
+} blocking;                             // The first blocking call of the chain
+
+// Return addresses from this function's caller's caller outwards
+static __attribute__((noinline)) uint8_t take_backtrace(uint32_t *out) {
+    uint8_t count = 0;
+#if CONFIG_IDF_TARGET_ARCH_XTENSA
+    esp_backtrace_frame_t frame;
+    esp_backtrace_get_start(&frame.pc, &frame.sp, &frame.next_pc);
+    // The first frame is telemetry_ui's own
+    if (!esp_backtrace_get_next_frame(&frame)) {
+        return 0;
+    }
+    while (count < TELEMETRY_UI_BACKTRACE_DEPTH && esp_backtrace_get_next_frame(&frame)) {
+        uint32_t pc = esp_cpu_process_stack_pc(frame.pc);
+        if (!esp_ptr_executable((void *)(uintptr_t)pc)) {
+            break;
+        }
+        out[count++] = pc;
+    }
+#else
+    (void)out;
+#endif
+    return count;
+}
+
+static const char *kind_name(telemetry_ui_kind_t kind) {
+    switch (kind) {
+    case TELEMETRY_UI_EVENT:
+        return "Event callback";
+    case TELEMETRY_UI_TIMER:
+        return "Timer";
+    default:
+        return "Pass";
+    }
+}
+
+static void record(telemetry_ui_kind_t kind, int64_t duration_us, const void *callback, uint32_t event) {
+    telemetry_ui_stall_t stall = {
+        .uptime_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .duration_us = duration_us > UINT32_MAX ? UINT32_MAX : (uint32_t)duration_us,
+        .callback = (uint32_t)(uintptr_t)callback,
+        .event = (uint16_t)event,
+        .kind = (uint8_t)kind,
+    };
+    if (blocking.api) {
+        strlcpy(stall.api, blocking.api, sizeof(stall.api));
+        memcpy(stall.backtrace, blocking.backtrace, sizeof(stall.backtrace));
+        stall.backtrace_count = blocking.count;
+    } else if (kind != TELEMETRY_UI_PASS) {
+        // Where LVGL called it from: the input, the event sender or the timer loop
+        uint32_t backtrace[TELEMETRY_UI_BACKTRACE_DEPTH];
+        stall.backtrace_count = take_backtrace(backtrace);
+        memcpy(stall.backtrace, backtrace, stall.backtrace_count * sizeof(backtrace[0]));
+    }
+    telemetry_record(TELEMETRY_UI_STALL, (uint32_t)(duration_us / 1000));
+
+    portENTER_CRITICAL(&lock);
+    stalls[stall_head] = stall;
+    stall_head = (stall_head + 1) % TELEMETRY_UI_STALL_LEN;
+    if (stall_count < TELEMETRY_UI_STALL_LEN) {
+        stall_count++;
+    }
+    stall_total++;
+    portEXIT_CRITICAL(&lock);
+
+    ESP_LOGW(TAG, "%s %p took %lu ms%s%s", kind_name(kind), callback, (unsigned long)(duration_us / 1000),
+             stall.api[0] ? " in " : "", stall.api);
+}
+
+void telemetry_ui_pass_begin(void) {
+    ui_task = xTaskGetCurrentTaskHandle();
+    pass_start_us = esp_timer_get_time();
+    pass_recorded = false;
+    slowest.duration_us = 0;
+    slowest.callback = NULL;
+    blocking.api = NULL;
+}
+
+void telemetry_ui_pass_end(void) {
+    int64_t duration_us = esp_timer_get_time() - pass_start_us;
+    if (duration_us > BUDGET_US && !pass_recorded) {
+        // Nothing in it overran on its own: blame the slowest part, if any ran
+        record(TELEMETRY_UI_PASS, duration_us, slowest.callback, slowest.event);
+    }
+    blocking.api = NULL;
+}
+
+int64_t telemetry_ui_begin(void) {
+    depth++;
+    return esp_timer_get_time();
+}
+
+void telemetry_ui_end(telemetry_ui_kind_t kind, int64_t start_us, const void *callback, uint32_t event) {
+    int64_t duration_us = esp_timer_get_time() - start_us;
+    if (depth) {
+        depth--;
+    }
+    if (duration_us > slowest.duration_us) {
+        slowest.duration_us = duration_us;
+        slowest.callback = callback;
+        slowest.event = event;
+    }
+    // Nested callbacks end first: the innermost one over budget is the stall
+    if (duration_us > BUDGET_US && !chain_recorded) {
+        record(kind, duration_us, callback, event);
+        chain_recorded = true;
+        pass_recorded = true;
+    }
+    if (depth == 0) {
+        chain_recorded = false;
+        blocking.api = NULL;
+    }
+}
+
+void telemetry_ui_blocking(const char *api) {
+    if (!ui_task || xTaskGetCurrentTaskHandle() != ui_task) {
+        return;
+    }
+#if CONFIG_TELEMETRY_UI_ASSERT_BLOCKING
+    // Straight to the console: queued log lines are lost in the panic
+    esp_rom_printf("%s called on the LVGL thread\n", api);
+    abort();
+#endif
+    if (!blocking.api) {
+        blocking.api = api;
+        blocking.count = take_backtrace(blocking.backtrace);
+    }
+}
+
+size_t telemetry_get_ui_stalls(telemetry_ui_stall_t *out, size_t max) {
+    size_t n = 0;
+    portENTER_CRITICAL(&lock);
+    for (; n < max && n < stall_count; n++) {
+        out[n] = stalls[(stall_head + TELEMETRY_UI_STALL_LEN - 1 - n) % TELEMETRY_UI_STALL_LEN];
+    }
+    portEXIT_CRITICAL(&lock);
+    return n;
+}
+
+uint32_t telemetry_ui_stall_total(void) {
+    portENTER_CRITICAL(&lock);
+    uint32_t total = stall_total;
+    portEXIT_CRITICAL(&lock);
+    return total;
+}
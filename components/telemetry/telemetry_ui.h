@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief UI watch - LVGL passes and callbacks that overrun the frame budget
+ *
+ * The LVGL thread brackets each lv_timer_handler() pass with
+ * telemetry_ui_pass_begin()/telemetry_ui_pass_end(), and LVGL times every
+ * event and timer callback through telemetry_ui_hook.h (LV_CB_HOOK_INCLUDE,
+ * set in the project CMakeLists.txt with TELEMETRY_UI_WATCH). A callback
+ * that runs longer than TELEMETRY_UI_BUDGET_MS is recorded as a stall: the
+ * innermost one of a nested chain, once. A pass over budget with no
+ * callback recorded names its slowest callback, or none when it was
+ * rendering. Each stall adds its duration in ms to TELEMETRY_UI_STALL and
+ * goes into a ring of TELEMETRY_UI_STALL_LEN, read with
+ * telemetry_get_ui_stalls() and carried in the dump.
+ *
+ * Code that blocks (flash commits, HTTP requests, TLS handshakes) calls
+ * telemetry_ui_blocking() first. On the LVGL thread that takes a backtrace
+ * there, which the stall it causes carries instead of the one taken where
+ * the callback returned, and with TELEMETRY_UI_ASSERT_BLOCKING it aborts.
+ * Callback addresses and backtraces resolve with addr2line on the ELF.
+ */
+
+#define TELEMETRY_UI_STALL_LEN          8
+#define TELEMETRY_UI_BACKTRACE_DEPTH    8
+#define TELEMETRY_UI_API_MAX            16      // With the terminator
+
+typedef enum {
+    TELEMETRY_UI_PASS,          // A whole lv_timer_handler() pass
+    TELEMETRY_UI_EVENT,         // An event callback
+    TELEMETRY_UI_TIMER,         // A timer callback
+} telemetry_ui_kind_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t uptime_ms;         // When it ended
+    uint32_t duration_us;
+    uint32_t callback;          // Address; 0: a pass with no callback to blame
+    uint16_t event;             // lv_event_code_t of an EVENT
+    uint8_t kind;               // telemetry_ui_kind_t
+    uint8_t backtrace_count;
+    char api[TELEMETRY_UI_API_MAX];     // The blocking call it made, "" if none seen
+    uint32_t backtrace[TELEMETRY_UI_BACKTRACE_DEPTH];
+} telemetry_ui_stall_t;
+
+/**
+ * @brief Start timing an lv_timer_handler() pass; the LVGL thread
+ */
+void telemetry_ui_pass_begin(void);
+
+/**
+ * @brief End the pass; records it if it overran and nothing in it did
+ */
+void telemetry_ui_pass_end(void);
+
+/**
+ * @brief Before an LVGL callback (telemetry_ui_hook.h)
+ * @return the start time to give telemetry_ui_end()
+ */
+int64_t telemetry_ui_begin(void);
+
+/**
+ * @brief After the callback started by telemetry_ui_begin()
+ */
+void telemetry_ui_end(telemetry_ui_kind_t kind, int64_t start_us, const void *callback, uint32_t event);
+
+/**
+ * @brief Mark a blocking call; any task, only counts on the LVGL thread
+ *
+ * @param api a short name, e.g. "nvs_commit"; kept as a pointer until stored
+ */
+void telemetry_ui_blocking(const char *api);
+
+/**
+ * @brief Copy up to max stalls, newest first
+ *
+ * @return number copied
+ */
+size_t telemetry_get_ui_stalls(telemetry_ui_stall_t *out, size_t max);
+
+/**
+ * @brief Stalls recorded since boot
+ */
+uint32_t telemetry_ui_stall_total(void);
+
+#ifdef __cplusplus
+}
+#endif
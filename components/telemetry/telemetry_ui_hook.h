@@ -0,0 +1,27 @@
+#pragma once
+
+#include "telemetry_ui.h"
+
+/**
+ * @brief LVGL's callback hooks with TELEMETRY_UI_WATCH
+ *
+ * Included by LVGL's lv_event.c and lv_timer.c (LV_CB_HOOK_INCLUDE, set in
+ * the project CMakeLists.txt) and only used there. The callback is read
+ * before the call: it may remove its own event descriptor or delete its
+ * timer.
+ */
+
+#define LV_EVENT_CB_CALL(cb, e) do { \
+        __typeof__(cb) ui_cb_ = (cb); \
+        uint32_t ui_code_ = (e)->code; \
+        int64_t ui_start_ = telemetry_ui_begin(); \
+        ui_cb_(e); \
+        telemetry_ui_end(TELEMETRY_UI_EVENT, ui_start_, (const void *)ui_cb_, ui_code_); \
+    } while(0)
+
+#define LV_TIMER_CB_CALL(cb, timer) do { \
+        __typeof__(cb) ui_cb_ = (cb); \
+        int64_t ui_start_ = telemetry_ui_begin(); \
+        ui_cb_(timer); \
+        telemetry_ui_end(TELEMETRY_UI_TIMER, ui_start_, (const void *)ui_cb_, 0); \
+    } while(0)
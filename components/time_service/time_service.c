@@ -0,0 +1,80 @@
+#include "time_service.h"
+
+#include <stdlib.h>
+#include <sys/time.h>
+#include "esp_log.h"
+#include "esp_netif_sntp.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "time_service";
+
+static const time_service_rtc_t *rtc_source;
+static volatile bool sntp_synced;
+
+bool time_service_clock_valid(void)
+{
+    return time(NULL) > TIME_SERVICE_VALID_AFTER;
+}
+
+bool time_service_synced(void)
+{
+    return sntp_synced;
+}
+
+bool time_service_init(const time_service_rtc_t *rtc)
+{
+    rtc_source = rtc;
+    time_t utc = 0;
+    if (!rtc || !rtc->read(&utc) || utc <= TIME_SERVICE_VALID_AFTER) {
+        ESP_LOGW(TAG, "No RTC time, the clock is unset until SNTP answers");
+        return time_service_clock_valid();
+    }
+
+    // Mid-second on average: the RTC keeps no fraction
+    struct timeval tv = { .tv_sec = utc, .tv_usec = 500000 };
+    settimeofday(&tv, NULL);
+
+    struct tm tm;
+    char text[24];
+    gmtime_r(&utc, &tm);
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &tm);
+    ESP_LOGI(TAG, "Clock set from the RTC: %s UTC", text);
+    return true;
+}
+
+// On the lwIP task, with the system time already set to tv
+static void time_service_sntp_synced(struct timeval *tv)
+{
+    bool first = !sntp_synced;
+    sntp_synced = true;
+    if (!rtc_source) {
+        return;
+    }
+
+    time_t rtc = 0;
+    bool rtc_valid = rtc_source->read(&rtc);
+    long drift = rtc_valid ? (long)(rtc - tv->tv_sec) : 0;
+    if (first) {
+        ESP_LOGI(TAG, "SNTP synced; RTC %s, %ld s off", rtc_valid ? "set" : "unset", drift);
+    }
+    if (!rtc_valid || labs(drift) >= CONFIG_TIME_SERVICE_RTC_MAX_DRIFT_S) {
+        rtc_source->write(tv->tv_sec + (tv->tv_usec >= 500000 ? 1 : 0));
+        if (rtc_valid) {
+            ESP_LOGI(TAG, "RTC corrected by %ld s", -drift);
+        } else {
+            ESP_LOGI(TAG, "RTC set");
+        }
+    }
+}
+
+void time_service_start_sntp(void)
+{
+    esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG(CONFIG_TIME_SERVICE_NTP_SERVER);
+    config.sync_cb = time_service_sntp_synced;
+    esp_err_t err = esp_netif_sntp_init(&config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "SNTP not started: %s", esp_err_to_name(err));
+        return;
+    }
+    ESP_LOGI(TAG, "SNTP started with %s", CONFIG_TIME_SERVICE_NTP_SERVER);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "esp_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Time service - the wall clock from the RTC at boot, SNTP after
+ *
+ * time() is what token expiries, cache TTLs and the discovery table's ages
+ * are kept in, and they are persisted, so the clock has to be right before
+ * anything loads them. time_service_init() sets the system time from the
+ * board's RTC, read through the callbacks given, before the network is up;
+ * time_service_start_sntp() then keeps it right from NTP, every
+ * LWIP_SNTP_UPDATE_DELAY, and writes the NTP time back to the RTC whenever
+ * the two are TIME_SERVICE_RTC_MAX_DRIFT_S or more apart.
+ *
+ * Intervals and latencies are never measured with time(), which steps when
+ * SNTP corrects it: time_service_mono_us() is the monotonic clock for those.
+ */
+
+#define TIME_SERVICE_VALID_AFTER    1704067200  // 2024-01-01: time() before it is the unset clock
+
+/**
+ * @brief The board's RTC, in UTC seconds
+ *
+ * Called on the task that calls time_service_init() and, after an SNTP
+ * sync, on the lwIP task.
+ */
+typedef struct {
+    bool (*read)(time_t *utc);      // false if the RTC lost its time (battery, first power-up)
+    void (*write)(time_t utc);
+} time_service_rtc_t;
+
+/**
+ * @brief Set the system time from the RTC
+ *
+ * @param rtc Kept; NULL to go without one, the clock then unset until SNTP
+ * @return true if the clock is set now
+ */
+bool time_service_init(const time_service_rtc_t *rtc);
+
+/**
+ * @brief Start SNTP in the background
+ *
+ * Once esp_netif is initialized; lwIP retries until the server answers.
+ */
+void time_service_start_sntp(void);
+
+/**
+ * @brief Whether time() is the real time, from the RTC or from SNTP
+ */
+bool time_service_clock_valid(void);
+
+/**
+ * @brief Whether SNTP has answered since boot
+ */
+bool time_service_synced(void);
+
+/**
+ * @brief Microseconds since boot; never steps, for intervals and latencies
+ */
+static inline int64_t time_service_mono_us(void)
+{
+    return esp_timer_get_time();
+}
+
+/**
+ * @brief Milliseconds since boot, wrapping after 49 days; compare by difference
+ */
+static inline uint32_t time_service_mono_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+#ifdef __cplusplus
+}
+#endif
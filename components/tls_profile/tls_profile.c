@@ -0,0 +1,67 @@
+#include "tls_profile.h"
+
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "esp_crt_bundle.h"
+#include "mbedtls/ssl_ciphersuites.h"
+
+static const int web_suites[] = {
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256,
+    0
+};
+
+static const int cast_suites[] = {
+#if CONFIG_TLS_PROFILE_CAST_RSA_KX
+    MBEDTLS_TLS_RSA_WITH_AES_128_GCM_SHA256,
+#endif
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256,
+    0
+};
+
+static const int bench_suites[] = {
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA,
+    MBEDTLS_TLS_RSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_RSA_WITH_AES_128_CBC_SHA,
+    0
+};
+
+const int *tls_profile_ciphersuites(tls_profile_t profile)
+{
+#if CONFIG_TLS_PROFILE_RESTRICT
+    return profile == TLS_PROFILE_CAST ? cast_suites : web_suites;
+#else
+    (void)profile;
+    return NULL;
+#endif
+}
+
+tls_profile_bundle_attach_t tls_profile_crt_bundle(tls_profile_t profile)
+{
+    // Speakers present self-signed certificates: with
+    // CONFIG_ESP_TLS_SKIP_SERVER_CERT_VERIFY no bundle means no check
+    return profile == TLS_PROFILE_CAST ? NULL : esp_crt_bundle_attach;
+}
+
+void tls_profile_apply(esp_tls_cfg_t *cfg, tls_profile_t profile)
+{
+    cfg->crt_bundle_attach = tls_profile_crt_bundle(profile);
+    // Nor are they issued for a name
+    cfg->skip_common_name = profile == TLS_PROFILE_CAST;
+    cfg->ciphersuites_list = tls_profile_ciphersuites(profile);
+}
+
+const int *tls_profile_bench_suites(void)
+{
+    return bench_suites;
+}
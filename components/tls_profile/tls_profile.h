@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_tls.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief TLS profile - cipher suites ordered for the ESP32-S3's crypto hardware
+ *
+ * The S3 has AES, SHA and MPI (big number) peripherals but no ECC one, so on
+ * a handshake the symmetric cipher, the transcript hash and RSA signature
+ * checks are in hardware, and ECDHE's curve arithmetic is not. The profile
+ * offers AES-128-GCM before AES-256-GCM (fewer rounds, same peripheral)
+ * with ECDHE-ECDSA before ECDHE-RSA, then one AES-CBC suite for old
+ * servers; ChaCha20 is not built. With CONFIG_TLS_PROFILE_CAST_RSA_KX a
+ * Cast connection offers the RSA key exchange first.
+ *
+ * The lists are zero terminated IANA identifiers, as esp_tls_cfg_t's
+ * ciphersuites_list wants them.
+ *
+ * Every TLS client takes its trust settings from here: WEB checks servers
+ * against the one certificate bundle in flash (esp_crt_bundle looks the
+ * issuer up and parses only that certificate), CAST accepts the speakers'
+ * self-signed certificates. esp_tls keeps an mbedtls_ssl_config and RNG in
+ * each esp_tls_t and cannot be handed shared ones, so the saving across
+ * connections comes from one session cache for all clients: a resumed
+ * handshake skips the key exchange and the certificate chain.
+ */
+
+#define TLS_PROFILE_SESSION_KEY_MAX     64      // With the terminator
+
+typedef enum {
+    TLS_PROFILE_CAST,       // Speakers on the LAN, self-signed certificates
+    TLS_PROFILE_WEB,        // Spotify and other public servers
+} tls_profile_t;
+
+// As esp_tls_cfg_t's crt_bundle_attach
+typedef esp_err_t (*tls_profile_bundle_attach_t)(void *conf);
+
+/**
+ * @brief The suites for profile, or NULL (mbedTLS's defaults) with
+ *        CONFIG_TLS_PROFILE_RESTRICT off
+ */
+const int *tls_profile_ciphersuites(tls_profile_t profile);
+
+/**
+ * @brief Set cfg's trust settings and ciphersuites_list for profile
+ */
+void tls_profile_apply(esp_tls_cfg_t *cfg, tls_profile_t profile);
+
+/**
+ * @brief The crt_bundle_attach for profile, for clients configured through
+ *        esp_http_client or esp_websocket_client rather than esp_tls_cfg_t
+ */
+tls_profile_bundle_attach_t tls_profile_crt_bundle(tls_profile_t profile);
+
+/**
+ * @brief Remove and return the cached session for key (device UUID, IP or
+ *        host name); the caller owns it. NULL if there is none, or without
+ *        CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+ */
+esp_tls_client_session_t *tls_profile_session_take(const char *key);
+
+/**
+ * @brief Cache session for key, replacing key's old one or the least
+ *        recently used; the cache owns it from here. Like take, safe from
+ *        any task: slots are only read or written under one lock
+ */
+void tls_profile_session_store(const char *key, esp_tls_client_session_t *session);
+
+/**
+ * @brief Before a connect: offer key's cached session in cfg->client_session
+ */
+void tls_profile_session_offer(esp_tls_cfg_t *cfg, const char *key);
+
+/**
+ * @brief After the connect: free the offered session and, when tls is the
+ *        established connection (NULL if it failed), cache its session
+ */
+void tls_profile_session_finish(esp_tls_cfg_t *cfg, esp_tls_t *tls, const char *key);
+
+/**
+ * @brief The session cache, serialised so it survives deep sleep, most
+ *        recently used first; sessions that do not fit are skipped
+ * @return Bytes written
+ */
+size_t tls_profile_sessions_export(uint8_t *out, size_t capacity);
+
+/**
+ * @brief Restore sessions written by tls_profile_sessions_export
+ * @return Sessions restored; records mbedTLS cannot load are dropped
+ */
+size_t tls_profile_sessions_import(const uint8_t *data, size_t length);
+
+/**
+ * @brief Every suite the bench measures on its own, zero terminated:
+ *        the profile's and the mbedTLS alternatives it leaves out
+ */
+const int *tls_profile_bench_suites(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,247 @@
+#include "tls_profile.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mbedtls/ssl.h"
+
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+
+static const char *TAG = "tls_session";
+
+typedef struct {
+    char key[TLS_PROFILE_SESSION_KEY_MAX];
+    esp_tls_client_session_t *session;
+    TickType_t last_used;
+} session_entry_t;
+
+static session_entry_t cache[CONFIG_TLS_PROFILE_SESSION_CACHE_SIZE];
+static portMUX_TYPE cache_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// esp-tls wraps a bare mbedtls_ssl_session (esp_tls_client_session in
+// esp_tls.h) and frees it with mbedtls_ssl_session_free() and free()
+static mbedtls_ssl_session *ssl_session_of(esp_tls_client_session_t *session)
+{
+    return (mbedtls_ssl_session *)session;
+}
+
+static bool key_fits(const char *key)
+{
+    return key && key[0] && strlen(key) < TLS_PROFILE_SESSION_KEY_MAX;
+}
+
+esp_tls_client_session_t *tls_profile_session_take(const char *key)
+{
+    if (!key_fits(key)) {
+        return NULL;
+    }
+
+    esp_tls_client_session_t *session = NULL;
+    taskENTER_CRITICAL(&cache_lock);
+    for (size_t i = 0; i < CONFIG_TLS_PROFILE_SESSION_CACHE_SIZE; i++) {
+        if (cache[i].session && strcmp(cache[i].key, key) == 0) {
+            session = cache[i].session;
+            cache[i].session = NULL;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&cache_lock);
+    return session;
+}
+
+void tls_profile_session_store(const char *key, esp_tls_client_session_t *session)
+{
+    if (!session) {
+        return;
+    }
+    if (!key_fits(key)) {
+        esp_tls_free_client_session(session);
+        return;
+    }
+
+    // The slot for this key, else an empty slot, else the least recently used
+    taskENTER_CRITICAL(&cache_lock);
+    session_entry_t *slot = NULL;
+    for (size_t i = 0; i < CONFIG_TLS_PROFILE_SESSION_CACHE_SIZE; i++) {
+        if (strcmp(cache[i].key, key) == 0) {
+            slot = &cache[i];
+            break;
+        }
+    }
+    for (size_t i = 0; !slot && i < CONFIG_TLS_PROFILE_SESSION_CACHE_SIZE; i++) {
+        if (!cache[i].session) {
+            slot = &cache[i];
+        }
+    }
+    if (!slot) {
+        slot = &cache[0];
+        for (size_t i = 1; i < CONFIG_TLS_PROFILE_SESSION_CACHE_SIZE; i++) {
+            if (cache[i].last_used < slot->last_used) {
+                slot = &cache[i];
+            }
+        }
+    }
+    // Key and session change together under the lock: a take on another task
+    // never matches a slot whose key is half rewritten
+    esp_tls_client_session_t *old = slot->session;
+    strcpy(slot->key, key);
+    slot->session = session;
+    slot->last_used = xTaskGetTickCount();
+    taskEXIT_CRITICAL(&cache_lock);
+
+    if (old) {
+        esp_tls_free_client_session(old);
+    }
+}
+
+void tls_profile_session_offer(esp_tls_cfg_t *cfg, const char *key)
+{
+    cfg->client_session = tls_profile_session_take(key);
+}
+
+void tls_profile_session_finish(esp_tls_cfg_t *cfg, esp_tls_t *tls, const char *key)
+{
+    if (cfg->client_session) {
+        esp_tls_free_client_session(cfg->client_session);
+        cfg->client_session = NULL;
+    }
+    if (tls) {
+        tls_profile_session_store(key, esp_tls_get_client_session(tls));
+    }
+}
+
+// Record per session: key length (1), key, session length (2, little endian), session.
+// Most recently used first, so a small buffer keeps the peer most likely next.
+size_t tls_profile_sessions_export(uint8_t *out, size_t capacity)
+{
+    session_entry_t order[CONFIG_TLS_PROFILE_SESSION_CACHE_SIZE];
+    size_t count = 0;
+    taskENTER_CRITICAL(&cache_lock);
+    for (size_t i = 0; i < CONFIG_TLS_PROFILE_SESSION_CACHE_SIZE; i++) {
+        if (cache[i].session) {
+            order[count++] = cache[i];
+        }
+    }
+    taskEXIT_CRITICAL(&cache_lock);
+    for (size_t i = 1; i < count; i++) {
+        for (size_t j = i; j > 0 && order[j].last_used > order[j - 1].last_used; j--) {
+            session_entry_t newer = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = newer;
+        }
+    }
+
+    size_t used = 0;
+    for (size_t n = 0; n < count; n++) {
+        const char *key = order[n].key;
+        // Taken out of the cache while serialised, so a connect cannot free it underneath
+        esp_tls_client_session_t *session = tls_profile_session_take(key);
+        if (!session) {
+            continue;
+        }
+        size_t key_length = strlen(key);
+        size_t header = 1 + key_length + 2;
+        size_t length = 0;
+        if (used + header <= capacity &&
+            mbedtls_ssl_session_save(ssl_session_of(session), out + used + header,
+                                     capacity - used - header, &length) == 0 &&
+            length <= UINT16_MAX) {
+            out[used] = (uint8_t)key_length;
+            memcpy(out + used + 1, key, key_length);
+            out[used + 1 + key_length] = (uint8_t)length;
+            out[used + 2 + key_length] = (uint8_t)(length >> 8);
+            used += header + length;
+        } else {
+            ESP_LOGD(TAG, "Session for %s does not fit, not exported", key);
+        }
+        tls_profile_session_store(key, session);
+    }
+    return used;
+}
+
+size_t tls_profile_sessions_import(const uint8_t *data, size_t length)
+{
+    size_t imported = 0;
+    size_t pos = 0;
+    while (pos + 1 <= length) {
+        size_t key_length = data[pos];
+        if (pos + 1 + key_length + 2 > length) {
+            break;
+        }
+        size_t session_length = data[pos + 1 + key_length] | (data[pos + 2 + key_length] << 8);
+        const uint8_t *record = data + pos + 1 + key_length + 2;
+        if (record + session_length > data + length) {
+            break;
+        }
+        char key[TLS_PROFILE_SESSION_KEY_MAX];
+        bool key_valid = key_length > 0 && key_length < sizeof(key);
+        if (key_valid) {
+            memcpy(key, data + pos + 1, key_length);
+            key[key_length] = '\0';
+        }
+        pos += 1 + key_length + 2 + session_length;
+        if (!key_valid) {
+            continue;
+        }
+
+        esp_tls_client_session_t *session = calloc(1, sizeof(mbedtls_ssl_session));
+        if (!session) {
+            break;
+        }
+        mbedtls_ssl_session_init(ssl_session_of(session));
+        if (mbedtls_ssl_session_load(ssl_session_of(session), record, session_length) != 0) {
+            // Saved by another mbedTLS build: a full handshake is all it costs
+            esp_tls_free_client_session(session);
+            continue;
+        }
+        tls_profile_session_store(key, session);
+        imported++;
+    }
+    return imported;
+}
+
+#else
+
+esp_tls_client_session_t *tls_profile_session_take(const char *key)
+{
+    (void)key;
+    return NULL;
+}
+
+void tls_profile_session_store(const char *key, esp_tls_client_session_t *session)
+{
+    (void)key;
+    (void)session;
+}
+
+void tls_profile_session_offer(esp_tls_cfg_t *cfg, const char *key)
+{
+    (void)cfg;
+    (void)key;
+}
+
+void tls_profile_session_finish(esp_tls_cfg_t *cfg, esp_tls_t *tls, const char *key)
+{
+    (void)cfg;
+    (void)tls;
+    (void)key;
+}
+
+size_t tls_profile_sessions_export(uint8_t *out, size_t capacity)
+{
+    (void)out;
+    (void)capacity;
+    return 0;
+}
+
+size_t tls_profile_sessions_import(const uint8_t *data, size_t length)
+{
+    (void)data;
+    (void)length;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,174 @@
+#include "traffic_capture.h"
+#include "sdkconfig.h"
+
+#if CONFIG_TRAFFIC_CAPTURE
+#include <stdio.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+#include "freertos/task.h"
+#include "mem_task.h"
+
+static const char *TAG = "traffic_capture";
+
+#define STOP_TIMEOUT_MS     5000
+
+static RingbufHandle_t ring;
+static FILE *file;
+static TaskHandle_t writer;
+static TaskHandle_t stopper;            // Waiting in traffic_capture_stop()
+static volatile bool active;
+static volatile bool stopping;
+static int64_t start_us;
+static size_t written;
+static uint32_t dropped;
+
+static void Writer_Task(void *arg) {
+    bool dirty = false;
+    while (true) {
+        size_t size;
+        void *item = xRingbufferReceive(ring, &size, pdMS_TO_TICKS(TRAFFIC_CAPTURE_FLUSH_MS));
+        if (item) {
+            bool full = written + size > (size_t)CONFIG_TRAFFIC_CAPTURE_MAX_KB * 1024;
+            if (!full && fwrite(item, 1, size, file) != size) {
+                ESP_LOGE(TAG, "Write failed after %u bytes, stopping", (unsigned)written);
+                full = true;
+            }
+            vRingbufferReturnItem(ring, item);
+            if (full) {
+                if (active) {
+                    ESP_LOGW(TAG, "Capture full at %u KB", (unsigned)(written / 1024));
+                }
+                active = false;     // What is queued still drains, unwritten
+                continue;
+            }
+            written += size;
+            dirty = true;
+            continue;
+        }
+        if (dirty) {
+            fflush(file);
+            dirty = false;
+        }
+        if (stopping) {
+            break;
+        }
+    }
+    fclose(file);
+    file = NULL;
+    ESP_LOGI(TAG, "Capture closed: %u bytes, %u records dropped", (unsigned)written, (unsigned)dropped);
+    xTaskNotifyGive(stopper);
+    mem_task_delete(NULL);
+}
+
+bool traffic_capture_start(const char *path) {
+    if (writer) {
+        return false;
+    }
+    file = fopen(path, "wb");
+    if (!file) {
+        ESP_LOGE(TAG, "Cannot create %s", path);
+        return false;
+    }
+    ring = xRingbufferCreateWithCaps((size_t)CONFIG_TRAFFIC_CAPTURE_RING_KB * 1024, RINGBUF_TYPE_NOSPLIT,
+                                     MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!ring || fwrite(TRAFFIC_FILE_MAGIC, 1, TRAFFIC_FILE_MAGIC_SIZE, file) != TRAFFIC_FILE_MAGIC_SIZE) {
+        ESP_LOGE(TAG, "Cannot start the capture");
+        goto fail;
+    }
+    written = TRAFFIC_FILE_MAGIC_SIZE;
+    dropped = 0;
+    stopping = false;
+    start_us = esp_timer_get_time();
+    if (!mem_task_create(Writer_Task, "Traffic capture", TRAFFIC_CAPTURE_WRITER_STACK, NULL,
+                         TRAFFIC_CAPTURE_WRITER_PRIORITY, &writer, TASK_PLAN_BACKGROUND_CORE,
+                         MEM_TASK_STACK_INTERNAL)) {
+        goto fail;
+    }
+    active = true;
+    ESP_LOGI(TAG, "Capturing to %s", path);
+    return true;
+
+fail:
+    if (ring) {
+        vRingbufferDeleteWithCaps(ring);
+        ring = NULL;
+    }
+    fclose(file);
+    file = NULL;
+    writer = NULL;
+    return false;
+}
+
+void traffic_capture_stop(void) {
+    if (!writer) {
+        return;
+    }
+    // A record under way when active drops is queued long before the ring goes
+    active = false;
+    stopper = xTaskGetCurrentTaskHandle();
+    stopping = true;
+    if (!ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(STOP_TIMEOUT_MS))) {
+        ESP_LOGE(TAG, "Writer did not finish; the ring is leaked");
+        return;
+    }
+    vRingbufferDeleteWithCaps(ring);
+    ring = NULL;
+    writer = NULL;
+}
+
+bool traffic_capture_active(void) {
+    return active;
+}
+
+void traffic_capture_record(traffic_kind_t kind, const char *key, int32_t status, const void *body, size_t length) {
+    if (!active) {
+        return;
+    }
+    size_t key_length = key ? strlen(key) : 0;
+    if (key_length > TRAFFIC_KEY_MAX) {
+        key_length = TRAFFIC_KEY_MAX;
+    }
+    size_t size = TRAFFIC_RECORD_HEADER_SIZE + key_length + length;
+    uint8_t *item = NULL;
+    if (length > TRAFFIC_BODY_MAX || size > xRingbufferGetMaxItemSize(ring) ||
+        xRingbufferSendAcquire(ring, (void **)&item, size, 0) != pdTRUE) {
+        __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    traffic_record_encode_header(item, kind, key_length, status, length, (uint64_t)(esp_timer_get_time() - start_us));
+    if (key_length) {
+        memcpy(item + TRAFFIC_RECORD_HEADER_SIZE, key, key_length);
+    }
+    memcpy(item + TRAFFIC_RECORD_HEADER_SIZE + key_length, body, length);
+    xRingbufferSendComplete(ring, item);
+}
+
+uint32_t traffic_capture_dropped(void) {
+    return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
+
+#else
+
+bool traffic_capture_start(const char *path) {
+    return false;
+}
+
+void traffic_capture_stop(void) {
+}
+
+bool traffic_capture_active(void) {
+    return false;
+}
+
+void traffic_capture_record(traffic_kind_t kind, const char *key, int32_t status, const void *body, size_t length) {
+}
+
+uint32_t traffic_capture_dropped(void) {
+    return 0;
+}
+
+#endif
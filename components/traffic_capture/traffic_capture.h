@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "task_plan.h"
+#include "traffic_format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Traffic capture - record what the Cast and Spotify controllers receive
+ *
+ * With TRAFFIC_CAPTURE, every Cast frame the ChromecastController decodes
+ * and every Web API response SpotifyApiClient gets is written to a file
+ * (traffic_format.h), with the time it arrived, for replaying through the
+ * controllers later: espcaster_bench on the device, replay_traffic in the
+ * host build.
+ *
+ * traffic_capture_record() runs on the receiving task and never waits: the
+ * record is copied into a ring in PSRAM, or dropped and counted when it
+ * does not fit. A writer task below the UI appends the ring to the file
+ * and flushes it whenever the ring runs empty, so the file is complete up
+ * to the last record written if the board resets. The capture stops by
+ * itself at TRAFFIC_CAPTURE_MAX_KB.
+ *
+ * One capture at a time; start and stop from one task.
+ */
+
+#define TRAFFIC_CAPTURE_WRITER_PRIORITY     (TASK_PLAN_BACKGROUND_PRIORITY + 1)
+#define TRAFFIC_CAPTURE_WRITER_STACK        3072
+#define TRAFFIC_CAPTURE_FLUSH_MS            500     // Flushed after the ring has been empty this long
+
+/**
+ * @brief Start recording into path (created or truncated)
+ *
+ * @return false if disabled, already capturing, or the file or ring could
+ *         not be set up
+ */
+bool traffic_capture_start(const char *path);
+
+/**
+ * @brief Write out what is queued and close the file
+ */
+void traffic_capture_stop(void);
+
+bool traffic_capture_active(void);
+
+/**
+ * @brief Queue one received message; a no-op unless capturing
+ *
+ * @param key NULL for none
+ */
+void traffic_capture_record(traffic_kind_t kind, const char *key, int32_t status, const void *body, size_t length);
+
+/**
+ * @brief Records dropped on a full ring since the capture started
+ */
+uint32_t traffic_capture_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,143 @@
+#include "traffic_format.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void put_le(uint8_t *out, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint64_t get_le(const uint8_t *in, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value |= (uint64_t)in[i] << (8 * i);
+    }
+    return value;
+}
+
+void traffic_record_encode_header(uint8_t out[TRAFFIC_RECORD_HEADER_SIZE], traffic_kind_t kind, size_t key_length,
+                                  int32_t status, size_t body_length, uint64_t time_us) {
+    out[0] = (uint8_t)kind;
+    out[1] = 0;
+    put_le(out + 2, key_length, 2);
+    put_le(out + 4, (uint32_t)status, 4);
+    put_le(out + 8, body_length, 4);
+    put_le(out + 12, time_us, 8);
+}
+
+bool traffic_reader_open(traffic_reader_t *reader, FILE *file) {
+    char magic[TRAFFIC_FILE_MAGIC_SIZE];
+    if (!file || fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+        memcmp(magic, TRAFFIC_FILE_MAGIC, sizeof(magic)) != 0) {
+        return false;
+    }
+    reader->file = file;
+    reader->buffer = NULL;
+    reader->capacity = 0;
+    return true;
+}
+
+int traffic_reader_next(traffic_reader_t *reader, traffic_record_t *record) {
+    uint8_t header[TRAFFIC_RECORD_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), reader->file) != sizeof(header)) {
+        return 0;
+    }
+    size_t key_length = (size_t)get_le(header + 2, 2);
+    size_t body_length = (size_t)get_le(header + 8, 4);
+    if ((header[0] != TRAFFIC_CAST_FRAME && header[0] != TRAFFIC_SPOTIFY_RESPONSE) ||
+        key_length > TRAFFIC_KEY_MAX || body_length > TRAFFIC_BODY_MAX) {
+        return -1;
+    }
+
+    size_t needed = key_length + 1 + body_length;
+    if (needed > reader->capacity) {
+        uint8_t *buffer = realloc(reader->buffer, needed);
+        if (!buffer) {
+            return -1;
+        }
+        reader->buffer = buffer;
+        reader->capacity = needed;
+    }
+    uint8_t *key = reader->buffer;
+    uint8_t *body = key + key_length + 1;
+    if (fread(key, 1, key_length, reader->file) != key_length ||
+        fread(body, 1, body_length, reader->file) != body_length) {
+        return 0;
+    }
+    key[key_length] = '\0';
+
+    record->kind = (traffic_kind_t)header[0];
+    record->status = (int32_t)(uint32_t)get_le(header + 4, 4);
+    record->time_us = get_le(header + 12, 8);
+    record->key = (const char *)key;
+    record->key_length = key_length;
+    record->body = body;
+    record->body_length = body_length;
+    return 1;
+}
+
+void traffic_reader_close(traffic_reader_t *reader) {
+    free(reader->buffer);
+    reader->buffer = NULL;
+    reader->capacity = 0;
+    if (reader->file) {
+        fclose(reader->file);
+        reader->file = NULL;
+    }
+}
+
+// The path of "GET /path?query" is path; false for another method
+static bool get_path(const char *key, const char **path, size_t *length) {
+    if (strncmp(key, "GET ", 4) != 0) {
+        return false;
+    }
+    *path = key + 4;
+    *length = strcspn(*path, "?");
+    return true;
+}
+
+static bool path_is(const char *path, size_t length, const char *expected) {
+    return length == strlen(expected) && memcmp(path, expected, length) == 0;
+}
+
+static bool path_starts(const char *path, size_t length, const char *prefix) {
+    size_t n = strlen(prefix);
+    return length >= n && memcmp(path, prefix, n) == 0;
+}
+
+traffic_spotify_endpoint_t traffic_spotify_endpoint(const char *key) {
+    const char *path;
+    size_t length;
+    if (!get_path(key, &path, &length)) {
+        return TRAFFIC_SPOTIFY_OTHER;
+    }
+    if (path_is(path, length, "/me/player")) {
+        return TRAFFIC_SPOTIFY_PLAYBACK;
+    }
+    if (path_is(path, length, "/me/player/devices")) {
+        return TRAFFIC_SPOTIFY_DEVICES;
+    }
+    if (path_is(path, length, "/me/player/queue")) {
+        return TRAFFIC_SPOTIFY_QUEUE;
+    }
+    if (path_is(path, length, "/search")) {
+        return TRAFFIC_SPOTIFY_SEARCH;
+    }
+    if (path_is(path, length, "/tracks")) {
+        return TRAFFIC_SPOTIFY_SEVERAL_TRACKS;
+    }
+    if (path_is(path, length, "/albums")) {
+        return TRAFFIC_SPOTIFY_SEVERAL_ALBUMS;
+    }
+    if (path_is(path, length, "/artists")) {
+        return TRAFFIC_SPOTIFY_SEVERAL_ARTISTS;
+    }
+    if (path_starts(path, length, "/playlists/") && length > 7 && memcmp(path + length - 7, "/tracks", 7) == 0) {
+        return TRAFFIC_SPOTIFY_PLAYLIST_TRACKS;
+    }
+    if (length > 10 && memcmp(path + length - 10, "/playlists", 10) == 0) {
+        return TRAFFIC_SPOTIFY_PLAYLISTS;
+    }
+    return TRAFFIC_SPOTIFY_OTHER;
+}
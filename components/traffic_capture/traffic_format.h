@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Traffic capture files - what the controllers received, with timing
+ *
+ * A file is TRAFFIC_FILE_MAGIC, then one record per received message:
+ *
+ *   kind (1), reserved (1), key length (2), status (4), body length (4),
+ *   time in microseconds since the capture started (8), key, body
+ *
+ * little-endian. A Cast record's body is one CastMessage, the frame
+ * without its length prefix, and it has no key. A Spotify record is one
+ * Web API response: the key is "<method> <endpoint>", the status the HTTP
+ * status and the body the whole response, however it arrived in chunks.
+ *
+ * The reader is plain C on stdio, with no ESP-IDF dependency, so the
+ * host build replays the same files as the device.
+ */
+
+#define TRAFFIC_FILE_MAGIC          "ESPCTRF1"
+#define TRAFFIC_FILE_MAGIC_SIZE     8
+#define TRAFFIC_RECORD_HEADER_SIZE  20
+#define TRAFFIC_KEY_MAX             1024        // Longer keys mark a corrupt file
+#define TRAFFIC_BODY_MAX            (256 * 1024)
+
+typedef enum {
+    TRAFFIC_CAST_FRAME = 1,
+    TRAFFIC_SPOTIFY_RESPONSE = 2,
+} traffic_kind_t;
+
+typedef struct {
+    traffic_kind_t kind;
+    int32_t status;
+    uint64_t time_us;
+    const char *key;            // NUL-terminated, "" for none
+    size_t key_length;
+    const uint8_t *body;
+    size_t body_length;
+} traffic_record_t;
+
+typedef struct {
+    FILE *file;
+    uint8_t *buffer;            // Key, NUL, body of the last record
+    size_t capacity;
+} traffic_reader_t;
+
+// The Spotify responses replay knows how to parse, from the record's key
+typedef enum {
+    TRAFFIC_SPOTIFY_OTHER,              // Commands and anything not parsed
+    TRAFFIC_SPOTIFY_PLAYLISTS,          // GET /me/playlists
+    TRAFFIC_SPOTIFY_PLAYLIST_TRACKS,    // GET /playlists/{id}/tracks
+    TRAFFIC_SPOTIFY_SEARCH,             // GET /search
+    TRAFFIC_SPOTIFY_QUEUE,              // GET /me/player/queue
+    TRAFFIC_SPOTIFY_SEVERAL_TRACKS,     // GET /tracks?ids=
+    TRAFFIC_SPOTIFY_SEVERAL_ALBUMS,     // GET /albums?ids=
+    TRAFFIC_SPOTIFY_SEVERAL_ARTISTS,    // GET /artists?ids=
+    TRAFFIC_SPOTIFY_PLAYBACK,           // GET /me/player
+    TRAFFIC_SPOTIFY_DEVICES,            // GET /me/player/devices
+} traffic_spotify_endpoint_t;
+
+void traffic_record_encode_header(uint8_t out[TRAFFIC_RECORD_HEADER_SIZE], traffic_kind_t kind, size_t key_length,
+                                  int32_t status, size_t body_length, uint64_t time_us);
+
+/**
+ * @brief Start reading file, after checking its magic
+ *
+ * @return false if it is not a capture; the file is not closed then
+ */
+bool traffic_reader_open(traffic_reader_t *reader, FILE *file);
+
+/**
+ * @brief The next record; valid until the next call
+ *
+ * @return 1 for a record, 0 at the end (a record cut short by a full card
+ *         or a reset counts as the end), -1 for a corrupt file or no memory
+ */
+int traffic_reader_next(traffic_reader_t *reader, traffic_record_t *record);
+
+// Frees the buffer and closes the file
+void traffic_reader_close(traffic_reader_t *reader);
+
+traffic_spotify_endpoint_t traffic_spotify_endpoint(const char *key);
+
+#ifdef __cplusplus
+}
+#endif
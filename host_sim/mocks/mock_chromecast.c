@@ -0,0 +1,258 @@
+// Chromecast discovery and controller: three speakers that answer every request
+#include "chromecast_discovery_wrapper.h"
+#include "chromecast_controller_wrapper.h"
+#include "lvgl.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "mock_chromecast";
+
+#define DISCOVERY_MS        1500
+#define CONNECT_STEP_MS     250
+
+struct chromecast_device_table {
+    size_t count;
+    chromecast_device_info_t devices[3];
+};
+
+static const chromecast_device_table_t s_table = {
+    .count = 3,
+    .devices = {
+        {.name = "Living Room", .ip_address = "192.168.1.20", .port = 8009, .model = "Google Home",
+         .uuid = "mock-living-room", .capabilities = CHROMECAST_CAP_AUDIO_OUT},
+        {.name = "Kitchen Display", .ip_address = "192.168.1.21", .port = 8009, .model = "Nest Hub",
+         .uuid = "mock-kitchen", .capabilities = CHROMECAST_CAP_AUDIO_OUT | CHROMECAST_CAP_VIDEO_OUT},
+        {.name = "Downstairs", .ip_address = "192.168.1.22", .port = 32187, .model = "Google Cast Group",
+         .uuid = "mock-downstairs", .capabilities = CHROMECAST_CAP_AUDIO_OUT | CHROMECAST_CAP_MULTIZONE_GROUP},
+    },
+};
+
+typedef struct {
+    chromecast_discovery_callback_t callback;
+    chromecast_device_found_callback_t found_callback;
+    chromecast_device_event_callback_t event_callback;
+    bool active;
+    bool announced;
+} mock_discovery_t;
+
+typedef struct {
+    chromecast_connection_state_t state;
+    chromecast_volume_info_t volume;
+    chromecast_state_callback_t state_callback;
+    chromecast_volume_callback_t volume_callback;
+    chromecast_connect_progress_callback_t progress_callback;
+    lv_timer_t *connect_timer;
+    int connect_step;
+} mock_controller_t;
+
+static mock_discovery_t s_discovery;
+static mock_controller_t s_controller;
+
+static const chromecast_device_info_t *mock_chromecast_devices(size_t *count) {
+    *count = s_discovery.announced ? s_table.count : 0;
+    return s_table.devices;
+}
+
+static void discovery_done_cb(lv_timer_t *timer) {
+    mock_discovery_t *discovery = timer->user_data;
+    for (size_t i = 0; i < s_table.count; i++) {
+        if (discovery->event_callback) {
+            discovery->event_callback(discovery->announced ? CHROMECAST_DEVICE_UPDATED : CHROMECAST_DEVICE_ADDED,
+                                      &s_table.devices[i]);
+        }
+        if (discovery->found_callback) {
+            discovery->found_callback(&s_table.devices[i]);
+        }
+    }
+    discovery->announced = true;
+    discovery->active = false;
+    if (discovery->callback) {
+        discovery->callback(s_table.devices, s_table.count);
+    }
+}
+
+chromecast_discovery_handle_t chromecast_discovery_create(void) {
+    return &s_discovery;
+}
+
+void chromecast_discovery_set_callback(chromecast_discovery_handle_t handle, chromecast_discovery_callback_t callback) {
+    ((mock_discovery_t *)handle)->callback = callback;
+}
+
+void chromecast_discovery_set_device_found_callback(chromecast_discovery_handle_t handle,
+                                                   chromecast_device_found_callback_t callback) {
+    ((mock_discovery_t *)handle)->found_callback = callback;
+}
+
+void chromecast_discovery_set_device_event_callback(chromecast_discovery_handle_t handle,
+                                                    chromecast_device_event_callback_t callback) {
+    ((mock_discovery_t *)handle)->event_callback = callback;
+}
+
+bool chromecast_discovery_discover_async(chromecast_discovery_handle_t handle) {
+    mock_discovery_t *discovery = handle;
+    if (discovery->active) {
+        return true;
+    }
+    discovery->active = true;
+    lv_timer_set_repeat_count(lv_timer_create(discovery_done_cb, DISCOVERY_MS, discovery), 1);
+    return true;
+}
+
+bool chromecast_discovery_start_browse(chromecast_discovery_handle_t handle) {
+    return chromecast_discovery_discover_async(handle);
+}
+
+bool chromecast_discovery_is_active(chromecast_discovery_handle_t handle) {
+    return ((mock_discovery_t *)handle)->active;
+}
+
+const chromecast_device_table_t *chromecast_discovery_acquire_devices(chromecast_discovery_handle_t handle) {
+    return &s_table;
+}
+
+void chromecast_device_table_release(const chromecast_device_table_t *table) {
+}
+
+const chromecast_device_info_t *chromecast_device_table_devices(const chromecast_device_table_t *table,
+                                                                size_t *device_count) {
+    return mock_chromecast_devices(device_count);
+}
+
+static void set_state(mock_controller_t *controller, chromecast_connection_state_t state) {
+    controller->state = state;
+    if (controller->state_callback) {
+        controller->state_callback(state);
+    }
+}
+
+static void progress(mock_controller_t *controller, chromecast_connect_stage_t stage) {
+    if (controller->progress_callback) {
+        controller->progress_callback(stage);
+    }
+}
+
+// TLS handshake, virtual connection, then connected with the speaker's volume
+static void connect_step_cb(lv_timer_t *timer) {
+    mock_controller_t *controller = timer->user_data;
+    switch (controller->connect_step++) {
+    case 0:
+        progress(controller, CHROMECAST_CONNECT_TLS_HANDSHAKE);
+        break;
+    case 1:
+        progress(controller, CHROMECAST_CONNECT_VIRTUAL_CONNECT);
+        break;
+    default:
+        lv_timer_del(timer);
+        controller->connect_timer = NULL;
+        progress(controller, CHROMECAST_CONNECT_COMPLETE);
+        set_state(controller, CHROMECAST_CONNECTED);
+        if (controller->volume_callback) {
+            controller->volume_callback(&controller->volume);
+        }
+        break;
+    }
+}
+
+static void connect_cancel(mock_controller_t *controller) {
+    if (controller->connect_timer) {
+        lv_timer_del(controller->connect_timer);
+        controller->connect_timer = NULL;
+    }
+}
+
+chromecast_controller_handle_t chromecast_controller_create(void) {
+    s_controller.volume.level = 0.4f;
+    return &s_controller;
+}
+
+void chromecast_controller_destroy(chromecast_controller_handle_t handle) {
+    connect_cancel(handle);
+}
+
+bool chromecast_controller_initialize(chromecast_controller_handle_t handle) {
+    return true;
+}
+
+bool chromecast_controller_connect_async_port(chromecast_controller_handle_t handle, const char *ip,
+                                             int port, const char *device_uuid) {
+    mock_controller_t *controller = handle;
+    ESP_LOGI(TAG, "Connecting to %s:%d", ip, port);
+    connect_cancel(controller);
+    controller->connect_step = 0;
+    controller->connect_timer = lv_timer_create(connect_step_cb, CONNECT_STEP_MS, controller);
+    set_state(controller, CHROMECAST_CONNECTING);
+    return true;
+}
+
+bool chromecast_controller_connect_background(chromecast_controller_handle_t handle, const char *ip,
+                                             int port, const char *device_uuid) {
+    return chromecast_controller_connect_async_port(handle, ip, port, device_uuid);
+}
+
+void chromecast_controller_cancel_connect(chromecast_controller_handle_t handle) {
+    mock_controller_t *controller = handle;
+    if (controller->connect_timer) {
+        connect_cancel(controller);
+        progress(controller, CHROMECAST_CONNECT_CANCELLED);
+        set_state(controller, CHROMECAST_DISCONNECTED);
+    }
+}
+
+void chromecast_controller_disconnect(chromecast_controller_handle_t handle) {
+    connect_cancel(handle);
+    set_state(handle, CHROMECAST_DISCONNECTED);
+}
+
+chromecast_connection_state_t chromecast_controller_get_state(chromecast_controller_handle_t handle) {
+    return ((mock_controller_t *)handle)->state;
+}
+
+bool chromecast_controller_get_status(chromecast_controller_handle_t handle) {
+    return ((mock_controller_t *)handle)->state == CHROMECAST_CONNECTED;
+}
+
+bool chromecast_controller_request_volume(chromecast_controller_handle_t handle, float level, bool muted) {
+    mock_controller_t *controller = handle;
+    if (controller->state != CHROMECAST_CONNECTED) {
+        return false;
+    }
+    controller->volume.level = level;
+    controller->volume.muted = muted;
+    if (controller->volume_callback) {
+        controller->volume_callback(&controller->volume);
+    }
+    return true;
+}
+
+bool chromecast_controller_load_file(chromecast_controller_handle_t handle, const char *path,
+                                     const char *title, bool autoplay) {
+    ESP_LOGI(TAG, "Casting %s", path);
+    return ((mock_controller_t *)handle)->state == CHROMECAST_CONNECTED;
+}
+
+void chromecast_controller_set_state_callback(chromecast_controller_handle_t handle,
+                                             chromecast_state_callback_t callback) {
+    ((mock_controller_t *)handle)->state_callback = callback;
+}
+
+void chromecast_controller_set_volume_callback(chromecast_controller_handle_t handle,
+                                              chromecast_volume_callback_t callback) {
+    ((mock_controller_t *)handle)->volume_callback = callback;
+}
+
+void chromecast_controller_set_connect_progress_callback(chromecast_controller_handle_t handle,
+                                                        chromecast_connect_progress_callback_t callback) {
+    ((mock_controller_t *)handle)->progress_callback = callback;
+}
+
+int esp_cast_get_chromecast_devices_for_spotify_strings(char devices[][64], int max_devices) {
+    size_t count;
+    const chromecast_device_info_t *found = mock_chromecast_devices(&count);
+    int n = 0;
+    for (; n < max_devices && (size_t)n < count; n++) {
+        strncpy(devices[n], found[n].name, 63);
+        devices[n][63] = '\0';
+    }
+    return n;
+}
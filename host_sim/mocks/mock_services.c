@@ -0,0 +1,72 @@
+// The settings, snapshot and API modules behind the GUI: nothing stored, nothing served
+#include "config_store.h"
+#include "control_api.h"
+#include "spotify_config_manager.h"
+#include "spotify_library_snapshot.h"
+#include "voice_vocabulary.h"
+#include <string.h>
+
+esp_err_t config_store_get_blob(const char *ns, const char *key, void *out, size_t *length) {
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t config_store_set_blob(const char *ns, const char *key, const void *value, size_t length) {
+    return ESP_OK;
+}
+
+void control_api_set_cast_status(const char *device, bool connected) {
+}
+
+void control_api_set_spotify_devices(const spotify_device_view_t *devices, size_t count) {
+}
+
+bool spotify_config_is_configured(void) {
+    return true;
+}
+
+esp_err_t spotify_config_load(spotify_config_t *config) {
+    memset(config, 0, sizeof(*config));
+    strncpy(config->client_id, "sim-client-id", sizeof(config->client_id) - 1);
+    strncpy(config->redirect_uri, spotify_config_get_default_redirect_uri(), sizeof(config->redirect_uri) - 1);
+    config->is_configured = true;
+    return ESP_OK;
+}
+
+esp_err_t spotify_config_save(const spotify_config_t *config) {
+    return ESP_OK;
+}
+
+bool spotify_config_validate(const spotify_config_t *config) {
+    return config->client_id[0] != '\0';
+}
+
+const char *spotify_config_get_default_redirect_uri(void) {
+    return "http://espcaster.local/callback";
+}
+
+bool spotify_snapshot_load(void) {
+    return false;
+}
+
+const spotify_playlist_view_t *spotify_snapshot_playlists(size_t *count) {
+    *count = 0;
+    return NULL;
+}
+
+const spotify_playback_state_t *spotify_snapshot_playback(void) {
+    return NULL;
+}
+
+const spotify_track_info_t *spotify_snapshot_recent_track(size_t index) {
+    return NULL;
+}
+
+void spotify_snapshot_set_playback(const spotify_playback_state_t *playback) {
+}
+
+bool spotify_snapshot_set_playlists(const spotify_playlist_view_t *playlists, size_t count) {
+    return true;
+}
+
+void voice_vocabulary_set_playlists(const spotify_playlist_view_t *playlists, size_t count) {
+}
@@ -0,0 +1,341 @@
+// Spotify controller and the esp_cast glue the GUI calls: a signed-in account
+// with a paged library, and playback that follows every command
+#include "spotify_controller_wrapper.h"
+#include "esp_cast.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "mock_spotify";
+
+#define PLAYLIST_COUNT      45
+#define TRACK_COUNT         60
+#define SEARCH_COUNT        12
+#define PAGE_SIZE           20
+#define REPLY_MS            300         // A Web API round trip
+
+typedef struct {
+    char id[24];
+    char name[64];
+    char uri[48];
+    char artist[48];
+} mock_item_t;
+
+typedef struct {
+    spotify_auth_state_callback_t auth_callback;
+    spotify_connection_state_callback_t connection_callback;
+    spotify_playback_state_callback_t playback_callback;
+    spotify_playlists_callback_t playlists_callback;
+    spotify_tracks_callback_t tracks_callback;
+    spotify_queue_callback_t queue_callback;
+    spotify_devices_callback_t devices_callback;
+    spotify_auth_state_t auth_state;
+    spotify_playback_state_t playback;
+    size_t playlists_sent;
+    size_t tracks_sent;
+    size_t tracks_total;
+    int track_index;
+} mock_spotify_t;
+
+static mock_spotify_t s_spotify;
+static mock_item_t s_playlists[PLAYLIST_COUNT];
+static spotify_playlist_view_t s_playlist_views[PLAYLIST_COUNT];
+static mock_item_t s_tracks[TRACK_COUNT];
+static spotify_track_view_t s_track_views[TRACK_COUNT];
+
+static void reply(lv_timer_cb_t cb) {
+    lv_timer_set_repeat_count(lv_timer_create(cb, REPLY_MS, &s_spotify), 1);
+}
+
+static void fill_tracks(const char *prefix, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        mock_item_t *item = &s_tracks[i];
+        snprintf(item->id, sizeof(item->id), "track%02u", (unsigned)i);
+        snprintf(item->name, sizeof(item->name), "%s %u", prefix, (unsigned)i + 1);
+        snprintf(item->uri, sizeof(item->uri), "spotify:track:%s", item->id);
+        snprintf(item->artist, sizeof(item->artist), "Artist %c", 'A' + (int)(i % 26));
+        s_track_views[i] = (spotify_track_view_t){
+            .id = item->id, .name = item->name, .artist = item->artist, .album = "Mock Album",
+            .uri = item->uri, .image_url = "", .duration_ms = 150000 + (int)i * 7000,
+        };
+    }
+    s_spotify.tracks_sent = 0;
+    s_spotify.tracks_total = count;
+}
+
+static void send_playback(void) {
+    if (s_spotify.playback_callback) {
+        s_spotify.playback_callback(&s_spotify.playback);
+    }
+}
+
+static void set_track(int index) {
+    const spotify_track_view_t *view = &s_track_views[index];
+    spotify_track_info_t *track = &s_spotify.playback.current_track;
+    s_spotify.track_index = index;
+    strncpy(track->id, view->id, sizeof(track->id) - 1);
+    strncpy(track->name, view->name, sizeof(track->name) - 1);
+    strncpy(track->artist, view->artist, sizeof(track->artist) - 1);
+    strncpy(track->album, view->album, sizeof(track->album) - 1);
+    strncpy(track->uri, view->uri, sizeof(track->uri) - 1);
+    track->duration_ms = view->duration_ms;
+    s_spotify.playback.progress_ms = 0;
+    s_spotify.playback.is_playing = true;
+}
+
+static void playlists_page_cb(lv_timer_t *timer) {
+    size_t first = s_spotify.playlists_sent;
+    size_t count = first + PAGE_SIZE < PLAYLIST_COUNT ? first + PAGE_SIZE : PLAYLIST_COUNT;
+    s_spotify.playlists_sent = count;
+    if (s_spotify.playlists_callback) {
+        s_spotify.playlists_callback(s_playlist_views, count, first);
+    }
+}
+
+static void tracks_page_cb(lv_timer_t *timer) {
+    size_t first = s_spotify.tracks_sent;
+    size_t count = first + PAGE_SIZE < s_spotify.tracks_total ? first + PAGE_SIZE : s_spotify.tracks_total;
+    s_spotify.tracks_sent = count;
+    if (s_spotify.tracks_callback) {
+        s_spotify.tracks_callback(s_track_views, count, first);
+    }
+}
+
+static void signed_in_cb(lv_timer_t *timer) {
+    s_spotify.auth_state = SPOTIFY_AUTH_AUTHENTICATED;
+    if (s_spotify.auth_callback) {
+        s_spotify.auth_callback(SPOTIFY_AUTH_AUTHENTICATED);
+    }
+    if (s_spotify.connection_callback) {
+        s_spotify.connection_callback(SPOTIFY_CONNECTION_CONNECTED);
+    }
+}
+
+static void playback_cb(lv_timer_t *timer) {
+    send_playback();
+    if (s_spotify.queue_callback) {
+        int count = (int)s_spotify.tracks_total;
+        spotify_track_info_t previous = {0}, next = {0};
+        snprintf(previous.name, sizeof(previous.name), "%s", s_track_views[(s_spotify.track_index + count - 1) % count].name);
+        snprintf(next.name, sizeof(next.name), "%s", s_track_views[(s_spotify.track_index + 1) % count].name);
+        s_spotify.queue_callback(&previous, &next);
+    }
+}
+
+// Connect devices: this one, a phone, and a speaker discovery also lists
+static const spotify_device_view_t s_devices[] = {
+    {.id = "dev-espcaster", .name = "ESPCaster", .type = "Speaker", .is_active = true, .volume_percent = 60},
+    {.id = "dev-phone", .name = "Pixel", .type = "Smartphone", .volume_percent = 80},
+    {.id = "dev-living", .name = "Living Room", .type = "CastAudio", .volume_percent = 40},
+};
+
+static void devices_cb(lv_timer_t *timer) {
+    if (s_spotify.devices_callback) {
+        s_spotify.devices_callback(s_devices, sizeof(s_devices) / sizeof(s_devices[0]));
+    }
+}
+
+spotify_controller_handle_t spotify_controller_create(void) {
+    for (size_t i = 0; i < PLAYLIST_COUNT; i++) {
+        mock_item_t *item = &s_playlists[i];
+        snprintf(item->id, sizeof(item->id), "playlist%02u", (unsigned)i);
+        snprintf(item->name, sizeof(item->name), i % 7 == 3 ? "A rather long playlist name that has to scroll %u" :
+                                                 "Playlist %u", (unsigned)i + 1);
+        snprintf(item->uri, sizeof(item->uri), "spotify:playlist:%s", item->id);
+        s_playlist_views[i] = (spotify_playlist_view_t){
+            .id = item->id, .name = item->name, .uri = item->uri, .image_url = "", .owner = "sim",
+            .track_count = TRACK_COUNT,
+        };
+    }
+    fill_tracks("Track", TRACK_COUNT);
+    set_track(0);
+    s_spotify.playback.is_playing = false;
+    s_spotify.playback.volume_percent = 60;
+    strncpy(s_spotify.playback.repeat_state, "off", sizeof(s_spotify.playback.repeat_state) - 1);
+    strncpy(s_spotify.playback.device_name, "ESPCaster", sizeof(s_spotify.playback.device_name) - 1);
+    s_spotify.auth_state = SPOTIFY_AUTH_AUTHENTICATED;
+    ESP_LOGI(TAG, "Mock account with %d playlists", PLAYLIST_COUNT);
+    return &s_spotify;
+}
+
+bool spotify_controller_start_authentication(spotify_controller_handle_t handle) {
+    s_spotify.auth_state = SPOTIFY_AUTH_AUTHENTICATING;
+    if (s_spotify.auth_callback) {
+        s_spotify.auth_callback(SPOTIFY_AUTH_AUTHENTICATING);
+    }
+    lv_timer_set_repeat_count(lv_timer_create(signed_in_cb, 1500, NULL), 1);
+    return true;
+}
+
+bool spotify_controller_get_auth_url(spotify_controller_handle_t handle, char *url_buffer, size_t buffer_size) {
+    snprintf(url_buffer, buffer_size, "https://accounts.spotify.com/authorize?client_id=sim");
+    return true;
+}
+
+bool spotify_controller_get_playlists(spotify_controller_handle_t handle) {
+    s_spotify.playlists_sent = 0;
+    reply(playlists_page_cb);
+    return true;
+}
+
+bool spotify_controller_load_more_playlists(spotify_controller_handle_t handle) {
+    if (s_spotify.playlists_sent == 0 || s_spotify.playlists_sent >= PLAYLIST_COUNT) {
+        return false;
+    }
+    reply(playlists_page_cb);
+    return true;
+}
+
+bool spotify_controller_get_playlist_tracks(spotify_controller_handle_t handle, const char *playlist_id) {
+    fill_tracks("Track", TRACK_COUNT);
+    reply(tracks_page_cb);
+    return true;
+}
+
+bool spotify_controller_search_tracks(spotify_controller_handle_t handle, const char *query, int limit) {
+    fill_tracks(query, SEARCH_COUNT < limit || limit <= 0 ? SEARCH_COUNT : (size_t)limit);
+    reply(tracks_page_cb);
+    return true;
+}
+
+void spotify_controller_cancel_search(spotify_controller_handle_t handle) {
+}
+
+bool spotify_controller_load_more_tracks(spotify_controller_handle_t handle) {
+    if (s_spotify.tracks_sent == 0 || s_spotify.tracks_sent >= s_spotify.tracks_total) {
+        return false;
+    }
+    reply(tracks_page_cb);
+    return true;
+}
+
+bool spotify_controller_play(spotify_controller_handle_t handle, const char *uri) {
+    int index = s_spotify.track_index;
+    for (size_t i = 0; uri && i < s_spotify.tracks_total; i++) {
+        if (strcmp(s_track_views[i].uri, uri) == 0) {
+            index = (int)i;
+        }
+    }
+    set_track(index);
+    reply(playback_cb);
+    return true;
+}
+
+bool spotify_controller_pause(spotify_controller_handle_t handle) {
+    s_spotify.playback.is_playing = false;
+    reply(playback_cb);
+    return true;
+}
+
+bool spotify_controller_next_track(spotify_controller_handle_t handle) {
+    set_track((s_spotify.track_index + 1) % (int)s_spotify.tracks_total);
+    reply(playback_cb);
+    return true;
+}
+
+bool spotify_controller_previous_track(spotify_controller_handle_t handle) {
+    set_track((s_spotify.track_index + (int)s_spotify.tracks_total - 1) % (int)s_spotify.tracks_total);
+    reply(playback_cb);
+    return true;
+}
+
+bool spotify_controller_get_devices(spotify_controller_handle_t handle) {
+    reply(devices_cb);
+    return true;
+}
+
+bool spotify_controller_play_on_device(spotify_controller_handle_t handle, const char *device_name,
+                                       const char *track_uri) {
+    ESP_LOGI(TAG, "Playing %s on %s", track_uri, device_name);
+    strncpy(s_spotify.playback.device_name, device_name, sizeof(s_spotify.playback.device_name) - 1);
+    return spotify_controller_play(handle, track_uri);
+}
+
+bool spotify_controller_prewarm(spotify_controller_handle_t handle) {
+    return true;
+}
+
+const lv_img_dsc_t *spotify_controller_get_album_art(spotify_controller_handle_t handle, const char *image_url) {
+    return NULL;
+}
+
+bool spotify_controller_set_album_art_size(spotify_controller_handle_t handle, int size_px) {
+    return true;
+}
+
+// The sim's playlists and tracks have no image URLs, so nothing is fetched
+const lv_img_dsc_t *spotify_controller_get_thumbnail(spotify_controller_handle_t handle, const char *image_url) {
+    return NULL;
+}
+
+bool spotify_controller_fetch_thumbnail(spotify_controller_handle_t handle, const char *image_url, int size_px) {
+    return false;
+}
+
+void spotify_controller_cancel_thumbnail(spotify_controller_handle_t handle) {
+}
+
+void spotify_controller_set_thumbnail_callback(spotify_controller_handle_t handle,
+                                              spotify_thumbnail_callback_t callback) {
+}
+
+void spotify_controller_set_auth_state_callback(spotify_controller_handle_t handle,
+                                               spotify_auth_state_callback_t callback) {
+    s_spotify.auth_callback = callback;
+}
+
+void spotify_controller_set_connection_state_callback(spotify_controller_handle_t handle,
+                                                     spotify_connection_state_callback_t callback) {
+    s_spotify.connection_callback = callback;
+}
+
+void spotify_controller_set_playback_state_callback(spotify_controller_handle_t handle,
+                                                   spotify_playback_state_callback_t callback) {
+    s_spotify.playback_callback = callback;
+}
+
+void spotify_controller_set_playlists_callback(spotify_controller_handle_t handle,
+                                              spotify_playlists_callback_t callback) {
+    s_spotify.playlists_callback = callback;
+}
+
+void spotify_controller_set_tracks_callback(spotify_controller_handle_t handle,
+                                           spotify_tracks_callback_t callback) {
+    s_spotify.tracks_callback = callback;
+}
+
+void spotify_controller_set_devices_callback(spotify_controller_handle_t handle,
+                                            spotify_devices_callback_t callback) {
+    s_spotify.devices_callback = callback;
+}
+
+void spotify_controller_set_error_callback(spotify_controller_handle_t handle,
+                                          spotify_error_callback_t callback) {
+}
+
+void spotify_controller_set_album_art_callback(spotify_controller_handle_t handle,
+                                              spotify_album_art_callback_t callback) {
+}
+
+void spotify_controller_set_queue_callback(spotify_controller_handle_t handle,
+                                          spotify_queue_callback_t callback) {
+    s_spotify.queue_callback = callback;
+}
+
+// The mock's commands never fail
+void spotify_controller_set_command_failed_callback(spotify_controller_handle_t handle,
+                                                   spotify_command_failed_callback_t callback) {
+}
+
+spotify_controller_handle_t esp_cast_get_spotify_controller(void) {
+    return &s_spotify;
+}
+
+bool esp_cast_spotify_init(const char *client_id, const char *client_secret, const char *redirect_uri) {
+    return true;
+}
+
+bool esp_cast_spotify_to_chromecast(const char *device_name, const char *track_uri) {
+    ESP_LOGI(TAG, "Casting %s to %s", track_uri, device_name);
+    return true;
+}
@@ -0,0 +1,123 @@
+// WiFi Manager and IP events: a fixed scan and a connect that always succeeds
+#include "wifi_manager.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "mock_wifi";
+
+#define SCAN_MS         1200
+#define CONNECT_MS      800
+#define MAX_HANDLERS    4
+
+esp_event_base_t const IP_EVENT = "IP_EVENT";
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT";
+
+typedef struct {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+} handler_slot_t;
+
+static wifi_manager_config_t s_config;
+static handler_slot_t s_handlers[MAX_HANDLERS];
+static char s_ssid[33];
+static bool s_connected;
+
+static const struct {
+    const char *ssid;
+    int8_t rssi;
+    wifi_auth_mode_t authmode;
+} s_networks[] = {
+    {"HomeNet", -42, WIFI_AUTH_WPA2_PSK},
+    {"HomeNet", -71, WIFI_AUTH_WPA2_PSK},      // A second access point, merged by the scan model
+    {"Office 5G", -58, WIFI_AUTH_WPA2_WPA3_PSK},
+    {"Cafe Guest", -66, WIFI_AUTH_OPEN},
+    {"Neighbour", -80, WIFI_AUTH_WPA_WPA2_PSK},
+    {"Printer-3F2A", -85, WIFI_AUTH_WPA2_PSK},
+};
+
+static void scan_done_cb(lv_timer_t *timer) {
+    wifi_ap_record_t aps[sizeof(s_networks) / sizeof(s_networks[0])] = {0};
+    uint16_t count = sizeof(aps) / sizeof(aps[0]);
+    for (uint16_t i = 0; i < count; i++) {
+        strncpy((char *)aps[i].ssid, s_networks[i].ssid, sizeof(aps[i].ssid) - 1);
+        aps[i].rssi = s_networks[i].rssi;
+        aps[i].authmode = s_networks[i].authmode;
+        aps[i].primary = 1 + i * 5 % 13;
+    }
+    if (s_config.scan_callback) {
+        s_config.scan_callback(aps, count);
+    }
+}
+
+static void connect_done_cb(lv_timer_t *timer) {
+    s_connected = true;
+    ESP_LOGI(TAG, "Connected to %s", s_ssid);
+    if (s_config.status_callback) {
+        s_config.status_callback(s_ssid, "192.168.1.42", true);
+    }
+    for (int i = 0; i < MAX_HANDLERS; i++) {
+        if (s_handlers[i].handler && s_handlers[i].base == IP_EVENT &&
+            (s_handlers[i].id == IP_EVENT_STA_GOT_IP || s_handlers[i].id == ESP_EVENT_ANY_ID)) {
+            s_handlers[i].handler(s_handlers[i].arg, IP_EVENT, IP_EVENT_STA_GOT_IP, NULL);
+        }
+    }
+}
+
+esp_err_t wifi_manager_init(const wifi_manager_config_t *config) {
+    s_config = *config;
+    if (config->auto_connect) {
+        strncpy(s_ssid, "HomeNet", sizeof(s_ssid) - 1);
+        lv_timer_set_repeat_count(lv_timer_create(connect_done_cb, CONNECT_MS, NULL), 1);
+    }
+    return ESP_OK;
+}
+
+esp_err_t wifi_manager_deinit(void) {
+    memset(&s_config, 0, sizeof(s_config));
+    return ESP_OK;
+}
+
+esp_err_t wifi_manager_scan(bool show_hidden) {
+    lv_timer_set_repeat_count(lv_timer_create(scan_done_cb, SCAN_MS, NULL), 1);
+    return ESP_OK;
+}
+
+esp_err_t wifi_manager_connect(const char *ssid, const char *password, bool save_credentials) {
+    strncpy(s_ssid, ssid, sizeof(s_ssid) - 1);
+    s_connected = false;
+    if (s_config.status_callback) {
+        s_config.status_callback(NULL, NULL, false);
+    }
+    lv_timer_set_repeat_count(lv_timer_create(connect_done_cb, CONNECT_MS, NULL), 1);
+    return ESP_OK;
+}
+
+bool wifi_manager_is_connected(void) {
+    return s_connected;
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t event_base, int32_t event_id,
+                                              esp_event_handler_t event_handler, void *event_handler_arg,
+                                              esp_event_handler_instance_t *instance) {
+    for (int i = 0; i < MAX_HANDLERS; i++) {
+        if (!s_handlers[i].handler) {
+            s_handlers[i] = (handler_slot_t){event_base, event_id, event_handler, event_handler_arg};
+            if (instance) {
+                *instance = &s_handlers[i];
+            }
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_event_handler_instance_unregister(esp_event_base_t event_base, int32_t event_id,
+                                                esp_event_handler_instance_t instance) {
+    if (instance) {
+        memset(instance, 0, sizeof(handler_slot_t));
+    }
+    return ESP_OK;
+}
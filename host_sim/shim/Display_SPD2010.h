@@ -0,0 +1,9 @@
+// The panel driver's geometry, for the touch header and the sim display
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define EXAMPLE_LCD_WIDTH       (412)
+#define EXAMPLE_LCD_HEIGHT      (412)
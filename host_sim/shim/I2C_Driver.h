@@ -0,0 +1,6 @@
+// Pulled in by Touch_SPD2010.h; no I2C on the host
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include "esp_err.h"
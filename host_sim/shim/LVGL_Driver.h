@@ -0,0 +1,14 @@
+// The part of the firmware's LVGL_Driver.h the GUI uses; sim_display.c implements it
+#pragma once
+
+#include <stdbool.h>
+#include "lvgl.h"
+#include "Display_SPD2010.h"
+
+#define LVGL_BUF_LEN  (EXAMPLE_LCD_WIDTH * EXAMPLE_LCD_HEIGHT / 20)
+#define LVGL_DEFER_MAX_TIMERS  (8)             // Timers LVGL_Timer_Defer() holds at once
+#define LVGL_DEFER_MAX_MS  (1000)              // ... and for how long at most
+
+/* For timer callbacks that can wait: true (return at once) while a scroll or an animation is on screen.
+ * The timer is then run once the UI settles, or is let through after LVGL_DEFER_MAX_MS. */
+bool LVGL_Timer_Defer(lv_timer_t *timer);
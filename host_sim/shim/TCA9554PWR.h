@@ -0,0 +1,4 @@
+// Pulled in by Touch_SPD2010.h; no I/O expander on the host
+#pragma once
+
+#include "I2C_Driver.h"
@@ -0,0 +1,17 @@
+// ESP_LOGx to stderr; debug and verbose only with -DSIM_LOG_VERBOSE
+#pragma once
+
+#include <stdio.h>
+
+#define SIM_LOG(letter, tag, format, ...) fprintf(stderr, letter " (%s) " format "\n", tag, ##__VA_ARGS__)
+
+#define ESP_LOGE(tag, format, ...) SIM_LOG("E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) SIM_LOG("W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) SIM_LOG("I", tag, format, ##__VA_ARGS__)
+#ifdef SIM_LOG_VERBOSE
+#define ESP_LOGD(tag, format, ...) SIM_LOG("D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) SIM_LOG("V", tag, format, ##__VA_ARGS__)
+#else
+#define ESP_LOGD(tag, format, ...) do { (void)(tag); } while (0)
+#define ESP_LOGV(tag, format, ...) do { (void)(tag); } while (0)
+#endif
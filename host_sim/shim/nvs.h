@@ -0,0 +1,5 @@
+#pragma once
+
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle_t;
@@ -0,0 +1,7 @@
+// The firmware's sdkconfig, converted by CMakeLists.txt, with the sim's overrides
+#pragma once
+
+#include "sim_sdkconfig.h"
+
+// The SDL texture takes native RGB565; the panel wants it byte-swapped
+#undef CONFIG_LV_COLOR_16_SWAP
@@ -0,0 +1,9 @@
+// Forced into every source (see CMakeLists.txt): what newlib has and the host's libc may not
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+
+#if !SIM_HAVE_STRLCPY
+size_t strlcpy(char *dst, const char *src, size_t size);
+#endif
@@ -0,0 +1,296 @@
+#include "sim_display.h"
+#include "sim_profile.h"
+#include "LVGL_Driver.h"
+#include "LVGL_Batch.h"
+#include "LVGL_Scroll.h"
+#include "Touch_Gesture.h"
+#include "gui_event_bus.h"
+#include "esp_log.h"
+#include "misc/lv_gc.h"
+#include <SDL.h>
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "sim_display";
+
+#define WIDTH       EXAMPLE_LCD_WIDTH
+#define HEIGHT      EXAMPLE_LCD_HEIGHT
+#define WHEEL_DEG   (5.0f)          // Rotation per wheel notch
+
+static SDL_Window *window;
+static SDL_Renderer *renderer;
+static SDL_Texture *texture;
+static bool round_mask;
+static int zoom;
+
+static lv_disp_draw_buf_t draw_buf;
+static lv_disp_drv_t disp_drv;
+static lv_indev_drv_t indev_drv;
+static lv_color_t buf1[LVGL_BUF_LEN];
+static lv_color_t buf2[LVGL_BUF_LEN];
+static lv_color_t frame[WIDTH * HEIGHT];
+
+// First and last visible pixel of each row; the panel is square, so also of each column
+static int16_t round_chord_start[HEIGHT];
+static int16_t round_chord_end[HEIGHT];
+
+static lv_timer_t *deferred[LVGL_DEFER_MAX_TIMERS];
+static uint32_t deferred_since;
+
+static void init_round_mask(void) {
+    const float radius = WIDTH / 2.0f;
+    for (int i = 0; i < HEIGHT; i++) {
+        float d = i + 0.5f - radius;
+        float half = sqrtf(radius * radius - d * d);
+        round_chord_start[i] = (int16_t)ceilf(radius - half - 0.5f);
+        round_chord_end[i] = (int16_t)floorf(radius + half - 0.5f);
+    }
+}
+
+static bool round_span(int y1, int y2, int *x1, int *x2) {
+    int mid = HEIGHT / 2;
+    int row = y2 < mid ? y2 : (y1 > mid ? y1 : mid);
+    int start = round_chord_start[row] > *x1 ? round_chord_start[row] : *x1;
+    int end = round_chord_end[row] < *x2 ? round_chord_end[row] : *x2;
+    if (start > end) {
+        return false;
+    }
+    *x1 = (start >> 2) << 2;
+    *x2 = ((end >> 2) << 2) + 3;
+    return true;
+}
+
+static void collapse(lv_area_t *area) {
+    area->x1 = 0;
+    area->x2 = 3;
+    area->y1 = 0;
+    area->y2 = 0;
+}
+
+// As Lvgl_port_rounder_callback, without the scroll blit (no direct mode here)
+static void rounder_cb(lv_disp_drv_t *drv, lv_area_t *area) {
+    if (LVGL_Batch_Take_Invalidation(area)) {
+        collapse(area);
+        return;
+    }
+    if (round_mask) {
+        int mid = WIDTH / 2;
+        int vis_x1 = area->x1, vis_x2 = area->x2;
+        int col = vis_x2 < mid ? vis_x2 : (vis_x1 > mid ? vis_x1 : mid);
+        if (area->y1 < round_chord_start[col]) area->y1 = round_chord_start[col];
+        if (area->y2 > round_chord_end[col]) area->y2 = round_chord_end[col];
+        if (area->y1 > area->y2 || !round_span(area->y1, area->y2, &vis_x1, &vis_x2)) {
+            collapse(area);
+            return;
+        }
+        area->x1 = vis_x1;
+        area->x2 = vis_x2;
+    }
+    area->x1 = (area->x1 >> 2) << 2;
+    area->x2 = ((area->x2 >> 2) << 2) + 3;
+}
+
+static void render_start_cb(lv_disp_drv_t *drv) {
+    lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+    uint32_t areas = 0;
+    for (uint16_t i = 0; i < disp->inv_p; i++) {
+        areas += !disp->inv_area_joined[i];
+    }
+    sim_profile_render_start(areas);
+}
+
+static void flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map) {
+    int64_t start_us = sim_profile_now_us();
+    int width = lv_area_get_width(area);
+    for (int y = area->y1; y <= area->y2; y++) {
+        const lv_color_t *src = color_map + (size_t)(y - area->y1) * width;
+        int x1 = area->x1, x2 = area->x2;
+        if (round_mask) {
+            x1 = x1 > round_chord_start[y] ? x1 : round_chord_start[y];
+            x2 = x2 < round_chord_end[y] ? x2 : round_chord_end[y];
+        }
+        if (x1 <= x2) {
+            memcpy(&frame[y * WIDTH + x1], src + (x1 - area->x1), (size_t)(x2 - x1 + 1) * sizeof(lv_color_t));
+        }
+    }
+    sim_profile_flush((uint32_t)(sim_profile_now_us() - start_us));
+
+    if (lv_disp_flush_is_last(drv)) {
+        SDL_UpdateTexture(texture, NULL, frame, WIDTH * sizeof(lv_color_t));
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture, NULL, NULL);
+        SDL_RenderPresent(renderer);
+    }
+    lv_disp_flush_ready(drv);
+}
+
+static void monitor_cb(lv_disp_drv_t *drv, uint32_t time_ms, uint32_t px) {
+    sim_profile_render_done(px);
+}
+
+// As in LVGL_Driver.c: a scroll under way or a finite animation running
+static bool lvgl_busy(void) {
+    for (lv_indev_t *indev = lv_indev_get_next(NULL); indev; indev = lv_indev_get_next(indev)) {
+        if (lv_indev_get_scroll_obj(indev)) {
+            return true;
+        }
+    }
+    lv_anim_t *anim;
+    _LV_LL_READ(&LV_GC_ROOT(_lv_anim_ll), anim) {
+        if (anim->repeat_cnt != LV_ANIM_REPEAT_INFINITE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void release_deferred(void) {
+    for (int i = 0; i < LVGL_DEFER_MAX_TIMERS && deferred[i]; i++) {
+        for (lv_timer_t *timer = lv_timer_get_next(NULL); timer; timer = lv_timer_get_next(timer)) {
+            if (timer == deferred[i]) {
+                lv_timer_ready(timer);
+                break;
+            }
+        }
+        deferred[i] = NULL;
+    }
+}
+
+bool LVGL_Timer_Defer(lv_timer_t *timer) {
+    if (!lvgl_busy()) {
+        return false;
+    }
+    if (!deferred[0]) {
+        deferred_since = lv_tick_get();
+    } else if (lv_tick_elaps(deferred_since) >= LVGL_DEFER_MAX_MS) {
+        return false;
+    }
+    for (int i = 0; i < LVGL_DEFER_MAX_TIMERS; i++) {
+        if (deferred[i] == timer) {
+            return true;
+        }
+        if (!deferred[i]) {
+            deferred[i] = timer;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void pointer_read_cb(lv_indev_drv_t *drv, lv_indev_data_t *data) {
+    int x, y;
+    uint32_t buttons = SDL_GetMouseState(&x, &y);
+    data->point.x = (lv_coord_t)(x / zoom);
+    data->point.y = (lv_coord_t)(y / zoom);
+    data->state = (buttons & SDL_BUTTON_LMASK) ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+
+    // Read every indev period, so deferred timers run as soon as the UI settles
+    if (deferred[0] && !lvgl_busy()) {
+        release_deferred();
+    }
+}
+
+static void post_gesture(touch_gesture_type_t type, float value, touch_swipe_dir_t direction) {
+    gui_event_t event = {.type = GUI_EVENT_TOUCH_GESTURE};
+    event.data.gesture.type = (uint8_t)type;
+    event.data.gesture.direction = (uint8_t)direction;
+    event.data.gesture.value = value;
+    if (type == TOUCH_GESTURE_SWIPE) {
+        int16_t speed = 1200;
+        event.data.gesture.velocity_x = direction == TOUCH_SWIPE_LEFT ? -speed : direction == TOUCH_SWIPE_RIGHT ? speed : 0;
+        event.data.gesture.velocity_y = direction == TOUCH_SWIPE_UP ? -speed : direction == TOUCH_SWIPE_DOWN ? speed : 0;
+    }
+    gui_event_bus_post(&event);
+}
+
+bool sim_display_init(const sim_display_config_t *config) {
+    zoom = config->zoom > 0 ? config->zoom : 1;
+    round_mask = config->round_mask;
+    init_round_mask();
+
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        ESP_LOGE(TAG, "SDL_Init: %s", SDL_GetError());
+        return false;
+    }
+    window = SDL_CreateWindow("ESPCaster", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+                              WIDTH * zoom, HEIGHT * zoom, 0);
+    renderer = window ? SDL_CreateRenderer(window, -1, 0) : NULL;
+    texture = renderer ? SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB565, SDL_TEXTUREACCESS_STREAMING,
+                                           WIDTH, HEIGHT) : NULL;
+    if (!texture) {
+        ESP_LOGE(TAG, "SDL window: %s", SDL_GetError());
+        sim_display_deinit();
+        return false;
+    }
+
+    lv_disp_draw_buf_init(&draw_buf, buf1, buf2, LVGL_BUF_LEN);
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.hor_res = WIDTH;
+    disp_drv.ver_res = HEIGHT;
+    disp_drv.flush_cb = flush_cb;
+    disp_drv.rounder_cb = rounder_cb;
+    disp_drv.render_start_cb = render_start_cb;
+    disp_drv.monitor_cb = monitor_cb;
+    disp_drv.draw_buf = &draw_buf;
+    lv_disp_drv_register(&disp_drv);
+
+    lv_indev_drv_init(&indev_drv);
+    indev_drv.type = LV_INDEV_TYPE_POINTER;
+    indev_drv.read_cb = pointer_read_cb;
+    lv_indev_drv_register(&indev_drv);
+    return true;
+}
+
+static bool handle_event(const SDL_Event *event) {
+    switch (event->type) {
+    case SDL_QUIT:
+        return false;
+    case SDL_MOUSEWHEEL:
+        post_gesture(TOUCH_GESTURE_ROTATE, event->wheel.y * WHEEL_DEG, TOUCH_SWIPE_LEFT);
+        break;
+    case SDL_KEYDOWN:
+        switch (event->key.keysym.sym) {
+        case SDLK_ESCAPE: return false;
+        case SDLK_LEFT: post_gesture(TOUCH_GESTURE_SWIPE, 0, TOUCH_SWIPE_LEFT); break;
+        case SDLK_RIGHT: post_gesture(TOUCH_GESTURE_SWIPE, 0, TOUCH_SWIPE_RIGHT); break;
+        case SDLK_UP: post_gesture(TOUCH_GESTURE_SWIPE, 0, TOUCH_SWIPE_UP); break;
+        case SDLK_DOWN: post_gesture(TOUCH_GESTURE_SWIPE, 0, TOUCH_SWIPE_DOWN); break;
+        default: break;
+        }
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+bool sim_display_poll(void) {
+    SDL_Event event;
+    while (SDL_PollEvent(&event)) {
+        if (!handle_event(&event)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void sim_display_wait(uint32_t ms) {
+    SDL_Event event;
+    if (ms > 0 && SDL_WaitEventTimeout(&event, (int)ms)) {
+        SDL_PushEvent(&event);      // Handled by the next poll
+    }
+}
+
+void sim_display_deinit(void) {
+    if (texture) SDL_DestroyTexture(texture);
+    if (renderer) SDL_DestroyRenderer(renderer);
+    if (window) SDL_DestroyWindow(window);
+    texture = NULL;
+    renderer = NULL;
+    window = NULL;
+    SDL_Quit();
+}
+
+// Scroll blit needs direct mode, which the sim does not use
+void LVGL_Scroll_Blit_Enable(lv_obj_t *obj) {
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief SDL window standing in for the 412x412 round panel and its touch
+ *
+ * LVGL renders into partial buffers of the firmware's default size
+ * (LVGL_BUF_LEN) through the same rounder as LVGL_Driver.c: areas are
+ * shrunk to the circle and 4-pixel aligned, and areas invalidated inside a
+ * batch are merged (LVGL_Batch.h). Flushes copy into a frame shown once
+ * the refresh ends; with the round mask, pixels outside the circle stay
+ * black, as on the panel.
+ *
+ * The left mouse button is the finger. The wheel turns like the two-finger
+ * rotate gesture, and the arrow keys swipe; both are posted to the GUI
+ * event bus, as the touch task posts them.
+ */
+
+typedef struct {
+    int zoom;               // Window pixels per panel pixel
+    bool round_mask;        // Clip to the circle as the panel does
+} sim_display_config_t;
+
+bool sim_display_init(const sim_display_config_t *config);
+
+// Handle window events; false once the window is closed or Escape pressed
+bool sim_display_poll(void);
+
+// Wait up to ms for a window event
+void sim_display_wait(uint32_t ms);
+
+void sim_display_deinit(void);
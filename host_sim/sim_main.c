@@ -0,0 +1,236 @@
+#include "sim_display.h"
+#include "sim_profile.h"
+#include "LVGL_Batch.h"
+#include "gui_event_bus.h"
+#include "ui_fonts.h"
+#include "ui_lazy_tab.h"
+#include "wifi_gui_manager.h"
+#include "chromecast_gui_manager.h"
+#include "spotify_gui_manager.h"
+#include "esp_cast.h"
+#include "esp_log.h"
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "sim";
+
+#define MAX_SLEEP_MS    5       // Longest wait between passes, so input stays responsive
+
+typedef struct {
+    int zoom;
+    bool square;
+    uint32_t frames;            // 0: until the window is closed
+    uint32_t seconds;
+    uint32_t cycle_tabs_ms;     // Switch tab this often, for unattended runs
+    const char *csv_path;
+} sim_options_t;
+
+static lv_obj_t *main_tabview;
+static chromecast_discovery_handle_t discovery_handle;
+
+static const ui_lazy_tab_ops_t wifi_tab_ops = {
+    .build = wifi_gui_create_interface,
+    .unload = wifi_gui_unload_interface,
+};
+static const ui_lazy_tab_ops_t chromecast_tab_ops = {
+    .build = chromecast_gui_create_interface,
+    .unload = chromecast_gui_unload_interface,
+};
+static const ui_lazy_tab_ops_t spotify_tab_ops = {
+    .build = spotify_gui_create_interface,
+    .unload = spotify_gui_unload_interface,
+};
+
+typedef struct {
+    chromecast_device_event_t event;
+    chromecast_device_info_t device;
+} device_event_call_t;
+
+static void discovery_done_call(void *arg) {
+    chromecast_gui_set_scanning(false, (size_t)(uintptr_t)arg);
+}
+
+static void device_event_call(void *arg) {
+    device_event_call_t *call = (device_event_call_t *)arg;
+    chromecast_gui_apply_device_event(call->event, &call->device);
+    free(call);
+}
+
+// Through the event bus, as esp_cast.c hands them over from the discovery task
+static void discovery_callback(const chromecast_device_info_t *devices, size_t device_count) {
+    gui_event_bus_post_call(discovery_done_call, (void *)(uintptr_t)device_count);
+}
+
+static void device_event_callback(chromecast_device_event_t event, const chromecast_device_info_t *device) {
+    device_event_call_t *call = malloc(sizeof(*call));
+    if (!call) {
+        return;
+    }
+    call->event = event;
+    call->device = *device;
+    if (!gui_event_bus_post_call(device_event_call, call)) {
+        free(call);
+    }
+}
+
+// The tabs of esp_cast_gui_init(), on the mocked controllers
+static bool build_gui(void) {
+    ui_fonts_init();
+
+    wifi_gui_config_t wifi_config = {
+        .parent = NULL,
+        .show_status_bar = true,
+        .show_scan_button = true,
+    };
+    if (wifi_gui_manager_init(&wifi_config) != ESP_OK) {
+        ESP_LOGE(TAG, "WiFi GUI manager failed");
+        return false;
+    }
+    discovery_handle = chromecast_discovery_create();
+
+    main_tabview = lv_tabview_create(lv_scr_act(), LV_DIR_TOP, 45);
+    ui_lazy_tab_init(main_tabview);
+
+    lv_obj_t *wifi_tab = lv_tabview_add_tab(main_tabview, "WiFi");
+    ui_lazy_tab_add(wifi_tab, &wifi_tab_ops);
+
+    lv_obj_t *chromecast_tab = lv_tabview_add_tab(main_tabview, "Chromecast");
+    chromecast_gui_config_t chromecast_config = {
+        .parent = NULL,
+        .discovery = discovery_handle,
+        .show_status_bar = true,
+        .show_scan_button = true,
+    };
+    if (chromecast_gui_manager_init(&chromecast_config) != ESP_OK) {
+        ESP_LOGE(TAG, "Chromecast GUI manager failed");
+        return false;
+    }
+    ui_lazy_tab_add(chromecast_tab, &chromecast_tab_ops);
+    chromecast_discovery_set_callback(discovery_handle, discovery_callback);
+    chromecast_discovery_set_device_event_callback(discovery_handle, device_event_callback);
+    chromecast_discovery_start_browse(discovery_handle);
+
+    lv_obj_t *spotify_tab = lv_tabview_add_tab(main_tabview, "Spotify");
+    spotify_gui_config_t spotify_config = {
+        .parent = spotify_tab,
+        .controller = esp_cast_get_spotify_controller(),
+        .show_status_bar = true,
+        .show_auth_button = true,
+        .show_search_bar = true,
+    };
+    if (spotify_gui_manager_init(&spotify_config) != ESP_OK) {
+        ESP_LOGE(TAG, "Spotify GUI manager failed");
+        return false;
+    }
+    ui_lazy_tab_add(spotify_tab, &spotify_tab_ops);
+    if (!spotify_gui_show_snapshot()) {
+        spotify_gui_show_auth_screen();
+    }
+
+    ui_lazy_tab_start();
+    return true;
+}
+
+static void cycle_tab(void) {
+    uint16_t count = (uint16_t)lv_obj_get_child_cnt(lv_tabview_get_content(main_tabview));
+    uint16_t next = (uint16_t)((lv_tabview_get_tab_act(main_tabview) + 1) % count);
+    lv_tabview_set_act(main_tabview, next, LV_ANIM_ON);
+    lv_event_send(main_tabview, LV_EVENT_VALUE_CHANGED, NULL);
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [--zoom N] [--square] [--frames N] [--seconds N] [--cycle-tabs MS] [--csv FILE]\n"
+            "  --zoom N         window pixels per panel pixel (1)\n"
+            "  --square         no round mask: render the corners too\n"
+            "  --frames N       exit after N rendered frames\n"
+            "  --seconds N      exit after N seconds\n"
+            "  --cycle-tabs MS  switch to the next tab every MS milliseconds\n"
+            "  --csv FILE       write one row per frame\n", argv0);
+}
+
+static bool parse_options(int argc, char **argv, sim_options_t *options) {
+    *options = (sim_options_t){.zoom = 1};
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--square") == 0) {
+            options->square = true;
+            continue;
+        }
+        if (!value) {
+            return false;
+        }
+        if (strcmp(arg, "--zoom") == 0) {
+            options->zoom = atoi(value);
+        } else if (strcmp(arg, "--frames") == 0) {
+            options->frames = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--seconds") == 0) {
+            options->seconds = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--cycle-tabs") == 0) {
+            options->cycle_tabs_ms = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--csv") == 0) {
+            options->csv_path = value;
+        } else {
+            return false;
+        }
+        i++;
+    }
+    return options->zoom > 0;
+}
+
+int main(int argc, char **argv) {
+    sim_options_t options;
+    if (!parse_options(argc, argv, &options)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    lv_init();
+    sim_display_config_t display_config = {
+        .zoom = options.zoom,
+        .round_mask = !options.square,
+    };
+    if (!sim_display_init(&display_config) || !sim_profile_init(options.csv_path)) {
+        return 1;
+    }
+    gui_event_bus_init();
+    if (!build_gui()) {
+        sim_display_deinit();
+        return 1;
+    }
+
+    // The firmware's LVGL_Loop, with the tick taken from the host clock
+    uint32_t start = SDL_GetTicks();
+    uint32_t last_tick = start;
+    uint32_t last_cycle = start;
+    while (sim_display_poll()) {
+        uint32_t now = SDL_GetTicks();
+        lv_tick_inc(now - last_tick);
+        last_tick = now;
+
+        if (options.cycle_tabs_ms && now - last_cycle >= options.cycle_tabs_ms) {
+            cycle_tab();
+            last_cycle = now;
+        }
+
+        sim_profile_pass_begin();
+        uint32_t sleep_ms = lv_timer_handler();
+        LVGL_Batch_Begin();
+        gui_event_bus_process();
+        LVGL_Batch_Commit();
+        sim_profile_pass_end();
+
+        if ((options.frames && sim_profile_frames() >= options.frames) ||
+            (options.seconds && now - start >= options.seconds * 1000)) {
+            break;
+        }
+        sim_display_wait(sleep_ms < MAX_SLEEP_MS ? sleep_ms : MAX_SLEEP_MS);
+    }
+
+    sim_profile_finish();
+    sim_display_deinit();
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include "sim_profile.h"
+#include "telemetry_hist.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <stdio.h>
+
+static const char *TAG = "sim_profile";
+
+#define REPORT_US   1000000
+
+static telemetry_hist_t *render_hist;
+static telemetry_hist_t *flush_hist;
+static telemetry_hist_t *pass_hist;
+static FILE *csv;
+
+static int64_t start_us;
+static int64_t render_start_us;
+static int64_t pass_start_us;
+static uint32_t frame_areas;
+static uint32_t frame_flush_us;
+static uint32_t frames;
+
+// The second being summed up
+static int64_t window_start_us;
+static uint32_t window_frames;
+static uint64_t window_render_us;
+static uint32_t window_render_max_us;
+static uint64_t window_flush_us;
+static uint64_t window_px;
+
+int64_t sim_profile_now_us(void) {
+    return esp_timer_get_time();
+}
+
+bool sim_profile_init(const char *csv_path) {
+    render_hist = telemetry_hist_get("lvgl render", TELEMETRY_HIST_US);
+    flush_hist = telemetry_hist_get("lvgl flush", TELEMETRY_HIST_US);
+    pass_hist = telemetry_hist_get("lvgl pass", TELEMETRY_HIST_US);
+    if (csv_path) {
+        csv = fopen(csv_path, "w");
+        if (!csv) {
+            ESP_LOGE(TAG, "Cannot write %s", csv_path);
+            return false;
+        }
+        fprintf(csv, "time_ms,render_us,flush_us,pixels,areas\n");
+    }
+    start_us = window_start_us = sim_profile_now_us();
+    return true;
+}
+
+static void report_window(int64_t now_us) {
+    if (window_frames > 0) {
+        ESP_LOGI(TAG, "%u frames: render avg %.2f ms, max %.2f ms; flush avg %.2f ms; %llu px/frame",
+                 (unsigned)window_frames, window_render_us / 1000.0 / window_frames, window_render_max_us / 1000.0,
+                 window_flush_us / 1000.0 / window_frames, (unsigned long long)(window_px / window_frames));
+    }
+    window_start_us = now_us;
+    window_frames = 0;
+    window_render_us = 0;
+    window_render_max_us = 0;
+    window_flush_us = 0;
+    window_px = 0;
+}
+
+void sim_profile_render_start(uint32_t areas) {
+    render_start_us = sim_profile_now_us();
+    frame_areas = areas;
+    frame_flush_us = 0;
+}
+
+void sim_profile_flush(uint32_t us) {
+    frame_flush_us += us;
+    telemetry_hist_record(flush_hist, us);
+}
+
+void sim_profile_render_done(uint32_t px) {
+    int64_t now_us = sim_profile_now_us();
+    uint32_t render_us = (uint32_t)(now_us - render_start_us);
+    telemetry_hist_record(render_hist, render_us);
+    frames++;
+
+    window_frames++;
+    window_render_us += render_us;
+    window_render_max_us = render_us > window_render_max_us ? render_us : window_render_max_us;
+    window_flush_us += frame_flush_us;
+    window_px += px;
+
+    if (csv) {
+        fprintf(csv, "%lld,%u,%u,%u,%u\n", (long long)((now_us - start_us) / 1000), (unsigned)render_us,
+                (unsigned)frame_flush_us, (unsigned)px, (unsigned)frame_areas);
+    }
+}
+
+void sim_profile_pass_begin(void) {
+    pass_start_us = sim_profile_now_us();
+}
+
+void sim_profile_pass_end(void) {
+    int64_t now_us = sim_profile_now_us();
+    telemetry_hist_record(pass_hist, (uint32_t)(now_us - pass_start_us));
+    if (now_us - window_start_us >= REPORT_US) {
+        report_window(now_us);
+    }
+}
+
+uint32_t sim_profile_frames(void) {
+    return frames;
+}
+
+void sim_profile_finish(void) {
+    report_window(sim_profile_now_us());
+    telemetry_hist_summary_t summaries[3];
+    size_t count = telemetry_hist_list(summaries, sizeof(summaries) / sizeof(summaries[0]));
+    for (size_t i = 0; i < count; i++) {
+        const telemetry_hist_summary_t *s = &summaries[i];
+        ESP_LOGI(TAG, "%-12s %6u samples  p50 %6u us  p95 %6u us  p99 %6u us  max %6u us", s->name,
+                 (unsigned)s->count, (unsigned)s->p50, (unsigned)s->p95, (unsigned)s->p99, (unsigned)s->max);
+    }
+    if (csv) {
+        fclose(csv);
+        csv = NULL;
+    }
+}
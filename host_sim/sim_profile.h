@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Render profiling for the simulator
+ *
+ * Every LVGL refresh is timed from the start of rendering to the end of its
+ * last flush, with the flushes (the copy into the window's frame) counted
+ * apart, and every pass of the main loop - timers, layout, rendering and
+ * the event bus - as a whole. The times go into the firmware's telemetry
+ * histograms ("lvgl render", "lvgl flush", "lvgl pass"), so percentiles are
+ * read the way the diagnostics tab reads them on the device.
+ *
+ * Once a second a line sums up the frames of that second; at exit the
+ * histograms are printed. With a CSV path, one row per frame is written:
+ * time_ms, render_us, flush_us, pixels, areas.
+ *
+ * Host timings are for comparing changes, not absolute: the ESP32-S3 renders
+ * an order of magnitude slower.
+ */
+
+bool sim_profile_init(const char *csv_path);
+void sim_profile_finish(void);
+
+// Display driver: rendering of a refresh with this many areas starts, a flush took us, the refresh is done
+void sim_profile_render_start(uint32_t areas);
+void sim_profile_flush(uint32_t us);
+void sim_profile_render_done(uint32_t px);
+
+// Main loop: around lv_timer_handler() and the event bus
+void sim_profile_pass_begin(void);
+void sim_profile_pass_end(void);
+
+// Frames rendered so far
+uint32_t sim_profile_frames(void);
+
+// Microseconds on a monotonic clock
+int64_t sim_profile_now_us(void);
@@ -0,0 +1,125 @@
+// Google Benchmark of the protocol and parsing cores on the host. Absolute
+// numbers say little about the ESP32-S3 (espcaster_bench measures those);
+// use these to compare changes to the code.
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "cast_frame_codec.h"
+#include "cast_json_writer.h"
+#include "cast_message_view.h"
+#include "cast_payload_parser.h"
+#include "spotify_stream_parser.h"
+
+static const char media_status[] =
+    "{\"type\":\"MEDIA_STATUS\",\"status\":[{\"mediaSessionId\":1,\"playbackRate\":1,"
+    "\"playerState\":\"PLAYING\",\"currentTime\":42.5,\"supportedMediaCommands\":274447,"
+    "\"volume\":{\"level\":1,\"muted\":false},\"media\":{\"contentId\":\"http://192.168.1.20/stream.mp3\","
+    "\"streamType\":\"BUFFERED\",\"contentType\":\"audio/mpeg\",\"metadata\":{\"metadataType\":3,"
+    "\"title\":\"Track\",\"artist\":\"Artist\"},\"duration\":215.3},\"currentItemId\":1,"
+    "\"repeatMode\":\"REPEAT_OFF\"}],\"requestId\":12}";
+
+static void put_varint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+static void put_string(std::vector<uint8_t>& out, uint32_t field, const std::string& value) {
+    put_varint(out, (field << 3) | 2);
+    put_varint(out, value.size());
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+// One framed CastMessage carrying media_status, as a speaker sends it
+static std::vector<uint8_t> media_status_frame() {
+    std::vector<uint8_t> message;
+    put_varint(message, (1 << 3) | 0);
+    put_varint(message, 0);                     // CASTV2_1_0
+    put_string(message, 2, "receiver-0");
+    put_string(message, 3, "sender-0");
+    put_string(message, 4, "urn:x-cast:com.google.cast.media");
+    put_varint(message, (5 << 3) | 0);
+    put_varint(message, 0);                     // STRING
+    put_string(message, 6, media_status);
+
+    std::vector<uint8_t> frame(CastFrameCodec::HEADER_SIZE);
+    CastFrameCodec::write_header(frame.data(), message.size());
+    frame.insert(frame.end(), message.begin(), message.end());
+    return frame;
+}
+
+static void BM_CastFrameDecode(benchmark::State& state) {
+    std::vector<uint8_t> frame = media_status_frame();
+    for (auto _ : state) {
+        const uint8_t* body;
+        uint32_t length;
+        CastFrameCodec::next_frame(frame.data(), frame.size(), 65536, body, length);
+        CastMessageView message;
+        benchmark::DoNotOptimize(CastMessageDecoder::decode(body, length, message));
+    }
+    state.SetBytesProcessed(state.iterations() * frame.size());
+}
+BENCHMARK(BM_CastFrameDecode);
+
+static void BM_CastPayloadParse(benchmark::State& state) {
+    for (auto _ : state) {
+        CastPayload payload;
+        benchmark::DoNotOptimize(CastPayloadParser::parse(media_status, sizeof(media_status) - 1, payload));
+    }
+    state.SetBytesProcessed(state.iterations() * (sizeof(media_status) - 1));
+}
+BENCHMARK(BM_CastPayloadParse);
+
+static void BM_CastJsonBuild(benchmark::State& state) {
+    for (auto _ : state) {
+        CastJsonWriter<512> w;
+        w.field("type", "LOAD").field_uint("requestId", 7).field("sessionId", "9F1A2C3D-4E5F-6071-8293-A4B5C6D7E8F9");
+        w.begin_object("media")
+            .field("contentId", "http://192.168.1.20/stream.mp3")
+            .field("streamType", "BUFFERED")
+            .field("contentType", "audio/mpeg")
+            .end_object();
+        w.field_bool("autoplay", true).field_number("currentTime", 0).end();
+        benchmark::DoNotOptimize(w.size());
+    }
+}
+BENCHMARK(BM_CastJsonBuild);
+
+// A playlist tracks page shaped like the Web API's
+static std::string playlist_page(int items) {
+    std::string page = "{\"items\":[";
+    char item[768];
+    for (int i = 0; i < items; i++) {
+        snprintf(item, sizeof(item),
+            "%s{\"added_at\":\"2024-01-01T00:00:00Z\",\"track\":{\"id\":\"4uLU6hMCjMI75M1A2tKU%02d\","
+            "\"name\":\"Track %d\",\"duration_ms\":215000,\"uri\":\"spotify:track:4uLU6hMCjMI75M1A2tKU%02d\","
+            "\"artists\":[{\"id\":\"0OdUWJ0sBjDrqHygGUXeCF\",\"name\":\"Artist\"}],"
+            "\"album\":{\"id\":\"5ht7ItJgpBH7W6vJ5BqpPr\",\"name\":\"Album\",\"images\":["
+            "{\"url\":\"https://i.scdn.co/image/ab67616d0000b273\",\"width\":640,\"height\":640},"
+            "{\"url\":\"https://i.scdn.co/image/ab67616d00001e02\",\"width\":300,\"height\":300},"
+            "{\"url\":\"https://i.scdn.co/image/ab67616d00004851\",\"width\":64,\"height\":64}]}}}",
+            i ? "," : "", i, i, i);
+        page += item;
+    }
+    page += "],\"next\":null,\"total\":" + std::to_string(items) + "}";
+    return page;
+}
+
+static void BM_SpotifyStreamParse(benchmark::State& state) {
+    std::string page = playlist_page(state.range(0));
+    const size_t chunk = 1024;      // As HTTP_EVENT_ON_DATA delivers
+    size_t tracks = 0;
+    for (auto _ : state) {
+        SpotifyStreamParser parser([&](const SpotifyTrack&) { tracks++; });
+        for (size_t offset = 0; offset < page.size(); offset += chunk) {
+            parser.feed(page.data() + offset, std::min(chunk, page.size() - offset));
+        }
+        benchmark::DoNotOptimize(parser.finish());
+    }
+    state.SetBytesProcessed(state.iterations() * page.size());
+    state.SetItemsProcessed(tracks);
+}
+BENCHMARK(BM_SpotifyStreamParse)->Arg(20)->Arg(50);
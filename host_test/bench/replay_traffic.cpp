@@ -0,0 +1,198 @@
+// Replays a traffic capture (components/traffic_capture) through the
+// parsing cores: each Cast frame is decoded and its JSON payload parsed as
+// handle_incoming_message() does, each Spotify response fed to the parser
+// the SpotifyApiClient call that made it uses, in REPLAY_CHUNK_SIZE pieces.
+// Prints the time per record by kind as espcaster_bench's replay does.
+//
+//   replay_traffic [--realtime] capture...
+//
+// --realtime waits between records as long as they were apart when recorded.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "cast_message_view.h"
+#include "cast_namespace.h"
+#include "cast_payload_parser.h"
+#include "spotify_stream_parser.h"
+#include "traffic_format.h"
+#ifdef ESPCASTER_HOST_CJSON
+#include "cJSON.h"
+#include "spotify_response_parser.h"
+#endif
+
+static constexpr size_t REPLAY_CHUNK_SIZE = 1024;      // As SpotifyApiClient
+
+using Clock = std::chrono::steady_clock;
+
+static volatile size_t sink;
+
+struct Times {
+    std::vector<uint32_t> us;
+    uint64_t bytes = 0;
+};
+
+static bool replay_cast(const traffic_record_t& record) {
+    static CastNamespaceRegistry namespaces;
+    CastMessageView message;
+    if (!CastMessageDecoder::decode(record.body, record.body_length, message)) {
+        return false;
+    }
+    if (namespaces.lookup(message.namespace_) != CAST_NS_DEVICE_AUTH && message.has_payload_utf8) {
+        CastPayload payload;
+        CastPayloadParser::parse(message.payload_utf8.data, message.payload_utf8.length, payload);
+        sink = payload.media_session_id;
+    }
+    return true;
+}
+
+template <typename Sink>
+static bool replay_stream(const traffic_record_t& record, Sink sink_fn) {
+    SpotifyStreamParser parser(sink_fn);
+    bool ok = true;
+    for (size_t offset = 0; ok && offset < record.body_length; offset += REPLAY_CHUNK_SIZE) {
+        ok = parser.feed(reinterpret_cast<const char*>(record.body) + offset,
+                         std::min(REPLAY_CHUNK_SIZE, record.body_length - offset));
+    }
+    return ok && parser.finish();
+}
+
+// -1: not a response the controller parses
+static int replay_spotify(const traffic_record_t& record) {
+    if (record.status < 200 || record.status >= 300 || record.body_length == 0) {
+        return -1;
+    }
+    auto track = [](const SpotifyTrack& t) { sink = t.name.size(); };
+    switch (traffic_spotify_endpoint(record.key)) {
+    case TRAFFIC_SPOTIFY_PLAYLISTS:
+        return replay_stream(record, SpotifyStreamParser::PlaylistSink([](const SpotifyPlaylist& p) {
+            sink = p.name.size();
+        }));
+    case TRAFFIC_SPOTIFY_PLAYLIST_TRACKS:
+    case TRAFFIC_SPOTIFY_SEARCH:
+    case TRAFFIC_SPOTIFY_QUEUE:
+    case TRAFFIC_SPOTIFY_SEVERAL_TRACKS:
+        return replay_stream(record, SpotifyStreamParser::TrackSink(track));
+    case TRAFFIC_SPOTIFY_SEVERAL_ALBUMS:
+        return replay_stream(record, SpotifyStreamParser::AlbumSink([](const SpotifyAlbum& a) {
+            sink = a.name.size();
+        }));
+    case TRAFFIC_SPOTIFY_SEVERAL_ARTISTS:
+        return replay_stream(record, SpotifyStreamParser::ArtistSink([](const SpotifyArtist& a) {
+            sink = a.name.size();
+        }));
+#ifdef ESPCASTER_HOST_CJSON
+    case TRAFFIC_SPOTIFY_PLAYBACK:
+    case TRAFFIC_SPOTIFY_DEVICES: {
+        cJSON* json = cJSON_ParseWithLength(reinterpret_cast<const char*>(record.body), record.body_length);
+        if (!json) {
+            return 0;
+        }
+        if (traffic_spotify_endpoint(record.key) == TRAFFIC_SPOTIFY_PLAYBACK) {
+            sink = SpotifyResponseParser::playback_state(json, SpotifyStreamParser::DEFAULT_IMAGE_TARGET)
+                       .current_track.name.size();
+        } else {
+            sink = SpotifyResponseParser::devices(json).size();
+        }
+        cJSON_Delete(json);
+        return 1;
+    }
+#endif
+    default:
+        return -1;
+    }
+}
+
+static void report(const char* kind, Times& times) {
+    std::printf("BENCH,replay_%s_records,%zu,count\n", kind, times.us.size());
+    if (times.us.empty()) {
+        return;
+    }
+    std::sort(times.us.begin(), times.us.end());
+    uint64_t total_us = 0;
+    for (uint32_t us : times.us) {
+        total_us += us;
+    }
+    size_t count = times.us.size();
+    std::printf("BENCH,replay_%s_throughput,%.1f,KB/s\n", kind,
+                total_us ? times.bytes * 1000000.0 / total_us / 1024.0 : 0.0);
+    std::printf("BENCH,replay_%s_p50,%u,us\n", kind, times.us[(50 * count + 99) / 100 - 1]);
+    std::printf("BENCH,replay_%s_p99,%u,us\n", kind, times.us[(99 * count + 99) / 100 - 1]);
+    std::printf("BENCH,replay_%s_max,%u,us\n", kind, times.us.back());
+}
+
+static bool replay_file(const char* path, bool realtime) {
+    traffic_reader_t reader;
+    FILE* file = std::fopen(path, "rb");
+    if (!traffic_reader_open(&reader, file)) {
+        std::fprintf(stderr, "%s: not a traffic capture\n", path);
+        if (file) {
+            std::fclose(file);
+        }
+        return false;
+    }
+
+    Times cast_times, spotify_times;
+    int failed = 0, skipped = 0;
+    Clock::time_point start = Clock::now();
+    bool first = true;
+    uint64_t first_us = 0;
+    traffic_record_t record;
+    int result;
+    while ((result = traffic_reader_next(&reader, &record)) == 1) {
+        if (first) {
+            first_us = record.time_us;
+            first = false;
+        }
+        if (realtime) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds(record.time_us - first_us));
+        }
+        bool is_cast = record.kind == TRAFFIC_CAST_FRAME;
+        Clock::time_point t0 = Clock::now();
+        int ok = is_cast ? replay_cast(record) : replay_spotify(record);
+        uint32_t us = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - t0).count();
+        if (ok < 0) {
+            skipped++;
+            continue;
+        }
+        if (!ok) {
+            failed++;
+            std::fprintf(stderr, "%s: replay of %s failed\n", path, is_cast ? "a Cast frame" : record.key);
+            continue;
+        }
+        Times& times = is_cast ? cast_times : spotify_times;
+        times.us.push_back(us);
+        times.bytes += record.body_length;
+    }
+    traffic_reader_close(&reader);
+    if (result < 0) {
+        std::fprintf(stderr, "%s: corrupt after %zu records\n", path, cast_times.us.size() + spotify_times.us.size());
+    }
+
+    report("cast", cast_times);
+    report("spotify", spotify_times);
+    std::printf("BENCH,replay_failed,%d,count\n", failed);
+    std::printf("BENCH,replay_skipped,%d,count\n", skipped);
+    return result == 0 && failed == 0;
+}
+
+int main(int argc, char** argv) {
+    bool realtime = false;
+    int files = 0;
+    bool ok = true;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--realtime") == 0) {
+            realtime = true;
+            continue;
+        }
+        ok = replay_file(argv[i], realtime) && ok;
+        files++;
+    }
+    if (files == 0) {
+        std::fprintf(stderr, "usage: %s [--realtime] capture...\n", argv[0]);
+        return 2;
+    }
+    return ok ? 0 : 1;
+}
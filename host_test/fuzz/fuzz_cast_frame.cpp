@@ -0,0 +1,32 @@
+// The receive path: split the input as a stream of frames, decode each
+// CastMessage, look up its namespace and parse its JSON payload, as
+// process_rx_frames() and handle_incoming_message() do.
+#include <cstdint>
+#include "cast_frame_codec.h"
+#include "cast_message_view.h"
+#include "cast_namespace.h"
+#include "cast_payload_parser.h"
+
+static constexpr size_t MAX_MESSAGE_SIZE = 65536;      // As ChromecastController
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    static CastNamespaceRegistry namespaces;
+    if (namespaces.lookup(CastSlice{"urn:x-cast:com.example.app", 26}) == CAST_NS_UNKNOWN) {
+        namespaces.add("urn:x-cast:com.example.app");
+    }
+
+    size_t offset = 0;
+    const uint8_t* body;
+    uint32_t length;
+    while (CastFrameCodec::next_frame(data + offset, size - offset, MAX_MESSAGE_SIZE, body, length) ==
+           CastFrameCodec::FRAME_OK) {
+        CastMessageView message;
+        if (CastMessageDecoder::decode(body, length, message) &&
+            namespaces.lookup(message.namespace_) != CAST_NS_DEVICE_AUTH && message.has_payload_utf8) {
+            CastPayload payload;
+            CastPayloadParser::parse(message.payload_utf8.data, message.payload_utf8.length, payload);
+        }
+        offset += CastFrameCodec::HEADER_SIZE + length;
+    }
+    return 0;
+}
@@ -0,0 +1,9 @@
+// Cast JSON payloads straight into the extractor.
+#include <cstdint>
+#include "cast_payload_parser.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    CastPayload payload;
+    CastPayloadParser::parse(reinterpret_cast<const char*>(data), size, payload);
+    return 0;
+}
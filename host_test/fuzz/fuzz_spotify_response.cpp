@@ -0,0 +1,15 @@
+// Player state and device list responses, through cJSON as on the device.
+#include <cstdint>
+#include "cJSON.h"
+#include "spotify_response_parser.h"
+#include "spotify_stream_parser.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    cJSON* json = cJSON_ParseWithLength(reinterpret_cast<const char*>(data), size);
+    if (json) {
+        SpotifyResponseParser::playback_state(json, SpotifyStreamParser::DEFAULT_IMAGE_TARGET);
+        SpotifyResponseParser::devices(json);
+        cJSON_Delete(json);
+    }
+    return 0;
+}
@@ -0,0 +1,31 @@
+// Spotify paging responses through each sink of the incremental parser. The
+// first byte picks the chunk size, since bodies arrive split anywhere.
+#include <cstdint>
+#include "spotify_stream_parser.h"
+
+template <typename Sink>
+static void feed(const uint8_t* data, size_t size, size_t chunk, Sink sink) {
+    SpotifyStreamParser parser(sink);
+    const char* text = reinterpret_cast<const char*>(data);
+    for (size_t offset = 0; offset < size; offset += chunk) {
+        size_t n = size - offset < chunk ? size - offset : chunk;
+        if (!parser.feed(text + offset, n)) {
+            return;
+        }
+    }
+    parser.finish();
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size < 1) {
+        return 0;
+    }
+    size_t chunk = data[0] + 1;
+    data++;
+    size--;
+    feed(data, size, chunk, SpotifyStreamParser::TrackSink([](const SpotifyTrack&) {}));
+    feed(data, size, chunk, SpotifyStreamParser::PlaylistSink([](const SpotifyPlaylist&) {}));
+    feed(data, size, chunk, SpotifyStreamParser::AlbumSink([](const SpotifyAlbum&) {}));
+    feed(data, size, chunk, SpotifyStreamParser::ArtistSink([](const SpotifyArtist&) {}));
+    return 0;
+}
@@ -0,0 +1,36 @@
+// Stands in for libFuzzer's main: runs each file named on the command line
+// (or every file in a named directory) through LLVMFuzzerTestOneInput once.
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+static void replay(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+}
+
+int main(int argc, char** argv) {
+    size_t count = 0;
+    for (int i = 1; i < argc; i++) {
+        std::filesystem::path path(argv[i]);
+        if (std::filesystem::is_directory(path)) {
+            for (const auto& entry : std::filesystem::directory_iterator(path)) {
+                if (entry.is_regular_file()) {
+                    replay(entry.path());
+                    count++;
+                }
+            }
+        } else {
+            replay(path);
+            count++;
+        }
+    }
+    printf("Replayed %zu inputs\n", count);
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include "rom/miniz.h"
+
+static voidpf Arena_Alloc(voidpf opaque, uInt items, uInt size)
+{
+    tinfl_decompressor *r = opaque;
+    size_t length = ((size_t)items * size + 15) & ~(size_t)15;
+    if (length > sizeof(r->arena) - r->arena_used) {
+        return Z_NULL;
+    }
+    voidpf p = r->arena + r->arena_used;
+    r->arena_used += length;
+    return p;
+}
+
+static void Arena_Free(voidpf opaque, voidpf address)
+{
+}
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const uint8_t *in_buf, size_t *in_buf_size,
+                              uint8_t *out_buf_start, uint8_t *out_buf_next, size_t *out_buf_size,
+                              uint32_t flags)
+{
+    if (!r->started) {
+        r->stream = (z_stream){ .zalloc = Arena_Alloc, .zfree = Arena_Free, .opaque = r };
+        if (inflateInit2(&r->stream, -15) != Z_OK) {
+            return TINFL_STATUS_BAD_PARAM;
+        }
+        r->started = 1;
+    }
+
+    r->stream.next_in = (Bytef *)in_buf;
+    r->stream.avail_in = (uInt)*in_buf_size;
+    r->stream.next_out = out_buf_next;
+    r->stream.avail_out = (uInt)*out_buf_size;
+    int ret = inflate(&r->stream, Z_NO_FLUSH);
+    *in_buf_size -= r->stream.avail_in;
+    *out_buf_size -= r->stream.avail_out;
+
+    if (ret == Z_STREAM_END) {
+        return TINFL_STATUS_DONE;
+    }
+    if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        return TINFL_STATUS_FAILED;
+    }
+    return r->stream.avail_out == 0 ? TINFL_STATUS_HAS_MORE_OUTPUT : TINFL_STATUS_NEEDS_MORE_INPUT;
+}
@@ -0,0 +1,44 @@
+// The ROM tinfl calls OTA_Package.c makes, over zlib's raw inflate, so the
+// package code builds on the host unchanged. zlib keeps its own window, so
+// out_buf_start is not referred back into; output still goes to out_buf_next.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <zlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TINFL_LZ_DICT_SIZE          32768
+#define TINFL_FLAG_HAS_MORE_INPUT   2
+
+// zlib's state and window come from here, so freeing the decompressor frees
+// them, as with tinfl, even for a stream that never ended
+#define TINFL_SHIM_ARENA_SIZE       (64 * 1024)
+
+typedef enum {
+    TINFL_STATUS_BAD_PARAM = -3,
+    TINFL_STATUS_ADLER32_MISMATCH = -2,
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2,
+} tinfl_status;
+
+typedef struct {
+    z_stream stream;
+    int started;
+    size_t arena_used;
+    uint8_t arena[TINFL_SHIM_ARENA_SIZE] __attribute__((aligned(16)));
+} tinfl_decompressor;
+
+#define tinfl_init(r)   ((r)->started = 0, (r)->arena_used = 0)
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const uint8_t *in_buf, size_t *in_buf_size,
+                              uint8_t *out_buf_start, uint8_t *out_buf_next, size_t *out_buf_size,
+                              uint32_t flags);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,358 @@
+// OTA_Package.c against buffers: full and delta packages, stored and deflated,
+// fed in chunks of every size must rebuild the image exactly; patch ops out
+// of bounds and truncated or corrupt streams must fail, never writing past
+// the image the header names.
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <zlib.h>
+extern "C" {
+#include "OTA_Package.h"
+}
+
+using Bytes = std::vector<uint8_t>;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            std::fprintf(stderr, "%s:%d: %s: failed: %s\n", __FILE__, __LINE__, \
+                         current_test, #cond);                                   \
+            failures++;                                                          \
+        }                                                                        \
+    } while (0)
+
+static const char* current_test = "";
+
+struct Slots {
+    Bytes base;
+    Bytes written;
+
+    static bool begin(void*, const ota_package_header_t*) { return true; }
+
+    static bool write(void* ctx, const uint8_t* data, size_t length) {
+        Slots* slots = static_cast<Slots*>(ctx);
+        slots->written.insert(slots->written.end(), data, data + length);
+        return length <= OTA_WRITE_BLOCK;
+    }
+
+    static bool read_base(void* ctx, uint32_t offset, uint8_t* out, size_t length) {
+        Slots* slots = static_cast<Slots*>(ctx);
+        if (offset > slots->base.size() || length > slots->base.size() - offset) {
+            return false;       // OTA_Package.c bounds COPY before it asks
+        }
+        std::memcpy(out, slots->base.data() + offset, length);
+        return true;
+    }
+};
+
+struct Result {
+    bool ok;
+    std::string error;
+    Bytes written;
+};
+
+static Bytes pattern(size_t length, uint32_t seed) {
+    std::mt19937 random(seed);
+    Bytes data(length);
+    for (size_t i = 0; i < length; i++) {
+        // Runs as well as noise, so deflate has something to match
+        data[i] = (i / 64) % 3 == 0 ? static_cast<uint8_t>(i) : static_cast<uint8_t>(random());
+    }
+    return data;
+}
+
+static Bytes raw_deflate(const Bytes& data) {
+    z_stream stream = {};
+    deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    Bytes out(deflateBound(&stream, data.size()));
+    stream.next_in = const_cast<Bytef*>(data.data());
+    stream.avail_in = data.size();
+    stream.next_out = out.data();
+    stream.avail_out = out.size();
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+}
+
+static void put_le32(Bytes& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+static void op_copy(Bytes& patch, uint32_t offset, uint32_t length) {
+    patch.push_back(OTA_OP_COPY);
+    put_le32(patch, offset);
+    put_le32(patch, length);
+}
+
+static void op_insert(Bytes& patch, const uint8_t* data, uint32_t length) {
+    patch.push_back(OTA_OP_INSERT);
+    put_le32(patch, length);
+    patch.insert(patch.end(), data, data + length);
+}
+
+static Bytes package(ota_kind_t kind, ota_compression_t compression, uint32_t image_size, const Bytes& payload) {
+    ota_package_header_t header = {};
+    header.magic = OTA_PACKAGE_MAGIC;
+    header.version = OTA_PACKAGE_VERSION;
+    header.kind = kind;
+    header.compression = compression;
+    header.image_size = image_size;
+    header.payload_size = payload.size();
+    const uint8_t* raw = reinterpret_cast<const uint8_t*>(&header);
+    Bytes out(raw, raw + sizeof(header));
+    out.insert(out.end(), payload.begin(), payload.end());
+    return out;
+}
+
+// chunk 0: random sizes from 1 to 5000
+static Result apply(const Bytes& data, const Bytes& base, size_t chunk, uint32_t seed = 1) {
+    Slots slots;
+    slots.base = base;
+    ota_package_io_t io = {};
+    io.ctx = &slots;
+    io.begin = Slots::begin;
+    io.write = Slots::write;
+    io.read_base = Slots::read_base;
+    io.base_size = base.size();
+    uint8_t block[OTA_WRITE_BLOCK];
+    ota_package_t package;
+    OTA_Package_Init(&package, &io, block);
+
+    std::mt19937 random(seed);
+    for (size_t offset = 0; offset < data.size();) {
+        size_t n = chunk ? chunk : 1 + random() % 5000;
+        n = std::min(n, data.size() - offset);
+        OTA_Package_Feed(&package, data.data() + offset, n);
+        offset += n;
+    }
+    Result result;
+    result.ok = OTA_Package_Finish(&package);
+    result.error = package.error ? package.error : "";
+    result.written = slots.written;
+    OTA_Package_Free(&package);
+    return result;
+}
+
+static const size_t CHUNKS[] = { 1, 7, 4096, 100000, 0 };
+
+static void test_full() {
+    current_test = "full";
+    Bytes image = pattern(3 * OTA_WRITE_BLOCK + 123, 1);
+    Bytes stored = package(OTA_KIND_FULL, OTA_COMPRESSION_NONE, image.size(), image);
+    Bytes deflated = package(OTA_KIND_FULL, OTA_COMPRESSION_DEFLATE, image.size(), raw_deflate(image));
+    for (size_t chunk : CHUNKS) {
+        Result result = apply(stored, {}, chunk);
+        CHECK(result.ok && result.written == image);
+        result = apply(deflated, {}, chunk);
+        CHECK(result.ok && result.written == image);
+    }
+}
+
+// The new image: the base's second half, new bytes, then its first half
+static Bytes delta_image(const Bytes& base, const Bytes& inserted) {
+    size_t half = base.size() / 2;
+    Bytes image(base.begin() + half, base.end());
+    image.insert(image.end(), inserted.begin(), inserted.end());
+    image.insert(image.end(), base.begin(), base.begin() + half);
+    return image;
+}
+
+static Bytes delta_patch(const Bytes& base, const Bytes& inserted) {
+    uint32_t half = base.size() / 2;
+    Bytes patch;
+    op_copy(patch, half, base.size() - half);
+    op_insert(patch, inserted.data(), inserted.size());
+    op_copy(patch, 0, half);
+    patch.push_back(OTA_OP_END);
+    return patch;
+}
+
+static void test_delta() {
+    current_test = "delta";
+    Bytes base = pattern(2 * OTA_WRITE_BLOCK + 77, 2);
+    Bytes inserted = pattern(OTA_WRITE_BLOCK + 5, 3);
+    Bytes image = delta_image(base, inserted);
+    Bytes patch = delta_patch(base, inserted);
+    Bytes stored = package(OTA_KIND_DELTA, OTA_COMPRESSION_NONE, image.size(), patch);
+    Bytes deflated = package(OTA_KIND_DELTA, OTA_COMPRESSION_DEFLATE, image.size(), raw_deflate(patch));
+    for (size_t chunk : CHUNKS) {
+        Result result = apply(stored, base, chunk);
+        CHECK(result.ok && result.written == image);
+        result = apply(deflated, base, chunk);
+        CHECK(result.ok && result.written == image);
+    }
+}
+
+static void expect_patch_error(const Bytes& base, uint32_t image_size, const Bytes& patch, const char* error) {
+    for (ota_compression_t compression : { OTA_COMPRESSION_NONE, OTA_COMPRESSION_DEFLATE }) {
+        Bytes payload = compression == OTA_COMPRESSION_DEFLATE ? raw_deflate(patch) : patch;
+        Bytes data = package(OTA_KIND_DELTA, compression, image_size, payload);
+        for (size_t chunk : CHUNKS) {
+            Result result = apply(data, base, chunk);
+            CHECK(!result.ok);
+            CHECK(result.error == error);
+            CHECK(result.written.size() <= image_size);
+        }
+    }
+}
+
+static void test_copy_bounds() {
+    current_test = "copy bounds";
+    Bytes base = pattern(1000, 4);
+    Bytes patch;
+
+    op_copy(patch, 0, 1001);                    // One past the end
+    patch.push_back(OTA_OP_END);
+    expect_patch_error(base, 2000, patch, "copy outside the running image");
+
+    patch.clear();
+    op_copy(patch, 1001, 0);                    // Starts past the end
+    patch.push_back(OTA_OP_END);
+    expect_patch_error(base, 2000, patch, "copy outside the running image");
+
+    patch.clear();
+    op_copy(patch, 0xFFFFFFF0u, 0x20);          // offset + length wraps
+    patch.push_back(OTA_OP_END);
+    expect_patch_error(base, 2000, patch, "copy outside the running image");
+
+    patch.clear();
+    op_copy(patch, 0, 600);
+    op_copy(patch, 0, 600);                     // Inside the base, past the image
+    patch.push_back(OTA_OP_END);
+    expect_patch_error(base, 1000, patch, "image longer than the header says");
+
+    patch.clear();
+    op_copy(patch, 0, 1000);                    // The whole base is fine
+    patch.push_back(OTA_OP_END);
+    Result result = apply(package(OTA_KIND_DELTA, OTA_COMPRESSION_NONE, 1000, patch), base, 0);
+    CHECK(result.ok && result.written == base);
+}
+
+static void test_insert_bounds() {
+    current_test = "insert bounds";
+    Bytes base = pattern(1000, 5);
+    Bytes bytes = pattern(300, 6);
+    Bytes patch;
+
+    op_insert(patch, bytes.data(), bytes.size());
+    patch.push_back(OTA_OP_END);
+    expect_patch_error(base, 299, patch, "image longer than the header says");
+
+    // A length far past the image fails on the op, before its bytes arrive
+    patch.clear();
+    patch.push_back(OTA_OP_INSERT);
+    put_le32(patch, 0xFFFFFFFFu);
+    patch.insert(patch.end(), bytes.begin(), bytes.end());
+    expect_patch_error(base, 1000, patch, "image longer than the header says");
+
+    patch.clear();
+    op_insert(patch, bytes.data(), bytes.size());
+    patch.resize(patch.size() - 1);             // Package ends inside the INSERT
+    expect_patch_error(base, 300, patch, "patch truncated");
+
+    patch.clear();
+    op_insert(patch, bytes.data(), bytes.size());
+    patch.push_back(OTA_OP_END);
+    patch.push_back(OTA_OP_END);
+    expect_patch_error(base, 300, patch, "patch data after its end");
+
+    patch.clear();
+    patch.push_back(7);
+    expect_patch_error(base, 300, patch, "unknown patch op");
+
+    patch.clear();
+    op_insert(patch, bytes.data(), bytes.size());   // No END
+    expect_patch_error(base, 300, patch, "patch truncated");
+}
+
+// What a dropped connection leaves: the deflate stream cut short
+static void test_truncated_deflate() {
+    current_test = "truncated deflate";
+    Bytes image = pattern(3 * OTA_WRITE_BLOCK, 7);
+    Bytes stream = raw_deflate(image);
+
+    // Cut in its last bits the stream may have given out the whole image: it
+    // still must not finish
+    for (size_t cut : { size_t(1), size_t(16), stream.size() / 2, stream.size() - 1 }) {
+        Bytes short_stream(stream.begin(), stream.end() - cut);
+        // The header still promises the whole stream: the package is short
+        Bytes data = package(OTA_KIND_FULL, OTA_COMPRESSION_DEFLATE, image.size(), stream);
+        data.resize(data.size() - cut);
+        for (size_t chunk : CHUNKS) {
+            Result result = apply(data, {}, chunk);
+            CHECK(!result.ok && result.error == "package truncated");
+            CHECK(result.written.size() <= image.size());
+        }
+        // The header agrees with the cut: the stream itself is short
+        data = package(OTA_KIND_FULL, OTA_COMPRESSION_DEFLATE, image.size(), short_stream);
+        for (size_t chunk : CHUNKS) {
+            Result result = apply(data, {}, chunk);
+            CHECK(!result.ok && result.error == "deflate stream truncated");
+            CHECK(result.written.size() <= image.size());
+        }
+    }
+
+    // A delta patch cut inside its deflate stream
+    Bytes base = pattern(2 * OTA_WRITE_BLOCK, 8);
+    Bytes inserted = pattern(500, 9);
+    Bytes patch_stream = raw_deflate(delta_patch(base, inserted));
+    patch_stream.resize(patch_stream.size() / 2);
+    Result result = apply(package(OTA_KIND_DELTA, OTA_COMPRESSION_DEFLATE,
+                                  delta_image(base, inserted).size(), patch_stream), base, 0);
+    CHECK(!result.ok && result.error == "deflate stream truncated");
+}
+
+static void test_corrupt() {
+    current_test = "corrupt";
+    Bytes image = pattern(2 * OTA_WRITE_BLOCK, 10);
+    Bytes stream = raw_deflate(image);
+    stream[0] = 0xFF;                           // Block type 3 is reserved
+    Result result = apply(package(OTA_KIND_FULL, OTA_COMPRESSION_DEFLATE, image.size(), stream), {}, 0);
+    CHECK(!result.ok && result.error == "corrupt deflate stream");
+
+    Bytes extra = raw_deflate(image);
+    extra.push_back(0);
+    result = apply(package(OTA_KIND_FULL, OTA_COMPRESSION_DEFLATE, image.size(), extra), {}, 0);
+    CHECK(!result.ok && result.error == "data after the deflate stream");
+
+    Bytes data = package(OTA_KIND_FULL, OTA_COMPRESSION_NONE, image.size(), image);
+    data[0] ^= 1;
+    result = apply(data, {}, 0);
+    CHECK(!result.ok && result.error == "not an ESPCaster package" && result.written.empty());
+
+    data = package(OTA_KIND_FULL, OTA_COMPRESSION_NONE, image.size() - 1, image);
+    result = apply(data, {}, 0);
+    CHECK(!result.ok && result.error == "image longer than the header says");
+
+    data = package(OTA_KIND_FULL, OTA_COMPRESSION_NONE, image.size() + 1, image);
+    result = apply(data, {}, 0);
+    CHECK(!result.ok && result.error == "image shorter than the header says");
+
+    data = package(OTA_KIND_FULL, OTA_COMPRESSION_NONE, image.size(), image);
+    data.push_back(0);
+    result = apply(data, {}, 0);
+    CHECK(!result.ok && result.error == "package longer than the header says");
+}
+
+int main() {
+    test_full();
+    test_delta();
+    test_copy_bounds();
+    test_insert_bounds();
+    test_truncated_deflate();
+    test_corrupt();
+    if (failures) {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("test_ota_package: all passed\n");
+    return 0;
+}
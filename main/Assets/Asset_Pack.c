@@ -0,0 +1,176 @@
+#include "Asset_Pack.h"
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_partition.h"
+
+static const char *TAG = "Assets";
+
+static const uint8_t *pack;
+static const asset_pack_header_t *header;
+static const asset_entry_t *entries;
+static lv_img_dsc_t *images;        // One per entry, filled on first use
+static esp_partition_mmap_handle_t pack_mmap;
+
+static bool Entry_Valid(const asset_entry_t *entry)
+{
+    return memchr(entry->name, '\0', sizeof(entry->name)) &&
+           entry->offset % 4 == 0 &&
+           entry->offset <= header->size && entry->size <= header->size - entry->offset &&
+           entry->encoding <= ASSET_ENCODING_RLE &&
+           (entry->encoding == ASSET_ENCODING_RAW ? entry->size == entry->data_size : entry->unit > 0);
+}
+
+/* Expand into dest, exactly data_size bytes; false on a malformed stream */
+static bool Rle_Decode(const asset_entry_t *entry, uint8_t *dest)
+{
+    const uint8_t *in = pack + entry->offset, *end = in + entry->size;
+    uint8_t *out = dest, *out_end = dest + entry->data_size;
+    size_t unit = entry->unit;
+
+    while (out < out_end) {
+        if (in >= end) {
+            return false;
+        }
+        uint8_t control = *in++;
+        if (control < 128) {
+            size_t length = (control + 1) * unit;
+            if (length > (size_t)(end - in) || length > (size_t)(out_end - out)) {
+                return false;
+            }
+            memcpy(out, in, length);
+            in += length;
+            out += length;
+            continue;
+        }
+
+        size_t total = (control - 126) * unit;
+        if (unit > (size_t)(end - in) || total > (size_t)(out_end - out)) {
+            return false;
+        }
+        if (unit == 1) {
+            memset(out, *in, total);
+        } else {
+            // Double the filled part: a few copies per run, not one per pixel
+            memcpy(out, in, unit);
+            for (size_t filled = unit; filled < total; ) {
+                size_t step = filled < total - filled ? filled : total - filled;
+                memcpy(out + filled, out, step);
+                filled += step;
+            }
+        }
+        in += unit;
+        out += total;
+    }
+    return true;
+}
+
+static void Pack_Unmap(void)
+{
+    esp_partition_munmap(pack_mmap);
+    pack = NULL;
+}
+
+bool Asset_Pack_Init(void)
+{
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                                ESP_PARTITION_SUBTYPE_ANY, "assets");
+    if (!partition) {
+        ESP_LOGW(TAG, "No assets partition");
+        return false;
+    }
+
+    asset_pack_header_t head;
+    if (esp_partition_read(partition, 0, &head, sizeof(head)) != ESP_OK ||
+        head.magic != ASSET_PACK_MAGIC || head.version != ASSET_PACK_VERSION) {
+        ESP_LOGW(TAG, "No asset pack flashed");
+        return false;
+    }
+    if (((head.flags & ASSET_PACK_FLAG_SWAP16) != 0) != (LV_COLOR_16_SWAP != 0)) {
+        ESP_LOGE(TAG, "Pack built %s the RGB565 byte swap this build draws with; rebuild it",
+                 (head.flags & ASSET_PACK_FLAG_SWAP16) ? "with" : "without");
+        return false;
+    }
+    if (head.count > ASSET_PACK_MAX_ENTRIES || head.size > partition->size ||
+        head.size < sizeof(head) + head.count * sizeof(asset_entry_t)) {
+        ESP_LOGE(TAG, "Asset pack header is corrupt");
+        return false;
+    }
+
+    // Only the pages the pack uses are mapped
+    const void *mapped;
+    esp_err_t err = esp_partition_mmap(partition, 0, head.size, ESP_PARTITION_MMAP_DATA, &mapped, &pack_mmap);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Mapping the asset pack failed: %s", esp_err_to_name(err));
+        return false;
+    }
+    pack = mapped;
+    header = (const asset_pack_header_t *)pack;
+    entries = (const asset_entry_t *)(pack + sizeof(asset_pack_header_t));
+    for (uint16_t i = 0; i < header->count; i++) {
+        if (!Entry_Valid(&entries[i])) {
+            ESP_LOGE(TAG, "Asset pack entry %u is corrupt", i);
+            Pack_Unmap();
+            return false;
+        }
+    }
+
+    images = calloc(header->count ? header->count : 1, sizeof(lv_img_dsc_t));
+    if (!images) {
+        Pack_Unmap();
+        return false;
+    }
+    ESP_LOGI(TAG, "%u images, %lu bytes mapped", header->count, (unsigned long)header->size);
+    return true;
+}
+
+const lv_img_dsc_t *Asset_Pack_Get(const char *name)
+{
+    if (!pack || !name) {
+        return NULL;
+    }
+
+    // The index is sorted by name
+    int low = 0, high = (int)header->count - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        const asset_entry_t *entry = &entries[mid];
+        int order = strncmp(name, entry->name, ASSET_NAME_MAX);
+        if (order < 0) {
+            high = mid - 1;
+            continue;
+        }
+        if (order > 0) {
+            low = mid + 1;
+            continue;
+        }
+
+        lv_img_dsc_t *image = &images[mid];
+        if (image->data) {
+            return image;
+        }
+        if (entry->encoding == ASSET_ENCODING_RAW) {
+            image->data = pack + entry->offset;
+        } else {
+            uint8_t *data = heap_caps_malloc(entry->data_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+            if (!data) {
+                ESP_LOGE(TAG, "No PSRAM for %s (%lu bytes)", name, (unsigned long)entry->data_size);
+                return NULL;
+            }
+            if (!Rle_Decode(entry, data)) {
+                ESP_LOGE(TAG, "%s does not decode", name);
+                heap_caps_free(data);
+                return NULL;
+            }
+            image->data = data;
+        }
+        image->header.cf = entry->cf;
+        image->header.w = entry->width;
+        image->header.h = entry->height;
+        image->data_size = entry->data_size;
+        return image;
+    }
+    ESP_LOGW(TAG, "No image %s in the pack", name);
+    return NULL;
+}
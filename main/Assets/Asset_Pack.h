@@ -0,0 +1,63 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "lvgl.h"
+
+/*
+ * UI images from the assets partition, packed at build time by
+ * tools/asset_pack.py from main/Assets/ui (PNG or SVG):
+ *
+ *   header   asset_pack_header_t, little endian
+ *   index    count asset_entry_t, sorted by name
+ *   data     each entry's pixels, 4-byte aligned
+ *
+ * Pixels are stored in the layout LVGL draws (RGB565 byte swapped for
+ * LV_COLOR_16_SWAP, RGB565 + alpha, alpha only or indexed), so nothing is
+ * converted on the device. The partition is mapped once, and a raw entry's
+ * lv_img_dsc_t points straight into the mapping: drawing an opaque image
+ * is a row memcpy from flash, and it takes no RAM and none of the app
+ * image. An RLE entry is expanded into PSRAM the first time it is asked
+ * for and kept from then on.
+ *
+ * RLE control byte n: below 128, n + 1 literal pixels follow; from 128,
+ * one pixel repeated n - 126 times. A pixel is the entry's unit bytes.
+ */
+
+#define ASSET_PACK_MAGIC            0x53414345  // "ECAS"
+#define ASSET_PACK_VERSION          1
+#define ASSET_PACK_FLAG_SWAP16      0x01        // RGB565 byte swapped
+#define ASSET_NAME_MAX              24          // With the terminator
+#define ASSET_PACK_MAX_ENTRIES      128
+
+typedef enum {
+    ASSET_ENCODING_RAW,
+    ASSET_ENCODING_RLE,
+} asset_encoding_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t flags;
+    uint16_t count;
+    uint32_t size;                  // Of the whole pack
+} asset_pack_header_t;
+
+typedef struct __attribute__((packed)) {
+    char name[ASSET_NAME_MAX];
+    uint32_t offset;                // From the start of the pack
+    uint32_t size;                  // As stored
+    uint32_t data_size;             // Decoded, as LVGL reads it
+    uint16_t width;
+    uint16_t height;
+    uint8_t cf;                     // lv_img_cf_t
+    uint8_t encoding;               // asset_encoding_t
+    uint8_t unit;                   // RLE pixel size in bytes
+    uint8_t reserved;
+} asset_entry_t;
+
+// Before the GUI: map the pack; false if the partition holds none or one
+// built for the other LV_COLOR_16_SWAP
+bool Asset_Pack_Init(void);
+// LVGL thread: the image called name, or NULL if the pack has none.
+// Valid for as long as the program runs
+const lv_img_dsc_t *Asset_Pack_Get(const char *name);
@@ -0,0 +1,277 @@
+#include "Audio_DSP.h"
+#include <math.h>
+#include <string.h>
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "dsps_biquad.h"
+#include "dsps_biquad_gen.h"
+#include "PCM5101.h"
+
+static const char *TAG = "AUDIO DSP";
+
+#define AUDIO_DSP_STAGES            3
+#define AUDIO_DSP_CHANNELS          2
+#define AUDIO_DSP_LOOKAHEAD_MAX     (AUDIO_DSP_MAX_RATE * AUDIO_DSP_LOOKAHEAD_MS / 1000)
+
+typedef struct {
+    float delay[AUDIO_DSP_LOOKAHEAD_MAX * AUDIO_DSP_CHANNELS];     // Interleaved
+    uint32_t frames;            // Look-ahead, and how long a reduction holds
+    uint32_t pos;
+    float ceiling;
+    float release;              // One-pole recovery coefficient per frame
+    float gain;
+    float target;               // Lowest gain a peak in the delay line needs
+    float slope;                // Per frame on the way down to target
+    uint32_t hold;
+} limiter_t;
+
+// Writers: Audio_DSP_Configure(); reader: the write path, which copies them
+// once the generation has moved
+static portMUX_TYPE settings_lock = portMUX_INITIALIZER_UNLOCKED;
+static audio_dsp_settings_t settings;
+static volatile uint32_t settings_gen;
+
+// Write path only
+static audio_dsp_settings_t applied;
+static uint32_t applied_gen = UINT32_MAX;
+static int applied_loudness_db = -1;
+static uint32_t rate;
+static uint8_t channels;
+static float coef[AUDIO_DSP_STAGES][5];
+static float state[AUDIO_DSP_CHANNELS][AUDIO_DSP_STAGES][2];
+static int stage_count;
+static float planar[AUDIO_DSP_CHANNELS][AUDIO_DSP_MAX_FRAMES];
+static limiter_t limiter;
+
+void Audio_DSP_Init(void)
+{
+    const audio_dsp_settings_t defaults = {
+        .highpass_hz = CONFIG_AUDIO_DSP_HIGHPASS_HZ,
+        .bass_db = CONFIG_AUDIO_DSP_BASS_DB,
+        .presence_db = CONFIG_AUDIO_DSP_PRESENCE_DB,
+#if CONFIG_AUDIO_DSP_LOUDNESS
+        .loudness = true,
+#endif
+        .limit_dbfs = CONFIG_AUDIO_DSP_LIMIT_DBFS,
+    };
+    Audio_DSP_Configure(&defaults);
+}
+
+void Audio_DSP_Configure(const audio_dsp_settings_t *new_settings)
+{
+    taskENTER_CRITICAL(&settings_lock);
+    settings = *new_settings;
+    if (settings.limit_dbfs > 0) {
+        settings.limit_dbfs = 0;
+    }
+    settings_gen++;
+    taskEXIT_CRITICAL(&settings_lock);
+}
+
+void Audio_DSP_Get_Settings(audio_dsp_settings_t *out)
+{
+    taskENTER_CRITICAL(&settings_lock);
+    *out = settings;
+    taskEXIT_CRITICAL(&settings_lock);
+}
+
+// Bass added for a volume below full, in whole dB
+static int Audio_DSP_Loudness_dB(uint8_t volume)
+{
+    if (!applied.loudness) {
+        return 0;
+    }
+    if (volume == 0) {
+        return AUDIO_DSP_LOUDNESS_MAX_DB;
+    }
+    float cut_db = -20.0f * log10f((float)volume / Volume_MAX);
+    int db = (int)lrintf(cut_db * AUDIO_DSP_LOUDNESS_RATIO);
+    return db < AUDIO_DSP_LOUDNESS_MAX_DB ? db : AUDIO_DSP_LOUDNESS_MAX_DB;
+}
+
+// RBJ peaking EQ; esp-dsp's peakingEQ generator is a band-pass without gain
+static void Audio_DSP_Gen_Peak(float *c, float f, float gain_db, float q)
+{
+    float A = powf(10.0f, gain_db / 40.0f);
+    float w0 = 2.0f * (float)M_PI * f;
+    float alpha = sinf(w0) / (2.0f * q);
+    float cw = cosf(w0);
+    float a0 = 1.0f + alpha / A;
+    c[0] = (1.0f + alpha * A) / a0;
+    c[1] = -2.0f * cw / a0;
+    c[2] = (1.0f - alpha * A) / a0;
+    c[3] = -2.0f * cw / a0;
+    c[4] = (1.0f - alpha / A) / a0;
+}
+
+// Normalised to the sample rate, kept below Nyquist
+static float Audio_DSP_Freq(uint32_t hz)
+{
+    float f = (float)hz / rate;
+    return f < 0.45f ? f : 0.45f;
+}
+
+static void Audio_DSP_Recompute(int loudness_db)
+{
+    stage_count = 0;
+    if (applied.highpass_hz > 0) {
+        dsps_biquad_gen_hpf_f32(coef[stage_count++], Audio_DSP_Freq(applied.highpass_hz), AUDIO_DSP_HIGHPASS_Q);
+    }
+    int bass_db = applied.bass_db + loudness_db;
+    if (bass_db != 0) {
+        dsps_biquad_gen_lowShelf_f32(coef[stage_count++], Audio_DSP_Freq(AUDIO_DSP_BASS_HZ), bass_db, AUDIO_DSP_BASS_Q);
+    }
+    if (applied.presence_db != 0) {
+        Audio_DSP_Gen_Peak(coef[stage_count++], Audio_DSP_Freq(AUDIO_DSP_PRESENCE_HZ), applied.presence_db, AUDIO_DSP_PRESENCE_Q);
+    }
+    limiter.ceiling = powf(10.0f, applied.limit_dbfs / 20.0f) * INT16_MAX;
+    applied_loudness_db = loudness_db;
+    ESP_LOGD(TAG, "%d stages, bass %+d dB (loudness %+d), limit %d dBFS",
+             stage_count, bass_db, loudness_db, applied.limit_dbfs);
+}
+
+void Audio_DSP_Set_Format(uint32_t sample_rate, uint8_t channel_count)
+{
+    if (sample_rate > AUDIO_DSP_MAX_RATE) {
+        sample_rate = AUDIO_DSP_MAX_RATE;
+    }
+    rate = sample_rate;
+    channels = channel_count < AUDIO_DSP_CHANNELS ? channel_count : AUDIO_DSP_CHANNELS;
+    memset(state, 0, sizeof(state));
+    memset(&limiter, 0, sizeof(limiter));
+    limiter.frames = rate * AUDIO_DSP_LOOKAHEAD_MS / 1000;
+    limiter.release = 1.0f - expf(-1000.0f / (AUDIO_DSP_RELEASE_MS * (float)rate));
+    limiter.gain = limiter.target = 1.0f;
+    applied_gen = settings_gen - 1;     // Recompute for the new rate
+}
+
+uint32_t Audio_DSP_Latency_us(void)
+{
+    return rate ? (uint32_t)((uint64_t)limiter.frames * 1000000 / rate) : 0;
+}
+
+static void Audio_DSP_Limit(float *left, float *right, int16_t *out, size_t frames)
+{
+    limiter_t *lim = &limiter;
+    for (size_t n = 0; n < frames; n++) {
+        float l = left[n];
+        float r = right ? right[n] : l;
+        float peak = fmaxf(fabsf(l), fabsf(r));
+        if (peak > lim->ceiling) {
+            float need = lim->ceiling / peak;
+            if (need < lim->target) {
+                // The steeper of the two slopes meets both deadlines
+                float slope = (need - lim->gain) / lim->frames;
+                lim->slope = fminf(lim->slope, slope);
+                lim->target = need;
+            }
+            lim->hold = lim->frames;            // No recovery while it is in the delay line
+        }
+        if (lim->gain > lim->target) {
+            lim->gain += lim->slope;
+            if (lim->gain <= lim->target) {
+                lim->gain = lim->target;
+                lim->slope = 0;
+            }
+        } else if (lim->hold > 0) {
+            lim->hold--;
+        } else if (lim->gain < 1.0f) {
+            lim->gain += (1.0f - lim->gain) * lim->release;
+            lim->target = lim->gain;
+        }
+
+        float *slot = &lim->delay[lim->pos * AUDIO_DSP_CHANNELS];
+        float dl = slot[0] * lim->gain;
+        float dr = slot[1] * lim->gain;
+        slot[0] = l;
+        slot[1] = r;
+        if (++lim->pos >= lim->frames) {
+            lim->pos = 0;
+        }
+        // The ceiling may be 0 dBFS
+        int32_t sl = (int32_t)dl;
+        out[0] = (int16_t)(sl > INT16_MAX ? INT16_MAX : sl < INT16_MIN ? INT16_MIN : sl);
+        if (right) {
+            int32_t sr = (int32_t)dr;
+            out[1] = (int16_t)(sr > INT16_MAX ? INT16_MAX : sr < INT16_MIN ? INT16_MIN : sr);
+        }
+        out += right ? 2 : 1;
+    }
+}
+
+void Audio_DSP_Process(const int16_t *in, int16_t *out, size_t count, float gain_from, float gain_to, uint8_t volume)
+{
+    if (rate == 0) {
+        Audio_DSP_Set_Format(44100, AUDIO_DSP_CHANNELS);   // What Audio_Init() opens I2S with
+    }
+    uint32_t gen = settings_gen;
+    if (gen != applied_gen) {
+        Audio_DSP_Get_Settings(&applied);
+        applied_gen = gen;
+        applied_loudness_db = -1;
+    }
+    int loudness_db = Audio_DSP_Loudness_dB(volume);
+    if (loudness_db != applied_loudness_db) {
+        Audio_DSP_Recompute(loudness_db);
+    }
+
+    size_t frames = count / channels;
+    if (frames > AUDIO_DSP_MAX_FRAMES) {
+        frames = AUDIO_DSP_MAX_FRAMES;
+    }
+    // Apart, in float, with the volume ramp folded into the conversion
+    float gain = gain_from;
+    float step = frames ? (gain_to - gain_from) / frames : 0;
+    for (size_t n = 0; n < frames; n++) {
+        for (int c = 0; c < channels; c++) {
+            planar[c][n] = in[n * channels + c] * gain;
+        }
+        gain += step;
+    }
+    for (int c = 0; c < channels; c++) {
+        for (int s = 0; s < stage_count; s++) {
+            dsps_biquad_f32(planar[c], planar[c], frames, coef[s], state[c][s]);
+        }
+    }
+    Audio_DSP_Limit(planar[0], channels > 1 ? planar[1] : NULL, out, frames);
+}
+
+#if CONFIG_ESPCASTER_BENCH
+uint32_t Audio_DSP_Bench(const int16_t *in, int16_t *out, size_t count)
+{
+    static float saved_coef[AUDIO_DSP_STAGES][5];
+    static float saved_state[AUDIO_DSP_CHANNELS][AUDIO_DSP_STAGES][2];
+    static limiter_t saved_limiter;
+    uint32_t saved_rate = rate;
+    uint8_t saved_channels = channels;
+    audio_dsp_settings_t saved_applied = applied;
+    uint32_t saved_gen = applied_gen;
+    int saved_loudness_db = applied_loudness_db;
+    int saved_stage_count = stage_count;
+    memcpy(saved_coef, coef, sizeof(coef));
+    memcpy(saved_state, state, sizeof(state));
+    saved_limiter = limiter;
+
+    Audio_DSP_Set_Format(44100, 2);
+    applied = (audio_dsp_settings_t){
+        .highpass_hz = 100, .bass_db = 4, .presence_db = 2, .loudness = true, .limit_dbfs = -1,
+    };
+    Audio_DSP_Recompute(AUDIO_DSP_LOUDNESS_MAX_DB);
+    applied_gen = settings_gen;
+    uint32_t start = esp_cpu_get_cycle_count();
+    Audio_DSP_Process(in, out, count, 1.0f, 0.5f, 0);
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+
+    rate = saved_rate;
+    channels = saved_channels;
+    applied = saved_applied;
+    applied_gen = saved_gen;
+    applied_loudness_db = saved_loudness_db;
+    stage_count = saved_stage_count;
+    memcpy(coef, saved_coef, sizeof(coef));
+    memcpy(state, saved_state, sizeof(state));
+    limiter = saved_limiter;
+    return cycles;
+}
+#endif
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+
+/*
+ * Speaker DSP (CONFIG_AUDIO_DSP), in bsp_i2s_write() between the player (or
+ * direct output) and the I2S DMA queue, in place of the Q15 gain stage.
+ *
+ * Per channel, in float: a high-pass below what the small speaker can move
+ * (AUDIO_DSP_HIGHPASS_Q), a bass low shelf at AUDIO_DSP_BASS_HZ and a
+ * presence peak at AUDIO_DSP_PRESENCE_HZ, cascaded esp-dsp biquads (the
+ * S3 assembly build). Stages at 0 dB are skipped. With loudness on, the
+ * shelf gains AUDIO_DSP_LOUDNESS_RATIO dB of bass per dB the volume is
+ * turned down, up to AUDIO_DSP_LOUDNESS_MAX_DB, in whole dB steps.
+ *
+ * Then the volume, ramped linearly across each chunk, and a look-ahead
+ * peak limiter linked across channels: the gain reaches what a peak needs
+ * by the time it leaves the AUDIO_DSP_LOOKAHEAD_MS delay line, holds for
+ * as long again, then recovers with AUDIO_DSP_RELEASE_MS.
+ *
+ * Coefficients are recomputed on the writing task only when the settings,
+ * the format or the loudness step change; biquad state is kept across a
+ * settings change and cleared on a format change.
+ *
+ * Audio_DSP_Configure() from any task; the rest on the I2S write path.
+ */
+
+#define AUDIO_DSP_MAX_FRAMES        512         // Per Audio_DSP_Process() call
+#define AUDIO_DSP_MAX_RATE          96000
+#define AUDIO_DSP_HIGHPASS_Q        0.707f
+#define AUDIO_DSP_BASS_HZ           250
+#define AUDIO_DSP_BASS_Q            0.707f
+#define AUDIO_DSP_PRESENCE_HZ       3000
+#define AUDIO_DSP_PRESENCE_Q        1.0f
+#define AUDIO_DSP_LOUDNESS_RATIO    0.4f
+#define AUDIO_DSP_LOUDNESS_MAX_DB   9
+#define AUDIO_DSP_LOOKAHEAD_MS      2
+#define AUDIO_DSP_RELEASE_MS        80
+
+typedef struct {
+    uint16_t highpass_hz;       // 0: no high-pass
+    int8_t bass_db;
+    int8_t presence_db;
+    bool loudness;
+    int8_t limit_dbfs;          // Limiter ceiling, 0 or below
+} audio_dsp_settings_t;
+
+// Kconfig defaults; before the first write
+void Audio_DSP_Init(void);
+void Audio_DSP_Configure(const audio_dsp_settings_t *settings);
+void Audio_DSP_Get_Settings(audio_dsp_settings_t *settings);
+
+// I2S write path only
+void Audio_DSP_Set_Format(uint32_t sample_rate, uint8_t channels);
+// count interleaved samples; gain goes linearly from gain_from to gain_to
+// across them; volume (0..Volume_MAX) sets the loudness contour
+void Audio_DSP_Process(const int16_t *in, int16_t *out, size_t count, float gain_from, float gain_to, uint8_t volume);
+uint32_t Audio_DSP_Latency_us(void);        // The limiter's delay line
+
+#if CONFIG_ESPCASTER_BENCH
+// CPU cycles of Audio_DSP_Process() on count samples of 44.1 kHz stereo with
+// every stage on; leaves the playback state alone
+uint32_t Audio_DSP_Bench(const int16_t *in, int16_t *out, size_t count);
+#endif
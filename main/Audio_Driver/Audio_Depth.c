@@ -0,0 +1,106 @@
+#include "Audio_Depth.h"
+#include "audio_player.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "telemetry.h"
+
+static const char *TAG = "AUDIO DEPTH";
+
+// Write path only
+static uint32_t dma_max = AUDIO_DEPTH_DMA_BASE;
+static uint32_t dma_buffers = AUDIO_DEPTH_DMA_BASE;
+static uint8_t pcm_max = AUDIO_DEPTH_PCM_BASE;
+static uint8_t pcm_base = AUDIO_DEPTH_PCM_BASE;
+static int64_t window_start_us;         // 0: no window open
+static int64_t last_update_us;
+static int64_t stable_since_us;
+
+// Counted from any writer; a lost increment only delays a step
+static volatile uint32_t underruns;
+
+void Audio_Depth_Init(uint32_t dma_max_buffers)
+{
+    dma_max = dma_max_buffers;
+    dma_buffers = dma_max < AUDIO_DEPTH_DMA_BASE ? dma_max : AUDIO_DEPTH_DMA_BASE;
+    pcm_max = CONFIG_AUDIO_PLAYER_PCM_BUFFERS;
+    pcm_base = pcm_max < AUDIO_DEPTH_PCM_BASE ? pcm_max : AUDIO_DEPTH_PCM_BASE;
+    audio_player_set_pcm_depth(pcm_base);
+    ESP_LOGI(TAG, "PCM %u of %u buffers, DMA %lu of %lu", pcm_base, pcm_max,
+             (unsigned long)dma_buffers, (unsigned long)dma_max);
+}
+
+void Audio_Depth_Underrun(void)
+{
+    underruns++;
+}
+
+uint32_t Audio_Depth_DMA_Buffers(void)
+{
+    return dma_buffers;
+}
+
+// Starts a window, dropping what was counted while nothing was measured
+static void Audio_Depth_Open_Window(int64_t now)
+{
+    audio_player_decode_stats_t stale;
+    audio_player_take_decode_stats(&stale);
+    underruns = 0;
+    window_start_us = now;
+    stable_since_us = now;
+}
+
+uint32_t Audio_Depth_Update(uint32_t dma_buffer_us)
+{
+    int64_t now = esp_timer_get_time();
+    // Paused, stopped or on direct output since the last write: start over
+    if (window_start_us == 0 || now - last_update_us > AUDIO_DEPTH_WINDOW_MS * 1000) {
+        Audio_Depth_Open_Window(now);
+    }
+    last_update_us = now;
+    if (now - window_start_us < AUDIO_DEPTH_WINDOW_MS * 1000) {
+        return dma_buffers;
+    }
+    window_start_us = now;
+
+    audio_player_decode_stats_t stats;
+    audio_player_take_decode_stats(&stats);
+    uint32_t missed = underruns;
+    underruns = 0;
+
+    uint8_t pcm = audio_player_get_pcm_depth();
+    // While one buffer is being written the decoder has the others to refill
+    uint64_t headroom_us = (uint64_t)(pcm - 1) * stats.frame_us * AUDIO_DEPTH_HEADROOM_PCT / 100;
+    bool jitter = stats.frames > 0 && stats.frame_us > 0 && stats.decode_max_us > headroom_us;
+
+    uint8_t next_pcm = pcm;
+    uint32_t next_dma = dma_buffers;
+    if (jitter || missed > 0) {
+        if (jitter && pcm < pcm_max) {
+            next_pcm = pcm + 1;
+        } else if (missed > 0 && dma_buffers < dma_max) {
+            next_dma = dma_buffers + AUDIO_DEPTH_DMA_STEP < dma_max ? dma_buffers + AUDIO_DEPTH_DMA_STEP : dma_max;
+        } else if (missed > 0 && pcm < pcm_max) {
+            next_pcm = pcm + 1;
+        }
+        stable_since_us = now;
+    } else if (now - stable_since_us >= AUDIO_DEPTH_STABLE_MS * 1000) {
+        if (pcm > pcm_base) {
+            next_pcm = pcm - 1;
+        } else if (dma_buffers > AUDIO_DEPTH_DMA_BASE) {
+            next_dma = dma_buffers > AUDIO_DEPTH_DMA_BASE + AUDIO_DEPTH_DMA_STEP ?
+                       dma_buffers - AUDIO_DEPTH_DMA_STEP : AUDIO_DEPTH_DMA_BASE;
+        }
+        stable_since_us = now;
+    }
+
+    if (next_pcm != pcm || next_dma != dma_buffers) {
+        ESP_LOGI(TAG, "%lu underruns, decode %lu us max of %lu us frames: PCM %u -> %u, DMA %lu -> %lu",
+                 (unsigned long)missed, (unsigned long)stats.decode_max_us, (unsigned long)stats.frame_us,
+                 pcm, next_pcm, (unsigned long)dma_buffers, (unsigned long)next_dma);
+        audio_player_set_pcm_depth(next_pcm);
+        dma_buffers = next_dma;
+    }
+    telemetry_record(TELEMETRY_AUDIO_DEPTH,
+                     (uint32_t)(((uint64_t)next_pcm * stats.frame_us + (uint64_t)next_dma * dma_buffer_us) / 1000));
+    return dma_buffers;
+}
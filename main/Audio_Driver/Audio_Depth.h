@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include "sdkconfig.h"
+
+/*
+ * Adaptive output buffering (CONFIG_AUDIO_ADAPTIVE_DEPTH) for local
+ * playback: how many of the player's PCM buffers and of the I2S DMA
+ * buffers may hold audio ahead of the DAC.
+ *
+ * Every AUDIO_DEPTH_WINDOW_MS of playback the controller looks at the
+ * underruns counted in that window and at the slowest decode
+ * (audio_player_take_decode_stats()). A decode that needs more than
+ * AUDIO_DEPTH_HEADROOM_PCT of what the PCM ring holds behind the frame
+ * being written is jitter that will starve the DAC sooner or later, and
+ * gets one more PCM buffer. An underrun with decoding well inside the
+ * ring is the writer itself coming late (a busy core, a reconfiguration)
+ * and gets AUDIO_DEPTH_DMA_STEP more DMA buffers. After
+ * AUDIO_DEPTH_STABLE_MS with neither, one step is given back for latency,
+ * PCM first, down to AUDIO_DEPTH_PCM_BASE and AUDIO_DEPTH_DMA_BASE.
+ *
+ * The DMA descriptors are allocated once at their maximum
+ * (CONFIG_AUDIO_DEPTH_DMA_BUFFERS_MAX), as the driver cannot resize them
+ * on a live channel; the depth is a cap on the bytes bsp_i2s_write()
+ * queues. Direct output is left alone: the multi-room client measures the
+ * queue it finds with Audio_Output_Delay_us().
+ *
+ * I2S write path only, but Audio_Depth_Underrun().
+ */
+
+#define AUDIO_DEPTH_WINDOW_MS       2000
+#define AUDIO_DEPTH_STABLE_MS       60000
+#define AUDIO_DEPTH_HEADROOM_PCT    75
+#define AUDIO_DEPTH_PCM_BASE        3           // PCM buffers, the fixed depth before this
+#define AUDIO_DEPTH_DMA_BASE        6           // DMA buffers, the driver's default
+#define AUDIO_DEPTH_DMA_STEP        2
+
+// After audio_player_new(); dma_max: DMA buffers allocated
+void Audio_Depth_Init(uint32_t dma_max);
+// Called from the I2S write path when the DMA ran dry while playing
+void Audio_Depth_Underrun(void);
+// Each write of local playback; dma_buffer_us: one DMA buffer at the
+// current format. Returns the DMA buffers that may be queued
+uint32_t Audio_Depth_Update(uint32_t dma_buffer_us);
+// DMA buffers that may be queued
+uint32_t Audio_Depth_DMA_Buffers(void);
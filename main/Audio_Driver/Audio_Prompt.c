@@ -0,0 +1,524 @@
+#include "Audio_Prompt.h"
+
+#if CONFIG_AUDIO_PROMPT
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_tts.h"
+#include "esp_tts_voice_template.h"
+#include "mem_task.h"
+#include "PCM5101.h"
+#include "SD_MMC.h"
+
+static const char *TAG = "AUDIO PROMPT";
+
+#define AUDIO_PROMPT_NO_NUMBER      (-1)
+#define AUDIO_PROMPT_MAX_FRAGMENTS  16          // 9999 is "九千九百九十九", seven
+
+typedef struct {
+    uint32_t magic;
+    uint32_t frames;            // At AUDIO_PROMPT_RATE, mono
+    char text[AUDIO_PROMPT_TEXT_LEN];       // Told apart from another with the same hash
+} Audio_Prompt_Header_t;
+
+typedef struct {
+    char text[AUDIO_PROMPT_TEXT_LEN];
+    int number;                 // AUDIO_PROMPT_NO_NUMBER for none
+    bool play;                  // false: only into the cache
+} Audio_Prompt_Request_t;
+
+typedef struct {
+    uint32_t hash;              // 0: the slot is free
+    char text[AUDIO_PROMPT_TEXT_LEN];       // A number prompt's is its phrase and digits
+    audio_player_clip_t clip;   // At the output rate, in PSRAM
+    uint32_t last_used;
+    int64_t sounding_until_us;  // The mixer may still read it until then
+    bool pinned;                // A number fragment
+} Audio_Prompt_Entry_t;
+
+// Digits first, so a digit is its own index
+enum {
+    FRAGMENT_TEN = 10,
+    FRAGMENT_HUNDRED,
+    FRAGMENT_THOUSAND,
+    FRAGMENT_COUNT
+};
+static const char *const Audio_Prompt_Fragments[FRAGMENT_COUNT] = {
+    "零", "一", "二", "三", "四", "五", "六", "七", "八", "九", "十", "百", "千",
+};
+
+static QueueHandle_t request_queue;
+static esp_tts_handle_t tts;                // NULL without the voice partition
+// The task's alone
+static Audio_Prompt_Entry_t cache[AUDIO_PROMPT_CACHE_ENTRIES];
+static Audio_Prompt_Entry_t *fragments[FRAGMENT_COUNT];
+static size_t cache_bytes;
+static uint32_t use_counter;
+
+// FNV-1a, with 0 kept for a free slot
+static uint32_t Audio_Prompt_Hash(const char *text)
+{
+    uint32_t hash = 2166136261u;
+    while (*text) {
+        hash ^= (uint8_t)*text++;
+        hash *= 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+/************************************************************************************************
+ *  PCM at 16 kHz: synthesis and the flash copy
+ ************************************************************************************************/
+static int16_t *Audio_Prompt_Synthesize(const char *text, size_t *frames)
+{
+    if (!tts) {
+        return NULL;
+    }
+    if (!esp_tts_parse_chinese(tts, text)) {
+        ESP_LOGW(TAG, "Cannot say \"%s\"", text);
+        return NULL;
+    }
+    const size_t max_frames = AUDIO_PROMPT_RATE * AUDIO_PROMPT_MAX_SECONDS;
+    int16_t *pcm = heap_caps_malloc(max_frames * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+    size_t count = 0;
+    int64_t start = esp_timer_get_time();
+    while (pcm) {
+        int len = 0;
+        const short *chunk = esp_tts_stream_play(tts, &len, AUDIO_PROMPT_SPEED);
+        if (len <= 0) {
+            break;
+        }
+        size_t take = ((size_t)len < max_frames - count) ? (size_t)len : max_frames - count;
+        memcpy(pcm + count, chunk, take * sizeof(int16_t));
+        count += take;
+        if (count == max_frames) {
+            ESP_LOGW(TAG, "\"%s\" cut off at %d s", text, AUDIO_PROMPT_MAX_SECONDS);
+            break;
+        }
+    }
+    esp_tts_stream_reset(tts);
+    if (!pcm || count == 0) {
+        free(pcm);
+        return NULL;
+    }
+    ESP_LOGI(TAG, "Synthesised \"%s\": %u ms of speech in %lld ms", text,
+             (unsigned)(count * 1000 / AUDIO_PROMPT_RATE), (esp_timer_get_time() - start) / 1000);
+    *frames = count;
+    return pcm;
+}
+
+static void Audio_Prompt_Path(uint32_t hash, char *path, size_t size)
+{
+    snprintf(path, size, AUDIO_PROMPT_DIR "/%08lx.pcm", (unsigned long)hash);
+}
+
+static int16_t *Audio_Prompt_Load(const char *text, uint32_t hash, size_t *frames)
+{
+    char path[48];
+    Audio_Prompt_Path(hash, path, sizeof(path));
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+    Audio_Prompt_Header_t header;
+    int16_t *pcm = NULL;
+    bool ok = fread(&header, 1, sizeof(header), fp) == sizeof(header) &&
+              header.magic == AUDIO_PROMPT_MAGIC && strncmp(header.text, text, sizeof(header.text)) == 0 &&
+              header.frames > 0 && header.frames <= AUDIO_PROMPT_RATE * AUDIO_PROMPT_MAX_SECONDS;
+    if (ok) {
+        pcm = heap_caps_malloc(header.frames * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+        ok = pcm && fread(pcm, sizeof(int16_t), header.frames, fp) == header.frames;
+    }
+    fclose(fp);
+    if (!ok) {
+        free(pcm);
+        return NULL;
+    }
+    *frames = header.frames;
+    return pcm;
+}
+
+static void Audio_Prompt_Save(const char *text, uint32_t hash, const int16_t *pcm, size_t frames)
+{
+    char path[48];
+    Audio_Prompt_Path(hash, path, sizeof(path));
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        ESP_LOGW(TAG, "Cannot write %s", path);
+        return;
+    }
+    Audio_Prompt_Header_t header = { .magic = AUDIO_PROMPT_MAGIC, .frames = frames };
+    strlcpy(header.text, text, sizeof(header.text));
+    bool ok = fwrite(&header, 1, sizeof(header), fp) == sizeof(header) &&
+              fwrite(pcm, sizeof(int16_t), frames, fp) == frames;
+    if (fclose(fp) != 0 || !ok) {
+        ESP_LOGW(TAG, "Failed to write %s", path);
+        remove(path);       // A short file would only be rejected on every load
+    }
+}
+
+/************************************************************************************************
+ *  The cache, at the output rate
+ ************************************************************************************************/
+// Drops the silence esp-tts leaves around a syllable, so fragments join up
+static const int16_t *Audio_Prompt_Trim(const int16_t *pcm, size_t *frames)
+{
+    size_t start = 0, end = *frames;
+    while (start < end && abs(pcm[start]) < AUDIO_PROMPT_TRIM_LEVEL) {
+        start++;
+    }
+    while (end > start && abs(pcm[end - 1]) < AUDIO_PROMPT_TRIM_LEVEL) {
+        end--;
+    }
+    *frames = end - start;
+    return pcm + start;
+}
+
+// Linear interpolation from 16 kHz; speech has next to nothing above 8 kHz to alias
+static int16_t *Audio_Prompt_Resample(const int16_t *pcm, size_t frames, size_t *out_frames)
+{
+    size_t count = (size_t)((uint64_t)frames * AUDIO_OUTPUT_RATE / AUDIO_PROMPT_RATE);
+    int16_t *out = count ? heap_caps_malloc(count * sizeof(int16_t), MALLOC_CAP_SPIRAM) : NULL;
+    if (!out) {
+        return NULL;
+    }
+    const uint32_t step = (uint32_t)(((uint64_t)AUDIO_PROMPT_RATE << 16) / AUDIO_OUTPUT_RATE);     // Q16
+    uint32_t pos = 0;
+    for (size_t n = 0; n < count; n++, pos += step) {
+        size_t i = pos >> 16;
+        int32_t frac = pos & 0xFFFF;
+        int32_t a = pcm[i];
+        int32_t b = (i + 1 < frames) ? pcm[i + 1] : a;
+        out[n] = (int16_t)(a + (((b - a) * frac) >> 16));
+    }
+    *out_frames = count;
+    return out;
+}
+
+static Audio_Prompt_Entry_t *Audio_Prompt_Find(const char *text, uint32_t hash)
+{
+    for (int i = 0; i < AUDIO_PROMPT_CACHE_ENTRIES; i++) {
+        if (cache[i].hash == hash && strcmp(cache[i].text, text) == 0) {
+            cache[i].last_used = ++use_counter;
+            return &cache[i];
+        }
+    }
+    return NULL;
+}
+
+static void Audio_Prompt_Free(Audio_Prompt_Entry_t *entry)
+{
+    cache_bytes -= entry->clip.frames * sizeof(int16_t);
+    free((void *)entry->clip.samples);
+    memset(entry, 0, sizeof(*entry));
+}
+
+// Least recently used that is neither a fragment nor still sounding
+static Audio_Prompt_Entry_t *Audio_Prompt_Victim(void)
+{
+    int64_t now = esp_timer_get_time();
+    Audio_Prompt_Entry_t *victim = NULL;
+    for (int i = 0; i < AUDIO_PROMPT_CACHE_ENTRIES; i++) {
+        Audio_Prompt_Entry_t *entry = &cache[i];
+        if (!entry->hash || entry->pinned || entry->sounding_until_us > now) {
+            continue;
+        }
+        if (!victim || entry->last_used < victim->last_used) {
+            victim = entry;
+        }
+    }
+    return victim;
+}
+
+/* Takes samples over, freeing them if there is no room */
+static Audio_Prompt_Entry_t *Audio_Prompt_Insert(const char *text, uint32_t hash, int16_t *samples,
+                                                 size_t frames, bool pinned)
+{
+    size_t bytes = frames * sizeof(int16_t);
+    Audio_Prompt_Entry_t *slot = NULL;
+    while (true) {
+        slot = NULL;
+        for (int i = 0; i < AUDIO_PROMPT_CACHE_ENTRIES && !slot; i++) {
+            slot = cache[i].hash ? NULL : &cache[i];
+        }
+        if (slot && cache_bytes + bytes <= AUDIO_PROMPT_CACHE_BYTES) {
+            break;
+        }
+        Audio_Prompt_Entry_t *victim = Audio_Prompt_Victim();
+        if (!victim) {
+            ESP_LOGW(TAG, "Cache full of prompts still sounding, \"%s\" dropped", text);
+            free(samples);
+            return NULL;
+        }
+        Audio_Prompt_Free(victim);
+    }
+    *slot = (Audio_Prompt_Entry_t){
+        .hash = hash,
+        .clip = { .samples = samples, .frames = frames, .channels = 1 },
+        .last_used = ++use_counter,
+        .pinned = pinned,
+    };
+    strlcpy(slot->text, text, sizeof(slot->text));
+    cache_bytes += bytes;
+    return slot;
+}
+
+/* From the cache, else the flash copy, else synthesised (and saved) */
+static Audio_Prompt_Entry_t *Audio_Prompt_Get(const char *text, bool fragment)
+{
+    uint32_t hash = Audio_Prompt_Hash(text);
+    Audio_Prompt_Entry_t *entry = Audio_Prompt_Find(text, hash);
+    if (entry) {
+        return entry;
+    }
+    size_t frames = 0;
+    int16_t *pcm = Audio_Prompt_Load(text, hash, &frames);
+    if (!pcm) {
+        pcm = Audio_Prompt_Synthesize(text, &frames);
+        if (!pcm) {
+            return NULL;
+        }
+        Audio_Prompt_Save(text, hash, pcm, frames);
+    }
+    const int16_t *speech = pcm;
+    if (fragment) {
+        speech = Audio_Prompt_Trim(pcm, &frames);
+    }
+    size_t out_frames = 0;
+    int16_t *out = frames ? Audio_Prompt_Resample(speech, frames, &out_frames) : NULL;
+    free(pcm);
+    if (!out) {
+        ESP_LOGE(TAG, "No memory for \"%s\"", text);
+        return NULL;
+    }
+    return Audio_Prompt_Insert(text, hash, out, out_frames, fragment);
+}
+
+/************************************************************************************************
+ *  Numbers
+ ************************************************************************************************/
+// Mandarin reading of 0 to 9999: 1050 is 一千零五十, 15 is 十五
+static size_t Audio_Prompt_Number_Fragments(int number, uint8_t *out)
+{
+    static const uint8_t units[] = { FRAGMENT_THOUSAND, FRAGMENT_HUNDRED, FRAGMENT_TEN };
+    static const int places[] = { 1000, 100, 10, 1 };
+    if (number == 0) {
+        out[0] = 0;
+        return 1;
+    }
+    size_t count = 0;
+    bool started = false, gap = false;
+    for (int i = 0; i < 4; i++) {
+        int digit = number / places[i] % 10;
+        if (digit == 0) {
+            gap = started;
+            continue;
+        }
+        if (gap) {
+            out[count++] = 0;       // One 零 for any run of zeros inside the number
+            gap = false;
+        }
+        if (!(i == 2 && digit == 1 && !started)) {
+            out[count++] = digit;
+        }
+        if (i < 3) {
+            out[count++] = units[i];
+        }
+        started = true;
+    }
+    return count;
+}
+
+static Audio_Prompt_Entry_t *Audio_Prompt_Get_Number(const char *text, int number)
+{
+    char key[AUDIO_PROMPT_TEXT_LEN + 8];
+    snprintf(key, sizeof(key), "%s#%d", text, number);
+    uint32_t hash = Audio_Prompt_Hash(key);
+    Audio_Prompt_Entry_t *entry = Audio_Prompt_Find(key, hash);
+    if (entry) {
+        return entry;
+    }
+
+    uint8_t parts[AUDIO_PROMPT_MAX_FRAGMENTS];
+    size_t part_count = Audio_Prompt_Number_Fragments(number, parts);
+    const Audio_Prompt_Entry_t *phrase = text[0] ? Audio_Prompt_Get(text, false) : NULL;
+    if (text[0] && !phrase) {
+        return NULL;
+    }
+    const size_t gap = phrase ? (size_t)AUDIO_OUTPUT_RATE * AUDIO_PROMPT_GAP_MS / 1000 : 0;
+    size_t frames = (phrase ? phrase->clip.frames : 0) + gap;
+    for (size_t i = 0; i < part_count; i++) {
+        if (!fragments[parts[i]]) {
+            ESP_LOGW(TAG, "No fragment %s, %d not said", Audio_Prompt_Fragments[parts[i]], number);
+            return NULL;
+        }
+        frames += fragments[parts[i]]->clip.frames;
+    }
+    int16_t *samples = heap_caps_malloc(frames * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+    if (!samples) {
+        ESP_LOGE(TAG, "No memory for \"%s\"", key);
+        return NULL;
+    }
+    // Joined before the insert, which may evict the phrase
+    int16_t *pos = samples;
+    if (phrase) {
+        memcpy(pos, phrase->clip.samples, phrase->clip.frames * sizeof(int16_t));
+        pos += phrase->clip.frames;
+        memset(pos, 0, gap * sizeof(int16_t));
+        pos += gap;
+    }
+    for (size_t i = 0; i < part_count; i++) {
+        const audio_player_clip_t *clip = &fragments[parts[i]]->clip;
+        memcpy(pos, clip->samples, clip->frames * sizeof(int16_t));
+        pos += clip->frames;
+    }
+    return Audio_Prompt_Insert(key, hash, samples, frames, false);
+}
+
+/************************************************************************************************
+ *  Task
+ ************************************************************************************************/
+static void Audio_Prompt_Play(Audio_Prompt_Entry_t *entry)
+{
+    // Ducks the music: a spoken prompt over it at full level is hard to follow
+    esp_err_t ret = Audio_Play_Clip(&entry->clip, AUDIO_PROMPT_GAIN, true);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "\"%s\" not played: %s", entry->text, esp_err_to_name(ret));
+        return;
+    }
+    int64_t length_us = (int64_t)entry->clip.frames * 1000000 / AUDIO_OUTPUT_RATE;
+    entry->sounding_until_us = esp_timer_get_time() + length_us + AUDIO_PROMPT_SOUNDING_SLACK_MS * 1000;
+}
+
+static void Audio_Prompt_Task(void *arg)
+{
+    mkdir(AUDIO_PROMPT_DIR, 0775);
+    for (int i = 0; i < FRAGMENT_COUNT; i++) {
+        fragments[i] = Audio_Prompt_Get(Audio_Prompt_Fragments[i], true);
+    }
+    ESP_LOGI(TAG, "Ready, %u KB cached", (unsigned)(cache_bytes / 1024));
+
+    Audio_Prompt_Request_t request;
+    while (true) {
+        if (xQueueReceive(request_queue, &request, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        Audio_Prompt_Entry_t *entry = (request.number == AUDIO_PROMPT_NO_NUMBER) ?
+                                      Audio_Prompt_Get(request.text, false) :
+                                      Audio_Prompt_Get_Number(request.text, request.number);
+        if (entry && request.play) {
+            Audio_Prompt_Play(entry);
+        }
+    }
+}
+
+static bool Audio_Prompt_Voice_Init(void)
+{
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                                AUDIO_PROMPT_VOICE_PARTITION);
+    if (!partition) {
+        ESP_LOGW(TAG, "No %s partition: only prompts already on flash are spoken", AUDIO_PROMPT_VOICE_PARTITION);
+        return false;
+    }
+    const void *data = NULL;
+    esp_partition_mmap_handle_t mmap;
+    esp_err_t ret = esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &data, &mmap);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot map the voice: %s", esp_err_to_name(ret));
+        return false;
+    }
+    esp_tts_voice_t *voice = esp_tts_voice_set_init(&esp_tts_voice_template, (void *)data);
+    tts = voice ? esp_tts_create(voice) : NULL;
+    if (!tts) {
+        ESP_LOGE(TAG, "Voice data in %s not usable", AUDIO_PROMPT_VOICE_PARTITION);
+        if (voice) {
+            esp_tts_voice_set_free(voice);
+        }
+        esp_partition_munmap(mmap);
+        return false;
+    }
+    return true;
+}
+
+void Audio_Prompt_Init(void)
+{
+    if (request_queue) {
+        return;
+    }
+    Audio_Prompt_Voice_Init();
+    request_queue = xQueueCreate(AUDIO_PROMPT_QUEUE_LEN, sizeof(Audio_Prompt_Request_t));
+    if (!request_queue) {
+        ESP_LOGE(TAG, "Failed to create the request queue");
+        return;
+    }
+    if (!mem_task_create(Audio_Prompt_Task, "Audio prompt", AUDIO_PROMPT_STACK_SIZE, NULL,
+                         AUDIO_PROMPT_PRIORITY, NULL, AUDIO_PROMPT_CORE, MEM_TASK_STACK_INTERNAL)) {
+        ESP_LOGE(TAG, "Failed to start the prompt task");
+        vQueueDelete(request_queue);
+        request_queue = NULL;
+    }
+}
+
+static bool Audio_Prompt_Post(const char *text, int number, bool play)
+{
+    if (!request_queue || !text || strlen(text) >= AUDIO_PROMPT_TEXT_LEN) {
+        return false;
+    }
+    Audio_Prompt_Request_t request = { .number = number, .play = play };
+    strlcpy(request.text, text, sizeof(request.text));
+    if (xQueueSend(request_queue, &request, 0) != pdTRUE) {
+        ESP_LOGD(TAG, "Queue full, \"%s\" not said", text);
+        return false;
+    }
+    return true;
+}
+
+bool Audio_Prompt_Say(const char *text)
+{
+    return Audio_Prompt_Post(text, AUDIO_PROMPT_NO_NUMBER, true);
+}
+
+bool Audio_Prompt_Say_Number(const char *text, int number)
+{
+    if (number < 0 || number > 9999) {
+        return false;
+    }
+    return Audio_Prompt_Post(text, number, true);
+}
+
+bool Audio_Prompt_Prepare(const char *text)
+{
+    return Audio_Prompt_Post(text, AUDIO_PROMPT_NO_NUMBER, false);
+}
+#else
+void Audio_Prompt_Init(void)
+{
+}
+
+bool Audio_Prompt_Say(const char *text)
+{
+    (void)text;
+    return false;
+}
+
+bool Audio_Prompt_Say_Number(const char *text, int number)
+{
+    (void)text;
+    (void)number;
+    return false;
+}
+
+bool Audio_Prompt_Prepare(const char *text)
+{
+    (void)text;
+    return false;
+}
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "task_plan.h"
+
+/*
+ * Spoken prompts (CONFIG_AUDIO_PROMPT): short phrases such as a volume
+ * readout, synthesised with esp-tts and mixed over the music like the UI
+ * sound effects (audio_player_play_clip(), ducking it).
+ *
+ * A phrase is synthesised once. Its 16 kHz PCM is written to the flash FAT
+ * under AUDIO_PROMPT_DIR, named by a hash of the text, and kept in a PSRAM
+ * LRU resampled to the output rate, so a phrase heard before plays at the
+ * mixer's latency and one heard in an earlier boot costs a file read. A
+ * number after a phrase is joined from pinned fragments (the digits and
+ * the units), never synthesised; the joined prompt is cached like any
+ * other, but not written to flash.
+ *
+ * The voice set is Mandarin (the only one esp-tts has): text is Chinese
+ * characters and digits. Its data is mapped from a data partition named
+ * AUDIO_PROMPT_VOICE_PARTITION; without one, only prompts already on
+ * flash are spoken.
+ *
+ * Synthesis runs on a task below the audio and speech tasks; Say may be
+ * called from any task and never waits.
+ */
+
+#define AUDIO_PROMPT_RATE               16000       // esp-tts output
+#define AUDIO_PROMPT_TEXT_LEN           48          // Bytes of UTF-8, at most three bytes a character
+#define AUDIO_PROMPT_CACHE_ENTRIES      32
+#define AUDIO_PROMPT_CACHE_BYTES        (CONFIG_AUDIO_PROMPT_CACHE_KB * 1024)
+#define AUDIO_PROMPT_QUEUE_LEN          4
+#define AUDIO_PROMPT_GAIN               0.8f
+#define AUDIO_PROMPT_SPEED              3           // esp-tts speed, 0 (slowest) to 5
+#define AUDIO_PROMPT_MAX_SECONDS        6           // Longer synthesis is cut off
+#define AUDIO_PROMPT_TRIM_LEVEL         300         // Fragments lose their silence down to this
+#define AUDIO_PROMPT_GAP_MS             60          // Between a phrase and its number
+#define AUDIO_PROMPT_SOUNDING_SLACK_MS  500         // A clip is kept this long after it should have ended
+#define AUDIO_PROMPT_MAGIC              0x4D545250  // "PRTM"
+#define AUDIO_PROMPT_DIR                "/flash/prompts"
+#define AUDIO_PROMPT_VOICE_PARTITION    "voice_data"
+#define AUDIO_PROMPT_PRIORITY           TASK_PLAN_PROMPT_PRIORITY
+#define AUDIO_PROMPT_CORE               TASK_PLAN_PROMPT_CORE
+#define AUDIO_PROMPT_STACK_SIZE         (6 * 1024)  // Internal: it writes the flash FAT
+
+// The task and voice; after Audio_Init(), which sets up the mixer
+void Audio_Prompt_Init(void);
+
+// false if disabled, not initialised, the text too long or the queue full
+bool Audio_Prompt_Say(const char *text);
+// text, then number (0 to 9999) read out in Mandarin from the fragments
+bool Audio_Prompt_Say_Number(const char *text, int number);
+
+// Synthesise text into the cache now, so its first use is instant too
+bool Audio_Prompt_Prepare(const char *text);
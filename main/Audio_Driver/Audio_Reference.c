@@ -0,0 +1,124 @@
+#include "Audio_Reference.h"
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "Audio Reference";
+
+#define REFERENCE_MASK          (AUDIO_REFERENCE_RING - 1)
+#define REFERENCE_PHASE_ONE     (1u << 16)
+
+_Static_assert((AUDIO_REFERENCE_RING & REFERENCE_MASK) == 0, "ring must be a power of two");
+
+static int16_t *ring;
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t head;               // Samples written so far
+static int64_t head_play_us;        // When sample head - 1 leaves the DAC
+
+// Write path only
+static uint32_t out_rate = 44100;
+static uint8_t out_channels = 2;
+static int64_t queue_us;            // Depth of the TX DMA queue
+static uint32_t phase_step;         // Q16 output samples per input frame
+static uint32_t phase;
+static int32_t sum;
+static uint32_t summed;
+
+static void Reference_Update_Step(void)
+{
+    phase_step = (uint32_t)(((uint64_t)AUDIO_REFERENCE_RATE << 16) / out_rate);
+    phase = 0;
+    sum = 0;
+    summed = 0;
+}
+
+void Audio_Reference_Init(void)
+{
+    if (ring) {
+        return;
+    }
+    int16_t *buffer = heap_caps_calloc(AUDIO_REFERENCE_RING, sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!buffer) {
+        ESP_LOGE(TAG, "No memory for the echo reference");
+        return;
+    }
+    Reference_Update_Step();
+    // The writer may be running already: publish the ring last
+    __atomic_store_n(&ring, buffer, __ATOMIC_RELEASE);
+}
+
+void Audio_Reference_Set_Format(uint32_t sample_rate, uint8_t channels, uint32_t dma_frames)
+{
+    if (sample_rate == 0 || channels == 0) {
+        return;
+    }
+    out_rate = sample_rate;
+    out_channels = channels;
+    queue_us = (int64_t)dma_frames * 1000000 / sample_rate;
+    Reference_Update_Step();
+}
+
+void Audio_Reference_Write(const int16_t *samples, size_t count)
+{
+    int16_t *buffer = __atomic_load_n(&ring, __ATOMIC_ACQUIRE);
+    if (!buffer || count == 0) {
+        return;
+    }
+
+    // Box filter: each output is the mean of the input frames in its period
+    uint32_t pos = head;
+    for (size_t i = 0; i + out_channels <= count; i += out_channels) {
+        int32_t mono = samples[i];
+        if (out_channels > 1) {
+            mono = (mono + samples[i + 1]) >> 1;
+        }
+        sum += mono;
+        summed++;
+        phase += phase_step;
+        if (phase < REFERENCE_PHASE_ONE) {
+            continue;
+        }
+        // Below AUDIO_REFERENCE_RATE one input frame covers several outputs
+        int16_t mean = (int16_t)(sum / (int32_t)summed);
+        do {
+            phase -= REFERENCE_PHASE_ONE;
+            buffer[pos++ & REFERENCE_MASK] = mean;
+        } while (phase >= REFERENCE_PHASE_ONE);
+        sum = 0;
+        summed = 0;
+    }
+
+    // The write blocked until the DMA queue had room, so the chunk sits at its end
+    int64_t play_us = esp_timer_get_time() + queue_us;
+    taskENTER_CRITICAL(&ring_lock);
+    head = pos;
+    head_play_us = play_us;
+    taskEXIT_CRITICAL(&ring_lock);
+}
+
+void Audio_Reference_Read(int16_t *out, size_t count, int64_t captured_us)
+{
+    int16_t *buffer = __atomic_load_n(&ring, __ATOMIC_ACQUIRE);
+    if (!buffer) {
+        memset(out, 0, count * sizeof(int16_t));
+        return;
+    }
+
+    taskENTER_CRITICAL(&ring_lock);
+    uint32_t newest = head;
+    int64_t newest_play_us = head_play_us;
+    taskEXIT_CRITICAL(&ring_lock);
+
+    // How far the sample playing at captured_us + lead is behind the newest;
+    // negative once playback has stopped
+    int64_t behind = (newest_play_us - captured_us - AUDIO_REFERENCE_LEAD_US) * AUDIO_REFERENCE_RATE / 1000000;
+    for (size_t n = 0; n < count; n++) {
+        int64_t age = behind + (int64_t)(count - n);    // 1: the newest sample
+        // Keep clear of the half the writer may be overwriting
+        out[n] = (age >= 1 && age <= AUDIO_REFERENCE_RING / 2)
+                 ? buffer[(newest - (uint32_t)age) & REFERENCE_MASK] : 0;
+    }
+}
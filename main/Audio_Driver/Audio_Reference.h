@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Echo reference for the speech front end (AFE AEC).
+ *
+ * The I2S write path hands every post-gain, post-mix chunk to
+ * Audio_Reference_Write() once it has been queued for the DAC. The chunk is
+ * folded to mono, box filtered down to AUDIO_REFERENCE_RATE and kept in a
+ * ring together with the time its newest sample will leave the TX DMA
+ * queue. The microphone task asks for the reference behind each block it
+ * reads with the block's capture time and gets the samples that were
+ * playing then, AUDIO_REFERENCE_LEAD_US early (the AEC filter only models
+ * echoes that come after the reference). Whatever was not played, because
+ * nothing was playing or it is too old, reads as silence.
+ *
+ * Nothing is recorded until Audio_Reference_Init() has been called.
+ */
+
+#define AUDIO_REFERENCE_RATE        16000       // The AFE's rate
+#define AUDIO_REFERENCE_RING        4096        // Samples, power of two: 256 ms
+#define AUDIO_REFERENCE_LEAD_US     4000
+
+void Audio_Reference_Init(void);
+
+// I2S write path only
+void Audio_Reference_Set_Format(uint32_t sample_rate, uint8_t channels, uint32_t dma_frames);
+void Audio_Reference_Write(const int16_t *samples, size_t count);   // Interleaved, just queued for the DAC
+
+// count samples at AUDIO_REFERENCE_RATE, the last one aligned with captured_us (esp_timer time)
+void Audio_Reference_Read(int16_t *out, size_t count, int64_t captured_us);
@@ -0,0 +1,481 @@
+#include "Audio_Stream.h"
+#include <string.h>
+#include <stdlib.h>
+#include <strings.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "AUDIO STREAM";
+
+typedef struct {
+    char *url;
+    audio_stream_title_cb_t on_title;
+
+    // Ring of stream bytes [tail, head); offsets are absolute positions in the audio
+    uint8_t *ring;
+    int64_t tail;                   // Oldest byte still held
+    int64_t read_pos;               // Next byte for the player
+    int64_t head;                   // Next byte from the network
+    int64_t seek_to;                // Pending reconnect offset, -1 for none
+    int64_t total;                  // Audio size, -1 if unknown
+    bool accept_ranges;
+    bool buffering;                 // Reads wait for Stream_Prebuffer_Bytes()
+    bool eof;
+    bool failed;
+    bool closing;
+
+    // ICY metadata, per connection (only requested from offset 0)
+    int icy_metaint;
+    int icy_until_meta;
+    int icy_meta_left;              // -1 while waiting for the length byte
+    int icy_meta_len;
+    char icy_meta[16 * 255 + 1];
+
+    // Prebuffer depth
+    uint32_t byte_rate;             // Of playback, bytes/s
+    bool rate_measured;             // byte_rate is from reads, not icy-br or the default
+    uint32_t stall_ms;              // Decaying peak of reads running late
+    uint32_t underruns;
+    int64_t rate_since_us;          // Start of the read rate window, 0 for none
+    int64_t rate_from;              // read_pos at its start
+
+    SemaphoreHandle_t lock;
+    SemaphoreHandle_t data_ready;   // Given when head, eof or failed change
+    SemaphoreHandle_t space_ready;  // Given when read_pos moves or a seek is requested
+    SemaphoreHandle_t task_done;
+} audio_stream_t;
+
+static void Stream_Signal(SemaphoreHandle_t sem)
+{
+    xSemaphoreGive(sem);            // Binary: repeated gives collapse, waiters re-check
+}
+
+static esp_err_t Stream_Http_Event(esp_http_client_event_t *evt)
+{
+    audio_stream_t *s = (audio_stream_t *)evt->user_data;
+    if (evt->event_id != HTTP_EVENT_ON_HEADER) {
+        return ESP_OK;
+    }
+    if (strcasecmp(evt->header_key, "icy-metaint") == 0) {
+        s->icy_metaint = atoi(evt->header_value);
+    } else if (strcasecmp(evt->header_key, "Accept-Ranges") == 0) {
+        s->accept_ranges = strcasecmp(evt->header_value, "bytes") == 0;
+    } else if (strcasecmp(evt->header_key, "Content-Range") == 0) {
+        // "bytes first-last/total"
+        const char *slash = strchr(evt->header_value, '/');
+        if (slash && slash[1] != '*') {
+            s->total = strtoll(slash + 1, NULL, 10);
+        }
+        s->accept_ranges = true;
+    } else if (strcasecmp(evt->header_key, "icy-br") == 0) {
+        int kbps = atoi(evt->header_value);
+        if (kbps > 0 && !s->rate_measured) {
+            s->byte_rate = kbps * 1000 / 8;
+        }
+    }
+    return ESP_OK;
+}
+
+// Bytes to hold before reads go ahead; under lock
+static int64_t Stream_Prebuffer_Bytes(const audio_stream_t *s)
+{
+    uint32_t underruns = s->underruns < AUDIO_STREAM_UNDERRUN_MAX ? s->underruns : AUDIO_STREAM_UNDERRUN_MAX;
+    uint32_t ms = AUDIO_STREAM_PREBUFFER_MS + 2 * s->stall_ms + underruns * AUDIO_STREAM_UNDERRUN_MS;
+    int64_t bytes = (int64_t)s->byte_rate * ms / 1000;
+    if (bytes < AUDIO_STREAM_PREBUFFER_MIN) {
+        bytes = AUDIO_STREAM_PREBUFFER_MIN;
+    }
+    return bytes < AUDIO_STREAM_PREBUFFER_MAX ? bytes : AUDIO_STREAM_PREBUFFER_MAX;
+}
+
+// A network read of len bytes took us microseconds; whatever it ran over
+// the time those bytes play for counts as a stall
+static void Stream_Note_Arrival(audio_stream_t *s, int len, int64_t us)
+{
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    int64_t late_ms = us / 1000 - (int64_t)len * 1000 / s->byte_rate;
+    if (late_ms > (int64_t)s->stall_ms) {
+        s->stall_ms = late_ms > 60000 ? 60000 : (uint32_t)late_ms;
+    } else {
+        s->stall_ms -= (s->stall_ms + 63) / 64;     // Forgets a stall over a few hundred reads
+    }
+    xSemaphoreGive(s->lock);
+}
+
+// The player reads at playback speed while not starved, so its reads give
+// the real byte rate (including VBR); under lock
+static void Stream_Note_Read(audio_stream_t *s)
+{
+    int64_t now = esp_timer_get_time();
+    if (s->rate_since_us == 0) {
+        s->rate_since_us = now;
+        s->rate_from = s->read_pos;
+        return;
+    }
+    int64_t elapsed = now - s->rate_since_us;
+    if (elapsed < AUDIO_STREAM_RATE_WINDOW_MS * 1000LL) {
+        return;
+    }
+    int64_t rate = (s->read_pos - s->rate_from) * 1000000 / elapsed;
+    if (rate > 0) {
+        s->byte_rate = s->rate_measured ? (uint32_t)((s->byte_rate * 3LL + rate) / 4) : (uint32_t)rate;
+        s->rate_measured = true;
+    }
+    s->rate_since_us = now;
+    s->rate_from = s->read_pos;
+}
+
+static void Stream_Parse_Title(audio_stream_t *s)
+{
+    s->icy_meta[s->icy_meta_len] = '\0';
+    const char *start = strstr(s->icy_meta, "StreamTitle='");
+    if (!start || !s->on_title) {
+        return;
+    }
+    start += strlen("StreamTitle='");
+    const char *end = strstr(start, "';");
+    size_t len = end ? (size_t)(end - start) : strlen(start);
+    char title[AUDIO_STREAM_TITLE_MAX];
+    if (len >= sizeof(title)) {
+        len = sizeof(title) - 1;
+    }
+    memcpy(title, start, len);
+    title[len] = '\0';
+    ESP_LOGI(TAG, "Title: %s", title);
+    s->on_title(title);
+}
+
+// Copies audio bytes into the ring, waiting for space. False if the
+// connection should be dropped (closing or a seek is pending).
+static bool Stream_Push(audio_stream_t *s, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        xSemaphoreTake(s->lock, portMAX_DELAY);
+        if (s->closing || s->seek_to >= 0) {
+            xSemaphoreGive(s->lock);
+            return false;
+        }
+        if (s->head - s->tail == AUDIO_STREAM_RING_SIZE && s->read_pos > s->tail) {
+            s->tail = s->read_pos;              // Give up the history once the ring is full
+        }
+        size_t space = AUDIO_STREAM_RING_SIZE - (size_t)(s->head - s->tail);
+        if (space == 0) {
+            xSemaphoreGive(s->lock);
+            xSemaphoreTake(s->space_ready, portMAX_DELAY);
+            continue;
+        }
+        size_t index = (size_t)(s->head % AUDIO_STREAM_RING_SIZE);
+        size_t n = len < space ? len : space;
+        if (n > AUDIO_STREAM_RING_SIZE - index) {
+            n = AUDIO_STREAM_RING_SIZE - index;
+        }
+        memcpy(s->ring + index, data, n);
+        s->head += n;
+        if (s->buffering && (s->head - s->read_pos >= Stream_Prebuffer_Bytes(s))) {
+            s->buffering = false;
+        }
+        xSemaphoreGive(s->lock);
+        Stream_Signal(s->data_ready);
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Splits ICY metadata blocks out of a received chunk
+static bool Stream_Demux(audio_stream_t *s, const uint8_t *data, size_t len)
+{
+    if (s->icy_metaint <= 0) {
+        return Stream_Push(s, data, len);
+    }
+    while (len > 0) {
+        if (s->icy_until_meta > 0) {
+            size_t n = len < (size_t)s->icy_until_meta ? len : (size_t)s->icy_until_meta;
+            if (!Stream_Push(s, data, n)) {
+                return false;
+            }
+            s->icy_until_meta -= n;
+            data += n;
+            len -= n;
+        } else if (s->icy_meta_left < 0) {
+            s->icy_meta_left = data[0] * 16;
+            s->icy_meta_len = 0;
+            data++;
+            len--;
+        } else {
+            size_t n = len < (size_t)s->icy_meta_left ? len : (size_t)s->icy_meta_left;
+            memcpy(s->icy_meta + s->icy_meta_len, data, n);
+            s->icy_meta_len += n;
+            s->icy_meta_left -= n;
+            data += n;
+            len -= n;
+        }
+        if (s->icy_until_meta == 0 && s->icy_meta_left == 0) {
+            if (s->icy_meta_len > 0) {
+                Stream_Parse_Title(s);
+            }
+            s->icy_until_meta = s->icy_metaint;
+            s->icy_meta_left = -1;
+        }
+    }
+    return true;
+}
+
+// One connection from offset until the end, an error or a seek
+static bool Stream_Fetch(audio_stream_t *s, int64_t offset, uint8_t *chunk)
+{
+    esp_http_client_config_t config = {
+        .url = s->url,
+        .event_handler = Stream_Http_Event,
+        .user_data = s,
+        .timeout_ms = AUDIO_STREAM_TIMEOUT_MS,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .buffer_size = AUDIO_STREAM_CHUNK,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (!client) {
+        return false;
+    }
+    s->icy_metaint = 0;
+    if (offset > 0) {
+        char range[40];
+        snprintf(range, sizeof(range), "bytes=%lld-", (long long)offset);
+        esp_http_client_set_header(client, "Range", range);
+    } else {
+        esp_http_client_set_header(client, "Icy-MetaData", "1");
+    }
+
+    bool ok = false;
+    if (esp_http_client_open(client, 0) == ESP_OK) {
+        int64_t length = esp_http_client_fetch_headers(client);
+        int status = esp_http_client_get_status_code(client);
+        if (status == 200 || status == 206) {
+            if (status == 200 && length > 0) {
+                s->total = length;
+            }
+            if (offset > 0 && status != 206) {
+                ESP_LOGW(TAG, "Server ignored the range request");
+            } else {
+                s->icy_until_meta = s->icy_metaint;
+                s->icy_meta_left = -1;
+                ESP_LOGI(TAG, "Connected at %lld (size %lld%s)", (long long)offset, (long long)s->total,
+                         s->icy_metaint > 0 ? ", ICY" : "");
+                ok = true;
+                int n;
+                int64_t start = esp_timer_get_time();
+                while ((n = esp_http_client_read(client, (char *)chunk, AUDIO_STREAM_CHUNK)) > 0) {
+                    Stream_Note_Arrival(s, n, esp_timer_get_time() - start);
+                    if (!Stream_Demux(s, chunk, n)) {
+                        break;
+                    }
+                    start = esp_timer_get_time();   // Not counting the wait for ring space
+                }
+                if (n < 0) {
+                    ESP_LOGW(TAG, "Read failed (%d)", n);
+                    ok = false;
+                }
+            }
+        } else {
+            ESP_LOGE(TAG, "HTTP status %d", status);
+        }
+    } else {
+        ESP_LOGE(TAG, "Failed to connect to %s", s->url);
+    }
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    return ok;
+}
+
+static void Stream_Task(void *parameter)
+{
+    audio_stream_t *s = (audio_stream_t *)parameter;
+    uint8_t *chunk = malloc(AUDIO_STREAM_CHUNK);
+    int64_t offset = 0;
+
+    while (chunk) {
+        bool ok = Stream_Fetch(s, offset, chunk);
+
+        xSemaphoreTake(s->lock, portMAX_DELAY);
+        bool closing = s->closing;
+        int64_t seek_to = s->seek_to;
+        s->seek_to = -1;
+        if (!closing && seek_to < 0) {
+            // Ran to the end (or failed): the reader drains what is left
+            s->eof = ok;
+            s->failed = !ok;
+        }
+        xSemaphoreGive(s->lock);
+        Stream_Signal(s->data_ready);
+
+        if (closing || seek_to < 0) {
+            if (!closing) {
+                // Wait for close(), or a seek that restarts the download
+                while (true) {
+                    xSemaphoreTake(s->space_ready, portMAX_DELAY);
+                    xSemaphoreTake(s->lock, portMAX_DELAY);
+                    closing = s->closing;
+                    seek_to = s->seek_to;
+                    s->seek_to = -1;
+                    if (seek_to >= 0) {
+                        s->eof = false;
+                        s->failed = false;
+                    }
+                    xSemaphoreGive(s->lock);
+                    if (closing || seek_to >= 0) {
+                        break;
+                    }
+                }
+            }
+            if (closing) {
+                break;
+            }
+        }
+        offset = seek_to;
+    }
+
+    free(chunk);
+    xSemaphoreGive(s->task_done);
+    vTaskDelete(NULL);
+}
+
+static int Stream_Read(void *ctx, void *buf, size_t len)
+{
+    audio_stream_t *s = (audio_stream_t *)ctx;
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    while (true) {
+        int64_t available = s->head - s->read_pos;
+        if (s->eof || s->failed) {
+            if (available == 0) {
+                xSemaphoreGive(s->lock);
+                return s->failed ? -1 : 0;
+            }
+            break;
+        }
+        if (available == 0) {
+            if (!s->buffering) {
+                s->underruns++;
+                ESP_LOGW(TAG, "Underrun, rebuffering %lld bytes (%lu B/s, stalls up to %lu ms)",
+                         (long long)Stream_Prebuffer_Bytes(s), (unsigned long)s->byte_rate, (unsigned long)s->stall_ms);
+            }
+            s->buffering = true;
+            s->rate_since_us = 0;           // Waiting for the network is not the playback rate
+        }
+        if (!s->buffering) {
+            break;
+        }
+        xSemaphoreGive(s->lock);
+        xSemaphoreTake(s->data_ready, portMAX_DELAY);
+        xSemaphoreTake(s->lock, portMAX_DELAY);
+    }
+
+    size_t n = (size_t)(s->head - s->read_pos);
+    if (n > len) {
+        n = len;
+    }
+    size_t index = (size_t)(s->read_pos % AUDIO_STREAM_RING_SIZE);
+    size_t first = n < AUDIO_STREAM_RING_SIZE - index ? n : AUDIO_STREAM_RING_SIZE - index;
+    memcpy(buf, s->ring + index, first);
+    memcpy((uint8_t *)buf + first, s->ring, n - first);
+    s->read_pos += n;
+    Stream_Note_Read(s);
+    xSemaphoreGive(s->lock);
+    Stream_Signal(s->space_ready);
+    return (int)n;
+}
+
+static int Stream_Seek(void *ctx, int64_t offset)
+{
+    audio_stream_t *s = (audio_stream_t *)ctx;
+    int ret = 0;
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    s->rate_since_us = 0;
+    if (offset >= s->tail && offset <= s->head) {
+        s->read_pos = offset;               // Still in the ring
+    } else if (s->accept_ranges && s->icy_metaint <= 0 && (s->total < 0 || offset < s->total)) {
+        s->tail = s->head = s->read_pos = offset;
+        s->seek_to = offset;
+        s->buffering = true;
+        s->rate_since_us = 0;
+    } else {
+        ret = -1;
+    }
+    xSemaphoreGive(s->lock);
+    Stream_Signal(s->space_ready);
+    return ret;
+}
+
+static int64_t Stream_Size(void *ctx)
+{
+    audio_stream_t *s = (audio_stream_t *)ctx;
+    return s->total;
+}
+
+static void Stream_Free(audio_stream_t *s)
+{
+    if (s->lock) vSemaphoreDelete(s->lock);
+    if (s->data_ready) vSemaphoreDelete(s->data_ready);
+    if (s->space_ready) vSemaphoreDelete(s->space_ready);
+    if (s->task_done) vSemaphoreDelete(s->task_done);
+    heap_caps_free(s->ring);
+    free(s->url);
+    free(s);
+}
+
+static void Stream_Close(void *ctx)
+{
+    audio_stream_t *s = (audio_stream_t *)ctx;
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    s->closing = true;
+    xSemaphoreGive(s->lock);
+    Stream_Signal(s->space_ready);
+    // The task notices at its next push or when the read times out
+    xSemaphoreTake(s->task_done, portMAX_DELAY);
+    Stream_Free(s);
+}
+
+esp_err_t Audio_Stream_Open(const char *url, audio_stream_title_cb_t on_title, audio_player_source_t *source)
+{
+    if (!url || !source) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    audio_stream_t *s = calloc(1, sizeof(audio_stream_t));
+    if (!s) {
+        return ESP_ERR_NO_MEM;
+    }
+    s->url = strdup(url);
+    s->on_title = on_title;
+    s->ring = heap_caps_malloc(AUDIO_STREAM_RING_SIZE, MALLOC_CAP_SPIRAM);
+    s->seek_to = -1;
+    s->total = -1;
+    s->buffering = true;
+    s->byte_rate = AUDIO_STREAM_DEFAULT_KBPS * 1000 / 8;
+    s->lock = xSemaphoreCreateMutex();
+    s->data_ready = xSemaphoreCreateBinary();
+    s->space_ready = xSemaphoreCreateBinary();
+    s->task_done = xSemaphoreCreateBinary();
+    if (!s->url || !s->ring || !s->lock || !s->data_ready || !s->space_ready || !s->task_done) {
+        ESP_LOGE(TAG, "Failed to allocate the stream buffer");
+        Stream_Free(s);
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreatePinnedToCore(Stream_Task, "Audio Stream", AUDIO_STREAM_TASK_STACK, s, AUDIO_STREAM_TASK_PRIORITY,
+                                NULL, TASK_PLAN_NETWORK_CORE) != pdPASS) {
+        Stream_Free(s);
+        return ESP_ERR_NO_MEM;
+    }
+
+    *source = (audio_player_source_t) {
+        .read = Stream_Read,
+        .seek = Stream_Seek,
+        .size = Stream_Size,
+        .close = Stream_Close,
+        .ctx = s,
+    };
+    return ESP_OK;
+}
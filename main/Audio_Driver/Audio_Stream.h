@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "audio_player.h"
+#include "task_plan.h"
+
+/*
+ * HTTP(S) stream source for the audio player (internet radio, DLNA).
+ *
+ * A download task fills a ring buffer in PSRAM; the player reads from it
+ * through audio_player_source_t.
+ *   - Reads block until the prebuffer is in, both at start and after an
+ *     underrun, so network stalls do not stutter. Its depth is playback
+ *     time, not bytes: AUDIO_STREAM_PREBUFFER_MS plus twice the recent
+ *     worst network stall plus AUDIO_STREAM_UNDERRUN_MS per underrun so
+ *     far, at the stream's byte rate (icy-br, then measured from the
+ *     player's reads). A 32 kbit/s stream starts in about as many seconds
+ *     as a 320 kbit/s one, and a jittery link earns a deeper buffer.
+ *   - Bytes already read stay in the ring until the space is needed, so the
+ *     decoders' format probe (seek back to 0) costs nothing. Seeking further
+ *     reconnects with a Range request when the server accepts ranges.
+ *   - Shoutcast/Icecast (ICY) metadata is stripped from the audio and the
+ *     StreamTitle is passed to the title callback
+ */
+
+#define AUDIO_STREAM_RING_SIZE      (256 * 1024)    // PSRAM
+#define AUDIO_STREAM_PREBUFFER_MS   1500
+#define AUDIO_STREAM_PREBUFFER_MIN  (4 * 1024)
+#define AUDIO_STREAM_PREBUFFER_MAX  (128 * 1024)
+#define AUDIO_STREAM_UNDERRUN_MS    1000            // Added per underrun, up to AUDIO_STREAM_UNDERRUN_MAX
+#define AUDIO_STREAM_UNDERRUN_MAX   6
+#define AUDIO_STREAM_DEFAULT_KBPS   128             // Until the rate is known
+#define AUDIO_STREAM_RATE_WINDOW_MS 5000            // Reads averaged per rate measurement
+#define AUDIO_STREAM_CHUNK          2048            // Per esp_http_client_read
+#define AUDIO_STREAM_TIMEOUT_MS     5000
+#define AUDIO_STREAM_TASK_STACK     4096
+#define AUDIO_STREAM_TASK_PRIORITY  TASK_PLAN_AUDIO_STREAM_PRIORITY
+#define AUDIO_STREAM_TITLE_MAX      128
+
+// Called on the download task with each new StreamTitle
+typedef void (*audio_stream_title_cb_t)(const char *title);
+
+// Starts the download; on success *source is ready for audio_player_play_source()
+esp_err_t Audio_Stream_Open(const char *url, audio_stream_title_cb_t on_title, audio_player_source_t *source);
@@ -0,0 +1,96 @@
+#include "MP3_Benchmark.h"
+#include <stdlib.h>
+#include <limits.h>
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_private/esp_clk.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mp3dec.h"
+
+static const char *TAG = "MP3 BENCH";
+
+extern const uint8_t mp3_bench_start[] asm("_binary_gs_16b_1c_44100hz_mp3_start");
+extern const uint8_t mp3_bench_end[] asm("_binary_gs_16b_1c_44100hz_mp3_end");
+
+bool MP3_Benchmark_Run(MP3_Bench_Result_t *result)
+{
+    bool ok = false;
+    HMP3Decoder decoder = MP3InitDecoder();
+    short *pcm = malloc(MAX_NCHAN * MAX_NGRAN * MAX_NSAMP * sizeof(short));
+    if (!decoder || !pcm) {
+        ESP_LOGE(TAG, "Out of memory");
+        goto done;
+    }
+
+    MP3FrameInfo info = { 0 };
+    uint32_t cycles_min = UINT32_MAX, cycles_max = 0;
+    uint64_t cycles_total = 0;
+    uint32_t frames = 0;
+    for (int pass = 0; pass < MP3_BENCH_PASSES; pass++) {
+        unsigned char *read_ptr = (unsigned char *)mp3_bench_start;
+        int bytes_left = mp3_bench_end - mp3_bench_start;
+        while (bytes_left > 0) {
+            int offset = MP3FindSyncWord(read_ptr, bytes_left);
+            if (offset < 0) {
+                break;
+            }
+            read_ptr += offset;
+            bytes_left -= offset;
+
+            uint32_t start = esp_cpu_get_cycle_count();
+            int err = MP3Decode(decoder, &read_ptr, &bytes_left, pcm, 0);
+            uint32_t cycles = esp_cpu_get_cycle_count() - start;
+            if (err == ERR_MP3_INDATA_UNDERFLOW) {
+                break;
+            }
+            if (err != ERR_MP3_NONE) {
+                continue;       // Skips the bad header on the next sync search
+            }
+            MP3GetLastFrameInfo(decoder, &info);
+            cycles_total += cycles;
+            cycles_min = cycles < cycles_min ? cycles : cycles_min;
+            cycles_max = cycles > cycles_max ? cycles : cycles_max;
+            frames++;
+        }
+    }
+
+    if (frames == 0 || info.samprate == 0 || info.nChans == 0) {
+        ESP_LOGE(TAG, "No frames decoded");
+        goto done;
+    }
+    result->frames = frames;
+    result->sample_rate = info.samprate;
+    result->channels = info.nChans;
+    result->cycles_min = cycles_min;
+    result->cycles_avg = cycles_total / frames;
+    result->cycles_max = cycles_max;
+    // One frame plays for outputSamps / nChans / samprate seconds
+    double frame_s = (double)info.outputSamps / info.nChans / info.samprate;
+    result->core_load = result->cycles_avg / (esp_clk_cpu_freq() * frame_s) * 100.0;
+    ok = true;
+
+done:
+    free(pcm);
+    if (decoder) {
+        MP3FreeDecoder(decoder);
+    }
+    return ok;
+}
+
+static void MP3_Benchmark_Task(void *parameter)
+{
+    MP3_Bench_Result_t r;
+    if (MP3_Benchmark_Run(&r)) {
+        ESP_LOGI(TAG, "%u frames, %d Hz %d ch: cycles/frame min %u avg %u max %u, %.1f%% of a %d MHz core",
+                 (unsigned)r.frames, r.sample_rate, r.channels, (unsigned)r.cycles_min, (unsigned)r.cycles_avg,
+                 (unsigned)r.cycles_max, r.core_load, esp_clk_cpu_freq() / 1000000);
+    }
+    vTaskDelete(NULL);
+}
+
+void MP3_Benchmark_Start(void)
+{
+    xTaskCreatePinnedToCore(MP3_Benchmark_Task, "MP3 bench", MP3_BENCH_STACK_SIZE, NULL,
+                            MP3_BENCH_PRIORITY, NULL, MP3_BENCH_CORE);
+}
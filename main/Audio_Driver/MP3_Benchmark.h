@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Helix MP3 decode benchmark (CONFIG_MP3_RUN_BENCHMARK, and part of
+ * CONFIG_ESPCASTER_BENCH).
+ *
+ * Decodes the reference clip from the audio player's test folder, embedded
+ * in the image, MP3_BENCH_PASSES times on the audio core at the audio
+ * task's priority while the GUI keeps running. Logs CPU cycles per frame
+ * (min / average / max) and the share of one core real-time playback needs,
+ * to compare the LIBHELIX_MP3_IN_IRAM / LIBHELIX_MP3_OPTIMIZE_O2 options.
+ */
+
+#define MP3_BENCH_PASSES        5
+#define MP3_BENCH_CORE          1       // As the audio player task
+#define MP3_BENCH_PRIORITY      3
+#define MP3_BENCH_STACK_SIZE    4096
+
+typedef struct {
+    uint32_t frames;
+    int sample_rate;
+    int channels;
+    uint32_t cycles_min;
+    uint32_t cycles_avg;
+    uint32_t cycles_max;
+    float core_load;            // Percent of one core at the current clock
+} MP3_Bench_Result_t;
+
+void MP3_Benchmark_Start(void);
+bool MP3_Benchmark_Run(MP3_Bench_Result_t *result);    // On the calling task; false if nothing decoded
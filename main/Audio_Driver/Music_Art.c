@@ -0,0 +1,434 @@
+#include "Music_Art.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "spotify_album_art.h"
+
+static const char *TAG = "MUSIC ART";
+
+#define MUSIC_ART_USE_FOLDER        0x0001      // No art of its own: the folder's, if any
+#define MUSIC_ART_COLOR             ((LV_COLOR_DEPTH << 8) | LV_COLOR_16_SWAP)
+#define MUSIC_ART_MAX_JPEG          SPOTIFY_ALBUM_ART_MAX_JPEG
+
+typedef struct {
+    uint32_t magic;
+    uint16_t color;             // MUSIC_ART_COLOR it was saved in
+    uint16_t flags;
+    uint32_t source_bytes;      // With source_mtime, tells whether the source changed
+    uint32_t source_mtime;
+    uint16_t width;             // 0 if there are no pixels
+    uint16_t height;
+} Music_Art_Header_t;
+
+typedef struct {
+    char dir[MUSIC_ART_PATH_MAX];
+    char file[MUSIC_ART_PATH_MAX];
+} Music_Art_Job_t;
+
+typedef struct {
+    Music_Art_Job_t key;
+    lv_img_dsc_t *image;        // NULL: there is none
+    uint32_t last_used;
+} Music_Art_Entry_t;
+
+static const char *const Music_Art_Folder_Names[] = { "folder.jpg", "cover.jpg", "front.jpg" };
+
+static QueueHandle_t job_queue;                 // Length 1, overwritten: only the latest track
+static Music_Art_Entry_t *pending;              // From the task, until Music_Art_Poll()
+static Music_Art_Entry_t cache[MUSIC_ART_CACHE_SIZE];   // The GUI task's
+static Music_Art_Job_t requested;               // Asked for and not back yet
+static uint32_t use_counter;
+
+/************************************************************************************************
+ *  Cache files
+ ************************************************************************************************/
+static void *Music_Art_Alloc(size_t size)
+{
+    void *ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    return ptr ? ptr : malloc(size);
+}
+
+static lv_img_dsc_t *Music_Art_Image(uint16_t width, uint16_t height)
+{
+    size_t data_size = (size_t)width * height * sizeof(lv_color_t);
+    lv_img_dsc_t *image = Music_Art_Alloc(sizeof(lv_img_dsc_t) + data_size);
+    if (!image) {
+        ESP_LOGE(TAG, "Out of memory for %ux%u art", width, height);
+        return NULL;
+    }
+    memset(&image->header, 0, sizeof(image->header));
+    image->header.cf = LV_IMG_CF_TRUE_COLOR;
+    image->header.w = width;
+    image->header.h = height;
+    image->data_size = data_size;
+    image->data = (const uint8_t *)(image + 1);
+    return image;
+}
+
+/* Reads a cache that is still current for source; *image stays NULL if it has no pixels */
+static bool Music_Art_Load(const char *path, const struct stat *source, Music_Art_Header_t *header,
+                           lv_img_dsc_t **image)
+{
+    *image = NULL;
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return false;
+    }
+    bool ok = fread(header, 1, sizeof(*header), fp) == sizeof(*header) &&
+              header->magic == MUSIC_ART_MAGIC && header->color == MUSIC_ART_COLOR &&
+              header->source_bytes == (uint32_t)source->st_size &&
+              header->source_mtime == (uint32_t)source->st_mtime &&
+              header->width <= 2 * MUSIC_ART_SIZE && header->height <= 2 * MUSIC_ART_SIZE;
+    if (ok && header->width && header->height) {
+        *image = Music_Art_Image(header->width, header->height);
+        ok = *image && fread((void *)(*image)->data, 1, (*image)->data_size, fp) == (*image)->data_size;
+    }
+    fclose(fp);
+    if (!ok) {
+        free(*image);
+        *image = NULL;
+    }
+    return ok;
+}
+
+static void Music_Art_Save(const char *path, const struct stat *source, uint16_t flags, const lv_img_dsc_t *image)
+{
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        ESP_LOGW(TAG, "Cannot write %s", path);
+        return;
+    }
+    Music_Art_Header_t header = {
+        .magic = MUSIC_ART_MAGIC,
+        .color = MUSIC_ART_COLOR,
+        .flags = flags,
+        .source_bytes = (uint32_t)source->st_size,
+        .source_mtime = (uint32_t)source->st_mtime,
+        .width = image ? image->header.w : 0,
+        .height = image ? image->header.h : 0,
+    };
+    bool ok = fwrite(&header, 1, sizeof(header), fp) == sizeof(header) &&
+              (!image || fwrite(image->data, 1, image->data_size, fp) == image->data_size);
+    if (fclose(fp) != 0 || !ok) {
+        ESP_LOGW(TAG, "Failed to write %s", path);
+        remove(path);       // A short file would only be rejected on every load
+    }
+}
+
+/************************************************************************************************
+ *  Decoding
+ ************************************************************************************************/
+static uint32_t Music_Art_Syncsafe(const uint8_t *b)
+{
+    return ((uint32_t)(b[0] & 0x7F) << 21) | ((b[1] & 0x7F) << 14) | ((b[2] & 0x7F) << 7) | (b[3] & 0x7F);
+}
+
+/* Skips a NUL-terminated string of the given ID3 encoding; returns the offset after it */
+static size_t Music_Art_Skip_Text(const uint8_t *data, size_t size, size_t pos, uint8_t encoding)
+{
+    bool wide = encoding == 1 || encoding == 2;
+    while (pos + (wide ? 1 : 0) < size) {
+        bool end = wide ? (data[pos] == 0 && data[pos + 1] == 0) : data[pos] == 0;
+        pos += wide ? 2 : 1;
+        if (end) {
+            return pos;
+        }
+    }
+    return size;
+}
+
+/* The first JPEG picture frame of the ID3v2 tag, front cover preferred; malloc'd */
+static uint8_t *Music_Art_Read_Apic(FILE *fp, size_t *jpeg_offset, size_t *jpeg_size)
+{
+    uint8_t header[10];
+    if (fread(header, 1, sizeof(header), fp) != sizeof(header) || memcmp(header, "ID3", 3) != 0) {
+        return NULL;
+    }
+    uint8_t version = header[3];
+    uint8_t flags = header[5];
+    if (version < 2 || version > 4 || ((flags & 0x80) && version < 4)) {
+        return NULL;    // Tag-wide unsynchronisation would have to be undone first
+    }
+    long end = 10 + (long)Music_Art_Syncsafe(header + 6);
+    long pos = 10;
+    if ((flags & 0x40) && version >= 3) {                   // Extended header
+        uint8_t b[4];
+        if (fread(b, 1, sizeof(b), fp) != sizeof(b)) {
+            return NULL;
+        }
+        pos += (version == 4) ? Music_Art_Syncsafe(b) :
+               4 + (long)(((uint32_t)b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3]);
+        if (fseek(fp, pos, SEEK_SET) != 0) {
+            return NULL;
+        }
+    }
+
+    const size_t frame_header = (version == 2) ? 6 : 10;
+    uint8_t *best = NULL;
+    while (pos + (long)frame_header <= end) {
+        uint8_t f[10];
+        if (fread(f, 1, frame_header, fp) != frame_header || f[0] == 0) {
+            break;                                          // Padding
+        }
+        uint32_t size;
+        bool usable = true;
+        size_t skip = 0;
+        if (version == 2) {
+            size = ((uint32_t)f[3] << 16) | (f[4] << 8) | f[5];
+        } else if (version == 3) {
+            size = ((uint32_t)f[4] << 24) | (f[5] << 16) | (f[6] << 8) | f[7];
+            usable = !(f[9] & 0xC0);                        // Compressed or encrypted
+        } else {
+            size = Music_Art_Syncsafe(f + 4);
+            usable = !(f[9] & 0x0E);                        // Compressed, encrypted or unsynchronised
+            skip = (f[9] & 0x01) ? 4 : 0;                   // Data length indicator
+        }
+        pos += frame_header;
+        if (pos + (long)size > end) {
+            break;
+        }
+        bool picture = (version == 2) ? memcmp(f, "PIC", 3) == 0 : memcmp(f, "APIC", 4) == 0;
+        if (picture && usable && size > skip + 4 && size <= MUSIC_ART_MAX_JPEG) {
+            uint8_t *data = Music_Art_Alloc(size);
+            if (!data || fread(data, 1, size, fp) != size) {
+                free(data);
+                break;
+            }
+            uint8_t encoding = data[skip];
+            uint8_t type;
+            size_t at;
+            if (version == 2) {                             // Encoding, 3 letter format, type, description
+                type = data[skip + 4];
+                at = Music_Art_Skip_Text(data, size, skip + 5, encoding);
+            } else {                                        // Encoding, MIME type, type, description
+                at = Music_Art_Skip_Text(data, size, skip + 1, 0);
+                type = (at < size) ? data[at] : 0;
+                at = Music_Art_Skip_Text(data, size, at + 1, encoding);
+            }
+            if (at + 2 < size && data[at] == 0xFF && data[at + 1] == 0xD8 && (!best || type == 3)) {
+                free(best);
+                best = data;
+                *jpeg_offset = at;
+                *jpeg_size = size - at;
+                if (type == 3) {
+                    break;                                  // Front cover
+                }
+            } else {
+                free(data);
+            }
+        }
+        pos += size;
+        if (fseek(fp, pos, SEEK_SET) != 0) {
+            break;
+        }
+    }
+    return best;
+}
+
+/* Decoded at the nearest TJpgDec scale, then sampled down so the longer side is MUSIC_ART_SIZE */
+static lv_img_dsc_t *Music_Art_Decode(const uint8_t *jpeg, size_t jpeg_size)
+{
+    lv_img_dsc_t *decoded = spotify_album_art_decode(jpeg, jpeg_size, MUSIC_ART_SIZE);
+    if (!decoded) {
+        return NULL;
+    }
+    uint16_t w = decoded->header.w, h = decoded->header.h;
+    uint16_t longer = w > h ? w : h;
+    if (longer <= MUSIC_ART_SIZE) {
+        return decoded;
+    }
+    uint16_t width = (uint32_t)w * MUSIC_ART_SIZE / longer;
+    uint16_t height = (uint32_t)h * MUSIC_ART_SIZE / longer;
+    lv_img_dsc_t *image = (width && height) ? Music_Art_Image(width, height) : NULL;
+    if (image) {
+        const lv_color_t *src = (const lv_color_t *)decoded->data;
+        lv_color_t *dst = (lv_color_t *)image->data;
+        for (uint16_t y = 0; y < height; y++) {
+            const lv_color_t *row = src + ((uint32_t)y * h / height) * w;
+            for (uint16_t x = 0; x < width; x++) {
+                *dst++ = row[(uint32_t)x * w / width];
+            }
+        }
+    }
+    spotify_album_art_free(decoded);
+    return image;
+}
+
+/* The folder's art, from its cache or else decoded and cached */
+static lv_img_dsc_t *Music_Art_Folder(const char *dir)
+{
+    char path[MUSIC_ART_PATH_MAX * 2];
+    struct stat st;
+    size_t i;
+    for (i = 0; i < sizeof(Music_Art_Folder_Names) / sizeof(Music_Art_Folder_Names[0]); i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, Music_Art_Folder_Names[i]);
+        if (stat(path, &st) == 0) {
+            break;
+        }
+    }
+    if (i == sizeof(Music_Art_Folder_Names) / sizeof(Music_Art_Folder_Names[0])) {
+        return NULL;
+    }
+
+    char cache_path[MUSIC_ART_PATH_MAX * 2];
+    snprintf(cache_path, sizeof(cache_path), "%s/%s", dir, MUSIC_ART_FOLDER_FILE);
+    Music_Art_Header_t header;
+    lv_img_dsc_t *image;
+    if (Music_Art_Load(cache_path, &st, &header, &image)) {
+        return image;
+    }
+
+    image = NULL;
+    uint8_t *jpeg = (st.st_size > 0 && st.st_size <= MUSIC_ART_MAX_JPEG) ? Music_Art_Alloc(st.st_size) : NULL;
+    FILE *fp = jpeg ? fopen(path, "rb") : NULL;
+    if (fp) {
+        if (fread(jpeg, 1, st.st_size, fp) == (size_t)st.st_size) {
+            image = Music_Art_Decode(jpeg, st.st_size);
+        }
+        fclose(fp);
+    }
+    free(jpeg);
+    Music_Art_Save(cache_path, &st, 0, image);
+    return image;
+}
+
+static lv_img_dsc_t *Music_Art_Find(const Music_Art_Job_t *job)
+{
+    char path[MUSIC_ART_PATH_MAX * 2];
+    snprintf(path, sizeof(path), "%s/%s", job->dir, job->file);
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return NULL;
+    }
+    char cache_path[MUSIC_ART_PATH_MAX * 2 + sizeof(MUSIC_ART_SUFFIX)];
+    snprintf(cache_path, sizeof(cache_path), "%s%s", path, MUSIC_ART_SUFFIX);
+    Music_Art_Header_t header;
+    lv_img_dsc_t *image;
+    if (Music_Art_Load(cache_path, &st, &header, &image)) {
+        return (header.flags & MUSIC_ART_USE_FOLDER) ? Music_Art_Folder(job->dir) : image;
+    }
+
+    TickType_t start = xTaskGetTickCount();
+    image = NULL;
+    FILE *fp = fopen(path, "rb");
+    if (fp) {
+        size_t offset, size;
+        uint8_t *frame = Music_Art_Read_Apic(fp, &offset, &size);
+        fclose(fp);
+        if (frame) {
+            image = Music_Art_Decode(frame + offset, size);
+            free(frame);
+        }
+    }
+    Music_Art_Save(cache_path, &st, image ? 0 : MUSIC_ART_USE_FOLDER, image);
+    if (!image) {
+        image = Music_Art_Folder(job->dir);
+    }
+    ESP_LOGI(TAG, "%s: %s in %lu ms", job->file, image ? "art cached" : "no art",
+             (unsigned long)pdTICKS_TO_MS(xTaskGetTickCount() - start));
+    return image;
+}
+
+static void Music_Art_Task(void *parameter)
+{
+    Music_Art_Job_t job;
+    while (true) {
+        xQueueReceive(job_queue, &job, portMAX_DELAY);
+
+        Music_Art_Entry_t *result = malloc(sizeof(*result));
+        if (!result) {
+            continue;
+        }
+        result->key = job;
+        result->image = Music_Art_Find(&job);
+        // Hand it over; one the GUI task has not taken yet is dropped
+        Music_Art_Entry_t *stale = __atomic_exchange_n(&pending, result, __ATOMIC_ACQ_REL);
+        if (stale) {
+            free(stale->image);
+            free(stale);
+        }
+    }
+}
+
+/************************************************************************************************
+ *  GUI task
+ ************************************************************************************************/
+void Music_Art_Init(void)
+{
+    if (job_queue) {
+        return;
+    }
+    job_queue = xQueueCreate(1, sizeof(Music_Art_Job_t));
+    if (!job_queue) {
+        ESP_LOGE(TAG, "Failed to create job queue");
+        return;
+    }
+    if (xTaskCreate(Music_Art_Task, "Music Art", MUSIC_ART_STACK_SIZE, NULL,
+                    MUSIC_ART_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create task");
+        vQueueDelete(job_queue);
+        job_queue = NULL;
+    }
+}
+
+static bool Music_Art_Same(const Music_Art_Job_t *key, const char *dir, const char *file)
+{
+    return strcmp(key->dir, dir) == 0 && strcmp(key->file, file) == 0;
+}
+
+const lv_img_dsc_t *Music_Art_Get(const char *dir, const char *file)
+{
+    if (!dir || !file || strlen(dir) >= MUSIC_ART_PATH_MAX || strlen(file) >= MUSIC_ART_PATH_MAX) {
+        return NULL;
+    }
+    for (int i = 0; i < MUSIC_ART_CACHE_SIZE; i++) {
+        if (cache[i].last_used && Music_Art_Same(&cache[i].key, dir, file)) {
+            cache[i].last_used = ++use_counter;
+            return cache[i].image;
+        }
+    }
+    if (job_queue && !Music_Art_Same(&requested, dir, file)) {
+        strcpy(requested.dir, dir);
+        strcpy(requested.file, file);
+        xQueueOverwrite(job_queue, &requested);
+    }
+    return NULL;
+}
+
+bool Music_Art_Poll(void)
+{
+    Music_Art_Entry_t *result = __atomic_exchange_n(&pending, NULL, __ATOMIC_ACQ_REL);
+    if (!result) {
+        return false;
+    }
+    if (Music_Art_Same(&requested, result->key.dir, result->key.file)) {
+        memset(&requested, 0, sizeof(requested));
+    }
+
+    // Free slot, else the least recently used one
+    Music_Art_Entry_t *entry = &cache[0];
+    for (int i = 0; i < MUSIC_ART_CACHE_SIZE; i++) {
+        if (!cache[i].last_used) {
+            entry = &cache[i];
+            break;
+        }
+        if (cache[i].last_used < entry->last_used) {
+            entry = &cache[i];
+        }
+    }
+    if (entry->image) {
+        // LVGL may still hold a decoder cache entry for this source
+        lv_img_cache_invalidate_src(entry->image);
+        free(entry->image);
+    }
+    *entry = *result;
+    entry->last_used = ++use_counter;
+    free(result);
+    return entry->image != NULL;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+#include "task_plan.h"
+
+/*
+ * Cover art for the tracks on the SD card, decoded once and then read raw.
+ *
+ * The first time a track is shown, a low priority task looks for its art:
+ * an ID3v2 APIC (v2.2 PIC) JPEG in the file, else "folder.jpg",
+ * "cover.jpg" or "front.jpg" beside it. It decodes and scales the art to
+ * MUSIC_ART_SIZE and saves the pixels, in the display's colour format,
+ * next to the source. Embedded art goes to "<file>.art" and folder art to
+ * "<dir>/.folder.art", so an album shares one. A track with no art of its
+ * own still gets a small "<file>.art", which says whether to use the
+ * folder's. From then on the art is one header read plus one read of the
+ * pixels, with no ID3 walk and no decode. A cache whose source size or
+ * mtime no longer matches is made again.
+ *
+ * The task hands each result to the GUI task as soon as it is ready. The
+ * GUI task keeps the last MUSIC_ART_CACHE_SIZE results, so the art being
+ * shown or sliding out stays valid.
+ *
+ * PNG art is skipped. LVGL's decoder allocates from the LVGL heap, which
+ * the task must not touch.
+ *
+ * Everything except Music_Art_Init() is for the GUI task only.
+ */
+
+#define MUSIC_ART_SIZE              176         // Longer side, as the demo covers it replaces
+#define MUSIC_ART_SUFFIX            ".art"
+#define MUSIC_ART_FOLDER_FILE       ".folder.art"
+#define MUSIC_ART_MAGIC             0x5452414D  // "MART"
+#define MUSIC_ART_PATH_MAX          192
+#define MUSIC_ART_CACHE_SIZE        4
+#define MUSIC_ART_PRIORITY          TASK_PLAN_BACKGROUND_PRIORITY   // Beside Music_Index; it mostly waits on the card
+#define MUSIC_ART_STACK_SIZE        6144        // FATFS long names, and TJpgDec on top
+
+void Music_Art_Init(void);
+
+/*
+ * The art of dir/file, or NULL if it is not ready yet or there is none.
+ * NULL for a track not asked for before starts the task on it; only the
+ * latest track waiting is kept.
+ * The image stays valid while it is among the MUSIC_ART_CACHE_SIZE most
+ * recently asked for.
+ */
+const lv_img_dsc_t *Music_Art_Get(const char *dir, const char *file);
+
+/* Takes the task's latest result. Returns true if that was art, to be asked for again */
+bool Music_Art_Poll(void);
@@ -0,0 +1,152 @@
+#include "Music_Index.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "audio_player.h"
+
+static const char *TAG = "MUSIC INDEX";
+
+typedef struct {
+    char path[MUSIC_INDEX_PATH_MAX];
+    FILE *player_file;
+} Music_Index_Job_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t file_bytes;
+    uint32_t step_frames;
+    uint32_t count;
+    uint32_t total_frames;
+} Music_Index_Header_t;
+
+static QueueHandle_t job_queue;
+
+static void Music_Index_Cache_Path(const char *path, char *cache_path)
+{
+    snprintf(cache_path, MUSIC_INDEX_PATH_MAX + sizeof(MUSIC_INDEX_SUFFIX), "%s%s", path, MUSIC_INDEX_SUFFIX);
+}
+
+static bool Music_Index_Load(const char *path, audio_player_seek_index_t *index)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return false;
+    }
+    char cache_path[MUSIC_INDEX_PATH_MAX + sizeof(MUSIC_INDEX_SUFFIX)];
+    Music_Index_Cache_Path(path, cache_path);
+    FILE *fp = fopen(cache_path, "rb");
+    if (!fp) {
+        return false;
+    }
+
+    Music_Index_Header_t header;
+    bool ok = fread(&header, 1, sizeof(header), fp) == sizeof(header) &&
+              header.magic == MUSIC_INDEX_MAGIC &&
+              header.file_bytes == (uint32_t)st.st_size &&
+              header.step_frames != 0 &&
+              header.count != 0 && header.count <= header.total_frames;
+    if (ok) {
+        index->offsets = malloc(header.count * sizeof(uint32_t));
+        ok = index->offsets &&
+             fread(index->offsets, sizeof(uint32_t), header.count, fp) == header.count;
+    }
+    fclose(fp);
+    if (!ok) {
+        free(index->offsets);
+        index->offsets = NULL;
+        ESP_LOGI(TAG, "No usable cache for %s", path);
+        return false;
+    }
+    index->step_frames = header.step_frames;
+    index->count = header.count;
+    index->total_frames = header.total_frames;
+    index->file_bytes = header.file_bytes;
+    return true;
+}
+
+static void Music_Index_Save(const char *path, const audio_player_seek_index_t *index)
+{
+    char cache_path[MUSIC_INDEX_PATH_MAX + sizeof(MUSIC_INDEX_SUFFIX)];
+    Music_Index_Cache_Path(path, cache_path);
+    FILE *fp = fopen(cache_path, "wb");
+    if (!fp) {
+        ESP_LOGW(TAG, "Cannot write %s", cache_path);
+        return;
+    }
+    Music_Index_Header_t header = {
+        .magic = MUSIC_INDEX_MAGIC,
+        .file_bytes = index->file_bytes,
+        .step_frames = index->step_frames,
+        .count = index->count,
+        .total_frames = index->total_frames,
+    };
+    bool ok = fwrite(&header, 1, sizeof(header), fp) == sizeof(header) &&
+              fwrite(index->offsets, sizeof(uint32_t), index->count, fp) == index->count;
+    if (fclose(fp) != 0 || !ok) {
+        ESP_LOGW(TAG, "Failed to write %s", cache_path);
+        remove(cache_path);     // A short file would only be rejected on every load
+    }
+}
+
+static void Music_Index_Task(void *parameter)
+{
+    Music_Index_Job_t job;
+    while (true) {
+        xQueueReceive(job_queue, &job, portMAX_DELAY);
+
+        audio_player_seek_index_t index = { 0 };
+        if (!Music_Index_Load(job.path, &index)) {
+            FILE *fp = fopen(job.path, "rb");
+            if (!fp) {
+                continue;
+            }
+            TickType_t start = xTaskGetTickCount();
+            esp_err_t ret = audio_player_build_seek_index(fp, &index);
+            fclose(fp);
+            if (ret == ESP_ERR_NOT_SUPPORTED) {
+                continue;       // Not MP3, or its own TOC seeks well enough
+            }
+            if (ret != ESP_OK) {
+                ESP_LOGW(TAG, "No index for %s: %s", job.path, esp_err_to_name(ret));
+                continue;
+            }
+            ESP_LOGI(TAG, "Indexed %s in %lu ms", job.path,
+                     (unsigned long)pdTICKS_TO_MS(xTaskGetTickCount() - start));
+            Music_Index_Save(job.path, &index);
+        }
+        audio_player_set_seek_index(job.player_file, &index);
+    }
+}
+
+void Music_Index_Init(void)
+{
+    job_queue = xQueueCreate(MUSIC_INDEX_QUEUE_LEN, sizeof(Music_Index_Job_t));
+    if (!job_queue) {
+        ESP_LOGE(TAG, "Failed to create job queue");
+        return;
+    }
+    if (xTaskCreate(Music_Index_Task, "Music Index", MUSIC_INDEX_STACK_SIZE, NULL,
+                    MUSIC_INDEX_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create task");
+        vQueueDelete(job_queue);
+        job_queue = NULL;
+    }
+}
+
+void Music_Index_Request(const char *path, FILE *player_file)
+{
+    if (!job_queue) {
+        return;
+    }
+    Music_Index_Job_t job;
+    strncpy(job.path, path, sizeof(job.path) - 1);
+    job.path[sizeof(job.path) - 1] = '\0';
+    job.player_file = player_file;
+    if (xQueueSend(job_queue, &job, 0) != pdPASS) {
+        ESP_LOGW(TAG, "Busy, %s seeks by estimate", path);
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdio.h>
+#include "task_plan.h"
+
+/*
+ * Seek indexes for MP3 files without a Xing/VBRI TOC.
+ *
+ * Each file that starts or is queued is handed to a low priority task. It
+ * loads "<file>.idx" from beside the file, or else reads every frame header
+ * (audio_player_build_seek_index) and saves the index there for next time,
+ * then gives it to the player for that FILE*. Until it arrives a seek lands
+ * on the bitrate estimate. A cache whose size no longer matches the MP3 is
+ * rebuilt.
+ */
+
+#define MUSIC_INDEX_SUFFIX          ".idx"
+#define MUSIC_INDEX_MAGIC           0x5844494D  // "MIDX"
+#define MUSIC_INDEX_PATH_MAX        128
+#define MUSIC_INDEX_QUEUE_LEN       2           // The track playing and the one queued
+#define MUSIC_INDEX_PRIORITY        TASK_PLAN_BACKGROUND_PRIORITY   // It mostly waits on the card
+#define MUSIC_INDEX_STACK_SIZE      4096
+
+void Music_Index_Init(void);
+void Music_Index_Request(const char *path, FILE *player_file);
@@ -0,0 +1,868 @@
+#include "Music_Library.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "audio_player.h"
+#include "Music_Index.h"
+
+static const char *TAG = "MUSIC LIBRARY";
+
+#define MUSIC_LIBRARY_NO_DIR        0xFFFF
+#define MUSIC_LIBRARY_STRINGS_MAX   (1024 * 1024)   // Sanity limit on a loaded file
+#define MUSIC_TRACK_READ            0x0001      // Tags and length read; else the title is the file name
+#define ID3_FRAME_MAX               (4 * MUSIC_LIBRARY_TEXT_MAX)    // Read of a text frame; the rest is skipped
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t dir_count;
+    uint16_t track_count;
+    uint16_t reserved;
+    uint32_t string_bytes;
+} Music_Library_Header_t;
+
+typedef struct {
+    uint32_t path;              // String offset, e.g. "/sdcard/Albums/Foo"
+    uint32_t mtime;             // 0 if stat gave none (the FAT root): always listed
+    uint16_t parent;            // MUSIC_LIBRARY_NO_DIR for the root
+    uint16_t depth;
+    uint16_t first_track;       // The tracks of a directory are contiguous
+    uint16_t track_count;
+} Music_Library_Dir_t;
+
+typedef struct {
+    uint32_t file;              // Name in its directory
+    uint32_t title;
+    uint32_t artist;            // 0, the empty string, if untagged
+    uint32_t album;
+    uint32_t size;              // With mtime, tells whether the file changed
+    uint32_t mtime;
+    uint32_t duration_ms;
+    uint16_t dir;
+    uint16_t flags;
+} Music_Library_Track_t;
+
+typedef struct {
+    Music_Library_Header_t header;
+    Music_Library_Dir_t *dirs;          // Breadth first from MUSIC_LIBRARY_ROOT
+    Music_Library_Track_t *tracks;      // By directory
+    uint16_t *order;                    // Track numbers by title: the list
+    char *strings;                      // Offset 0 is ""
+    uint32_t dir_capacity;              // While the scanner builds it
+    uint32_t track_capacity;
+    uint32_t string_capacity;
+    bool out_of_memory;
+} Music_Library_t;
+
+typedef struct {
+    char title[MUSIC_LIBRARY_TEXT_MAX];
+    char artist[MUSIC_LIBRARY_TEXT_MAX];
+    char album[MUSIC_LIBRARY_TEXT_MAX];
+} Music_Tags_t;
+
+static const char *const Music_Library_Types[] = { ".mp3", ".wav", ".flac", ".aac", ".opus" };
+
+static Music_Library_t library;                 // The GUI task's
+static Music_Library_t *pending;                // From the scanner, until Music_Library_Apply()
+static bool scanning;
+static const Music_Library_t *sort_library;    // qsort() has no context; only the scanner sorts
+
+/************************************************************************************************
+ *  Storage
+ ************************************************************************************************/
+// Tables live in PSRAM; internal RAM is kept for DMA and the stacks
+static void *Music_Library_Realloc(void *ptr, size_t size)
+{
+    void *grown = heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM);
+    return grown ? grown : realloc(ptr, size);
+}
+
+static void Music_Library_Free(Music_Library_t *lib)
+{
+    free(lib->dirs);
+    free(lib->tracks);
+    free(lib->order);
+    free(lib->strings);
+    memset(lib, 0, sizeof(*lib));
+}
+
+static bool Music_Library_Grow(Music_Library_t *lib, void **array, uint32_t *capacity, uint32_t count,
+                               size_t item, uint32_t first)
+{
+    if (count < *capacity) {
+        return true;
+    }
+    uint32_t grown = *capacity ? *capacity * 2 : first;
+    void *ptr = Music_Library_Realloc(*array, (size_t)grown * item);
+    if (!ptr) {
+        lib->out_of_memory = true;
+        return false;
+    }
+    *array = ptr;
+    *capacity = grown;
+    return true;
+}
+
+static uint32_t Music_Library_Add_String(Music_Library_t *lib, const char *text)
+{
+    size_t len = strlen(text) + 1;
+    while (lib->header.string_bytes + len > lib->string_capacity) {
+        if (!Music_Library_Grow(lib, (void **)&lib->strings, &lib->string_capacity,
+                                lib->string_capacity, 1, 4096)) {
+            return 0;
+        }
+    }
+    uint32_t offset = lib->header.string_bytes;
+    memcpy(lib->strings + offset, text, len);
+    lib->header.string_bytes += len;
+    return offset;
+}
+
+// Tracks of an album share their artist and album; store those once
+static uint32_t Music_Library_Add_Text(Music_Library_t *lib, const char *text, uint32_t previous)
+{
+    if (!text[0]) {
+        return 0;
+    }
+    if (previous && strcmp(lib->strings + previous, text) == 0) {
+        return previous;
+    }
+    return Music_Library_Add_String(lib, text);
+}
+
+static int Music_Library_Add_Dir(Music_Library_t *lib, const char *path, uint16_t parent, uint16_t depth)
+{
+    if (lib->header.dir_count >= MUSIC_LIBRARY_MAX_DIRS) {
+        ESP_LOGW(TAG, "More than %d folders, %s left out", MUSIC_LIBRARY_MAX_DIRS, path);
+        return -1;
+    }
+    if (!Music_Library_Grow(lib, (void **)&lib->dirs, &lib->dir_capacity, lib->header.dir_count,
+                            sizeof(Music_Library_Dir_t), 16)) {
+        return -1;
+    }
+    uint32_t offset = Music_Library_Add_String(lib, path);
+    Music_Library_Dir_t *dir = &lib->dirs[lib->header.dir_count];
+    memset(dir, 0, sizeof(*dir));
+    dir->path = offset;
+    dir->parent = parent;
+    dir->depth = depth;
+    return lib->header.dir_count++;
+}
+
+static Music_Library_Track_t *Music_Library_Add_Track(Music_Library_t *lib)
+{
+    if (lib->header.track_count >= MUSIC_LIBRARY_MAX_TRACKS) {
+        return NULL;
+    }
+    if (!Music_Library_Grow(lib, (void **)&lib->tracks, &lib->track_capacity, lib->header.track_count,
+                            sizeof(Music_Library_Track_t), 64)) {
+        return NULL;
+    }
+    Music_Library_Track_t *track = &lib->tracks[lib->header.track_count++];
+    memset(track, 0, sizeof(*track));
+    return track;
+}
+
+static bool Music_Library_Read_Array(FILE *fp, void **array, size_t size)
+{
+    *array = NULL;
+    if (size == 0) {
+        return true;
+    }
+    *array = Music_Library_Realloc(NULL, size);
+    return *array && fread(*array, 1, size, fp) == size;
+}
+
+static bool Music_Library_Valid(const Music_Library_t *lib)
+{
+    const Music_Library_Header_t *h = &lib->header;
+    if (lib->strings[h->string_bytes - 1] != '\0') {
+        return false;
+    }
+    for (uint32_t d = 0; d < h->dir_count; d++) {
+        const Music_Library_Dir_t *dir = &lib->dirs[d];
+        if (dir->path >= h->string_bytes ||
+            (uint32_t)dir->first_track + dir->track_count > h->track_count) {
+            return false;
+        }
+    }
+    for (uint32_t t = 0; t < h->track_count; t++) {
+        const Music_Library_Track_t *track = &lib->tracks[t];
+        if (track->dir >= h->dir_count || track->file >= h->string_bytes || track->title >= h->string_bytes ||
+            track->artist >= h->string_bytes || track->album >= h->string_bytes ||
+            lib->order[t] >= h->track_count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool Music_Library_Load(Music_Library_t *lib)
+{
+    memset(lib, 0, sizeof(*lib));
+    FILE *fp = fopen(MUSIC_LIBRARY_FILE, "rb");
+    if (!fp) {
+        return false;
+    }
+    Music_Library_Header_t *h = &lib->header;
+    bool ok = fread(h, 1, sizeof(*h), fp) == sizeof(*h) &&
+              h->magic == MUSIC_LIBRARY_MAGIC && h->version == MUSIC_LIBRARY_VERSION &&
+              h->dir_count >= 1 && h->dir_count <= MUSIC_LIBRARY_MAX_DIRS &&
+              h->track_count <= MUSIC_LIBRARY_MAX_TRACKS &&
+              h->string_bytes >= 1 && h->string_bytes <= MUSIC_LIBRARY_STRINGS_MAX;
+    ok = ok && Music_Library_Read_Array(fp, (void **)&lib->dirs, h->dir_count * sizeof(Music_Library_Dir_t)) &&
+         Music_Library_Read_Array(fp, (void **)&lib->tracks, h->track_count * sizeof(Music_Library_Track_t)) &&
+         Music_Library_Read_Array(fp, (void **)&lib->order, h->track_count * sizeof(uint16_t)) &&
+         Music_Library_Read_Array(fp, (void **)&lib->strings, h->string_bytes) &&
+         Music_Library_Valid(lib);
+    fclose(fp);
+    if (!ok) {
+        ESP_LOGW(TAG, "%s is not usable, rescanning", MUSIC_LIBRARY_FILE);
+        Music_Library_Free(lib);
+        return false;
+    }
+    lib->dir_capacity = h->dir_count;
+    lib->track_capacity = h->track_count;
+    lib->string_capacity = h->string_bytes;
+    return true;
+}
+
+// Written beside and renamed over, so a reset half way leaves the old file
+static void Music_Library_Save(const Music_Library_t *lib)
+{
+    const char *temp_path = MUSIC_LIBRARY_FILE ".tmp";
+    FILE *fp = fopen(temp_path, "wb");
+    if (!fp) {
+        ESP_LOGW(TAG, "Cannot write %s", temp_path);
+        return;
+    }
+    const Music_Library_Header_t *h = &lib->header;
+    bool ok = fwrite(h, 1, sizeof(*h), fp) == sizeof(*h) &&
+              fwrite(lib->dirs, sizeof(Music_Library_Dir_t), h->dir_count, fp) == h->dir_count &&
+              fwrite(lib->tracks, sizeof(Music_Library_Track_t), h->track_count, fp) == h->track_count &&
+              fwrite(lib->order, sizeof(uint16_t), h->track_count, fp) == h->track_count &&
+              fwrite(lib->strings, 1, h->string_bytes, fp) == h->string_bytes;
+    if (fclose(fp) != 0 || !ok) {
+        ESP_LOGW(TAG, "Failed to write %s", temp_path);
+        remove(temp_path);
+        return;
+    }
+    remove(MUSIC_LIBRARY_FILE);     // FATFS will not rename over a file
+    if (rename(temp_path, MUSIC_LIBRARY_FILE) != 0) {
+        ESP_LOGW(TAG, "Failed to replace %s", MUSIC_LIBRARY_FILE);
+    }
+}
+
+static bool Music_Library_Clone(const Music_Library_t *from, Music_Library_t *to)
+{
+    const Music_Library_Header_t *h = &from->header;
+    memset(to, 0, sizeof(*to));
+    to->header = *h;
+    to->dirs = Music_Library_Realloc(NULL, h->dir_count * sizeof(Music_Library_Dir_t));
+    to->strings = Music_Library_Realloc(NULL, h->string_bytes);
+    if (h->track_count) {
+        to->tracks = Music_Library_Realloc(NULL, h->track_count * sizeof(Music_Library_Track_t));
+        to->order = Music_Library_Realloc(NULL, h->track_count * sizeof(uint16_t));
+    }
+    if (!to->dirs || !to->strings || (h->track_count && (!to->tracks || !to->order))) {
+        Music_Library_Free(to);
+        return false;
+    }
+    memcpy(to->dirs, from->dirs, h->dir_count * sizeof(Music_Library_Dir_t));
+    memcpy(to->strings, from->strings, h->string_bytes);
+    if (h->track_count) {
+        memcpy(to->tracks, from->tracks, h->track_count * sizeof(Music_Library_Track_t));
+        memcpy(to->order, from->order, h->track_count * sizeof(uint16_t));
+    }
+    to->dir_capacity = h->dir_count;
+    to->track_capacity = h->track_count;
+    to->string_capacity = h->string_bytes;
+    return true;
+}
+
+/************************************************************************************************
+ *  Tags
+ ************************************************************************************************/
+// One code point onto text, whole or not at all
+static bool Music_Library_Put_Utf8(char *text, size_t *len, uint32_t c)
+{
+    char buf[4];
+    size_t n;
+    if (c < 0x80) {
+        buf[0] = c;
+        n = 1;
+    } else if (c < 0x800) {
+        buf[0] = 0xC0 | (c >> 6);
+        buf[1] = 0x80 | (c & 0x3F);
+        n = 2;
+    } else if (c < 0x10000) {
+        buf[0] = 0xE0 | (c >> 12);
+        buf[1] = 0x80 | ((c >> 6) & 0x3F);
+        buf[2] = 0x80 | (c & 0x3F);
+        n = 3;
+    } else {
+        buf[0] = 0xF0 | (c >> 18);
+        buf[1] = 0x80 | ((c >> 12) & 0x3F);
+        buf[2] = 0x80 | ((c >> 6) & 0x3F);
+        buf[3] = 0x80 | (c & 0x3F);
+        n = 4;
+    }
+    if (*len + n >= MUSIC_LIBRARY_TEXT_MAX) {
+        return false;
+    }
+    memcpy(text + *len, buf, n);
+    *len += n;
+    text[*len] = '\0';
+    return true;
+}
+
+// ID3 text in any of its encodings, up to its first NUL, as UTF-8 for LVGL
+static void Music_Library_Decode(const uint8_t *data, size_t size, uint8_t encoding, char *text)
+{
+    size_t len = 0;
+    text[0] = '\0';
+    if (encoding == 1 || encoding == 2) {                   // UTF-16 with BOM, UTF-16BE
+        bool big_endian = (encoding == 2);
+        if (encoding == 1 && size >= 2 && (data[0] == 0xFE || data[0] == 0xFF) && data[0] + data[1] == 0x1FD) {
+            big_endian = (data[0] == 0xFE);
+            data += 2;
+            size -= 2;
+        }
+        for (size_t i = 0; i + 1 < size; i += 2) {
+            uint32_t c = big_endian ? (data[i] << 8) | data[i + 1] : data[i] | (data[i + 1] << 8);
+            if (c == 0) {
+                break;
+            }
+            if (c >= 0xD800 && c < 0xE000) {                // Surrogate pair, or '?' if broken
+                uint32_t low = (i + 3 < size) ? (big_endian ? (data[i + 2] << 8) | data[i + 3] :
+                                                              data[i + 2] | (data[i + 3] << 8)) : 0;
+                if (c < 0xDC00 && low >= 0xDC00 && low < 0xE000) {
+                    c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                    i += 2;
+                } else {
+                    c = '?';
+                }
+            }
+            if (!Music_Library_Put_Utf8(text, &len, c)) {
+                break;
+            }
+        }
+    } else if (encoding == 3) {                             // UTF-8: whole sequences only
+        for (size_t i = 0; i < size && data[i]; ) {
+            size_t n = (data[i] < 0x80) ? 1 : (data[i] >= 0xF0) ? 4 : (data[i] >= 0xE0) ? 3 : 2;
+            if (i + n > size || len + n >= MUSIC_LIBRARY_TEXT_MAX) {
+                break;
+            }
+            memcpy(text + len, data + i, n);
+            len += n;
+            i += n;
+        }
+        text[len] = '\0';
+    } else {                                                // ISO-8859-1
+        for (size_t i = 0; i < size && data[i]; i++) {
+            if (!Music_Library_Put_Utf8(text, &len, data[i])) {
+                break;
+            }
+        }
+    }
+    while (len > 0 && text[len - 1] == ' ') {
+        text[--len] = '\0';
+    }
+}
+
+static uint32_t Music_Library_Syncsafe(const uint8_t *b)
+{
+    return ((uint32_t)(b[0] & 0x7F) << 21) | ((b[1] & 0x7F) << 14) | ((b[2] & 0x7F) << 7) | (b[3] & 0x7F);
+}
+
+static char *Music_Library_Tag_Field(Music_Tags_t *tags, const uint8_t *id, uint8_t version)
+{
+    static const char *const v22_ids[] = { "TT2", "TP1", "TAL" };
+    static const char *const v23_ids[] = { "TIT2", "TPE1", "TALB" };
+    char *fields[] = { tags->title, tags->artist, tags->album };
+    for (int i = 0; i < 3; i++) {
+        if (version == 2 ? memcmp(id, v22_ids[i], 3) == 0 : memcmp(id, v23_ids[i], 4) == 0) {
+            return fields[i][0] ? NULL : fields[i];
+        }
+    }
+    return NULL;
+}
+
+// ID3v2.2 to 2.4 at the start of the file: text frames are read, pictures and the rest skipped
+static void Music_Library_Read_Id3v2(FILE *fp, Music_Tags_t *tags)
+{
+    uint8_t header[10];
+    if (fseek(fp, 0, SEEK_SET) != 0 || fread(header, 1, sizeof(header), fp) != sizeof(header) ||
+        memcmp(header, "ID3", 3) != 0) {
+        return;
+    }
+    uint8_t version = header[3];
+    uint8_t flags = header[5];
+    if (version < 2 || version > 4 || ((flags & 0x80) && version < 4)) {
+        return;     // Tag-wide unsynchronisation would have to be undone first; v2.4 does it per frame
+    }
+    long end = 10 + (long)Music_Library_Syncsafe(header + 6);
+    long pos = 10;
+    if ((flags & 0x40) && version >= 3) {                   // Extended header
+        uint8_t b[4];
+        if (fread(b, 1, sizeof(b), fp) != sizeof(b)) {
+            return;
+        }
+        pos += (version == 4) ? Music_Library_Syncsafe(b) :
+               4 + (long)(((uint32_t)b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3]);
+        if (fseek(fp, pos, SEEK_SET) != 0) {
+            return;
+        }
+    }
+
+    const size_t frame_header = (version == 2) ? 6 : 10;
+    uint8_t data[ID3_FRAME_MAX];
+    while (pos + (long)frame_header <= end && !(tags->title[0] && tags->artist[0] && tags->album[0])) {
+        uint8_t f[10];
+        if (fread(f, 1, frame_header, fp) != frame_header || f[0] == 0) {
+            break;                                          // Padding
+        }
+        uint32_t size;
+        bool usable = true;
+        size_t skip = 0;
+        if (version == 2) {
+            size = ((uint32_t)f[3] << 16) | (f[4] << 8) | f[5];
+        } else if (version == 3) {
+            size = ((uint32_t)f[4] << 24) | (f[5] << 16) | (f[6] << 8) | f[7];
+            usable = !(f[9] & 0xC0);                        // Compressed or encrypted
+        } else {
+            size = Music_Library_Syncsafe(f + 4);
+            usable = !(f[9] & 0x0E);                        // Compressed, encrypted or unsynchronised
+            skip = (f[9] & 0x01) ? 4 : 0;                   // Data length indicator
+        }
+        pos += frame_header;
+        if (pos + (long)size > end) {
+            break;
+        }
+        char *field = Music_Library_Tag_Field(tags, f, version);
+        if (field && usable && size > skip + 1) {
+            size_t n = (size < sizeof(data)) ? size : sizeof(data);
+            if (fread(data, 1, n, fp) != n) {
+                break;
+            }
+            Music_Library_Decode(data + skip + 1, n - skip - 1, data[skip], field);
+        }
+        pos += size;
+        if (fseek(fp, pos, SEEK_SET) != 0) {
+            break;
+        }
+    }
+}
+
+// The 128 bytes at the end; fills only what ID3v2 left empty
+static void Music_Library_Read_Id3v1(FILE *fp, Music_Tags_t *tags)
+{
+    uint8_t tag[128];
+    if (fseek(fp, -(long)sizeof(tag), SEEK_END) != 0 || fread(tag, 1, sizeof(tag), fp) != sizeof(tag) ||
+        memcmp(tag, "TAG", 3) != 0) {
+        return;
+    }
+    char *fields[] = { tags->title, tags->artist, tags->album };
+    for (int i = 0; i < 3; i++) {
+        if (!fields[i][0]) {
+            Music_Library_Decode(tag + 3 + 30 * i, 30, 0, fields[i]);
+        }
+    }
+}
+
+/************************************************************************************************
+ *  Scanner
+ ************************************************************************************************/
+static bool Music_Library_Is_Music(const char *name)
+{
+    const char *dot = strrchr(name, '.');
+    if (!dot || dot == name) {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(Music_Library_Types) / sizeof(Music_Library_Types[0]); i++) {
+        if (strcasecmp(dot, Music_Library_Types[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int Music_Library_Find_Dir(const Music_Library_t *lib, const char *path)
+{
+    for (int d = 0; d < lib->header.dir_count; d++) {
+        if (strcmp(lib->strings + lib->dirs[d].path, path) == 0) {
+            return d;
+        }
+    }
+    return -1;
+}
+
+// readdir() keeps its order, so the search starts after the last match
+static const Music_Library_Track_t *Music_Library_Find_Track(const Music_Library_t *base, int dir_index,
+                                                             const char *name, uint16_t *hint)
+{
+    if (dir_index < 0) {
+        return NULL;
+    }
+    const Music_Library_Dir_t *dir = &base->dirs[dir_index];
+    for (uint16_t i = 0; i < dir->track_count; i++) {
+        uint16_t n = (*hint + i) % dir->track_count;
+        const Music_Library_Track_t *track = &base->tracks[dir->first_track + n];
+        if (strcmp(base->strings + track->file, name) == 0) {
+            *hint = n + 1;
+            return track;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * One file into lib: copied from old if that is the same file (size and
+ * mtime) and as complete as wanted, else read. Returns false once the
+ * library is full.
+ */
+static bool Music_Library_Add_File(const Music_Library_t *base, const Music_Library_Track_t *old,
+                                   Music_Library_t *lib, uint16_t dir, const char *path, const char *name,
+                                   uint32_t size, uint32_t mtime, bool read_tags, uint32_t *fresh)
+{
+    Music_Library_Track_t *track = Music_Library_Add_Track(lib);
+    if (!track) {
+        if (!lib->out_of_memory) {
+            ESP_LOGW(TAG, "More than %d tracks, the rest are left out", MUSIC_LIBRARY_MAX_TRACKS);
+        }
+        return false;
+    }
+    uint32_t previous_artist = (lib->header.track_count > 1) ? track[-1].artist : 0;
+    uint32_t previous_album = (lib->header.track_count > 1) ? track[-1].album : 0;
+    track->dir = dir;
+    track->size = size;
+    track->mtime = mtime;
+    track->file = Music_Library_Add_String(lib, name);
+
+    if (old && old->size == size && old->mtime == mtime && ((old->flags & MUSIC_TRACK_READ) || !read_tags)) {
+        track->title = Music_Library_Add_String(lib, base->strings + old->title);
+        track->artist = Music_Library_Add_Text(lib, base->strings + old->artist, previous_artist);
+        track->album = Music_Library_Add_Text(lib, base->strings + old->album, previous_album);
+        track->duration_ms = old->duration_ms;
+        track->flags = old->flags;
+        return true;
+    }
+
+    Music_Tags_t tags = { 0 };
+    if (read_tags) {
+        FILE *fp = fopen(path, "rb");
+        if (fp) {
+            Music_Library_Read_Id3v2(fp, &tags);
+            Music_Library_Read_Id3v1(fp, &tags);
+            audio_player_get_file_duration(fp, &track->duration_ms);
+            fclose(fp);
+        }
+        track->flags = MUSIC_TRACK_READ;    // Even if it could not be opened: no retry on every boot
+    }
+    if (!tags.title[0]) {
+        strlcpy(tags.title, name, sizeof(tags.title));
+        char *dot = strrchr(tags.title, '.');
+        if (dot && dot != tags.title) {
+            *dot = '\0';
+        }
+    }
+    track->title = Music_Library_Add_String(lib, tags.title);
+    track->artist = Music_Library_Add_Text(lib, tags.artist, previous_artist);
+    track->album = Music_Library_Add_Text(lib, tags.album, previous_album);
+    (*fresh)++;
+    return true;
+}
+
+// Unchanged since the last scan: its files and folders are taken as they were
+static void Music_Library_Reuse_Dir(const Music_Library_t *base, int b, Music_Library_t *lib, uint16_t d,
+                                    bool read_tags, uint32_t *fresh)
+{
+    const Music_Library_Dir_t *old = &base->dirs[b];
+    char path[MUSIC_INDEX_PATH_MAX];
+    for (uint16_t i = 0; i < old->track_count; i++) {
+        const Music_Library_Track_t *track = &base->tracks[old->first_track + i];
+        snprintf(path, sizeof(path), "%s/%s", base->strings + old->path, base->strings + track->file);
+        if (!Music_Library_Add_File(base, track, lib, d, path, base->strings + track->file,
+                                    track->size, track->mtime, read_tags, fresh)) {
+            break;
+        }
+    }
+    for (int sub = b + 1; sub < base->header.dir_count; sub++) {
+        if (base->dirs[sub].parent == b) {
+            Music_Library_Add_Dir(lib, base->strings + base->dirs[sub].path, d, lib->dirs[d].depth + 1);
+        }
+    }
+}
+
+static void Music_Library_List_Dir(const Music_Library_t *base, int b, Music_Library_t *lib, uint16_t d,
+                                   const char *dir_path, bool read_tags, uint32_t *fresh)
+{
+    DIR *dir = opendir(dir_path);
+    if (!dir) {
+        ESP_LOGW(TAG, "Cannot list %s", dir_path);
+        return;
+    }
+    char path[MUSIC_INDEX_PATH_MAX];
+    uint16_t hint = 0;
+    bool full = false;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && !lib->out_of_memory) {
+        if (entry->d_name[0] == '.') {
+            continue;                                       // Hidden, and this library itself
+        }
+        if (snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name) >= (int)sizeof(path)) {
+            ESP_LOGW(TAG, "Path too long: %s/%s", dir_path, entry->d_name);
+            continue;                                       // Play_Music() could not open it either
+        }
+        if (entry->d_type == DT_DIR) {
+            if (strcmp(entry->d_name, "System Volume Information") != 0 &&
+                lib->dirs[d].depth < MUSIC_LIBRARY_MAX_DEPTH) {
+                Music_Library_Add_Dir(lib, path, d, lib->dirs[d].depth + 1);
+            }
+        } else if (!full && Music_Library_Is_Music(entry->d_name)) {
+            struct stat st;
+            if (stat(path, &st) != 0) {
+                continue;
+            }
+            const Music_Library_Track_t *old = Music_Library_Find_Track(base, b, entry->d_name, &hint);
+            full = !Music_Library_Add_File(base, old, lib, d, path, entry->d_name,
+                                           (uint32_t)st.st_size, (uint32_t)st.st_mtime, read_tags, fresh);
+        }
+    }
+    closedir(dir);
+}
+
+static int Music_Library_Compare(const void *a, const void *b)
+{
+    const Music_Library_t *lib = sort_library;
+    uint16_t ia = *(const uint16_t *)a;
+    uint16_t ib = *(const uint16_t *)b;
+    const Music_Library_Track_t *ta = &lib->tracks[ia];
+    const Music_Library_Track_t *tb = &lib->tracks[ib];
+    int diff = strcasecmp(lib->strings + ta->title, lib->strings + tb->title);
+    if (diff == 0) {
+        diff = strcasecmp(lib->strings + ta->artist, lib->strings + tb->artist);
+    }
+    return diff ? diff : (int)ia - (int)ib;
+}
+
+static void Music_Library_Sort(Music_Library_t *lib)
+{
+    uint16_t count = lib->header.track_count;
+    free(lib->order);
+    lib->order = NULL;
+    if (count == 0) {
+        return;
+    }
+    lib->order = Music_Library_Realloc(NULL, count * sizeof(uint16_t));
+    if (!lib->order) {
+        lib->out_of_memory = true;
+        return;
+    }
+    for (uint16_t i = 0; i < count; i++) {
+        lib->order[i] = i;
+    }
+    sort_library = lib;
+    qsort(lib->order, count, sizeof(uint16_t), Music_Library_Compare);
+}
+
+/*
+ * Walks the card breadth first, taking from base what has not changed.
+ * fresh counts the files that were not in base as they are now.
+ */
+static bool Music_Library_Scan(const Music_Library_t *base, Music_Library_t *lib, bool read_tags, uint32_t *fresh)
+{
+    memset(lib, 0, sizeof(*lib));
+    lib->header.magic = MUSIC_LIBRARY_MAGIC;
+    lib->header.version = MUSIC_LIBRARY_VERSION;
+    *fresh = 0;
+    Music_Library_Add_String(lib, "");
+    Music_Library_Add_Dir(lib, MUSIC_LIBRARY_ROOT, MUSIC_LIBRARY_NO_DIR, 0);
+
+    char path[MUSIC_INDEX_PATH_MAX];
+    for (uint16_t d = 0; d < lib->header.dir_count && !lib->out_of_memory; d++) {
+        strlcpy(path, lib->strings + lib->dirs[d].path, sizeof(path));
+        struct stat st;
+        uint32_t mtime = (stat(path, &st) == 0) ? (uint32_t)st.st_mtime : 0;
+        lib->dirs[d].mtime = mtime;
+        lib->dirs[d].first_track = lib->header.track_count;
+        int b = Music_Library_Find_Dir(base, path);
+        if (b >= 0 && mtime != 0 && base->dirs[b].mtime == mtime) {
+            Music_Library_Reuse_Dir(base, b, lib, d, read_tags, fresh);
+        } else {
+            Music_Library_List_Dir(base, b, lib, d, path, read_tags, fresh);
+        }
+        lib->dirs[d].track_count = lib->header.track_count - lib->dirs[d].first_track;
+    }
+    if (!lib->out_of_memory) {
+        Music_Library_Sort(lib);
+    }
+    if (lib->out_of_memory) {
+        Music_Library_Free(lib);
+        return false;
+    }
+    return true;
+}
+
+static bool Music_Library_Changed(const Music_Library_t *base, const Music_Library_t *lib, uint32_t fresh)
+{
+    if (fresh || base->header.track_count != lib->header.track_count ||
+        base->header.dir_count != lib->header.dir_count) {
+        return true;
+    }
+    for (uint16_t d = 0; d < lib->header.dir_count; d++) {
+        if (base->dirs[d].mtime != lib->dirs[d].mtime ||
+            strcmp(base->strings + base->dirs[d].path, lib->strings + lib->dirs[d].path) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Hands lib over to the GUI task; one it has not taken yet is dropped
+static void Music_Library_Publish(Music_Library_t *lib)
+{
+    Music_Library_t *boxed = malloc(sizeof(*boxed));
+    if (!boxed) {
+        Music_Library_Free(lib);
+        return;
+    }
+    *boxed = *lib;
+    memset(lib, 0, sizeof(*lib));
+    Music_Library_t *stale = __atomic_exchange_n(&pending, boxed, __ATOMIC_ACQ_REL);
+    if (stale) {
+        Music_Library_Free(stale);
+        free(stale);
+    }
+}
+
+static void Music_Library_Task(void *parameter)
+{
+    Music_Library_t *base = parameter;
+    Music_Library_t lib;
+    uint32_t fresh;
+    TickType_t start = xTaskGetTickCount();
+
+    // First boot: list the names now, read the tags after
+    if (base->header.track_count == 0 && Music_Library_Scan(base, &lib, false, &fresh)) {
+        Music_Library_t names;
+        if (lib.header.track_count && Music_Library_Clone(&lib, &names)) {
+            Music_Library_Publish(&names);
+        }
+        Music_Library_Free(base);
+        *base = lib;
+    }
+
+    if (!Music_Library_Scan(base, &lib, true, &fresh)) {
+        ESP_LOGE(TAG, "Out of memory scanning the card");
+    } else if (Music_Library_Changed(base, &lib, fresh)) {
+        ESP_LOGI(TAG, "%u tracks in %u folders, %lu read, in %lu ms", lib.header.track_count,
+                 lib.header.dir_count, (unsigned long)fresh,
+                 (unsigned long)pdTICKS_TO_MS(xTaskGetTickCount() - start));
+        Music_Library_Save(&lib);
+        Music_Library_Publish(&lib);
+    } else {
+        ESP_LOGI(TAG, "Unchanged, checked in %lu ms", (unsigned long)pdTICKS_TO_MS(xTaskGetTickCount() - start));
+        Music_Library_Free(&lib);
+    }
+    Music_Library_Free(base);
+    free(base);
+    __atomic_store_n(&scanning, false, __ATOMIC_RELEASE);
+    vTaskDelete(NULL);
+}
+
+/************************************************************************************************
+ *  GUI task
+ ************************************************************************************************/
+void Music_Library_Init(void)
+{
+    static bool started;
+    if (started) {
+        return;
+    }
+    started = true;
+    if (Music_Library_Load(&library)) {
+        ESP_LOGI(TAG, "%u tracks from %s", library.header.track_count, MUSIC_LIBRARY_FILE);
+    }
+
+    // The scanner works on a copy of its own
+    Music_Library_t *base = calloc(1, sizeof(*base));
+    if (!base || (library.header.dir_count && !Music_Library_Clone(&library, base))) {
+        ESP_LOGE(TAG, "No memory for the scanner");
+        free(base);
+        return;
+    }
+    __atomic_store_n(&scanning, true, __ATOMIC_RELEASE);
+    if (xTaskCreate(Music_Library_Task, "Music Library", MUSIC_LIBRARY_STACK_SIZE, base,
+                    MUSIC_LIBRARY_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create task");
+        __atomic_store_n(&scanning, false, __ATOMIC_RELEASE);
+        Music_Library_Free(base);
+        free(base);
+    }
+}
+
+bool Music_Library_Scanning(void)
+{
+    return __atomic_load_n(&scanning, __ATOMIC_ACQUIRE);
+}
+
+static uint32_t Music_Library_Remap(const Music_Library_t *from, const Music_Library_t *to, uint32_t position)
+{
+    uint16_t count = to->header.track_count;
+    if (position < from->header.track_count) {
+        const Music_Library_Track_t *track = &from->tracks[from->order[position]];
+        const char *file = from->strings + track->file;
+        const char *dir = from->strings + from->dirs[track->dir].path;
+        for (uint16_t n = 0; n < count; n++) {
+            const Music_Library_Track_t *candidate = &to->tracks[to->order[n]];
+            if (strcmp(to->strings + candidate->file, file) == 0 &&
+                strcmp(to->strings + to->dirs[candidate->dir].path, dir) == 0) {
+                return n;
+            }
+        }
+    }
+    return (position < count || count == 0) ? position : (uint32_t)count - 1;
+}
+
+bool Music_Library_Apply(uint32_t *positions, size_t count)
+{
+    Music_Library_t *next = __atomic_exchange_n(&pending, NULL, __ATOMIC_ACQ_REL);
+    if (!next) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        positions[i] = Music_Library_Remap(&library, next, positions[i]);
+    }
+    Music_Library_Free(&library);
+    library = *next;
+    free(next);
+    return true;
+}
+
+uint16_t Music_Library_Count(void)
+{
+    return library.header.track_count;
+}
+
+bool Music_Library_Get(uint16_t position, Music_Track_t *track)
+{
+    if (position >= library.header.track_count) {
+        return false;
+    }
+    const Music_Library_Track_t *t = &library.tracks[library.order[position]];
+    track->dir = library.strings + library.dirs[t->dir].path;
+    track->file = library.strings + t->file;
+    track->title = library.strings + t->title;
+    track->artist = library.strings + t->artist;
+    track->album = library.strings + t->album;
+    track->duration_ms = t->duration_ms;
+    return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "task_plan.h"
+
+/*
+ * The music on the SD card, kept in one binary file so the list needs no
+ * directory walk at boot.
+ *
+ * Music_Library_Init() loads "/sdcard/.music.lib" (a header, then the
+ * directory and track tables, the list order and a string pool, each read
+ * with one fread into PSRAM) and starts a low priority scanner. The
+ * scanner reuses every directory whose mtime is unchanged without listing
+ * it, and every file whose size and mtime are unchanged without opening
+ * it. Only new or changed files are opened for their ID3v2/ID3v1 title,
+ * artist and album and their length. If anything differs the new library
+ * is saved and handed to the GUI task, which takes it with
+ * Music_Library_Apply().
+ *
+ * On the first boot there is no file: the scanner hands over the file
+ * names as soon as the card is listed, then the tags once they are read.
+ *
+ * Everything except Music_Library_Init() is for the GUI task only; the
+ * strings in a Music_Track_t stay valid until the next Music_Library_Apply()
+ * that returns true.
+ */
+
+#define MUSIC_LIBRARY_ROOT          "/sdcard"
+#define MUSIC_LIBRARY_FILE          MUSIC_LIBRARY_ROOT "/.music.lib"
+#define MUSIC_LIBRARY_MAGIC         0x42494C4D  // "MLIB"
+#define MUSIC_LIBRARY_VERSION       1
+#define MUSIC_LIBRARY_MAX_TRACKS    4096
+#define MUSIC_LIBRARY_MAX_DIRS      512
+#define MUSIC_LIBRARY_MAX_DEPTH     6           // Below MUSIC_LIBRARY_ROOT
+#define MUSIC_LIBRARY_TEXT_MAX      64          // Bytes of UTF-8 kept per tag
+#define MUSIC_LIBRARY_PRIORITY      TASK_PLAN_BACKGROUND_PRIORITY   // Beside Music_Index; it mostly waits on the card
+#define MUSIC_LIBRARY_STACK_SIZE    6144        // FATFS keeps long names on the caller's stack
+
+typedef struct {
+    const char *dir;            // For Play_Music()
+    const char *file;
+    const char *title;          // The tag, else the file name without its extension
+    const char *artist;         // "" if not tagged
+    const char *album;
+    uint32_t duration_ms;       // 0 while unknown
+} Music_Track_t;
+
+void Music_Library_Init(void);
+bool Music_Library_Scanning(void);
+
+/*
+ * Takes the scanner's latest library, if there is one.
+ * positions: list positions (the current track, the queued one) that are
+ * moved to where the same files are in the new list; a file that is gone
+ * keeps its number, clamped to the new count.
+ * Returns true if the list changed.
+ */
+bool Music_Library_Apply(uint32_t *positions, size_t count);
+uint16_t Music_Library_Count(void);
+bool Music_Library_Get(uint16_t position, Music_Track_t *track);    // In list order: by title
@@ -1,29 +1,219 @@
 #include "PCM5101.h"
+#include "Power_Manager.h"
+#include "Music_Index.h"
+#include "SD_ReadAhead.h"
+#include "Audio_Reference.h"
+#include "Audio_DSP.h"
+#include "Audio_Prompt.h"
+#include "Audio_Depth.h"
+#include "task_plan.h"
+#include "dsps_mulc.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "telemetry.h"
+#include "telemetry_trace.h"
+#include <math.h>
 
 static const char *TAG = "AUDIO PCM5101"; 
 
 static i2s_chan_handle_t i2s_tx_chan; 
 static i2s_chan_handle_t i2s_rx_chan; 
+static uint32_t i2s_tx_dma_frames;      // Frames the TX DMA queue holds
+static uint32_t i2s_tx_block_frames;    // Frames per DMA buffer
+static uint32_t i2s_tx_byte_rate;       // Of the current clock setting
+static uint32_t i2s_tx_rate;
+static uint8_t i2s_tx_channels;
+
+// Bytes into and out of the TX DMA queue, for Audio_Output_Delay_us()
+static volatile uint32_t tx_written_bytes;
+static volatile uint32_t tx_sent_bytes;
+static volatile int64_t tx_sent_us;     // When the last buffer went out
+
+#if CONFIG_AUDIO_ADAPTIVE_DEPTH
+// DMA buffers the write path may fill (Audio_Depth), of all those allocated;
+// it waits on tx_room, given as each buffer goes out, while at the cap
+static uint32_t tx_dma_buffers;
+static uint32_t tx_cap_bytes = UINT32_MAX;
+static SemaphoreHandle_t tx_room;
+#endif
+
+// Audio_Output_*: held while a direct write is in progress
+static SemaphoreHandle_t output_lock;
+static bool output_active;
+static int64_t output_refused_until_us;     // Local playback just took over
 
 uint8_t Volume = Volume_MAX - 2;
 bool Music_Next_Flag = 0;
+bool Music_Advanced_Flag = 0;
 // static esp_err_t bsp_i2s_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms) {                     // I2S Write Init
 //     return i2s_channel_write(i2s_tx_chan, (char *)audio_buffer, len, bytes_written, timeout_ms);
 // }
-static esp_err_t bsp_i2s_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms) {
-    int16_t *samples = (int16_t *)audio_buffer;
-    size_t sample_count = len / sizeof(int16_t);
-    
-    // Calculate the volume scaling factor to convert the volume level from 0-100 to the 0.0-1.0 range
-    float volume_factor = Volume / 100.0f;
 
+// Q15 gain of the samples last written; ramps towards the Volume target
+static int32_t gain_q15 = -1;
+static int16_t gain_buffer[AUDIO_GAIN_CHUNK_SAMPLES];
+
+static inline int32_t Volume_To_Q15(uint8_t vol) {
+    return (int32_t)vol * INT16_MAX / Volume_MAX;
+}
+
+// Gain <= 1.0 in Q15 cannot overflow int16, so the shift needs no clamp
+static void Audio_Apply_Gain(const int16_t *in, int16_t *out, size_t count, int32_t target) {
+    size_t i = 0;
+    // Linear ramp, one Q15 step per sample at most, so volume changes do not zipper
+    while (i < count && gain_q15 != target) {
+        int32_t diff = target - gain_q15;
+        gain_q15 += diff > AUDIO_GAIN_RAMP_STEP ? AUDIO_GAIN_RAMP_STEP :
+                    diff < -AUDIO_GAIN_RAMP_STEP ? -AUDIO_GAIN_RAMP_STEP : diff;
+        out[i] = (int16_t)(((int32_t)in[i] * gain_q15) >> 15);
+        i++;
+    }
+    if (i < count) {
+        dsps_mulc_s16(in + i, out + i, count - i, (int16_t)gain_q15, 1, 1);
+    }
+}
+
+#if CONFIG_AUDIO_DSP
+// Where the ramp has got to after count more samples
+static int32_t Audio_Ramp_Gain(int32_t target, size_t count) {
+    int32_t diff = target - gain_q15;
+    int32_t reach = (int32_t)count * AUDIO_GAIN_RAMP_STEP;
+    return gain_q15 + (diff > reach ? reach : diff < -reach ? -reach : diff);
+}
+#endif
+
+// When the TX DMA last ran dry (auto_clear is sending silence), 0 if it has not since the last write
+static volatile int64_t tx_starved_us;
+
+static bool IRAM_ATTR Audio_TX_Starved_Callback(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx) {
+    if (tx_starved_us == 0) {
+        tx_starved_us = esp_timer_get_time();
+    }
+    return false;
+}
+
+static bool IRAM_ATTR Audio_TX_Sent_Callback(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx) {
+    // Silence sent by auto_clear while starved was never written
+    uint32_t queued = tx_written_bytes - tx_sent_bytes;
+    tx_sent_bytes += event->size < queued ? event->size : queued;
+    tx_sent_us = esp_timer_get_time();
+    BaseType_t woken = pdFALSE;
+#if CONFIG_AUDIO_ADAPTIVE_DEPTH
+    xSemaphoreGiveFromISR(tx_room, &woken);
+#endif
+    return woken == pdTRUE;
+}
+
+// A write soon after the DMA ran dry is an underrun; a longer gap is a pause or the end of a track
+static void Audio_Check_Underrun(void) {
+    int64_t starved = tx_starved_us;
+    if (starved != 0) {
+        tx_starved_us = 0;
+        if (esp_timer_get_time() - starved < AUDIO_UNDERRUN_GAP_US) {
+            telemetry_record(TELEMETRY_AUDIO_UNDERRUN, 1);
+#if CONFIG_AUDIO_ADAPTIVE_DEPTH
+            Audio_Depth_Underrun();
+#endif
+        }
+    }
+}
 
-    for (size_t i = 0; i < sample_count; i++) {
-        samples[i] = (int16_t)(samples[i] * volume_factor);
+// What the write path may queue changed: the format, or the Audio_Depth cap
+static void Audio_TX_Queue_Changed(void) {
+    uint32_t frames = i2s_tx_dma_frames;
+#if CONFIG_AUDIO_ADAPTIVE_DEPTH
+    frames = tx_dma_buffers * i2s_tx_block_frames;
+    tx_cap_bytes = frames * (i2s_tx_byte_rate / i2s_tx_rate);
+#endif
+    Audio_Reference_Set_Format(i2s_tx_rate, i2s_tx_channels, frames);
+}
+
+#if CONFIG_AUDIO_ADAPTIVE_DEPTH
+// Until bytes more fit under the cap; the DMA keeps sending (silence once
+// starved), so a buffer going out always comes
+static esp_err_t Audio_TX_Wait_Room(size_t bytes, uint32_t timeout_ms) {
+    TickType_t timeout = timeout_ms == portMAX_DELAY ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    TickType_t start = xTaskGetTickCount();
+    while ((tx_written_bytes - tx_sent_bytes) + bytes > tx_cap_bytes) {
+        TickType_t waited = xTaskGetTickCount() - start;
+        if (timeout != portMAX_DELAY && waited >= timeout) {
+            return ESP_ERR_TIMEOUT;
+        }
+        xSemaphoreTake(tx_room, timeout == portMAX_DELAY ? portMAX_DELAY : timeout - waited);
+    }
+    return ESP_OK;
+}
+#endif
+
+// Scales (and with CONFIG_AUDIO_DSP filters and limits) into a scratch
+// buffer: the decoder's frame is left untouched
+static esp_err_t bsp_i2s_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms) {
+    const int16_t *samples = (const int16_t *)audio_buffer;
+    size_t sample_count = len / sizeof(int16_t);
+    int32_t target = Volume_To_Q15(Volume);
+    if (gain_q15 < 0) {
+        gain_q15 = target;
+    }
+    Audio_Check_Underrun();
+#if CONFIG_AUDIO_ADAPTIVE_DEPTH
+    // Local playback only: direct output keeps the depth it finds
+    if (!output_active) {
+        uint32_t buffers = Audio_Depth_Update((uint32_t)((uint64_t)i2s_tx_block_frames * 1000000 / i2s_tx_rate));
+        if (buffers != tx_dma_buffers) {
+            tx_dma_buffers = buffers;
+            Audio_TX_Queue_Changed();
+        }
     }
+#endif
+    TELEMETRY_TRACE_BEGIN(TELEMETRY_TRACE_AUDIO_WRITE);
 
-    return i2s_channel_write(i2s_tx_chan, (char *)audio_buffer, len, bytes_written, timeout_ms);
+    size_t total = 0;
+    esp_err_t ret = ESP_OK;
+    for (size_t offset = 0; offset < sample_count && ret == ESP_OK; offset += AUDIO_GAIN_CHUNK_SAMPLES) {
+        size_t count = sample_count - offset;
+        if (count > AUDIO_GAIN_CHUNK_SAMPLES) {
+            count = AUDIO_GAIN_CHUNK_SAMPLES;
+        }
+#if CONFIG_AUDIO_ADAPTIVE_DEPTH
+        ret = Audio_TX_Wait_Room(count * sizeof(int16_t), timeout_ms);
+        if (ret != ESP_OK) {
+            break;
+        }
+#endif
+#if CONFIG_AUDIO_DSP
+        int32_t gain_from = gain_q15;
+        gain_q15 = Audio_Ramp_Gain(target, count);
+        Audio_DSP_Process(samples + offset, gain_buffer, count, gain_from / 32768.0f, gain_q15 / 32768.0f, Volume);
+#else
+        Audio_Apply_Gain(samples + offset, gain_buffer, count, target);
+#endif
+        size_t written = 0;
+        ret = i2s_channel_write(i2s_tx_chan, (char *)gain_buffer, count * sizeof(int16_t), &written, timeout_ms);
+        tx_written_bytes += written;
+        // What the speaker plays, for the microphone's echo canceller
+        Audio_Reference_Write(gain_buffer, written / sizeof(int16_t));
+        total += written;
+    }
+    TELEMETRY_TRACE_END(TELEMETRY_TRACE_AUDIO_WRITE);
+    if (bytes_written) {
+        *bytes_written = total;
+    }
+    return ret;
 }
+#if CONFIG_ESPCASTER_BENCH
+uint32_t Audio_Gain_Bench(const int16_t *in, int16_t *out, size_t count, bool ramp) {
+    int32_t saved = gain_q15;
+    int32_t target = Volume_To_Q15(Volume_MAX / 2);
+    gain_q15 = ramp ? 0 : target;
+    uint32_t start = esp_cpu_get_cycle_count();
+    Audio_Apply_Gain(in, out, count, target);
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+    gain_q15 = saved;
+    return cycles;
+}
+#endif
+
 static esp_err_t bsp_i2s_reconfig_clk(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch) {                                   // I2S Init
     esp_err_t ret = ESP_OK; 
     i2s_std_config_t std_cfg = {
@@ -35,6 +225,14 @@ static esp_err_t bsp_i2s_reconfig_clk(uint32_t rate, uint32_t bits_cfg, i2s_slot
     ret |= i2s_channel_reconfig_std_clock(i2s_tx_chan, &std_cfg.clk_cfg);
     ret |= i2s_channel_reconfig_std_slot(i2s_tx_chan, &std_cfg.slot_cfg);
     ret |= i2s_channel_enable(i2s_tx_chan); 
+    i2s_tx_rate = rate;
+    i2s_tx_channels = ch == I2S_SLOT_MODE_MONO ? 1 : 2;
+    i2s_tx_byte_rate = rate * i2s_tx_channels * (bits_cfg / 8);
+    tx_sent_bytes = tx_written_bytes;      // The queue starts empty again
+    Audio_TX_Queue_Changed();
+#if CONFIG_AUDIO_DSP
+    Audio_DSP_Set_Format(rate, ch == I2S_SLOT_MODE_MONO ? 1 : 2);
+#endif
     return ret; 
 }
 
@@ -46,11 +244,24 @@ static esp_err_t audio_mute_function(AUDIO_PLAYER_MUTE_SETTING setting) {
 static esp_err_t bsp_audio_init(const i2s_std_config_t *i2s_config, i2s_chan_handle_t *tx_channel, i2s_chan_handle_t *rx_channel) {     // Audio Init
     i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(CONFIG_BSP_I2S_NUM, I2S_ROLE_MASTER);
     chan_cfg.auto_clear = true; 
+#if CONFIG_AUDIO_ADAPTIVE_DEPTH
+    // All of them up front: Audio_Depth caps how many are used
+    chan_cfg.dma_desc_num = CONFIG_AUDIO_DEPTH_DMA_BUFFERS_MAX;
+    tx_dma_buffers = chan_cfg.dma_desc_num;
+    tx_room = xSemaphoreCreateBinary();
+#endif
+    i2s_tx_dma_frames = chan_cfg.dma_desc_num * chan_cfg.dma_frame_num;
+    i2s_tx_block_frames = chan_cfg.dma_frame_num;
     ESP_ERROR_CHECK(i2s_new_channel(&chan_cfg, tx_channel, rx_channel)); 
     const i2s_std_config_t std_cfg_default = BSP_I2S_DUPLEX_MONO_CFG(22050); 
     const i2s_std_config_t *p_i2s_cfg = (i2s_config != NULL) ? i2s_config : &std_cfg_default; 
     if (tx_channel) {
         ESP_ERROR_CHECK(i2s_channel_init_std_mode(*tx_channel, p_i2s_cfg));
+        const i2s_event_callbacks_t tx_callbacks = {
+            .on_sent = Audio_TX_Sent_Callback,
+            .on_send_q_ovf = Audio_TX_Starved_Callback,
+        };
+        ESP_ERROR_CHECK(i2s_channel_register_event_callback(*tx_channel, &tx_callbacks, NULL));
         ESP_ERROR_CHECK(i2s_channel_enable(*tx_channel)); 
     }
     if (rx_channel) {
@@ -60,16 +271,101 @@ static esp_err_t bsp_audio_init(const i2s_std_config_t *i2s_config, i2s_chan_han
     return ESP_OK; 
 }
 
+#if defined(CONFIG_AUDIO_PLAYER_MIXER)
+// Effects are synthesised once into PSRAM as raw PCM at the output rate, so playing one costs no decoding
+static audio_player_clip_t effect_clips[AUDIO_EFFECT_COUNT];
+
+static const struct {
+    float freq[2];              // Hz, one per half of the clip
+    uint16_t ms;
+    float decay;                // Envelope time constant in ms
+    float gain;
+    bool duck;
+} effect_specs[AUDIO_EFFECT_COUNT] = {
+    [AUDIO_EFFECT_CLICK]  = { { 3000.0f, 3000.0f }, 8, 1.5f, 0.5f, false },
+    [AUDIO_EFFECT_NOTIFY] = { { 880.0f, 1320.0f }, 300, 60.0f, 0.7f, true },
+};
+
+static void Audio_Effects_Init(void) {
+    const float rate = CONFIG_AUDIO_PLAYER_OUTPUT_RATE;
+    const size_t attack = CONFIG_AUDIO_PLAYER_OUTPUT_RATE / 1000;   // 1 ms, so a tone has no click of its own
+    for (int e = 0; e < AUDIO_EFFECT_COUNT; e++) {
+        size_t frames = (size_t)(rate * effect_specs[e].ms / 1000);
+        int16_t *samples = heap_caps_malloc(frames * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+        if (!samples) {
+            ESP_LOGE(TAG, "No memory for sound effect %d", e);
+            continue;
+        }
+        size_t half = frames / 2;
+        float phase = 0;
+        for (size_t n = 0; n < frames; n++) {
+            size_t t = (n < half) ? n : n - half;   // Each tone starts its own envelope
+            float envelope = expf(-(t * 1000.0f / rate) / effect_specs[e].decay);
+            if (t < attack) {
+                envelope *= (float)t / attack;
+            }
+            phase += 2.0f * (float)M_PI * effect_specs[e].freq[n < half ? 0 : 1] / rate;
+            samples[n] = (int16_t)(sinf(phase) * envelope * INT16_MAX);
+        }
+        effect_clips[e] = (audio_player_clip_t){ .samples = samples, .frames = frames, .channels = 1 };
+    }
+}
+
+esp_err_t Audio_Play_Clip(const audio_player_clip_t *clip, float gain, bool duck) {
+    // The player's writer would interleave the clip with direct output
+    if (output_active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return audio_player_play_clip(clip, gain, duck);
+}
+
+void Audio_Play_Effect(Audio_Effect_t effect) {
+    if (effect >= AUDIO_EFFECT_COUNT || !effect_clips[effect].samples || output_active) {
+        return;
+    }
+    esp_err_t ret = Audio_Play_Clip(&effect_clips[effect], effect_specs[effect].gain, effect_specs[effect].duck);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Sound effect %d: %s", effect, esp_err_to_name(ret));
+    }
+}
+#else
+static void Audio_Effects_Init(void) {
+}
+
+esp_err_t Audio_Play_Clip(const audio_player_clip_t *clip, float gain, bool duck) {
+    (void)clip;
+    (void)gain;
+    (void)duck;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void Audio_Play_Effect(Audio_Effect_t effect) {
+    (void)effect;
+}
+#endif
+
 static FILE * Music_File = NULL;
 static audio_player_callback_event_t expected_event; 
 static QueueHandle_t event_queue; 
 static audio_player_callback_event_t event; 
 
 static void audio_player_callback(audio_player_cb_ctx_t *ctx) {
+    // Decode at full clock while playing; DFS may scale down once paused or finished
+    if (ctx->audio_event == AUDIO_PLAYER_CALLBACK_EVENT_PLAYING) {
+        Power_Hold(POWER_LOCK_AUDIO, true);
+    } else if (ctx->audio_event == AUDIO_PLAYER_CALLBACK_EVENT_PAUSE ||
+               ctx->audio_event == AUDIO_PLAYER_CALLBACK_EVENT_IDLE) {
+        Power_Hold(POWER_LOCK_AUDIO, false);
+    }
     if (ctx->audio_event == AUDIO_PLAYER_CALLBACK_EVENT_IDLE) {
         ESP_LOGI(TAG, "Playback finished");
         Music_Next_Flag = 1;
     }
+    // Play_Music() pauses first, so only a queued track taking over gets here
+    if (ctx->audio_event == AUDIO_PLAYER_CALLBACK_EVENT_COMPLETED_PLAYING_NEXT) {
+        ESP_LOGI(TAG, "Queued track started");
+        Music_Advanced_Flag = 1;
+    }
     if (ctx->audio_event == expected_event) {
         xQueueSend(event_queue, &(ctx->audio_event), 0);
     }
@@ -87,18 +383,34 @@ void Audio_Init(void)
         ESP_LOGE(TAG, "Failed to initialize audio: %s", esp_err_to_name(ret));
         return;
     }
+    i2s_tx_rate = 44100;
+    i2s_tx_channels = 2;
+    i2s_tx_byte_rate = 44100 * 2 * sizeof(int16_t);
+    Audio_TX_Queue_Changed();
+#if CONFIG_AUDIO_DSP
+    Audio_DSP_Init();
+    Audio_DSP_Set_Format(44100, 2);
+#endif
+    output_lock = xSemaphoreCreateMutex();
     audio_player_config_t config = { 
         .mute_fn = audio_mute_function,
         .write_fn = bsp_i2s_write,
         .clk_set_fn = bsp_i2s_reconfig_clk,
-        .priority = 3,
-        .coreID = 1 
+        .priority = TASK_PLAN_AUDIO_DECODE_PRIORITY,      // Its writer runs one above
+        .coreID = TASK_PLAN_AUDIO_DECODE_CORE,
+        // Mono goes out as I2S mono (both slots); the gain and DSP stages are 16-bit
+        .output_caps = AUDIO_PLAYER_OUTPUT_MONO | AUDIO_PLAYER_OUTPUT_STEREO | AUDIO_PLAYER_OUTPUT_16BIT,
     };
     ret = audio_player_new(config);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to create audio player: %s", esp_err_to_name(ret));
         return;
     }
+#if CONFIG_AUDIO_ADAPTIVE_DEPTH
+    Audio_Depth_Init(tx_dma_buffers);
+    tx_dma_buffers = Audio_Depth_DMA_Buffers();
+    Audio_TX_Queue_Changed();
+#endif
     event_queue = xQueueCreate(1, sizeof(audio_player_callback_event_t));
     if (!event_queue) {
         ESP_LOGE(TAG, "Failed to create event queue");
@@ -113,20 +425,92 @@ void Audio_Init(void)
         ESP_LOGE(TAG, "Expected state to be IDLE");                 // The player is not idle
         return;
     }
+    Audio_Effects_Init();
+    Audio_Prompt_Init();
+    Music_Index_Init();
 }
-void Play_Music(const char* directory, const char* fileName)
-{  
-    Music_pause();
-    const int maxPathLength = 100; 
-    char filePath[maxPathLength];
+
+bool Audio_Output_Begin(void)
+{
+    if (!output_lock || audio_player_get_state() == AUDIO_PLAYER_STATE_PLAYING ||
+        esp_timer_get_time() < output_refused_until_us) {
+        return false;
+    }
+    xSemaphoreTake(output_lock, portMAX_DELAY);
+    if (!output_active) {
+        // The player's own format (it resamples to it), so it need not reconfigure after us
+        bsp_i2s_reconfig_clk(AUDIO_OUTPUT_RATE, I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO);
+        output_active = true;
+    }
+    xSemaphoreGive(output_lock);
+    return true;
+}
+esp_err_t Audio_Output_Write(const int16_t *frames, size_t frame_count)
+{
+    xSemaphoreTake(output_lock, portMAX_DELAY);
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+    if (output_active) {
+        ret = bsp_i2s_write((void *)frames, frame_count * AUDIO_OUTPUT_CHANNELS * sizeof(int16_t), NULL, AUDIO_OUTPUT_TIMEOUT_MS);
+    }
+    xSemaphoreGive(output_lock);
+    return ret;
+}
+int64_t Audio_Output_Delay_us(void)
+{
+    int64_t now = esp_timer_get_time();
+    int32_t queued = (int32_t)(tx_written_bytes - tx_sent_bytes);
+    if (queued <= 0 || i2s_tx_byte_rate == 0) {
+        return 0;
+    }
+    // The whole queue, less what of the buffer in flight has gone out since it started
+    int64_t delay = (int64_t)queued * 1000000 / i2s_tx_byte_rate - (now - tx_sent_us);
+#if CONFIG_AUDIO_DSP
+    delay += Audio_DSP_Latency_us();           // The limiter holds this much back
+#endif
+    return delay > 0 ? delay : 0;
+}
+size_t Audio_Output_Block_Frames(void)
+{
+    return i2s_tx_block_frames;
+}
+void Audio_Output_End(void)
+{
+    if (!output_lock) {
+        return;
+    }
+    // Once this returns no direct write is in progress or will start
+    xSemaphoreTake(output_lock, portMAX_DELAY);
+    output_active = false;
+    xSemaphoreGive(output_lock);
+}
+// Local playback is starting: direct output stops, and stays refused until
+// the player has had the time to report PLAYING
+static void Audio_Output_Preempt(void)
+{
+    output_refused_until_us = esp_timer_get_time() + AUDIO_OUTPUT_PREEMPT_MS * 1000;
+    Audio_Output_End();
+}
+static FILE *Music_Open(const char* directory, const char* fileName, char *filePath)
+{
+    const int maxPathLength = MUSIC_INDEX_PATH_MAX; 
     if (strcmp(directory, "/") == 0) {                                               
         snprintf(filePath, maxPathLength, "%s%s", directory, fileName);   
     } else {                                                            
         snprintf(filePath, maxPathLength, "%s/%s", directory, fileName);
     }
-    Music_File = Open_File(filePath);
-    if (!Music_File) {
+    FILE *file = Open_File_ReadAhead(filePath);
+    if (!file) {
         ESP_LOGE(TAG, "Failed to open MP3 file: %s", filePath);
+    }
+    return file;
+}
+void Play_Music(const char* directory, const char* fileName)
+{  
+    Audio_Output_Preempt();
+    Music_pause();
+    char filePath[MUSIC_INDEX_PATH_MAX];
+    Music_File = Music_Open(directory, fileName, filePath);
+    if (!Music_File) {
         return;
     }
 
@@ -147,9 +531,49 @@ void Play_Music(const char* directory, const char* fileName)
         fclose(Music_File);
         return;
     }
+    Music_Index_Request(filePath, Music_File);
+}
+void Queue_Music(const char* directory, const char* fileName)
+{
+    char filePath[MUSIC_INDEX_PATH_MAX];
+    FILE *file = Music_Open(directory, fileName, filePath);
+    if (!file) {
+        return;
+    }
+    esp_err_t ret = audio_player_queue(file);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to queue audio: %s", esp_err_to_name(ret));
+        fclose(file);
+        return;
+    }
+    Music_Index_Request(filePath, file);
+}
+void Play_Stream(const char* url, audio_stream_title_cb_t on_title)
+{
+    Audio_Output_Preempt();
+    Music_pause();
+    audio_player_source_t source;
+    esp_err_t ret = Audio_Stream_Open(url, on_title, &source);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open stream %s: %s", url, esp_err_to_name(ret));
+        return;
+    }
+
+    // Waiting for PLAYING covers the prebuffer, so allow more than for a file
+    expected_event = AUDIO_PLAYER_CALLBACK_EVENT_PLAYING;
+    ret = audio_player_play_source(&source);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to play stream: %s", esp_err_to_name(ret));
+        source.close(source.ctx);
+        return;
+    }
+    if (xQueueReceive(event_queue, &event, pdMS_TO_TICKS(AUDIO_STREAM_TIMEOUT_MS)) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to receive playing event for stream");
+    }
 }
 void Music_resume(void)
 {
+    Audio_Output_Preempt();
     if (audio_player_get_state() != AUDIO_PLAYER_STATE_PLAYING){
         expected_event = AUDIO_PLAYER_CALLBACK_EVENT_PLAYING;
         esp_err_t ret = audio_player_resume();
@@ -193,6 +617,25 @@ void Music_pause(void)
     }
 }
 
+void Music_Seek(uint32_t position_ms)
+{
+    esp_err_t ret = audio_player_seek(position_ms);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to seek: %s", esp_err_to_name(ret));
+    }
+}
+uint32_t Music_Duration(void)
+{
+    uint32_t duration_ms = 0;
+    audio_player_get_position(NULL, &duration_ms);
+    return duration_ms;
+}
+uint32_t Music_Elapsed(void)
+{
+    uint32_t position_ms = 0;
+    audio_player_get_position(&position_ms, NULL);
+    return position_ms;
+}
 
 void Volume_adjustment(uint8_t Vol) {
     if(Vol > Volume_MAX )
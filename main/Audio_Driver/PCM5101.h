@@ -8,6 +8,7 @@
 #include "freertos/semphr.h" 
 
 #include "SD_MMC.h"
+#include "Audio_Stream.h"
 
 #define CONFIG_BSP_I2S_NUM 0
 
@@ -41,14 +42,59 @@
     }
 
 #define Volume_MAX  100
+// Volume is applied in Q15 on chunks of this many samples (dsps_mulc_s16);
+// a change ramps by AUDIO_GAIN_RAMP_STEP per sample, ~15 ms for full scale
+// at 44.1 kHz stereo
+#define AUDIO_GAIN_CHUNK_SAMPLES    512
+#define AUDIO_GAIN_RAMP_STEP        24
+
+// The TX DMA running dry counts as an underrun if the next write comes within this
+#define AUDIO_UNDERRUN_GAP_US       (500 * 1000)
 extern bool Music_Next_Flag;
+extern bool Music_Advanced_Flag;        // A track queued with Queue_Music() has taken over
 extern uint8_t Volume;
 void Audio_Init(void);
 void Play_Music(const char* directory, const char* fileName);
+void Queue_Music(const char* directory, const char* fileName);   // Plays gaplessly after the current one
+void Play_Stream(const char* url, audio_stream_title_cb_t on_title);     // HTTP(S)/ICY, no SD card needed
 void Music_resume(void);
 void Music_pause(void);
 
-uint32_t Music_Duration(void);
-uint32_t Music_Elapsed(void);
+void Music_Seek(uint32_t position_ms);    // Playing or paused
+uint32_t Music_Duration(void);              // ms, 0 while unknown
+uint32_t Music_Elapsed(void);               // ms
 uint16_t Music_Energy(void);
-void Volume_adjustment(uint8_t Volume);
\ No newline at end of file
+void Volume_adjustment(uint8_t Volume);
+
+// Direct output, for a source that schedules its own samples (the multi-room
+// client): interleaved stereo PCM at the player's output rate goes through
+// the volume stage straight into the I2S DMA queue, with no decoder or PCM
+// buffers in between. Local playback comes first: Begin fails while the
+// player is playing, and Play_Music(), Play_Stream() and Music_resume() end
+// direct output, after which Audio_Output_Write() returns ESP_ERR_INVALID_STATE.
+#define AUDIO_OUTPUT_RATE           CONFIG_AUDIO_PLAYER_OUTPUT_RATE
+#define AUDIO_OUTPUT_CHANNELS       2
+#define AUDIO_OUTPUT_TIMEOUT_MS     100
+#define AUDIO_OUTPUT_PREEMPT_MS     AUDIO_STREAM_TIMEOUT_MS    // Begin refused this long after local
+                                                            // playback started: a stream's prebuffer
+bool Audio_Output_Begin(void);
+esp_err_t Audio_Output_Write(const int16_t *frames, size_t frame_count);
+int64_t Audio_Output_Delay_us(void);        // Until a frame written now is heard
+size_t Audio_Output_Block_Frames(void);     // Frames per DMA buffer
+void Audio_Output_End(void);
+
+// UI sound effects, mixed over whatever is playing (CONFIG_AUDIO_PLAYER_MIXER)
+typedef enum {
+    AUDIO_EFFECT_CLICK,         // Short tick for touch feedback
+    AUDIO_EFFECT_NOTIFY,        // Two-tone chime; ducks the music while it sounds
+    AUDIO_EFFECT_COUNT
+} Audio_Effect_t;
+void Audio_Play_Effect(Audio_Effect_t effect);
+// Any other clip (spoken prompts); ESP_ERR_INVALID_STATE during direct output
+esp_err_t Audio_Play_Clip(const audio_player_clip_t *clip, float gain, bool duck);
+
+#if CONFIG_ESPCASTER_BENCH
+// CPU cycles of bsp_i2s_write()'s gain stage on count samples, at steady
+// volume or ramping through a volume change; leaves playback state alone
+uint32_t Audio_Gain_Bench(const int16_t *in, int16_t *out, size_t count, bool ramp);
+#endif
\ No newline at end of file
@@ -0,0 +1,680 @@
+#include "Snapcast_Client.h"
+#include "sdkconfig.h"
+
+#if CONFIG_SNAPCAST_CLIENT
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "cJSON.h"
+#include "mdns.h"
+#include "PCM5101.h"
+#include "telemetry.h"
+#include "mem_tag.h"
+#include "mem_task.h"
+
+static const char *TAG = "SNAPCAST";
+
+#define SNAP_FRAME_BYTES        (AUDIO_OUTPUT_CHANNELS * sizeof(int16_t))
+#define SNAP_PAD_MAX_US         50000       // Early by more than this: sleep first, then pad
+#define SNAP_HOST_MAX           64
+#define SNAP_SMALL_MESSAGE      512
+
+enum {
+    SNAP_MSG_CODEC_HEADER = 1,
+    SNAP_MSG_WIRE_CHUNK = 2,
+    SNAP_MSG_SERVER_SETTINGS = 3,
+    SNAP_MSG_TIME = 4,
+    SNAP_MSG_HELLO = 5,
+};
+
+// Every message starts with this, little-endian like the ESP32
+typedef struct __attribute__((packed)) {
+    uint16_t type;
+    uint16_t id;
+    uint16_t refers_to;
+    int32_t sent_sec;
+    int32_t sent_usec;
+    int32_t received_sec;
+    int32_t received_usec;
+    uint32_t size;              // Of the payload that follows
+} snap_header_t;
+
+typedef struct __attribute__((packed)) {
+    int32_t sec;
+    int32_t usec;
+    uint32_t size;
+} snap_chunk_header_t;
+
+typedef struct {
+    int64_t server_us;          // Server time of the first frame
+    uint32_t frames;
+    int16_t samples[];          // Interleaved stereo
+} snap_chunk_t;
+
+// Where playback is in the jitter buffer
+typedef struct {
+    snap_chunk_t *chunk;
+    uint32_t pos;               // Next frame of chunk
+} snap_cursor_t;
+
+static struct {
+    volatile bool running;
+    volatile int sock;
+    QueueHandle_t chunks;       // snap_chunk_t *, oldest first
+    SemaphoreHandle_t done;     // Given by each task as it exits
+    portMUX_TYPE spin;          // Guards offset_us and playout_us
+
+    int64_t offset_us;          // Server clock - esp_timer
+    int64_t playout_us;         // The server's buffer less this client's latency setting
+    volatile bool clock_valid;
+    volatile bool format_ok;
+    int64_t history[SNAPCAST_TIME_HISTORY];
+    size_t history_count;
+    size_t history_next;
+
+    uint16_t next_id;
+    int volume;                 // Last applied from the server, -1 for none
+} snap = {
+    .sock = -1,
+    .spin = portMUX_INITIALIZER_UNLOCKED,
+    .volume = -1,
+};
+
+/**********************************************************************************
+ * Clock
+ **********************************************************************************/
+static int Snap_Compare(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void Snap_Reset_Clock(void)
+{
+    snap.history_count = 0;
+    snap.history_next = 0;
+    snap.clock_valid = false;
+}
+
+// One Time exchange: c2s = server receive - our send, s2c = our receive - server send
+static void Snap_Add_Offset(int64_t c2s_us, int64_t s2c_us)
+{
+    snap.history[snap.history_next] = (c2s_us - s2c_us) / 2;
+    snap.history_next = (snap.history_next + 1) % SNAPCAST_TIME_HISTORY;
+    if (snap.history_count < SNAPCAST_TIME_HISTORY) {
+        snap.history_count++;
+    }
+
+    int64_t sorted[SNAPCAST_TIME_HISTORY];
+    memcpy(sorted, snap.history, snap.history_count * sizeof(sorted[0]));
+    qsort(sorted, snap.history_count, sizeof(sorted[0]), Snap_Compare);
+    taskENTER_CRITICAL(&snap.spin);
+    snap.offset_us = sorted[snap.history_count / 2];
+    taskEXIT_CRITICAL(&snap.spin);
+    snap.clock_valid = true;
+}
+
+// Local time the cursor's next frame is due to be heard
+static int64_t Snap_Due_us(const snap_cursor_t *c)
+{
+    taskENTER_CRITICAL(&snap.spin);
+    int64_t shift = snap.playout_us - snap.offset_us;
+    taskEXIT_CRITICAL(&snap.spin);
+    return c->chunk->server_us + (int64_t)c->pos * 1000000 / AUDIO_OUTPUT_RATE + shift;
+}
+
+/**********************************************************************************
+ * Jitter buffer and playback
+ **********************************************************************************/
+// Up to count frames from the jitter buffer into out, or dropped if out is NULL
+static size_t Snap_Take(snap_cursor_t *c, int16_t *out, size_t count)
+{
+    size_t taken = 0;
+    while (taken < count) {
+        if (!c->chunk && xQueueReceive(snap.chunks, &c->chunk, 0) != pdTRUE) {
+            c->chunk = NULL;
+            break;
+        }
+        size_t n = c->chunk->frames - c->pos;
+        if (n > count - taken) {
+            n = count - taken;
+        }
+        if (out) {
+            memcpy(out + taken * AUDIO_OUTPUT_CHANNELS, c->chunk->samples + c->pos * AUDIO_OUTPUT_CHANNELS,
+                   n * SNAP_FRAME_BYTES);
+        }
+        c->pos += n;
+        taken += n;
+        if (c->pos >= c->chunk->frames) {
+            heap_caps_free(c->chunk);
+            c->chunk = NULL;
+            c->pos = 0;
+        }
+    }
+    return taken;
+}
+
+static size_t Snap_Frames(int64_t us)
+{
+    return (size_t)(us * AUDIO_OUTPUT_RATE / 1000000);
+}
+
+static bool Snap_Write_Silence(int16_t *block, size_t block_frames, size_t frames)
+{
+    memset(block, 0, block_frames * SNAP_FRAME_BYTES);
+    while (frames > 0) {
+        size_t n = frames < block_frames ? frames : block_frames;
+        if (Audio_Output_Write(block, n) != ESP_OK) {
+            return false;
+        }
+        frames -= n;
+    }
+    return true;
+}
+
+static void Snap_Play_Task(void *arg)
+{
+    const size_t block = Audio_Output_Block_Frames();
+    int16_t *out = heap_caps_malloc((block + 1) * SNAP_FRAME_BYTES, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    snap_cursor_t cursor = { 0 };
+    bool owned = false;
+    bool synced = false;
+    int64_t error_avg = 0;
+    if (!out) {
+        ESP_LOGE(TAG, "No memory for the playback block");
+    }
+
+    while (snap.running && out) {
+        if (!cursor.chunk) {
+            if (xQueueReceive(snap.chunks, &cursor.chunk, pdMS_TO_TICKS(SNAPCAST_IDLE_MS)) != pdTRUE) {
+                cursor.chunk = NULL;
+                if (owned) {
+                    ESP_LOGI(TAG, "Stream idle, output back to the player");
+                    Audio_Output_End();
+                    owned = false;
+                }
+                synced = false;
+                continue;
+            }
+            cursor.pos = 0;
+        }
+
+        int64_t heard = esp_timer_get_time() + Audio_Output_Delay_us() + SNAPCAST_DAC_DELAY_US;
+        int64_t error = heard - Snap_Due_us(&cursor);      // > 0: late
+
+        if (!owned) {
+            if (!Audio_Output_Begin()) {
+                // Local playback has the output: keep up with the stream silently
+                if (error > 0) {
+                    Snap_Take(&cursor, NULL, Snap_Frames(error));
+                }
+                vTaskDelay(pdMS_TO_TICKS(20));
+                continue;
+            }
+            owned = true;
+            synced = false;
+            continue;               // The clock was reconfigured; measure again
+        }
+
+        if (!synced) {
+            if (error > 0) {
+                Snap_Take(&cursor, NULL, Snap_Frames(error) + 1);
+                continue;
+            }
+            if (-error > SNAP_PAD_MAX_US) {
+                vTaskDelay(pdMS_TO_TICKS((-error - SNAP_PAD_MAX_US) / 1000) + 1);
+                continue;
+            }
+            // Silence up to the frame's due time, so it is heard to the sample
+            if (!Snap_Write_Silence(out, block, Snap_Frames(-error))) {
+                owned = false;
+                continue;
+            }
+            ESP_LOGI(TAG, "In sync, %lld us of silence ahead", (long long)-error);
+            synced = true;
+            error_avg = 0;
+            continue;
+        }
+
+        if (error > SNAPCAST_RESYNC_US || error < -SNAPCAST_RESYNC_US) {
+            ESP_LOGW(TAG, "Off by %lld us, resyncing", (long long)error);
+            synced = false;
+            continue;
+        }
+        telemetry_record(TELEMETRY_SYNC_ERROR, (uint32_t)(error < 0 ? -error : error));
+        error_avg += (error - error_avg) / 32;
+
+        // Rate trim: one frame dropped (late) or repeated (early) in the middle of the block
+        int trim = error_avg > SNAPCAST_TRIM_US ? 1 : error_avg < -SNAPCAST_TRIM_US ? -1 : 0;
+        size_t got = Snap_Take(&cursor, out, block + trim);
+        const size_t mid = block / 2;
+        if (got == block + trim && trim != 0) {
+            int16_t *at = out + mid * AUDIO_OUTPUT_CHANNELS;
+            if (trim > 0) {
+                memmove(at, at + AUDIO_OUTPUT_CHANNELS, (got - mid - 1) * SNAP_FRAME_BYTES);
+            } else {
+                memmove(at + AUDIO_OUTPUT_CHANNELS, at, (got - mid) * SNAP_FRAME_BYTES);
+            }
+            got = block;
+            error_avg -= trim * 1000000LL / AUDIO_OUTPUT_RATE;     // Its effect, before the average sees it
+        }
+        if (got < block) {
+            // The buffer ran dry: what there is, then sync again on the next chunk
+            memset(out + got * AUDIO_OUTPUT_CHANNELS, 0, (block - got) * SNAP_FRAME_BYTES);
+            synced = false;
+        }
+        if (Audio_Output_Write(out, block) != ESP_OK) {
+            ESP_LOGI(TAG, "Local playback took the output");
+            owned = false;
+            synced = false;
+        }
+    }
+
+    if (owned) {
+        Audio_Output_End();
+    }
+    if (cursor.chunk) {
+        heap_caps_free(cursor.chunk);
+    }
+    heap_caps_free(out);
+    xSemaphoreGive(snap.done);
+    mem_task_delete(NULL);
+}
+
+/**********************************************************************************
+ * Protocol
+ **********************************************************************************/
+static bool Snap_Send(int sock, uint16_t type, const void *payload, uint32_t size)
+{
+    uint8_t message[SNAP_SMALL_MESSAGE];
+    if (sizeof(snap_header_t) + size > sizeof(message)) {
+        return false;
+    }
+    int64_t now = esp_timer_get_time();
+    snap_header_t header = {
+        .type = type,
+        .id = snap.next_id++,
+        .sent_sec = (int32_t)(now / 1000000),
+        .sent_usec = (int32_t)(now % 1000000),
+        .size = size,
+    };
+    memcpy(message, &header, sizeof(header));
+    memcpy(message + sizeof(header), payload, size);
+
+    // One write, so a Time request does not wait on a second segment
+    size_t length = sizeof(header) + size;
+    for (size_t sent = 0; sent < length;) {
+        int n = send(sock, message + sent, length - sent, 0);
+        if (n <= 0) {
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+static bool Snap_Send_Hello(int sock)
+{
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    char id[18];
+    snprintf(id, sizeof(id), "%02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+    char payload[SNAP_SMALL_MESSAGE - sizeof(snap_header_t)];
+    int json = snprintf(payload + 4, sizeof(payload) - 4,
+                        "{\"Arch\":\"xtensa\",\"ClientName\":\"ESPCaster\",\"HostName\":\"espcaster\","
+                        "\"ID\":\"%s\",\"Instance\":1,\"MAC\":\"%s\",\"OS\":\"ESP-IDF\","
+                        "\"SnapStreamProtocolVersion\":2,\"Version\":\"0.26.0\"}", id, id);
+    if (json <= 0 || json >= (int)sizeof(payload) - 4) {
+        return false;
+    }
+    uint32_t length = (uint32_t)json;
+    memcpy(payload, &length, sizeof(length));
+    return Snap_Send(sock, SNAP_MSG_HELLO, payload, sizeof(length) + length);
+}
+
+// 1 once len bytes are in, 0 on a timeout before the first byte (if may_idle), -1 on error or Stop
+static int Snap_Recv(int sock, void *buf, size_t len, bool may_idle)
+{
+    size_t got = 0;
+    while (got < len) {
+        int n = recv(sock, (uint8_t *)buf + got, len - got, 0);
+        if (n > 0) {
+            got += n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && snap.running) {
+            if (got == 0 && may_idle) {
+                return 0;
+            }
+            continue;
+        }
+        return -1;
+    }
+    return 1;
+}
+
+static void Snap_Codec_Header(const uint8_t *p, uint32_t size)
+{
+    snap.format_ok = false;
+    uint32_t codec_len = 0;
+    uint32_t header_len = 0;
+    if (size < 8 || (memcpy(&codec_len, p, 4), codec_len > size - 8)) {
+        return;
+    }
+    char codec[16];
+    snprintf(codec, sizeof(codec), "%.*s", (int)codec_len, (const char *)p + 4);
+    memcpy(&header_len, p + 4 + codec_len, 4);
+    const uint8_t *wav = p + 8 + codec_len;
+    if (strcmp(codec, "pcm") != 0 || header_len > size - 8 - codec_len) {
+        ESP_LOGE(TAG, "Codec %s is not played here; set codec=pcm on the server's stream", codec);
+        return;
+    }
+
+    // RIFF/WAVE: walk the chunks to "fmt "
+    if (header_len < 12 || memcmp(wav, "RIFF", 4) != 0 || memcmp(wav + 8, "WAVE", 4) != 0) {
+        return;
+    }
+    for (uint32_t pos = 12; pos + 8 <= header_len;) {
+        uint32_t chunk_len;
+        memcpy(&chunk_len, wav + pos + 4, 4);
+        if (memcmp(wav + pos, "fmt ", 4) == 0 && chunk_len >= 16 && pos + 8 + chunk_len <= header_len) {
+            uint16_t channels, bits;
+            uint32_t rate;
+            memcpy(&channels, wav + pos + 10, 2);
+            memcpy(&rate, wav + pos + 12, 4);
+            memcpy(&bits, wav + pos + 22, 2);
+            snap.format_ok = rate == AUDIO_OUTPUT_RATE && channels == AUDIO_OUTPUT_CHANNELS && bits == 16;
+            if (snap.format_ok) {
+                ESP_LOGI(TAG, "Stream is %lu:%u:%u", (unsigned long)rate, bits, channels);
+            } else {
+                ESP_LOGE(TAG, "Stream is %lu:%u:%u, only %d:16:%d is played", (unsigned long)rate, bits,
+                         channels, AUDIO_OUTPUT_RATE, AUDIO_OUTPUT_CHANNELS);
+            }
+            return;
+        }
+        pos += 8 + chunk_len;
+    }
+}
+
+static void Snap_Server_Settings(const uint8_t *p, uint32_t size)
+{
+    uint32_t length = 0;
+    if (size < 4 || (memcpy(&length, p, 4), length > size - 4)) {
+        return;
+    }
+    cJSON *json = cJSON_ParseWithLength((const char *)p + 4, length);
+    if (!json) {
+        return;
+    }
+    const cJSON *buffer_ms = cJSON_GetObjectItem(json, "bufferMs");
+    const cJSON *latency = cJSON_GetObjectItem(json, "latency");
+    const cJSON *volume = cJSON_GetObjectItem(json, "volume");
+    int64_t playout = (int64_t)((cJSON_IsNumber(buffer_ms) ? buffer_ms->valueint : 1000) -
+                                (cJSON_IsNumber(latency) ? latency->valueint : 0)) * 1000;
+    taskENTER_CRITICAL(&snap.spin);
+    snap.playout_us = playout;
+    taskEXIT_CRITICAL(&snap.spin);
+
+    // The group's volume for this client; only a change, so the local setting stands otherwise
+    int level = cJSON_IsNumber(volume) ? volume->valueint : snap.volume;
+    if (cJSON_IsTrue(cJSON_GetObjectItem(json, "muted"))) {
+        level = 0;
+    }
+    if (level >= 0 && level <= Volume_MAX && level != snap.volume) {
+        snap.volume = level;
+        Volume_adjustment((uint8_t)level);
+    }
+    ESP_LOGI(TAG, "Playout %lld ms, volume %d", (long long)(playout / 1000), level);
+    cJSON_Delete(json);
+}
+
+static bool Snap_Wire_Chunk(int sock, uint32_t size)
+{
+    snap_chunk_header_t header;
+    if (size < sizeof(header) || Snap_Recv(sock, &header, sizeof(header), false) != 1 ||
+        header.size != size - sizeof(header)) {
+        return false;
+    }
+    // Read straight into the buffer entry
+    snap_chunk_t *chunk = heap_caps_malloc(sizeof(*chunk) + header.size, MALLOC_CAP_SPIRAM);
+    if (!chunk) {
+        return false;
+    }
+    if (Snap_Recv(sock, chunk->samples, header.size, false) != 1) {
+        heap_caps_free(chunk);
+        return false;
+    }
+    chunk->server_us = (int64_t)header.sec * 1000000 + header.usec;
+    chunk->frames = header.size / SNAP_FRAME_BYTES;
+    if (!snap.format_ok || !snap.clock_valid || xQueueSend(snap.chunks, &chunk, 0) != pdTRUE) {
+        heap_caps_free(chunk);
+    }
+    return true;
+}
+
+static bool Snap_Read_Message(int sock)
+{
+    snap_header_t header;
+    int ret = Snap_Recv(sock, &header, sizeof(header), true);
+    if (ret <= 0) {
+        return ret == 0;
+    }
+    int64_t received_us = esp_timer_get_time();
+    if (header.size > SNAPCAST_MAX_MESSAGE) {
+        ESP_LOGE(TAG, "Message of %lu bytes, dropping the connection", (unsigned long)header.size);
+        return false;
+    }
+
+    if (header.type == SNAP_MSG_WIRE_CHUNK) {
+        return Snap_Wire_Chunk(sock, header.size);
+    }
+    if (header.type == SNAP_MSG_TIME) {
+        int32_t latency[2];
+        if (header.size != sizeof(latency) || Snap_Recv(sock, latency, sizeof(latency), false) != 1) {
+            return false;
+        }
+        int64_t c2s = (int64_t)latency[0] * 1000000 + latency[1];
+        int64_t s2c = received_us - ((int64_t)header.sent_sec * 1000000 + header.sent_usec);
+        Snap_Add_Offset(c2s, s2c);
+        return true;
+    }
+
+    uint8_t *payload = heap_caps_malloc(header.size + 1, MALLOC_CAP_SPIRAM);
+    if (!payload || (header.size && Snap_Recv(sock, payload, header.size, false) != 1)) {
+        heap_caps_free(payload);
+        return false;
+    }
+    if (header.type == SNAP_MSG_CODEC_HEADER) {
+        Snap_Codec_Header(payload, header.size);
+    } else if (header.type == SNAP_MSG_SERVER_SETTINGS) {
+        Snap_Server_Settings(payload, header.size);
+    }
+    heap_caps_free(payload);
+    return true;
+}
+
+/**********************************************************************************
+ * Connection
+ **********************************************************************************/
+static bool Snap_Discover(char *host, size_t size, uint16_t *port)
+{
+    mdns_result_t *results = NULL;
+    if (mdns_query_ptr("_snapcast", "_tcp", 3000, 1, &results) != ESP_OK || !results) {
+        return false;
+    }
+    bool found = false;
+    for (mdns_ip_addr_t *a = results->addr; a && !found; a = a->next) {
+        if (a->addr.type == ESP_IPADDR_TYPE_V4) {
+            snprintf(host, size, IPSTR, IP2STR(&a->addr.u_addr.ip4));
+            found = true;
+        }
+    }
+    if (!found && results->hostname) {
+        snprintf(host, size, "%s.local", results->hostname);
+        found = true;
+    }
+    if (found && results->port) {
+        *port = results->port;
+    }
+    mdns_query_results_free(results);
+    return found;
+}
+
+static int Snap_Connect(void)
+{
+    char host[SNAP_HOST_MAX] = CONFIG_SNAPCAST_SERVER_HOST;
+    uint16_t port = CONFIG_SNAPCAST_SERVER_PORT;
+    if (!host[0] && !Snap_Discover(host, sizeof(host), &port)) {
+        return -1;
+    }
+
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    const struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(host, service, &hints, &res) != 0 || !res) {
+        ESP_LOGW(TAG, "Cannot resolve %s", host);
+        return -1;
+    }
+    int sock = socket(res->ai_family, res->ai_socktype, 0);
+    if (sock >= 0 && connect(sock, res->ai_addr, res->ai_addrlen) != 0) {
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+    if (sock < 0) {
+        ESP_LOGW(TAG, "Cannot connect to %s:%u", host, port);
+        return -1;
+    }
+
+    // Time requests go out at once; reads wake up in time to send the next one
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    const struct timeval timeout = { 0, SNAPCAST_TIME_FAST_MS * 1000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ESP_LOGI(TAG, "Connected to %s:%u", host, port);
+    return sock;
+}
+
+static void Snap_Sleep(uint32_t ms)
+{
+    for (uint32_t slept = 0; slept < ms && snap.running; slept += 100) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+}
+
+static void Snap_Net_Task(void *arg)
+{
+    static const int32_t no_latency[2] = { 0, 0 };
+    mem_tag_enter(MEM_TAG_SNAPCAST, NULL);     // Every message this task parses or builds
+    while (snap.running) {
+        int sock = Snap_Connect();
+        if (sock < 0) {
+            Snap_Sleep(SNAPCAST_RECONNECT_MS);
+            continue;
+        }
+        Snap_Reset_Clock();
+        snap.sock = sock;
+
+        bool ok = Snap_Send_Hello(sock);
+        int64_t next_time_us = 0;
+        while (ok && snap.running) {
+            int64_t now = esp_timer_get_time();
+            if (now >= next_time_us) {
+                ok = Snap_Send(sock, SNAP_MSG_TIME, no_latency, sizeof(no_latency));
+                uint32_t period = snap.history_count < SNAPCAST_TIME_HISTORY ? SNAPCAST_TIME_FAST_MS
+                                                                            : SNAPCAST_TIME_PERIOD_MS;
+                next_time_us = now + period * 1000;
+            }
+            ok = ok && Snap_Read_Message(sock);
+        }
+
+        snap.sock = -1;
+        close(sock);
+        snap.format_ok = false;
+        snap.clock_valid = false;
+        if (snap.running) {
+            ESP_LOGW(TAG, "Disconnected, retrying in %d ms", SNAPCAST_RECONNECT_MS);
+            Snap_Sleep(SNAPCAST_RECONNECT_MS);
+        }
+    }
+    xSemaphoreGive(snap.done);
+    mem_task_delete(NULL);
+}
+
+bool Snapcast_Client_Start(void)
+{
+    if (snap.running) {
+        return false;
+    }
+    if (!snap.chunks) {
+        snap.chunks = xQueueCreate(SNAPCAST_MAX_CHUNKS, sizeof(snap_chunk_t *));
+        snap.done = xSemaphoreCreateCounting(2, 0);
+    }
+    if (!snap.chunks || !snap.done) {
+        ESP_LOGE(TAG, "No memory for the jitter buffer queue");
+        return false;
+    }
+
+    snap.running = true;
+    int started = 0;
+    // Sockets and JSON only, so the network side can take a PSRAM stack
+    started += mem_task_create(Snap_Net_Task, "snap_net", SNAPCAST_TASK_STACK, NULL,
+                               SNAPCAST_NET_PRIORITY, NULL, SNAPCAST_NET_CORE, MEM_TASK_STACK_PSRAM);
+    // Next to the audio player's writer
+    started += mem_task_create(Snap_Play_Task, "snap_play", SNAPCAST_TASK_STACK, NULL,
+                               SNAPCAST_PLAY_PRIORITY, NULL, SNAPCAST_PLAY_CORE, MEM_TASK_STACK_INTERNAL);
+    if (started < 2) {
+        ESP_LOGE(TAG, "Failed to start the client tasks");
+        snap.running = false;
+        while (started-- > 0) {
+            xSemaphoreTake(snap.done, portMAX_DELAY);
+        }
+        return false;
+    }
+    return true;
+}
+
+void Snapcast_Client_Stop(void)
+{
+    if (!snap.running) {
+        return;
+    }
+    snap.running = false;
+    int sock = snap.sock;
+    if (sock >= 0) {
+        shutdown(sock, SHUT_RDWR);      // Wakes the blocked read
+    }
+    xSemaphoreTake(snap.done, portMAX_DELAY);
+    xSemaphoreTake(snap.done, portMAX_DELAY);
+
+    snap_chunk_t *chunk;
+    while (xQueueReceive(snap.chunks, &chunk, 0) == pdTRUE) {
+        heap_caps_free(chunk);
+    }
+    ESP_LOGI(TAG, "Stopped");
+}
+#else
+bool Snapcast_Client_Start(void)
+{
+    return false;
+}
+
+void Snapcast_Client_Stop(void)
+{
+}
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include "task_plan.h"
+
+/*
+ * Multi-room client: a Snapcast server's stream, played in step with the
+ * server's other clients whenever the local player is not playing.
+ *   - Connects to SNAPCAST_SERVER_HOST, or the first _snapcast._tcp server
+ *     mDNS finds, and reconnects after a drop
+ *   - The offset to the server's clock is measured NTP-style: one Time
+ *     exchange gives ((server receive - client send) - (client receive -
+ *     server send)) / 2, and the median of the last SNAPCAST_TIME_HISTORY is
+ *     used, so a packet delayed one way does not move it
+ *   - Timestamped PCM chunks wait in a PSRAM jitter buffer until due, at the
+ *     server timestamp + the server's buffer - this client's latency setting
+ *   - The first frame is started to the sample: silence is padded ahead of it
+ *     against the exact delay of the I2S DMA queue (Audio_Output_Delay_us())
+ *   - The DAC crystal drifts from the server's clock by tens of ppm; while the
+ *     smoothed error is past SNAPCAST_TRIM_US one frame of a DMA block is
+ *     dropped or repeated, at most one a block (0.4% of rate)
+ *   - An error past SNAPCAST_RESYNC_US (an underrun, a clock step) starts over
+ *     from the padding
+ * Only the "pcm" codec at the player's output format (48 kHz, 16 bit,
+ * stereo) is played: set the server stream's codec=pcm. The server's volume
+ * and mute for this client set Volume.
+ */
+
+#define SNAPCAST_TIME_HISTORY       50
+#define SNAPCAST_TIME_FAST_MS       100         // Between Time exchanges until the history is full
+#define SNAPCAST_TIME_PERIOD_MS     1000
+#define SNAPCAST_MAX_CHUNKS         160         // 3.2 s of the server's default 20 ms chunks
+#define SNAPCAST_MAX_MESSAGE        (64 * 1024)
+#define SNAPCAST_TRIM_US            50          // 2.4 frames
+#define SNAPCAST_RESYNC_US          20000
+#define SNAPCAST_DAC_DELAY_US       480         // PCM5101 interpolation filter, 23 frames
+#define SNAPCAST_IDLE_MS            1000        // No chunk this long: the output goes back to the player
+#define SNAPCAST_RECONNECT_MS       5000
+#define SNAPCAST_TASK_STACK         4096
+#define SNAPCAST_NET_PRIORITY       TASK_PLAN_SNAPCAST_NET_PRIORITY
+#define SNAPCAST_NET_CORE           TASK_PLAN_NETWORK_CORE
+#define SNAPCAST_PLAY_PRIORITY      TASK_PLAN_SNAPCAST_PLAY_PRIORITY    // Beside the audio player's writer
+#define SNAPCAST_PLAY_CORE          TASK_PLAN_SNAPCAST_PLAY_CORE
+
+// Starts the client tasks; false if SNAPCAST_CLIENT is disabled or already started
+bool Snapcast_Client_Start(void);
+// Disconnects and gives the output back; blocks until both tasks are gone
+void Snapcast_Client_Stop(void);
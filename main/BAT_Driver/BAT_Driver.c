@@ -68,50 +68,165 @@ static bool example_adc_calibration_init(adc_unit_t unit, adc_channel_t channel,
 // #endif
 // }
 
-adc_oneshot_unit_handle_t adc1_handle;
-bool do_calibration1_chan3;
-adc_cali_handle_t adc1_cali_chan3_handle = NULL;
+static adc_continuous_handle_t adc1_handle;
+static bool do_calibration1_chan3;
+static adc_cali_handle_t adc1_cali_chan3_handle = NULL;
+
+static float BAT_filtered = 0;                 // IIR output, V; 0 until the first burst
+static float BAT_soc_prev = -1;                // Filtered state of charge at the last rate update
+static int64_t BAT_soc_prev_us = 0;
+static float BAT_rate = 0;                     // Percent per hour, positive while discharging
+static bat_status_t BAT_status = { .percent = -1, .minutes_left = -1 };
+static bat_callback_t BAT_callback = NULL;
+
+// Resting LiPo cell, 1C-ish load: volts -> percent, descending
+static const struct { float volts; float percent; } BAT_soc_curve[] = {
+    { 4.20f, 100 }, { 4.10f, 90 }, { 4.00f, 80 }, { 3.92f, 70 }, { 3.85f, 60 },
+    { 3.80f,  50 }, { 3.75f, 40 }, { 3.71f, 30 }, { 3.67f, 20 }, { 3.61f, 10 },
+    { 3.50f,   5 }, { 3.30f,  0 },
+};
 
-int adc_raw[2][10];                           
-int voltage[2][10];                          
 void ADC_Init(void)
 {
     //-------------ADC1 Init---------------//
-    adc_oneshot_unit_init_cfg_t init_config1 = {                          
-        .unit_id = ADC_UNIT_1,                                               
+    // One conversion frame is one burst; the DMA pool holds two
+    adc_continuous_handle_cfg_t handle_config = {
+        .max_store_buf_size = BAT_BURST_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES * 2,
+        .conv_frame_size = BAT_BURST_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES,
     };
-    ESP_ERROR_CHECK(adc_oneshot_new_unit(&init_config1, &adc1_handle));      
+    ESP_ERROR_CHECK(adc_continuous_new_handle(&handle_config, &adc1_handle));
 
     //-------------ADC1 Config---------------//
-    adc_oneshot_chan_cfg_t config = {
-        .atten = EXAMPLE_ADC_ATTEN,                                               
-        .bitwidth = ADC_BITWIDTH_DEFAULT,
+    adc_digi_pattern_config_t pattern = {
+        .atten = EXAMPLE_ADC_ATTEN,
+        .channel = EXAMPLE_ADC1_CHAN,
+        .unit = ADC_UNIT_1,
+        .bit_width = SOC_ADC_DIGI_MAX_BITWIDTH,
+    };
+    adc_continuous_config_t config = {
+        .pattern_num = 1,
+        .adc_pattern = &pattern,
+        .sample_freq_hz = BAT_SAMPLE_FREQ_HZ,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_DIGI_OUTPUT_FORMAT_TYPE2,
     };
-    ESP_ERROR_CHECK(adc_oneshot_config_channel(adc1_handle, EXAMPLE_ADC1_CHAN, &config)); 
+    ESP_ERROR_CHECK(adc_continuous_config(adc1_handle, &config));
 
     //-------------ADC1 Calibration Init---------------//
-    do_calibration1_chan3 = example_adc_calibration_init(ADC_UNIT_1, EXAMPLE_ADC1_CHAN, EXAMPLE_ADC_ATTEN, &adc1_cali_chan3_handle);     
+    do_calibration1_chan3 = example_adc_calibration_init(ADC_UNIT_1, EXAMPLE_ADC1_CHAN, EXAMPLE_ADC_ATTEN, &adc1_cali_chan3_handle);
+}
+
+// One DMA burst with the converter running only for its duration; returns the mean raw code or -1
+static int BAT_Read_Burst(void)
+{
+    static uint8_t frame[BAT_BURST_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES];
+    uint32_t length = 0;
+
+    adc_continuous_flush_pool(adc1_handle);
+    if (adc_continuous_start(adc1_handle) != ESP_OK) {
+        return -1;
+    }
+    esp_err_t ret = adc_continuous_read(adc1_handle, frame, sizeof(frame), &length, BAT_BURST_TIMEOUT_MS);
+    adc_continuous_stop(adc1_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGW(ADC_TAG, "Battery burst failed: %s", esp_err_to_name(ret));
+        return -1;
+    }
+
+    uint32_t raw_sum = 0;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= length; i += SOC_ADC_DIGI_RESULT_BYTES) {
+        const adc_digi_output_data_t *p = (const adc_digi_output_data_t *)&frame[i];
+        if (p->type2.unit == ADC_UNIT_1 && p->type2.channel == EXAMPLE_ADC1_CHAN) {
+            raw_sum += p->type2.data;
+            count++;
+        }
+    }
+    return count ? (int)((raw_sum + count / 2) / count) : -1;
+}
+
+static float BAT_Volts_To_Percent(float volts)
+{
+    const int points = sizeof(BAT_soc_curve) / sizeof(BAT_soc_curve[0]);
+    if (volts >= BAT_soc_curve[0].volts) {
+        return 100;
+    }
+    for (int i = 1; i < points; i++) {
+        if (volts >= BAT_soc_curve[i].volts) {
+            float span = BAT_soc_curve[i - 1].volts - BAT_soc_curve[i].volts;
+            float t = (volts - BAT_soc_curve[i].volts) / span;
+            return BAT_soc_curve[i].percent + t * (BAT_soc_curve[i - 1].percent - BAT_soc_curve[i].percent);
+        }
+    }
+    return 0;
+}
 
-    // //Tear Down
-    // ESP_ERROR_CHECK(adc_oneshot_del_unit(adc1_handle));
-    // if (do_calibration1_chan3) {                                                                                                                
-    //     example_adc_calibration_deinit(adc1_cali_chan3_handle);                                                                                 
-    // }
+// Discharge rate from the filtered state of charge, smoothed over several windows
+static void BAT_Update_Rate(float soc, int64_t now_us)
+{
+    if (BAT_soc_prev < 0) {
+        BAT_soc_prev = soc;
+        BAT_soc_prev_us = now_us;
+        return;
+    }
+    int64_t elapsed_us = now_us - BAT_soc_prev_us;
+    if (elapsed_us < (int64_t)BAT_RATE_WINDOW_S * 1000000) {
+        return;
+    }
+    float rate = (BAT_soc_prev - soc) * 3600e6f / (float)elapsed_us;
+    BAT_rate += (rate - BAT_rate) * BAT_RATE_ALPHA;
+    BAT_soc_prev = soc;
+    BAT_soc_prev_us = now_us;
 }
 
 void BAT_Init(void)
 {
     ADC_Init();
 }
+
+void BAT_Set_Callback(bat_callback_t callback)
+{
+    BAT_callback = callback;
+}
+
+bat_status_t BAT_Get_Status(void)
+{
+    return BAT_status;
+}
+
 float BAT_Get_Volts(void)
 {
-    adc_oneshot_read(adc1_handle, EXAMPLE_ADC1_CHAN, &adc_raw[0][0]);                                                     
-    // printf( "ADC%d Channel[%d] Raw Data: %d\r\n", ADC_UNIT_1 + 1, EXAMPLE_ADC1_CHAN, adc_raw[0][0]);                                                
-    if (do_calibration1_chan3) {                                                                                           
-        ESP_ERROR_CHECK(adc_cali_raw_to_voltage(adc1_cali_chan3_handle, adc_raw[0][0], &voltage[0][0]));                    
-        // printf("ADC%d Channel[%d] Cali Voltage: %d mV\r\n", ADC_UNIT_1 + 1, EXAMPLE_ADC1_CHAN, voltage[0][0]);                
-        BAT_analogVolts = (float)(voltage[0][0] * 3.0 / 1000.0) / Measurement_offset;
-        // printf("BAT voltage : %.2f V\r\n", BAT_analogVolts);
+    int raw = BAT_Read_Burst();
+    if (raw < 0 || !do_calibration1_chan3) {
+        return BAT_analogVolts;
+    }
+    int millivolts = 0;
+    ESP_ERROR_CHECK(adc_cali_raw_to_voltage(adc1_cali_chan3_handle, raw, &millivolts));
+    float volts = (float)(millivolts * 3.0 / 1000.0) / Measurement_offset;
+
+    // Seed with the first burst so the filter does not ramp up from zero
+    if (BAT_filtered == 0) {
+        BAT_filtered = volts;
+    } else {
+        BAT_filtered += (volts - BAT_filtered) * BAT_IIR_ALPHA;
+    }
+    BAT_analogVolts = BAT_filtered;
+
+    float soc = BAT_Volts_To_Percent(BAT_filtered);
+    BAT_Update_Rate(soc, esp_timer_get_time());
+
+    bat_status_t status = {
+        .volts = BAT_filtered,
+        .percent = (int)(soc + 0.5f),
+        .minutes_left = BAT_rate > BAT_RATE_MIN ? (int)(soc / BAT_rate * 60) : -1,
+    };
+    bool changed = status.percent != BAT_status.percent;
+    BAT_status = status;
+    if (changed) {
+        ESP_LOGI(ADC_TAG, "Battery %.2f V, %d%%, %d min left", status.volts, status.percent, status.minutes_left);
+        if (BAT_callback) {
+            BAT_callback(&status);
+        }
     }
     return BAT_analogVolts;
-}
\ No newline at end of file
+}
@@ -1,9 +1,10 @@
 #pragma once
 
 #include "esp_log.h"
-#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_continuous.h"
 #include "esp_adc/adc_cali.h"
 #include "esp_adc/adc_cali_scheme.h"
+#include "esp_timer.h"
 
 
 /*---------------------------------------------------------------
@@ -15,7 +16,33 @@
 
 #define Measurement_offset 0.990476  
 
+/*
+ * Battery monitor: each BAT_Get_Volts() runs the ADC in continuous (DMA)
+ * mode for one short burst and averages it, so the converter is off between
+ * measurements. Bursts go through an IIR filter, the filtered voltage maps to
+ * a state of charge on a LiPo curve, and the SoC slope gives a discharge
+ * rate and time remaining. The callback fires only when the whole percent
+ * changes.
+ */
+#define BAT_SAMPLE_FREQ_HZ      20000                   // Burst of 64 samples: ~3 ms of conversion
+#define BAT_BURST_SAMPLES       64
+#define BAT_BURST_TIMEOUT_MS    20
+#define BAT_IIR_ALPHA           0.25f                   // Per measurement
+#define BAT_RATE_WINDOW_S       300                     // SoC slope sampled every 5 min
+#define BAT_RATE_ALPHA          0.3f                    // Smoothing across windows
+#define BAT_RATE_MIN            0.2f                    // %/h; below this there is no estimate (or charging)
+
+typedef struct {
+    float volts;                // Filtered
+    int percent;                // 0..100, -1 before the first measurement
+    int minutes_left;           // -1 when unknown or charging
+} bat_status_t;
+
+typedef void (*bat_callback_t)(const bat_status_t *status);
+
 extern float BAT_analogVolts;
 
 void BAT_Init(void);
-float BAT_Get_Volts(void);
\ No newline at end of file
+float BAT_Get_Volts(void);                              // Measure; returns the filtered voltage
+bat_status_t BAT_Get_Status(void);
+void BAT_Set_Callback(bat_callback_t callback);        // Runs on the measuring task
\ No newline at end of file
@@ -0,0 +1,202 @@
+#include "ESPCaster_Bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lvgl.h"
+#include "LVGL_Latency.h"
+#include "Touch_SPD2010.h"
+
+static const char *TAG = "BENCH";
+
+#if CONFIG_LVGL_LATENCY_PROBE
+static const char *const stage_names[LVGL_LATENCY_STAGE_COUNT] = {
+    "int", "read", "indev", "event", "render", "flush", "scanout",
+};
+
+typedef struct {
+    uint32_t us[LVGL_LATENCY_STAGE_COUNT][BENCH_LATENCY_SAMPLES];   // From the INT edge, per stage
+    int count;
+    int missed;
+} Bench_Latency_t;
+
+/* Run LVGL as its task would, without sleeping, until a probe finishes or
+ * until deadline_us; the probe goes into result if one is given */
+static bool Bench_Pump(int64_t deadline_us, Bench_Latency_t *result)
+{
+    LVGL_Latency_Probe_t probe;
+    while (esp_timer_get_time() < deadline_us) {
+        lv_timer_handler();
+        if (LVGL_Latency_Take(&probe)) {
+            if (result && result->count < BENCH_LATENCY_SAMPLES) {
+                for (int s = 0; s < LVGL_LATENCY_STAGE_COUNT; s++) {
+                    result->us[s][result->count] = probe.at_us[s] ? (uint32_t)(probe.at_us[s] - probe.at_us[0]) : 0;
+                }
+                result->count++;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+/* One touch: LVGL runs for a while first, so the touch lands anywhere in
+ * the indev read period, as a finger would. Not counted without result */
+static void Bench_Touch_Sample(Bench_Latency_t *result, int sample, uint16_t x, uint16_t y)
+{
+    vTaskDelay(1);                  // Let the idle tasks run between samples
+    int64_t settle_us = BENCH_LATENCY_SETTLE_MS * 1000LL + (sample * 7919) % (LV_INDEV_DEF_READ_PERIOD * 1000);
+    Bench_Pump(esp_timer_get_time() + settle_us, NULL);
+    Touch_Inject(true, x, y);
+    if (!Bench_Pump(esp_timer_get_time() + BENCH_LATENCY_WAIT_MS * 1000LL, result) && result) {
+        result->missed++;
+    }
+}
+
+static void Bench_Release(uint16_t x, uint16_t y)
+{
+    Touch_Inject(false, x, y);
+    Bench_Pump(esp_timer_get_time() + BENCH_LATENCY_SETTLE_MS * 1000LL, NULL);
+}
+
+static int Bench_Compare(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// values sorted, count > 0
+static double Bench_Percentile_ms(const uint32_t *values, int count, int percent)
+{
+    int rank = (percent * count + 99) / 100;
+    return values[rank > 0 ? rank - 1 : 0] / 1000.0;
+}
+
+static void Bench_Latency_Report(const char *interaction, Bench_Latency_t *result)
+{
+    char key[48];
+    snprintf(key, sizeof(key), "latency_%s_missed", interaction);
+    Bench_Report(key, result->missed, "count");
+    if (result->missed) {
+        ESP_LOGW(TAG, "%s: %d touches did not reach the panel in %d ms", interaction, result->missed,
+                 BENCH_LATENCY_WAIT_MS);
+    }
+    if (result->count == 0) {
+        return;
+    }
+    // Each stage from the INT edge, at the median; the whole path at p50, p90 and p99
+    for (int s = LVGL_LATENCY_TOUCH_READ; s <= LVGL_LATENCY_LAST_STAGE; s++) {
+        qsort(result->us[s], result->count, sizeof(uint32_t), Bench_Compare);
+        snprintf(key, sizeof(key), "latency_%s_%s_p50", interaction, stage_names[s]);
+        Bench_Report(key, Bench_Percentile_ms(result->us[s], result->count, 50), "ms");
+    }
+    const uint32_t *total = result->us[LVGL_LATENCY_LAST_STAGE];
+    snprintf(key, sizeof(key), "latency_%s_p90", interaction);
+    Bench_Report(key, Bench_Percentile_ms(total, result->count, 90), "ms");
+    snprintf(key, sizeof(key), "latency_%s_p99", interaction);
+    Bench_Report(key, Bench_Percentile_ms(total, result->count, 99), "ms");
+}
+
+// Press and release a button that changes colour while pressed
+static void Bench_Button(lv_obj_t *screen, Bench_Latency_t *result)
+{
+    lv_obj_t *button = lv_btn_create(screen);
+    lv_obj_set_size(button, 160, 80);
+    lv_obj_center(button);
+    lv_obj_set_style_bg_color(button, lv_color_make(0x20, 0x40, 0x80), 0);
+    lv_obj_set_style_bg_color(button, lv_color_make(0xE0, 0x60, 0x20), LV_STATE_PRESSED);
+    lv_obj_update_layout(screen);
+    lv_area_t a;
+    lv_obj_get_coords(button, &a);
+    uint16_t x = (a.x1 + a.x2) / 2, y = (a.y1 + a.y2) / 2;
+
+    for (int i = 0; i < BENCH_LATENCY_SAMPLES; i++) {
+        Bench_Touch_Sample(result, i, x, y);
+        Bench_Release(x, y);
+    }
+    lv_obj_del(button);
+}
+
+// Hold the knob, then move it a step per sample, back and forth
+static void Bench_Slider(lv_obj_t *screen, Bench_Latency_t *result)
+{
+    lv_obj_t *slider = lv_slider_create(screen);
+    lv_obj_set_width(slider, 300);
+    lv_obj_center(slider);
+    lv_slider_set_range(slider, 0, 300);
+    lv_slider_set_value(slider, 0, LV_ANIM_OFF);
+    lv_obj_update_layout(screen);
+    lv_area_t a;
+    lv_obj_get_coords(slider, &a);
+    int x = a.x1, y = (a.y1 + a.y2) / 2, step = BENCH_LATENCY_STEP_PX;
+
+    Bench_Touch_Sample(NULL, 0, x, y);              // Grabbing it is not a drag
+    for (int i = 0; i < BENCH_LATENCY_SAMPLES; i++) {
+        if (x + step > a.x2 || x + step < a.x1) {
+            step = -step;
+        }
+        x += step;
+        Bench_Touch_Sample(result, i, x, y);
+    }
+    Bench_Release(x, y);
+    lv_obj_del(slider);
+}
+
+// Drag a long list upwards a step per sample
+static void Bench_List(lv_obj_t *screen, Bench_Latency_t *result)
+{
+    lv_obj_t *list = lv_list_create(screen);
+    lv_obj_set_size(list, 280, 360);
+    lv_obj_center(list);
+    for (int i = 0; i < 60; i++) {
+        char text[16];
+        snprintf(text, sizeof(text), "Track %d", i + 1);
+        lv_list_add_btn(list, LV_SYMBOL_AUDIO, text);
+    }
+    lv_obj_update_layout(screen);
+    lv_area_t a;
+    lv_obj_get_coords(list, &a);
+    int x = (a.x1 + a.x2) / 2, y = a.y2 - 20;
+
+    Bench_Touch_Sample(NULL, 0, x, y);
+    // Past LVGL's scroll threshold first, so every sample moves the list
+    y -= LV_INDEV_DEF_SCROLL_LIMIT + 1;
+    Bench_Touch_Sample(NULL, 1, x, y);
+    for (int i = 0; i < BENCH_LATENCY_SAMPLES && y - BENCH_LATENCY_STEP_PX > a.y1; i++) {
+        y -= BENCH_LATENCY_STEP_PX;
+        Bench_Touch_Sample(result, i, x, y);
+    }
+    Bench_Release(x, y);
+    lv_obj_del(list);
+}
+
+void Bench_Latency_Run(void)
+{
+    // On a screen of its own, touched only through Touch_Inject()
+    lv_obj_t *previous = lv_scr_act();
+    lv_obj_t *screen = lv_obj_create(NULL);
+    lv_scr_load(screen);
+    Bench_Pump(esp_timer_get_time() + BENCH_LATENCY_SETTLE_MS * 1000LL, NULL);
+
+    static Bench_Latency_t result;
+    result = (Bench_Latency_t){0};
+    Bench_Button(screen, &result);
+    Bench_Latency_Report("button", &result);
+    result = (Bench_Latency_t){0};
+    Bench_Slider(screen, &result);
+    Bench_Latency_Report("slider", &result);
+    result = (Bench_Latency_t){0};
+    Bench_List(screen, &result);
+    Bench_Latency_Report("list", &result);
+
+    lv_scr_load(previous);
+    lv_obj_del(screen);
+}
+#else
+void Bench_Latency_Run(void)
+{
+    ESP_LOGI(TAG, "Touch latency needs CONFIG_LVGL_LATENCY_PROBE, skipped");
+}
+#endif
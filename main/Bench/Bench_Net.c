@@ -0,0 +1,340 @@
+#include "ESPCaster_Bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include "sdkconfig.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "esp_tls.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "lwip/inet.h"
+#include "ping/ping_sock.h"
+#include "mem_task.h"
+#include "task_plan.h"
+#include "wifi_manager.h"
+
+#if CONFIG_ESPCASTER_BENCH_NET
+static const char *TAG = "BENCH";
+
+static TaskHandle_t bench_caller;
+
+typedef struct {
+    uint32_t min_ms;
+    uint32_t max_ms;
+    uint32_t total_ms;
+    uint32_t replies;
+    TaskHandle_t waiter;
+} bench_ping_t;
+
+static void Bench_Ping_Success(esp_ping_handle_t ping, void *args)
+{
+    bench_ping_t *result = args;
+    uint32_t ms = 0;
+    esp_ping_get_profile(ping, ESP_PING_PROF_TIMEGAP, &ms, sizeof(ms));
+    result->min_ms = ms < result->min_ms ? ms : result->min_ms;
+    result->max_ms = ms > result->max_ms ? ms : result->max_ms;
+    result->total_ms += ms;
+    result->replies++;
+}
+
+static void Bench_Ping_End(esp_ping_handle_t ping, void *args)
+{
+    bench_ping_t *result = args;
+    xTaskNotifyGive(result->waiter);
+}
+
+/* ICMP echo RTT, BENCH_NET_PINGS of them */
+static void Bench_Ping(const char *target, const ip_addr_t *addr)
+{
+    esp_ping_config_t config = ESP_PING_DEFAULT_CONFIG();
+    config.target_addr = *addr;
+    config.count = BENCH_NET_PINGS;
+    config.interval_ms = BENCH_NET_PING_INTERVAL_MS;
+    config.timeout_ms = BENCH_NET_TIMEOUT_MS;
+
+    bench_ping_t result = { .min_ms = UINT32_MAX, .waiter = xTaskGetCurrentTaskHandle() };
+    esp_ping_callbacks_t callbacks = {
+        .cb_args = &result,
+        .on_ping_success = Bench_Ping_Success,
+        .on_ping_end = Bench_Ping_End,
+    };
+    esp_ping_handle_t ping;
+    if (esp_ping_new_session(&config, &callbacks, &ping) != ESP_OK) {
+        ESP_LOGW(TAG, "%s: no ping session", target);
+        return;
+    }
+    esp_ping_start(ping);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    esp_ping_delete_session(ping);
+
+    char key[48];
+    snprintf(key, sizeof(key), "net_%s_ping_loss", target);
+    Bench_Report(key, 100.0 * (BENCH_NET_PINGS - result.replies) / BENCH_NET_PINGS, "%");
+    if (!result.replies) {
+        return;
+    }
+    snprintf(key, sizeof(key), "net_%s_ping_min", target);
+    Bench_Report(key, result.min_ms, "ms");
+    snprintf(key, sizeof(key), "net_%s_ping_avg", target);
+    Bench_Report(key, (double)result.total_ms / result.replies, "ms");
+    snprintf(key, sizeof(key), "net_%s_ping_max", target);
+    Bench_Report(key, result.max_ms, "ms");
+}
+
+/* Blocking TCP connect with BENCH_NET_TIMEOUT_MS; the socket, or -1 */
+static int Bench_Connect(const char *host, int port, int64_t *us, bool refused_ok)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+    };
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        ESP_LOGW(TAG, "%s is not an IPv4 address", host);
+        return -1;
+    }
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0) {
+        return -1;
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+    int64_t start = esp_timer_get_time();
+    int ret = connect(sock, (struct sockaddr *)&addr, sizeof(addr));
+    if (ret < 0 && errno == EINPROGRESS) {
+        fd_set write_fds;
+        FD_ZERO(&write_fds);
+        FD_SET(sock, &write_fds);
+        struct timeval timeout = { BENCH_NET_TIMEOUT_MS / 1000, (BENCH_NET_TIMEOUT_MS % 1000) * 1000 };
+        ret = select(sock + 1, NULL, &write_fds, NULL, &timeout) == 1 ? 0 : -1;
+        if (ret == 0) {
+            int error = 0;
+            socklen_t length = sizeof(error);
+            getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &length);
+            // A refusal is a SYN answered with a RST: one round trip all the same
+            ret = error == 0 || (refused_ok && error == ECONNREFUSED) ? 0 : -1;
+        }
+    }
+    *us = esp_timer_get_time() - start;
+    if (ret < 0) {
+        close(sock);
+        return -1;
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) & ~O_NONBLOCK);
+    return sock;
+}
+
+/* TCP handshake RTT; a closed port does as well as an open one */
+static void Bench_Connect_RTT(const char *target, const char *host, int port)
+{
+    int64_t total = 0, best = INT64_MAX;
+    int done = 0;
+    for (int i = 0; i < BENCH_NET_CONNECTS; i++) {
+        int64_t us;
+        int sock = Bench_Connect(host, port, &us, true);
+        if (sock < 0) {
+            continue;
+        }
+        close(sock);
+        total += us;
+        best = us < best ? us : best;
+        done++;
+    }
+    char key[48];
+    if (!done) {
+        ESP_LOGW(TAG, "%s: no TCP answer on port %d", target, port);
+        return;
+    }
+    snprintf(key, sizeof(key), "net_%s_connect", target);
+    Bench_Report(key, total / 1000.0 / done, "ms");
+    snprintf(key, sizeof(key), "net_%s_connect_min", target);
+    Bench_Report(key, best / 1000.0, "ms");
+}
+
+static void Bench_Report_Rate(const char *name, uint64_t bytes, int64_t us)
+{
+    if (us > 0 && bytes > 0) {
+        Bench_Report(name, bytes * 8.0 / us, "Mbit/s");
+    }
+}
+
+/* BENCH_NET_SECONDS of bulk TCP each way: to the peer's sink, from its source */
+static void Bench_TCP_Throughput(const char *host, uint8_t *buffer)
+{
+    int64_t us;
+    int sock = Bench_Connect(host, BENCH_NET_SINK_PORT, &us, false);
+    if (sock >= 0) {
+        uint64_t sent = 0;
+        int64_t start = esp_timer_get_time();
+        int64_t end = start + BENCH_NET_SECONDS * 1000000LL;
+        while (esp_timer_get_time() < end) {
+            int n = send(sock, buffer, BENCH_NET_CHUNK, 0);
+            if (n <= 0) {
+                break;
+            }
+            sent += n;
+        }
+        Bench_Report_Rate("net_tcp_tx", sent, esp_timer_get_time() - start);
+        close(sock);
+    } else {
+        ESP_LOGW(TAG, "No TCP sink on %s:%d", host, BENCH_NET_SINK_PORT);
+    }
+
+    sock = Bench_Connect(host, BENCH_NET_SOURCE_PORT, &us, false);
+    if (sock >= 0) {
+        struct timeval timeout = { BENCH_NET_TIMEOUT_MS / 1000, (BENCH_NET_TIMEOUT_MS % 1000) * 1000 };
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        uint64_t received = 0;
+        int64_t start = esp_timer_get_time();
+        int64_t end = start + BENCH_NET_SECONDS * 1000000LL;
+        while (esp_timer_get_time() < end) {
+            int n = recv(sock, buffer, BENCH_NET_CHUNK, 0);
+            if (n <= 0) {
+                break;
+            }
+            received += n;
+        }
+        Bench_Report_Rate("net_tcp_rx", received, esp_timer_get_time() - start);
+        close(sock);
+    } else {
+        ESP_LOGW(TAG, "No TCP source on %s:%d", host, BENCH_NET_SOURCE_PORT);
+    }
+}
+
+static esp_tls_t *Bench_TLS_Connect(const char *host, int port)
+{
+    esp_tls_cfg_t cfg = {0};
+    cfg.timeout_ms = BENCH_TLS_TIMEOUT_MS;
+    cfg.skip_common_name = true;
+    cfg.crt_bundle_attach = NULL;       // Self-signed, as in the handshake bench
+    esp_tls_t *tls = esp_tls_init();
+    if (!tls) {
+        return NULL;
+    }
+    if (esp_tls_conn_new_sync(host, strlen(host), port, &cfg, tls) != 1) {
+        esp_tls_conn_destroy(tls);
+        ESP_LOGW(TAG, "No TLS peer on %s:%d", host, port);
+        return NULL;
+    }
+    return tls;
+}
+
+/* The same over TLS: record encryption and decryption on top of the TCP cost */
+static void Bench_TLS_Throughput(const char *host, uint8_t *buffer)
+{
+    esp_tls_t *tls = Bench_TLS_Connect(host, BENCH_NET_TLS_SINK_PORT);
+    if (tls) {
+        uint64_t sent = 0;
+        int64_t start = esp_timer_get_time();
+        int64_t end = start + BENCH_NET_SECONDS * 1000000LL;
+        while (esp_timer_get_time() < end) {
+            int n = esp_tls_conn_write(tls, buffer, BENCH_NET_CHUNK);
+            if (n <= 0 && n != ESP_TLS_ERR_SSL_WANT_WRITE) {
+                break;
+            }
+            sent += n > 0 ? n : 0;
+        }
+        Bench_Report_Rate("net_tls_tx", sent, esp_timer_get_time() - start);
+        esp_tls_conn_destroy(tls);
+    }
+
+    tls = Bench_TLS_Connect(host, BENCH_NET_TLS_SOURCE_PORT);
+    if (tls) {
+        uint64_t received = 0;
+        int64_t start = esp_timer_get_time();
+        int64_t end = start + BENCH_NET_SECONDS * 1000000LL;
+        while (esp_timer_get_time() < end) {
+            int n = esp_tls_conn_read(tls, buffer, BENCH_NET_CHUNK);
+            if (n <= 0 && n != ESP_TLS_ERR_SSL_WANT_READ) {
+                break;
+            }
+            received += n > 0 ? n : 0;
+        }
+        Bench_Report_Rate("net_tls_rx", received, esp_timer_get_time() - start);
+        esp_tls_conn_destroy(tls);
+    }
+}
+
+/* The buffer profile in use, so results can be told apart */
+static void Bench_Net_Profile(void)
+{
+    Bench_Report("net_tcp_snd_buf", CONFIG_LWIP_TCP_SND_BUF_DEFAULT, "bytes");
+    Bench_Report("net_tcp_wnd", CONFIG_LWIP_TCP_WND_DEFAULT, "bytes");
+    Bench_Report("net_wifi_static_rx", CONFIG_ESP_WIFI_STATIC_RX_BUFFER_NUM, "buffers");
+    Bench_Report("net_wifi_dynamic_rx", CONFIG_ESP_WIFI_DYNAMIC_RX_BUFFER_NUM, "buffers");
+#if CONFIG_ESP_WIFI_STATIC_TX_BUFFER
+    Bench_Report("net_wifi_static_tx", CONFIG_ESP_WIFI_STATIC_TX_BUFFER_NUM, "buffers");
+#else
+    Bench_Report("net_wifi_dynamic_tx", CONFIG_ESP_WIFI_DYNAMIC_TX_BUFFER_NUM, "buffers");
+#endif
+    Bench_Report("net_wifi_rx_ba_win", CONFIG_ESP_WIFI_RX_BA_WIN, "frames");
+}
+
+static void Bench_Net_Task(void *parameter)
+{
+    Bench_Net_Profile();
+    Bench_Report("net_internal_free", heap_caps_get_free_size(MALLOC_CAP_INTERNAL) / 1024.0, "KB");
+
+    esp_netif_ip_info_t ip_info;
+    esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    if (netif && esp_netif_get_ip_info(netif, &ip_info) == ESP_OK && ip_info.gw.addr) {
+        ip_addr_t gateway;
+        ip_addr_set_ip4_u32(&gateway, ip_info.gw.addr);
+        char host[16];
+        esp_ip4addr_ntoa(&ip_info.gw, host, sizeof(host));
+        Bench_Ping("gateway", &gateway);
+        Bench_Connect_RTT("gateway", host, BENCH_NET_GATEWAY_PORT);
+    }
+
+    if (CONFIG_ESPCASTER_BENCH_TLS_CAST[0]) {
+        ip_addr_t cast;
+        if (ipaddr_aton(CONFIG_ESPCASTER_BENCH_TLS_CAST, &cast)) {
+            Bench_Ping("cast", &cast);
+        }
+        Bench_Connect_RTT("cast", CONFIG_ESPCASTER_BENCH_TLS_CAST, BENCH_TLS_CAST_PORT);
+    }
+
+    if (CONFIG_ESPCASTER_BENCH_NET_PEER[0]) {
+        uint8_t *buffer = heap_caps_malloc(BENCH_NET_CHUNK, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (buffer) {
+            memset(buffer, 0x5a, BENCH_NET_CHUNK);
+            Bench_TCP_Throughput(CONFIG_ESPCASTER_BENCH_NET_PEER, buffer);
+            Bench_TLS_Throughput(CONFIG_ESPCASTER_BENCH_NET_PEER, buffer);
+            heap_caps_free(buffer);
+        }
+        // What the buffers took at their fullest, beside the rest of the app
+        Bench_Report("net_internal_min_free", heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL) / 1024.0, "KB");
+    }
+
+    xTaskNotifyGive(bench_caller);
+    mem_task_delete(NULL);
+}
+#endif
+
+void Bench_Net_Run(void)
+{
+#if CONFIG_ESPCASTER_BENCH_NET
+    int64_t deadline = esp_timer_get_time() + BENCH_TLS_WIFI_WAIT_MS * 1000LL;
+    while (!wifi_manager_is_connected()) {
+        if (esp_timer_get_time() > deadline) {
+            ESP_LOGW(TAG, "No Wi-Fi after %d ms, network not measured", BENCH_TLS_WIFI_WAIT_MS);
+            return;
+        }
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+
+    // The TLS legs need more stack than app_main has
+    bench_caller = xTaskGetCurrentTaskHandle();
+    if (!mem_task_create(Bench_Net_Task, "Bench net", BENCH_TLS_STACK_SIZE, NULL, TASK_PLAN_CAST_CONNECT_PRIORITY,
+                         NULL, TASK_PLAN_NETWORK_CORE, MEM_TASK_STACK_INTERNAL)) {
+        ESP_LOGE(TAG, "No memory for the network bench task");
+        return;
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+#endif
+}
@@ -0,0 +1,149 @@
+#include "ESPCaster_Bench.h"
+#include <cstdio>
+#include <cstring>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#include "cast_json_writer.h"
+#include "cast_message_view.h"
+#include "cast_payload_parser.h"
+#include "chromecast_protobuf/cast_channel.pb-c.h"
+#include "spotify_stream_parser.h"
+
+static const char *TAG = "BENCH";
+
+// A MEDIA_STATUS as a speaker sends it during playback
+static const char media_status[] =
+    "{\"type\":\"MEDIA_STATUS\",\"status\":[{\"mediaSessionId\":1,\"playbackRate\":1,"
+    "\"playerState\":\"PLAYING\",\"currentTime\":42.5,\"supportedMediaCommands\":274447,"
+    "\"volume\":{\"level\":1,\"muted\":false},\"media\":{\"contentId\":\"http://192.168.1.20/stream.mp3\","
+    "\"streamType\":\"BUFFERED\",\"contentType\":\"audio/mpeg\",\"metadata\":{\"metadataType\":3,"
+    "\"title\":\"Track\",\"artist\":\"Artist\"},\"duration\":215.3},\"currentItemId\":1,"
+    "\"repeatMode\":\"REPEAT_OFF\"}],\"requestId\":12}";
+
+static volatile size_t sink;    // Keeps the measured work from being optimised out
+
+template <typename Body>
+static double Bench_Time_Us(int passes, Body body)
+{
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < passes; i++) {
+        body();
+    }
+    return (double)(esp_timer_get_time() - start) / passes;
+}
+
+static void Bench_Cast(void)
+{
+    Extensions__Api__CastChannel__CastMessage message = EXTENSIONS__API__CAST_CHANNEL__CAST_MESSAGE__INIT;
+    message.protocol_version = EXTENSIONS__API__CAST_CHANNEL__CAST_MESSAGE__PROTOCOL_VERSION__CASTV2_1_0;
+    message.source_id = const_cast<char*>("sender-0");
+    message.destination_id = const_cast<char*>("receiver-0");
+    message.namespace_ = const_cast<char*>("urn:x-cast:com.google.cast.media");
+    message.payload_type = EXTENSIONS__API__CAST_CHANNEL__CAST_MESSAGE__PAYLOAD_TYPE__STRING;
+    message.payload_utf8 = const_cast<char*>(media_status);
+
+    static uint8_t packed[1024];
+    size_t packed_size = extensions__api__cast_channel__cast_message__get_packed_size(&message);
+    if (packed_size > sizeof(packed)) {
+        ESP_LOGE(TAG, "Cast message too large: %u", (unsigned)packed_size);
+        return;
+    }
+    Bench_Report("cast_pack", Bench_Time_Us(BENCH_PROTOCOL_PASSES, [&] {
+        sink = extensions__api__cast_channel__cast_message__get_packed_size(&message);
+        sink = extensions__api__cast_channel__cast_message__pack(&message, packed);
+    }), "us");
+    Bench_Report("cast_unpack", Bench_Time_Us(BENCH_PROTOCOL_PASSES, [&] {
+        CastMessageView view;
+        sink = CastMessageDecoder::decode(packed, packed_size, view) ? view.payload_utf8.length : 0;
+    }), "us");
+}
+
+static void Bench_Json(void)
+{
+    Bench_Report("json_build", Bench_Time_Us(BENCH_PROTOCOL_PASSES, [] {
+        CastJsonWriter<512> w;
+        w.field("type", "LOAD").field_uint("requestId", 7).field("sessionId", "9F1A2C3D-4E5F-6071-8293-A4B5C6D7E8F9");
+        w.begin_object("media")
+            .field("contentId", "http://192.168.1.20/stream.mp3")
+            .field("streamType", "BUFFERED")
+            .field("contentType", "audio/mpeg")
+            .end_object();
+        w.field_bool("autoplay", true).field_number("currentTime", 0).end();
+        sink = w.size();
+    }), "us");
+
+    Bench_Report("json_parse", Bench_Time_Us(BENCH_PROTOCOL_PASSES, [] {
+        CastPayload payload;
+        sink = CastPayloadParser::parse(media_status, sizeof(media_status) - 1, payload) ? payload.media_session_id : 0;
+    }), "us");
+    // For comparison: what the cJSON fallback costs on the same payload
+    Bench_Report("cjson_parse", Bench_Time_Us(BENCH_PROTOCOL_PASSES, [] {
+        cJSON *root = cJSON_Parse(media_status);
+        sink = root != nullptr;
+        cJSON_Delete(root);
+    }), "us");
+}
+
+// A playlist tracks page shaped like the Web API's, BENCH_SPOTIFY_ITEMS long
+static size_t Bench_Spotify_Page(char *buf, size_t size)
+{
+    size_t len = snprintf(buf, size, "{\"href\":\"https://api.spotify.com/v1/playlists/x/tracks\",\"items\":[");
+    for (int i = 0; i < BENCH_SPOTIFY_ITEMS && len < size; i++) {
+        len += snprintf(buf + len, size - len,
+            "%s{\"added_at\":\"2024-01-01T00:00:00Z\",\"track\":{\"id\":\"4uLU6hMCjMI75M1A2tKU%02d\","
+            "\"name\":\"Track %d\",\"duration_ms\":215000,\"uri\":\"spotify:track:4uLU6hMCjMI75M1A2tKU%02d\","
+            "\"explicit\":false,\"popularity\":50,\"artists\":[{\"id\":\"0OdUWJ0sBjDrqHygGUXeCF\",\"name\":\"Artist\"}],"
+            "\"album\":{\"id\":\"5ht7ItJgpBH7W6vJ5BqpPr\",\"name\":\"Album\",\"images\":["
+            "{\"url\":\"https://i.scdn.co/image/ab67616d0000b273\",\"width\":640,\"height\":640},"
+            "{\"url\":\"https://i.scdn.co/image/ab67616d00001e02\",\"width\":300,\"height\":300},"
+            "{\"url\":\"https://i.scdn.co/image/ab67616d00004851\",\"width\":64,\"height\":64}]}}}",
+            i ? "," : "", i, i, i);
+    }
+    if (len < size) {
+        len += snprintf(buf + len, size - len, "],\"limit\":%d,\"next\":null,\"offset\":0,\"total\":%d}",
+                        BENCH_SPOTIFY_ITEMS, BENCH_SPOTIFY_ITEMS);
+    }
+    return len < size ? len : 0;
+}
+
+static void Bench_Spotify(void)
+{
+    const size_t size = 64 * 1024;
+    char *page = static_cast<char*>(heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    size_t len = page ? Bench_Spotify_Page(page, size) : 0;
+    if (len == 0) {
+        ESP_LOGE(TAG, "No memory for the Spotify page");
+        heap_caps_free(page);
+        return;
+    }
+
+    size_t tracks = 0;
+    bool ok = true;
+    int64_t start = esp_timer_get_time();
+    for (int pass = 0; pass < BENCH_SPOTIFY_PASSES; pass++) {
+        SpotifyStreamParser parser([&](const SpotifyTrack&) { tracks++; });
+        for (size_t offset = 0; offset < len; offset += BENCH_SPOTIFY_CHUNK) {
+            size_t n = len - offset < BENCH_SPOTIFY_CHUNK ? len - offset : BENCH_SPOTIFY_CHUNK;
+            ok = parser.feed(page + offset, n) && ok;
+        }
+        ok = parser.finish() && ok;
+    }
+    double seconds = (esp_timer_get_time() - start) / 1e6;
+    heap_caps_free(page);
+
+    if (!ok || tracks != (size_t)BENCH_SPOTIFY_ITEMS * BENCH_SPOTIFY_PASSES) {
+        ESP_LOGE(TAG, "Spotify page parsed to %u tracks", (unsigned)tracks);
+        return;
+    }
+    Bench_Report("spotify_parse_throughput", (double)len * BENCH_SPOTIFY_PASSES / seconds / (1024 * 1024), "MB/s");
+    Bench_Report("spotify_parse_items", tracks / seconds, "items/s");
+}
+
+void Bench_Protocol_Run(void)
+{
+    Bench_Cast();
+    Bench_Json();
+    Bench_Spotify();
+}
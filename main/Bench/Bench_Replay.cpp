@@ -0,0 +1,197 @@
+#include "ESPCaster_Bench.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mem_task.h"
+#include "task_plan.h"
+#include "chromecast_controller.h"
+#include "spotify_api_client.h"
+#include "traffic_format.h"
+extern "C" {
+#include "SD_MMC.h"
+}
+
+static const char *TAG = "BENCH";
+
+static TaskHandle_t bench_caller;
+static volatile size_t sink;    // Keeps the parsed records from being optimised out
+
+// Handling times of one kind of record, in us
+struct Bench_Replay_Times {
+    std::vector<uint32_t> us;
+    uint64_t bytes = 0;
+};
+
+static void Bench_Replay_Report(const char *kind, Bench_Replay_Times& times)
+{
+    char key[48];
+    snprintf(key, sizeof(key), "replay_%s_records", kind);
+    Bench_Report(key, times.us.size(), "count");
+    if (times.us.empty()) {
+        return;
+    }
+    std::sort(times.us.begin(), times.us.end());
+    uint64_t total_us = 0;
+    for (uint32_t us : times.us) {
+        total_us += us;
+    }
+    int count = (int)times.us.size();
+    snprintf(key, sizeof(key), "replay_%s_throughput", kind);
+    Bench_Report(key, total_us ? times.bytes * 1000000.0 / total_us / 1024.0 : 0, "KB/s");
+    snprintf(key, sizeof(key), "replay_%s_p50", kind);
+    Bench_Report(key, times.us[(50 * count + 99) / 100 - 1], "us");
+    snprintf(key, sizeof(key), "replay_%s_p99", kind);
+    Bench_Report(key, times.us[(99 * count + 99) / 100 - 1], "us");
+    snprintf(key, sizeof(key), "replay_%s_max", kind);
+    Bench_Report(key, times.us.back(), "us");
+}
+
+// The Spotify call that made the recorded request, answered by the record
+static bool Bench_Replay_Spotify(SpotifyApiClient& client, const traffic_record_t& record)
+{
+    auto track = [](const SpotifyTrack& t) { sink = t.name.size(); };
+    switch (traffic_spotify_endpoint(record.key)) {
+    case TRAFFIC_SPOTIFY_PLAYLISTS:
+        return client.stream_user_playlists([](const SpotifyPlaylist& p) { sink = p.name.size(); });
+    case TRAFFIC_SPOTIFY_PLAYLIST_TRACKS:
+        return client.stream_playlist_tracks("replay", track);
+    case TRAFFIC_SPOTIFY_SEARCH:
+        return client.stream_search_tracks("replay", track);
+    case TRAFFIC_SPOTIFY_QUEUE:
+        return client.stream_queue(track);
+    case TRAFFIC_SPOTIFY_SEVERAL_TRACKS:
+        return client.stream_several_tracks({"replay"}, track);
+    case TRAFFIC_SPOTIFY_SEVERAL_ALBUMS:
+        return client.stream_several_albums({"replay"}, [](const SpotifyAlbum& a) { sink = a.name.size(); });
+    case TRAFFIC_SPOTIFY_SEVERAL_ARTISTS:
+        return client.stream_several_artists({"replay"}, [](const SpotifyArtist& a) { sink = a.name.size(); });
+    case TRAFFIC_SPOTIFY_PLAYBACK:
+        return client.get_playback_state();
+    case TRAFFIC_SPOTIFY_DEVICES:
+        return client.get_available_devices();
+    case TRAFFIC_SPOTIFY_OTHER:
+        break;
+    }
+    return false;
+}
+
+static void Bench_Replay(FILE *file)
+{
+    traffic_reader_t reader;
+    if (!traffic_reader_open(&reader, file)) {
+        ESP_LOGE(TAG, "%s is not a traffic capture", CONFIG_ESPCASTER_BENCH_REPLAY);
+        fclose(file);
+        return;
+    }
+
+    // Neither connects: the Cast controller needs its mutexes, the Spotify
+    // client nothing, as every request is answered by the record
+    ChromecastController *cast = new ChromecastController();
+    SpotifyApiClient *spotify = new SpotifyApiClient();
+    if (!cast->initialize()) {
+        ESP_LOGE(TAG, "Cast controller did not initialise, replay skipped");
+        delete spotify;
+        delete cast;
+        traffic_reader_close(&reader);
+        return;
+    }
+    traffic_record_t record;
+    spotify->set_replay_source([&record](const SpotifyApiRequest&, SpotifyApiResponse& response) {
+        response.status_code = record.status;
+        response.body.assign((const char *)record.body, record.body_length);
+        return true;
+    });
+
+    Bench_Replay_Times cast_times, spotify_times;
+    int failed = 0, skipped = 0;
+    int64_t start_us = esp_timer_get_time();
+    uint64_t first_us = 0;
+    bool first = true;
+    int result;
+    while ((result = traffic_reader_next(&reader, &record)) == 1) {
+        if (first) {
+            first_us = record.time_us;
+            first = false;
+        }
+#if CONFIG_ESPCASTER_BENCH_REPLAY_REALTIME
+        int64_t due_us = start_us + (int64_t)(record.time_us - first_us);
+        int64_t wait_us = due_us - esp_timer_get_time();
+        if (wait_us > 1000) {
+            vTaskDelay(pdMS_TO_TICKS(wait_us / 1000));
+        }
+#endif
+        bool is_cast = record.kind == TRAFFIC_CAST_FRAME;
+        if (!is_cast && (record.status < 200 || record.status >= 300 ||
+                         traffic_spotify_endpoint(record.key) == TRAFFIC_SPOTIFY_OTHER)) {
+            skipped++;          // Errors and command replies: nothing is parsed
+            continue;
+        }
+        int64_t t0 = esp_timer_get_time();
+        bool ok = is_cast ? cast->replay_message(record.body, record.body_length)
+                          : Bench_Replay_Spotify(*spotify, record);
+        uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+        if (!ok) {
+            failed++;
+            ESP_LOGW(TAG, "Replay of %s failed", is_cast ? "a Cast frame" : record.key);
+            continue;
+        }
+        Bench_Replay_Times& times = is_cast ? cast_times : spotify_times;
+        times.us.push_back(us);
+        times.bytes += record.body_length;
+    }
+    if (result < 0) {
+        ESP_LOGW(TAG, "Capture corrupt after %u records", (unsigned)(cast_times.us.size() + spotify_times.us.size()));
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+
+    Bench_Replay_Report("cast", cast_times);
+    Bench_Replay_Report("spotify", spotify_times);
+    Bench_Report("replay_failed", failed, "count");
+    Bench_Report("replay_skipped", skipped, "count");
+    Bench_Report("replay_elapsed", elapsed_us / 1000.0, "ms");
+
+    spotify->set_replay_source(nullptr);
+    delete spotify;
+    delete cast;
+    traffic_reader_close(&reader);
+}
+
+static void Bench_Replay_Task(void *parameter)
+{
+    FILE *file = (FILE *)parameter;
+    Bench_Replay(file);
+    xTaskNotifyGive(bench_caller);
+    mem_task_delete(NULL);
+}
+
+void Bench_Replay_Run(void)
+{
+    const char *path = CONFIG_ESPCASTER_BENCH_REPLAY;
+    if (!path[0]) {
+        return;
+    }
+    if (strncmp(path, SD_MOUNT_POINT "/", strlen(SD_MOUNT_POINT) + 1) == 0) {
+        SD_Init();
+    }
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        ESP_LOGE(TAG, "Cannot open %s, replay skipped", path);
+        return;
+    }
+
+    // The controllers' handlers want more stack than app_main has
+    bench_caller = xTaskGetCurrentTaskHandle();
+    if (!mem_task_create(Bench_Replay_Task, "Bench replay", BENCH_REPLAY_STACK_SIZE, file,
+                         TASK_PLAN_BACKGROUND_PRIORITY, NULL, TASK_PLAN_BACKGROUND_CORE, MEM_TASK_STACK_INTERNAL)) {
+        ESP_LOGE(TAG, "No memory for the replay bench task");
+        fclose(file);
+        return;
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
@@ -0,0 +1,123 @@
+#include "ESPCaster_Bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_tls.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/ssl_ciphersuites.h"
+#include "mem_task.h"
+#include "task_plan.h"
+#include "tls_profile.h"
+#include "wifi_manager.h"
+
+static const char *TAG = "BENCH";
+
+static TaskHandle_t bench_caller;
+
+/* Connect and handshake once, offering suites (NULL: mbedTLS's own list);
+ * the time in us, or -1 if the server took none of them */
+static int64_t Bench_Handshake(const char *host, int port, const int *suites, int *negotiated)
+{
+    esp_tls_cfg_t cfg = {0};
+    cfg.timeout_ms = BENCH_TLS_TIMEOUT_MS;
+    cfg.skip_common_name = true;
+    cfg.crt_bundle_attach = NULL;       // Self-signed, as speakers are
+    cfg.ciphersuites_list = suites;
+
+    esp_tls_t *tls = esp_tls_init();
+    if (!tls) {
+        return -1;
+    }
+    int64_t start = esp_timer_get_time();
+    int ret = esp_tls_conn_new_sync(host, strlen(host), port, &cfg, tls);
+    int64_t us = esp_timer_get_time() - start;
+    if (ret == 1 && negotiated) {
+        *negotiated = mbedtls_ssl_get_ciphersuite_id_from_ssl(esp_tls_get_ssl_context(tls));
+    }
+    esp_tls_conn_destroy(tls);
+    return ret == 1 ? us : -1;
+}
+
+/* BENCH_TLS_HANDSHAKES in a row; the first is counted too, as there is no
+ * session to resume: every one is a full handshake */
+static void Bench_Suites(const char *target, const char *host, int port, const char *label, const int *suites)
+{
+    int64_t total = 0, best = INT64_MAX;
+    int negotiated = 0;
+    for (int i = 0; i < BENCH_TLS_HANDSHAKES; i++) {
+        int64_t us = Bench_Handshake(host, port, suites, &negotiated);
+        if (us < 0) {
+            ESP_LOGI(TAG, "%s: %s not taken", target, label);
+            return;
+        }
+        total += us;
+        best = us < best ? us : best;
+    }
+
+    char key[96];
+    snprintf(key, sizeof(key), "tls_%s_%s", target, label);
+    Bench_Report(key, total / 1000.0 / BENCH_TLS_HANDSHAKES, "ms");
+    snprintf(key, sizeof(key), "tls_%s_%s_min", target, label);
+    Bench_Report(key, best / 1000.0, "ms");
+    if (!suites || suites[1]) {
+        // A list: which one the server picked
+        ESP_LOGI(TAG, "%s: %s negotiated %s", target, label, mbedtls_ssl_get_ciphersuite_name(negotiated));
+    }
+}
+
+static void Bench_Target(const char *target, const char *host, int port, tls_profile_t profile)
+{
+    Bench_Suites(target, host, port, "default", NULL);
+    Bench_Suites(target, host, port, "profile", tls_profile_ciphersuites(profile));
+    for (const int *id = tls_profile_bench_suites(); *id; id++) {
+        const int one[] = { *id, 0 };
+        const char *name = mbedtls_ssl_get_ciphersuite_name(*id);
+        Bench_Suites(target, host, port, strncmp(name, "TLS-", 4) ? name : name + 4, one);
+    }
+}
+
+static void Bench_TLS_Task(void *parameter)
+{
+    // "host:port" of a local test server, see README
+    char local[sizeof(CONFIG_ESPCASTER_BENCH_TLS_LOCAL)];
+    strcpy(local, CONFIG_ESPCASTER_BENCH_TLS_LOCAL);
+    char *colon = strrchr(local, ':');
+    if (colon) {
+        *colon = '\0';
+        Bench_Target("local", local, atoi(colon + 1), TLS_PROFILE_WEB);
+    }
+    if (CONFIG_ESPCASTER_BENCH_TLS_CAST[0]) {
+        Bench_Target("cast", CONFIG_ESPCASTER_BENCH_TLS_CAST, BENCH_TLS_CAST_PORT, TLS_PROFILE_CAST);
+    }
+    xTaskNotifyGive(bench_caller);
+    mem_task_delete(NULL);
+}
+
+void Bench_TLS_Run(void)
+{
+    if (!CONFIG_ESPCASTER_BENCH_TLS_LOCAL[0] && !CONFIG_ESPCASTER_BENCH_TLS_CAST[0]) {
+        return;
+    }
+    int64_t deadline = esp_timer_get_time() + BENCH_TLS_WIFI_WAIT_MS * 1000LL;
+    while (!wifi_manager_is_connected()) {
+        if (esp_timer_get_time() > deadline) {
+            ESP_LOGW(TAG, "No Wi-Fi after %d ms, TLS handshakes not measured", BENCH_TLS_WIFI_WAIT_MS);
+            return;
+        }
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+
+    // A handshake needs more stack than app_main has
+    bench_caller = xTaskGetCurrentTaskHandle();
+    if (!mem_task_create(Bench_TLS_Task, "Bench TLS", BENCH_TLS_STACK_SIZE, NULL, TASK_PLAN_CAST_CONNECT_PRIORITY,
+                         NULL, TASK_PLAN_NETWORK_CORE, MEM_TASK_STACK_INTERNAL)) {
+        ESP_LOGE(TAG, "No memory for the TLS bench task");
+        return;
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
@@ -0,0 +1,258 @@
+#include "ESPCaster_Bench.h"
+#include <stdio.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include "esp_app_desc.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_private/esp_clk.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lvgl.h"
+#include "Display_SPD2010.h"
+#include "Touch_SPD2010.h"
+#include "PCM5101.h"
+#include "Audio_DSP.h"
+#include "MP3_Benchmark.h"
+#include "Power_Manager.h"
+#include "SD_MMC.h"
+#if CONFIG_QMI8658_FUSION
+#include "QMI8658_Fusion.h"
+#endif
+
+static const char *TAG = "BENCH";
+
+static unsigned report_count;
+
+void Bench_Report(const char *name, double value, const char *unit)
+{
+    printf("BENCH,%s,%.3f,%s\n", name, value, unit);
+    report_count++;
+}
+
+// lv_refr_now() returns with the last area still on its way to the panel
+static void Bench_Wait_Flush(lv_disp_t *disp)
+{
+    while (disp->driver->draw_buf->flushing) {
+    }
+}
+
+// Recolours a w x h box every frame: a solid fill, so the time is mostly
+// the flush (and, in direct mode, the sync of the other buffer)
+static void Bench_Flush(const char *name, lv_coord_t w, lv_coord_t h)
+{
+    lv_disp_t *disp = lv_disp_get_default();
+    lv_obj_t *box = lv_obj_create(lv_scr_act());
+    lv_obj_remove_style_all(box);
+    lv_obj_set_size(box, w, h);
+    lv_obj_center(box);
+    lv_obj_set_style_bg_opa(box, LV_OPA_COVER, 0);
+    lv_refr_now(disp);          // Not counted: the first frame repaints everything
+    Bench_Wait_Flush(disp);
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < BENCH_FLUSH_FRAMES; i++) {
+        lv_obj_set_style_bg_color(box, (i & 1) ? lv_color_white() : lv_color_black(), 0);
+        lv_refr_now(disp);
+        Bench_Wait_Flush(disp);
+    }
+    double seconds = (esp_timer_get_time() - start) / 1e6;
+    lv_obj_del(box);
+
+    char key[32];
+    double bytes = (double)w * h * sizeof(lv_color_t) * BENCH_FLUSH_FRAMES;
+    snprintf(key, sizeof(key), "%s_fps", name);
+    Bench_Report(key, BENCH_FLUSH_FRAMES / seconds, "fps");
+    snprintf(key, sizeof(key), "%s_throughput", name);
+    Bench_Report(key, bytes / seconds / (1024 * 1024), "MB/s");
+    // Of what four lines at the SPI clock could carry, render time included
+    snprintf(key, sizeof(key), "%s_bus_use", name);
+    Bench_Report(key, 100.0 * bytes / seconds / ESP_PANEL_LCD_SPI_MAX_BYTES_PER_S, "%");
+}
+
+// The I2C read alone; the touch task only reads on an interrupt, so leave the screen alone
+static void Bench_Touch(void)
+{
+    SPD2010_Touch touch;
+    uint32_t min_us = UINT32_MAX, max_us = 0, errors = 0;
+    uint64_t total_us = 0;
+    for (int i = 0; i < BENCH_TOUCH_READS; i++) {
+        int64_t start = esp_timer_get_time();
+        if (tp_read_data(&touch) != ESP_OK) {
+            errors++;
+        }
+        uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+        total_us += us;
+        min_us = us < min_us ? us : min_us;
+        max_us = us > max_us ? us : max_us;
+    }
+    Bench_Report("touch_read_min", min_us, "us");
+    Bench_Report("touch_read_avg", (double)total_us / BENCH_TOUCH_READS, "us");
+    Bench_Report("touch_read_max", max_us, "us");
+    Bench_Report("touch_read_errors", errors, "count");
+}
+
+static void Bench_Gain(void)
+{
+    int16_t *in = heap_caps_malloc(AUDIO_GAIN_CHUNK_SAMPLES * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    int16_t *out = heap_caps_malloc(AUDIO_GAIN_CHUNK_SAMPLES * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!in || !out) {
+        ESP_LOGE(TAG, "Out of memory for the gain buffers");
+        goto done;
+    }
+    for (int i = 0; i < AUDIO_GAIN_CHUNK_SAMPLES; i++) {
+        in[i] = (int16_t)(i * 127);
+    }
+
+    uint64_t steady = 0, ramp = 0;
+    for (int pass = 0; pass < BENCH_GAIN_PASSES; pass++) {
+        steady += Audio_Gain_Bench(in, out, AUDIO_GAIN_CHUNK_SAMPLES, false);
+        ramp += Audio_Gain_Bench(in, out, AUDIO_GAIN_CHUNK_SAMPLES, true);
+    }
+    double samples = (double)BENCH_GAIN_PASSES * AUDIO_GAIN_CHUNK_SAMPLES;
+    Bench_Report("i2s_gain_steady", steady / samples, "cycles/sample");
+    Bench_Report("i2s_gain_ramp", ramp / samples, "cycles/sample");
+#if CONFIG_AUDIO_DSP
+    uint64_t dsp = 0;
+    for (int pass = 0; pass < BENCH_GAIN_PASSES; pass++) {
+        dsp += Audio_DSP_Bench(in, out, AUDIO_GAIN_CHUNK_SAMPLES);
+    }
+    Bench_Report("i2s_dsp", dsp / samples, "cycles/sample");
+    // Of one core, playing 44.1 kHz stereo
+    Bench_Report("i2s_dsp_load", 100.0 * dsp / samples * 44100 * 2 / esp_clk_cpu_freq(), "%");
+#endif
+
+done:
+    heap_caps_free(in);
+    heap_caps_free(out);
+}
+
+typedef struct {
+    volatile bool run;
+    int64_t max_gap_us;
+    int64_t stalled_us;         // Sum of the gaps past BENCH_STALL_US
+    TaskHandle_t caller;
+} Bench_Stall_t;
+
+// Takes the time in a loop on the other core: any gap is time this code,
+// run from flash like the decoder and LVGL (or from PSRAM), could not run
+static void Bench_Stall_Task(void *arg)
+{
+    Bench_Stall_t *stall = arg;
+    int64_t last = esp_timer_get_time();
+    while (stall->run) {
+        int64_t now = esp_timer_get_time();
+        int64_t gap = now - last;
+        if (gap > stall->max_gap_us) {
+            stall->max_gap_us = gap;
+        }
+        if (gap > BENCH_STALL_US) {
+            stall->stalled_us += gap;
+        }
+        last = now;
+    }
+    xTaskNotifyGive(stall->caller);
+    vTaskDelete(NULL);
+}
+
+// Writes a file on the flash FAT, erases and all, while core 1 keeps time:
+// compare flash_write_max_stall between the default and the sdkconfig.xip builds
+static void Bench_Flash_Write(void)
+{
+    const char *path = FLASH_FAT_MOUNT_POINT "/.bench.bin";
+    uint8_t *block = heap_caps_malloc(BENCH_FLASH_BLOCK, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    FILE *f = block ? fopen(path, "wb") : NULL;
+    if (!f) {
+        ESP_LOGE(TAG, "Cannot write %s", path);
+        heap_caps_free(block);
+        return;
+    }
+    memset(block, 0xA5, BENCH_FLASH_BLOCK);
+
+    Bench_Stall_t stall = { .run = true, .caller = xTaskGetCurrentTaskHandle() };
+    if (xTaskCreatePinnedToCore(Bench_Stall_Task, "bench_stall", 2048, &stall,
+                                BENCH_STALL_PRIORITY, NULL, 1) != pdPASS) {
+        ESP_LOGE(TAG, "Cannot start the stall task");
+        fclose(f);
+        heap_caps_free(block);
+        unlink(path);
+        return;
+    }
+
+    size_t written = 0;
+    int64_t start = esp_timer_get_time();
+    while (written < BENCH_FLASH_WRITE_KB * 1024 && fwrite(block, 1, BENCH_FLASH_BLOCK, f) == BENCH_FLASH_BLOCK) {
+        written += BENCH_FLASH_BLOCK;
+    }
+    fflush(f);
+    fsync(fileno(f));
+    double seconds = (esp_timer_get_time() - start) / 1e6;
+    stall.run = false;
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    fclose(f);
+    unlink(path);
+    heap_caps_free(block);
+
+    if (written < BENCH_FLASH_WRITE_KB * 1024) {
+        ESP_LOGW(TAG, "Flash FAT full after %u KB", (unsigned)(written / 1024));
+    }
+    Bench_Report("flash_write_throughput", written / 1024.0 / seconds, "KB/s");
+    Bench_Report("flash_write_max_stall", stall.max_gap_us, "us");
+    Bench_Report("flash_write_stalled", 100.0 * stall.stalled_us / (seconds * 1e6), "%");
+}
+
+static void Bench_MP3(void)
+{
+    MP3_Bench_Result_t r;
+    if (!MP3_Benchmark_Run(&r)) {
+        return;
+    }
+    Bench_Report("mp3_decode_min", r.cycles_min, "cycles/frame");
+    Bench_Report("mp3_decode_avg", r.cycles_avg, "cycles/frame");
+    Bench_Report("mp3_decode_max", r.cycles_max, "cycles/frame");
+    Bench_Report("mp3_decode_load", r.core_load, "%");
+}
+
+static void Bench_Fusion(void)
+{
+#if CONFIG_QMI8658_FUSION
+    uint32_t cycles = QMI8658_Fusion_Bench(BENCH_FUSION_SAMPLES);
+    Bench_Report("imu_fusion", cycles, "cycles/sample");
+    Bench_Report("imu_fusion_load", 100.0 * cycles * QMI8658_FIFO_ODR_HZ / esp_clk_cpu_freq(), "%");
+    qmi8658_fusion_stats_t live;
+    QMI8658_Fusion_Get_Stats(&live);
+    Bench_Report("imu_fusion_live_max", live.cycles_max, "cycles/sample");
+#endif
+}
+
+void ESPCaster_Bench_Run(void)
+{
+    const esp_app_desc_t *app = esp_app_get_description();
+    // Full clock throughout, so runs compare whatever the power profile
+    Power_Hold(POWER_LOCK_RENDER, true);
+    printf("BENCH,begin,%s,%s\n", app->version, app->idf_ver);
+    report_count = 0;
+    Bench_Report("cpu_clock", esp_clk_cpu_freq() / 1e6, "MHz");
+    Bench_Report("panel_bus_max", ESP_PANEL_LCD_SPI_MAX_BYTES_PER_S / (1024.0 * 1024), "MB/s");
+
+    Bench_Flush("flush_full", LV_HOR_RES, LV_VER_RES);
+    Bench_Flush("flush_partial", BENCH_PARTIAL_SIZE, BENCH_PARTIAL_SIZE);
+    lv_obj_invalidate(lv_scr_act());
+
+    Bench_Touch();
+    Bench_Latency_Run();
+    Bench_Gain();
+    Bench_MP3();
+    Bench_Fusion();
+    Bench_Flash_Write();
+    Bench_Protocol_Run();
+    Bench_Replay_Run();
+    Bench_TLS_Run();
+    Bench_Net_Run();
+
+    printf("BENCH,end,%u,-\n", report_count);
+    Power_Hold(POWER_LOCK_RENDER, false);
+}
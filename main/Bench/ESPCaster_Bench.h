@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * espcaster_bench: on-target benchmarks of the UI, audio, storage, protocol
+ * and JSON hot paths (CONFIG_ESPCASTER_BENCH; build with the sdkconfig.bench
+ * overlay, see README, "Benchmarks").
+ *
+ * ESPCaster_Bench_Run() runs once from app_main after LVGL_Init(), before
+ * the LVGL task exists, so it drives LVGL and the panel itself; the app
+ * starts as usual afterwards. Every result is one console line
+ *
+ *   BENCH,<name>,<value>,<unit>
+ *
+ * between "BENCH,begin,<app version>,<IDF version>" and
+ * "BENCH,end,<result count>,-", so a script can pick them out of the serial
+ * log and compare releases.
+ */
+
+#define BENCH_FLUSH_FRAMES      60
+#define BENCH_PARTIAL_SIZE      100     // Side of the square partial update, px
+#define BENCH_TOUCH_READS       100
+#define BENCH_GAIN_PASSES       200     // Of AUDIO_GAIN_CHUNK_SAMPLES
+#define BENCH_PROTOCOL_PASSES   500
+#define BENCH_SPOTIFY_ITEMS     50      // Tracks in the synthetic playlist page
+#define BENCH_SPOTIFY_PASSES    20
+#define BENCH_SPOTIFY_CHUNK     1024    // Bytes per feed(), as HTTP_EVENT_ON_DATA delivers
+#define BENCH_FUSION_SAMPLES    2000    // Synthetic IMU samples, about 17 s of data
+#define BENCH_FLASH_WRITE_KB    128     // Written to the flash FAT, then deleted
+#define BENCH_FLASH_BLOCK       4096    // Bytes per fwrite(), one FAT sector
+#define BENCH_STALL_US          100     // A longer gap in the timekeeping loop counts as stalled
+#define BENCH_STALL_PRIORITY    20      // Above everything on core 1 while it runs
+#define BENCH_TLS_HANDSHAKES    5       // Per suite and server
+#define BENCH_TLS_TIMEOUT_MS    10000
+#define BENCH_TLS_WIFI_WAIT_MS  20000   // For the connection the boot started
+#define BENCH_TLS_CAST_PORT     8009
+#define BENCH_TLS_STACK_SIZE    (8 * 1024)
+#define BENCH_LATENCY_SAMPLES   30      // Touches per interaction
+#define BENCH_LATENCY_WAIT_MS   300     // For one touch to reach the panel
+#define BENCH_LATENCY_SETTLE_MS 40      // LVGL run before each touch, plus up to an indev period of jitter
+#define BENCH_LATENCY_STEP_PX   10      // Finger move per drag sample
+#define BENCH_REPLAY_STACK_SIZE (8 * 1024)
+#define BENCH_NET_PINGS         20
+#define BENCH_NET_PING_INTERVAL_MS 100
+#define BENCH_NET_CONNECTS      10      // TCP handshakes per target
+#define BENCH_NET_TIMEOUT_MS    1000
+#define BENCH_NET_GATEWAY_PORT  80      // Open or closed, the handshake is timed
+#define BENCH_NET_SECONDS       5       // Per throughput leg
+#define BENCH_NET_CHUNK         4096    // Bytes per send() / recv()
+#define BENCH_NET_SINK_PORT     5001    // tools/net_peer.py; iperf 2's server takes the upload too
+#define BENCH_NET_SOURCE_PORT   5002
+#define BENCH_NET_TLS_SINK_PORT 5003
+#define BENCH_NET_TLS_SOURCE_PORT 5004
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void ESPCaster_Bench_Run(void);
+void Bench_Report(const char *name, double value, const char *unit);
+
+void Bench_Protocol_Run(void);      // Bench_Protocol.cpp: Cast, JSON and Spotify parsing
+void Bench_Replay_Run(void);        // Bench_Replay.cpp: a traffic capture through the controllers
+void Bench_TLS_Run(void);           // Bench_TLS.c: full handshakes per cipher suite
+void Bench_Net_Run(void);           // Bench_Net.c: RTT and TCP / TLS throughput
+void Bench_Latency_Run(void);       // Bench_Latency.c: touch to photon, injected touches
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,514 @@
+#include "ble_control.h"
+#include "sdkconfig.h"
+
+#if CONFIG_BLE_CONTROL
+#include "chromecast_gui_manager.h"
+#include "spotify_gui_manager.h"
+#include "gui_event_bus.h"
+#include "now_playing_store.h"
+#include "ui_widget_pool.h"
+#include "Power_Manager.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "host/ble_hs.h"
+#include "host/util/util.h"
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+#include "services/gap/ble_svc_gap.h"
+#include "services/gatt/ble_svc_gatt.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "ble_control";
+
+// NimBLE's NVS bond store; not declared in its public headers
+void ble_store_config_init(void);
+
+// c0a80001-7b3e-4f51-9d2a-e5ca57e700nn, least significant byte first
+#define BLE_CONTROL_UUID(n) \
+    BLE_UUID128_INIT((n), 0x00, 0xe7, 0x57, 0xca, 0xe5, 0x2a, 0x9d, 0x51, 0x4f, 0x3e, 0x7b, 0x01, 0x00, 0xa8, 0xc0)
+
+#define ADV_INTERVAL_MS         418     // A phone finds it within a scan or two
+#define CONN_INTERVAL_MIN       12      // 1.25 ms units: 15 ms, a command applies in one event
+#define CONN_INTERVAL_MAX       24      // 30 ms
+#define CONN_LATENCY            4       // Events the unit may sleep through with nothing to send
+#define CONN_SUPERVISION        400     // 10 ms units: 4 s
+
+#define VALUE_KEEP              0xFF    // Volume write: leave as is; read: not known
+#define VOLUME_MUTED            (1u << 0)
+#define STATE_PLAYING           (1u << 0)
+#define STATE_MUTED             (1u << 1)
+#define STATE_HEADER            6       // Flags, volume, position, duration
+
+// Not on the wire: a Volume write, as queued for the LVGL thread
+#define OP_SET_VOLUME           0x80
+
+#define PASSKEY_RANGE           1000000 // Six digits
+
+#if CONFIG_BLE_CONTROL_OPEN
+#define WRITE_ACCESS            (BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP)
+#else
+// Only over a link encrypted with a passkey-authenticated key; the central pairs when refused
+#define WRITE_ACCESS            (BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP | \
+                                 BLE_GATT_CHR_F_WRITE_ENC | BLE_GATT_CHR_F_WRITE_AUTHEN)
+#endif
+
+typedef enum {
+    CHR_VOLUME,
+    CHR_TRANSPORT,
+    CHR_STATE,
+} characteristic_t;
+
+static const ble_uuid128_t SERVICE_UUID = BLE_CONTROL_UUID(0x00);
+static const ble_uuid128_t VOLUME_UUID = BLE_CONTROL_UUID(0x01);
+static const ble_uuid128_t TRANSPORT_UUID = BLE_CONTROL_UUID(0x02);
+static const ble_uuid128_t STATE_UUID = BLE_CONTROL_UUID(0x03);
+
+static bool s_started;
+static uint8_t s_own_addr_type;
+static uint16_t s_volume_handle;
+static uint16_t s_state_handle;
+
+// Built on the LVGL thread, read on the host task
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t s_volume[2] = { VALUE_KEEP, 0 };
+static uint8_t s_state[STATE_HEADER + BLE_CONTROL_TITLE_MAX] = { 0, VALUE_KEEP };
+static size_t s_state_len = STATE_HEADER;
+
+// LVGL thread: the level last asked for, so quick steps add up before the speaker replies
+static chromecast_volume_info_t s_target;
+static bool s_target_valid;
+
+// LVGL thread: the passkey on screen while a central pairs
+static ui_modal_t *s_passkey_modal;
+
+static int access_cb(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg);
+
+static const struct ble_gatt_svc_def SERVICES[] = {
+    {
+        .type = BLE_GATT_SVC_TYPE_PRIMARY,
+        .uuid = &SERVICE_UUID.u,
+        .characteristics = (struct ble_gatt_chr_def[]) {
+            {
+                .uuid = &VOLUME_UUID.u,
+                .access_cb = access_cb,
+                .arg = (void *)(uintptr_t)CHR_VOLUME,
+                .flags = BLE_GATT_CHR_F_READ | WRITE_ACCESS | BLE_GATT_CHR_F_NOTIFY,
+                .val_handle = &s_volume_handle,
+            },
+            {
+                .uuid = &TRANSPORT_UUID.u,
+                .access_cb = access_cb,
+                .arg = (void *)(uintptr_t)CHR_TRANSPORT,
+                .flags = WRITE_ACCESS,
+            },
+            {
+                .uuid = &STATE_UUID.u,
+                .access_cb = access_cb,
+                .arg = (void *)(uintptr_t)CHR_STATE,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
+                .val_handle = &s_state_handle,
+            },
+            { 0 },
+        },
+    },
+    { 0 },
+};
+
+/**********************************************************************************
+ * Commands (LVGL thread)
+ **********************************************************************************/
+// Packed into the event bus argument, so a write allocates nothing
+#define COMMAND_PACK(op, level, muted) \
+    ((void *)(uintptr_t)((uint32_t)(op) | ((uint32_t)(level) << 8) | ((uint32_t)(muted) << 16)))
+
+static chromecast_controller_handle_t connected_chromecast(void) {
+    chromecast_controller_handle_t handle = chromecast_gui_get_controller_handle();
+    if (!handle || chromecast_controller_get_state(handle) != CHROMECAST_CONNECTED) {
+        return NULL;
+    }
+    return handle;
+}
+
+static spotify_controller_handle_t connected_spotify(void) {
+    spotify_controller_handle_t handle = spotify_gui_get_controller_handle();
+    if (!handle || !spotify_controller_is_connected(handle)) {
+        return NULL;
+    }
+    return handle;
+}
+
+static bool change_volume(uint8_t op, uint8_t level, uint8_t muted) {
+    chromecast_controller_handle_t chromecast = connected_chromecast();
+    if (!chromecast) {
+        return false;
+    }
+    chromecast_volume_info_t volume = { 0 };
+    bool known = s_target_valid;
+    if (known) {
+        volume = s_target;
+    } else {
+        known = chromecast_controller_get_volume(chromecast, &volume);
+    }
+    if (!known && !(op == OP_SET_VOLUME && level != VALUE_KEEP)) {
+        return false;       // Nothing to step from or keep
+    }
+
+    switch (op) {
+        case OP_SET_VOLUME:
+            if (level != VALUE_KEEP) {
+                volume.level = level / 100.0f;
+            }
+            if (muted != VALUE_KEEP) {
+                volume.muted = muted;
+            }
+            break;
+        case BLE_CONTROL_OP_MUTE:
+            volume.muted = !volume.muted;
+            break;
+        default: {
+            int step = (op == BLE_CONTROL_OP_VOLUME_UP) ? BLE_CONTROL_VOLUME_STEP : -BLE_CONTROL_VOLUME_STEP;
+            // Whole steps: "up" from 43% goes to 45%, not 48%
+            long percent = lroundf((volume.level * 100.0f + step) / BLE_CONTROL_VOLUME_STEP) * BLE_CONTROL_VOLUME_STEP;
+            volume.level = fmaxf(0.0f, fminf(1.0f, percent / 100.0f));
+            volume.muted = false;
+            break;
+        }
+    }
+
+    if (!chromecast_controller_request_volume(chromecast, volume.level, volume.muted)) {
+        return false;
+    }
+    s_target = volume;
+    s_target_valid = true;
+    return true;
+}
+
+static bool control_playback(uint8_t op) {
+    spotify_controller_handle_t spotify = connected_spotify();
+    if (!spotify) {
+        return false;
+    }
+    if (op == BLE_CONTROL_OP_TOGGLE) {
+        op = now_playing_store_get()->is_playing ? BLE_CONTROL_OP_PAUSE : BLE_CONTROL_OP_PLAY;
+    }
+    switch (op) {
+        case BLE_CONTROL_OP_PLAY:       return spotify_controller_play(spotify, NULL);
+        case BLE_CONTROL_OP_PAUSE:      return spotify_controller_pause(spotify);
+        case BLE_CONTROL_OP_NEXT:       return spotify_controller_next_track(spotify);
+        case BLE_CONTROL_OP_PREVIOUS:   return spotify_controller_previous_track(spotify);
+        default:                        return false;
+    }
+}
+
+static void run_command(void *arg) {
+    uint32_t packed = (uint32_t)(uintptr_t)arg;
+    uint8_t op = packed & 0xFF;
+    // Listen for the reply before the request goes out; the screen stays as it is
+    Power_Wifi_Wake(BLE_CONTROL_WIFI_WAKE_MS);
+    bool queued = (op == OP_SET_VOLUME || op >= BLE_CONTROL_OP_VOLUME_UP)
+                      ? change_volume(op, (packed >> 8) & 0xFF, (packed >> 16) & 0xFF)
+                      : control_playback(op);
+    if (!queued) {
+        ESP_LOGW(TAG, "Command 0x%02x not run", op);
+    }
+}
+
+/**********************************************************************************
+ * Pairing (LVGL thread)
+ **********************************************************************************/
+static void hide_passkey(void *arg) {
+    if (s_passkey_modal) {
+        ui_widget_pool_modal_close(s_passkey_modal);
+        s_passkey_modal = NULL;
+    }
+}
+
+static void passkey_close_cb(lv_event_t *e) {
+    hide_passkey(NULL);
+}
+
+static void show_passkey(void *arg) {
+    char text[64];
+    snprintf(text, sizeof(text), "Bluetooth pairing\n\nEnter on the remote:\n%06" PRIu32,
+             (uint32_t)(uintptr_t)arg);
+
+    // Pairing is the one BLE event that needs the screen
+    lv_disp_trig_activity(NULL);
+    if (!s_passkey_modal) {
+        s_passkey_modal = ui_widget_pool_modal_open(260, 180, NULL, true);
+        if (!s_passkey_modal) {
+            ESP_LOGW(TAG, "Passkey not shown");
+            return;
+        }
+        lv_obj_t *close = ui_widget_pool_modal_button(s_passkey_modal, 0, "Close", passkey_close_cb);
+        if (close) {
+            lv_obj_align(close, LV_ALIGN_BOTTOM_MID, 0, -10);
+        }
+    }
+    lv_label_set_text(s_passkey_modal->title, text);
+}
+
+/**********************************************************************************
+ * State (LVGL thread)
+ **********************************************************************************/
+static uint16_t seconds_u16(int ms) {
+    return ms <= 0 ? 0 : (ms / 1000 > UINT16_MAX ? UINT16_MAX : ms / 1000);
+}
+
+static void now_playing_changed(const now_playing_state_t *state, uint32_t changed) {
+    uint8_t volume = state->volume_percent < 0 ? VALUE_KEEP : (uint8_t)state->volume_percent;
+    uint16_t position = seconds_u16(now_playing_store_position_ms());
+    uint16_t duration = seconds_u16(state->duration_ms);
+
+    // Cut at a character boundary
+    size_t title_len = strnlen(state->track, BLE_CONTROL_TITLE_MAX + 1);
+    if (title_len > BLE_CONTROL_TITLE_MAX) {
+        title_len = BLE_CONTROL_TITLE_MAX;
+        while (title_len > 0 && ((uint8_t)state->track[title_len] & 0xC0) == 0x80) {
+            title_len--;
+        }
+    }
+
+    taskENTER_CRITICAL(&s_lock);
+    s_volume[0] = volume;
+    s_volume[1] = state->muted ? VOLUME_MUTED : 0;
+    s_state[0] = (state->is_playing ? STATE_PLAYING : 0) | (state->muted ? STATE_MUTED : 0);
+    s_state[1] = volume;
+    s_state[2] = position & 0xFF;
+    s_state[3] = position >> 8;
+    s_state[4] = duration & 0xFF;
+    s_state[5] = duration >> 8;
+    memcpy(&s_state[STATE_HEADER], state->track, title_len);
+    s_state_len = STATE_HEADER + title_len;
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (changed & NOW_PLAYING_VOLUME) {
+        s_target_valid = false;         // The speaker's own report wins
+        if (s_volume_handle) {
+            ble_gatts_chr_updated(s_volume_handle);
+        }
+    }
+    // Handles are assigned once the host has synced
+    if (s_state_handle) {
+        ble_gatts_chr_updated(s_state_handle);
+    }
+}
+
+/**********************************************************************************
+ * GATT and GAP (NimBLE host task)
+ **********************************************************************************/
+static int read_value(characteristic_t chr, struct os_mbuf *om) {
+    uint8_t value[sizeof(s_state)];
+    size_t len;
+    taskENTER_CRITICAL(&s_lock);
+    if (chr == CHR_VOLUME) {
+        len = sizeof(s_volume);
+        memcpy(value, s_volume, len);
+    } else {
+        len = s_state_len;
+        memcpy(value, s_state, len);
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    return os_mbuf_append(om, value, len) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+static bool valid_op(uint8_t op) {
+    return (op >= BLE_CONTROL_OP_PLAY && op <= BLE_CONTROL_OP_PREVIOUS) ||
+           (op >= BLE_CONTROL_OP_VOLUME_UP && op <= BLE_CONTROL_OP_MUTE);
+}
+
+static int write_value(characteristic_t chr, struct os_mbuf *om) {
+    uint8_t data[2];
+    uint16_t len = OS_MBUF_PKTLEN(om);
+    if (len < 1 || len > (chr == CHR_VOLUME ? 2 : 1) || ble_hs_mbuf_to_flat(om, data, sizeof(data), &len) != 0) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+
+    void *command;
+    if (chr == CHR_VOLUME) {
+        uint8_t muted = len > 1 ? data[1] : VALUE_KEEP;
+        if ((data[0] > 100 && data[0] != VALUE_KEEP) || (muted > 1 && muted != VALUE_KEEP)) {
+            return BLE_ATT_ERR_VALUE_NOT_ALLOWED;
+        }
+        command = COMMAND_PACK(OP_SET_VOLUME, data[0], muted);
+    } else {
+        if (!valid_op(data[0])) {
+            return BLE_ATT_ERR_VALUE_NOT_ALLOWED;
+        }
+        command = COMMAND_PACK(data[0], 0, 0);
+    }
+    return gui_event_bus_post_call(run_command, command) ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+static int access_cb(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg) {
+    characteristic_t chr = (characteristic_t)(uintptr_t)arg;
+    switch (ctxt->op) {
+        case BLE_GATT_ACCESS_OP_READ_CHR:   return read_value(chr, ctxt->om);
+        case BLE_GATT_ACCESS_OP_WRITE_CHR:  return write_value(chr, ctxt->om);
+        default:                            return BLE_ATT_ERR_UNLIKELY;
+    }
+}
+
+static int gap_event(struct ble_gap_event *event, void *arg);
+
+static void advertise(void) {
+    // The service UUID fills the advertisement; the name goes in the scan response
+    struct ble_hs_adv_fields fields = { 0 };
+    fields.flags = BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP;
+    fields.uuids128 = &SERVICE_UUID;
+    fields.num_uuids128 = 1;
+    fields.uuids128_is_complete = 1;
+
+    struct ble_hs_adv_fields response = { 0 };
+    response.name = (const uint8_t *)BLE_CONTROL_DEVICE_NAME;
+    response.name_len = strlen(BLE_CONTROL_DEVICE_NAME);
+    response.name_is_complete = 1;
+
+    struct ble_gap_adv_params params = {
+        .conn_mode = BLE_GAP_CONN_MODE_UND,
+        .disc_mode = BLE_GAP_DISC_MODE_GEN,
+        .itvl_min = BLE_GAP_ADV_ITVL_MS(ADV_INTERVAL_MS),
+        .itvl_max = BLE_GAP_ADV_ITVL_MS(ADV_INTERVAL_MS),
+    };
+
+    int rc = ble_gap_adv_set_fields(&fields);
+    if (rc == 0) {
+        rc = ble_gap_adv_rsp_set_fields(&response);
+    }
+    if (rc == 0) {
+        rc = ble_gap_adv_start(s_own_addr_type, NULL, BLE_HS_FOREVER, &params, gap_event, NULL);
+    }
+    if (rc != 0) {
+        ESP_LOGE(TAG, "Advertising failed: %d", rc);
+    }
+}
+
+static int gap_event(struct ble_gap_event *event, void *arg) {
+    switch (event->type) {
+        case BLE_GAP_EVENT_CONNECT:
+            if (event->connect.status != 0) {
+                advertise();
+                break;
+            }
+            ESP_LOGI(TAG, "Controller connected");
+            {
+                // Central's choice until now; ask for quick commands that cost little when idle
+                struct ble_gap_upd_params params = {
+                    .itvl_min = CONN_INTERVAL_MIN,
+                    .itvl_max = CONN_INTERVAL_MAX,
+                    .latency = CONN_LATENCY,
+                    .supervision_timeout = CONN_SUPERVISION,
+                };
+                ble_gap_update_params(event->connect.conn_handle, &params);
+            }
+            break;
+        case BLE_GAP_EVENT_DISCONNECT:
+            ESP_LOGI(TAG, "Controller disconnected (reason 0x%x)", event->disconnect.reason);
+            gui_event_bus_post_call(hide_passkey, NULL);
+            advertise();
+            break;
+        case BLE_GAP_EVENT_PASSKEY_ACTION:
+            if (event->passkey.params.action == BLE_SM_IOACT_DISP) {
+                struct ble_sm_io io = {
+                    .action = BLE_SM_IOACT_DISP,
+                    .passkey = esp_random() % PASSKEY_RANGE,
+                };
+                ble_sm_inject_io(event->passkey.conn_handle, &io);
+                if (!gui_event_bus_post_call(show_passkey, (void *)(uintptr_t)io.passkey)) {
+                    ESP_LOGW(TAG, "Passkey not shown");
+                }
+            }
+            break;
+        case BLE_GAP_EVENT_ENC_CHANGE:
+            ESP_LOGI(TAG, "Controller link %s", event->enc_change.status == 0 ? "encrypted" : "not encrypted");
+            gui_event_bus_post_call(hide_passkey, NULL);
+            break;
+        case BLE_GAP_EVENT_REPEAT_PAIRING: {
+            // The central lost its bond: drop ours so it pairs again, with a new passkey
+            struct ble_gap_conn_desc desc;
+            if (ble_gap_conn_find(event->repeat_pairing.conn_handle, &desc) == 0) {
+                ble_store_util_delete_peer(&desc.peer_id_addr);
+            }
+            return BLE_GAP_REPEAT_PAIRING_RETRY;
+        }
+        case BLE_GAP_EVENT_ADV_COMPLETE:
+            advertise();
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+static void on_sync(void) {
+    if (ble_hs_util_ensure_addr(0) != 0 || ble_hs_id_infer_auto(0, &s_own_addr_type) != 0) {
+        ESP_LOGE(TAG, "No usable BLE address");
+        return;
+    }
+    advertise();
+}
+
+static void on_reset(int reason) {
+    ESP_LOGW(TAG, "NimBLE host reset (reason %d)", reason);
+}
+
+static void host_task(void *param) {
+    nimble_port_run();
+    nimble_port_freertos_deinit();
+}
+
+/**********************************************************************************
+ * Public
+ **********************************************************************************/
+bool ble_control_start(void) {
+    if (s_started) {
+        return true;
+    }
+    esp_err_t err = nimble_port_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NimBLE init failed: %s", esp_err_to_name(err));
+        return false;
+    }
+    ble_hs_cfg.sync_cb = on_sync;
+    ble_hs_cfg.reset_cb = on_reset;
+
+    // Passkey pairing, shown on the screen and typed on the central; bonded
+    ble_hs_cfg.store_status_cb = ble_store_util_status_rr;
+    ble_hs_cfg.sm_io_cap = BLE_HS_IO_DISPLAY_ONLY;
+    ble_hs_cfg.sm_bonding = 1;
+    ble_hs_cfg.sm_mitm = 1;
+    ble_hs_cfg.sm_sc = 1;
+    ble_hs_cfg.sm_our_key_dist = BLE_SM_PAIR_KEY_DIST_ENC | BLE_SM_PAIR_KEY_DIST_ID;
+    ble_hs_cfg.sm_their_key_dist = BLE_SM_PAIR_KEY_DIST_ENC | BLE_SM_PAIR_KEY_DIST_ID;
+
+    ble_svc_gap_init();
+    ble_svc_gatt_init();
+    int rc = ble_gatts_count_cfg(SERVICES);
+    if (rc == 0) {
+        rc = ble_gatts_add_svcs(SERVICES);
+    }
+    if (rc != 0) {
+        ESP_LOGE(TAG, "GATT service not registered: %d", rc);
+        nimble_port_deinit();
+        return false;
+    }
+    ble_svc_gap_device_name_set(BLE_CONTROL_DEVICE_NAME);
+    ble_store_config_init();
+
+    s_started = true;
+    now_playing_store_listen(NOW_PLAYING_TRACK | NOW_PLAYING_PROGRESS | NOW_PLAYING_VOLUME | NOW_PLAYING_PLAYING,
+                             now_playing_changed);
+    nimble_port_freertos_init(host_task);
+    ESP_LOGI(TAG, "BLE control advertising as %s", BLE_CONTROL_DEVICE_NAME);
+    return true;
+}
+#else
+bool ble_control_start(void) {
+    return false;
+}
+#endif
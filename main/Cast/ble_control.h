@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief BLE control - volume and transport over a NimBLE GATT service
+ *
+ * For a phone or a BLE remote within reach: a command is a one or two byte
+ * write on a link that is already up, and the state comes back as a
+ * notification, so nothing is polled and Wi-Fi is not kept awake to serve
+ * it. The service is c0a80001-7b3e-4f51-9d2a-e5ca57e70000, advertised with
+ * the name BLE_CONTROL_DEVICE_NAME; its characteristics are the same UUID
+ * ending in:
+ *
+ * - 0001 Volume, read/write/notify: [percent, 0xFF unknown][bit 0 muted].
+ *   Written as [percent, 0xFF to keep] with an optional second byte
+ *   [0 unmute, 1 mute, 0xFF keep]
+ * - 0002 Transport, write: [ble_control_op_t]
+ * - 0003 State, read/notify: [bit 0 playing, bit 1 muted][volume percent,
+ *   0xFF unknown][position s, u16 LE][duration s, u16 LE][track title,
+ *   UTF-8, at most BLE_CONTROL_TITLE_MAX bytes and cut to the ATT MTU]
+ *
+ * State is notified when the track, play/pause, a seek or the volume
+ * changes, not every second; the position is the one when it was sent and
+ * while playing a client counts on from there. Volume applies to the Cast
+ * device, transport to Spotify, as on the touch controls.
+ *
+ * Writes are checked on the NimBLE host task and queued on the GUI event
+ * bus, then run on the LVGL thread. They are not user activity: the screen
+ * stays off, and from DEEP_IDLE Wi-Fi leaves maximum modem sleep only for
+ * BLE_CONTROL_WIFI_WAKE_MS, long enough to forward the command and take the
+ * speaker's reply (see Power_Wifi_Wake()).
+ *
+ * Writes need an encrypted link with a bonded key: the central pairs when
+ * its first write is refused, and the six digit passkey it asks for comes
+ * up on the screen. BLE_CONTROL_OPEN drops that for remotes that cannot
+ * pair, letting anyone in radio range use it. Nothing is advertised unless
+ * BLE_CONTROL is enabled (off by default), which needs the NimBLE host.
+ */
+
+#define BLE_CONTROL_DEVICE_NAME     "ESPCaster"
+#define BLE_CONTROL_TITLE_MAX       64          // Bytes of the track title in State
+#define BLE_CONTROL_VOLUME_STEP     5           // Percent per volume up/down
+#define BLE_CONTROL_WIFI_WAKE_MS    3000
+
+typedef enum {
+    BLE_CONTROL_OP_PLAY         = 0x01,         // Spotify
+    BLE_CONTROL_OP_PAUSE        = 0x02,
+    BLE_CONTROL_OP_TOGGLE       = 0x03,         // Play or pause
+    BLE_CONTROL_OP_NEXT         = 0x04,
+    BLE_CONTROL_OP_PREVIOUS     = 0x05,
+    BLE_CONTROL_OP_VOLUME_UP    = 0x10,         // Cast device
+    BLE_CONTROL_OP_VOLUME_DOWN  = 0x11,
+    BLE_CONTROL_OP_MUTE         = 0x12,         // Toggles
+} ble_control_op_t;
+
+/**
+ * @brief Start the NimBLE host and advertise; LVGL thread, after the
+ *        Chromecast and Spotify GUI managers are initialised
+ *
+ * @return false if disabled or the host could not start
+ */
+bool ble_control_start(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,6 +1,7 @@
 #include "chromecast_controller_wrapper.h"
 #include "chromecast_controller.h"
 #include "esp_log.h"
+#include <algorithm>
 #include <cstring>
 #include <memory>
 #include <new>
@@ -13,11 +14,15 @@ struct ChromecastControllerWrapper {
     chromecast_state_callback_t state_callback;
     chromecast_volume_callback_t volume_callback;
     chromecast_message_callback_t message_callback;
+    chromecast_media_status_callback_t media_status_callback;
+    chromecast_connect_progress_callback_t connect_progress_callback;
     
     ChromecastControllerWrapper() : 
         state_callback(nullptr), 
         volume_callback(nullptr), 
-        message_callback(nullptr) {
+        message_callback(nullptr),
+        media_status_callback(nullptr),
+        connect_progress_callback(nullptr) {
         controller = std::make_unique<ChromecastController>();
     }
 };
@@ -46,6 +51,35 @@ static void convert_volume_info(const ChromecastController::VolumeInfo& cpp_volu
     c_volume->muted = cpp_volume.muted;
 }
 
+// Helper function to convert C++ connect stage to C connect stage
+static chromecast_connect_stage_t convert_connect_stage(ChromecastController::ConnectStage stage) {
+    switch (stage) {
+        case ChromecastController::CONNECT_STAGE_TLS_HANDSHAKE:
+            return CHROMECAST_CONNECT_TLS_HANDSHAKE;
+        case ChromecastController::CONNECT_STAGE_VIRTUAL_CONNECT:
+            return CHROMECAST_CONNECT_VIRTUAL_CONNECT;
+        case ChromecastController::CONNECT_STAGE_COMPLETE:
+            return CHROMECAST_CONNECT_COMPLETE;
+        case ChromecastController::CONNECT_STAGE_CANCELLED:
+            return CHROMECAST_CONNECT_CANCELLED;
+        default:
+            return CHROMECAST_CONNECT_FAILED;
+    }
+}
+
+// Helper function to convert C++ media status to C media status
+static void convert_media_status(const ChromecastController::MediaStatus& cpp_status, double position,
+                                 chromecast_media_status_t* c_status) {
+    if (!c_status) return;
+    strncpy(c_status->player_state, cpp_status.player_state.c_str(), sizeof(c_status->player_state) - 1);
+    c_status->player_state[sizeof(c_status->player_state) - 1] = '\0';
+    strncpy(c_status->idle_reason, cpp_status.idle_reason.c_str(), sizeof(c_status->idle_reason) - 1);
+    c_status->idle_reason[sizeof(c_status->idle_reason) - 1] = '\0';
+    c_status->media_session_id = cpp_status.media_session_id;
+    c_status->current_time = position;
+    c_status->duration = cpp_status.duration;
+}
+
 extern "C" {
 
 chromecast_controller_handle_t chromecast_controller_create(void) {
@@ -86,9 +120,24 @@ bool chromecast_controller_initialize(chromecast_controller_handle_t handle) {
         }
     });
     
-    wrapper->controller->set_message_callback([wrapper](const std::string& namespace_str, const std::string& payload) {
+    wrapper->controller->set_message_callback([wrapper](std::string_view namespace_str, std::string_view payload) {
         if (wrapper->message_callback) {
-            wrapper->message_callback(namespace_str.c_str(), payload.c_str());
+            wrapper->message_callback(namespace_str.data(), namespace_str.length(),
+                                      payload.data(), payload.length());
+        }
+    });
+    
+    wrapper->controller->set_media_status_callback([wrapper](const ChromecastController::MediaStatus& status) {
+        if (wrapper->media_status_callback) {
+            chromecast_media_status_t c_status = {};
+            convert_media_status(status, status.current_time, &c_status);
+            wrapper->media_status_callback(&c_status);
+        }
+    });
+    
+    wrapper->controller->set_connect_progress_callback([wrapper](ChromecastController::ConnectStage stage) {
+        if (wrapper->connect_progress_callback) {
+            wrapper->connect_progress_callback(convert_connect_stage(stage));
         }
     });
     
@@ -106,6 +155,49 @@ bool chromecast_controller_connect(chromecast_controller_handle_t handle, const
     return result;
 }
 
+bool chromecast_controller_connect_async(chromecast_controller_handle_t handle, const char* ip,
+                                        const char* device_uuid) {
+    return chromecast_controller_connect_async_port(handle, ip, ChromecastController::CHROMECAST_PORT, device_uuid);
+}
+
+bool chromecast_controller_connect_async_port(chromecast_controller_handle_t handle, const char* ip,
+                                             int port, const char* device_uuid) {
+    if (!handle || !ip || port <= 0) return false;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    wrapper->controller->set_device_id(device_uuid ? std::string(device_uuid) : std::string());
+    bool result = wrapper->controller->connect_to_chromecast_async(std::string(ip), port);
+    ESP_LOGI(TAG, "ChromecastController async connect to %s:%d: %s", ip, port, result ? "started" : "failed");
+    return result;
+}
+
+bool chromecast_controller_connect_background(chromecast_controller_handle_t handle, const char* ip,
+                                             int port, const char* device_uuid) {
+    if (!handle || !ip || port <= 0) return false;
+
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    wrapper->controller->set_device_id(device_uuid ? std::string(device_uuid) : std::string());
+    bool result = wrapper->controller->connect_to_chromecast_async(
+        std::string(ip), port, ChromecastController::BACKGROUND_CONNECT_PRIORITY);
+    ESP_LOGI(TAG, "ChromecastController background connect to %s:%d: %s", ip, port, result ? "started" : "failed");
+    return result;
+}
+
+void chromecast_controller_cancel_connect(chromecast_controller_handle_t handle) {
+    if (!handle) return;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    wrapper->controller->cancel_connect();
+}
+
+void chromecast_controller_set_connect_progress_callback(chromecast_controller_handle_t handle, 
+                                                        chromecast_connect_progress_callback_t callback) {
+    if (!handle) return;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    wrapper->connect_progress_callback = callback;
+}
+
 void chromecast_controller_disconnect(chromecast_controller_handle_t handle) {
     if (!handle) return;
     
@@ -124,6 +216,32 @@ bool chromecast_controller_set_volume(chromecast_controller_handle_t handle, flo
     return result;
 }
 
+bool chromecast_controller_request_volume(chromecast_controller_handle_t handle, float level, bool muted) {
+    if (!handle) return false;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    return wrapper->controller->request_volume(level, muted);
+}
+
+bool chromecast_controller_get_volume(chromecast_controller_handle_t handle, chromecast_volume_info_t* volume) {
+    if (!handle || !volume) return false;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    ChromecastController::VolumeInfo info;
+    if (!wrapper->controller->get_volume(info)) {
+        return false;
+    }
+    convert_volume_info(info, volume);
+    return true;
+}
+
+void chromecast_controller_prewarm(chromecast_controller_handle_t handle) {
+    if (!handle) return;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    wrapper->controller->prewarm();
+}
+
 bool chromecast_controller_get_status(chromecast_controller_handle_t handle) {
     if (!handle) return false;
     
@@ -180,6 +298,136 @@ void chromecast_controller_set_message_callback(chromecast_controller_handle_t h
     wrapper->message_callback = callback;
 }
 
+void chromecast_controller_set_media_status_callback(chromecast_controller_handle_t handle, 
+                                                    chromecast_media_status_callback_t callback) {
+    if (!handle) return;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    wrapper->media_status_callback = callback;
+}
+
+bool chromecast_controller_launch_app(chromecast_controller_handle_t handle, const char* app_id) {
+    if (!handle) return false;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    bool result = app_id ? wrapper->controller->launch_app(std::string(app_id))
+                         : wrapper->controller->launch_app();
+    ESP_LOGI(TAG, "ChromecastController launch app: %s", result ? "success" : "failed");
+    return result;
+}
+
+bool chromecast_controller_load_media(chromecast_controller_handle_t handle, const char* url,
+                                     const char* content_type, const char* title, bool autoplay) {
+    if (!handle || !url) return false;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    bool result = wrapper->controller->load_media(std::string(url),
+                                                  content_type ? std::string(content_type) : std::string(),
+                                                  title ? std::string(title) : std::string(),
+                                                  autoplay);
+    ESP_LOGI(TAG, "ChromecastController load media %s: %s", url, result ? "success" : "failed");
+    return result;
+}
+
+bool chromecast_controller_load_file(chromecast_controller_handle_t handle, const char* path,
+                                     const char* title, bool autoplay) {
+    if (!handle || !path) return false;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    bool result = wrapper->controller->load_file(std::string(path),
+                                                 title ? std::string(title) : std::string(),
+                                                 autoplay);
+    ESP_LOGI(TAG, "ChromecastController load file %s: %s", path, result ? "success" : "failed");
+    return result;
+}
+
+bool chromecast_controller_play(chromecast_controller_handle_t handle) {
+    if (!handle) return false;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    return wrapper->controller->play();
+}
+
+bool chromecast_controller_pause(chromecast_controller_handle_t handle) {
+    if (!handle) return false;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    return wrapper->controller->pause();
+}
+
+bool chromecast_controller_stop_media(chromecast_controller_handle_t handle) {
+    if (!handle) return false;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    return wrapper->controller->stop_media();
+}
+
+bool chromecast_controller_seek(chromecast_controller_handle_t handle, double position_seconds) {
+    if (!handle) return false;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    return wrapper->controller->seek(position_seconds);
+}
+
+bool chromecast_controller_get_media_status(chromecast_controller_handle_t handle, 
+                                           chromecast_media_status_t* status) {
+    if (!handle || !status) return false;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    ChromecastController::MediaStatus cached = wrapper->controller->get_cached_media_status();
+    convert_media_status(cached, wrapper->controller->get_estimated_position(), status);
+    return wrapper->controller->has_app_session();
+}
+
+void chromecast_controller_set_auto_reconnect(chromecast_controller_handle_t handle, bool enabled,
+                                             uint32_t liveness_timeout_ms) {
+    if (!handle) return;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    wrapper->controller->set_auto_reconnect(enabled);
+    wrapper->controller->set_liveness_timeout(liveness_timeout_ms);
+}
+
+void chromecast_controller_set_device_auth_required(chromecast_controller_handle_t handle, bool required) {
+    if (!handle) return;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    wrapper->controller->set_device_auth_required(required);
+}
+
+bool chromecast_controller_is_device_authenticated(chromecast_controller_handle_t handle) {
+    if (!handle) return false;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    CastDeviceAuth::Status status = wrapper->controller->get_device_auth_status();
+    return status == CastDeviceAuth::AUTH_VERIFIED || status == CastDeviceAuth::AUTH_CACHED;
+}
+
+bool chromecast_controller_is_group(chromecast_controller_handle_t handle) {
+    if (!handle) return false;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    return wrapper->controller->is_group();
+}
+
+size_t chromecast_controller_get_group_members(chromecast_controller_handle_t handle,
+                                               chromecast_group_member_t* members, size_t max_members) {
+    if (!handle || !members || max_members == 0) return 0;
+    
+    auto wrapper = static_cast<ChromecastControllerWrapper*>(handle);
+    ChromecastController::GroupMember cpp_members[CastPayload::MAX_GROUP_MEMBERS];
+    size_t count = wrapper->controller->get_group_members(cpp_members, std::min(max_members, CastPayload::MAX_GROUP_MEMBERS));
+    
+    for (size_t i = 0; i < count; i++) {
+        strlcpy(members[i].device_id, cpp_members[i].device_id, sizeof(members[i].device_id));
+        strlcpy(members[i].name, cpp_members[i].name, sizeof(members[i].name));
+        members[i].capabilities = cpp_members[i].capabilities;
+        members[i].volume_level = cpp_members[i].has_volume ? cpp_members[i].volume_level : -1.0f;
+        members[i].muted = cpp_members[i].volume_muted;
+    }
+    return count;
+}
+
 void chromecast_controller_start_heartbeat(chromecast_controller_handle_t handle) {
     if (!handle) return;
     
@@ -196,4 +444,14 @@ void chromecast_controller_stop_heartbeat(chromecast_controller_handle_t handle)
     ESP_LOGI(TAG, "ChromecastController heartbeat stopped");
 }
 
+size_t chromecast_controller_export_sessions(uint8_t* out, size_t capacity) {
+    if (!out) return 0;
+    return ChromecastController::export_sessions(out, capacity);
+}
+
+size_t chromecast_controller_import_sessions(const uint8_t* data, size_t length) {
+    if (!data) return 0;
+    return ChromecastController::import_sessions(data, length);
+}
+
 } // extern "C"
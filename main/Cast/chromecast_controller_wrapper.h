@@ -32,10 +32,41 @@ typedef struct {
     bool muted;
 } chromecast_volume_info_t;
 
+// Connection progress stages reported by chromecast_controller_connect_async
+typedef enum {
+    CHROMECAST_CONNECT_TLS_HANDSHAKE,
+    CHROMECAST_CONNECT_VIRTUAL_CONNECT,
+    CHROMECAST_CONNECT_COMPLETE,
+    CHROMECAST_CONNECT_FAILED,
+    CHROMECAST_CONNECT_CANCELLED
+} chromecast_connect_stage_t;
+
+// Media session status (C compatible)
+typedef struct {
+    char player_state[16];      // IDLE, BUFFERING, PLAYING, PAUSED
+    char idle_reason[16];       // FINISHED, CANCELLED, ERROR, INTERRUPTED
+    uint32_t media_session_id;  // 0 when no media is loaded
+    double current_time;        // Position in seconds (extrapolated while playing)
+    double duration;            // Seconds, 0 if unknown
+} chromecast_media_status_t;
+
+// Member of the connected multizone group
+typedef struct {
+    char device_id[40];
+    char name[48];
+    uint32_t capabilities;
+    float volume_level;      // Negative if the member reported no volume
+    bool muted;
+} chromecast_group_member_t;
+
 // Callback function types
 typedef void (*chromecast_state_callback_t)(chromecast_connection_state_t state);
 typedef void (*chromecast_volume_callback_t)(const chromecast_volume_info_t* volume);
-typedef void (*chromecast_message_callback_t)(const char* namespace_str, const char* payload);
+// Neither string is NUL-terminated and both are only valid during the call
+typedef void (*chromecast_message_callback_t)(const char* namespace_str, size_t namespace_len,
+                                              const char* payload, size_t payload_len);
+typedef void (*chromecast_media_status_callback_t)(const chromecast_media_status_t* status);
+typedef void (*chromecast_connect_progress_callback_t)(chromecast_connect_stage_t stage);
 
 /**
  * @brief Create a new ChromecastController instance
@@ -68,6 +99,63 @@ bool chromecast_controller_initialize(chromecast_controller_handle_t handle);
  */
 bool chromecast_controller_connect(chromecast_controller_handle_t handle, const char* ip);
 
+/**
+ * @brief Connect to a Chromecast device in the background
+ * 
+ * Returns immediately; progress and the result are reported through the
+ * connect progress callback from the connect task. Reconnects to a device
+ * with the same UUID reuse its cached TLS session.
+ * 
+ * @param handle Controller instance handle
+ * @param ip IP address of the Chromecast device
+ * @param device_uuid Device UUID used as TLS session cache key, may be NULL
+ * @return bool true if the connect task was started
+ */
+bool chromecast_controller_connect_async(chromecast_controller_handle_t handle, const char* ip,
+                                        const char* device_uuid);
+
+/**
+ * @brief Connect in the background to a device or speaker group on a given port
+ * 
+ * Speaker groups are served by the group leader on their own port, so one
+ * connection (and one SET_VOLUME) controls every member of the group.
+ * 
+ * @param handle Controller instance handle
+ * @param ip IP address of the Chromecast device or group leader
+ * @param port Cast port from discovery (8009 for single speakers)
+ * @param device_uuid Device UUID used as TLS session cache key, may be NULL
+ * @return bool true if the connect task was started
+ */
+bool chromecast_controller_connect_async_port(chromecast_controller_handle_t handle, const char* ip,
+                                             int port, const char* device_uuid);
+
+/**
+ * @brief chromecast_controller_connect_async_port at low priority
+ * 
+ * For connects nobody is waiting on yet (warm standby at boot): the TLS
+ * handshake only runs when nothing interactive is ready to.
+ * 
+ * @return bool true if the connect task was started
+ */
+bool chromecast_controller_connect_background(chromecast_controller_handle_t handle, const char* ip,
+                                             int port, const char* device_uuid);
+
+/**
+ * @brief Cancel an in-progress asynchronous connect
+ * 
+ * @param handle Controller instance handle
+ */
+void chromecast_controller_cancel_connect(chromecast_controller_handle_t handle);
+
+/**
+ * @brief Set connect progress callback
+ * 
+ * @param handle Controller instance handle
+ * @param callback Callback function for connect progress (runs on the connect task)
+ */
+void chromecast_controller_set_connect_progress_callback(chromecast_controller_handle_t handle, 
+                                                        chromecast_connect_progress_callback_t callback);
+
 /**
  * @brief Disconnect from the Chromecast device
  * 
@@ -85,6 +173,40 @@ void chromecast_controller_disconnect(chromecast_controller_handle_t handle);
  */
 bool chromecast_controller_set_volume(chromecast_controller_handle_t handle, float level, bool muted);
 
+/**
+ * @brief Request a volume change without blocking
+ * 
+ * Intended for sliders: only the latest requested value is sent, with at
+ * most one SET_VOLUME in flight. Echoes from RECEIVER_STATUS that lag behind
+ * the requested value are not reported to the volume callback.
+ * 
+ * @param handle Controller instance handle
+ * @param level Volume level (0.0 to 1.0)
+ * @param muted Mute state
+ * @return bool true if the request was queued
+ */
+bool chromecast_controller_request_volume(chromecast_controller_handle_t handle, float level, bool muted);
+
+/**
+ * @brief Get the volume the speaker last reported
+ * 
+ * @param handle Controller instance handle
+ * @param volume Filled with the level and mute state
+ * @return bool false if no RECEIVER_STATUS with a volume has arrived yet
+ */
+bool chromecast_controller_get_volume(chromecast_controller_handle_t handle, chromecast_volume_info_t* volume);
+
+/**
+ * @brief Get ready to send a command without delay
+ * 
+ * Starts the volume task and pings a link that has been quiet for a
+ * heartbeat interval, so a dead connection is noticed (and reconnected)
+ * before the command rather than after it. Does nothing when not connected.
+ * 
+ * @param handle Controller instance handle
+ */
+void chromecast_controller_prewarm(chromecast_controller_handle_t handle);
+
 /**
  * @brief Get current status from the Chromecast device
  * 
@@ -134,11 +256,155 @@ void chromecast_controller_set_volume_callback(chromecast_controller_handle_t ha
  * @brief Set message callback
  * 
  * @param handle Controller instance handle
- * @param callback Callback function for received messages
+ * @param callback Callback function for received messages; copy anything
+ *                 that must outlive the call
  */
 void chromecast_controller_set_message_callback(chromecast_controller_handle_t handle, 
                                                chromecast_message_callback_t callback);
 
+/**
+ * @brief Set media status callback
+ * 
+ * @param handle Controller instance handle
+ * @param callback Callback function for MEDIA_STATUS updates
+ */
+void chromecast_controller_set_media_status_callback(chromecast_controller_handle_t handle, 
+                                                    chromecast_media_status_callback_t callback);
+
+/**
+ * @brief Launch a receiver application
+ * 
+ * @param handle Controller instance handle
+ * @param app_id Application ID, NULL for the Default Media Receiver
+ * @return bool true if the LAUNCH request was sent
+ */
+bool chromecast_controller_launch_app(chromecast_controller_handle_t handle, const char* app_id);
+
+/**
+ * @brief Load a media URL, launching the Default Media Receiver if needed
+ * 
+ * @param handle Controller instance handle
+ * @param url Media URL reachable by the Chromecast
+ * @param content_type MIME type, NULL for audio/mpeg
+ * @param title Optional title shown on the receiver, may be NULL
+ * @param autoplay Start playback once loaded
+ * @return bool true if the request was sent (or queued behind LAUNCH)
+ */
+bool chromecast_controller_load_media(chromecast_controller_handle_t handle, const char* url,
+                                     const char* content_type, const char* title, bool autoplay);
+
+/**
+ * @brief Load a local file through the on-device media server
+ * 
+ * @param handle Controller instance handle
+ * @param path File under MEDIA_SERVER_ROOT, e.g. "/sdcard/Music/a.mp3"
+ * @param title Optional title shown on the receiver, may be NULL
+ * @param autoplay Start playback once loaded
+ * @return bool true if the request was sent (or queued behind LAUNCH); false
+ *         also when the media server is not running
+ */
+bool chromecast_controller_load_file(chromecast_controller_handle_t handle, const char* path,
+                                     const char* title, bool autoplay);
+
+/**
+ * @brief Resume playback of the loaded media
+ * 
+ * @param handle Controller instance handle
+ * @return bool true on success, false on failure
+ */
+bool chromecast_controller_play(chromecast_controller_handle_t handle);
+
+/**
+ * @brief Pause playback of the loaded media
+ * 
+ * @param handle Controller instance handle
+ * @return bool true on success, false on failure
+ */
+bool chromecast_controller_pause(chromecast_controller_handle_t handle);
+
+/**
+ * @brief Stop the loaded media
+ * 
+ * @param handle Controller instance handle
+ * @return bool true on success, false on failure
+ */
+bool chromecast_controller_stop_media(chromecast_controller_handle_t handle);
+
+/**
+ * @brief Seek within the loaded media
+ * 
+ * @param handle Controller instance handle
+ * @param position_seconds Target position in seconds
+ * @return bool true on success, false on failure
+ */
+bool chromecast_controller_seek(chromecast_controller_handle_t handle, double position_seconds);
+
+/**
+ * @brief Get the locally cached media status
+ * 
+ * Reads state tracked from MEDIA_STATUS messages; no request is sent.
+ * 
+ * @param handle Controller instance handle
+ * @param status Output status structure
+ * @return bool true if a media session is active
+ */
+bool chromecast_controller_get_media_status(chromecast_controller_handle_t handle, 
+                                           chromecast_media_status_t* status);
+
+/**
+ * @brief Enable or disable automatic background reconnect
+ * 
+ * When enabled (the default), a dropped link or one that stays silent for
+ * longer than liveness_timeout_ms is reconnected with jittered exponential
+ * backoff. chromecast_controller_disconnect() always stops reconnecting.
+ * 
+ * @param handle Controller instance handle
+ * @param enabled true to reconnect automatically
+ * @param liveness_timeout_ms Silence window before the link is declared dead, 0 to disable
+ */
+void chromecast_controller_set_auto_reconnect(chromecast_controller_handle_t handle, bool enabled,
+                                             uint32_t liveness_timeout_ms);
+
+/**
+ * @brief Require the device to pass the deviceauth challenge
+ * 
+ * Verified devices are cached in NVS, so reconnecting to a known device
+ * skips the signature check. When required (the default), the connection
+ * is complete only once the device has answered; one that fails or does
+ * not answer is disconnected and not reconnected automatically.
+ * 
+ * @param handle Controller instance handle
+ * @param required true to drop devices that fail authentication
+ */
+void chromecast_controller_set_device_auth_required(chromecast_controller_handle_t handle, bool required);
+
+/**
+ * @brief Check whether the connected device has been authenticated
+ * 
+ * @param handle Controller instance handle
+ * @return true if verified on this connection or matched the NVS cache
+ */
+bool chromecast_controller_is_device_authenticated(chromecast_controller_handle_t handle);
+
+/**
+ * @brief Check whether the connection is to a multizone speaker group
+ * 
+ * @param handle Controller instance handle
+ * @return true if connected to a group
+ */
+bool chromecast_controller_is_group(chromecast_controller_handle_t handle);
+
+/**
+ * @brief Get the members of the connected speaker group
+ * 
+ * @param handle Controller instance handle
+ * @param members Array to store the members
+ * @param max_members Maximum number of members to store
+ * @return size_t Number of members copied (0 when not connected to a group)
+ */
+size_t chromecast_controller_get_group_members(chromecast_controller_handle_t handle,
+                                               chromecast_group_member_t* members, size_t max_members);
+
 /**
  * @brief Start heartbeat timer
  * 
@@ -153,6 +419,28 @@ void chromecast_controller_start_heartbeat(chromecast_controller_handle_t handle
  */
 void chromecast_controller_stop_heartbeat(chromecast_controller_handle_t handle);
 
+/**
+ * @brief Serialise the cached TLS sessions of recent devices
+ * 
+ * For memory that outlives the heap, such as RTC memory across deep sleep,
+ * so the first connect after waking resumes the session instead of running
+ * a full handshake.
+ * 
+ * @param out Buffer to write to
+ * @param capacity Size of out; sessions that do not fit are skipped
+ * @return size_t Bytes written (0 without client session tickets)
+ */
+size_t chromecast_controller_export_sessions(uint8_t* out, size_t capacity);
+
+/**
+ * @brief Restore TLS sessions written by chromecast_controller_export_sessions
+ * 
+ * @param data Serialised sessions
+ * @param length Bytes in data
+ * @return size_t Number of sessions restored
+ */
+size_t chromecast_controller_import_sessions(const uint8_t* data, size_t length);
+
 #ifdef __cplusplus
 }
 #endif
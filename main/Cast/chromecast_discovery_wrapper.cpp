@@ -1,20 +1,55 @@
 #include "chromecast_discovery_wrapper.h"
 #include "chromecast_discovery.h"
+#include "ssdp_discovery.h"
+#include "discovery_peers.h"
+#include "sdkconfig.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <atomic>
 #include <cstring>
 #include <memory>
 #include <new>
 
 static const char* TAG = "chromecast_wrapper";
 
+// Device table as handed to C: converted once per table epoch and shared by
+// every holder, freed with the last reference
+struct chromecast_device_table {
+    std::atomic<int> refs;
+    uint32_t epoch;
+    std::vector<chromecast_device_info_t> devices;
+};
+
 // Internal wrapper structure
 struct ChromecastDiscoveryWrapper {
+#if CONFIG_ESPCASTER_SSDP_DISCOVERY
+    std::unique_ptr<SsdpDiscovery> ssdp;    // Declared first, so it outlives discovery
+#endif
+#if CONFIG_ESPCASTER_DISCOVERY_PEERS
+    std::unique_ptr<DiscoveryPeers> peers;  // Likewise
+#endif
     std::unique_ptr<ChromecastDiscovery> discovery;
     chromecast_discovery_callback_t discovery_callback;
     chromecast_device_found_callback_t device_found_callback;
+    chromecast_device_event_callback_t device_event_callback;
+
+    // Newest converted table, one reference held; guarded by table_mutex
+    chromecast_device_table* table;
+    SemaphoreHandle_t table_mutex;
     
-    ChromecastDiscoveryWrapper() : discovery_callback(nullptr), device_found_callback(nullptr) {
+    ChromecastDiscoveryWrapper()
+        : discovery_callback(nullptr), device_found_callback(nullptr), device_event_callback(nullptr),
+          table(nullptr), table_mutex(nullptr) {
         discovery = std::make_unique<ChromecastDiscovery>();
+#if CONFIG_ESPCASTER_SSDP_DISCOVERY
+        ssdp = std::make_unique<SsdpDiscovery>();
+        discovery->add_backend(ssdp.get());
+#endif
+#if CONFIG_ESPCASTER_DISCOVERY_PEERS
+        peers = std::make_unique<DiscoveryPeers>();
+        discovery->set_peers(peers.get());
+#endif
     }
 };
 
@@ -39,8 +74,82 @@ static void convert_device_info(const ChromecastDiscovery::DeviceInfo& cpp_devic
     
     strncpy(c_device->uuid, cpp_device.uuid.c_str(), sizeof(c_device->uuid) - 1);
     c_device->uuid[sizeof(c_device->uuid) - 1] = '\0';
+
+    c_device->probable = cpp_device.probable;
+    c_device->capabilities = cpp_device.capabilities;
+
+    strncpy(c_device->status, cpp_device.status.c_str(), sizeof(c_device->status) - 1);
+    c_device->status[sizeof(c_device->status) - 1] = '\0';
+
+    strncpy(c_device->leader_uuid, cpp_device.leader_uuid.c_str(), sizeof(c_device->leader_uuid) - 1);
+    c_device->leader_uuid[sizeof(c_device->leader_uuid) - 1] = '\0';
+
+    c_device->protocol = cpp_device.protocol;
+}
+
+static void release_table(const chromecast_device_table* table) {
+    if (table && const_cast<chromecast_device_table*>(table)->refs.fetch_sub(1) == 1) {
+        delete table;
+    }
 }
 
+static chromecast_device_table* build_table(ChromecastDiscoveryWrapper* wrapper) {
+    auto table = new(std::nothrow) chromecast_device_table();
+    if (!table) {
+        return nullptr;
+    }
+
+    std::vector<ChromecastDiscovery::DeviceInfo> cpp_devices;
+    wrapper->discovery->get_cached_devices(cpp_devices, &table->epoch);
+    table->devices.resize(cpp_devices.size());
+    for (size_t i = 0; i < cpp_devices.size(); i++) {
+        convert_device_info(cpp_devices[i], &table->devices[i]);
+    }
+    table->refs = 1;
+    return table;
+}
+
+// The current table, rebuilt only if the device table changed since
+static const chromecast_device_table* acquire_table(ChromecastDiscoveryWrapper* wrapper) {
+    if (!wrapper->table_mutex || !wrapper->discovery->is_initialized()) {
+        return nullptr;
+    }
+
+    xSemaphoreTake(wrapper->table_mutex, portMAX_DELAY);
+    chromecast_device_table* table = wrapper->table;
+    if (!table || table->epoch != wrapper->discovery->get_table_epoch()) {
+        table = build_table(wrapper);
+        if (table) {
+            release_table(wrapper->table);
+            wrapper->table = table;
+        }
+    }
+    if (table) {
+        table->refs++;
+    }
+    xSemaphoreGive(wrapper->table_mutex);
+    return table;
+}
+
+static_assert(CHROMECAST_CAP_VIDEO_OUT == ChromecastDiscovery::DeviceInfo::CAP_VIDEO_OUT &&
+              CHROMECAST_CAP_MULTIZONE_GROUP == ChromecastDiscovery::DeviceInfo::CAP_MULTIZONE_GROUP &&
+              CHROMECAST_CAP_AUDIO_OUT == ChromecastDiscovery::DeviceInfo::CAP_AUDIO_OUT,
+              "Capability bits must mirror ChromecastDiscovery::DeviceInfo::Capability");
+
+static_assert(CHROMECAST_DEVICE_ADDED == (int)ChromecastDiscovery::DEVICE_ADDED &&
+              CHROMECAST_DEVICE_UPDATED == (int)ChromecastDiscovery::DEVICE_UPDATED &&
+              CHROMECAST_DEVICE_REMOVED == (int)ChromecastDiscovery::DEVICE_REMOVED,
+              "chromecast_device_event_t must mirror ChromecastDiscovery::DeviceEvent");
+
+static_assert(CHROMECAST_DISCOVERY_BACKGROUND == (int)ChromecastDiscovery::INTEREST_BACKGROUND &&
+              CHROMECAST_DISCOVERY_VISIBLE == (int)ChromecastDiscovery::INTEREST_VISIBLE &&
+              CHROMECAST_DISCOVERY_IDLE == (int)ChromecastDiscovery::INTEREST_IDLE,
+              "chromecast_discovery_interest_t must mirror ChromecastDiscovery::Interest");
+
+static_assert(CHROMECAST_PROTOCOL_CAST == (int)ChromecastDeviceTable::PROTOCOL_CAST &&
+              CHROMECAST_PROTOCOL_UPNP == (int)ChromecastDeviceTable::PROTOCOL_UPNP,
+              "CHROMECAST_PROTOCOL_* must mirror ChromecastDeviceTable::Protocol");
+
 extern "C" {
 
 chromecast_discovery_handle_t chromecast_discovery_create(void) {
@@ -49,6 +158,12 @@ chromecast_discovery_handle_t chromecast_discovery_create(void) {
         ESP_LOGE(TAG, "Failed to create ChromecastDiscovery wrapper: out of memory");
         return nullptr;
     }
+    wrapper->table_mutex = xSemaphoreCreateMutex();
+    if (!wrapper->table_mutex) {
+        ESP_LOGE(TAG, "Failed to create ChromecastDiscovery wrapper: no table mutex");
+        delete wrapper;
+        return nullptr;
+    }
     ESP_LOGI(TAG, "Created ChromecastDiscovery wrapper");
     return static_cast<chromecast_discovery_handle_t>(wrapper);
 }
@@ -57,6 +172,8 @@ void chromecast_discovery_destroy(chromecast_discovery_handle_t handle) {
     if (!handle) return;
     
     auto wrapper = static_cast<ChromecastDiscoveryWrapper*>(handle);
+    release_table(wrapper->table);
+    vSemaphoreDelete(wrapper->table_mutex);
     delete wrapper;
     ESP_LOGI(TAG, "Destroyed ChromecastDiscovery wrapper");
 }
@@ -67,14 +184,16 @@ bool chromecast_discovery_initialize(chromecast_discovery_handle_t handle) {
     auto wrapper = static_cast<ChromecastDiscoveryWrapper*>(handle);
     
     // Set up C++ callbacks that will call C callbacks
-    wrapper->discovery->set_discovery_callback([wrapper](const std::vector<ChromecastDiscovery::DeviceInfo>& devices) {
+    wrapper->discovery->set_discovery_callback([wrapper](const std::vector<ChromecastDiscovery::DeviceInfo>&) {
         if (wrapper->discovery_callback) {
-            // Convert C++ vector to C array
-            auto c_devices = std::make_unique<chromecast_device_info_t[]>(devices.size());
-            for (size_t i = 0; i < devices.size(); i++) {
-                convert_device_info(devices[i], &c_devices[i]);
+            // The shared table, converted at most once for every holder
+            const chromecast_device_table* table = acquire_table(wrapper);
+            if (table) {
+                wrapper->discovery_callback(table->devices.data(), table->devices.size());
+            } else {
+                wrapper->discovery_callback(nullptr, 0);
             }
-            wrapper->discovery_callback(c_devices.get(), devices.size());
+            release_table(table);
         }
     });
     
@@ -86,6 +205,15 @@ bool chromecast_discovery_initialize(chromecast_discovery_handle_t handle) {
         }
     });
     
+    wrapper->discovery->set_device_event_callback([wrapper](ChromecastDiscovery::DeviceEvent event,
+                                                            const ChromecastDiscovery::DeviceInfo& device) {
+        if (wrapper->device_event_callback) {
+            chromecast_device_info_t c_device;
+            convert_device_info(device, &c_device);
+            wrapper->device_event_callback(static_cast<chromecast_device_event_t>(event), &c_device);
+        }
+    });
+    
     bool result = wrapper->discovery->initialize();
     ESP_LOGI(TAG, "ChromecastDiscovery initialization: %s", result ? "success" : "failed");
     return result;
@@ -152,6 +280,30 @@ void chromecast_discovery_stop_periodic(chromecast_discovery_handle_t handle) {
     ESP_LOGI(TAG, "Periodic discovery stopped");
 }
 
+bool chromecast_discovery_start_browse(chromecast_discovery_handle_t handle) {
+    if (!handle) return false;
+    
+    auto wrapper = static_cast<ChromecastDiscoveryWrapper*>(handle);
+    bool result = wrapper->discovery->start_continuous_browse();
+    ESP_LOGI(TAG, "Continuous browse started: %s", result ? "success" : "failed");
+    return result;
+}
+
+void chromecast_discovery_stop_browse(chromecast_discovery_handle_t handle) {
+    if (!handle) return;
+    
+    auto wrapper = static_cast<ChromecastDiscoveryWrapper*>(handle);
+    wrapper->discovery->stop_continuous_browse();
+}
+
+void chromecast_discovery_set_interest(chromecast_discovery_handle_t handle,
+                                       chromecast_discovery_interest_t interest) {
+    if (!handle) return;
+    
+    auto wrapper = static_cast<ChromecastDiscoveryWrapper*>(handle);
+    wrapper->discovery->set_interest(static_cast<ChromecastDiscovery::Interest>(interest));
+}
+
 void chromecast_discovery_set_timeout(chromecast_discovery_handle_t handle, uint32_t timeout_ms) {
     if (!handle) return;
     
@@ -182,6 +334,78 @@ void chromecast_discovery_set_device_found_callback(chromecast_discovery_handle_
     wrapper->device_found_callback = callback;
 }
 
+void chromecast_discovery_set_device_event_callback(chromecast_discovery_handle_t handle,
+                                                    chromecast_device_event_callback_t callback) {
+    if (!handle) return;
+    
+    auto wrapper = static_cast<ChromecastDiscoveryWrapper*>(handle);
+    wrapper->device_event_callback = callback;
+}
+
+bool chromecast_discovery_get_cached_devices(chromecast_discovery_handle_t handle,
+                                             chromecast_device_info_t* devices,
+                                             size_t max_devices,
+                                             size_t* device_count) {
+    if (!handle || !devices || !device_count) return false;
+    
+    auto wrapper = static_cast<ChromecastDiscoveryWrapper*>(handle);
+    const chromecast_device_table* table = acquire_table(wrapper);
+    size_t count = table ? std::min(table->devices.size(), max_devices) : 0;
+    if (count > 0) {
+        memcpy(devices, table->devices.data(), count * sizeof(chromecast_device_info_t));
+    }
+    release_table(table);
+    
+    *device_count = count;
+    return true;
+}
+
+const chromecast_device_table_t* chromecast_discovery_acquire_devices(chromecast_discovery_handle_t handle) {
+    if (!handle) return nullptr;
+
+    return acquire_table(static_cast<ChromecastDiscoveryWrapper*>(handle));
+}
+
+void chromecast_device_table_release(const chromecast_device_table_t* table) {
+    release_table(table);
+}
+
+const chromecast_device_info_t* chromecast_device_table_devices(const chromecast_device_table_t* table,
+                                                                size_t* device_count) {
+    if (!table) {
+        if (device_count) *device_count = 0;
+        return nullptr;
+    }
+    if (device_count) *device_count = table->devices.size();
+    return table->devices.data();
+}
+
+uint32_t chromecast_device_table_epoch(const chromecast_device_table_t* table) {
+    return table ? table->epoch : 0;
+}
+
+uint32_t chromecast_discovery_get_devices_epoch(chromecast_discovery_handle_t handle) {
+    if (!handle) return 0;
+
+    auto wrapper = static_cast<ChromecastDiscoveryWrapper*>(handle);
+    return wrapper->discovery->get_table_epoch();
+}
+
+bool chromecast_discovery_find_device(chromecast_discovery_handle_t handle,
+                                      const char* key,
+                                      chromecast_device_info_t* device) {
+    if (!handle || !key || !device) return false;
+
+    auto wrapper = static_cast<ChromecastDiscoveryWrapper*>(handle);
+    ChromecastDiscovery::DeviceInfo cpp_device;
+    if (!wrapper->discovery->find_cached_device(key, cpp_device)) {
+        return false;
+    }
+
+    convert_device_info(cpp_device, device);
+    return true;
+}
+
 bool chromecast_discovery_is_initialized(chromecast_discovery_handle_t handle) {
     if (!handle) return false;
     
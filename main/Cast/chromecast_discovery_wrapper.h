@@ -27,11 +27,43 @@ typedef struct {
     char instance_name[64];  // mDNS instance name
     char model[32];          // Device model (if available)
     char uuid[64];           // Device UUID (if available)
+    bool probable;           // Restored from NVS at boot, not yet seen on the network
+    uint32_t capabilities;   // CHROMECAST_CAP_* bits (TXT "ca")
+    char status[48];         // Receiver status text (TXT "rs"), empty when idle
+    char leader_uuid[64];    // Groups: UUID of the speaker hosting the group, if known
+    uint8_t protocol;        // CHROMECAST_PROTOCOL_*; only Cast devices can be cast to
 } chromecast_device_info_t;
 
+// How a device was found and is spoken to
+#define CHROMECAST_PROTOCOL_CAST        0
+#define CHROMECAST_PROTOCOL_UPNP        1   // UPnP/DLNA renderer found over SSDP; listed only
+
+// Device capability bits
+#define CHROMECAST_CAP_VIDEO_OUT        (1u << 0)
+#define CHROMECAST_CAP_AUDIO_OUT        (1u << 2)
+#define CHROMECAST_CAP_MULTIZONE_GROUP  (1u << 5)
+
+// Change to the discovered device table
+typedef enum {
+    CHROMECAST_DEVICE_ADDED = 0,
+    CHROMECAST_DEVICE_UPDATED,
+    CHROMECAST_DEVICE_REMOVED
+} chromecast_device_event_t;
+
+// How closely the device list is watched (ChromecastDiscovery::Interest)
+typedef enum {
+    CHROMECAST_DISCOVERY_BACKGROUND = 0,    // Sweeps back off while the set is unchanged
+    CHROMECAST_DISCOVERY_VISIBLE,           // Device list on screen: fast sweeps
+    CHROMECAST_DISCOVERY_IDLE               // Screen asleep: no queries
+} chromecast_discovery_interest_t;
+
+// Snapshot of the device table (opaque, reference counted)
+typedef struct chromecast_device_table chromecast_device_table_t;
+
 // Discovery result callback
 typedef void (*chromecast_discovery_callback_t)(const chromecast_device_info_t* devices, size_t device_count);
 typedef void (*chromecast_device_found_callback_t)(const chromecast_device_info_t* device);
+typedef void (*chromecast_device_event_callback_t)(chromecast_device_event_t event, const chromecast_device_info_t* device);
 
 /**
  * @brief Create a new ChromecastDiscovery instance
@@ -79,6 +111,11 @@ bool chromecast_discovery_discover_sync(chromecast_discovery_handle_t handle,
 /**
  * @brief Start asynchronous discovery
  * 
+ * Returns at once. While browsing, devices are reported through the device
+ * event callback as each one answers; the discovery callback follows with
+ * the whole table once the query times out. Without browsing, everything is
+ * reported at the end.
+ * 
  * @param handle Discovery instance handle
  * @return bool true on success, false on failure
  */
@@ -100,6 +137,39 @@ bool chromecast_discovery_start_periodic(chromecast_discovery_handle_t handle, u
  */
 void chromecast_discovery_stop_periodic(chromecast_discovery_handle_t handle);
 
+/**
+ * @brief Start continuous mDNS browsing
+ * 
+ * Devices are reported through the device event callback as soon as they
+ * announce themselves. Known records are refreshed with unicast queries as
+ * they approach their TTL, and PTR sweeps are paced as in periodic
+ * discovery. Replaces periodic discovery while active.
+ * 
+ * @param handle Discovery instance handle
+ * @return bool true on success, false on failure
+ */
+bool chromecast_discovery_start_browse(chromecast_discovery_handle_t handle);
+
+/**
+ * @brief Stop continuous mDNS browsing
+ * 
+ * @param handle Discovery instance handle
+ */
+void chromecast_discovery_stop_browse(chromecast_discovery_handle_t handle);
+
+/**
+ * @brief Tell discovery how closely the device list is watched
+ * 
+ * Sets the pace of periodic and browse-mode sweeps: every few seconds while
+ * visible, from the periodic interval backing off to minutes in the
+ * background, none while idle. Any task.
+ * 
+ * @param handle Discovery instance handle
+ * @param interest Current interest
+ */
+void chromecast_discovery_set_interest(chromecast_discovery_handle_t handle,
+                                       chromecast_discovery_interest_t interest);
+
 /**
  * @brief Set discovery timeout
  * 
@@ -119,6 +189,8 @@ void chromecast_discovery_set_max_results(chromecast_discovery_handle_t handle,
 /**
  * @brief Set discovery callback
  * 
+ * The devices passed are the shared device table, valid during the call.
+ * 
  * @param handle Discovery instance handle
  * @param callback Callback function to call when discovery completes
  */
@@ -134,6 +206,92 @@ void chromecast_discovery_set_callback(chromecast_discovery_handle_t handle,
 void chromecast_discovery_set_device_found_callback(chromecast_discovery_handle_t handle,
                                                    chromecast_device_found_callback_t callback);
 
+/**
+ * @brief Set device event callback
+ * 
+ * Called once per added, updated or removed device, before the discovery
+ * callback. Both run on the discovering task, never the LVGL thread: post
+ * GUI work with gui_event_bus_post_call().
+ * 
+ * @param handle Discovery instance handle
+ * @param callback Callback function to call for each device table change
+ */
+void chromecast_discovery_set_device_event_callback(chromecast_discovery_handle_t handle,
+                                                    chromecast_device_event_callback_t callback);
+
+/**
+ * @brief Get the cached device table without querying the network
+ * 
+ * @param handle Discovery instance handle
+ * @param devices Array to store cached devices
+ * @param max_devices Maximum number of devices to store
+ * @param device_count Pointer to store actual number of devices copied
+ * @return bool true on success, false on failure
+ */
+bool chromecast_discovery_get_cached_devices(chromecast_discovery_handle_t handle,
+                                             chromecast_device_info_t* devices,
+                                             size_t max_devices,
+                                             size_t* device_count);
+
+/**
+ * @brief Take a reference to the device table as it is now
+ * 
+ * The table is converted once per change and shared by every holder, so a
+ * list can be held across frames without copying the devices out. A held
+ * table never changes; its epoch tells whether the device table has moved
+ * on since (see chromecast_discovery_get_devices_epoch). Any thread.
+ * 
+ * @param handle Discovery instance handle
+ * @return const chromecast_device_table_t* Release with chromecast_device_table_release(),
+ *         NULL if discovery is not initialized or out of memory
+ */
+const chromecast_device_table_t* chromecast_discovery_acquire_devices(chromecast_discovery_handle_t handle);
+
+/**
+ * @brief Drop a reference taken with chromecast_discovery_acquire_devices()
+ * 
+ * @param table Device table, may be NULL
+ */
+void chromecast_device_table_release(const chromecast_device_table_t* table);
+
+/**
+ * @brief Devices in a held table
+ * 
+ * @param table Device table
+ * @param device_count Pointer to store the number of devices
+ * @return const chromecast_device_info_t* The devices, valid until the table is released
+ */
+const chromecast_device_info_t* chromecast_device_table_devices(const chromecast_device_table_t* table,
+                                                                size_t* device_count);
+
+/**
+ * @brief Epoch of the device table a held table was taken at
+ * 
+ * @param table Device table
+ * @return uint32_t Epoch
+ */
+uint32_t chromecast_device_table_epoch(const chromecast_device_table_t* table);
+
+/**
+ * @brief Current epoch of the device table, moved on by every change
+ * 
+ * @param handle Discovery instance handle
+ * @return uint32_t Epoch
+ */
+uint32_t chromecast_discovery_get_devices_epoch(chromecast_discovery_handle_t handle);
+
+/**
+ * @brief Look up a known device by UUID, friendly/instance name or IPv4 address
+ * 
+ * @param handle Discovery instance handle
+ * @param key UUID, name or dotted IPv4 address
+ * @param device Pointer to store the device information
+ * @return bool true if the device is in the device table, false otherwise
+ */
+bool chromecast_discovery_find_device(chromecast_discovery_handle_t handle,
+                                      const char* key,
+                                      chromecast_device_info_t* device);
+
 /**
  * @brief Check if discovery is initialized
  * 
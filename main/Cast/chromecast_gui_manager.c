@@ -1,27 +1,81 @@
 #include "chromecast_gui_manager.h"
+#include "gui_event_bus.h"
+#include "now_playing_store.h"
+#include "ui_layer_cache.h"
+#include "ui_prerender.h"
+#include "ui_widget_pool.h"
+#include "control_api.h"
+#include "config_store.h"
+#include "Touch_Gesture.h"
+#include "LVGL_Scroll.h"
+#include "wifi_manager.h"
 #include "esp_log.h"
 #include "esp_err.h"
+#include "sdkconfig.h"
+#include <stdarg.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
 static const char *TAG = "chromecast_gui_manager";
 
+// Two-finger rotation on the volume screen: a full turn sweeps 0-100%
+#define CHROMECAST_GUI_ROTATE_DEG_PER_PERCENT 3.6f
+
+// The last device connected to from the list, for the warm standby at boot
+#define CHROMECAST_GUI_PREF_NAMESPACE   "cast_pref"
+#define CHROMECAST_GUI_PREF_DEVICE_KEY  "device"
+
+#if CONFIG_ESPCASTER_CAST_STANDBY
+#define CHROMECAST_GUI_STANDBY_IDLE_MS  (CONFIG_ESPCASTER_CAST_STANDBY_IDLE_S * 1000)
+#else
+#define CHROMECAST_GUI_STANDBY_IDLE_MS  0   // Never started
+#endif
+
+// Warm standby: a background connection to the preferred device, made
+// before anyone asks for it
+typedef enum {
+    STANDBY_OFF = 0,
+    STANDBY_CONNECTING,         // Background connect to the cached address
+    STANDBY_WAIT_DISCOVERY,     // That failed; retried when the UUID is announced
+    STANDBY_READY,              // Connected, the volume screen not opened yet
+} chromecast_standby_t;
+
+typedef struct {
+    lv_obj_t *container;
+    lv_obj_t *slider;
+    lv_obj_t *mute_button;
+    lv_obj_t *label;
+} volume_widgets_t;
+
 // GUI state
 typedef struct {
     bool initialized;
     lv_obj_t *status_bar;
     lv_obj_t *scan_button;
+    lv_obj_t *scan_spinner;         // On the scan button while a discovery runs
     lv_obj_t *device_list_container;
     lv_obj_t *volume_control_container;
     lv_obj_t *volume_slider;
     lv_obj_t *mute_button;
     lv_obj_t *volume_label;
-    lv_obj_t *connection_modal;
+    ui_modal_t *connection_modal;
     lv_obj_t *main_container;
+    char status_text[128];          // Kept while the tab is unloaded
+    bool volume_shown;              // The volume screen is open, or opens when the tab is built
     chromecast_discovery_handle_t discovery_handle;
     chromecast_controller_handle_t controller_handle;
     chromecast_device_info_t selected_device;
     bool device_selected;
+    chromecast_standby_t standby;
+    chromecast_device_info_t standby_device;
+    bool standby_tried;             // Once per boot
+    lv_timer_t *standby_timer;      // Drops an unused standby connection
+    esp_event_handler_instance_t ip_handler;
+    // The volume screen built ahead, hidden, for a device connected or connecting
+    ui_prerender_t volume_prerender;
+    volume_widgets_t volume_prebuilt;
+    chromecast_device_info_t prebuilt_device;
 } chromecast_gui_state_t;
 
 static chromecast_gui_state_t g_gui_state = {0};
@@ -36,6 +90,33 @@ static void connect_button_cb(lv_event_t *e);
 static void cancel_button_cb(lv_event_t *e);
 static void chromecast_state_callback(chromecast_connection_state_t state);
 static void chromecast_volume_callback(const chromecast_volume_info_t* volume);
+static void chromecast_connect_progress_callback(chromecast_connect_stage_t stage);
+static void state_event_handler(const gui_event_t *event);
+static void volume_event_handler(const gui_event_t *event);
+static void connect_progress_event_handler(const gui_event_t *event);
+static void gesture_event_handler(const gui_event_t *event);
+static void request_slider_volume(void);
+static void show_cached_devices(void);
+static void standby_connect(void);
+static void standby_stop(bool drop);
+static void save_preferred_device(const chromecast_device_info_t *device);
+static void connect_selected_device(void);
+static void predict_volume_control(const chromecast_device_info_t *device);
+static void discard_prebuilt_volume(void);
+#if CONFIG_ESPCASTER_CAST_STANDBY
+static void standby_start_call(void *arg);
+static void got_ip_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data);
+#endif
+
+static void set_status(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(g_gui_state.status_text, sizeof(g_gui_state.status_text), format, args);
+    va_end(args);
+    if (g_gui_state.status_bar) {
+        lv_label_set_text(g_gui_state.status_bar, g_gui_state.status_text);
+    }
+}
 
 esp_err_t chromecast_gui_manager_init(const chromecast_gui_config_t *config) {
     if (g_gui_state.initialized) {
@@ -65,9 +146,26 @@ esp_err_t chromecast_gui_manager_init(const chromecast_gui_config_t *config) {
         return ESP_FAIL;
     }
 
-    // Set up controller callbacks
+    // Set up controller callbacks; they post to the event bus, and these
+    // handlers apply the events on the LVGL thread
+    gui_event_bus_subscribe(GUI_EVENT_CHROMECAST_STATE, state_event_handler);
+    gui_event_bus_subscribe(GUI_EVENT_CHROMECAST_VOLUME, volume_event_handler);
+    gui_event_bus_subscribe(GUI_EVENT_CHROMECAST_CONNECT_PROGRESS, connect_progress_event_handler);
+    gui_event_bus_subscribe(GUI_EVENT_TOUCH_GESTURE, gesture_event_handler);
     chromecast_controller_set_state_callback(g_gui_state.controller_handle, chromecast_state_callback);
     chromecast_controller_set_volume_callback(g_gui_state.controller_handle, chromecast_volume_callback);
+    chromecast_controller_set_connect_progress_callback(g_gui_state.controller_handle, chromecast_connect_progress_callback);
+
+#if CONFIG_ESPCASTER_CAST_STANDBY
+    // Warm up the last-used device as soon as there is a network to reach it on
+    if (esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, got_ip_handler,
+                                            NULL, &g_gui_state.ip_handler) != ESP_OK) {
+        ESP_LOGW(TAG, "No warm standby: cannot watch for an IP address");
+    }
+    if (wifi_manager_is_connected()) {
+        gui_event_bus_post_call(standby_start_call, NULL);
+    }
+#endif
 
     // Create GUI elements if parent provided
     if (config && config->parent) {
@@ -86,20 +184,27 @@ esp_err_t chromecast_gui_manager_deinit(void) {
 
     ESP_LOGI(TAG, "Deinitializing Chromecast GUI Manager");
 
+    if (g_gui_state.ip_handler) {
+        esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, g_gui_state.ip_handler);
+    }
+    standby_stop(false);
+
     // Clean up controller
     if (g_gui_state.controller_handle) {
         chromecast_controller_destroy(g_gui_state.controller_handle);
         g_gui_state.controller_handle = NULL;
     }
+    gui_event_bus_subscribe(GUI_EVENT_CHROMECAST_STATE, NULL);
+    gui_event_bus_subscribe(GUI_EVENT_CHROMECAST_VOLUME, NULL);
+    gui_event_bus_subscribe(GUI_EVENT_CHROMECAST_CONNECT_PROGRESS, NULL);
+    gui_event_bus_subscribe(GUI_EVENT_TOUCH_GESTURE, NULL);
 
     // Clean up GUI elements
     chromecast_gui_hide_devices();
     chromecast_gui_hide_volume_control();
 
-    if (g_gui_state.connection_modal) {
-        lv_obj_del(g_gui_state.connection_modal);
-        g_gui_state.connection_modal = NULL;
-    }
+    ui_widget_pool_modal_close(g_gui_state.connection_modal);
+    g_gui_state.connection_modal = NULL;
 
     memset(&g_gui_state, 0, sizeof(g_gui_state));
     ESP_LOGI(TAG, "Chromecast GUI Manager deinitialized");
@@ -118,59 +223,249 @@ lv_obj_t *chromecast_gui_create_interface(lv_obj_t *parent) {
     lv_obj_t *container = lv_obj_create(parent);
     lv_obj_set_size(container, lv_pct(100), lv_pct(100));
     lv_obj_center(container);
+    ui_layer_cache_attach(container);
 
     // Create button list
     lv_obj_t *btn_list = lv_list_create(container);
     lv_obj_center(btn_list);
+    LVGL_Scroll_Blit_Enable(btn_list);
 
     // Create Chromecast scan button
     g_gui_state.scan_button = lv_list_add_btn(btn_list, LV_SYMBOL_REFRESH, "Scan Chromecast");
     lv_obj_add_event_cb(g_gui_state.scan_button, scan_button_cb, LV_EVENT_CLICKED, NULL);
+    g_gui_state.scan_spinner = lv_spinner_create(g_gui_state.scan_button, 1000, 60);
+    lv_obj_set_size(g_gui_state.scan_spinner, 24, 24);
+    lv_obj_add_flag(g_gui_state.scan_spinner, LV_OBJ_FLAG_IGNORE_LAYOUT | LV_OBJ_FLAG_HIDDEN);
+    lv_obj_clear_flag(g_gui_state.scan_spinner, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_align(g_gui_state.scan_spinner, LV_ALIGN_RIGHT_MID, 0, 0);
 
     // Create status bar
     g_gui_state.status_bar = lv_label_create(container);
     lv_obj_align(g_gui_state.status_bar, LV_ALIGN_BOTTOM_MID, 0, -10);
-    lv_label_set_text(g_gui_state.status_bar, "Chromecast: Disconnected");
+    lv_label_set_text(g_gui_state.status_bar, g_gui_state.status_text[0] ? g_gui_state.status_text
+                                                                           : "Chromecast: Disconnected");
 
     g_gui_state.main_container = container;
+
+    if (g_gui_state.volume_shown) {
+        // Built again with a device connected: back on its volume screen
+        chromecast_gui_show_volume_control(&g_gui_state.selected_device);
+    } else {
+        // Speakers remembered from the last session are tappable before discovery finishes
+        show_cached_devices();
+        if (g_gui_state.standby == STANDBY_READY) {
+            predict_volume_control(&g_gui_state.standby_device);
+        }
+    }
+    if (g_gui_state.discovery_handle && chromecast_discovery_is_active(g_gui_state.discovery_handle)) {
+        lv_obj_clear_flag(g_gui_state.scan_spinner, LV_OBJ_FLAG_HIDDEN);
+    }
+
     return container;
 }
 
+void chromecast_gui_unload_interface(void) {
+    if (!g_gui_state.main_container) {
+        return;
+    }
+    // Device rows own a copy of their device; the volume screen's bindings
+    // let go when it is deleted
+    chromecast_gui_hide_devices();
+    g_gui_state.status_bar = NULL;
+    g_gui_state.scan_button = NULL;
+    g_gui_state.scan_spinner = NULL;
+    g_gui_state.volume_control_container = NULL;
+    g_gui_state.volume_slider = NULL;
+    g_gui_state.mute_button = NULL;
+    g_gui_state.volume_label = NULL;
+    ui_prerender_cancel(&g_gui_state.volume_prerender);
+    memset(&g_gui_state.volume_prebuilt, 0, sizeof(g_gui_state.volume_prebuilt));
+    g_gui_state.main_container = NULL;
+}
+
+/**
+ * @brief Format the list label for a device; NVS-restored devices are marked as unconfirmed
+ * and UPnP renderers, which cannot be cast to, as DLNA
+ */
+static void format_device_label(const chromecast_device_info_t *device, char *buffer, size_t size) {
+    const char *prefix = device->protocol == CHROMECAST_PROTOCOL_UPNP ? "DLNA: "
+                       : (device->capabilities & CHROMECAST_CAP_MULTIZONE_GROUP) ? "Group: " : "";
+    snprintf(buffer, size, device->probable ? "%s%s (%s, last seen)" : "%s%s (%s)",
+             prefix, device->name, device->ip_address);
+}
+
+/**
+ * @brief Whether two records are the same device: by UUID, else by mDNS instance name
+ */
+static bool same_device(const chromecast_device_info_t *a, const chromecast_device_info_t *b) {
+    return b->uuid[0] ? strcmp(a->uuid, b->uuid) == 0
+                      : strcmp(a->instance_name, b->instance_name) == 0;
+}
+
+/**
+ * @brief Bring a device list button up to date with a device record
+ *
+ * Nothing is touched if the record is unchanged, and the label only when its
+ * text is different, so a rename or a last-seen change redraws one row.
+ */
+static void set_device_button(lv_obj_t *btn, const chromecast_device_info_t *device) {
+    chromecast_device_info_t *device_data = lv_obj_get_user_data(btn);
+    if (!device_data || memcmp(device_data, device, sizeof(chromecast_device_info_t)) == 0) {
+        return;
+    }
+    memcpy(device_data, device, sizeof(chromecast_device_info_t));
+
+    char btn_text[128];
+    format_device_label(device, btn_text, sizeof(btn_text));
+
+    uint32_t child_count = lv_obj_get_child_cnt(btn);
+    for (uint32_t i = 0; i < child_count; i++) {
+        lv_obj_t *child = lv_obj_get_child(btn, i);
+        if (lv_obj_check_type(child, &lv_label_class) && strcmp(lv_label_get_text(child), btn_text) != 0) {
+            lv_label_set_text(child, btn_text);
+        }
+    }
+}
+
+static void remove_device_button(lv_obj_t *btn) {
+    free(lv_obj_get_user_data(btn));
+    lv_obj_del(btn);
+}
+
+static void add_device_button(const chromecast_device_info_t *device) {
+    // Create button with device name and IP
+    char btn_text[128];
+    format_device_label(device, btn_text, sizeof(btn_text));
+
+    lv_obj_t *btn = lv_list_add_btn(g_gui_state.device_list_container, LV_SYMBOL_AUDIO, btn_text);
+
+    // Store device info in button user data
+    chromecast_device_info_t *device_data = malloc(sizeof(chromecast_device_info_t));
+    if (device_data) {
+        memcpy(device_data, device, sizeof(chromecast_device_info_t));
+        lv_obj_set_user_data(btn, device_data);
+        lv_obj_add_event_cb(btn, device_button_cb, LV_EVENT_CLICKED, NULL);
+    }
+}
+
+static lv_obj_t *find_device_button(const chromecast_device_info_t *device);
+
+/**
+ * @brief Patch the device list to match a full set of devices
+ *
+ * Rows are keyed by device: rows of devices no longer in the set are
+ * deleted, new devices are appended and the rest are updated in place, so
+ * the scroll position and a row being pressed survive a refresh. A set
+ * identical to what is shown changes nothing.
+ */
 void chromecast_gui_show_devices(const chromecast_device_info_t *devices, size_t device_count) {
     if (!devices || device_count == 0 || !g_gui_state.main_container) {
         ESP_LOGW(TAG, "No devices to display or main container not available");
         return;
     }
 
-    ESP_LOGI(TAG, "Displaying %d Chromecast devices", device_count);
-
-    // Remove existing device list
-    chromecast_gui_hide_devices();
+    if (!g_gui_state.device_list_container) {
+        g_gui_state.device_list_container = lv_list_create(g_gui_state.main_container);
+        lv_obj_set_size(g_gui_state.device_list_container, lv_pct(90), LV_SIZE_CONTENT);
+        lv_obj_center(g_gui_state.device_list_container);
+    }
 
-    // Create new list container
-    g_gui_state.device_list_container = lv_list_create(g_gui_state.main_container);
-    lv_obj_set_size(g_gui_state.device_list_container, lv_pct(90), LV_SIZE_CONTENT);
-    lv_obj_center(g_gui_state.device_list_container);
+    // Backwards, so deleting a row does not move the ones still to be checked
+    uint32_t child_count = lv_obj_get_child_cnt(g_gui_state.device_list_container);
+    for (uint32_t i = child_count; i-- > 0;) {
+        lv_obj_t *child = lv_obj_get_child(g_gui_state.device_list_container, i);
+        const chromecast_device_info_t *shown = lv_obj_get_user_data(child);
+        if (!shown) {
+            continue;
+        }
+        bool present = false;
+        for (size_t d = 0; d < device_count && !present; d++) {
+            present = same_device(shown, &devices[d]);
+        }
+        if (!present) {
+            ESP_LOGI(TAG, "Device gone: %s", shown->name);
+            remove_device_button(child);
+        }
+    }
 
-    // Add devices to list
     for (size_t i = 0; i < device_count; i++) {
-        // Create button with device name and IP
-        char btn_text[128];
-        snprintf(btn_text, sizeof(btn_text), "%s (%s)", 
-                 devices[i].name, devices[i].ip_address);
+        lv_obj_t *btn = find_device_button(&devices[i]);
+        if (btn) {
+            set_device_button(btn, &devices[i]);
+        } else {
+            ESP_LOGI(TAG, "Device added: %s", devices[i].name);
+            add_device_button(&devices[i]);
+        }
+    }
+}
 
-        lv_obj_t *btn = lv_list_add_btn(g_gui_state.device_list_container, LV_SYMBOL_AUDIO, btn_text);
-        
-        // Store device info in button user data
-        chromecast_device_info_t *device_data = malloc(sizeof(chromecast_device_info_t));
-        if (device_data) {
-            memcpy(device_data, &devices[i], sizeof(chromecast_device_info_t));
-            lv_obj_set_user_data(btn, device_data);
-            lv_obj_add_event_cb(btn, device_button_cb, LV_EVENT_CLICKED, NULL);
+/**
+ * @brief Find the list button showing a device, matched by UUID or instance name
+ */
+static lv_obj_t *find_device_button(const chromecast_device_info_t *device) {
+    if (!g_gui_state.device_list_container) {
+        return NULL;
+    }
+
+    uint32_t child_count = lv_obj_get_child_cnt(g_gui_state.device_list_container);
+    for (uint32_t i = 0; i < child_count; i++) {
+        lv_obj_t *child = lv_obj_get_child(g_gui_state.device_list_container, i);
+        const chromecast_device_info_t *shown = lv_obj_get_user_data(child);
+        if (shown && same_device(shown, device)) {
+            return child;
         }
     }
+    return NULL;
+}
+
+void chromecast_gui_apply_device_event(chromecast_device_event_t event, const chromecast_device_info_t *device) {
+    // The preferred device answered at a new address: try the standby there
+    if (device && g_gui_state.standby == STANDBY_WAIT_DISCOVERY && event != CHROMECAST_DEVICE_REMOVED &&
+        !device->probable && device->uuid[0] && same_device(device, &g_gui_state.standby_device) &&
+        strcmp(device->ip_address, g_gui_state.standby_device.ip_address) != 0) {
+        ESP_LOGI(TAG, "Standby device %s moved to %s", device->name, device->ip_address);
+        g_gui_state.standby_device = *device;
+        standby_connect();
+    }
 
-    ESP_LOGI(TAG, "Displayed %d Chromecast devices", device_count);
+    // The list is rebuilt from the discovery cache when the volume screen closes
+    if (!device || !g_gui_state.main_container || g_gui_state.volume_control_container) {
+        return;
+    }
+
+    lv_obj_t *btn = find_device_button(device);
+    switch (event) {
+        case CHROMECAST_DEVICE_ADDED:
+        case CHROMECAST_DEVICE_UPDATED:
+            if (!g_gui_state.device_list_container) {
+                chromecast_gui_show_devices(device, 1);
+            } else if (!btn) {
+                add_device_button(device);
+            } else {
+                set_device_button(btn, device);
+            }
+            break;
+
+        case CHROMECAST_DEVICE_REMOVED:
+            if (btn) {
+                remove_device_button(btn);
+            }
+            break;
+    }
+}
+
+static void show_cached_devices(void) {
+    if (!g_gui_state.discovery_handle) {
+        return;
+    }
+
+    const chromecast_device_table_t *table = chromecast_discovery_acquire_devices(g_gui_state.discovery_handle);
+    size_t count = 0;
+    const chromecast_device_info_t *devices = chromecast_device_table_devices(table, &count);
+    if (count > 0) {
+        chromecast_gui_show_devices(devices, count);
+    }
+    chromecast_device_table_release(table);
 }
 
 void chromecast_gui_hide_devices(void) {
@@ -191,66 +486,99 @@ void chromecast_gui_hide_devices(void) {
 }
 
 void chromecast_gui_update_status(const char *device_name, const char *ip_address, bool connected) {
-    if (!g_gui_state.status_bar) {
-        return;
-    }
+    control_api_set_cast_status(device_name, connected);
 
-    char status_text[128];
     if (connected && device_name && ip_address) {
-        snprintf(status_text, sizeof(status_text), "Chromecast: Connected to %s (%s)", device_name, ip_address);
+        set_status("Chromecast: Connected to %s (%s)", device_name, ip_address);
     } else {
-        snprintf(status_text, sizeof(status_text), "Chromecast: Disconnected");
+        set_status("Chromecast: Disconnected");
     }
-
-    lv_label_set_text(g_gui_state.status_bar, status_text);
-    ESP_LOGI(TAG, "Updated Chromecast status: %s", status_text);
+    ESP_LOGI(TAG, "Updated Chromecast status: %s", g_gui_state.status_text);
 }
 
-void chromecast_gui_show_volume_control(const chromecast_device_info_t *device_info) {
-    if (!device_info || !g_gui_state.main_container) {
+void chromecast_gui_set_scanning(bool scanning, size_t device_count) {
+    if (g_gui_state.scan_spinner) {
+        if (scanning) {
+            lv_obj_clear_flag(g_gui_state.scan_spinner, LV_OBJ_FLAG_HIDDEN);
+        } else {
+            lv_obj_add_flag(g_gui_state.scan_spinner, LV_OBJ_FLAG_HIDDEN);
+        }
+    }
+    // The status bar belongs to the connection while one is up
+    if (g_gui_state.volume_shown) {
         return;
     }
+    if (scanning) {
+        set_status("Chromecast: Scanning...");
+    } else if (device_count == 0) {
+        set_status("Chromecast: No devices found");
+    } else {
+        set_status("Chromecast: %u device%s found", (unsigned)device_count, device_count == 1 ? "" : "s");
+    }
+}
 
-    ESP_LOGI(TAG, "Showing volume control for device: %s", device_info->name);
+static void bind_volume_slider(lv_obj_t *obj, const now_playing_state_t *state, uint32_t changed) {
+    if (state->volume_percent >= 0) {
+        lv_slider_set_value(obj, state->volume_percent, LV_ANIM_ON);
+    }
+}
 
-    // Hide device list
-    chromecast_gui_hide_devices();
+static void bind_volume_label(lv_obj_t *obj, const now_playing_state_t *state, uint32_t changed) {
+    if (state->volume_percent >= 0) {
+        lv_label_set_text_fmt(obj, "Volume: %d%% %s", state->volume_percent, state->muted ? "(Muted)" : "");
+    }
+}
+
+static void bind_mute_label(lv_obj_t *obj, const now_playing_state_t *state, uint32_t changed) {
+    lv_label_set_text(obj, state->muted ? "Unmute" : "Mute");
+}
 
+// Hidden until shown or revealed
+static void build_volume_widgets(const chromecast_device_info_t *device, volume_widgets_t *w) {
     // Create volume control container
-    g_gui_state.volume_control_container = lv_obj_create(g_gui_state.main_container);
-    lv_obj_set_size(g_gui_state.volume_control_container, lv_pct(90), lv_pct(80));
-    lv_obj_center(g_gui_state.volume_control_container);
+    w->container = lv_obj_create(g_gui_state.main_container);
+    lv_obj_set_size(w->container, lv_pct(90), lv_pct(80));
+    lv_obj_center(w->container);
+    ui_layer_cache_attach(w->container);
+    lv_obj_add_flag(w->container, LV_OBJ_FLAG_HIDDEN);
 
     // Device name label
-    lv_obj_t *device_label = lv_label_create(g_gui_state.volume_control_container);
-    lv_label_set_text_fmt(device_label, "Controlling: %s", device_info->name);
+    lv_obj_t *device_label = lv_label_create(w->container);
+    lv_label_set_text_fmt(device_label, "Controlling: %s", device->name);
     lv_obj_align(device_label, LV_ALIGN_TOP_MID, 0, 10);
 
     // Volume label
-    g_gui_state.volume_label = lv_label_create(g_gui_state.volume_control_container);
-    lv_label_set_text(g_gui_state.volume_label, "Volume: 50%");
-    lv_obj_align(g_gui_state.volume_label, LV_ALIGN_TOP_MID, 0, 40);
+    w->label = lv_label_create(w->container);
+    lv_label_set_text(w->label, "Volume: 50%");
+    lv_obj_align(w->label, LV_ALIGN_TOP_MID, 0, 40);
 
     // Volume slider
-    g_gui_state.volume_slider = lv_slider_create(g_gui_state.volume_control_container);
-    lv_obj_set_size(g_gui_state.volume_slider, 200, 20);
-    lv_obj_align(g_gui_state.volume_slider, LV_ALIGN_CENTER, 0, -20);
-    lv_slider_set_range(g_gui_state.volume_slider, 0, 100);
-    lv_slider_set_value(g_gui_state.volume_slider, 50, LV_ANIM_OFF);
-    lv_obj_add_event_cb(g_gui_state.volume_slider, volume_slider_cb, LV_EVENT_VALUE_CHANGED, NULL);
+    w->slider = lv_slider_create(w->container);
+    lv_obj_set_size(w->slider, 200, 20);
+    lv_obj_align(w->slider, LV_ALIGN_CENTER, 0, -20);
+    lv_slider_set_range(w->slider, 0, 100);
+    lv_slider_set_value(w->slider, 50, LV_ANIM_OFF);
+    lv_obj_add_event_cb(w->slider, volume_slider_cb, LV_EVENT_VALUE_CHANGED, NULL);
+    // A drag then only redraws the indicator and the knob with styles
+    ui_layer_cache_attach(w->slider);
 
     // Mute button
-    g_gui_state.mute_button = lv_btn_create(g_gui_state.volume_control_container);
-    lv_obj_set_size(g_gui_state.mute_button, 100, 40);
-    lv_obj_align(g_gui_state.mute_button, LV_ALIGN_CENTER, 0, 30);
-    lv_obj_add_event_cb(g_gui_state.mute_button, mute_button_cb, LV_EVENT_CLICKED, NULL);
+    w->mute_button = lv_btn_create(w->container);
+    lv_obj_set_size(w->mute_button, 100, 40);
+    lv_obj_align(w->mute_button, LV_ALIGN_CENTER, 0, 30);
+    lv_obj_add_event_cb(w->mute_button, mute_button_cb, LV_EVENT_CLICKED, NULL);
     
-    lv_obj_t *mute_label = lv_label_create(g_gui_state.mute_button);
+    lv_obj_t *mute_label = lv_label_create(w->mute_button);
     lv_label_set_text(mute_label, "Mute");
     lv_obj_center(mute_label);
 
+    // Volume reports only redraw these three; the level was reset when the connect started
+    now_playing_store_bind(w->slider, NOW_PLAYING_VOLUME, bind_volume_slider);
+    now_playing_store_bind(w->label, NOW_PLAYING_VOLUME, bind_volume_label);
+    now_playing_store_bind(mute_label, NOW_PLAYING_VOLUME, bind_mute_label);
+
     // Back button
-    lv_obj_t *back_button = lv_btn_create(g_gui_state.volume_control_container);
+    lv_obj_t *back_button = lv_btn_create(w->container);
     lv_obj_set_size(back_button, 80, 30);
     lv_obj_align(back_button, LV_ALIGN_BOTTOM_LEFT, 10, -10);
     lv_obj_add_event_cb(back_button, back_button_cb, LV_EVENT_CLICKED, NULL);
@@ -258,10 +586,84 @@ void chromecast_gui_show_volume_control(const chromecast_device_info_t *device_i
     lv_obj_t *back_label = lv_label_create(back_button);
     lv_label_set_text(back_label, "Back");
     lv_obj_center(back_label);
+}
+
+static lv_obj_t *build_predicted_volume_control(void) {
+    // Only while the device list is up: the volume screen comes next from there
+    if (!g_gui_state.main_container || g_gui_state.volume_control_container) {
+        return NULL;
+    }
+    if (!g_gui_state.volume_prebuilt.container) {
+        ESP_LOGD(TAG, "Building the volume screen for %s ahead", g_gui_state.prebuilt_device.name);
+        build_volume_widgets(&g_gui_state.prebuilt_device, &g_gui_state.volume_prebuilt);
+    }
+    return g_gui_state.volume_prebuilt.container;
+}
+
+static void discard_prebuilt_volume(void) {
+    ui_prerender_cancel(&g_gui_state.volume_prerender);
+    if (g_gui_state.volume_prebuilt.container) {
+        lv_obj_del(g_gui_state.volume_prebuilt.container);
+    }
+    memset(&g_gui_state.volume_prebuilt, 0, sizeof(g_gui_state.volume_prebuilt));
+}
+
+// The volume screen for device is what opens next: built and drawn on idle frames
+static void predict_volume_control(const chromecast_device_info_t *device) {
+    if (!g_gui_state.main_container || g_gui_state.volume_shown) {
+        return;
+    }
+    if (g_gui_state.volume_prebuilt.container && !same_device(&g_gui_state.prebuilt_device, device)) {
+        discard_prebuilt_volume();
+    }
+    if (device != &g_gui_state.prebuilt_device) {
+        g_gui_state.prebuilt_device = *device;
+    }
+    ui_prerender_want(&g_gui_state.volume_prerender, build_predicted_volume_control);
+}
+
+void chromecast_gui_show_volume_control(const chromecast_device_info_t *device_info) {
+    if (!device_info) {
+        return;
+    }
+    if (!g_gui_state.main_container) {
+        // Shown when the tab is built
+        if (device_info != &g_gui_state.selected_device) {
+            g_gui_state.selected_device = *device_info;
+        }
+        g_gui_state.device_selected = true;
+        g_gui_state.volume_shown = true;
+        return;
+    }
+
+    ESP_LOGI(TAG, "Showing volume control for device: %s", device_info->name);
+
+    // Hide device list
+    chromecast_gui_hide_devices();
+
+    volume_widgets_t widgets = g_gui_state.volume_prebuilt;
+    bool prebuilt = widgets.container && same_device(&g_gui_state.prebuilt_device, device_info);
+    if (prebuilt) {
+        memset(&g_gui_state.volume_prebuilt, 0, sizeof(g_gui_state.volume_prebuilt));
+    } else {
+        discard_prebuilt_volume();
+        build_volume_widgets(device_info, &widgets);
+    }
+    g_gui_state.volume_control_container = widgets.container;
+    g_gui_state.volume_slider = widgets.slider;
+    g_gui_state.mute_button = widgets.mute_button;
+    g_gui_state.volume_label = widgets.label;
+    // Slid in from its snapshot if that is current, else shown as it is
+    if (!ui_prerender_reveal(&g_gui_state.volume_prerender, widgets.container)) {
+        lv_obj_clear_flag(widgets.container, LV_OBJ_FLAG_HIDDEN);
+    }
 
     // Store selected device
-    memcpy(&g_gui_state.selected_device, device_info, sizeof(chromecast_device_info_t));
+    if (device_info != &g_gui_state.selected_device) {
+        memcpy(&g_gui_state.selected_device, device_info, sizeof(chromecast_device_info_t));
+    }
     g_gui_state.device_selected = true;
+    g_gui_state.volume_shown = true;
 
     // Get initial status
     if (g_gui_state.controller_handle) {
@@ -277,32 +679,18 @@ void chromecast_gui_hide_volume_control(void) {
         g_gui_state.mute_button = NULL;
         g_gui_state.volume_label = NULL;
     }
+    discard_prebuilt_volume();
     g_gui_state.device_selected = false;
+    g_gui_state.volume_shown = false;
 }
 
 void chromecast_gui_update_volume(const chromecast_volume_info_t *volume_info) {
     if (!volume_info) return;
 
-    if (g_gui_state.volume_slider) {
-        int volume_percent = (int)(volume_info->level * 100);
-        lv_slider_set_value(g_gui_state.volume_slider, volume_percent, LV_ANIM_ON);
-    }
-
-    if (g_gui_state.volume_label) {
-        char volume_text[32];
-        snprintf(volume_text, sizeof(volume_text), "Volume: %d%% %s",
-                 (int)(volume_info->level * 100), volume_info->muted ? "(Muted)" : "");
-        lv_label_set_text(g_gui_state.volume_label, volume_text);
-    }
-
-    if (g_gui_state.mute_button) {
-        lv_obj_t *mute_label = lv_obj_get_child(g_gui_state.mute_button, 0);
-        if (mute_label) {
-            lv_label_set_text(mute_label, volume_info->muted ? "Unmute" : "Mute");
-        }
-    }
+    // The bound widgets redraw only if the percentage or the mute changed
+    now_playing_store_set_volume((int)(volume_info->level * 100), volume_info->muted);
 
-    ESP_LOGI(TAG, "Updated volume display: %.2f%% %s",
+    ESP_LOGD(TAG, "Updated volume display: %.2f%% %s",
              volume_info->level * 100, volume_info->muted ? "(Muted)" : "");
 }
 
@@ -313,35 +701,20 @@ void chromecast_gui_show_connection_dialog(const char *device_name) {
 
     ESP_LOGI(TAG, "Showing connection dialog for device: %s", device_name);
 
-    // Create modal dialog
-    g_gui_state.connection_modal = lv_obj_create(lv_scr_act());
-    lv_obj_set_size(g_gui_state.connection_modal, 250, 150);
-    lv_obj_center(g_gui_state.connection_modal);
-
-    // Title
-    lv_obj_t *title = lv_label_create(g_gui_state.connection_modal);
-    lv_label_set_text_fmt(title, "Connect to %s?", device_name);
-    lv_obj_align(title, LV_ALIGN_TOP_MID, 0, 10);
+    char title[80];
+    snprintf(title, sizeof(title), "Connect to %s?", device_name);
+    g_gui_state.connection_modal = ui_widget_pool_modal_open(250, 150, title, false);
+    if (!g_gui_state.connection_modal) {
+        return;
+    }
 
-    // Connect button
-    lv_obj_t *connect_btn = lv_btn_create(g_gui_state.connection_modal);
+    lv_obj_t *connect_btn = ui_widget_pool_modal_button(g_gui_state.connection_modal, 0, "Connect", connect_button_cb);
     lv_obj_set_size(connect_btn, 80, 30);
     lv_obj_align(connect_btn, LV_ALIGN_BOTTOM_LEFT, 20, -20);
-    lv_obj_add_event_cb(connect_btn, connect_button_cb, LV_EVENT_CLICKED, NULL);
 
-    lv_obj_t *connect_label = lv_label_create(connect_btn);
-    lv_label_set_text(connect_label, "Connect");
-    lv_obj_center(connect_label);
-
-    // Cancel button
-    lv_obj_t *cancel_btn = lv_btn_create(g_gui_state.connection_modal);
+    lv_obj_t *cancel_btn = ui_widget_pool_modal_button(g_gui_state.connection_modal, 1, "Cancel", cancel_button_cb);
     lv_obj_set_size(cancel_btn, 80, 30);
     lv_obj_align(cancel_btn, LV_ALIGN_BOTTOM_RIGHT, -20, -20);
-    lv_obj_add_event_cb(cancel_btn, cancel_button_cb, LV_EVENT_CLICKED, NULL);
-
-    lv_obj_t *cancel_label = lv_label_create(cancel_btn);
-    lv_label_set_text(cancel_label, "Cancel");
-    lv_obj_center(cancel_label);
 }
 
 lv_obj_t *chromecast_gui_get_status_bar(void) {
@@ -362,23 +735,77 @@ chromecast_controller_handle_t chromecast_gui_get_controller_handle(void) {
     return g_gui_state.controller_handle;
 }
 
+bool chromecast_gui_cast_file(const char *path, const char *title) {
+    const char *status;
+    bool sent = false;
+    if (!g_gui_state.controller_handle ||
+        chromecast_controller_get_state(g_gui_state.controller_handle) != CHROMECAST_CONNECTED) {
+        status = "Chromecast: Connect a device to cast to";
+    } else if (!(sent = chromecast_controller_load_file(g_gui_state.controller_handle, path, title, true))) {
+        status = "Chromecast: Could not cast the track";
+    } else {
+        status = NULL;
+    }
+
+    if (status) {
+        set_status("%s", status);
+    } else {
+        set_status("Chromecast: Casting %s", title ? title : path);
+    }
+    return sent;
+}
+
 // Callback implementations
 static void scan_button_cb(lv_event_t *e) {
     ESP_LOGI(TAG, "Chromecast scan button clicked");
 
     if (!g_gui_state.discovery_handle) {
         ESP_LOGE(TAG, "ChromecastDiscovery not initialized");
-        chromecast_gui_update_status("Error", "Discovery not initialized", false);
+        set_status("Chromecast: Discovery not initialized");
         return;
     }
 
-    // Update status to show scanning
-    chromecast_gui_update_status("Scanning", "Looking for Chromecast devices...", false);
+    // Show known devices right away; answers patch the list in place as they arrive
+    show_cached_devices();
 
-    // Start asynchronous discovery
-    if (!chromecast_discovery_discover_async(g_gui_state.discovery_handle)) {
+    // A second tap during a scan just keeps the one running
+    if (!chromecast_discovery_is_active(g_gui_state.discovery_handle) &&
+        !chromecast_discovery_discover_async(g_gui_state.discovery_handle)) {
         ESP_LOGE(TAG, "Failed to start Chromecast discovery");
-        chromecast_gui_update_status("Error", "Discovery failed - Check WiFi connection", false);
+        set_status("Chromecast: Discovery failed - Check WiFi");
+        return;
+    }
+    chromecast_gui_set_scanning(true, 0);
+}
+
+// From a tap, which asks first, or a voice command, which does not
+static void select_device(const chromecast_device_info_t *device, bool ask) {
+    ESP_LOGI(TAG, "Selected Chromecast device: %s", device->name);
+
+    if (device->protocol != CHROMECAST_PROTOCOL_CAST) {
+        set_status("Chromecast: %s is a DLNA renderer, not a Cast device", device->name);
+        return;
+    }
+
+    chromecast_standby_t standby = g_gui_state.standby;
+    bool standby_device = standby != STANDBY_OFF && same_device(device, &g_gui_state.standby_device);
+    // Claimed, the standby connection is the user's; any other device replaces it
+    standby_stop(!standby_device);
+
+    // Store selected device
+    memcpy(&g_gui_state.selected_device, device, sizeof(chromecast_device_info_t));
+    g_gui_state.device_selected = true;
+
+    if (standby_device && standby == STANDBY_READY) {
+        // Already connected and reporting: live on the first touch
+        chromecast_gui_show_volume_control(device);
+    } else if (standby_device && standby == STANDBY_CONNECTING) {
+        // The volume screen opens on CHROMECAST_CONNECT_COMPLETE
+        set_status("Chromecast: Connecting to %s...", device->name);
+    } else if (ask) {
+        chromecast_gui_show_connection_dialog(device->name);
+    } else {
+        connect_selected_device();
     }
 }
 
@@ -387,22 +814,26 @@ static void device_button_cb(lv_event_t *e) {
     chromecast_device_info_t *device = (chromecast_device_info_t *)lv_obj_get_user_data(btn);
 
     if (device) {
-        ESP_LOGI(TAG, "Selected Chromecast device: %s", device->name);
-
-        // Store selected device
-        memcpy(&g_gui_state.selected_device, device, sizeof(chromecast_device_info_t));
-        g_gui_state.device_selected = true;
+        select_device(device, true);
+    }
+}
 
-        chromecast_gui_show_connection_dialog(device->name);
+void chromecast_gui_connect_device(const chromecast_device_info_t *device) {
+    if (device && g_gui_state.initialized) {
+        select_device(device, false);
     }
 }
 
 static void volume_slider_cb(lv_event_t *e) {
-    lv_obj_t *slider = lv_event_get_target(e);
-    int32_t value = lv_slider_get_value(slider);
-    float volume_level = value / 100.0f;
+    ESP_LOGD(TAG, "Volume slider changed to: %d%%", (int)lv_slider_get_value(lv_event_get_target(e)));
+    request_slider_volume();
+}
 
-    ESP_LOGI(TAG, "Volume slider changed to: %d%%", value);
+static void request_slider_volume(void) {
+    if (!g_gui_state.volume_slider) {
+        return;
+    }
+    float volume_level = lv_slider_get_value(g_gui_state.volume_slider) / 100.0f;
 
     if (g_gui_state.controller_handle && g_gui_state.device_selected) {
         // Get current mute state from the button label
@@ -415,7 +846,8 @@ static void volume_slider_cb(lv_event_t *e) {
             }
         }
 
-        chromecast_controller_set_volume(g_gui_state.controller_handle, volume_level, is_muted);
+        // Latest value wins; the controller coalesces a drag into a few commands
+        chromecast_controller_request_volume(g_gui_state.controller_handle, volume_level, is_muted);
     }
 }
 
@@ -435,13 +867,16 @@ static void mute_button_cb(lv_event_t *e) {
             is_currently_muted = (strcmp(label_text, "Unmute") == 0);
         }
 
-        chromecast_controller_set_volume(g_gui_state.controller_handle, volume_level, !is_currently_muted);
+        chromecast_controller_request_volume(g_gui_state.controller_handle, volume_level, !is_currently_muted);
     }
 }
 
 static void back_button_cb(lv_event_t *e) {
     ESP_LOGI(TAG, "Back button clicked");
+    chromecast_gui_disconnect();
+}
 
+void chromecast_gui_disconnect(void) {
     // Disconnect from current device
     if (g_gui_state.controller_handle) {
         chromecast_controller_disconnect(g_gui_state.controller_handle);
@@ -450,42 +885,65 @@ static void back_button_cb(lv_event_t *e) {
     // Hide volume control and show device list
     chromecast_gui_hide_volume_control();
 
-    // Trigger a new scan to refresh the device list
-    if (g_gui_state.discovery_handle) {
-        chromecast_discovery_discover_async(g_gui_state.discovery_handle);
+    // Restore the list from the cache, then refresh it in the background
+    show_cached_devices();
+    if (g_gui_state.discovery_handle && !chromecast_discovery_is_active(g_gui_state.discovery_handle) &&
+        chromecast_discovery_discover_async(g_gui_state.discovery_handle)) {
+        chromecast_gui_set_scanning(true, 0);
     }
 }
 
-static void connect_button_cb(lv_event_t *e) {
-    ESP_LOGI(TAG, "Connect button clicked");
-
+static void connect_selected_device(void) {
     if (g_gui_state.device_selected && g_gui_state.controller_handle) {
-        // Connect to the selected device
-        if (chromecast_controller_connect(g_gui_state.controller_handle, g_gui_state.selected_device.ip_address)) {
+        // The last device's level is not this one's
+        now_playing_store_set_volume(-1, false);
+
+        // Connect in the background; the volume screen opens on CHROMECAST_CONNECT_COMPLETE.
+        // Groups use their own port on the leader, so the slider drives the whole group.
+        if (chromecast_controller_connect_async_port(g_gui_state.controller_handle,
+                                                     g_gui_state.selected_device.ip_address,
+                                                     g_gui_state.selected_device.port,
+                                                     g_gui_state.selected_device.uuid)) {
             ESP_LOGI(TAG, "Connection initiated to %s", g_gui_state.selected_device.name);
-
-            // Show volume control interface
-            chromecast_gui_show_volume_control(&g_gui_state.selected_device);
-
-            // Start heartbeat
-            chromecast_controller_start_heartbeat(g_gui_state.controller_handle);
+            set_status("Chromecast: Connecting to %s...", g_gui_state.selected_device.name);
+            // Ready by the time the handshake is done, if the frames in between are idle
+            predict_volume_control(&g_gui_state.selected_device);
         } else {
             ESP_LOGE(TAG, "Failed to connect to %s", g_gui_state.selected_device.name);
         }
     }
+}
+
+static void connect_button_cb(lv_event_t *e) {
+    ESP_LOGI(TAG, "Connect button clicked");
+
+    connect_selected_device();
 
     // Close connection dialog
-    if (g_gui_state.connection_modal) {
-        lv_obj_del(g_gui_state.connection_modal);
-        g_gui_state.connection_modal = NULL;
-    }
+    ui_widget_pool_modal_close(g_gui_state.connection_modal);
+    g_gui_state.connection_modal = NULL;
 }
 
+// Controller callbacks run on the receive and connect tasks; they only post
+// to the event bus, and the handlers below touch the widgets
 static void chromecast_state_callback(chromecast_connection_state_t state) {
+    gui_event_t event = { .type = GUI_EVENT_CHROMECAST_STATE, .data.value = state };
+    if (!gui_event_bus_post(&event)) {
+        ESP_LOGW(TAG, "Dropped Chromecast state event");
+    }
+}
+
+static void state_event_handler(const gui_event_t *event) {
+    chromecast_connection_state_t state = (chromecast_connection_state_t)event->data.value;
     const char *state_str = "Unknown";
     switch (state) {
         case CHROMECAST_DISCONNECTED:
             state_str = "Disconnected";
+            if (g_gui_state.standby == STANDBY_READY) {
+                standby_stop(false);
+                // Not for a connect under way: it may be to another device
+                discard_prebuilt_volume();
+            }
             chromecast_gui_update_status(NULL, NULL, false);
             break;
         case CHROMECAST_CONNECTING:
@@ -493,7 +951,9 @@ static void chromecast_state_callback(chromecast_connection_state_t state) {
             break;
         case CHROMECAST_CONNECTED:
             state_str = "Connected";
-            if (g_gui_state.device_selected) {
+            if (g_gui_state.standby != STANDBY_OFF) {
+                // The standby's own status line is set on CHROMECAST_CONNECT_COMPLETE
+            } else if (g_gui_state.device_selected) {
                 chromecast_gui_update_status(g_gui_state.selected_device.name,
                                            g_gui_state.selected_device.ip_address, true);
             }
@@ -507,19 +967,214 @@ static void chromecast_state_callback(chromecast_connection_state_t state) {
     ESP_LOGI(TAG, "Chromecast state changed to: %s", state_str);
 }
 
+static void chromecast_connect_progress_callback(chromecast_connect_stage_t stage) {
+    gui_event_t event = { .type = GUI_EVENT_CHROMECAST_CONNECT_PROGRESS, .data.value = stage };
+    if (!gui_event_bus_post(&event)) {
+        ESP_LOGW(TAG, "Dropped Chromecast connect progress event");
+    }
+}
+
+static void connect_progress_event_handler(const gui_event_t *event) {
+    chromecast_connect_stage_t stage = (chromecast_connect_stage_t)event->data.value;
+
+    switch (stage) {
+        case CHROMECAST_CONNECT_TLS_HANDSHAKE:
+            set_status("Chromecast: Securing connection...");
+            break;
+        case CHROMECAST_CONNECT_VIRTUAL_CONNECT:
+            set_status("Chromecast: Opening session...");
+            break;
+        case CHROMECAST_CONNECT_COMPLETE:
+            if (g_gui_state.standby == STANDBY_CONNECTING) {
+                ESP_LOGI(TAG, "Standby connection to %s ready", g_gui_state.standby_device.name);
+                g_gui_state.standby = STANDBY_READY;
+                set_status("Chromecast: %s ready", g_gui_state.standby_device.name);
+                // The volume is known before the screen is opened
+                chromecast_controller_get_status(g_gui_state.controller_handle);
+                predict_volume_control(&g_gui_state.standby_device);
+                break;
+            }
+            ESP_LOGI(TAG, "Connected to %s", g_gui_state.selected_device.name);
+            save_preferred_device(&g_gui_state.selected_device);
+            chromecast_gui_show_volume_control(&g_gui_state.selected_device);
+            break;
+        case CHROMECAST_CONNECT_FAILED:
+            if (g_gui_state.standby == STANDBY_CONNECTING) {
+                // Its address may be stale; discovery will tell where it went
+                ESP_LOGW(TAG, "Standby connection to %s failed", g_gui_state.standby_device.name);
+                g_gui_state.standby = g_gui_state.standby_device.uuid[0] ? STANDBY_WAIT_DISCOVERY : STANDBY_OFF;
+                if (g_gui_state.standby == STANDBY_OFF) {
+                    standby_stop(false);
+                }
+            } else {
+                ESP_LOGE(TAG, "Failed to connect to %s", g_gui_state.selected_device.name);
+            }
+            if (!g_gui_state.volume_shown) {
+                discard_prebuilt_volume();
+            }
+            chromecast_gui_update_status(NULL, NULL, false);
+            break;
+        case CHROMECAST_CONNECT_CANCELLED:
+            if (g_gui_state.standby == STANDBY_CONNECTING) {
+                standby_stop(false);
+            }
+            if (!g_gui_state.volume_shown) {
+                discard_prebuilt_volume();
+            }
+            chromecast_gui_update_status(NULL, NULL, false);
+            break;
+    }
+}
+
 static void chromecast_volume_callback(const chromecast_volume_info_t* volume) {
     if (volume) {
-        ESP_LOGI(TAG, "Volume callback: %.2f%% %s",
-                 volume->level * 100, volume->muted ? "(Muted)" : "");
-        chromecast_gui_update_volume(volume);
+        gui_event_t event = { .type = GUI_EVENT_CHROMECAST_VOLUME };
+        event.data.volume.level = volume->level;
+        event.data.volume.muted = volume->muted;
+        if (!gui_event_bus_post(&event)) {
+            ESP_LOGW(TAG, "Dropped Chromecast volume event");
+        }
+    }
+}
+
+static void volume_event_handler(const gui_event_t *event) {
+    chromecast_volume_info_t volume = {
+        .level = event->data.volume.level,
+        .muted = event->data.volume.muted,
+    };
+    ESP_LOGI(TAG, "Volume callback: %.2f%% %s",
+             volume.level * 100, volume.muted ? "(Muted)" : "");
+    chromecast_gui_update_volume(&volume);
+    // The bindings moved the hidden screen on: its snapshot is retaken when idle
+    if (g_gui_state.volume_prebuilt.container) {
+        predict_volume_control(&g_gui_state.prebuilt_device);
+    }
+}
+
+static void gesture_event_handler(const gui_event_t *event) {
+    static float rotate_remainder = 0;
+
+    if (event->data.gesture.type != TOUCH_GESTURE_ROTATE || !g_gui_state.volume_slider) {
+        rotate_remainder = 0;
+        return;
+    }
+
+    // Whole percents only; the rest carries over to the next event
+    float percent = rotate_remainder + event->data.gesture.value / CHROMECAST_GUI_ROTATE_DEG_PER_PERCENT;
+    int32_t step = (int32_t)percent;
+    rotate_remainder = percent - step;
+    if (step == 0) {
+        return;
     }
+
+    int32_t value = lv_slider_get_value(g_gui_state.volume_slider) + step;
+    value = LV_CLAMP(0, value, 100);
+    lv_slider_set_value(g_gui_state.volume_slider, value, LV_ANIM_OFF);
+    request_slider_volume();
 }
 
 static void cancel_button_cb(lv_event_t *e) {
     ESP_LOGI(TAG, "Cancel button clicked");
 
-    if (g_gui_state.connection_modal) {
-        lv_obj_del(g_gui_state.connection_modal);
-        g_gui_state.connection_modal = NULL;
+    ui_widget_pool_modal_close(g_gui_state.connection_modal);
+    g_gui_state.connection_modal = NULL;
+}
+
+static void save_preferred_device(const chromecast_device_info_t *device) {
+    // Only what identifies and reaches it, so a status change does not rewrite flash
+    chromecast_device_info_t record = *device;
+    record.probable = false;
+    memset(record.status, 0, sizeof(record.status));
+
+    // An unchanged record writes nothing
+    esp_err_t err = config_store_set_blob(CHROMECAST_GUI_PREF_NAMESPACE, CHROMECAST_GUI_PREF_DEVICE_KEY,
+                                          &record, sizeof(record));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save preferred device: %s", esp_err_to_name(err));
+    }
+}
+
+static void standby_timer_cb(lv_timer_t *timer) {
+    ESP_LOGI(TAG, "Standby connection to %s unused, dropping it", g_gui_state.standby_device.name);
+    standby_stop(true);
+}
+
+static void standby_connect(void) {
+    const chromecast_device_info_t *device = &g_gui_state.standby_device;
+    if (!chromecast_controller_connect_background(g_gui_state.controller_handle, device->ip_address,
+                                                  device->port, device->uuid)) {
+        standby_stop(false);
+        return;
+    }
+    g_gui_state.standby = STANDBY_CONNECTING;
+
+    // Counted from the first attempt: a retry does not extend it
+    if (!g_gui_state.standby_timer) {
+        g_gui_state.standby_timer = lv_timer_create(standby_timer_cb,
+                                                    CHROMECAST_GUI_STANDBY_IDLE_MS, NULL);
+    }
+}
+
+#if CONFIG_ESPCASTER_CAST_STANDBY
+/**
+ * @brief Read the last device connected to from the list
+ *
+ * A record written with another chromecast_device_info_t layout is ignored.
+ */
+static bool load_preferred_device(chromecast_device_info_t *device) {
+    size_t size = sizeof(*device);
+    esp_err_t err = config_store_get_blob(CHROMECAST_GUI_PREF_NAMESPACE, CHROMECAST_GUI_PREF_DEVICE_KEY, device, &size);
+    return err == ESP_OK && size == sizeof(*device) && device->ip_address[0];
+}
+
+// IP event task: the standby is started on the LVGL thread
+static void got_ip_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
+    gui_event_bus_post_call(standby_start_call, NULL);
+}
+
+static void standby_start_call(void *arg) {
+    if (g_gui_state.standby_tried || !g_gui_state.controller_handle) {
+        return;
+    }
+    g_gui_state.standby_tried = true;
+
+    // Someone got there first
+    if (g_gui_state.device_selected ||
+        chromecast_controller_get_state(g_gui_state.controller_handle) != CHROMECAST_DISCONNECTED) {
+        return;
+    }
+    if (!load_preferred_device(&g_gui_state.standby_device)) {
+        ESP_LOGI(TAG, "No preferred device for a warm standby");
+        return;
+    }
+
+    ESP_LOGI(TAG, "Warm standby to %s (%s)", g_gui_state.standby_device.name,
+             g_gui_state.standby_device.ip_address);
+    now_playing_store_set_volume(-1, false);
+    standby_connect();
+}
+#endif
+
+/**
+ * @brief End the warm standby
+ *
+ * @param drop Also cancel or close its connection; false when the user has
+ *             taken it over, or it has already gone
+ */
+static void standby_stop(bool drop) {
+    if (g_gui_state.standby_timer) {
+        lv_timer_del(g_gui_state.standby_timer);
+        g_gui_state.standby_timer = NULL;
+    }
+
+    chromecast_standby_t standby = g_gui_state.standby;
+    g_gui_state.standby = STANDBY_OFF;
+    if (!drop || !g_gui_state.controller_handle) {
+        return;
+    }
+    if (standby == STANDBY_CONNECTING) {
+        chromecast_controller_cancel_connect(g_gui_state.controller_handle);
+    } else if (standby == STANDBY_READY) {
+        chromecast_controller_disconnect(g_gui_state.controller_handle);
     }
 }
@@ -14,6 +14,11 @@ extern "C" {
  * 
  * This component provides a graphical user interface for Chromecast management
  * using LVGL, including device discovery, device selection, and volume control.
+ * 
+ * With CONFIG_ESPCASTER_CAST_STANDBY the device last connected to from the
+ * list is connected to in the background once Wi-Fi is up at boot, so tapping
+ * it opens a volume screen that is already live. An unused standby
+ * connection is closed after CONFIG_ESPCASTER_CAST_STANDBY_IDLE_S.
  */
 
 /**
@@ -51,6 +56,15 @@ esp_err_t chromecast_gui_manager_deinit(void);
  */
 lv_obj_t *chromecast_gui_create_interface(lv_obj_t *parent);
 
+/**
+ * @brief Forget the interface's widgets before its parent deletes them
+ *
+ * The status line and the open volume screen are kept; the next
+ * chromecast_gui_create_interface() shows them again, with the device
+ * list from the discovery cache.
+ */
+void chromecast_gui_unload_interface(void);
+
 /**
  * @brief Show discovered Chromecast devices
  * 
@@ -64,6 +78,17 @@ void chromecast_gui_show_devices(const chromecast_device_info_t *devices, size_t
  */
 void chromecast_gui_hide_devices(void);
 
+/**
+ * @brief Apply a single device table change to the displayed list
+ * 
+ * Adds, relabels or removes one list entry instead of rebuilding the list.
+ * Ignored while the volume screen is shown. Must run on the LVGL thread.
+ * 
+ * @param event Kind of change
+ * @param device Device that changed
+ */
+void chromecast_gui_apply_device_event(chromecast_device_event_t event, const chromecast_device_info_t *device);
+
 /**
  * @brief Update Chromecast connection status
  * 
@@ -73,6 +98,18 @@ void chromecast_gui_hide_devices(void);
  */
 void chromecast_gui_update_status(const char *device_name, const char *ip_address, bool connected);
 
+/**
+ * @brief Show or end the scanning indicator
+ * 
+ * While scanning, a spinner turns on the scan button and devices appear in
+ * the list one by one as they answer. At the end the status bar shows how
+ * many were found. Must run on the LVGL thread.
+ * 
+ * @param scanning Whether a discovery is running
+ * @param device_count Devices known when it ended (ignored while scanning)
+ */
+void chromecast_gui_set_scanning(bool scanning, size_t device_count);
+
 /**
  * @brief Show volume control interface for selected device
  * 
@@ -129,6 +166,29 @@ void chromecast_gui_set_discovery_handle(chromecast_discovery_handle_t discovery
  */
 chromecast_controller_handle_t chromecast_gui_get_controller_handle(void);
 
+/**
+ * @brief Connect to a device as a tap on it does, without the confirmation dialog
+ * 
+ * For voice commands; the volume screen opens once it is connected.
+ * @param device Device information (copied)
+ */
+void chromecast_gui_connect_device(const chromecast_device_info_t *device);
+
+/**
+ * @brief Disconnect and go back to the device list, as the back button does
+ */
+void chromecast_gui_disconnect(void);
+
+/**
+ * @brief Play a local file on the connected Chromecast, via the media server
+ * 
+ * The outcome is shown on the status bar.
+ * @param path File under MEDIA_SERVER_ROOT
+ * @param title Shown on the receiver, may be NULL
+ * @return true if the LOAD was sent (or queued behind launching the receiver)
+ */
+bool chromecast_gui_cast_file(const char *path, const char *title);
+
 #ifdef __cplusplus
 }
 #endif
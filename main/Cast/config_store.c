@@ -0,0 +1,404 @@
+#include "config_store.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "telemetry_ui.h"
+#include <string.h>
+
+static const char *TAG = "config_store";
+
+#define PSRAM_CAPS  (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+
+typedef struct {
+    char ns[NVS_NS_NAME_MAX_SIZE];
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_type_t type;            // NVS_TYPE_STR or NVS_TYPE_BLOB
+    uint8_t *value;             // A string with its terminator
+    size_t length;
+    uint32_t generation;        // Bumped by every change: a flush's copy is still current if it matches
+    bool present;               // false once erased
+    bool dirty;                 // Changed since written; a slot neither present nor dirty is free
+} item_t;
+
+// A dirty key as a flush took it
+typedef struct {
+    item_t item;
+    size_t slot;
+    esp_err_t err;
+} pending_t;
+
+static item_t g_items[CONFIG_STORE_MAX_KEYS];
+static char g_namespaces[CONFIG_STORE_MAX_NAMESPACES][NVS_NS_NAME_MAX_SIZE];   // Read from NVS
+static SemaphoreHandle_t g_lock;            // g_items, g_namespaces and the dirty state
+static SemaphoreHandle_t g_flush_lock;      // One flush at a time: the task's or config_store_flush()'s
+static TaskHandle_t g_task;
+static config_store_gate_t g_gate;
+static bool g_dirty;
+static TickType_t g_dirty_since;            // The first unwritten change
+static volatile TickType_t g_changed_at;    // The last one
+
+// Caller holds g_lock
+static item_t *find_item(const char *ns, const char *key) {
+    for (size_t i = 0; i < CONFIG_STORE_MAX_KEYS; ++i) {
+        item_t *item = &g_items[i];
+        if ((item->present || item->dirty) && strcmp(item->key, key) == 0 && strcmp(item->ns, ns) == 0) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+// Caller holds g_lock
+static item_t *new_item(const char *ns, const char *key) {
+    for (size_t i = 0; i < CONFIG_STORE_MAX_KEYS; ++i) {
+        item_t *item = &g_items[i];
+        if (!item->present && !item->dirty) {
+            heap_caps_free(item->value);
+            memset(item, 0, sizeof(*item));
+            strlcpy(item->ns, ns, sizeof(item->ns));
+            strlcpy(item->key, key, sizeof(item->key));
+            return item;
+        }
+    }
+    ESP_LOGE(TAG, "No room for %s/%s", ns, key);
+    return NULL;
+}
+
+static void load_entry(nvs_handle_t nvs, const char *ns, const nvs_entry_info_t *info) {
+    size_t length = 0;
+    esp_err_t err = info->type == NVS_TYPE_STR ? nvs_get_str(nvs, info->key, NULL, &length)
+                                               : nvs_get_blob(nvs, info->key, NULL, &length);
+    uint8_t *value = err == ESP_OK ? heap_caps_malloc(length ? length : 1, PSRAM_CAPS) : NULL;
+    if (!value) {
+        return;
+    }
+    err = info->type == NVS_TYPE_STR ? nvs_get_str(nvs, info->key, (char *)value, &length)
+                                     : nvs_get_blob(nvs, info->key, value, &length);
+    item_t *item = err == ESP_OK ? new_item(ns, info->key) : NULL;
+    if (!item) {
+        heap_caps_free(value);
+        return;
+    }
+    item->type = info->type;
+    item->value = value;
+    item->length = length;
+    item->present = true;
+}
+
+// Caller holds g_lock. Reads ns's strings and blobs the first time it is used
+static esp_err_t load_namespace(const char *ns) {
+    if (strlen(ns) >= NVS_NS_NAME_MAX_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t slot = 0;
+    for (; slot < CONFIG_STORE_MAX_NAMESPACES && g_namespaces[slot][0]; ++slot) {
+        if (strcmp(g_namespaces[slot], ns) == 0) {
+            return ESP_OK;
+        }
+    }
+    if (slot == CONFIG_STORE_MAX_NAMESPACES) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    nvs_iterator_t it = NULL;
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, ns, NVS_TYPE_ANY, &it);
+    if (err == ESP_OK && nvs_open(ns, NVS_READONLY, &nvs) == ESP_OK) {
+        size_t count = 0;
+        for (; err == ESP_OK; err = nvs_entry_next(&it)) {
+            nvs_entry_info_t info;
+            if (nvs_entry_info(it, &info) == ESP_OK && (info.type == NVS_TYPE_STR || info.type == NVS_TYPE_BLOB)) {
+                load_entry(nvs, ns, &info);
+                count++;
+            }
+        }
+        nvs_close(nvs);
+        ESP_LOGI(TAG, "%s: %u keys", ns, (unsigned)count);
+    }
+    nvs_release_iterator(it);
+    strlcpy(g_namespaces[slot], ns, sizeof(g_namespaces[slot]));
+    return ESP_OK;
+}
+
+// Caller holds g_lock
+static void mark_dirty(item_t *item) {
+    TickType_t now = xTaskGetTickCount();
+    item->dirty = true;
+    item->generation++;
+    if (!g_dirty) {
+        g_dirty = true;
+        g_dirty_since = now;
+    }
+    g_changed_at = now;
+    xTaskNotifyGive(g_task);
+}
+
+static esp_err_t get_value(const char *ns, const char *key, nvs_type_t type, void *out, size_t *length) {
+    if (!g_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    esp_err_t err = load_namespace(ns);
+    item_t *item = err == ESP_OK ? find_item(ns, key) : NULL;
+    if (err == ESP_OK) {
+        if (!item || !item->present) {
+            err = ESP_ERR_NVS_NOT_FOUND;
+        } else if (item->type != type) {
+            err = ESP_ERR_NVS_TYPE_MISMATCH;
+        } else if (out && *length < item->length) {
+            err = ESP_ERR_NVS_INVALID_LENGTH;
+        } else {
+            if (out) {
+                memcpy(out, item->value, item->length);
+            }
+            *length = item->length;
+        }
+    }
+    xSemaphoreGive(g_lock);
+    return err;
+}
+
+static esp_err_t set_value(const char *ns, const char *key, nvs_type_t type, const void *value, size_t length) {
+    if (!g_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (strlen(key) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    esp_err_t err = load_namespace(ns);
+    item_t *item = err == ESP_OK ? find_item(ns, key) : NULL;
+    if (err != ESP_OK || (item && item->present && item->type == type && item->length == length &&
+                          memcmp(item->value, value, length) == 0)) {
+        xSemaphoreGive(g_lock);
+        return err;     // Unchanged: nothing to write
+    }
+
+    uint8_t *copy = heap_caps_malloc(length ? length : 1, PSRAM_CAPS);
+    if (!item && copy) {
+        item = new_item(ns, key);
+    }
+    if (!copy || !item) {
+        heap_caps_free(copy);
+        xSemaphoreGive(g_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, value, length);
+    heap_caps_free(item->value);
+    item->value = copy;
+    item->length = length;
+    item->type = type;
+    item->present = true;
+    mark_dirty(item);
+    xSemaphoreGive(g_lock);
+    return ESP_OK;
+}
+
+esp_err_t config_store_get_str(const char *ns, const char *key, char *out, size_t *length) {
+    return get_value(ns, key, NVS_TYPE_STR, out, length);
+}
+
+esp_err_t config_store_get_blob(const char *ns, const char *key, void *out, size_t *length) {
+    return get_value(ns, key, NVS_TYPE_BLOB, out, length);
+}
+
+esp_err_t config_store_set_str(const char *ns, const char *key, const char *value) {
+    return set_value(ns, key, NVS_TYPE_STR, value, strlen(value) + 1);
+}
+
+esp_err_t config_store_set_blob(const char *ns, const char *key, const void *value, size_t length) {
+    return set_value(ns, key, NVS_TYPE_BLOB, value, length);
+}
+
+esp_err_t config_store_erase_key(const char *ns, const char *key) {
+    if (!g_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    esp_err_t err = load_namespace(ns);
+    item_t *item = err == ESP_OK ? find_item(ns, key) : NULL;
+    if (item && item->present) {
+        heap_caps_free(item->value);
+        item->value = NULL;
+        item->length = 0;
+        item->present = false;
+        mark_dirty(item);
+    }
+    xSemaphoreGive(g_lock);
+    return err;
+}
+
+static esp_err_t write_namespace(pending_t *pending, size_t count, size_t first) {
+    nvs_handle_t nvs;
+    const char *ns = pending[first].item.ns;
+    esp_err_t err = nvs_open(ns, NVS_READWRITE, &nvs);
+    for (size_t i = first; i < count; ++i) {
+        pending_t *p = &pending[i];
+        if (strcmp(p->item.ns, ns) != 0) {
+            continue;
+        }
+        if (err != ESP_OK) {
+            p->err = err;
+        } else if (!p->item.present) {
+            p->err = nvs_erase_key(nvs, p->item.key);
+            p->err = p->err == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : p->err;
+        } else if (p->item.type == NVS_TYPE_STR) {
+            p->err = nvs_set_str(nvs, p->item.key, (const char *)p->item.value);
+        } else {
+            p->err = nvs_set_blob(nvs, p->item.key, p->item.value, p->item.length);
+        }
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    // Uncommitted, none of them is written
+    for (size_t i = first; err != ESP_OK && i < count; ++i) {
+        if (strcmp(pending[i].item.ns, ns) == 0) {
+            pending[i].err = err;
+        }
+    }
+    return err;
+}
+
+// Caller holds g_flush_lock. Copies the dirty keys out, so sets carry on
+// against RAM while flash is written
+static esp_err_t flush_dirty(void) {
+    pending_t *pending = heap_caps_calloc(CONFIG_STORE_MAX_KEYS, sizeof(*pending), PSRAM_CAPS);
+    if (!pending) {
+        return ESP_ERR_NO_MEM;
+    }
+    size_t count = 0;
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    for (size_t i = 0; i < CONFIG_STORE_MAX_KEYS; ++i) {
+        item_t *item = &g_items[i];
+        if (!item->dirty) {
+            continue;
+        }
+        pending_t *p = &pending[count];
+        p->item = *item;
+        p->item.value = item->present ? heap_caps_malloc(item->length ? item->length : 1, PSRAM_CAPS) : NULL;
+        if (item->present && !p->item.value) {
+            continue;           // Stays dirty for the next flush
+        }
+        if (p->item.value) {
+            memcpy(p->item.value, item->value, item->length);
+        }
+        p->slot = i;
+        item->dirty = false;
+        count++;
+    }
+    g_dirty = false;
+    xSemaphoreGive(g_lock);
+
+    esp_err_t result = ESP_OK;
+    for (size_t i = 0; i < count; ++i) {
+        bool first = true;
+        for (size_t j = 0; j < i; ++j) {
+            first = first && strcmp(pending[j].item.ns, pending[i].item.ns) != 0;
+        }
+        if (first && write_namespace(pending, count, i) != ESP_OK) {
+            result = ESP_FAIL;
+        }
+    }
+
+    size_t failed = 0;
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    for (size_t i = 0; i < count; ++i) {
+        pending_t *p = &pending[i];
+        item_t *item = &g_items[p->slot];
+        if (p->err != ESP_OK) {
+            ESP_LOGW(TAG, "Writing %s/%s failed: %s", p->item.ns, p->item.key, esp_err_to_name(p->err));
+            result = ESP_FAIL;
+            if (item->generation == p->item.generation && strcmp(item->key, p->item.key) == 0) {
+                mark_dirty(item);   // Retried a debounce later
+                failed++;
+            }
+        }
+        heap_caps_free(p->item.value);
+    }
+    for (size_t i = 0; i < CONFIG_STORE_MAX_KEYS; ++i) {
+        g_dirty = g_dirty || g_items[i].dirty;
+    }
+    xSemaphoreGive(g_lock);
+    heap_caps_free(pending);
+
+    if (count > failed) {
+        ESP_LOGI(TAG, "%u keys written", (unsigned)(count - failed));
+    }
+    return result;
+}
+
+static void flush_task(void *arg) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Every change notifies again, restarting the wait
+        TickType_t quiet;
+        while ((quiet = xTaskGetTickCount() - g_changed_at) < pdMS_TO_TICKS(CONFIG_STORE_DEBOUNCE_MS)) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_STORE_DEBOUNCE_MS) - quiet);
+        }
+        xSemaphoreTake(g_lock, portMAX_DELAY);
+        bool dirty = g_dirty;
+        TickType_t since = g_dirty_since;
+        xSemaphoreGive(g_lock);
+        if (!dirty) {
+            continue;
+        }
+        config_store_gate_t gate = g_gate;
+        while (gate && !gate() && xTaskGetTickCount() - since < pdMS_TO_TICKS(CONFIG_STORE_MAX_DEFER_MS)) {
+            vTaskDelay(pdMS_TO_TICKS(CONFIG_STORE_GATE_POLL_MS));
+        }
+
+        xSemaphoreTake(g_flush_lock, portMAX_DELAY);
+        flush_dirty();
+        xSemaphoreGive(g_flush_lock);
+    }
+}
+
+esp_err_t config_store_init(void) {
+    if (g_lock) {
+        return ESP_OK;
+    }
+
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_LOGW(TAG, "NVS partition was truncated and needs to be erased");
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    g_flush_lock = xSemaphoreCreateMutex();
+    SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    if (!g_flush_lock || !lock ||
+        xTaskCreate(flush_task, "config_store", CONFIG_STORE_TASK_STACK, NULL, CONFIG_STORE_TASK_PRIORITY,
+                    &g_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the flush task");
+        return ESP_ERR_NO_MEM;
+    }
+    g_lock = lock;      // Last: gets and sets start working now
+    return ESP_OK;
+}
+
+esp_err_t config_store_flush(void) {
+    if (!g_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    telemetry_ui_blocking("nvs_commit");
+    xSemaphoreTake(g_flush_lock, portMAX_DELAY);
+    esp_err_t err = flush_dirty();
+    xSemaphoreGive(g_flush_lock);
+    return err;
+}
+
+void config_store_set_gate(config_store_gate_t gate) {
+    g_gate = gate;
+}
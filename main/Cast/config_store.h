@@ -0,0 +1,87 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include "task_plan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Config store - settings in RAM, written to NVS behind
+ *
+ * An NVS write erases and programs flash, which stalls the caches of both
+ * cores for its duration: a hitch in rendering, and possibly in audio, when
+ * done from a GUI callback. The settings of the managers here (Wi-Fi
+ * credentials and AP cache, Spotify app config, the preferred Cast device)
+ * go through this store instead.
+ *
+ * A namespace's strings and blobs are read from NVS into PSRAM on its first
+ * use, at boot, and every later get is served from there. A set or erase
+ * changes RAM at once and marks the key dirty; setting what a key already
+ * holds marks nothing. A priority-1 task writes the dirty keys, one
+ * nvs_commit() per namespace, CONFIG_STORE_DEBOUNCE_MS after the last
+ * change, so a burst of settings costs one flush. It then waits for the
+ * gate, if one is set, to report a quiet moment (no touch, say), but not
+ * longer than CONFIG_STORE_MAX_DEFER_MS after the first unwritten change. A
+ * failed write is retried at the next flush.
+ *
+ * Any task may call these after config_store_init().
+ */
+
+#define CONFIG_STORE_MAX_KEYS       32
+#define CONFIG_STORE_MAX_NAMESPACES 8
+#define CONFIG_STORE_DEBOUNCE_MS    2000
+#define CONFIG_STORE_MAX_DEFER_MS   30000
+#define CONFIG_STORE_GATE_POLL_MS   250
+#define CONFIG_STORE_QUIET_MS       1500    // The GUI's gate: this long without input
+#define CONFIG_STORE_TASK_PRIORITY  TASK_PLAN_BACKGROUND_PRIORITY
+#define CONFIG_STORE_TASK_STACK     3072
+
+/**
+ * @brief Whether now is a good moment for a flash write; called from the flush task
+ */
+typedef bool (*config_store_gate_t)(void);
+
+/**
+ * @brief Initialize NVS (erasing a partition it cannot use) and start the flush task
+ *
+ * Safe to call more than once.
+ */
+esp_err_t config_store_init(void);
+
+/**
+ * @brief nvs_get_str() from RAM
+ *
+ * @param out NULL to ask for the length only
+ * @param length In: out's size; out: the length with the terminator
+ * @return ESP_ERR_NVS_NOT_FOUND, ESP_ERR_NVS_TYPE_MISMATCH or
+ *         ESP_ERR_NVS_INVALID_LENGTH like NVS
+ */
+esp_err_t config_store_get_str(const char *ns, const char *key, char *out, size_t *length);
+
+/**
+ * @brief nvs_get_blob() from RAM, with the same conventions
+ */
+esp_err_t config_store_get_blob(const char *ns, const char *key, void *out, size_t *length);
+
+esp_err_t config_store_set_str(const char *ns, const char *key, const char *value);
+esp_err_t config_store_set_blob(const char *ns, const char *key, const void *value, size_t length);
+
+/**
+ * @brief Remove key; ESP_OK whether or not it was there
+ */
+esp_err_t config_store_erase_key(const char *ns, const char *key);
+
+/**
+ * @brief Write every dirty key now, on the calling task; before a restart
+ */
+esp_err_t config_store_flush(void);
+
+void config_store_set_gate(config_store_gate_t gate);
+
+#ifdef __cplusplus
+}
+#endif
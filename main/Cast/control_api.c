@@ -0,0 +1,736 @@
+#include "control_api.h"
+#include "sdkconfig.h"
+
+#if CONFIG_CONTROL_API
+#include "chromecast_gui_manager.h"
+#include "spotify_gui_manager.h"
+#include "gui_event_bus.h"
+#include "now_playing_store.h"
+#include "OTA_Update.h"
+#include "telemetry_hist.h"
+#include "mem_tag.h"
+#include "esp_http_server.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "cJSON.h"
+#include "mdns.h"
+#include "lwip/inet.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *TAG = "control_api";
+
+#define CONTROL_API_PREFIX          "/api/"
+#define CONTROL_API_MDNS_HOSTNAME   "espcaster"     // Only if nothing set one before
+#define CONTROL_API_TOKEN_HEADER    "X-ESPCaster-Token"
+#define CONTROL_API_MAX_HEADER      128
+
+typedef enum {
+    SECTION_PLAYBACK,
+    SECTION_VOLUME,
+    SECTION_CAST,
+    SECTION_CAST_DEVICES,
+    SECTION_SPOTIFY_DEVICES,
+    SECTION_COUNT
+} section_t;
+
+#define SECTION_BIT(section)    (1u << (section))
+#define SECTION_ALL             ((1u << SECTION_COUNT) - 1)
+
+static const char *const SECTION_NAMES[SECTION_COUNT] = {
+    "playback", "volume", "cast", "cast_devices", "spotify_devices",
+};
+
+typedef enum {
+    COMMAND_CAST_VOLUME,
+    COMMAND_SPOTIFY_PLAY,
+    COMMAND_SPOTIFY_PAUSE,
+    COMMAND_SPOTIFY_NEXT,
+    COMMAND_SPOTIFY_PREVIOUS,
+    COMMAND_SPOTIFY_DEVICES,
+    COMMAND_OTA,
+} command_action_t;
+
+static const struct {
+    const char *name;
+    command_action_t action;
+} COMMANDS[] = {
+    { "cast/volume",        COMMAND_CAST_VOLUME },
+    { "spotify/play",       COMMAND_SPOTIFY_PLAY },
+    { "spotify/pause",      COMMAND_SPOTIFY_PAUSE },
+    { "spotify/next",       COMMAND_SPOTIFY_NEXT },
+    { "spotify/previous",   COMMAND_SPOTIFY_PREVIOUS },
+    { "spotify/devices",    COMMAND_SPOTIFY_DEVICES },
+    { "ota",                COMMAND_OTA },
+};
+
+typedef struct {
+    command_action_t action;
+    bool has_level;
+    float level;
+    int muted;                  // -1 to keep
+    char uri[256];              // spotify/play, "" to resume; ota, the package URL
+} command_t;
+
+// A message for the httpd task to send
+typedef struct {
+    int fd;                     // -1 for every WebSocket client
+    char *text;
+} ws_message_t;
+
+static httpd_handle_t s_server;
+static chromecast_discovery_handle_t s_discovery;
+static SemaphoreHandle_t s_lock;            // Guards s_sections and the playback copy
+static char *s_sections[SECTION_COUNT];     // Unformatted JSON values, NULL until known
+
+// Playback is printed per message, for a current progress_ms
+static now_playing_state_t s_playback;
+static int64_t s_progress_us;               // esp_timer time of s_playback.progress_ms
+static bool s_playback_known;
+
+/**********************************************************************************
+ * State
+ **********************************************************************************/
+// Lock held
+static char *print_playback(void) {
+    int64_t position = s_playback.progress_ms;
+    if (s_playback.is_playing) {
+        position += (esp_timer_get_time() - s_progress_us) / 1000;
+    }
+    if (s_playback.duration_ms > 0 && position > s_playback.duration_ms) {
+        position = s_playback.duration_ms;
+    }
+
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "track", s_playback.track);
+    cJSON_AddStringToObject(json, "artist", s_playback.artist);
+    cJSON_AddStringToObject(json, "image_url", s_playback.image_url);
+    cJSON_AddStringToObject(json, "device", s_playback.device);
+    cJSON_AddNumberToObject(json, "duration_ms", s_playback.duration_ms);
+    cJSON_AddNumberToObject(json, "progress_ms", (double)position);
+    cJSON_AddBoolToObject(json, "playing", s_playback.is_playing);
+    char *text = cJSON_PrintUnformatted(json);
+    cJSON_Delete(json);
+    return text;
+}
+
+/**
+ * @brief {"section":value,...} for the known sections in mask; free() it
+ */
+static char *build_message(uint32_t mask) {
+    mem_tag_scope_t scope = mem_tag_enter(MEM_TAG_CONTROL, NULL);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    char *playback = (mask & SECTION_BIT(SECTION_PLAYBACK)) && s_playback_known ? print_playback() : NULL;
+    const char *values[SECTION_COUNT];
+    size_t size = sizeof("{}");
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        values[i] = !(mask & SECTION_BIT(i)) ? NULL : (i == SECTION_PLAYBACK ? playback : s_sections[i]);
+        if (values[i]) {
+            size += strlen(SECTION_NAMES[i]) + strlen(values[i]) + sizeof("\"\":,");
+        }
+    }
+
+    char *message = malloc(size);
+    if (message) {
+        char *p = message;
+        *p++ = '{';
+        for (int i = 0; i < SECTION_COUNT; i++) {
+            if (values[i]) {
+                p += sprintf(p, "%s\"%s\":%s", p > message + 1 ? "," : "", SECTION_NAMES[i], values[i]);
+            }
+        }
+        strcpy(p, "}");
+    }
+    xSemaphoreGive(s_lock);
+    cJSON_free(playback);
+    mem_tag_leave(scope);
+    return message;
+}
+
+static void ws_send_work(void *arg) {
+    ws_message_t *message = arg;
+    httpd_ws_frame_t frame = {
+        .final = true,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)message->text,
+        .len = strlen(message->text),
+    };
+
+    int fds[CONTROL_API_CLIENTS];
+    size_t count = CONTROL_API_CLIENTS;
+    if (message->fd >= 0) {
+        fds[0] = message->fd;
+        count = 1;
+    } else if (httpd_get_client_list(s_server, &count, fds) != ESP_OK) {
+        count = 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (httpd_ws_get_fd_info(s_server, fds[i]) == HTTPD_WS_CLIENT_WEBSOCKET) {
+            httpd_ws_send_frame_async(s_server, fds[i], &frame);
+        }
+    }
+    free(message->text);
+    free(message);
+}
+
+// Sent from the httpd task, which owns the sockets
+static void ws_send(int fd, uint32_t mask) {
+    ws_message_t *message = malloc(sizeof(*message));
+    char *text = message ? build_message(mask) : NULL;
+    if (!text) {
+        free(message);
+        return;
+    }
+    message->fd = fd;
+    message->text = text;
+    if (httpd_queue_work(s_server, ws_send_work, message) != ESP_OK) {
+        ESP_LOGW(TAG, "Dropped a state update");
+        free(text);
+        free(message);
+    }
+}
+
+// Takes value; pushes it to the WebSocket clients if it is new
+static void set_section(section_t section, char *value) {
+    if (!value) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool changed = !s_sections[section] || strcmp(s_sections[section], value) != 0;
+    if (changed) {
+        cJSON_free(s_sections[section]);
+        s_sections[section] = value;
+        value = NULL;
+    }
+    xSemaphoreGive(s_lock);
+    cJSON_free(value);
+
+    if (changed) {
+        ws_send(-1, SECTION_BIT(section));
+    }
+}
+
+static char *print_and_delete(cJSON *json) {
+    char *text = json ? cJSON_PrintUnformatted(json) : NULL;
+    cJSON_Delete(json);
+    return text;
+}
+
+static void now_playing_changed(const now_playing_state_t *state, uint32_t changed) {
+    if (!s_server) {
+        return;
+    }
+    if (changed & NOW_PLAYING_VOLUME) {
+        mem_tag_scope_t scope = mem_tag_enter(MEM_TAG_CONTROL, NULL);
+        cJSON *json = cJSON_CreateObject();
+        if (state->volume_percent >= 0) {
+            cJSON_AddNumberToObject(json, "percent", state->volume_percent);
+        } else {
+            cJSON_AddNullToObject(json, "percent");
+        }
+        cJSON_AddBoolToObject(json, "muted", state->muted);
+        set_section(SECTION_VOLUME, print_and_delete(json));
+        mem_tag_leave(scope);
+    }
+    if (changed & ~NOW_PLAYING_VOLUME) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_playback = *state;
+        s_progress_us = esp_timer_get_time() - (int64_t)lv_tick_elaps(state->progress_tick) * 1000;
+        s_playback_known = true;
+        xSemaphoreGive(s_lock);
+        ws_send(-1, SECTION_BIT(SECTION_PLAYBACK));
+    }
+}
+
+void control_api_set_cast_status(const char *device, bool connected) {
+    if (!s_server) {
+        return;
+    }
+    mem_tag_scope_t scope = mem_tag_enter(MEM_TAG_CONTROL, NULL);
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddBoolToObject(json, "connected", connected);
+    if (connected && device) {
+        cJSON_AddStringToObject(json, "device", device);
+    } else {
+        cJSON_AddNullToObject(json, "device");
+    }
+    set_section(SECTION_CAST, print_and_delete(json));
+    mem_tag_leave(scope);
+}
+
+void control_api_cast_devices_changed(void) {
+    if (!s_server || !s_discovery) {
+        return;
+    }
+    mem_tag_scope_t scope = mem_tag_enter(MEM_TAG_CONTROL, NULL);
+    cJSON *json = cJSON_CreateArray();
+    const chromecast_device_table_t *table = chromecast_discovery_acquire_devices(s_discovery);
+    size_t count = 0;
+    const chromecast_device_info_t *devices = chromecast_device_table_devices(table, &count);
+    for (size_t i = 0; i < count && i < CONTROL_API_MAX_DEVICES; i++) {
+        cJSON *device = cJSON_CreateObject();
+        cJSON_AddStringToObject(device, "name", devices[i].name);
+        cJSON_AddStringToObject(device, "uuid", devices[i].uuid);
+        cJSON_AddStringToObject(device, "address", devices[i].ip_address);
+        cJSON_AddStringToObject(device, "model", devices[i].model);
+        cJSON_AddBoolToObject(device, "group", devices[i].capabilities & CHROMECAST_CAP_MULTIZONE_GROUP);
+        cJSON_AddStringToObject(device, "protocol",
+                                devices[i].protocol == CHROMECAST_PROTOCOL_UPNP ? "upnp" : "cast");
+        cJSON_AddStringToObject(device, "status", devices[i].status);
+        cJSON_AddItemToArray(json, device);
+    }
+    chromecast_device_table_release(table);
+    set_section(SECTION_CAST_DEVICES, print_and_delete(json));
+    mem_tag_leave(scope);
+}
+
+void control_api_set_spotify_devices(const spotify_device_view_t *devices, size_t count) {
+    if (!s_server) {
+        return;
+    }
+    mem_tag_scope_t scope = mem_tag_enter(MEM_TAG_CONTROL, NULL);
+    cJSON *json = cJSON_CreateArray();
+    for (size_t i = 0; devices && i < count && i < CONTROL_API_MAX_DEVICES; i++) {
+        cJSON *device = cJSON_CreateObject();
+        cJSON_AddStringToObject(device, "id", devices[i].id);
+        cJSON_AddStringToObject(device, "name", devices[i].name);
+        cJSON_AddStringToObject(device, "type", devices[i].type);
+        cJSON_AddBoolToObject(device, "active", devices[i].is_active);
+        cJSON_AddNumberToObject(device, "volume_percent", devices[i].volume_percent);
+        cJSON_AddItemToArray(json, device);
+    }
+    set_section(SECTION_SPOTIFY_DEVICES, print_and_delete(json));
+    mem_tag_leave(scope);
+}
+
+/**********************************************************************************
+ * Commands (LVGL thread)
+ **********************************************************************************/
+static chromecast_controller_handle_t connected_chromecast(void) {
+    chromecast_controller_handle_t handle = chromecast_gui_get_controller_handle();
+    if (!handle || chromecast_controller_get_state(handle) != CHROMECAST_CONNECTED) {
+        return NULL;
+    }
+    return handle;
+}
+
+static spotify_controller_handle_t connected_spotify(void) {
+    spotify_controller_handle_t handle = spotify_gui_get_controller_handle();
+    if (!handle || !spotify_controller_is_connected(handle)) {
+        return NULL;
+    }
+    return handle;
+}
+
+static bool set_cast_volume(const command_t *command) {
+    chromecast_controller_handle_t chromecast = connected_chromecast();
+    if (!chromecast) {
+        return false;
+    }
+    chromecast_volume_info_t volume = { 0 };
+    if (!chromecast_controller_get_volume(chromecast, &volume) && !command->has_level) {
+        return false;       // Nothing to keep the level at
+    }
+    if (command->has_level) {
+        volume.level = fmaxf(0.0f, fminf(1.0f, command->level));
+    }
+    if (command->muted >= 0) {
+        volume.muted = command->muted;
+    }
+    return chromecast_controller_request_volume(chromecast, volume.level, volume.muted);
+}
+
+static void run_command(void *arg) {
+    command_t *command = arg;
+    spotify_controller_handle_t spotify = connected_spotify();
+    bool queued = false;
+    if (command->action == COMMAND_CAST_VOLUME) {
+        queued = set_cast_volume(command);
+    } else if (command->action == COMMAND_OTA) {
+        queued = OTA_Update_Start(command->uri);
+    } else if (spotify) {
+        switch (command->action) {
+            case COMMAND_SPOTIFY_PLAY:
+                queued = spotify_controller_play(spotify, command->uri[0] ? command->uri : NULL);
+                break;
+            case COMMAND_SPOTIFY_PAUSE:     queued = spotify_controller_pause(spotify); break;
+            case COMMAND_SPOTIFY_NEXT:      queued = spotify_controller_next_track(spotify); break;
+            case COMMAND_SPOTIFY_PREVIOUS:  queued = spotify_controller_previous_track(spotify); break;
+            case COMMAND_SPOTIFY_DEVICES:   queued = spotify_controller_get_devices(spotify); break;
+            default: break;
+        }
+    }
+    if (!queued) {
+        ESP_LOGW(TAG, "Command %s not run", COMMANDS[command->action].name);
+    }
+    free(command);
+}
+
+// Compared in full whatever the first difference, so timing gives nothing away
+static bool token_valid(const char *token) {
+    const char *expected = CONFIG_CONTROL_API_OTA_TOKEN;
+    size_t len = strlen(expected);
+    if (!token || len == 0 || strlen(token) != len) {
+        return false;
+    }
+    uint8_t diff = 0;
+    for (size_t i = 0; i < len; i++) {
+        diff |= (uint8_t)token[i] ^ (uint8_t)expected[i];
+    }
+    return diff == 0;
+}
+
+/**
+ * @brief Queue the named command for the LVGL thread
+ *
+ * @param args The JSON body, or NULL for none
+ * @param token What the client sent as CONTROL_API_OTA_TOKEN, or NULL
+ * @return ESP_ERR_NOT_FOUND for an unknown name, ESP_ERR_NOT_ALLOWED for ota
+ *         without the token, ESP_ERR_NO_MEM if the bus is full
+ */
+static esp_err_t post_command(const char *name, const cJSON *args, const char *token) {
+    command_t *command = NULL;
+    for (size_t i = 0; i < sizeof(COMMANDS) / sizeof(COMMANDS[0]) && !command; i++) {
+        if (strcmp(name, COMMANDS[i].name) == 0) {
+            command = calloc(1, sizeof(*command));
+            if (!command) {
+                return ESP_ERR_NO_MEM;
+            }
+            command->action = COMMANDS[i].action;
+        }
+    }
+    if (!command) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (command->action == COMMAND_OTA && !token_valid(token)) {
+        ESP_LOGW(TAG, "Refused ota without the token");
+        free(command);
+        return ESP_ERR_NOT_ALLOWED;
+    }
+
+    const cJSON *level = cJSON_GetObjectItem(args, "level");
+    const cJSON *muted = cJSON_GetObjectItem(args, "muted");
+    const cJSON *uri = cJSON_GetObjectItem(args, command->action == COMMAND_OTA ? "url" : "uri");
+    command->has_level = cJSON_IsNumber(level);
+    command->level = command->has_level ? (float)level->valuedouble : 0.0f;
+    command->muted = cJSON_IsBool(muted) ? cJSON_IsTrue(muted) : -1;
+    if (cJSON_IsString(uri)) {
+        strlcpy(command->uri, uri->valuestring, sizeof(command->uri));
+    }
+
+    if (!gui_event_bus_post_call(run_command, command)) {
+        free(command);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/**********************************************************************************
+ * HTTP
+ **********************************************************************************/
+// An IP literal or our mDNS name: a name rebound to our address by someone's DNS is not
+static bool host_allowed(const char *host) {
+    if (host[0] == '[') {
+        return true;        // IPv6 literal
+    }
+    char name[CONTROL_API_MAX_HEADER];
+    strlcpy(name, host, sizeof(name));
+    name[strcspn(name, ":")] = '\0';
+    size_t len = strlen(name);
+    if (len && name[len - 1] == '.') {
+        name[--len] = '\0';
+    }
+
+    struct in_addr addr;
+    if (inet_pton(AF_INET, name, &addr) == 1) {
+        return true;
+    }
+    char hostname[64];
+    if (mdns_hostname_get(hostname) != ESP_OK) {
+        return false;
+    }
+    size_t hostname_len = strlen(hostname);
+    return len == hostname_len + strlen(".local") && strncasecmp(name, hostname, hostname_len) == 0 &&
+           strcasecmp(name + hostname_len, ".local") == 0;
+}
+
+/**
+ * @brief Host names this device, and Origin, if a browser sent one, the same
+ *
+ * A page elsewhere can make a browser send requests here, but the browser
+ * names that page in Origin.
+ */
+static bool request_allowed(httpd_req_t *req) {
+    char host[CONTROL_API_MAX_HEADER];
+    if (httpd_req_get_hdr_value_str(req, "Host", host, sizeof(host)) != ESP_OK || !host_allowed(host)) {
+        ESP_LOGW(TAG, "Refused a request for another host");
+        return false;
+    }
+
+    char origin[CONTROL_API_MAX_HEADER];
+    esp_err_t err = httpd_req_get_hdr_value_str(req, "Origin", origin, sizeof(origin));
+    if (err == ESP_ERR_NOT_FOUND) {
+        return true;
+    }
+    const char *origin_host = err == ESP_OK ? strstr(origin, "://") : NULL;
+    if (!origin_host || strcasecmp(origin_host + 3, host) != 0) {
+        ESP_LOGW(TAG, "Refused a request from another origin");
+        return false;
+    }
+    return true;
+}
+
+// application/json, which a page elsewhere cannot POST without a preflight we never answer
+static bool content_type_json(httpd_req_t *req) {
+    static const char JSON_TYPE[] = "application/json";
+    char type[CONTROL_API_MAX_HEADER];
+    if (httpd_req_get_hdr_value_str(req, "Content-Type", type, sizeof(type)) != ESP_OK ||
+        strncasecmp(type, JSON_TYPE, sizeof(JSON_TYPE) - 1) != 0) {
+        return false;
+    }
+    char next = type[sizeof(JSON_TYPE) - 1];
+    return next == '\0' || next == ';' || next == ' ';
+}
+
+static esp_err_t state_get_handler(httpd_req_t *req) {
+    if (!request_allowed(req)) {
+        return httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Forbidden");
+    }
+    char *message = build_message(SECTION_ALL);
+    if (!message) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No memory");
+    }
+    httpd_resp_set_type(req, "application/json");
+    esp_err_t err = httpd_resp_sendstr(req, message);
+    free(message);
+    return err;
+}
+
+// Counts and percentiles since boot, per histogram and for all Cast and Spotify requests
+static esp_err_t latency_get_handler(httpd_req_t *req) {
+    static const char *const AGGREGATES[] = { "cast ", "http " };
+    if (!request_allowed(req)) {
+        return httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Forbidden");
+    }
+    telemetry_hist_summary_t *summaries = malloc((CONFIG_TELEMETRY_HIST_SLOTS + 2) * sizeof(*summaries));
+    cJSON *root = cJSON_CreateObject();
+    cJSON *histograms = cJSON_AddArrayToObject(root, "histograms");
+    if (!summaries || !histograms) {
+        free(summaries);
+        cJSON_Delete(root);
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No memory");
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < sizeof(AGGREGATES) / sizeof(AGGREGATES[0]); i++) {
+        count += telemetry_hist_summarize(AGGREGATES[i], &summaries[count]);
+    }
+    count += telemetry_hist_list(&summaries[count], CONFIG_TELEMETRY_HIST_SLOTS);
+    for (size_t i = 0; i < count; i++) {
+        const telemetry_hist_summary_t *h = &summaries[i];
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "name", h->name);
+        cJSON_AddStringToObject(item, "unit", h->unit == TELEMETRY_HIST_US ? "us" : "ms");
+        cJSON_AddNumberToObject(item, "count", h->count);
+        cJSON_AddNumberToObject(item, "max", h->max);
+        cJSON_AddNumberToObject(item, "p50", h->p50);
+        cJSON_AddNumberToObject(item, "p95", h->p95);
+        cJSON_AddNumberToObject(item, "p99", h->p99);
+        cJSON_AddItemToArray(histograms, item);
+    }
+    free(summaries);
+
+    char *message = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (!message) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No memory");
+    }
+    httpd_resp_set_type(req, "application/json");
+    esp_err_t err = httpd_resp_sendstr(req, message);
+    free(message);
+    return err;
+}
+
+static esp_err_t command_post_handler(httpd_req_t *req) {
+    if (!request_allowed(req)) {
+        return httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Forbidden");
+    }
+    if (!content_type_json(req)) {
+        httpd_resp_set_status(req, "415 Unsupported Media Type");
+        return httpd_resp_sendstr(req, "Content-Type must be application/json");
+    }
+    if (req->content_len > CONTROL_API_MAX_BODY) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Body too large");
+    }
+    char body[CONTROL_API_MAX_BODY + 1];
+    size_t received = 0;
+    while (received < req->content_len) {
+        int n = httpd_req_recv(req, body + received, req->content_len - received);
+        if (n <= 0) {
+            return ESP_FAIL;
+        }
+        received += n;
+    }
+    body[received] = '\0';
+
+    mem_tag_scope_t scope = mem_tag_enter(MEM_TAG_CONTROL, NULL);
+    cJSON *args = received ? cJSON_Parse(body) : NULL;
+    if (received && !cJSON_IsObject(args)) {
+        cJSON_Delete(args);
+        mem_tag_leave(scope);
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Body is not a JSON object");
+    }
+    char name[32];
+    strlcpy(name, req->uri + strlen(CONTROL_API_PREFIX), sizeof(name));
+    name[strcspn(name, "?")] = '\0';
+    char token[CONTROL_API_MAX_HEADER];
+    bool has_token = httpd_req_get_hdr_value_str(req, CONTROL_API_TOKEN_HEADER, token, sizeof(token)) == ESP_OK;
+    esp_err_t err = post_command(name, args, has_token ? token : NULL);
+    cJSON_Delete(args);
+    mem_tag_leave(scope);
+
+    if (err == ESP_ERR_NOT_FOUND) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown command");
+    }
+    if (err == ESP_ERR_NOT_ALLOWED) {
+        return httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Needs the token");
+    }
+    if (err != ESP_OK) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "1");
+        return httpd_resp_sendstr(req, "Busy");
+    }
+    httpd_resp_set_status(req, "202 Accepted");
+    return httpd_resp_send(req, NULL, 0);
+}
+
+static esp_err_t ws_handler(httpd_req_t *req) {
+    // The handshake: the client starts from the whole state. Browsers do not
+    // hold WebSockets to their origin, so one from elsewhere is closed here.
+    if (req->method == HTTP_GET) {
+        if (!request_allowed(req)) {
+            return ESP_FAIL;
+        }
+        ws_send(httpd_req_to_sockfd(req), SECTION_ALL);
+        return ESP_OK;
+    }
+
+    httpd_ws_frame_t frame = { 0 };
+    if (httpd_ws_recv_frame(req, &frame, 0) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (frame.type != HTTPD_WS_TYPE_TEXT || frame.len > CONTROL_API_MAX_BODY) {
+        return frame.type == HTTPD_WS_TYPE_TEXT ? ESP_FAIL : ESP_OK;
+    }
+    char text[CONTROL_API_MAX_BODY + 1];
+    frame.payload = (uint8_t *)text;
+    if (httpd_ws_recv_frame(req, &frame, frame.len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    text[frame.len] = '\0';
+
+    mem_tag_scope_t scope = mem_tag_enter(MEM_TAG_CONTROL, NULL);
+    cJSON *json = cJSON_Parse(text);
+    const cJSON *cmd = cJSON_GetObjectItem(json, "cmd");
+    const char *token = cJSON_GetStringValue(cJSON_GetObjectItem(json, "token"));
+    esp_err_t err = cJSON_IsString(cmd) ? post_command(cmd->valuestring, json, token) : ESP_ERR_NOT_FOUND;
+    cJSON_Delete(json);
+    mem_tag_leave(scope);
+    if (err == ESP_OK) {
+        return ESP_OK;
+    }
+
+    const char *error = err == ESP_ERR_NOT_FOUND   ? "{\"error\":\"unknown command\"}"
+                        : err == ESP_ERR_NOT_ALLOWED ? "{\"error\":\"forbidden\"}"
+                                                     : "{\"error\":\"busy\"}";
+    httpd_ws_frame_t reply = {
+        .final = true,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)error,
+        .len = strlen(error),
+    };
+    return httpd_ws_send_frame(req, &reply);
+}
+
+static void advertise(void) {
+    char hostname[64];
+    if (mdns_hostname_get(hostname) != ESP_OK) {
+        mdns_hostname_set(CONTROL_API_MDNS_HOSTNAME);
+    }
+    mdns_txt_item_t txt[] = {
+        { "api", "1" },
+        { "ws", CONTROL_API_PREFIX "ws" },
+    };
+    esp_err_t err = mdns_service_add("ESPCaster", "_espcaster", "_tcp", CONFIG_CONTROL_API_PORT,
+                                     txt, sizeof(txt) / sizeof(txt[0]));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Not advertised over mDNS: %s", esp_err_to_name(err));
+    }
+}
+
+bool control_api_start(chromecast_discovery_handle_t discovery) {
+    if (s_server) {
+        return true;
+    }
+    s_lock = s_lock ? s_lock : xSemaphoreCreateMutex();
+    if (!s_lock) {
+        return false;
+    }
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = CONFIG_CONTROL_API_PORT;
+    config.ctrl_port = CONFIG_CONTROL_API_PORT + 1;    // Apart from the Spotify callback server's
+    config.max_open_sockets = CONTROL_API_CLIENTS;
+    config.lru_purge_enable = true;
+    config.send_wait_timeout = 2;                       // A stalled client must not hold up the rest
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    config.stack_size = 4096;
+#if CONFIG_MEM_TASK_PSRAM_STACKS
+    // Handlers only parse and queue for the LVGL thread, never touch flash
+    config.task_caps = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+#endif
+    if (httpd_start(&s_server, &config) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the control API on port %d", CONFIG_CONTROL_API_PORT);
+        s_server = NULL;
+        return false;
+    }
+
+    const httpd_uri_t uris[] = {
+        { .uri = CONTROL_API_PREFIX "state", .method = HTTP_GET, .handler = state_get_handler },
+        { .uri = CONTROL_API_PREFIX "latency", .method = HTTP_GET, .handler = latency_get_handler },
+        { .uri = CONTROL_API_PREFIX "ws", .method = HTTP_GET, .handler = ws_handler, .is_websocket = true },
+        { .uri = CONTROL_API_PREFIX "*", .method = HTTP_POST, .handler = command_post_handler },
+    };
+    for (size_t i = 0; i < sizeof(uris) / sizeof(uris[0]); i++) {
+        httpd_register_uri_handler(s_server, &uris[i]);
+    }
+
+    // Sections start from what the GUI has now
+    s_discovery = discovery;
+    control_api_set_cast_status(NULL, false);
+    control_api_cast_devices_changed();
+    now_playing_store_listen(NOW_PLAYING_TRACK | NOW_PLAYING_ARTIST | NOW_PLAYING_PROGRESS | NOW_PLAYING_VOLUME |
+                             NOW_PLAYING_PLAYING | NOW_PLAYING_DEVICE, now_playing_changed);
+
+    advertise();
+    ESP_LOGI(TAG, "Control API on port %d", CONFIG_CONTROL_API_PORT);
+    return true;
+}
+#else
+bool control_api_start(chromecast_discovery_handle_t discovery) {
+    return false;
+}
+
+void control_api_set_cast_status(const char *device, bool connected) {
+}
+
+void control_api_cast_devices_changed(void) {
+}
+
+void control_api_set_spotify_devices(const spotify_device_view_t *devices, size_t count) {
+}
+#endif
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "chromecast_discovery_wrapper.h"
+#include "spotify_controller_wrapper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Control API - the player over REST and WebSocket, for home automation
+ *
+ * An HTTP server on CONTROL_API_PORT, advertised as _espcaster._tcp over
+ * the mDNS responder discovery started:
+ *
+ * - GET /api/state: the whole state as one JSON object
+ * - GET /api/ws: a WebSocket. The whole state is sent on connect, then
+ *   only the sections that changed, as an object with just those keys, so
+ *   a client merges messages into what it has instead of polling
+ * - POST /api/<command> with an optional JSON body, or a WebSocket text
+ *   frame {"cmd":"<command>", ...}:
+ *     cast/volume        {"level":0.0-1.0, "muted":bool}, either optional
+ *     spotify/play       {"uri":"spotify:..."} optional
+ *     spotify/pause, spotify/next, spotify/previous
+ *     spotify/devices    refresh the Spotify Connect device list
+ *     ota                {"url":"https://..."} an update package, only
+ *                        from under OTA_URL_PREFIX (see OTA_Update.h) and
+ *                        with CONTROL_API_OTA_TOKEN in the X-ESPCaster-Token
+ *                        header or the frame's "token"
+ *   answered 202 once queued; the effect arrives as a state change
+ *
+ * A POST must be Content-Type: application/json. Every request must name
+ * this device in Host, as an IP address or <mDNS hostname>.local, and in
+ * Origin if it has one; anything else is refused with 403 (or the
+ * WebSocket closed), so a web page the user opens cannot reach the API.
+ *
+ * State sections: "playback" (track, artist, image_url, device,
+ * duration_ms, progress_ms, playing), "volume" (the Cast device's percent
+ * and muted), "cast" (connected, device), "cast_devices" and
+ * "spotify_devices" (arrays). progress_ms is the position when the
+ * message was built; while playing a client counts on from there.
+ *
+ * Commands run on the LVGL thread beside the touch controls, queued on the
+ * GUI event bus, which wakes it at once; nothing waits for a GUI frame.
+ * The control_api_set_* hooks are called on the LVGL thread too.
+ *
+ * Nothing is served unless CONTROL_API is enabled.
+ */
+
+#define CONTROL_API_MAX_BODY        512
+#define CONTROL_API_MAX_DEVICES     16          // Per list
+#define CONTROL_API_CLIENTS         3           // Sockets, WebSockets and REST together
+
+/**
+ * @brief Start the server and advertise it; after discovery has started mDNS
+ *
+ * @param discovery Where the Cast device list is read from
+ * @return false if disabled or it could not start
+ */
+bool control_api_start(chromecast_discovery_handle_t discovery);
+
+/**
+ * @brief The Cast connection changed (device is NULL when disconnected)
+ */
+void control_api_set_cast_status(const char *device, bool connected);
+
+/**
+ * @brief The discovered Cast device table changed
+ */
+void control_api_cast_devices_changed(void);
+
+/**
+ * @brief A new Spotify Connect device list arrived
+ */
+void control_api_set_spotify_devices(const spotify_device_view_t *devices, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
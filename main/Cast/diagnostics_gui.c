@@ -0,0 +1,186 @@
+#include "diagnostics_gui.h"
+#include <stdio.h>
+#include "esp_log.h"
+#include "telemetry.h"
+#include "LVGL_Driver.h"
+
+static const char *TAG = "diagnostics_gui";
+
+#define DIAG_REFRESH_MS     TELEMETRY_PERIOD_MS
+#define DIAG_TEXT_SIZE      3072
+
+static lv_obj_t *tabview;
+static lv_obj_t *text_label;
+static uint16_t tab_id;
+static uint16_t previous_tab;
+static bool tab_shown;
+
+static bool diagnostics_active(void) {
+    return tab_shown && lv_tabview_get_tab_act(tabview) == tab_id;
+}
+
+static void set_tab_shown(bool shown) {
+    lv_obj_t *buttons = lv_tabview_get_tab_btns(tabview);
+    tab_shown = shown;
+    if (shown) {
+        lv_btnmatrix_clear_btn_ctrl(buttons, tab_id, LV_BTNMATRIX_CTRL_HIDDEN);
+    } else {
+        lv_btnmatrix_set_btn_ctrl(buttons, tab_id, LV_BTNMATRIX_CTRL_HIDDEN);
+        if (lv_tabview_get_tab_act(tabview) == tab_id) {
+            lv_tabview_set_act(tabview, previous_tab, LV_ANIM_OFF);
+        }
+    }
+    ESP_LOGI(TAG, "Diagnostics tab %s", shown ? "shown" : "hidden");
+}
+
+// Average of a window's values, 0 if there were none
+static uint32_t counter_average(const telemetry_counter_t *c) {
+    return c->count ? c->sum / c->count : 0;
+}
+
+static void refresh_text(void) {
+    static char text[DIAG_TEXT_SIZE];
+    static telemetry_task_t tasks[TELEMETRY_MAX_TASKS];
+    int len = 0;
+
+    telemetry_sample_t s;
+    if (telemetry_get_samples(&s, 1) == 1) {
+        const telemetry_counter_t *m = s.metrics;
+        len += snprintf(text + len, sizeof(text) - len,
+                        "Up %lus\n"
+                        "Internal %lu free, %lu min, %lu block\n"
+                        "PSRAM %lu free, %lu block\n"
+                        "LVGL heap %lu used, %lu block\n"
+                        "LVGL %u fps, %lu ms avg, %u max\n"
+                        "Cast RTT %lu ms avg, %u max (%u)\n"
+                        "Cast rx %lu us avg, %u max\n"
+                        "TLS %lu ms avg (%u)  HTTP %lu ms avg, %u max (%u)\n"
+                        "Underruns %u  Sync %lu us avg, %u max  UI stalls %u\n"
+                        "Decode %lu us avg, %u max  Audio depth %u ms\n\n",
+                        (unsigned long)(s.uptime_ms / 1000),
+                        (unsigned long)s.internal_free, (unsigned long)s.internal_min,
+                        (unsigned long)s.internal_largest,
+                        (unsigned long)s.psram_free, (unsigned long)s.psram_largest,
+                        (unsigned long)s.lvgl_used, (unsigned long)s.lvgl_largest,
+                        m[TELEMETRY_LVGL_FRAME].count, (unsigned long)counter_average(&m[TELEMETRY_LVGL_FRAME]),
+                        m[TELEMETRY_LVGL_FRAME].max,
+                        (unsigned long)counter_average(&m[TELEMETRY_CAST_RTT]), m[TELEMETRY_CAST_RTT].max,
+                        m[TELEMETRY_CAST_RTT].count,
+                        (unsigned long)counter_average(&m[TELEMETRY_CAST_RX_LATENCY]), m[TELEMETRY_CAST_RX_LATENCY].max,
+                        (unsigned long)counter_average(&m[TELEMETRY_TLS_HANDSHAKE]), m[TELEMETRY_TLS_HANDSHAKE].count,
+                        (unsigned long)counter_average(&m[TELEMETRY_HTTP_LATENCY]), m[TELEMETRY_HTTP_LATENCY].max,
+                        m[TELEMETRY_HTTP_LATENCY].count,
+                        m[TELEMETRY_AUDIO_UNDERRUN].count,
+                        (unsigned long)counter_average(&m[TELEMETRY_SYNC_ERROR]), m[TELEMETRY_SYNC_ERROR].max,
+                        m[TELEMETRY_UI_STALL].count,
+                        (unsigned long)counter_average(&m[TELEMETRY_AUDIO_DECODE]), m[TELEMETRY_AUDIO_DECODE].max,
+                        m[TELEMETRY_AUDIO_DEPTH].max);
+    }
+
+    telemetry_ui_stall_t stall;
+    if (telemetry_get_ui_stalls(&stall, 1) == 1) {
+        len += snprintf(text + len, sizeof(text) - len,
+                        "Last UI stall %lu ms at %lus: %p%s%s (%lu since boot)\n\n",
+                        (unsigned long)(stall.duration_us / 1000), (unsigned long)(stall.uptime_ms / 1000),
+                        (void *)(uintptr_t)stall.callback, stall.api[0] ? " in " : "", stall.api,
+                        (unsigned long)telemetry_ui_stall_total());
+    }
+
+    telemetry_boot_t boot[TELEMETRY_BOOT_PHASE_COUNT];
+    telemetry_get_boot(boot);
+    len += snprintf(text + len, sizeof(text) - len,
+                    "Boot %lu ms to UI: display %lu, network %lu, spotify %lu, gui %lu\n\n",
+                    (unsigned long)boot[TELEMETRY_BOOT_INTERACTIVE].duration_ms,
+                    (unsigned long)boot[TELEMETRY_BOOT_DISPLAY].duration_ms,
+                    (unsigned long)boot[TELEMETRY_BOOT_NETWORK].duration_ms,
+                    (unsigned long)boot[TELEMETRY_BOOT_SPOTIFY].duration_ms,
+                    (unsigned long)boot[TELEMETRY_BOOT_GUI].duration_ms);
+
+    telemetry_storage_t sd;
+    telemetry_get_storage(&sd);
+    if (sd.freq_khz) {
+        len += snprintf(text + len, sizeof(text) - len,
+                        "SD %u-bit %u kHz: read %lu KB/s (%u ms max), write %lu KB/s (%u ms max)\n\n",
+                        sd.bus_width, sd.freq_khz, (unsigned long)sd.read_kbps, sd.read_max_ms,
+                        (unsigned long)sd.write_kbps, sd.write_max_ms);
+    }
+
+    // Since boot: every Cast request type and Spotify endpoint together, then each
+    static telemetry_hist_summary_t hists[2 + CONFIG_TELEMETRY_HIST_SLOTS];
+    size_t hist_count = 0;
+    hist_count += telemetry_hist_summarize("cast ", &hists[hist_count]);
+    hist_count += telemetry_hist_summarize("http ", &hists[hist_count]);
+    hist_count += telemetry_hist_list(&hists[hist_count], CONFIG_TELEMETRY_HIST_SLOTS);
+    if (hist_count && len < (int)sizeof(text)) {
+        len += snprintf(text + len, sizeof(text) - len, "%-20s %5s %5s %5s %5s\n", "Latency", "n", "p50", "p95", "p99");
+    }
+    for (size_t i = 0; i < hist_count && len < (int)sizeof(text); i++) {
+        const telemetry_hist_summary_t *h = &hists[i];
+        len += snprintf(text + len, sizeof(text) - len, "%-20.20s %5lu %5lu %5lu %5lu %s\n",
+                        h->name, (unsigned long)h->count, (unsigned long)h->p50, (unsigned long)h->p95,
+                        (unsigned long)h->p99, h->unit == TELEMETRY_HIST_US ? "us" : "ms");
+    }
+    if (hist_count && len < (int)sizeof(text)) {
+        len += snprintf(text + len, sizeof(text) - len, "\n");
+    }
+
+    size_t task_count = telemetry_get_tasks(tasks, TELEMETRY_MAX_TASKS);
+    for (size_t i = 0; i < task_count && len < (int)sizeof(text); i++) {
+        const telemetry_task_t *t = &tasks[i];
+        len += snprintf(text + len, sizeof(text) - len, "%-15.15s %3u%% %5lu B p%u c%d\n",
+                        t->name, t->cpu_percent, (unsigned long)t->stack_free, t->priority, t->core);
+    }
+    lv_label_set_text_static(text_label, text);
+}
+
+static void refresh_timer_cb(lv_timer_t *timer) {
+    if (diagnostics_active() && !LVGL_Timer_Defer(timer)) {
+        refresh_text();
+    }
+}
+
+static void tab_bar_long_press_cb(lv_event_t *e) {
+    set_tab_shown(!tab_shown);
+}
+
+// Swiping the content can still reach the tab while its button is hidden
+static void tab_changed_cb(lv_event_t *e) {
+    uint16_t active = lv_tabview_get_tab_act(tabview);
+    if (active == tab_id && !tab_shown) {
+        lv_tabview_set_act(tabview, previous_tab, LV_ANIM_OFF);
+        return;
+    }
+    if (active != tab_id) {
+        previous_tab = active;
+    } else {
+        refresh_text();
+    }
+}
+
+static void dump_button_cb(lv_event_t *e) {
+    telemetry_dump_console();
+}
+
+void diagnostics_gui_init(lv_obj_t *tv) {
+    tabview = tv;
+    lv_obj_t *tab = lv_tabview_add_tab(tabview, "Diag");
+    tab_id = lv_obj_get_child_cnt(lv_tabview_get_content(tabview)) - 1;
+
+    lv_obj_set_flex_flow(tab, LV_FLEX_FLOW_COLUMN);
+
+    lv_obj_t *dump_button = lv_btn_create(tab);
+    lv_obj_t *dump_label = lv_label_create(dump_button);
+    lv_label_set_text(dump_label, "Dump");
+    lv_obj_add_event_cb(dump_button, dump_button_cb, LV_EVENT_CLICKED, NULL);
+
+    text_label = lv_label_create(tab);
+    lv_obj_set_width(text_label, lv_pct(100));
+    lv_obj_set_style_text_font(text_label, &lv_font_montserrat_14, 0);
+    lv_label_set_text_static(text_label, "");
+
+    lv_obj_add_event_cb(lv_tabview_get_tab_btns(tabview), tab_bar_long_press_cb, LV_EVENT_LONG_PRESSED, NULL);
+    lv_obj_add_event_cb(tabview, tab_changed_cb, LV_EVENT_VALUE_CHANGED, NULL);
+    lv_timer_create(refresh_timer_cb, DIAG_REFRESH_MS, NULL);
+
+    set_tab_shown(false);
+}
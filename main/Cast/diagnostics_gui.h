@@ -0,0 +1,28 @@
+#pragma once
+
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Diagnostics tab - live telemetry, hidden until asked for
+ *
+ * Adds a "Diag" tab at the end of the tabview with its button hidden. A
+ * long press on the tab bar shows or hides it. While it is the active tab
+ * it shows the last telemetry window once a second: heap, LVGL FPS and
+ * frame time, Cast RTT, TLS handshake and HTTP latency, audio underruns
+ * and the task table. "Dump" prints the binary dump on the console.
+ *
+ * LVGL thread only.
+ */
+
+/**
+ * @brief Add the hidden tab; after the other tabs are added
+ */
+void diagnostics_gui_init(lv_obj_t *tabview);
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,20 +8,50 @@
 #include "spotify_controller_wrapper.h"
 #include "spotify_gui_manager.h"
 #include "spotify_config_manager.h"
+#include "config_store.h"
+#include "voice_actions.h"
+#include "voice_vocabulary.h"
+#include "gui_event_bus.h"
+#include "diagnostics_gui.h"
+#include "ui_lazy_tab.h"
+#include "ui_fonts.h"
+#include "telemetry_http.h"
+#include "media_server.h"
+#include "Snapcast_Client.h"
+#include "control_api.h"
+#include "ble_control.h"
+#include "soak_test.h"
+#include "Display_SPD2010.h"
+#include "Touch_Gesture.h"
+#include "Power_Manager.h"
+#include "Power_Suspend.h"
+#include "spotify_library_snapshot.h"
+#include "chromecast_controller_wrapper.h"
+#include <stdlib.h>
 #include <string.h>
 
 #include "freertos/FreeRTOS.h"
 #include <stdio.h>
 #include "esp_system.h"
-#include "esp_bt.h"
-#include "esp_gap_ble_api.h"
-#include "esp_bt_main.h"
+#include "esp_attr.h"
+
+// Cast TLS sessions kept through a suspend: a couple of sessions with their
+// peer certificates, the most recently used first
+#define ESP_CAST_RESUME_TLS_BYTES   3072
 
 // Global variables
 static const char *TAG = "esp_cast";
 static chromecast_discovery_handle_t discovery_handle = NULL;
 static spotify_controller_handle_t spotify_handle = NULL;
 static lv_obj_t *main_tabview = NULL;
+static uint16_t spotify_tab_id;
+static uint16_t chromecast_tab_id;
+static volatile bool chromecast_tab_active;     // Written on the LVGL thread
+
+// Kept in RTC memory through a suspend, read only when Power_Resumed()
+static RTC_DATA_ATTR uint16_t resume_tab;
+static RTC_DATA_ATTR uint16_t resume_tls_length;
+static RTC_DATA_ATTR uint8_t resume_tls[ESP_CAST_RESUME_TLS_BYTES];
 
 // Function prototypes
 static void chromecast_discovery_callback(const chromecast_device_info_t* devices, size_t device_count);
@@ -29,6 +59,12 @@ static void chromecast_device_found_callback(const chromecast_device_info_t* dev
 void esp_cast_wifi_init_sta(void) {
     ESP_LOGI(TAG, "Initializing WiFi via WiFi Manager");
 
+    // Before Wi-Fi is up, so the standby connect to the last device resumes its session
+    if (Power_Resumed() && resume_tls_length > 0) {
+        size_t sessions = chromecast_controller_import_sessions(resume_tls, resume_tls_length);
+        ESP_LOGI(TAG, "%u Cast TLS sessions kept through suspend", (unsigned)sessions);
+    }
+
     // Initialize WiFi GUI Manager (which also initializes WiFi Manager)
     wifi_gui_config_t config = {
         .parent = NULL,  // Will be set in GUI init
@@ -44,6 +80,12 @@ void esp_cast_wifi_init_sta(void) {
 
     ESP_LOGI(TAG, "WiFi GUI Manager initialized successfully");
 
+    // Only starts anything with TELEMETRY_HTTP; needs the netif the WiFi Manager brought up
+    telemetry_http_start();
+
+    // SD card tracks for Chromecasts to fetch (long press in the music list)
+    media_server_start();
+
     // Initialize ChromecastDiscovery
     discovery_handle = chromecast_discovery_create();
     if (!discovery_handle) {
@@ -68,12 +110,48 @@ void esp_cast_wifi_init_sta(void) {
     }
 
     ESP_LOGI(TAG, "ChromecastDiscovery initialized successfully");
+
+    // Only with SNAPCAST_CLIENT; after discovery, which brought mDNS up for finding the server
+    Snapcast_Client_Start();
 }
 
 static void chromecast_discovery_callback_gui(const chromecast_device_info_t* devices, size_t device_count);
+static void chromecast_device_event_callback_gui(chromecast_device_event_t event, const chromecast_device_info_t* device);
+static void touch_gesture_callback_gui(const touch_gesture_t *gesture);
+static void tab_changed_cb(lv_event_t *e);
+
+// Each tab's widgets are built when it is first shown, and dropped again
+// when the LVGL pool runs low while it is hidden
+static const ui_lazy_tab_ops_t wifi_tab_ops = {
+    .build = wifi_gui_create_interface,
+    .unload = wifi_gui_unload_interface,
+};
+static const ui_lazy_tab_ops_t chromecast_tab_ops = {
+    .build = chromecast_gui_create_interface,
+    .unload = chromecast_gui_unload_interface,
+};
+static const ui_lazy_tab_ops_t spotify_tab_ops = {
+    .build = spotify_gui_create_interface,
+    .unload = spotify_gui_unload_interface,
+};
+
+// The suspend hook: what RTC memory keeps, and what flash would only have
+// had once the config store and snapshot timers ran out
+static void suspend_hook(void) {
+    resume_tab = main_tabview ? lv_tabview_get_tab_act(main_tabview) : 0;
+    resume_tls_length = chromecast_controller_export_sessions(resume_tls, sizeof(resume_tls));
+    spotify_snapshot_flush();
+    config_store_flush();
+}
+
+// Flash writes stall both cores' caches, so the config store waits for a
+// pause in touch input. Reads the one timestamp LVGL keeps for it
+static bool config_flush_gate(void) {
+    return lv_disp_get_inactive_time(NULL) >= CONFIG_STORE_QUIET_MS;
+}
 
 // Auto-initialize Spotify from stored configuration
-static void esp_cast_auto_init_spotify(void) {
+void esp_cast_spotify_auto_init(void) {
     ESP_LOGI(TAG, "Checking for stored Spotify configuration");
 
     // Initialize config manager
@@ -116,22 +194,24 @@ static void esp_cast_auto_init_spotify(void) {
 void esp_cast_gui_init(void) {
     ESP_LOGI(TAG, "Initializing ESP Cast GUI");
 
-    // Auto-initialize Spotify from stored configuration
-    esp_cast_auto_init_spotify();
+    // Montserrat with the TrueType fallback, for every widget below
+    ui_fonts_init();
 
     // Create main tabview
     main_tabview = lv_tabview_create(lv_scr_act(), LV_DIR_TOP, 45);
+    ui_lazy_tab_init(main_tabview);
 
     // Create WiFi tab
     lv_obj_t *wifi_tab = lv_tabview_add_tab(main_tabview, "WiFi");
-    wifi_gui_create_interface(wifi_tab);
+    ui_lazy_tab_add(wifi_tab, &wifi_tab_ops);
 
     // Create Chromecast tab
     lv_obj_t *chromecast_tab = lv_tabview_add_tab(main_tabview, "Chromecast");
+    chromecast_tab_id = lv_obj_get_child_cnt(lv_tabview_get_content(main_tabview)) - 1;
 
-    // Initialize Chromecast GUI manager
+    // Initialize Chromecast GUI manager; the interface is built with the tab
     chromecast_gui_config_t chromecast_config = {
-        .parent = chromecast_tab,
+        .parent = NULL,
         .discovery = discovery_handle,
         .show_status_bar = true,
         .show_scan_button = true
@@ -143,14 +223,25 @@ void esp_cast_gui_init(void) {
         return;
     }
 
-    // Create Chromecast interface
-    chromecast_gui_create_interface(chromecast_tab);
+    ui_lazy_tab_add(chromecast_tab, &chromecast_tab_ops);
 
-    // Set up discovery callback to update GUI
+    // Set up discovery callbacks to update GUI
     chromecast_discovery_set_callback(discovery_handle, chromecast_discovery_callback_gui);
+    chromecast_discovery_set_device_event_callback(discovery_handle, chromecast_device_event_callback_gui);
+
+    // Gestures are recognized on the touch task and handled by the GUI managers
+    Touch_Gesture_Set_Callback(touch_gesture_callback_gui);
+    config_store_set_gate(config_flush_gate);
+
+    // Speakers show up as they announce; the scan button still forces a sweep
+    if (!chromecast_discovery_start_browse(discovery_handle)) {
+        ESP_LOGW(TAG, "Continuous browse unavailable, relying on manual scans");
+    }
 
     // Create Spotify tab
     lv_obj_t *spotify_tab = lv_tabview_add_tab(main_tabview, "Spotify");
+    spotify_tab_id = lv_obj_get_child_cnt(lv_tabview_get_content(main_tabview)) - 1;
+    lv_obj_add_event_cb(main_tabview, tab_changed_cb, LV_EVENT_VALUE_CHANGED, NULL);
 
     // Always initialize Spotify GUI manager
     spotify_gui_config_t spotify_config = {
@@ -169,13 +260,15 @@ void esp_cast_gui_init(void) {
         lv_label_set_text(placeholder, "Spotify GUI initialization failed.");
         lv_obj_center(placeholder);
     } else {
-        // Create Spotify interface
-        spotify_gui_create_interface(spotify_tab);
+        ui_lazy_tab_add(spotify_tab, &spotify_tab_ops);
 
-        // Show appropriate screen based on configuration status
+        // The screen the tab opens on, based on configuration status
         if (spotify_handle) {
-            // Spotify is initialized, show auth screen
-            spotify_gui_show_auth_screen();
+            // Spotify is initialized: last session's library if there is
+            // one, else the auth screen
+            if (!spotify_gui_show_snapshot()) {
+                spotify_gui_show_auth_screen();
+            }
             ESP_LOGI(TAG, "Spotify GUI initialized with controller");
         } else if (spotify_config_is_configured()) {
             // Configuration exists but initialization failed, show config screen for editing
@@ -188,23 +281,71 @@ void esp_cast_gui_init(void) {
         }
     }
 
+    // Hidden until a long press on the tab bar
+    diagnostics_gui_init(main_tabview);
+
+    // Back on the tab the suspend left, without the slide
+    if (Power_Resumed() && resume_tab < lv_obj_get_child_cnt(lv_tabview_get_content(main_tabview))) {
+        lv_tabview_set_act(main_tabview, resume_tab, LV_ANIM_OFF);
+        lv_event_send(main_tabview, LV_EVENT_VALUE_CHANGED, NULL);
+    }
+    ui_lazy_tab_start();
+    Power_Suspend_Add_Hook(suspend_hook);
+
+    // Spoken commands drive the same controllers as the tabs, and can name
+    // the playlists and speakers on them
+    voice_actions_init();
+    voice_vocabulary_init(discovery_handle);
+
+    // And so do home automation hubs, over REST and WebSocket
+    control_api_start(discovery_handle);
+    // And a phone or remote over BLE, without keeping Wi-Fi awake for it
+    ble_control_start();
+
+    // A scripted run of the above for hours, only in a soak test build
+    soak_test_start(discovery_handle);
+
     ESP_LOGI(TAG, "ESP Cast GUI initialized with WiFi, Chromecast, and Spotify tabs");
 }
 
+// Discovery callbacks run on the discovery task: the widgets are updated
+// from the event bus on the LVGL thread
+typedef struct {
+    chromecast_device_event_t event;
+    chromecast_device_info_t device;
+} device_event_call_t;
+
+static void discovery_done_call(void *arg) {
+    size_t device_count = (size_t)(uintptr_t)arg;
+
+    // The device list itself is kept current by chromecast_device_event_callback_gui
+    chromecast_gui_set_scanning(false, device_count);
+}
+
+static void device_event_call(void *arg) {
+    device_event_call_t *call = (device_event_call_t *)arg;
+    chromecast_gui_apply_device_event(call->event, &call->device);
+    control_api_cast_devices_changed();
+    voice_vocabulary_cast_devices_changed();
+    free(call);
+}
+
+// Opening the Spotify tab usually means a command follows: resolve and
+// connect now, on the worker, rather than when it is tapped
+static void tab_changed_cb(lv_event_t *e) {
+    uint16_t active = lv_tabview_get_tab_act(main_tabview);
+    if (spotify_handle && active == spotify_tab_id) {
+        spotify_controller_prewarm(spotify_handle);
+    }
+    chromecast_tab_active = active == chromecast_tab_id;
+}
+
+// Discovery calls these on its own tasks; the GUI side runs from the event bus
 static void chromecast_discovery_callback_gui(const chromecast_device_info_t* devices, size_t device_count) {
     ESP_LOGI(TAG, "Discovery completed, found %d Chromecast devices", device_count);
 
-    // Update the GUI with discovered devices
-    chromecast_gui_show_devices(devices, device_count);
-
-    // Update status based on results
-    if (device_count == 0) {
-        chromecast_gui_update_status("No devices", "No Chromecast devices found", false);
-    } else {
-        char status_text[64];
-        snprintf(status_text, sizeof(status_text), "Found %d device%s",
-                 device_count, device_count == 1 ? "" : "s");
-        chromecast_gui_update_status("Ready", status_text, false);
+    if (!gui_event_bus_post_call(discovery_done_call, (void *)(uintptr_t)device_count)) {
+        ESP_LOGW(TAG, "Dropped discovery status event");
     }
 
     for (size_t i = 0; i < device_count; i++) {
@@ -215,9 +356,40 @@ static void chromecast_discovery_callback_gui(const chromecast_device_info_t* de
     }
 }
 
+static void chromecast_device_event_callback_gui(chromecast_device_event_t event, const chromecast_device_info_t* device) {
+    static const char* const event_names[] = { "added", "updated", "removed" };
+    ESP_LOGI(TAG, "Chromecast %s: %s (%s)", event_names[event], device->name, device->ip_address);
+
+    device_event_call_t *call = malloc(sizeof(*call));
+    if (!call) {
+        ESP_LOGE(TAG, "Out of memory posting device event");
+        return;
+    }
+    call->event = event;
+    call->device = *device;
+    if (!gui_event_bus_post_call(device_event_call, call)) {
+        ESP_LOGW(TAG, "Dropped device event for %s", device->name);
+        free(call);
+    }
+}
+
 // WiFi GUI functions are now handled by wifi_gui_manager
 // These functions are kept for backward compatibility but delegate to the new manager
 
+static void touch_gesture_callback_gui(const touch_gesture_t *gesture) {
+    gui_event_t event = {
+        .type = GUI_EVENT_TOUCH_GESTURE,
+        .data.gesture = {
+            .type = (uint8_t)gesture->type,
+            .direction = (uint8_t)gesture->direction,
+            .velocity_x = gesture->velocity_x,
+            .velocity_y = gesture->velocity_y,
+            .value = gesture->value,
+        },
+    };
+    gui_event_bus_post(&event);
+}
+
 void esp_cast_show_wifi_list(wifi_ap_record_t *aps, uint16_t ap_num) {
     // This function is now handled by wifi_gui_manager callbacks
     ESP_LOGI(TAG, "esp_cast_show_wifi_list called - delegating to wifi_gui_manager");
@@ -243,9 +415,26 @@ static void chromecast_device_found_callback(const chromecast_device_info_t* dev
     }
 }
 
+// Discovery sweeps fast while the device list is on screen and not at all
+// with the screen off
+static void update_discovery_interest(void) {
+    static chromecast_discovery_interest_t current = CHROMECAST_DISCOVERY_BACKGROUND;
+
+    chromecast_discovery_interest_t interest = CHROMECAST_DISCOVERY_BACKGROUND;
+    if (LCD_Backlight == 0 || Power_Get_Profile() >= POWER_PROFILE_IDLE) {
+        interest = CHROMECAST_DISCOVERY_IDLE;
+    } else if (chromecast_tab_active) {
+        interest = CHROMECAST_DISCOVERY_VISIBLE;
+    }
+    if (discovery_handle && interest != current) {
+        chromecast_discovery_set_interest(discovery_handle, interest);
+        current = interest;
+    }
+}
+
 void esp_cast_loop(void) {
-    // The new ChromecastDiscovery handles everything internally via callbacks
-    // No polling needed in the main loop
+    // ChromecastDiscovery reports through callbacks; it is only told what is on screen
+    update_discovery_interest();
 
     // Run Spotify periodic tasks
     esp_cast_spotify_run_tasks();
@@ -298,20 +487,21 @@ bool esp_cast_spotify_init(const char* client_id, const char* client_secret, con
 
     ESP_LOGI(TAG, "Initializing Spotify controller");
 
-    // Create Spotify controller
-    spotify_handle = spotify_controller_create();
-    if (!spotify_handle) {
+    // Create Spotify controller; only published once initialized, since
+    // the cast task starts polling it as soon as spotify_handle is set
+    spotify_controller_handle_t handle = spotify_controller_create();
+    if (!handle) {
         ESP_LOGE(TAG, "Failed to create Spotify controller");
         return false;
     }
 
     // Initialize controller
-    if (!spotify_controller_initialize(spotify_handle, client_id, client_secret, redirect_uri)) {
+    if (!spotify_controller_initialize(handle, client_id, client_secret, redirect_uri)) {
         ESP_LOGE(TAG, "Failed to initialize Spotify controller");
-        spotify_controller_destroy(spotify_handle);
-        spotify_handle = NULL;
+        spotify_controller_destroy(handle);
         return false;
     }
+    spotify_handle = handle;
 
     ESP_LOGI(TAG, "Spotify controller initialized successfully");
     return true;
@@ -322,7 +512,17 @@ spotify_controller_handle_t esp_cast_get_spotify_controller(void) {
 }
 
 void esp_cast_spotify_run_tasks(void) {
+    static bool display_active = true;
+
     if (spotify_handle) {
+        // Backlight 0 means the screen is off (sleep or dimmed by voice control),
+        // as does the idle power profile, which switches the panel light off
+        bool backlight_on = LCD_Backlight > 0 && Power_Get_Profile() < POWER_PROFILE_IDLE;
+        if (backlight_on != display_active &&
+            spotify_controller_set_display_active(spotify_handle, backlight_on)) {
+            display_active = backlight_on;
+        }
+
         spotify_controller_run_periodic_tasks(spotify_handle);
     }
 }
@@ -335,44 +535,26 @@ bool esp_cast_spotify_to_chromecast(const char* device_name, const char* track_u
 
     ESP_LOGI(TAG, "Attempting to cast Spotify track to Chromecast device: %s", device_name);
 
-    // Get the list of discovered Chromecast devices
-    chromecast_device_info_t devices[10];
-    size_t device_count = 0;
-
-    // Note: In a real implementation, you would need to store the discovered devices
-    // from the discovery callback. For now, we'll simulate this.
-
-    // Find the device by name
-    bool device_found = false;
-    char target_ip[16] = {0};
-
-    // This is a simplified approach - in practice, you'd maintain a list of discovered devices
-    ESP_LOGI(TAG, "Looking for Chromecast device: %s", device_name);
-
-    // For demonstration, we'll assume the device is found and use a placeholder IP
-    // In a real implementation, you would:
-    // 1. Query the discovery component for current devices
-    // 2. Match by device name
-    // 3. Get the IP address
-
-    if (strstr(device_name, "Chromecast") != NULL) {
-        device_found = true;
-        strncpy(target_ip, "192.168.1.100", sizeof(target_ip) - 1); // Placeholder IP
-        ESP_LOGI(TAG, "Found device %s at IP %s (simulated)", device_name, target_ip);
-    }
-
-    if (!device_found) {
+    // Indexed lookup by name, UUID or IP in the discovery device table
+    chromecast_device_info_t device;
+    if (!chromecast_discovery_find_device(discovery_handle, device_name, &device)) {
         ESP_LOGE(TAG, "Chromecast device not found: %s", device_name);
         return false;
     }
+    if (device.protocol != CHROMECAST_PROTOCOL_CAST) {
+        ESP_LOGE(TAG, "%s is a DLNA renderer, not a Cast device", device_name);
+        return false;
+    }
+    ESP_LOGI(TAG, "Found device %s at %s:%d", device.name, device.ip_address, device.port);
 
-    // Cast to the Chromecast device
-    bool result = spotify_controller_cast_to_chromecast(spotify_handle, target_ip, track_uri);
+    // The receiver on the device streams from Spotify; we only hand it the session
+    bool result = spotify_controller_cast_to_chromecast(spotify_handle, device.ip_address, device.port,
+                                                        device.name, track_uri);
 
     if (result) {
-        ESP_LOGI(TAG, "Successfully initiated casting to %s", device_name);
+        ESP_LOGI(TAG, "Queued casting to %s", device_name);
     } else {
-        ESP_LOGE(TAG, "Failed to cast to %s", device_name);
+        ESP_LOGE(TAG, "Failed to queue casting to %s", device_name);
     }
 
     return result;
@@ -384,29 +566,20 @@ int esp_cast_get_chromecast_devices_for_spotify_strings(char devices[][64], int
         return 0;
     }
 
-    // In a real implementation, you would query the discovery component
-    // for the current list of discovered devices
+    const chromecast_device_table_t* table = chromecast_discovery_acquire_devices(discovery_handle);
+    size_t cached_count = 0;
+    const chromecast_device_info_t* cached = chromecast_device_table_devices(table, &cached_count);
 
-    // For demonstration, we'll return some mock devices
     int device_count = 0;
-
-    if (max_devices > 0) {
-        strncpy(devices[0], "Living Room Chromecast", 63);
-        devices[0][63] = '\0';
-        device_count++;
-    }
-
-    if (max_devices > 1) {
-        strncpy(devices[1], "Bedroom Chromecast", 63);
-        devices[1][63] = '\0';
-        device_count++;
-    }
-
-    if (max_devices > 2) {
-        strncpy(devices[2], "Kitchen Chromecast", 63);
-        devices[2][63] = '\0';
+    for (size_t i = 0; i < cached_count && device_count < max_devices; i++) {
+        if (cached[i].protocol != CHROMECAST_PROTOCOL_CAST) {
+            continue;
+        }
+        strncpy(devices[device_count], cached[i].name, 63);
+        devices[device_count][63] = '\0';
         device_count++;
     }
+    chromecast_device_table_release(table);
 
     ESP_LOGI(TAG, "Returning %d Chromecast devices for Spotify casting", device_count);
     return device_count;
@@ -420,40 +593,21 @@ int esp_cast_get_chromecast_devices_for_spotify(chromecast_device_info_t* device
 
     ESP_LOGI(TAG, "Getting Chromecast devices for Spotify casting (device info format)");
 
-    // For now, return simulated devices
-    // In a real implementation, this would query the discovery component
-    int device_count = 0;
-
-    if (max_devices > 0) {
-        strncpy(devices[0].name, "Living Room Chromecast", sizeof(devices[0].name) - 1);
-        devices[0].name[sizeof(devices[0].name) - 1] = '\0';
-        strncpy(devices[0].ip_address, "192.168.1.100", sizeof(devices[0].ip_address) - 1);
-        devices[0].ip_address[sizeof(devices[0].ip_address) - 1] = '\0';
-        devices[0].port = 8009;
-        strncpy(devices[0].instance_name, "Chromecast-Living-Room", sizeof(devices[0].instance_name) - 1);
-        devices[0].instance_name[sizeof(devices[0].instance_name) - 1] = '\0';
-        strncpy(devices[0].model, "Chromecast", sizeof(devices[0].model) - 1);
-        devices[0].model[sizeof(devices[0].model) - 1] = '\0';
-        strncpy(devices[0].uuid, "12345678-1234-1234-1234-123456789abc", sizeof(devices[0].uuid) - 1);
-        devices[0].uuid[sizeof(devices[0].uuid) - 1] = '\0';
-        device_count++;
+    size_t device_count = 0;
+    if (!chromecast_discovery_get_cached_devices(discovery_handle, devices, max_devices, &device_count)) {
+        ESP_LOGW(TAG, "Discovery not initialized");
+        return 0;
     }
 
-    if (max_devices > 1) {
-        strncpy(devices[1].name, "Bedroom Chromecast", sizeof(devices[1].name) - 1);
-        devices[1].name[sizeof(devices[1].name) - 1] = '\0';
-        strncpy(devices[1].ip_address, "192.168.1.101", sizeof(devices[1].ip_address) - 1);
-        devices[1].ip_address[sizeof(devices[1].ip_address) - 1] = '\0';
-        devices[1].port = 8009;
-        strncpy(devices[1].instance_name, "Chromecast-Bedroom", sizeof(devices[1].instance_name) - 1);
-        devices[1].instance_name[sizeof(devices[1].instance_name) - 1] = '\0';
-        strncpy(devices[1].model, "Chromecast", sizeof(devices[1].model) - 1);
-        devices[1].model[sizeof(devices[1].model) - 1] = '\0';
-        strncpy(devices[1].uuid, "87654321-4321-4321-4321-cba987654321", sizeof(devices[1].uuid) - 1);
-        devices[1].uuid[sizeof(devices[1].uuid) - 1] = '\0';
-        device_count++;
+    // Only Cast devices can take a Spotify session
+    size_t cast_count = 0;
+    for (size_t i = 0; i < device_count; i++) {
+        if (devices[i].protocol == CHROMECAST_PROTOCOL_CAST) {
+            devices[cast_count++] = devices[i];
+        }
     }
+    device_count = cast_count;
 
-    ESP_LOGI(TAG, "Returning %d Chromecast devices for Spotify casting (device info format)", device_count);
-    return device_count;
+    ESP_LOGI(TAG, "Returning %d Chromecast devices for Spotify casting (device info format)", (int)device_count);
+    return (int)device_count;
 }
@@ -23,6 +23,14 @@ void esp_cast_gui_init(void);
  */
 void esp_cast_wifi_init_sta(void);
 
+/**
+ * @brief Create the Spotify controller from the stored configuration, if any
+ *
+ * Any task, after esp_cast_wifi_init_sta() (NVS and the network stack);
+ * before esp_cast_gui_init(), which shows the tab for what it made.
+ */
+void esp_cast_spotify_auto_init(void);
+
 /**
  * @brief Main ESP Cast loop
  *
@@ -82,7 +90,8 @@ spotify_controller_handle_t esp_cast_get_spotify_controller(void);
 /**
  * @brief Run Spotify periodic tasks
  *
- * Should be called from main loop to handle token refresh and other periodic tasks
+ * Should be called from main loop to handle token refresh and other periodic tasks.
+ * Only queues the work; the network calls run on the Spotify worker task.
  */
 void esp_cast_spotify_run_tasks(void);
 
@@ -91,7 +100,7 @@ void esp_cast_spotify_run_tasks(void);
  *
  * @param device_name Name of the Chromecast device to cast to
  * @param track_uri Spotify track URI to cast
- * @return true on success, false on failure
+ * @return true if the device was found and the cast request was queued
  */
 bool esp_cast_spotify_to_chromecast(const char* device_name, const char* track_uri);
 
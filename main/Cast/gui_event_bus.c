@@ -0,0 +1,143 @@
+#include "gui_event_bus.h"
+#include "esp_log.h"
+#include <stdatomic.h>
+#include <string.h>
+
+static const char *TAG = "gui_event_bus";
+
+#define GUI_EVENT_BUS_MASK (GUI_EVENT_BUS_CAPACITY - 1)
+
+_Static_assert((GUI_EVENT_BUS_CAPACITY & GUI_EVENT_BUS_MASK) == 0, "capacity must be a power of two");
+
+// Bounded MPSC ring: each slot's sequence says whose turn it is. A producer
+// claims position pos when sequence == pos, fills the slot and publishes it
+// as pos + 1; the consumer reads it and hands the slot on to the producer
+// one lap later (pos + capacity).
+typedef struct {
+    atomic_uint sequence;
+    gui_event_t event;
+} gui_event_slot_t;
+
+static gui_event_slot_t g_slots[GUI_EVENT_BUS_CAPACITY];
+static atomic_uint g_head;     // Next position to claim (producers)
+static unsigned g_tail;        // Next position to read (LVGL thread only)
+static atomic_uint g_dropped;
+static gui_event_handler_t g_handlers[GUI_EVENT_TYPE_COUNT];
+static TaskHandle_t volatile g_consumer;
+
+static bool event_coalesces(gui_event_type_t type) {
+    return type == GUI_EVENT_CHROMECAST_STATE || type == GUI_EVENT_CHROMECAST_VOLUME ||
+           type == GUI_EVENT_BATTERY;
+}
+
+void gui_event_bus_init(void) {
+    for (unsigned i = 0; i < GUI_EVENT_BUS_CAPACITY; i++) {
+        atomic_init(&g_slots[i].sequence, i);
+    }
+    atomic_init(&g_head, 0);
+    atomic_init(&g_dropped, 0);
+    g_tail = 0;
+}
+
+void gui_event_bus_set_consumer(TaskHandle_t task) {
+    g_consumer = task;
+}
+
+void gui_event_bus_subscribe(gui_event_type_t type, gui_event_handler_t handler) {
+    if (type < GUI_EVENT_TYPE_COUNT) {
+        g_handlers[type] = handler;
+    }
+}
+
+bool gui_event_bus_post(const gui_event_t *event) {
+    if (!event || event->type >= GUI_EVENT_TYPE_COUNT) {
+        return false;
+    }
+
+    unsigned pos = atomic_load_explicit(&g_head, memory_order_relaxed);
+    gui_event_slot_t *slot;
+    for (;;) {
+        slot = &g_slots[pos & GUI_EVENT_BUS_MASK];
+        unsigned sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        int diff = (int)(sequence - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&g_head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+            // pos now holds the current head; try that slot
+        } else if (diff < 0) {
+            // Slot still holds an event from the previous lap: full
+            atomic_fetch_add_explicit(&g_dropped, 1, memory_order_relaxed);
+            return false;
+        } else {
+            pos = atomic_load_explicit(&g_head, memory_order_relaxed);
+        }
+    }
+
+    slot->event = *event;
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+
+    TaskHandle_t consumer = g_consumer;
+    if (consumer) {
+        xTaskNotifyGive(consumer);
+    }
+    return true;
+}
+
+bool gui_event_bus_post_call(void (*fn)(void *arg), void *arg) {
+    gui_event_t event = {
+        .type = GUI_EVENT_CALL,
+        .data.call = { .fn = fn, .arg = arg },
+    };
+    return fn && gui_event_bus_post(&event);
+}
+
+static bool pop_event(gui_event_t *event) {
+    gui_event_slot_t *slot = &g_slots[g_tail & GUI_EVENT_BUS_MASK];
+    unsigned sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    if (sequence != g_tail + 1) {
+        return false;
+    }
+
+    *event = slot->event;
+    atomic_store_explicit(&slot->sequence, g_tail + GUI_EVENT_BUS_CAPACITY, memory_order_release);
+    g_tail++;
+    return true;
+}
+
+bool gui_event_bus_process(void) {
+    gui_event_t batch[GUI_EVENT_BUS_MAX_PER_TICK];
+    size_t count = 0;
+    while (count < GUI_EVENT_BUS_MAX_PER_TICK && pop_event(&batch[count])) {
+        count++;
+    }
+
+    unsigned dropped = atomic_exchange_explicit(&g_dropped, 0, memory_order_relaxed);
+    if (dropped > 0) {
+        ESP_LOGW(TAG, "Event ring full, %u events dropped", dropped);
+    }
+    if (count == 0) {
+        return false;
+    }
+
+    // Index of the newest event of each type in this batch
+    size_t newest[GUI_EVENT_TYPE_COUNT];
+    for (size_t i = 0; i < count; i++) {
+        newest[batch[i].type] = i;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const gui_event_t *event = &batch[i];
+        if (event_coalesces(event->type) && newest[event->type] != i) {
+            continue;
+        }
+
+        if (event->type == GUI_EVENT_CALL) {
+            event->data.call.fn(event->data.call.arg);
+        } else if (g_handlers[event->type]) {
+            g_handlers[event->type](event);
+        }
+    }
+    return count == GUI_EVENT_BUS_MAX_PER_TICK;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief GUI event bus - hands controller events to the LVGL thread
+ *
+ * Controller callbacks fire on their own tasks (the Chromecast receive and
+ * connect tasks, discovery, the Spotify worker) and must not touch LVGL.
+ * They post small tagged events into a fixed-size lock-free ring instead;
+ * app_main drains it once per lv_timer_handler() tick and dispatches each
+ * event to the handler subscribed for its type.
+ *
+ * - Any number of producers, one consumer (the LVGL thread)
+ * - At most GUI_EVENT_BUS_MAX_PER_TICK events per drain; the rest wait for
+ *   the next tick, so a burst cannot stall a frame
+ * - Within a drain only the newest event of a coalescing type (connection
+ *   state, volume, battery) is delivered; older ones are stale by then
+ * - Posting never blocks: a full ring rejects the event
+ * - Posting wakes the consumer task (if set), so a GUI loop that sleeps
+ *   until its next LVGL timer still reacts within a tick
+ */
+
+#define GUI_EVENT_BUS_CAPACITY          64      // Power of two
+#define GUI_EVENT_BUS_MAX_PER_TICK      16
+
+typedef enum {
+    GUI_EVENT_CALL,                         // data.call: run fn(arg) on the LVGL thread
+    GUI_EVENT_CHROMECAST_STATE,             // data.value: chromecast_connection_state_t (coalesced)
+    GUI_EVENT_CHROMECAST_VOLUME,            // data.volume (coalesced)
+    GUI_EVENT_CHROMECAST_CONNECT_PROGRESS,  // data.value: chromecast_connect_stage_t
+    GUI_EVENT_TOUCH_GESTURE,                // data.gesture (see Touch_Gesture.h)
+    GUI_EVENT_BATTERY,                      // data.battery (coalesced)
+    GUI_EVENT_VOICE_COMMAND,                // data.value: voice_action_t (see voice_actions.h)
+    GUI_EVENT_TYPE_COUNT
+} gui_event_type_t;
+
+typedef struct {
+    gui_event_type_t type;
+    union {
+        int32_t value;
+        struct {
+            float level;
+            bool muted;
+        } volume;
+        struct {
+            void (*fn)(void *arg);
+            void *arg;
+        } call;
+        struct {
+            uint8_t type;           // touch_gesture_type_t
+            uint8_t direction;      // touch_swipe_dir_t
+            int16_t velocity_x;
+            int16_t velocity_y;
+            float value;
+        } gesture;
+        struct {
+            int16_t percent;
+            int16_t minutes_left;   // -1 when unknown
+        } battery;
+    } data;
+} gui_event_t;
+
+typedef void (*gui_event_handler_t)(const gui_event_t *event);
+
+/**
+ * @brief Reset the ring; call once before any producer starts
+ */
+void gui_event_bus_init(void);
+
+/**
+ * @brief Task to notify (xTaskNotifyGive) after each post, or NULL
+ */
+void gui_event_bus_set_consumer(TaskHandle_t task);
+
+/**
+ * @brief Set the LVGL-thread handler for an event type (NULL to drop them)
+ */
+void gui_event_bus_subscribe(gui_event_type_t type, gui_event_handler_t handler);
+
+/**
+ * @brief Queue an event from any task
+ *
+ * @return false if the ring is full (the event is not queued)
+ */
+bool gui_event_bus_post(const gui_event_t *event);
+
+/**
+ * @brief Queue fn(arg) to run on the LVGL thread
+ *
+ * @return false if the ring is full; fn will not run, so arg is still the
+ *         caller's to release
+ */
+bool gui_event_bus_post_call(void (*fn)(void *arg), void *arg);
+
+/**
+ * @brief Dispatch queued events; LVGL thread, once per lv_timer_handler()
+ *
+ * @return true if the per-tick limit was reached and more may be waiting
+ */
+bool gui_event_bus_process(void);
+
+#ifdef __cplusplus
+}
+#endif
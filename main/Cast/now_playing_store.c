@@ -0,0 +1,206 @@
+#include "now_playing_store.h"
+#include "LVGL_Driver.h"
+#include "LVGL_Batch.h"
+#include "esp_log.h"
+#include <string.h>
+#include <stdlib.h>
+
+static const char *TAG = "now_playing_store";
+
+typedef struct {
+    lv_obj_t *obj;
+    uint32_t fields;
+    now_playing_bind_cb_t cb;
+} now_playing_binding_t;
+
+static now_playing_state_t s_state = { .volume_percent = -1 };
+static now_playing_binding_t s_bindings[NOW_PLAYING_MAX_BINDINGS];
+static struct {
+    uint32_t fields;
+    now_playing_listener_t cb;
+} s_listeners[NOW_PLAYING_MAX_LISTENERS];
+static lv_timer_t *s_clock_timer;
+
+static bool clock_bound(void) {
+    for (size_t i = 0; i < NOW_PLAYING_MAX_BINDINGS; i++) {
+        if (s_bindings[i].obj && (s_bindings[i].fields & NOW_PLAYING_CLOCK)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The clock only ticks while there is something playing to count and a label to show it
+static void update_clock_timer(void) {
+    if (!s_clock_timer) {
+        return;
+    }
+    if (s_state.is_playing && clock_bound()) {
+        lv_timer_resume(s_clock_timer);
+    } else {
+        lv_timer_pause(s_clock_timer);
+    }
+}
+
+static void notify(uint32_t changed) {
+    if (changed == 0) {
+        return;
+    }
+    // Every bound widget redrawn as one area
+    LVGL_Batch_Begin();
+    for (size_t i = 0; i < NOW_PLAYING_MAX_BINDINGS; i++) {
+        now_playing_binding_t *binding = &s_bindings[i];
+        if (binding->obj && (binding->fields & changed)) {
+            binding->cb(binding->obj, &s_state, binding->fields & changed);
+        }
+    }
+    for (size_t i = 0; i < NOW_PLAYING_MAX_LISTENERS; i++) {
+        if (s_listeners[i].cb && (s_listeners[i].fields & changed)) {
+            s_listeners[i].cb(&s_state, s_listeners[i].fields & changed);
+        }
+    }
+    LVGL_Batch_Commit();
+    if (changed & (NOW_PLAYING_PLAYING | NOW_PLAYING_PROGRESS)) {
+        update_clock_timer();
+    }
+}
+
+static void clock_timer_cb(lv_timer_t *timer) {
+    // A second label update can wait for a scroll to finish
+    if (LVGL_Timer_Defer(timer)) {
+        return;
+    }
+    notify(NOW_PLAYING_CLOCK);
+}
+
+static void binding_delete_cb(lv_event_t *e) {
+    lv_obj_t *obj = lv_event_get_target(e);
+    for (size_t i = 0; i < NOW_PLAYING_MAX_BINDINGS; i++) {
+        if (s_bindings[i].obj == obj) {
+            s_bindings[i].obj = NULL;
+        }
+    }
+    update_clock_timer();
+}
+
+bool now_playing_store_bind(lv_obj_t *obj, uint32_t fields, now_playing_bind_cb_t cb) {
+    if (!obj || !cb) {
+        return false;
+    }
+
+    now_playing_binding_t *binding = NULL;
+    for (size_t i = 0; i < NOW_PLAYING_MAX_BINDINGS && !binding; i++) {
+        if (!s_bindings[i].obj) {
+            binding = &s_bindings[i];
+        }
+    }
+    if (!binding) {
+        ESP_LOGE(TAG, "No free binding");
+        return false;
+    }
+
+    if ((fields & NOW_PLAYING_CLOCK) && !s_clock_timer) {
+        s_clock_timer = lv_timer_create(clock_timer_cb, NOW_PLAYING_CLOCK_MS, NULL);
+        if (!s_clock_timer) {
+            ESP_LOGE(TAG, "Failed to create clock timer");
+            return false;
+        }
+        lv_timer_pause(s_clock_timer);
+    }
+
+    binding->obj = obj;
+    binding->fields = fields;
+    binding->cb = cb;
+    lv_obj_add_event_cb(obj, binding_delete_cb, LV_EVENT_DELETE, NULL);
+
+    cb(obj, &s_state, fields);
+    update_clock_timer();
+    return true;
+}
+
+bool now_playing_store_listen(uint32_t fields, now_playing_listener_t cb) {
+    if (!cb) {
+        return false;
+    }
+    for (size_t i = 0; i < NOW_PLAYING_MAX_LISTENERS; i++) {
+        if (!s_listeners[i].cb) {
+            s_listeners[i].fields = fields;
+            s_listeners[i].cb = cb;
+            cb(&s_state, fields);
+            return true;
+        }
+    }
+    ESP_LOGE(TAG, "No free listener");
+    return false;
+}
+
+static bool copy_field(char *field, size_t size, const char *value) {
+    if (strncmp(field, value, size - 1) == 0) {
+        return false;
+    }
+    strncpy(field, value, size - 1);
+    field[size - 1] = '\0';
+    return true;
+}
+
+void now_playing_store_set_playback(const spotify_playback_state_t *playback) {
+    if (!playback) {
+        return;
+    }
+
+    uint32_t changed = 0;
+    const spotify_track_info_t *track = &playback->current_track;
+    if (copy_field(s_state.track, sizeof(s_state.track), track->name) |
+        copy_field(s_state.image_url, sizeof(s_state.image_url), track->image_url) |
+        (s_state.duration_ms != track->duration_ms)) {
+        s_state.duration_ms = track->duration_ms;
+        changed |= NOW_PLAYING_TRACK;
+    }
+    if (copy_field(s_state.artist, sizeof(s_state.artist), track->artist)) {
+        changed |= NOW_PLAYING_ARTIST;
+    }
+    if (copy_field(s_state.device, sizeof(s_state.device), playback->device_name)) {
+        changed |= NOW_PLAYING_DEVICE;
+    }
+
+    // Read the clock before a play/pause change stops or starts it
+    int position = now_playing_store_position_ms();
+    if (s_state.is_playing != playback->is_playing) {
+        s_state.is_playing = playback->is_playing;
+        changed |= NOW_PLAYING_PLAYING;
+    }
+    if ((changed & (NOW_PLAYING_TRACK | NOW_PLAYING_PLAYING)) ||
+        abs(playback->progress_ms - position) > NOW_PLAYING_DRIFT_MS) {
+        changed |= NOW_PLAYING_PROGRESS;
+    }
+    if (changed & NOW_PLAYING_PROGRESS) {
+        s_state.progress_ms = playback->progress_ms;
+        s_state.progress_tick = lv_tick_get();
+    }
+
+    notify(changed);
+}
+
+void now_playing_store_set_volume(int volume_percent, bool muted) {
+    if (s_state.volume_percent == volume_percent && s_state.muted == muted) {
+        return;
+    }
+    s_state.volume_percent = volume_percent;
+    s_state.muted = muted;
+    notify(NOW_PLAYING_VOLUME);
+}
+
+const now_playing_state_t *now_playing_store_get(void) {
+    return &s_state;
+}
+
+int now_playing_store_position_ms(void) {
+    int position = s_state.progress_ms;
+    if (s_state.is_playing) {
+        position += (int)lv_tick_elaps(s_state.progress_tick);
+    }
+    if (s_state.duration_ms > 0 && position > s_state.duration_ms) {
+        position = s_state.duration_ms;
+    }
+    return position;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lvgl.h"
+#include "spotify_controller_wrapper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Now playing store - what is playing, as the GUI shows it
+ *
+ * Playback polls and volume reports are merged into one state, and only the
+ * fields that actually changed are passed on: a widget is bound to the
+ * fields it draws and is refreshed when one of them changes, so a poll that
+ * only moves the position redraws nothing but the elapsed time.
+ *
+ * The position is a clock: the last reported position and the tick it was
+ * reported at. While playing, NOW_PLAYING_CLOCK fires once a second for
+ * labels that show the extrapolated time; a report is taken as a new
+ * position (NOW_PLAYING_PROGRESS) only if it is a seek, i.e. off the clock
+ * by more than NOW_PLAYING_DRIFT_MS.
+ *
+ * LVGL thread only.
+ */
+
+#define NOW_PLAYING_MAX_BINDINGS    16
+#define NOW_PLAYING_MAX_LISTENERS   3
+#define NOW_PLAYING_DRIFT_MS        1500
+#define NOW_PLAYING_CLOCK_MS        1000
+
+typedef enum {
+    NOW_PLAYING_TRACK       = 1 << 0,   // track, image_url, duration_ms
+    NOW_PLAYING_ARTIST      = 1 << 1,
+    NOW_PLAYING_PROGRESS    = 1 << 2,   // the clock was set (seek, new track, play/pause)
+    NOW_PLAYING_VOLUME      = 1 << 3,   // volume_percent, muted: the Cast device's
+    NOW_PLAYING_PLAYING     = 1 << 4,
+    NOW_PLAYING_DEVICE      = 1 << 5,
+    NOW_PLAYING_CLOCK       = 1 << 6,   // a second passed while playing
+} now_playing_field_t;
+
+typedef struct {
+    char track[256];
+    char artist[256];
+    char image_url[512];
+    char device[256];
+    int duration_ms;
+    int progress_ms;            // At progress_tick
+    uint32_t progress_tick;     // lv_tick_get()
+    int volume_percent;         // -1 until the Cast device reports it
+    bool muted;
+    bool is_playing;
+} now_playing_state_t;
+
+/**
+ * @brief Refresh a bound widget
+ *
+ * @param obj The widget
+ * @param state Current state
+ * @param changed now_playing_field_t bits that changed (all bound fields on the first call)
+ */
+typedef void (*now_playing_bind_cb_t)(lv_obj_t *obj, const now_playing_state_t *state, uint32_t changed);
+
+/**
+ * @brief Told of changes without a widget behind it (the control API, BLE control)
+ */
+typedef void (*now_playing_listener_t)(const now_playing_state_t *state, uint32_t changed);
+
+/**
+ * @brief Refresh obj whenever one of fields changes, until obj is deleted
+ *
+ * cb runs once at once with the current state.
+ *
+ * @return false if all NOW_PLAYING_MAX_BINDINGS are taken
+ */
+bool now_playing_store_bind(lv_obj_t *obj, uint32_t fields, now_playing_bind_cb_t cb);
+
+/**
+ * @brief Call cb whenever one of fields changes, for good
+ *
+ * cb runs once at once with the current state. NOW_PLAYING_CLOCK only
+ * ticks while a bound widget shows the clock.
+ *
+ * @return false if all NOW_PLAYING_MAX_LISTENERS are taken
+ */
+bool now_playing_store_listen(uint32_t fields, now_playing_listener_t cb);
+
+/**
+ * @brief Merge a Spotify playback poll (everything but the volume)
+ */
+void now_playing_store_set_playback(const spotify_playback_state_t *playback);
+
+/**
+ * @brief Merge a volume report from the Cast device
+ */
+void now_playing_store_set_volume(int volume_percent, bool muted);
+
+const now_playing_state_t *now_playing_store_get(void);
+
+/**
+ * @brief The clock read now: the position extrapolated while playing, held
+ *        while paused, never past the track's end
+ */
+int now_playing_store_position_ms(void);
+
+#ifdef __cplusplus
+}
+#endif
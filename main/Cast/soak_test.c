@@ -0,0 +1,255 @@
+#include "soak_test.h"
+#include "sdkconfig.h"
+
+#if CONFIG_ESPCASTER_SOAK
+#include "chromecast_gui_manager.h"
+#include "spotify_gui_manager.h"
+#include "gui_event_bus.h"
+#include "Display_SPD2010.h"
+#include "Touch_SPD2010.h"
+#include "SD_MMC.h"
+#include "telemetry.h"
+#include "mem_tag.h"
+#include "mem_task.h"
+#include "task_plan.h"
+#include "esp_app_desc.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "soak_test";
+
+#define LINE_SIZE   512
+
+typedef enum {
+    TOUCH_TAB,
+    TOUCH_SWIPE_LEFT,
+    TOUCH_SWIPE_RIGHT,
+    TOUCH_SCROLL_UP,
+    TOUCH_SCROLL_DOWN,
+    TOUCH_ACTION_COUNT
+} touch_action_t;
+
+static chromecast_discovery_handle_t s_discovery;
+static chromecast_device_info_t s_device;       // Read on the LVGL thread by connect_call()
+static FILE *s_csv;
+
+// Counted since the start
+static uint32_t s_connects;
+static uint32_t s_connect_failures;
+static uint32_t s_scans;
+static volatile uint32_t s_spotify_requests;    // On the LVGL thread
+static uint32_t s_touches;
+
+static void connect_call(void *arg) {
+    chromecast_gui_connect_device(&s_device);
+}
+
+static void disconnect_call(void *arg) {
+    chromecast_gui_disconnect();
+}
+
+static void spotify_call(void *arg) {
+    spotify_controller_handle_t handle = spotify_gui_get_controller_handle();
+    if (!handle || !spotify_controller_is_connected(handle)) {
+        return;
+    }
+    bool queued = false;
+    switch ((uintptr_t)arg % 3) {
+        case 0: queued = spotify_controller_get_playback_state(handle); break;
+        case 1: queued = spotify_controller_get_devices(handle); break;
+        default: queued = spotify_controller_get_playlists(handle); break;
+    }
+    if (queued) {
+        s_spotify_requests++;
+    }
+}
+
+// The configured device, else the first Cast device in the table
+static bool pick_device(chromecast_device_info_t *out) {
+    if (CONFIG_ESPCASTER_SOAK_CAST_DEVICE[0]) {
+        return chromecast_discovery_find_device(s_discovery, CONFIG_ESPCASTER_SOAK_CAST_DEVICE, out);
+    }
+    const chromecast_device_table_t *table = chromecast_discovery_acquire_devices(s_discovery);
+    size_t count = 0;
+    const chromecast_device_info_t *devices = chromecast_device_table_devices(table, &count);
+    bool found = false;
+    for (size_t i = 0; i < count && !found; i++) {
+        if (devices[i].protocol == CHROMECAST_PROTOCOL_CAST && !devices[i].probable) {
+            *out = devices[i];
+            found = true;
+        }
+    }
+    chromecast_device_table_release(table);
+    return found;
+}
+
+static void cast_step(uint32_t elapsed_s) {
+    uint32_t phase = elapsed_s % SOAK_CAST_PERIOD_S;
+    if (phase == 0) {
+        if (!pick_device(&s_device)) {
+            ESP_LOGW(TAG, "No Cast device to connect to");
+            s_connect_failures++;
+            return;
+        }
+        s_connects++;
+        gui_event_bus_post_call(connect_call, NULL);
+    } else if (phase == SOAK_CAST_HOLD_S) {
+        chromecast_controller_handle_t controller = chromecast_gui_get_controller_handle();
+        if (!controller || chromecast_controller_get_state(controller) != CHROMECAST_CONNECTED) {
+            s_connect_failures++;
+        }
+        gui_event_bus_post_call(disconnect_call, NULL);
+    }
+}
+
+// One finger from (x0, y0) to (x1, y1); a tap when they are the same
+static void touch_path(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
+    for (int i = 0; i <= SOAK_TOUCH_STEPS; i++) {
+        Touch_Inject(true, x0 + (x1 - x0) * i / SOAK_TOUCH_STEPS, y0 + (y1 - y0) * i / SOAK_TOUCH_STEPS);
+        vTaskDelay(pdMS_TO_TICKS(SOAK_TOUCH_STEP_MS));
+    }
+    Touch_Inject(false, x1, y1);
+    s_touches++;
+}
+
+static void touch_step(uint32_t step) {
+    const uint16_t w = EXAMPLE_LCD_WIDTH, h = EXAMPLE_LCD_HEIGHT;
+    switch ((touch_action_t)(step % TOUCH_ACTION_COUNT)) {
+        case TOUCH_TAB: {
+            uint16_t tab = (step / TOUCH_ACTION_COUNT) % SOAK_TABS;
+            uint16_t x = w * (2 * tab + 1) / (2 * SOAK_TABS);
+            touch_path(x, SOAK_TAB_BAR_HEIGHT / 2, x, SOAK_TAB_BAR_HEIGHT / 2);
+            break;
+        }
+        case TOUCH_SWIPE_LEFT:  touch_path(w * 3 / 4, h / 2, w / 4, h / 2); break;
+        case TOUCH_SWIPE_RIGHT: touch_path(w / 4, h / 2, w * 3 / 4, h / 2); break;
+        case TOUCH_SCROLL_UP:   touch_path(w / 2, h * 2 / 3, w / 2, h / 3); break;
+        case TOUCH_SCROLL_DOWN: touch_path(w / 2, h / 3, w / 2, h * 2 / 3); break;
+        default: break;
+    }
+}
+
+static void emit(const char *line) {
+    printf("%s\n", line);
+    if (s_csv) {
+        fprintf(s_csv, "%s\n", line);
+        fflush(s_csv);
+    }
+}
+
+static void emit_columns(void) {
+    char line[LINE_SIZE];
+    int n = snprintf(line, sizeof(line), "SOAK,columns,uptime_s,internal_free,internal_largest,internal_min,"
+                                         "psram_free,psram_largest,lvgl_used,lvgl_largest");
+    for (int t = 0; t < MEM_TAG_COUNT && n < (int)sizeof(line); t++) {
+        const char *name = mem_tag_name((mem_tag_t)t);
+        n += snprintf(line + n, sizeof(line) - n, ",%s_live,%s_allocs,%s_failures", name, name, name);
+    }
+    if (n < (int)sizeof(line)) {
+        snprintf(line + n, sizeof(line) - n, ",connects,connect_failures,scans,spotify_requests,touches");
+    }
+    emit(line);
+}
+
+static void sample(void) {
+    telemetry_sample_t latest = {0};
+    telemetry_get_samples(&latest, 1);      // For the LVGL heap, which only its thread can walk
+    mem_tag_stats_t tags[MEM_TAG_COUNT];
+    mem_tag_get_stats(tags);
+
+    const uint32_t internal = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+    char line[LINE_SIZE];
+    int n = snprintf(line, sizeof(line), "SOAK,%lu,%u,%u,%u,%u,%u,%lu,%lu",
+                     (unsigned long)(esp_timer_get_time() / 1000000),
+                     (unsigned)heap_caps_get_free_size(internal),
+                     (unsigned)heap_caps_get_largest_free_block(internal),
+                     (unsigned)heap_caps_get_minimum_free_size(internal),
+                     (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM),
+                     (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM),
+                     (unsigned long)latest.lvgl_used, (unsigned long)latest.lvgl_largest);
+    for (int t = 0; t < MEM_TAG_COUNT && n < (int)sizeof(line); t++) {
+        n += snprintf(line + n, sizeof(line) - n, ",%lu,%lu,%lu", (unsigned long)tags[t].live,
+                      (unsigned long)tags[t].allocs, (unsigned long)tags[t].failures);
+    }
+    if (n < (int)sizeof(line)) {
+        snprintf(line + n, sizeof(line) - n, ",%lu,%lu,%lu,%lu,%lu", (unsigned long)s_connects,
+                 (unsigned long)s_connect_failures, (unsigned long)s_scans, (unsigned long)s_spotify_requests,
+                 (unsigned long)s_touches);
+    }
+    emit(line);
+}
+
+static void Soak_Task(void *arg) {
+    const char *path = CONFIG_ESPCASTER_SOAK_CSV;
+    if (path[0]) {
+        if (strncmp(path, SD_MOUNT_POINT "/", strlen(SD_MOUNT_POINT) + 1) == 0) {
+            SD_Init();
+        }
+        s_csv = fopen(path, "a");
+        if (!s_csv) {
+            ESP_LOGW(TAG, "Cannot open %s, console only", path);
+        }
+    }
+
+    const esp_app_desc_t *app = esp_app_get_description();
+    char line[96];
+    snprintf(line, sizeof(line), "SOAK,begin,%s,%s", app->version, app->idf_ver);
+    emit(line);
+    emit_columns();
+
+    const uint32_t duration_s = CONFIG_ESPCASTER_SOAK_HOURS * 3600u;       // 0: until reset
+    uint32_t samples = 0;
+    TickType_t wake = xTaskGetTickCount();
+    for (uint32_t elapsed_s = 0; duration_s == 0 || elapsed_s < duration_s; elapsed_s++) {
+        if (elapsed_s % CONFIG_ESPCASTER_SOAK_SAMPLE_S == 0) {
+            sample();
+            samples++;
+        }
+        cast_step(elapsed_s);
+        if (elapsed_s % SOAK_DISCOVERY_PERIOD_S == SOAK_DISCOVERY_PERIOD_S / 2 &&
+            !chromecast_discovery_is_active(s_discovery) && chromecast_discovery_discover_async(s_discovery)) {
+            s_scans++;
+        }
+        if (elapsed_s % SOAK_SPOTIFY_PERIOD_S == 0) {
+            gui_event_bus_post_call(spotify_call, (void *)(uintptr_t)(elapsed_s / SOAK_SPOTIFY_PERIOD_S));
+        }
+        if (elapsed_s % SOAK_TOUCH_PERIOD_S == SOAK_TOUCH_PERIOD_S / 2) {
+            touch_step(elapsed_s / SOAK_TOUCH_PERIOD_S);
+        }
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(1000));
+    }
+
+    sample();
+    snprintf(line, sizeof(line), "SOAK,end,%lu,-", (unsigned long)samples + 1);
+    emit(line);
+    if (s_csv) {
+        fclose(s_csv);
+        s_csv = NULL;
+    }
+    ESP_LOGI(TAG, "Soak test finished after %d h", CONFIG_ESPCASTER_SOAK_HOURS);
+    mem_task_delete(NULL);
+}
+
+bool soak_test_start(chromecast_discovery_handle_t discovery) {
+    if (!discovery) {
+        return false;
+    }
+    s_discovery = discovery;
+    if (!mem_task_create(Soak_Task, "Soak test", SOAK_TASK_STACK, NULL, TASK_PLAN_BACKGROUND_PRIORITY, NULL,
+                         TASK_PLAN_BACKGROUND_CORE, MEM_TASK_STACK_INTERNAL)) {
+        ESP_LOGE(TAG, "No memory for the soak test task");
+        return false;
+    }
+    ESP_LOGW(TAG, "Soak test running for %d h (0: until reset)", CONFIG_ESPCASTER_SOAK_HOURS);
+    return true;
+}
+#else
+bool soak_test_start(chromecast_discovery_handle_t discovery) {
+    return false;
+}
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdbool.h>
+#include "chromecast_discovery_wrapper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Soak test - hours of scripted use, with the heap sampled throughout
+ *
+ * Field failures come after days of uptime, as heaps fragment and small
+ * leaks add up. With ESPCASTER_SOAK the app starts as usual and a
+ * background task then drives it, for ESPCASTER_SOAK_HOURS, through what a
+ * long day does to it:
+ *
+ * - connecting to a Cast device (ESPCASTER_SOAK_CAST_DEVICE, else the first
+ *   one found), holding the link SOAK_CAST_HOLD_S and going back to the
+ *   device list, every SOAK_CAST_PERIOD_S
+ * - a discovery sweep every SOAK_DISCOVERY_PERIOD_S
+ * - Spotify playback state, device and playlist requests in turn, every
+ *   SOAK_SPOTIFY_PERIOD_S, once Spotify is connected
+ * - every SOAK_TOUCH_PERIOD_S a tap on a tab, a swipe between tabs or a
+ *   list scroll, injected into the touch task as the controller's points
+ *   (Touch_Inject), so they take the gesture and LVGL input paths
+ *
+ * Connections and commands go through the GUI managers on the LVGL thread,
+ * as the touch controls' do. Every ESPCASTER_SOAK_SAMPLE_S one line is
+ * printed, and appended to ESPCASTER_SOAK_CSV if set:
+ *
+ *   SOAK,<uptime_s>,<internal free, largest, min>,<PSRAM free, largest>,
+ *        <LVGL used, largest>,<per tag: live bytes, allocs, failures>,
+ *        <connects, connect failures, scans, Spotify requests, touches>
+ *
+ * after one "SOAK,columns,..." line naming them, so that
+ * tools/soak_report.py can turn a log into trends per hour.
+ */
+
+#define SOAK_CAST_PERIOD_S          180
+#define SOAK_CAST_HOLD_S            60      // Connected this long before going back
+#define SOAK_DISCOVERY_PERIOD_S     300
+#define SOAK_SPOTIFY_PERIOD_S       30
+#define SOAK_TOUCH_PERIOD_S         10
+#define SOAK_TOUCH_STEP_MS          16      // Between the points of a swipe, one touch read apart
+#define SOAK_TOUCH_STEPS            12
+#define SOAK_TAB_BAR_HEIGHT         45      // As esp_cast_gui_init() builds the tabview
+#define SOAK_TABS                   3       // WiFi, Chromecast, Spotify
+#define SOAK_TASK_STACK             4096
+
+/**
+ * @brief Start the scripted run; after the GUI is built
+ *
+ * @param discovery Where the Cast devices are found
+ * @return false if disabled or the task could not start
+ */
+bool soak_test_start(chromecast_discovery_handle_t discovery);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,292 @@
+#include "spotify_album_art.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "rom/tjpgd.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "spotify_album_art";
+
+// Work area TJpgDec needs for its Huffman and quantisation tables
+#define ALBUM_ART_DECODER_WORK_SIZE     3100
+#define ALBUM_ART_MAX_SCALE             3       // 1/8
+
+typedef struct {
+    char id[SPOTIFY_ALBUM_ART_ID_LEN];
+    lv_img_dsc_t *image;
+    uint32_t last_used;
+} album_art_entry_t;
+
+typedef struct {
+    const uint8_t *jpeg;
+    size_t jpeg_size;
+    size_t offset;
+    lv_color_t *pixels;
+    uint16_t width;
+    uint16_t height;
+} album_art_decode_t;
+
+typedef struct {
+    album_art_entry_t *entries;
+    int size;
+} album_art_cache_t;
+
+static album_art_entry_t g_cover_entries[SPOTIFY_ALBUM_ART_CACHE_SIZE];
+static album_art_entry_t g_thumb_entries[SPOTIFY_ALBUM_ART_THUMB_CACHE_SIZE];
+static album_art_cache_t g_covers = {g_cover_entries, SPOTIFY_ALBUM_ART_CACHE_SIZE};
+static album_art_cache_t g_thumbs = {g_thumb_entries, SPOTIFY_ALBUM_ART_THUMB_CACHE_SIZE};
+static uint32_t g_use_counter = 0;
+
+static void *psram_realloc(void *ptr, size_t size) {
+    void *result = heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!result) {
+        result = realloc(ptr, size);
+    }
+    return result;
+}
+
+bool spotify_album_art_buffer_append(spotify_album_art_buffer_t *buffer, const void *data, size_t length) {
+    if (buffer->size + length > SPOTIFY_ALBUM_ART_MAX_JPEG) {
+        ESP_LOGW(TAG, "Album art larger than %d bytes, giving up", SPOTIFY_ALBUM_ART_MAX_JPEG);
+        return false;
+    }
+
+    if (buffer->size + length > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 16 * 1024;
+        while (capacity < buffer->size + length) {
+            capacity *= 2;
+        }
+        if (capacity > SPOTIFY_ALBUM_ART_MAX_JPEG) {
+            capacity = SPOTIFY_ALBUM_ART_MAX_JPEG;
+        }
+
+        uint8_t *grown = psram_realloc(buffer->data, capacity);
+        if (!grown) {
+            ESP_LOGE(TAG, "Out of memory buffering album art");
+            return false;
+        }
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+
+    memcpy(buffer->data + buffer->size, data, length);
+    buffer->size += length;
+    return true;
+}
+
+void spotify_album_art_buffer_free(spotify_album_art_buffer_t *buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->capacity = 0;
+}
+
+bool spotify_album_art_image_id(const char *url, char *id, size_t id_size) {
+    if (!url || !id || id_size == 0) {
+        return false;
+    }
+
+    // https://i.scdn.co/image/<id>
+    const char *slash = strrchr(url, '/');
+    const char *start = slash ? slash + 1 : url;
+    size_t length = strcspn(start, "?#");
+    if (length == 0 || length >= id_size) {
+        return false;
+    }
+
+    memcpy(id, start, length);
+    id[length] = '\0';
+    return true;
+}
+
+static uint32_t album_art_input(JDEC *decoder, uint8_t *buffer, uint32_t length) {
+    album_art_decode_t *ctx = (album_art_decode_t *)decoder->device;
+
+    size_t available = ctx->jpeg_size - ctx->offset;
+    if (length > available) {
+        length = available;
+    }
+    // NULL buffer: the decoder is skipping a segment
+    if (buffer) {
+        memcpy(buffer, ctx->jpeg + ctx->offset, length);
+    }
+    ctx->offset += length;
+    return length;
+}
+
+// The ROM decoder hands out RGB888 blocks; convert them in place into the
+// display's color format (RGB565, byte-swapped per LV_COLOR_16_SWAP)
+static uint32_t album_art_output(JDEC *decoder, void *bitmap, JRECT *rect) {
+    album_art_decode_t *ctx = (album_art_decode_t *)decoder->device;
+    const uint8_t *rgb = (const uint8_t *)bitmap;
+
+    for (int y = rect->top; y <= rect->bottom; y++) {
+        for (int x = rect->left; x <= rect->right; x++, rgb += 3) {
+            if (x < ctx->width && y < ctx->height) {
+                ctx->pixels[y * ctx->width + x] = lv_color_make(rgb[0], rgb[1], rgb[2]);
+            }
+        }
+    }
+    return 1;
+}
+
+lv_img_dsc_t *spotify_album_art_decode(const uint8_t *jpeg, size_t jpeg_size, uint16_t target_size) {
+    if (!jpeg || jpeg_size == 0) {
+        return NULL;
+    }
+
+    void *work = malloc(ALBUM_ART_DECODER_WORK_SIZE);
+    if (!work) {
+        ESP_LOGE(TAG, "Out of memory for JPEG decoder");
+        return NULL;
+    }
+
+    album_art_decode_t ctx = {
+        .jpeg = jpeg,
+        .jpeg_size = jpeg_size,
+    };
+    JDEC decoder;
+    JRESULT res = jd_prepare(&decoder, album_art_input, work, ALBUM_ART_DECODER_WORK_SIZE, &ctx);
+    if (res != JDR_OK) {
+        ESP_LOGW(TAG, "Not a decodable JPEG (%d)", res);
+        free(work);
+        return NULL;
+    }
+
+    // Largest scale-down that still covers the target size
+    uint16_t shorter = decoder.width < decoder.height ? decoder.width : decoder.height;
+    uint8_t scale = 0;
+    while (scale < ALBUM_ART_MAX_SCALE && (shorter >> (scale + 1)) >= target_size) {
+        scale++;
+    }
+
+    ctx.width = (decoder.width + (1 << scale) - 1) >> scale;
+    ctx.height = (decoder.height + (1 << scale) - 1) >> scale;
+    size_t data_size = (size_t)ctx.width * ctx.height * sizeof(lv_color_t);
+
+    lv_img_dsc_t *image = psram_realloc(NULL, sizeof(lv_img_dsc_t) + data_size);
+    if (!image) {
+        ESP_LOGE(TAG, "Out of memory for %dx%d album art", ctx.width, ctx.height);
+        free(work);
+        return NULL;
+    }
+    ctx.pixels = (lv_color_t *)(image + 1);
+    memset(ctx.pixels, 0, data_size);
+
+    res = jd_decomp(&decoder, album_art_output, scale);
+    free(work);
+    if (res != JDR_OK) {
+        ESP_LOGW(TAG, "JPEG decode failed (%d)", res);
+        free(image);
+        return NULL;
+    }
+
+    memset(&image->header, 0, sizeof(image->header));
+    image->header.cf = LV_IMG_CF_TRUE_COLOR;
+    image->header.w = ctx.width;
+    image->header.h = ctx.height;
+    image->data_size = data_size;
+    image->data = (const uint8_t *)ctx.pixels;
+
+    ESP_LOGD(TAG, "Decoded %dx%d JPEG at 1/%d to %dx%d",
+             decoder.width, decoder.height, 1 << scale, ctx.width, ctx.height);
+    return image;
+}
+
+void spotify_album_art_free(lv_img_dsc_t *image) {
+    free(image);
+}
+
+static album_art_entry_t *album_art_find(album_art_cache_t *cache, const char *image_id) {
+    for (int i = 0; i < cache->size; i++) {
+        if (cache->entries[i].image && strcmp(cache->entries[i].id, image_id) == 0) {
+            return &cache->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void album_art_evict(album_art_entry_t *entry) {
+    // LVGL may still hold a decoder cache entry for this source
+    lv_img_cache_invalidate_src(entry->image);
+    free(entry->image);
+    entry->image = NULL;
+    entry->id[0] = '\0';
+}
+
+static const lv_img_dsc_t *album_art_get(album_art_cache_t *cache, const char *image_id) {
+    if (!image_id) {
+        return NULL;
+    }
+
+    album_art_entry_t *entry = album_art_find(cache, image_id);
+    if (!entry) {
+        return NULL;
+    }
+    entry->last_used = ++g_use_counter;
+    return entry->image;
+}
+
+static const lv_img_dsc_t *album_art_put(album_art_cache_t *cache, const char *image_id, lv_img_dsc_t *image) {
+    if (!image_id || !image || strlen(image_id) >= SPOTIFY_ALBUM_ART_ID_LEN) {
+        spotify_album_art_free(image);
+        return NULL;
+    }
+
+    album_art_entry_t *entry = album_art_find(cache, image_id);
+    if (entry) {
+        spotify_album_art_free(image);
+        entry->last_used = ++g_use_counter;
+        return entry->image;
+    }
+
+    // Free slot, else the least recently used one
+    entry = &cache->entries[0];
+    for (int i = 0; i < cache->size; i++) {
+        if (!cache->entries[i].image) {
+            entry = &cache->entries[i];
+            break;
+        }
+        if (cache->entries[i].last_used < entry->last_used) {
+            entry = &cache->entries[i];
+        }
+    }
+    if (entry->image) {
+        ESP_LOGD(TAG, "Evicting album art %s", entry->id);
+        album_art_evict(entry);
+    }
+
+    strcpy(entry->id, image_id);
+    entry->image = image;
+    entry->last_used = ++g_use_counter;
+    return image;
+}
+
+static void album_art_clear(album_art_cache_t *cache) {
+    for (int i = 0; i < cache->size; i++) {
+        if (cache->entries[i].image) {
+            album_art_evict(&cache->entries[i]);
+        }
+    }
+}
+
+const lv_img_dsc_t *spotify_album_art_cache_get(const char *image_id) {
+    return album_art_get(&g_covers, image_id);
+}
+
+const lv_img_dsc_t *spotify_album_art_cache_put(const char *image_id, lv_img_dsc_t *image) {
+    return album_art_put(&g_covers, image_id, image);
+}
+
+const lv_img_dsc_t *spotify_album_art_thumb_cache_get(const char *image_id) {
+    return album_art_get(&g_thumbs, image_id);
+}
+
+const lv_img_dsc_t *spotify_album_art_thumb_cache_put(const char *image_id, lv_img_dsc_t *image) {
+    return album_art_put(&g_thumbs, image_id, image);
+}
+
+void spotify_album_art_cache_clear(void) {
+    album_art_clear(&g_covers);
+    album_art_clear(&g_thumbs);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "lvgl.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Spotify album art - JPEG decode and LRU cache of decoded images
+ *
+ * Covers are decoded with the ROM TJpgDec straight into lv_color_t pixels,
+ * using the decoder's 1/2, 1/4 and 1/8 scaling to get close to the size
+ * they are shown at. Decoded images live in PSRAM, keyed by the Spotify
+ * image id (the last path segment of the i.scdn.co URL), so switching back
+ * to a recent track shows its cover without a download.
+ *
+ * Decoding may run on any task; the cache is LVGL-thread only.
+ */
+
+#define SPOTIFY_ALBUM_ART_CACHE_SIZE    8
+#define SPOTIFY_ALBUM_ART_THUMB_CACHE_SIZE  24      // List row thumbnails, kept apart from the covers
+#define SPOTIFY_ALBUM_ART_ID_LEN        48
+#define SPOTIFY_ALBUM_ART_MAX_JPEG      (192 * 1024)
+
+/**
+ * @brief Growable PSRAM buffer for a JPEG being downloaded
+ */
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} spotify_album_art_buffer_t;
+
+/**
+ * @brief Append a downloaded chunk
+ *
+ * @return false if out of memory or SPOTIFY_ALBUM_ART_MAX_JPEG is exceeded
+ */
+bool spotify_album_art_buffer_append(spotify_album_art_buffer_t *buffer, const void *data, size_t length);
+
+/**
+ * @brief Release the buffer's memory and reset it
+ */
+void spotify_album_art_buffer_free(spotify_album_art_buffer_t *buffer);
+
+/**
+ * @brief Extract the image id from a Spotify image URL
+ *
+ * @return false if the URL has no id or it does not fit
+ */
+bool spotify_album_art_image_id(const char *url, char *id, size_t id_size);
+
+/**
+ * @brief Decode a JPEG to a true-color LVGL image
+ *
+ * Uses the largest decoder scale-down that keeps the shorter side at least
+ * target_size pixels. The descriptor and its pixels are one PSRAM block.
+ *
+ * @return Decoded image (free with spotify_album_art_free()) or NULL
+ */
+lv_img_dsc_t *spotify_album_art_decode(const uint8_t *jpeg, size_t jpeg_size, uint16_t target_size);
+
+/**
+ * @brief Free an image that was never put in the cache
+ */
+void spotify_album_art_free(lv_img_dsc_t *image);
+
+/**
+ * @brief Look up a decoded image and mark it most recently used
+ *
+ * The image stays valid while it is among the SPOTIFY_ALBUM_ART_CACHE_SIZE
+ * most recently used, so an image that is shown must be looked up (or put)
+ * again whenever it is shown.
+ *
+ * @return Cached image or NULL
+ */
+const lv_img_dsc_t *spotify_album_art_cache_get(const char *image_id);
+
+/**
+ * @brief Add a decoded image, evicting the least recently used one if full
+ *
+ * Takes ownership of image. If image_id is already cached, image is freed
+ * and the cached copy is returned.
+ *
+ * @return The cached image
+ */
+const lv_img_dsc_t *spotify_album_art_cache_put(const char *image_id, lv_img_dsc_t *image);
+
+/**
+ * @brief spotify_album_art_cache_get() for the list row thumbnails
+ *
+ * Thumbnails have their own SPOTIFY_ALBUM_ART_THUMB_CACHE_SIZE entries, so
+ * a scrolled list never evicts the cover on the now playing screen.
+ */
+const lv_img_dsc_t *spotify_album_art_thumb_cache_get(const char *image_id);
+
+/**
+ * @brief spotify_album_art_cache_put() for the list row thumbnails
+ */
+const lv_img_dsc_t *spotify_album_art_thumb_cache_put(const char *image_id, lv_img_dsc_t *image);
+
+/**
+ * @brief Free every cached image and thumbnail (nothing may be showing one)
+ */
+void spotify_album_art_cache_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
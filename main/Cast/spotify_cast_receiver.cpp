@@ -0,0 +1,124 @@
+#include "spotify_cast_receiver.h"
+#include "chromecast_controller.h"
+#include "cast_json_writer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include <cstring>
+#include <new>
+
+static const char *TAG = "spotify_cast";
+
+// setCredentials carries the token (a few hundred characters)
+static constexpr size_t SPOTIFY_CAST_MESSAGE_SIZE = 1024;
+static constexpr uint32_t SPOTIFY_CAST_SESSION_POLL_MS = 100;
+
+static constexpr EventBits_t CONNECT_DONE_BIT = 1 << 0;
+static constexpr EventBits_t CONNECT_FAILED_BIT = 1 << 1;
+static constexpr EventBits_t CREDENTIALS_OK_BIT = 1 << 2;
+static constexpr EventBits_t CREDENTIALS_ERROR_BIT = 1 << 3;
+
+// The receiver session exists once a RECEIVER_STATUS lists the app with a transport
+static bool wait_for_app_session(ChromecastController& cast) {
+    for (uint32_t waited = 0; waited < SPOTIFY_CAST_LAUNCH_TIMEOUT_MS; waited += SPOTIFY_CAST_SESSION_POLL_MS) {
+        if (cast.has_app_session()) {
+            return true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(SPOTIFY_CAST_SESSION_POLL_MS));
+    }
+    return cast.has_app_session();
+}
+
+static spotify_cast_launch_result_t launch(ChromecastController& cast, EventGroupHandle_t events, const char *ip,
+                                           int port, const char *access_token, uint32_t expires_in_s) {
+    // Connect on the controller's own task: the TLS handshake needs its stack
+    cast.set_connect_progress_callback([events](ChromecastController::ConnectStage stage) {
+        if (stage == ChromecastController::CONNECT_STAGE_COMPLETE) {
+            xEventGroupSetBits(events, CONNECT_DONE_BIT);
+        } else if (stage == ChromecastController::CONNECT_STAGE_FAILED ||
+                   stage == ChromecastController::CONNECT_STAGE_CANCELLED) {
+            xEventGroupSetBits(events, CONNECT_FAILED_BIT);
+        }
+    });
+    bool registered = cast.register_namespace_handler(SPOTIFY_CAST_NAMESPACE, [events](const CastMessageView&, const CastPayload& payload) {
+        if (strcmp(payload.type, "setCredentialsResponse") == 0) {
+            xEventGroupSetBits(events, CREDENTIALS_OK_BIT);
+        } else if (strcmp(payload.type, "setCredentialsError") == 0) {
+            xEventGroupSetBits(events, CREDENTIALS_ERROR_BIT);
+        } else {
+            ESP_LOGD(TAG, "Receiver message: %s", payload.type);
+        }
+    });
+
+    if (!registered || !cast.connect_to_chromecast_async(ip, port)) {
+        return SPOTIFY_CAST_LAUNCH_FAILED;
+    }
+    EventBits_t bits = xEventGroupWaitBits(events, CONNECT_DONE_BIT | CONNECT_FAILED_BIT, pdTRUE, pdFALSE,
+                                           pdMS_TO_TICKS(SPOTIFY_CAST_CONNECT_TIMEOUT_MS));
+    if (!(bits & CONNECT_DONE_BIT)) {
+        cast.cancel_connect();
+        if (cast.is_device_auth_rejected()) {
+            ESP_LOGE(TAG, "%s:%d failed Cast device authentication", ip, port);
+            return SPOTIFY_CAST_LAUNCH_NOT_AUTHENTICATED;
+        }
+        ESP_LOGE(TAG, "Could not connect to %s:%d", ip, port);
+        return SPOTIFY_CAST_LAUNCH_FAILED;
+    }
+
+    if (!cast.launch_app(SPOTIFY_CAST_APP_ID) || !wait_for_app_session(cast)) {
+        ESP_LOGE(TAG, "Spotify receiver did not start on %s", ip);
+        return SPOTIFY_CAST_LAUNCH_FAILED;
+    }
+    ESP_LOGI(TAG, "Spotify receiver running on %s (transport %s)", ip, cast.get_app_transport_id().c_str());
+
+    // A bearer token for the user's account: only for a device that proved it
+    // is one, unless device auth is not enforced (CONFIG_CAST_DEVICE_AUTH_REQUIRED)
+    if (!cast.is_device_authenticated()) {
+        const char *status = CastDeviceAuth::status_name(cast.get_device_auth_status());
+        if (cast.is_device_auth_required()) {
+            ESP_LOGE(TAG, "Not sending credentials to %s: device auth %s", ip, status);
+            return SPOTIFY_CAST_LAUNCH_NOT_AUTHENTICATED;
+        }
+        ESP_LOGW(TAG, "Sending credentials to %s without device auth (%s, not required)", ip, status);
+    }
+
+    CastJsonWriter<SPOTIFY_CAST_MESSAGE_SIZE> json;
+    json.field("type", "setCredentials")
+        .field("credentials", access_token)
+        .field_uint("expiresIn", expires_in_s)
+        .end();
+    if (!json.ok() || !cast.send_app_message(SPOTIFY_CAST_NAMESPACE, json.c_str())) {
+        ESP_LOGE(TAG, "Failed to send credentials to the receiver");
+        return SPOTIFY_CAST_LAUNCH_FAILED;
+    }
+
+    bits = xEventGroupWaitBits(events, CREDENTIALS_OK_BIT | CREDENTIALS_ERROR_BIT, pdTRUE, pdFALSE,
+                               pdMS_TO_TICKS(SPOTIFY_CAST_CREDENTIALS_TIMEOUT_MS));
+    if (!(bits & CREDENTIALS_OK_BIT)) {
+        ESP_LOGE(TAG, "Receiver %s the credentials", (bits & CREDENTIALS_ERROR_BIT) ? "rejected" : "did not answer");
+        return SPOTIFY_CAST_LAUNCH_FAILED;
+    }
+    return SPOTIFY_CAST_LAUNCH_OK;
+}
+
+spotify_cast_launch_result_t spotify_cast_receiver_launch(const char *ip, int port, const char *access_token,
+                                                          uint32_t expires_in_s) {
+    if (!ip || port <= 0 || !access_token || !access_token[0]) {
+        return SPOTIFY_CAST_LAUNCH_FAILED;
+    }
+
+    EventGroupHandle_t events = xEventGroupCreate();
+    ChromecastController *cast = new (std::nothrow) ChromecastController();
+    spotify_cast_launch_result_t result = SPOTIFY_CAST_LAUNCH_FAILED;
+    if (events && cast && cast->initialize()) {
+        result = launch(*cast, events, ip, port, access_token, expires_in_s);
+    }
+
+    // The receiver keeps running (and playing) after its sender goes away;
+    // deleting the controller also waits out a connect still in progress
+    delete cast;
+    if (events) {
+        vEventGroupDelete(events);
+    }
+    return result;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Spotify receiver app on a Cast device
+ *
+ * Playback can move straight to a speaker: the speaker runs Spotify's own
+ * Cast receiver, which streams from Spotify and shows up as a Spotify
+ * Connect device once it holds the user's access token. The ESP only
+ * launches it and hands it the token; afterwards it sends Web API control
+ * calls, no audio.
+ *
+ * With CONFIG_CAST_DEVICE_AUTH_REQUIRED the token only goes to a device
+ * that passed Cast device authentication on this connection (or matched a
+ * verified one in the NVS cache); without it any host on the LAN answering
+ * as a _googlecast service gets it.
+ *
+ * The launch uses a Cast connection of its own, opened for the handshake
+ * and closed once the receiver has the token, so the volume screen's
+ * connection is not disturbed. Blocks for up to
+ * SPOTIFY_CAST_CONNECT_TIMEOUT_MS + SPOTIFY_CAST_LAUNCH_TIMEOUT_MS +
+ * SPOTIFY_CAST_CREDENTIALS_TIMEOUT_MS; run it on a worker task.
+ */
+
+#define SPOTIFY_CAST_APP_ID                     "CC32E753"
+#define SPOTIFY_CAST_NAMESPACE                  "urn:x-cast:com.spotify.chromecast.secure.v1"
+#define SPOTIFY_CAST_CONNECT_TIMEOUT_MS         15000
+#define SPOTIFY_CAST_LAUNCH_TIMEOUT_MS          15000
+#define SPOTIFY_CAST_CREDENTIALS_TIMEOUT_MS     10000
+
+typedef enum {
+    SPOTIFY_CAST_LAUNCH_OK,                 // The receiver accepted the token
+    SPOTIFY_CAST_LAUNCH_FAILED,             // Connect, launch or the credentials exchange failed
+    SPOTIFY_CAST_LAUNCH_NOT_AUTHENTICATED,  // Device auth failed or did not complete: no token sent
+} spotify_cast_launch_result_t;
+
+/**
+ * @brief Launch the Spotify receiver on a Cast device and give it a token
+ *
+ * @param ip Address of the device (the leader's, for a group)
+ * @param port Its Cast port
+ * @param access_token Spotify access token
+ * @param expires_in_s Seconds the token is still valid for
+ * @return SPOTIFY_CAST_LAUNCH_OK once the receiver has accepted the token
+ */
+spotify_cast_launch_result_t spotify_cast_receiver_launch(const char *ip, int port, const char *access_token,
+                                                          uint32_t expires_in_s);
+
+#ifdef __cplusplus
+}
+#endif
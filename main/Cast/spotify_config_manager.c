@@ -1,7 +1,6 @@
 #include "spotify_config_manager.h"
+#include "config_store.h"
 #include "esp_log.h"
-#include "nvs_flash.h"
-#include "nvs.h"
 #include <string.h>
 
 static const char *TAG = "spotify_config";
@@ -20,14 +19,8 @@ esp_err_t spotify_config_manager_init(void) {
 
     ESP_LOGI(TAG, "Initializing Spotify configuration manager");
 
-    // Initialize NVS if not already done
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_LOGW(TAG, "NVS partition was truncated and needs to be erased");
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
-    }
-    
+    // Initialize the config store (and NVS under it) if not already done
+    esp_err_t ret = config_store_init();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize NVS: %s", esp_err_to_name(ret));
         return ret;
@@ -64,24 +57,18 @@ esp_err_t spotify_config_save(const spotify_config_t *config) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(SPOTIFY_CONFIG_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-
     bool success = true;
 
     // Save client ID
-    if (nvs_set_str(nvs_handle, SPOTIFY_CONFIG_CLIENT_ID_KEY, config->client_id) != ESP_OK) {
+    if (config_store_set_str(SPOTIFY_CONFIG_NAMESPACE, SPOTIFY_CONFIG_CLIENT_ID_KEY, config->client_id) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to save client ID");
         success = false;
     }
 
     // Save client secret (optional)
     if (success && strlen(config->client_secret) > 0) {
-        if (nvs_set_str(nvs_handle, SPOTIFY_CONFIG_CLIENT_SECRET_KEY, config->client_secret) != ESP_OK) {
+        if (config_store_set_str(SPOTIFY_CONFIG_NAMESPACE, SPOTIFY_CONFIG_CLIENT_SECRET_KEY,
+                                 config->client_secret) != ESP_OK) {
             ESP_LOGE(TAG, "Failed to save client secret");
             success = false;
         }
@@ -91,23 +78,16 @@ esp_err_t spotify_config_save(const spotify_config_t *config) {
     if (success) {
         const char* uri_to_save = strlen(config->redirect_uri) > 0 ? 
                                   config->redirect_uri : DEFAULT_REDIRECT_URI;
-        if (nvs_set_str(nvs_handle, SPOTIFY_CONFIG_REDIRECT_URI_KEY, uri_to_save) != ESP_OK) {
+        if (config_store_set_str(SPOTIFY_CONFIG_NAMESPACE, SPOTIFY_CONFIG_REDIRECT_URI_KEY, uri_to_save) != ESP_OK) {
             ESP_LOGE(TAG, "Failed to save redirect URI");
             success = false;
         }
     }
 
+    // Written to NVS behind, by the config store's task
     if (success) {
-        err = nvs_commit(nvs_handle);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to commit NVS: %s", esp_err_to_name(err));
-            success = false;
-        } else {
-            ESP_LOGI(TAG, "Successfully saved Spotify configuration");
-        }
+        ESP_LOGI(TAG, "Successfully saved Spotify configuration");
     }
-
-    nvs_close(nvs_handle);
     return success ? ESP_OK : ESP_FAIL;
 }
 
@@ -125,19 +105,13 @@ esp_err_t spotify_config_load(spotify_config_t *config) {
     // Initialize config structure
     memset(config, 0, sizeof(spotify_config_t));
 
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(SPOTIFY_CONFIG_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGD(TAG, "No Spotify configuration found (NVS namespace not found)");
-        return ESP_ERR_NOT_FOUND;
-    }
-
     size_t required_size;
     bool success = true;
 
     // Load client ID
     required_size = SPOTIFY_CLIENT_ID_MAX_LEN;
-    err = nvs_get_str(nvs_handle, SPOTIFY_CONFIG_CLIENT_ID_KEY, config->client_id, &required_size);
+    esp_err_t err = config_store_get_str(SPOTIFY_CONFIG_NAMESPACE, SPOTIFY_CONFIG_CLIENT_ID_KEY,
+                                         config->client_id, &required_size);
     if (err != ESP_OK) {
         ESP_LOGD(TAG, "No client ID found in configuration");
         success = false;
@@ -146,7 +120,8 @@ esp_err_t spotify_config_load(spotify_config_t *config) {
     // Load client secret (optional)
     if (success) {
         required_size = SPOTIFY_CLIENT_SECRET_MAX_LEN;
-        err = nvs_get_str(nvs_handle, SPOTIFY_CONFIG_CLIENT_SECRET_KEY, config->client_secret, &required_size);
+        err = config_store_get_str(SPOTIFY_CONFIG_NAMESPACE, SPOTIFY_CONFIG_CLIENT_SECRET_KEY,
+                                   config->client_secret, &required_size);
         if (err != ESP_OK) {
             ESP_LOGD(TAG, "No client secret found (using PKCE flow)");
             // Client secret is optional, so this is not an error
@@ -157,7 +132,8 @@ esp_err_t spotify_config_load(spotify_config_t *config) {
     // Load redirect URI
     if (success) {
         required_size = SPOTIFY_REDIRECT_URI_MAX_LEN;
-        err = nvs_get_str(nvs_handle, SPOTIFY_CONFIG_REDIRECT_URI_KEY, config->redirect_uri, &required_size);
+        err = config_store_get_str(SPOTIFY_CONFIG_NAMESPACE, SPOTIFY_CONFIG_REDIRECT_URI_KEY,
+                                   config->redirect_uri, &required_size);
         if (err != ESP_OK) {
             ESP_LOGD(TAG, "No redirect URI found, using default");
             strncpy(config->redirect_uri, DEFAULT_REDIRECT_URI, SPOTIFY_REDIRECT_URI_MAX_LEN - 1);
@@ -165,8 +141,6 @@ esp_err_t spotify_config_load(spotify_config_t *config) {
         }
     }
 
-    nvs_close(nvs_handle);
-
     if (success) {
         config->is_configured = true;
         ESP_LOGI(TAG, "Successfully loaded Spotify configuration");
@@ -189,22 +163,16 @@ esp_err_t spotify_config_clear(void) {
         return ESP_ERR_INVALID_STATE;
     }
 
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(SPOTIFY_CONFIG_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle for clearing: %s", esp_err_to_name(err));
-        return err;
+    esp_err_t err = config_store_erase_key(SPOTIFY_CONFIG_NAMESPACE, SPOTIFY_CONFIG_CLIENT_ID_KEY);
+    if (err == ESP_OK) {
+        err = config_store_erase_key(SPOTIFY_CONFIG_NAMESPACE, SPOTIFY_CONFIG_CLIENT_SECRET_KEY);
+    }
+    if (err == ESP_OK) {
+        err = config_store_erase_key(SPOTIFY_CONFIG_NAMESPACE, SPOTIFY_CONFIG_REDIRECT_URI_KEY);
     }
-
-    nvs_erase_key(nvs_handle, SPOTIFY_CONFIG_CLIENT_ID_KEY);
-    nvs_erase_key(nvs_handle, SPOTIFY_CONFIG_CLIENT_SECRET_KEY);
-    nvs_erase_key(nvs_handle, SPOTIFY_CONFIG_REDIRECT_URI_KEY);
-
-    err = nvs_commit(nvs_handle);
-    nvs_close(nvs_handle);
 
     if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Cleared Spotify configuration from NVS");
+        ESP_LOGI(TAG, "Cleared Spotify configuration");
     } else {
         ESP_LOGE(TAG, "Failed to clear Spotify configuration: %s", esp_err_to_name(err));
     }
@@ -12,7 +12,8 @@ extern "C" {
  * @brief Spotify Configuration Manager - Handles credential storage and retrieval
  * 
  * This component manages Spotify app credentials (Client ID, Client Secret, Redirect URI)
- * using NVS (Non-Volatile Storage) for persistent storage across reboots.
+ * using NVS (Non-Volatile Storage) for persistent storage across reboots. Reads and
+ * saves go through the config store (config_store.h): RAM at once, flash behind.
  */
 
 // Maximum lengths for Spotify credentials
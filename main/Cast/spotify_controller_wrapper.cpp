@@ -1,14 +1,120 @@
 #include "spotify_controller_wrapper.h"
+#include "spotify_album_art.h"
+#include "spotify_cast_receiver.h"
+#include "gui_event_bus.h"
 #include "spotify_controller.h"
 #include "spotify_auth.h"
+#include "spotify_media_store.h"
+#include "spotify_stream_parser.h"
+#include "mem_budget.h"
+#include "task_plan.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "lvgl.h"
+#include <atomic>
+#include <cstdlib>
 #include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
 
 static const char *TAG = "spotify_wrapper";
 
+// Worker task: every Spotify Web API call runs here instead of on the LVGL loop
+static constexpr uint32_t SPOTIFY_WORKER_STACK_SIZE = 8192;
+static constexpr UBaseType_t SPOTIFY_WORKER_PRIORITY = TASK_PLAN_SPOTIFY_WORKER_PRIORITY;
+static constexpr UBaseType_t SPOTIFY_COMMAND_QUEUE_LEN = 8;    // User commands
+static constexpr UBaseType_t SPOTIFY_POLL_QUEUE_LEN = 4;       // Background polling
+static constexpr uint32_t SPOTIFY_PERIODIC_INTERVAL_MS = 1000;
+static constexpr uint32_t SPOTIFY_WORKER_STOP_TIMEOUT_MS = 15000;
+static constexpr size_t SPOTIFY_MAX_DEFERRED = SPOTIFY_COMMAND_QUEUE_LEN + SPOTIFY_POLL_QUEUE_LEN;
+static constexpr int SPOTIFY_PLAYLIST_PAGE_SIZE = 20;
+static constexpr int SPOTIFY_TRACK_PAGE_SIZE = 50;
+static constexpr size_t SPOTIFY_SEARCH_CACHE_LEN = 6;          // Recent search result pages kept
+
+enum spotify_request_type_t : uint8_t {
+    SPOTIFY_REQ_CONNECT,
+    SPOTIFY_REQ_COMPLETE_AUTH,
+    SPOTIFY_REQ_PLAY,
+    SPOTIFY_REQ_PAUSE,
+    SPOTIFY_REQ_NEXT,
+    SPOTIFY_REQ_PREVIOUS,
+    SPOTIFY_REQ_SET_VOLUME,
+    SPOTIFY_REQ_SEEK,
+    SPOTIFY_REQ_PREWARM,
+    SPOTIFY_REQ_GET_PLAYLISTS,
+    SPOTIFY_REQ_GET_PLAYLIST_TRACKS,
+    SPOTIFY_REQ_SEARCH_TRACKS,
+    SPOTIFY_REQ_CAST,
+    SPOTIFY_REQ_PLAY_ON_DEVICE,
+    SPOTIFY_REQ_GET_PLAYBACK_STATE,
+    SPOTIFY_REQ_GET_DEVICES,
+    SPOTIFY_REQ_SET_DISPLAY_ACTIVE,
+    SPOTIFY_REQ_SET_IMAGE_SIZE,
+    SPOTIFY_REQ_GET_ALBUM_ART,
+    SPOTIFY_REQ_GET_THUMBNAIL,
+    SPOTIFY_REQ_LOOKUP_TRACK,
+    SPOTIFY_REQ_PERIODIC
+};
+
+// Cast device for SPOTIFY_REQ_CAST; only the name for SPOTIFY_REQ_PLAY_ON_DEVICE
+struct spotify_cast_target_t {
+    char ip[16];
+    int port;
+    char name[64];          // Its friendly name, which the receiver registers under
+};
+
+// Queued request; text and cast are heap-owned by the request and freed by the worker
+struct spotify_request_t {
+    spotify_request_type_t type;
+    uint8_t attempts;       // Sends so far (one retry after a 429)
+    int value;
+    int offset;             // First entry of a list page (0: a new list)
+    char* text;             // URI, playlist/track ID, search query, image URL or auth code
+    spotify_cast_target_t* cast;
+    uint32_t generation;    // Searches and thumbnails: stale once their generation moves on
+};
+
+// Latest-value-wins command (volume, seek): each update overwrites value and
+// only one request is queued at a time, which sends whatever value holds
+// when the worker gets to it, so a slider drag costs a request or two
+struct spotify_value_slot_t {
+    std::atomic<int> value;
+    std::atomic<bool> queued;
+};
+
+// First page of a recent search, so a query typed again (usually a prefix
+// the user backspaced to) is shown without a request
+struct spotify_search_cache_entry_t {
+    std::string query;
+    int limit;
+    std::shared_ptr<SpotifyMediaStore> store;
+    std::vector<spotify_track_view_t> views;
+    bool complete;
+};
+
 // Internal structure to hold C++ instance and callbacks
 struct spotify_controller_wrapper {
     SpotifyController* controller;
+
+    // Worker task and its two bounded queues (commands drain before polling)
+    TaskHandle_t worker_task;
+    QueueHandle_t command_queue;
+    QueueHandle_t poll_queue;
+    std::atomic<bool> worker_running;
+    std::atomic<bool> periodic_pending;
+    TickType_t last_periodic;
+    spotify_value_slot_t volume_slot;
+    spotify_value_slot_t seek_slot;
+
+    // Requests waiting for rate-limit budget, oldest first (worker only)
+    spotify_request_t deferred[SPOTIFY_MAX_DEFERRED];
+    size_t deferred_count;
+
     spotify_auth_state_callback_t auth_state_callback;
     spotify_connection_state_callback_t connection_state_callback;
     spotify_playback_state_callback_t playback_state_callback;
@@ -16,9 +122,60 @@ struct spotify_controller_wrapper {
     spotify_tracks_callback_t tracks_callback;
     spotify_devices_callback_t devices_callback;
     spotify_error_callback_t error_callback;
+    spotify_album_art_callback_t album_art_callback;
+    spotify_thumbnail_callback_t thumbnail_callback;
+    spotify_queue_callback_t queue_callback;
+    spotify_track_lookup_callback_t track_lookup_callback;
+    spotify_command_failed_callback_t command_failed_callback;
+
+    // Album art: size it is decoded for, and the URLs being fetched (LVGL
+    // thread only) so repeated playback updates do not queue them again
+    std::atomic<int> album_art_size;
+    std::vector<std::string> album_art_pending;
+
+    // List thumbnails: cancelling bumps the generation, which drops a queued
+    // request and aborts one being downloaded
+    std::atomic<uint32_t> thumbnail_generation;
+
+    // Lists currently handed to the GUI; only touched on the LVGL thread.
+    // The views point into the page stores, so both are kept together.
+    // Further pages are appended while they belong to the list shown.
+    std::vector<std::shared_ptr<SpotifyMediaStore>> gui_playlist_stores;
+    std::atomic<bool> playlists_delivered;     // A playlists page was posted
+    std::vector<spotify_playlist_view_t> gui_playlist_views;
+    bool gui_playlists_complete;
+    bool gui_playlists_loading;                // Next page requested
+    std::vector<std::shared_ptr<SpotifyMediaStore>> gui_track_stores;
+    std::vector<spotify_track_view_t> gui_track_views;
+    spotify_request_type_t gui_track_source_type;   // Playlist tracks or search
+    std::string gui_track_source;                  // Playlist ID or search query
+    int gui_track_page_size;
+    bool gui_tracks_complete;
+    bool gui_tracks_loading;
+    std::vector<SpotifyDevice> gui_devices;
+    std::vector<spotify_device_view_t> gui_device_views;
+
+    // Search as you type: each query bumps the generation, which drops or
+    // aborts older searches on the worker. The query and the cache (newest
+    // first) are LVGL thread only.
+    std::atomic<uint32_t> search_generation;
+    std::string gui_search_query;
+    std::vector<spotify_search_cache_entry_t> search_cache;
 };
 
 // Helper functions to convert between C++ and C structures
+static void convert_track(const SpotifyTrack& cpp_track, spotify_track_info_t* c_track) {
+    memset(c_track, 0, sizeof(spotify_track_info_t));
+    strncpy(c_track->id, cpp_track.id.c_str(), sizeof(c_track->id) - 1);
+    strncpy(c_track->name, cpp_track.name.c_str(), sizeof(c_track->name) - 1);
+    strncpy(c_track->artist, cpp_track.artist.c_str(), sizeof(c_track->artist) - 1);
+    strncpy(c_track->album, cpp_track.album.c_str(), sizeof(c_track->album) - 1);
+    strncpy(c_track->uri, cpp_track.uri.c_str(), sizeof(c_track->uri) - 1);
+    strncpy(c_track->preview_url, cpp_track.preview_url.c_str(), sizeof(c_track->preview_url) - 1);
+    strncpy(c_track->image_url, cpp_track.image_url.c_str(), sizeof(c_track->image_url) - 1);
+    c_track->duration_ms = cpp_track.duration_ms;
+}
+
 static void convert_playback_state(const SpotifyPlaybackState& cpp_state, spotify_playback_state_t* c_state) {
     if (!c_state) return;
     
@@ -34,14 +191,7 @@ static void convert_playback_state(const SpotifyPlaybackState& cpp_state, spotif
     strncpy(c_state->device_name, cpp_state.device_name.c_str(), sizeof(c_state->device_name) - 1);
     
     // Convert track info
-    strncpy(c_state->current_track.id, cpp_state.current_track.id.c_str(), sizeof(c_state->current_track.id) - 1);
-    strncpy(c_state->current_track.name, cpp_state.current_track.name.c_str(), sizeof(c_state->current_track.name) - 1);
-    strncpy(c_state->current_track.artist, cpp_state.current_track.artist.c_str(), sizeof(c_state->current_track.artist) - 1);
-    strncpy(c_state->current_track.album, cpp_state.current_track.album.c_str(), sizeof(c_state->current_track.album) - 1);
-    strncpy(c_state->current_track.uri, cpp_state.current_track.uri.c_str(), sizeof(c_state->current_track.uri) - 1);
-    strncpy(c_state->current_track.preview_url, cpp_state.current_track.preview_url.c_str(), sizeof(c_state->current_track.preview_url) - 1);
-    strncpy(c_state->current_track.image_url, cpp_state.current_track.image_url.c_str(), sizeof(c_state->current_track.image_url) - 1);
-    c_state->current_track.duration_ms = cpp_state.current_track.duration_ms;
+    convert_track(cpp_state.current_track, &c_state->current_track);
 }
 
 static spotify_auth_state_t convert_auth_state(SpotifyAuthState cpp_state) {
@@ -76,6 +226,674 @@ static spotify_connection_state_t convert_connection_state(SpotifyConnectionStat
     }
 }
 
+static spotify_command_t convert_command(SpotifyTransportCommand command) {
+    switch (command) {
+        case SpotifyTransportCommand::PLAY:
+            return SPOTIFY_COMMAND_PLAY;
+        case SpotifyTransportCommand::PAUSE:
+            return SPOTIFY_COMMAND_PAUSE;
+        case SpotifyTransportCommand::NEXT:
+            return SPOTIFY_COMMAND_NEXT;
+        case SpotifyTransportCommand::PREVIOUS:
+        default:
+            return SPOTIFY_COMMAND_PREVIOUS;
+    }
+}
+
+// Completion delivery: run fn on the LVGL thread via the GUI event bus
+static void gui_call_trampoline(void* user_data) {
+    std::function<void()>* fn = static_cast<std::function<void()>*>(user_data);
+    (*fn)();
+    delete fn;
+}
+
+static void post_to_gui(std::function<void()> fn) {
+    std::function<void()>* heap_fn = new(std::nothrow) std::function<void()>(std::move(fn));
+    if (!heap_fn) {
+        ESP_LOGE(TAG, "Out of memory posting Spotify completion to GUI");
+        return;
+    }
+    if (!gui_event_bus_post_call(gui_call_trampoline, heap_fn)) {
+        ESP_LOGE(TAG, "Failed to post Spotify completion to GUI");
+        delete heap_fn;
+    }
+}
+
+static std::shared_ptr<SpotifyMediaStore> new_media_store() {
+    std::shared_ptr<SpotifyMediaStore> store(new(std::nothrow) SpotifyMediaStore());
+    if (!store) {
+        ESP_LOGE(TAG, "Out of memory allocating Spotify media store");
+    }
+    return store;
+}
+
+// Hand a playlists page to the GUI. An empty (or failed, store == nullptr)
+// first page is dropped so the list the GUI is showing stays alive; a later
+// page is appended if the list has not been replaced since it was asked for.
+static void post_playlists(spotify_controller_wrapper* wrapper, std::shared_ptr<SpotifyMediaStore> store,
+                           int offset, bool complete) {
+    if (offset == 0 && (!store || store->playlist_count() == 0)) {
+        return;
+    }
+    if (offset == 0) {
+        wrapper->playlists_delivered = true;
+    }
+
+    std::vector<spotify_playlist_view_t> views(store ? store->playlist_count() : 0);
+    const SpotifyMediaStore::Playlist* records = store ? store->playlists() : nullptr;
+    for (size_t i = 0; i < views.size(); ++i) {
+        views[i].id = records[i].id;
+        views[i].name = records[i].name;
+        views[i].uri = records[i].uri;
+        views[i].image_url = records[i].image_url;
+        views[i].owner = records[i].owner;
+        views[i].track_count = records[i].track_count;
+    }
+
+    post_to_gui([wrapper, store, views = std::move(views), offset, complete]() mutable {
+        if (offset == 0) {
+            wrapper->gui_playlist_stores.clear();
+            wrapper->gui_playlist_views.clear();
+        } else {
+            wrapper->gui_playlists_loading = false;
+            if (!store || (size_t)offset != wrapper->gui_playlist_views.size()) {
+                return;
+            }
+        }
+
+        wrapper->gui_playlist_stores.push_back(std::move(store));
+        wrapper->gui_playlist_views.insert(wrapper->gui_playlist_views.end(), views.begin(), views.end());
+        wrapper->gui_playlists_complete = complete;
+        if (wrapper->playlists_callback) {
+            wrapper->playlists_callback(wrapper->gui_playlist_views.data(), wrapper->gui_playlist_views.size(), offset);
+        }
+    });
+}
+
+// Playlists page unchanged (304): show the page the GUI already holds again
+// without re-fetching or re-parsing it
+static void repost_playlists(spotify_controller_wrapper* wrapper) {
+    post_to_gui([wrapper]() {
+        if (!wrapper->gui_playlist_stores.empty() && wrapper->playlists_callback) {
+            wrapper->playlists_callback(wrapper->gui_playlist_views.data(), wrapper->gui_playlist_views.size(), 0);
+        }
+    });
+}
+
+// LVGL thread: remember a search's first page, newest first
+static void cache_search(spotify_controller_wrapper* wrapper, const std::string& query, int limit,
+                         const std::shared_ptr<SpotifyMediaStore>& store,
+                         const std::vector<spotify_track_view_t>& views, bool complete) {
+    std::vector<spotify_search_cache_entry_t>& cache = wrapper->search_cache;
+    for (auto it = cache.begin(); it != cache.end(); ++it) {
+        if (it->query == query && it->limit == limit) {
+            cache.erase(it);
+            break;
+        }
+    }
+    if (cache.size() >= SPOTIFY_SEARCH_CACHE_LEN) {
+        cache.pop_back();
+    }
+    cache.insert(cache.begin(), spotify_search_cache_entry_t{query, limit, store, views, complete});
+}
+
+// LVGL thread: hand a cached search page to the GUI as a new list
+static void show_cached_search(spotify_controller_wrapper* wrapper, const spotify_search_cache_entry_t& entry) {
+    wrapper->gui_track_stores.assign(1, entry.store);
+    wrapper->gui_track_views = entry.views;
+    wrapper->gui_track_source_type = SPOTIFY_REQ_SEARCH_TRACKS;
+    wrapper->gui_track_source = entry.query;
+    wrapper->gui_track_page_size = entry.limit;
+    wrapper->gui_tracks_complete = entry.complete;
+    wrapper->gui_tracks_loading = false;
+    if (wrapper->tracks_callback) {
+        wrapper->tracks_callback(wrapper->gui_track_views.data(), wrapper->gui_track_views.size(), 0);
+    }
+}
+
+// Same as post_playlists(); a later page must also be for the playlist or
+// query of the list shown. Search results are cached even when the user has
+// typed on, but only the latest query's are shown, empty ones included.
+static void post_tracks(spotify_controller_wrapper* wrapper, std::shared_ptr<SpotifyMediaStore> store,
+                        const spotify_request_t& request, int limit, bool complete) {
+    bool is_search = request.type == SPOTIFY_REQ_SEARCH_TRACKS;
+    if (request.offset == 0 && (!store || (store->track_count() == 0 && !is_search))) {
+        return;
+    }
+
+    std::vector<spotify_track_view_t> views(store ? store->track_count() : 0);
+    const SpotifyMediaStore::Track* records = store ? store->tracks() : nullptr;
+    for (size_t i = 0; i < views.size(); ++i) {
+        views[i].id = records[i].id;
+        views[i].name = records[i].name;
+        views[i].artist = records[i].artist;
+        views[i].album = records[i].album;
+        views[i].uri = records[i].uri;
+        views[i].image_url = records[i].image_url;
+        views[i].duration_ms = records[i].duration_ms;
+    }
+
+    post_to_gui([wrapper, store, views = std::move(views), type = request.type,
+                 source = std::string(request.text ? request.text : ""), offset = request.offset,
+                 limit, complete]() mutable {
+        if (offset == 0 && type == SPOTIFY_REQ_SEARCH_TRACKS) {
+            cache_search(wrapper, source, limit, store, views, complete);
+            if (source != wrapper->gui_search_query) {
+                return;
+            }
+        }
+        if (offset == 0) {
+            wrapper->gui_track_stores.clear();
+            wrapper->gui_track_views.clear();
+            wrapper->gui_track_source_type = type;
+            wrapper->gui_track_source = std::move(source);
+            wrapper->gui_track_page_size = limit;
+            wrapper->gui_tracks_loading = false;
+        } else {
+            if (type != wrapper->gui_track_source_type || source != wrapper->gui_track_source) {
+                return;
+            }
+            wrapper->gui_tracks_loading = false;
+            if (!store || (size_t)offset != wrapper->gui_track_views.size()) {
+                return;
+            }
+        }
+
+        wrapper->gui_track_stores.push_back(std::move(store));
+        wrapper->gui_track_views.insert(wrapper->gui_track_views.end(), views.begin(), views.end());
+        wrapper->gui_tracks_complete = complete;
+        if (wrapper->tracks_callback) {
+            wrapper->tracks_callback(wrapper->gui_track_views.data(), wrapper->gui_track_views.size(), offset);
+        }
+    });
+}
+
+// Download and decode album art on the worker, then cache it on the LVGL thread
+static bool fetch_album_art(spotify_controller_wrapper* wrapper, const char* image_url) {
+    spotify_album_art_buffer_t jpeg = {};
+    bool in_memory = true;
+    bool ok = wrapper->controller->fetch_image(image_url, [&jpeg, &in_memory](const char* data, size_t length) {
+        if (in_memory) {
+            in_memory = spotify_album_art_buffer_append(&jpeg, data, length);
+        }
+    });
+
+    lv_img_dsc_t* image = nullptr;
+    if (ok && in_memory) {
+        image = spotify_album_art_decode(jpeg.data, jpeg.size, (uint16_t)wrapper->album_art_size.load());
+    }
+    spotify_album_art_buffer_free(&jpeg);
+
+    post_to_gui([wrapper, url = std::string(image_url), image]() {
+        std::vector<std::string>& pending = wrapper->album_art_pending;
+        for (auto it = pending.begin(); it != pending.end(); ++it) {
+            if (*it == url) {
+                pending.erase(it);
+                break;
+            }
+        }
+
+        const lv_img_dsc_t* cached = nullptr;
+        char image_id[SPOTIFY_ALBUM_ART_ID_LEN];
+        if (image && spotify_album_art_image_id(url.c_str(), image_id, sizeof(image_id))) {
+            cached = spotify_album_art_cache_put(image_id, image);
+        } else {
+            spotify_album_art_free(image);
+        }
+
+        if (wrapper->album_art_callback) {
+            wrapper->album_art_callback(url.c_str(), cached);
+        }
+    });
+    return image != nullptr;
+}
+
+static void post_thumbnail(spotify_controller_wrapper* wrapper, const char* image_url, lv_img_dsc_t* image) {
+    post_to_gui([wrapper, url = std::string(image_url), image]() {
+        const lv_img_dsc_t* cached = nullptr;
+        char image_id[SPOTIFY_ALBUM_ART_ID_LEN];
+        if (image && spotify_album_art_image_id(url.c_str(), image_id, sizeof(image_id))) {
+            cached = spotify_album_art_thumb_cache_put(image_id, image);
+        } else {
+            spotify_album_art_free(image);
+        }
+
+        if (wrapper->thumbnail_callback) {
+            wrapper->thumbnail_callback(url.c_str(), cached);
+        }
+    });
+}
+
+// As fetch_album_art(), but given up on (between chunks) once cancelled
+static bool fetch_thumbnail(spotify_controller_wrapper* wrapper, const spotify_request_t& request) {
+    spotify_album_art_buffer_t jpeg = {};
+    bool in_memory = true;
+    uint32_t generation = request.generation;
+    bool ok = wrapper->controller->fetch_image(request.text, [&jpeg, &in_memory](const char* data, size_t length) {
+        if (in_memory) {
+            in_memory = spotify_album_art_buffer_append(&jpeg, data, length);
+        }
+    }, [wrapper, generation]() {
+        return wrapper->thumbnail_generation != generation;
+    });
+
+    lv_img_dsc_t* image = nullptr;
+    if (ok && in_memory) {
+        image = spotify_album_art_decode(jpeg.data, jpeg.size, (uint16_t)request.value);
+    }
+    spotify_album_art_buffer_free(&jpeg);
+
+    post_thumbnail(wrapper, request.text, image);
+    return image != nullptr || wrapper->thumbnail_generation != generation;  // Cancelled is not failed
+}
+
+// Hand the track to the batcher; the worker sends the batch once it is due
+static bool lookup_track(spotify_controller_wrapper* wrapper, const char* track_id) {
+    return wrapper->controller->lookup_track(track_id, [wrapper, id = std::string(track_id)](const SpotifyTrack* track) {
+        spotify_track_info_t c_track;
+        if (track) convert_track(*track, &c_track);
+        post_to_gui([wrapper, id, c_track, found = track != nullptr]() {
+            if (wrapper->track_lookup_callback) {
+                wrapper->track_lookup_callback(id.c_str(), found ? &c_track : nullptr);
+            }
+        });
+    });
+}
+
+// Start Spotify's receiver on the Cast device, then move playback to it. The
+// worker is busy for the whole handshake; later requests wait their turn.
+static bool cast_to_receiver(spotify_controller_wrapper* wrapper, const spotify_cast_target_t& cast, const char* track_uri) {
+    SpotifyController* controller = wrapper->controller;
+    std::string token;
+    uint32_t expires_in_s = 0;
+    if (!controller->get_access_token(token, expires_in_s)) {
+        ESP_LOGE(TAG, "No valid access token to hand to %s", cast.name);
+        return false;
+    }
+    spotify_cast_launch_result_t result = spotify_cast_receiver_launch(cast.ip, cast.port, token.c_str(), expires_in_s);
+    if (result == SPOTIFY_CAST_LAUNCH_NOT_AUTHENTICATED) {
+        // Not a genuine Cast device, or one that could not prove it: say so, not "try again"
+        post_to_gui([wrapper, message = std::string(cast.name) + ": device not authenticated"]() {
+            if (wrapper->error_callback) {
+                wrapper->error_callback(message.c_str());
+            }
+        });
+        return false;
+    }
+    if (result != SPOTIFY_CAST_LAUNCH_OK) {
+        ESP_LOGE(TAG, "Spotify receiver did not start on %s", cast.name);
+        return false;
+    }
+    return controller->cast_to_device(cast.name, track_uri);
+}
+
+// A search the user has typed past, or a thumbnail for rows scrolled away;
+// not worth its rate-limit budget or download
+static bool is_superseded(spotify_controller_wrapper* wrapper, const spotify_request_t& request) {
+    return (request.type == SPOTIFY_REQ_SEARCH_TRACKS && request.generation != wrapper->search_generation) ||
+           (request.type == SPOTIFY_REQ_GET_THUMBNAIL && request.generation != wrapper->thumbnail_generation);
+}
+
+static bool is_background_request(spotify_request_type_t type) {
+    return type == SPOTIFY_REQ_GET_PLAYBACK_STATE ||
+           type == SPOTIFY_REQ_GET_DEVICES ||
+           type == SPOTIFY_REQ_GET_ALBUM_ART ||
+           type == SPOTIFY_REQ_GET_THUMBNAIL ||
+           type == SPOTIFY_REQ_LOOKUP_TRACK ||
+           type == SPOTIFY_REQ_PERIODIC;
+}
+
+static void spotify_request_free(spotify_request_t& request) {
+    free(request.text);
+    free(request.cast);
+    request.text = nullptr;
+    request.cast = nullptr;
+}
+
+static bool spotify_enqueue(spotify_controller_wrapper* wrapper, spotify_request_type_t type,
+                            const char* text = nullptr, int value = 0, const spotify_cast_target_t* cast = nullptr,
+                            int offset = 0, uint32_t generation = 0) {
+    if (!wrapper->worker_task) {
+        ESP_LOGE(TAG, "Spotify worker not running, dropping request %d", type);
+        return false;
+    }
+
+    spotify_request_t request = {};
+    request.type = type;
+    request.value = value;
+    request.offset = offset;
+    request.generation = generation;
+    if (text) {
+        request.text = strdup(text);
+        if (!request.text) {
+            ESP_LOGE(TAG, "Out of memory queueing Spotify request %d", type);
+            return false;
+        }
+    }
+    if (cast) {
+        request.cast = static_cast<spotify_cast_target_t*>(malloc(sizeof(spotify_cast_target_t)));
+        if (!request.cast) {
+            ESP_LOGE(TAG, "Out of memory queueing Spotify request %d", type);
+            spotify_request_free(request);
+            return false;
+        }
+        *request.cast = *cast;
+    }
+
+    QueueHandle_t queue = is_background_request(type) ? wrapper->poll_queue : wrapper->command_queue;
+    if (xQueueSend(queue, &request, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Spotify %s queue full, dropping request %d",
+                 queue == wrapper->poll_queue ? "poll" : "command", type);
+        spotify_request_free(request);
+        return false;
+    }
+
+    xTaskNotifyGive(wrapper->worker_task);
+    return true;
+}
+
+static bool spotify_post_value(spotify_controller_wrapper* wrapper, spotify_value_slot_t& slot,
+                               spotify_request_type_t type, int value) {
+    slot.value = value;
+    if (slot.queued.exchange(true)) {
+        return true;    // The request already queued sends it
+    }
+    if (!spotify_enqueue(wrapper, type)) {
+        slot.queued = false;
+        return false;
+    }
+    return true;
+}
+
+// Cleared before the value is read: an update that arrives while this one
+// is being sent queues the next request
+static int spotify_take_value(spotify_value_slot_t& slot) {
+    slot.queued = false;
+    return slot.value;
+}
+
+// Rate-limit class of the Web API calls a request makes; false if it makes
+// none (or only auth calls) and is never deferred
+static bool request_rate_class(spotify_request_type_t type, SpotifyRateLimiter::EndpointClass* cls) {
+    switch (type) {
+        case SPOTIFY_REQ_PLAY:
+        case SPOTIFY_REQ_PAUSE:
+        case SPOTIFY_REQ_NEXT:
+        case SPOTIFY_REQ_PREVIOUS:
+        case SPOTIFY_REQ_SET_VOLUME:
+        case SPOTIFY_REQ_SEEK:
+        case SPOTIFY_REQ_GET_PLAYBACK_STATE:
+        case SPOTIFY_REQ_GET_DEVICES:
+            *cls = SpotifyRateLimiter::EndpointClass::PLAYER;
+            return true;
+        case SPOTIFY_REQ_GET_PLAYLISTS:
+        case SPOTIFY_REQ_GET_PLAYLIST_TRACKS:
+        case SPOTIFY_REQ_SEARCH_TRACKS:
+            *cls = SpotifyRateLimiter::EndpointClass::BROWSE;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static uint32_t request_delay_ms(spotify_controller_wrapper* wrapper, const spotify_request_t& request) {
+    SpotifyRateLimiter::EndpointClass cls;
+    if (!request_rate_class(request.type, &cls)) {
+        return 0;
+    }
+    return wrapper->controller->get_rate_limit_delay_ms(cls);
+}
+
+static bool spotify_run_request(spotify_controller_wrapper* wrapper, const spotify_request_t& request) {
+    SpotifyController* controller = wrapper->controller;
+    const char* text = request.text ? request.text : "";
+    std::shared_ptr<SpotifyMediaStore> store;
+    bool ok = true;
+
+    switch (request.type) {
+        case SPOTIFY_REQ_CONNECT:             ok = controller->connect(); break;
+        case SPOTIFY_REQ_COMPLETE_AUTH:       ok = controller->complete_authentication(text); break;
+        case SPOTIFY_REQ_PLAY:                ok = controller->play(text); break;
+        case SPOTIFY_REQ_PAUSE:               ok = controller->pause(); break;
+        case SPOTIFY_REQ_NEXT:                ok = controller->next_track(); break;
+        case SPOTIFY_REQ_PREVIOUS:            ok = controller->previous_track(); break;
+        case SPOTIFY_REQ_SET_VOLUME:          ok = controller->set_volume(spotify_take_value(wrapper->volume_slot)); break;
+        case SPOTIFY_REQ_SEEK:                ok = controller->seek_to_position(spotify_take_value(wrapper->seek_slot)); break;
+        case SPOTIFY_REQ_PREWARM:             controller->prewarm(); break;
+        case SPOTIFY_REQ_GET_PLAYLISTS: {
+            // Only accept a bare 304 for a first page the GUI already holds;
+            // otherwise the controller replays its cached copy into store
+            bool not_modified = false;
+            bool revalidate = request.offset == 0 && wrapper->playlists_delivered;
+            store = new_media_store();
+            ok = store && controller->get_user_playlists(*store, revalidate ? &not_modified : nullptr,
+                                                         SPOTIFY_PLAYLIST_PAGE_SIZE, request.offset);
+            if (ok && not_modified) repost_playlists(wrapper);
+            else post_playlists(wrapper, ok ? store : nullptr, request.offset,
+                                ok && store->playlist_count() < (size_t)SPOTIFY_PLAYLIST_PAGE_SIZE);
+            break;
+        }
+        case SPOTIFY_REQ_GET_PLAYLIST_TRACKS:
+        case SPOTIFY_REQ_SEARCH_TRACKS: {
+            // A page with fewer entries than asked for is the last one. A
+            // search is aborted as soon as a newer query comes in.
+            size_t page_items = 0;
+            bool is_search = request.type == SPOTIFY_REQ_SEARCH_TRACKS;
+            int limit = is_search ? request.value : SPOTIFY_TRACK_PAGE_SIZE;
+            store = new_media_store();
+            ok = store && (is_search
+                           ? controller->search_tracks(text, limit, *store, request.offset, &page_items,
+                                                       [wrapper, generation = request.generation]() {
+                                                           return wrapper->search_generation != generation;
+                                                       })
+                           : controller->get_playlist_tracks(text, *store, limit, request.offset, &page_items));
+            post_tracks(wrapper, ok ? store : nullptr, request, limit, ok && page_items < (size_t)limit);
+            if (!ok && is_superseded(wrapper, request)) {
+                ok = true;  // Aborted, not failed
+            }
+            break;
+        }
+        case SPOTIFY_REQ_CAST:                ok = request.cast && cast_to_receiver(wrapper, *request.cast, text); break;
+        case SPOTIFY_REQ_PLAY_ON_DEVICE:      ok = request.cast && controller->cast_to_device(request.cast->name, text); break;
+        case SPOTIFY_REQ_GET_PLAYBACK_STATE:  ok = controller->get_current_playback_state(); break;
+        case SPOTIFY_REQ_GET_DEVICES:         ok = controller->get_available_devices(); break;
+        case SPOTIFY_REQ_SET_DISPLAY_ACTIVE:  controller->set_display_active(request.value != 0); break;
+        case SPOTIFY_REQ_SET_IMAGE_SIZE:      controller->set_image_target(request.value); break;
+        case SPOTIFY_REQ_GET_ALBUM_ART:       ok = fetch_album_art(wrapper, text); break;
+        case SPOTIFY_REQ_GET_THUMBNAIL:       ok = request.text && fetch_thumbnail(wrapper, request); break;
+        case SPOTIFY_REQ_LOOKUP_TRACK:        ok = lookup_track(wrapper, text); break;
+        case SPOTIFY_REQ_PERIODIC:
+            wrapper->periodic_pending = false;
+            controller->run_periodic_tasks();
+            break;
+    }
+
+    if (!ok) {
+        ESP_LOGW(TAG, "Spotify request %d failed", request.type);
+    }
+    return ok;
+}
+
+static void spotify_defer_request(spotify_controller_wrapper* wrapper, spotify_request_t& request) {
+    if (wrapper->deferred_count >= SPOTIFY_MAX_DEFERRED) {
+        ESP_LOGW(TAG, "Too many rate-limited Spotify requests, dropping request %d", request.type);
+        // The next update queues its slot's request again
+        if (request.type == SPOTIFY_REQ_SET_VOLUME) wrapper->volume_slot.queued = false;
+        if (request.type == SPOTIFY_REQ_SEEK) wrapper->seek_slot.queued = false;
+        spotify_request_free(request);
+        return;
+    }
+    wrapper->deferred[wrapper->deferred_count++] = request;
+}
+
+// Send now if the request's endpoint class has budget, otherwise park it
+static void spotify_dispatch_request(spotify_controller_wrapper* wrapper, spotify_request_t& request) {
+    if (is_superseded(wrapper, request)) {
+        ESP_LOGD(TAG, "Dropping superseded request %d \"%s\"", request.type, request.text ? request.text : "");
+        if (request.type == SPOTIFY_REQ_GET_THUMBNAIL) {
+            post_thumbnail(wrapper, request.text ? request.text : "", nullptr);
+        } else {
+            post_tracks(wrapper, nullptr, request, request.value, false);
+        }
+        spotify_request_free(request);
+        return;
+    }
+    if (request_delay_ms(wrapper, request) > 0) {
+        spotify_defer_request(wrapper, request);
+        return;
+    }
+
+    request.attempts++;
+    bool ok = spotify_run_request(wrapper, request);
+
+    // Failed and now throttled: most likely a 429, so try once more after it
+    if (!ok && request.attempts == 1 && request_delay_ms(wrapper, request) > 0) {
+        spotify_defer_request(wrapper, request);
+        return;
+    }
+    spotify_request_free(request);
+}
+
+// Run the oldest deferred request whose class has budget again. Returns false
+// if none can run yet, with *wait_ticks set to the shortest remaining delay.
+static bool spotify_run_deferred(spotify_controller_wrapper* wrapper, TickType_t* wait_ticks) {
+    *wait_ticks = portMAX_DELAY;
+
+    for (size_t i = 0; i < wrapper->deferred_count; ++i) {
+        // Superseded searches are dispatched (and dropped) without waiting
+        const spotify_request_t& deferred = wrapper->deferred[i];
+        uint32_t delay = is_superseded(wrapper, deferred) ? 0 : request_delay_ms(wrapper, deferred);
+        if (delay == 0) {
+            spotify_request_t request = wrapper->deferred[i];
+            memmove(&wrapper->deferred[i], &wrapper->deferred[i + 1],
+                    (wrapper->deferred_count - i - 1) * sizeof(spotify_request_t));
+            wrapper->deferred_count--;
+            spotify_dispatch_request(wrapper, request);
+            return true;
+        }
+
+        TickType_t ticks = pdMS_TO_TICKS(delay);
+        if (ticks == 0) {
+            ticks = 1;
+        }
+        if (ticks < *wait_ticks) {
+            *wait_ticks = ticks;
+        }
+    }
+    return false;
+}
+
+static void spotify_worker_task(void* param) {
+    spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(param);
+    spotify_request_t request;
+
+    ESP_LOGI(TAG, "Spotify worker started");
+
+    while (wrapper->worker_running) {
+        // Requests held back by the rate limiter keep their place in line
+        TickType_t wait_ticks;
+        if (spotify_run_deferred(wrapper, &wait_ticks)) {
+            continue;
+        }
+
+        // User commands always go ahead of background polling, and
+        // background work waits in its queue while internal RAM is short
+        if (xQueueReceive(wrapper->command_queue, &request, 0) == pdTRUE) {
+            spotify_dispatch_request(wrapper, request);
+            continue;
+        }
+        bool background_held = uxQueueMessagesWaiting(wrapper->poll_queue) > 0 &&
+                               !mem_budget_admit(MEM_BUDGET_BACKGROUND, 0);
+        if (!background_held && xQueueReceive(wrapper->poll_queue, &request, 0) == pdTRUE) {
+            spotify_dispatch_request(wrapper, request);
+            continue;
+        }
+        if (background_held && wait_ticks > pdMS_TO_TICKS(MEM_BUDGET_RETRY_MS)) {
+            wait_ticks = pdMS_TO_TICKS(MEM_BUDGET_RETRY_MS);
+        }
+
+        // Batched lookups go out once their window has closed
+        uint32_t lookup_delay = wrapper->controller->get_lookup_delay_ms();
+        if (lookup_delay == 0) {
+            wrapper->controller->flush_lookups();
+            continue;
+        }
+        if (lookup_delay != UINT32_MAX) {
+            TickType_t ticks = pdMS_TO_TICKS(lookup_delay);
+            if (ticks == 0) {
+                ticks = 1;
+            }
+            if (ticks < wait_ticks) {
+                wait_ticks = ticks;
+            }
+        }
+        ulTaskNotifyTake(pdTRUE, wait_ticks);
+    }
+
+    // Drop whatever was still queued
+    while (xQueueReceive(wrapper->command_queue, &request, 0) == pdTRUE ||
+           xQueueReceive(wrapper->poll_queue, &request, 0) == pdTRUE) {
+        spotify_request_free(request);
+    }
+    for (size_t i = 0; i < wrapper->deferred_count; ++i) {
+        spotify_request_free(wrapper->deferred[i]);
+    }
+    wrapper->deferred_count = 0;
+    wrapper->periodic_pending = false;
+    wrapper->volume_slot.queued = false;
+    wrapper->seek_slot.queued = false;
+
+    ESP_LOGI(TAG, "Spotify worker stopped");
+    wrapper->worker_task = nullptr;
+    vTaskDelete(nullptr);
+}
+
+static bool spotify_start_worker(spotify_controller_wrapper* wrapper) {
+    if (wrapper->worker_task) {
+        return true;
+    }
+
+    if (!wrapper->command_queue) {
+        wrapper->command_queue = xQueueCreate(SPOTIFY_COMMAND_QUEUE_LEN, sizeof(spotify_request_t));
+    }
+    if (!wrapper->poll_queue) {
+        wrapper->poll_queue = xQueueCreate(SPOTIFY_POLL_QUEUE_LEN, sizeof(spotify_request_t));
+    }
+    if (!wrapper->command_queue || !wrapper->poll_queue) {
+        ESP_LOGE(TAG, "Failed to create Spotify request queues");
+        return false;
+    }
+
+    wrapper->worker_running = true;
+    if (xTaskCreate(spotify_worker_task, "spotify_worker", SPOTIFY_WORKER_STACK_SIZE,
+                    wrapper, SPOTIFY_WORKER_PRIORITY, &wrapper->worker_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create Spotify worker task");
+        wrapper->worker_running = false;
+        wrapper->worker_task = nullptr;
+        return false;
+    }
+    return true;
+}
+
+static void spotify_stop_worker(spotify_controller_wrapper* wrapper) {
+    if (!wrapper->worker_task) {
+        return;
+    }
+
+    wrapper->worker_running = false;
+    xTaskNotifyGive(wrapper->worker_task);
+
+    // Let an in-flight HTTPS request finish (bounded by its own timeout)
+    TickType_t start = xTaskGetTickCount();
+    while (wrapper->worker_task &&
+           (xTaskGetTickCount() - start) < pdMS_TO_TICKS(SPOTIFY_WORKER_STOP_TIMEOUT_MS)) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    if (wrapper->worker_task) {
+        ESP_LOGW(TAG, "Spotify worker did not stop in time");
+    }
+}
+
 // C API implementation
 spotify_controller_handle_t spotify_controller_create(void) {
     ESP_LOGI(TAG, "Creating Spotify controller");
@@ -93,6 +911,28 @@ spotify_controller_handle_t spotify_controller_create(void) {
         return nullptr;
     }
     
+    wrapper->worker_task = nullptr;
+    wrapper->command_queue = nullptr;
+    wrapper->poll_queue = nullptr;
+    wrapper->worker_running = false;
+    wrapper->periodic_pending = false;
+    wrapper->last_periodic = 0;
+    wrapper->volume_slot.value = 0;
+    wrapper->volume_slot.queued = false;
+    wrapper->seek_slot.value = 0;
+    wrapper->seek_slot.queued = false;
+    wrapper->deferred_count = 0;
+    wrapper->playlists_delivered = false;
+    wrapper->gui_playlists_complete = true;
+    wrapper->gui_playlists_loading = false;
+    wrapper->gui_track_source_type = SPOTIFY_REQ_GET_PLAYLIST_TRACKS;
+    wrapper->gui_track_page_size = SPOTIFY_TRACK_PAGE_SIZE;
+    wrapper->gui_tracks_complete = true;
+    wrapper->gui_tracks_loading = false;
+    wrapper->search_generation = 0;
+    wrapper->album_art_size = SpotifyStreamParser::DEFAULT_IMAGE_TARGET;
+    wrapper->thumbnail_generation = 0;
+    
     // Initialize callbacks to nullptr
     wrapper->auth_state_callback = nullptr;
     wrapper->connection_state_callback = nullptr;
@@ -101,6 +941,11 @@ spotify_controller_handle_t spotify_controller_create(void) {
     wrapper->tracks_callback = nullptr;
     wrapper->devices_callback = nullptr;
     wrapper->error_callback = nullptr;
+    wrapper->album_art_callback = nullptr;
+    wrapper->thumbnail_callback = nullptr;
+    wrapper->queue_callback = nullptr;
+    wrapper->track_lookup_callback = nullptr;
+    wrapper->command_failed_callback = nullptr;
     
     return wrapper;
 }
@@ -112,10 +957,19 @@ void spotify_controller_destroy(spotify_controller_handle_t handle) {
     
     spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
     
+    spotify_stop_worker(wrapper);
+    
     if (wrapper->controller) {
         delete wrapper->controller;
     }
     
+    if (wrapper->command_queue) {
+        vQueueDelete(wrapper->command_queue);
+    }
+    if (wrapper->poll_queue) {
+        vQueueDelete(wrapper->poll_queue);
+    }
+    
     delete wrapper;
 }
 
@@ -136,90 +990,126 @@ bool spotify_controller_initialize(spotify_controller_handle_t handle,
     bool result = wrapper->controller->initialize(client_id, client_secret_str, redirect_uri_str);
     
     if (result) {
-        // Set up C++ callbacks that will call C callbacks
+        // Set up C++ callbacks that will call C callbacks. They fire on the
+        // worker (or the auth callback server), so each one is converted here
+        // and handed to the LVGL thread through the GUI event bus.
         wrapper->controller->set_auth_state_callback([wrapper](SpotifyAuthState state) {
-            if (wrapper->auth_state_callback) {
-                wrapper->auth_state_callback(convert_auth_state(state));
-            }
+            spotify_auth_state_t c_state = convert_auth_state(state);
+            post_to_gui([wrapper, c_state]() {
+                if (wrapper->auth_state_callback) {
+                    wrapper->auth_state_callback(c_state);
+                }
+            });
         });
         
         wrapper->controller->set_connection_state_callback([wrapper](SpotifyConnectionState state) {
-            if (wrapper->connection_state_callback) {
-                wrapper->connection_state_callback(convert_connection_state(state));
-            }
+            spotify_connection_state_t c_state = convert_connection_state(state);
+            post_to_gui([wrapper, c_state]() {
+                if (wrapper->connection_state_callback) {
+                    wrapper->connection_state_callback(c_state);
+                }
+            });
         });
         
         wrapper->controller->set_playback_state_callback([wrapper](const SpotifyPlaybackState& state) {
-            if (wrapper->playback_state_callback) {
-                spotify_playback_state_t c_state;
-                convert_playback_state(state, &c_state);
-                wrapper->playback_state_callback(&c_state);
-            }
+            spotify_playback_state_t c_state;
+            convert_playback_state(state, &c_state);
+            post_to_gui([wrapper, c_state]() {
+                if (wrapper->playback_state_callback) {
+                    wrapper->playback_state_callback(&c_state);
+                }
+            });
         });
         
-        wrapper->controller->set_playlists_callback([wrapper](const std::vector<SpotifyPlaylist>& playlists) {
-            if (wrapper->playlists_callback && !playlists.empty()) {
-                // Convert to C array
-                spotify_playlist_info_t* c_playlists = new spotify_playlist_info_t[playlists.size()];
-                for (size_t i = 0; i < playlists.size(); ++i) {
-                    memset(&c_playlists[i], 0, sizeof(spotify_playlist_info_t));
-                    strncpy(c_playlists[i].id, playlists[i].id.c_str(), sizeof(c_playlists[i].id) - 1);
-                    strncpy(c_playlists[i].name, playlists[i].name.c_str(), sizeof(c_playlists[i].name) - 1);
-                    strncpy(c_playlists[i].description, playlists[i].description.c_str(), sizeof(c_playlists[i].description) - 1);
-                    strncpy(c_playlists[i].uri, playlists[i].uri.c_str(), sizeof(c_playlists[i].uri) - 1);
-                    strncpy(c_playlists[i].image_url, playlists[i].image_url.c_str(), sizeof(c_playlists[i].image_url) - 1);
-                    strncpy(c_playlists[i].owner, playlists[i].owner.c_str(), sizeof(c_playlists[i].owner) - 1);
-                    c_playlists[i].track_count = playlists[i].track_count;
+        wrapper->controller->set_queue_callback([wrapper](const SpotifyTrack* previous, const SpotifyTrack* next) {
+            spotify_track_info_t c_previous;
+            spotify_track_info_t c_next;
+            if (previous) convert_track(*previous, &c_previous);
+            if (next) convert_track(*next, &c_next);
+            post_to_gui([wrapper, c_previous, c_next, has_previous = previous != nullptr, has_next = next != nullptr]() {
+                if (wrapper->queue_callback) {
+                    wrapper->queue_callback(has_previous ? &c_previous : nullptr, has_next ? &c_next : nullptr);
                 }
-                wrapper->playlists_callback(c_playlists, playlists.size());
-                delete[] c_playlists;
+            });
+        });
+        
+        wrapper->controller->set_command_failed_callback([wrapper](SpotifyTransportCommand command) {
+            spotify_command_t c_command = convert_command(command);
+            post_to_gui([wrapper, c_command]() {
+                if (wrapper->command_failed_callback) {
+                    wrapper->command_failed_callback(c_command);
+                }
+            });
+        });
+        
+        // Lists requested through the C API stream straight into a store in
+        // spotify_run_request; these only see pages the controller fetches
+        // on its own (e.g. playlists after connecting)
+        wrapper->controller->set_playlists_callback([wrapper](const std::vector<SpotifyPlaylist>& playlists) {
+            if (playlists.empty()) {
+                return;
+            }
+            std::shared_ptr<SpotifyMediaStore> store = new_media_store();
+            if (!store) {
+                return;
             }
+            for (const SpotifyPlaylist& playlist : playlists) {
+                store->add_playlist(playlist);
+            }
+            post_playlists(wrapper, store);
         });
         
         wrapper->controller->set_tracks_callback([wrapper](const std::vector<SpotifyTrack>& tracks) {
-            if (wrapper->tracks_callback && !tracks.empty()) {
-                // Convert to C array
-                spotify_track_info_t* c_tracks = new spotify_track_info_t[tracks.size()];
-                for (size_t i = 0; i < tracks.size(); ++i) {
-                    memset(&c_tracks[i], 0, sizeof(spotify_track_info_t));
-                    strncpy(c_tracks[i].id, tracks[i].id.c_str(), sizeof(c_tracks[i].id) - 1);
-                    strncpy(c_tracks[i].name, tracks[i].name.c_str(), sizeof(c_tracks[i].name) - 1);
-                    strncpy(c_tracks[i].artist, tracks[i].artist.c_str(), sizeof(c_tracks[i].artist) - 1);
-                    strncpy(c_tracks[i].album, tracks[i].album.c_str(), sizeof(c_tracks[i].album) - 1);
-                    strncpy(c_tracks[i].uri, tracks[i].uri.c_str(), sizeof(c_tracks[i].uri) - 1);
-                    strncpy(c_tracks[i].preview_url, tracks[i].preview_url.c_str(), sizeof(c_tracks[i].preview_url) - 1);
-                    strncpy(c_tracks[i].image_url, tracks[i].image_url.c_str(), sizeof(c_tracks[i].image_url) - 1);
-                    c_tracks[i].duration_ms = tracks[i].duration_ms;
-                }
-                wrapper->tracks_callback(c_tracks, tracks.size());
-                delete[] c_tracks;
+            if (tracks.empty()) {
+                return;
             }
+            std::shared_ptr<SpotifyMediaStore> store = new_media_store();
+            if (!store) {
+                return;
+            }
+            for (const SpotifyTrack& track : tracks) {
+                store->add_track(track);
+            }
+            post_tracks(wrapper, store);
         });
         
         wrapper->controller->set_devices_callback([wrapper](const std::vector<SpotifyDevice>& devices) {
-            if (wrapper->devices_callback && !devices.empty()) {
-                // Convert to C array
-                spotify_device_info_t* c_devices = new spotify_device_info_t[devices.size()];
-                for (size_t i = 0; i < devices.size(); ++i) {
-                    memset(&c_devices[i], 0, sizeof(spotify_device_info_t));
-                    strncpy(c_devices[i].id, devices[i].id.c_str(), sizeof(c_devices[i].id) - 1);
-                    strncpy(c_devices[i].name, devices[i].name.c_str(), sizeof(c_devices[i].name) - 1);
-                    strncpy(c_devices[i].type, devices[i].type.c_str(), sizeof(c_devices[i].type) - 1);
-                    c_devices[i].is_active = devices[i].is_active;
-                    c_devices[i].is_private_session = devices[i].is_private_session;
-                    c_devices[i].is_restricted = devices[i].is_restricted;
-                    c_devices[i].volume_percent = devices[i].volume_percent;
-                }
-                wrapper->devices_callback(c_devices, devices.size());
-                delete[] c_devices;
+            if (devices.empty()) {
+                return;
             }
+            // The list is kept on the LVGL thread and the views point into it
+            post_to_gui([wrapper, devices]() mutable {
+                wrapper->gui_devices = std::move(devices);
+                wrapper->gui_device_views.resize(wrapper->gui_devices.size());
+                for (size_t i = 0; i < wrapper->gui_devices.size(); ++i) {
+                    const SpotifyDevice& device = wrapper->gui_devices[i];
+                    spotify_device_view_t& view = wrapper->gui_device_views[i];
+                    view.id = device.id.c_str();
+                    view.name = device.name.c_str();
+                    view.type = device.type.c_str();
+                    view.is_active = device.is_active;
+                    view.is_private_session = device.is_private_session;
+                    view.is_restricted = device.is_restricted;
+                    view.volume_percent = device.volume_percent;
+                }
+                if (wrapper->devices_callback) {
+                    wrapper->devices_callback(wrapper->gui_device_views.data(), wrapper->gui_device_views.size());
+                }
+            });
         });
         
         wrapper->controller->set_error_callback([wrapper](const std::string& error) {
-            if (wrapper->error_callback) {
-                wrapper->error_callback(error.c_str());
-            }
+            post_to_gui([wrapper, message = error]() {
+                if (wrapper->error_callback) {
+                    wrapper->error_callback(message.c_str());
+                }
+            });
         });
+        
+        if (!spotify_start_worker(wrapper)) {
+            wrapper->controller->deinitialize();
+            result = false;
+        }
     }
     
     return result;
@@ -229,6 +1119,7 @@ void spotify_controller_deinitialize(spotify_controller_handle_t handle) {
     if (!handle) return;
     
     spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
+    spotify_stop_worker(wrapper);
     wrapper->controller->deinitialize();
 }
 
@@ -257,7 +1148,7 @@ bool spotify_controller_complete_authentication(spotify_controller_handle_t hand
     if (!handle || !auth_code) return false;
     
     spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
-    return wrapper->controller->complete_authentication(auth_code);
+    return spotify_enqueue(wrapper, SPOTIFY_REQ_COMPLETE_AUTH, auth_code);
 }
 
 bool spotify_controller_is_authenticated(spotify_controller_handle_t handle) {
@@ -271,7 +1162,7 @@ bool spotify_controller_connect(spotify_controller_handle_t handle) {
     if (!handle) return false;
     
     spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
-    return wrapper->controller->connect();
+    return spotify_enqueue(wrapper, SPOTIFY_REQ_CONNECT);
 }
 
 void spotify_controller_disconnect(spotify_controller_handle_t handle) {
@@ -293,36 +1184,49 @@ bool spotify_controller_play(spotify_controller_handle_t handle, const char* uri
     if (!handle) return false;
 
     spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
-    std::string uri_str = uri ? uri : "";
-    return wrapper->controller->play(uri_str);
+    return spotify_enqueue(wrapper, SPOTIFY_REQ_PLAY, uri);
 }
 
 bool spotify_controller_pause(spotify_controller_handle_t handle) {
     if (!handle) return false;
 
     spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
-    return wrapper->controller->pause();
+    return spotify_enqueue(wrapper, SPOTIFY_REQ_PAUSE);
 }
 
 bool spotify_controller_next_track(spotify_controller_handle_t handle) {
     if (!handle) return false;
 
     spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
-    return wrapper->controller->next_track();
+    return spotify_enqueue(wrapper, SPOTIFY_REQ_NEXT);
 }
 
 bool spotify_controller_previous_track(spotify_controller_handle_t handle) {
     if (!handle) return false;
 
     spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
-    return wrapper->controller->previous_track();
+    return spotify_enqueue(wrapper, SPOTIFY_REQ_PREVIOUS);
 }
 
 bool spotify_controller_set_volume(spotify_controller_handle_t handle, int volume_percent) {
     if (!handle) return false;
 
     spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
-    return wrapper->controller->set_volume(volume_percent);
+    return spotify_post_value(wrapper, wrapper->volume_slot, SPOTIFY_REQ_SET_VOLUME, volume_percent);
+}
+
+bool spotify_controller_seek(spotify_controller_handle_t handle, int position_ms) {
+    if (!handle) return false;
+
+    spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
+    return spotify_post_value(wrapper, wrapper->seek_slot, SPOTIFY_REQ_SEEK, position_ms);
+}
+
+bool spotify_controller_prewarm(spotify_controller_handle_t handle) {
+    if (!handle) return false;
+
+    spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
+    return spotify_enqueue(wrapper, SPOTIFY_REQ_PREWARM);
 }
 
 // Content functions
@@ -330,44 +1234,116 @@ bool spotify_controller_get_playlists(spotify_controller_handle_t handle) {
     if (!handle) return false;
 
     spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
-    return wrapper->controller->get_user_playlists();
+    return spotify_enqueue(wrapper, SPOTIFY_REQ_GET_PLAYLISTS);
 }
 
 bool spotify_controller_get_playlist_tracks(spotify_controller_handle_t handle, const char* playlist_id) {
     if (!handle || !playlist_id) return false;
 
     spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
-    return wrapper->controller->get_playlist_tracks(playlist_id);
+    return spotify_enqueue(wrapper, SPOTIFY_REQ_GET_PLAYLIST_TRACKS, playlist_id);
 }
 
 bool spotify_controller_search_tracks(spotify_controller_handle_t handle, const char* query, int limit) {
     if (!handle || !query) return false;
 
     spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
-    return wrapper->controller->search_tracks(query, limit);
+    wrapper->gui_search_query = query;
+    uint32_t generation = ++wrapper->search_generation;
+
+    // Asked for recently: move it to the front and show it again, unless the
+    // user has typed on by the time the GUI gets to it
+    std::vector<spotify_search_cache_entry_t>& cache = wrapper->search_cache;
+    for (auto it = cache.begin(); it != cache.end(); ++it) {
+        if (it->query == query && it->limit == limit) {
+            spotify_search_cache_entry_t entry = *it;
+            cache.erase(it);
+            cache.insert(cache.begin(), entry);
+            post_to_gui([wrapper, generation, entry = std::move(entry)]() {
+                if (wrapper->search_generation == generation) {
+                    show_cached_search(wrapper, entry);
+                }
+            });
+            return true;
+        }
+    }
+
+    return spotify_enqueue(wrapper, SPOTIFY_REQ_SEARCH_TRACKS, query, limit, nullptr, 0, generation);
+}
+
+void spotify_controller_cancel_search(spotify_controller_handle_t handle) {
+    if (!handle) return;
+
+    spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
+    wrapper->gui_search_query.clear();
+    ++wrapper->search_generation;
+}
+
+bool spotify_controller_load_more_playlists(spotify_controller_handle_t handle) {
+    if (!handle) return false;
+
+    spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
+    if (wrapper->gui_playlist_stores.empty() || wrapper->gui_playlists_complete || wrapper->gui_playlists_loading) {
+        return false;
+    }
+
+    wrapper->gui_playlists_loading = spotify_enqueue(wrapper, SPOTIFY_REQ_GET_PLAYLISTS, nullptr, 0, nullptr,
+                                                     (int)wrapper->gui_playlist_views.size());
+    return wrapper->gui_playlists_loading;
+}
+
+bool spotify_controller_load_more_tracks(spotify_controller_handle_t handle) {
+    if (!handle) return false;
+
+    spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
+    if (wrapper->gui_track_stores.empty() || wrapper->gui_tracks_complete || wrapper->gui_tracks_loading) {
+        return false;
+    }
+
+    wrapper->gui_tracks_loading = spotify_enqueue(wrapper, wrapper->gui_track_source_type,
+                                                  wrapper->gui_track_source.c_str(), wrapper->gui_track_page_size,
+                                                  nullptr, (int)wrapper->gui_track_views.size(),
+                                                  wrapper->search_generation);
+    return wrapper->gui_tracks_loading;
 }
 
 bool spotify_controller_get_playback_state(spotify_controller_handle_t handle) {
     if (!handle) return false;
 
     spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
-    return wrapper->controller->get_current_playback_state();
+    return spotify_enqueue(wrapper, SPOTIFY_REQ_GET_PLAYBACK_STATE);
 }
 
 bool spotify_controller_get_devices(spotify_controller_handle_t handle) {
     if (!handle) return false;
 
     spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
-    return wrapper->controller->get_available_devices();
+    return spotify_enqueue(wrapper, SPOTIFY_REQ_GET_DEVICES);
 }
 
 bool spotify_controller_cast_to_chromecast(spotify_controller_handle_t handle,
-                                          const char* chromecast_ip,
-                                          const char* track_uri) {
-    if (!handle || !chromecast_ip || !track_uri) return false;
+                                          const char* chromecast_ip, int port,
+                                          const char* device_name, const char* track_uri) {
+    if (!handle || !chromecast_ip || port <= 0 || !device_name || !track_uri) return false;
+
+    spotify_cast_target_t cast = {};
+    strncpy(cast.ip, chromecast_ip, sizeof(cast.ip) - 1);
+    cast.port = port;
+    strncpy(cast.name, device_name, sizeof(cast.name) - 1);
+
+    spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
+    return spotify_enqueue(wrapper, SPOTIFY_REQ_CAST, track_uri, 0, &cast);
+}
+
+bool spotify_controller_play_on_device(spotify_controller_handle_t handle, const char* device_name,
+                                       const char* track_uri) {
+    if (!handle || !device_name || !track_uri) return false;
+
+    spotify_cast_target_t cast = {};
+    strncpy(cast.name, device_name, sizeof(cast.name) - 1);
 
     spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
-    return wrapper->controller->cast_to_chromecast(chromecast_ip, track_uri);
+    return spotify_enqueue(wrapper, SPOTIFY_REQ_PLAY_ON_DEVICE, track_uri, 0, &cast);
 }
 
 // Callback setters
@@ -427,6 +1403,116 @@ void spotify_controller_set_error_callback(spotify_controller_handle_t handle,
     wrapper->error_callback = callback;
 }
 
+void spotify_controller_set_album_art_callback(spotify_controller_handle_t handle,
+                                              spotify_album_art_callback_t callback) {
+    if (!handle) return;
+
+    spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
+    wrapper->album_art_callback = callback;
+}
+
+void spotify_controller_set_thumbnail_callback(spotify_controller_handle_t handle,
+                                              spotify_thumbnail_callback_t callback) {
+    if (!handle) return;
+
+    spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
+    wrapper->thumbnail_callback = callback;
+}
+
+void spotify_controller_set_queue_callback(spotify_controller_handle_t handle,
+                                          spotify_queue_callback_t callback) {
+    if (!handle) return;
+
+    spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
+    wrapper->queue_callback = callback;
+}
+
+void spotify_controller_set_command_failed_callback(spotify_controller_handle_t handle,
+                                                   spotify_command_failed_callback_t callback) {
+    if (!handle) return;
+
+    spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
+    wrapper->command_failed_callback = callback;
+}
+
+void spotify_controller_set_track_lookup_callback(spotify_controller_handle_t handle,
+                                                 spotify_track_lookup_callback_t callback) {
+    if (!handle) return;
+
+    spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
+    wrapper->track_lookup_callback = callback;
+}
+
+bool spotify_controller_set_album_art_size(spotify_controller_handle_t handle, int size_px) {
+    if (!handle || size_px <= 0) return false;
+
+    spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
+    wrapper->album_art_size = size_px;
+    return spotify_enqueue(wrapper, SPOTIFY_REQ_SET_IMAGE_SIZE, nullptr, size_px);
+}
+
+const lv_img_dsc_t* spotify_controller_get_album_art(spotify_controller_handle_t handle, const char* image_url) {
+    if (!handle || !image_url || !image_url[0]) return nullptr;
+
+    spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
+
+    char image_id[SPOTIFY_ALBUM_ART_ID_LEN];
+    if (!spotify_album_art_image_id(image_url, image_id, sizeof(image_id))) {
+        ESP_LOGW(TAG, "Unrecognised album art URL: %s", image_url);
+        return nullptr;
+    }
+
+    const lv_img_dsc_t* image = spotify_album_art_cache_get(image_id);
+    if (image) {
+        return image;
+    }
+    for (const std::string& pending : wrapper->album_art_pending) {
+        if (pending == image_url) {
+            return nullptr;
+        }
+    }
+
+    if (spotify_enqueue(wrapper, SPOTIFY_REQ_GET_ALBUM_ART, image_url)) {
+        wrapper->album_art_pending.push_back(image_url);
+    }
+    return nullptr;
+}
+
+const lv_img_dsc_t* spotify_controller_get_thumbnail(spotify_controller_handle_t handle, const char* image_url) {
+    if (!handle || !image_url || !image_url[0]) return nullptr;
+
+    char image_id[SPOTIFY_ALBUM_ART_ID_LEN];
+    if (!spotify_album_art_image_id(image_url, image_id, sizeof(image_id))) {
+        return nullptr;
+    }
+    return spotify_album_art_thumb_cache_get(image_id);
+}
+
+bool spotify_controller_fetch_thumbnail(spotify_controller_handle_t handle, const char* image_url, int size_px) {
+    if (!handle || !image_url || !image_url[0] || size_px <= 0) return false;
+
+    spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
+    return spotify_enqueue(wrapper, SPOTIFY_REQ_GET_THUMBNAIL, image_url, size_px, nullptr, 0,
+                           wrapper->thumbnail_generation);
+}
+
+void spotify_controller_cancel_thumbnail(spotify_controller_handle_t handle) {
+    if (!handle) return;
+
+    spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
+    ++wrapper->thumbnail_generation;
+    if (wrapper->worker_task) {
+        xTaskNotifyGive(wrapper->worker_task);   // A queued one is dropped sooner
+    }
+}
+
+bool spotify_controller_lookup_track(spotify_controller_handle_t handle, const char* track_id) {
+    if (!handle || !track_id || !track_id[0]) return false;
+
+    spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
+    return spotify_enqueue(wrapper, SPOTIFY_REQ_LOOKUP_TRACK, track_id);
+}
+
 // State getters
 spotify_auth_state_t spotify_controller_get_auth_state(spotify_controller_handle_t handle) {
     if (!handle) return SPOTIFY_AUTH_ERROR_STATE;
@@ -446,5 +1532,26 @@ void spotify_controller_run_periodic_tasks(spotify_controller_handle_t handle) {
     if (!handle) return;
 
     spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
-    wrapper->controller->run_periodic_tasks();
+
+    // Cheap enough for every loop iteration: at most one periodic request is
+    // queued per interval, and it runs on the worker
+    TickType_t now = xTaskGetTickCount();
+    if (wrapper->periodic_pending ||
+        (now - wrapper->last_periodic) < pdMS_TO_TICKS(SPOTIFY_PERIODIC_INTERVAL_MS)) {
+        return;
+    }
+    wrapper->last_periodic = now;
+
+    // Set before queueing: the worker clears it as soon as it picks the request up
+    wrapper->periodic_pending = true;
+    if (!spotify_enqueue(wrapper, SPOTIFY_REQ_PERIODIC)) {
+        wrapper->periodic_pending = false;
+    }
+}
+
+bool spotify_controller_set_display_active(spotify_controller_handle_t handle, bool active) {
+    if (!handle) return false;
+
+    spotify_controller_wrapper* wrapper = static_cast<spotify_controller_wrapper*>(handle);
+    return spotify_enqueue(wrapper, SPOTIFY_REQ_SET_DISPLAY_ACTIVE, nullptr, active ? 1 : 0);
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "esp_err.h"
+#include "lvgl.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -13,6 +14,13 @@ extern "C" {
  * 
  * This wrapper provides a C interface for the C++ SpotifyController class,
  * allowing integration with the existing C-based ESP Cast application.
+ *
+ * Calls that reach the Spotify Web API are queued to a dedicated worker task
+ * and return as soon as the request is queued. User commands (playback,
+ * browsing, casting) are served ahead of background polling. Requests over
+ * the client's rate budget (or during a 429 Retry-After) wait on the worker
+ * rather than blocking the caller. All callbacks are delivered on the LVGL
+ * thread through the GUI event bus (gui_event_bus.h).
  */
 
 /**
@@ -56,17 +64,35 @@ typedef struct {
 } spotify_track_info_t;
 
 /**
- * @brief Spotify playlist information (C struct)
+ * @brief Spotify track list entry (view into a controller-owned page)
+ *
+ * Strings are never NULL (missing fields are ""). The entry stays valid until
+ * a new track list is delivered; the array moves when a page is appended.
  */
 typedef struct {
-    char id[64];
-    char name[256];
-    char description[512];
-    char uri[256];
+    const char* id;
+    const char* name;
+    const char* artist;
+    const char* album;
+    const char* uri;
+    const char* image_url;
+    int duration_ms;
+} spotify_track_view_t;
+
+/**
+ * @brief Spotify playlist list entry (view into a controller-owned page)
+ *
+ * Strings are never NULL (missing fields are ""). The entry stays valid until
+ * a new playlist list is delivered; the array moves when a page is appended.
+ */
+typedef struct {
+    const char* id;
+    const char* name;
+    const char* uri;
+    const char* image_url;
+    const char* owner;
     int track_count;
-    char image_url[512];
-    char owner[128];
-} spotify_playlist_info_t;
+} spotify_playlist_view_t;
 
 /**
  * @brief Spotify playback state (C struct)
@@ -83,17 +109,30 @@ typedef struct {
 } spotify_playback_state_t;
 
 /**
- * @brief Spotify device information (C struct)
+ * @brief Playback command shown as done before Spotify confirms it
+ */
+typedef enum {
+    SPOTIFY_COMMAND_PLAY,
+    SPOTIFY_COMMAND_PAUSE,
+    SPOTIFY_COMMAND_NEXT,
+    SPOTIFY_COMMAND_PREVIOUS
+} spotify_command_t;
+
+/**
+ * @brief Spotify Connect device (view into the controller-owned device list)
+ *
+ * Strings are never NULL (missing fields are ""). The entry stays valid until
+ * a new device list is delivered.
  */
 typedef struct {
-    char id[64];
-    char name[256];
-    char type[64];
+    const char* id;
+    const char* name;
+    const char* type;
     bool is_active;
     bool is_private_session;
     bool is_restricted;
     int volume_percent;
-} spotify_device_info_t;
+} spotify_device_view_t;
 
 /**
  * @brief Callback function types
@@ -101,10 +140,23 @@ typedef struct {
 typedef void (*spotify_auth_state_callback_t)(spotify_auth_state_t state);
 typedef void (*spotify_connection_state_callback_t)(spotify_connection_state_t state);
 typedef void (*spotify_playback_state_callback_t)(const spotify_playback_state_t* state);
-typedef void (*spotify_playlists_callback_t)(const spotify_playlist_info_t* playlists, size_t count);
-typedef void (*spotify_tracks_callback_t)(const spotify_track_info_t* tracks, size_t count);
-typedef void (*spotify_devices_callback_t)(const spotify_device_info_t* devices, size_t count);
+// Lists arrive a page at a time: the array holds every entry loaded so far
+// and first_new is where the page just delivered starts (0: a new list)
+typedef void (*spotify_playlists_callback_t)(const spotify_playlist_view_t* playlists, size_t count, size_t first_new);
+typedef void (*spotify_tracks_callback_t)(const spotify_track_view_t* tracks, size_t count, size_t first_new);
+typedef void (*spotify_devices_callback_t)(const spotify_device_view_t* devices, size_t count);
 typedef void (*spotify_error_callback_t)(const char* error_message);
+// image is NULL if the download or decode failed
+typedef void (*spotify_album_art_callback_t)(const char* image_url, const lv_img_dsc_t* image);
+// image is NULL if the download failed or was cancelled
+typedef void (*spotify_thumbnail_callback_t)(const char* image_url, const lv_img_dsc_t* image);
+// Tracks either side of the one playing (NULL when not known), sent after each track change
+typedef void (*spotify_queue_callback_t)(const spotify_track_info_t* previous, const spotify_track_info_t* next);
+// track is NULL if Spotify does not know the ID or the lookup failed
+typedef void (*spotify_track_lookup_callback_t)(const char* track_id, const spotify_track_info_t* track);
+// A play/pause/skip already shown as done did not take; the playback state
+// callback has just been given the state it was rolled back to
+typedef void (*spotify_command_failed_callback_t)(spotify_command_t command);
 
 /**
  * @brief Create Spotify controller instance
@@ -164,7 +216,7 @@ bool spotify_controller_get_auth_url(spotify_controller_handle_t handle, char* u
  * 
  * @param handle Controller handle
  * @param auth_code Authorization code from callback
- * @return true on success, false on failure
+ * @return true if the request was queued, false if the queue is full
  */
 bool spotify_controller_complete_authentication(spotify_controller_handle_t handle, const char* auth_code);
 
@@ -180,7 +232,7 @@ bool spotify_controller_is_authenticated(spotify_controller_handle_t handle);
  * @brief Connect to Spotify
  * 
  * @param handle Controller handle
- * @return true on success, false on failure
+ * @return true if the request was queued, false if the queue is full
  */
 bool spotify_controller_connect(spotify_controller_handle_t handle);
 
@@ -202,9 +254,16 @@ bool spotify_controller_is_connected(spotify_controller_handle_t handle);
 /**
  * @brief Start/resume playback
  * 
+ * This and pause, next and previous are optimistic: the playback state
+ * callback gets the state the command should lead to as soon as the worker
+ * takes it up, before the request goes out. States Spotify reports before
+ * it has applied the command are held back for a few seconds; if the
+ * request fails, or nothing confirms it by then, the last reported state is
+ * restored and the command failed callback told.
+ * 
  * @param handle Controller handle
  * @param uri Optional URI to play (NULL for current context)
- * @return true on success, false on failure
+ * @return true if the request was queued, false if the queue is full
  */
 bool spotify_controller_play(spotify_controller_handle_t handle, const char* uri);
 
@@ -212,7 +271,7 @@ bool spotify_controller_play(spotify_controller_handle_t handle, const char* uri
  * @brief Pause playback
  * 
  * @param handle Controller handle
- * @return true on success, false on failure
+ * @return true if the request was queued, false if the queue is full
  */
 bool spotify_controller_pause(spotify_controller_handle_t handle);
 
@@ -220,7 +279,7 @@ bool spotify_controller_pause(spotify_controller_handle_t handle);
  * @brief Skip to next track
  * 
  * @param handle Controller handle
- * @return true on success, false on failure
+ * @return true if the request was queued, false if the queue is full
  */
 bool spotify_controller_next_track(spotify_controller_handle_t handle);
 
@@ -228,24 +287,51 @@ bool spotify_controller_next_track(spotify_controller_handle_t handle);
  * @brief Skip to previous track
  * 
  * @param handle Controller handle
- * @return true on success, false on failure
+ * @return true if the request was queued, false if the queue is full
  */
 bool spotify_controller_previous_track(spotify_controller_handle_t handle);
 
 /**
  * @brief Set playback volume
  * 
+ * Latest value wins: while one volume request is queued or deferred, further
+ * calls only replace the value it sends, so a slider can call this on every
+ * change. At most one is outstanding and the last value is always sent.
+ * 
  * @param handle Controller handle
  * @param volume_percent Volume percentage (0-100)
- * @return true on success, false on failure
+ * @return true if the value will be sent, false if the queue is full
  */
 bool spotify_controller_set_volume(spotify_controller_handle_t handle, int volume_percent);
 
+/**
+ * @brief Seek within the current track
+ * 
+ * Latest value wins, as spotify_controller_set_volume().
+ * 
+ * @param handle Controller handle
+ * @param position_ms Position from the start of the track
+ * @return true if the value will be sent, false if the queue is full
+ */
+bool spotify_controller_seek(spotify_controller_handle_t handle, int position_ms);
+
+/**
+ * @brief Get ready for a playback command that is about to follow
+ * 
+ * Queued ahead of background polling. Refreshes a token close to expiry and
+ * reopens a closed API connection, so the command that follows does not wait
+ * on either. Never deferred for rate limiting; a throttled warm-up is dropped.
+ * 
+ * @param handle Controller handle
+ * @return true if the request was queued, false if the queue is full
+ */
+bool spotify_controller_prewarm(spotify_controller_handle_t handle);
+
 /**
  * @brief Get user playlists
  * 
  * @param handle Controller handle
- * @return true on success, false on failure
+ * @return true if the request was queued, false if the queue is full
  */
 bool spotify_controller_get_playlists(spotify_controller_handle_t handle);
 
@@ -254,47 +340,101 @@ bool spotify_controller_get_playlists(spotify_controller_handle_t handle);
  * 
  * @param handle Controller handle
  * @param playlist_id Playlist ID
- * @return true on success, false on failure
+ * @return true if the request was queued, false if the queue is full
  */
 bool spotify_controller_get_playlist_tracks(spotify_controller_handle_t handle, const char* playlist_id);
 
 /**
  * @brief Search for tracks
  * 
+ * Meant to be called as the user types. A new search supersedes the last
+ * one: a queued older search is never sent, one in flight is aborted, and
+ * results for anything but the latest query are not delivered. Recent
+ * queries are answered from memory without a request. Unlike playlist
+ * tracks, a search with no matches is delivered as an empty list.
+ * LVGL thread only.
+ * 
  * @param handle Controller handle
  * @param query Search query
  * @param limit Maximum number of results
- * @return true on success, false on failure
+ * @return true if the request was queued or answered from the cache, false
+ *         if the queue is full
  */
 bool spotify_controller_search_tracks(spotify_controller_handle_t handle, const char* query, int limit);
 
+/**
+ * @brief Abandon the last search, e.g. when the search field is cleared
+ * 
+ * Its results are no longer delivered. LVGL thread only.
+ * 
+ * @param handle Controller handle
+ */
+void spotify_controller_cancel_search(spotify_controller_handle_t handle);
+
+/**
+ * @brief Load the next page of the playlist or track list last delivered
+ * 
+ * The page is appended and the list callback called again. LVGL thread only.
+ * 
+ * @param handle Controller handle
+ * @return true if the page was requested, false if the list is complete, a
+ *         page is already loading or the queue is full
+ */
+bool spotify_controller_load_more_playlists(spotify_controller_handle_t handle);
+bool spotify_controller_load_more_tracks(spotify_controller_handle_t handle);
+
 /**
  * @brief Get current playback state
  * 
  * @param handle Controller handle
- * @return true on success, false on failure
+ * @return true if the request was queued, false if the queue is full
  */
 bool spotify_controller_get_playback_state(spotify_controller_handle_t handle);
 
 /**
  * @brief Get available devices
  * 
+ * Answered from the controller's cache while it is fresh: it is fetched
+ * again after a transfer, once playback moves to a device it does not show
+ * as active, or after a minute.
+ * 
  * @param handle Controller handle
- * @return true on success, false on failure
+ * @return true if the request was queued, false if the queue is full
  */
 bool spotify_controller_get_devices(spotify_controller_handle_t handle);
 
 /**
  * @brief Cast to Chromecast device
  * 
+ * Launches Spotify's receiver on the device, hands it the access token,
+ * waits for it to join Spotify Connect and transfers playback to it (see
+ * spotify_cast_receiver.h). Audio then streams from Spotify to the speaker.
+ * Failures are reported through the error callback.
+ * 
  * @param handle Controller handle
  * @param chromecast_ip Chromecast device IP address
- * @param track_uri Spotify track URI to cast
- * @return true on success, false on failure
+ * @param port Its Cast port
+ * @param device_name Its friendly name, as Spotify Connect will list it
+ * @param track_uri Spotify track URI to start there, "" to carry on what is playing
+ * @return true if the request was queued, false if the queue is full
  */
 bool spotify_controller_cast_to_chromecast(spotify_controller_handle_t handle, 
-                                          const char* chromecast_ip, 
-                                          const char* track_uri);
+                                          const char* chromecast_ip, int port,
+                                          const char* device_name, const char* track_uri);
+
+/**
+ * @brief Move playback to a device already in Spotify Connect
+ * 
+ * For a speaker or app Spotify lists itself, with no receiver to launch.
+ * Failures are reported through the error callback.
+ * 
+ * @param handle Controller handle
+ * @param device_name Its name as the devices callback gave it
+ * @param track_uri Spotify track URI to start there, "" to carry on what is playing
+ * @return true if the request was queued, false if the queue is full
+ */
+bool spotify_controller_play_on_device(spotify_controller_handle_t handle, const char* device_name,
+                                       const char* track_uri);
 
 /**
  * @brief Set callback functions
@@ -313,6 +453,92 @@ void spotify_controller_set_devices_callback(spotify_controller_handle_t handle,
                                             spotify_devices_callback_t callback);
 void spotify_controller_set_error_callback(spotify_controller_handle_t handle, 
                                           spotify_error_callback_t callback);
+void spotify_controller_set_album_art_callback(spotify_controller_handle_t handle,
+                                              spotify_album_art_callback_t callback);
+void spotify_controller_set_thumbnail_callback(spotify_controller_handle_t handle,
+                                              spotify_thumbnail_callback_t callback);
+void spotify_controller_set_queue_callback(spotify_controller_handle_t handle,
+                                          spotify_queue_callback_t callback);
+void spotify_controller_set_track_lookup_callback(spotify_controller_handle_t handle,
+                                                 spotify_track_lookup_callback_t callback);
+void spotify_controller_set_command_failed_callback(spotify_controller_handle_t handle,
+                                                   spotify_command_failed_callback_t callback);
+
+/**
+ * @brief Set the size album art is shown at
+ * 
+ * Image variants are chosen (smallest at least this wide) and decoded
+ * (scaled down as far as possible without going below it) for this size.
+ * 
+ * @param handle Controller handle
+ * @param size_px Width/height of the album art widget in pixels
+ * @return true if the request was queued, false if the queue is full
+ */
+bool spotify_controller_set_album_art_size(spotify_controller_handle_t handle, int size_px);
+
+/**
+ * @brief Get decoded album art for an image URL
+ * 
+ * Returns a recently decoded image straight from the PSRAM cache. Otherwise
+ * the JPEG is downloaded and decoded on the worker and the album art
+ * callback is called once it is ready. LVGL thread only. The image stays
+ * valid while it is among the most recently requested covers
+ * (SPOTIFY_ALBUM_ART_CACHE_SIZE), so call this again each time it is shown.
+ * 
+ * @param handle Controller handle
+ * @param image_url Spotify image URL (e.g. spotify_track_info_t::image_url)
+ * @return Cached image, or NULL if it is being fetched
+ */
+const lv_img_dsc_t* spotify_controller_get_album_art(spotify_controller_handle_t handle, const char* image_url);
+
+/**
+ * @brief Get a decoded list row thumbnail, if it is cached
+ * 
+ * Unlike spotify_controller_get_album_art() this never downloads; see
+ * spotify_controller_fetch_thumbnail(). LVGL thread only. The image stays
+ * valid while it is among the SPOTIFY_ALBUM_ART_THUMB_CACHE_SIZE most
+ * recently requested thumbnails.
+ * 
+ * @param handle Controller handle
+ * @param image_url Spotify image URL of a playlist or track
+ * @return Cached image or NULL
+ */
+const lv_img_dsc_t* spotify_controller_get_thumbnail(spotify_controller_handle_t handle, const char* image_url);
+
+/**
+ * @brief Download and decode a list row thumbnail on the worker
+ * 
+ * Queued as background work. The thumbnail callback gets the result, or
+ * NULL if it failed or was cancelled, on the LVGL thread.
+ * 
+ * @param handle Controller handle
+ * @param image_url Spotify image URL
+ * @param size_px Size the thumbnail is shown at
+ * @return true if the request was queued
+ */
+bool spotify_controller_fetch_thumbnail(spotify_controller_handle_t handle, const char* image_url, int size_px);
+
+/**
+ * @brief Cancel every thumbnail fetch queued or running
+ * 
+ * A download in progress stops at its next chunk. Each cancelled fetch
+ * still calls the thumbnail callback, with NULL.
+ * 
+ * @param handle Controller handle
+ */
+void spotify_controller_cancel_thumbnail(spotify_controller_handle_t handle);
+
+/**
+ * @brief Look up one track by ID
+ * 
+ * Lookups made within a short window are sent together as a single
+ * /tracks?ids= call; each result goes to the track lookup callback.
+ * 
+ * @param handle Controller handle
+ * @param track_id Spotify track ID
+ * @return true if the lookup was queued, false if the queue is full
+ */
+bool spotify_controller_lookup_track(spotify_controller_handle_t handle, const char* track_id);
 
 /**
  * @brief Get current state
@@ -323,10 +549,27 @@ spotify_connection_state_t spotify_controller_get_connection_state(spotify_contr
 /**
  * @brief Run periodic tasks (call from main loop)
  * 
+ * Queues at most one background request per second for token refresh and
+ * playback polling; it never blocks on the network. Playback state is only
+ * fetched when the adaptive schedule is due (track end, after a command, or
+ * every 30-60 s while paused).
+ * 
  * @param handle Controller handle
  */
 void spotify_controller_run_periodic_tasks(spotify_controller_handle_t handle);
 
+/**
+ * @brief Tell the controller whether the display is on
+ * 
+ * Playback polling stops while the display is off and resyncs as soon as it
+ * comes back on.
+ * 
+ * @param handle Controller handle
+ * @param active true when the display is on
+ * @return true if the request was queued, false if the queue is full
+ */
+bool spotify_controller_set_display_active(spotify_controller_handle_t handle, bool active);
+
 #ifdef __cplusplus
 }
 #endif
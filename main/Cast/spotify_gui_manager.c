@@ -1,13 +1,68 @@
 #include "spotify_gui_manager.h"
 #include "spotify_config_manager.h"
+#include "now_playing_store.h"
+#include "spotify_library_snapshot.h"
+#include "spotify_thumbnails.h"
+#include "ui_layer_cache.h"
+#include "ui_prerender.h"
+#include "ui_widget_pool.h"
+#include "control_api.h"
+#include "voice_vocabulary.h"
+#include "LVGL_Scroll.h"
 #include "esp_cast.h"
 #include "esp_log.h"
 #include "esp_err.h"
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 static const char *TAG = "spotify_gui_manager";
 
+// Album art is decoded for (and shown at) this size on the now playing screen
+#define SPOTIFY_GUI_ALBUM_ART_SIZE 150
+#define SPOTIFY_GUI_PREVIOUS_RESTART_MS 3000   // Past this, "previous" restarts the track
+#define SPOTIFY_GUI_FAILED_FLASH_MS 800         // A command that did not take tints its control this long
+
+// Playlist and track lists: a fixed pool of rows is re-bound to whatever is
+// scrolled into view, and the next page is requested near the end
+#define SPOTIFY_GUI_LIST_ROW_HEIGHT 44
+#define SPOTIFY_GUI_LIST_POOL_ROWS 16      // More than fit on screen
+#define SPOTIFY_GUI_LIST_LOAD_AHEAD 10     // Rows left below the pool that trigger the next page
+#define SPOTIFY_GUI_LIST_NO_ITEM SIZE_MAX
+#define SPOTIFY_GUI_LIST_THUMB_LOOK_AHEAD 2    // Rows either side of the view whose covers are fetched
+#define SPOTIFY_GUI_LIST_THUMB_GAP 6
+
+// Search as you type: the query goes out once typing pauses this long
+#define SPOTIFY_GUI_SEARCH_DEBOUNCE_MS 300
+#define SPOTIFY_GUI_SEARCH_LIMIT 20
+
+// Screens are built on first use and kept, hidden, while another one shows.
+// Before a new one is built with less than this left in the LVGL pool, the
+// hidden ones are deleted; they are rebuilt when next shown.
+#define SPOTIFY_GUI_SCREEN_EVICT_FREE_BYTES (12 * 1024)
+
+// Speakers offered when a track is cast: Cast devices, then Spotify Connect ones
+#define SPOTIFY_GUI_CAST_DEVICES_MAX 8
+
+typedef void (*spotify_gui_list_bind_t)(lv_obj_t *label, size_t index);
+typedef const char *(*spotify_gui_list_image_t)(size_t index);
+typedef bool (*spotify_gui_list_load_more_t)(void);
+
+typedef struct {
+    lv_obj_t *container;
+    lv_obj_t *end_marker;   // Sizes the scrollable content to every item
+    lv_obj_t *rows[SPOTIFY_GUI_LIST_POOL_ROWS];
+    lv_obj_t *labels[SPOTIFY_GUI_LIST_POOL_ROWS];
+    lv_obj_t *images[SPOTIFY_GUI_LIST_POOL_ROWS];
+    size_t bound[SPOTIFY_GUI_LIST_POOL_ROWS];  // Item shown by each row
+    size_t count;
+    size_t view_first;      // Rows in view when the thumbnails were last set
+    size_t view_end;
+    spotify_gui_list_bind_t bind;
+    spotify_gui_list_image_t image_url;
+    spotify_gui_list_load_more_t load_more;
+} spotify_gui_virtual_list_t;
+
 // Forward declarations for callback functions
 static void config_save_button_cb(lv_event_t *e);
 static void config_cancel_button_cb(lv_event_t *e);
@@ -15,6 +70,8 @@ static void track_play_button_cb(lv_event_t *e);
 static void track_cast_button_cb(lv_event_t *e);
 static void chromecast_device_button_cb(lv_event_t *e);
 static void close_modal_button_cb(lv_event_t *e);
+static void show_current_screen(void);
+static void player_predict_listener(const now_playing_state_t *state, uint32_t changed);
 
 // GUI state
 typedef struct {
@@ -26,7 +83,9 @@ typedef struct {
     lv_obj_t *loading_spinner;
     lv_obj_t *error_modal;
     spotify_controller_handle_t controller_handle;
-    spotify_gui_screen_t current_screen_type;
+    spotify_gui_screen_t current_screen_type;   // Also while the tab is unloaded: shown when it is built
+    bool show_search_bar;
+    char status_text[128];                      // Kept while the tab is unloaded
     
     // Screen containers
     lv_obj_t *config_screen;
@@ -35,6 +94,25 @@ typedef struct {
     lv_obj_t *tracks_screen;
     lv_obj_t *player_screen;
     lv_obj_t *search_screen;
+    lv_obj_t *unconfigured_screen;
+
+    // Tracks screen elements
+    lv_obj_t *tracks_title;
+    char tracks_title_text[64];
+
+    // Now playing screen elements
+    lv_obj_t *player_art;
+    lv_obj_t *player_title;
+    lv_obj_t *player_artist;
+    lv_obj_t *player_play_label;
+    lv_timer_t *failed_flash_timer;
+    bool failed_flash_title;    // Tinting the title (a skip), else the play button
+    ui_prerender_t player_prerender;    // Built and drawn ahead once a track starts
+    
+    // Search screen elements; results use search_list
+    lv_obj_t *search_textarea;
+    lv_obj_t *search_status;
+    lv_timer_t *search_timer;   // Debounce, paused while nothing is typed
 
     // Configuration screen elements
     lv_obj_t *client_id_textarea;
@@ -42,10 +120,34 @@ typedef struct {
     lv_obj_t *redirect_uri_textarea;
     
     // Current data
-    const spotify_playlist_info_t *current_playlists;
+    const spotify_playlist_view_t *current_playlists;
     size_t current_playlist_count;
-    const spotify_track_info_t *current_tracks;
+    const spotify_track_view_t *current_tracks;
     size_t current_track_count;
+    spotify_gui_virtual_list_t playlist_list;
+    spotify_gui_virtual_list_t track_list;
+    spotify_gui_virtual_list_t search_list;
+    spotify_playback_state_t playback;
+    bool has_playback;
+
+    // Tracks either side of the current one, for instant skips
+    spotify_track_info_t previous_track;
+    spotify_track_info_t next_track;
+    bool has_previous_track;
+    bool has_next_track;
+
+    // The track and speakers of the action and speaker modals; a new page
+    // may replace the track views while one is open
+    char modal_track_uri[256];
+    char modal_devices[SPOTIFY_GUI_CAST_DEVICES_MAX][64];
+    bool modal_device_connect[SPOTIFY_GUI_CAST_DEVICES_MAX];    // Already in Connect: no receiver to launch
+    size_t modal_device_count;
+    ui_modal_t *device_modal;
+    lv_obj_t *device_list;
+
+    // Spotify Connect devices as last reported, for the speaker modal
+    char connect_devices[SPOTIFY_GUI_CAST_DEVICES_MAX][64];
+    size_t connect_device_count;
 } spotify_gui_state_t;
 
 static spotify_gui_state_t g_gui_state = {0};
@@ -58,6 +160,7 @@ static void play_button_cb(lv_event_t *e);
 static void pause_button_cb(lv_event_t *e);
 static void next_button_cb(lv_event_t *e);
 static void prev_button_cb(lv_event_t *e);
+static void play_pause_button_cb(lv_event_t *e);
 static void search_button_cb(lv_event_t *e);
 static void back_button_cb(lv_event_t *e);
 
@@ -65,10 +168,13 @@ static void back_button_cb(lv_event_t *e);
 static void spotify_auth_state_callback(spotify_auth_state_t state);
 static void spotify_connection_state_callback(spotify_connection_state_t state);
 static void spotify_playback_state_callback(const spotify_playback_state_t* state);
-static void spotify_playlists_callback(const spotify_playlist_info_t* playlists, size_t count);
-static void spotify_tracks_callback(const spotify_track_info_t* tracks, size_t count);
-static void spotify_devices_callback(const spotify_device_info_t* devices, size_t count);
+static void spotify_playlists_callback(const spotify_playlist_view_t* playlists, size_t count, size_t first_new);
+static void spotify_tracks_callback(const spotify_track_view_t* tracks, size_t count, size_t first_new);
+static void spotify_devices_callback(const spotify_device_view_t* devices, size_t count);
 static void spotify_error_callback(const char* error_message);
+static void spotify_album_art_callback(const char* image_url, const lv_img_dsc_t* image);
+static void spotify_queue_callback(const spotify_track_info_t* previous, const spotify_track_info_t* next);
+static void spotify_command_failed_callback(spotify_command_t command);
 
 esp_err_t spotify_gui_manager_init(const spotify_gui_config_t *config) {
     if (g_gui_state.initialized) {
@@ -90,15 +196,28 @@ esp_err_t spotify_gui_manager_init(const spotify_gui_config_t *config) {
         spotify_controller_set_tracks_callback(g_gui_state.controller_handle, spotify_tracks_callback);
         spotify_controller_set_devices_callback(g_gui_state.controller_handle, spotify_devices_callback);
         spotify_controller_set_error_callback(g_gui_state.controller_handle, spotify_error_callback);
+        spotify_controller_set_album_art_callback(g_gui_state.controller_handle, spotify_album_art_callback);
+        spotify_controller_set_queue_callback(g_gui_state.controller_handle, spotify_queue_callback);
+        spotify_controller_set_command_failed_callback(g_gui_state.controller_handle, spotify_command_failed_callback);
+        spotify_controller_set_album_art_size(g_gui_state.controller_handle, SPOTIFY_GUI_ALBUM_ART_SIZE);
+        spotify_thumbnails_init(g_gui_state.controller_handle);
     }
 
     // Initialize state
     g_gui_state.current_screen_type = SPOTIFY_GUI_SCREEN_AUTH;
+    g_gui_state.show_search_bar = config && config->show_search_bar;
     g_gui_state.current_playlists = NULL;
     g_gui_state.current_playlist_count = 0;
     g_gui_state.current_tracks = NULL;
     g_gui_state.current_track_count = 0;
 
+    // Only a working controller can bring what the snapshot shows up to date
+    if (g_gui_state.controller_handle) {
+        spotify_snapshot_load();
+    }
+    now_playing_store_listen(NOW_PLAYING_TRACK | NOW_PLAYING_ARTIST | NOW_PLAYING_PLAYING | NOW_PLAYING_DEVICE,
+                             player_predict_listener);
+
     g_gui_state.initialized = true;
     ESP_LOGI(TAG, "Spotify GUI Manager initialized successfully");
     return ESP_OK;
@@ -136,36 +255,147 @@ lv_obj_t *spotify_gui_create_interface(lv_obj_t *parent) {
     lv_obj_t *container = lv_obj_create(parent);
     lv_obj_set_size(container, lv_pct(100), lv_pct(100));
     lv_obj_center(container);
+    ui_layer_cache_attach(container);
 
     g_gui_state.main_container = container;
 
     // Create status bar
     g_gui_state.status_bar = lv_label_create(container);
     lv_obj_align(g_gui_state.status_bar, LV_ALIGN_BOTTOM_MID, 0, -10);
-    lv_label_set_text(g_gui_state.status_bar, "Spotify: Not authenticated");
+    lv_label_set_text(g_gui_state.status_bar, g_gui_state.status_text[0] ? g_gui_state.status_text
+                                                                           : "Spotify: Not authenticated");
 
-    // Show initial authentication screen
-    spotify_gui_show_auth_screen();
+    // The screen last shown, or asked for while the tab was not built
+    show_current_screen();
 
     return container;
 }
 
-void spotify_gui_show_config_screen(void) {
-    ESP_LOGI(TAG, "Showing configuration screen");
+void spotify_gui_unload_interface(void) {
+    if (!g_gui_state.main_container) {
+        return;
+    }
+    // The screens' delete callbacks clear their slots, widgets and lists
+    g_gui_state.main_container = NULL;
+    g_gui_state.status_bar = NULL;
+}
+
+static void set_status(const char *text) {
+    strlcpy(g_gui_state.status_text, text, sizeof(g_gui_state.status_text));
+    if (g_gui_state.status_bar) {
+        lv_label_set_text(g_gui_state.status_bar, g_gui_state.status_text);
+    }
+}
 
-    // Clear current screen
-    if (g_gui_state.current_screen) {
-        lv_obj_del(g_gui_state.current_screen);
+static void screen_delete_cb(lv_event_t *e) {
+    lv_obj_t **slot = (lv_obj_t **)lv_event_get_user_data(e);
+    if (g_gui_state.current_screen == *slot) {
         g_gui_state.current_screen = NULL;
     }
+    *slot = NULL;
+}
+
+static void search_stop(void);
+
+// Until the tab is built a screen is only noted, with its data
+static bool screen_deferred(spotify_gui_screen_t type) {
+    if (g_gui_state.main_container) {
+        return false;
+    }
+    g_gui_state.current_screen_type = type;
+    return true;
+}
+
+// Delete every cached screen except the one on display
+static void screen_evict_hidden(void) {
+    lv_obj_t **slots[] = {
+        &g_gui_state.config_screen, &g_gui_state.auth_screen, &g_gui_state.playlists_screen,
+        &g_gui_state.tracks_screen, &g_gui_state.player_screen, &g_gui_state.search_screen,
+        &g_gui_state.unconfigured_screen,
+    };
+    for (size_t i = 0; i < sizeof(slots) / sizeof(slots[0]); i++) {
+        if (*slots[i] && *slots[i] != g_gui_state.current_screen) {
+            lv_obj_del(*slots[i]);     // screen_delete_cb clears the slot
+        }
+    }
+}
+
+static void screen_create(lv_obj_t **slot, lv_coord_t width, lv_coord_t height) {
+    *slot = lv_obj_create(g_gui_state.main_container);
+    lv_obj_set_size(*slot, width, height);
+    lv_obj_center(*slot);
+    lv_obj_add_event_cb(*slot, screen_delete_cb, LV_EVENT_DELETE, slot);
+    ui_layer_cache_attach(*slot);
+}
+
+// Hide the screen on display and show the one in slot, creating its
+// container if it is not cached. Returns true when the caller has to build
+// the screen's widgets; otherwise only its data needs binding.
+static bool screen_show(lv_obj_t **slot, spotify_gui_screen_t type, lv_coord_t width, lv_coord_t height) {
+    if (g_gui_state.current_screen && g_gui_state.current_screen != *slot) {
+        if (g_gui_state.current_screen == g_gui_state.search_screen) {
+            search_stop();
+        }
+        if (g_gui_state.current_screen == g_gui_state.player_screen) {
+            ui_prerender_cancel(&g_gui_state.player_prerender);     // Left mid-reveal
+        }
+        lv_obj_add_flag(g_gui_state.current_screen, LV_OBJ_FLAG_HIDDEN);
+        // A hidden list fetches no covers; it sets its rows again when shown
+        spotify_thumbnails_set_rows(NULL, NULL, 0);
+    }
+    g_gui_state.current_screen_type = type;
+
+    bool created = false;
+    if (!*slot) {
+        lv_mem_monitor_t mon;
+        lv_mem_monitor(&mon);
+        if (mon.free_size < SPOTIFY_GUI_SCREEN_EVICT_FREE_BYTES) {
+            ESP_LOGI(TAG, "LVGL pool low (%u bytes free), dropping hidden screens", (unsigned)mon.free_size);
+            screen_evict_hidden();
+        }
+
+        screen_create(slot, width, height);
+        created = true;
+    }
+
+    // A screen drawn ahead slides in from its snapshot
+    if (*slot != g_gui_state.player_screen || !ui_prerender_reveal(&g_gui_state.player_prerender, *slot)) {
+        lv_obj_clear_flag(*slot, LV_OBJ_FLAG_HIDDEN);
+    }
+    g_gui_state.current_screen = *slot;
+    return created;
+}
+
+static void config_load_fields(void) {
+    spotify_config_t existing_config;
+    if (spotify_config_load(&existing_config) == ESP_OK) {
+        lv_textarea_set_text(g_gui_state.client_id_textarea, existing_config.client_id);
+        if (strlen(existing_config.client_secret) > 0) {
+            lv_textarea_set_text(g_gui_state.client_secret_textarea, existing_config.client_secret);
+        }
+        if (strlen(existing_config.redirect_uri) > 0) {
+            lv_textarea_set_text(g_gui_state.redirect_uri_textarea, existing_config.redirect_uri);
+        }
+    }
+}
 
-    // Create config screen container
-    g_gui_state.config_screen = lv_obj_create(g_gui_state.main_container);
-    lv_obj_set_size(g_gui_state.config_screen, lv_pct(95), lv_pct(90));
-    lv_obj_center(g_gui_state.config_screen);
+static void config_screen_delete_cb(lv_event_t *e) {
+    g_gui_state.client_id_textarea = NULL;
+    g_gui_state.client_secret_textarea = NULL;
+    g_gui_state.redirect_uri_textarea = NULL;
+}
 
-    g_gui_state.current_screen = g_gui_state.config_screen;
-    g_gui_state.current_screen_type = SPOTIFY_GUI_SCREEN_CONFIG;
+void spotify_gui_show_config_screen(void) {
+    ESP_LOGI(TAG, "Showing configuration screen");
+
+    if (screen_deferred(SPOTIFY_GUI_SCREEN_CONFIG)) {
+        return;
+    }
+    if (!screen_show(&g_gui_state.config_screen, SPOTIFY_GUI_SCREEN_CONFIG, lv_pct(95), lv_pct(90))) {
+        config_load_fields();
+        return;
+    }
+    lv_obj_add_event_cb(g_gui_state.config_screen, config_screen_delete_cb, LV_EVENT_DELETE, NULL);
 
     // Create title
     lv_obj_t *title = lv_label_create(g_gui_state.config_screen);
@@ -243,35 +473,25 @@ void spotify_gui_show_config_screen(void) {
     lv_obj_center(cancel_label);
 
     // Try to load existing configuration
-    spotify_config_t existing_config;
-    if (spotify_config_load(&existing_config) == ESP_OK) {
-        lv_textarea_set_text(g_gui_state.client_id_textarea, existing_config.client_id);
-        if (strlen(existing_config.client_secret) > 0) {
-            lv_textarea_set_text(g_gui_state.client_secret_textarea, existing_config.client_secret);
-        }
-        if (strlen(existing_config.redirect_uri) > 0) {
-            lv_textarea_set_text(g_gui_state.redirect_uri_textarea, existing_config.redirect_uri);
-        }
-    }
+    config_load_fields();
+}
+
+static void auth_screen_delete_cb(lv_event_t *e) {
+    g_gui_state.auth_button = NULL;
 }
 
 void spotify_gui_show_auth_screen(void) {
     ESP_LOGI(TAG, "Showing authentication screen");
-    
-    // Clear current screen
-    if (g_gui_state.current_screen) {
-        lv_obj_del(g_gui_state.current_screen);
-        g_gui_state.current_screen = NULL;
+
+    if (screen_deferred(SPOTIFY_GUI_SCREEN_AUTH)) {
+        return;
     }
-    
-    // Create auth screen container
-    g_gui_state.auth_screen = lv_obj_create(g_gui_state.main_container);
-    lv_obj_set_size(g_gui_state.auth_screen, lv_pct(90), lv_pct(80));
-    lv_obj_center(g_gui_state.auth_screen);
-    
-    g_gui_state.current_screen = g_gui_state.auth_screen;
-    g_gui_state.current_screen_type = SPOTIFY_GUI_SCREEN_AUTH;
-    
+    // Nothing on it changes
+    if (!screen_show(&g_gui_state.auth_screen, SPOTIFY_GUI_SCREEN_AUTH, lv_pct(90), lv_pct(80))) {
+        return;
+    }
+    lv_obj_add_event_cb(g_gui_state.auth_screen, auth_screen_delete_cb, LV_EVENT_DELETE, NULL);
+
     // Create title
     lv_obj_t *title = lv_label_create(g_gui_state.auth_screen);
     lv_label_set_text(title, "Spotify Authentication");
@@ -295,7 +515,201 @@ void spotify_gui_show_auth_screen(void) {
     lv_obj_align(instructions, LV_ALIGN_BOTTOM_MID, 0, -20);
 }
 
-void spotify_gui_show_playlists(const spotify_playlist_info_t *playlists, size_t playlist_count) {
+static void virtual_list_add_thumbnail(spotify_gui_virtual_list_t *list, spotify_thumbnail_row_t *rows, size_t *n,
+                                       bool *added, size_t index, bool fetch) {
+    size_t slot = index % SPOTIFY_GUI_LIST_POOL_ROWS;
+    if (index >= list->count || added[slot] || list->bound[slot] != index) {
+        return;
+    }
+    rows[(*n)++] = (spotify_thumbnail_row_t){
+        .image = list->images[slot],
+        .image_url = list->image_url(index),
+        .fetch = fetch,
+    };
+    added[slot] = true;
+}
+
+// Rows in view first, top down, then the look-ahead below and above; the
+// rest of the pool only shows covers already decoded
+static void virtual_list_update_thumbnails(spotify_gui_virtual_list_t *list, size_t first, size_t end) {
+    spotify_thumbnail_row_t rows[SPOTIFY_GUI_LIST_POOL_ROWS];
+    bool added[SPOTIFY_GUI_LIST_POOL_ROWS] = {false};
+    size_t n = 0;
+
+    for (size_t index = first; index < end; index++) {
+        virtual_list_add_thumbnail(list, rows, &n, added, index, true);
+    }
+    for (size_t i = 0; i < SPOTIFY_GUI_LIST_THUMB_LOOK_AHEAD; i++) {
+        virtual_list_add_thumbnail(list, rows, &n, added, end + i, true);
+        if (first > i) {
+            virtual_list_add_thumbnail(list, rows, &n, added, first - i - 1, true);
+        }
+    }
+    for (size_t slot = 0; slot < SPOTIFY_GUI_LIST_POOL_ROWS; slot++) {
+        if (!added[slot]) {
+            size_t index = list->bound[slot];
+            rows[n++] = (spotify_thumbnail_row_t){
+                .image = list->images[slot],
+                .image_url = index != SPOTIFY_GUI_LIST_NO_ITEM ? list->image_url(index) : NULL,
+                .fetch = false,
+            };
+        }
+    }
+
+    spotify_thumbnails_set_rows(list, rows, n);
+    list->view_first = first;
+    list->view_end = end;
+}
+
+// Bind the pool to the rows around the scroll position. Each item index has
+// one pool slot (index % pool size), so only rows that scrolled in change.
+static void virtual_list_refresh(spotify_gui_virtual_list_t *list) {
+    if (!list->container) {
+        return;
+    }
+
+    lv_coord_t scroll_y = lv_obj_get_scroll_y(list->container);
+    size_t first = scroll_y > 0 ? (size_t)(scroll_y / SPOTIFY_GUI_LIST_ROW_HEIGHT) : 0;
+    size_t view_first = first;
+    size_t view_end = (size_t)((scroll_y > 0 ? scroll_y : 0) + lv_obj_get_content_height(list->container) +
+                               SPOTIFY_GUI_LIST_ROW_HEIGHT - 1) / SPOTIFY_GUI_LIST_ROW_HEIGHT;
+    if (first > 0) {
+        first--;    // One row of margin above
+    }
+
+    bool rebound = false;
+    for (size_t index = first; index < first + SPOTIFY_GUI_LIST_POOL_ROWS; index++) {
+        size_t slot = index % SPOTIFY_GUI_LIST_POOL_ROWS;
+        if (index >= list->count) {
+            rebound |= list->bound[slot] != SPOTIFY_GUI_LIST_NO_ITEM;
+            lv_obj_add_flag(list->rows[slot], LV_OBJ_FLAG_HIDDEN);
+            list->bound[slot] = SPOTIFY_GUI_LIST_NO_ITEM;
+            continue;
+        }
+        if (list->bound[slot] == index) {
+            continue;
+        }
+        rebound = true;
+        lv_obj_set_y(list->rows[slot], (lv_coord_t)(index * SPOTIFY_GUI_LIST_ROW_HEIGHT));
+        lv_obj_set_user_data(list->rows[slot], (void *)(uintptr_t)index);
+        list->bind(list->labels[slot], index);
+        lv_obj_clear_flag(list->rows[slot], LV_OBJ_FLAG_HIDDEN);
+        list->bound[slot] = index;
+    }
+
+    // Not on every scrolled pixel: only once a row comes into or leaves view
+    if (list->image_url && (rebound || view_first != list->view_first || view_end != list->view_end)) {
+        virtual_list_update_thumbnails(list, view_first, view_end);
+    }
+
+    // The controller ignores this while a page is loading or the list is complete
+    if (list->load_more && first + SPOTIFY_GUI_LIST_POOL_ROWS + SPOTIFY_GUI_LIST_LOAD_AHEAD >= list->count) {
+        list->load_more();
+    }
+}
+
+static void virtual_list_scroll_cb(lv_event_t *e) {
+    virtual_list_refresh((spotify_gui_virtual_list_t *)lv_event_get_user_data(e));
+}
+
+static void virtual_list_delete_cb(lv_event_t *e) {
+    spotify_gui_virtual_list_t *list = (spotify_gui_virtual_list_t *)lv_event_get_user_data(e);
+    spotify_thumbnails_release(list);
+    list->container = NULL;
+}
+
+// New item count (and data): every row is re-bound, the scroll position kept
+static void virtual_list_set_count(spotify_gui_virtual_list_t *list, size_t count) {
+    if (!list->container) {
+        return;
+    }
+
+    list->count = count;
+    lv_obj_set_y(list->end_marker, (lv_coord_t)(count * SPOTIFY_GUI_LIST_ROW_HEIGHT));
+    for (size_t i = 0; i < SPOTIFY_GUI_LIST_POOL_ROWS; i++) {
+        list->bound[i] = SPOTIFY_GUI_LIST_NO_ITEM;
+    }
+    list->view_first = SPOTIFY_GUI_LIST_NO_ITEM;    // The thumbnails are set again
+    virtual_list_refresh(list);
+}
+
+static void virtual_list_create(spotify_gui_virtual_list_t *list, lv_obj_t *parent, size_t count,
+                                spotify_gui_list_bind_t bind, spotify_gui_list_image_t image_url,
+                                lv_event_cb_t clicked_cb, spotify_gui_list_load_more_t load_more) {
+    list->bind = bind;
+    list->image_url = image_url;
+    list->load_more = load_more;
+    list->count = 0;
+
+    // Plain container, no layout: rows are placed by hand
+    list->container = lv_obj_create(parent);
+    lv_obj_set_size(list->container, lv_pct(90), lv_pct(70));
+    lv_obj_align(list->container, LV_ALIGN_CENTER, 0, 10);
+    lv_obj_set_scroll_dir(list->container, LV_DIR_VER);
+    // Before the recycling handler, so rebound rows are drawn over the copy
+    LVGL_Scroll_Blit_Enable(list->container);
+    lv_obj_add_event_cb(list->container, virtual_list_scroll_cb, LV_EVENT_SCROLL, list);
+    lv_obj_add_event_cb(list->container, virtual_list_delete_cb, LV_EVENT_DELETE, list);
+
+    list->end_marker = lv_obj_create(list->container);
+    lv_obj_remove_style_all(list->end_marker);
+    lv_obj_set_size(list->end_marker, 1, 1);
+    lv_obj_clear_flag(list->end_marker, LV_OBJ_FLAG_CLICKABLE);
+
+    for (size_t i = 0; i < SPOTIFY_GUI_LIST_POOL_ROWS; i++) {
+        lv_obj_t *row = lv_btn_create(list->container);
+        lv_obj_set_size(row, lv_pct(100), SPOTIFY_GUI_LIST_ROW_HEIGHT - 4);
+        lv_obj_add_flag(row, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_add_event_cb(row, clicked_cb, LV_EVENT_CLICKED, NULL);
+
+        // The cover sits in the row's left padding, so the label keeps the
+        // full content width
+        const lv_coord_t thumb_width = SPOTIFY_THUMBNAIL_SIZE + SPOTIFY_GUI_LIST_THUMB_GAP;
+        lv_obj_set_style_pad_left(row, lv_obj_get_style_pad_left(row, LV_PART_MAIN) + thumb_width, 0);
+        lv_obj_t *image = lv_img_create(row);
+        lv_obj_set_size(image, SPOTIFY_THUMBNAIL_SIZE, SPOTIFY_THUMBNAIL_SIZE);
+        lv_obj_align(image, LV_ALIGN_LEFT_MID, -thumb_width, 0);
+        lv_obj_add_flag(image, LV_OBJ_FLAG_HIDDEN);
+
+        lv_obj_t *label = lv_label_create(row);
+        lv_label_set_long_mode(label, LV_LABEL_LONG_DOT);
+        lv_obj_set_width(label, lv_pct(100));
+        lv_obj_align(label, LV_ALIGN_LEFT_MID, 0, 0);
+
+        list->rows[i] = row;
+        list->labels[i] = label;
+        list->images[i] = image;
+        list->bound[i] = SPOTIFY_GUI_LIST_NO_ITEM;
+    }
+
+    virtual_list_set_count(list, count);
+}
+
+static void bind_playlist_row(lv_obj_t *label, size_t index) {
+    spotify_gui_bind_playlist_item(label, &g_gui_state.current_playlists[index]);
+}
+
+static void bind_track_row(lv_obj_t *label, size_t index) {
+    spotify_gui_bind_track_item(label, &g_gui_state.current_tracks[index]);
+}
+
+static const char *playlist_image_url(size_t index) {
+    return g_gui_state.current_playlists[index].image_url;
+}
+
+static const char *track_image_url(size_t index) {
+    return g_gui_state.current_tracks[index].image_url;
+}
+
+static bool load_more_playlists(void) {
+    return spotify_controller_load_more_playlists(g_gui_state.controller_handle);
+}
+
+static bool load_more_tracks(void) {
+    return spotify_controller_load_more_tracks(g_gui_state.controller_handle);
+}
+
+void spotify_gui_show_playlists(const spotify_playlist_view_t *playlists, size_t playlist_count) {
     if (!playlists || playlist_count == 0) {
         ESP_LOGW(TAG, "No playlists to display");
         return;
@@ -306,38 +720,38 @@ void spotify_gui_show_playlists(const spotify_playlist_info_t *playlists, size_t
     // Store playlist data
     g_gui_state.current_playlists = playlists;
     g_gui_state.current_playlist_count = playlist_count;
-    
-    // Clear current screen
-    if (g_gui_state.current_screen) {
-        lv_obj_del(g_gui_state.current_screen);
-        g_gui_state.current_screen = NULL;
+    if (screen_deferred(SPOTIFY_GUI_SCREEN_PLAYLISTS)) {
+        return;
     }
-    
-    // Create playlists screen
-    g_gui_state.playlists_screen = lv_obj_create(g_gui_state.main_container);
-    lv_obj_set_size(g_gui_state.playlists_screen, lv_pct(90), lv_pct(80));
-    lv_obj_center(g_gui_state.playlists_screen);
-    
-    g_gui_state.current_screen = g_gui_state.playlists_screen;
-    g_gui_state.current_screen_type = SPOTIFY_GUI_SCREEN_PLAYLISTS;
-    
+
+    // Coming back keeps the scroll position
+    if (!screen_show(&g_gui_state.playlists_screen, SPOTIFY_GUI_SCREEN_PLAYLISTS, lv_pct(90), lv_pct(80))) {
+        virtual_list_set_count(&g_gui_state.playlist_list, playlist_count);
+        return;
+    }
+
     // Create title
     lv_obj_t *title = lv_label_create(g_gui_state.playlists_screen);
     lv_label_set_text(title, "Your Playlists");
     lv_obj_align(title, LV_ALIGN_TOP_MID, 0, 10);
     
-    // Create playlist list
-    lv_obj_t *list = lv_list_create(g_gui_state.playlists_screen);
-    lv_obj_set_size(list, lv_pct(90), lv_pct(70));
-    lv_obj_align(list, LV_ALIGN_CENTER, 0, 10);
-    
-    // Add playlists to list
-    for (size_t i = 0; i < playlist_count; i++) {
-        spotify_gui_create_playlist_item(list, &playlists[i]);
+    if (g_gui_state.show_search_bar) {
+        lv_obj_t *search_btn = lv_btn_create(g_gui_state.playlists_screen);
+        lv_obj_set_size(search_btn, 80, 30);
+        lv_obj_align(search_btn, LV_ALIGN_TOP_RIGHT, -10, 5);
+        lv_obj_add_event_cb(search_btn, search_button_cb, LV_EVENT_CLICKED, NULL);
+
+        lv_obj_t *search_label = lv_label_create(search_btn);
+        lv_label_set_text(search_label, "Search");
+        lv_obj_center(search_label);
     }
+    
+    // Create playlist list
+    virtual_list_create(&g_gui_state.playlist_list, g_gui_state.playlists_screen, playlist_count,
+                        bind_playlist_row, playlist_image_url, playlist_button_cb, load_more_playlists);
 }
 
-void spotify_gui_show_tracks(const spotify_track_info_t *tracks, size_t track_count, const char *title) {
+void spotify_gui_show_tracks(const spotify_track_view_t *tracks, size_t track_count, const char *title) {
     if (!tracks || track_count == 0) {
         ESP_LOGW(TAG, "No tracks to display");
         return;
@@ -348,26 +762,26 @@ void spotify_gui_show_tracks(const spotify_track_info_t *tracks, size_t track_co
     // Store track data
     g_gui_state.current_tracks = tracks;
     g_gui_state.current_track_count = track_count;
-    
-    // Clear current screen
-    if (g_gui_state.current_screen) {
-        lv_obj_del(g_gui_state.current_screen);
-        g_gui_state.current_screen = NULL;
+    if (title != g_gui_state.tracks_title_text) {
+        strlcpy(g_gui_state.tracks_title_text, title ? title : "Tracks", sizeof(g_gui_state.tracks_title_text));
     }
-    
-    // Create tracks screen
-    g_gui_state.tracks_screen = lv_obj_create(g_gui_state.main_container);
-    lv_obj_set_size(g_gui_state.tracks_screen, lv_pct(90), lv_pct(80));
-    lv_obj_center(g_gui_state.tracks_screen);
-    
-    g_gui_state.current_screen = g_gui_state.tracks_screen;
-    g_gui_state.current_screen_type = SPOTIFY_GUI_SCREEN_TRACKS;
-    
+    if (screen_deferred(SPOTIFY_GUI_SCREEN_TRACKS)) {
+        return;
+    }
+
+    // Always a new list, shown from its top
+    if (!screen_show(&g_gui_state.tracks_screen, SPOTIFY_GUI_SCREEN_TRACKS, lv_pct(90), lv_pct(80))) {
+        lv_label_set_text(g_gui_state.tracks_title, g_gui_state.tracks_title_text);
+        lv_obj_scroll_to_y(g_gui_state.track_list.container, 0, LV_ANIM_OFF);
+        virtual_list_set_count(&g_gui_state.track_list, track_count);
+        return;
+    }
+
     // Create title
-    lv_obj_t *title_label = lv_label_create(g_gui_state.tracks_screen);
-    lv_label_set_text(title_label, title ? title : "Tracks");
-    lv_obj_align(title_label, LV_ALIGN_TOP_MID, 0, 10);
-    
+    g_gui_state.tracks_title = lv_label_create(g_gui_state.tracks_screen);
+    lv_label_set_text(g_gui_state.tracks_title, g_gui_state.tracks_title_text);
+    lv_obj_align(g_gui_state.tracks_title, LV_ALIGN_TOP_MID, 0, 10);
+
     // Create back button
     lv_obj_t *back_btn = lv_btn_create(g_gui_state.tracks_screen);
     lv_obj_set_size(back_btn, 60, 30);
@@ -379,56 +793,51 @@ void spotify_gui_show_tracks(const spotify_track_info_t *tracks, size_t track_co
     lv_obj_center(back_label);
     
     // Create track list
-    lv_obj_t *list = lv_list_create(g_gui_state.tracks_screen);
-    lv_obj_set_size(list, lv_pct(90), lv_pct(70));
-    lv_obj_align(list, LV_ALIGN_CENTER, 0, 10);
-    
-    // Add tracks to list
-    for (size_t i = 0; i < track_count; i++) {
-        spotify_gui_create_track_item(list, &tracks[i]);
+    virtual_list_create(&g_gui_state.track_list, g_gui_state.tracks_screen, track_count,
+                        bind_track_row, track_image_url, track_button_cb, load_more_tracks);
+}
+
+bool spotify_gui_show_snapshot(void) {
+    const spotify_playback_state_t *playback = spotify_snapshot_playback();
+    if (playback) {
+        spotify_gui_update_playback_state(playback);
+    }
+    // The track played before the last one, for an instant previous
+    const spotify_track_info_t *previous = spotify_snapshot_recent_track(1);
+    if (previous) {
+        g_gui_state.previous_track = *previous;
+        g_gui_state.has_previous_track = true;
     }
+
+    size_t count = 0;
+    const spotify_playlist_view_t *playlists = spotify_snapshot_playlists(&count);
+    if (!playlists) {
+        return false;
+    }
+    ESP_LOGI(TAG, "Showing %d playlists from the snapshot", (int)count);
+    spotify_gui_show_playlists(playlists, count);
+    voice_vocabulary_set_playlists(playlists, count);
+    return true;
 }
 
-lv_obj_t *spotify_gui_create_playlist_item(lv_obj_t *parent, const spotify_playlist_info_t *playlist) {
-    if (!parent || !playlist) return NULL;
+void spotify_gui_bind_playlist_item(lv_obj_t *label, const spotify_playlist_view_t *playlist) {
+    if (!label || !playlist) return;
     
-    // Create button with playlist name and track count
+    // Playlist name and track count
     char btn_text[300];
-    snprintf(btn_text, sizeof(btn_text), "%s (%d tracks)", 
+    snprintf(btn_text, sizeof(btn_text), LV_SYMBOL_AUDIO "  %s (%d tracks)",
              playlist->name, playlist->track_count);
-    
-    lv_obj_t *btn = lv_list_add_btn(parent, LV_SYMBOL_AUDIO, btn_text);
-    
-    // Store playlist data in button user data
-    spotify_playlist_info_t *playlist_data = malloc(sizeof(spotify_playlist_info_t));
-    if (playlist_data) {
-        memcpy(playlist_data, playlist, sizeof(spotify_playlist_info_t));
-        lv_obj_set_user_data(btn, playlist_data);
-        lv_obj_add_event_cb(btn, playlist_button_cb, LV_EVENT_CLICKED, NULL);
-    }
-    
-    return btn;
+    lv_label_set_text(label, btn_text);
 }
 
-lv_obj_t *spotify_gui_create_track_item(lv_obj_t *parent, const spotify_track_info_t *track) {
-    if (!parent || !track) return NULL;
+void spotify_gui_bind_track_item(lv_obj_t *label, const spotify_track_view_t *track) {
+    if (!label || !track) return;
     
-    // Create button with track name and artist
+    // Track name and artist
     char btn_text[600];  // Increased buffer size to accommodate longer strings
-    snprintf(btn_text, sizeof(btn_text), "%s - %s",
+    snprintf(btn_text, sizeof(btn_text), LV_SYMBOL_PLAY "  %s - %s",
              track->name, track->artist);
-    
-    lv_obj_t *btn = lv_list_add_btn(parent, LV_SYMBOL_PLAY, btn_text);
-    
-    // Store track data in button user data
-    spotify_track_info_t *track_data = malloc(sizeof(spotify_track_info_t));
-    if (track_data) {
-        memcpy(track_data, track, sizeof(spotify_track_info_t));
-        lv_obj_set_user_data(btn, track_data);
-        lv_obj_add_event_cb(btn, track_button_cb, LV_EVENT_CLICKED, NULL);
-    }
-    
-    return btn;
+    lv_label_set_text(label, btn_text);
 }
 
 // Callback handlers for Spotify controller
@@ -471,27 +880,70 @@ static void spotify_playback_state_callback(const spotify_playback_state_t* stat
              state->current_track.name,
              state->is_playing ? "Playing" : "Paused");
 
-    // Update GUI if on player screen
-    if (g_gui_state.current_screen_type == SPOTIFY_GUI_SCREEN_PLAYER) {
-        spotify_gui_show_player(state);
-    }
+    // Remembered for the player screen; shown now if it is open
+    spotify_gui_update_playback_state(state);
+    spotify_snapshot_set_playback(state);
 }
 
-static void spotify_playlists_callback(const spotify_playlist_info_t* playlists, size_t count) {
+static void spotify_playlists_callback(const spotify_playlist_view_t* playlists, size_t count, size_t first_new) {
     ESP_LOGI(TAG, "Received %d playlists", count);
 
+    // A further page: grow the list on screen without rebuilding it
+    if (first_new > 0) {
+        g_gui_state.current_playlists = playlists;
+        g_gui_state.current_playlist_count = count;
+        if (g_gui_state.current_screen_type == SPOTIFY_GUI_SCREEN_PLAYLISTS) {
+            virtual_list_set_count(&g_gui_state.playlist_list, count);
+        }
+        spotify_snapshot_set_playlists(playlists, count);
+        voice_vocabulary_set_playlists(playlists, count);
+        return;
+    }
+
     spotify_gui_hide_loading();
 
     if (playlists && count > 0) {
-        spotify_gui_show_playlists(playlists, count);
+        // Off the snapshot's views first; if the list is the one it showed,
+        // the rows on screen are already right
+        g_gui_state.current_playlists = playlists;
+        g_gui_state.current_playlist_count = count;
+        if (spotify_snapshot_set_playlists(playlists, count) ||
+            g_gui_state.current_screen_type != SPOTIFY_GUI_SCREEN_PLAYLISTS) {
+            spotify_gui_show_playlists(playlists, count);
+        }
+        voice_vocabulary_set_playlists(playlists, count);
     } else {
         spotify_gui_show_error("No playlists found");
     }
 }
 
-static void spotify_tracks_callback(const spotify_track_info_t* tracks, size_t count) {
+static void spotify_tracks_callback(const spotify_track_view_t* tracks, size_t count, size_t first_new) {
     ESP_LOGI(TAG, "Received %d tracks", count);
 
+    // Search results (only ever the latest query's) replace the list below
+    // the search field in place
+    if (g_gui_state.current_screen_type == SPOTIFY_GUI_SCREEN_SEARCH) {
+        g_gui_state.current_tracks = tracks;
+        g_gui_state.current_track_count = count;
+        if (first_new == 0 && g_gui_state.search_list.container) {
+            lv_obj_scroll_to_y(g_gui_state.search_list.container, 0, LV_ANIM_OFF);
+        }
+        if (first_new == 0 && g_gui_state.search_status) {
+            lv_label_set_text(g_gui_state.search_status, count > 0 ? "" : "No results");
+        }
+        virtual_list_set_count(&g_gui_state.search_list, count);
+        return;
+    }
+
+    if (first_new > 0) {
+        g_gui_state.current_tracks = tracks;
+        g_gui_state.current_track_count = count;
+        if (g_gui_state.current_screen_type == SPOTIFY_GUI_SCREEN_TRACKS) {
+            virtual_list_set_count(&g_gui_state.track_list, count);
+        }
+        return;
+    }
+
     spotify_gui_hide_loading();
 
     if (tracks && count > 0) {
@@ -501,9 +953,125 @@ static void spotify_tracks_callback(const spotify_track_info_t* tracks, size_t c
     }
 }
 
-static void spotify_devices_callback(const spotify_device_info_t* devices, size_t count) {
+static void fill_device_list(void);
+
+static void spotify_devices_callback(const spotify_device_view_t* devices, size_t count) {
     ESP_LOGI(TAG, "Received %d devices", count);
-    // Device handling can be implemented later
+    control_api_set_spotify_devices(devices, count);
+
+    // Ones the Web API may not control are not offered
+    g_gui_state.connect_device_count = 0;
+    for (size_t i = 0; i < count && g_gui_state.connect_device_count < SPOTIFY_GUI_CAST_DEVICES_MAX; i++) {
+        if (!devices[i].is_restricted) {
+            strlcpy(g_gui_state.connect_devices[g_gui_state.connect_device_count++], devices[i].name,
+                    sizeof(g_gui_state.connect_devices[0]));
+        }
+    }
+    // The speaker modal opened with the cached list; show what changed
+    if (g_gui_state.device_modal && g_gui_state.device_modal->open && lv_obj_is_valid(g_gui_state.device_list)) {
+        fill_device_list();
+    }
+}
+
+static void spotify_album_art_callback(const char* image_url, const lv_img_dsc_t* image) {
+    // Only show it if the track has not changed while it was downloading
+    if (!image || g_gui_state.current_screen_type != SPOTIFY_GUI_SCREEN_PLAYER || !g_gui_state.player_art ||
+        strcmp(image_url, g_gui_state.playback.current_track.image_url) != 0) {
+        return;
+    }
+
+    lv_img_set_src(g_gui_state.player_art, image);
+    lv_obj_clear_flag(g_gui_state.player_art, LV_OBJ_FLAG_HIDDEN);
+}
+
+static void spotify_queue_callback(const spotify_track_info_t* previous, const spotify_track_info_t* next) {
+    g_gui_state.has_previous_track = previous != NULL;
+    g_gui_state.has_next_track = next != NULL;
+    if (previous) {
+        g_gui_state.previous_track = *previous;
+    }
+    if (next) {
+        g_gui_state.next_track = *next;
+        // Download the cover now so it is cached by the time the user skips
+        spotify_controller_get_album_art(g_gui_state.controller_handle, next->image_url);
+    }
+    if (previous) {
+        spotify_controller_get_album_art(g_gui_state.controller_handle, previous->image_url);
+    }
+}
+
+// Show a skip before Spotify confirms it; the controller's state corrects
+// the screen if the track that actually plays is a different one
+static void show_skipped_track(bool forward) {
+    if (!g_gui_state.has_playback) {
+        return;
+    }
+
+    spotify_track_info_t current = g_gui_state.playback.current_track;
+    if (forward) {
+        if (!g_gui_state.has_next_track) {
+            return;
+        }
+        g_gui_state.playback.current_track = g_gui_state.next_track;
+        g_gui_state.previous_track = current;
+        g_gui_state.has_previous_track = true;
+        g_gui_state.has_next_track = false;
+    } else {
+        // Spotify restarts the current track instead once it is a few seconds in
+        if (!g_gui_state.has_previous_track || g_gui_state.playback.progress_ms > SPOTIFY_GUI_PREVIOUS_RESTART_MS) {
+            return;
+        }
+        g_gui_state.playback.current_track = g_gui_state.previous_track;
+        g_gui_state.next_track = current;
+        g_gui_state.has_next_track = true;
+        g_gui_state.has_previous_track = false;
+    }
+    g_gui_state.playback.progress_ms = 0;
+    g_gui_state.playback.is_playing = true;
+
+    spotify_gui_update_playback_state(&g_gui_state.playback);
+}
+
+// Play or pause at once; the controller reports the same until Spotify
+// confirms it, or rolls it back
+static void show_play_state(bool playing) {
+    if (!g_gui_state.has_playback || g_gui_state.playback.is_playing == playing) {
+        return;
+    }
+    g_gui_state.playback.progress_ms = now_playing_store_position_ms();
+    g_gui_state.playback.is_playing = playing;
+    spotify_gui_update_playback_state(&g_gui_state.playback);
+}
+
+static lv_obj_t *failed_flash_target(void) {
+    return g_gui_state.failed_flash_title ? g_gui_state.player_title : g_gui_state.player_play_label;
+}
+
+static void failed_flash_timer_cb(lv_timer_t *timer) {
+    g_gui_state.failed_flash_timer = NULL;
+    lv_obj_t *target = failed_flash_target();
+    if (target) {
+        lv_obj_remove_local_style_prop(target, LV_STYLE_TEXT_COLOR, 0);
+    }
+}
+
+// The screen is already back to what is really playing; tint the control
+// that was pressed for a moment so the change back does not look random
+static void spotify_command_failed_callback(spotify_command_t command) {
+    ESP_LOGW(TAG, "Spotify command %d did not take", command);
+    if (g_gui_state.failed_flash_timer) {
+        lv_timer_del(g_gui_state.failed_flash_timer);
+        failed_flash_timer_cb(NULL);
+    }
+
+    g_gui_state.failed_flash_title = command == SPOTIFY_COMMAND_NEXT || command == SPOTIFY_COMMAND_PREVIOUS;
+    lv_obj_t *target = failed_flash_target();
+    if (!target) {
+        return;
+    }
+    lv_obj_set_style_text_color(target, lv_palette_main(LV_PALETTE_RED), 0);
+    g_gui_state.failed_flash_timer = lv_timer_create(failed_flash_timer_cb, SPOTIFY_GUI_FAILED_FLASH_MS, NULL);
+    lv_timer_set_repeat_count(g_gui_state.failed_flash_timer, 1);
 }
 
 static void spotify_error_callback(const char* error_message) {
@@ -538,7 +1106,10 @@ static void auth_button_cb(lv_event_t *e) {
 
 static void playlist_button_cb(lv_event_t *e) {
     lv_obj_t *btn = lv_event_get_target(e);
-    spotify_playlist_info_t *playlist = (spotify_playlist_info_t*)lv_obj_get_user_data(btn);
+    // Rows are recycled and the array moves as pages arrive, so rows hold an index
+    size_t index = (size_t)(uintptr_t)lv_obj_get_user_data(btn);
+    const spotify_playlist_view_t *playlist = index < g_gui_state.current_playlist_count ?
+                                              &g_gui_state.current_playlists[index] : NULL;
 
     if (!playlist || !g_gui_state.controller_handle) {
         spotify_gui_show_error("Invalid playlist or controller");
@@ -554,7 +1125,9 @@ static void playlist_button_cb(lv_event_t *e) {
 
 static void track_button_cb(lv_event_t *e) {
     lv_obj_t *btn = lv_event_get_target(e);
-    spotify_track_info_t *track = (spotify_track_info_t*)lv_obj_get_user_data(btn);
+    size_t index = (size_t)(uintptr_t)lv_obj_get_user_data(btn);
+    const spotify_track_view_t *track = index < g_gui_state.current_track_count ?
+                                        &g_gui_state.current_tracks[index] : NULL;
 
     if (!track || !g_gui_state.controller_handle) {
         spotify_gui_show_error("Invalid track or controller");
@@ -563,50 +1136,20 @@ static void track_button_cb(lv_event_t *e) {
 
     ESP_LOGI(TAG, "Track clicked: %s", track->name);
 
-    // Create action selection modal
-    lv_obj_t *modal = lv_obj_create(lv_scr_act());
-    lv_obj_set_size(modal, 250, 150);
-    lv_obj_center(modal);
-    lv_obj_add_flag(modal, LV_OBJ_FLAG_FLOATING);
-
-    // Add title
-    lv_obj_t *title = lv_label_create(modal);
-    lv_label_set_text(title, "Select Action");
-    lv_obj_align(title, LV_ALIGN_TOP_MID, 0, 10);
+    // Action selection modal
+    ui_modal_t *modal = ui_widget_pool_modal_open(250, 150, "Select Action", false);
+    if (!modal) {
+        return;
+    }
+    strlcpy(g_gui_state.modal_track_uri, track->uri, sizeof(g_gui_state.modal_track_uri));
 
-    // Create action buttons
-    lv_obj_t *play_btn = lv_btn_create(modal);
+    lv_obj_t *play_btn = ui_widget_pool_modal_button(modal, 0, "Play on Spotify", track_play_button_cb);
     lv_obj_set_size(play_btn, 200, 40);
     lv_obj_align(play_btn, LV_ALIGN_CENTER, 0, -20);
 
-    lv_obj_t *play_label = lv_label_create(play_btn);
-    lv_label_set_text(play_label, "Play on Spotify");
-    lv_obj_center(play_label);
-
-    // Store track data for play button
-    spotify_track_info_t *play_track_data = malloc(sizeof(spotify_track_info_t));
-    if (play_track_data) {
-        memcpy(play_track_data, track, sizeof(spotify_track_info_t));
-        lv_obj_set_user_data(play_btn, play_track_data);
-        lv_obj_add_event_cb(play_btn, track_play_button_cb, LV_EVENT_CLICKED, NULL);
-    }
-
-    // Cast button
-    lv_obj_t *cast_btn = lv_btn_create(modal);
+    lv_obj_t *cast_btn = ui_widget_pool_modal_button(modal, 1, "Cast to Chromecast", track_cast_button_cb);
     lv_obj_set_size(cast_btn, 200, 40);
     lv_obj_align(cast_btn, LV_ALIGN_CENTER, 0, 20);
-
-    lv_obj_t *cast_label = lv_label_create(cast_btn);
-    lv_label_set_text(cast_label, "Cast to Chromecast");
-    lv_obj_center(cast_label);
-
-    // Store track data for cast button
-    spotify_track_info_t *cast_track_data = malloc(sizeof(spotify_track_info_t));
-    if (cast_track_data) {
-        memcpy(cast_track_data, track, sizeof(spotify_track_info_t));
-        lv_obj_set_user_data(cast_btn, cast_track_data);
-        lv_obj_add_event_cb(cast_btn, track_cast_button_cb, LV_EVENT_CLICKED, NULL);
-    }
 }
 
 static void back_button_cb(lv_event_t *e) {
@@ -618,86 +1161,88 @@ static void back_button_cb(lv_event_t *e) {
 
 // Placeholder implementations for remaining functions
 static void play_button_cb(lv_event_t *e) {
-    if (g_gui_state.controller_handle) {
-        spotify_controller_play(g_gui_state.controller_handle, NULL);
+    if (g_gui_state.controller_handle &&
+        spotify_controller_play(g_gui_state.controller_handle, NULL)) {
+        show_play_state(true);
     }
 }
 
 static void pause_button_cb(lv_event_t *e) {
-    if (g_gui_state.controller_handle) {
-        spotify_controller_pause(g_gui_state.controller_handle);
+    if (g_gui_state.controller_handle &&
+        spotify_controller_pause(g_gui_state.controller_handle)) {
+        show_play_state(false);
     }
 }
 
 static void next_button_cb(lv_event_t *e) {
-    if (g_gui_state.controller_handle) {
-        spotify_controller_next_track(g_gui_state.controller_handle);
+    if (g_gui_state.controller_handle &&
+        spotify_controller_next_track(g_gui_state.controller_handle)) {
+        show_skipped_track(true);
     }
 }
 
 static void prev_button_cb(lv_event_t *e) {
-    if (g_gui_state.controller_handle) {
-        spotify_controller_previous_track(g_gui_state.controller_handle);
+    if (g_gui_state.controller_handle &&
+        spotify_controller_previous_track(g_gui_state.controller_handle)) {
+        show_skipped_track(false);
+    }
+}
+
+static void play_pause_button_cb(lv_event_t *e) {
+    if (g_gui_state.has_playback && g_gui_state.playback.is_playing) {
+        pause_button_cb(e);
+    } else {
+        play_button_cb(e);
     }
 }
 
 static void search_button_cb(lv_event_t *e) {
-    // Search functionality to be implemented
-    ESP_LOGI(TAG, "Search button clicked - not implemented yet");
+    spotify_gui_navigate_to_screen(SPOTIFY_GUI_SCREEN_SEARCH);
 }
 
 static void track_play_button_cb(lv_event_t *e) {
-    spotify_track_info_t *track = (spotify_track_info_t*)lv_obj_get_user_data(lv_event_get_target(e));
-    if (track && g_gui_state.controller_handle) {
-        spotify_controller_play(g_gui_state.controller_handle, track->uri);
+    ui_widget_pool_modal_close(lv_event_get_user_data(e));
+    bool playing = g_gui_state.controller_handle &&
+                   spotify_controller_play(g_gui_state.controller_handle, g_gui_state.modal_track_uri);
+
+    if (playing) {
+        spotify_gui_navigate_to_screen(SPOTIFY_GUI_SCREEN_PLAYER);
     }
-    // Close modal
-    lv_obj_t *modal = lv_obj_get_parent(lv_event_get_target(e));
-    lv_obj_del(modal);
-    free(track);
 }
 
 static void track_cast_button_cb(lv_event_t *e) {
-    spotify_track_info_t *track = (spotify_track_info_t*)lv_obj_get_user_data(lv_event_get_target(e));
-    if (track) {
-        // Show Chromecast device selection
-        spotify_gui_show_chromecast_selection(track->uri);
-    }
-    // Close modal
-    lv_obj_t *modal = lv_obj_get_parent(lv_event_get_target(e));
-    lv_obj_del(modal);
-    free(track);
+    ui_widget_pool_modal_close(lv_event_get_user_data(e));
+    spotify_gui_show_chromecast_selection(g_gui_state.modal_track_uri);
 }
 
 static void chromecast_device_button_cb(lv_event_t *e) {
-    char *data = (char*)lv_obj_get_user_data(lv_event_get_target(e));
-    if (data) {
-        char *separator = strchr(data, '|');
-        if (separator) {
-            *separator = '\0';
-            char *track_uri = data;
-            char *device_name = separator + 1;
-
-            ESP_LOGI(TAG, "Casting %s to %s", track_uri, device_name);
-            spotify_gui_cast_to_chromecast(device_name, track_uri);
-
-            // Close modal
-            lv_obj_t *modal = lv_obj_get_parent(lv_obj_get_parent(lv_event_get_target(e)));
-            lv_obj_del(modal);
-        }
-        free(data);
+    size_t index = (size_t)(uintptr_t)lv_obj_get_user_data(lv_event_get_target(e));
+    ui_widget_pool_modal_close(lv_event_get_user_data(e));
+    g_gui_state.device_modal = NULL;
+    if (index >= g_gui_state.modal_device_count) {
+        return;
+    }
+    const char *device_name = g_gui_state.modal_devices[index];
+    ESP_LOGI(TAG, "Casting %s to %s", g_gui_state.modal_track_uri, device_name);
+    if (!g_gui_state.modal_device_connect[index]) {
+        spotify_gui_cast_to_chromecast(device_name, g_gui_state.modal_track_uri);
+    } else if (g_gui_state.controller_handle &&
+               spotify_controller_play_on_device(g_gui_state.controller_handle, device_name,
+                                                 g_gui_state.modal_track_uri)) {
+        char message[128];
+        snprintf(message, sizeof(message), "Playing on %s", device_name);
+        spotify_gui_update_connection_status(SPOTIFY_CONNECTION_CONNECTED, message);
+    } else {
+        spotify_gui_show_error("Failed to play on the device");
     }
 }
 
 static void close_modal_button_cb(lv_event_t *e) {
-    lv_obj_t *modal = lv_obj_get_parent(lv_event_get_target(e));
-    lv_obj_del(modal);
+    ui_widget_pool_modal_close(lv_event_get_user_data(e));
 }
 
 // Utility functions
 void spotify_gui_update_auth_status(spotify_auth_state_t state, const char *message) {
-    if (!g_gui_state.status_bar) return;
-
     char status_text[128];
     const char* state_str = "Unknown";
 
@@ -725,13 +1270,11 @@ void spotify_gui_update_auth_status(spotify_auth_state_t state, const char *mess
         snprintf(status_text, sizeof(status_text), "Spotify: %s", state_str);
     }
 
-    lv_label_set_text(g_gui_state.status_bar, status_text);
+    set_status(status_text);
     ESP_LOGI(TAG, "Updated auth status: %s", status_text);
 }
 
 void spotify_gui_update_connection_status(spotify_connection_state_t state, const char *message) {
-    if (!g_gui_state.status_bar) return;
-
     char status_text[128];
     const char* state_str = "Unknown";
 
@@ -756,19 +1299,19 @@ void spotify_gui_update_connection_status(spotify_connection_state_t state, cons
         snprintf(status_text, sizeof(status_text), "Spotify: %s", state_str);
     }
 
-    lv_label_set_text(g_gui_state.status_bar, status_text);
+    set_status(status_text);
     ESP_LOGI(TAG, "Updated connection status: %s", status_text);
 }
 
 void spotify_gui_show_error(const char *error_message) {
-    if (!error_message || !g_gui_state.main_container) return;
+    if (!error_message) return;
 
     ESP_LOGE(TAG, "Showing error: %s", error_message);
 
     // Create simple error display in status bar for now
     char error_text[128];
     snprintf(error_text, sizeof(error_text), "Error: %s", error_message);
-    lv_label_set_text(g_gui_state.status_bar, error_text);
+    set_status(error_text);
 }
 
 void spotify_gui_hide_error(void) {
@@ -777,11 +1320,9 @@ void spotify_gui_hide_error(void) {
 }
 
 void spotify_gui_show_loading(const char *message) {
-    if (!g_gui_state.status_bar) return;
-
     char loading_text[128];
     snprintf(loading_text, sizeof(loading_text), "Loading: %s", message ? message : "Please wait...");
-    lv_label_set_text(g_gui_state.status_bar, loading_text);
+    set_status(loading_text);
     ESP_LOGI(TAG, "Showing loading: %s", message ? message : "Loading...");
 }
 
@@ -805,12 +1346,47 @@ void spotify_gui_navigate_to_screen(spotify_gui_screen_t screen) {
                 }
             }
             break;
+        case SPOTIFY_GUI_SCREEN_PLAYER:
+            spotify_gui_show_player(NULL);
+            break;
+        case SPOTIFY_GUI_SCREEN_SEARCH:
+            spotify_gui_show_search_screen();
+            break;
         default:
             ESP_LOGW(TAG, "Unknown screen type: %d", screen);
             break;
     }
 }
 
+static void show_current_screen(void) {
+    switch (g_gui_state.current_screen_type) {
+        case SPOTIFY_GUI_SCREEN_CONFIG:
+            spotify_gui_show_config_screen();
+            break;
+        case SPOTIFY_GUI_SCREEN_TRACKS:
+        case SPOTIFY_GUI_SCREEN_PLAYLISTS:
+            if (g_gui_state.current_screen_type == SPOTIFY_GUI_SCREEN_TRACKS &&
+                g_gui_state.current_tracks && g_gui_state.current_track_count > 0) {
+                spotify_gui_show_tracks(g_gui_state.current_tracks, g_gui_state.current_track_count,
+                                        g_gui_state.tracks_title_text);
+            } else if (g_gui_state.current_playlists && g_gui_state.current_playlist_count > 0) {
+                spotify_gui_show_playlists(g_gui_state.current_playlists, g_gui_state.current_playlist_count);
+            } else {
+                spotify_gui_show_auth_screen();
+            }
+            break;
+        case SPOTIFY_GUI_SCREEN_PLAYER:
+            spotify_gui_show_player(NULL);
+            break;
+        case SPOTIFY_GUI_SCREEN_SEARCH:
+            spotify_gui_show_search_screen();
+            break;
+        default:
+            spotify_gui_show_auth_screen();
+            break;
+    }
+}
+
 spotify_gui_screen_t spotify_gui_get_current_screen(void) {
     return g_gui_state.current_screen_type;
 }
@@ -872,9 +1448,7 @@ static void config_save_button_cb(lv_event_t *e) {
     ESP_LOGI(TAG, "Spotify configuration saved successfully");
 
     // Show success message briefly
-    if (g_gui_state.status_bar) {
-        lv_label_set_text(g_gui_state.status_bar, "Configuration saved successfully!");
-    }
+    set_status("Configuration saved successfully!");
 
     // Initialize Spotify with new configuration
     bool spotify_init_success = esp_cast_spotify_init(config.client_id,
@@ -889,9 +1463,7 @@ static void config_save_button_cb(lv_event_t *e) {
         spotify_gui_show_auth_screen();
 
         // Update status
-        if (g_gui_state.status_bar) {
-            lv_label_set_text(g_gui_state.status_bar, "Spotify: Ready for authentication");
-        }
+        set_status("Spotify: Ready for authentication");
     } else {
         spotify_gui_show_error("Failed to initialize Spotify with provided credentials");
     }
@@ -906,30 +1478,340 @@ static void config_cancel_button_cb(lv_event_t *e) {
         spotify_gui_show_auth_screen();
     } else {
         // Show placeholder message if not configured
-        if (g_gui_state.current_screen) {
-            lv_obj_del(g_gui_state.current_screen);
-            g_gui_state.current_screen = NULL;
+        if (screen_show(&g_gui_state.unconfigured_screen, SPOTIFY_GUI_SCREEN_CONFIG, lv_pct(90), lv_pct(80))) {
+            lv_obj_t *placeholder = lv_label_create(g_gui_state.unconfigured_screen);
+            lv_label_set_text(placeholder, "Spotify not configured.\nPlease configure with client credentials.");
+            lv_obj_center(placeholder);
         }
+    }
+}
 
-        lv_obj_t *placeholder = lv_label_create(g_gui_state.main_container);
-        lv_label_set_text(placeholder, "Spotify not configured.\nPlease configure with client credentials.");
-        lv_obj_center(placeholder);
-        g_gui_state.current_screen = placeholder;
-        g_gui_state.current_screen_type = SPOTIFY_GUI_SCREEN_CONFIG;
+static void player_screen_delete_cb(lv_event_t *e) {
+    if (g_gui_state.failed_flash_timer) {
+        lv_timer_del(g_gui_state.failed_flash_timer);
+        g_gui_state.failed_flash_timer = NULL;
     }
+    g_gui_state.player_art = NULL;
+    g_gui_state.player_title = NULL;
+    g_gui_state.player_artist = NULL;
+    g_gui_state.player_play_label = NULL;
+}
+
+// Now playing widgets: each one redraws only for the store fields it shows
+static void bind_player_title(lv_obj_t *obj, const now_playing_state_t *state, uint32_t changed) {
+    lv_label_set_text(obj, state->track[0] ? state->track : "Nothing playing");
+}
+
+static void bind_player_artist(lv_obj_t *obj, const now_playing_state_t *state, uint32_t changed) {
+    lv_label_set_text(obj, state->artist);
+}
+
+static void bind_player_device(lv_obj_t *obj, const now_playing_state_t *state, uint32_t changed) {
+    if (state->device[0]) {
+        lv_label_set_text_fmt(obj, LV_SYMBOL_AUDIO " %s", state->device);
+    } else {
+        lv_label_set_text(obj, "");
+    }
+}
+
+static void bind_player_play(lv_obj_t *obj, const now_playing_state_t *state, uint32_t changed) {
+    lv_label_set_text(obj, state->is_playing ? LV_SYMBOL_PAUSE : LV_SYMBOL_PLAY);
+}
+
+static void bind_player_elapsed(lv_obj_t *obj, const now_playing_state_t *state, uint32_t changed) {
+    if (!state->track[0]) {
+        lv_label_set_text(obj, "");
+        return;
+    }
+    int elapsed_s = now_playing_store_position_ms() / 1000;
+    int duration_s = state->duration_ms / 1000;
+    lv_label_set_text_fmt(obj, "%d:%02d / %d:%02d", elapsed_s / 60, elapsed_s % 60,
+                          duration_s / 60, duration_s % 60);
+}
+
+// Cached covers show at once; anything else arrives via the album art callback
+static void bind_player_art(lv_obj_t *obj, const now_playing_state_t *state, uint32_t changed) {
+    const lv_img_dsc_t *art = spotify_controller_get_album_art(g_gui_state.controller_handle, state->image_url);
+    if (art) {
+        lv_img_set_src(obj, art);
+        lv_obj_clear_flag(obj, LV_OBJ_FLAG_HIDDEN);
+    } else {
+        lv_obj_add_flag(obj, LV_OBJ_FLAG_HIDDEN);
+    }
+}
+
+static void build_player_widgets(void);
+static lv_obj_t *build_predicted_player(void);
+
+static lv_obj_t *create_player_button(lv_obj_t *parent, const char *symbol, lv_event_cb_t cb, lv_coord_t x_offset) {
+    lv_obj_t *btn = lv_btn_create(parent);
+    lv_obj_set_size(btn, 50, 40);
+    lv_obj_align(btn, LV_ALIGN_BOTTOM_MID, x_offset, -10);
+    lv_obj_add_event_cb(btn, cb, LV_EVENT_CLICKED, NULL);
+
+    lv_obj_t *label = lv_label_create(btn);
+    lv_label_set_text(label, symbol);
+    lv_obj_center(label);
+    return label;
 }
 
-// Placeholder implementations for functions not yet implemented
 void spotify_gui_show_player(const spotify_playback_state_t *playback_state) {
-    ESP_LOGI(TAG, "Show player screen - not implemented yet");
+    ESP_LOGI(TAG, "Showing now playing screen");
+
+    if (screen_deferred(SPOTIFY_GUI_SCREEN_PLAYER)) {
+        spotify_gui_update_playback_state(playback_state);
+        return;
+    }
+    // The widgets are bound to the now playing store and already current
+    if (!screen_show(&g_gui_state.player_screen, SPOTIFY_GUI_SCREEN_PLAYER, lv_pct(90), lv_pct(80))) {
+        spotify_gui_update_playback_state(playback_state);
+        return;
+    }
+    // Merge the newest state first, so the bindings start from it
+    if (playback_state) {
+        spotify_gui_update_playback_state(playback_state);
+    }
+    build_player_widgets();
+}
+
+// A track starting makes now playing the likely next screen; a change to
+// what it shows has its snapshot retaken
+static void player_predict_listener(const now_playing_state_t *state, uint32_t changed) {
+    if (!g_gui_state.main_container || (g_gui_state.player_screen && g_gui_state.current_screen == g_gui_state.player_screen)) {
+        return;
+    }
+    bool started = (changed & (NOW_PLAYING_TRACK | NOW_PLAYING_PLAYING)) && state->is_playing && state->track[0];
+    if (started || ui_prerender_target(&g_gui_state.player_prerender)) {
+        ui_prerender_want(&g_gui_state.player_prerender, build_predicted_player);
+    }
+}
+
+static lv_obj_t *build_predicted_player(void) {
+    if (!g_gui_state.main_container || (g_gui_state.player_screen && g_gui_state.current_screen == g_gui_state.player_screen)) {
+        return NULL;
+    }
+    if (!g_gui_state.player_screen) {
+        ESP_LOGD(TAG, "Building the now playing screen ahead");
+        screen_create(&g_gui_state.player_screen, lv_pct(90), lv_pct(80));
+        lv_obj_add_flag(g_gui_state.player_screen, LV_OBJ_FLAG_HIDDEN);
+        build_player_widgets();
+    }
+    return g_gui_state.player_screen;
+}
+
+static void build_player_widgets(void) {
+    lv_obj_clear_flag(g_gui_state.player_screen, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_event_cb(g_gui_state.player_screen, player_screen_delete_cb, LV_EVENT_DELETE, NULL);
+
+    // Create back button
+    lv_obj_t *back_btn = lv_btn_create(g_gui_state.player_screen);
+    lv_obj_set_size(back_btn, 60, 30);
+    lv_obj_align(back_btn, LV_ALIGN_TOP_LEFT, 10, 10);
+    lv_obj_add_event_cb(back_btn, back_button_cb, LV_EVENT_CLICKED, NULL);
+
+    lv_obj_t *back_label = lv_label_create(back_btn);
+    lv_label_set_text(back_label, "Back");
+    lv_obj_center(back_label);
+
+    // Album art stays hidden until the decoded cover is available
+    g_gui_state.player_art = lv_img_create(g_gui_state.player_screen);
+    lv_obj_set_size(g_gui_state.player_art, SPOTIFY_GUI_ALBUM_ART_SIZE, SPOTIFY_GUI_ALBUM_ART_SIZE);
+    lv_obj_align(g_gui_state.player_art, LV_ALIGN_TOP_MID, 0, 45);
+    lv_obj_add_flag(g_gui_state.player_art, LV_OBJ_FLAG_HIDDEN);
+
+    g_gui_state.player_title = lv_label_create(g_gui_state.player_screen);
+    lv_label_set_long_mode(g_gui_state.player_title, LV_LABEL_LONG_SCROLL_CIRCULAR);
+    lv_obj_set_width(g_gui_state.player_title, lv_pct(80));
+    lv_obj_set_style_text_align(g_gui_state.player_title, LV_TEXT_ALIGN_CENTER, 0);
+    lv_obj_align(g_gui_state.player_title, LV_ALIGN_TOP_MID, 0, 45 + SPOTIFY_GUI_ALBUM_ART_SIZE + 10);
+
+    g_gui_state.player_artist = lv_label_create(g_gui_state.player_screen);
+    lv_label_set_long_mode(g_gui_state.player_artist, LV_LABEL_LONG_DOT);
+    lv_obj_set_width(g_gui_state.player_artist, lv_pct(80));
+    lv_obj_set_style_text_align(g_gui_state.player_artist, LV_TEXT_ALIGN_CENTER, 0);
+    lv_obj_align_to(g_gui_state.player_artist, g_gui_state.player_title, LV_ALIGN_OUT_BOTTOM_MID, 0, 5);
+
+    lv_obj_t *elapsed = lv_label_create(g_gui_state.player_screen);
+    lv_obj_align_to(elapsed, g_gui_state.player_artist, LV_ALIGN_OUT_BOTTOM_MID, 0, 5);
+
+    lv_obj_t *device = lv_label_create(g_gui_state.player_screen);
+    lv_label_set_long_mode(device, LV_LABEL_LONG_DOT);
+    lv_obj_set_width(device, lv_pct(60));
+    lv_obj_set_style_text_align(device, LV_TEXT_ALIGN_RIGHT, 0);
+    lv_obj_align(device, LV_ALIGN_TOP_RIGHT, -10, 15);
+
+    // Playback controls
+    create_player_button(g_gui_state.player_screen, LV_SYMBOL_PREV, prev_button_cb, -60);
+    g_gui_state.player_play_label = create_player_button(g_gui_state.player_screen, LV_SYMBOL_PLAY,
+                                                         play_pause_button_cb, 0);
+    create_player_button(g_gui_state.player_screen, LV_SYMBOL_NEXT, next_button_cb, 60);
+
+    now_playing_store_bind(g_gui_state.player_title, NOW_PLAYING_TRACK, bind_player_title);
+    now_playing_store_bind(g_gui_state.player_artist, NOW_PLAYING_ARTIST, bind_player_artist);
+    now_playing_store_bind(g_gui_state.player_art, NOW_PLAYING_TRACK, bind_player_art);
+    now_playing_store_bind(g_gui_state.player_play_label, NOW_PLAYING_PLAYING, bind_player_play);
+    now_playing_store_bind(elapsed, NOW_PLAYING_TRACK | NOW_PLAYING_PROGRESS | NOW_PLAYING_CLOCK,
+                           bind_player_elapsed);
+    now_playing_store_bind(device, NOW_PLAYING_DEVICE, bind_player_device);
+}
+
+static void search_keyboard_cb(lv_event_t *e);
+
+// The shared keyboard takes the lower part of the screen; results get it
+// back while it is closed
+static void search_set_keyboard_visible(bool visible) {
+    if (!g_gui_state.search_screen || !g_gui_state.search_textarea) {
+        return;
+    }
+    if (visible) {
+        lv_obj_t *keyboard = ui_widget_pool_keyboard(g_gui_state.search_screen, g_gui_state.search_textarea,
+                                                     search_keyboard_cb);
+        if (!keyboard) {
+            return;
+        }
+        lv_obj_set_height(keyboard, lv_pct(45));
+        lv_obj_align(keyboard, LV_ALIGN_BOTTOM_MID, 0, 0);
+    } else {
+        ui_widget_pool_keyboard_release(g_gui_state.search_screen);
+    }
+    if (g_gui_state.search_list.container) {
+        lv_obj_set_height(g_gui_state.search_list.container, visible ? lv_pct(35) : lv_pct(75));
+        virtual_list_refresh(&g_gui_state.search_list);
+    }
+}
+
+static void search_run(void) {
+    lv_timer_pause(g_gui_state.search_timer);
+
+    const char *query = lv_textarea_get_text(g_gui_state.search_textarea);
+    if (!query || query[0] == '\0') {
+        // Nothing to search for: whatever is still in flight must not show up
+        spotify_controller_cancel_search(g_gui_state.controller_handle);
+        g_gui_state.current_track_count = 0;
+        virtual_list_set_count(&g_gui_state.search_list, 0);
+        lv_label_set_text(g_gui_state.search_status, "Type to search");
+        return;
+    }
+
+    if (spotify_controller_search_tracks(g_gui_state.controller_handle, query, SPOTIFY_GUI_SEARCH_LIMIT)) {
+        lv_label_set_text(g_gui_state.search_status, "Searching...");
+    } else {
+        lv_label_set_text(g_gui_state.search_status, "Search failed, keep typing to retry");
+    }
+}
+
+static void search_timer_cb(lv_timer_t *timer) {
+    search_run();
+}
+
+static void search_textarea_cb(lv_event_t *e) {
+    switch (lv_event_get_code(e)) {
+        case LV_EVENT_VALUE_CHANGED:
+            // Restart the debounce on every keystroke
+            lv_timer_reset(g_gui_state.search_timer);
+            lv_timer_resume(g_gui_state.search_timer);
+            break;
+        case LV_EVENT_READY:
+            search_set_keyboard_visible(false);
+            search_run();
+            break;
+        case LV_EVENT_FOCUSED:
+            search_set_keyboard_visible(true);
+            break;
+        default:
+            break;
+    }
+}
+
+// READY is left to the text area, which closes the keyboard and searches
+static void search_keyboard_cb(lv_event_t *e) {
+    if (lv_event_get_code(e) == LV_EVENT_CANCEL) {
+        search_set_keyboard_visible(false);
+    }
+}
+
+static void search_bar_delete_cb(lv_event_t *e) {
+    if (g_gui_state.search_timer) {
+        lv_timer_del(g_gui_state.search_timer);
+        g_gui_state.search_timer = NULL;
+    }
+    g_gui_state.search_textarea = NULL;
+    spotify_controller_cancel_search(g_gui_state.controller_handle);
+}
+
+// Leaving the search screen: nothing typed or in flight may land on another one
+static void search_stop(void) {
+    ui_widget_pool_keyboard_release(g_gui_state.search_screen);
+    if (g_gui_state.search_timer) {
+        lv_timer_pause(g_gui_state.search_timer);
+    }
+    spotify_controller_cancel_search(g_gui_state.controller_handle);
+}
+
+static void search_screen_delete_cb(lv_event_t *e) {
+    g_gui_state.search_status = NULL;
 }
 
 void spotify_gui_show_search_screen(void) {
-    ESP_LOGI(TAG, "Show search screen - not implemented yet");
+    ESP_LOGI(TAG, "Showing search screen");
+
+    if (screen_deferred(SPOTIFY_GUI_SCREEN_SEARCH)) {
+        return;
+    }
+    // The track views may belong to a playlist by now: the results start
+    // empty again, and the query left in the field is searched once more
+    if (!screen_show(&g_gui_state.search_screen, SPOTIFY_GUI_SCREEN_SEARCH, lv_pct(90), lv_pct(80))) {
+        g_gui_state.current_track_count = 0;
+        virtual_list_set_count(&g_gui_state.search_list, 0);
+        search_run();
+        search_set_keyboard_visible(true);
+        return;
+    }
+    lv_obj_clear_flag(g_gui_state.search_screen, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_event_cb(g_gui_state.search_screen, search_screen_delete_cb, LV_EVENT_DELETE, NULL);
+
+    // Create back button
+    lv_obj_t *back_btn = lv_btn_create(g_gui_state.search_screen);
+    lv_obj_set_size(back_btn, 60, 30);
+    lv_obj_align(back_btn, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_add_event_cb(back_btn, back_button_cb, LV_EVENT_CLICKED, NULL);
+
+    lv_obj_t *back_label = lv_label_create(back_btn);
+    lv_label_set_text(back_label, "Back");
+    lv_obj_center(back_label);
+
+    lv_obj_t *search_bar = spotify_gui_create_search_bar(g_gui_state.search_screen);
+    if (!search_bar) {
+        spotify_gui_show_error("Search is not available");
+        return;
+    }
+    lv_obj_align(search_bar, LV_ALIGN_TOP_RIGHT, 0, 0);
+
+    g_gui_state.search_status = lv_label_create(g_gui_state.search_screen);
+    lv_label_set_text(g_gui_state.search_status, "Type to search");
+    lv_obj_align(g_gui_state.search_status, LV_ALIGN_TOP_MID, 0, 45);
+
+    // Results start empty; the list grows as pages arrive
+    g_gui_state.current_track_count = 0;
+    virtual_list_create(&g_gui_state.search_list, g_gui_state.search_screen, 0,
+                        bind_track_row, track_image_url, track_button_cb, load_more_tracks);
+    lv_obj_set_width(g_gui_state.search_list.container, lv_pct(100));
+    lv_obj_align(g_gui_state.search_list.container, LV_ALIGN_TOP_MID, 0, 70);
+
+    search_set_keyboard_visible(true);
 }
 
 void spotify_gui_update_playback_state(const spotify_playback_state_t *playback_state) {
-    ESP_LOGI(TAG, "Update playback state - not implemented yet");
+    if (!playback_state) {
+        return;
+    }
+    if (playback_state != &g_gui_state.playback) {
+        g_gui_state.playback = *playback_state;
+        g_gui_state.has_playback = true;
+    }
+
+    // Only the widgets whose fields changed redraw
+    now_playing_store_set_playback(&g_gui_state.playback);
 }
 
 lv_obj_t *spotify_gui_create_qr_code(lv_obj_t *parent, const char *url) {
@@ -948,8 +1830,26 @@ lv_obj_t *spotify_gui_create_volume_control(lv_obj_t *parent) {
 }
 
 lv_obj_t *spotify_gui_create_search_bar(lv_obj_t *parent) {
-    ESP_LOGI(TAG, "Create search bar - not implemented yet");
-    return NULL;
+    if (!parent) {
+        return NULL;
+    }
+
+    if (!g_gui_state.search_timer) {
+        g_gui_state.search_timer = lv_timer_create(search_timer_cb, SPOTIFY_GUI_SEARCH_DEBOUNCE_MS, NULL);
+        if (!g_gui_state.search_timer) {
+            ESP_LOGE(TAG, "Failed to create search timer");
+            return NULL;
+        }
+        lv_timer_pause(g_gui_state.search_timer);
+    }
+
+    g_gui_state.search_textarea = lv_textarea_create(parent);
+    lv_textarea_set_placeholder_text(g_gui_state.search_textarea, "Search tracks");
+    lv_textarea_set_one_line(g_gui_state.search_textarea, true);
+    lv_obj_set_width(g_gui_state.search_textarea, lv_pct(75));
+    lv_obj_add_event_cb(g_gui_state.search_textarea, search_textarea_cb, LV_EVENT_ALL, NULL);
+    lv_obj_add_event_cb(g_gui_state.search_textarea, search_bar_delete_cb, LV_EVENT_DELETE, NULL);
+    return g_gui_state.search_textarea;
 }
 
 void spotify_gui_set_status_bar_position(lv_align_t align, int32_t x_offset, int32_t y_offset) {
@@ -972,6 +1872,43 @@ void spotify_gui_refresh_current_screen(void) {
     spotify_gui_navigate_to_screen(g_gui_state.current_screen_type);
 }
 
+// Cast devices from discovery, then the Connect devices they do not already
+// name; both lists are cached, so this never waits on the network
+static void fill_device_list(void) {
+    lv_obj_t *list = g_gui_state.device_list;
+    lv_obj_clean(list);
+
+    int cast_count = esp_cast_get_chromecast_devices_for_spotify_strings(g_gui_state.modal_devices,
+                                                                         SPOTIFY_GUI_CAST_DEVICES_MAX);
+    size_t count = 0;
+    for (; count < (size_t)cast_count; count++) {
+        g_gui_state.modal_device_connect[count] = false;
+    }
+    for (size_t i = 0; i < g_gui_state.connect_device_count && count < SPOTIFY_GUI_CAST_DEVICES_MAX; i++) {
+        const char *name = g_gui_state.connect_devices[i];
+        bool listed = false;
+        for (int j = 0; j < cast_count && !listed; j++) {
+            listed = strcmp(g_gui_state.modal_devices[j], name) == 0;
+        }
+        if (!listed) {
+            strlcpy(g_gui_state.modal_devices[count], name, sizeof(g_gui_state.modal_devices[0]));
+            g_gui_state.modal_device_connect[count++] = true;
+        }
+    }
+    g_gui_state.modal_device_count = count;
+
+    if (count == 0) {
+        lv_list_add_text(list, "No devices found");
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        const char *symbol = g_gui_state.modal_device_connect[i] ? LV_SYMBOL_WIFI : LV_SYMBOL_AUDIO;
+        lv_obj_t *btn = lv_list_add_btn(list, symbol, g_gui_state.modal_devices[i]);
+        lv_obj_set_user_data(btn, (void *)(uintptr_t)i);
+        lv_obj_add_event_cb(btn, chromecast_device_button_cb, LV_EVENT_CLICKED, g_gui_state.device_modal);
+    }
+}
+
 void spotify_gui_show_chromecast_selection(const char *track_uri) {
     if (!track_uri || !g_gui_state.main_container) {
         ESP_LOGE(TAG, "Invalid parameters for Chromecast selection");
@@ -980,53 +1917,28 @@ void spotify_gui_show_chromecast_selection(const char *track_uri) {
 
     ESP_LOGI(TAG, "Showing Chromecast device selection for track: %s", track_uri);
 
-    // Create modal dialog for device selection
-    lv_obj_t *modal = lv_obj_create(lv_scr_act());
-    lv_obj_set_size(modal, 300, 200);
-    lv_obj_center(modal);
-    lv_obj_add_flag(modal, LV_OBJ_FLAG_FLOATING);
-
-    // Add title
-    lv_obj_t *title = lv_label_create(modal);
-    lv_label_set_text(title, "Select Chromecast Device");
-    lv_obj_align(title, LV_ALIGN_TOP_MID, 0, 10);
-
-    // Get available Chromecast devices
-    char devices[5][64];
-    int device_count = esp_cast_get_chromecast_devices_for_spotify_strings(devices, 5);
+    // Device selection modal; the list in it is deleted when it closes
+    ui_modal_t *modal = ui_widget_pool_modal_open(300, 200, "Select Device", false);
+    if (!modal) {
+        return;
+    }
+    if (track_uri != g_gui_state.modal_track_uri) {
+        strlcpy(g_gui_state.modal_track_uri, track_uri, sizeof(g_gui_state.modal_track_uri));
+    }
 
-    if (device_count == 0) {
-        lv_obj_t *no_devices = lv_label_create(modal);
-        lv_label_set_text(no_devices, "No Chromecast devices found");
-        lv_obj_center(no_devices);
-    } else {
-        // Create device list
-        lv_obj_t *list = lv_list_create(modal);
-        lv_obj_set_size(list, 250, 120);
-        lv_obj_align(list, LV_ALIGN_CENTER, 0, 0);
-
-        for (int i = 0; i < device_count; i++) {
-            lv_obj_t *btn = lv_list_add_btn(list, LV_SYMBOL_AUDIO, devices[i]);
-
-            // Store track URI and device name for the callback
-            char *user_data = malloc(strlen(track_uri) + strlen(devices[i]) + 2);
-            if (user_data) {
-                sprintf(user_data, "%s|%s", track_uri, devices[i]);
-                lv_obj_set_user_data(btn, user_data);
-                lv_obj_add_event_cb(btn, chromecast_device_button_cb, LV_EVENT_CLICKED, NULL);
-            }
-        }
+    // Shown from the caches at once; the Connect list is refreshed behind it
+    g_gui_state.device_modal = modal;
+    g_gui_state.device_list = lv_list_create(modal->box);
+    lv_obj_set_size(g_gui_state.device_list, 250, 120);
+    lv_obj_align(g_gui_state.device_list, LV_ALIGN_CENTER, 0, 0);
+    fill_device_list();
+    if (g_gui_state.controller_handle) {
+        spotify_controller_get_devices(g_gui_state.controller_handle);
     }
 
-    // Add close button
-    lv_obj_t *close_btn = lv_btn_create(modal);
+    lv_obj_t *close_btn = ui_widget_pool_modal_button(modal, 0, "Close", close_modal_button_cb);
     lv_obj_set_size(close_btn, 60, 30);
     lv_obj_align(close_btn, LV_ALIGN_BOTTOM_RIGHT, -10, -10);
-    lv_obj_add_event_cb(close_btn, close_modal_button_cb, LV_EVENT_CLICKED, NULL);
-
-    lv_obj_t *close_label = lv_label_create(close_btn);
-    lv_label_set_text(close_label, "Close");
-    lv_obj_center(close_label);
 }
 
 void spotify_gui_cast_to_chromecast(const char *device_name, const char *track_uri) {
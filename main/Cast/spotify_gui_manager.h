@@ -63,6 +63,15 @@ esp_err_t spotify_gui_manager_deinit(void);
  */
 lv_obj_t *spotify_gui_create_interface(lv_obj_t *parent);
 
+/**
+ * @brief Forget the interface's widgets before its parent deletes them
+ *
+ * The status line, the screen on display and the data behind it are kept;
+ * until the next spotify_gui_create_interface(), which shows them again,
+ * the show functions only note the screen asked for.
+ */
+void spotify_gui_unload_interface(void);
+
 /**
  * @brief Show configuration screen
  *
@@ -83,7 +92,17 @@ void spotify_gui_show_auth_screen(void);
  * @param playlists Array of playlists
  * @param playlist_count Number of playlists
  */
-void spotify_gui_show_playlists(const spotify_playlist_info_t *playlists, size_t playlist_count);
+void spotify_gui_show_playlists(const spotify_playlist_view_t *playlists, size_t playlist_count);
+
+/**
+ * @brief Show the last session's playlists and playback from the library snapshot
+ *
+ * Used at boot, before the network is up; the live lists replace them as
+ * they arrive.
+ *
+ * @return true if the snapshot had playlists to show
+ */
+bool spotify_gui_show_snapshot(void);
 
 /**
  * @brief Show tracks screen
@@ -92,7 +111,7 @@ void spotify_gui_show_playlists(const spotify_playlist_info_t *playlists, size_t
  * @param track_count Number of tracks
  * @param title Screen title (e.g., playlist name)
  */
-void spotify_gui_show_tracks(const spotify_track_info_t *tracks, size_t track_count, const char *title);
+void spotify_gui_show_tracks(const spotify_track_view_t *tracks, size_t track_count, const char *title);
 
 /**
  * @brief Show now playing screen
@@ -103,6 +122,9 @@ void spotify_gui_show_player(const spotify_playback_state_t *playback_state);
 
 /**
  * @brief Show search screen
+ * 
+ * Searches as the user types, once typing pauses for a moment; results
+ * replace the list below the search field.
  */
 void spotify_gui_show_search_screen(void);
 
@@ -195,28 +217,32 @@ lv_obj_t *spotify_gui_create_volume_control(lv_obj_t *parent);
 /**
  * @brief Create search bar
  * 
+ * One-line text area that starts a debounced track search on every edit.
+ * Only one search bar can be live at a time.
+ * 
  * @param parent Parent object
  * @return lv_obj_t* Search bar object
  */
 lv_obj_t *spotify_gui_create_search_bar(lv_obj_t *parent);
 
 /**
- * @brief Create playlist item
+ * @brief Show a playlist in a list row
+ * 
+ * Lists keep a small pool of rows that are re-bound as they scroll, so this
+ * only sets the row's text.
  * 
- * @param parent Parent list object
+ * @param label Label of the list row
  * @param playlist Playlist information
- * @return lv_obj_t* Playlist item object
  */
-lv_obj_t *spotify_gui_create_playlist_item(lv_obj_t *parent, const spotify_playlist_info_t *playlist);
+void spotify_gui_bind_playlist_item(lv_obj_t *label, const spotify_playlist_view_t *playlist);
 
 /**
- * @brief Create track item
+ * @brief Show a track in a list row
  * 
- * @param parent Parent list object
+ * @param label Label of the list row
  * @param track Track information
- * @return lv_obj_t* Track item object
  */
-lv_obj_t *spotify_gui_create_track_item(lv_obj_t *parent, const spotify_track_info_t *track);
+void spotify_gui_bind_track_item(lv_obj_t *label, const spotify_track_view_t *track);
 
 /**
  * @brief Get status bar object
@@ -0,0 +1,475 @@
+#include "spotify_library_snapshot.h"
+#include "lvgl.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "spotify_snapshot";
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t playlist_count;
+    uint16_t recent_count;
+    uint16_t has_playback;
+    uint32_t string_bytes;
+} snapshot_header_t;
+
+// Strings are offsets into the pool; offset 0 is ""
+typedef struct {
+    uint32_t id;
+    uint32_t name;
+    uint32_t uri;
+    uint32_t image_url;
+    uint32_t owner;
+    int32_t track_count;
+} snapshot_playlist_t;
+
+typedef struct {
+    uint32_t id;
+    uint32_t name;
+    uint32_t artist;
+    uint32_t album;
+    uint32_t uri;
+    uint32_t image_url;
+    int32_t duration_ms;
+} snapshot_track_t;
+
+typedef struct {
+    snapshot_track_t track;
+    uint32_t device_id;
+    uint32_t device_name;
+    uint32_t repeat_state;
+    int32_t progress_ms;
+    int32_t volume_percent;
+    uint32_t shuffle_state;
+} snapshot_playback_t;
+
+// File layout: header, playlists, recent tracks, one playback record (used
+// if has_playback), string pool
+#define SNAPSHOT_PLAYLISTS_AT   sizeof(snapshot_header_t)
+#define SNAPSHOT_RECENT_AT(h)   (SNAPSHOT_PLAYLISTS_AT + (h)->playlist_count * sizeof(snapshot_playlist_t))
+#define SNAPSHOT_PLAYBACK_AT(h) (SNAPSHOT_RECENT_AT(h) + (h)->recent_count * sizeof(snapshot_track_t))
+#define SNAPSHOT_STRINGS_AT(h)  (SNAPSHOT_PLAYBACK_AT(h) + sizeof(snapshot_playback_t))
+
+// The fixed-size copies are a few KB each, so they live in PSRAM too
+typedef struct {
+    spotify_playback_state_t playback;
+    spotify_track_info_t recent[SPOTIFY_SNAPSHOT_MAX_RECENT];
+} snapshot_state_t;
+
+typedef struct {
+    uint8_t *buf;
+    uint32_t strings_at;
+    uint32_t string_bytes;
+} snapshot_writer_t;
+
+static uint8_t *s_blob;                     // The playlists' views point into its pool
+static spotify_playlist_view_t *s_views;
+static size_t s_view_count;
+static snapshot_state_t *s_state;
+static bool s_has_playback;
+static size_t s_recent_count;
+static lv_timer_t *s_save_timer;
+
+static void *snapshot_alloc(size_t size) {
+    void *ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return ptr ? ptr : malloc(size);
+}
+
+static bool snapshot_ensure_state(void) {
+    if (!s_state) {
+        s_state = snapshot_alloc(sizeof(*s_state));
+        if (!s_state) {
+            ESP_LOGE(TAG, "No memory for the snapshot state");
+            return false;
+        }
+        memset(s_state, 0, sizeof(*s_state));
+    }
+    return true;
+}
+
+static void copy_string(char *field, size_t size, const char *value) {
+    strncpy(field, value ? value : "", size - 1);
+    field[size - 1] = '\0';
+}
+
+/************************************************************************************************
+ *  File format
+ ************************************************************************************************/
+static size_t string_size(const char *value) {
+    return value && value[0] ? strlen(value) + 1 : 0;
+}
+
+static uint32_t write_string(snapshot_writer_t *w, const char *value) {
+    size_t size = string_size(value);
+    if (size == 0) {
+        return 0;
+    }
+    uint32_t offset = w->string_bytes;
+    memcpy(w->buf + w->strings_at + offset, value, size);
+    w->string_bytes += size;
+    return offset;
+}
+
+static size_t track_strings_size(const spotify_track_info_t *track) {
+    return string_size(track->id) + string_size(track->name) + string_size(track->artist) +
+           string_size(track->album) + string_size(track->uri) + string_size(track->image_url);
+}
+
+static void write_track(snapshot_writer_t *w, snapshot_track_t *record, const spotify_track_info_t *track) {
+    record->id = write_string(w, track->id);
+    record->name = write_string(w, track->name);
+    record->artist = write_string(w, track->artist);
+    record->album = write_string(w, track->album);
+    record->uri = write_string(w, track->uri);
+    record->image_url = write_string(w, track->image_url);
+    record->duration_ms = track->duration_ms;
+}
+
+// One buffer holding the whole file, from the given playlists and the
+// current playback and recent tracks
+static uint8_t *snapshot_build(const spotify_playlist_view_t *playlists, size_t count, size_t *size_out) {
+    snapshot_header_t header = {
+        .magic = SPOTIFY_SNAPSHOT_MAGIC,
+        .version = SPOTIFY_SNAPSHOT_VERSION,
+        .playlist_count = (uint16_t)count,
+        .recent_count = (uint16_t)s_recent_count,
+        .has_playback = s_has_playback,
+        .string_bytes = 1,
+    };
+    for (size_t i = 0; i < count; i++) {
+        const spotify_playlist_view_t *playlist = &playlists[i];
+        header.string_bytes += string_size(playlist->id) + string_size(playlist->name) +
+                               string_size(playlist->uri) + string_size(playlist->image_url) +
+                               string_size(playlist->owner);
+    }
+    for (size_t i = 0; i < s_recent_count; i++) {
+        header.string_bytes += track_strings_size(&s_state->recent[i]);
+    }
+    if (s_has_playback) {
+        const spotify_playback_state_t *playback = &s_state->playback;
+        header.string_bytes += track_strings_size(&playback->current_track) + string_size(playback->device_id) +
+                               string_size(playback->device_name) + string_size(playback->repeat_state);
+    }
+
+    size_t size = SNAPSHOT_STRINGS_AT(&header) + header.string_bytes;
+    if (size > SPOTIFY_SNAPSHOT_MAX_BYTES) {
+        ESP_LOGW(TAG, "Snapshot would take %u bytes, not kept", (unsigned)size);
+        return NULL;
+    }
+    uint8_t *buf = snapshot_alloc(size);
+    if (!buf) {
+        ESP_LOGE(TAG, "No memory for a %u byte snapshot", (unsigned)size);
+        return NULL;
+    }
+    memset(buf, 0, SNAPSHOT_STRINGS_AT(&header));
+
+    snapshot_writer_t w = { .buf = buf, .strings_at = SNAPSHOT_STRINGS_AT(&header), .string_bytes = 1 };
+    buf[w.strings_at] = '\0';
+    snapshot_playlist_t *records = (snapshot_playlist_t *)(buf + SNAPSHOT_PLAYLISTS_AT);
+    for (size_t i = 0; i < count; i++) {
+        records[i].id = write_string(&w, playlists[i].id);
+        records[i].name = write_string(&w, playlists[i].name);
+        records[i].uri = write_string(&w, playlists[i].uri);
+        records[i].image_url = write_string(&w, playlists[i].image_url);
+        records[i].owner = write_string(&w, playlists[i].owner);
+        records[i].track_count = playlists[i].track_count;
+    }
+    snapshot_track_t *recent = (snapshot_track_t *)(buf + SNAPSHOT_RECENT_AT(&header));
+    for (size_t i = 0; i < s_recent_count; i++) {
+        write_track(&w, &recent[i], &s_state->recent[i]);
+    }
+    if (s_has_playback) {
+        const spotify_playback_state_t *playback = &s_state->playback;
+        snapshot_playback_t *record = (snapshot_playback_t *)(buf + SNAPSHOT_PLAYBACK_AT(&header));
+        write_track(&w, &record->track, &playback->current_track);
+        record->device_id = write_string(&w, playback->device_id);
+        record->device_name = write_string(&w, playback->device_name);
+        record->repeat_state = write_string(&w, playback->repeat_state);
+        record->progress_ms = playback->progress_ms;
+        record->volume_percent = playback->volume_percent;
+        record->shuffle_state = playback->shuffle_state;
+    }
+    memcpy(buf, &header, sizeof(header));
+
+    *size_out = size;
+    return buf;
+}
+
+static bool track_valid(const snapshot_track_t *track, uint32_t string_bytes) {
+    return track->id < string_bytes && track->name < string_bytes && track->artist < string_bytes &&
+           track->album < string_bytes && track->uri < string_bytes && track->image_url < string_bytes;
+}
+
+static bool snapshot_valid(const uint8_t *blob, size_t size) {
+    const snapshot_header_t *h = (const snapshot_header_t *)blob;
+    if (size < sizeof(*h) || h->magic != SPOTIFY_SNAPSHOT_MAGIC || h->version != SPOTIFY_SNAPSHOT_VERSION ||
+        h->playlist_count > SPOTIFY_SNAPSHOT_MAX_PLAYLISTS || h->recent_count > SPOTIFY_SNAPSHOT_MAX_RECENT ||
+        h->string_bytes < 1 || SNAPSHOT_STRINGS_AT(h) + h->string_bytes != size) {
+        return false;
+    }
+    uint32_t n = h->string_bytes;
+    if (blob[SNAPSHOT_STRINGS_AT(h) + n - 1] != '\0') {
+        return false;
+    }
+    const snapshot_playlist_t *playlists = (const snapshot_playlist_t *)(blob + SNAPSHOT_PLAYLISTS_AT);
+    for (uint32_t i = 0; i < h->playlist_count; i++) {
+        const snapshot_playlist_t *p = &playlists[i];
+        if (p->id >= n || p->name >= n || p->uri >= n || p->image_url >= n || p->owner >= n) {
+            return false;
+        }
+    }
+    const snapshot_track_t *recent = (const snapshot_track_t *)(blob + SNAPSHOT_RECENT_AT(h));
+    for (uint32_t i = 0; i < h->recent_count; i++) {
+        if (!track_valid(&recent[i], n)) {
+            return false;
+        }
+    }
+    const snapshot_playback_t *playback = (const snapshot_playback_t *)(blob + SNAPSHOT_PLAYBACK_AT(h));
+    return !h->has_playback || (track_valid(&playback->track, n) && playback->device_id < n &&
+                                playback->device_name < n && playback->repeat_state < n);
+}
+
+static void read_track(spotify_track_info_t *track, const snapshot_track_t *record, const char *strings) {
+    memset(track, 0, sizeof(*track));
+    copy_string(track->id, sizeof(track->id), strings + record->id);
+    copy_string(track->name, sizeof(track->name), strings + record->name);
+    copy_string(track->artist, sizeof(track->artist), strings + record->artist);
+    copy_string(track->album, sizeof(track->album), strings + record->album);
+    copy_string(track->uri, sizeof(track->uri), strings + record->uri);
+    copy_string(track->image_url, sizeof(track->image_url), strings + record->image_url);
+    track->duration_ms = record->duration_ms;
+}
+
+// Point the playlist views into a checked blob, which the snapshot then owns
+static bool snapshot_adopt(uint8_t *blob) {
+    const snapshot_header_t *h = (const snapshot_header_t *)blob;
+    spotify_playlist_view_t *views = NULL;
+    if (h->playlist_count > 0) {
+        views = snapshot_alloc(h->playlist_count * sizeof(*views));
+        if (!views) {
+            free(blob);
+            return false;
+        }
+    }
+
+    const char *strings = (const char *)blob + SNAPSHOT_STRINGS_AT(h);
+    const snapshot_playlist_t *records = (const snapshot_playlist_t *)(blob + SNAPSHOT_PLAYLISTS_AT);
+    for (size_t i = 0; i < h->playlist_count; i++) {
+        views[i].id = strings + records[i].id;
+        views[i].name = strings + records[i].name;
+        views[i].uri = strings + records[i].uri;
+        views[i].image_url = strings + records[i].image_url;
+        views[i].owner = strings + records[i].owner;
+        views[i].track_count = records[i].track_count;
+    }
+
+    free(s_views);
+    free(s_blob);
+    s_blob = blob;
+    s_views = views;
+    s_view_count = h->playlist_count;
+    return true;
+}
+
+// Written beside and renamed over, so a reset half way leaves the old file
+static void snapshot_save(void) {
+    size_t size = 0;
+    uint8_t *buf = snapshot_build(s_views, s_view_count, &size);
+    if (!buf) {
+        return;
+    }
+
+    const char *temp_path = SPOTIFY_SNAPSHOT_FILE ".tmp";
+    FILE *fp = fopen(temp_path, "wb");
+    if (!fp) {
+        ESP_LOGW(TAG, "Cannot write %s", temp_path);
+        free(buf);
+        return;
+    }
+    bool ok = fwrite(buf, 1, size, fp) == size;
+    free(buf);
+    if (fclose(fp) != 0 || !ok) {
+        ESP_LOGW(TAG, "Failed to write %s", temp_path);
+        remove(temp_path);
+        return;
+    }
+    remove(SPOTIFY_SNAPSHOT_FILE);      // FATFS will not rename over a file
+    if (rename(temp_path, SPOTIFY_SNAPSHOT_FILE) != 0) {
+        ESP_LOGW(TAG, "Failed to replace %s", SPOTIFY_SNAPSHOT_FILE);
+        return;
+    }
+    ESP_LOGI(TAG, "Saved %u playlists, %u recent tracks (%u bytes)",
+             (unsigned)s_view_count, (unsigned)s_recent_count, (unsigned)size);
+}
+
+static void save_timer_cb(lv_timer_t *timer) {
+    s_save_timer = NULL;    // One shot: LVGL deletes it after this run
+    snapshot_save();
+}
+
+static void schedule_save(void) {
+    if (s_save_timer) {
+        return;
+    }
+    s_save_timer = lv_timer_create(save_timer_cb, SPOTIFY_SNAPSHOT_SAVE_DELAY_MS, NULL);
+    if (s_save_timer) {
+        lv_timer_set_repeat_count(s_save_timer, 1);
+    } else {
+        snapshot_save();
+    }
+}
+
+/************************************************************************************************
+ *  API
+ ************************************************************************************************/
+bool spotify_snapshot_load(void) {
+    FILE *fp = fopen(SPOTIFY_SNAPSHOT_FILE, "rb");
+    if (!fp) {
+        return false;
+    }
+    uint8_t *blob = NULL;
+    size_t size = 0;
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        long length = ftell(fp);
+        if (length > 0 && length <= SPOTIFY_SNAPSHOT_MAX_BYTES && fseek(fp, 0, SEEK_SET) == 0) {
+            size = (size_t)length;
+            blob = snapshot_alloc(size);
+        }
+    }
+    bool ok = blob && fread(blob, 1, size, fp) == size && snapshot_valid(blob, size) && snapshot_ensure_state();
+    fclose(fp);
+    if (!ok) {
+        ESP_LOGW(TAG, "%s is not usable", SPOTIFY_SNAPSHOT_FILE);
+        free(blob);
+        return false;
+    }
+
+    const snapshot_header_t *h = (const snapshot_header_t *)blob;
+    const char *strings = (const char *)blob + SNAPSHOT_STRINGS_AT(h);
+    const snapshot_track_t *recent = (const snapshot_track_t *)(blob + SNAPSHOT_RECENT_AT(h));
+    for (size_t i = 0; i < h->recent_count; i++) {
+        read_track(&s_state->recent[i], &recent[i], strings);
+    }
+    s_recent_count = h->recent_count;
+
+    s_has_playback = h->has_playback;
+    if (s_has_playback) {
+        const snapshot_playback_t *record = (const snapshot_playback_t *)(blob + SNAPSHOT_PLAYBACK_AT(h));
+        spotify_playback_state_t *playback = &s_state->playback;
+        memset(playback, 0, sizeof(*playback));
+        read_track(&playback->current_track, &record->track, strings);
+        copy_string(playback->device_id, sizeof(playback->device_id), strings + record->device_id);
+        copy_string(playback->device_name, sizeof(playback->device_name), strings + record->device_name);
+        copy_string(playback->repeat_state, sizeof(playback->repeat_state), strings + record->repeat_state);
+        playback->progress_ms = record->progress_ms;
+        playback->volume_percent = record->volume_percent;
+        playback->shuffle_state = record->shuffle_state != 0;
+        playback->is_playing = false;   // Until the first poll says otherwise
+    }
+
+    if (!snapshot_adopt(blob)) {
+        return false;
+    }
+    ESP_LOGI(TAG, "Loaded %u playlists, %u recent tracks", (unsigned)s_view_count, (unsigned)s_recent_count);
+    return s_view_count > 0 || s_has_playback;
+}
+
+const spotify_playlist_view_t *spotify_snapshot_playlists(size_t *count) {
+    if (count) {
+        *count = s_view_count;
+    }
+    return s_view_count > 0 ? s_views : NULL;
+}
+
+const spotify_playback_state_t *spotify_snapshot_playback(void) {
+    return s_has_playback ? &s_state->playback : NULL;
+}
+
+const spotify_track_info_t *spotify_snapshot_recent_track(size_t index) {
+    return index < s_recent_count ? &s_state->recent[index] : NULL;
+}
+
+static bool playlist_equal(const spotify_playlist_view_t *a, const spotify_playlist_view_t *b) {
+    return a->track_count == b->track_count && strcmp(a->id, b->id) == 0 && strcmp(a->name, b->name) == 0 &&
+           strcmp(a->uri, b->uri) == 0 && strcmp(a->image_url, b->image_url) == 0 &&
+           strcmp(a->owner, b->owner) == 0;
+}
+
+bool spotify_snapshot_set_playlists(const spotify_playlist_view_t *playlists, size_t count) {
+    if (!playlists) {
+        return true;
+    }
+
+    // The rows on screen are current only if the whole list matches; only
+    // the head of a longer one is kept
+    size_t kept = count < SPOTIFY_SNAPSHOT_MAX_PLAYLISTS ? count : SPOTIFY_SNAPSHOT_MAX_PLAYLISTS;
+    bool same = kept == s_view_count;
+    for (size_t i = 0; same && i < kept; i++) {
+        same = playlist_equal(&playlists[i], &s_views[i]);
+    }
+    if (same) {
+        return count > kept;
+    }
+
+    if (!snapshot_ensure_state()) {
+        return true;
+    }
+    size_t size = 0;
+    uint8_t *blob = snapshot_build(playlists, kept, &size);
+    if (blob && snapshot_adopt(blob)) {
+        schedule_save();
+    }
+    return true;
+}
+
+void spotify_snapshot_set_playback(const spotify_playback_state_t *playback) {
+    if (!playback || !snapshot_ensure_state()) {
+        return;
+    }
+
+    const spotify_playback_state_t *old = &s_state->playback;
+    const char *id = playback->current_track.id;
+    bool new_track = id[0] && strcmp(id, s_recent_count > 0 ? s_state->recent[0].id : "") != 0;
+    bool changed = !s_has_playback || new_track ||
+                   strcmp(id, old->current_track.id) != 0 ||
+                   strcmp(playback->device_id, old->device_id) != 0 ||
+                   strcmp(playback->repeat_state, old->repeat_state) != 0 ||
+                   playback->volume_percent != old->volume_percent ||
+                   playback->shuffle_state != old->shuffle_state;
+
+    s_state->playback = *playback;
+    s_has_playback = true;
+
+    if (new_track) {
+        // Move it to the front, dropping an older entry for the same track
+        size_t end = s_recent_count < SPOTIFY_SNAPSHOT_MAX_RECENT ? s_recent_count : SPOTIFY_SNAPSHOT_MAX_RECENT - 1;
+        for (size_t i = 1; i < s_recent_count; i++) {
+            if (strcmp(s_state->recent[i].id, id) == 0) {
+                end = i;
+                break;
+            }
+        }
+        memmove(&s_state->recent[1], &s_state->recent[0], end * sizeof(s_state->recent[0]));
+        s_state->recent[0] = playback->current_track;
+        if (end == s_recent_count) {
+            s_recent_count++;
+        }
+    }
+
+    if (changed) {
+        schedule_save();
+    }
+}
+
+void spotify_snapshot_flush(void) {
+    if (!s_save_timer) {
+        return;
+    }
+    lv_timer_del(s_save_timer);
+    s_save_timer = NULL;
+    snapshot_save();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "spotify_controller_wrapper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Spotify library snapshot - the last session's library, for boot
+ *
+ * Without it the Spotify tab showed nothing useful until Wi-Fi was up, the
+ * token refreshed and the first playlists page fetched. The snapshot keeps
+ * the first SPOTIFY_SNAPSHOT_MAX_PLAYLISTS playlists, the last playback
+ * state and the SPOTIFY_SNAPSHOT_MAX_RECENT tracks played last in one flat
+ * file on the flash_test partition: a header, the playlist, recent track
+ * and playback tables, then a string pool, read with a single fread into
+ * PSRAM and checked before use. The GUI shows it at once and swaps in the
+ * live lists as they arrive.
+ *
+ * Live data is compared with the snapshot as it comes in: an unchanged
+ * playlists page or a mere position update changes nothing, and anything
+ * else is saved SPOTIFY_SNAPSHOT_SAVE_DELAY_MS later, coalescing bursts into
+ * one flash write. Saves go to a temporary file renamed over the old one,
+ * so a reset half way keeps the previous snapshot.
+ *
+ * LVGL thread only. The views returned stay valid until the next
+ * spotify_snapshot_set_playlists() that returns true.
+ */
+
+#define SPOTIFY_SNAPSHOT_FILE           "/flash/.spotify.snap"
+#define SPOTIFY_SNAPSHOT_MAGIC          0x50414E53  // "SNAP"
+#define SPOTIFY_SNAPSHOT_VERSION        1
+#define SPOTIFY_SNAPSHOT_MAX_PLAYLISTS  64
+#define SPOTIFY_SNAPSHOT_MAX_RECENT     8
+#define SPOTIFY_SNAPSHOT_MAX_BYTES      (64 * 1024)     // Sanity limit on a loaded file
+#define SPOTIFY_SNAPSHOT_SAVE_DELAY_MS  5000
+
+/**
+ * @brief Load the snapshot file, if there is a usable one
+ * @return true if it held anything to show
+ */
+bool spotify_snapshot_load(void);
+
+/**
+ * @brief The snapshot's playlists
+ * @return NULL (count 0) if there are none
+ */
+const spotify_playlist_view_t *spotify_snapshot_playlists(size_t *count);
+
+/**
+ * @brief The last playback state (is_playing is false if it came from the file)
+ * @return NULL if there is none
+ */
+const spotify_playback_state_t *spotify_snapshot_playback(void);
+
+/**
+ * @brief A recently played track, 0 being the current (or last) one
+ * @return NULL past the end
+ */
+const spotify_track_info_t *spotify_snapshot_recent_track(size_t index);
+
+/**
+ * @brief Reconcile with a live playlists list (the pages received so far)
+ *
+ * Call once the GUI no longer shows the snapshot's views.
+ * @return true if the list differs from the snapshot's (which then takes
+ *         it on); false if it is the same and the rows on screen are current
+ */
+bool spotify_snapshot_set_playlists(const spotify_playlist_view_t *playlists, size_t count);
+
+/**
+ * @brief Reconcile with a live playback state
+ *
+ * A new track goes to the front of the recent tracks. Only a change of
+ * track, device, volume, shuffle or repeat is saved, not the position alone.
+ */
+void spotify_snapshot_set_playback(const spotify_playback_state_t *playback);
+
+/**
+ * @brief Write a save still waiting out SPOTIFY_SNAPSHOT_SAVE_DELAY_MS now
+ *
+ * For power-down; on the LVGL thread like the rest. Does nothing if the
+ * file is current.
+ */
+void spotify_snapshot_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,201 @@
+#include "spotify_thumbnails.h"
+#include "spotify_album_art.h"
+#include "esp_log.h"
+#include <stdint.h>
+#include <string.h>
+
+static const char *TAG = "spotify_thumbnails";
+
+// Every row keeps its entry, with room left for the fetch that arrives next
+_Static_assert(SPOTIFY_THUMBNAILS_MAX_ROWS < SPOTIFY_ALBUM_ART_THUMB_CACHE_SIZE,
+               "thumbnail cache must outlast a full pool of rows");
+
+typedef struct {
+    lv_obj_t *image;
+    uint32_t hash;          // Of the image URL, 0 for none
+} thumbnail_row_t;
+
+typedef struct {
+    char url[SPOTIFY_THUMBNAILS_URL_LEN];
+    uint32_t hash;
+} thumbnail_want_t;
+
+typedef struct {
+    spotify_controller_handle_t controller;
+    const void *owner;
+    thumbnail_row_t rows[SPOTIFY_THUMBNAILS_MAX_ROWS];
+    size_t row_count;
+    // Not cached and not loading, in priority order, one per URL
+    thumbnail_want_t wanted[SPOTIFY_THUMBNAILS_MAX_ROWS];
+    size_t wanted_count;
+    uint32_t loading;       // Hash of the URL being fetched, 0 for none
+    bool cancelled;         // The next fetch waits for the cancelled one's callback
+    uint32_t loading_since;
+} thumbnails_state_t;
+
+static thumbnails_state_t s_thumbs;
+
+// FNV-1a, with 0 kept for no URL
+static uint32_t url_hash(const char *url) {
+    uint32_t hash = 2166136261u;
+    while (*url) {
+        hash ^= (uint8_t)*url++;
+        hash *= 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+// Only changes what differs, so rows that stay put are not redrawn mid-scroll
+static void row_show(lv_obj_t *image, const lv_img_dsc_t *src) {
+    if (src) {
+        if (lv_img_get_src(image) != src) {
+            lv_img_set_src(image, src);
+        }
+        if (lv_obj_has_flag(image, LV_OBJ_FLAG_HIDDEN)) {
+            lv_obj_clear_flag(image, LV_OBJ_FLAG_HIDDEN);
+        }
+    } else if (lv_img_get_src(image)) {
+        // No source kept either: it may be evicted while the row is hidden
+        lv_obj_add_flag(image, LV_OBJ_FLAG_HIDDEN);
+        lv_img_set_src(image, NULL);
+    }
+}
+
+static void start_next(void) {
+    if (s_thumbs.loading) {
+        return;
+    }
+    if (s_thumbs.wanted_count == 0) {
+        return;
+    }
+    // Queue full: tried again on the next update
+    thumbnail_want_t *next = &s_thumbs.wanted[0];
+    if (!spotify_controller_fetch_thumbnail(s_thumbs.controller, next->url, SPOTIFY_THUMBNAIL_SIZE)) {
+        ESP_LOGD(TAG, "Thumbnail not queued");
+        return;
+    }
+    s_thumbs.loading = next->hash;
+    s_thumbs.cancelled = false;
+    s_thumbs.loading_since = lv_tick_get();
+    s_thumbs.wanted_count--;
+    memmove(&s_thumbs.wanted[0], &s_thumbs.wanted[1], s_thumbs.wanted_count * sizeof(thumbnail_want_t));
+}
+
+static void cancel_loading(void) {
+    if (s_thumbs.loading && !s_thumbs.cancelled) {
+        spotify_controller_cancel_thumbnail(s_thumbs.controller);
+        s_thumbs.cancelled = true;
+    }
+}
+
+static void thumbnail_callback(const char *image_url, const lv_img_dsc_t *image) {
+    uint32_t hash = url_hash(image_url);
+    if (hash != s_thumbs.loading) {
+        return;     // Forgotten as stalled
+    }
+    s_thumbs.loading = 0;
+    s_thumbs.cancelled = false;
+
+    // Also if it finished before the cancel reached it: it is cached now
+    if (image) {
+        for (size_t i = 0; i < s_thumbs.row_count; i++) {
+            if (s_thumbs.rows[i].hash == hash) {
+                row_show(s_thumbs.rows[i].image, image);
+            }
+        }
+        for (size_t i = 0; i < s_thumbs.wanted_count; i++) {
+            if (s_thumbs.wanted[i].hash == hash) {
+                s_thumbs.wanted_count--;
+                memmove(&s_thumbs.wanted[i], &s_thumbs.wanted[i + 1],
+                        (s_thumbs.wanted_count - i) * sizeof(thumbnail_want_t));
+                break;
+            }
+        }
+    }
+    start_next();
+}
+
+void spotify_thumbnails_init(spotify_controller_handle_t controller) {
+    s_thumbs.controller = controller;
+    spotify_controller_set_thumbnail_callback(controller, thumbnail_callback);
+}
+
+static bool is_wanted(uint32_t hash) {
+    for (size_t i = 0; i < s_thumbs.wanted_count; i++) {
+        if (s_thumbs.wanted[i].hash == hash) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void spotify_thumbnails_set_rows(const void *owner, const spotify_thumbnail_row_t *rows, size_t count) {
+    if (!s_thumbs.controller) {
+        return;
+    }
+    if (owner != s_thumbs.owner) {
+        for (size_t i = 0; i < s_thumbs.row_count; i++) {
+            row_show(s_thumbs.rows[i].image, NULL);
+        }
+        s_thumbs.owner = owner;
+    }
+    if (count > SPOTIFY_THUMBNAILS_MAX_ROWS) {
+        count = SPOTIFY_THUMBNAILS_MAX_ROWS;
+    }
+
+    // The worker was stopped or the answer lost on the bus
+    if (s_thumbs.loading && lv_tick_elaps(s_thumbs.loading_since) > SPOTIFY_THUMBNAILS_STALL_MS) {
+        ESP_LOGW(TAG, "Thumbnail fetch not answered, going on");
+        s_thumbs.loading = 0;
+    }
+
+    bool loading_wanted = false;
+    s_thumbs.wanted_count = 0;
+    s_thumbs.row_count = count;
+    for (size_t i = 0; i < count; i++) {
+        const char *url = rows[i].image_url;
+        thumbnail_row_t *row = &s_thumbs.rows[i];
+        row->image = rows[i].image;
+        row->hash = url && url[0] ? url_hash(url) : 0;
+        if (!row->hash) {
+            row_show(row->image, NULL);
+            continue;
+        }
+
+        // Looked up for every row, so each stays among the most recently used
+        const lv_img_dsc_t *cached = spotify_controller_get_thumbnail(s_thumbs.controller, url);
+        row_show(row->image, cached);
+        if (cached || !rows[i].fetch) {
+            continue;
+        }
+        // Served by the fetch under way, unless that was cancelled: then
+        // it is fetched again once the cancel has gone through
+        if (row->hash == s_thumbs.loading && !s_thumbs.cancelled) {
+            loading_wanted = true;
+            continue;
+        }
+        if (is_wanted(row->hash) || strlen(url) >= SPOTIFY_THUMBNAILS_URL_LEN) {
+            continue;
+        }
+        thumbnail_want_t *want = &s_thumbs.wanted[s_thumbs.wanted_count++];
+        strcpy(want->url, url);
+        want->hash = row->hash;
+    }
+
+    // A fetch for rows still in view or look-ahead runs to the end even if
+    // others now rank above it
+    if (!loading_wanted) {
+        cancel_loading();
+    }
+    start_next();
+}
+
+void spotify_thumbnails_release(const void *owner) {
+    if (owner != s_thumbs.owner) {
+        return;
+    }
+    cancel_loading();
+    s_thumbs.owner = NULL;
+    s_thumbs.row_count = 0;
+    s_thumbs.wanted_count = 0;
+}
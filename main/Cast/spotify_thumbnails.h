@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "lvgl.h"
+#include "spotify_controller_wrapper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief List row thumbnails - cover art loaded for the rows in view
+ *
+ * Each virtual list hands over its bound rows whenever they change, in
+ * priority order: the rows in view top to bottom, then a few rows of
+ * look-ahead, then the rest of the pool. Rows in view or look-ahead that
+ * have no cached thumbnail are downloaded one at a time, highest priority
+ * first, so the next fetch always goes to what the user is looking at. A
+ * URL several rows share (tracks of one album) is fetched once and set on
+ * all of them. When the download in progress belongs to no row in view or
+ * look-ahead any more it is cancelled between chunks; the rest of the
+ * pool only shows what is already cached.
+ *
+ * The images come from the controller's thumbnail cache, which holds more
+ * entries than there are rows, and every row's image is looked up again on
+ * each update, so nothing shown is evicted.
+ *
+ * LVGL thread only.
+ */
+
+#define SPOTIFY_THUMBNAIL_SIZE              36      // Shown at, and decoded for
+#define SPOTIFY_THUMBNAILS_MAX_ROWS         16      // A list's pool
+#define SPOTIFY_THUMBNAILS_URL_LEN          224     // Mosaic playlist covers name four images
+#define SPOTIFY_THUMBNAILS_STALL_MS         15000   // A fetch not answered by then is forgotten
+
+typedef struct {
+    lv_obj_t *image;            // The row's lv_img
+    const char *image_url;      // Only read during the call; NULL or "" for none
+    bool fetch;                 // In view or look-ahead: download if not cached
+} spotify_thumbnail_row_t;
+
+/**
+ * @brief Take over the controller's thumbnail callback
+ */
+void spotify_thumbnails_init(spotify_controller_handle_t controller);
+
+/**
+ * @brief Set the rows of owner, highest priority first
+ *
+ * Replaces whatever was set before. If owner is another list, its rows'
+ * images are cleared, since they are no longer kept in the cache.
+ *
+ * @param owner The list the rows belong to
+ * @param rows  At most SPOTIFY_THUMBNAILS_MAX_ROWS; the rest are ignored
+ * @param count Number of rows
+ */
+void spotify_thumbnails_set_rows(const void *owner, const spotify_thumbnail_row_t *rows, size_t count);
+
+/**
+ * @brief Forget owner's rows and cancel their fetch, if it has them
+ *
+ * For a list being deleted: its images are not touched.
+ */
+void spotify_thumbnails_release(const void *owner);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,80 @@
+#include "ui_fonts.h"
+#include "esp_log.h"
+
+typedef struct {
+    const lv_font_t *base;
+    lv_coord_t size;
+    bool tried;             // Fallback looked for, found or not
+    lv_font_t font;         // base, with the fallback
+} ui_font_t;
+
+static ui_font_t s_fonts[] = {
+#if LV_FONT_MONTSERRAT_12
+    { .base = &lv_font_montserrat_12, .size = 12 },
+#endif
+#if LV_FONT_MONTSERRAT_14
+    { .base = &lv_font_montserrat_14, .size = 14 },
+#endif
+#if LV_FONT_MONTSERRAT_16
+    { .base = &lv_font_montserrat_16, .size = 16 },
+#endif
+};
+
+#if CONFIG_ESPCASTER_UI_FONT_FALLBACK
+static const char *TAG = "ui_fonts";
+
+static bool font_file_exists(void) {
+    static int exists = -1;
+    if (exists < 0) {
+        lv_fs_file_t file;
+        exists = lv_fs_open(&file, CONFIG_ESPCASTER_UI_FONT_FILE, LV_FS_MODE_RD) == LV_FS_RES_OK;
+        if (exists) {
+            lv_fs_close(&file);
+        } else {
+            ESP_LOGI(TAG, "No %s, using the built-in fonts only", CONFIG_ESPCASTER_UI_FONT_FILE);
+        }
+    }
+    return exists;
+}
+
+static void load_fallback(ui_font_t *entry) {
+    if (!font_file_exists()) {
+        return;
+    }
+    lv_font_t *fallback = lv_tiny_ttf_create_file_ex(CONFIG_ESPCASTER_UI_FONT_FILE, entry->size,
+                                                     CONFIG_ESPCASTER_UI_FONT_CACHE_KB * 1024);
+    if (!fallback) {
+        ESP_LOGW(TAG, "Failed to load %s at %d px", CONFIG_ESPCASTER_UI_FONT_FILE, entry->size);
+        return;
+    }
+    entry->font = *entry->base;
+    entry->font.fallback = fallback;
+    ESP_LOGI(TAG, "Fallback font loaded at %d px", entry->size);
+}
+#endif
+
+const lv_font_t *ui_fonts_get(const lv_font_t *base) {
+    for (size_t i = 0; i < sizeof(s_fonts) / sizeof(s_fonts[0]); i++) {
+        ui_font_t *entry = &s_fonts[i];
+        if (entry->base != base) {
+            continue;
+        }
+#if CONFIG_ESPCASTER_UI_FONT_FALLBACK
+        if (!entry->tried) {
+            entry->tried = true;
+            load_fallback(entry);
+        }
+#endif
+        return entry->font.fallback ? &entry->font : base;
+    }
+    return base;
+}
+
+void ui_fonts_init(void) {
+    const lv_font_t *font = ui_fonts_get(LV_FONT_DEFAULT);
+    if (font == LV_FONT_DEFAULT) {
+        return;
+    }
+    lv_obj_set_style_text_font(lv_scr_act(), font, 0);
+    lv_obj_set_style_text_font(lv_layer_top(), font, 0);
+}
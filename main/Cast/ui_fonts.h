@@ -0,0 +1,42 @@
+#pragma once
+
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief UI fonts - the built-in Montserrat, with a TrueType fallback
+ *
+ * Montserrat only covers Latin, so track names in CJK, Cyrillic or Greek
+ * showed as boxes, and compiling a CJK font in would triple the app image.
+ * With CONFIG_ESPCASTER_UI_FONT_FALLBACK, each Montserrat size in use gets
+ * a fallback that Tiny TTF streams from CONFIG_ESPCASTER_UI_FONT_FILE on
+ * the flash_test partition: the file is opened the first time a size is
+ * asked for, and a glyph is read and rasterised the first time it is drawn.
+ * Rendered glyphs stay in an LRU of CONFIG_ESPCASTER_UI_FONT_CACHE_KB per
+ * size in the LVGL heap. Glyphs Montserrat has never reach the fallback.
+ *
+ * Without the option or the file, the plain Montserrat fonts are used.
+ *
+ * LVGL thread only.
+ */
+
+/**
+ * @brief Use the default font, with its fallback, on the screen and the top layer
+ *
+ * Every widget that does not set a font of its own inherits it.
+ */
+void ui_fonts_init(void);
+
+/**
+ * @brief A built-in Montserrat font with its fallback
+ *
+ * @return base itself if it has no fallback (another font, or no file)
+ */
+const lv_font_t *ui_fonts_get(const lv_font_t *base);
+
+#ifdef __cplusplus
+}
+#endif
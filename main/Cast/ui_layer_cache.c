@@ -0,0 +1,205 @@
+#include "ui_layer_cache.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "ui_layer_cache";
+
+// Everything a layer's pixels depend on; zeroed before filling, so it compares with memcmp
+typedef struct {
+    lv_coord_t width;
+    lv_coord_t height;
+    lv_color_t backdrop;
+    lv_coord_t radius;
+    lv_color_t bg_color;
+    lv_opa_t bg_opa;
+    lv_grad_dsc_t bg_grad;
+    lv_color_t border_color;
+    lv_coord_t border_width;
+    lv_opa_t border_opa;
+    lv_border_side_t border_side;
+} ui_layer_look_t;
+
+typedef struct {
+    ui_layer_look_t look;
+    lv_img_dsc_t img;
+    lv_color_t *buf;
+    uint32_t last_used;
+} ui_layer_t;
+
+static ui_layer_t s_layers[UI_LAYER_CACHE_MAX_LAYERS];
+static uint32_t s_use_count;
+
+static void layer_free(ui_layer_t *layer) {
+    if (layer->buf) {
+        lv_img_cache_invalidate_src(&layer->img);
+        heap_caps_free(layer->buf);
+    }
+    memset(layer, 0, sizeof(*layer));
+}
+
+// The colour the background is drawn over: the first opaque ancestor's
+static bool find_backdrop(lv_obj_t *obj, lv_color_t *color) {
+    for (lv_obj_t *parent = lv_obj_get_parent(obj); parent; parent = lv_obj_get_parent(parent)) {
+        if (lv_obj_get_style_bg_img_src(parent, LV_PART_MAIN)) {
+            return false;
+        }
+        if (lv_obj_get_style_bg_opa(parent, LV_PART_MAIN) >= LV_OPA_MAX) {
+            if (lv_obj_get_style_bg_grad_dir(parent, LV_PART_MAIN) != LV_GRAD_DIR_NONE) {
+                return false;
+            }
+            *color = lv_obj_get_style_bg_color_filtered(parent, LV_PART_MAIN);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool look_get(lv_obj_t *obj, const lv_area_t *coords, lv_draw_rect_dsc_t *rect, ui_layer_look_t *look) {
+    // Border included: with border_post the event's descriptor leaves it out
+    lv_draw_rect_dsc_init(rect);
+    lv_obj_init_draw_rect_dsc(obj, LV_PART_MAIN, rect);
+
+    if (rect->blend_mode != LV_BLEND_MODE_NORMAL || rect->bg_img_src ||
+        (rect->shadow_width > 0 && rect->shadow_opa > LV_OPA_MIN) ||
+        (lv_obj_get_style_clip_corner(obj, LV_PART_MAIN) && rect->radius != 0) ||
+        lv_draw_mask_is_any(coords)) {
+        return false;
+    }
+
+    memset(look, 0, sizeof(*look));
+    if (!find_backdrop(obj, &look->backdrop)) {
+        return false;
+    }
+    look->width = lv_area_get_width(coords);
+    look->height = lv_area_get_height(coords);
+    look->radius = rect->radius;
+    look->bg_color = rect->bg_color;
+    look->bg_opa = rect->bg_opa;
+    if (rect->bg_grad.dir != LV_GRAD_DIR_NONE) {
+        memcpy(&look->bg_grad, &rect->bg_grad, sizeof(look->bg_grad));
+    }
+    if (rect->border_width > 0 && rect->border_opa > LV_OPA_MIN) {
+        look->border_color = rect->border_color;
+        look->border_width = rect->border_width;
+        look->border_opa = rect->border_opa;
+        look->border_side = rect->border_side;
+    }
+    return look->width > 0 && look->height > 0;
+}
+
+// Draw the background once, the way the display would, into a buffer of its own
+static bool layer_render(ui_layer_t *layer, const lv_draw_rect_dsc_t *rect, const lv_area_t *coords) {
+    lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+    if (!disp || disp->driver->set_px_cb) {
+        return false;
+    }
+
+    uint32_t px_count = (uint32_t)layer->look.width * layer->look.height;
+    layer->buf = heap_caps_malloc(px_count * sizeof(lv_color_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!layer->buf) {
+        ESP_LOGW(TAG, "No PSRAM for a %dx%d layer", layer->look.width, layer->look.height);
+        return false;
+    }
+    lv_draw_ctx_t *draw_ctx = lv_mem_alloc(disp->driver->draw_ctx_size);
+    if (!draw_ctx) {
+        heap_caps_free(layer->buf);
+        layer->buf = NULL;
+        return false;
+    }
+    lv_color_fill(layer->buf, layer->look.backdrop, px_count);
+
+    lv_area_t area = *coords;
+    disp->driver->draw_ctx_init(disp->driver, draw_ctx);
+    draw_ctx->buf = layer->buf;
+    draw_ctx->buf_area = &area;
+    draw_ctx->clip_area = &area;
+
+    lv_draw_rect_dsc_t bg = *rect;
+    bg.border_post = 0;
+    bg.outline_opa = LV_OPA_TRANSP;
+    lv_draw_rect(draw_ctx, &bg, &area);
+
+    disp->driver->draw_ctx_deinit(disp->driver, draw_ctx);
+    lv_mem_free(draw_ctx);
+
+    layer->img.header.always_zero = 0;
+    layer->img.header.cf = LV_IMG_CF_TRUE_COLOR;
+    layer->img.header.w = layer->look.width;
+    layer->img.header.h = layer->look.height;
+    layer->img.data_size = px_count * sizeof(lv_color_t);
+    layer->img.data = (const uint8_t *)layer->buf;
+    ESP_LOGD(TAG, "Rendered a %dx%d layer", layer->look.width, layer->look.height);
+    return true;
+}
+
+static ui_layer_t *layer_get(const ui_layer_look_t *look, const lv_draw_rect_dsc_t *rect,
+                             const lv_area_t *coords, bool render) {
+    ui_layer_t *oldest = &s_layers[0];
+    for (size_t i = 0; i < UI_LAYER_CACHE_MAX_LAYERS; i++) {
+        ui_layer_t *layer = &s_layers[i];
+        if (layer->buf && memcmp(&layer->look, look, sizeof(*look)) == 0) {
+            layer->last_used = ++s_use_count;
+            return layer;
+        }
+        if (!layer->buf || (oldest->buf && layer->last_used < oldest->last_used)) {
+            oldest = layer;
+        }
+    }
+    if (!render) {
+        return NULL;
+    }
+
+    // Layers are only read while their widget draws, so the oldest can go at any time
+    layer_free(oldest);
+    oldest->look = *look;
+    if (!layer_render(oldest, rect, coords)) {
+        memset(oldest, 0, sizeof(*oldest));
+        return NULL;
+    }
+    oldest->last_used = ++s_use_count;
+    return oldest;
+}
+
+static void layer_draw_cb(lv_event_t *e) {
+    lv_obj_draw_part_dsc_t *dsc = lv_event_get_draw_part_dsc(e);
+    if (dsc->class_p != &lv_obj_class || dsc->part != LV_PART_MAIN || !dsc->rect_dsc ||
+        (dsc->type != LV_OBJ_DRAW_PART_RECTANGLE && dsc->type != LV_OBJ_DRAW_PART_BORDER_POST)) {
+        return;
+    }
+
+    lv_draw_rect_dsc_t rect;
+    ui_layer_look_t look;
+    if (!look_get(lv_event_get_target(e), dsc->draw_area, &rect, &look)) {
+        return;
+    }
+
+    // The border drawn after the children is already in the layer, if there is one
+    bool main_rect = dsc->type == LV_OBJ_DRAW_PART_RECTANGLE;
+    ui_layer_t *layer = layer_get(&look, &rect, dsc->draw_area, main_rect);
+    if (!layer) {
+        return;
+    }
+    dsc->rect_dsc->border_opa = LV_OPA_TRANSP;
+    if (main_rect) {
+        dsc->rect_dsc->bg_opa = LV_OPA_TRANSP;
+        dsc->rect_dsc->bg_img_src = &layer->img;
+        dsc->rect_dsc->bg_img_opa = LV_OPA_COVER;
+        dsc->rect_dsc->bg_img_recolor_opa = LV_OPA_TRANSP;
+        dsc->rect_dsc->bg_img_tiled = false;
+    }
+}
+
+void ui_layer_cache_attach(lv_obj_t *obj) {
+    if (obj) {
+        lv_obj_add_event_cb(obj, layer_draw_cb, LV_EVENT_DRAW_PART_BEGIN, NULL);
+    }
+}
+
+void ui_layer_cache_invalidate(void) {
+    for (size_t i = 0; i < UI_LAYER_CACHE_MAX_LAYERS; i++) {
+        layer_free(&s_layers[i]);
+    }
+    lv_obj_invalidate(lv_scr_act());
+    lv_obj_invalidate(lv_layer_top());
+}
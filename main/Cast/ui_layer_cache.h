@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief UI layer cache - static backgrounds rendered once, then blitted
+ *
+ * Panels and slider tracks never change, but LVGL redraws their rounded
+ * corners, borders and radius masks whenever anything on top of them is
+ * invalidated: a volume drag repaints the slider's track and the panel
+ * under it on every frame. For an attached widget the background
+ * (LV_PART_MAIN: fill, radius, border) is rendered once into an RGB565
+ * layer in PSRAM, over the colour behind it so it is opaque, and is then
+ * drawn as a plain, unmasked image copy. Children, the slider's indicator
+ * and knob, and outlines are still drawn with styles.
+ *
+ * Layers are keyed by the look the widget's styles resolve to, its size and
+ * its backdrop, so a theme change, a state change or a resize simply gets a
+ * new layer and identical widgets share one. Backgrounds a layer cannot
+ * reproduce (shadows, images, clipped corners, a gradient behind them, a
+ * mask in effect) are drawn as before, and so is one whose layer does not
+ * fit in PSRAM. When the cache is full the least recently drawn layer goes.
+ *
+ * LVGL thread only.
+ */
+
+#define UI_LAYER_CACHE_MAX_LAYERS   8
+
+/**
+ * @brief Draw obj's background from a cached layer from now on
+ */
+void ui_layer_cache_attach(lv_obj_t *obj);
+
+/**
+ * @brief Drop every layer and redraw; layers are rendered again on use
+ *
+ * Call when the theme changes, so layers of the old look do not linger.
+ */
+void ui_layer_cache_invalidate(void);
+
+#ifdef __cplusplus
+}
+#endif
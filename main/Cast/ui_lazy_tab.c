@@ -0,0 +1,130 @@
+#include "ui_lazy_tab.h"
+#include "LVGL_Driver.h"
+#include "esp_log.h"
+
+static const char *TAG = "ui_lazy_tab";
+
+typedef struct {
+    lv_obj_t *tab;
+    uint16_t id;                // Index in the tabview
+    const ui_lazy_tab_ops_t *ops;
+    bool built;
+    uint32_t hidden_since;      // lv_tick_get() when it was last left
+} ui_lazy_tab_t;
+
+static lv_obj_t *s_tabview;
+static ui_lazy_tab_t s_tabs[UI_LAZY_TAB_MAX_TABS];
+static size_t s_tab_count;
+static uint16_t s_active;
+static bool s_scrolling;        // A swipe between tabs is under way
+static lv_timer_t *s_timer;
+
+static ui_lazy_tab_t *find_tab(uint16_t id) {
+    for (size_t i = 0; i < s_tab_count; i++) {
+        if (s_tabs[i].id == id) {
+            return &s_tabs[i];
+        }
+    }
+    return NULL;
+}
+
+static void build(uint16_t id) {
+    ui_lazy_tab_t *tab = find_tab(id);
+    if (!tab || tab->built) {
+        return;
+    }
+    ESP_LOGI(TAG, "Building tab %u", (unsigned)id);
+    tab->ops->build(tab->tab);
+    tab->built = true;
+}
+
+static void unload(ui_lazy_tab_t *tab) {
+    ESP_LOGI(TAG, "Unloading tab %u, hidden for %lu ms", (unsigned)tab->id,
+             (unsigned long)lv_tick_elaps(tab->hidden_since));
+    tab->ops->unload();
+    lv_obj_clean(tab->tab);
+    tab->built = false;
+}
+
+static void tab_changed_cb(lv_event_t *e) {
+    uint16_t active = lv_tabview_get_tab_act(s_tabview);
+    if (active != s_active) {
+        ui_lazy_tab_t *left = find_tab(s_active);
+        if (left) {
+            left->hidden_since = lv_tick_get();
+        }
+        s_active = active;
+    }
+    build(active);
+}
+
+// A swipe shows the neighbours before the tab changes: they have to exist by then
+static void content_scroll_cb(lv_event_t *e) {
+    if (lv_event_get_code(e) == LV_EVENT_SCROLL_END) {
+        s_scrolling = false;
+        return;
+    }
+    s_scrolling = true;
+    uint16_t active = lv_tabview_get_tab_act(s_tabview);
+    if (active > 0) {
+        build(active - 1);
+    }
+    build(active + 1);
+}
+
+static void pressure_timer_cb(lv_timer_t *timer) {
+    if (s_scrolling || LVGL_Timer_Defer(timer)) {
+        return;
+    }
+    lv_mem_monitor_t mon;
+    lv_mem_monitor(&mon);
+    if (mon.free_size >= UI_LAZY_TAB_LOW_FREE_BYTES) {
+        return;
+    }
+
+    // One tab per check: the pool is looked at again before the next goes
+    ui_lazy_tab_t *oldest = NULL;
+    for (size_t i = 0; i < s_tab_count; i++) {
+        ui_lazy_tab_t *tab = &s_tabs[i];
+        if (!tab->built || tab->id == s_active || lv_tick_elaps(tab->hidden_since) < UI_LAZY_TAB_HIDDEN_MS) {
+            continue;
+        }
+        if (!oldest || lv_tick_elaps(tab->hidden_since) > lv_tick_elaps(oldest->hidden_since)) {
+            oldest = tab;
+        }
+    }
+    if (oldest) {
+        ESP_LOGI(TAG, "LVGL pool low (%u bytes free)", (unsigned)mon.free_size);
+        unload(oldest);
+    }
+}
+
+void ui_lazy_tab_init(lv_obj_t *tabview) {
+    s_tabview = tabview;
+    lv_obj_add_event_cb(tabview, tab_changed_cb, LV_EVENT_VALUE_CHANGED, NULL);
+    lv_obj_t *content = lv_tabview_get_content(tabview);
+    lv_obj_add_event_cb(content, content_scroll_cb, LV_EVENT_SCROLL_BEGIN, NULL);
+    lv_obj_add_event_cb(content, content_scroll_cb, LV_EVENT_SCROLL_END, NULL);
+}
+
+bool ui_lazy_tab_add(lv_obj_t *tab, const ui_lazy_tab_ops_t *ops) {
+    if (s_tab_count == UI_LAZY_TAB_MAX_TABS) {
+        ESP_LOGE(TAG, "No slot for another lazy tab");
+        return false;
+    }
+    s_tabs[s_tab_count++] = (ui_lazy_tab_t){
+        .tab = tab,
+        .id = (uint16_t)lv_obj_get_index(tab),
+        .ops = ops,
+        .hidden_since = lv_tick_get(),
+    };
+    return true;
+}
+
+void ui_lazy_tab_start(void) {
+    s_active = lv_tabview_get_tab_act(s_tabview);
+    build(s_active);
+    if (!s_timer) {
+        s_timer = lv_timer_create(pressure_timer_cb, UI_LAZY_TAB_CHECK_MS, NULL);
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Lazy tabs - a tab's widgets exist only while they may be looked at
+ *
+ * Only one tab of the main tabview is on the display, yet every tab's
+ * widgets take LVGL pool and are laid out at boot. A lazy tab is empty
+ * until it is first shown: switching to it, or starting a swipe next to
+ * it so the swipe does not reveal a blank page, has its build op create
+ * the widgets.
+ *
+ * When the LVGL pool runs below UI_LAZY_TAB_LOW_FREE_BYTES, the tab hidden
+ * the longest, for at least UI_LAZY_TAB_HIDDEN_MS, is torn down: its unload
+ * op forgets every widget, which are then deleted. The data behind them -
+ * the status line, the scan results, the screen that was open - stays with
+ * the GUI manager, and the next build shows it again. The tab on display
+ * and the ones either side of a swipe under way are never unloaded.
+ *
+ * LVGL thread only.
+ */
+
+#define UI_LAZY_TAB_MAX_TABS            4
+#define UI_LAZY_TAB_LOW_FREE_BYTES      (12 * 1024)
+#define UI_LAZY_TAB_HIDDEN_MS           30000
+#define UI_LAZY_TAB_CHECK_MS            2000    // How often the pool is looked at
+
+typedef struct {
+    lv_obj_t *(*build)(lv_obj_t *tab);  // Create the widgets in tab, showing the data kept
+    void (*unload)(void);               // Before they are deleted: drop every pointer to them
+} ui_lazy_tab_ops_t;
+
+/**
+ * @brief Watch tabview for tabs being shown
+ */
+void ui_lazy_tab_init(lv_obj_t *tabview);
+
+/**
+ * @brief Leave an empty tab of the tabview to be built when shown
+ *
+ * @param ops kept as a pointer
+ * @return false if UI_LAZY_TAB_MAX_TABS are lazy already
+ */
+bool ui_lazy_tab_add(lv_obj_t *tab, const ui_lazy_tab_ops_t *ops);
+
+/**
+ * @brief Build the tab on display and start watching the pool
+ *
+ * After the tabs are added and the first one to show is selected.
+ */
+void ui_lazy_tab_start(void);
+
+#ifdef __cplusplus
+}
+#endif
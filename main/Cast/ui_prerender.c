@@ -0,0 +1,196 @@
+#include "ui_prerender.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "ui_prerender";
+
+static ui_prerender_t *s_entries[UI_PRERENDER_MAX];
+static lv_timer_t *s_timer;
+
+static void snapshot_free(ui_prerender_t *pr) {
+    if (pr->buf) {
+        lv_img_cache_invalidate_src(&pr->image);
+        heap_caps_free(pr->buf);
+    }
+    pr->buf = NULL;
+    pr->buf_size = 0;
+    pr->current = false;
+}
+
+static void target_delete_cb(lv_event_t *e) {
+    ui_prerender_t *pr = lv_event_get_user_data(e);
+    lv_obj_t *obj = lv_event_get_target(e);
+    if (pr->target == obj) {
+        pr->target = NULL;
+        pr->wanted = false;
+        // A cover still showing it keeps the image until its animation ends
+        if (!pr->cover) {
+            snapshot_free(pr);
+        }
+    }
+    if (pr->revealing == obj) {
+        pr->revealing = NULL;
+    }
+}
+
+static void detach(ui_prerender_t *pr) {
+    if (pr->target && pr->target != pr->revealing) {
+        lv_obj_remove_event_cb_with_user_data(pr->target, target_delete_cb, pr);
+    }
+    pr->target = NULL;
+    pr->wanted = false;
+}
+
+// Nothing touched lately and nothing waiting to be drawn
+static bool idle_frame(void) {
+    lv_disp_t *disp = lv_disp_get_default();
+    return disp && disp->inv_p == 0 && lv_disp_get_inactive_time(disp) >= UI_PRERENDER_IDLE_MS;
+}
+
+static void take_snapshot(ui_prerender_t *pr) {
+    uint32_t size = lv_snapshot_buf_size_needed(pr->target, LV_IMG_CF_TRUE_COLOR_ALPHA);
+    if (size != pr->buf_size) {
+        snapshot_free(pr);
+        pr->buf = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+        if (!pr->buf) {
+            ESP_LOGW(TAG, "No PSRAM for a %u byte snapshot", (unsigned)size);
+            return;
+        }
+        pr->buf_size = size;
+    }
+    // The same descriptor may be cached with the old pixels
+    lv_img_cache_invalidate_src(&pr->image);
+    pr->current = lv_snapshot_take_to_buf(pr->target, LV_IMG_CF_TRUE_COLOR_ALPHA, &pr->image,
+                                          pr->buf, pr->buf_size) == LV_RES_OK;
+    ESP_LOGD(TAG, "Snapshot %ux%u %s", (unsigned)pr->image.header.w, (unsigned)pr->image.header.h,
+             pr->current ? "taken" : "failed");
+}
+
+// One step of one screen per idle frame: build it, or draw it
+static void prerender_timer_cb(lv_timer_t *timer) {
+    if (!idle_frame()) {
+        return;
+    }
+    for (size_t i = 0; i < UI_PRERENDER_MAX; i++) {
+        ui_prerender_t *pr = s_entries[i];
+        if (!pr || !pr->wanted || pr->cover) {
+            continue;
+        }
+        if (!pr->target) {
+            lv_mem_monitor_t mon;
+            lv_mem_monitor(&mon);
+            lv_obj_t *target = mon.free_size >= UI_PRERENDER_MIN_FREE_BYTES ? pr->build() : NULL;
+            if (!target) {
+                pr->wanted = false;
+                continue;
+            }
+            pr->target = target;
+            lv_obj_add_event_cb(target, target_delete_cb, LV_EVENT_DELETE, pr);
+            // Laid out now, so the snapshot next time costs only the drawing
+            lv_obj_update_layout(target);
+            return;
+        }
+        take_snapshot(pr);
+        pr->wanted = false;
+        return;
+    }
+}
+
+bool ui_prerender_want(ui_prerender_t *pr, ui_prerender_build_cb_t build) {
+    size_t free_slot = UI_PRERENDER_MAX;
+    bool known = false;
+    for (size_t i = 0; i < UI_PRERENDER_MAX && !known; i++) {
+        known = s_entries[i] == pr;
+        if (!s_entries[i] && free_slot == UI_PRERENDER_MAX) {
+            free_slot = i;
+        }
+    }
+    if (!known) {
+        if (free_slot == UI_PRERENDER_MAX) {
+            return false;
+        }
+        s_entries[free_slot] = pr;
+    }
+    if (!s_timer) {
+        s_timer = lv_timer_create(prerender_timer_cb, UI_PRERENDER_POLL_MS, NULL);
+    }
+    pr->build = build;
+    pr->wanted = true;
+    pr->current = false;
+    return true;
+}
+
+lv_obj_t *ui_prerender_target(const ui_prerender_t *pr) {
+    return pr->target;
+}
+
+static void cover_anim_cb(void *var, int32_t value) {
+    lv_obj_t *cover = var;
+    lv_obj_set_style_opa(cover, (lv_opa_t)value, 0);
+    lv_obj_set_style_translate_y(cover, UI_PRERENDER_SLIDE_PX * (LV_OPA_COVER - value) / LV_OPA_COVER, 0);
+}
+
+// Also when its parent goes mid-animation, which then never ends
+static void cover_delete_cb(lv_event_t *e) {
+    ui_prerender_t *pr = lv_event_get_user_data(e);
+    pr->cover = NULL;
+    snapshot_free(pr);
+}
+
+static void cover_ready_cb(lv_anim_t *a) {
+    ui_prerender_t *pr = lv_anim_get_user_data(a);
+    if (pr->revealing) {
+        lv_obj_remove_event_cb_with_user_data(pr->revealing, target_delete_cb, pr);
+        lv_obj_clear_flag(pr->revealing, LV_OBJ_FLAG_HIDDEN);
+        pr->revealing = NULL;
+    }
+    lv_obj_del_anim_ready_cb(a);
+}
+
+bool ui_prerender_reveal(ui_prerender_t *pr, lv_obj_t *target) {
+    bool animate = target && pr->target == target && pr->current && !pr->cover;
+    if (!animate) {
+        detach(pr);
+        if (!pr->cover) {
+            snapshot_free(pr);
+        }
+        return false;
+    }
+    // Its delete callback stays until the animation ends, to learn if it goes first
+    pr->revealing = target;
+    detach(pr);
+
+    pr->cover = lv_img_create(lv_obj_get_parent(target));
+    lv_img_set_src(pr->cover, &pr->image);
+    lv_obj_add_flag(pr->cover, LV_OBJ_FLAG_IGNORE_LAYOUT);
+    lv_obj_clear_flag(pr->cover, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_align_to(pr->cover, target, LV_ALIGN_CENTER, 0, 0);
+    lv_obj_add_event_cb(pr->cover, cover_delete_cb, LV_EVENT_DELETE, pr);
+    cover_anim_cb(pr->cover, LV_OPA_TRANSP);
+
+    lv_anim_t a;
+    lv_anim_init(&a);
+    lv_anim_set_var(&a, pr->cover);
+    lv_anim_set_exec_cb(&a, cover_anim_cb);
+    lv_anim_set_values(&a, LV_OPA_TRANSP, LV_OPA_COVER);
+    lv_anim_set_time(&a, UI_PRERENDER_ANIM_MS);
+    lv_anim_set_path_cb(&a, lv_anim_path_ease_out);
+    lv_anim_set_ready_cb(&a, cover_ready_cb);
+    lv_anim_set_user_data(&a, pr);
+    lv_anim_start(&a);
+    return true;
+}
+
+void ui_prerender_cancel(ui_prerender_t *pr) {
+    detach(pr);
+    if (pr->revealing) {
+        lv_obj_remove_event_cb_with_user_data(pr->revealing, target_delete_cb, pr);
+        pr->revealing = NULL;
+    }
+    if (pr->cover) {
+        lv_obj_del(pr->cover);      // Its animation goes with it; cover_delete_cb frees the snapshot
+    } else {
+        snapshot_free(pr);
+    }
+}
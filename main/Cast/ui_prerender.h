@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Screen pre-rendering - the likely next screen made ready while idle
+ *
+ * Building a screen and drawing it for the first time is what makes a
+ * transition hitch. A GUI manager that can tell which screen comes next
+ * (the volume screen once a device is connected, now playing once a track
+ * starts) asks for it with ui_prerender_want(). On the next idle frame (no
+ * input for UI_PRERENDER_IDLE_MS, nothing waiting to be drawn) the build
+ * op lays the screen out, hidden, and on the one after it is drawn into a
+ * snapshot in PSRAM. One step per idle frame, so neither lands on a frame
+ * that is busy already.
+ *
+ * When the screen is then opened, ui_prerender_reveal() slides and fades
+ * the snapshot in, a single image copy per frame, and shows the real
+ * widgets in its place when it ends. A snapshot taken before the screen's
+ * data changed is not shown: want it again and it is retaken when idle.
+ * Without a current snapshot the screen is shown at once, built already.
+ *
+ * The screen stays the GUI manager's: it may delete it at any time, and
+ * the snapshot goes with it.
+ *
+ * LVGL thread only.
+ */
+
+#define UI_PRERENDER_MAX            4
+#define UI_PRERENDER_IDLE_MS        300     // No input for this long is an idle frame
+#define UI_PRERENDER_POLL_MS        100
+#define UI_PRERENDER_MIN_FREE_BYTES (16 * 1024)     // LVGL pool left for the screen on display
+#define UI_PRERENDER_ANIM_MS        150
+#define UI_PRERENDER_SLIDE_PX       16
+
+/**
+ * @brief Make the screen, hidden, or return it if it exists; NULL if it cannot be now
+ */
+typedef lv_obj_t *(*ui_prerender_build_cb_t)(void);
+
+typedef struct {
+    ui_prerender_build_cb_t build;
+    lv_obj_t *target;           // Built and hidden, waiting to be revealed
+    lv_obj_t *cover;            // The snapshot on display during a reveal
+    lv_obj_t *revealing;        // Shown when the cover's animation ends
+    lv_img_dsc_t image;
+    uint8_t *buf;               // PSRAM
+    uint32_t buf_size;
+    bool wanted;                // Build or snapshot on an idle frame
+    bool current;               // The snapshot shows target as it is now
+} ui_prerender_t;
+
+/**
+ * @brief Have pr's screen built and snapshotted on the next idle frames
+ *
+ * Again when the screen's data changed, to retake the snapshot.
+ *
+ * @param pr    Kept as a pointer; zeroed before first use
+ * @param build Called on an idle frame if pr has no screen yet
+ * @return false if UI_PRERENDER_MAX others are in use
+ */
+bool ui_prerender_want(ui_prerender_t *pr, ui_prerender_build_cb_t build);
+
+/**
+ * @brief The screen built for pr, hidden, or NULL
+ */
+lv_obj_t *ui_prerender_target(const ui_prerender_t *pr);
+
+/**
+ * @brief Open target, from pr's snapshot if it shows target as it is
+ *
+ * pr forgets target either way; want it again for the next time.
+ *
+ * @return true if target stays hidden until the reveal animation ends;
+ *         false if the caller has to show it
+ */
+bool ui_prerender_reveal(ui_prerender_t *pr, lv_obj_t *target);
+
+/**
+ * @brief Forget the prediction: the snapshot is freed, the screen left as it is
+ *
+ * A reveal under way stops where it is, its screen still hidden.
+ */
+void ui_prerender_cancel(ui_prerender_t *pr);
+
+#ifdef __cplusplus
+}
+#endif
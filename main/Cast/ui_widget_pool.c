@@ -0,0 +1,181 @@
+#include "ui_widget_pool.h"
+#include "esp_log.h"
+
+static const char *TAG = "ui_widget_pool";
+
+#define DELETING    LV_OBJ_FLAG_USER_1      // A caller's widget in a closed modal, deleted after the event
+
+static lv_obj_t *s_keyboard;
+static lv_obj_t *s_keyboard_parent;     // NULL: parked
+static lv_event_cb_t s_keyboard_done_cb;
+
+static ui_modal_t s_modals[UI_WIDGET_POOL_MODALS];
+static lv_obj_t *s_backdrop;
+static size_t s_dim_count;              // Open modals that dim the screen
+
+static void keyboard_parent_delete_cb(lv_event_t *e);
+
+static void keyboard_park(void) {
+    s_keyboard_parent = NULL;
+    s_keyboard_done_cb = NULL;
+    lv_keyboard_set_textarea(s_keyboard, NULL);
+    lv_obj_add_flag(s_keyboard, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_set_parent(s_keyboard, lv_layer_top());
+}
+
+// Sent before the parent's children are deleted: the keyboard gets out first.
+// The callback stays: taking it off would skip the parent's next one
+static void keyboard_parent_delete_cb(lv_event_t *e) {
+    if (lv_event_get_target(e) == s_keyboard_parent) {
+        keyboard_park();
+    }
+}
+
+static void keyboard_done_cb(lv_event_t *e) {
+    if (s_keyboard_done_cb) {
+        s_keyboard_done_cb(e);
+    }
+}
+
+lv_obj_t *ui_widget_pool_keyboard(lv_obj_t *parent, lv_obj_t *textarea, lv_event_cb_t done_cb) {
+    if (!s_keyboard) {
+        s_keyboard = lv_keyboard_create(lv_layer_top());
+        if (!s_keyboard) {
+            ESP_LOGE(TAG, "Failed to create the keyboard");
+            return NULL;
+        }
+        lv_obj_add_flag(s_keyboard, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_add_event_cb(s_keyboard, keyboard_done_cb, LV_EVENT_READY, NULL);
+        lv_obj_add_event_cb(s_keyboard, keyboard_done_cb, LV_EVENT_CANCEL, NULL);
+    }
+
+    if (s_keyboard_parent != parent) {
+        if (s_keyboard_parent) {
+            lv_obj_remove_event_cb(s_keyboard_parent, keyboard_parent_delete_cb);
+        }
+        lv_obj_set_parent(s_keyboard, parent);
+        lv_obj_add_event_cb(parent, keyboard_parent_delete_cb, LV_EVENT_DELETE, NULL);
+        s_keyboard_parent = parent;
+    }
+    s_keyboard_done_cb = done_cb;
+    lv_keyboard_set_mode(s_keyboard, LV_KEYBOARD_MODE_TEXT_LOWER);
+    lv_keyboard_set_textarea(s_keyboard, textarea);
+    lv_obj_set_size(s_keyboard, lv_pct(100), lv_pct(50));
+    lv_obj_clear_flag(s_keyboard, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_move_foreground(s_keyboard);
+    return s_keyboard;
+}
+
+void ui_widget_pool_keyboard_release(lv_obj_t *parent) {
+    if (s_keyboard && parent && s_keyboard_parent == parent) {
+        lv_obj_remove_event_cb(parent, keyboard_parent_delete_cb);
+        keyboard_park();
+    }
+}
+
+static bool modal_owns(const ui_modal_t *modal, const lv_obj_t *obj) {
+    if (obj == modal->title) {
+        return true;
+    }
+    for (size_t i = 0; i < UI_WIDGET_POOL_MODAL_BUTTONS; i++) {
+        if (obj == modal->buttons[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ui_modal_t *ui_widget_pool_modal_open(lv_coord_t width, lv_coord_t height, const char *title, bool dim) {
+    ui_modal_t *modal = NULL;
+    for (size_t i = 0; i < UI_WIDGET_POOL_MODALS && !modal; i++) {
+        if (!s_modals[i].open) {
+            modal = &s_modals[i];
+        }
+    }
+    if (!modal) {
+        ESP_LOGW(TAG, "No free modal");
+        return NULL;
+    }
+
+    if (!modal->box) {
+        modal->box = lv_obj_create(lv_layer_top());
+        modal->title = lv_label_create(modal->box);
+        lv_obj_align(modal->title, LV_ALIGN_TOP_MID, 0, 10);
+    }
+    if (dim) {
+        if (!s_backdrop) {
+            s_backdrop = lv_obj_create(lv_layer_top());
+            lv_obj_remove_style_all(s_backdrop);
+            lv_obj_set_size(s_backdrop, lv_pct(100), lv_pct(100));
+            lv_obj_set_style_bg_color(s_backdrop, lv_color_black(), 0);
+            lv_obj_set_style_bg_opa(s_backdrop, LV_OPA_50, 0);
+            lv_obj_add_flag(s_backdrop, LV_OBJ_FLAG_CLICKABLE);     // Taps behind the modal stop here
+        }
+        lv_obj_clear_flag(s_backdrop, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_move_foreground(s_backdrop);
+        s_dim_count++;
+    }
+
+    lv_obj_set_size(modal->box, width, height);
+    lv_obj_center(modal->box);
+    lv_obj_scroll_to(modal->box, 0, 0, LV_ANIM_OFF);
+    lv_label_set_text(modal->title, title ? title : "");
+    for (size_t i = 0; i < UI_WIDGET_POOL_MODAL_BUTTONS; i++) {
+        if (modal->buttons[i]) {
+            lv_obj_add_flag(modal->buttons[i], LV_OBJ_FLAG_HIDDEN);
+        }
+    }
+    lv_obj_clear_flag(modal->box, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_move_foreground(modal->box);
+    modal->user_data = NULL;
+    modal->open = true;
+    modal->dim = dim;
+    return modal;
+}
+
+lv_obj_t *ui_widget_pool_modal_button(ui_modal_t *modal, size_t index, const char *text, lv_event_cb_t cb) {
+    if (!modal || !modal->open || index >= UI_WIDGET_POOL_MODAL_BUTTONS) {
+        return NULL;
+    }
+    lv_obj_t *button = modal->buttons[index];
+    if (!button) {
+        button = lv_btn_create(modal->box);
+        lv_obj_t *label = lv_label_create(button);
+        lv_obj_center(label);
+        modal->buttons[index] = button;
+    }
+    if (modal->button_cbs[index]) {
+        lv_obj_remove_event_cb_with_user_data(button, modal->button_cbs[index], modal);
+    }
+    if (cb) {
+        lv_obj_add_event_cb(button, cb, LV_EVENT_CLICKED, modal);
+    }
+    modal->button_cbs[index] = cb;
+    lv_label_set_text(lv_obj_get_child(button, 0), text);
+    lv_obj_clear_flag(button, LV_OBJ_FLAG_HIDDEN);
+    return button;
+}
+
+void ui_widget_pool_modal_close(ui_modal_t *modal) {
+    if (!modal || !modal->open) {
+        return;
+    }
+    ui_widget_pool_keyboard_release(modal->box);
+
+    // Possibly from the event of one of them: deleted once it has returned
+    uint32_t child_count = lv_obj_get_child_cnt(modal->box);
+    for (uint32_t i = 0; i < child_count; i++) {
+        lv_obj_t *child = lv_obj_get_child(modal->box, i);
+        if (!modal_owns(modal, child) && !lv_obj_has_flag(child, DELETING)) {
+            lv_obj_add_flag(child, LV_OBJ_FLAG_HIDDEN | DELETING);
+            lv_obj_del_async(child);
+        }
+    }
+    lv_obj_add_flag(modal->box, LV_OBJ_FLAG_HIDDEN);
+    modal->open = false;
+
+    if (modal->dim && --s_dim_count == 0) {
+        lv_obj_add_flag(s_backdrop, LV_OBJ_FLAG_HIDDEN);
+    }
+    modal->dim = false;
+}
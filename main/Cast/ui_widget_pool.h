@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Widget pool - one keyboard and a few modal shells, shared by the GUI managers
+ *
+ * A keyboard is a button matrix with a map, a control map and styles for
+ * every part, and a dialog a box, a label and buttons with their own
+ * labels: built for each password prompt or menu and deleted after, they
+ * cost an allocation burst and a layout pass per open. The pool creates
+ * them once, on first use, and keeps them hidden on the top layer between
+ * uses.
+ *
+ * The keyboard is lent to a parent: it is moved under it, bound to its
+ * text area and shown. The next parent takes it over; releasing it, or
+ * deleting its parent, parks it again. A modal shell is a box with a title
+ * and up to UI_WIDGET_POOL_MODAL_BUTTONS buttons, rebound on each open;
+ * anything else the caller puts in the box is deleted when it closes.
+ *
+ * LVGL thread only.
+ */
+
+#define UI_WIDGET_POOL_MODALS           3       // Open at once; one may open another before it closes
+#define UI_WIDGET_POOL_MODAL_BUTTONS    2
+
+typedef struct {
+    lv_obj_t *box;              // On the top layer; the caller's widgets go in here
+    lv_obj_t *title;
+    void *user_data;            // The caller's, NULL at each open
+    // The pool's
+    lv_obj_t *buttons[UI_WIDGET_POOL_MODAL_BUTTONS];
+    lv_event_cb_t button_cbs[UI_WIDGET_POOL_MODAL_BUTTONS];
+    bool open;
+    bool dim;
+} ui_modal_t;
+
+/**
+ * @brief Lend the keyboard to parent, typing into textarea
+ *
+ * Reset to lower case letters and the default size (the parent's width, half
+ * its height); align it as it should sit in parent.
+ *
+ * @param textarea in parent
+ * @param done_cb  called on READY and CANCEL while parent has the keyboard,
+ *                 before textarea gets them; releasing the keyboard in it
+ *                 keeps them from textarea. May be NULL
+ * @return the keyboard, NULL if it could not be created
+ */
+lv_obj_t *ui_widget_pool_keyboard(lv_obj_t *parent, lv_obj_t *textarea, lv_event_cb_t done_cb);
+
+/**
+ * @brief Park the keyboard again, if parent still has it
+ */
+void ui_widget_pool_keyboard_release(lv_obj_t *parent);
+
+/**
+ * @brief Show a modal shell, centred on the top layer
+ *
+ * @param title may be NULL for none
+ * @param dim   grey out and block the screen behind it
+ * @return NULL if UI_WIDGET_POOL_MODALS are open
+ */
+ui_modal_t *ui_widget_pool_modal_open(lv_coord_t width, lv_coord_t height, const char *title, bool dim);
+
+/**
+ * @brief Show a button of the modal, clicked into cb
+ *
+ * The event's user data is the modal. Size and align the returned button.
+ */
+lv_obj_t *ui_widget_pool_modal_button(ui_modal_t *modal, size_t index, const char *text, lv_event_cb_t cb);
+
+/**
+ * @brief Hide the modal for its next use; safe from an event of a widget in it
+ *
+ * The caller's widgets in the box are deleted after the event, and the
+ * keyboard, if lent to the box, is parked.
+ */
+void ui_widget_pool_modal_close(ui_modal_t *modal);
+
+#ifdef __cplusplus
+}
+#endif
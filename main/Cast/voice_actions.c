@@ -0,0 +1,153 @@
+#include "voice_actions.h"
+#include "voice_vocabulary.h"
+#include "gui_event_bus.h"
+#include "chromecast_gui_manager.h"
+#include "spotify_gui_manager.h"
+#include "esp_log.h"
+#include <math.h>
+#if CONFIG_AUDIO_PROMPT
+#include "Audio_Prompt.h"
+#endif
+
+static const char *TAG = "voice_actions";
+
+// Volumes resolved at the wake word; LVGL thread only
+typedef struct {
+    bool valid;
+    chromecast_volume_info_t current;   // Speaker volume, or the last one we asked for
+} voice_volume_t;
+
+static voice_volume_t g_volume;
+
+static void voice_event_handler(const gui_event_t *event);
+
+void voice_actions_init(void) {
+    gui_event_bus_subscribe(GUI_EVENT_VOICE_COMMAND, voice_event_handler);
+}
+
+bool voice_actions_post(voice_action_t action) {
+    gui_event_t event = {
+        .type = GUI_EVENT_VOICE_COMMAND,
+        .data.value = action,
+    };
+    return gui_event_bus_post(&event);
+}
+
+static chromecast_controller_handle_t connected_chromecast(void) {
+    chromecast_controller_handle_t handle = chromecast_gui_get_controller_handle();
+    if (!handle || chromecast_controller_get_state(handle) != CHROMECAST_CONNECTED) {
+        return NULL;
+    }
+    return handle;
+}
+
+static spotify_controller_handle_t connected_spotify(void) {
+    spotify_controller_handle_t handle = spotify_gui_get_controller_handle();
+    if (!handle || !spotify_controller_is_connected(handle)) {
+        return NULL;
+    }
+    return handle;
+}
+
+static void prepare(void) {
+    chromecast_controller_handle_t chromecast = connected_chromecast();
+    if (chromecast) {
+        chromecast_controller_prewarm(chromecast);
+        g_volume.valid = chromecast_controller_get_volume(chromecast, &g_volume.current);
+    } else {
+        g_volume.valid = false;
+    }
+
+    spotify_controller_handle_t spotify = connected_spotify();
+    if (spotify) {
+        spotify_controller_prewarm(spotify);
+    }
+}
+
+static void change_volume(voice_action_t action) {
+    chromecast_controller_handle_t chromecast = connected_chromecast();
+    if (!chromecast) {
+        ESP_LOGW(TAG, "No Chromecast connected for voice volume control");
+        return;
+    }
+    // A command without a wake word first, or one from before a reconnect
+    if (!g_volume.valid) {
+        g_volume.valid = chromecast_controller_get_volume(chromecast, &g_volume.current);
+        if (!g_volume.valid) {
+            ESP_LOGW(TAG, "Speaker volume not known yet");
+            return;
+        }
+    }
+
+    chromecast_volume_info_t target = g_volume.current;
+    if (action == VOICE_ACTION_MUTE) {
+        target.muted = !target.muted;
+    } else {
+        float step = (action == VOICE_ACTION_VOLUME_UP) ? VOICE_ACTIONS_VOLUME_STEP : -VOICE_ACTIONS_VOLUME_STEP;
+        // Whole steps: "up" from 43% goes to 50%, not 53%
+        target.level = roundf((target.level + step) / VOICE_ACTIONS_VOLUME_STEP) * VOICE_ACTIONS_VOLUME_STEP;
+        target.level = fmaxf(0.0f, fminf(1.0f, target.level));
+        target.muted = false;
+    }
+
+    // A second command in the same session continues from this one
+    if (chromecast_controller_request_volume(chromecast, target.level, target.muted)) {
+        g_volume.current = target;
+        ESP_LOGI(TAG, "Voice volume %d%%%s", (int)lroundf(target.level * 100), target.muted ? " (muted)" : "");
+#if CONFIG_AUDIO_PROMPT
+        // Said from what was asked for: the speaker's reply may come after the prompt is wanted
+        if (target.muted) {
+            Audio_Prompt_Say("静音");
+        } else {
+            Audio_Prompt_Say_Number("音量", (int)lroundf(target.level * 100));
+        }
+#endif
+    }
+}
+
+static void control_playback(voice_action_t action) {
+    spotify_controller_handle_t spotify = connected_spotify();
+    if (!spotify) {
+        ESP_LOGW(TAG, "Spotify not connected for voice playback control");
+        return;
+    }
+
+    bool queued = false;
+    switch (action) {
+        case VOICE_ACTION_PLAY:     queued = spotify_controller_play(spotify, NULL); break;
+        case VOICE_ACTION_PAUSE:    queued = spotify_controller_pause(spotify); break;
+        case VOICE_ACTION_NEXT:     queued = spotify_controller_next_track(spotify); break;
+        default: break;
+    }
+    if (!queued) {
+        ESP_LOGW(TAG, "Voice playback command %d not queued", action);
+    }
+}
+
+static void voice_event_handler(const gui_event_t *event) {
+    voice_action_t action = (voice_action_t)event->data.value;
+
+    if (voice_vocabulary_owns(event->data.value)) {
+        voice_vocabulary_run(event->data.value);
+        return;
+    }
+
+    switch (action) {
+        case VOICE_ACTION_WAKE:
+            prepare();
+            break;
+        case VOICE_ACTION_VOLUME_UP:
+        case VOICE_ACTION_VOLUME_DOWN:
+        case VOICE_ACTION_MUTE:
+            change_volume(action);
+            break;
+        case VOICE_ACTION_PLAY:
+        case VOICE_ACTION_PAUSE:
+        case VOICE_ACTION_NEXT:
+            control_playback(action);
+            break;
+        default:
+            ESP_LOGW(TAG, "Unknown voice action %d", action);
+            break;
+    }
+}
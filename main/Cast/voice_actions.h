@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Voice actions - spoken commands applied to the Chromecast and Spotify
+ *
+ * The speech task posts GUI_EVENT_VOICE_COMMAND events (data.value: a
+ * voice_action_t) and never touches the controllers itself; the actions
+ * run on the LVGL thread beside the touch controls.
+ *
+ * VOICE_ACTION_WAKE is posted as soon as the wake word is heard, while the
+ * user is still speaking the command. It pings a quiet Cast link, starts
+ * its volume task, refreshes an expiring Spotify token, reopens a closed
+ * API connection and resolves the volume the up/down/mute commands will
+ * send. When the command is recognised only the request itself is left.
+ *
+ * Values from VOICE_VOCABULARY_FIRST_ID on are not voice_action_t but the
+ * command IDs of phrases taught by voice_vocabulary, and are run by it.
+ *
+ * Motion gestures (CONFIG_QMI8658_MOTION_GESTURES) post the same actions
+ * from the IMU task: a tilt steps the volume, a shake skips to the next.
+ */
+
+#define VOICE_ACTIONS_VOLUME_STEP   0.1f    // Of full volume per "volume up/down"
+
+typedef enum {
+    VOICE_ACTION_WAKE,          // Wake word heard: a command may follow
+    VOICE_ACTION_VOLUME_UP,     // Chromecast
+    VOICE_ACTION_VOLUME_DOWN,
+    VOICE_ACTION_MUTE,          // Toggles
+    VOICE_ACTION_PLAY,          // Spotify
+    VOICE_ACTION_PAUSE,
+    VOICE_ACTION_NEXT,
+} voice_action_t;
+
+/**
+ * @brief Subscribe to voice commands; LVGL thread, after the Chromecast and
+ *        Spotify GUI managers are initialised
+ */
+void voice_actions_init(void);
+
+/**
+ * @brief Queue an action from any task (the speech task)
+ *
+ * @return false if the event bus is full
+ */
+bool voice_actions_post(voice_action_t action);
+
+#ifdef __cplusplus
+}
+#endif
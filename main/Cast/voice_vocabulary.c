@@ -0,0 +1,288 @@
+#include "voice_vocabulary.h"
+#include "sdkconfig.h"
+
+#if defined(CONFIG_VOICE_VOCABULARY)
+
+#include "chromecast_gui_manager.h"
+#include "spotify_gui_manager.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "voice_vocabulary";
+
+typedef enum {
+    ENTRY_PLAYLIST,
+    ENTRY_SPEAKER,
+} entry_kind_t;
+
+// One taught (or to be taught) phrase; its index is its command ID's offset
+typedef struct {
+    char phrase[VOICE_VOCABULARY_PHRASE_LEN];
+    char target[128];           // Playlist URI, or speaker UUID (its name if it has none)
+    entry_kind_t kind;
+    bool wanted;                // In the latest lists
+    bool active;                // In the recognizer
+} entry_t;
+
+static entry_t g_entries[VOICE_VOCABULARY_MAX_ENTRIES];
+static size_t g_next_slot;          // Free slots are taken round robin, so a dropped ID is not reused at once
+static SemaphoreHandle_t g_lock;    // Guards g_entries; the LVGL thread against the speech task
+static volatile bool g_dirty;
+static volatile TickType_t g_changed_at;
+static chromecast_discovery_handle_t g_discovery;
+
+// LVGL thread; the speech task only looks once g_dirty is set
+static bool make_lock(void) {
+    if (!g_lock) {
+        g_lock = xSemaphoreCreateMutex();
+    }
+    return g_lock != NULL;
+}
+
+void voice_vocabulary_init(chromecast_discovery_handle_t discovery) {
+    g_discovery = discovery;
+    voice_vocabulary_cast_devices_changed();
+}
+
+// "Mr. Brightside & Co" -> "mr brightside and co": letters only, down-cased,
+// apostrophes dropped, anything else ending a word
+static bool build_phrase(char *out, const char *prefix, const char *name) {
+    char clean[2 * VOICE_VOCABULARY_PHRASE_LEN];
+    size_t n = 0;
+    for (const char *p = name; *p && n + 5 < sizeof(clean); ++p) {
+        char c = *p;
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+        if (c >= 'a' && c <= 'z') {
+            clean[n++] = c;
+        } else if (c == '&') {
+            memcpy(clean + n, " and ", 5);
+            n += 5;
+        } else if (c != '\'') {
+            clean[n++] = ' ';
+        }
+    }
+    clean[n] = '\0';
+
+    size_t len = strlcpy(out, prefix, VOICE_VOCABULARY_PHRASE_LEN);
+    size_t start = len;
+    int words = 0;
+    char *save = NULL;
+    for (char *word = strtok_r(clean, " ", &save); word && words < VOICE_VOCABULARY_MAX_WORDS;
+         word = strtok_r(NULL, " ", &save)) {
+        size_t word_len = strlen(word);
+        if (len + (len > start) + word_len >= VOICE_VOCABULARY_PHRASE_LEN) {
+            break;
+        }
+        if (len > start) {
+            out[len++] = ' ';
+        }
+        memcpy(out + len, word, word_len);
+        len += word_len;
+        words++;
+    }
+    out[len] = '\0';
+    return words > 0;
+}
+
+// Caller holds g_lock
+static void want(entry_kind_t kind, const char *phrase, const char *target) {
+    entry_t *free_entry = NULL;
+    for (size_t n = 0; n < VOICE_VOCABULARY_MAX_ENTRIES; ++n) {
+        entry_t *entry = &g_entries[(g_next_slot + n) % VOICE_VOCABULARY_MAX_ENTRIES];
+        if ((entry->wanted || entry->active) && strcmp(entry->phrase, phrase) == 0) {
+            if (entry->kind == kind && !entry->wanted) {
+                // Still taught, or dropped and not yet taken out: kept as it is
+                strlcpy(entry->target, target, sizeof(entry->target));
+                entry->wanted = true;
+            }
+            return;         // Otherwise the phrase is another playlist's or a speaker's
+        }
+        if (!free_entry && !entry->wanted && !entry->active) {
+            free_entry = entry;
+        }
+    }
+    if (!free_entry) {
+        return;
+    }
+    strlcpy(free_entry->phrase, phrase, sizeof(free_entry->phrase));
+    strlcpy(free_entry->target, target, sizeof(free_entry->target));
+    free_entry->kind = kind;
+    free_entry->wanted = true;
+    g_next_slot = (free_entry - g_entries + 1) % VOICE_VOCABULARY_MAX_ENTRIES;
+}
+
+// Caller holds g_lock: drops every entry of kind, returning what was wanted
+static void unwant(entry_kind_t kind, bool *was_wanted) {
+    for (size_t i = 0; i < VOICE_VOCABULARY_MAX_ENTRIES; ++i) {
+        was_wanted[i] = g_entries[i].wanted && g_entries[i].kind == kind;
+        if (was_wanted[i]) {
+            g_entries[i].wanted = false;
+        }
+    }
+}
+
+// Caller holds g_lock: after unwant() and want(), whether kind's phrases moved
+static bool changed_since(entry_kind_t kind, const bool *was_wanted) {
+    for (size_t i = 0; i < VOICE_VOCABULARY_MAX_ENTRIES; ++i) {
+        if (g_entries[i].kind == kind && g_entries[i].wanted != was_wanted[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void mark_changed(bool changed) {
+    if (changed) {
+        g_changed_at = xTaskGetTickCount();
+        __atomic_store_n(&g_dirty, true, __ATOMIC_RELEASE);
+    }
+}
+
+void voice_vocabulary_set_playlists(const spotify_playlist_view_t *playlists, size_t count) {
+    if (!make_lock()) {
+        return;
+    }
+    bool was_wanted[VOICE_VOCABULARY_MAX_ENTRIES];
+    char phrase[VOICE_VOCABULARY_PHRASE_LEN];
+    size_t taught = 0;
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    unwant(ENTRY_PLAYLIST, was_wanted);
+    for (size_t i = 0; i < count && taught < VOICE_VOCABULARY_MAX_PLAYLISTS; ++i) {
+        if (playlists[i].uri[0] && build_phrase(phrase, "play ", playlists[i].name)) {
+            want(ENTRY_PLAYLIST, phrase, playlists[i].uri);
+            taught++;
+        }
+    }
+    bool changed = changed_since(ENTRY_PLAYLIST, was_wanted);
+    xSemaphoreGive(g_lock);
+    mark_changed(changed);
+}
+
+void voice_vocabulary_cast_devices_changed(void) {
+    if (!g_discovery || !make_lock()) {
+        return;
+    }
+    const chromecast_device_table_t *table = chromecast_discovery_acquire_devices(g_discovery);
+    size_t count = 0;
+    const chromecast_device_info_t *devices = chromecast_device_table_devices(table, &count);
+    bool was_wanted[VOICE_VOCABULARY_MAX_ENTRIES];
+    char phrase[VOICE_VOCABULARY_PHRASE_LEN];
+    size_t taught = 0;
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    unwant(ENTRY_SPEAKER, was_wanted);
+    for (size_t i = 0; devices && i < count && taught < VOICE_VOCABULARY_MAX_SPEAKERS; ++i) {
+        if (devices[i].protocol == CHROMECAST_PROTOCOL_CAST && build_phrase(phrase, "cast to ", devices[i].name)) {
+            want(ENTRY_SPEAKER, phrase, devices[i].uuid[0] ? devices[i].uuid : devices[i].name);
+            taught++;
+        }
+    }
+    bool changed = changed_since(ENTRY_SPEAKER, was_wanted);
+    xSemaphoreGive(g_lock);
+    chromecast_device_table_release(table);
+    mark_changed(changed);
+}
+
+bool voice_vocabulary_apply(voice_vocabulary_edit_t edit) {
+    if (!__atomic_load_n(&g_dirty, __ATOMIC_ACQUIRE) ||
+        xTaskGetTickCount() - g_changed_at < pdMS_TO_TICKS(VOICE_VOCABULARY_SETTLE_MS)) {
+        return false;
+    }
+
+    int added = 0, removed = 0;
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    g_dirty = false;
+    // Removals first, so MultiNet's phrase limit is not hit on the way
+    for (size_t i = 0; i < VOICE_VOCABULARY_MAX_ENTRIES; ++i) {
+        entry_t *entry = &g_entries[i];
+        if (entry->active && !entry->wanted) {
+            edit(false, VOICE_VOCABULARY_FIRST_ID + i, entry->phrase);
+            entry->active = false;
+            removed++;
+        }
+    }
+    for (size_t i = 0; i < VOICE_VOCABULARY_MAX_ENTRIES; ++i) {
+        entry_t *entry = &g_entries[i];
+        if (entry->wanted && !entry->active) {
+            if (edit(true, VOICE_VOCABULARY_FIRST_ID + i, entry->phrase)) {
+                entry->active = true;
+                added++;
+            } else {
+                ESP_LOGW(TAG, "\"%s\" not taught", entry->phrase);
+                entry->wanted = false;
+            }
+        }
+    }
+    xSemaphoreGive(g_lock);
+
+    if (added || removed) {
+        ESP_LOGI(TAG, "%d phrases added, %d removed", added, removed);
+    }
+    return added || removed;
+}
+
+bool voice_vocabulary_owns(int command_id) {
+    return command_id >= VOICE_VOCABULARY_FIRST_ID &&
+           command_id < VOICE_VOCABULARY_FIRST_ID + VOICE_VOCABULARY_MAX_ENTRIES;
+}
+
+void voice_vocabulary_run(int command_id) {
+    if (!g_lock || !voice_vocabulary_owns(command_id)) {
+        return;
+    }
+    // Recognized just now, so taught a moment ago even if its list has moved on since
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    entry_t entry = g_entries[command_id - VOICE_VOCABULARY_FIRST_ID];
+    xSemaphoreGive(g_lock);
+    if (!entry.phrase[0]) {
+        return;
+    }
+    ESP_LOGI(TAG, "\"%s\"", entry.phrase);
+
+    if (entry.kind == ENTRY_PLAYLIST) {
+        spotify_controller_handle_t spotify = spotify_gui_get_controller_handle();
+        if (!spotify || !spotify_controller_is_connected(spotify)) {
+            ESP_LOGW(TAG, "Spotify not connected for \"%s\"", entry.phrase);
+        } else if (!spotify_controller_play(spotify, entry.target)) {
+            ESP_LOGW(TAG, "Play of %s not queued", entry.target);
+        }
+        return;
+    }
+
+    chromecast_device_info_t device;
+    if (!g_discovery || !chromecast_discovery_find_device(g_discovery, entry.target, &device)) {
+        ESP_LOGW(TAG, "Speaker for \"%s\" is gone", entry.phrase);
+        return;
+    }
+    chromecast_gui_connect_device(&device);
+}
+
+#else
+
+void voice_vocabulary_init(chromecast_discovery_handle_t discovery) {
+}
+
+void voice_vocabulary_set_playlists(const spotify_playlist_view_t *playlists, size_t count) {
+}
+
+void voice_vocabulary_cast_devices_changed(void) {
+}
+
+bool voice_vocabulary_apply(voice_vocabulary_edit_t edit) {
+    return false;
+}
+
+bool voice_vocabulary_owns(int command_id) {
+    return false;
+}
+
+void voice_vocabulary_run(int command_id) {
+}
+
+#endif
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "chromecast_discovery_wrapper.h"
+#include "spotify_controller_wrapper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Voice vocabulary - MultiNet commands built from the libraries
+ *
+ * Besides the fixed commands from sdkconfig, the recognizer is taught
+ * "play <playlist>" for the cached Spotify playlists and "cast to
+ * <speaker>" for the discovered Cast devices. Names are reduced to what
+ * MultiNet6's English grapheme model takes: lower-case letters and single
+ * spaces, at most VOICE_VOCABULARY_MAX_WORDS words; a name with nothing
+ * left, or clashing with one already taught, is left out.
+ *
+ * The lists are updated on the LVGL thread and only mark what changed.
+ * The speech task applies the differences between its fetches with
+ * esp_mn_commands_add()/remove() and a single esp_mn_commands_update(),
+ * once the lists have been quiet for VOICE_VOCABULARY_SETTLE_MS and no
+ * command is being listened for, so a discovery sweep or the playlist
+ * pages arriving one by one rebuild the recognizer once.
+ *
+ * Each phrase keeps its command ID, from VOICE_VOCABULARY_FIRST_ID on,
+ * while it is taught; a recognized one reaches voice_actions like the
+ * fixed commands and is run by voice_vocabulary_run() on the LVGL thread.
+ *
+ * Nothing is taught unless VOICE_VOCABULARY is enabled.
+ */
+
+#define VOICE_VOCABULARY_FIRST_ID       200     // Past the sdkconfig command IDs
+#define VOICE_VOCABULARY_MAX_PLAYLISTS  48
+#define VOICE_VOCABULARY_MAX_SPEAKERS   16
+#define VOICE_VOCABULARY_MAX_ENTRIES    (VOICE_VOCABULARY_MAX_PLAYLISTS + VOICE_VOCABULARY_MAX_SPEAKERS)
+#define VOICE_VOCABULARY_MAX_WORDS      5       // Of a name; longer ones are cut
+#define VOICE_VOCABULARY_PHRASE_LEN     64      // MultiNet's limit, with the terminator
+#define VOICE_VOCABULARY_SETTLE_MS      3000
+
+/**
+ * @brief Start following the libraries; LVGL thread, after discovery has started
+ *
+ * @param discovery Where the Cast device table is read from
+ */
+void voice_vocabulary_init(chromecast_discovery_handle_t discovery);
+
+/**
+ * @brief The Spotify playlists shown changed (the snapshot's or the live pages)
+ */
+void voice_vocabulary_set_playlists(const spotify_playlist_view_t *playlists, size_t count);
+
+/**
+ * @brief The discovered Cast device table changed
+ */
+void voice_vocabulary_cast_devices_changed(void);
+
+/**
+ * @brief One recognizer edit, made by the speech task
+ *
+ * @return false if MultiNet refused it
+ */
+typedef bool (*voice_vocabulary_edit_t)(bool add, int command_id, const char *phrase);
+
+/**
+ * @brief Hand the settled changes to edit; speech task, between fetches
+ *
+ * Cheap when there is nothing to do.
+ * @return true if anything was edited: the caller runs esp_mn_commands_update()
+ */
+bool voice_vocabulary_apply(voice_vocabulary_edit_t edit);
+
+/**
+ * @brief Whether a recognized command ID is one of the taught phrases
+ */
+bool voice_vocabulary_owns(int command_id);
+
+/**
+ * @brief Run a recognized phrase; LVGL thread
+ */
+void voice_vocabulary_run(int command_id);
+
+#ifdef __cplusplus
+}
+#endif
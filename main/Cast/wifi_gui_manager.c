@@ -1,18 +1,33 @@
 #include "wifi_gui_manager.h"
 #include "wifi_manager.h"
+#include "wifi_scan_model.h"
+#include "gui_event_bus.h"
+#include "ui_layer_cache.h"
+#include "ui_widget_pool.h"
+#include "LVGL_Scroll.h"
 #include "esp_log.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "wifi_gui_manager";
 
+// Rows created, moved, relabelled or deleted per LVGL frame while a new scan is applied
+#define WIFI_GUI_ROWS_PER_FRAME 2
+
 // GUI state
 typedef struct {
     bool initialized;
     lv_obj_t *status_bar;
     lv_obj_t *scan_button;
     lv_obj_t *wifi_list_container;
-    lv_obj_t *connection_modal;
+    ui_modal_t *connection_modal;
+    char dialog_ssid[33];           // The network the password prompt is for
     lv_obj_t *main_container;
+    char status_text[128];          // Kept while the tab is unloaded
+    wifi_scan_model_t target;       // The list being patched in, or shown when the tab is built
+    uint16_t patch_index;           // Rows before this already match target
+    lv_timer_t *patch_timer;
 } wifi_gui_state_t;
 
 static wifi_gui_state_t g_gui_state = {0};
@@ -21,8 +36,11 @@ static wifi_gui_state_t g_gui_state = {0};
 static void scan_button_cb(lv_event_t *e);
 static void wifi_network_button_cb(lv_event_t *e);
 static void password_input_cb(lv_event_t *e);
+static void password_keyboard_cb(lv_event_t *e);
 static void wifi_status_callback(const char *ssid, const char *ip, bool connected);
 static void wifi_scan_callback(wifi_ap_record_t *aps, uint16_t ap_count);
+static void patch_timer_cb(lv_timer_t *timer);
+static void apply_scan_model(const wifi_scan_model_t *model);
 
 esp_err_t wifi_gui_manager_init(const wifi_gui_config_t *config) {
     if (g_gui_state.initialized) {
@@ -64,12 +82,14 @@ esp_err_t wifi_gui_manager_deinit(void) {
     ESP_LOGI(TAG, "Deinitializing WiFi GUI Manager");
 
     // Clean up GUI objects
+    wifi_gui_hide_scan_results();
+    if (g_gui_state.patch_timer) {
+        lv_timer_del(g_gui_state.patch_timer);
+    }
     if (g_gui_state.main_container) {
         lv_obj_del(g_gui_state.main_container);
     }
-    if (g_gui_state.connection_modal) {
-        lv_obj_del(g_gui_state.connection_modal);
-    }
+    ui_widget_pool_modal_close(g_gui_state.connection_modal);
 
     // Deinitialize WiFi Manager
     wifi_manager_deinit();
@@ -90,10 +110,12 @@ lv_obj_t *wifi_gui_create_interface(lv_obj_t *parent) {
     lv_obj_t *container = lv_obj_create(parent);
     lv_obj_set_size(container, lv_pct(100), lv_pct(100));
     lv_obj_center(container);
+    ui_layer_cache_attach(container);
 
     // Create button list
     lv_obj_t *btn_list = lv_list_create(container);
     lv_obj_center(btn_list);
+    LVGL_Scroll_Blit_Enable(btn_list);
 
     // Create WiFi scan button
     g_gui_state.scan_button = lv_list_add_btn(btn_list, LV_SYMBOL_WIFI, "Scan Wi-Fi");
@@ -102,63 +124,208 @@ lv_obj_t *wifi_gui_create_interface(lv_obj_t *parent) {
     // Create status bar
     g_gui_state.status_bar = lv_label_create(container);
     lv_obj_align(g_gui_state.status_bar, LV_ALIGN_BOTTOM_MID, 0, -10);
-    lv_label_set_text(g_gui_state.status_bar, "Wi-Fi: Disconnected");
+    lv_label_set_text(g_gui_state.status_bar, g_gui_state.status_text[0] ? g_gui_state.status_text : "Wi-Fi: Disconnected");
 
     g_gui_state.main_container = container;
+
+    // The last scan, if it came in while the tab was not built
+    if (g_gui_state.target.count > 0) {
+        apply_scan_model(&g_gui_state.target);
+    }
     return container;
 }
 
-void wifi_gui_show_scan_results(wifi_ap_record_t *aps, uint16_t ap_count) {
-    // Delete previous list if it exists
-    if (g_gui_state.wifi_list_container) {
-        lv_obj_del(g_gui_state.wifi_list_container);
-        g_gui_state.wifi_list_container = NULL;
+static void free_rows(void) {
+    uint32_t child_count = lv_obj_get_child_cnt(g_gui_state.wifi_list_container);
+    for (uint32_t i = 0; i < child_count; i++) {
+        free(lv_obj_get_user_data(lv_obj_get_child(g_gui_state.wifi_list_container, i)));
     }
+}
 
-    if (ap_count == 0) {
-        ESP_LOGI(TAG, "No WiFi networks found");
+void wifi_gui_unload_interface(void) {
+    if (!g_gui_state.main_container) {
         return;
     }
+    if (g_gui_state.patch_timer) {
+        lv_timer_pause(g_gui_state.patch_timer);
+    }
+    // The target stays, for create_interface to patch in again
+    if (g_gui_state.wifi_list_container) {
+        free_rows();
+    }
+    g_gui_state.status_bar = NULL;
+    g_gui_state.scan_button = NULL;
+    g_gui_state.wifi_list_container = NULL;
+    g_gui_state.main_container = NULL;
+}
+
+void wifi_gui_show_scan_results(wifi_ap_record_t *aps, uint16_t ap_count) {
+    // Static: too large for the LVGL task stack, and only used on that thread
+    static wifi_scan_model_t model;
+    wifi_scan_model_build(&model, aps, ap_count);
+    apply_scan_model(&model);
+}
+
+static void format_network_label(const wifi_scan_entry_t *entry, char *buffer, size_t size) {
+    snprintf(buffer, size, "%s (%d dBm)", entry->ssid, wifi_scan_model_display_rssi(entry->rssi));
+}
+
+static void set_network_button(lv_obj_t *btn, const wifi_scan_entry_t *entry) {
+    char btn_text[64];
+    format_network_label(entry, btn_text, sizeof(btn_text));
 
-    // Create new list container
-    g_gui_state.wifi_list_container = lv_list_create(g_gui_state.main_container);
-    lv_obj_set_size(g_gui_state.wifi_list_container, lv_pct(90), LV_SIZE_CONTENT);
-    lv_obj_center(g_gui_state.wifi_list_container);
-
-    // Add networks to list
-    for (int i = 0; i < ap_count; i++) {
-        // Create button with SSID and signal strength
-        char btn_text[64];
-        snprintf(btn_text, sizeof(btn_text), "%s (%d dBm)", 
-                 (char *)aps[i].ssid, aps[i].rssi);
-
-        lv_obj_t *btn = lv_list_add_btn(g_gui_state.wifi_list_container, LV_SYMBOL_WIFI, btn_text);
-        
-        // Store AP info in button user data
-        wifi_ap_record_t *ap_data = malloc(sizeof(wifi_ap_record_t));
-        if (ap_data) {
-            memcpy(ap_data, &aps[i], sizeof(wifi_ap_record_t));
-            lv_obj_set_user_data(btn, ap_data);
-            lv_obj_add_event_cb(btn, wifi_network_button_cb, LV_EVENT_CLICKED, NULL);
+    uint32_t child_count = lv_obj_get_child_cnt(btn);
+    for (uint32_t i = 0; i < child_count; i++) {
+        lv_obj_t *child = lv_obj_get_child(btn, i);
+        if (lv_obj_check_type(child, &lv_label_class)) {
+            lv_label_set_text(child, btn_text);
         }
     }
 
-    ESP_LOGI(TAG, "Displayed %d WiFi networks", ap_count);
+    wifi_scan_entry_t *shown = lv_obj_get_user_data(btn);
+    if (shown) {
+        *shown = *entry;
+    }
 }
 
-void wifi_gui_update_status(const char *ssid, const char *ip_address, bool connected) {
-    if (!g_gui_state.status_bar) {
+static lv_obj_t *add_network_button(const wifi_scan_entry_t *entry) {
+    char btn_text[64];
+    format_network_label(entry, btn_text, sizeof(btn_text));
+
+    lv_obj_t *btn = lv_list_add_btn(g_gui_state.wifi_list_container, LV_SYMBOL_WIFI, btn_text);
+
+    // Store the entry in button user data
+    wifi_scan_entry_t *shown = malloc(sizeof(wifi_scan_entry_t));
+    if (shown) {
+        *shown = *entry;
+        lv_obj_set_user_data(btn, shown);
+        lv_obj_add_event_cb(btn, wifi_network_button_cb, LV_EVENT_CLICKED, NULL);
+    }
+    return btn;
+}
+
+/**
+ * @brief One step of bringing the list in line with g_gui_state.target
+ *
+ * Rows are matched by SSID; a row that already shows its target entry in the
+ * right place costs nothing. Returns false for a step that changed no object.
+ */
+static bool patch_next_row(bool *done) {
+    lv_obj_t *list = g_gui_state.wifi_list_container;
+    uint16_t index = g_gui_state.patch_index;
+    uint32_t child_count = lv_obj_get_child_cnt(list);
+
+    if (index >= g_gui_state.target.count) {
+        // Everything wanted is in place; drop the rows after it
+        if (child_count <= index) {
+            *done = true;
+            return false;
+        }
+        lv_obj_t *extra = lv_obj_get_child(list, child_count - 1);
+        free(lv_obj_get_user_data(extra));
+        lv_obj_del(extra);
+        return true;
+    }
+
+    const wifi_scan_entry_t *entry = &g_gui_state.target.entries[index];
+    g_gui_state.patch_index++;
+
+    lv_obj_t *row = NULL;
+    for (uint32_t i = index; i < child_count; i++) {
+        lv_obj_t *child = lv_obj_get_child(list, i);
+        const wifi_scan_entry_t *shown = lv_obj_get_user_data(child);
+        if (shown && strcmp(shown->ssid, entry->ssid) == 0) {
+            row = child;
+            break;
+        }
+    }
+
+    if (!row) {
+        row = add_network_button(entry);
+        lv_obj_move_to_index(row, index);
+        return true;
+    }
+
+    bool changed = false;
+    if (lv_obj_get_index(row) != index) {
+        lv_obj_move_to_index(row, index);
+        changed = true;
+    }
+    const wifi_scan_entry_t *shown = lv_obj_get_user_data(row);
+    if (!wifi_scan_entry_same_row(shown, entry)) {
+        set_network_button(row, entry);
+        changed = true;
+    } else {
+        *(wifi_scan_entry_t *)shown = *entry;   // Keep the exact RSSI and channel
+    }
+    return changed;
+}
+
+static void patch_timer_cb(lv_timer_t *timer) {
+    if (!g_gui_state.wifi_list_container) {
+        lv_timer_pause(timer);
+        return;
+    }
+
+    int budget = WIFI_GUI_ROWS_PER_FRAME;
+    bool done = false;
+    while (budget > 0 && !done) {
+        if (patch_next_row(&done)) {
+            budget--;
+        }
+    }
+    if (done) {
+        lv_timer_pause(timer);
+        ESP_LOGI(TAG, "Displayed %d WiFi networks", g_gui_state.target.count);
+    }
+}
+
+/**
+ * @brief Start patching the shown list towards a new model
+ *
+ * LVGL thread. A model that arrives while a patch is running replaces the
+ * target and the walk starts again from the top; rows already right are
+ * passed over without work.
+ */
+static void apply_scan_model(const wifi_scan_model_t *model) {
+    if (!g_gui_state.main_container) {
+        g_gui_state.target = *model;
+        return;
+    }
+
+    if (model->count == 0) {
+        ESP_LOGI(TAG, "No WiFi networks found");
+        wifi_gui_hide_scan_results();
         return;
     }
 
-    char status_text[128];
+    if (!g_gui_state.wifi_list_container) {
+        g_gui_state.wifi_list_container = lv_list_create(g_gui_state.main_container);
+        lv_obj_set_size(g_gui_state.wifi_list_container, lv_pct(90), LV_SIZE_CONTENT);
+        lv_obj_center(g_gui_state.wifi_list_container);
+    }
+
+    g_gui_state.target = *model;
+    g_gui_state.patch_index = 0;
+    if (!g_gui_state.patch_timer) {
+        // Period 1: runs on every lv_timer_handler() pass until paused
+        g_gui_state.patch_timer = lv_timer_create(patch_timer_cb, 1, NULL);
+    } else {
+        lv_timer_resume(g_gui_state.patch_timer);
+    }
+}
+
+void wifi_gui_update_status(const char *ssid, const char *ip_address, bool connected) {
+    char *status_text = g_gui_state.status_text;
     if (connected && ssid && ip_address) {
-        snprintf(status_text, sizeof(status_text), "Wi-Fi: Connected to %s (%s)", ssid, ip_address);
+        snprintf(status_text, sizeof(g_gui_state.status_text), "Wi-Fi: Connected to %s (%s)", ssid, ip_address);
     } else {
-        snprintf(status_text, sizeof(status_text), "Wi-Fi: Disconnected");
+        snprintf(status_text, sizeof(g_gui_state.status_text), "Wi-Fi: Disconnected");
     }
 
-    lv_label_set_text(g_gui_state.status_bar, status_text);
+    if (g_gui_state.status_bar) {
+        lv_label_set_text(g_gui_state.status_bar, status_text);
+    }
     ESP_LOGI(TAG, "Updated WiFi status: %s", status_text);
 }
 
@@ -167,21 +334,14 @@ void wifi_gui_show_connection_dialog(const char *ssid) {
         return;
     }
 
-    // Create modal background
-    g_gui_state.connection_modal = lv_obj_create(lv_scr_act());
-    lv_obj_set_size(g_gui_state.connection_modal, lv_pct(100), lv_pct(100));
-    lv_obj_set_style_bg_opa(g_gui_state.connection_modal, LV_OPA_50, 0);
-    lv_obj_center(g_gui_state.connection_modal);
-
-    // Create dialog container
-    lv_obj_t *dialog = lv_obj_create(g_gui_state.connection_modal);
-    lv_obj_set_size(dialog, 300, 250);
-    lv_obj_center(dialog);
-
-    // Create title label
-    lv_obj_t *title = lv_label_create(dialog);
-    lv_label_set_text_fmt(title, "Connect to %s", ssid);
-    lv_obj_align(title, LV_ALIGN_TOP_MID, 0, 10);
+    char title[48];
+    snprintf(title, sizeof(title), "Connect to %s", ssid);
+    g_gui_state.connection_modal = ui_widget_pool_modal_open(300, 250, title, true);
+    if (!g_gui_state.connection_modal) {
+        return;
+    }
+    strlcpy(g_gui_state.dialog_ssid, ssid, sizeof(g_gui_state.dialog_ssid));
+    lv_obj_t *dialog = g_gui_state.connection_modal->box;
 
     // Create password input
     lv_obj_t *password_input = lv_textarea_create(dialog);
@@ -191,19 +351,11 @@ void wifi_gui_show_connection_dialog(const char *ssid) {
     lv_obj_set_width(password_input, lv_pct(90));
     lv_obj_align(password_input, LV_ALIGN_TOP_MID, 0, 50);
 
-    // Store SSID in input user data
-    char *ssid_copy = malloc(strlen(ssid) + 1);
-    if (ssid_copy) {
-        strcpy(ssid_copy, ssid);
-        lv_obj_set_user_data(password_input, ssid_copy);
+    lv_obj_t *keyboard = ui_widget_pool_keyboard(dialog, password_input, password_keyboard_cb);
+    if (keyboard) {
+        lv_obj_align(keyboard, LV_ALIGN_BOTTOM_MID, 0, -10);
     }
 
-    // Create keyboard
-    lv_obj_t *keyboard = lv_keyboard_create(dialog);
-    lv_keyboard_set_mode(keyboard, LV_KEYBOARD_MODE_TEXT_LOWER);
-    lv_keyboard_set_textarea(keyboard, password_input);
-    lv_obj_align(keyboard, LV_ALIGN_BOTTOM_MID, 0, -10);
-
     // Handle password submission
     lv_obj_add_event_cb(password_input, password_input_cb, LV_EVENT_READY, NULL);
 
@@ -211,7 +363,12 @@ void wifi_gui_show_connection_dialog(const char *ssid) {
 }
 
 void wifi_gui_hide_scan_results(void) {
+    if (g_gui_state.patch_timer) {
+        lv_timer_pause(g_gui_state.patch_timer);
+    }
+    g_gui_state.target.count = 0;
     if (g_gui_state.wifi_list_container) {
+        free_rows();
         lv_obj_del(g_gui_state.wifi_list_container);
         g_gui_state.wifi_list_container = NULL;
     }
@@ -239,47 +396,64 @@ static void scan_button_cb(lv_event_t *e) {
 
 static void wifi_network_button_cb(lv_event_t *e) {
     lv_obj_t *btn = lv_event_get_target(e);
-    wifi_ap_record_t *ap = (wifi_ap_record_t *)lv_obj_get_user_data(btn);
+    const wifi_scan_entry_t *network = lv_obj_get_user_data(btn);
 
-    if (ap) {
-        ESP_LOGI(TAG, "Selected WiFi network: %s", (char *)ap->ssid);
-        wifi_gui_show_connection_dialog((char *)ap->ssid);
+    if (network) {
+        ESP_LOGI(TAG, "Selected WiFi network: %s", network->ssid);
+        wifi_gui_show_connection_dialog(network->ssid);
     }
 }
 
 static void password_input_cb(lv_event_t *e) {
     lv_obj_t *input = lv_event_get_target(e);
-    char *ssid = (char *)lv_obj_get_user_data(input);
     const char *password = lv_textarea_get_text(input);
 
-    if (ssid && password) {
-        ESP_LOGI(TAG, "Connecting to WiFi: %s", ssid);
+    if (g_gui_state.connection_modal && password) {
+        ESP_LOGI(TAG, "Connecting to WiFi: %s", g_gui_state.dialog_ssid);
 
-        esp_err_t ret = wifi_manager_connect(ssid, password, true);
+        esp_err_t ret = wifi_manager_connect(g_gui_state.dialog_ssid, password, true);
         if (ret != ESP_OK) {
             ESP_LOGE(TAG, "Failed to connect to WiFi: %s", esp_err_to_name(ret));
         }
 
-        // Clean up
-        free(ssid);
-
-        // Close modal
-        if (g_gui_state.connection_modal) {
-            lv_obj_del_async(g_gui_state.connection_modal);
-            g_gui_state.connection_modal = NULL;
-        }
+        // Close modal; the input goes once this event has returned
+        ui_widget_pool_modal_close(g_gui_state.connection_modal);
+        g_gui_state.connection_modal = NULL;
 
         // Hide scan results
         wifi_gui_hide_scan_results();
     }
 }
 
+// READY is the input's to handle; the keyboard's close key drops the prompt
+static void password_keyboard_cb(lv_event_t *e) {
+    if (lv_event_get_code(e) == LV_EVENT_CANCEL) {
+        ui_widget_pool_modal_close(g_gui_state.connection_modal);
+        g_gui_state.connection_modal = NULL;
+    }
+}
+
 static void wifi_status_callback(const char *ssid, const char *ip, bool connected) {
     ESP_LOGI(TAG, "WiFi status changed: %s", connected ? "Connected" : "Disconnected");
     wifi_gui_update_status(ssid, ip, connected);
 }
 
+static void scan_model_call(void *arg) {
+    wifi_scan_model_t *model = arg;
+    apply_scan_model(model);
+    free(model);
+}
+
 static void wifi_scan_callback(wifi_ap_record_t *aps, uint16_t ap_count) {
     ESP_LOGI(TAG, "WiFi scan completed, found %d networks", ap_count);
-    wifi_gui_show_scan_results(aps, ap_count);
+
+    // Event task: dedup and sort here, patch the rows on the LVGL thread
+    wifi_scan_model_t *model = malloc(sizeof(wifi_scan_model_t));
+    if (!model) {
+        return;
+    }
+    wifi_scan_model_build(model, aps, ap_count);
+    if (!gui_event_bus_post_call(scan_model_call, model)) {
+        free(model);
+    }
 }
@@ -48,9 +48,21 @@ esp_err_t wifi_gui_manager_deinit(void);
  */
 lv_obj_t *wifi_gui_create_interface(lv_obj_t *parent);
 
+/**
+ * @brief Forget the interface's widgets before its parent deletes them
+ *
+ * The status line and the last scan are kept; the next
+ * wifi_gui_create_interface() shows them again.
+ */
+void wifi_gui_unload_interface(void);
+
 /**
  * @brief Show WiFi scan results
- * 
+ *
+ * LVGL thread. The records are deduplicated and sorted (wifi_scan_model.h)
+ * and the shown list is patched towards them a few rows per frame; rows
+ * that have not changed are left alone.
+ *
  * @param aps Array of WiFi access points
  * @param ap_count Number of access points
  */
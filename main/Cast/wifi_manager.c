@@ -3,25 +3,90 @@
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_netif.h"
-#include "nvs_flash.h"
+#include "esp_mac.h"
+#include "config_store.h"
+#include "mbedtls/pkcs5.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "sdkconfig.h"
 #include <string.h>
+#ifdef CONFIG_ESP_WIFI_11KV_SUPPORT
+#include "esp_wnm.h"
+#include "esp_rrm.h"
+#endif
 
 static const char *TAG = "wifi_manager";
 
+#define WIFI_AP_CACHE_VERSION 1
+
+#define WIFI_ROAM_BACKOFF_MS 30000      // Between roam attempts that found nothing better
+#define WIFI_ROAM_STEER_WAIT_MS 1500    // For the AP to answer a BTM query before we scan
+#define WIFI_ROAM_SCAN_ACTIVE_MS 40     // Per channel; the driver goes home between channels
+#define WIFI_EID_NEIGHBOR_REPORT 52
+
+// Private events, so the roam timer's work runs on the event loop with everything else
+ESP_EVENT_DEFINE_BASE(WIFI_MANAGER_EVENT);
+enum {
+    WIFI_MANAGER_EVENT_ROAM_TIMER,
+};
+
+/**
+ * Roaming: the driver raises BSS_RSSI_LOW once the AP falls below
+ * CONFIG_WIFI_ROAM_RSSI_THRESHOLD (and BEACON_TIMEOUT when beacons go
+ * missing). We ask the AP to steer us (802.11v BTM query); if it does not
+ * within WIFI_ROAM_STEER_WAIT_MS, we ask for its neighbours (802.11k) and
+ * scan just their channels for our SSID, or every channel without 11k.
+ * A BSSID at least CONFIG_WIFI_ROAM_MIN_GAIN dB stronger is joined directly.
+ *
+ * Either way a roam is a reassociation: the link is down for a few hundred
+ * milliseconds, but g_wifi_state stays connected, no status callback fires,
+ * and the netif keeps its address (IP lost timer, DHCP restore of the last
+ * lease), so open sockets - Cast TLS sessions and their heartbeats - carry on.
+ */
+typedef enum {
+    WIFI_ROAM_IDLE,
+    WIFI_ROAM_STEERING,     // BTM query sent, waiting for the AP or the timer
+    WIFI_ROAM_NEIGHBORS,    // Neighbour report requested, waiting for it or the timer
+    WIFI_ROAM_SCANNING,     // Background scan for our SSID
+    WIFI_ROAM_LEAVING,      // Disconnecting from the current AP for the target
+    WIFI_ROAM_JOINING       // Connecting to the target, ours or the AP's pick
+} wifi_roam_state_t;
+
+// The last AP we got an IP from, so the next connect can skip the scan
+typedef struct {
+    uint8_t version;
+    uint8_t channel;
+    uint8_t has_pmk;
+    uint8_t reserved;
+    uint32_t key;           // wifi_manager_cache_key() of the SSID and password
+    uint8_t bssid[6];
+    char ssid[33];
+    uint8_t pmk[32];        // WPA/WPA2-PSK only; saves the 4096-round PBKDF2 on connect
+} wifi_ap_cache_t;
+
 // Internal state
 typedef struct {
     bool initialized;
     bool connected;
     bool auto_connect_enabled;
+    bool fast_attempt;      // Connecting directly to the cached BSSID/channel
     uint8_t reconnect_attempts;
+    wifi_roam_state_t roam_state;
+    uint8_t roam_bssid[6];      // The AP being left, then the one being joined
+    uint8_t roam_channel;
+    int8_t roam_rssi;           // Of the AP being left
+    TickType_t roam_started;
+    esp_timer_handle_t roam_timer;  // Steering and neighbour-report waits, then the backoff
+    char ssid[33];          // The network being joined, for the scan fallback
+    char password[65];
+    esp_netif_t *netif;
     wifi_status_callback_t status_callback;
     wifi_scan_callback_t scan_callback;
     wifi_connection_info_t connection_info;
     esp_event_handler_instance_t wifi_handler_instance;
     esp_event_handler_instance_t ip_handler_instance;
+    esp_event_handler_instance_t manager_handler_instance;
 } wifi_manager_state_t;
 
 static wifi_manager_state_t g_wifi_state = {0};
@@ -29,6 +94,18 @@ static wifi_manager_state_t g_wifi_state = {0};
 // Forward declarations
 static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data);
 static esp_err_t wifi_manager_init_nvs(void);
+static esp_err_t wifi_manager_apply_config(bool use_cache, const uint8_t *bssid, uint8_t channel);
+static void wifi_manager_update_ap_cache(const wifi_ap_record_t *ap);
+static void wifi_manager_clear_ap_cache(void);
+static void wifi_manager_set_static_ip(void);
+#ifdef CONFIG_WIFI_ROAMING
+static void wifi_manager_roam_start(const char *why, bool frames_lost);
+static void wifi_manager_roam_survey(void);
+static void wifi_manager_roam_scan(uint16_t channels);
+static void wifi_manager_roam_scan_done(void);
+static void wifi_manager_roam_end(uint32_t backoff_ms);
+static void wifi_manager_roam_timer_cb(void *arg);
+#endif
 
 esp_err_t wifi_manager_init(const wifi_manager_config_t *config) {
     if (g_wifi_state.initialized) {
@@ -48,7 +125,7 @@ esp_err_t wifi_manager_init(const wifi_manager_config_t *config) {
     // Initialize network interface
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    g_wifi_state.netif = esp_netif_create_default_wifi_sta();
 
     // Initialize WiFi
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
@@ -61,6 +138,16 @@ esp_err_t wifi_manager_init(const wifi_manager_config_t *config) {
         WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, &g_wifi_state.wifi_handler_instance));
     ESP_ERROR_CHECK(esp_event_handler_instance_register(
         IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL, &g_wifi_state.ip_handler_instance));
+#ifdef CONFIG_WIFI_ROAMING
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(
+        WIFI_MANAGER_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, &g_wifi_state.manager_handler_instance));
+
+    const esp_timer_create_args_t roam_timer_args = {
+        .callback = wifi_manager_roam_timer_cb,
+        .name = "wifi_roam",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&roam_timer_args, &g_wifi_state.roam_timer));
+#endif
 
     // Set callbacks if provided
     if (config) {
@@ -111,6 +198,14 @@ esp_err_t wifi_manager_deinit(void) {
     if (g_wifi_state.ip_handler_instance) {
         esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, g_wifi_state.ip_handler_instance);
     }
+    if (g_wifi_state.manager_handler_instance) {
+        esp_event_handler_instance_unregister(WIFI_MANAGER_EVENT, ESP_EVENT_ANY_ID,
+                                              g_wifi_state.manager_handler_instance);
+    }
+    if (g_wifi_state.roam_timer) {
+        esp_timer_stop(g_wifi_state.roam_timer);
+        esp_timer_delete(g_wifi_state.roam_timer);
+    }
 
     // Stop and deinitialize WiFi
     esp_wifi_stop();
@@ -151,18 +246,20 @@ esp_err_t wifi_manager_connect(const char *ssid, const char *password, bool save
         return ESP_ERR_INVALID_ARG;
     }
 
-    wifi_config_t wifi_config = {0};
-    strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid) - 1);
+    memset(g_wifi_state.ssid, 0, sizeof(g_wifi_state.ssid));
+    memset(g_wifi_state.password, 0, sizeof(g_wifi_state.password));
+    strncpy(g_wifi_state.ssid, ssid, sizeof(g_wifi_state.ssid) - 1);
     if (password) {
-        strncpy((char *)wifi_config.sta.password, password, sizeof(wifi_config.sta.password) - 1);
+        strncpy(g_wifi_state.password, password, sizeof(g_wifi_state.password) - 1);
     }
 
     ESP_LOGI(TAG, "Connecting to WiFi network: %s", ssid);
 
-    // Disconnect first if already connected
+    // Disconnect first if already connected; a roam in progress is abandoned
+    g_wifi_state.roam_state = WIFI_ROAM_IDLE;
     esp_wifi_disconnect();
-    
-    esp_err_t ret = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+
+    esp_err_t ret = wifi_manager_apply_config(true, NULL, 0);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to set WiFi config: %s", esp_err_to_name(ret));
         return ret;
@@ -189,6 +286,7 @@ esp_err_t wifi_manager_disconnect(void) {
     }
 
     ESP_LOGI(TAG, "Disconnecting from WiFi");
+    g_wifi_state.roam_state = WIFI_ROAM_IDLE;
     return esp_wifi_disconnect();
 }
 
@@ -207,24 +305,15 @@ bool wifi_manager_load_credentials(char *ssid, size_t ssid_len, char *password,
         return false;
     }
 
-    nvs_handle_t nvs;
-    esp_err_t err = nvs_open(WIFI_CREDS_NAMESPACE, NVS_READONLY, &nvs);
-    if (err != ESP_OK) {
-        ESP_LOGI(TAG, "No saved WiFi credentials found (NVS namespace not found)");
-        return false;
-    }
-
     size_t required_ssid_len = ssid_len;
-    err = nvs_get_str(nvs, WIFI_CREDS_SSID_KEY, ssid, &required_ssid_len);
+    esp_err_t err = config_store_get_str(WIFI_CREDS_NAMESPACE, WIFI_CREDS_SSID_KEY, ssid, &required_ssid_len);
     if (err != ESP_OK) {
-        ESP_LOGI(TAG, "No saved SSID found in NVS");
-        nvs_close(nvs);
+        ESP_LOGI(TAG, "No saved SSID found");
         return false;
     }
 
     size_t required_pass_len = pass_len;
-    err = nvs_get_str(nvs, WIFI_CREDS_PASS_KEY, password, &required_pass_len);
-    nvs_close(nvs);
+    err = config_store_get_str(WIFI_CREDS_NAMESPACE, WIFI_CREDS_PASS_KEY, password, &required_pass_len);
 
     if (err == ESP_OK) {
         ESP_LOGI(TAG, "Successfully loaded WiFi credentials for SSID: %s", ssid);
@@ -240,23 +329,11 @@ esp_err_t wifi_manager_save_credentials(const char *ssid, const char *password)
         return ESP_ERR_INVALID_ARG;
     }
 
-    nvs_handle_t nvs;
-    esp_err_t err = nvs_open(WIFI_CREDS_NAMESPACE, NVS_READWRITE, &nvs);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS for writing credentials");
-        return err;
-    }
-
-    err = nvs_set_str(nvs, WIFI_CREDS_SSID_KEY, ssid);
+    // In RAM now, in NVS once the config store flushes
+    esp_err_t err = config_store_set_str(WIFI_CREDS_NAMESPACE, WIFI_CREDS_SSID_KEY, ssid);
     if (err == ESP_OK && password) {
-        err = nvs_set_str(nvs, WIFI_CREDS_PASS_KEY, password);
+        err = config_store_set_str(WIFI_CREDS_NAMESPACE, WIFI_CREDS_PASS_KEY, password);
     }
-    
-    if (err == ESP_OK) {
-        err = nvs_commit(nvs);
-    }
-    
-    nvs_close(nvs);
 
     if (err == ESP_OK) {
         ESP_LOGI(TAG, "Saved WiFi credentials for SSID: %s", ssid);
@@ -268,16 +345,9 @@ esp_err_t wifi_manager_save_credentials(const char *ssid, const char *password)
 }
 
 esp_err_t wifi_manager_clear_credentials(void) {
-    nvs_handle_t nvs;
-    esp_err_t err = nvs_open(WIFI_CREDS_NAMESPACE, NVS_READWRITE, &nvs);
-    if (err != ESP_OK) {
-        return err;
-    }
-
-    nvs_erase_key(nvs, WIFI_CREDS_SSID_KEY);
-    nvs_erase_key(nvs, WIFI_CREDS_PASS_KEY);
-    err = nvs_commit(nvs);
-    nvs_close(nvs);
+    esp_err_t err = config_store_erase_key(WIFI_CREDS_NAMESPACE, WIFI_CREDS_SSID_KEY);
+    config_store_erase_key(WIFI_CREDS_NAMESPACE, WIFI_CREDS_PASS_KEY);
+    config_store_erase_key(WIFI_CREDS_NAMESPACE, WIFI_CREDS_AP_KEY);
 
     ESP_LOGI(TAG, "Cleared WiFi credentials");
     return err;
@@ -351,20 +421,294 @@ esp_err_t wifi_manager_auto_connect(void) {
 
 // Internal helper functions
 static esp_err_t wifi_manager_init_nvs(void) {
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
+    return config_store_init();     // The Wi-Fi driver keeps its calibration and config in NVS too
+}
+
+// FNV-1a over the SSID and password: tells whether a cached PMK still matches
+static uint32_t wifi_manager_cache_key(const char *ssid, const char *password) {
+    uint32_t hash = 2166136261u;
+    for (const char *s = ssid; *s; s++) {
+        hash = (hash ^ (uint8_t)*s) * 16777619u;
+    }
+    hash = (hash ^ 0xff) * 16777619u;
+    for (const char *s = password; *s; s++) {
+        hash = (hash ^ (uint8_t)*s) * 16777619u;
+    }
+    return hash;
+}
+
+static bool wifi_manager_load_ap_cache(wifi_ap_cache_t *cache) {
+    size_t size = sizeof(*cache);
+    esp_err_t err = config_store_get_blob(WIFI_CREDS_NAMESPACE, WIFI_CREDS_AP_KEY, cache, &size);
+    return err == ESP_OK && size == sizeof(*cache) && cache->version == WIFI_AP_CACHE_VERSION;
+}
+
+static void wifi_manager_clear_ap_cache(void) {
+    config_store_erase_key(WIFI_CREDS_NAMESPACE, WIFI_CREDS_AP_KEY);
+}
+
+/**
+ * Sets the station config for g_wifi_state.ssid/password. With use_cache and
+ * a cached AP for that SSID, the connect goes straight to its BSSID on its
+ * channel (a one-channel probe instead of the full scan), and with a PMK that
+ * matches the password, the PSK is given as 64 hex digits. A bssid given
+ * (a roam target) is joined instead of the cached one, still with its PMK.
+ */
+static esp_err_t wifi_manager_apply_config(bool use_cache, const uint8_t *bssid, uint8_t channel) {
+    wifi_config_t wifi_config = {0};
+    memcpy(wifi_config.sta.ssid, g_wifi_state.ssid, sizeof(wifi_config.sta.ssid));
+    strncpy((char *)wifi_config.sta.password, g_wifi_state.password, sizeof(wifi_config.sta.password));
+    wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+#if defined(CONFIG_WIFI_ROAMING) && defined(CONFIG_ESP_WIFI_11KV_SUPPORT)
+    // Advertise 11k/11v in the association request, so the AP answers our queries
+    wifi_config.sta.rm_enabled = 1;
+    wifi_config.sta.btm_enabled = 1;
+#endif
+
+    g_wifi_state.fast_attempt = false;
+#ifdef CONFIG_WIFI_FAST_RECONNECT
+    wifi_ap_cache_t cache;
+    if ((use_cache || bssid) && wifi_manager_load_ap_cache(&cache) && strcmp(cache.ssid, g_wifi_state.ssid) == 0) {
+        if (!bssid) {
+            wifi_config.sta.bssid_set = true;
+            memcpy(wifi_config.sta.bssid, cache.bssid, sizeof(cache.bssid));
+            wifi_config.sta.channel = cache.channel;
+            g_wifi_state.fast_attempt = true;
+            ESP_LOGI(TAG, "Fast connect to " MACSTR " on channel %d%s", MAC2STR(cache.bssid), cache.channel,
+                     cache.has_pmk ? " with cached PMK" : "");
+        }
+        if (cache.has_pmk && cache.key == wifi_manager_cache_key(g_wifi_state.ssid, g_wifi_state.password)) {
+            static const char hex[] = "0123456789abcdef";
+            for (size_t i = 0; i < sizeof(cache.pmk); i++) {
+                wifi_config.sta.password[2 * i] = hex[cache.pmk[i] >> 4];
+                wifi_config.sta.password[2 * i + 1] = hex[cache.pmk[i] & 0x0f];
+            }
+        }
     }
-    return ret;
+#endif
+    if (bssid) {
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, bssid, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.channel = channel;
+    }
+
+    return esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
 }
 
+// Called on every got-IP; changes the stored copy only when the AP or the password changed
+static void wifi_manager_update_ap_cache(const wifi_ap_record_t *ap) {
+#ifdef CONFIG_WIFI_FAST_RECONNECT
+    wifi_ap_cache_t old;
+    bool have_old = wifi_manager_load_ap_cache(&old);
+    uint32_t key = wifi_manager_cache_key(g_wifi_state.ssid, g_wifi_state.password);
+    bool psk = (ap->authmode == WIFI_AUTH_WPA_PSK || ap->authmode == WIFI_AUTH_WPA2_PSK ||
+                ap->authmode == WIFI_AUTH_WPA_WPA2_PSK) && strlen(g_wifi_state.password) >= 8 &&
+               strlen(g_wifi_state.password) < 64;
+
+    wifi_ap_cache_t cache = {
+        .version = WIFI_AP_CACHE_VERSION,
+        .channel = ap->primary,
+        .key = key,
+    };
+    memcpy(cache.bssid, ap->bssid, sizeof(cache.bssid));
+    memcpy(cache.ssid, g_wifi_state.ssid, sizeof(cache.ssid));
+
+    if (have_old && old.key == key && strcmp(old.ssid, cache.ssid) == 0 && old.has_pmk == psk) {
+        if (old.channel == cache.channel && memcmp(old.bssid, cache.bssid, sizeof(cache.bssid)) == 0) {
+            return;
+        }
+        memcpy(cache.pmk, old.pmk, sizeof(cache.pmk));
+        cache.has_pmk = old.has_pmk;
+    } else if (psk) {
+        // Once per network: the same derivation the supplicant does on every connect
+        if (mbedtls_pkcs5_pbkdf2_hmac_ext(MBEDTLS_MD_SHA1,
+                (const unsigned char *)g_wifi_state.password, strlen(g_wifi_state.password),
+                (const unsigned char *)g_wifi_state.ssid, strlen(g_wifi_state.ssid),
+                4096, sizeof(cache.pmk), cache.pmk) == 0) {
+            cache.has_pmk = true;
+        }
+    }
+
+    if (config_store_set_blob(WIFI_CREDS_NAMESPACE, WIFI_CREDS_AP_KEY, &cache, sizeof(cache)) == ESP_OK) {
+        ESP_LOGI(TAG, "Cached AP " MACSTR " on channel %d", MAC2STR(cache.bssid), cache.channel);
+    }
+#endif
+}
+
+// From project configuration instead of DHCP; set once associated, as DHCP would be
+static void wifi_manager_set_static_ip(void) {
+#ifdef CONFIG_WIFI_STATIC_IP
+    esp_netif_ip_info_t ip_info = {0};
+    ip_info.ip.addr = esp_ip4addr_aton(CONFIG_WIFI_STATIC_IP_ADDR);
+    ip_info.netmask.addr = esp_ip4addr_aton(CONFIG_WIFI_STATIC_NETMASK);
+    ip_info.gw.addr = esp_ip4addr_aton(CONFIG_WIFI_STATIC_GATEWAY);
+
+    esp_netif_dhcpc_stop(g_wifi_state.netif);
+    if (esp_netif_set_ip_info(g_wifi_state.netif, &ip_info) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set static IP %s", CONFIG_WIFI_STATIC_IP_ADDR);
+        return;
+    }
+
+    esp_netif_dns_info_t dns = {0};
+    dns.ip.type = ESP_IPADDR_TYPE_V4;
+    dns.ip.u_addr.ip4.addr = esp_ip4addr_aton(CONFIG_WIFI_STATIC_DNS);
+    esp_netif_set_dns_info(g_wifi_state.netif, ESP_NETIF_DNS_MAIN, &dns);
+    ESP_LOGI(TAG, "Static IP %s", CONFIG_WIFI_STATIC_IP_ADDR);
+#endif
+}
+
+#ifdef CONFIG_WIFI_ROAMING
+static void wifi_manager_roam_timer_cb(void *arg) {
+    esp_event_post(WIFI_MANAGER_EVENT, WIFI_MANAGER_EVENT_ROAM_TIMER, NULL, 0, 0);
+}
+
+// Back to watching the signal: the RSSI threshold is re-armed now, or when backoff_ms is up
+static void wifi_manager_roam_end(uint32_t backoff_ms) {
+    g_wifi_state.roam_state = WIFI_ROAM_IDLE;
+    esp_timer_stop(g_wifi_state.roam_timer);
+    if (backoff_ms) {
+        esp_timer_start_once(g_wifi_state.roam_timer, (uint64_t)backoff_ms * 1000);
+    } else {
+        esp_wifi_set_rssi_threshold(CONFIG_WIFI_ROAM_RSSI_THRESHOLD);
+    }
+}
+
+static void wifi_manager_roam_start(const char *why, bool frames_lost) {
+    TickType_t now = xTaskGetTickCount();
+    if (g_wifi_state.roam_state != WIFI_ROAM_IDLE || !g_wifi_state.connected ||
+        (g_wifi_state.roam_started && now - g_wifi_state.roam_started < pdMS_TO_TICKS(WIFI_ROAM_BACKOFF_MS))) {
+        return;
+    }
+
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return;
+    }
+    memcpy(g_wifi_state.roam_bssid, ap.bssid, sizeof(g_wifi_state.roam_bssid));
+    g_wifi_state.roam_channel = ap.primary;
+    g_wifi_state.roam_rssi = ap.rssi;
+    g_wifi_state.roam_started = now;
+    g_wifi_state.connection_info.rssi = ap.rssi;
+    ESP_LOGI(TAG, "%s: %d dBm from " MACSTR ", looking for a better AP", why, ap.rssi, MAC2STR(ap.bssid));
+
+    esp_timer_stop(g_wifi_state.roam_timer);
+#ifdef CONFIG_ESP_WIFI_11KV_SUPPORT
+    // An AP that knows its neighbours' load may steer us; the supplicant then roams on its own
+    if (esp_wnm_is_btm_supported_connection() &&
+        esp_wnm_send_bss_transition_mgmt_query(frames_lost ? REASON_FRAME_LOSS : REASON_RSSI, NULL, 0) == 0) {
+        g_wifi_state.roam_state = WIFI_ROAM_STEERING;
+        esp_timer_start_once(g_wifi_state.roam_timer, WIFI_ROAM_STEER_WAIT_MS * 1000ULL);
+        return;
+    }
+#else
+    (void)frames_lost;
+#endif
+    wifi_manager_roam_survey();
+}
+
+// Neighbour report first if the AP keeps one, so only its neighbours' channels are scanned
+static void wifi_manager_roam_survey(void) {
+#ifdef CONFIG_ESP_WIFI_11KV_SUPPORT
+    if (esp_rrm_is_rrm_supported_connection() && esp_rrm_send_neighbor_report_request() == 0) {
+        g_wifi_state.roam_state = WIFI_ROAM_NEIGHBORS;
+        esp_timer_start_once(g_wifi_state.roam_timer, WIFI_ROAM_STEER_WAIT_MS * 1000ULL);
+        return;
+    }
+#endif
+    wifi_manager_roam_scan(0);
+}
+
+#ifdef CONFIG_ESP_WIFI_11KV_SUPPORT
+// 2.4 GHz channel bitmap of the Neighbor Report elements (BSSID, info, class, channel, PHY)
+static uint16_t wifi_manager_neighbor_channels(const uint8_t *report, size_t length) {
+    uint16_t channels = 0;
+    while (length >= 2 && report[1] + 2u <= length) {
+        uint8_t element_length = report[1];
+        if (report[0] == WIFI_EID_NEIGHBOR_REPORT && element_length >= 13) {
+            uint8_t channel = report[2 + 11];
+            if (channel >= 1 && channel <= 14) {
+                channels |= 1u << channel;
+            }
+        }
+        report += 2 + element_length;
+        length -= 2 + element_length;
+    }
+    return channels;
+}
+#endif
+
+// Our SSID only, on the given channels (all with none), short dwells between beacons home.
+static void wifi_manager_roam_scan(uint16_t channels) {
+    wifi_scan_config_t scan_config = {
+        .ssid = (uint8_t *)g_wifi_state.ssid,
+        .show_hidden = false,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+        .scan_time.active = { .min = 0, .max = WIFI_ROAM_SCAN_ACTIVE_MS },
+    };
+    scan_config.channel_bitmap.ghz_2_channels = channels;
+
+    g_wifi_state.roam_state = WIFI_ROAM_SCANNING;
+    esp_err_t err = esp_wifi_scan_start(&scan_config, false);
+    if (err != ESP_OK) {
+        // Most likely a scan from the GUI running; try again later
+        ESP_LOGW(TAG, "Roam scan not started: %s", esp_err_to_name(err));
+        wifi_manager_roam_end(WIFI_ROAM_BACKOFF_MS);
+        return;
+    }
+    ESP_LOGI(TAG, "Scanning %s for %s", channels ? "neighbour channels" : "all channels", g_wifi_state.ssid);
+}
+
+static void wifi_manager_roam_scan_done(void) {
+    uint16_t count = 0;
+    esp_wifi_scan_get_ap_num(&count);
+    wifi_ap_record_t *records = count ? malloc(sizeof(wifi_ap_record_t) * count) : NULL;
+    if (!records) {
+        esp_wifi_clear_ap_list();
+        count = 0;
+    } else if (esp_wifi_scan_get_ap_records(&count, records) != ESP_OK) {
+        count = 0;
+    }
+
+    const wifi_ap_record_t *best = NULL;
+    for (uint16_t i = 0; i < count; i++) {
+        if (memcmp(records[i].bssid, g_wifi_state.roam_bssid, sizeof(g_wifi_state.roam_bssid)) == 0) {
+            g_wifi_state.roam_rssi = records[i].rssi;   // Fresher than when the roam started
+        } else if (!best || records[i].rssi > best->rssi) {
+            best = &records[i];
+        }
+    }
+
+    if (best && best->rssi >= g_wifi_state.roam_rssi + CONFIG_WIFI_ROAM_MIN_GAIN) {
+        ESP_LOGI(TAG, "Roaming to " MACSTR " on channel %d: %d dBm against %d dBm", MAC2STR(best->bssid),
+                 best->primary, best->rssi, g_wifi_state.roam_rssi);
+        memcpy(g_wifi_state.roam_bssid, best->bssid, sizeof(g_wifi_state.roam_bssid));
+        g_wifi_state.roam_channel = best->primary;
+        g_wifi_state.roam_state = WIFI_ROAM_LEAVING;
+        if (wifi_manager_apply_config(false, g_wifi_state.roam_bssid, g_wifi_state.roam_channel) != ESP_OK ||
+            esp_wifi_disconnect() != ESP_OK) {
+            wifi_manager_roam_end(WIFI_ROAM_BACKOFF_MS);
+        }
+    } else {
+        ESP_LOGI(TAG, "No AP for %s at least %d dB above %d dBm, staying", g_wifi_state.ssid,
+                 CONFIG_WIFI_ROAM_MIN_GAIN, g_wifi_state.roam_rssi);
+        wifi_manager_roam_end(WIFI_ROAM_BACKOFF_MS);
+    }
+    free(records);
+}
+#endif
+
 static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
     ESP_LOGI(TAG, "WiFi event: base=%s, id=%d", event_base, event_id);
 
     if (event_base == WIFI_EVENT) {
         switch (event_id) {
             case WIFI_EVENT_SCAN_DONE: {
+#ifdef CONFIG_WIFI_ROAMING
+                if (g_wifi_state.roam_state == WIFI_ROAM_SCANNING) {
+                    wifi_manager_roam_scan_done();     // Not the GUI's scan
+                    break;
+                }
+#endif
                 uint16_t ap_count = 0;
                 esp_wifi_scan_get_ap_num(&ap_count);
 
@@ -396,6 +740,7 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
                 // Update connection info
                 strncpy(g_wifi_state.connection_info.ssid, (char *)event->ssid, sizeof(g_wifi_state.connection_info.ssid) - 1);
                 g_wifi_state.connection_info.connected = true;
+                wifi_manager_set_static_ip();
                 break;
             }
 
@@ -403,6 +748,40 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
                 wifi_event_sta_disconnected_t *event = (wifi_event_sta_disconnected_t *)event_data;
                 ESP_LOGI(TAG, "Disconnected from WiFi network, reason: %d", event->reason);
 
+#ifdef CONFIG_WIFI_ROAMING
+                // A roam keeps the connection (and the netif its address) up for everyone else
+                if (g_wifi_state.roam_state == WIFI_ROAM_LEAVING) {
+                    g_wifi_state.roam_state = WIFI_ROAM_JOINING;
+                    if (esp_wifi_connect() == ESP_OK) {
+                        break;
+                    }
+                } else if (event->reason == WIFI_REASON_ROAMING) {
+                    // The supplicant acting on a BTM request; it joins the AP's pick itself
+                    ESP_LOGI(TAG, "Steered away from " MACSTR, MAC2STR(g_wifi_state.roam_bssid));
+                    g_wifi_state.roam_state = WIFI_ROAM_JOINING;
+                    break;
+                } else if (g_wifi_state.roam_state == WIFI_ROAM_JOINING) {
+                    // The new AP did not take us: back to the one we left, as a fast connect
+                    ESP_LOGW(TAG, "Roam failed, back to the last AP");
+                    wifi_manager_roam_end(WIFI_ROAM_BACKOFF_MS);
+                    if (wifi_manager_apply_config(true, NULL, 0) == ESP_OK && esp_wifi_connect() == ESP_OK) {
+                        break;
+                    }
+                }
+                if (g_wifi_state.roam_state != WIFI_ROAM_IDLE) {
+                    wifi_manager_roam_end(WIFI_ROAM_BACKOFF_MS);
+                }
+#endif
+
+                // The cached AP moved or its PMK is stale: scan for the network right away
+                if (g_wifi_state.fast_attempt && event->reason != WIFI_REASON_ASSOC_LEAVE) {
+                    ESP_LOGW(TAG, "Fast connect failed, scanning for %s", g_wifi_state.ssid);
+                    wifi_manager_clear_ap_cache();
+                    if (wifi_manager_apply_config(false, NULL, 0) == ESP_OK && esp_wifi_connect() == ESP_OK) {
+                        break;
+                    }
+                }
+
                 // Update connection info
                 memset(&g_wifi_state.connection_info, 0, sizeof(g_wifi_state.connection_info));
                 g_wifi_state.connected = false;
@@ -436,9 +815,40 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
                 break;
             }
 
+#ifdef CONFIG_WIFI_ROAMING
+            case WIFI_EVENT_STA_BSS_RSSI_LOW:
+                wifi_manager_roam_start("Weak signal", false);
+                break;
+
+            case WIFI_EVENT_STA_BEACON_TIMEOUT:
+                wifi_manager_roam_start("Beacons lost", true);
+                break;
+
+#ifdef CONFIG_ESP_WIFI_11KV_SUPPORT
+            case WIFI_EVENT_STA_NEIGHBOR_REP: {
+                wifi_event_neighbor_report_t *event = (wifi_event_neighbor_report_t *)event_data;
+                if (g_wifi_state.roam_state == WIFI_ROAM_NEIGHBORS) {
+                    esp_timer_stop(g_wifi_state.roam_timer);
+                    wifi_manager_roam_scan(wifi_manager_neighbor_channels(event->report, event->report_len));
+                }
+                break;
+            }
+#endif
+#endif
+
             default:
                 break;
         }
+#ifdef CONFIG_WIFI_ROAMING
+    } else if (event_base == WIFI_MANAGER_EVENT && event_id == WIFI_MANAGER_EVENT_ROAM_TIMER) {
+        if (g_wifi_state.roam_state == WIFI_ROAM_STEERING) {
+            wifi_manager_roam_survey();             // The AP did not steer us
+        } else if (g_wifi_state.roam_state == WIFI_ROAM_NEIGHBORS) {
+            wifi_manager_roam_scan(0);              // No neighbour report
+        } else if (g_wifi_state.roam_state == WIFI_ROAM_IDLE && g_wifi_state.connected) {
+            esp_wifi_set_rssi_threshold(CONFIG_WIFI_ROAM_RSSI_THRESHOLD);   // Backoff over
+        }
+#endif
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
 
@@ -451,10 +861,22 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
         g_wifi_state.reconnect_attempts = 0;  // Reset reconnect attempts on successful connection
 
         // Get RSSI
+        g_wifi_state.fast_attempt = false;
+
         wifi_ap_record_t ap_info;
         if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
             g_wifi_state.connection_info.rssi = ap_info.rssi;
+            wifi_manager_update_ap_cache(&ap_info);
+#ifdef CONFIG_WIFI_ROAMING
+            if (g_wifi_state.roam_state == WIFI_ROAM_JOINING) {
+                ESP_LOGI(TAG, "Roamed to " MACSTR " on channel %d, %d dBm", MAC2STR(ap_info.bssid),
+                         ap_info.primary, ap_info.rssi);
+            }
+#endif
         }
+#ifdef CONFIG_WIFI_ROAMING
+        wifi_manager_roam_end(0);
+#endif
 
         ESP_LOGI(TAG, "Got IP address: %s", g_wifi_state.connection_info.ip_address);
 
@@ -26,6 +26,7 @@ extern "C" {
 #define WIFI_CREDS_NAMESPACE "wifi_creds"
 #define WIFI_CREDS_SSID_KEY "ssid"
 #define WIFI_CREDS_PASS_KEY "pass"
+#define WIFI_CREDS_AP_KEY "ap"          // BSSID, channel and PMK of the last AP joined
 
 // WiFi connection status callback
 typedef void (*wifi_status_callback_t)(const char *ssid, const char *ip, bool connected);
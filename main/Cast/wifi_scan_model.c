@@ -0,0 +1,70 @@
+#include "wifi_scan_model.h"
+#include <string.h>
+
+void wifi_scan_model_build(wifi_scan_model_t *model, const wifi_ap_record_t *aps, uint16_t ap_count) {
+    model->count = 0;
+
+    for (uint16_t i = 0; i < ap_count; i++) {
+        const wifi_ap_record_t *ap = &aps[i];
+        if (ap->ssid[0] == '\0') {
+            continue;
+        }
+
+        // Dedup by SSID, keeping the strongest BSSID
+        wifi_scan_entry_t *entry = NULL;
+        for (uint16_t j = 0; j < model->count; j++) {
+            if (strncmp(model->entries[j].ssid, (const char *)ap->ssid, sizeof(model->entries[j].ssid)) == 0) {
+                entry = &model->entries[j];
+                break;
+            }
+        }
+        if (entry) {
+            if (ap->rssi <= entry->rssi) {
+                continue;
+            }
+        } else if (model->count < WIFI_SCAN_MODEL_MAX_NETWORKS) {
+            entry = &model->entries[model->count++];
+            memset(entry, 0, sizeof(*entry));
+            memcpy(entry->ssid, ap->ssid, sizeof(entry->ssid) - 1);
+        } else {
+            // Full: replace the weakest if this one is stronger
+            entry = &model->entries[0];
+            for (uint16_t j = 1; j < model->count; j++) {
+                if (model->entries[j].rssi < entry->rssi) {
+                    entry = &model->entries[j];
+                }
+            }
+            if (ap->rssi <= entry->rssi) {
+                continue;
+            }
+            memset(entry, 0, sizeof(*entry));
+            memcpy(entry->ssid, ap->ssid, sizeof(entry->ssid) - 1);
+        }
+        entry->rssi = ap->rssi;
+        entry->channel = ap->primary;
+        entry->authmode = ap->authmode;
+    }
+
+    // Insertion sort, strongest first; ties keep scan order
+    for (uint16_t i = 1; i < model->count; i++) {
+        wifi_scan_entry_t entry = model->entries[i];
+        uint16_t j = i;
+        while (j > 0 && model->entries[j - 1].rssi < entry.rssi) {
+            model->entries[j] = model->entries[j - 1];
+            j--;
+        }
+        model->entries[j] = entry;
+    }
+}
+
+int8_t wifi_scan_model_display_rssi(int8_t rssi) {
+    // RSSI is negative; round half away from zero
+    int value = rssi - WIFI_SCAN_MODEL_RSSI_STEP / 2;
+    return (int8_t)(value / WIFI_SCAN_MODEL_RSSI_STEP * WIFI_SCAN_MODEL_RSSI_STEP);
+}
+
+bool wifi_scan_entry_same_row(const wifi_scan_entry_t *a, const wifi_scan_entry_t *b) {
+    return strcmp(a->ssid, b->ssid) == 0 &&
+           wifi_scan_model_display_rssi(a->rssi) == wifi_scan_model_display_rssi(b->rssi) &&
+           (a->authmode == WIFI_AUTH_OPEN) == (b->authmode == WIFI_AUTH_OPEN);
+}
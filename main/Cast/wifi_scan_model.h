@@ -0,0 +1,56 @@
+#pragma once
+
+#include "esp_wifi_types.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief WiFi scan model - the network list as the GUI shows it
+ *
+ * A scan reports one record per BSSID, so a mesh or a dual-band router
+ * shows up several times. The model keeps one entry per SSID (its
+ * strongest BSSID), drops hidden networks, and sorts by RSSI, strongest
+ * first. Plain data: build it on any task and hand it to the LVGL thread.
+ */
+
+#define WIFI_SCAN_MODEL_MAX_NETWORKS    20
+#define WIFI_SCAN_MODEL_RSSI_STEP       5       // dB; finer changes do not relabel a row
+
+typedef struct {
+    char ssid[33];
+    int8_t rssi;
+    uint8_t channel;
+    wifi_auth_mode_t authmode;
+} wifi_scan_entry_t;
+
+typedef struct {
+    uint16_t count;
+    wifi_scan_entry_t entries[WIFI_SCAN_MODEL_MAX_NETWORKS];
+} wifi_scan_model_t;
+
+/**
+ * @brief Fill the model from raw scan records
+ *
+ * @param model Model to overwrite
+ * @param aps Scan records (may be NULL when ap_count is 0)
+ * @param ap_count Number of records
+ */
+void wifi_scan_model_build(wifi_scan_model_t *model, const wifi_ap_record_t *aps, uint16_t ap_count);
+
+/**
+ * @brief RSSI rounded to WIFI_SCAN_MODEL_RSSI_STEP, as shown in the list
+ */
+int8_t wifi_scan_model_display_rssi(int8_t rssi);
+
+/**
+ * @brief Whether two entries would draw the same row
+ */
+bool wifi_scan_entry_same_row(const wifi_scan_entry_t *a, const wifi_scan_entry_t *b);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,82 +1,179 @@
 #include "TCA9554PWR.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+
+static const char *TAG_EXIO = "EXIO";
+
+#if defined(CONFIG_TCA9554_INT_GPIO) && CONFIG_TCA9554_INT_GPIO >= 0
+#define TCA9554_USE_INT             1
+#else
+#define TCA9554_USE_INT             0
+#endif
+
+/*
+ * The output and configuration registers only change when written, so they
+ * are kept here and a pin change is one write instead of a read and a write.
+ * A failed write leaves the chip's value unknown: the next change reads it
+ * back first. The lock keeps concurrent changes in order, so the last write
+ * wins with every pin it did not touch intact.
+ */
+static uint8_t output_shadow;
+static bool output_valid = false;
+static uint8_t config_shadow;
+static bool config_valid = false;
+static uint8_t input_shadow;
+static volatile bool input_stale = true;   // Set by the INT line; always true without one
+static SemaphoreHandle_t exio_lock = NULL;
+static StaticSemaphore_t exio_lock_buffer;
+static TaskHandle_t input_notify_task = NULL;
+
 /*****************************************************  Operation register REG   ****************************************************/   
 uint8_t Read_REG(uint8_t REG)                                // Read the value of the TCA9554PWR register REG
 {
     uint8_t bitsStatus = 0;                                                             
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();     
-    i2c_master_start(cmd);                                                             
-    i2c_master_write_byte(cmd, (TCA9554_ADDRESS << 1) | I2C_MASTER_WRITE, true); 
-    i2c_master_write_byte(cmd, REG, true);                                
-    i2c_master_start(cmd);       
-    i2c_master_write_byte(cmd, (TCA9554_ADDRESS << 1) | I2C_MASTER_READ, true); 
-    i2c_master_read_byte(cmd, &bitsStatus, I2C_MASTER_NACK);
-    i2c_master_stop(cmd);                             
-    i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS); 
-    i2c_cmd_link_delete(cmd);                                                          
+    I2C_Read(TCA9554_ADDRESS, REG, &bitsStatus, 1);
     return bitsStatus;                                                                
 }
 void Write_REG(uint8_t REG,uint8_t Data)                    // Write Data to the REG register of the TCA9554PWR
 {
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();           
-    i2c_master_start(cmd);                                             
-    i2c_master_write_byte(cmd, (TCA9554_ADDRESS << 1) | I2C_MASTER_WRITE, true);    
-    i2c_master_write_byte(cmd, REG, true);                                           
-    i2c_master_write_byte(cmd, Data, true);  
-    i2c_master_stop(cmd);     
-    i2c_master_cmd_begin(I2C_MASTER_NUM,cmd,I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);                                                           
+    I2C_Write(TCA9554_ADDRESS, REG, &Data, 1);
+    // Keep the shadows true to the chip for callers that bypass them
+    if (REG == TCA9554_OUTPUT_REG) {
+        output_valid = false;
+    } else if (REG == TCA9554_CONFIG_REG) {
+        config_valid = false;
+    }
+}
+
+static void EXIO_Lock(void)
+{
+    if (exio_lock) {
+        xSemaphoreTake(exio_lock, portMAX_DELAY);
+    }
+}
+static void EXIO_Unlock(void)
+{
+    if (exio_lock) {
+        xSemaphoreGive(exio_lock);
+    }
+}
+
+// Clear, set, then toggle bits of a shadowed register, in one write and only if it changes
+static void EXIO_Update(uint8_t REG, uint8_t *shadow, bool *valid, uint8_t clear, uint8_t set, uint8_t toggle)
+{
+    EXIO_Lock();
+    if (!*valid) {
+        if (I2C_Read(TCA9554_ADDRESS, REG, shadow, 1) != ESP_OK) {
+            ESP_LOGW(TAG_EXIO, "Register 0x%02x read failed, not changed", REG);
+            EXIO_Unlock();
+            return;
+        }
+        *valid = true;
+    }
+    uint8_t Data = ((*shadow & ~clear) | set) ^ toggle;
+    if (Data != *shadow) {
+        if (I2C_Write(TCA9554_ADDRESS, REG, &Data, 1) == ESP_OK) {
+            *shadow = Data;
+        } else {
+            ESP_LOGW(TAG_EXIO, "Register 0x%02x write failed", REG);
+            *valid = false;
+        }
+    }
+    EXIO_Unlock();
+}
+
+static bool EXIO_Pin_Valid(uint8_t Pin)
+{
+    if (Pin < 9 && Pin > 0) {
+        return true;
+    }
+    printf("Parameter error, please enter the correct parameter!\r\n");
+    return false;
 }
 /********************************************************** Set EXIO mode **********************************************************/       
 void Mode_EXIO(uint8_t Pin,uint8_t State)                 // Set the mode of the TCA9554PWR Pin. The default is Output mode (output mode or input mode). State: 0= Output mode 1= input mode    
 {
-    uint8_t bitsStatus = Read_REG(TCA9554_CONFIG_REG);                                
-    uint8_t Data = (0x01 << (Pin-1)) | bitsStatus;  
-    Write_REG(TCA9554_CONFIG_REG,Data);            
+    if (!EXIO_Pin_Valid(Pin)) {
+        return;
+    }
+    uint8_t bit = 0x01 << (Pin-1);
+    EXIO_Update(TCA9554_CONFIG_REG, &config_shadow, &config_valid, bit, State ? bit : 0, 0);
 }
 void Mode_EXIOS(uint8_t PinState)                        // Set the mode of the 7 pins from the TCA9554PWR with PinState   
 {
-    Write_REG(TCA9554_CONFIG_REG,PinState);                             
+    EXIO_Update(TCA9554_CONFIG_REG, &config_shadow, &config_valid, 0xFF, PinState, 0);
 }
 
 /********************************************************** Read EXIO status **********************************************************/       
 uint8_t Read_EXIO(uint8_t Pin)                            // Read the level of the TCA9554PWR Pin
 {
-    uint8_t inputBits =Read_REG(TCA9554_INPUT_REG);                                  
+    uint8_t inputBits = Read_EXIOS();
     uint8_t bitStatus = (inputBits >> (Pin-1)) & 0x01;                             
     return bitStatus;                                                              
 }
 uint8_t Read_EXIOS(void)                                  // Read the level of all pins of TCA9554PWR
 {
-  uint8_t inputBits = Read_REG(TCA9554_INPUT_REG);                                     
-  return inputBits;                                                                    
+    // With the INT line the register is read only after an input changed;
+    // reading it is also what releases INT
+    if (input_stale) {
+        EXIO_Lock();
+        if (input_stale) {
+            input_stale = !TCA9554_USE_INT;     // Before the read: an edge during it stays noticed
+            if (I2C_Read(TCA9554_ADDRESS, TCA9554_INPUT_REG, &input_shadow, 1) != ESP_OK) {
+                input_stale = true;
+            }
+        }
+        EXIO_Unlock();
+    }
+    return input_shadow;
 }
 
 /********************************************************** Set the EXIO output status **********************************************************/  
 void Set_EXIO(uint8_t Pin,bool State)                  // Sets the level state of the Pin without affecting the other pins(PIN：1~8)
 {
-    uint8_t Data = 0;
-    uint8_t bitsStatus = Read_REG(TCA9554_OUTPUT_REG);         
-    if(Pin < 9 && Pin > 0){     
-        if(State)                                     
-            Data = (0x01 << (Pin-1)) | bitsStatus;                 
-        else
-            Data = (~(0x01 << (Pin-1)) & bitsStatus);  
-        Write_REG(TCA9554_OUTPUT_REG,Data);
+    if (!EXIO_Pin_Valid(Pin)) {
+        return;
     }
-    else                                                                             
-        printf("Parameter error, please enter the correct parameter!\r\n");
-
+    uint8_t bit = 0x01 << (Pin-1);
+    EXIO_Update(TCA9554_OUTPUT_REG, &output_shadow, &output_valid, bit, State ? bit : 0, 0);
 }
 void Set_EXIOS(uint8_t PinState)                     // Set 7 pins to the PinState state such as :PinState=0x23, 0010 0011 state (the highest bit is not used)
 {
-    Write_REG(TCA9554_OUTPUT_REG,PinState);                                            
+    EXIO_Update(TCA9554_OUTPUT_REG, &output_shadow, &output_valid, 0xFF, PinState, 0);
+}
+void Set_EXIOS_Masked(uint8_t Mask,uint8_t PinState)   // Set the pins in Mask to their bits of PinState together, in one write
+{
+    EXIO_Update(TCA9554_OUTPUT_REG, &output_shadow, &output_valid, Mask, PinState & Mask, 0);
 }
 
 /********************************************************** Flip EXIO state **********************************************************/  
 void Set_Toggle(uint8_t Pin)                              // Flip the level of the TCA9554PWR Pin
 {
-    uint8_t bitsStatus = Read_EXIO(Pin);                                              
-    Set_EXIO(Pin,(bool)!bitsStatus);
+    if (!EXIO_Pin_Valid(Pin)) {
+        return;
+    }
+    EXIO_Update(TCA9554_OUTPUT_REG, &output_shadow, &output_valid, 0, 0, 0x01 << (Pin-1));
+}
+
+/********************************************************** Input change notification **********************************************************/  
+#if TCA9554_USE_INT
+static void IRAM_ATTR EXIO_ISR_Handler(void *arg)
+{
+    input_stale = true;
+    TaskHandle_t task = input_notify_task;
+    if (task) {
+        BaseType_t task_woken = pdFALSE;
+        vTaskNotifyGiveFromISR(task, &task_woken);
+        if (task_woken) {
+            portYIELD_FROM_ISR();
+        }
+    }
+}
+#endif
+
+void EXIO_Set_Notify_Task(TaskHandle_t task)
+{
+    input_notify_task = task;
 }
 
 
@@ -84,7 +181,31 @@ void Set_Toggle(uint8_t Pin)                              // Flip the level of t
 void TCA9554PWR_Init(uint8_t PinState)                  // Set the seven pins to PinState state, for example :PinState=0x23, 0010 0011 State (the highest bit is not used) (Output mode or input mode) 0= Output mode 1= Input mode. The default value is output mode
 {
     // i2c_master_init();                                                  
+    if (!exio_lock) {
+        exio_lock = xSemaphoreCreateMutexStatic(&exio_lock_buffer);
+    }
+    // Whatever the outputs hold now is kept: a reset line must not pulse at boot
+    output_valid = I2C_Read(TCA9554_ADDRESS, TCA9554_OUTPUT_REG, &output_shadow, 1) == ESP_OK;
     Mode_EXIOS(PinState);                                          
+
+#if TCA9554_USE_INT
+    // Open drain, low while an input differs from the last read of the input register
+    const gpio_config_t int_gpio_config = {
+        .pin_bit_mask = 1ULL << CONFIG_TCA9554_INT_GPIO,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&int_gpio_config));
+    esp_err_t ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {     // Already installed is fine
+        ESP_LOGE(TAG_EXIO, "Failed to install GPIO ISR service: %s", esp_err_to_name(ret));
+        return;
+    }
+    gpio_isr_handler_add(CONFIG_TCA9554_INT_GPIO, EXIO_ISR_Handler, NULL);
+    input_stale = true;
+    Read_EXIOS();                   // Releases INT, in case it was already low
+#endif
 }
 
 esp_err_t EXIO_Init(void)
@@ -2,7 +2,16 @@
 
 
 #include <stdio.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "I2C_Driver.h"
+
+/*
+ * The output and configuration registers are shadowed: setters write once,
+ * never read first. Inputs are read from the bus each time, or with
+ * CONFIG_TCA9554_INT_GPIO only after the INT line reported a change.
+ */
 #define TCA9554_EXIO1 0x01
 #define TCA9554_EXIO2 0x02
 #define TCA9554_EXIO3 0x03
@@ -36,9 +45,13 @@ uint8_t Read_EXIOS(void);                                   // Read the level of
 /********************************************************** Set the EXIO output status **********************************************************/  
 void Set_EXIO(uint8_t Pin,bool State);                   // Sets the level state of the Pin without affecting the other pins
 void Set_EXIOS(uint8_t PinState);                           // Set 7 pins to the PinState state such as :PinState=0x23, 0010 0011 state (the highest bit is not used)
+void Set_EXIOS_Masked(uint8_t Mask,uint8_t PinState);       // Set only the pins in Mask to their bits of PinState, all in one write
 /********************************************************** Flip EXIO state **********************************************************/  
 void Set_Toggle(uint8_t Pin);                               // Flip the level of the TCA9554PWR Pin
 /********************************************************* TCA9554PWR Initializes the device ***********************************************************/  
 void TCA9554PWR_Init(uint8_t PinState);                     // Set the seven pins to PinState state, for example :PinState=0x23, 0010 0011 State (the highest bit is not used) (Output mode or input mode) 0= Output mode 1= Input mode. The default value is output mode
 
+/********************************************************** Input change notification **********************************************************/  
+void EXIO_Set_Notify_Task(TaskHandle_t task);               // With CONFIG_TCA9554_INT_GPIO, input changes wake this task (xTaskNotifyGive)
+
 esp_err_t EXIO_Init(void);
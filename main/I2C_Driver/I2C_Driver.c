@@ -1,31 +1,35 @@
 #include "I2C_Driver.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
-
-#define I2C_TRANS_BUF_MINIMUM_SIZE     (sizeof(i2c_cmd_desc_t) + \
-                                        sizeof(i2c_cmd_link_t) * 8) /* It is required to have allocate one i2c_cmd_desc_t per command:
-                                                                     * start + write (device address) + write buffer +
-                                                                     * start + write (device address) + read buffer + read buffer for NACK +
-                                                                     * stop */
 static const char *I2C_TAG = "I2C";
+
+static i2c_master_bus_handle_t bus_handle = NULL;
+static SemaphoreHandle_t device_lock = NULL;          // Guards the device table only
+static struct {
+    uint8_t addr;
+    i2c_master_dev_handle_t handle;
+} devices[I2C_MAX_DEVICES];
+static int device_count = 0;
+
 /**
  * @brief i2c master initialization
  */
 static esp_err_t i2c_master_init(void)
 {
-    int i2c_master_port = I2C_MASTER_NUM;
-
-    i2c_config_t conf = {
-        .mode = I2C_MODE_MASTER,
+    const i2c_master_bus_config_t bus_config = {
+        .i2c_port = I2C_MASTER_NUM,
         .sda_io_num = I2C_SDA_IO,
         .scl_io_num = I2C_SCL_IO,
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_pullup_en = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = I2C_MASTER_FREQ_HZ,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = true,
     };
-
-    i2c_param_config(i2c_master_port, &conf);
-
-    return i2c_driver_install(i2c_master_port, conf.mode, I2C_MASTER_RX_BUF_DISABLE, I2C_MASTER_TX_BUF_DISABLE, 0);
+    device_lock = xSemaphoreCreateMutex();
+    if (!device_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    return i2c_new_master_bus(&bus_config, &bus_handle);
 }
 void I2C_Init(void)
 {
@@ -34,21 +38,83 @@ void I2C_Init(void)
     ESP_LOGI(I2C_TAG, "I2C initialized successfully");  
 }
 
+static i2c_master_dev_handle_t I2C_Get_Device(uint8_t Driver_addr)
+{
+    i2c_master_dev_handle_t handle = NULL;
+    if (!bus_handle) {
+        return NULL;
+    }
+    xSemaphoreTake(device_lock, portMAX_DELAY);
+    for (int i = 0; i < device_count; i++) {
+        if (devices[i].addr == Driver_addr) {
+            handle = devices[i].handle;
+            break;
+        }
+    }
+    if (!handle && device_count < I2C_MAX_DEVICES) {
+        const i2c_device_config_t dev_config = {
+            .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+            .device_address = Driver_addr,
+            .scl_speed_hz = I2C_MASTER_FREQ_HZ,
+        };
+        if (i2c_master_bus_add_device(bus_handle, &dev_config, &handle) == ESP_OK) {
+            devices[device_count].addr = Driver_addr;
+            devices[device_count].handle = handle;
+            device_count++;
+        } else {
+            handle = NULL;
+        }
+    }
+    xSemaphoreGive(device_lock);
+    if (!handle) {
+        ESP_LOGE(I2C_TAG, "No device handle for address 0x%02x", Driver_addr);
+    }
+    return handle;
+}
+
+static esp_err_t I2C_Write_Reg(uint8_t Driver_addr, const uint8_t *Reg_addr, uint32_t Addr_len, const uint8_t *Reg_data, uint32_t Length)
+{
+    i2c_master_dev_handle_t dev = I2C_Get_Device(Driver_addr);
+    if (!dev) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Register address and data go out in one transaction
+    i2c_master_transmit_multi_buffer_info_t buffers[2] = {
+        { .write_buffer = (uint8_t *)Reg_addr, .buffer_size = Addr_len },
+        { .write_buffer = (uint8_t *)Reg_data, .buffer_size = Length },
+    };
+    return i2c_master_multi_buffer_transmit(dev, buffers, Length ? 2 : 1, I2C_MASTER_TIMEOUT_MS);
+}
+
+static esp_err_t I2C_Read_Reg(uint8_t Driver_addr, const uint8_t *Reg_addr, uint32_t Addr_len, uint8_t *Reg_data, uint32_t Length)
+{
+    i2c_master_dev_handle_t dev = I2C_Get_Device(Driver_addr);
+    if (!dev) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return i2c_master_transmit_receive(dev, Reg_addr, Addr_len, Reg_data, Length, I2C_MASTER_TIMEOUT_MS);
+}
 
 // Reg addr is 8 bit
 esp_err_t I2C_Write(uint8_t Driver_addr, uint8_t Reg_addr, const uint8_t *Reg_data, uint32_t Length)
 {
-    uint8_t buf[Length+1];
-    
-    buf[0] = Reg_addr;
-    // Copy Reg_data to buf starting at buf[1]
-    memcpy(&buf[1], Reg_data, Length);
-    return i2c_master_write_to_device(I2C_MASTER_NUM, Driver_addr, buf, Length+1, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
+    return I2C_Write_Reg(Driver_addr, &Reg_addr, 1, Reg_data, Length);
 }
 
+esp_err_t I2C_Read(uint8_t Driver_addr, uint8_t Reg_addr, uint8_t *Reg_data, uint32_t Length)
+{
+    return I2C_Read_Reg(Driver_addr, &Reg_addr, 1, Reg_data, Length);
+}
 
+// Reg addr is 16 bit, high byte first
+esp_err_t I2C_Write16(uint8_t Driver_addr, uint16_t Reg_addr, const uint8_t *Reg_data, uint32_t Length)
+{
+    const uint8_t buf_Addr[2] = { (uint8_t)(Reg_addr >> 8), (uint8_t)Reg_addr };
+    return I2C_Write_Reg(Driver_addr, buf_Addr, 2, Reg_data, Length);
+}
 
-esp_err_t I2C_Read(uint8_t Driver_addr, uint8_t Reg_addr, uint8_t *Reg_data, uint32_t Length)
+esp_err_t I2C_Read16(uint8_t Driver_addr, uint16_t Reg_addr, uint8_t *Reg_data, uint32_t Length)
 {
-    return i2c_master_write_read_device(I2C_MASTER_NUM, Driver_addr, &Reg_addr, 1, Reg_data, Length, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
+    const uint8_t buf_Addr[2] = { (uint8_t)(Reg_addr >> 8), (uint8_t)Reg_addr };
+    return I2C_Read_Reg(Driver_addr, buf_Addr, 2, Reg_data, Length);
 }
@@ -4,7 +4,7 @@
 #include <string.h>  // For memcpy
 #include "esp_log.h"
 #include "driver/gpio.h"
-#include "driver/i2c.h"
+#include "driver/i2c_master.h"
 
 
 /********************* I2C *********************/
@@ -12,12 +12,21 @@
 #define I2C_SDA_IO                  11         /*!< GPIO number used for I2C master data  */
 #define I2C_MASTER_NUM              0         /*!< I2C master i2c port number, the number of i2c peripheral interfaces available will depend on the chip */
 #define I2C_MASTER_FREQ_HZ          400000    /*!< I2C master clock frequency */
-#define I2C_MASTER_TX_BUF_DISABLE   0         /*!< I2C master doesn't need buffer */
-#define I2C_MASTER_RX_BUF_DISABLE   0         /*!< I2C master doesn't need buffer */
 #define I2C_MASTER_TIMEOUT_MS       1000
+#define I2C_MAX_DEVICES             8         /*!< Touch, IMU, RTC, IO expander, with room to spare */
 
-
+/*
+ * One i2c_master bus shared by every driver on it; each 7-bit address gets
+ * its device handle on first use. Transactions from different tasks are
+ * serialized by the bus lock, a FreeRTOS mutex: waiters are served highest
+ * priority first (and the holder inherits their priority), so the touch task
+ * waits for at most the one transaction already on the wire, never for a
+ * queue of IMU or RTC reads.
+ */
 void I2C_Init(void);
 // Reg addr is 8 bit
 esp_err_t I2C_Write(uint8_t Driver_addr, uint8_t Reg_addr, const uint8_t *Reg_data, uint32_t Length);
-esp_err_t I2C_Read(uint8_t Driver_addr, uint8_t Reg_addr, uint8_t *Reg_data, uint32_t Length);
\ No newline at end of file
+esp_err_t I2C_Read(uint8_t Driver_addr, uint8_t Reg_addr, uint8_t *Reg_data, uint32_t Length);
+// Reg addr is 16 bit, high byte first
+esp_err_t I2C_Write16(uint8_t Driver_addr, uint16_t Reg_addr, const uint8_t *Reg_data, uint32_t Length);
+esp_err_t I2C_Read16(uint8_t Driver_addr, uint16_t Reg_addr, uint8_t *Reg_data, uint32_t Length);
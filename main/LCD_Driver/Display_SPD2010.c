@@ -1,40 +1,93 @@
 #include "Display_SPD2010.h"
+#include "LVGL_Latency.h"
 
 static const char *TAG_LCD = "SPD2010";
 
 esp_lcd_panel_handle_t panel_handle = NULL;
+esp_lcd_panel_io_handle_t io_handle = NULL;
+
+// Survives a software reset, panic or watchdog but not a power cycle
+static RTC_NOINIT_ATTR uint32_t lcd_warm_magic;
+
+#if CONFIG_LCD_TE_SYNC
+static SemaphoreHandle_t te_semaphore = NULL;
+
+static void IRAM_ATTR TE_ISR_Handler(void *arg)
+{
+  LVGL_Latency_Mark(LVGL_LATENCY_SCANOUT);
+  BaseType_t task_woken = pdFALSE;
+  xSemaphoreGiveFromISR(te_semaphore, &task_woken);
+  if (task_woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+static void TE_Init(void)
+{
+  te_semaphore = xSemaphoreCreateBinary();
+  if (!te_semaphore) {
+    ESP_LOGE(TAG_LCD, "Failed to create TE semaphore");
+    return;
+  }
+  const gpio_config_t te_gpio_config = {
+    .pin_bit_mask = 1ULL << ESP_PANEL_LCD_SPI_IO_TE,
+    .mode = GPIO_MODE_INPUT,
+    .intr_type = GPIO_INTR_POSEDGE,
+  };
+  ESP_ERROR_CHECK(gpio_config(&te_gpio_config));
+  esp_err_t ret = gpio_install_isr_service(0);
+  if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {     // Already installed is fine
+    ESP_LOGE(TAG_LCD, "Failed to install GPIO ISR service: %s", esp_err_to_name(ret));
+    return;
+  }
+  gpio_isr_handler_add(ESP_PANEL_LCD_SPI_IO_TE, TE_ISR_Handler, NULL);
+}
+
+void LCD_Wait_TE(void)
+{
+  if (!te_semaphore) {
+    return;
+  }
+  // Drop a pulse that came before this frame, then wait for a fresh one
+  xSemaphoreTake(te_semaphore, 0);
+  xSemaphoreTake(te_semaphore, pdMS_TO_TICKS(LCD_TE_TIMEOUT_MS));
+}
+#endif
 
 void SPD2010_Reset(){
   Set_EXIO(TCA9554_EXIO2,false);
-  vTaskDelay(pdMS_TO_TICKS(100));
+  vTaskDelay(pdMS_TO_TICKS(LCD_RESET_PULSE_MS));
   Set_EXIO(TCA9554_EXIO2,true);
-  vTaskDelay(pdMS_TO_TICKS(100));
+  vTaskDelay(pdMS_TO_TICKS(LCD_RESET_WAIT_MS));
 }
 void LCD_Init() {        
   SPD2010_Init();
   Backlight_Init();
   Touch_Init();
 }
+void LCD_Display_On(void)
+{
+  esp_lcd_panel_disp_on_off(panel_handle, true);
+}
 
-static void test_draw_bitmap(esp_lcd_panel_handle_t panel_handle)
+// The panel keeps its registers and stays awake through a reset of the ESP32 alone,
+// and keeps them asleep through a deep sleep that LCD_Suspend() started
+static bool SPD2010_Is_Warm(void)
 {
-  uint16_t row_line = ((EXAMPLE_LCD_WIDTH / EXAMPLE_LCD_COLOR_BITS) << 1) >> 1;
-  uint8_t byte_per_pixel = EXAMPLE_LCD_COLOR_BITS / 8;
-  uint8_t *color = (uint8_t *)heap_caps_calloc(1, row_line * EXAMPLE_LCD_HEIGHT * byte_per_pixel, MALLOC_CAP_DMA);
-
-
-  for (int j = 0; j < EXAMPLE_LCD_COLOR_BITS; j++) {
-      for (int i = 0; i < row_line * EXAMPLE_LCD_HEIGHT; i++) {
-          for (int k = 0; k < byte_per_pixel; k++) {
-              color[i * byte_per_pixel + k] = (SPI_SWAP_DATA_TX(BIT(j), EXAMPLE_LCD_COLOR_BITS) >> (k * 8)) & 0xff;
-          }
-      }
-      esp_lcd_panel_draw_bitmap(panel_handle, 0, j * row_line, EXAMPLE_LCD_HEIGHT, (j + 1) * row_line, color);
+  switch (esp_reset_reason()) {
+  case ESP_RST_DEEPSLEEP:
+  case ESP_RST_SW:
+  case ESP_RST_PANIC:
+  case ESP_RST_INT_WDT:
+  case ESP_RST_TASK_WDT:
+  case ESP_RST_WDT:
+    return lcd_warm_magic == LCD_WARM_MAGIC;
+  default:
+    return false;
   }
-  free(color);
 }
 
-int QSPI_Init(void){
+int QSPI_Init(bool warm){
   static const spi_bus_config_t host_config = {            
     .data0_io_num = ESP_PANEL_LCD_SPI_IO_DATA0,                    
     .data1_io_num = ESP_PANEL_LCD_SPI_IO_DATA1,                   
@@ -74,7 +127,6 @@ int QSPI_Init(void){
       .cs_high_active = 0,            
     },                                  
   };
-  esp_lcd_panel_io_handle_t io_handle = NULL;
   if(esp_lcd_new_panel_io_spi((esp_lcd_spi_bus_handle_t)ESP_PANEL_HOST_SPI_ID_DEFAULT, &io_config, &io_handle) != ESP_OK){
     printf("Failed to set LCD communication parameters -- SPI\r\n");
     return 0;
@@ -85,6 +137,7 @@ int QSPI_Init(void){
   spd2010_vendor_config_t vendor_config={  
     .flags = {
       .use_qspi_interface = 1,
+      .skip_vendor_init = warm,
     },
   };
   esp_lcd_panel_dev_config_t panel_config={
@@ -99,30 +152,46 @@ int QSPI_Init(void){
   };
   esp_lcd_new_panel_spd2010(io_handle, &panel_config, &panel_handle);
 
-  esp_lcd_panel_reset(panel_handle);
-  esp_lcd_panel_init(panel_handle);
+  // SPD2010_Reset() was the reset; display on comes once there is a frame to show
+  if(esp_lcd_panel_init(panel_handle) != ESP_OK){
+    printf("Failed to initialize the SPD2010 panel\r\n");
+    return 0;
+  }
   // esp_lcd_panel_invert_color(panel_handle,false);
 
-  esp_lcd_panel_disp_on_off(panel_handle, true);
-  test_draw_bitmap(panel_handle);
+#if CONFIG_LCD_TE_SYNC
+  TE_Init();
+#endif
   return 1;
 }
 
 void SPD2010_Init() {
-  SPD2010_Reset();
-  if(!QSPI_Init()){
+  bool warm = SPD2010_Is_Warm();
+  lcd_warm_magic = 0;                   // A reset before this completes starts cold
+  if(!warm){
+    SPD2010_Reset();
+  }
+  if(!QSPI_Init(warm)){
     printf("SPD2010 Failed to be initialized\r\n");
+    return;
+  }
+  if(warm && esp_reset_reason() == ESP_RST_DEEPSLEEP){
+    // Asleep since LCD_Suspend(); LCD_Display_On() waits out the sleep-out time
+    esp_lcd_panel_disp_sleep(panel_handle, false);
   }
+  lcd_warm_magic = LCD_WARM_MAGIC;
+  ESP_LOGI(TAG_LCD, "Panel %s", warm ? "already initialized, vendor init skipped" : "initialized");
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Backlight program
 
-uint8_t LCD_Backlight = 70;
+RTC_DATA_ATTR uint8_t LCD_Backlight = 70;       // The user's level survives a suspend
 static ledc_channel_config_t ledc_channel;
 void Backlight_Init(void)
 {
     ESP_LOGI(TAG_LCD, "Turn off LCD backlight");
+    gpio_hold_dis(EXAMPLE_LCD_PIN_NUM_BK_LIGHT);     // Held low through a suspend
     gpio_config_t bk_gpio_config = {
         .mode = GPIO_MODE_OUTPUT,
         .pin_bit_mask = 1ULL << EXAMPLE_LCD_PIN_NUM_BK_LIGHT
@@ -148,13 +217,36 @@ void Backlight_Init(void)
     
     Set_Backlight(LCD_Backlight);      //0~100    
 }
+static uint32_t Backlight_Duty(uint8_t Light)
+{
+    if(Light > Backlight_MAX) Light = Backlight_MAX;
+    if(Light == 0)
+        return 0;
+    return LEDC_MAX_Duty-(81*(Backlight_MAX-Light));
+}
 void Set_Backlight(uint8_t Light)
 {   
-    if(Light > Backlight_MAX) Light = Backlight_MAX;
-    uint16_t Duty = LEDC_MAX_Duty-(81*(Backlight_MAX-Light));
-    if(Light == 0) 
-        Duty = 0;
-    ledc_set_duty(ledc_channel.speed_mode, ledc_channel.channel, Duty);
-    ledc_update_duty(ledc_channel.speed_mode, ledc_channel.channel);
+    Set_Backlight_Fade(Light, 0);
 }
-// end Backlight program
\ No newline at end of file
+void Set_Backlight_Fade(uint8_t Light, uint32_t Fade_ms)
+{
+    uint32_t Duty = Backlight_Duty(Light);
+    // A new level replaces a fade still running; both calls are thread-safe
+    ledc_fade_stop(ledc_channel.speed_mode, ledc_channel.channel);
+    if(Fade_ms == 0 || ledc_get_duty(ledc_channel.speed_mode, ledc_channel.channel) == Duty){
+        ledc_set_duty_and_update(ledc_channel.speed_mode, ledc_channel.channel, Duty, 0);
+        return;
+    }
+    // The LEDC steps the duty itself; the CPU only hears about the end
+    ledc_set_fade_time_and_start(ledc_channel.speed_mode, ledc_channel.channel, Duty, Fade_ms, LEDC_FADE_NO_WAIT);
+}
+// end Backlight program
+
+void LCD_Suspend(void)
+{
+  ledc_fade_stop(ledc_channel.speed_mode, ledc_channel.channel);
+  ledc_stop(ledc_channel.speed_mode, ledc_channel.channel, EXAMPLE_LCD_BK_LIGHT_OFF_LEVEL);
+  gpio_hold_en(EXAMPLE_LCD_PIN_NUM_BK_LIGHT);        // Off until Backlight_Init() on the way back
+  esp_lcd_panel_disp_on_off(panel_handle, false);
+  esp_lcd_panel_disp_sleep(panel_handle, true);
+}
\ No newline at end of file
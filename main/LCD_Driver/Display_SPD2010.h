@@ -6,9 +6,13 @@
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "driver/gpio.h"
 #include "driver/spi_master.h"
+#include "hal/spi_ll.h"
 #include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_system.h"
 #include "esp_lcd_panel_io.h"
 #include "esp_lcd_panel_io_interface.h"
 #include "esp_intr_alloc.h"
@@ -47,7 +51,17 @@
 #define EXAMPLE_LCD_BK_LIGHT_ON_LEVEL       (1)
 #define EXAMPLE_LCD_BK_LIGHT_OFF_LEVEL !EXAMPLE_LCD_BK_LIGHT_ON_LEVEL
 
+// Theoretical QSPI pixel rate: four data lines at the SPI clock
+#define ESP_PANEL_LCD_SPI_MAX_BYTES_PER_S   (ESP_PANEL_LCD_SPI_CLK_HZ / 8 * 4)
+
+#if CONFIG_LVGL_BUFFER_INTERNAL_DMA || CONFIG_LVGL_BUFFER_PSRAM_BOUNCE
+// Draw buffers are internal and DMA-capable: a flush is one transaction of
+// up to the hardware's length limit, over a chain of DMA descriptors
+#define ESP_PANEL_HOST_SPI_MAX_TRANSFER_SIZE   (SPI_LL_DATA_MAX_BIT_LEN / 8)
+#else
+// PSRAM is copied to an internal buffer per transaction, so keep them small
 #define ESP_PANEL_HOST_SPI_MAX_TRANSFER_SIZE   (2048)
+#endif
 
 #define LEDC_HS_TIMER          LEDC_TIMER_0
 #define LEDC_LS_MODE           LEDC_LOW_SPEED_MODE
@@ -58,13 +72,30 @@
 #define LEDC_MAX_Duty          ((1 << LEDC_ResolutionRatio) - 1)
 #define Backlight_MAX   100      
 
+// Longest wait for a TE pulse; the panel refreshes at about 60 Hz
+#define LCD_TE_TIMEOUT_MS      (20)
+
+// Reset pulse, then the wait before the first command: the panel may have been
+// awake (only the ESP32 was reset), which the datasheet gives 120 ms
+#define LCD_RESET_PULSE_MS     (10)
+#define LCD_RESET_WAIT_MS      (120)
+// Marks a panel left initialized across a reset of the ESP32 alone
+#define LCD_WARM_MAGIC         (0x5D2010A5)
+
 extern esp_lcd_panel_handle_t panel_handle;
+extern esp_lcd_panel_io_handle_t io_handle;
 extern uint8_t LCD_Backlight;
 
 void SPD2010_Init();
 
 void LCD_Init(void);                     // Call this function to initialize the screen (must be called in the main function) !!!!!
+void LCD_Display_On(void);               // Once the first frame is drawn; waits out what is left of the panel's sleep-out time
+void LCD_Suspend(void);                  // Backlight off and held, panel asleep with its registers: the next SPD2010_Init() skips the reset
 void LCD_addWindow(uint16_t Xstart, uint16_t Ystart, uint16_t Xend, uint16_t Yend,uint16_t* color);
+#if CONFIG_LCD_TE_SYNC
+void LCD_Wait_TE(void);                  // Block until the next TE pulse (vertical blanking), at most LCD_TE_TIMEOUT_MS
+#endif
 
 void Backlight_Init(void);                             // Initialize the LCD backlight, which has been called in the LCD_Init function, ignore it                                                         
 void Set_Backlight(uint8_t Light);                   // Call this function to adjust the brightness of the backlight. The value of the parameter Light ranges from 0 to 100
+void Set_Backlight_Fade(uint8_t Light, uint32_t Fade_ms); // The same, reached over Fade_ms by the LEDC hardware fade; returns at once
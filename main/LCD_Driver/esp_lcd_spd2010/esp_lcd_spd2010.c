@@ -5,12 +5,14 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <sys/cdefs.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "driver/gpio.h"
 #include "esp_check.h"
+#include "esp_timer.h"
 #include "esp_lcd_panel_interface.h"
 #include "esp_lcd_panel_io.h"
 #include "esp_lcd_panel_vendor.h"
@@ -29,6 +31,27 @@
 #define SPD2010_CMD_SET_BYTE1       (0x10)
 #define SPD2010_CMD_SET_USER        (0x00)
 
+#define SPD2010_SLPOUT_SETTLE_MS    (120)   // After sleep out, before display on
+
+/*
+ * The default init sequence is a packed byte stream rather than an array of
+ * spd2010_lcd_init_cmd_t: nearly all of it is single-byte register writes,
+ * two bytes each here instead of a struct and a compound literal. Ops:
+ *   SPD2010_INIT_CMD(len), cmd, data[len]      one command, len up to 63
+ *   SPD2010_INIT_PAGE(page)                    CMD_SET to a register page
+ *   SPD2010_INIT_REGS(n), n x {reg, value}     single-byte writes, n up to 127
+ *   SPD2010_INIT_DELAY(ms)                     a wait, up to 255 ms
+ * There are no per-command delays; the one the sequence needs, after sleep
+ * out, is waited out by the display on command instead.
+ */
+#define SPD2010_INIT_OP_PAGE        (0x40)
+#define SPD2010_INIT_OP_DELAY       (0x41)
+#define SPD2010_INIT_OP_REGS        (0x80)
+#define SPD2010_INIT_CMD(len)       (len)
+#define SPD2010_INIT_PAGE(page)     SPD2010_INIT_OP_PAGE, (page)
+#define SPD2010_INIT_REGS(n)        (SPD2010_INIT_OP_REGS | (n))
+#define SPD2010_INIT_DELAY(ms)      SPD2010_INIT_OP_DELAY, (ms)
+
 static const char *TAG = "spd2010";
 
 static esp_err_t panel_spd2010_del(esp_lcd_panel_t *panel);
@@ -40,6 +63,7 @@ static esp_err_t panel_spd2010_mirror(esp_lcd_panel_t *panel, bool mirror_x, boo
 static esp_err_t panel_spd2010_swap_xy(esp_lcd_panel_t *panel, bool swap_axes);
 static esp_err_t panel_spd2010_set_gap(esp_lcd_panel_t *panel, int x_gap, int y_gap);
 static esp_err_t panel_spd2010_disp_on_off(esp_lcd_panel_t *panel, bool off);
+static esp_err_t panel_spd2010_disp_sleep(esp_lcd_panel_t *panel, bool sleep);
 
 typedef struct {
     esp_lcd_panel_t base;
@@ -52,12 +76,24 @@ typedef struct {
     uint8_t colmod_val; // save current value of LCD_CMD_COLMOD register
     const spd2010_lcd_init_cmd_t *init_cmds;
     uint16_t init_cmds_size;
+    int64_t sleep_out_us;       // When sleep out was sent, until display on
+    int window[4];              // Last CASET and RASET sent (x_start, x_end, y_start, y_end), -1 if unknown:
+                                // from creation and after a reset, init, sleep or display on/off
     struct {
         unsigned int use_qspi_interface: 1;
+        unsigned int skip_vendor_init: 1;
         unsigned int reset_level: 1;
     } flags;
 } spd2010_panel_t;
 
+// The next draw sends CASET and RASET whatever the panel was last told
+static void window_forget(spd2010_panel_t *spd2010)
+{
+    for (size_t i = 0; i < sizeof(spd2010->window) / sizeof(spd2010->window[0]); i++) {
+        spd2010->window[i] = -1;
+    }
+}
+
 esp_err_t esp_lcd_new_panel_spd2010(const esp_lcd_panel_io_handle_t io, const esp_lcd_panel_dev_config_t *panel_dev_config, esp_lcd_panel_handle_t *ret_panel)
 {
     ESP_RETURN_ON_FALSE(io && panel_dev_config && ret_panel, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
@@ -66,6 +102,7 @@ esp_err_t esp_lcd_new_panel_spd2010(const esp_lcd_panel_io_handle_t io, const es
     spd2010_panel_t *spd2010 = NULL;
     spd2010 = calloc(1, sizeof(spd2010_panel_t));
     ESP_GOTO_ON_FALSE(spd2010, ESP_ERR_NO_MEM, err, TAG, "no mem for spd2010 panel");
+    window_forget(spd2010);
 
     if (panel_dev_config->reset_gpio_num >= 0) {
         gpio_config_t io_conf = {
@@ -115,6 +152,7 @@ esp_err_t esp_lcd_new_panel_spd2010(const esp_lcd_panel_io_handle_t io, const es
         spd2010->init_cmds = vendor_config->init_cmds;
         spd2010->init_cmds_size = vendor_config->init_cmds_size;
         spd2010->flags.use_qspi_interface = vendor_config->flags.use_qspi_interface;
+        spd2010->flags.skip_vendor_init = vendor_config->flags.skip_vendor_init;
     }
     spd2010->flags.reset_level = panel_dev_config->flags.reset_active_high;
     spd2010->base.del = panel_spd2010_del;
@@ -126,6 +164,7 @@ esp_err_t esp_lcd_new_panel_spd2010(const esp_lcd_panel_io_handle_t io, const es
     spd2010->base.mirror = panel_spd2010_mirror;
     spd2010->base.swap_xy = panel_spd2010_swap_xy;
     spd2010->base.disp_on_off = panel_spd2010_disp_on_off;
+    spd2010->base.disp_sleep = panel_spd2010_disp_sleep;
     *ret_panel = &(spd2010->base);
     ESP_LOGD(TAG, "new spd2010 panel @%p", spd2010);
 
@@ -181,6 +220,7 @@ static esp_err_t panel_spd2010_reset(esp_lcd_panel_t *panel)
     spd2010_panel_t *spd2010 = __containerof(panel, spd2010_panel_t, base);
     esp_lcd_panel_io_handle_t io = spd2010->io;
 
+    window_forget(spd2010);
     // Perform hardware reset
     if (spd2010->reset_gpio_num >= 0) {
         gpio_set_level(spd2010->reset_gpio_num, spd2010->flags.reset_level);
@@ -196,422 +236,250 @@ static esp_err_t panel_spd2010_reset(esp_lcd_panel_t *panel)
 }
 
 
-static const spd2010_lcd_init_cmd_t vendor_specific_init_default[] = {
-//  {cmd, { data }, data_size, delay_ms}
-    {0xFF, (uint8_t []){0x20, 0x10, 0x10}, 3, 0},
-    {0x0C, (uint8_t []){0x11}, 1, 0},
-    {0x10, (uint8_t []){0x02}, 1, 0},
-    {0x11, (uint8_t []){0x11}, 1, 0},
-    {0x15, (uint8_t []){0x42}, 1, 0},
-    {0x16, (uint8_t []){0x11}, 1, 0},
-    {0x1A, (uint8_t []){0x02}, 1, 0},
-    {0x1B, (uint8_t []){0x11}, 1, 0},
-    {0x61, (uint8_t []){0x80}, 1, 0},
-    {0x62, (uint8_t []){0x80}, 1, 0},
-    {0x54, (uint8_t []){0x44}, 1, 0},
-    {0x58, (uint8_t []){0x88}, 1, 0},
-    {0x5C, (uint8_t []){0xcc}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x10}, 3, 0},
-    {0x20, (uint8_t []){0x80}, 1, 0},
-    {0x21, (uint8_t []){0x81}, 1, 0},
-    {0x22, (uint8_t []){0x31}, 1, 0},
-    {0x23, (uint8_t []){0x20}, 1, 0},
-    {0x24, (uint8_t []){0x11}, 1, 0},
-    {0x25, (uint8_t []){0x11}, 1, 0},
-    {0x26, (uint8_t []){0x12}, 1, 0},
-    {0x27, (uint8_t []){0x12}, 1, 0},
-    {0x30, (uint8_t []){0x80}, 1, 0},
-    {0x31, (uint8_t []){0x81}, 1, 0},
-    {0x32, (uint8_t []){0x31}, 1, 0},
-    {0x33, (uint8_t []){0x20}, 1, 0},
-    {0x34, (uint8_t []){0x11}, 1, 0},
-    {0x35, (uint8_t []){0x11}, 1, 0},
-    {0x36, (uint8_t []){0x12}, 1, 0},
-    {0x37, (uint8_t []){0x12}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x10}, 3, 0},
-    {0x41, (uint8_t []){0x11}, 1, 0},
-    {0x42, (uint8_t []){0x22}, 1, 0},
-    {0x43, (uint8_t []){0x33}, 1, 0},
-    {0x49, (uint8_t []){0x11}, 1, 0},
-    {0x4A, (uint8_t []){0x22}, 1, 0},
-    {0x4B, (uint8_t []){0x33}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x15}, 3, 0},
-    {0x00, (uint8_t []){0x00}, 1, 0},
-    {0x01, (uint8_t []){0x00}, 1, 0},
-    {0x02, (uint8_t []){0x00}, 1, 0},
-    {0x03, (uint8_t []){0x00}, 1, 0},
-    {0x04, (uint8_t []){0x10}, 1, 0},
-    {0x05, (uint8_t []){0x0C}, 1, 0},
-    {0x06, (uint8_t []){0x23}, 1, 0},
-    {0x07, (uint8_t []){0x22}, 1, 0},
-    {0x08, (uint8_t []){0x21}, 1, 0},
-    {0x09, (uint8_t []){0x20}, 1, 0},
-    {0x0A, (uint8_t []){0x33}, 1, 0},
-    {0x0B, (uint8_t []){0x32}, 1, 0},
-    {0x0C, (uint8_t []){0x34}, 1, 0},
-    {0x0D, (uint8_t []){0x35}, 1, 0},
-    {0x0E, (uint8_t []){0x01}, 1, 0},
-    {0x0F, (uint8_t []){0x01}, 1, 0},
-    {0x20, (uint8_t []){0x00}, 1, 0},
-    {0x21, (uint8_t []){0x00}, 1, 0},
-    {0x22, (uint8_t []){0x00}, 1, 0},
-    {0x23, (uint8_t []){0x00}, 1, 0},
-    {0x24, (uint8_t []){0x0C}, 1, 0},
-    {0x25, (uint8_t []){0x10}, 1, 0},
-    {0x26, (uint8_t []){0x20}, 1, 0},
-    {0x27, (uint8_t []){0x21}, 1, 0},
-    {0x28, (uint8_t []){0x22}, 1, 0},
-    {0x29, (uint8_t []){0x23}, 1, 0},
-    {0x2A, (uint8_t []){0x33}, 1, 0},
-    {0x2B, (uint8_t []){0x32}, 1, 0},
-    {0x2C, (uint8_t []){0x34}, 1, 0},
-    {0x2D, (uint8_t []){0x35}, 1, 0},
-    {0x2E, (uint8_t []){0x01}, 1, 0},
-    {0x2F, (uint8_t []){0x01}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x16}, 3, 0},
-    {0x00, (uint8_t []){0x00}, 1, 0},
-    {0x01, (uint8_t []){0x00}, 1, 0},
-    {0x02, (uint8_t []){0x00}, 1, 0},
-    {0x03, (uint8_t []){0x00}, 1, 0},
-    {0x04, (uint8_t []){0x08}, 1, 0},
-    {0x05, (uint8_t []){0x04}, 1, 0},
-    {0x06, (uint8_t []){0x19}, 1, 0},
-    {0x07, (uint8_t []){0x18}, 1, 0},
-    {0x08, (uint8_t []){0x17}, 1, 0},
-    {0x09, (uint8_t []){0x16}, 1, 0},
-    {0x0A, (uint8_t []){0x33}, 1, 0},
-    {0x0B, (uint8_t []){0x32}, 1, 0},
-    {0x0C, (uint8_t []){0x34}, 1, 0},
-    {0x0D, (uint8_t []){0x35}, 1, 0},
-    {0x0E, (uint8_t []){0x01}, 1, 0},
-    {0x0F, (uint8_t []){0x01}, 1, 0},
-    {0x20, (uint8_t []){0x00}, 1, 0},
-    {0x21, (uint8_t []){0x00}, 1, 0},
-    {0x22, (uint8_t []){0x00}, 1, 0},
-    {0x23, (uint8_t []){0x00}, 1, 0},
-    {0x24, (uint8_t []){0x04}, 1, 0},
-    {0x25, (uint8_t []){0x08}, 1, 0},
-    {0x26, (uint8_t []){0x16}, 1, 0},
-    {0x27, (uint8_t []){0x17}, 1, 0},
-    {0x28, (uint8_t []){0x18}, 1, 0},
-    {0x29, (uint8_t []){0x19}, 1, 0},
-    {0x2A, (uint8_t []){0x33}, 1, 0},
-    {0x2B, (uint8_t []){0x32}, 1, 0},
-    {0x2C, (uint8_t []){0x34}, 1, 0},
-    {0x2D, (uint8_t []){0x35}, 1, 0},
-    {0x2E, (uint8_t []){0x01}, 1, 0},
-    {0x2F, (uint8_t []){0x01}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x12}, 3, 0},
-    {0x00, (uint8_t []){0x99}, 1, 0},
-    {0x2A, (uint8_t []){0x28}, 1, 0},
-    {0x2B, (uint8_t []){0x0f}, 1, 0},
-    {0x2C, (uint8_t []){0x16}, 1, 0},
-    {0x2D, (uint8_t []){0x28}, 1, 0},
-    {0x2E, (uint8_t []){0x0f}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0xA0}, 3, 0},
-    {0x08, (uint8_t []){0xdc}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x45}, 3, 0},
-    {0x01, (uint8_t []){0x9C}, 1, 0},
-    {0x03, (uint8_t []){0x9C}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x42}, 3, 0},
-    {0x05, (uint8_t []){0x2c}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x11}, 3, 0},
-    {0x50, (uint8_t []){0x01}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x00}, 3, 0},
-    {0x2A, (uint8_t []){0x00, 0x00, 0x01, 0x9B}, 4, 0},
-    {0x2B, (uint8_t []){0x00, 0x00, 0x01, 0x9B}, 4, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x40}, 3, 0},
-    {0x86, (uint8_t []){0x00}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x00}, 3, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x12}, 3, 0},
-    {0x0D, (uint8_t []){0x66}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x17}, 3, 0},
-    {0x39, (uint8_t []){0x3c}, 1, 0},
-    {0xff, (uint8_t []){0x20, 0x10, 0x31}, 3, 0},
-    {0x38, (uint8_t []){0x03}, 1, 0},
-    {0x39, (uint8_t []){0xf0}, 1, 0},
-    {0x36, (uint8_t []){0x03}, 1, 0},
-    {0x37, (uint8_t []){0xe8}, 1, 0},
-    {0x34, (uint8_t []){0x03}, 1, 0},
-    {0x35, (uint8_t []){0xCF}, 1, 0},
-    {0x32, (uint8_t []){0x03}, 1, 0},
-    {0x33, (uint8_t []){0xBA}, 1, 0},
-    {0x30, (uint8_t []){0x03}, 1, 0},
-    {0x31, (uint8_t []){0xA2}, 1, 0},
-    {0x2e, (uint8_t []){0x03}, 1, 0},
-    {0x2f, (uint8_t []){0x95}, 1, 0},
-    {0x2c, (uint8_t []){0x03}, 1, 0},
-    {0x2d, (uint8_t []){0x7e}, 1, 0},
-    {0x2a, (uint8_t []){0x03}, 1, 0},
-    {0x2b, (uint8_t []){0x62}, 1, 0},
-    {0x28, (uint8_t []){0x03}, 1, 0},
-    {0x29, (uint8_t []){0x44}, 1, 0},
-    {0x26, (uint8_t []){0x02}, 1, 0},
-    {0x27, (uint8_t []){0xfc}, 1, 0},
-    {0x24, (uint8_t []){0x02}, 1, 0},
-    {0x25, (uint8_t []){0xd0}, 1, 0},
-    {0x22, (uint8_t []){0x02}, 1, 0},
-    {0x23, (uint8_t []){0x98}, 1, 0},
-    {0x20, (uint8_t []){0x02}, 1, 0},
-    {0x21, (uint8_t []){0x6f}, 1, 0},
-    {0x1e, (uint8_t []){0x02}, 1, 0},
-    {0x1f, (uint8_t []){0x32}, 1, 0},
-    {0x1c, (uint8_t []){0x01}, 1, 0},
-    {0x1d, (uint8_t []){0xf6}, 1, 0},
-    {0x1a, (uint8_t []){0x01}, 1, 0},
-    {0x1b, (uint8_t []){0xb8}, 1, 0},
-    {0x18, (uint8_t []){0x01}, 1, 0},
-    {0x19, (uint8_t []){0x6E}, 1, 0},
-    {0x16, (uint8_t []){0x01}, 1, 0},
-    {0x17, (uint8_t []){0x41}, 1, 0},
-    {0x14, (uint8_t []){0x00}, 1, 0},
-    {0x15, (uint8_t []){0xfd}, 1, 0},
-    {0x12, (uint8_t []){0x00}, 1, 0},
-    {0x13, (uint8_t []){0xCf}, 1, 0},
-    {0x10, (uint8_t []){0x00}, 1, 0},
-    {0x11, (uint8_t []){0x98}, 1, 0},
-    {0x0e, (uint8_t []){0x00}, 1, 0},
-    {0x0f, (uint8_t []){0x89}, 1, 0},
-    {0x0c, (uint8_t []){0x00}, 1, 0},
-    {0x0d, (uint8_t []){0x79}, 1, 0},
-    {0x0a, (uint8_t []){0x00}, 1, 0},
-    {0x0b, (uint8_t []){0x67}, 1, 0},
-    {0x08, (uint8_t []){0x00}, 1, 0},
-    {0x09, (uint8_t []){0x55}, 1, 0},
-    {0x06, (uint8_t []){0x00}, 1, 0},
-    {0x07, (uint8_t []){0x3F}, 1, 0},
-    {0x04, (uint8_t []){0x00}, 1, 0},
-    {0x05, (uint8_t []){0x28}, 1, 0},
-    {0x02, (uint8_t []){0x00}, 1, 0},
-    {0x03, (uint8_t []){0x0E}, 1, 0},
-    {0xff, (uint8_t []){0x20, 0x10, 0x00}, 3, 0},
-    {0xff, (uint8_t []){0x20, 0x10, 0x32}, 3, 0},
-    {0x38, (uint8_t []){0x03}, 1, 0},
-    {0x39, (uint8_t []){0xf0}, 1, 0},
-    {0x36, (uint8_t []){0x03}, 1, 0},
-    {0x37, (uint8_t []){0xe8}, 1, 0},
-    {0x34, (uint8_t []){0x03}, 1, 0},
-    {0x35, (uint8_t []){0xCF}, 1, 0},
-    {0x32, (uint8_t []){0x03}, 1, 0},
-    {0x33, (uint8_t []){0xBA}, 1, 0},
-    {0x30, (uint8_t []){0x03}, 1, 0},
-    {0x31, (uint8_t []){0xA2}, 1, 0},
-    {0x2e, (uint8_t []){0x03}, 1, 0},
-    {0x2f, (uint8_t []){0x95}, 1, 0},
-    {0x2c, (uint8_t []){0x03}, 1, 0},
-    {0x2d, (uint8_t []){0x7e}, 1, 0},
-    {0x2a, (uint8_t []){0x03}, 1, 0},
-    {0x2b, (uint8_t []){0x62}, 1, 0},
-    {0x28, (uint8_t []){0x03}, 1, 0},
-    {0x29, (uint8_t []){0x44}, 1, 0},
-    {0x26, (uint8_t []){0x02}, 1, 0},
-    {0x27, (uint8_t []){0xfc}, 1, 0},
-    {0x24, (uint8_t []){0x02}, 1, 0},
-    {0x25, (uint8_t []){0xd0}, 1, 0},
-    {0x22, (uint8_t []){0x02}, 1, 0},
-    {0x23, (uint8_t []){0x98}, 1, 0},
-    {0x20, (uint8_t []){0x02}, 1, 0},
-    {0x21, (uint8_t []){0x6f}, 1, 0},
-    {0x1e, (uint8_t []){0x02}, 1, 0},
-    {0x1f, (uint8_t []){0x32}, 1, 0},
-    {0x1c, (uint8_t []){0x01}, 1, 0},
-    {0x1d, (uint8_t []){0xf6}, 1, 0},
-    {0x1a, (uint8_t []){0x01}, 1, 0},
-    {0x1b, (uint8_t []){0xb8}, 1, 0},
-    {0x18, (uint8_t []){0x01}, 1, 0},
-    {0x19, (uint8_t []){0x6E}, 1, 0},
-    {0x16, (uint8_t []){0x01}, 1, 0},
-    {0x17, (uint8_t []){0x41}, 1, 0},
-    {0x14, (uint8_t []){0x00}, 1, 0},
-    {0x15, (uint8_t []){0xfd}, 1, 0},
-    {0x12, (uint8_t []){0x00}, 1, 0},
-    {0x13, (uint8_t []){0xCf}, 1, 0},
-    {0x10, (uint8_t []){0x00}, 1, 0},
-    {0x11, (uint8_t []){0x98}, 1, 0},
-    {0x0e, (uint8_t []){0x00}, 1, 0},
-    {0x0f, (uint8_t []){0x89}, 1, 0},
-    {0x0c, (uint8_t []){0x00}, 1, 0},
-    {0x0d, (uint8_t []){0x79}, 1, 0},
-    {0x0a, (uint8_t []){0x00}, 1, 0},
-    {0x0b, (uint8_t []){0x67}, 1, 0},
-    {0x08, (uint8_t []){0x00}, 1, 0},
-    {0x09, (uint8_t []){0x55}, 1, 0},
-    {0x06, (uint8_t []){0x00}, 1, 0},
-    {0x07, (uint8_t []){0x3F}, 1, 0},
-    {0x04, (uint8_t []){0x00}, 1, 0},
-    {0x05, (uint8_t []){0x28}, 1, 0},
-    {0x02, (uint8_t []){0x00}, 1, 0},
-    {0x03, (uint8_t []){0x0E}, 1, 0},
-    {0xff, (uint8_t []){0x20, 0x10, 0x00}, 3, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x11}, 3, 0},
-    {0x60, (uint8_t []){0x01}, 1, 0},
-    {0x65, (uint8_t []){0x03}, 1, 0},
-    {0x66, (uint8_t []){0x38}, 1, 0},
-    {0x67, (uint8_t []){0x04}, 1, 0},
-    {0x68, (uint8_t []){0x34}, 1, 0},
-    {0x69, (uint8_t []){0x03}, 1, 0},
-    {0x61, (uint8_t []){0x03}, 1, 0},
-    {0x62, (uint8_t []){0x38}, 1, 0},
-    {0x63, (uint8_t []){0x04}, 1, 0},
-    {0x64, (uint8_t []){0x34}, 1, 0},
-    {0x0A, (uint8_t []){0x11}, 1, 0},
-    {0x0B, (uint8_t []){0x20}, 1, 0},
-    {0x0c, (uint8_t []){0x20}, 1, 0},
-    {0x55, (uint8_t []){0x06}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x42}, 3, 0},
-    {0x05, (uint8_t []){0x3D}, 1, 0},
-    {0x06, (uint8_t []){0x03}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x00}, 3, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x12}, 3, 0},
-    {0x1F, (uint8_t []){0xDC}, 1, 0},
-    {0xff, (uint8_t []){0x20, 0x10, 0x17}, 3, 0},
-    {0x11, (uint8_t []){0xAA}, 1, 0},
-    {0x16, (uint8_t []){0x12}, 1, 0},
-    {0x0B, (uint8_t []){0xC3}, 1, 0},
-    {0x10, (uint8_t []){0x0E}, 1, 0},
-    {0x14, (uint8_t []){0xAA}, 1, 0},
-    {0x18, (uint8_t []){0xA0}, 1, 0},
-    {0x1A, (uint8_t []){0x80}, 1, 0},
-    {0x1F, (uint8_t []){0x80}, 1, 0},
-    {0xff, (uint8_t []){0x20, 0x10, 0x11}, 3, 0},
-    {0x30, (uint8_t []){0xEE}, 1, 0},
-    {0xff, (uint8_t []){0x20, 0x10, 0x12}, 3, 0},
-    {0x15, (uint8_t []){0x0F}, 1, 0},
-    {0xff, (uint8_t []){0x20, 0x10, 0x2D}, 3, 0},
-    {0x01, (uint8_t []){0x3E}, 1, 0},
-    {0xff, (uint8_t []){0x20, 0x10, 0x40}, 3, 0},
-    {0x83, (uint8_t []){0xC4}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x12}, 3, 0},
-    {0x00, (uint8_t []){0xCC}, 1, 0},
-    {0x36, (uint8_t []){0xA0}, 1, 0},
-    {0x2A, (uint8_t []){0x2D}, 1, 0},
-    {0x2B, (uint8_t []){0x1e}, 1, 0},
-    {0x2C, (uint8_t []){0x26}, 1, 0},
-    {0x2D, (uint8_t []){0x2D}, 1, 0},
-    {0x2E, (uint8_t []){0x1e}, 1, 0},
-    {0x1F, (uint8_t []){0xE6}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0xA0}, 3, 0},
-    {0x08, (uint8_t []){0xE6}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x12}, 3, 0},
-    {0x10, (uint8_t []){0x0F}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x18}, 3, 0},
-    {0x01, (uint8_t []){0x01}, 1, 0},
-    {0x00, (uint8_t []){0x1E}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x43}, 3, 0},
-    {0x03, (uint8_t []){0x04}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x18}, 3, 0},
-    {0x3A, (uint8_t []){0x01}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x50}, 3, 0},
-    {0x05, (uint8_t []){0x08}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x00}, 3, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x50}, 3, 0},
-    {0x00, (uint8_t []){0xA6}, 1, 0},
-    {0x01, (uint8_t []){0xA6}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x00}, 3, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x50}, 3, 0},
-    {0x08, (uint8_t []){0x55}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x00}, 3, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x10}, 3, 0},
-    {0x0B, (uint8_t []){0x43}, 1, 0},
-    {0x0C, (uint8_t []){0x12}, 1, 0},
-    {0x10, (uint8_t []){0x01}, 1, 0},
-    {0x11, (uint8_t []){0x12}, 1, 0},
-    {0x15, (uint8_t []){0x00}, 1, 0},
-    {0x16, (uint8_t []){0x00}, 1, 0},
-    {0x1A, (uint8_t []){0x00}, 1, 0},
-    {0x1B, (uint8_t []){0x00}, 1, 0},
-    {0x61, (uint8_t []){0x00}, 1, 0},
-    {0x62, (uint8_t []){0x00}, 1, 0},
-    {0x51, (uint8_t []){0x11}, 1, 0},
-    {0x55, (uint8_t []){0x55}, 1, 0},
-    {0x58, (uint8_t []){0x00}, 1, 0},
-    {0x5C, (uint8_t []){0x00}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x10}, 3, 0},
-    {0x20, (uint8_t []){0x81}, 1, 0},
-    {0x21, (uint8_t []){0x82}, 1, 0},
-    {0x22, (uint8_t []){0x72}, 1, 0},
-    {0x30, (uint8_t []){0x00}, 1, 0},
-    {0x31, (uint8_t []){0x00}, 1, 0},
-    {0x32, (uint8_t []){0x00}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x10}, 3, 0},
-    {0x44, (uint8_t []){0x44}, 1, 0},
-    {0x45, (uint8_t []){0x55}, 1, 0},
-    {0x46, (uint8_t []){0x66}, 1, 0},
-    {0x47, (uint8_t []){0x77}, 1, 0},
-    {0x49, (uint8_t []){0x00}, 1, 0},
-    {0x4A, (uint8_t []){0x00}, 1, 0},
-    {0x4B, (uint8_t []){0x00}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x17}, 3, 0},
-    {0x37, (uint8_t []){0x00}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x15}, 3, 0},
-    {0x04, (uint8_t []){0x08}, 1, 0},
-    {0x05, (uint8_t []){0x04}, 1, 0},
-    {0x06, (uint8_t []){0x1C}, 1, 0},
-    {0x07, (uint8_t []){0x1A}, 1, 0},
-    {0x08, (uint8_t []){0x18}, 1, 0},
-    {0x09, (uint8_t []){0x16}, 1, 0},
-    {0x24, (uint8_t []){0x05}, 1, 0},
-    {0x25, (uint8_t []){0x09}, 1, 0},
-    {0x26, (uint8_t []){0x17}, 1, 0},
-    {0x27, (uint8_t []){0x19}, 1, 0},
-    {0x28, (uint8_t []){0x1B}, 1, 0},
-    {0x29, (uint8_t []){0x1D}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x16}, 3, 0},
-    {0x04, (uint8_t []){0x09}, 1, 0},
-    {0x05, (uint8_t []){0x05}, 1, 0},
-    {0x06, (uint8_t []){0x1D}, 1, 0},
-    {0x07, (uint8_t []){0x1B}, 1, 0},
-    {0x08, (uint8_t []){0x19}, 1, 0},
-    {0x09, (uint8_t []){0x17}, 1, 0},
-    {0x24, (uint8_t []){0x04}, 1, 0},
-    {0x25, (uint8_t []){0x08}, 1, 0},
-    {0x26, (uint8_t []){0x16}, 1, 0},
-    {0x27, (uint8_t []){0x18}, 1, 0},
-    {0x28, (uint8_t []){0x1A}, 1, 0},
-    {0x29, (uint8_t []){0x1C}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x18}, 3, 0},
-    {0x1F, (uint8_t []){0x02}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x11}, 3, 0},
-    {0x15, (uint8_t []){0x99}, 1, 0},
-    {0x16, (uint8_t []){0x99}, 1, 0},
-    {0x1C, (uint8_t []){0x88}, 1, 0},
-    {0x1D, (uint8_t []){0x88}, 1, 0},
-    {0x1E, (uint8_t []){0x88}, 1, 0},
-    {0x13, (uint8_t []){0xf0}, 1, 0},
-    {0x14, (uint8_t []){0x34}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x12}, 3, 0},
-    {0x12, (uint8_t []){0x89}, 1, 0},
-    {0x06, (uint8_t []){0x06}, 1, 0},
-    {0x18, (uint8_t []){0x00}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x11}, 3, 0},
-    {0x0A, (uint8_t []){0x00}, 1, 0},
-    {0x0B, (uint8_t []){0xF0}, 1, 0},
-    {0x0c, (uint8_t []){0xF0}, 1, 0},
-    {0x6A, (uint8_t []){0x10}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x00}, 3, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x11}, 3, 0},
-    {0x08, (uint8_t []){0x70}, 1, 0},
-    {0x09, (uint8_t []){0x00}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x00}, 3, 0},
-    {0x35, (uint8_t []){0x00}, 1, 0},
-    // {0x3A, (uint8_t []){0x05}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x12}, 3, 0},
-    {0x21, (uint8_t []){0x70}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x2D}, 3, 0},
-    {0x02, (uint8_t []){0x00}, 1, 0},
-    {0xFF, (uint8_t []){0x20, 0x10, 0x00}, 3, 0},
-    {0x11, (uint8_t []){0x00}, 0, 120},
+static const uint8_t vendor_specific_init_default[] = {
+//  SPD2010_INIT_PAGE(page) | SPD2010_INIT_REGS(n), n x {reg, value} | SPD2010_INIT_CMD(len), cmd, data...
+    SPD2010_INIT_PAGE(0x10),
+    SPD2010_INIT_REGS(34),
+        0x0C, 0x11, 0x10, 0x02, 0x11, 0x11, 0x15, 0x42, 0x16, 0x11, 0x1A, 0x02, 0x1B, 0x11, 0x61, 0x80,
+        0x62, 0x80, 0x54, 0x44, 0x58, 0x88, 0x5C, 0xCC, 0x20, 0x80, 0x21, 0x81, 0x22, 0x31, 0x23, 0x20,
+        0x24, 0x11, 0x25, 0x11, 0x26, 0x12, 0x27, 0x12, 0x30, 0x80, 0x31, 0x81, 0x32, 0x31, 0x33, 0x20,
+        0x34, 0x11, 0x35, 0x11, 0x36, 0x12, 0x37, 0x12, 0x41, 0x11, 0x42, 0x22, 0x43, 0x33, 0x49, 0x11,
+        0x4A, 0x22, 0x4B, 0x33,
+    SPD2010_INIT_PAGE(0x15),
+    SPD2010_INIT_REGS(32),
+        0x00, 0x00, 0x01, 0x00, 0x02, 0x00, 0x03, 0x00, 0x04, 0x10, 0x05, 0x0C, 0x06, 0x23, 0x07, 0x22,
+        0x08, 0x21, 0x09, 0x20, 0x0A, 0x33, 0x0B, 0x32, 0x0C, 0x34, 0x0D, 0x35, 0x0E, 0x01, 0x0F, 0x01,
+        0x20, 0x00, 0x21, 0x00, 0x22, 0x00, 0x23, 0x00, 0x24, 0x0C, 0x25, 0x10, 0x26, 0x20, 0x27, 0x21,
+        0x28, 0x22, 0x29, 0x23, 0x2A, 0x33, 0x2B, 0x32, 0x2C, 0x34, 0x2D, 0x35, 0x2E, 0x01, 0x2F, 0x01,
+    SPD2010_INIT_PAGE(0x16),
+    SPD2010_INIT_REGS(32),
+        0x00, 0x00, 0x01, 0x00, 0x02, 0x00, 0x03, 0x00, 0x04, 0x08, 0x05, 0x04, 0x06, 0x19, 0x07, 0x18,
+        0x08, 0x17, 0x09, 0x16, 0x0A, 0x33, 0x0B, 0x32, 0x0C, 0x34, 0x0D, 0x35, 0x0E, 0x01, 0x0F, 0x01,
+        0x20, 0x00, 0x21, 0x00, 0x22, 0x00, 0x23, 0x00, 0x24, 0x04, 0x25, 0x08, 0x26, 0x16, 0x27, 0x17,
+        0x28, 0x18, 0x29, 0x19, 0x2A, 0x33, 0x2B, 0x32, 0x2C, 0x34, 0x2D, 0x35, 0x2E, 0x01, 0x2F, 0x01,
+    SPD2010_INIT_PAGE(0x12),
+    SPD2010_INIT_REGS(6),
+        0x00, 0x99, 0x2A, 0x28, 0x2B, 0x0F, 0x2C, 0x16, 0x2D, 0x28, 0x2E, 0x0F,
+    SPD2010_INIT_PAGE(0xA0),
+    SPD2010_INIT_REGS(1),
+        0x08, 0xDC,
+    SPD2010_INIT_PAGE(0x45),
+    SPD2010_INIT_REGS(2),
+        0x01, 0x9C, 0x03, 0x9C,
+    SPD2010_INIT_PAGE(0x42),
+    SPD2010_INIT_REGS(1),
+        0x05, 0x2C,
+    SPD2010_INIT_PAGE(0x11),
+    SPD2010_INIT_REGS(1),
+        0x50, 0x01,
+    SPD2010_INIT_PAGE(0x00),
+    SPD2010_INIT_CMD(4), 0x2A, 0x00, 0x00, 0x01, 0x9B,
+    SPD2010_INIT_CMD(4), 0x2B, 0x00, 0x00, 0x01, 0x9B,
+    SPD2010_INIT_PAGE(0x40),
+    SPD2010_INIT_REGS(1),
+        0x86, 0x00,
+    SPD2010_INIT_PAGE(0x00),
+    SPD2010_INIT_PAGE(0x12),
+    SPD2010_INIT_REGS(1),
+        0x0D, 0x66,
+    SPD2010_INIT_PAGE(0x17),
+    SPD2010_INIT_REGS(1),
+        0x39, 0x3C,
+    SPD2010_INIT_PAGE(0x31),
+    SPD2010_INIT_REGS(56),
+        0x38, 0x03, 0x39, 0xF0, 0x36, 0x03, 0x37, 0xE8, 0x34, 0x03, 0x35, 0xCF, 0x32, 0x03, 0x33, 0xBA,
+        0x30, 0x03, 0x31, 0xA2, 0x2E, 0x03, 0x2F, 0x95, 0x2C, 0x03, 0x2D, 0x7E, 0x2A, 0x03, 0x2B, 0x62,
+        0x28, 0x03, 0x29, 0x44, 0x26, 0x02, 0x27, 0xFC, 0x24, 0x02, 0x25, 0xD0, 0x22, 0x02, 0x23, 0x98,
+        0x20, 0x02, 0x21, 0x6F, 0x1E, 0x02, 0x1F, 0x32, 0x1C, 0x01, 0x1D, 0xF6, 0x1A, 0x01, 0x1B, 0xB8,
+        0x18, 0x01, 0x19, 0x6E, 0x16, 0x01, 0x17, 0x41, 0x14, 0x00, 0x15, 0xFD, 0x12, 0x00, 0x13, 0xCF,
+        0x10, 0x00, 0x11, 0x98, 0x0E, 0x00, 0x0F, 0x89, 0x0C, 0x00, 0x0D, 0x79, 0x0A, 0x00, 0x0B, 0x67,
+        0x08, 0x00, 0x09, 0x55, 0x06, 0x00, 0x07, 0x3F, 0x04, 0x00, 0x05, 0x28, 0x02, 0x00, 0x03, 0x0E,
+    SPD2010_INIT_PAGE(0x00),
+    SPD2010_INIT_PAGE(0x32),
+    SPD2010_INIT_REGS(56),
+        0x38, 0x03, 0x39, 0xF0, 0x36, 0x03, 0x37, 0xE8, 0x34, 0x03, 0x35, 0xCF, 0x32, 0x03, 0x33, 0xBA,
+        0x30, 0x03, 0x31, 0xA2, 0x2E, 0x03, 0x2F, 0x95, 0x2C, 0x03, 0x2D, 0x7E, 0x2A, 0x03, 0x2B, 0x62,
+        0x28, 0x03, 0x29, 0x44, 0x26, 0x02, 0x27, 0xFC, 0x24, 0x02, 0x25, 0xD0, 0x22, 0x02, 0x23, 0x98,
+        0x20, 0x02, 0x21, 0x6F, 0x1E, 0x02, 0x1F, 0x32, 0x1C, 0x01, 0x1D, 0xF6, 0x1A, 0x01, 0x1B, 0xB8,
+        0x18, 0x01, 0x19, 0x6E, 0x16, 0x01, 0x17, 0x41, 0x14, 0x00, 0x15, 0xFD, 0x12, 0x00, 0x13, 0xCF,
+        0x10, 0x00, 0x11, 0x98, 0x0E, 0x00, 0x0F, 0x89, 0x0C, 0x00, 0x0D, 0x79, 0x0A, 0x00, 0x0B, 0x67,
+        0x08, 0x00, 0x09, 0x55, 0x06, 0x00, 0x07, 0x3F, 0x04, 0x00, 0x05, 0x28, 0x02, 0x00, 0x03, 0x0E,
+    SPD2010_INIT_PAGE(0x00),
+    SPD2010_INIT_PAGE(0x11),
+    SPD2010_INIT_REGS(14),
+        0x60, 0x01, 0x65, 0x03, 0x66, 0x38, 0x67, 0x04, 0x68, 0x34, 0x69, 0x03, 0x61, 0x03, 0x62, 0x38,
+        0x63, 0x04, 0x64, 0x34, 0x0A, 0x11, 0x0B, 0x20, 0x0C, 0x20, 0x55, 0x06,
+    SPD2010_INIT_PAGE(0x42),
+    SPD2010_INIT_REGS(2),
+        0x05, 0x3D, 0x06, 0x03,
+    SPD2010_INIT_PAGE(0x00),
+    SPD2010_INIT_PAGE(0x12),
+    SPD2010_INIT_REGS(1),
+        0x1F, 0xDC,
+    SPD2010_INIT_PAGE(0x17),
+    SPD2010_INIT_REGS(8),
+        0x11, 0xAA, 0x16, 0x12, 0x0B, 0xC3, 0x10, 0x0E, 0x14, 0xAA, 0x18, 0xA0, 0x1A, 0x80, 0x1F, 0x80,
+    SPD2010_INIT_PAGE(0x11),
+    SPD2010_INIT_REGS(1),
+        0x30, 0xEE,
+    SPD2010_INIT_PAGE(0x12),
+    SPD2010_INIT_REGS(1),
+        0x15, 0x0F,
+    SPD2010_INIT_PAGE(0x2D),
+    SPD2010_INIT_REGS(1),
+        0x01, 0x3E,
+    SPD2010_INIT_PAGE(0x40),
+    SPD2010_INIT_REGS(1),
+        0x83, 0xC4,
+    SPD2010_INIT_PAGE(0x12),
+    SPD2010_INIT_REGS(8),
+        0x00, 0xCC, 0x36, 0xA0, 0x2A, 0x2D, 0x2B, 0x1E, 0x2C, 0x26, 0x2D, 0x2D, 0x2E, 0x1E, 0x1F, 0xE6,
+    SPD2010_INIT_PAGE(0xA0),
+    SPD2010_INIT_REGS(1),
+        0x08, 0xE6,
+    SPD2010_INIT_PAGE(0x12),
+    SPD2010_INIT_REGS(1),
+        0x10, 0x0F,
+    SPD2010_INIT_PAGE(0x18),
+    SPD2010_INIT_REGS(2),
+        0x01, 0x01, 0x00, 0x1E,
+    SPD2010_INIT_PAGE(0x43),
+    SPD2010_INIT_REGS(1),
+        0x03, 0x04,
+    SPD2010_INIT_PAGE(0x18),
+    SPD2010_INIT_REGS(1),
+        0x3A, 0x01,
+    SPD2010_INIT_PAGE(0x50),
+    SPD2010_INIT_REGS(1),
+        0x05, 0x08,
+    SPD2010_INIT_PAGE(0x00),
+    SPD2010_INIT_PAGE(0x50),
+    SPD2010_INIT_REGS(2),
+        0x00, 0xA6, 0x01, 0xA6,
+    SPD2010_INIT_PAGE(0x00),
+    SPD2010_INIT_PAGE(0x50),
+    SPD2010_INIT_REGS(1),
+        0x08, 0x55,
+    SPD2010_INIT_PAGE(0x00),
+    SPD2010_INIT_PAGE(0x10),
+    SPD2010_INIT_REGS(27),
+        0x0B, 0x43, 0x0C, 0x12, 0x10, 0x01, 0x11, 0x12, 0x15, 0x00, 0x16, 0x00, 0x1A, 0x00, 0x1B, 0x00,
+        0x61, 0x00, 0x62, 0x00, 0x51, 0x11, 0x55, 0x55, 0x58, 0x00, 0x5C, 0x00, 0x20, 0x81, 0x21, 0x82,
+        0x22, 0x72, 0x30, 0x00, 0x31, 0x00, 0x32, 0x00, 0x44, 0x44, 0x45, 0x55, 0x46, 0x66, 0x47, 0x77,
+        0x49, 0x00, 0x4A, 0x00, 0x4B, 0x00,
+    SPD2010_INIT_PAGE(0x17),
+    SPD2010_INIT_REGS(1),
+        0x37, 0x00,
+    SPD2010_INIT_PAGE(0x15),
+    SPD2010_INIT_REGS(12),
+        0x04, 0x08, 0x05, 0x04, 0x06, 0x1C, 0x07, 0x1A, 0x08, 0x18, 0x09, 0x16, 0x24, 0x05, 0x25, 0x09,
+        0x26, 0x17, 0x27, 0x19, 0x28, 0x1B, 0x29, 0x1D,
+    SPD2010_INIT_PAGE(0x16),
+    SPD2010_INIT_REGS(12),
+        0x04, 0x09, 0x05, 0x05, 0x06, 0x1D, 0x07, 0x1B, 0x08, 0x19, 0x09, 0x17, 0x24, 0x04, 0x25, 0x08,
+        0x26, 0x16, 0x27, 0x18, 0x28, 0x1A, 0x29, 0x1C,
+    SPD2010_INIT_PAGE(0x18),
+    SPD2010_INIT_REGS(1),
+        0x1F, 0x02,
+    SPD2010_INIT_PAGE(0x11),
+    SPD2010_INIT_REGS(7),
+        0x15, 0x99, 0x16, 0x99, 0x1C, 0x88, 0x1D, 0x88, 0x1E, 0x88, 0x13, 0xF0, 0x14, 0x34,
+    SPD2010_INIT_PAGE(0x12),
+    SPD2010_INIT_REGS(3),
+        0x12, 0x89, 0x06, 0x06, 0x18, 0x00,
+    SPD2010_INIT_PAGE(0x11),
+    SPD2010_INIT_REGS(4),
+        0x0A, 0x00, 0x0B, 0xF0, 0x0C, 0xF0, 0x6A, 0x10,
+    SPD2010_INIT_PAGE(0x00),
+    SPD2010_INIT_PAGE(0x11),
+    SPD2010_INIT_REGS(2),
+        0x08, 0x70, 0x09, 0x00,
+    SPD2010_INIT_PAGE(0x00),
+    SPD2010_INIT_REGS(1),
+        0x35, 0x00,
+    SPD2010_INIT_PAGE(0x12),
+    SPD2010_INIT_REGS(1),
+        0x21, 0x70,
+    SPD2010_INIT_PAGE(0x2D),
+    SPD2010_INIT_REGS(1),
+        0x02, 0x00,
+    SPD2010_INIT_PAGE(0x00),
+    SPD2010_INIT_CMD(0), 0x11,
 };
 
+static esp_err_t send_init_cmd(spd2010_panel_t *spd2010, int cmd, const uint8_t *data, size_t data_bytes, bool *is_user_set)
+{
+    // Check if the command has been used or conflicts with the internal only when command2 is disable
+    if (*is_user_set && (data_bytes > 0)) {
+        bool is_cmd_overwritten = true;
+        switch (cmd) {
+        case LCD_CMD_MADCTL:
+            spd2010->madctl_val = data[0];
+            break;
+        case LCD_CMD_COLMOD:
+            spd2010->colmod_val = data[0];
+            break;
+        default:
+            is_cmd_overwritten = false;
+            break;
+        }
+
+        if (is_cmd_overwritten) {
+            ESP_LOGW(TAG, "The %02Xh command has been used and will be overwritten by external initialization sequence",
+                     cmd);
+        }
+    }
+
+    ESP_RETURN_ON_ERROR(tx_param(spd2010, spd2010->io, cmd, data, data_bytes), TAG, "send command failed");
+
+    // Check if the current cmd is the "command set" cmd
+    if ((cmd == SPD2010_CMD_SET) && (data_bytes > 2)) {
+        *is_user_set = (data[2] == SPD2010_CMD_SET_USER);
+    } else if (cmd == LCD_CMD_SLPOUT) {
+        spd2010->sleep_out_us = esp_timer_get_time();
+    }
+    return ESP_OK;
+}
+
+static esp_err_t send_init_stream(spd2010_panel_t *spd2010, const uint8_t *stream, size_t size, bool *is_user_set)
+{
+    const uint8_t *end = stream + size;
+
+    while (stream < end) {
+        uint8_t op = *stream++;
+        if (op & SPD2010_INIT_OP_REGS) {
+            size_t count = op & ~SPD2010_INIT_OP_REGS;
+            ESP_RETURN_ON_FALSE((size_t)(end - stream) >= count * 2, ESP_ERR_INVALID_SIZE, TAG, "init stream truncated");
+            for (; count > 0; count--, stream += 2) {
+                ESP_RETURN_ON_ERROR(send_init_cmd(spd2010, stream[0], &stream[1], 1, is_user_set), TAG, "send command failed");
+            }
+        } else if (op == SPD2010_INIT_OP_PAGE || op == SPD2010_INIT_OP_DELAY) {
+            ESP_RETURN_ON_FALSE(stream < end, ESP_ERR_INVALID_SIZE, TAG, "init stream truncated");
+            uint8_t arg = *stream++;
+            if (op == SPD2010_INIT_OP_DELAY) {
+                vTaskDelay(pdMS_TO_TICKS(arg) + 1);
+                continue;
+            }
+            ESP_RETURN_ON_ERROR(send_init_cmd(spd2010, SPD2010_CMD_SET, (uint8_t[]) {
+                SPD2010_CMD_SET_BYTE0, SPD2010_CMD_SET_BYTE1, arg
+            }, 3, is_user_set), TAG, "send command failed");
+        } else {
+            ESP_RETURN_ON_FALSE(op < SPD2010_INIT_OP_PAGE && (size_t)(end - stream) > op, ESP_ERR_INVALID_SIZE, TAG,
+                                "bad init stream op %02X", op);
+            ESP_RETURN_ON_ERROR(send_init_cmd(spd2010, stream[0], &stream[1], op, is_user_set), TAG, "send command failed");
+            stream += 1 + op;
+        }
+    }
+    return ESP_OK;
+}
+
 static esp_err_t panel_spd2010_init(esp_lcd_panel_t *panel)
 {
     spd2010_panel_t *spd2010 = __containerof(panel, spd2010_panel_t, base);
     esp_lcd_panel_io_handle_t io = spd2010->io;
-    const spd2010_lcd_init_cmd_t *init_cmds = NULL;
-    uint16_t init_cmds_size = 0;
     bool is_user_set = true;
-    bool is_cmd_overwritten = false;
 
+    window_forget(spd2010);
     ESP_RETURN_ON_ERROR(tx_param(spd2010, io, SPD2010_CMD_SET, (uint8_t[]) {
         SPD2010_CMD_SET_BYTE0, SPD2010_CMD_SET_BYTE1, SPD2010_CMD_SET_USER
     }, 3), TAG, "send command failed");
@@ -622,48 +490,27 @@ static esp_err_t panel_spd2010_init(esp_lcd_panel_t *panel)
         spd2010->colmod_val,
     }, 1), TAG, "send command failed");
 
+    // The vendor registers outlive a reset of the host alone; the panel is still awake with them
+    if (spd2010->flags.skip_vendor_init) {
+        ESP_LOGD(TAG, "vendor init skipped");
+        return ESP_OK;
+    }
+
     // vendor specific initialization, it can be different between manufacturers
     // should consult the LCD supplier for initialization sequence code
-    if (spd2010->init_cmds) {
-        init_cmds = spd2010->init_cmds;
-        init_cmds_size = spd2010->init_cmds_size;
-    } else {
-        init_cmds = vendor_specific_init_default;
-        init_cmds_size = sizeof(vendor_specific_init_default) / sizeof(spd2010_lcd_init_cmd_t);
+    if (!spd2010->init_cmds) {
+        ESP_RETURN_ON_ERROR(send_init_stream(spd2010, vendor_specific_init_default, sizeof(vendor_specific_init_default),
+                                             &is_user_set), TAG, "send init stream failed");
+        ESP_LOGD(TAG, "send init commands success");
+        return ESP_OK;
     }
 
-    for (int i = 0; i < init_cmds_size; i++) {
-        // Check if the command has been used or conflicts with the internal only when command2 is disable
-        if (is_user_set && (init_cmds[i].data_bytes > 0)) {
-            switch (init_cmds[i].cmd) {
-            case LCD_CMD_MADCTL:
-                is_cmd_overwritten = true;
-                spd2010->madctl_val = ((uint8_t *)init_cmds[i].data)[0];
-                break;
-            case LCD_CMD_COLMOD:
-                is_cmd_overwritten = true;
-                spd2010->colmod_val = ((uint8_t *)init_cmds[i].data)[0];
-                break;
-            default:
-                is_cmd_overwritten = false;
-                break;
-            }
-
-            if (is_cmd_overwritten) {
-                is_cmd_overwritten = false;
-                ESP_LOGW(TAG, "The %02Xh command has been used and will be overwritten by external initialization sequence",
-                         init_cmds[i].cmd);
-            }
-        }
-
-        // Send command
-        ESP_RETURN_ON_ERROR(tx_param(spd2010, io, init_cmds[i].cmd, init_cmds[i].data, init_cmds[i].data_bytes), TAG,
-                            "send command failed");
-        vTaskDelay(pdMS_TO_TICKS(init_cmds[i].delay_ms));
-
-        // Check if the current cmd is the "command set" cmd
-        if ((init_cmds[i].cmd == SPD2010_CMD_SET) && (init_cmds[i].data_bytes > 2)) {
-            is_user_set = (((uint8_t *)init_cmds[i].data)[2] == SPD2010_CMD_SET_USER);
+    const spd2010_lcd_init_cmd_t *init_cmds = spd2010->init_cmds;
+    for (int i = 0; i < spd2010->init_cmds_size; i++) {
+        ESP_RETURN_ON_ERROR(send_init_cmd(spd2010, init_cmds[i].cmd, init_cmds[i].data, init_cmds[i].data_bytes,
+                                          &is_user_set), TAG, "send command failed");
+        if (init_cmds[i].delay_ms) {
+            vTaskDelay(pdMS_TO_TICKS(init_cmds[i].delay_ms));
         }
     }
     ESP_LOGD(TAG, "send init commands success");
@@ -682,19 +529,31 @@ static esp_err_t panel_spd2010_draw_bitmap(esp_lcd_panel_t *panel, int x_start,
     y_start += spd2010->y_gap;
     y_end += spd2010->y_gap;
 
-    // define an area of frame memory where MCU can access
-    ESP_RETURN_ON_ERROR(tx_param(spd2010, io, LCD_CMD_CASET, (uint8_t[]) {
-        (x_start >> 8) & 0xFF,
-        x_start & 0xFF,
-        ((x_end - 1) >> 8) & 0xFF,
-        (x_end - 1) & 0xFF,
-    }, 4), TAG, "send command failed");
-    ESP_RETURN_ON_ERROR(tx_param(spd2010, io, LCD_CMD_RASET, (uint8_t[]) {
-        (y_start >> 8) & 0xFF,
-        y_start & 0xFF,
-        ((y_end - 1) >> 8) & 0xFF,
-        (y_end - 1) & 0xFF,
-    }, 4), TAG, "send command failed");
+    // define an area of frame memory where MCU can access. Each command waits
+    // for the pixels already queued to finish, so only send what changed: bands
+    // of one flush share their columns, and RAMWR restarts at the window's start
+    if (x_start != spd2010->window[0] || x_end != spd2010->window[1]) {
+        spd2010->window[0] = -1;
+        ESP_RETURN_ON_ERROR(tx_param(spd2010, io, LCD_CMD_CASET, (uint8_t[]) {
+            (x_start >> 8) & 0xFF,
+            x_start & 0xFF,
+            ((x_end - 1) >> 8) & 0xFF,
+            (x_end - 1) & 0xFF,
+        }, 4), TAG, "send command failed");
+        spd2010->window[0] = x_start;
+        spd2010->window[1] = x_end;
+    }
+    if (y_start != spd2010->window[2] || y_end != spd2010->window[3]) {
+        spd2010->window[2] = -1;
+        ESP_RETURN_ON_ERROR(tx_param(spd2010, io, LCD_CMD_RASET, (uint8_t[]) {
+            (y_start >> 8) & 0xFF,
+            y_start & 0xFF,
+            ((y_end - 1) >> 8) & 0xFF,
+            (y_end - 1) & 0xFF,
+        }, 4), TAG, "send command failed");
+        spd2010->window[2] = y_start;
+        spd2010->window[3] = y_end;
+    }
     // transfer frame buffer
     size_t len = (x_end - x_start) * (y_end - y_start) * spd2010->fb_bits_per_pixel / 8;
     ESP_RETURN_ON_ERROR(tx_color(spd2010, io, LCD_CMD_RAMWR, color_data, len), TAG, "send color failed");
@@ -756,7 +615,14 @@ static esp_err_t panel_spd2010_disp_on_off(esp_lcd_panel_t *panel, bool on_off)
     esp_lcd_panel_io_handle_t io = spd2010->io;
     int command = 0;
 
+    window_forget(spd2010);
     if (on_off) {
+        // Wait out what is left of the settling time, overlapped with the caller's work since init
+        int64_t wait_us = spd2010->sleep_out_us + SPD2010_SLPOUT_SETTLE_MS * 1000 - esp_timer_get_time();
+        if (spd2010->sleep_out_us && wait_us > 0) {
+            vTaskDelay(pdMS_TO_TICKS((wait_us + 999) / 1000) + 1);
+        }
+        spd2010->sleep_out_us = 0;
         command = LCD_CMD_DISPON;
     } else {
         command = LCD_CMD_DISPOFF;
@@ -764,3 +630,15 @@ static esp_err_t panel_spd2010_disp_on_off(esp_lcd_panel_t *panel, bool on_off)
     ESP_RETURN_ON_ERROR(tx_param(spd2010, io, command, NULL, 0), TAG, "send command failed");
     return ESP_OK;
 }
+
+// Registers and frame memory are kept asleep; display on waits out the settling time after waking
+static esp_err_t panel_spd2010_disp_sleep(esp_lcd_panel_t *panel, bool sleep)
+{
+    spd2010_panel_t *spd2010 = __containerof(panel, spd2010_panel_t, base);
+
+    window_forget(spd2010);
+    ESP_RETURN_ON_ERROR(tx_param(spd2010, spd2010->io, sleep ? LCD_CMD_SLPIN : LCD_CMD_SLPOUT, NULL, 0), TAG,
+                        "send command failed");
+    spd2010->sleep_out_us = sleep ? 0 : esp_timer_get_time();
+    return ESP_OK;
+}
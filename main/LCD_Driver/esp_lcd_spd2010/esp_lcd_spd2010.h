@@ -40,6 +40,9 @@ typedef struct {
     uint16_t init_cmds_size;    /*<! Number of commands in above array */
     struct {
         unsigned int use_qspi_interface: 1;     /*<! Set to 1 if use QSPI interface, default is SPI interface */
+        unsigned int skip_vendor_init: 1;       /*<! Set to 1 if the panel kept its vendor registers and is awake (a reset of
+                                                 *   the host alone); init then sends only the user settings
+                                                 */
     } flags;
 } spd2010_vendor_config_t;
 
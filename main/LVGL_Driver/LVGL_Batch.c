@@ -0,0 +1,46 @@
+#include "LVGL_Batch.h"
+
+static uint32_t batch_depth;
+static bool batch_dirty;
+static lv_area_t batch_area;
+
+void LVGL_Batch_Begin(void)
+{
+    batch_depth++;
+}
+
+void LVGL_Batch_Commit(void)
+{
+    if (batch_depth == 0) {
+        return;
+    }
+    if (batch_depth > 1) {
+        batch_depth--;
+        return;
+    }
+
+    // The one layout pass, still inside the batch: objects it moves or
+    // resizes are merged into the box with the rest
+    lv_obj_update_layout(lv_scr_act());
+    lv_obj_update_layout(lv_layer_top());
+
+    batch_depth = 0;
+    if (batch_dirty) {
+        batch_dirty = false;
+        _lv_inv_area(lv_disp_get_default(), &batch_area);
+    }
+}
+
+bool LVGL_Batch_Take_Invalidation(const lv_area_t *area)
+{
+    if (batch_depth == 0) {
+        return false;
+    }
+    if (batch_dirty) {
+        _lv_area_join(&batch_area, &batch_area, area);
+    } else {
+        lv_area_copy(&batch_area, area);
+        batch_dirty = true;
+    }
+    return true;
+}
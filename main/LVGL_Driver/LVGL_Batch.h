@@ -0,0 +1,28 @@
+#pragma once
+#include <stdbool.h>
+#include "lvgl.h"
+
+/*
+ * Batched widget updates.
+ *
+ * Between LVGL_Batch_Begin() and the matching LVGL_Batch_Commit() nothing
+ * that is invalidated reaches LVGL's list of areas to redraw: the areas are
+ * merged into one bounding box instead. The commit runs the layout of the
+ * active screen and the top layer once, with what that moves merged in too,
+ * then invalidates the box. A state change that rewrites a status label,
+ * hides a spinner and updates the now playing fields so costs one layout
+ * pass and one dirty area, not one of each per widget, and can no longer
+ * fill the 32 area list and fall back to a full screen redraw.
+ *
+ * Batches nest; only the outermost commit does the work. Keep them short:
+ * two changes far apart redraw everything between them.
+ *
+ * LVGL thread only, never while a frame is being rendered.
+ */
+
+void LVGL_Batch_Begin(void);
+void LVGL_Batch_Commit(void);
+
+// For LVGL_Driver.c: the rounder drops an area invalidated inside a batch
+// once it has been merged into the batch's box
+bool LVGL_Batch_Take_Invalidation(const lv_area_t *area);
@@ -0,0 +1,173 @@
+#include "LVGL_Draw_S3.h"
+#include "src/draw/sw/lv_draw_sw.h"
+#include "dsps_mem.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "mem_task.h"
+#include "task_plan.h"
+
+#if !LV_COLOR_16_SWAP || LV_COLOR_DEPTH != 16
+#error "LVGL_Draw_S3 expects RGB565 with LV_COLOR_16_SWAP"
+#endif
+
+#if CONFIG_LVGL_DRAW_S3_PARALLEL
+#define BLEND_WORKER_STACK_SIZE     (2 * 1024)
+#define BLEND_WORKER_PRIORITY       TASK_PLAN_LVGL_BLEND_PRIORITY
+#define BLEND_WORKER_CORE           TASK_PLAN_LVGL_BLEND_CORE
+
+/* The half of a split blend the worker draws; its ctx is a copy with the clip cut to those rows */
+static struct {
+    lv_draw_sw_ctx_t ctx;
+    lv_area_t clip;
+    const lv_draw_sw_blend_dsc_t *dsc;
+} blend_job;
+static TaskHandle_t blend_worker;
+static SemaphoreHandle_t blend_done;
+#endif
+
+/* Solid fill: the first row by words, the rest copied from it (or memset if both bytes match) */
+static void LV_ATTRIBUTE_FAST_MEM fill_cover(lv_color_t *dest, lv_coord_t width, lv_coord_t height,
+                                             lv_coord_t stride, lv_color_t color)
+{
+    size_t row_bytes = width * sizeof(lv_color_t);
+    uint8_t low = color.full & 0xFF;
+    if (low == color.full >> 8) {
+        for (lv_coord_t y = 0; y < height; y++) {
+            dsps_memset(dest + y * stride, low, row_bytes);
+        }
+        return;
+    }
+
+    lv_coord_t x = 0;
+    if ((uintptr_t)dest & 2) {
+        dest[x++] = color;
+    }
+    uint32_t pair = (uint32_t)color.full | (uint32_t)color.full << 16;
+    uint32_t *words = (uint32_t *)(dest + x);
+    for (; x + 1 < width; x += 2) {
+        *words++ = pair;
+    }
+    if (x < width) {
+        dest[x] = color;
+    }
+
+    for (lv_coord_t y = 1; y < height; y++) {
+        dsps_memcpy(dest + y * stride, dest, row_bytes);
+    }
+}
+
+/* Opaque image: row copies */
+static void LV_ATTRIBUTE_FAST_MEM map_cover(lv_color_t *dest, lv_coord_t width, lv_coord_t height,
+                                            lv_coord_t dest_stride, const lv_color_t *src, lv_coord_t src_stride)
+{
+    size_t row_bytes = width * sizeof(lv_color_t);
+    for (lv_coord_t y = 0; y < height; y++) {
+        dsps_memcpy(dest + y * dest_stride, src + y * src_stride, row_bytes);
+    }
+}
+
+static void LV_ATTRIBUTE_FAST_MEM blend_rows(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc)
+{
+    lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+    bool masked = dsc->mask_buf && dsc->mask_res != LV_DRAW_MASK_RES_FULL_COVER;
+    if (masked || dsc->blend_mode != LV_BLEND_MODE_NORMAL || disp->driver->set_px_cb ||
+        disp->driver->screen_transp || dsc->opa < LV_OPA_MAX) {
+        lv_draw_sw_blend_basic(draw_ctx, dsc);
+        return;
+    }
+
+    lv_area_t blend_area;
+    if (!_lv_area_intersect(&blend_area, dsc->blend_area, draw_ctx->clip_area)) {
+        return;
+    }
+
+    lv_coord_t dest_stride = lv_area_get_width(draw_ctx->buf_area);
+    lv_color_t *dest = (lv_color_t *)draw_ctx->buf;
+    dest += dest_stride * (blend_area.y1 - draw_ctx->buf_area->y1) + (blend_area.x1 - draw_ctx->buf_area->x1);
+    lv_coord_t width = lv_area_get_width(&blend_area);
+    lv_coord_t height = lv_area_get_height(&blend_area);
+
+    if (dsc->src_buf) {
+        lv_coord_t src_stride = lv_area_get_width(dsc->blend_area);
+        const lv_color_t *src = dsc->src_buf;
+        src += src_stride * (blend_area.y1 - dsc->blend_area->y1) + (blend_area.x1 - dsc->blend_area->x1);
+        map_cover(dest, width, height, dest_stride, src, src_stride);
+    } else {
+        fill_cover(dest, width, height, dest_stride, dsc->color);
+    }
+}
+
+#if CONFIG_LVGL_DRAW_S3_PARALLEL
+static void Blend_Worker(void *parameter)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        blend_rows(&blend_job.ctx.base_draw, blend_job.dsc);
+        xSemaphoreGive(blend_done);
+    }
+    mem_task_delete(NULL);
+}
+
+/* A large blend: the lower rows on the worker, the upper ones here, then wait
+ * for both. Rows never overlap and blend_rows() keeps to the clip area, so the
+ * halves write disjoint memory and read only dsc and its buffers. */
+static bool LV_ATTRIBUTE_FAST_MEM blend_split(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc)
+{
+    lv_area_t blend_area;
+    if (!_lv_area_intersect(&blend_area, dsc->blend_area, draw_ctx->clip_area) ||
+        lv_area_get_size(&blend_area) < LVGL_DRAW_S3_SPLIT_MIN_PX || lv_area_get_height(&blend_area) < 2) {
+        return false;
+    }
+    // LVGL rounds the whole mask in place when antialiasing is off: not from two cores
+    lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+    if (disp->driver->set_px_cb || (dsc->mask_buf && !disp->driver->antialiasing)) {
+        return false;
+    }
+
+    lv_coord_t mid = blend_area.y1 + lv_area_get_height(&blend_area) / 2;
+    blend_job.ctx = *(lv_draw_sw_ctx_t *)draw_ctx;
+    blend_job.clip = blend_area;
+    blend_job.clip.y1 = mid;
+    blend_job.ctx.base_draw.clip_area = &blend_job.clip;
+    blend_job.dsc = dsc;
+    xTaskNotifyGive(blend_worker);
+
+    lv_draw_sw_ctx_t upper = *(lv_draw_sw_ctx_t *)draw_ctx;
+    lv_area_t upper_clip = blend_area;
+    upper_clip.y2 = mid - 1;
+    upper.base_draw.clip_area = &upper_clip;
+    blend_rows(&upper.base_draw, dsc);
+
+    xSemaphoreTake(blend_done, portMAX_DELAY);
+    return true;
+}
+#endif
+
+static void LV_ATTRIBUTE_FAST_MEM blend_s3(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc)
+{
+#if CONFIG_LVGL_DRAW_S3_PARALLEL
+    if (blend_worker && blend_split(draw_ctx, dsc)) {
+        return;
+    }
+#endif
+    blend_rows(draw_ctx, dsc);
+}
+
+void LVGL_Draw_S3_Init_Ctx(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx)
+{
+    lv_draw_sw_init_ctx(drv, draw_ctx);
+    ((lv_draw_sw_ctx_t *)draw_ctx)->blend = blend_s3;
+#if CONFIG_LVGL_DRAW_S3_PARALLEL
+    // Without the worker every blend is drawn here, as before
+    if (!blend_worker) {
+        blend_done = xSemaphoreCreateBinary();
+        if (!blend_done || !mem_task_create(Blend_Worker, "LVGL blend", BLEND_WORKER_STACK_SIZE, NULL,
+                                            BLEND_WORKER_PRIORITY, &blend_worker, BLEND_WORKER_CORE,
+                                            MEM_TASK_STACK_INTERNAL)) {
+            blend_worker = NULL;
+        }
+    }
+#endif
+}
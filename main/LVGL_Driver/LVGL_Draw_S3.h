@@ -0,0 +1,27 @@
+#pragma once
+#include "lvgl.h"
+
+/*
+ * ESP32-S3 blend path for LVGL's software renderer.
+ *
+ * Replaces lv_draw_sw_ctx_t::blend for opaque, unmasked draws in
+ * LV_BLEND_MODE_NORMAL and hands everything else to lv_draw_sw_blend_basic():
+ *   - solid fill         row memset/memcpy with the PIE kernels of esp-dsp
+ *   - image copy         row memcpy with the PIE kernel of esp-dsp
+ * Translucent fills stay with LVGL, which already premultiplies the colour
+ * and mixes once per run of equal background pixels.
+ * LV_COLOR_16_SWAP is set, so buffers are already in SPI byte order and no
+ * copy needs a byte swap.
+ *
+ * With CONFIG_LVGL_DRAW_S3_PARALLEL a blend of LVGL_DRAW_S3_SPLIT_MIN_PX or
+ * more, of either kind, is cut in two by rows: a worker on the other core
+ * draws the lower half while the LVGL thread draws the upper one. Full
+ * screen fills, wallpapers and fades of a transition take about half as
+ * long. LVGL 8 walks the objects, builds masks and rasterises glyphs on one
+ * thread only, so small blends (text, thin arcs) are drawn as before.
+ */
+
+#define LVGL_DRAW_S3_SPLIT_MIN_PX   (16 * 1024)    // Below this the hand-off costs more than it saves
+
+// Use as lv_disp_drv_t::draw_ctx_init (draw_ctx_size stays sizeof(lv_draw_sw_ctx_t))
+void LVGL_Draw_S3_Init_Ctx(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx);
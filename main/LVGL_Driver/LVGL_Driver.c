@@ -1,4 +1,12 @@
 #include "LVGL_Driver.h"
+#include "LVGL_Draw_S3.h"
+#include "LVGL_Scroll.h"
+#include "LVGL_Batch.h"
+#include "LVGL_Latency.h"
+#include "misc/lv_gc.h"
+#include <math.h>
+#include "telemetry.h"
+#include "telemetry_trace.h"
 
 static const char *TAG_LVGL = "LVGL";
 
@@ -8,13 +16,116 @@ lv_disp_draw_buf_t disp_buf;                                                 //
 lv_disp_drv_t disp_drv;                                                      // contains callback functions
 lv_indev_drv_t indev_drv;
 
+#if CONFIG_LVGL_BUFFER_PSRAM_BOUNCE
+static lv_color_t *bounce_buf[2];
+static SemaphoreHandle_t bounce_free;        // Bounce buffers not queued for DMA
+static int bounce_next;
+#endif
+
+#if CONFIG_LCD_ROUND_MASK
+// First and last visible pixel of each row of the round panel; the panel is
+// square, so the same table gives each column's visible rows
+static int16_t round_chord_start[EXAMPLE_LCD_HEIGHT];
+static int16_t round_chord_end[EXAMPLE_LCD_HEIGHT];
+#endif
+static int flush_pending;                    // Transfers of the current flush still in flight
+static telemetry_hist_t *flush_hist;         // Looked up once: the ISR records into it
+static int64_t flush_start_us;               // When the current flush started
+
+static lv_timer_t *deferred[LVGL_DEFER_MAX_TIMERS];   // Timers waiting for the scroll or animation to end
+static uint32_t deferred_since;             // lv_tick_get() of the first deferral
+
+static esp_timer_handle_t lvgl_tick_timer = NULL;
+static int64_t tick_paused_us;              // esp_timer_get_time() when paused, 0 while running
+
 void example_increase_lvgl_tick(void *arg)
 {
     /* Tell LVGL how many milliseconds has elapsed */
     lv_tick_inc(EXAMPLE_LVGL_TICK_PERIOD_MS);
 }
+
+void LVGL_Tick_Pause(void)
+{
+    if (lvgl_tick_timer && !tick_paused_us && esp_timer_stop(lvgl_tick_timer) == ESP_OK) {
+        tick_paused_us = esp_timer_get_time();
+    }
+}
+
+void LVGL_Tick_Resume(void)
+{
+    if (!tick_paused_us) {
+        return;
+    }
+    lv_tick_inc((uint32_t)((esp_timer_get_time() - tick_paused_us) / 1000));
+    tick_paused_us = 0;
+    ESP_ERROR_CHECK(esp_timer_start_periodic(lvgl_tick_timer, EXAMPLE_LVGL_TICK_PERIOD_MS * 1000));
+}
+#if CONFIG_LCD_ROUND_MASK
+static void LVGL_Init_Round_Mask(void)
+{
+  const float radius = EXAMPLE_LCD_WIDTH / 2.0f;
+  for (int i = 0; i < EXAMPLE_LCD_HEIGHT; i++) {
+    float d = i + 0.5f - radius;                              // Pixel centre to circle centre
+    float half = sqrtf(radius * radius - d * d);
+    round_chord_start[i] = (int16_t)ceilf(radius - half - 0.5f);
+    round_chord_end[i] = (int16_t)floorf(radius + half - 0.5f);
+  }
+}
+
+/* Visible columns of rows y1..y2 within x1..x2, 4-aligned like the rounder; false if none */
+static bool round_span(int y1, int y2, int *x1, int *x2)
+{
+  // Chords are nested around the centre: the widest is the row closest to it
+  int mid = EXAMPLE_LCD_HEIGHT / 2;
+  int row = y2 < mid ? y2 : (y1 > mid ? y1 : mid);
+  int start = round_chord_start[row] > *x1 ? round_chord_start[row] : *x1;
+  int end = round_chord_end[row] < *x2 ? round_chord_end[row] : *x2;
+  if (start > end) {
+    return false;
+  }
+  *x1 = (start >> 2) << 2;
+  *x2 = ((end >> 2) << 2) + 3;
+  return true;
+}
+#endif
+
 void Lvgl_port_rounder_callback(struct _lv_disp_drv_t * disp_drv, lv_area_t * area)
 {
+  // A scrolled container's own invalidation, already covered by the scroll blit
+  if (LVGL_Scroll_Take_Invalidation(area)) {
+    area->x1 = 0;
+    area->x2 = 3;
+    area->y1 = 0;
+    area->y2 = 0;
+    return;
+  }
+  // Inside a batch: redrawn at the commit, merged with the batch's other areas
+  if (LVGL_Batch_Take_Invalidation(area)) {
+    area->x1 = 0;
+    area->x2 = 3;
+    area->y1 = 0;
+    area->y2 = 0;
+    return;
+  }
+#if CONFIG_LCD_ROUND_MASK
+  // Shrink to the bounding box of the part inside the circle, so corners are
+  // never rendered. An area with no visible pixel is collapsed onto the
+  // top-left block, which is outside the circle and cheap to render.
+  int mid = EXAMPLE_LCD_WIDTH / 2;
+  int vis_x1 = area->x1, vis_x2 = area->x2;
+  int col = vis_x2 < mid ? vis_x2 : (vis_x1 > mid ? vis_x1 : mid);
+  if (area->y1 < round_chord_start[col]) area->y1 = round_chord_start[col];
+  if (area->y2 > round_chord_end[col]) area->y2 = round_chord_end[col];
+  if (area->y1 > area->y2 || !round_span(area->y1, area->y2, &vis_x1, &vis_x2)) {
+    area->x1 = 0;
+    area->x2 = 3;
+    area->y1 = 0;
+    area->y2 = 0;
+    return;
+  }
+  area->x1 = vis_x1;
+  area->x2 = vis_x2;
+#endif
   uint16_t x1 = area->x1;
   uint16_t x2 = area->x2;
 
@@ -25,6 +136,29 @@ void Lvgl_port_rounder_callback(struct _lv_disp_drv_t * disp_drv, lv_area_t * ar
   area->x2 = ((x2 >> 2) << 2) + 3;
 }
 
+/* Color transfer finished (DMA done, ISR context): the buffer may be drawn into again */
+bool example_notify_lvgl_flush_ready(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx)
+{
+#if CONFIG_LVGL_BUFFER_PSRAM_BOUNCE
+    // The frame buffer was released after copying; this frees a bounce buffer
+    BaseType_t task_woken = pdFALSE;
+    xSemaphoreGiveFromISR(bounce_free, &task_woken);
+    if (uxSemaphoreGetCountFromISR(bounce_free) == 2) {
+        LVGL_Latency_Mark(LVGL_LATENCY_FLUSH);     // Nothing left in flight
+    }
+    return task_woken == pdTRUE;
+#else
+    // A flush may be sent as several bands; the last one releases the buffer
+    if (__atomic_sub_fetch(&flush_pending, 1, __ATOMIC_ACQ_REL) == 0) {
+        lv_disp_drv_t *disp_driver = (lv_disp_drv_t *)user_ctx;
+        LVGL_Latency_Mark(LVGL_LATENCY_FLUSH);
+        telemetry_hist_record(flush_hist, (uint32_t)(esp_timer_get_time() - flush_start_us));
+        lv_disp_flush_ready(disp_driver);
+    }
+    return false;
+#endif
+}
+
 void example_lvgl_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
 {
     esp_lcd_panel_handle_t panel_handle = (esp_lcd_panel_handle_t) drv->user_data;
@@ -32,9 +166,228 @@ void example_lvgl_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t
     int offsetx2 = area->x2;
     int offsety1 = area->y1;
     int offsety2 = area->y2;
-    // copy a buffer's content to a specific area of the display
-    esp_lcd_panel_draw_bitmap(panel_handle, offsetx1, offsety1, offsetx2 +1, offsety2 + 1, color_map);
+    TELEMETRY_TRACE_BEGIN(TELEMETRY_TRACE_LVGL_FLUSH);
+    flush_start_us = esp_timer_get_time();
+#if !CONFIG_LVGL_BUFFER_PSRAM_BOUNCE
+    if (lv_disp_flush_is_last(drv)) {
+        LVGL_Latency_Mark(LVGL_LATENCY_RENDER);
+    }
+#endif
+#if CONFIG_LCD_TE_SYNC && !CONFIG_LVGL_BUFFER_DIRECT_MODE
+    // Start tall areas in vertical blanking so the scan never overtakes the write
+    if (offsety2 - offsety1 + 1 >= CONFIG_LCD_TE_SYNC_MIN_LINES) {
+        LCD_Wait_TE();
+    }
+#endif
+#if CONFIG_LVGL_BUFFER_DIRECT_MODE
+    // Every area of the frame is flushed with the whole frame and is already
+    // drawn in it: wait for the last, then send the rows of all dirty and
+    // scroll-copied areas at full width, where they are contiguous
+    if (!lv_disp_flush_is_last(drv)) {
+        lv_disp_flush_ready(drv);
+        TELEMETRY_TRACE_END(TELEMETRY_TRACE_LVGL_FLUSH);
+        return;
+    }
+    lv_disp_t *refr_disp = _lv_refr_get_disp_refreshing();
+    const lv_area_t *copied;
+    uint32_t copied_count = LVGL_Scroll_Get_Copied(&copied);
+    lv_area_t rows[LV_INV_BUF_SIZE + LVGL_SCROLL_MAX_COPIES];
+    int row_count = 0;
+    for (uint32_t i = 0; i < refr_disp->inv_p + copied_count && row_count < (int)(sizeof(rows) / sizeof(rows[0])); i++) {
+        const lv_area_t *dirty = i < refr_disp->inv_p ? &refr_disp->inv_areas[i] : &copied[i - refr_disp->inv_p];
+        if (i < refr_disp->inv_p && refr_disp->inv_area_joined[i]) {
+            continue;
+        }
+        // Sorted by first row, then merged where they touch
+        int pos = row_count;
+        while (pos > 0 && rows[pos - 1].y1 > dirty->y1) {
+            rows[pos] = rows[pos - 1];
+            pos--;
+        }
+        rows[pos] = (lv_area_t){ .y1 = dirty->y1, .y2 = dirty->y2 };
+        row_count++;
+    }
+    int band_count = 0;
+    int total_lines = 0;
+    for (int i = 0; i < row_count; i++) {
+        if (band_count > 0 && rows[i].y1 <= rows[band_count - 1].y2 + 1) {
+            if (rows[i].y2 > rows[band_count - 1].y2) {
+                rows[band_count - 1].y2 = rows[i].y2;
+            }
+        } else {
+            rows[band_count++] = rows[i];
+        }
+    }
+    for (int i = 0; i < band_count; i++) {
+        total_lines += rows[i].y2 - rows[i].y1 + 1;
+    }
+    if (band_count == 0) {
+        LVGL_Latency_Mark(LVGL_LATENCY_FLUSH);
+        lv_disp_flush_ready(drv);
+        TELEMETRY_TRACE_END(TELEMETRY_TRACE_LVGL_FLUSH);
+        return;
+    }
+#if CONFIG_LCD_TE_SYNC
+    if (total_lines >= CONFIG_LCD_TE_SYNC_MIN_LINES) {
+        LCD_Wait_TE();
+    }
+#endif
+    __atomic_store_n(&flush_pending, band_count, __ATOMIC_RELEASE);
+    for (int i = 0; i < band_count; i++) {
+        if (esp_lcd_panel_draw_bitmap(panel_handle, 0, rows[i].y1, EXAMPLE_LCD_WIDTH, rows[i].y2 + 1,
+                                      color_map + rows[i].y1 * EXAMPLE_LCD_WIDTH) != ESP_OK) {
+            // The remaining bands will never complete
+            if (__atomic_sub_fetch(&flush_pending, band_count - i, __ATOMIC_ACQ_REL) == 0) {
+                lv_disp_flush_ready(drv);
+            }
+            break;
+        }
+    }
+#elif CONFIG_LVGL_BUFFER_PSRAM_BOUNCE
+    // Copy out through the internal bounce buffers, alternating so one fills
+    // while the other is sent; the frame buffer is free once all is copied
+    int width = offsetx2 - offsetx1 + 1;
+    int chunk_lines = LVGL_BOUNCE_BUF_LEN / width;
+#if CONFIG_LCD_ROUND_MASK
+    if (chunk_lines > LCD_ROUND_BAND_LINES) {
+        chunk_lines = LCD_ROUND_BAND_LINES;
+    }
+#endif
+    for (int y = offsety1; y <= offsety2; y += chunk_lines) {
+        int lines = (offsety2 - y + 1) < chunk_lines ? (offsety2 - y + 1) : chunk_lines;
+        int x1 = offsetx1, x2 = offsetx2;
+#if CONFIG_LCD_ROUND_MASK
+        // Only the columns inside the circle, copied row by row
+        if (!round_span(y, y + lines - 1, &x1, &x2)) {
+            continue;
+        }
+#endif
+        int span = x2 - x1 + 1;
+        xSemaphoreTake(bounce_free, portMAX_DELAY);
+        lv_color_t *bounce = bounce_buf[bounce_next];
+        bounce_next ^= 1;
+        for (int row = 0; row < lines; row++) {
+            memcpy(bounce + row * span, color_map + (y - offsety1 + row) * width + (x1 - offsetx1),
+                   span * sizeof(lv_color_t));
+        }
+        if (esp_lcd_panel_draw_bitmap(panel_handle, x1, y, x2 + 1, y + lines, bounce) != ESP_OK) {
+            xSemaphoreGive(bounce_free);
+        }
+    }
+    // Rendered once all is queued; the ISR marks the flush when both
+    // buffers come back, or they already have
+    if (lv_disp_flush_is_last(drv)) {
+        LVGL_Latency_Mark(LVGL_LATENCY_RENDER);
+        if (uxSemaphoreGetCount(bounce_free) == 2) {
+            LVGL_Latency_Mark(LVGL_LATENCY_FLUSH);
+        }
+    }
+    // Done with the frame buffer once copied out: that is the flush LVGL waits for
+    telemetry_hist_record(flush_hist, (uint32_t)(esp_timer_get_time() - flush_start_us));
     lv_disp_flush_ready(drv);
+#elif CONFIG_LCD_ROUND_MASK
+    // Send the area as bands of LCD_ROUND_BAND_LINES rows, each cut to the
+    // columns inside the circle. The bands are packed in place first (a band
+    // is never wider than the area, so data only moves towards the start),
+    // then queued together; the last transfer releases the buffer.
+    int width = offsetx2 - offsetx1 + 1;
+    lv_area_t bands[EXAMPLE_LCD_HEIGHT / LCD_ROUND_BAND_LINES + 1];
+    lv_color_t *band_data[EXAMPLE_LCD_HEIGHT / LCD_ROUND_BAND_LINES + 1];
+    int band_count = 0;
+    lv_color_t *packed = color_map;
+    for (int y = offsety1; y <= offsety2; y += LCD_ROUND_BAND_LINES) {
+        int y2 = (y + LCD_ROUND_BAND_LINES - 1) < offsety2 ? (y + LCD_ROUND_BAND_LINES - 1) : offsety2;
+        int x1 = offsetx1, x2 = offsetx2;
+        if (!round_span(y, y2, &x1, &x2)) {
+            continue;
+        }
+        int span = x2 - x1 + 1;
+        band_data[band_count] = packed;
+        for (int row = y; row <= y2; row++) {
+            memmove(packed, color_map + (row - offsety1) * width + (x1 - offsetx1), span * sizeof(lv_color_t));
+            packed += span;
+        }
+        bands[band_count++] = (lv_area_t){ .x1 = x1, .y1 = y, .x2 = x2, .y2 = y2 };
+    }
+    if (band_count == 0) {
+        LVGL_Latency_Mark(LVGL_LATENCY_FLUSH);
+        lv_disp_flush_ready(drv);
+        TELEMETRY_TRACE_END(TELEMETRY_TRACE_LVGL_FLUSH);
+        return;
+    }
+    __atomic_store_n(&flush_pending, band_count, __ATOMIC_RELEASE);
+    for (int i = 0; i < band_count; i++) {
+        if (esp_lcd_panel_draw_bitmap(panel_handle, bands[i].x1, bands[i].y1, bands[i].x2 + 1, bands[i].y2 + 1,
+                                      band_data[i]) != ESP_OK) {
+            // The remaining bands will never complete
+            if (__atomic_sub_fetch(&flush_pending, band_count - i, __ATOMIC_ACQ_REL) == 0) {
+                lv_disp_flush_ready(drv);
+            }
+            break;
+        }
+    }
+#else
+    // copy a buffer's content to a specific area of the display; LVGL renders
+    // into the other buffer until example_notify_lvgl_flush_ready() releases this one
+    __atomic_store_n(&flush_pending, 1, __ATOMIC_RELEASE);
+    if (esp_lcd_panel_draw_bitmap(panel_handle, offsetx1, offsety1, offsetx2 +1, offsety2 + 1, color_map) != ESP_OK) {
+        lv_disp_flush_ready(drv);
+    }
+#endif
+    TELEMETRY_TRACE_END(TELEMETRY_TRACE_LVGL_FLUSH);
+}
+
+/* A scroll is being dragged or thrown, or a finite animation (not a marquee) is running */
+static bool LVGL_Busy(void)
+{
+    for (lv_indev_t *indev = lv_indev_get_next(NULL); indev; indev = lv_indev_get_next(indev)) {
+        if (lv_indev_get_scroll_obj(indev)) {
+            return true;
+        }
+    }
+    lv_anim_t *anim;
+    _LV_LL_READ(&LV_GC_ROOT(_lv_anim_ll), anim) {
+        if (anim->repeat_cnt != LV_ANIM_REPEAT_INFINITE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void LVGL_Release_Deferred(void)
+{
+    for (int i = 0; i < LVGL_DEFER_MAX_TIMERS && deferred[i]; i++) {
+        // Run it now unless it was deleted meanwhile
+        for (lv_timer_t *timer = lv_timer_get_next(NULL); timer; timer = lv_timer_get_next(timer)) {
+            if (timer == deferred[i]) {
+                lv_timer_ready(timer);
+                break;
+            }
+        }
+        deferred[i] = NULL;
+    }
+}
+
+bool LVGL_Timer_Defer(lv_timer_t *timer)
+{
+    if (!LVGL_Busy()) {
+        return false;
+    }
+    if (!deferred[0]) {
+        deferred_since = lv_tick_get();
+    } else if (lv_tick_elaps(deferred_since) >= LVGL_DEFER_MAX_MS) {
+        return false;
+    }
+    for (int i = 0; i < LVGL_DEFER_MAX_TIMERS; i++) {
+        if (deferred[i] == timer) {
+            return true;
+        }
+        if (!deferred[i]) {
+            deferred[i] = timer;
+            return true;
+        }
+    }
+    return false;
 }
 
 /*Read the touchpad*/
@@ -44,7 +397,7 @@ void example_touchpad_read( lv_indev_drv_t * drv, lv_indev_data_t * data )
     uint16_t touchpad_y[5] = {0};
     uint8_t touchpad_cnt = 0;
    
-    /* Get coordinates */
+    /* Get coordinates (latest sample from the touch task, no I2C here) */
     bool touchpad_pressed = Touch_Get_xy( touchpad_x, touchpad_y, NULL, &touchpad_cnt, CONFIG_ESP_LCD_TOUCH_MAX_POINTS);
 
     // printf("CCCCCCCCCCCCC=%d  \r\n",touchpad_cnt);
@@ -52,12 +405,25 @@ void example_touchpad_read( lv_indev_drv_t * drv, lv_indev_data_t * data )
         data->point.x = touchpad_x[0];
         data->point.y = touchpad_y[0];
         data->state = LV_INDEV_STATE_PR;
+        LVGL_Latency_Mark(LVGL_LATENCY_INDEV_READ);
         // printf("X=%u Y=%u num=%d \r\n", data->point.x, data->point.y,touchpad_cnt);
     } else {
         data->state = LV_INDEV_STATE_REL;
     }
-   
+
+    // Read every indev period, so deferred timers run as soon as the UI settles
+    if (deferred[0] && !LVGL_Busy()) {
+        LVGL_Release_Deferred();
+    }
+}
+#if CONFIG_LVGL_LATENCY_PROBE
+/* LVGL sends an input event, before its callbacks run */
+static void LVGL_Touchpad_Feedback(lv_indev_drv_t *drv, uint8_t code)
+{
+    LVGL_Latency_Mark(LVGL_LATENCY_EVENT);
 }
+#endif
+
 /* Rotate display and touch, when rotated screen in LVGL. Called when driver parameters are updated. */
 void example_lvgl_port_update_callback(lv_disp_drv_t *drv)
 {
@@ -89,16 +455,83 @@ void example_lvgl_port_update_callback(lv_disp_drv_t *drv)
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 lv_disp_t *disp;
-void LVGL_Init(void)
+
+/* Allocate the draw buffers for the configured strategy (CONFIG_LVGL_BUFFER_*) */
+static void LVGL_Init_Buffers(void)
 {
-    ESP_LOGI(TAG_LVGL, "Initialize LVGL library");
-    lv_init();
-    
+#if CONFIG_LVGL_BUFFER_INTERNAL_DMA
+    // Tallest pair that still leaves the reserve in internal RAM
+    for (int lines = LVGL_DMA_BUF_MAX_LINES; lines >= LVGL_DMA_BUF_MIN_LINES; lines -= 10) {
+        size_t len = EXAMPLE_LCD_WIDTH * lines;
+        size_t size = len * sizeof(lv_color_t);
+        if (heap_caps_get_free_size(MALLOC_CAP_INTERNAL) < 2 * size + LVGL_INTERNAL_RAM_RESERVE) {
+            continue;
+        }
+        lv_color_t *buf1 = heap_caps_malloc(size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        lv_color_t *buf2 = heap_caps_malloc(size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        if (buf1 && buf2) {
+            ESP_LOGI(TAG_LVGL, "Draw buffers: 2 x %d lines in internal RAM", lines);
+            lv_disp_draw_buf_init(&disp_buf, buf1, buf2, len);
+            return;
+        }
+        heap_caps_free(buf1);
+        heap_caps_free(buf2);
+    }
+    ESP_LOGW(TAG_LVGL, "Not enough internal RAM for draw buffers, using PSRAM");
+#elif CONFIG_LVGL_BUFFER_PSRAM_BOUNCE
+    lv_color_t *frame = heap_caps_malloc(LVGL_FRAME_LEN * sizeof(lv_color_t), MALLOC_CAP_SPIRAM);
+    bounce_buf[0] = heap_caps_malloc(LVGL_BOUNCE_BUF_LEN * sizeof(lv_color_t), MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    bounce_buf[1] = heap_caps_malloc(LVGL_BOUNCE_BUF_LEN * sizeof(lv_color_t), MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    bounce_free = xSemaphoreCreateCounting(2, 2);
+    assert(frame && bounce_buf[0] && bounce_buf[1] && bounce_free);
+    ESP_LOGI(TAG_LVGL, "Draw buffer: full frame in PSRAM, 2 x %d line bounce buffers",
+             LVGL_BOUNCE_BUF_LEN / EXAMPLE_LCD_WIDTH);
+    lv_disp_draw_buf_init(&disp_buf, frame, NULL, LVGL_FRAME_LEN);
+    return;
+#elif CONFIG_LVGL_BUFFER_DIRECT_MODE
+    lv_color_t *buf1 = heap_caps_malloc(LVGL_FRAME_LEN * sizeof(lv_color_t), MALLOC_CAP_SPIRAM);
+    lv_color_t *buf2 = heap_caps_malloc(LVGL_FRAME_LEN * sizeof(lv_color_t), MALLOC_CAP_SPIRAM);
+    assert(buf1 && buf2);
+    ESP_LOGI(TAG_LVGL, "Draw buffers: 2 full frames in PSRAM (direct mode)");
+    lv_disp_draw_buf_init(&disp_buf, buf1, buf2, LVGL_FRAME_LEN);
+    return;
+#endif
+
     lv_color_t *buf1 = heap_caps_malloc(LVGL_BUF_LEN * sizeof(lv_color_t), MALLOC_CAP_SPIRAM);
     assert(buf1);
     lv_color_t *buf2 = heap_caps_malloc(LVGL_BUF_LEN * sizeof(lv_color_t) , MALLOC_CAP_SPIRAM);    
     assert(buf2);
     lv_disp_draw_buf_init(&disp_buf, buf1, buf2, LVGL_BUF_LEN);                              // initialize LVGL draw buffers
+}
+
+// Called once per refresh with the render and flush time in ms
+static void LVGL_Monitor_Callback(lv_disp_drv_t *drv, uint32_t time, uint32_t px)
+{
+    telemetry_record(TELEMETRY_LVGL_FRAME, time);
+    LVGL_Scroll_Frame_Done(disp);
+}
+
+// The heap walk is not free, so only once per telemetry sample
+static void LVGL_Mem_Timer_Callback(lv_timer_t *timer)
+{
+    if (LVGL_Timer_Defer(timer)) {
+        return;
+    }
+    lv_mem_monitor_t mon;
+    lv_mem_monitor(&mon);
+    telemetry_set_lvgl_mem(mon.total_size - mon.free_size, mon.free_biggest_size);
+}
+
+void LVGL_Init(void)
+{
+    ESP_LOGI(TAG_LVGL, "Initialize LVGL library");
+    lv_init();
+    
+    LVGL_Init_Buffers();
+    flush_hist = telemetry_hist_get("lvgl flush", TELEMETRY_HIST_US);
+#if CONFIG_LCD_ROUND_MASK
+    LVGL_Init_Round_Mask();
+#endif
 
     ESP_LOGI(TAG_LVGL, "Register display driver to LVGL");
     lv_disp_drv_init(&disp_drv);                                                                        // Create a new screen object and initialize the associated device
@@ -108,15 +541,31 @@ void LVGL_Init(void)
     disp_drv.flush_cb = example_lvgl_flush_cb;                                                          // Function : copy a buffer's content to a specific area of the display
     disp_drv.drv_update_cb = example_lvgl_port_update_callback;         
     disp_drv.rounder_cb = Lvgl_port_rounder_callback;                                    // Function : Rotate display and touch, when rotated screen in LVGL. Called when driver parameters are updated. 
-    disp_drv.draw_buf = &disp_buf;                                                                  // LVGL will use this buffer(s) to draw the screens contents
+    disp_drv.draw_buf = &disp_buf;
+    disp_drv.monitor_cb = LVGL_Monitor_Callback;                                                    // Frame time and FPS for the diagnostics tab
+#if CONFIG_LVGL_DRAW_S3_ACCEL
+    disp_drv.draw_ctx_init = LVGL_Draw_S3_Init_Ctx;                                                  // SW renderer with the S3 fill/copy blend path
+#endif
+#if CONFIG_LVGL_BUFFER_DIRECT_MODE
+    disp_drv.direct_mode = 1;                                                                       // Buffers are whole frames; LVGL syncs the dirty areas between them
+#endif                                                                  // LVGL will use this buffer(s) to draw the screens contents
     disp_drv.user_data = panel_handle;                
     ESP_LOGI(TAG_LVGL,"Register display indev to LVGL");                                                  // Custom display driver user data
     disp = lv_disp_drv_register(&disp_drv);     
+
+    // Flushes complete from the panel IO's transfer-done callback
+    const esp_lcd_panel_io_callbacks_t io_callbacks = {
+        .on_color_trans_done = example_notify_lvgl_flush_ready,
+    };
+    ESP_ERROR_CHECK(esp_lcd_panel_io_register_event_callbacks(io_handle, &io_callbacks, &disp_drv));
     
     lv_indev_drv_init ( &indev_drv );
     indev_drv.type = LV_INDEV_TYPE_POINTER;
     indev_drv.disp = disp;
     indev_drv.read_cb = example_touchpad_read;
+#if CONFIG_LVGL_LATENCY_PROBE
+    indev_drv.feedback_cb = LVGL_Touchpad_Feedback;
+#endif
     lv_indev_drv_register( &indev_drv );
 
     /********************* LVGL *********************/
@@ -127,8 +576,9 @@ void LVGL_Init(void)
         .name = "lvgl_tick"
     };
     
-    esp_timer_handle_t lvgl_tick_timer = NULL;
     ESP_ERROR_CHECK(esp_timer_create(&lvgl_tick_timer_args, &lvgl_tick_timer));
     ESP_ERROR_CHECK(esp_timer_start_periodic(lvgl_tick_timer, EXAMPLE_LVGL_TICK_PERIOD_MS * 1000));
 
+    lv_timer_create(LVGL_Mem_Timer_Callback, TELEMETRY_PERIOD_MS, NULL);
+
 }
@@ -11,15 +11,30 @@
 #include "Display_SPD2010.h"
 
 #define LVGL_BUF_LEN  (EXAMPLE_LCD_WIDTH * EXAMPLE_LCD_HEIGHT / 20)
+#define LVGL_FRAME_LEN  (EXAMPLE_LCD_WIDTH * EXAMPLE_LCD_HEIGHT)
+#define LVGL_DMA_BUF_MAX_LINES  (ESP_PANEL_HOST_SPI_MAX_TRANSFER_SIZE / (EXAMPLE_LCD_WIDTH * (int)sizeof(lv_color_t)))  // Internal double buffers: tallest tried, one transaction
+#define LVGL_DMA_BUF_MIN_LINES  (10)           // ... and shortest accepted
+#define LVGL_INTERNAL_RAM_RESERVE  (64 * 1024) // Internal heap left for WiFi/TLS after allocating them
+#define LVGL_BOUNCE_BUF_LEN  (EXAMPLE_LCD_WIDTH * 20)  // Each of the two bounce buffers (PSRAM_BOUNCE)
+#define LCD_ROUND_BAND_LINES  (16)             // Rows per clipped transfer (LCD_ROUND_MASK)
 #define EXAMPLE_LVGL_TICK_PERIOD_MS    2
+#define LVGL_DEFER_MAX_TIMERS  (8)             // Timers LVGL_Timer_Defer() holds at once
+#define LVGL_DEFER_MAX_MS  (1000)              // ... and for how long at most
 
 extern lv_disp_draw_buf_t disp_buf;                                                 // contains internal graphic buffer(s) called draw buffer(s)
 extern lv_disp_drv_t disp_drv;                                                      // contains callback functions
 extern lv_disp_t *disp;    
 
 void example_lvgl_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map);
+bool example_notify_lvgl_flush_ready(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx);
 /* Rotate display and touch, when rotated screen in LVGL. Called when driver parameters are updated. */
 void example_lvgl_port_update_callback(lv_disp_drv_t *drv);
 void example_increase_lvgl_tick(void *arg);
+/* LVGL thread: stop the 2 ms tick timer, and restart it with the time stopped added to the tick */
+void LVGL_Tick_Pause(void);
+void LVGL_Tick_Resume(void);
+/* For timer callbacks that can wait: true (return at once) while a scroll or an animation is on screen.
+ * The timer is then run once the UI settles, or is let through after LVGL_DEFER_MAX_MS. */
+bool LVGL_Timer_Defer(lv_timer_t *timer);
 
 void LVGL_Init(void);                     // Call this function to initialize the screen (must be called in the main function) !!!!!
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include "LVGL_Idle.h"
+#include <stdatomic.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include "LVGL_Driver.h"
+#include "Power_Manager.h"
+#include "gui_event_bus.h"
+
+static const char *TAG_IDLE = "LVGL idle";
+
+#if CONFIG_LVGL_IDLE_MODE
+static lv_disp_t *idle_disp;
+static atomic_bool asleep;
+
+static void LVGL_Idle_Wake_Call(void *arg)
+{
+  lv_disp_trig_activity(NULL);
+}
+
+void LVGL_Idle_Start(lv_disp_t *disp)
+{
+  idle_disp = disp;
+}
+
+bool LVGL_Idle_Sleep(void)
+{
+  if (!idle_disp || lv_disp_get_inactive_time(idle_disp) < LVGL_IDLE_AFTER_MS) {
+    return false;
+  }
+  if (idle_disp->inv_p > 0) {
+    return false;                           // Let the refresh timer draw it first
+  }
+  if (Power_Get_Profile() < POWER_PROFILE_IDLE && lv_anim_count_running() > 0) {
+    return false;
+  }
+  uint32_t sleep_ms = Power_Profile_Due_In_ms();
+  if (sleep_ms > LVGL_IDLE_MAX_SLEEP_MS) {
+    sleep_ms = LVGL_IDLE_MAX_SLEEP_MS;
+  }
+  if (sleep_ms < portTICK_PERIOD_MS) {
+    return false;
+  }
+
+  atomic_store(&asleep, true);
+  LVGL_Tick_Pause();
+  int64_t start_us = esp_timer_get_time();
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(sleep_ms));
+  atomic_store(&asleep, false);
+  LVGL_Tick_Resume();
+  ESP_LOGD(TAG_IDLE, "Slept %lld ms", (long long)((esp_timer_get_time() - start_us) / 1000));
+  return true;
+}
+
+void LVGL_Idle_Wake(void)
+{
+  // Once per sleep: a finger held down would otherwise post every poll
+  if (atomic_exchange(&asleep, false)) {
+    gui_event_bus_post_call(LVGL_Idle_Wake_Call, NULL);
+  }
+}
+
+#else
+
+void LVGL_Idle_Start(lv_disp_t *disp)
+{
+  ESP_LOGI(TAG_IDLE, "Off, LVGL runs its timers throughout");
+}
+
+bool LVGL_Idle_Sleep(void)
+{
+  return false;
+}
+
+void LVGL_Idle_Wake(void)
+{
+}
+
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+#include <stdbool.h>
+#include "lvgl.h"
+
+/*
+ * Display idle (CONFIG_LVGL_IDLE_MODE).
+ *
+ * Once no input has come for CONFIG_LVGL_IDLE_AFTER_S, no animation runs and
+ * no area waits to be redrawn, the LVGL thread stops calling
+ * lv_timer_handler() and the 2 ms tick timer is stopped. Nothing is rendered
+ * or flushed (the SPD2010 keeps the picture in its GRAM), timers such as a
+ * seconds counter are held, and auto light sleep gets whole seconds instead
+ * of 2 ms. Infinite animations (marquees) keep the GUI running only while
+ * the backlight is on; with it off nobody sees them stop.
+ *
+ * Any task notification wakes the thread at once: a GUI event bus post, an
+ * IMU tap or pick-up (FIFO mode), or a touch through LVGL_Idle_Wake(). It
+ * also wakes for the next power profile step and at least every
+ * CONFIG_LVGL_IDLE_MAX_SLEEP_S, so clocks and status labels catch up. The
+ * LVGL tick is advanced by the time slept, so timers and the inactivity
+ * time keep to the wall clock.
+ *
+ * LVGL_Idle_Start() and LVGL_Idle_Sleep() on the LVGL thread;
+ * LVGL_Idle_Wake() from any task.
+ */
+
+#define LVGL_IDLE_AFTER_MS          (CONFIG_LVGL_IDLE_AFTER_S * 1000)
+#define LVGL_IDLE_MAX_SLEEP_MS      (CONFIG_LVGL_IDLE_MAX_SLEEP_S * 1000)
+
+// After LVGL_Init() and Power_Start_Profiles()
+void LVGL_Idle_Start(lv_disp_t *disp);
+// After a pass with nothing due at once: false if the GUI must keep running,
+// else sleeps until woken and returns true
+bool LVGL_Idle_Sleep(void);
+// A touch while asleep: wake the LVGL thread and count it as activity
+void LVGL_Idle_Wake(void);
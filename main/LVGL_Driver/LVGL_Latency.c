@@ -0,0 +1,86 @@
+#include "LVGL_Latency.h"
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "telemetry_hist.h"
+
+#if CONFIG_LVGL_LATENCY_PROBE
+static const char *TAG_LATENCY = "Latency";
+
+static portMUX_TYPE probe_lock = portMUX_INITIALIZER_UNLOCKED;
+static LVGL_Latency_Probe_t probe;          // Under probe_lock
+static int probe_next = LVGL_LATENCY_STAGE_COUNT;   // Stage awaited; STAGE_COUNT: none open
+static bool probe_done;                     // Finished, not taken yet
+
+void IRAM_ATTR LVGL_Latency_Mark(LVGL_Latency_Stage_t stage)
+{
+  int64_t now_us = esp_timer_get_time();
+  portENTER_CRITICAL_SAFE(&probe_lock);
+  if (stage == LVGL_LATENCY_TOUCH_INT) {
+    // A finger held down keeps raising INT: only a new probe starts here
+    bool open = probe_next != LVGL_LATENCY_STAGE_COUNT;
+    if (!probe_done && (!open || now_us - probe.at_us[0] > LVGL_LATENCY_TIMEOUT_MS * 1000LL)) {
+      memset(&probe, 0, sizeof(probe));
+      probe.at_us[LVGL_LATENCY_TOUCH_INT] = now_us;
+      probe_next = LVGL_LATENCY_TOUCH_READ;
+    }
+  } else if ((int)stage == probe_next) {
+    probe.at_us[stage] = now_us;
+    if (stage == LVGL_LATENCY_LAST_STAGE) {
+      probe_done = true;
+      probe_next = LVGL_LATENCY_STAGE_COUNT;
+    } else {
+      probe_next++;
+    }
+  }
+  portEXIT_CRITICAL_SAFE(&probe_lock);
+}
+
+void LVGL_Latency_Cancel(void)
+{
+  portENTER_CRITICAL(&probe_lock);
+  if (probe_next == LVGL_LATENCY_TOUCH_READ) {
+    probe_next = LVGL_LATENCY_STAGE_COUNT;
+  }
+  portEXIT_CRITICAL(&probe_lock);
+}
+
+bool LVGL_Latency_Take(LVGL_Latency_Probe_t *out)
+{
+  portENTER_CRITICAL(&probe_lock);
+  bool done = probe_done;
+  if (done) {
+    *out = probe;
+    probe_done = false;
+  }
+  portEXIT_CRITICAL(&probe_lock);
+  return done;
+}
+
+void LVGL_Latency_Log(void)
+{
+  LVGL_Latency_Probe_t p;
+  if (!LVGL_Latency_Take(&p)) {
+    return;
+  }
+  const int64_t *t = p.at_us;
+  TELEMETRY_HIST_RECORD("touch", TELEMETRY_HIST_US, (uint32_t)(t[LVGL_LATENCY_LAST_STAGE] - t[0]));
+  ESP_LOGI(TAG_LATENCY, "Touch to %s %lld us: read %lld, indev %lld, event %lld, render %lld, flush %lld",
+           LVGL_LATENCY_LAST_STAGE == LVGL_LATENCY_SCANOUT ? "scan-out" : "panel",
+           (long long)(t[LVGL_LATENCY_LAST_STAGE] - t[0]),
+           (long long)(t[LVGL_LATENCY_TOUCH_READ] - t[0]), (long long)(t[LVGL_LATENCY_INDEV_READ] - t[0]),
+           (long long)(t[LVGL_LATENCY_EVENT] - t[0]), (long long)(t[LVGL_LATENCY_RENDER] - t[0]),
+           (long long)(t[LVGL_LATENCY_FLUSH] - t[0]));
+}
+#else
+bool LVGL_Latency_Take(LVGL_Latency_Probe_t *probe)
+{
+  return false;
+}
+
+void LVGL_Latency_Log(void)
+{
+}
+#endif
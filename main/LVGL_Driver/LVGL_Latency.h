@@ -0,0 +1,61 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+/*
+ * Touch-to-photon probe (CONFIG_LVGL_LATENCY_PROBE).
+ *
+ * One touch at a time is followed through the pipeline, each stage stamped
+ * with esp_timer_get_time() where it happens: the touch controller's INT
+ * edge, the touch task publishing the sample, the LVGL indev read that
+ * picks it up, the first input event LVGL sends for it, the last area of
+ * the next refresh handed to the flush callback, that area's transfers
+ * done, and with CONFIG_LCD_TE_SYNC the next TE pulse, when the panel
+ * starts scanning the new picture out. A stage is only taken after the one
+ * before it, so a probe that stalls (a touch that changes nothing on
+ * screen) is dropped once it is LVGL_LATENCY_TIMEOUT_MS old and the next
+ * INT edge starts another.
+ *
+ * A finished probe waits in LVGL_Latency_Take() for the bench
+ * (Bench_Latency.c); otherwise the LVGL thread logs it. Marks are safe
+ * from ISRs and cost nothing without the option.
+ */
+
+#define LVGL_LATENCY_TIMEOUT_MS     (500)
+
+typedef enum {
+  LVGL_LATENCY_TOUCH_INT,         // INT edge, or a bench touch injected
+  LVGL_LATENCY_TOUCH_READ,        // Sample published by the touch task
+  LVGL_LATENCY_INDEV_READ,        // LVGL's indev read saw it pressed
+  LVGL_LATENCY_EVENT,             // LVGL sent its first input event
+  LVGL_LATENCY_RENDER,            // The refresh's last area went to flush
+  LVGL_LATENCY_FLUSH,             // ... and its transfers finished
+  LVGL_LATENCY_SCANOUT,           // Next TE pulse (CONFIG_LCD_TE_SYNC only)
+  LVGL_LATENCY_STAGE_COUNT
+} LVGL_Latency_Stage_t;
+
+#if CONFIG_LCD_TE_SYNC
+#define LVGL_LATENCY_LAST_STAGE     LVGL_LATENCY_SCANOUT
+#else
+#define LVGL_LATENCY_LAST_STAGE     LVGL_LATENCY_FLUSH
+#endif
+
+typedef struct {
+  int64_t at_us[LVGL_LATENCY_STAGE_COUNT];    // 0: not measured in this build
+} LVGL_Latency_Probe_t;
+
+#if CONFIG_LVGL_LATENCY_PROBE
+// Any task or ISR
+void LVGL_Latency_Mark(LVGL_Latency_Stage_t stage);
+// A read found no finger: drop a probe still waiting for its sample
+void LVGL_Latency_Cancel(void);
+#else
+static inline void LVGL_Latency_Mark(LVGL_Latency_Stage_t stage) { (void)stage; }
+static inline void LVGL_Latency_Cancel(void) {}
+#endif
+
+// A finished probe, once; false if none is ready
+bool LVGL_Latency_Take(LVGL_Latency_Probe_t *probe);
+// LVGL thread, once a pass: log a finished probe
+void LVGL_Latency_Log(void);
@@ -0,0 +1,93 @@
+#include "LVGL_Orientation.h"
+#include <math.h>
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "Display_SPD2010.h"
+#include "Touch_SPD2010.h"
+#include "QMI8658.h"
+#if CONFIG_QMI8658_FUSION
+#include "QMI8658_Fusion.h"
+#endif
+
+static const char *TAG_ORIENT = "Orientation";
+
+static bool flipped;
+
+bool LVGL_Orientation_Flipped(void)
+{
+  return flipped;
+}
+
+#if CONFIG_LCD_AUTO_FLIP
+static lv_disp_t *orient_disp;
+
+static void Orientation_Apply(bool flip)
+{
+  if (esp_lcd_panel_mirror(panel_handle, flip, flip) != ESP_OK) {
+    ESP_LOGW(TAG_ORIENT, "Panel mirror failed");
+    return;
+  }
+  Touch_Set_Flip(flip);
+  flipped = flip;
+  // GRAM still holds the picture the old way round
+  lv_obj_invalidate(lv_disp_get_scr_act(orient_disp));
+  ESP_LOGI(TAG_ORIENT, "Picture %s", flip ? "upside down" : "upright");
+}
+
+#if !CONFIG_QMI8658_FUSION
+static bool pending;                        // The other way is wanted ...
+static uint32_t pending_since;              // ... since this lv_tick_get()
+
+static void Orientation_Timer_Cb(lv_timer_t *timer)
+{
+  IMUdata a = Accel;
+  float down = LVGL_ORIENT_DOWN_G(a);
+  bool want = flipped;
+  if (fabsf(a.z) < LVGL_ORIENT_FLAT_G) {
+    if (down <= -LVGL_ORIENT_FLIP_G) {
+      want = true;
+    } else if (down >= LVGL_ORIENT_FLIP_G) {
+      want = false;
+    }
+  }
+  if (want == flipped) {
+    pending = false;
+    return;
+  }
+  if (!pending) {
+    pending = true;
+    pending_since = lv_tick_get();
+    return;
+  }
+  if (lv_tick_elaps(pending_since) >= LVGL_ORIENT_HOLD_MS) {
+    pending = false;
+    Orientation_Apply(want);
+  }
+}
+#endif
+
+#endif
+
+void LVGL_Orientation_Set(bool flip)
+{
+#if CONFIG_LCD_AUTO_FLIP
+  if (orient_disp && flip != flipped) {
+    Orientation_Apply(flip);
+  }
+#endif
+}
+
+void LVGL_Orientation_Start(lv_disp_t *disp)
+{
+#if CONFIG_LCD_AUTO_FLIP
+  orient_disp = disp;
+#if CONFIG_QMI8658_FUSION
+  // Way-up events before now were ignored
+  if (QMI8658_Fusion_Face() == QMI8658_FACE_UPSIDE_DOWN) {
+    Orientation_Apply(true);
+  }
+#else
+  lv_timer_create(Orientation_Timer_Cb, LVGL_ORIENT_PERIOD_MS, NULL);
+#endif
+#endif
+}
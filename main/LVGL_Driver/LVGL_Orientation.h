@@ -0,0 +1,40 @@
+#pragma once
+#include <stdbool.h>
+#include "lvgl.h"
+
+/*
+ * Upside-down flip (CONFIG_LCD_AUTO_FLIP).
+ *
+ * An LVGL timer reads the newest QMI8658 accel sample and turns the picture
+ * by 180 degrees once gravity has pointed the other way for
+ * LVGL_ORIENT_HOLD_MS. The panel's mirror bits do the turning and the touch
+ * task maps points to match, so LVGL renders as before and a frame costs
+ * the same either way; turning redraws the screen once, with no re-layout.
+ *
+ * Hysteresis: gravity along the picture's vertical axis must pass
+ * LVGL_ORIENT_FLIP_G towards the new bottom edge, about 37 degrees past
+ * level, and nothing changes while the device lies flat.
+ *
+ * With CONFIG_QMI8658_FUSION the timer is not created: the fusion's way-up
+ * events, with the same thresholds and hold on its filtered gravity, call
+ * LVGL_Orientation_Set() instead.
+ *
+ * The SPD2010 cannot exchange rows and columns (swap_xy), so 90 and 270
+ * degrees would need LVGL's software rotation and are not offered.
+ *
+ * LVGL thread only.
+ */
+
+// Gravity towards the bottom edge of the unflipped picture, in g, for how the
+// IMU sits on this board
+#define LVGL_ORIENT_DOWN_G(accel)   ((accel).y)
+#define LVGL_ORIENT_FLIP_G          (0.6f)
+#define LVGL_ORIENT_FLAT_G          (0.8f)      // |z| above this: lying flat, keep the current way
+#define LVGL_ORIENT_HOLD_MS         (700)
+#define LVGL_ORIENT_PERIOD_MS       (100)
+
+// After LVGL_Init() and the IMU; starts the timer
+void LVGL_Orientation_Start(lv_disp_t *disp);
+bool LVGL_Orientation_Flipped(void);
+// Turn the picture now; ignored before LVGL_Orientation_Start()
+void LVGL_Orientation_Set(bool flip);
@@ -0,0 +1,254 @@
+#include "LVGL_Scroll.h"
+#include <string.h>
+#include "sdkconfig.h"
+
+#define LVGL_SCROLL_INV_STRIPS      6       // Free invalid areas a step may need
+
+static lv_area_t copied[LVGL_SCROLL_MAX_COPIES];
+static uint32_t copied_count;
+static bool take_armed;                     // The next invalidation of take_area is the container's own
+static lv_area_t take_area;
+
+#if CONFIG_LVGL_BUFFER_DIRECT_MODE
+/* Something drawn after obj that reaches into area */
+static bool Scroll_Covered(lv_obj_t *obj, const lv_area_t *area)
+{
+    for (lv_obj_t *child = obj, *parent = lv_obj_get_parent(obj); parent; child = parent, parent = lv_obj_get_parent(parent)) {
+        uint32_t count = lv_obj_get_child_cnt(parent);
+        for (uint32_t i = lv_obj_get_index(child) + 1; i < count; i++) {
+            lv_obj_t *sibling = lv_obj_get_child(parent, i);
+            if (lv_obj_has_flag(sibling, LV_OBJ_FLAG_HIDDEN)) {
+                continue;
+            }
+            lv_area_t coords;
+            lv_obj_get_coords(sibling, &coords);
+            lv_area_increase(&coords, _lv_obj_get_ext_draw_size(sibling), _lv_obj_get_ext_draw_size(sibling));
+            if (_lv_area_is_on(&coords, area)) {
+                return true;
+            }
+        }
+
+        // Scrollbars and late borders of the parent are drawn over its children
+        lv_area_t hor, ver;
+        lv_obj_get_scrollbar_area(parent, &hor, &ver);
+        if ((lv_area_get_size(&hor) > 0 && _lv_area_is_on(&hor, area)) ||
+            (lv_area_get_size(&ver) > 0 && _lv_area_is_on(&ver, area))) {
+            return true;
+        }
+        if (lv_obj_get_style_border_post(parent, LV_PART_MAIN) && lv_obj_get_style_border_width(parent, LV_PART_MAIN) > 0) {
+            lv_area_t inner;
+            lv_obj_get_coords(parent, &inner);
+            lv_coord_t inset = LV_MAX(lv_obj_get_style_border_width(parent, LV_PART_MAIN),
+                                      lv_obj_get_style_radius(parent, LV_PART_MAIN));
+            lv_area_increase(&inner, -inset, -inset);
+            if (!_lv_area_is_in(area, &inner, 0)) {
+                return true;
+            }
+        }
+    }
+
+    lv_disp_t *disp = lv_obj_get_disp(obj);
+    lv_obj_t *layers[] = { lv_disp_get_layer_top(disp), lv_disp_get_layer_sys(disp) };
+    for (size_t l = 0; l < sizeof(layers) / sizeof(layers[0]); l++) {
+        uint32_t count = lv_obj_get_child_cnt(layers[l]);
+        for (uint32_t i = 0; i < count; i++) {
+            lv_obj_t *child = lv_obj_get_child(layers[l], i);
+            lv_area_t coords;
+            lv_obj_get_coords(child, &coords);
+            lv_area_increase(&coords, _lv_obj_get_ext_draw_size(child), _lv_obj_get_ext_draw_size(child));
+            if (!lv_obj_has_flag(child, LV_OBJ_FLAG_HIDDEN) && _lv_area_is_on(&coords, area)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/* The part of obj whose pixels only depend on the scroll position: inside its
+ * corners, border and scrollbar bands, and clipped by its ancestors */
+static bool Scroll_Area(lv_obj_t *obj, lv_area_t *area)
+{
+    // What is behind a transparent container stays put while its content moves
+    if (lv_obj_get_style_bg_opa(obj, LV_PART_MAIN) < LV_OPA_MAX ||
+        lv_obj_get_style_bg_grad_dir(obj, LV_PART_MAIN) != LV_GRAD_DIR_NONE ||
+        lv_obj_get_style_bg_img_src(obj, LV_PART_MAIN)) {
+        return false;
+    }
+    for (lv_obj_t *o = obj; o; o = lv_obj_get_parent(o)) {
+        if (lv_obj_get_style_opa(o, LV_PART_MAIN) < LV_OPA_MAX ||
+            lv_obj_get_style_transform_zoom(o, LV_PART_MAIN) != LV_IMG_ZOOM_NONE ||
+            lv_obj_get_style_transform_angle(o, LV_PART_MAIN) != 0 ||
+            lv_obj_get_style_blend_mode(o, LV_PART_MAIN) != LV_BLEND_MODE_NORMAL ||
+            (lv_obj_get_style_clip_corner(o, LV_PART_MAIN) && lv_obj_get_style_radius(o, LV_PART_MAIN) != 0)) {
+            return false;
+        }
+    }
+    // Floating children stay put while the rest moves
+    uint32_t count = lv_obj_get_child_cnt(obj);
+    for (uint32_t i = 0; i < count; i++) {
+        if (lv_obj_has_flag(lv_obj_get_child(obj, i), LV_OBJ_FLAG_FLOATING)) {
+            return false;
+        }
+    }
+
+    lv_obj_get_coords(obj, area);
+    lv_coord_t inset = LV_MAX(lv_obj_get_style_border_width(obj, LV_PART_MAIN), lv_obj_get_style_radius(obj, LV_PART_MAIN));
+    lv_area_increase(area, -inset, -inset);
+    lv_coord_t bar = lv_obj_get_style_width(obj, LV_PART_SCROLLBAR);
+    if (lv_obj_get_style_base_dir(obj, LV_PART_MAIN) == LV_BASE_DIR_RTL) {
+        area->x1 += bar + lv_obj_get_style_pad_left(obj, LV_PART_SCROLLBAR);
+    } else {
+        area->x2 -= bar + lv_obj_get_style_pad_right(obj, LV_PART_SCROLLBAR);
+    }
+    area->y2 -= bar + lv_obj_get_style_pad_bottom(obj, LV_PART_SCROLLBAR);
+    if (area->x1 > area->x2 || area->y1 > area->y2 || !lv_obj_area_is_visible(obj, area)) {
+        return false;
+    }
+    return !Scroll_Covered(obj, area);
+}
+
+/* The copied area is final in the frame LVGL draws next: keep the sync from overwriting it */
+static void Scroll_Unsync(lv_disp_t *disp, const lv_area_t *area)
+{
+    lv_area_t res[4];
+    lv_area_t *sync_area = _lv_ll_get_head(&disp->sync_areas);
+    while (sync_area) {
+        lv_area_t *next_area = _lv_ll_get_next(&disp->sync_areas, sync_area);
+        int8_t res_c = _lv_area_diff(res, sync_area, area);
+        if (res_c != -1) {
+            for (int8_t j = 0; j < res_c; j++) {
+                lv_area_t *new_area = _lv_ll_ins_prev(&disp->sync_areas, sync_area);
+                if (new_area) {
+                    *new_area = res[j];
+                }
+            }
+            _lv_ll_remove(&disp->sync_areas, sync_area);
+            lv_mem_free(sync_area);
+        }
+        sync_area = next_area;
+    }
+}
+
+/* Children moved by (dx, dy): shift what is on screen and invalidate the rest of obj */
+static void Scroll_Blit(lv_obj_t *obj, lv_coord_t dx, lv_coord_t dy)
+{
+    lv_disp_t *disp = lv_obj_get_disp(obj);
+    lv_disp_draw_buf_t *draw_buf = lv_disp_get_draw_buf(disp);
+    if (!disp->driver->direct_mode || !draw_buf->buf2 || disp->prev_scr || disp->rendering_in_progress ||
+        lv_obj_get_screen(obj) != lv_disp_get_scr_act(disp) || copied_count >= LVGL_SCROLL_MAX_COPIES ||
+        disp->inv_p + LVGL_SCROLL_INV_STRIPS >= LV_INV_BUF_SIZE) {
+        return;
+    }
+
+    lv_area_t area;
+    if (!Scroll_Area(obj, &area)) {
+        return;
+    }
+    // Invalidated before the step: drawn for the old positions, so the copy would be stale
+    for (uint16_t i = 0; i < disp->inv_p; i++) {
+        if (!disp->inv_area_joined[i] && _lv_area_is_on(&disp->inv_areas[i], &area)) {
+            return;
+        }
+    }
+    lv_area_t shifted = area, valid;
+    lv_area_move(&shifted, dx, dy);
+    if (!_lv_area_intersect(&valid, &shifted, &area)) {
+        return;
+    }
+
+    lv_color_t *off_screen = draw_buf->buf_act;
+    lv_color_t *on_screen = draw_buf->buf_act == draw_buf->buf1 ? draw_buf->buf2 : draw_buf->buf1;
+    lv_coord_t stride = lv_disp_get_hor_res(disp);
+    size_t row_size = lv_area_get_width(&valid) * sizeof(lv_color_t);
+    for (lv_coord_t y = valid.y1; y <= valid.y2; y++) {
+        memcpy(off_screen + y * stride + valid.x1, on_screen + (y - dy) * stride + valid.x1 - dx, row_size);
+    }
+    Scroll_Unsync(disp, &valid);
+    copied[copied_count++] = valid;
+
+    // LVGL invalidates all of obj next; that becomes everything but the copy
+    lv_area_t full;
+    lv_obj_get_coords(obj, &full);
+    lv_area_increase(&full, _lv_obj_get_ext_draw_size(obj), _lv_obj_get_ext_draw_size(obj));
+    if (!lv_obj_area_is_visible(obj, &full)) {
+        return;
+    }
+    lv_area_t strips[4];
+    int8_t strip_count = _lv_area_diff(strips, &full, &valid);
+    for (int8_t i = 0; i < strip_count; i++) {
+        _lv_inv_area(disp, &strips[i]);
+    }
+    lv_area_t scr_area = { 0, 0, lv_disp_get_hor_res(disp) - 1, lv_disp_get_ver_res(disp) - 1 };
+    take_armed = _lv_area_intersect(&take_area, &full, &scr_area);
+}
+
+static void Scroll_Event_Cb(lv_event_t *e)
+{
+    lv_obj_t *obj = lv_event_get_current_target(e);
+    lv_point_t *last = lv_event_get_user_data(e);
+    if (lv_event_get_code(e) == LV_EVENT_DELETE) {
+        lv_mem_free(last);
+        return;
+    }
+    if (lv_event_get_target(e) != obj) {
+        return;
+    }
+
+    // Scrolling by +x moves the children by -x
+    lv_coord_t x = lv_obj_get_scroll_x(obj);
+    lv_coord_t y = lv_obj_get_scroll_y(obj);
+    lv_coord_t dx = last->x - x;
+    lv_coord_t dy = last->y - y;
+    last->x = x;
+    last->y = y;
+    take_armed = false;
+    if (dx != 0 || dy != 0) {
+        Scroll_Blit(obj, dx, dy);
+    }
+}
+#endif
+
+void LVGL_Scroll_Blit_Enable(lv_obj_t *obj)
+{
+#if CONFIG_LVGL_BUFFER_DIRECT_MODE
+    lv_point_t *last = lv_mem_alloc(sizeof(lv_point_t));
+    if (!last) {
+        return;
+    }
+    last->x = lv_obj_get_scroll_x(obj);
+    last->y = lv_obj_get_scroll_y(obj);
+    lv_obj_add_event_cb(obj, Scroll_Event_Cb, LV_EVENT_SCROLL, last);
+    lv_obj_add_event_cb(obj, Scroll_Event_Cb, LV_EVENT_DELETE, last);
+#else
+    LV_UNUSED(obj);
+#endif
+}
+
+bool LVGL_Scroll_Take_Invalidation(const lv_area_t *area)
+{
+    if (!take_armed) {
+        return false;
+    }
+    take_armed = false;
+    return area->x1 == take_area.x1 && area->y1 == take_area.y1 &&
+           area->x2 == take_area.x2 && area->y2 == take_area.y2;
+}
+
+uint32_t LVGL_Scroll_Get_Copied(const lv_area_t **areas)
+{
+    *areas = copied;
+    return copied_count;
+}
+
+void LVGL_Scroll_Frame_Done(lv_disp_t *disp)
+{
+    // The copies were drawn into this frame, so the next one syncs them like rendered areas
+    for (uint32_t i = 0; i < copied_count; i++) {
+        lv_area_t *sync_area = _lv_ll_ins_tail(&disp->sync_areas);
+        if (sync_area) {
+            *sync_area = copied[i];
+        }
+    }
+    copied_count = 0;
+    take_armed = false;
+}
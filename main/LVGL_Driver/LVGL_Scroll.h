@@ -0,0 +1,38 @@
+#pragma once
+#include "lvgl.h"
+
+/*
+ * Scroll blit for direct mode (CONFIG_LVGL_BUFFER_DIRECT_MODE).
+ *
+ * Scrolling a container normally redraws all of it on every step. For an
+ * enabled container the pixels already on screen are moved instead: the
+ * part that is still visible after the step is copied, shifted by the
+ * scroll delta, from the frame on screen into the frame LVGL draws next.
+ * Only the rows or columns the step exposes, the container's edges and
+ * its scrollbars are invalidated. The copied rows are still sent to the
+ * panel, as it has no scroll of its own.
+ *
+ * A step is redrawn as usual when a copy could be wrong:
+ *   - something is drawn over the container (a later sibling, the top or
+ *     system layer, an ancestor's scrollbar);
+ *   - its background is not an opaque plain colour, or it has floating
+ *     children;
+ *   - it fades, zooms or rotates, or a clipped corner or screen change is
+ *     in the way;
+ *   - part of it was already invalidated before the step.
+ * With the other draw buffer strategies enabling does nothing.
+ *
+ * LVGL thread only.
+ */
+
+#define LVGL_SCROLL_MAX_COPIES  (4)            // Per frame; later steps are redrawn
+
+// Enable before adding the object's own LV_EVENT_SCROLL handlers: areas they invalidate are drawn over the copy
+void LVGL_Scroll_Blit_Enable(lv_obj_t *obj);
+
+// For LVGL_Driver.c: the rounder drops the container's own invalidation, the
+// flush sends the copied areas, and the monitor hands them to the direct mode
+// sync once the frame is out
+bool LVGL_Scroll_Take_Invalidation(const lv_area_t *area);
+uint32_t LVGL_Scroll_Get_Copied(const lv_area_t **areas);
+void LVGL_Scroll_Frame_Done(lv_disp_t *disp);
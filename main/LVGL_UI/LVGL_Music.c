@@ -1,7 +1,8 @@
 #include "LVGL_Music.h"
-#include <demos/music/assets/spectrum_1.h>
-#include <demos/music/assets/spectrum_2.h>
-#include <demos/music/assets/spectrum_3.h>
+#include <stdio.h>
+#include <string.h>
+#include "Music_Index.h"
+#include "chromecast_gui_manager.h"
 /*********************
  *      DEFINES
  *********************/
@@ -17,10 +18,25 @@
     #define BAR_COLOR2_STOP     100
 #endif
 #define BAR_COLOR3_STOP     (2 * LV_HOR_RES / 3)
+#if defined(CONFIG_AUDIO_PLAYER_SPECTRUM)
+#define BAR_CNT             CONFIG_AUDIO_PLAYER_SPECTRUM_BANDS     // One per band of the player's analyser
+#else
 #define BAR_CNT             20
+#endif
 #define DEG_STEP            (180/BAR_CNT)
 #define BAND_CNT            4
 #define BAR_PER_BAND_CNT    (BAR_CNT / BAND_CNT)
+#define BAR_WIDTH           4
+#define BAR_GAP             6           // Between the album art and the bars
+#define SPECTRUM_PERIOD_MS  33
+#define SPECTRUM_FALL       12          // Per period; bars rise at once
+#define SPECTRUM_HOLD_MS    200         // No new analysis for this long: paused or stopped
+#define LIST_ROW_HEIGHT     60
+#define LIST_VISIBLE_ROWS   5
+#define LIST_POOL_ROWS      (LIST_VISIBLE_ROWS + 1)     // Rows are reused as the list scrolls
+#define LIST_HEIGHT         (LIST_VISIBLE_ROWS * LIST_ROW_HEIGHT)
+#define LIST_NO_TRACK       UINT32_MAX
+#define LIBRARY_WAIT_MS     500         // While the first scan runs
 
 
 /**********************
@@ -34,27 +50,42 @@ lv_obj_t * panel2;
 static lv_obj_t * main_cont;
 static lv_obj_t * spectrum_obj;
 static lv_obj_t * title_label;
+static lv_obj_t * artist_label;
 static lv_obj_t * album_img_obj;
 static uint32_t time_act;
 static lv_timer_t  * sec_counter_timer; 
 static const lv_font_t * font_small;
 static const lv_font_t * font_large;
 static bool Playing_Flag;                                     
-static uint32_t track_id;
+static uint32_t track_id;                   // List position of the track playing
+static uint32_t queued_id;                  // ... and of the one lined up after it
 static lv_obj_t * play_obj;
-static const uint16_t (* spectrum)[4];
-static uint32_t spectrum_len;
+static lv_obj_t * progress_slider;          // Seconds into the track; drag to seek
+#if defined(CONFIG_AUDIO_PLAYER_SPECTRUM)
+static uint8_t spectrum_levels[BAR_CNT];    // As drawn
+static uint8_t spectrum_target[BAR_CNT];    // Latest analysis
+static uint32_t spectrum_seq;
+static uint32_t spectrum_tick;              // When the latest analysis arrived
+static void spectrum_timer_cb(lv_timer_t * t);
+#endif
+static void title_update(void);
+static void list_refresh(bool rebind);
+static void album_art_update(void);
 
 lv_obj_t * Music_img;
 
 
-char SD_Name[100][100] ;    
-char File_Name[100][100] ;     
-char Audio_Name[100] ;         
 uint16_t ACTIVE_TRACK_CNT;      
 uint16_t Audio_energy;         
 
 static lv_obj_t * list;
+static lv_obj_t * list_rows[LIST_POOL_ROWS];
+static uint32_t list_row_pos[LIST_POOL_ROWS];   // Track each row shows, LIST_NO_TRACK if hidden
+static uint32_t list_checked = LIST_NO_TRACK;
+static lv_obj_t * list_spacer;                  // Last child; its y sets the scroll height
+static lv_style_t style_artist;
+static lv_obj_t * music_parent;
+static lv_obj_t * empty_label;
 static lv_style_t style_btn_round;
 static lv_style_t style_btn_pr;
 static lv_style_t style_btn_play;
@@ -89,6 +120,7 @@ void _obj_set_x_anim_cb(void * obj, int32_t x)
 lv_obj_t * _lv_demo_music_main_create(lv_obj_t * parent)
 {
 
+  music_parent = parent;
   LVGL_Search_Music();   
   if(ACTIVE_TRACK_CNT) {                                  
     lv_style_init(&music_style);
@@ -137,8 +169,6 @@ lv_obj_t * _lv_demo_music_main_create(lv_obj_t * parent)
     lv_obj_set_height(panel2, LV_SIZE_CONTENT);
 
     lv_obj_t * list_box = create_List_box(panel2);
-    
-    lv_obj_set_size(list_box, LV_SIZE_CONTENT, LV_SIZE_CONTENT);               
     // lv_obj_add_style(list_box, &music_style, 0);
 
     static lv_coord_t grid_2_col_dsc[] = {LV_GRID_FR(1),LV_GRID_FR(1),  LV_GRID_TEMPLATE_LAST};
@@ -152,6 +182,9 @@ lv_obj_t * _lv_demo_music_main_create(lv_obj_t * parent)
 
 
     lv_timer_create(timer_cb, 100, NULL);
+#if defined(CONFIG_AUDIO_PLAYER_SPECTRUM)
+    lv_timer_create(spectrum_timer_cb, SPECTRUM_PERIOD_MS, NULL);
+#endif
 
 
     lv_obj_fade_in(title_box, 500, INTRO_TIME - 1000);
@@ -160,17 +193,40 @@ lv_obj_t * _lv_demo_music_main_create(lv_obj_t * parent)
     lv_obj_fade_in(spectrum_obj, 0, INTRO_TIME - 1000);
   }
   else{ 
-    lv_obj_t *label = lv_label_create(parent);
-    lv_label_set_text(label, "No MP3 file found in SD card!");
+    empty_label = lv_label_create(parent);
+    if(Music_Library_Scanning()) {
+      lv_label_set_text(empty_label, "Scanning SD card...");
+      lv_timer_create(library_wait_cb, LIBRARY_WAIT_MS, NULL);
+    }
+    else
+      lv_label_set_text(empty_label, "No music file found in SD card!");
     // lv_obj_set_size(label, LV_PCT(100), LV_PCT(100));
 
-    lv_obj_set_size(label, LV_SIZE_CONTENT, LV_SIZE_CONTENT);
-    lv_obj_align(label, LV_ALIGN_CENTER, 0, 0);
-    lv_obj_set_style_text_align(label, LV_TEXT_ALIGN_CENTER, 0);  
+    lv_obj_set_size(empty_label, LV_SIZE_CONTENT, LV_SIZE_CONTENT);
+    lv_obj_align(empty_label, LV_ALIGN_CENTER, 0, 0);
+    lv_obj_set_style_text_align(empty_label, LV_TEXT_ALIGN_CENTER, 0);  
   }
   return main_cont;
 }
 
+// Nothing was on the card yet: build the player once the first scan finds something
+void library_wait_cb(lv_timer_t * t)
+{
+  bool done = !Music_Library_Scanning();                    // Before the apply, so nothing published is missed
+  uint32_t unused = 0;
+  Music_Library_Apply(&unused, 1);
+  if(Music_Library_Count()) {
+    lv_timer_del(t);
+    lv_obj_del(empty_label);
+    empty_label = NULL;
+    _lv_demo_music_main_create(music_parent);
+  }
+  else if(done) {
+    lv_timer_del(t);
+    lv_label_set_text(empty_label, "No music file found in SD card!");
+  }
+}
+
 
 /************************************************************************************************************************************
  *   create_title_box                 
@@ -187,10 +243,22 @@ lv_obj_t * create_title_box(lv_obj_t * parent)
   title_label = lv_label_create(cont);                                                            
   lv_obj_set_style_text_font(title_label, font_large, 0);                                                        
   lv_obj_set_style_text_color(title_label, lv_color_hex(0x504d6d), 0);                            
-  lv_label_set_text(title_label, Audio_Name);                                                    
   lv_obj_set_height(title_label, lv_font_get_line_height(font_large) );                         
+
+  artist_label = lv_label_create(cont);
+  lv_obj_set_style_text_font(artist_label, font_small, 0);
+  lv_obj_set_style_text_color(artist_label, lv_color_hex(0x8a86b8), 0);
+  title_update();
   return cont;
 }
+// Title and artist of the track playing, from its tags
+static void title_update(void)
+{
+  Music_Track_t track;
+  if(!Music_Library_Get(track_id, &track)) return;
+  lv_label_set_text(title_label, track.title);
+  lv_label_set_text(artist_label, track.artist);
+}
 /************************************************************************************************************************************
  *  create_title_box END            *  create_title_box END             *  create_title_box END             *  create_title_box END
 ************************************************************************************************************************************/
@@ -278,6 +346,67 @@ void create_wave_images(lv_obj_t * parent)
 /************************************************************************************************************************************
  *  spectrum                    *  spectrum                     *  spectrum                     *  spectrum                    
 ************************************************************************************************************************************/
+#if defined(CONFIG_AUDIO_PLAYER_SPECTRUM)
+/* Bars around the album art, bass at the bottom, mirrored left and right */
+static void spectrum_draw_event_cb(lv_event_t * e)
+{
+  lv_obj_t * obj = lv_event_get_target(e);
+  lv_draw_ctx_t * draw_ctx = lv_event_get_draw_ctx(e);
+  lv_coord_t r_in = lv_obj_get_width(album_img_obj) / 2 + BAR_GAP;
+  lv_coord_t r_max = LV_MIN(lv_obj_get_width(obj), lv_obj_get_height(obj)) / 2;
+  if(r_max <= r_in) return;
+  lv_coord_t cx = obj->coords.x1 + lv_obj_get_width(obj) / 2;
+  lv_coord_t cy = obj->coords.y1 + lv_obj_get_height(obj) / 2;
+
+  lv_draw_line_dsc_t dsc;
+  lv_draw_line_dsc_init(&dsc);
+  dsc.width = BAR_WIDTH;
+  dsc.round_start = 1;
+  dsc.round_end = 1;
+  for(int i = 0; i < BAR_CNT; i++) {
+    if(spectrum_levels[i] == 0) continue;
+    int32_t r_out = r_in + (r_max - r_in) * spectrum_levels[i] / 255;
+    dsc.color = lv_color_mix(BAR_COLOR2, BAR_COLOR1, spectrum_levels[i]);
+    int16_t angle = 90 - DEG_STEP * i - DEG_STEP / 2;
+    for(int side = 0; side < 2; side++) {
+      int16_t a = side ? 180 - angle : angle;
+      int32_t cos_a = lv_trigo_cos(a);
+      int32_t sin_a = lv_trigo_sin(a);
+      lv_point_t p1 = { cx + ((r_in * cos_a) >> LV_TRIGO_SHIFT), cy + ((r_in * sin_a) >> LV_TRIGO_SHIFT) };
+      lv_point_t p2 = { cx + ((r_out * cos_a) >> LV_TRIGO_SHIFT), cy + ((r_out * sin_a) >> LV_TRIGO_SHIFT) };
+      lv_draw_line(draw_ctx, &dsc, &p1, &p2);
+    }
+  }
+}
+
+/* Follows the player's analyser; redraws only when a bar moves */
+static void spectrum_timer_cb(lv_timer_t * t)
+{
+  LV_UNUSED(t);
+  uint8_t levels[BAR_CNT];
+  uint32_t seq = audio_player_get_spectrum(levels, BAR_CNT);
+  if(seq != 0 && seq != spectrum_seq) {
+    spectrum_seq = seq;
+    spectrum_tick = lv_tick_get();
+    memcpy(spectrum_target, levels, sizeof(levels));
+  } else if(lv_tick_elaps(spectrum_tick) > SPECTRUM_HOLD_MS) {
+    memset(spectrum_target, 0, sizeof(spectrum_target));
+  }
+
+  bool changed = false;
+  for(int i = 0; i < BAR_CNT; i++) {
+    uint8_t level = spectrum_levels[i];
+    if(spectrum_target[i] >= level) level = spectrum_target[i];
+    else level = (level - spectrum_target[i] > SPECTRUM_FALL) ? level - SPECTRUM_FALL : spectrum_target[i];
+    if(level != spectrum_levels[i]) {
+      spectrum_levels[i] = level;
+      changed = true;
+    }
+  }
+  if(changed) lv_obj_invalidate(spectrum_obj);
+}
+#endif
+
 lv_obj_t * create_spectrum_obj(lv_obj_t * parent)
 {
   /*Create the spectrum visualizer*/
@@ -287,6 +416,9 @@ lv_obj_t * create_spectrum_obj(lv_obj_t * parent)
   lv_obj_clear_flag(obj, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE);                            
   lv_obj_refresh_ext_draw_size(obj);                                                              
   album_img_obj = album_img_create(obj);                                                         
+#if defined(CONFIG_AUDIO_PLAYER_SPECTRUM)
+  lv_obj_add_event_cb(obj, spectrum_draw_event_cb, LV_EVENT_DRAW_MAIN, NULL);
+#endif
   return obj;
 }
 
@@ -335,8 +467,7 @@ lv_obj_t * album_img_create(lv_obj_t * parent)
       lv_img_set_src(Music_img, &img_lv_demo_music_cover_1);                        
       break;                                                                  
   }  
-  spectrum = spectrum_3;                                                      
-  spectrum_len = sizeof(spectrum_3) / sizeof(spectrum_3[0]);                  
+  album_art_update();
   lv_img_set_antialias(Music_img, true);                                            
   lv_obj_align(Music_img, LV_ALIGN_CENTER, 0, 0);                                   
   lv_obj_add_event_cb(Music_img, album_gesture_event_cb, LV_EVENT_GESTURE, NULL);   
@@ -348,6 +479,17 @@ lv_obj_t * album_img_create(lv_obj_t * parent)
 }
 
 
+// The track's own cover once Music_Art has it; the demo cover until then
+static void album_art_update(void)
+{
+  Music_Track_t track;
+  if(!Music_img || !Music_Library_Get(track_id, &track)) return;
+  const lv_img_dsc_t * art = Music_Art_Get(track.dir, track.file);
+  if(art && lv_img_get_src(Music_img) != art) {
+    lv_img_set_src(Music_img, art);
+  }
+}
+
 void album_gesture_event_cb(lv_event_t * e)
 {
   lv_dir_t dir = lv_indev_get_gesture_dir(lv_indev_get_act());                
@@ -429,6 +571,16 @@ lv_obj_t * create_ctrl_box(lv_obj_t * parent)
   lv_obj_set_grid_cell(icon4, LV_GRID_ALIGN_CENTER, 4, 1, LV_GRID_ALIGN_CENTER, 0, 1);             
   lv_obj_add_event_cb(icon4, next_click_event_cb, LV_EVENT_CLICKED, NULL);                         
   lv_obj_add_flag(icon4, LV_OBJ_FLAG_CLICKABLE);                                                  
+
+  progress_slider = lv_slider_create(cont);
+  lv_obj_set_grid_cell(progress_slider, LV_GRID_ALIGN_STRETCH, 1, 5, LV_GRID_ALIGN_CENTER, 1, 1);
+  lv_obj_set_height(progress_slider, 6);
+  lv_obj_set_ext_click_area(progress_slider, 15);
+  lv_obj_set_style_bg_color(progress_slider, lv_color_hex(0xADD8F6), LV_PART_INDICATOR);
+  lv_obj_set_style_bg_color(progress_slider, lv_color_hex(0xFFFFFF), LV_PART_KNOB);
+  lv_obj_set_style_pad_all(progress_slider, 4, LV_PART_KNOB);
+  lv_slider_set_range(progress_slider, 0, 1);
+  lv_obj_add_event_cb(progress_slider, progress_event_cb, LV_EVENT_RELEASED, NULL);
           
 
   return cont;
@@ -436,6 +588,7 @@ lv_obj_t * create_ctrl_box(lv_obj_t * parent)
 
 void track_load(uint32_t id) 
 {
+  if(ACTIVE_TRACK_CNT == 0) return;
   if(first_Flag) {                                                          
     if(id == track_id) return;                                              
   }
@@ -449,7 +602,7 @@ void track_load(uint32_t id)
   }
   _lv_demo_music_list_btn_check(id, true);                                  
   first_Flag = true;                                                        
-  lv_label_set_text(title_label, Audio_Name);                               
+  title_update();
                                                                             
   lv_anim_t a;                                                              
   lv_anim_init(&a);                                                         
@@ -522,13 +675,50 @@ void next_click_event_cb(lv_event_t * e)
     _lv_demo_music_album_next(true);                                          
   }
 }
+// Seeks where the knob was let go, so dragging does not seek on every step
+void progress_event_cb(lv_event_t * e)
+{
+  int32_t seconds = lv_slider_get_value(lv_event_get_target(e));
+  Music_Seek((uint32_t)seconds * 1000);
+}
+static void progress_update(void)
+{
+  if(!progress_slider || lv_obj_has_state(progress_slider, LV_STATE_PRESSED)) return;
+  uint32_t duration = Music_Duration() / 1000;
+  if(duration == 0) return;                                                 // Not known yet
+  if(lv_slider_get_max_value(progress_slider) != (int32_t)duration) {
+    lv_slider_set_range(progress_slider, 0, duration);
+  }
+  lv_slider_set_value(progress_slider, Music_Elapsed() / 1000, LV_ANIM_OFF);
+}
+// A scan finished: the list may have new tracks or a new order
+static void library_update(void)
+{
+  uint32_t positions[2] = { track_id, queued_id };
+  if(!Music_Library_Apply(positions, 2)) return;
+  ACTIVE_TRACK_CNT = Music_Library_Count();
+  track_id = positions[0];
+  queued_id = positions[1];
+  list_checked = track_id;
+  lv_obj_set_y(list_spacer, ACTIVE_TRACK_CNT ? ACTIVE_TRACK_CNT * LIST_ROW_HEIGHT - 1 : 0);
+  list_refresh(true);
+  title_update();
+  album_art_update();
+}
 void timer_cb(lv_timer_t * t)
 {
   LV_UNUSED(t);                                                             
+  progress_update();
+  library_update();
+  if(Music_Art_Poll()) album_art_update();
   if(Music_Next_Flag){
     Music_Next_Flag = 0;                                      
     _lv_demo_music_album_next(true);  
   }                 
+  if(Music_Advanced_Flag){
+    Music_Advanced_Flag = 0;
+    LVGL_Music_Advanced();
+  }
 }
 static lv_obj_t * panel;
 static lv_obj_t * slider;        
@@ -638,20 +828,34 @@ lv_obj_t * create_List_box(lv_obj_t * parent)
   lv_style_init(&style_title);                                              
   lv_style_set_text_font(&style_title, font_small);                         
   lv_style_set_text_color(&style_title, lv_color_hex(0x101010));            
+
+  lv_style_init(&style_artist);
+  lv_style_set_text_font(&style_artist, font_small);
+  lv_style_set_text_color(&style_artist, lv_color_hex(0x707070));
     
+  /* Only LIST_POOL_ROWS rows exist, however many tracks there are: as the
+   * list scrolls they move down (or up) and take the next track's text */
   list = lv_obj_create(parent);
   lv_obj_remove_style_all(list);                                            
-  lv_obj_set_size(list, LV_SIZE_CONTENT, LV_SIZE_CONTENT);                  
+  lv_obj_set_size(list, lv_pct(100), LIST_HEIGHT);
   lv_obj_set_pos(list, 0, LV_DEMO_MUSIC_HANDLE_SIZE);                       
   // lv_obj_set_y(list, LV_DEMO_MUSIC_HANDLE_SIZE);
   lv_obj_add_style(list, &music_style, LV_PART_SCROLLBAR);
-  lv_obj_set_flex_flow(list, LV_FLEX_FLOW_COLUMN);
+  lv_obj_set_scroll_dir(list, LV_DIR_VER);
+  lv_obj_add_event_cb(list, list_scroll_event_cb, LV_EVENT_SCROLL, NULL);
 
   uint32_t List_id;
-  for(List_id = 0; List_id < ACTIVE_TRACK_CNT; List_id++) {                 
-      add_list_btn(list,  List_id);                                         
+  for(List_id = 0; List_id < LIST_POOL_ROWS; List_id++) {                 
+      list_rows[List_id] = add_list_btn(list,  List_id);                                         
+      list_row_pos[List_id] = LIST_NO_TRACK;
   }
+  list_spacer = lv_obj_create(list);
+  lv_obj_remove_style_all(list_spacer);
+  lv_obj_clear_flag(list_spacer, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SNAPPABLE);
+  lv_obj_set_size(list_spacer, 1, 1);
+  lv_obj_set_y(list_spacer, ACTIVE_TRACK_CNT * LIST_ROW_HEIGHT - 1);
   lv_obj_set_scroll_snap_y(list, LV_SCROLL_SNAP_CENTER);                    
+  list_refresh(true);
   _lv_demo_music_list_btn_check(0, true);                                         
   return list;
 }
@@ -659,13 +863,14 @@ lv_obj_t * add_list_btn(lv_obj_t * parent, uint32_t List_id)
 {
   lv_obj_t * btn = lv_obj_create(parent);                                  
   lv_obj_remove_style_all(btn);                                             
-  lv_obj_set_size(btn, lv_pct(100), 60);  
+  lv_obj_set_size(btn, lv_pct(100), LIST_ROW_HEIGHT);  
   lv_obj_add_style(btn, &style_btn_round, 0);                                  
 
   lv_obj_add_style(btn, &style_btn_stop, 0);                                
   lv_obj_add_style(btn, &style_btn_play, LV_STATE_CHECKED);                 
   lv_obj_add_style(btn, &style_btn_pr, LV_STATE_PRESSED);                   
-  lv_obj_add_event_cb(btn, btn_click_event_cb, LV_EVENT_CLICKED, NULL);     
+  lv_obj_add_event_cb(btn, btn_click_event_cb, LV_EVENT_SHORT_CLICKED, NULL);     
+  lv_obj_add_event_cb(btn, btn_long_press_event_cb, LV_EVENT_LONG_PRESSED, NULL);
 
 
   lv_obj_t * icon = lv_img_create(btn);                                     
@@ -673,27 +878,85 @@ lv_obj_t * add_list_btn(lv_obj_t * parent, uint32_t List_id)
   lv_obj_set_grid_cell(icon, LV_GRID_ALIGN_START, 0, 1, LV_GRID_ALIGN_CENTER, 0, 2);  
 
   lv_obj_t * title_label = lv_label_create(btn);                           
-  lv_label_set_text(title_label, File_Name[List_id]);                       
-  lv_obj_set_grid_cell(title_label, LV_GRID_ALIGN_START, 1, 1, LV_GRID_ALIGN_CENTER, 0, 1);
+  lv_label_set_long_mode(title_label, LV_LABEL_LONG_DOT);
+  lv_obj_set_grid_cell(title_label, LV_GRID_ALIGN_STRETCH, 1, 1, LV_GRID_ALIGN_CENTER, 0, 1);
   lv_obj_add_style(title_label, &style_title, 0);
+
+  lv_obj_t * artist_label = lv_label_create(btn);
+  lv_label_set_long_mode(artist_label, LV_LABEL_LONG_DOT);
+  lv_obj_set_grid_cell(artist_label, LV_GRID_ALIGN_STRETCH, 1, 1, LV_GRID_ALIGN_CENTER, 1, 1);
+  lv_obj_add_style(artist_label, &style_artist, 0);
+
+  lv_obj_t * time_label = lv_label_create(btn);
+  lv_obj_set_grid_cell(time_label, LV_GRID_ALIGN_END, 2, 1, LV_GRID_ALIGN_CENTER, 0, 2);
+  lv_obj_add_style(time_label, &style_artist, 0);
                     
   return btn;
 }
 
-void _lv_demo_music_list_btn_check(uint32_t List_id, bool state)
+// Puts track pos on row, with its tags and whether it is the one playing
+static void list_bind_row(uint32_t row, uint32_t pos)
 {
-  lv_obj_t * btn = lv_obj_get_child(list, List_id);                           
-  lv_obj_t * icon = lv_obj_get_child(btn, 0);                                
+  lv_obj_t * btn = list_rows[row];
+  Music_Track_t track;
+  if(!Music_Library_Get(pos, &track)) {
+    lv_obj_add_flag(btn, LV_OBJ_FLAG_HIDDEN);
+    list_row_pos[row] = LIST_NO_TRACK;
+    return;
+  }
+  list_row_pos[row] = pos;
+  lv_obj_clear_flag(btn, LV_OBJ_FLAG_HIDDEN);
+  lv_obj_set_y(btn, pos * LIST_ROW_HEIGHT);
+  lv_label_set_text(lv_obj_get_child(btn, 1), track.title);
+  if(track.artist[0] && track.album[0])
+    lv_label_set_text_fmt(lv_obj_get_child(btn, 2), "%s - %s", track.artist, track.album);
+  else
+    lv_label_set_text(lv_obj_get_child(btn, 2), track.artist[0] ? track.artist : track.album);
+  uint32_t seconds = track.duration_ms / 1000;
+  if(seconds)
+    lv_label_set_text_fmt(lv_obj_get_child(btn, 3), "%lu:%02lu", (unsigned long)(seconds / 60), (unsigned long)(seconds % 60));
+  else
+    lv_label_set_text(lv_obj_get_child(btn, 3), "");
 
-  if(state) {
-    lv_obj_add_state(btn, LV_STATE_CHECKED);                                  
-    lv_img_set_src(icon, &img_lv_demo_music_btn_list_pause);                  
-    lv_obj_scroll_to_view(btn, LV_ANIM_ON);                                   
+  lv_obj_t * icon = lv_obj_get_child(btn, 0);
+  if(pos == list_checked) {
+    lv_obj_add_state(btn, LV_STATE_CHECKED);
+    lv_img_set_src(icon, &img_lv_demo_music_btn_list_pause);
   }
   else {
-    lv_obj_clear_state(btn, LV_STATE_CHECKED);                                
-    lv_img_set_src(icon, &img_lv_demo_music_btn_list_play);                   
+    lv_obj_clear_state(btn, LV_STATE_CHECKED);
+    lv_img_set_src(icon, &img_lv_demo_music_btn_list_play);
   }
+}
+
+// Track p always goes on row p % LIST_POOL_ROWS, so a row is rebound only when it scrolls out
+static void list_refresh(bool rebind)
+{
+  lv_coord_t first = lv_obj_get_scroll_y(list) / LIST_ROW_HEIGHT;
+  if(first < 0) first = 0;
+  for(uint32_t pos = first; pos < (uint32_t)first + LIST_POOL_ROWS; pos++) {
+    uint32_t row = pos % LIST_POOL_ROWS;
+    if(rebind || list_row_pos[row] != pos) list_bind_row(row, pos);
+  }
+}
+
+void list_scroll_event_cb(lv_event_t * e)
+{
+  LV_UNUSED(e);
+  list_refresh(false);
+}
+
+void _lv_demo_music_list_btn_check(uint32_t List_id, bool state)
+{
+  if(state) {
+    list_checked = List_id;
+    lv_coord_t y = List_id * LIST_ROW_HEIGHT - (LIST_HEIGHT - LIST_ROW_HEIGHT) / 2;
+    lv_obj_scroll_to_y(list, y > 0 ? y : 0, LV_ANIM_ON);                   // Bounded to the list
+  }
+  else if(list_checked == List_id) {
+    list_checked = LIST_NO_TRACK;
+  }
+  list_refresh(true);
   // lv_obj_scroll_to_view(panel1, LV_ANIM_ON);                               
   lv_obj_invalidate(panel1);                                                 
 }
@@ -701,13 +964,27 @@ void _lv_demo_music_list_btn_check(uint32_t List_id, bool state)
 void btn_click_event_cb(lv_event_t * e)
 {
   lv_obj_t * btn = lv_event_get_target(e);                                    
-  uint32_t idx = lv_obj_get_child_id(btn);            
+  uint32_t idx = list_row_pos[lv_obj_get_child_id(btn)];
+  if(idx == LIST_NO_TRACK) return;
   if(idx == track_id)   
     _lv_demo_music_resume();  
   else                   
     _lv_demo_music_play(idx);                                                   
 }
 
+// Long press: the track plays on the connected Chromecast instead, from the media server
+void btn_long_press_event_cb(lv_event_t * e)
+{
+  lv_obj_t * btn = lv_event_get_target(e);
+  uint32_t idx = list_row_pos[lv_obj_get_child_id(btn)];
+  Music_Track_t track;
+  if(idx == LIST_NO_TRACK || !Music_Library_Get(idx, &track)) return;
+  char path[MUSIC_INDEX_PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%s", track.dir, track.file);
+  if(chromecast_gui_cast_file(path, track.title))
+    LVGL_Pause_Music();
+}
+
 /************************************************************************************************************************************
  *   create_ctrl_box END                *   create_ctrl_box END                 *   create_ctrl_box END                   *   create_ctrl_box END
 ************************************************************************************************************************************/
@@ -721,6 +998,7 @@ void _lv_demo_music_main_close(void)
 
 void _lv_demo_music_album_next(bool next)
 {
+  if(ACTIVE_TRACK_CNT == 0) return;
   uint32_t id = track_id;
   if(next) {                                                                         
     id++;                                                         
@@ -777,26 +1055,37 @@ void _lv_demo_music_pause(void)
  *  Other         *  Other         *  Other         *  Other                   
 ************************************************************************************************************************************/
 
-void remove_file_extension(char *file_name) {
-  char *last_dot = strrchr(file_name, '.');
-  if (last_dot != NULL) {
-    *last_dot = '\0'; 
-  }
-}
+// The saved library is there at once; the scanner brings it up to date behind the UI
 void LVGL_Search_Music() {        
-  ACTIVE_TRACK_CNT = Folder_retrieval("/sdcard",".mp3",SD_Name,100);
+  Music_Library_Init();
+  Music_Art_Init();
+  ACTIVE_TRACK_CNT = Music_Library_Count();
   if(ACTIVE_TRACK_CNT) {  
-    for (int i = 0; i < ACTIVE_TRACK_CNT; i++) {
-      strcpy(File_Name[i], SD_Name[i]);
-      remove_file_extension(File_Name[i]); 
-    }                
-    LVGL_Play_Music(0);    
+    LVGL_Play_Music(track_id < ACTIVE_TRACK_CNT ? track_id : 0);    
   }                                                             
 }
 void LVGL_Play_Music(uint32_t ID) {                                        
-  Play_Music("/sdcard",SD_Name[ID]);
+  Music_Track_t track;
+  if(!Music_Library_Get(ID, &track)) return;
+  Play_Music(track.dir, track.file);
   LVGL_Pause_Music();
-  strncpy(Audio_Name,File_Name[ID], sizeof(File_Name[ID]));       
+  LVGL_Queue_Next_Music(ID);
+}
+// Line up the following track so it plays without a gap
+void LVGL_Queue_Next_Music(uint32_t ID) {
+  Music_Track_t track;
+  if(ACTIVE_TRACK_CNT > 1 && Music_Library_Get((ID + 1) % ACTIVE_TRACK_CNT, &track)) {
+    queued_id = (ID + 1) % ACTIVE_TRACK_CNT;
+    Queue_Music(track.dir, track.file);
+  }
+}
+// The queued track is playing: follow it in the UI and queue the one after
+void LVGL_Music_Advanced() {
+  if(ACTIVE_TRACK_CNT == 0) return;
+  uint32_t id = queued_id;
+  Music_img_angle = 0;
+  track_load(id);
+  LVGL_Queue_Next_Music(id);
 }
 
 void LVGL_Resume_Music() {
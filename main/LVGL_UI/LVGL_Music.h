@@ -13,6 +13,8 @@
 
 #include "SD_MMC.h"
 #include "PCM5101.h"
+#include "Music_Library.h"
+#include "Music_Art.h"
 
 /**********************
  *   GLOBAL FUNCTIONS
@@ -43,6 +45,9 @@ lv_obj_t * create_List_box(lv_obj_t * parent);
 lv_obj_t * add_list_btn(lv_obj_t * parent, uint32_t track_id);
 void _lv_demo_music_list_btn_check(uint32_t track_id, bool state);
 void btn_click_event_cb(lv_event_t * e);
+void btn_long_press_event_cb(lv_event_t * e);
+void list_scroll_event_cb(lv_event_t * e);
+void library_wait_cb(lv_timer_t * t);
 
 lv_obj_t * create_cont(lv_obj_t * parent);
 void create_wave_images(lv_obj_t * parent);
@@ -58,6 +63,7 @@ void play_event_click_cb(lv_event_t * e);
 void prev_click_event_cb(lv_event_t * e);
 void next_click_event_cb(lv_event_t * e);
 void volume_event_cb(lv_event_t * e);
+void progress_event_cb(lv_event_t * e);
 
 void album_fade_anim_cb(void * var, int32_t v);
 void timer_cb(lv_timer_t * t);
@@ -66,4 +72,6 @@ void LVGL_Search_Music();
 void LVGL_Resume_Music();
 void LVGL_Pause_Music();  
 void LVGL_Play_Music(uint32_t ID);  
+void LVGL_Queue_Next_Music(uint32_t ID);
+void LVGL_Music_Advanced();
 void LVGL_volume_adjustment(uint8_t Volume);
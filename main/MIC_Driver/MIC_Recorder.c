@@ -0,0 +1,536 @@
+#include "MIC_Recorder.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "SD_MMC.h"
+
+#if defined(CONFIG_MIC_RECORDER)
+
+#include "esp_opus_enc.h"
+
+static const char *TAG = "MIC RECORDER";
+
+#define WAV_HEADER              44
+#define OPUS_GRANULE_RATIO      (48000 / MIC_RECORDER_RATE)     // Ogg Opus counts 48 kHz samples
+#define OPUS_PRE_SKIP           312         // The encoder's look-ahead, at 48 kHz
+#define OGG_PAGE_HEADER         27
+#define OGG_PAGE_BODY           8192
+#define OGG_PAGE_PACKETS        50          // A page a second
+#define OGG_PAGE_MAX            (OGG_PAGE_HEADER + 255 + OGG_PAGE_BODY)
+
+typedef struct {
+    char path[128];
+    uint8_t channels;
+    bool opus;
+    int fd;
+
+    // The ring: written by the feed task, read by the writer
+    uint8_t *ring;
+    uint32_t ring_in;               // Bytes, free running
+    uint32_t ring_out;
+    uint32_t dropped;               // Frames the ring had no room for
+    volatile bool feeding;          // The feed task is in the ring
+
+    uint8_t *block;                 // DMA-capable, the next write
+    size_t block_len;
+    uint32_t written;               // File offset of block[0]
+    uint32_t reserved;              // Bytes preallocated, a whole number of blocks
+    bool full;                      // Out of reserved space, or a write failed
+    uint32_t frames;                // Recorded
+
+    // Opus
+    void *encoder;
+    uint8_t *pcm;                   // One encoder frame
+    size_t pcm_size;
+    uint8_t *packet;
+    size_t packet_size;
+    uint8_t page[OGG_PAGE_HEADER + 255];    // Header and lacing of the page being built
+    uint8_t *body;
+    size_t body_len;
+    uint8_t segments;
+    int page_packets;
+    uint64_t page_granule;          // Of the last packet on the page
+    uint64_t granule;
+    uint32_t serial;
+    uint32_t sequence;
+
+    TaskHandle_t task;
+    SemaphoreHandle_t done;         // Given once the file is closed
+    volatile bool stopping;
+    volatile bool finished;
+} Recorder_t;
+
+static Recorder_t *recorder;
+static portMUX_TYPE recorder_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t ogg_crc_table[256];
+
+static inline void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static inline void put_le32(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i) {
+        p[i] = v >> (8 * i);
+    }
+}
+
+static inline void put_le64(uint8_t *p, uint64_t v)
+{
+    for (int i = 0; i < 8; ++i) {
+        p[i] = v >> (8 * i);
+    }
+}
+
+static void Wav_Header(uint8_t *h, uint8_t channels, uint32_t data_bytes)
+{
+    memcpy(h, "RIFF", 4);
+    put_le32(h + 4, 36 + data_bytes);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    put_le32(h + 16, 16);
+    put_le16(h + 20, 1);                // PCM
+    put_le16(h + 22, channels);
+    put_le32(h + 24, MIC_RECORDER_RATE);
+    put_le32(h + 28, MIC_RECORDER_RATE * channels * sizeof(int16_t));
+    put_le16(h + 32, channels * sizeof(int16_t));
+    put_le16(h + 34, 16);
+    memcpy(h + 36, "data", 4);
+    put_le32(h + 40, data_bytes);
+}
+
+static void Block_Write(Recorder_t *r)
+{
+    ssize_t n = write(r->fd, r->block, r->block_len);
+    if (n != (ssize_t)r->block_len) {
+        ESP_LOGE(TAG, "Write at %lu failed", (unsigned long)r->written);
+        r->full = true;
+    } else {
+        r->written += r->block_len;
+    }
+    r->block_len = 0;
+    if (r->written >= r->reserved) {
+        r->full = true;
+    }
+}
+
+// Callers keep within the reservation
+static void Block_Append(Recorder_t *r, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    while (len > 0) {
+        size_t n = MIC_RECORDER_BLOCK - r->block_len;
+        n = n < len ? n : len;
+        memcpy(r->block + r->block_len, p, n);
+        r->block_len += n;
+        p += n;
+        len -= n;
+        if (r->block_len == MIC_RECORDER_BLOCK) {
+            Block_Write(r);
+        }
+    }
+}
+
+static void Ring_Read(Recorder_t *r, uint8_t *out, size_t len)
+{
+    size_t pos = r->ring_out % MIC_RECORDER_RING;
+    size_t first = MIC_RECORDER_RING - pos < len ? MIC_RECORDER_RING - pos : len;
+    memcpy(out, r->ring + pos, first);
+    memcpy(out + first, r->ring, len - first);
+    __atomic_store_n(&r->ring_out, r->ring_out + len, __ATOMIC_RELEASE);   // The copy before the space
+}
+
+static void Ogg_Crc_Init(void)
+{
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i << 24;
+        for (int b = 0; b < 8; ++b) {
+            crc = crc & 0x80000000 ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+        }
+        ogg_crc_table[i] = crc;
+    }
+}
+
+static uint32_t Ogg_Crc(uint32_t crc, const uint8_t *p, size_t len)
+{
+    while (len--) {
+        crc = (crc << 8) ^ ogg_crc_table[(crc >> 24) ^ *p++];
+    }
+    return crc;
+}
+
+// Returns false, keeping the page, if it would not leave room for the last one
+static bool Ogg_Flush(Recorder_t *r, bool last)
+{
+    if (r->segments == 0 && !last) {
+        return true;
+    }
+    size_t header = OGG_PAGE_HEADER + r->segments;
+    uint32_t limit = last ? r->reserved : r->reserved - OGG_PAGE_MAX;
+    if (r->written + r->block_len + header + r->body_len > limit) {
+        return false;
+    }
+    uint8_t *h = r->page;
+    memcpy(h, "OggS", 4);
+    h[4] = 0;
+    h[5] = (r->sequence == 0 ? 0x02 : 0) | (last ? 0x04 : 0);
+    put_le64(h + 6, r->page_granule);
+    put_le32(h + 14, r->serial);
+    put_le32(h + 18, r->sequence++);
+    put_le32(h + 22, 0);
+    h[26] = r->segments;
+    uint32_t crc = Ogg_Crc(Ogg_Crc(0, h, header), r->body, r->body_len);
+    put_le32(h + 22, crc);
+    Block_Append(r, h, header);
+    Block_Append(r, r->body, r->body_len);
+    r->segments = 0;
+    r->body_len = 0;
+    r->page_packets = 0;
+    return true;
+}
+
+static void Ogg_Packet(Recorder_t *r, const uint8_t *data, size_t len, uint64_t granule)
+{
+    size_t lacing = len / 255 + 1;
+    if (r->segments + lacing > 255 || r->body_len + len > OGG_PAGE_BODY || r->page_packets == OGG_PAGE_PACKETS) {
+        if (!Ogg_Flush(r, false)) {
+            r->full = true;
+            return;
+        }
+    }
+    for (size_t i = 1; i < lacing; ++i) {
+        r->page[OGG_PAGE_HEADER + r->segments++] = 255;
+    }
+    r->page[OGG_PAGE_HEADER + r->segments++] = len % 255;
+    memcpy(r->body + r->body_len, data, len);
+    r->body_len += len;
+    r->page_packets++;
+    r->page_granule = granule;
+}
+
+// OpusHead and OpusTags (RFC 7845 section 5), each on a page of its own
+static bool Opus_Headers(Recorder_t *r)
+{
+    uint8_t head[19];
+    memcpy(head, "OpusHead", 8);
+    head[8] = 1;
+    head[9] = r->channels;
+    put_le16(head + 10, OPUS_PRE_SKIP);
+    put_le32(head + 12, MIC_RECORDER_RATE);
+    put_le16(head + 16, 0);
+    head[18] = 0;
+    Ogg_Packet(r, head, sizeof(head), 0);
+    if (!Ogg_Flush(r, false)) {
+        return false;
+    }
+
+    static const char vendor[] = "ESPCaster";
+    uint8_t tags[8 + 4 + sizeof(vendor) - 1 + 4];
+    memcpy(tags, "OpusTags", 8);
+    put_le32(tags + 8, sizeof(vendor) - 1);
+    memcpy(tags + 12, vendor, sizeof(vendor) - 1);
+    put_le32(tags + 12 + sizeof(vendor) - 1, 0);
+    Ogg_Packet(r, tags, sizeof(tags), 0);
+    return Ogg_Flush(r, false);
+}
+
+static bool Opus_Open(Recorder_t *r)
+{
+    esp_opus_enc_config_t config = ESP_OPUS_ENC_CONFIG_DEFAULT();
+    config.sample_rate = MIC_RECORDER_RATE;
+    config.channel = r->channels;
+    config.bits_per_sample = 16;
+    config.bitrate = CONFIG_MIC_RECORDER_OPUS_KBPS * 1000;
+    config.frame_duration = ESP_OPUS_ENC_FRAME_DURATION_20_MS;
+    config.application_mode = ESP_OPUS_ENC_APPLICATION_VOIP;
+    if (esp_opus_enc_open(&config, sizeof(config), &r->encoder) != ESP_AUDIO_ERR_OK) {
+        r->encoder = NULL;
+        return false;
+    }
+    int in_size = 0, out_size = 0;
+    esp_opus_enc_get_frame_size(r->encoder, &in_size, &out_size);
+    r->pcm_size = in_size;
+    r->pcm = malloc(in_size);
+    r->packet_size = out_size;
+    r->packet = malloc(out_size);
+    r->body = heap_caps_malloc(OGG_PAGE_BODY, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    r->serial = esp_random();
+    return in_size > 0 && r->pcm && r->packet && r->body;
+}
+
+// frames of r->pcm are audio, the rest is padding
+static void Opus_Encode(Recorder_t *r, uint32_t frames)
+{
+    esp_audio_enc_in_frame_t in = { .buffer = r->pcm, .len = r->pcm_size };
+    esp_audio_enc_out_frame_t out = { .buffer = r->packet, .len = r->packet_size };
+    if (esp_opus_enc_process(r->encoder, &in, &out) != ESP_AUDIO_ERR_OK) {
+        ESP_LOGW(TAG, "Encoding failed");
+        return;
+    }
+    r->frames += frames;
+    r->granule += r->pcm_size / (r->channels * sizeof(int16_t)) * OPUS_GRANULE_RATIO;
+    Ogg_Packet(r, r->packet, out.encoded_bytes, r->granule);
+}
+
+static void Recorder_Drain(Recorder_t *r, bool stopping)
+{
+    uint32_t in = __atomic_load_n(&r->ring_in, __ATOMIC_ACQUIRE);
+    size_t frame = r->channels * sizeof(int16_t);
+    if (r->opus) {
+        while (!r->full && in - r->ring_out >= r->pcm_size) {
+            Ring_Read(r, r->pcm, r->pcm_size);
+            Opus_Encode(r, r->pcm_size / frame);
+        }
+        if (stopping && !r->full && in != r->ring_out) {
+            // The last partial frame, padded with silence
+            size_t left = in - r->ring_out;
+            memset(r->pcm, 0, r->pcm_size);
+            Ring_Read(r, r->pcm, left);
+            Opus_Encode(r, left / frame);
+        }
+        return;
+    }
+    // WAV is the samples as they are, straight into the block
+    while (!r->full && in != r->ring_out) {
+        size_t n = MIC_RECORDER_BLOCK - r->block_len;
+        n = n < in - r->ring_out ? n : in - r->ring_out;
+        Ring_Read(r, r->block + r->block_len, n);
+        r->block_len += n;
+        r->frames += n / frame;
+        if (r->block_len == MIC_RECORDER_BLOCK) {
+            Block_Write(r);
+        }
+    }
+}
+
+static void Recorder_Finish(Recorder_t *r)
+{
+    if (r->opus) {
+        // The end of the last packet's padding is trimmed by its granule position
+        uint64_t end = OPUS_PRE_SKIP + (uint64_t)r->frames * OPUS_GRANULE_RATIO;
+        if (r->segments > 0 && end < r->page_granule) {
+            r->page_granule = end;
+        }
+        Ogg_Flush(r, true);
+    }
+    if (r->block_len > 0) {
+        Block_Write(r);
+    }
+    if (!r->opus && r->written >= WAV_HEADER) {
+        uint8_t header[WAV_HEADER];
+        size_t frame = r->channels * sizeof(int16_t);
+        Wav_Header(header, r->channels, (r->written - WAV_HEADER) / frame * frame);
+        if (lseek(r->fd, 0, SEEK_SET) != 0 || write(r->fd, header, sizeof(header)) != sizeof(header)) {
+            ESP_LOGE(TAG, "Could not complete the header of %s", r->path);
+        }
+    }
+    // Give back the reservation past the end
+    ftruncate(r->fd, r->written);
+    fsync(r->fd);
+    close(r->fd);
+    r->fd = -1;
+    ESP_LOGI(TAG, "%s: %lu ms, %lu bytes, %lu frames dropped", r->path,
+             (unsigned long)((uint64_t)r->frames * 1000 / MIC_RECORDER_RATE),
+             (unsigned long)r->written, (unsigned long)r->dropped);
+    r->finished = true;
+}
+
+static void Recorder_Task(void *parameter)
+{
+    Recorder_t *r = parameter;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        bool stopping = __atomic_load_n(&r->stopping, __ATOMIC_ACQUIRE);
+        if (!r->finished) {
+            Recorder_Drain(r, stopping);
+            if (stopping || r->full) {
+                Recorder_Finish(r);
+            }
+        }
+        if (stopping) {
+            break;
+        }
+    }
+    xSemaphoreGive(r->done);
+    vTaskDelete(NULL);
+}
+
+static void Recorder_Free(Recorder_t *r)
+{
+    if (r->fd >= 0) {
+        close(r->fd);
+    }
+    if (r->encoder) {
+        esp_opus_enc_close(r->encoder);
+    }
+    heap_caps_free(r->ring);
+    heap_caps_free(r->block);
+    heap_caps_free(r->body);
+    free(r->pcm);
+    free(r->packet);
+    if (r->done) {
+        vSemaphoreDelete(r->done);
+    }
+    free(r);
+}
+
+bool MIC_Recorder_Start(const MIC_Recorder_Config_t *config)
+{
+    if (recorder && !recorder->finished) {
+        ESP_LOGW(TAG, "Already recording");
+        return false;
+    }
+    MIC_Recorder_Stop();
+    if (!ogg_crc_table[1]) {
+        Ogg_Crc_Init();
+    }
+
+    Recorder_t *r = calloc(1, sizeof(Recorder_t));
+    if (!r) {
+        return false;
+    }
+    r->fd = -1;
+    strlcpy(r->path, config->path, sizeof(r->path));
+    r->channels = config->channels == 1 ? 1 : 2;
+    r->opus = config->opus;
+    uint32_t seconds = config->max_seconds ? config->max_seconds : CONFIG_MIC_RECORDER_MAX_SECONDS;
+    uint64_t bytes = r->opus ? (uint64_t)seconds * CONFIG_MIC_RECORDER_OPUS_KBPS * 1000 / 8 * 5 / 4 + 2 * OGG_PAGE_MAX
+                             : WAV_HEADER + (uint64_t)seconds * MIC_RECORDER_RATE * r->channels * sizeof(int16_t);
+    bytes = (bytes + MIC_RECORDER_BLOCK - 1) / MIC_RECORDER_BLOCK * MIC_RECORDER_BLOCK;
+    r->reserved = bytes < UINT32_MAX / MIC_RECORDER_BLOCK * MIC_RECORDER_BLOCK ? bytes : UINT32_MAX / MIC_RECORDER_BLOCK * MIC_RECORDER_BLOCK;
+
+    r->ring = heap_caps_malloc(MIC_RECORDER_RING, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    r->block = heap_caps_aligned_alloc(4, MIC_RECORDER_BLOCK, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    r->done = xSemaphoreCreateBinary();
+    if (!r->ring || !r->block || !r->done || (r->opus && !Opus_Open(r))) {
+        ESP_LOGE(TAG, "Out of memory");
+        Recorder_Free(r);
+        return false;
+    }
+
+    // One run of clusters for the whole recording: a write never waits on the FAT
+    esp_err_t err = esp_vfs_fat_create_contiguous_file(SD_MOUNT_POINT, r->path, r->reserved, true);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "No contiguous %lu bytes for %s (%s), allocating as it is written",
+                 (unsigned long)r->reserved, r->path, esp_err_to_name(err));
+    }
+    r->fd = open(r->path, err == ESP_OK ? O_WRONLY : O_WRONLY | O_CREAT | O_TRUNC);
+    if (r->fd < 0) {
+        ESP_LOGE(TAG, "Failed to open %s", r->path);
+        Recorder_Free(r);
+        return false;
+    }
+
+    if (r->opus) {
+        Opus_Headers(r);
+    } else {
+        // Covers the whole reservation until the end is known
+        Wav_Header(r->block, r->channels, r->reserved - WAV_HEADER);
+        r->block_len = WAV_HEADER;
+    }
+
+    if (xTaskCreatePinnedToCore(Recorder_Task, "MIC Recorder",
+                                r->opus ? MIC_RECORDER_OPUS_STACK_SIZE : MIC_RECORDER_STACK_SIZE,
+                                r, MIC_RECORDER_PRIORITY, &r->task, MIC_RECORDER_CORE) != pdPASS) {
+        Recorder_Free(r);
+        return false;
+    }
+    taskENTER_CRITICAL(&recorder_lock);
+    recorder = r;
+    taskEXIT_CRITICAL(&recorder_lock);
+    ESP_LOGI(TAG, "Recording %s, %lu KB reserved", r->path, (unsigned long)(r->reserved / 1024));
+    return true;
+}
+
+void MIC_Recorder_Stop(void)
+{
+    Recorder_t *r = recorder;
+    if (!r) {
+        return;
+    }
+    taskENTER_CRITICAL(&recorder_lock);
+    recorder = NULL;
+    taskEXIT_CRITICAL(&recorder_lock);
+    // Once the feed task is out, nothing else touches the ring or notifies the writer
+    while (__atomic_load_n(&r->feeding, __ATOMIC_ACQUIRE)) {
+        vTaskDelay(1);
+    }
+    __atomic_store_n(&r->stopping, true, __ATOMIC_RELEASE);
+    xTaskNotifyGive(r->task);
+    xSemaphoreTake(r->done, portMAX_DELAY);
+    Recorder_Free(r);
+}
+
+bool MIC_Recorder_Active(void)
+{
+    Recorder_t *r = recorder;
+    return r && !r->finished;
+}
+
+void MIC_Recorder_Feed(const int16_t *block, size_t frames)
+{
+    taskENTER_CRITICAL(&recorder_lock);
+    Recorder_t *r = recorder;
+    if (r) {
+        r->feeding = true;
+    }
+    taskEXIT_CRITICAL(&recorder_lock);
+    if (!r) {
+        return;
+    }
+
+    if (!r->finished) {
+        size_t bytes = frames * r->channels * sizeof(int16_t);
+        uint32_t in = r->ring_in;
+        uint32_t out = __atomic_load_n(&r->ring_out, __ATOMIC_ACQUIRE);
+        size_t pos = in % MIC_RECORDER_RING;
+        if (MIC_RECORDER_RING - (in - out) < bytes) {
+            r->dropped += frames;
+        } else if (r->channels == 2) {
+            size_t first = MIC_RECORDER_RING - pos < bytes ? MIC_RECORDER_RING - pos : bytes;
+            memcpy(r->ring + pos, block, first);
+            memcpy(r->ring, (const uint8_t *)block + first, bytes - first);
+            __atomic_store_n(&r->ring_in, in + bytes, __ATOMIC_RELEASE);
+        } else {
+            int16_t *ring = (int16_t *)r->ring;
+            pos /= sizeof(int16_t);
+            for (size_t i = 0; i < frames; ++i) {
+                ring[pos] = block[2 * i];
+                pos = (pos + 1) % (MIC_RECORDER_RING / sizeof(int16_t));
+            }
+            __atomic_store_n(&r->ring_in, in + bytes, __ATOMIC_RELEASE);
+        }
+        xTaskNotifyGive(r->task);
+    }
+    __atomic_store_n(&r->feeding, false, __ATOMIC_RELEASE);
+}
+
+#else
+
+bool MIC_Recorder_Start(const MIC_Recorder_Config_t *config)
+{
+    return false;
+}
+
+void MIC_Recorder_Stop(void)
+{
+}
+
+bool MIC_Recorder_Active(void)
+{
+    return false;
+}
+
+void MIC_Recorder_Feed(const int16_t *block, size_t frames)
+{
+}
+
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "task_plan.h"
+
+/*
+ * Recording from the microphone to the SD card (CONFIG_MIC_RECORDER): voice
+ * memos, or the AFE's input for debugging.
+ *
+ * The speech feed task hands every block it converts to MIC_Recorder_Feed(),
+ * which only copies it into a PSRAM ring and never waits: a block the ring
+ * has no room for is dropped and counted. A writer task below the audio and
+ * speech tasks empties the ring. The file is preallocated in one contiguous
+ * run of clusters (f_expand) for max_seconds, so no write looks up the FAT
+ * or allocates, and it is written in whole MIC_RECORDER_BLOCK writes from
+ * DMA-capable RAM at block-aligned offsets; any card stall is absorbed by
+ * the ring. At the end the header is completed and the unused space
+ * truncated.
+ *
+ * WAV is 16-bit PCM at MIC_RECORDER_RATE. Ogg Opus (RFC 7845) is encoded on
+ * the writer task with esp_audio_codec in 20 ms frames, about a tenth of
+ * the write volume at CONFIG_MIC_RECORDER_OPUS_KBPS.
+ *
+ * One recording at a time; Start and Stop from one task.
+ */
+
+#define MIC_RECORDER_RATE           16000       // The AFE's rate
+#define MIC_RECORDER_BLOCK          (32 * 1024) // One write, a whole number of sectors
+#define MIC_RECORDER_RING           (8 * MIC_RECORDER_BLOCK)    // PSRAM: 4 s of both channels
+#define MIC_RECORDER_PRIORITY       TASK_PLAN_RECORDER_PRIORITY     // Below the speech and audio tasks
+#define MIC_RECORDER_CORE           TASK_PLAN_RECORDER_CORE
+#define MIC_RECORDER_STACK_SIZE     3072
+#define MIC_RECORDER_OPUS_STACK_SIZE (24 * 1024)    // The Opus encoder works on the stack
+
+typedef struct {
+    const char *path;           // e.g. "/sdcard/memo.wav"; copied
+    uint8_t channels;           // 1: the microphone, 2: the microphone then the playback reference
+    bool opus;                  // Ogg Opus instead of WAV
+    uint32_t max_seconds;       // Space reserved, the recording stops there; 0 for CONFIG_MIC_RECORDER_MAX_SECONDS
+} MIC_Recorder_Config_t;
+
+// false if disabled, already recording, or the file or buffers could not be set up
+bool MIC_Recorder_Start(const MIC_Recorder_Config_t *config);
+// Returns once the file is complete and closed; also cleans up after a recording that ran full
+void MIC_Recorder_Stop(void);
+bool MIC_Recorder_Active(void);
+
+// Speech feed task only: frames of interleaved microphone/reference samples
+void MIC_Recorder_Feed(const int16_t *block, size_t frames);
@@ -6,15 +6,48 @@
 #include "soc/soc_caps.h"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include <string.h>
 
 #include "esp_wn_iface.h"
 #include "esp_wn_models.h"
 #include "esp_afe_sr_models.h"
 #include "esp_mn_iface.h"
 #include "esp_mn_models.h"
+#include "esp_mn_speech_commands.h"
+
+#include "voice_actions.h"
+#include "voice_vocabulary.h"
+#include "Audio_Reference.h"
+#include "MIC_Recorder.h"
+#include "mem_task.h"
+#include "task_plan.h"
 
 #define I2S_CHANNEL_NUM 1
 
+// Energy gate in front of the AFE: blocks are only fed (and WakeNet only
+// runs) while the microphone is over its noise floor, for a hangover after
+// that, while something is playing, or while a command is being listened for
+#define SPEECH_GATE_OPEN_RATIO      4       // Block energy over the noise floor: 6 dB
+#define SPEECH_GATE_MIN_ENERGY      400     // Mean square, about -38 dBFS
+#define SPEECH_GATE_FLOOR_RISE      6       // The floor creeps up by 1/64 per block, ~3 dB/s
+#define SPEECH_GATE_HANGOVER_US     1500000 // Keeps the gate open across the wake word's syllables
+#define SPEECH_GATE_PREROLL         3       // Blocks held back so the wake word's onset is fed too
+
+// MultiNet command IDs (CONFIG_EN_SPEECH_COMMAND_IDn) handed to voice_actions
+static const struct {
+    command_word_t command;
+    voice_action_t action;
+} voice_commands[] = {
+    {COMMAND_ID6,  VOICE_ACTION_VOLUME_UP},
+    {COMMAND_ID7,  VOICE_ACTION_VOLUME_DOWN},
+    {COMMAND_ID8,  VOICE_ACTION_MUTE},
+    {COMMAND_ID9,  VOICE_ACTION_PLAY},
+    {COMMAND_ID10, VOICE_ACTION_PAUSE},
+    {COMMAND_ID11, VOICE_ACTION_NEXT},
+};
+
 static const char *TAG = "App/Speech";
 
 static i2s_chan_handle_t                rx_handle = NULL;        // I2S rx channel handler
@@ -40,38 +73,230 @@ static esp_err_t i2s_init(i2s_port_t i2s_num, uint32_t sample_rate, int channel_
     return ret_val;
 }
 
+// One pass from the 32-bit I2S words to the AFE's interleaved mic/reference
+// layout, summing the microphone's energy on the way; returns its mean square
+static uint32_t convert_block(const int32_t *in, const int16_t *ref, int16_t *out, size_t len)
+{
+    int64_t energy = 0;
+    size_t i = 0;
+    // 32:8 is the significant bit, 8:0 is the low 8 bits, all 0, the AFE input is 16 bits of voice data, the 29:13 bit is to amplify the voice signal.
+    for (; i + 4 <= len; i += 4) {
+        int16_t m0 = in[i] >> 14, m1 = in[i + 1] >> 14, m2 = in[i + 2] >> 14, m3 = in[i + 3] >> 14;
+        out[2 * i] = m0;     out[2 * i + 1] = ref[i];
+        out[2 * i + 2] = m1; out[2 * i + 3] = ref[i + 1];
+        out[2 * i + 4] = m2; out[2 * i + 5] = ref[i + 2];
+        out[2 * i + 6] = m3; out[2 * i + 7] = ref[i + 3];
+        energy += (int32_t)m0 * m0 + (int32_t)m1 * m1 + (int32_t)m2 * m2 + (int32_t)m3 * m3;
+    }
+    for (; i < len; ++i) {
+        int16_t m = in[i] >> 14;
+        out[2 * i] = m;
+        out[2 * i + 1] = ref[i];
+        energy += (int32_t)m * m;
+    }
+    return len ? (uint32_t)(energy / len) : 0;
+}
+
+static bool reference_playing(const int16_t *ref, size_t len)
+{
+    for (size_t i = 0; i < len; ++i) {
+        if (ref[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
 static void feed_handler(AppSpeech *self)
 {
     esp_afe_sr_data_t *afe_data = self->afe_data;
     int audio_chunksize = self->afe_handle->get_feed_chunksize(afe_data);
     int nch = self->afe_handle->get_channel_num(afe_data);
-    (void)nch;
+    assert(nch == I2S_CHANNEL_NUM + 1);     // The microphone, then the playback reference
     size_t samp_len = audio_chunksize;
     size_t samp_len_bytes = samp_len * I2S_CHANNEL_NUM * sizeof(int32_t);
     int32_t *i2s_buff = (int32_t *)malloc(samp_len_bytes);
-    assert(i2s_buff);
+    int16_t *ref_buff = (int16_t *)malloc(samp_len * sizeof(int16_t));
+    // The block being converted plus the pre-roll, used round robin
+    int16_t *feed_buffs[SPEECH_GATE_PREROLL + 1];
+    for (int b = 0; b <= SPEECH_GATE_PREROLL; ++b) {
+        feed_buffs[b] = (int16_t *)malloc(samp_len * nch * sizeof(int16_t));
+        assert(feed_buffs[b]);
+    }
+    assert(i2s_buff && ref_buff);
     size_t bytes_read;
-    // FILE *fp = fopen("/sdcard/out", "a+");
-    // if (fp == NULL) ESP_LOGE(TAG,"can not open file\n");
+    uint32_t noise_floor = SPEECH_GATE_MIN_ENERGY;
+    int64_t open_until = 0;
+    int held = 0;           // Pre-roll blocks waiting in feed_buffs
+    int current = 0;
 
     while (true)
     {
         i2s_channel_read(rx_handle, i2s_buff, samp_len_bytes, &bytes_read, portMAX_DELAY);
+        // The read returns as the DMA completes the block: its last sample is from now
+        int64_t now = esp_timer_get_time();
+        Audio_Reference_Read(ref_buff, samp_len, now);
 
-        for (int i = 0; i < samp_len; ++i)
-        {
-            i2s_buff[i] = i2s_buff[i] >> 14; // 32:8 is the significant bit, 8:0 is the low 8 bits, all 0, the AFE input is 16 bits of voice data, the 29:13 bit is to amplify the voice signal.
+        int16_t *feed_buff = feed_buffs[current];
+        uint32_t energy = convert_block(i2s_buff, ref_buff, feed_buff, samp_len);
+        MIC_Recorder_Feed(feed_buff, samp_len);     // Never blocks: a copy into the recorder's ring
+
+        bool voice = energy >= SPEECH_GATE_MIN_ENERGY && energy / SPEECH_GATE_OPEN_RATIO > noise_floor;
+        if (energy < noise_floor) {
+            noise_floor = energy > SPEECH_GATE_MIN_ENERGY / SPEECH_GATE_OPEN_RATIO ? energy : SPEECH_GATE_MIN_ENERGY / SPEECH_GATE_OPEN_RATIO;
+        } else if (!voice) {
+            noise_floor += (noise_floor >> SPEECH_GATE_FLOOR_RISE) + 1;
+        }
+        if (voice || self->detected || reference_playing(ref_buff, samp_len)) {
+            open_until = now + SPEECH_GATE_HANGOVER_US;
         }
-        // FatfsComboWrite(i2s_buff, audio_chunksize * I2S_CHANNEL_NUM * sizeof(int16_t), 1, fp);
 
-        self->afe_handle->feed(afe_data, (int16_t *)i2s_buff);
+        if (now >= open_until) {
+            // Silent: hold the block back, dropping the oldest
+            held = held < SPEECH_GATE_PREROLL ? held + 1 : SPEECH_GATE_PREROLL;
+            current = (current + 1) % (SPEECH_GATE_PREROLL + 1);
+            continue;
+        }
+        if (held) {
+            ESP_LOGD(TAG, "Voice activity, feeding the AFE");
+            for (int b = held; b > 0; --b) {
+                self->afe_handle->feed(afe_data, feed_buffs[(current + SPEECH_GATE_PREROLL + 1 - b) % (SPEECH_GATE_PREROLL + 1)]);
+            }
+            held = 0;
+        }
+        self->afe_handle->feed(afe_data, feed_buff);
     }
     self->afe_handle->destroy(afe_data);
-    if (i2s_buff) {
-        free(i2s_buff);
-        i2s_buff = NULL;
+    free(i2s_buff);
+    free(ref_buff);
+    for (int b = 0; b <= SPEECH_GATE_PREROLL; ++b) {
+        free(feed_buffs[b]);
+    }
+    mem_task_delete(NULL);
+}
+
+static bool post_voice_command(int command_id)
+{
+    if (voice_vocabulary_owns(command_id)) {
+        if (!voice_actions_post((voice_action_t)command_id)) {
+            ESP_LOGW(TAG, "Event bus full, voice command %d dropped", command_id);
+        }
+        return true;
     }
-    vTaskDelete(NULL);
+    for (size_t i = 0; i < sizeof(voice_commands) / sizeof(voice_commands[0]); ++i) {
+        if (voice_commands[i].command == command_id) {
+            if (!voice_actions_post(voice_commands[i].action)) {
+                ESP_LOGW(TAG, "Event bus full, voice command %d dropped", command_id);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+// MultiNet and its phrases. With CONFIG_SPEECH_MULTINET_ON_DEMAND the model
+// only exists from the wake word to the command window's timeout; its
+// phrases outlive it in phrases[], where voice_vocabulary's edits go
+// meanwhile, and are taught to each new instance. The model itself is
+// mapped from flash, so a load is its working memory and the phrase graph.
+#define SPEECH_MN_DURATION_MS       6000    // Command window
+#define SPEECH_MN_MAX_PHRASES       128
+
+typedef struct {
+    int command_id;
+    char string[ESP_MN_MAX_PHRASE_LEN + 1];
+} speech_phrase_t;
+
+static struct {
+    char *name;
+    esp_mn_iface_t *iface;
+    model_iface_data_t *data;       // NULL while unloaded
+    speech_phrase_t *phrases;       // PSRAM, SPEECH_MN_MAX_PHRASES of them
+    size_t phrase_count;
+} s_mn;
+
+static void report_phrase_errors(esp_mn_error_t *errors)
+{
+    for (int i = 0; errors && i < errors->num; ++i) {
+        ESP_LOGW(TAG, "Phrase \"%s\" not recognizable", errors->phrases[i]->string);
+    }
+}
+
+// The loaded model's phrases, for when it is gone
+static void mn_snapshot_phrases(void)
+{
+    esp_mn_phrase_t *phrase;
+    s_mn.phrase_count = 0;
+    while (s_mn.phrase_count < SPEECH_MN_MAX_PHRASES &&
+           (phrase = esp_mn_commands_get_from_index(s_mn.phrase_count)) != NULL) {
+        speech_phrase_t *copy = &s_mn.phrases[s_mn.phrase_count++];
+        copy->command_id = phrase->command_id;
+        strlcpy(copy->string, phrase->string, sizeof(copy->string));
+    }
+}
+
+static bool mn_load(void)
+{
+    int64_t start = esp_timer_get_time();
+    s_mn.data = s_mn.iface->create(s_mn.name, SPEECH_MN_DURATION_MS);
+    if (!s_mn.data) {
+        ESP_LOGE(TAG, "MultiNet not created");
+        return false;
+    }
+    esp_mn_commands_alloc(s_mn.iface, s_mn.data);
+    for (size_t i = 0; i < s_mn.phrase_count; ++i) {
+        // One the model turns down is not in the next snapshot
+        if (esp_mn_commands_add(s_mn.phrases[i].command_id, s_mn.phrases[i].string) != ESP_OK) {
+            ESP_LOGW(TAG, "Phrase \"%s\" not recognizable", s_mn.phrases[i].string);
+        }
+    }
+    report_phrase_errors(esp_mn_commands_update());
+    ESP_LOGI(TAG, "MultiNet loaded in %d ms, %d phrases", (int)((esp_timer_get_time() - start) / 1000),
+             (int)s_mn.phrase_count);
+    return true;
+}
+
+#if CONFIG_SPEECH_MULTINET_ON_DEMAND
+static void mn_unload(void)
+{
+    mn_snapshot_phrases();
+    esp_mn_commands_free();     // Drops its model pointers too, so no edit reaches a freed model
+    s_mn.iface->destroy(s_mn.data);
+    s_mn.data = NULL;
+    ESP_LOGI(TAG, "MultiNet unloaded, %u bytes of PSRAM free", (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+}
+#endif
+
+static bool snapshot_edit(bool add, int command_id, const char *phrase)
+{
+    for (size_t i = 0; i < s_mn.phrase_count; ++i) {
+        if (strcmp(s_mn.phrases[i].string, phrase) == 0) {
+            if (add) {
+                s_mn.phrases[i].command_id = command_id;
+            } else {
+                s_mn.phrase_count--;
+                memmove(&s_mn.phrases[i], &s_mn.phrases[i + 1], (s_mn.phrase_count - i) * sizeof(speech_phrase_t));
+            }
+            return true;
+        }
+    }
+    if (!add || s_mn.phrase_count >= SPEECH_MN_MAX_PHRASES || strlen(phrase) > ESP_MN_MAX_PHRASE_LEN) {
+        return false;
+    }
+    speech_phrase_t *entry = &s_mn.phrases[s_mn.phrase_count++];
+    entry->command_id = command_id;
+    strlcpy(entry->string, phrase, sizeof(entry->string));
+    return true;
+}
+
+// voice_vocabulary's phrases, added and removed on this task between fetches;
+// while MultiNet is unloaded they are only checked as it loads
+static bool edit_vocabulary(bool add, int command_id, const char *phrase)
+{
+    if (!s_mn.data) {
+        return snapshot_edit(add, command_id, phrase);
+    }
+    return (add ? esp_mn_commands_add(command_id, phrase) : esp_mn_commands_remove(phrase)) == ESP_OK;
 }
 
 static void detect_hander(AppSpeech *self)
@@ -79,22 +304,31 @@ static void detect_hander(AppSpeech *self)
     esp_afe_sr_data_t *afe_data = self->afe_data;
     int afe_chunksize = self->afe_handle->get_fetch_chunksize(afe_data);
 #if defined(CONFIG_SR_MN_CN_MULTINET5_RECOGNITION_QUANT8) || defined(CONFIG_SR_MN_CN_MULTINET6_QUANT) || defined(CONFIG_SR_MN_CN_MULTINET6_AC_QUANT)
-    char *mn_name = esp_srmodel_filter(self->models, ESP_MN_PREFIX, ESP_MN_CHINESE);
+    s_mn.name = esp_srmodel_filter(self->models, ESP_MN_PREFIX, ESP_MN_CHINESE);
 #else
-    char *mn_name = esp_srmodel_filter(self->models, ESP_MN_PREFIX, ESP_MN_ENGLISH);
+    s_mn.name = esp_srmodel_filter(self->models, ESP_MN_PREFIX, ESP_MN_ENGLISH);
 #endif // CONFIG_IDF_TARGET_ESP32S3
-    ESP_LOGI(TAG, "multinet:%s\n", mn_name);
-    esp_mn_iface_t *multinet = esp_mn_handle_from_name(mn_name);
-    model_iface_data_t *model_data = multinet->create(mn_name, 6000);
-    esp_mn_commands_update_from_sdkconfig(multinet, model_data); // Add speech commands from sdkconfig
-    int mu_chunksize = multinet->get_samp_chunksize(model_data);
+    ESP_LOGI(TAG, "multinet:%s\n", s_mn.name);
+    s_mn.iface = esp_mn_handle_from_name(s_mn.name);
+    s_mn.phrases = heap_caps_calloc(SPEECH_MN_MAX_PHRASES, sizeof(speech_phrase_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    assert(s_mn.phrases);
+
+    // The first instance takes the sdkconfig commands, the phrases every later one is taught
+    s_mn.data = s_mn.iface->create(s_mn.name, SPEECH_MN_DURATION_MS);
+    assert(s_mn.data);
+    esp_mn_commands_update_from_sdkconfig(s_mn.iface, s_mn.data); // Add speech commands from sdkconfig
+    esp_mn_iface_t *multinet = s_mn.iface;
+    int mu_chunksize = multinet->get_samp_chunksize(s_mn.data);
     assert(mu_chunksize == afe_chunksize);
 
     // FILE *fp = fopen("/sdcard/out", "w");
     // if (fp == NULL) ESP_LOGE(TAG,"can not open file\n");
 
     //print active speech commands
-    multinet->print_active_speech_commands(model_data);
+    multinet->print_active_speech_commands(s_mn.data);
+#if CONFIG_SPEECH_MULTINET_ON_DEMAND
+    mn_unload();
+#endif
     ESP_LOGI(TAG, "Ready");
 
     self->detected = false;
@@ -107,11 +341,23 @@ static void detect_hander(AppSpeech *self)
             break;
         }
 
+        // Never while a command is being listened for: the update rebuilds the recognizer
+        if (!self->detected && voice_vocabulary_apply(edit_vocabulary) && s_mn.data) {
+            report_phrase_errors(esp_mn_commands_update());
+        }
+
         if (res->wakeup_state == WAKENET_DETECTED) {
             ESP_LOGI(TAG, "WAKEWORD DETECTED\n");
-	        multinet->clean(model_data);  // clean all status of multinet
+            // Loaded while the channel is verified, before the command starts
+            if (s_mn.data) {
+                multinet->clean(s_mn.data);  // clean all status of multinet
+            } else if (!mn_load()) {
+                continue;
+            }
             LCD_Backlight_original = LCD_Backlight;
-        } else if (res->wakeup_state == WAKENET_CHANNEL_VERIFIED) {
+            // Connections are readied while the command is still being spoken
+            voice_actions_post(VOICE_ACTION_WAKE);
+        } else if (res->wakeup_state == WAKENET_CHANNEL_VERIFIED && s_mn.data) {
             ESP_LOGI(TAG, "AFE_FETCH_CHANNEL_VERIFIED, channel index: %d\n", res->trigger_channel_id);
             ESP_LOGI(TAG, ">>> Say your command <<<");
             self->detected = true;
@@ -121,13 +367,13 @@ static void detect_hander(AppSpeech *self)
         }
 
         if (self->detected) {
-            esp_mn_state_t mn_state = multinet->detect(model_data, res->data);
+            esp_mn_state_t mn_state = multinet->detect(s_mn.data, res->data);
 
             if (mn_state == ESP_MN_STATE_DETECTING) {
                 self->command = COMMAND_NOT_DETECTED;
                 continue;
             } else if (mn_state == ESP_MN_STATE_DETECTED) {
-                esp_mn_results_t *mn_result = multinet->get_results(model_data);
+                esp_mn_results_t *mn_result = multinet->get_results(s_mn.data);
                 // for (int i = 0; i < mn_result->num; i++) {
                 //     ESP_LOGI(TAG, "TOP %d, command_id: %d, phrase_id: %d, string:%s prob: %f\n", 
                 //     i+1, mn_result->command_id[i], mn_result->phrase_id[i], mn_result->string, mn_result->prob[i]);
@@ -150,7 +396,11 @@ static void detect_hander(AppSpeech *self)
                     case 4:                 
                         play_Music_Flag = 1;              
                         break;
-                    default: printf("Unknown Command!\r\n"); break;
+                    default:
+                        if (!post_voice_command(mn_result->command_id[0])) {
+                            printf("Unknown Command!\r\n");
+                        }
+                        break;
                 }
                 self->command = (command_word_t)mn_result->command_id[0];
                 // self->afe_handle->enable_wakenet(afe_data);
@@ -161,12 +411,15 @@ static void detect_hander(AppSpeech *self)
                 ESP_LOGI(TAG, ">>> Say your command <<<");
                 self->command = COMMAND_TIMEOUT;
             } else if (mn_state == ESP_MN_STATE_TIMEOUT) {
-                esp_mn_results_t *mn_result = multinet->get_results(model_data);
+                esp_mn_results_t *mn_result = multinet->get_results(s_mn.data);
                 ESP_LOGI(TAG, "timeout, string:%s\n", mn_result->string);
                 self->command = COMMAND_TIMEOUT;
                 self->afe_handle->enable_wakenet(afe_data);
                 self->detected = false;
                 ESP_LOGI(TAG, ">>> Waiting to be waken up <<<");
+#if CONFIG_SPEECH_MULTINET_ON_DEMAND
+                mn_unload();
+#endif
                 LCD_Backlight = LCD_Backlight_original;
                 if(play_Music_Flag){
                     play_Music_Flag = 0;
@@ -178,12 +431,12 @@ static void detect_hander(AppSpeech *self)
             }
         }
     }
-    if (model_data) {
-        multinet->destroy(model_data);
-        model_data = NULL;
+    if (s_mn.data) {
+        multinet->destroy(s_mn.data);
+        s_mn.data = NULL;
     }
     self->afe_handle->destroy(afe_data);
-    vTaskDelete(NULL);
+    mem_task_delete(NULL);
 }
 
 
@@ -195,6 +448,7 @@ void MIC_Speech_init()
     MIC_Speech.detected = false;
     MIC_Speech.command = COMMAND_TIMEOUT;
     MIC_Speech.models = esp_srmodel_init("model");
+    Audio_Reference_Init();     // Start recording what the speaker plays before the AFE wants it
     i2s_init(I2S_NUM_1, 16000, 2, 32);
     // sd_card_mount("/sdcard");
     afe_config_t afe_config = {
@@ -225,7 +479,8 @@ void MIC_Speech_init()
         .debug_init = false,
         .debug_hook = {{AFE_DEBUG_HOOK_MASE_TASK_IN, NULL}, {AFE_DEBUG_HOOK_FETCH_TASK_IN, NULL}},
     };
-    afe_config.aec_init = false;
+    // AEC against the playback reference keeps the wake word working over music
+    afe_config.aec_init = true;
     afe_config.se_init = false;
     afe_config.vad_init = false;
     afe_config.afe_ringbuf_size = 10;
@@ -235,6 +490,9 @@ void MIC_Speech_init()
     afe_config.pcm_config.sample_rate = 16000;
     afe_config.wakenet_model_name = esp_srmodel_filter(MIC_Speech.models, ESP_WN_PREFIX, NULL);
     MIC_Speech.afe_data = MIC_Speech.afe_handle->create_from_config(&afe_config);
-    xTaskCreatePinnedToCore((TaskFunction_t)feed_handler, "App/SR/Feed", 4 * 1024, &MIC_Speech, 5, NULL, 0);
-    xTaskCreatePinnedToCore((TaskFunction_t)detect_hander, "App/SR/Detect", 5 * 1024, &MIC_Speech, 5, NULL, 0);
+    // The feed keeps up with the I2S DMA; recognition only posts its results
+    mem_task_create((TaskFunction_t)feed_handler, "App/SR/Feed", 4 * 1024, &MIC_Speech,
+                    TASK_PLAN_SPEECH_FEED_PRIORITY, NULL, TASK_PLAN_SPEECH_FEED_CORE, MEM_TASK_STACK_INTERNAL);
+    mem_task_create((TaskFunction_t)detect_hander, "App/SR/Detect", 5 * 1024, &MIC_Speech,
+                    TASK_PLAN_SPEECH_DETECT_PRIORITY, NULL, TASK_PLAN_SPEECH_DETECT_CORE, MEM_TASK_STACK_PSRAM);
 }
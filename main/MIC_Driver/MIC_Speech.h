@@ -33,6 +33,11 @@ typedef enum
     COMMAND_ID4 = 3,
     COMMAND_ID5 = 4,
     COMMAND_ID6 = 5,
+    COMMAND_ID7 = 6,
+    COMMAND_ID8 = 7,
+    COMMAND_ID9 = 8,
+    COMMAND_ID10 = 9,
+    COMMAND_ID11 = 10,
 } command_word_t;
 
 typedef struct {
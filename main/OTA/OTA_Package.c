@@ -0,0 +1,287 @@
+#include "OTA_Package.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t Read_Le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void OTA_Package_Fail(ota_package_t *package, const char *why)
+{
+    if (!package->error) {
+        package->error = why;
+    }
+}
+
+/**********************************************************************************
+ * Output: the new image, a block at a time
+ **********************************************************************************/
+static void Output_Flush(ota_package_t *package)
+{
+    if (package->block_fill == 0 || package->error) {
+        return;
+    }
+    if (!package->io.write(package->io.ctx, package->block, package->block_fill)) {
+        OTA_Package_Fail(package, "flash write");
+        return;
+    }
+    package->written += package->block_fill;
+    package->block_fill = 0;
+}
+
+static bool Output_Room(ota_package_t *package, uint32_t length)
+{
+    if (length > package->header.image_size - package->written - package->block_fill) {
+        OTA_Package_Fail(package, "image longer than the header says");
+        return false;
+    }
+    return true;
+}
+
+static void Output_Put(ota_package_t *package, const uint8_t *data, size_t length)
+{
+    if (!Output_Room(package, length)) {
+        return;
+    }
+    while (length > 0 && !package->error) {
+        size_t n = OTA_WRITE_BLOCK - package->block_fill;
+        if (n > length) {
+            n = length;
+        }
+        memcpy(package->block + package->block_fill, data, n);
+        package->block_fill += n;
+        data += n;
+        length -= n;
+        if (package->block_fill == OTA_WRITE_BLOCK) {
+            Output_Flush(package);
+        }
+    }
+}
+
+// Straight from the running image into the output block
+static void Output_Copy(ota_package_t *package, uint32_t offset, uint32_t length)
+{
+    if (offset > package->io.base_size || length > package->io.base_size - offset) {
+        OTA_Package_Fail(package, "copy outside the running image");
+        return;
+    }
+    if (!Output_Room(package, length)) {
+        return;
+    }
+    while (length > 0 && !package->error) {
+        size_t n = OTA_WRITE_BLOCK - package->block_fill;
+        if (n > length) {
+            n = length;
+        }
+        if (!package->io.read_base(package->io.ctx, offset, package->block + package->block_fill, n)) {
+            OTA_Package_Fail(package, "reading the running image");
+            return;
+        }
+        package->block_fill += n;
+        offset += n;
+        length -= n;
+        if (package->block_fill == OTA_WRITE_BLOCK) {
+            Output_Flush(package);
+        }
+    }
+}
+
+/**********************************************************************************
+ * Payload: patch ops, inflate
+ **********************************************************************************/
+static void Patch_Feed(ota_package_t *package, const uint8_t *data, size_t length)
+{
+    while (length > 0 && !package->error) {
+        if (package->insert_left > 0) {
+            size_t n = length < package->insert_left ? length : package->insert_left;
+            Output_Put(package, data, n);
+            package->insert_left -= n;
+            data += n;
+            length -= n;
+            continue;
+        }
+        if (package->patch_done) {
+            OTA_Package_Fail(package, "patch data after its end");
+            return;
+        }
+
+        // The op may be split across chunks
+        package->op[package->op_pos++] = *data++;
+        length--;
+        size_t need;
+        switch (package->op[0]) {
+            case OTA_OP_END:    need = 1; break;
+            case OTA_OP_COPY:   need = 9; break;
+            case OTA_OP_INSERT: need = 5; break;
+            default:
+                OTA_Package_Fail(package, "unknown patch op");
+                return;
+        }
+        if (package->op_pos < need) {
+            continue;
+        }
+        package->op_pos = 0;
+        switch (package->op[0]) {
+            case OTA_OP_END:
+                package->patch_done = true;
+                break;
+            case OTA_OP_COPY:
+                Output_Copy(package, Read_Le32(package->op + 1), Read_Le32(package->op + 5));
+                break;
+            case OTA_OP_INSERT:
+                // Checked up front, so a bad length fails before its bytes download
+                package->insert_left = Read_Le32(package->op + 1);
+                Output_Room(package, package->insert_left);
+                break;
+        }
+    }
+}
+
+static void Image_Feed(ota_package_t *package, const uint8_t *data, size_t length)
+{
+    if (package->header.kind == OTA_KIND_DELTA) {
+        Patch_Feed(package, data, length);
+    } else {
+        Output_Put(package, data, length);
+    }
+}
+
+static void Inflate_Feed(ota_package_t *package, const uint8_t *data, size_t length)
+{
+    size_t used = 0;
+    while (!package->error) {
+        if (package->inflate_done) {
+            if (used < length) {
+                OTA_Package_Fail(package, "data after the deflate stream");
+            }
+            return;
+        }
+        size_t in_bytes = length - used;
+        size_t out_bytes = OTA_WINDOW_SIZE - package->window_pos;
+        tinfl_status status = tinfl_decompress(package->decompressor, data + used, &in_bytes, package->window,
+                                               package->window + package->window_pos, &out_bytes,
+                                               TINFL_FLAG_HAS_MORE_INPUT);
+        used += in_bytes;
+        if (out_bytes > 0) {
+            Image_Feed(package, package->window + package->window_pos, out_bytes);
+            // The window wraps: tinfl refers back into it for matches
+            package->window_pos = (package->window_pos + out_bytes) & (OTA_WINDOW_SIZE - 1);
+        }
+        if (status == TINFL_STATUS_DONE) {
+            package->inflate_done = true;
+        } else if (status < 0) {
+            OTA_Package_Fail(package, "corrupt deflate stream");
+        } else if (status == TINFL_STATUS_NEEDS_MORE_INPUT && used == length) {
+            return;
+        }
+    }
+}
+
+/**********************************************************************************
+ * Package
+ **********************************************************************************/
+static bool Package_Begin(ota_package_t *package)
+{
+    const ota_package_header_t *h = &package->header;
+    if (h->magic != OTA_PACKAGE_MAGIC || h->version != OTA_PACKAGE_VERSION) {
+        OTA_Package_Fail(package, "not an ESPCaster package");
+        return false;
+    }
+    if (h->kind > OTA_KIND_DELTA || h->compression > OTA_COMPRESSION_DEFLATE) {
+        OTA_Package_Fail(package, "unsupported package kind");
+        return false;
+    }
+    if (h->image_size == 0) {
+        OTA_Package_Fail(package, "empty image");
+        return false;
+    }
+    if (h->compression == OTA_COMPRESSION_DEFLATE) {
+        package->decompressor = package->io.alloc(sizeof(tinfl_decompressor));
+        package->window = package->io.alloc(OTA_WINDOW_SIZE);
+        if (!package->decompressor || !package->window) {
+            OTA_Package_Fail(package, "no memory for the inflate window");
+            return false;
+        }
+        tinfl_init(package->decompressor);
+    }
+    if (!package->io.begin(package->io.ctx, h)) {
+        OTA_Package_Fail(package, "refused");
+        return false;
+    }
+    return true;
+}
+
+void OTA_Package_Init(ota_package_t *package, const ota_package_io_t *io, uint8_t *block)
+{
+    memset(package, 0, sizeof(*package));
+    package->io = *io;
+    if (!package->io.alloc || !package->io.release) {
+        package->io.alloc = malloc;
+        package->io.release = free;
+    }
+    package->block = block;
+}
+
+void OTA_Package_Feed(ota_package_t *package, const uint8_t *data, size_t length)
+{
+    if (package->error) {
+        return;
+    }
+    if (package->header_pos < sizeof(package->header)) {
+        size_t n = sizeof(package->header) - package->header_pos;
+        if (n > length) {
+            n = length;
+        }
+        memcpy((uint8_t *)&package->header + package->header_pos, data, n);
+        package->header_pos += n;
+        data += n;
+        length -= n;
+        if (package->header_pos < sizeof(package->header) || !Package_Begin(package)) {
+            return;
+        }
+    }
+    if (length > package->header.payload_size - package->payload_pos) {
+        OTA_Package_Fail(package, "package longer than the header says");
+        return;
+    }
+    package->payload_pos += length;
+    if (package->header.compression == OTA_COMPRESSION_DEFLATE) {
+        Inflate_Feed(package, data, length);
+    } else {
+        Image_Feed(package, data, length);
+    }
+}
+
+bool OTA_Package_Finish(ota_package_t *package)
+{
+    if (package->error) {
+        return false;
+    }
+    if (package->header_pos < sizeof(package->header) || package->payload_pos != package->header.payload_size) {
+        OTA_Package_Fail(package, "package truncated");
+        return false;
+    }
+    if (package->header.compression == OTA_COMPRESSION_DEFLATE && !package->inflate_done) {
+        OTA_Package_Fail(package, "deflate stream truncated");
+        return false;
+    }
+    if (package->header.kind == OTA_KIND_DELTA && (!package->patch_done || package->insert_left > 0)) {
+        OTA_Package_Fail(package, "patch truncated");
+        return false;
+    }
+    Output_Flush(package);
+    if (package->error || package->written != package->header.image_size) {
+        OTA_Package_Fail(package, "image shorter than the header says");
+        return false;
+    }
+    return true;
+}
+
+void OTA_Package_Free(ota_package_t *package)
+{
+    package->io.release(package->decompressor);
+    package->io.release(package->window);
+    package->decompressor = NULL;
+    package->window = NULL;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "rom/miniz.h"
+
+/*
+ * The ESPCaster update package (tools/ota_pack.py), applied as it streams in:
+ *
+ *   header   ota_package_header_t, little endian
+ *   payload  the new image, or for a delta the patch against the running
+ *            image; raw deflate when OTA_COMPRESSION_DEFLATE
+ *
+ * A patch is a list of ops: COPY (u32 offset, u32 length) from the running
+ * image, INSERT (u32 length, then the bytes) and END. Chunks of any size are
+ * inflated into a 32 KB window, patched and handed on OTA_WRITE_BLOCK bytes
+ * at a time. Nothing here touches flash or the network: OTA_Update.c does
+ * through the callbacks, and host_test runs the same code against buffers.
+ */
+
+#define OTA_PACKAGE_MAGIC           0x544F4345  // "ECOT"
+#define OTA_PACKAGE_VERSION         1
+#define OTA_WRITE_BLOCK             4096        // Per write callback, one flash sector
+#define OTA_WINDOW_SIZE             TINFL_LZ_DICT_SIZE
+#define OTA_OP_MAX                  9           // COPY: op, offset, length
+
+typedef enum {
+    OTA_KIND_FULL,
+    OTA_KIND_DELTA,
+} ota_kind_t;
+
+typedef enum {
+    OTA_COMPRESSION_NONE,
+    OTA_COMPRESSION_DEFLATE,
+} ota_compression_t;
+
+typedef enum {
+    OTA_OP_END,
+    OTA_OP_COPY,
+    OTA_OP_INSERT,
+} ota_op_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t kind;                   // ota_kind_t
+    uint8_t compression;            // ota_compression_t
+    uint8_t reserved;
+    uint32_t image_size;            // Of the new image, as written
+    uint32_t payload_size;          // Bytes after the header
+    uint8_t base_sha256[32];        // Delta: esp_partition_get_sha256() of the running slot
+    uint8_t image_sha256[32];
+} ota_package_header_t;
+
+typedef struct {
+    void *ctx;
+    // The header is in and well formed: check it against the slots and start
+    // the image. False refuses the package; set the reason with OTA_Package_Fail.
+    bool (*begin)(void *ctx, const ota_package_header_t *header);
+    // The next bytes of the image, in order
+    bool (*write)(void *ctx, const uint8_t *data, size_t length);
+    // COPY: length bytes at offset in the running image, within base_size
+    bool (*read_base)(void *ctx, uint32_t offset, uint8_t *out, size_t length);
+    // For the inflate state and window; NULL for malloc and free
+    void *(*alloc)(size_t size);
+    void (*release)(void *ptr);
+    uint32_t base_size;             // Of the running image, the bound on COPY
+} ota_package_io_t;
+
+typedef struct {
+    ota_package_io_t io;
+    ota_package_header_t header;
+    size_t header_pos;
+    uint32_t payload_pos;
+
+    // Deflate packages: decompressor and window
+    tinfl_decompressor *decompressor;
+    uint8_t *window;
+    size_t window_pos;
+    bool inflate_done;
+
+    // Delta: the op being read, and the bytes an INSERT still has to come
+    uint8_t op[OTA_OP_MAX];
+    size_t op_pos;
+    uint32_t insert_left;
+    bool patch_done;
+
+    uint8_t *block;                 // OTA_WRITE_BLOCK bytes, the caller's
+    size_t block_fill;
+    uint32_t written;
+    const char *error;              // The first failure, NULL while there is none
+} ota_package_t;
+
+// block is OTA_WRITE_BLOCK bytes the caller keeps until OTA_Package_Free
+void OTA_Package_Init(ota_package_t *package, const ota_package_io_t *io, uint8_t *block);
+// Any split of the package; does nothing once it has failed
+void OTA_Package_Feed(ota_package_t *package, const uint8_t *data, size_t length);
+// After the last chunk: the whole package arrived and the image is complete
+// and written. The caller checks what it wrote against header.image_sha256.
+bool OTA_Package_Finish(ota_package_t *package);
+void OTA_Package_Free(ota_package_t *package);
+// Records why, if nothing failed before; later failures follow from the first
+void OTA_Package_Fail(ota_package_t *package, const char *why);
@@ -0,0 +1,306 @@
+#include "OTA_Update.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mbedtls/sha256.h"
+#include "mem_task.h"
+#include "task_plan.h"
+#include "Power_Manager.h"
+#include "wifi_manager.h"
+
+static const char *TAG = "OTA";
+
+typedef struct {
+    char url[256];
+    ota_package_t package;
+    int progress;                   // Last percent logged
+
+    const esp_partition_t *base;    // The running slot
+    const esp_partition_t *target;
+    esp_ota_handle_t handle;
+    bool begun;
+    mbedtls_sha256_context sha;
+} ota_job_t;
+
+static atomic_bool running;
+static esp_timer_handle_t health_timer;
+static int64_t health_connected_us;     // Since Wi-Fi has been up, 0 while down
+
+/**********************************************************************************
+ * Package callbacks: the slots
+ **********************************************************************************/
+static void *Psram_Alloc(size_t size)
+{
+    return heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+}
+
+static bool Job_Begin(void *ctx, const ota_package_header_t *h)
+{
+    ota_job_t *job = ctx;
+    if (h->image_size > job->target->size) {
+        OTA_Package_Fail(&job->package, "image does not fit the update slot");
+        return false;
+    }
+    if (h->kind == OTA_KIND_DELTA) {
+        uint8_t base_sha[32];
+        if (esp_partition_get_sha256(job->base, base_sha) != ESP_OK || memcmp(base_sha, h->base_sha256, 32) != 0) {
+            OTA_Package_Fail(&job->package, "patch is for another image");
+            return false;
+        }
+    }
+
+    // Sequential writes erase a sector ahead of each write instead of the whole slot first
+    esp_err_t err = esp_ota_begin(job->target, OTA_WITH_SEQUENTIAL_WRITES, &job->handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_begin: %s", esp_err_to_name(err));
+        OTA_Package_Fail(&job->package, "update slot");
+        return false;
+    }
+    job->begun = true;
+    mbedtls_sha256_starts(&job->sha, 0);
+    ESP_LOGI(TAG, "%s%s package: %lu byte image from %lu bytes, into %s",
+             h->kind == OTA_KIND_DELTA ? "Delta" : "Full", h->compression == OTA_COMPRESSION_DEFLATE ? " deflate" : "",
+             (unsigned long)h->image_size, (unsigned long)h->payload_size, job->target->label);
+    return true;
+}
+
+static bool Job_Write(void *ctx, const uint8_t *data, size_t length)
+{
+    ota_job_t *job = ctx;
+    mbedtls_sha256_update(&job->sha, data, length);
+    esp_err_t err = esp_ota_write(job->handle, data, length);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Write at %lu failed: %s", (unsigned long)job->package.written, esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+static bool Job_Read_Base(void *ctx, uint32_t offset, uint8_t *out, size_t length)
+{
+    ota_job_t *job = ctx;
+    return esp_partition_read(job->base, offset, out, length) == ESP_OK;
+}
+
+/**********************************************************************************
+ * Package
+ **********************************************************************************/
+static void Job_Progress(ota_job_t *job)
+{
+    const ota_package_t *package = &job->package;
+    if (package->header_pos < sizeof(package->header) || package->header.payload_size == 0) {
+        return;
+    }
+    int percent = (int)((uint64_t)package->payload_pos * 100 / package->header.payload_size);
+    if (percent >= job->progress + OTA_PROGRESS_STEP) {
+        job->progress = percent - percent % OTA_PROGRESS_STEP;
+        ESP_LOGI(TAG, "%d%%", job->progress);
+    }
+}
+
+static bool Job_Finish(ota_job_t *job)
+{
+    if (!OTA_Package_Finish(&job->package)) {
+        return false;
+    }
+
+    uint8_t sha[32];
+    mbedtls_sha256_finish(&job->sha, sha);
+    if (memcmp(sha, job->package.header.image_sha256, sizeof(sha)) != 0) {
+        OTA_Package_Fail(&job->package, "SHA-256 mismatch");
+        return false;
+    }
+    // Checks the image header, segments and appended digest (and signature with secure boot)
+    esp_err_t err = esp_ota_end(job->handle);
+    job->begun = false;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_end: %s", esp_err_to_name(err));
+        OTA_Package_Fail(&job->package, "image not valid");
+        return false;
+    }
+    err = esp_ota_set_boot_partition(job->target);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_set_boot_partition: %s", esp_err_to_name(err));
+        OTA_Package_Fail(&job->package, "boot slot");
+        return false;
+    }
+    return true;
+}
+
+static bool Job_Download(ota_job_t *job, uint8_t *chunk)
+{
+    esp_http_client_config_t config = {
+        .url = job->url,
+        .timeout_ms = OTA_HTTP_TIMEOUT_MS,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .buffer_size = OTA_CHUNK,
+        .keep_alive_enable = true,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (!client) {
+        return false;
+    }
+
+    bool ok = false;
+    if (esp_http_client_open(client, 0) == ESP_OK) {
+        esp_http_client_fetch_headers(client);
+        int status = esp_http_client_get_status_code(client);
+        if (status == 200) {
+            int n;
+            while (!job->package.error && (n = esp_http_client_read(client, (char *)chunk, OTA_CHUNK)) > 0) {
+                OTA_Package_Feed(&job->package, chunk, n);
+                Job_Progress(job);
+            }
+            if (n < 0) {
+                ESP_LOGE(TAG, "Read failed (%d)", n);
+            } else {
+                ok = Job_Finish(job);
+            }
+        } else {
+            ESP_LOGE(TAG, "HTTP status %d", status);
+        }
+    } else {
+        ESP_LOGE(TAG, "Failed to connect to %s", job->url);
+    }
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    return ok;
+}
+
+static void OTA_Task(void *parameter)
+{
+    ota_job_t *job = parameter;
+    int64_t start_us = esp_timer_get_time();
+    Power_Hold(POWER_LOCK_UPDATE, true);    // Full speed for inflating, and no auto-suspend
+
+    bool ok = false;
+    uint8_t *chunk = malloc(OTA_CHUNK);
+    uint8_t *block = heap_caps_malloc(OTA_WRITE_BLOCK, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    job->base = esp_ota_get_running_partition();
+    job->target = esp_ota_get_next_update_partition(NULL);
+    const ota_package_io_t io = {
+        .ctx = job,
+        .begin = Job_Begin,
+        .write = Job_Write,
+        .read_base = Job_Read_Base,
+        .alloc = Psram_Alloc,
+        .release = heap_caps_free,
+        .base_size = job->base ? job->base->size : 0,
+    };
+    OTA_Package_Init(&job->package, &io, block);
+    mbedtls_sha256_init(&job->sha);
+    if (!chunk || !block) {
+        ESP_LOGE(TAG, "No memory for the download buffers");
+    } else if (!job->base || !job->target) {
+        ESP_LOGE(TAG, "No update slot: is the ota_0/ota_1 partition table flashed?");
+    } else {
+        ok = Job_Download(job, chunk);
+        if (!ok && job->package.error) {
+            ESP_LOGE(TAG, "Update failed: %s", job->package.error);
+        }
+    }
+    if (job->begun) {
+        esp_ota_abort(job->handle);
+    }
+    mbedtls_sha256_free(&job->sha);
+    OTA_Package_Free(&job->package);
+    heap_caps_free(block);
+    free(chunk);
+
+    Power_Hold(POWER_LOCK_UPDATE, false);
+    if (ok) {
+        ESP_LOGI(TAG, "Update applied in %lld ms, restarting into %s",
+                 (long long)((esp_timer_get_time() - start_us) / 1000), job->target->label);
+        free(job);
+        vTaskDelay(pdMS_TO_TICKS(OTA_REBOOT_DELAY_MS));
+        esp_restart();
+    }
+    free(job);
+    atomic_store(&running, false);
+    mem_task_delete(NULL);
+}
+
+bool OTA_Update_Start(const char *url)
+{
+    const char *prefix = CONFIG_OTA_URL_PREFIX;
+    if (!url || !prefix[0] || strncmp(url, prefix, strlen(prefix)) != 0) {
+        ESP_LOGW(TAG, "Refused update from %s", url ? url : "(none)");
+        return false;
+    }
+    ota_job_t *job = calloc(1, sizeof(*job));
+    if (!job || strlen(url) >= sizeof(job->url)) {
+        free(job);
+        return false;
+    }
+    bool expected = false;
+    if (!atomic_compare_exchange_strong(&running, &expected, true)) {
+        ESP_LOGW(TAG, "An update is already running");
+        free(job);
+        return false;
+    }
+    strcpy(job->url, url);
+    job->progress = -OTA_PROGRESS_STEP;
+    // Internal stack: the task writes flash, when PSRAM is out of reach
+    if (!mem_task_create(OTA_Task, "OTA", OTA_TASK_STACK_SIZE, job, TASK_PLAN_BACKGROUND_PRIORITY, NULL,
+                         TASK_PLAN_BACKGROUND_CORE, MEM_TASK_STACK_INTERNAL)) {
+        free(job);
+        atomic_store(&running, false);
+        return false;
+    }
+    return true;
+}
+
+bool OTA_Update_Running(void)
+{
+    return atomic_load(&running);
+}
+
+/**********************************************************************************
+ * Health check of an image on trial
+ **********************************************************************************/
+static void Health_Check(void *arg)
+{
+    int64_t now_us = esp_timer_get_time();
+    if (!wifi_manager_is_connected()) {
+        health_connected_us = 0;
+    } else if (health_connected_us == 0) {
+        health_connected_us = now_us;
+    }
+
+    if (health_connected_us && now_us - health_connected_us >= CONFIG_OTA_HEALTH_STABLE_S * 1000000LL) {
+        ESP_LOGI(TAG, "New image healthy, rollback cancelled");
+        esp_ota_mark_app_valid_cancel_rollback();
+        esp_timer_stop(health_timer);
+    } else if (now_us >= CONFIG_OTA_HEALTH_TIMEOUT_S * 1000000LL) {
+        ESP_LOGE(TAG, "New image failed its health check, rolling back");
+        esp_ota_mark_app_invalid_rollback_and_reboot();
+    }
+}
+
+void OTA_Health_Start(void)
+{
+    esp_ota_img_states_t state;
+    const esp_partition_t *running_slot = esp_ota_get_running_partition();
+    if (esp_ota_get_state_partition(running_slot, &state) != ESP_OK || state != ESP_OTA_IMG_PENDING_VERIFY) {
+        return;
+    }
+    ESP_LOGW(TAG, "%s is on trial: kept after %d s of Wi-Fi, rolled back at %d s", running_slot->label,
+             CONFIG_OTA_HEALTH_STABLE_S, CONFIG_OTA_HEALTH_TIMEOUT_S);
+    const esp_timer_create_args_t args = {
+        .callback = Health_Check,
+        .name = "ota_health",
+    };
+    if (esp_timer_create(&args, &health_timer) == ESP_OK) {
+        esp_timer_start_periodic(health_timer, OTA_HEALTH_PERIOD_MS * 1000);
+    }
+}
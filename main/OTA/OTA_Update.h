@@ -0,0 +1,35 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "OTA_Package.h"
+
+/*
+ * Over-the-air updates into the ota_0/ota_1 slot not running, from an
+ * ESPCaster package (OTA_Package.h) fetched over HTTPS. Everything streams:
+ * chunks are inflated with the ROM's tinfl into a 32 KB window in PSRAM,
+ * patched against the running slot, and written with sequential erases,
+ * one flash sector at a time, so nothing is held whole and erasing overlaps
+ * the download. The written image must hash to the header's SHA-256 and
+ * pass esp_ota_end() before it is made the boot slot.
+ *
+ * The new image boots pending verification (bootloader rollback). It is
+ * kept once Wi-Fi has stayed up OTA_HEALTH_STABLE_S; if that has not
+ * happened after OTA_HEALTH_TIMEOUT_S, or it resets first, the bootloader
+ * goes back to the previous slot.
+ */
+
+#define OTA_CHUNK                   4096        // Per esp_http_client_read
+#define OTA_HTTP_TIMEOUT_MS         15000
+#define OTA_TASK_STACK_SIZE         6144
+#define OTA_PROGRESS_STEP           10          // Percent between progress lines
+#define OTA_REBOOT_DELAY_MS         1000        // For the log and the API answer to get out
+#define OTA_HEALTH_PERIOD_MS        1000
+
+// Any task: download and apply url on a task of its own, then restart into
+// it. Only URLs under OTA_URL_PREFIX are taken; false if that is empty, the
+// URL is not under it or an update is already running.
+bool OTA_Update_Start(const char *url);
+bool OTA_Update_Running(void);
+// Once the GUI is up: if this image is on trial, start judging it
+void OTA_Health_Start(void);
@@ -117,6 +117,60 @@ void PCF85063_Read_Time(datetime_t *time)
 	time->year = bcdToDec(buf[6])+YEAR_OFFSET;
 }
 
+/******************************************************************************
+function:	Read Time And Date as UTC seconds since 1970
+parameter:
+Info:		The registers hold UTC. False if the oscillator has stopped since the
+			time was last set (OS flag): first power-up or a flat backup battery
+******************************************************************************/
+bool PCF85063_Read_UTC(time_t *utc)
+{
+	uint8_t buf[7] = {0};
+	ESP_ERROR_CHECK(I2C_Read(PCF85063_ADDRESS, RTC_SECOND_ADDR, buf, 7));
+	if (buf[0] & RTC_SECOND_OS) {
+		return false;
+	}
+	int year = bcdToDec(buf[6]) + YEAR_OFFSET;
+	int month = bcdToDec(buf[5] & 0x1F);
+	int day = bcdToDec(buf[3] & 0x3F);
+	if (month < 1 || month > 12 || day < 1 || day > 31) {
+		return false;
+	}
+
+	// Days from civil: March-based years, so the leap day comes last
+	int y = year - (month <= 2);
+	int era = y / 400;
+	int yoe = y - era * 400;
+	int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	int64_t days = (int64_t)era * 146097 + doe - 719468;
+
+	*utc = (time_t)(days * 86400 + bcdToDec(buf[2] & 0x3F) * 3600 +
+	                bcdToDec(buf[1] & 0x7F) * 60 + bcdToDec(buf[0] & 0x7F));
+	return true;
+}
+
+/******************************************************************************
+function:	Set Time And Date from UTC seconds since 1970
+parameter:
+Info:		Clears the OS flag
+******************************************************************************/
+void PCF85063_Set_UTC(time_t utc)
+{
+	struct tm tm;
+	gmtime_r(&utc, &tm);
+	datetime_t time = {
+		.year = tm.tm_year + 1900,
+		.month = tm.tm_mon + 1,
+		.day = tm.tm_mday,
+		.dotw = tm.tm_wday,
+		.hour = tm.tm_hour,
+		.minute = tm.tm_min,
+		.second = tm.tm_sec,
+	};
+	PCF85063_Set_All(time);
+}
+
 /******************************************************************************
 function:	Enable Alarm and Clear Alarm flag
 parameter:			
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdbool.h>
+#include <time.h>
 #include "I2C_Driver.h"
 
 
@@ -14,6 +16,7 @@
 #define RTC_RAM_by_ADDR     (0x03)
 // registar overview - time & data reg
 #define RTC_SECOND_ADDR		(0x04)
+#define RTC_SECOND_OS		(0x80)	// oscillator stopped: the time is not to be trusted
 #define RTC_MINUTE_ADDR		(0x05)
 #define RTC_HOUR_ADDR		(0x06)
 #define RTC_DAY_ADDR		(0x07)
@@ -83,6 +86,9 @@ void PCF85063_Set_All(datetime_t time);
 
 void PCF85063_Read_Time(datetime_t *time);
 
+bool PCF85063_Read_UTC(time_t *utc);
+void PCF85063_Set_UTC(time_t utc);
+
 
 void PCF85063_Enable_Alarm(void);
 uint8_t PCF85063_Get_Alarm_Flag();
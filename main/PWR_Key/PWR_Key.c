@@ -1,8 +1,37 @@
 #include "PWR_Key.h"
+#include "Power_Suspend.h"
 
-static uint8_t BAT_State = 0; 
+static RTC_DATA_ATTR uint8_t BAT_State = 0;     // The latch is held through a suspend
 static uint8_t Device_State = 0; 
 static uint16_t Long_Press = 0;
+static const char *TAG_PWR = "PWR_Key";
+static TaskHandle_t Key_Notify_Task = NULL;
+
+static void IRAM_ATTR PWR_Key_ISR_Handler(void *arg)
+{
+  BaseType_t task_woken = pdFALSE;
+  vTaskNotifyGiveFromISR(Key_Notify_Task, &task_woken);
+  if (task_woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+bool PWR_Key_Pressed(void)
+{
+  return !gpio_get_level(PWR_KEY_Input_PIN);
+}
+
+void PWR_Key_Set_Notify_Task(TaskHandle_t task)
+{
+  Key_Notify_Task = task;
+  gpio_set_intr_type(PWR_KEY_Input_PIN, GPIO_INTR_ANYEDGE);
+  esp_err_t ret = gpio_install_isr_service(0);
+  if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {     // Already installed is fine
+    ESP_LOGE(TAG_PWR, "Failed to install GPIO ISR service: %s", esp_err_to_name(ret));
+    return;
+  }
+  gpio_isr_handler_add(PWR_KEY_Input_PIN, PWR_Key_ISR_Handler, NULL);
+}
 
 
 void PWR_Loop(void)
@@ -24,13 +53,17 @@ void PWR_Loop(void)
     else{
       if(BAT_State == 1)   
         BAT_State = 2;
+      // Acted on when let go, so holding on reaches restart and shutdown
+      if(Device_State == 1)
+        Fall_Asleep();
+      Device_State = 0;
       Long_Press = 0;
     }
   }
 }
 void Fall_Asleep(void)
 {
-
+  Power_Suspend_Request();
 }
 void Restart(void)                              
 {
@@ -49,6 +82,17 @@ void configure_GPIO(int pin, gpio_mode_t Mode)
 }
 void PWR_Init(void) {
   configure_GPIO(PWR_KEY_Input_PIN, GPIO_MODE_INPUT);    
+  if(Power_Resumed()) {
+    // Latched before the suspend and held since: no reset of the pin, drive it
+    // high before the hold lets go, and skip the wait for a press-and-hold
+    gpio_set_level(PWR_Control_PIN, true);
+    gpio_set_direction(PWR_Control_PIN, GPIO_MODE_OUTPUT);
+    gpio_hold_dis(PWR_Control_PIN);
+    gpio_deep_sleep_hold_dis();
+    if(!gpio_get_level(PWR_KEY_Input_PIN))
+      BAT_State = 1;                // The waking press is not the start of a long press
+    return;
+  }
   configure_GPIO(PWR_Control_PIN, GPIO_MODE_OUTPUT);
   gpio_set_level(PWR_Control_PIN, false);
   vTaskDelay(100);
@@ -13,4 +13,6 @@ void Shutdown(void);
 void Restart(void);
 
 void PWR_Init(void);
-void PWR_Loop(void);
\ No newline at end of file
+void PWR_Loop(void);                                  // Call every 100 ms while PWR_Key_Pressed() (long-press timing)
+bool PWR_Key_Pressed(void);
+void PWR_Key_Set_Notify_Task(TaskHandle_t task);      // Key edges wake this task (xTaskNotifyGive)
\ No newline at end of file
@@ -0,0 +1,188 @@
+#include "Power_Manager.h"
+#include <stdatomic.h>
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "Display_SPD2010.h"
+#include "Power_Suspend.h"
+
+static const char *TAG_POWER = "Power";
+
+static esp_pm_lock_handle_t pm_locks[POWER_LOCK_COUNT];
+static atomic_bool pm_held[POWER_LOCK_COUNT];
+static const char *const pm_lock_names[POWER_LOCK_COUNT] = { "render", "audio", "update" };
+
+static lv_disp_t *power_disp = NULL;
+static volatile power_profile_t power_profile = POWER_PROFILE_ACTIVE;
+
+// Power_Wifi_Wake() window, ended by the profile timer
+static portMUX_TYPE wifi_wake_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool wifi_woken = false;
+static TickType_t wifi_wake_until;
+
+void Power_Init(void)
+{
+#if CONFIG_PM_ENABLE
+  const esp_pm_config_t pm_config = {
+    .max_freq_mhz = POWER_CPU_MAX_MHZ,
+    .min_freq_mhz = POWER_CPU_MIN_MHZ,
+#if CONFIG_POWER_AUTO_LIGHT_SLEEP
+    .light_sleep_enable = true,
+#endif
+  };
+  esp_err_t ret = esp_pm_configure(&pm_config);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG_POWER, "esp_pm_configure failed: %s", esp_err_to_name(ret));
+    return;
+  }
+  for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+    ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, pm_lock_names[i], &pm_locks[i]));
+  }
+  ESP_LOGI(TAG_POWER, "DFS %d-%d MHz%s", POWER_CPU_MIN_MHZ, POWER_CPU_MAX_MHZ,
+           pm_config.light_sleep_enable ? ", auto light sleep" : "");
+#else
+  ESP_LOGW(TAG_POWER, "CONFIG_PM_ENABLE is off, CPU stays at full speed");
+#endif
+}
+
+void Power_Hold(power_lock_t lock, bool hold)
+{
+  if (lock >= POWER_LOCK_COUNT || !pm_locks[lock]) {
+    return;
+  }
+  if (atomic_exchange(&pm_held[lock], hold) == hold) {
+    return;
+  }
+  if (hold) {
+    esp_pm_lock_acquire(pm_locks[lock]);
+  } else {
+    esp_pm_lock_release(pm_locks[lock]);
+  }
+}
+
+power_profile_t Power_Get_Profile(void)
+{
+  return power_profile;
+}
+
+void Power_Wifi_Wake(uint32_t ms)
+{
+  taskENTER_CRITICAL(&wifi_wake_lock);
+  wifi_wake_until = xTaskGetTickCount() + pdMS_TO_TICKS(ms);
+  bool wake = !wifi_woken && power_profile == POWER_PROFILE_DEEP_IDLE;
+  wifi_woken = wifi_woken || wake;
+  taskEXIT_CRITICAL(&wifi_wake_lock);
+  if (wake) {
+    esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+  }
+}
+
+// Profile timer: the wake window is over, or a profile change took over the setting
+static void Power_Wifi_Wake_Check(power_profile_t profile)
+{
+  taskENTER_CRITICAL(&wifi_wake_lock);
+  bool expired = (int32_t)(xTaskGetTickCount() - wifi_wake_until) >= 0;
+  bool restore = wifi_woken && expired && profile == POWER_PROFILE_DEEP_IDLE && power_profile == POWER_PROFILE_DEEP_IDLE;
+  if (restore || profile != power_profile) {
+    wifi_woken = false;
+  }
+  taskEXIT_CRITICAL(&wifi_wake_lock);
+  if (restore) {
+    esp_wifi_set_ps(WIFI_PS_MAX_MODEM);
+  }
+}
+
+uint32_t Power_Profile_Due_In_ms(void)
+{
+  static const uint32_t after_ms[] = { POWER_DIM_AFTER_MS, POWER_IDLE_AFTER_MS, POWER_DEEP_IDLE_AFTER_MS };
+  if (!power_disp) {
+    return UINT32_MAX;
+  }
+  uint32_t inactive_ms = lv_disp_get_inactive_time(power_disp);
+  for (size_t i = 0; i < sizeof(after_ms) / sizeof(after_ms[0]); i++) {
+    if (inactive_ms < after_ms[i]) {
+      return after_ms[i] - inactive_ms;
+    }
+  }
+  return UINT32_MAX;
+}
+
+static void Power_Set_Rates(uint32_t refr_period_ms, uint32_t read_period_ms)
+{
+  lv_timer_t *refr_timer = _lv_disp_get_refr_timer(power_disp);
+  if (refr_timer) {
+    lv_timer_set_period(refr_timer, refr_period_ms);
+  }
+  for (lv_indev_t *indev = lv_indev_get_next(NULL); indev; indev = lv_indev_get_next(indev)) {
+    lv_timer_t *read_timer = lv_indev_get_read_timer((lv_disp_t *)indev);
+    if (read_timer) {
+      lv_timer_set_period(read_timer, read_period_ms);
+    }
+  }
+}
+
+static void Power_Apply_Profile(power_profile_t profile)
+{
+  switch (profile) {
+  case POWER_PROFILE_ACTIVE:
+    Set_Backlight_Fade(LCD_Backlight, POWER_FADE_WAKE_MS);
+    Power_Set_Rates(LV_DISP_DEF_REFR_PERIOD, LV_INDEV_DEF_READ_PERIOD);
+    esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+    break;
+  case POWER_PROFILE_DIM:
+    Set_Backlight_Fade(LCD_Backlight < POWER_DIM_BACKLIGHT ? LCD_Backlight : POWER_DIM_BACKLIGHT, POWER_FADE_DIM_MS);
+    break;
+  case POWER_PROFILE_IDLE:
+    Set_Backlight_Fade(0, POWER_FADE_OFF_MS);
+    Power_Set_Rates(POWER_IDLE_REFR_PERIOD_MS, POWER_IDLE_READ_PERIOD_MS);
+    break;
+  case POWER_PROFILE_DEEP_IDLE:
+    esp_wifi_set_ps(WIFI_PS_MAX_MODEM);      // Ignored until Wi-Fi is started
+    break;
+  }
+}
+
+static void Power_Profile_Timer_Cb(lv_timer_t *timer)
+{
+  uint32_t inactive_ms = lv_disp_get_inactive_time(power_disp);
+  power_profile_t profile = POWER_PROFILE_ACTIVE;
+  if (inactive_ms >= POWER_DEEP_IDLE_AFTER_MS) {
+    profile = POWER_PROFILE_DEEP_IDLE;
+  } else if (inactive_ms >= POWER_IDLE_AFTER_MS) {
+    profile = POWER_PROFILE_IDLE;
+  } else if (inactive_ms >= POWER_DIM_AFTER_MS) {
+    profile = POWER_PROFILE_DIM;
+  }
+  // Maximum modem sleep would stretch a download out many times over
+  bool updating = atomic_load(&pm_held[POWER_LOCK_UPDATE]);
+  if (profile == POWER_PROFILE_DEEP_IDLE && updating) {
+    profile = POWER_PROFILE_IDLE;
+  }
+#if CONFIG_POWER_SUSPEND_AFTER_MIN > 0
+  if (inactive_ms >= CONFIG_POWER_SUSPEND_AFTER_MIN * 60000u && !atomic_load(&pm_held[POWER_LOCK_AUDIO]) && !updating) {
+    Power_Suspend();
+  }
+#endif
+  Power_Wifi_Wake_Check(profile);
+  if (profile == power_profile) {
+    return;
+  }
+
+  ESP_LOGI(TAG_POWER, "Profile %d -> %d after %u ms inactive", power_profile, profile, (unsigned)inactive_ms);
+  if (profile == POWER_PROFILE_ACTIVE) {
+    Power_Apply_Profile(POWER_PROFILE_ACTIVE);
+  } else if (profile < power_profile) {
+    esp_wifi_set_ps(WIFI_PS_MIN_MODEM);      // Out of DEEP_IDLE for an update, the screen stays off
+  } else {
+    // Step through the profiles in between (a long block of the LVGL thread can skip one)
+    for (power_profile_t p = power_profile + 1; p <= profile; p++) {
+      Power_Apply_Profile(p);
+    }
+  }
+  power_profile = profile;
+}
+
+void Power_Start_Profiles(lv_disp_t *disp)
+{
+  power_disp = disp;
+  lv_timer_create(Power_Profile_Timer_Cb, POWER_CHECK_PERIOD_MS, NULL);
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "lvgl.h"
+
+/*
+ * Power management: dynamic frequency scaling between POWER_CPU_MAX_MHZ
+ * and POWER_CPU_MIN_MHZ (esp_pm), with FreeRTOS tickless idle so idle
+ * cores skip ticks. Work that needs full speed holds a POWER_LOCK_* while it
+ * runs; the panel SPI and Wi-Fi drivers take their own locks, and the Cast
+ * components hold one across TLS handshakes.
+ *
+ * Profiles follow LVGL's inactivity time, which touch input and IMU wakes
+ * (posted through the GUI event bus) both reset:
+ *   ACTIVE     user backlight, full LVGL refresh and input rate
+ *   DIM        backlight lowered to POWER_DIM_BACKLIGHT
+ *   IDLE       backlight off, LVGL refresh and input reads slowed down
+ *   DEEP_IDLE  as IDLE, plus Wi-Fi in maximum modem sleep
+ * Any activity goes straight back to ACTIVE. Backlight changes are LEDC
+ * hardware fades: slow going down, so a glance can still catch it, and
+ * quick coming back.
+ *
+ * Commands that arrive without a screen to look at (BLE control) are not
+ * activity; Power_Wifi_Wake() takes Wi-Fi out of maximum modem sleep just
+ * long enough for the reply, and leaves the profile as it is.
+ */
+
+#define POWER_CPU_MAX_MHZ           240
+#define POWER_CPU_MIN_MHZ           80      // Keeps APB at 80 MHz for the panel SPI clock
+
+#define POWER_DIM_AFTER_MS          30000
+#define POWER_IDLE_AFTER_MS         60000
+#define POWER_DEEP_IDLE_AFTER_MS    300000
+#define POWER_DIM_BACKLIGHT         10      // Percent, or the user level if lower
+#define POWER_FADE_WAKE_MS          150     // Back to the user level
+#define POWER_FADE_DIM_MS           1500
+#define POWER_FADE_OFF_MS           800     // From the dim level
+#define POWER_IDLE_REFR_PERIOD_MS   200     // LVGL refresh while nothing is shown
+#define POWER_IDLE_READ_PERIOD_MS   100     // LVGL touch reads while idle
+#define POWER_CHECK_PERIOD_MS       250     // Profile timer
+
+typedef enum {
+  POWER_PROFILE_ACTIVE,
+  POWER_PROFILE_DIM,
+  POWER_PROFILE_IDLE,
+  POWER_PROFILE_DEEP_IDLE,
+} power_profile_t;
+
+typedef enum {
+  POWER_LOCK_RENDER,                  // LVGL timer handler
+  POWER_LOCK_AUDIO,                   // Local playback
+  POWER_LOCK_UPDATE,                  // OTA download and flash writes
+  POWER_LOCK_COUNT,
+} power_lock_t;
+
+void Power_Init(void);
+// Take or drop a full-speed lock; repeated calls with the same value are no-ops
+void Power_Hold(power_lock_t lock, bool hold);
+// LVGL thread, after LVGL_Init(): starts the profile timer
+void Power_Start_Profiles(lv_disp_t *disp);
+power_profile_t Power_Get_Profile(void);
+// LVGL thread: ms of further inactivity before the next profile step, UINT32_MAX in DEEP_IDLE
+uint32_t Power_Profile_Due_In_ms(void);
+// Any task: Wi-Fi in minimum modem sleep for the next ms, if DEEP_IDLE had it in maximum
+void Power_Wifi_Wake(uint32_t ms);
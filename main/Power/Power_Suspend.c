@@ -0,0 +1,131 @@
+#include "Power_Suspend.h"
+#include <time.h>
+#include "esp_attr.h"
+#include "esp_sleep.h"
+#include "esp_system.h"
+#include "driver/gpio.h"
+#include "driver/rtc_io.h"
+#include "deferred_log.h"
+#include "gui_event_bus.h"
+#include "PWR_Key.h"
+#include "QMI8658_FIFO.h"
+
+static const char *TAG_SUSPEND = "Suspend";
+
+#if CONFIG_POWER_SUSPEND_WAKE_ON_MOTION && CONFIG_QMI8658_FIFO_MODE && CONFIG_QMI8658_INT_GPIO >= 0
+#define POWER_SUSPEND_MOTION        1
+#else
+#define POWER_SUSPEND_MOTION        0
+#endif
+
+static RTC_DATA_ATTR uint32_t suspend_magic;
+static RTC_DATA_ATTR time_t suspended_at;
+static power_suspend_hook_t suspend_hooks[POWER_SUSPEND_HOOKS_MAX];
+static size_t suspend_hook_count = 0;
+static int8_t resumed = -1;             // Worked out on the first call
+
+esp_err_t Power_Suspend_Add_Hook(power_suspend_hook_t hook)
+{
+  if (!hook) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (suspend_hook_count >= POWER_SUSPEND_HOOKS_MAX) {
+    return ESP_ERR_NO_MEM;
+  }
+  suspend_hooks[suspend_hook_count++] = hook;
+  return ESP_OK;
+}
+
+bool Power_Resumed(void)
+{
+  if (resumed < 0) {
+    resumed = esp_reset_reason() == ESP_RST_DEEPSLEEP && suspend_magic == POWER_SUSPEND_MAGIC;
+    suspend_magic = 0;                  // The next suspend sets it again
+    if (resumed) {
+      // The RTC timer kept the system time through deep sleep
+      ESP_LOGI(TAG_SUSPEND, "Resumed after %lld s", (long long)(time(NULL) - suspended_at));
+    }
+  }
+  return resumed;
+}
+
+power_wake_t Power_Wake_Source(void)
+{
+  if (!Power_Resumed()) {
+    return POWER_WAKE_NONE;
+  }
+  switch (esp_sleep_get_wakeup_cause()) {
+  case ESP_SLEEP_WAKEUP_EXT1:
+    return (esp_sleep_get_ext1_wakeup_status() & (1ULL << PWR_KEY_Input_PIN)) ? POWER_WAKE_KEY : POWER_WAKE_TOUCH;
+  case ESP_SLEEP_WAKEUP_EXT0:
+    return POWER_WAKE_MOTION;
+  default:
+    return POWER_WAKE_NONE;
+  }
+}
+
+// A key or finger still down would wake the chip as soon as it slept
+static bool Power_Wait_Released(int gpio)
+{
+  for (uint32_t waited_ms = 0; !gpio_get_level(gpio); waited_ms += POWER_SUSPEND_POLL_MS) {
+    if (waited_ms >= POWER_SUSPEND_RELEASE_MS) {
+      return false;
+    }
+    vTaskDelay(pdMS_TO_TICKS(POWER_SUSPEND_POLL_MS));
+  }
+  return true;
+}
+
+void Power_Suspend(void)
+{
+  ESP_LOGI(TAG_SUSPEND, "Suspending, %u hooks", (unsigned)suspend_hook_count);
+  for (size_t i = 0; i < suspend_hook_count; i++) {
+    suspend_hooks[i]();
+  }
+  LCD_Suspend();
+
+  uint64_t wake_mask = 1ULL << PWR_KEY_Input_PIN;
+  if (!Power_Wait_Released(PWR_KEY_Input_PIN)) {
+    ESP_LOGW(TAG_SUSPEND, "Power key still held, it will wake at once");
+  }
+  if (Power_Wait_Released(EXAMPLE_PIN_NUM_TOUCH_INT)) {
+    wake_mask |= 1ULL << EXAMPLE_PIN_NUM_TOUCH_INT;
+  } else {
+    ESP_LOGW(TAG_SUSPEND, "Touch interrupt stuck low, waking on the key only");
+  }
+  for (int gpio = 0; gpio < GPIO_NUM_MAX; gpio++) {
+    if (wake_mask & (1ULL << gpio)) {
+      rtc_gpio_pullup_en(gpio);
+      rtc_gpio_pulldown_dis(gpio);
+    }
+  }
+  esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);     // Keeps those pull-ups
+  esp_sleep_enable_ext1_wakeup(wake_mask, ESP_EXT1_WAKEUP_ANY_LOW);
+#if POWER_SUSPEND_MOTION
+  if (rtc_gpio_is_valid_gpio(CONFIG_QMI8658_INT_GPIO) && QMI8658_Wake_On_Motion(CONFIG_POWER_SUSPEND_MOTION_MG)) {
+    esp_sleep_enable_ext0_wakeup(CONFIG_QMI8658_INT_GPIO, 1);
+  }
+#endif
+
+  // The latch is all that keeps the board powered: hold it high through sleep
+  gpio_hold_en(PWR_Control_PIN);
+  gpio_deep_sleep_hold_en();
+
+  suspended_at = time(NULL);
+  suspend_magic = POWER_SUSPEND_MAGIC;
+  ESP_LOGI(TAG_SUSPEND, "Deep sleep");
+  deferred_log_flush();     // Deep sleep runs no shutdown handlers
+  esp_deep_sleep_start();
+}
+
+static void Power_Suspend_Call(void *arg)
+{
+  Power_Suspend();
+}
+
+void Power_Suspend_Request(void)
+{
+  if (!gui_event_bus_post_call(Power_Suspend_Call, NULL)) {
+    ESP_LOGW(TAG_SUSPEND, "Suspend request dropped");
+  }
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_log.h"
+
+/*
+ * Suspend: deep sleep with the power latch held, and a resume that takes
+ * the warm paths instead of a cold boot. What has to survive is split by
+ * where it lives:
+ *   RTC memory  kept by its owner as RTC_DATA_ATTR and trusted only when
+ *               Power_Resumed(): the tab shown, the Cast TLS sessions, the
+ *               backlight level and the power key latch
+ *   flash       written by the subsystems' suspend hooks: the config store
+ *               (Wi-Fi AP cache, last Cast device) and the Spotify snapshot;
+ *               the DHCP lease is already in NVS
+ *   the panel   asleep with its registers, so no reset or vendor init
+ * Wakes on the power key or a touch (EXT1, either low), and on motion when
+ * the IMU interrupt is wired (EXT0, wake-on-motion threshold).
+ */
+
+#define POWER_SUSPEND_HOOKS_MAX     8
+#define POWER_SUSPEND_MAGIC         0x53555350  // "SUSP": this deep sleep was ours
+#define POWER_SUSPEND_RELEASE_MS    3000        // Longest wait for the key and panel to be let go
+#define POWER_SUSPEND_POLL_MS       20
+
+typedef enum {
+  POWER_WAKE_NONE,                    // Not a resume: power on or reset
+  POWER_WAKE_KEY,
+  POWER_WAKE_TOUCH,
+  POWER_WAKE_MOTION,
+} power_wake_t;
+
+// LVGL thread, just before deep sleep: write out what the resume needs
+typedef void (*power_suspend_hook_t)(void);
+
+// Before the LVGL task starts or on it; hooks run in the order added
+esp_err_t Power_Suspend_Add_Hook(power_suspend_hook_t hook);
+// LVGL thread; does not return
+void Power_Suspend(void);
+// Any task: Power_Suspend() on the LVGL thread
+void Power_Suspend_Request(void);
+// This boot is a wake from Power_Suspend(); valid from the first line of app_main
+bool Power_Resumed(void);
+power_wake_t Power_Wake_Source(void);
@@ -1,4 +1,5 @@
 #include "QMI8658.h"
+#include "QMI8658_FIFO.h"
 
 IMUdata Accel;
 IMUdata Gyro;
@@ -57,10 +58,15 @@ void QMI8658_Init(void)
         case GYR_RANGE_512DPS: gyroScales = 512.0 / 32768.0; break;
         case GYR_RANGE_1024DPS: gyroScales = 1024.0 / 32768.0; break;
     }
+#if CONFIG_QMI8658_FIFO_MODE
+    QMI8658_FIFO_Init();
+#endif
 }
 void QMI8658_Loop(void)
 {
-  getAccelerometer();
+#if !CONFIG_QMI8658_FIFO_MODE
+  getAccelerometer();             // In FIFO mode the IMU task keeps Accel/Gyro current
+#endif
 }
 
 /**
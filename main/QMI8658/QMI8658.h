@@ -135,6 +135,7 @@ typedef struct __IMUdata {
 
 extern IMUdata Accel;
 extern IMUdata Gyro;
+extern float accelScales, gyroScales;   // g / dps per LSB at the configured ranges
 
 void QMI8658_Init(void);
 void QMI8658_Loop(void);
@@ -0,0 +1,287 @@
+#include "QMI8658_FIFO.h"
+#include "QMI8658_Fusion.h"
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+
+static const char *TAG_IMU = "QMI8658";
+
+#define QMI8658_FIFO_FRAME_BYTES        12      // ax ay az gx gy gz, int16 LE
+#define QMI8658_FIFO_SAMPLE_PERIOD_US   (1000000 / QMI8658_FIFO_ODR_HZ)
+#define QMI8658_FIFO_MAX_SAMPLES        64      // FIFO_CTRL size setting below
+#define QMI8658_FIFO_CTRL_VALUE         (0x02 << 2 | 0x02)  // 64 samples, stream mode
+#define QMI8658_FIFO_READ_CHUNK         (8 * QMI8658_FIFO_FRAME_BYTES)
+#define QMI8658_CTRL1_INT1_EN           0x08
+#define QMI8658_CTRL1_FIFO_INT1         0x04    // Route the FIFO interrupt to INT1
+
+#if defined(CONFIG_QMI8658_INT_GPIO) && CONFIG_QMI8658_INT_GPIO >= 0
+#define QMI8658_FIFO_USE_INT            1
+#else
+#define QMI8658_FIFO_USE_INT            0
+#endif
+
+static qmi8658_sample_t ring[QMI8658_FIFO_RING_SIZE];
+static size_t ring_head = 0;        // Next slot to write
+static size_t ring_count = 0;
+static SemaphoreHandle_t ring_lock = NULL;
+static TaskHandle_t fifo_task_handle = NULL;
+static qmi8658_wake_cb_t wake_cb = NULL;
+static volatile bool fifo_stopping = false;
+static SemaphoreHandle_t fifo_stopped = NULL;
+
+// Wake detector state
+static IMUdata gravity;
+static bool gravity_valid = false;
+static float last_magnitude = 1.0f;
+static int pickup_run = 0;
+static int64_t last_wake_us = 0;
+
+void QMI8658_Set_Wake_Callback(qmi8658_wake_cb_t callback)
+{
+    wake_cb = callback;
+}
+
+static void Wake_Fire(qmi8658_wake_reason_t reason, int64_t time_us)
+{
+    if (time_us - last_wake_us < QMI8658_WAKE_HOLDOFF_MS * 1000LL) {
+        return;
+    }
+    last_wake_us = time_us;
+    qmi8658_wake_cb_t cb = wake_cb;
+    if (cb) {
+        cb(reason);
+    }
+}
+
+static void Wake_Feed(const qmi8658_sample_t *sample)
+{
+    const IMUdata *a = &sample->accel;
+    float magnitude = sqrtf(a->x * a->x + a->y * a->y + a->z * a->z);
+    if (!gravity_valid) {
+        gravity = *a;
+        gravity_valid = true;
+        last_magnitude = magnitude;
+        return;
+    }
+
+    if (fabsf(magnitude - last_magnitude) >= QMI8658_WAKE_TAP_G) {
+        Wake_Fire(QMI8658_WAKE_TAP, sample->time_us);
+    }
+    last_magnitude = magnitude;
+
+    float dx = a->x - gravity.x;
+    float dy = a->y - gravity.y;
+    float dz = a->z - gravity.z;
+    if (dx * dx + dy * dy + dz * dz >= QMI8658_WAKE_PICKUP_G * QMI8658_WAKE_PICKUP_G) {
+        if (++pickup_run == QMI8658_WAKE_PICKUP_SAMPLES) {
+            Wake_Fire(QMI8658_WAKE_PICKUP, sample->time_us);
+        }
+    } else {
+        pickup_run = 0;
+    }
+
+    // Slow baseline (~1 s), so a device at rest in any orientation settles
+    gravity.x += (a->x - gravity.x) * 0.01f;
+    gravity.y += (a->y - gravity.y) * 0.01f;
+    gravity.z += (a->z - gravity.z) * 0.01f;
+}
+
+static void FIFO_Decode(const uint8_t *frame, int64_t time_us, qmi8658_sample_t *sample)
+{
+    int16_t raw[6];
+    for (int i = 0; i < 6; i++) {
+        raw[i] = (int16_t)(frame[2 * i + 1] << 8 | frame[2 * i]);
+    }
+    sample->time_us = time_us;
+    sample->accel.x = raw[0] * accelScales;
+    sample->accel.y = raw[1] * accelScales;
+    sample->accel.z = raw[2] * accelScales;
+    sample->gyro.x = raw[3] * gyroScales;
+    sample->gyro.y = raw[4] * gyroScales;
+    sample->gyro.z = raw[5] * gyroScales;
+}
+
+static void FIFO_Drain(void)
+{
+    uint8_t status[2];
+    if (I2C_Read(QMI8658_L_SLAVE_ADDRESS, QMI8658_FIFO_SMPL_CNT, status, 2) != ESP_OK) {
+        return;
+    }
+    // Sample count is in 16-bit words, 10 bits across both registers
+    size_t bytes = (((size_t)(status[1] & 0x03) << 8) | status[0]) * 2;
+    size_t frames = bytes / QMI8658_FIFO_FRAME_BYTES;
+    if (frames == 0) {
+        return;
+    }
+    if (frames > QMI8658_FIFO_MAX_SAMPLES) {
+        frames = QMI8658_FIFO_MAX_SAMPLES;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    QMI8658_CTRL9_Write(QMI8658_CTRL_CMD_REQ_FIFO);
+
+    uint8_t chunk[QMI8658_FIFO_READ_CHUNK];
+    size_t done = 0;
+    while (done < frames) {
+        size_t n = frames - done;
+        if (n > QMI8658_FIFO_READ_CHUNK / QMI8658_FIFO_FRAME_BYTES) {
+            n = QMI8658_FIFO_READ_CHUNK / QMI8658_FIFO_FRAME_BYTES;
+        }
+        if (I2C_Read(QMI8658_L_SLAVE_ADDRESS, QMI8658_FIFO_DATA, chunk, n * QMI8658_FIFO_FRAME_BYTES) != ESP_OK) {
+            break;
+        }
+
+        xSemaphoreTake(ring_lock, portMAX_DELAY);
+        for (size_t i = 0; i < n; i++) {
+            // The newest sample was taken about now; the rest one period apart
+            int64_t time_us = now_us - (int64_t)(frames - 1 - (done + i)) * QMI8658_FIFO_SAMPLE_PERIOD_US;
+            qmi8658_sample_t *sample = &ring[ring_head];
+            FIFO_Decode(&chunk[i * QMI8658_FIFO_FRAME_BYTES], time_us, sample);
+            ring_head = (ring_head + 1) % QMI8658_FIFO_RING_SIZE;
+            if (ring_count < QMI8658_FIFO_RING_SIZE) {
+                ring_count++;
+            }
+            Accel = sample->accel;
+            Gyro = sample->gyro;
+        }
+        xSemaphoreGive(ring_lock);
+
+        for (size_t i = 0; i < n; i++) {
+            const qmi8658_sample_t *sample = &ring[(ring_head + QMI8658_FIFO_RING_SIZE - n + i) % QMI8658_FIFO_RING_SIZE];
+            Wake_Feed(sample);
+#if CONFIG_QMI8658_FUSION
+            QMI8658_Fusion_Feed(sample);
+#endif
+        }
+        done += n;
+    }
+
+    // Leave FIFO read mode
+    QMI8658_transmit(QMI8658_FIFO_CTRL, QMI8658_FIFO_CTRL_VALUE);
+}
+
+size_t QMI8658_FIFO_Read(qmi8658_sample_t *samples, size_t max_samples)
+{
+    if (!ring_lock) {
+        return 0;
+    }
+    xSemaphoreTake(ring_lock, portMAX_DELAY);
+    size_t n = ring_count < max_samples ? ring_count : max_samples;
+    size_t start = (ring_head + QMI8658_FIFO_RING_SIZE - ring_count) % QMI8658_FIFO_RING_SIZE;
+    for (size_t i = 0; i < n; i++) {
+        samples[i] = ring[(start + i) % QMI8658_FIFO_RING_SIZE];
+    }
+    ring_count -= n;
+    xSemaphoreGive(ring_lock);
+    return n;
+}
+
+#if QMI8658_FIFO_USE_INT
+static void IRAM_ATTR FIFO_ISR_Handler(void *arg)
+{
+    BaseType_t task_woken = pdFALSE;
+    vTaskNotifyGiveFromISR(fifo_task_handle, &task_woken);
+    if (task_woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+#endif
+
+static void FIFO_Task(void *arg)
+{
+    // Without the interrupt the timeout paces the reads; with it, it only
+    // covers a missed edge
+    const TickType_t period = pdMS_TO_TICKS(QMI8658_FIFO_WATERMARK * 1000 / QMI8658_FIFO_ODR_HZ);
+    while (1) {
+#if QMI8658_FIFO_USE_INT
+        ulTaskNotifyTake(pdTRUE, 4 * period);
+#else
+        ulTaskNotifyTake(pdTRUE, period);
+#endif
+        // Between batches, so the bus is free for the wake-on-motion setup
+        if (fifo_stopping) {
+            xSemaphoreGive(fifo_stopped);
+            vTaskSuspend(NULL);
+        }
+        FIFO_Drain();
+    }
+}
+
+void QMI8658_FIFO_Init(void)
+{
+    ring_lock = xSemaphoreCreateMutex();
+    if (!ring_lock) {
+        ESP_LOGE(TAG_IMU, "Failed to create FIFO ring lock");
+        return;
+    }
+
+    setAccODR(acc_odr_norm_120);
+    setGyroODR(gyro_odr_norm_120);
+    QMI8658_transmit(QMI8658_FIFO_WTM_TH, QMI8658_FIFO_WATERMARK);
+    QMI8658_transmit(QMI8658_FIFO_CTRL, QMI8658_FIFO_CTRL_VALUE);
+    QMI8658_CTRL9_Write(QMI8658_CTRL_CMD_RST_FIFO);
+
+    if (xTaskCreatePinnedToCore(FIFO_Task, "IMU", QMI8658_FIFO_TASK_STACK_SIZE, NULL,
+                                QMI8658_FIFO_TASK_PRIORITY, &fifo_task_handle, QMI8658_FIFO_TASK_CORE) != pdPASS) {
+        ESP_LOGE(TAG_IMU, "Failed to create IMU task");
+        return;
+    }
+
+#if QMI8658_FIFO_USE_INT
+    uint8_t ctrl1 = QMI8658_receive(QMI8658_CTRL1);
+    QMI8658_transmit(QMI8658_CTRL1, ctrl1 | QMI8658_CTRL1_INT1_EN | QMI8658_CTRL1_FIFO_INT1);
+
+    const gpio_config_t int_gpio_config = {
+        .pin_bit_mask = 1ULL << CONFIG_QMI8658_INT_GPIO,
+        .mode = GPIO_MODE_INPUT,
+        .intr_type = GPIO_INTR_POSEDGE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&int_gpio_config));
+    esp_err_t ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {     // Already installed is fine
+        ESP_LOGE(TAG_IMU, "Failed to install GPIO ISR service: %s", esp_err_to_name(ret));
+        return;
+    }
+    gpio_isr_handler_add(CONFIG_QMI8658_INT_GPIO, FIFO_ISR_Handler, NULL);
+    ESP_LOGI(TAG_IMU, "FIFO mode, watermark interrupt on GPIO %d", CONFIG_QMI8658_INT_GPIO);
+#else
+    ESP_LOGI(TAG_IMU, "FIFO mode, drained every %d ms", QMI8658_FIFO_WATERMARK * 1000 / QMI8658_FIFO_ODR_HZ);
+#endif
+}
+
+bool QMI8658_Wake_On_Motion(uint8_t threshold_mg)
+{
+#if QMI8658_FIFO_USE_INT
+    gpio_isr_handler_remove(CONFIG_QMI8658_INT_GPIO);
+    if (fifo_task_handle) {
+        fifo_stopped = xSemaphoreCreateBinary();
+        if (!fifo_stopped) {
+            return false;
+        }
+        fifo_stopping = true;
+        xTaskNotifyGive(fifo_task_handle);
+        if (xSemaphoreTake(fifo_stopped, pdMS_TO_TICKS(500)) != pdTRUE) {
+            ESP_LOGW(TAG_IMU, "IMU task did not stop, wake-on-motion not armed");
+            return false;
+        }
+    }
+
+    QMI8658_transmit(QMI8658_CTRL7, 0x00);                  // Sensors off while it is set up
+    QMI8658_transmit(QMI8658_FIFO_CTRL, 0x00);              // FIFO bypass
+    uint8_t ctrl2 = QMI8658_receive(QMI8658_CTRL2);
+    QMI8658_transmit(QMI8658_CTRL2, (ctrl2 & ~QMI8658_AODR_MASK) | acc_odr_lp_21);
+    QMI8658_transmit(QMI8658_CAL1_L, threshold_mg);
+    QMI8658_transmit(QMI8658_CAL1_H, QMI8658_WOM_INT1_LOW | QMI8658_WOM_BLANKING);
+    QMI8658_CTRL9_Write(QMI8658_CTRL_CMD_WRITE_WOM);
+    uint8_t ctrl1 = QMI8658_receive(QMI8658_CTRL1);
+    QMI8658_transmit(QMI8658_CTRL1, (ctrl1 | QMI8658_CTRL1_INT1_EN) & ~QMI8658_CTRL1_FIFO_INT1);
+    QMI8658_transmit(QMI8658_CTRL7, 0x01);                  // Accelerometer only
+    ESP_LOGI(TAG_IMU, "Wake-on-motion above %u mg on GPIO %d", threshold_mg, CONFIG_QMI8658_INT_GPIO);
+    return true;
+#else
+    (void)threshold_mg;
+    return false;
+#endif
+}
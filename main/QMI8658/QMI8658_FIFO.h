@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "QMI8658.h"
+#include "task_plan.h"
+
+/*
+ * FIFO mode: the QMI8658 samples accel + gyro at QMI8658_FIFO_ODR_HZ into its
+ * own FIFO and an IMU task drains it in bursts once QMI8658_FIFO_WATERMARK
+ * samples are waiting - woken by the watermark interrupt when
+ * CONFIG_QMI8658_INT_GPIO is wired, otherwise once per watermark period.
+ * Samples land in a timestamped ring buffer; Accel/Gyro keep the newest one.
+ *
+ * Each batch also feeds a wake detector: a tap (sharp spike) or a pick-up
+ * (sustained change against the gravity baseline) calls the wake callback.
+ */
+
+#define QMI8658_FIFO_ODR_HZ             117     // acc_odr_norm_120 / gyro_odr_norm_120 (6DOF)
+#define QMI8658_FIFO_WATERMARK          16      // Samples per batch, ~140 ms
+#define QMI8658_FIFO_RING_SIZE          128     // Samples kept for consumers, ~1 s
+#define QMI8658_FIFO_TASK_STACK_SIZE    3072
+#define QMI8658_FIFO_TASK_PRIORITY      TASK_PLAN_IMU_PRIORITY
+#define QMI8658_FIFO_TASK_CORE          TASK_PLAN_IMU_CORE
+
+#define QMI8658_WAKE_PICKUP_G           0.20f   // Deviation from the gravity baseline
+#define QMI8658_WAKE_PICKUP_SAMPLES     6       // ... held this many samples in a row
+#define QMI8658_WAKE_TAP_G              1.0f    // Sample-to-sample jump of |a|
+#define QMI8658_WAKE_HOLDOFF_MS         1000    // Minimum time between wake calls
+
+#define QMI8658_FIFO_WTM_TH             0x13
+#define QMI8658_FIFO_CTRL               0x14
+#define QMI8658_FIFO_SMPL_CNT           0x15
+#define QMI8658_FIFO_STATUS             0x16
+#define QMI8658_FIFO_DATA               0x17
+
+#define QMI8658_CTRL_CMD_RST_FIFO       0x04
+#define QMI8658_CTRL_CMD_REQ_FIFO       0x05
+#define QMI8658_CTRL_CMD_WRITE_WOM      0x08    // Threshold in CAL1_L, pin and blanking in CAL1_H
+#define QMI8658_WOM_INT1_LOW            0x80    // CAL1_H: on INT1, low until motion
+#define QMI8658_WOM_BLANKING            0x20    // CAL1_H: samples ignored once armed, ~1.5 s at 21 Hz
+
+typedef struct {
+    int64_t time_us;        // esp_timer time the sample was taken (estimated)
+    IMUdata accel;          // g
+    IMUdata gyro;           // dps
+} qmi8658_sample_t;
+
+typedef enum {
+    QMI8658_WAKE_TAP,
+    QMI8658_WAKE_PICKUP,
+} qmi8658_wake_reason_t;
+
+// Runs on the IMU task
+typedef void (*qmi8658_wake_cb_t)(qmi8658_wake_reason_t reason);
+
+void QMI8658_FIFO_Init(void);                                   // After QMI8658_Init()
+size_t QMI8658_FIFO_Read(qmi8658_sample_t *samples, size_t max_samples);   // Oldest first; returns count
+void QMI8658_Set_Wake_Callback(qmi8658_wake_cb_t callback);
+// For suspend: stops the IMU task and leaves only the accelerometer running,
+// at 21 Hz low power, raising INT1 on a change above threshold_mg. Only
+// QMI8658_Init() undoes it. False without CONFIG_QMI8658_INT_GPIO.
+bool QMI8658_Wake_On_Motion(uint8_t threshold_mg);
@@ -0,0 +1,369 @@
+#include "QMI8658_Fusion.h"
+#include <math.h>
+#include <string.h>
+#include "esp_cpu.h"
+#include "esp_log.h"
+
+static const char *TAG_FUSION = "Fusion";
+
+#define FUSION_DEG_TO_RAD               0.017453293f
+#define FUSION_RAD_TO_DEG               57.29578f
+#define FUSION_PERIOD_S                 (1.0f / QMI8658_FIFO_ODR_HZ)
+#define FUSION_BIAS_RATE                0.02f   // Gyro bias follows this fraction per sample at rest
+#define FUSION_TILT_FOLLOW              0.01f   // The rest angle follows slow drift while untilted
+#define FUSION_MAX_EVENTS               4       // Per sample
+
+typedef struct {
+    qmi8658_motion_event_t event;
+    int value;
+} fusion_event_t;
+
+typedef struct {
+    // Mahony filter
+    float q0, q1, q2, q3;
+    float ix, iy, iz;               // Integral feedback, rad/s
+    IMUdata gravity;                // Unit, from the attitude
+    int64_t last_us;
+    bool started;
+
+    // Way up
+    qmi8658_face_t face;
+    bool face_known;
+    qmi8658_face_t face_pending;
+    int64_t face_since_us;          // 0: nothing pending
+
+    // Rest and pick-up
+    IMUdata gyro_bias;              // dps
+    int64_t still_since_us;
+    bool resting;
+
+    // Tilt
+    float rest_angle;               // Degrees in the screen's plane
+    bool rest_angle_valid;
+    int tilt_dir;                   // -1 left, 1 right, 0 none
+    int64_t tilt_since_us;
+    int64_t tilt_next_us;
+    int tilt_steps;
+
+    // Shake
+    int64_t peaks[QMI8658_MOTION_SHAKE_PEAKS];
+    int peak_next;
+    int peak_count;
+    bool jolt;
+    int64_t shake_holdoff_us;
+
+    fusion_event_t events[FUSION_MAX_EVENTS];
+    int event_count;
+} fusion_state_t;
+
+static fusion_state_t fusion;
+static qmi8658_motion_cb_t motion_cb = NULL;
+static qmi8658_fusion_stats_t stats;
+static uint64_t stats_total_cycles;
+static bool budget_warned = false;
+
+void QMI8658_Fusion_Set_Callback(qmi8658_motion_cb_t callback)
+{
+    motion_cb = callback;
+}
+
+static void Fusion_Emit(fusion_state_t *s, qmi8658_motion_event_t event, int value)
+{
+    if (s->event_count < FUSION_MAX_EVENTS) {
+        s->events[s->event_count++] = (fusion_event_t){ event, value };
+    }
+}
+
+static void Fusion_Update_Gravity(fusion_state_t *s)
+{
+    s->gravity.x = 2.0f * (s->q1 * s->q3 - s->q0 * s->q2);
+    s->gravity.y = 2.0f * (s->q0 * s->q1 + s->q2 * s->q3);
+    s->gravity.z = s->q0 * s->q0 - s->q1 * s->q1 - s->q2 * s->q2 + s->q3 * s->q3;
+}
+
+// Level the attitude on the first reading, so the filter need not converge from nothing
+static void Fusion_Start(fusion_state_t *s, const IMUdata *a)
+{
+    float roll = atan2f(a->y, a->z);
+    float pitch = atan2f(-a->x, sqrtf(a->y * a->y + a->z * a->z));
+    float cr = cosf(roll * 0.5f), sr = sinf(roll * 0.5f);
+    float cp = cosf(pitch * 0.5f), sp = sinf(pitch * 0.5f);
+    s->q0 = cr * cp;
+    s->q1 = sr * cp;
+    s->q2 = cr * sp;
+    s->q3 = -sr * sp;
+    s->ix = s->iy = s->iz = 0.0f;
+    Fusion_Update_Gravity(s);
+    s->started = true;
+}
+
+static void Fusion_Mahony(fusion_state_t *s, const IMUdata *a, const IMUdata *g, float magnitude, float dt)
+{
+    float gx = g->x * FUSION_DEG_TO_RAD;
+    float gy = g->y * FUSION_DEG_TO_RAD;
+    float gz = g->z * FUSION_DEG_TO_RAD;
+
+    // A jolt or a swing is not gravity: integrate the gyro alone through it
+    if (fabsf(magnitude - 1.0f) < QMI8658_FUSION_ACCEL_TRUST_G) {
+        float recip = 1.0f / magnitude;
+        float ax = a->x * recip, ay = a->y * recip, az = a->z * recip;
+        const IMUdata *v = &s->gravity;
+        float ex = ay * v->z - az * v->y;
+        float ey = az * v->x - ax * v->z;
+        float ez = ax * v->y - ay * v->x;
+        s->ix += QMI8658_FUSION_KI * ex * dt;
+        s->iy += QMI8658_FUSION_KI * ey * dt;
+        s->iz += QMI8658_FUSION_KI * ez * dt;
+        gx += QMI8658_FUSION_KP * ex;
+        gy += QMI8658_FUSION_KP * ey;
+        gz += QMI8658_FUSION_KP * ez;
+    }
+    gx = (gx + s->ix) * 0.5f * dt;
+    gy = (gy + s->iy) * 0.5f * dt;
+    gz = (gz + s->iz) * 0.5f * dt;
+
+    float q0 = s->q0, q1 = s->q1, q2 = s->q2, q3 = s->q3;
+    s->q0 += -q1 * gx - q2 * gy - q3 * gz;
+    s->q1 += q0 * gx + q2 * gz - q3 * gy;
+    s->q2 += q0 * gy - q1 * gz + q3 * gx;
+    s->q3 += q0 * gz + q1 * gy - q2 * gx;
+    float norm = 1.0f / sqrtf(s->q0 * s->q0 + s->q1 * s->q1 + s->q2 * s->q2 + s->q3 * s->q3);
+    s->q0 *= norm;
+    s->q1 *= norm;
+    s->q2 *= norm;
+    s->q3 *= norm;
+    Fusion_Update_Gravity(s);
+}
+
+static void Fusion_Detect_Face(fusion_state_t *s, int64_t time_us)
+{
+    const IMUdata *v = &s->gravity;
+    float down = QMI8658_FUSION_DOWN(*v);
+    qmi8658_face_t want = s->face;
+    if (fabsf(v->z) > QMI8658_MOTION_FACE_FLAT_G) {
+        want = QMI8658_FACE_FLAT;
+    } else if (down >= QMI8658_MOTION_FACE_FLIP_G) {
+        want = QMI8658_FACE_UPRIGHT;
+    } else if (down <= -QMI8658_MOTION_FACE_FLIP_G) {
+        want = QMI8658_FACE_UPSIDE_DOWN;
+    }
+
+    if (s->face_known && want == s->face) {
+        s->face_since_us = 0;
+        return;
+    }
+    if (s->face_since_us == 0 || want != s->face_pending) {
+        s->face_pending = want;
+        s->face_since_us = time_us;
+        return;
+    }
+    if (time_us - s->face_since_us >= QMI8658_MOTION_FACE_HOLD_MS * 1000LL) {
+        s->face = want;
+        s->face_known = true;
+        s->face_since_us = 0;
+        Fusion_Emit(s, QMI8658_MOTION_ORIENTATION, want);
+    }
+}
+
+// Returns the turn rate with the learnt bias taken off, in dps
+static float Fusion_Detect_Rest(fusion_state_t *s, const IMUdata *g, float magnitude, int64_t time_us)
+{
+    float gx = g->x - s->gyro_bias.x;
+    float gy = g->y - s->gyro_bias.y;
+    float gz = g->z - s->gyro_bias.z;
+    float rate = sqrtf(gx * gx + gy * gy + gz * gz);
+
+    if (rate < QMI8658_MOTION_REST_DPS && fabsf(magnitude - 1.0f) < QMI8658_MOTION_REST_G) {
+        if (s->still_since_us == 0) {
+            s->still_since_us = time_us;
+        }
+        s->gyro_bias.x += gx * FUSION_BIAS_RATE;
+        s->gyro_bias.y += gy * FUSION_BIAS_RATE;
+        s->gyro_bias.z += gz * FUSION_BIAS_RATE;
+        if (!s->resting && time_us - s->still_since_us >= QMI8658_MOTION_REST_MS * 1000LL) {
+            s->resting = true;
+        }
+    } else {
+        s->still_since_us = 0;
+        if (s->resting && rate > QMI8658_MOTION_PICKUP_DPS) {
+            s->resting = false;
+            Fusion_Emit(s, QMI8658_MOTION_PICKUP, 0);
+        }
+    }
+    return rate;
+}
+
+static void Fusion_Detect_Tilt(fusion_state_t *s, float rate, int64_t time_us)
+{
+    bool standing = s->face_known && s->face != QMI8658_FACE_FLAT;
+    if (!standing) {
+        s->tilt_dir = 0;
+        s->tilt_since_us = 0;
+        s->rest_angle_valid = false;
+        return;
+    }
+
+    // Lowering the picture's right edge is positive, whichever way up it is
+    const IMUdata *v = &s->gravity;
+    float angle = atan2f(QMI8658_FUSION_RIGHT(*v), fabsf(QMI8658_FUSION_DOWN(*v))) * FUSION_RAD_TO_DEG;
+    if (s->face == QMI8658_FACE_UPSIDE_DOWN) {
+        angle = -angle;
+    }
+    if (!s->rest_angle_valid) {
+        s->rest_angle = angle;
+        s->rest_angle_valid = true;
+        return;
+    }
+
+    float delta = angle - s->rest_angle;
+    bool still = rate < QMI8658_MOTION_STILL_DPS;
+    if (s->tilt_dir == 0) {
+        if (fabsf(delta) < QMI8658_MOTION_TILT_RELEASE_DEG && still) {
+            s->rest_angle += delta * FUSION_TILT_FOLLOW;
+        }
+        if (fabsf(delta) < QMI8658_MOTION_TILT_DEG || !still) {
+            s->tilt_since_us = 0;
+            return;
+        }
+        if (s->tilt_since_us == 0) {
+            s->tilt_since_us = time_us;
+            return;
+        }
+        if (time_us - s->tilt_since_us >= QMI8658_MOTION_TILT_HOLD_MS * 1000LL) {
+            s->tilt_dir = delta > 0 ? 1 : -1;
+            s->tilt_steps = 1;
+            s->tilt_next_us = time_us + QMI8658_MOTION_TILT_REPEAT_MS * 1000LL;
+            Fusion_Emit(s, s->tilt_dir > 0 ? QMI8658_MOTION_TILT_RIGHT : QMI8658_MOTION_TILT_LEFT, 1);
+        }
+        return;
+    }
+
+    if (delta * s->tilt_dir < QMI8658_MOTION_TILT_RELEASE_DEG) {
+        s->tilt_dir = 0;
+        s->tilt_since_us = 0;
+        return;
+    }
+    if (still && time_us >= s->tilt_next_us) {
+        if (s->tilt_steps >= QMI8658_MOTION_TILT_MAX_STEPS) {
+            // Left that way: it rests there now
+            s->rest_angle = angle;
+            s->tilt_dir = 0;
+            s->tilt_since_us = 0;
+            return;
+        }
+        s->tilt_steps++;
+        s->tilt_next_us += QMI8658_MOTION_TILT_REPEAT_MS * 1000LL;
+        Fusion_Emit(s, s->tilt_dir > 0 ? QMI8658_MOTION_TILT_RIGHT : QMI8658_MOTION_TILT_LEFT, s->tilt_steps);
+    }
+}
+
+static void Fusion_Detect_Shake(fusion_state_t *s, float magnitude, int64_t time_us)
+{
+    bool jolt = magnitude > 1.0f + QMI8658_MOTION_SHAKE_G;
+    if (jolt && !s->jolt) {
+        s->peaks[s->peak_next] = time_us;
+        s->peak_next = (s->peak_next + 1) % QMI8658_MOTION_SHAKE_PEAKS;
+        if (s->peak_count < QMI8658_MOTION_SHAKE_PEAKS) {
+            s->peak_count++;
+        }
+        // peak_next now holds the oldest of the last few
+        if (s->peak_count == QMI8658_MOTION_SHAKE_PEAKS && time_us >= s->shake_holdoff_us &&
+            time_us - s->peaks[s->peak_next] <= QMI8658_MOTION_SHAKE_WINDOW_MS * 1000LL) {
+            s->peak_count = 0;
+            s->shake_holdoff_us = time_us + QMI8658_MOTION_SHAKE_HOLDOFF_MS * 1000LL;
+            Fusion_Emit(s, QMI8658_MOTION_SHAKE, 0);
+        }
+    }
+    s->jolt = jolt;
+}
+
+static void Fusion_Step(fusion_state_t *s, const qmi8658_sample_t *sample)
+{
+    const IMUdata *a = &sample->accel;
+    float magnitude = sqrtf(a->x * a->x + a->y * a->y + a->z * a->z);
+    s->event_count = 0;
+    if (!s->started) {
+        if (magnitude > 0.0f) {
+            Fusion_Start(s, a);
+            s->last_us = sample->time_us;
+        }
+        return;
+    }
+
+    // Timestamps within a batch are estimates; only trust a plausible gap
+    float dt = FUSION_PERIOD_S;
+    float gap = (sample->time_us - s->last_us) * 1e-6f;
+    if (gap > 0.5f * FUSION_PERIOD_S && gap < 2.0f * FUSION_PERIOD_S) {
+        dt = gap;
+    }
+    s->last_us = sample->time_us;
+
+    Fusion_Mahony(s, a, &sample->gyro, magnitude, dt);
+    Fusion_Detect_Face(s, sample->time_us);
+    float rate = Fusion_Detect_Rest(s, &sample->gyro, magnitude, sample->time_us);
+    Fusion_Detect_Tilt(s, rate, sample->time_us);
+    Fusion_Detect_Shake(s, magnitude, sample->time_us);
+}
+
+void QMI8658_Fusion_Feed(const qmi8658_sample_t *sample)
+{
+    uint32_t start = esp_cpu_get_cycle_count();
+    Fusion_Step(&fusion, sample);
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+
+    stats.samples++;
+    stats_total_cycles += cycles;
+    stats.cycles_avg = (uint32_t)(stats_total_cycles / stats.samples);
+    if (cycles > stats.cycles_max) {
+        stats.cycles_max = cycles;
+    }
+    if (!budget_warned && stats.samples >= QMI8658_FIFO_ODR_HZ && stats.cycles_avg > QMI8658_FUSION_BUDGET_CYCLES) {
+        budget_warned = true;
+        ESP_LOGW(TAG_FUSION, "Fusion takes %lu cycles per sample, over its %d budget",
+                 (unsigned long)stats.cycles_avg, QMI8658_FUSION_BUDGET_CYCLES);
+    }
+
+    // Outside the measured step: the callback's cost is the consumer's
+    qmi8658_motion_cb_t cb = motion_cb;
+    for (int i = 0; cb && i < fusion.event_count; i++) {
+        cb(fusion.events[i].event, fusion.events[i].value);
+    }
+}
+
+// Read from other tasks; a torn read mixes two consecutive samples at worst
+IMUdata QMI8658_Fusion_Gravity(void)
+{
+    return fusion.gravity;
+}
+
+qmi8658_face_t QMI8658_Fusion_Face(void)
+{
+    return fusion.face_known ? fusion.face : QMI8658_FACE_FLAT;
+}
+
+void QMI8658_Fusion_Get_Stats(qmi8658_fusion_stats_t *out)
+{
+    *out = stats;
+}
+
+uint32_t QMI8658_Fusion_Bench(int samples)
+{
+    static fusion_state_t bench;   // Not on the caller's stack
+    memset(&bench, 0, sizeof(bench));
+
+    // Turning in the screen's plane at 60 dps, with a jolt every 0.5 s
+    uint64_t total = 0;
+    for (int i = 0; i < samples; i++) {
+        float angle = i * FUSION_PERIOD_S * 60.0f * FUSION_DEG_TO_RAD;
+        bool jolt = i % (QMI8658_FIFO_ODR_HZ / 2) == 0;
+        qmi8658_sample_t sample = {
+            .time_us = 1 + (int64_t)i * (1000000 / QMI8658_FIFO_ODR_HZ),
+            .accel = { sinf(angle) * (jolt ? 3.0f : 1.0f), cosf(angle), 0.1f },
+            .gyro = { 0.5f, -0.3f, 60.0f },
+        };
+        uint32_t start = esp_cpu_get_cycle_count();
+        Fusion_Step(&bench, &sample);
+        total += esp_cpu_get_cycle_count() - start;
+    }
+    return samples > 0 ? (uint32_t)(total / samples) : 0;
+}
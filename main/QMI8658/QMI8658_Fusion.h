@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "QMI8658_FIFO.h"
+
+/*
+ * Sensor fusion and motion events (CONFIG_QMI8658_FUSION).
+ *
+ * A Mahony filter (proportional-integral correction of the gyro by the
+ * accelerometer's gravity) runs on every FIFO sample, on the IMU task
+ * right after each batch is drained, so it costs nothing between batches.
+ * Its gravity direction is steadier than one accel reading: a tap or a
+ * shake moves it little, and the filter skips the accel correction while
+ * |a| is far from 1 g. Four detectors run on it and report, rarely and
+ * through the motion callback:
+ *
+ * - ORIENTATION: the picture's way up (upright, upside down, or lying
+ *   flat) changed and held QMI8658_MOTION_FACE_HOLD_MS, with the
+ *   hysteresis LVGL_Orientation had, so auto-flip needs no polling timer
+ * - TILT_LEFT / TILT_RIGHT: turned in the screen's plane by
+ *   QMI8658_MOTION_TILT_DEG from where it rested, held still; repeated
+ *   every QMI8658_MOTION_TILT_REPEAT_MS while held, up to
+ *   QMI8658_MOTION_TILT_MAX_STEPS, after which the new angle is where it rests
+ * - SHAKE: QMI8658_MOTION_SHAKE_PEAKS jolts above QMI8658_MOTION_SHAKE_G
+ *   within QMI8658_MOTION_SHAKE_WINDOW_MS
+ * - PICKUP: it rested QMI8658_MOTION_REST_MS and then turned faster than
+ *   QMI8658_MOTION_PICKUP_DPS (the gyro bias learnt at rest taken off)
+ *
+ * The filter and detectors are float: the S3's FPU does single precision
+ * in hardware, so fixed point would buy nothing. Every sample's cost is
+ * counted in CPU cycles (QMI8658_Fusion_Get_Stats()), and the IMU task
+ * logs a warning once if the average passes QMI8658_FUSION_BUDGET_CYCLES.
+ * QMI8658_Fusion_Bench() runs the same step on a private state for
+ * espcaster_bench.
+ */
+
+// Picture axes in the sensor frame, for how the IMU sits on this board (as
+// LVGL_ORIENT_DOWN_G): towards the bottom and the right edge of the
+// unflipped picture
+#define QMI8658_FUSION_DOWN(v)          ((v).y)
+#define QMI8658_FUSION_RIGHT(v)         ((v).x)
+
+#define QMI8658_FUSION_KP               1.0f    // Accel correction gain
+#define QMI8658_FUSION_KI               0.02f   // Gyro bias integral gain
+#define QMI8658_FUSION_ACCEL_TRUST_G    0.2f    // |a| further than this from 1 g: gyro only
+#define QMI8658_FUSION_BUDGET_CYCLES    6000    // Per sample; ~25 us at 240 MHz, 0.3 % of a core
+
+#define QMI8658_MOTION_FACE_FLIP_G      0.6f    // Gravity along the picture's vertical, about 37 degrees past level
+#define QMI8658_MOTION_FACE_FLAT_G      0.8f    // |z| above this: lying flat
+#define QMI8658_MOTION_FACE_HOLD_MS     700
+#define QMI8658_MOTION_TILT_DEG         25.0f
+#define QMI8658_MOTION_TILT_RELEASE_DEG 15.0f   // Back within this ends a tilt
+#define QMI8658_MOTION_TILT_HOLD_MS     400
+#define QMI8658_MOTION_TILT_REPEAT_MS   600
+#define QMI8658_MOTION_TILT_MAX_STEPS   10
+#define QMI8658_MOTION_STILL_DPS        30.0f   // Turning slower than this counts as held still
+#define QMI8658_MOTION_SHAKE_G          1.5f    // |a| above 1 g by this is a jolt
+#define QMI8658_MOTION_SHAKE_PEAKS      3
+#define QMI8658_MOTION_SHAKE_WINDOW_MS  800
+#define QMI8658_MOTION_SHAKE_HOLDOFF_MS 1500
+#define QMI8658_MOTION_REST_DPS         6.0f
+#define QMI8658_MOTION_REST_G           0.05f
+#define QMI8658_MOTION_REST_MS          2000
+#define QMI8658_MOTION_PICKUP_DPS       40.0f
+
+typedef enum {
+    QMI8658_MOTION_ORIENTATION,     // value: qmi8658_face_t
+    QMI8658_MOTION_TILT_LEFT,       // value: steps so far in this tilt, from 1
+    QMI8658_MOTION_TILT_RIGHT,
+    QMI8658_MOTION_SHAKE,
+    QMI8658_MOTION_PICKUP,
+} qmi8658_motion_event_t;
+
+typedef enum {
+    QMI8658_FACE_UPRIGHT,
+    QMI8658_FACE_UPSIDE_DOWN,
+    QMI8658_FACE_FLAT,
+} qmi8658_face_t;
+
+typedef struct {
+    uint32_t samples;
+    uint32_t cycles_avg;            // Per sample
+    uint32_t cycles_max;
+} qmi8658_fusion_stats_t;
+
+// Runs on the IMU task
+typedef void (*qmi8658_motion_cb_t)(qmi8658_motion_event_t event, int value);
+
+void QMI8658_Fusion_Set_Callback(qmi8658_motion_cb_t callback);
+void QMI8658_Fusion_Feed(const qmi8658_sample_t *sample);      // IMU task, each sample in order
+IMUdata QMI8658_Fusion_Gravity(void);                           // Unit vector, sensor frame
+qmi8658_face_t QMI8658_Fusion_Face(void);
+void QMI8658_Fusion_Get_Stats(qmi8658_fusion_stats_t *stats);
+uint32_t QMI8658_Fusion_Bench(int samples);                     // Average cycles per sample, synthetic motion
@@ -1,7 +1,8 @@
 #include "SD_MMC.h"
+#include "SD_SelfTest.h"
 
 #define EXAMPLE_MAX_CHAR_SIZE    64
-#define MOUNT_POINT "/sdcard"
+#define MOUNT_POINT SD_MOUNT_POINT
 
 static const char *SD_TAG = "SD";
 
@@ -47,16 +48,34 @@ esp_err_t s_example_read_file(const char *path)
 }
 
 
+// Bus modes tried in turn, the fastest wired one first. The driver only
+// switches to high speed if the card says it can; a card or a layout that
+// still fails there (40 MHz over the internal pull-ups) gets the next one.
+typedef struct {
+    uint8_t width;
+    int freq_khz;
+} SD_Bus_Mode_t;
+
+static const SD_Bus_Mode_t SD_Bus_Modes[] = {
+#if CONFIG_SD_HIGH_SPEED
+    { SD_BUS_WIDTH, SDMMC_FREQ_HIGHSPEED },
+#endif
+    { SD_BUS_WIDTH, SDMMC_FREQ_DEFAULT },
+#if SD_BUS_WIDTH == 4
+    { 1, SDMMC_FREQ_DEFAULT },
+#endif
+};
+
 void SD_Init(void)
 {
-    esp_err_t ret;
+    esp_err_t ret = ESP_FAIL;
 
     // Options for mounting the filesystem.
     // If format_if_mount_failed is set to true, SD card will be partitioned and formatted in case when mounting fails.  false true
     esp_vfs_fat_sdmmc_mount_config_t mount_config = {
         .format_if_mount_failed = true,           
         .max_files = 5,
-        .allocation_unit_size = 16 * 1024
+        .allocation_unit_size = CONFIG_SD_ALLOCATION_UNIT_KB * 1024     // Only used when formatting
     };
     sdmmc_card_t *card;
     const char mount_point[] = MOUNT_POINT;
@@ -67,16 +86,13 @@ void SD_Init(void)
     // Please check its source code and implement error recovery when developing production applications.
     ESP_LOGI(SD_TAG, "Using SPI peripheral");
 
-    // By default, SD card frequency is initialized to SDMMC_FREQ_DEFAULT (20MHz)
-    // For setting a specific frequency, use host.max_freq_khz (range 400kHz - 20MHz for SDSPI)
-    // Example: for fixed frequency of 10MHz, use host.max_freq_khz = 10000;
+    // The clock (host.max_freq_khz) and the bus width are set per SD_Bus_Modes entry
     sdmmc_host_t host = SDMMC_HOST_DEFAULT();
 
 
     // This initializes the slot without card detect (CD) and write protect (WP) signals.
     // Modify slot_config.gpio_cd and slot_config.gpio_wp if your board has these signals.
     sdmmc_slot_config_t slot_config = SDMMC_SLOT_CONFIG_DEFAULT();
-    slot_config.width = 1;          // 1-wire  / 4-wire   slot_config.width = 4;
 
     slot_config.clk = CONFIG_EXAMPLE_PIN_CLK;
     slot_config.cmd = CONFIG_EXAMPLE_PIN_CMD;
@@ -91,7 +107,16 @@ void SD_Init(void)
 
 
     ESP_LOGI(SD_TAG, "Mounting filesystem");
-    ret = esp_vfs_fat_sdmmc_mount(mount_point, &host, &slot_config, &mount_config, &card);
+    for (size_t m = 0; m < sizeof(SD_Bus_Modes) / sizeof(SD_Bus_Modes[0]); m++) {
+        host.max_freq_khz = SD_Bus_Modes[m].freq_khz;
+        slot_config.width = SD_Bus_Modes[m].width;
+        ret = esp_vfs_fat_sdmmc_mount(mount_point, &host, &slot_config, &mount_config, &card);
+        if (ret == ESP_OK) {
+            break;
+        }
+        ESP_LOGW(SD_TAG, "%d-bit at %d kHz failed (%s)", SD_Bus_Modes[m].width, SD_Bus_Modes[m].freq_khz,
+                 esp_err_to_name(ret));
+    }
 
     if (ret != ESP_OK) {
         if (ret == ESP_FAIL) {
@@ -108,6 +133,7 @@ void SD_Init(void)
     // Card has been initialized, print its properties
     sdmmc_card_print_info(stdout, card);
     SDCard_Size = ((uint64_t) card->csd.capacity) * card->csd.sector_size / (1024 * 1024);
+    SD_Self_Test_Start(1 << card->log_bus_width, card->real_freq_khz);
 }
 void Flash_Searching(void)
 {
@@ -121,6 +147,29 @@ void Flash_Searching(void)
     }
 }
 
+// Never formats: an unmounted partition only means the files on it are not used
+esp_err_t Flash_FAT_Mount(void)
+{
+    static wl_handle_t wl_handle = WL_INVALID_HANDLE;
+    if (wl_handle != WL_INVALID_HANDLE) {
+        return ESP_OK;
+    }
+
+    const esp_vfs_fat_mount_config_t mount_config = {
+        .format_if_mount_failed = false,
+        .max_files = 4,
+        .allocation_unit_size = CONFIG_WL_SECTOR_SIZE,
+    };
+    esp_err_t ret = esp_vfs_fat_spiflash_mount_rw_wl(FLASH_FAT_MOUNT_POINT, FLASH_FAT_PARTITION,
+                                                     &mount_config, &wl_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGW(SD_TAG, "Failed to mount %s (%s)", FLASH_FAT_PARTITION, esp_err_to_name(ret));
+        return ret;
+    }
+    ESP_LOGI(SD_TAG, "%s mounted at %s", FLASH_FAT_PARTITION, FLASH_FAT_MOUNT_POINT);
+    return ESP_OK;
+}
+
 
 FILE* Open_File(const char *file_path) {
     ESP_LOGI(SD_TAG, "Attempting to open file: %s", file_path);
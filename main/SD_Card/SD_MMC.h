@@ -10,18 +10,32 @@
 #include "driver/sdmmc_host.h"
 #include "esp_log.h" 
 #include <errno.h>
+#include "sdkconfig.h"
 
 #include "esp_flash.h"    
 
 #define CONFIG_EXAMPLE_PIN_CLK  14
 #define CONFIG_EXAMPLE_PIN_CMD  17
 #define CONFIG_EXAMPLE_PIN_D0   16
+#if CONFIG_SD_BUS_WIDTH_4
+#define CONFIG_EXAMPLE_PIN_D1   CONFIG_SD_PIN_D1
+#define CONFIG_EXAMPLE_PIN_D2   CONFIG_SD_PIN_D2
+#define CONFIG_EXAMPLE_PIN_D3   CONFIG_SD_PIN_D3
+#define SD_BUS_WIDTH            4
+#else
 #define CONFIG_EXAMPLE_PIN_D1   -1
 #define CONFIG_EXAMPLE_PIN_D2   -1
 #define CONFIG_EXAMPLE_PIN_D3   -1  
+#define SD_BUS_WIDTH            1
+#endif
 
 #define CONFIG_SD_Card_D3       21  
 
+// The FAT data partition in flash (fonts and other files read at runtime)
+#define FLASH_FAT_PARTITION     "flash_test"
+#define FLASH_FAT_MOUNT_POINT   "/flash"
+#define SD_MOUNT_POINT          "/sdcard"
+
 
 esp_err_t SD_Card_CS_EN(void);
 esp_err_t SD_Card_CS_Dis(void);
@@ -33,5 +47,6 @@ extern uint32_t SDCard_Size;
 extern uint32_t Flash_Size;
 void SD_Init(void);
 void Flash_Searching(void);
+esp_err_t Flash_FAT_Mount(void);
 FILE* Open_File(const char *file_path);
 uint16_t Folder_retrieval(const char* directory, const char* fileExtension, char File_Name[][100],uint16_t maxFiles);
\ No newline at end of file
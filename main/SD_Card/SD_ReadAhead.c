@@ -0,0 +1,247 @@
+#include "SD_ReadAhead.h"
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "SD_MMC.h"
+
+#if defined(CONFIG_AUDIO_READ_AHEAD)
+
+static const char *TAG = "SD READ AHEAD";
+
+typedef enum {
+    BLOCK_EMPTY,
+    BLOCK_LOADING,          // Owned by the reader task
+    BLOCK_READY,
+} Block_State_t;
+
+typedef struct {
+    uint8_t *data;
+    off_t offset;           // File offset of data[0], a multiple of SD_READ_AHEAD_BLOCK
+    size_t length;          // Short at the end of the file
+    volatile Block_State_t state;
+} Block_t;
+
+typedef struct {
+    int fd;
+    off_t size;
+    off_t position;
+    Block_t blocks[2];
+    SemaphoreHandle_t loaded;   // Given by the reader task after every block
+    volatile bool error;
+} Read_Ahead_t;
+
+typedef struct {
+    Read_Ahead_t *file;
+    Block_t *block;
+} Read_Job_t;
+
+// Whatever newlib's cookie_seek_function_t takes
+#ifdef __LARGE64_FILES
+typedef _off64_t Cookie_Offset_t;
+#else
+typedef off_t Cookie_Offset_t;
+#endif
+
+static QueueHandle_t job_queue;
+
+static void Read_Ahead_Task(void *parameter)
+{
+    Read_Job_t job;
+    while (true) {
+        xQueueReceive(job_queue, &job, portMAX_DELAY);
+        Block_t *block = job.block;
+        ssize_t n = -1;
+        if (lseek(job.file->fd, block->offset, SEEK_SET) == block->offset) {
+            n = read(job.file->fd, block->data, SD_READ_AHEAD_BLOCK);
+        }
+        if (n <= 0) {
+            ESP_LOGE(TAG, "Read at %ld failed", (long)block->offset);
+            job.file->error = true;
+            n = 0;
+        }
+        block->length = n;
+        __atomic_store_n(&block->state, BLOCK_READY, __ATOMIC_RELEASE);    // The data before the state
+        xSemaphoreGive(job.file->loaded);
+    }
+}
+
+static void Read_Ahead_Load(Read_Ahead_t *f, Block_t *block, off_t offset)
+{
+    block->offset = offset;
+    block->length = 0;
+    block->state = BLOCK_LOADING;
+    Read_Job_t job = { .file = f, .block = block };
+    xQueueSend(job_queue, &job, portMAX_DELAY);
+}
+
+static Block_t *Read_Ahead_Find(Read_Ahead_t *f, off_t position)
+{
+    for (int b = 0; b < 2; b++) {
+        Block_t *block = &f->blocks[b];
+        if (__atomic_load_n(&block->state, __ATOMIC_ACQUIRE) == BLOCK_READY && position >= block->offset &&
+            position < block->offset + (off_t)block->length) {
+            return block;
+        }
+    }
+    return NULL;
+}
+
+static ssize_t Read_Ahead_Read(void *cookie, char *buf, size_t size)
+{
+    Read_Ahead_t *f = cookie;
+    size_t done = 0;
+    while (done < size && f->position < f->size && !f->error) {
+        Block_t *block = Read_Ahead_Find(f, f->position);
+        if (!block) {
+            // Start it unless it is already on its way, then wait for the reader
+            off_t offset = f->position / SD_READ_AHEAD_BLOCK * SD_READ_AHEAD_BLOCK;
+            Block_t *pending = NULL, *idle = NULL;
+            for (int b = 0; b < 2; b++) {
+                if (f->blocks[b].state == BLOCK_LOADING) {
+                    if (f->blocks[b].offset == offset) pending = &f->blocks[b];
+                } else {
+                    idle = &f->blocks[b];
+                }
+            }
+            if (!pending && idle) {
+                Read_Ahead_Load(f, idle, offset);
+            }
+            xSemaphoreTake(f->loaded, portMAX_DELAY);
+            continue;
+        }
+
+        size_t at = f->position - block->offset;
+        size_t n = block->length - at;
+        if (n > size - done) n = size - done;
+        memcpy(buf + done, block->data + at, n);
+        done += n;
+        f->position += n;
+
+        // Keep the following block coming while this one is used up
+        Block_t *other = (block == &f->blocks[0]) ? &f->blocks[1] : &f->blocks[0];
+        off_t next = block->offset + SD_READ_AHEAD_BLOCK;
+        if (next < f->size && other->state != BLOCK_LOADING &&
+            !(other->state == BLOCK_READY && other->offset == next)) {
+            Read_Ahead_Load(f, other, next);
+        }
+    }
+    if (done == 0 && f->error) {
+        return -1;
+    }
+    return done;
+}
+
+static int Read_Ahead_Seek(void *cookie, Cookie_Offset_t *offset, int whence)
+{
+    Read_Ahead_t *f = cookie;
+    off_t target = *offset;
+    if (whence == SEEK_CUR) {
+        target += f->position;
+    } else if (whence == SEEK_END) {
+        target += f->size;
+    }
+    if (target < 0) {
+        return -1;
+    }
+    // Nothing is read here: a block already held or coming is reused
+    f->position = target;
+    f->error = false;
+    *offset = target;
+    return 0;
+}
+
+static void Read_Ahead_Free(Read_Ahead_t *f)
+{
+    for (int b = 0; b < 2; b++) {
+        heap_caps_free(f->blocks[b].data);
+    }
+    if (f->loaded) vSemaphoreDelete(f->loaded);
+    if (f->fd >= 0) close(f->fd);
+    free(f);
+}
+
+static int Read_Ahead_Close(void *cookie)
+{
+    Read_Ahead_t *f = cookie;
+    // The reader task may still be filling a block
+    while (f->blocks[0].state == BLOCK_LOADING || f->blocks[1].state == BLOCK_LOADING) {
+        xSemaphoreTake(f->loaded, portMAX_DELAY);
+    }
+    Read_Ahead_Free(f);
+    return 0;
+}
+
+static bool Read_Ahead_Start(void)
+{
+    if (job_queue) {
+        return true;
+    }
+    job_queue = xQueueCreate(SD_READ_AHEAD_QUEUE_LEN, sizeof(Read_Job_t));
+    if (!job_queue) {
+        return false;
+    }
+    if (xTaskCreatePinnedToCore(Read_Ahead_Task, "SD Read Ahead", SD_READ_AHEAD_STACK_SIZE, NULL,
+                                SD_READ_AHEAD_PRIORITY, NULL, SD_READ_AHEAD_CORE) != pdPASS) {
+        vQueueDelete(job_queue);
+        job_queue = NULL;
+        return false;
+    }
+    return true;
+}
+
+FILE *Open_File_ReadAhead(const char *file_path)
+{
+    Read_Ahead_t *f = calloc(1, sizeof(Read_Ahead_t));
+    if (!f || !Read_Ahead_Start()) {
+        free(f);
+        return Open_File(file_path);
+    }
+    f->fd = open(file_path, O_RDONLY);
+    struct stat st;
+    if (f->fd < 0 || fstat(f->fd, &st) != 0) {
+        ESP_LOGE(TAG, "Failed to open file %s", file_path);
+        Read_Ahead_Free(f);
+        return NULL;
+    }
+    f->size = st.st_size;
+    f->loaded = xSemaphoreCreateBinary();
+    for (int b = 0; b < 2; b++) {
+        f->blocks[b].data = heap_caps_aligned_alloc(4, SD_READ_AHEAD_BLOCK, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    }
+    if (!f->loaded || !f->blocks[0].data || !f->blocks[1].data) {
+        ESP_LOGW(TAG, "Out of DMA memory, reading %s directly", file_path);
+        Read_Ahead_Free(f);
+        return Open_File(file_path);
+    }
+
+    cookie_io_functions_t functions = {
+        .read = Read_Ahead_Read,
+        .seek = Read_Ahead_Seek,
+        .close = Read_Ahead_Close,
+    };
+    FILE *fp = fopencookie(f, "r", functions);
+    if (!fp) {
+        Read_Ahead_Free(f);
+        return Open_File(file_path);
+    }
+    // The blocks are the buffer; stdio's would only add a copy
+    setvbuf(fp, NULL, _IONBF, 0);
+    Read_Ahead_Load(f, &f->blocks[0], 0);
+    return fp;
+}
+
+#else
+
+FILE *Open_File_ReadAhead(const char *file_path)
+{
+    return Open_File(file_path);
+}
+
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdio.h>
+#include "sdkconfig.h"
+#include "task_plan.h"
+
+/*
+ * Read-ahead for files streamed off the SD card (CONFIG_AUDIO_READ_AHEAD).
+ *
+ * The file comes back as an unbuffered stdio stream (fopencookie), so the
+ * decoders keep using fread/fseek. Underneath, one reader task fills two
+ * blocks per file: whole, sector-aligned SD_READ_AHEAD_BLOCK reads with
+ * read(2) into DMA-capable internal RAM, which FATFS and the SDMMC driver
+ * hand to the card's DMA with no cache or bounce copy. While the caller
+ * copies out of one block the next one is already being read, so a slow
+ * card or a walk along the FAT chain is hidden behind a whole block.
+ */
+
+#if defined(CONFIG_AUDIO_READ_AHEAD)
+#define SD_READ_AHEAD_BLOCK         (CONFIG_AUDIO_READ_AHEAD_KB * 1024 / 4096 * 4096)
+#else
+#define SD_READ_AHEAD_BLOCK         16384
+#endif
+#define SD_READ_AHEAD_QUEUE_LEN     4
+#define SD_READ_AHEAD_PRIORITY      TASK_PLAN_SD_READ_AHEAD_PRIORITY    // Above the decoder: a finished read is picked up at once
+#define SD_READ_AHEAD_CORE          TASK_PLAN_SD_READ_AHEAD_CORE
+#define SD_READ_AHEAD_STACK_SIZE    3072
+
+// Falls back to a plain fopen() when read-ahead is off or out of memory
+FILE *Open_File_ReadAhead(const char *file_path);
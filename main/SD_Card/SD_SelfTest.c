@@ -0,0 +1,109 @@
+#include "SD_SelfTest.h"
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_vfs_fat.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "telemetry.h"
+#include "SD_MMC.h"
+
+static telemetry_storage_t result;
+
+#if defined(CONFIG_SD_SELF_TEST)
+
+#define SD_SELF_TEST_FILE           SD_MOUNT_POINT "/.sdtest"
+
+static const char *TAG = "SD SELF TEST";
+
+// Times every block; returns the whole pass in us, or -1 if a block failed
+static int64_t Self_Test_Pass(int fd, uint8_t *block, size_t blocks, bool writing, uint16_t *max_ms)
+{
+    int64_t start = esp_timer_get_time();
+    int64_t slowest = 0;
+    for (size_t b = 0; b < blocks; b++) {
+        int64_t t = esp_timer_get_time();
+        ssize_t n = writing ? write(fd, block, SD_SELF_TEST_BLOCK) : read(fd, block, SD_SELF_TEST_BLOCK);
+        if (n != SD_SELF_TEST_BLOCK) {
+            return -1;
+        }
+        t = esp_timer_get_time() - t;
+        slowest = t > slowest ? t : slowest;
+    }
+    if (writing && fsync(fd) != 0) {
+        return -1;
+    }
+    *max_ms = (uint16_t)((slowest + 999) / 1000);
+    return esp_timer_get_time() - start;
+}
+
+static uint32_t Self_Test_Rate(size_t bytes, int64_t us)
+{
+    return us > 0 ? (uint32_t)((uint64_t)bytes * 1000000 / 1024 / us) : 0;
+}
+
+static void Self_Test_Task(void *parameter)
+{
+    vTaskDelay(pdMS_TO_TICKS(SD_SELF_TEST_DELAY_MS));
+
+    size_t blocks = (CONFIG_SD_SELF_TEST_KB * 1024 + SD_SELF_TEST_BLOCK - 1) / SD_SELF_TEST_BLOCK;
+    size_t bytes = blocks * SD_SELF_TEST_BLOCK;
+    uint8_t *block = heap_caps_aligned_alloc(4, SD_SELF_TEST_BLOCK, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    if (!block) {
+        ESP_LOGW(TAG, "Out of DMA memory, not measured");
+        vTaskDelete(NULL);
+    }
+    for (size_t i = 0; i < SD_SELF_TEST_BLOCK; i++) {
+        block[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+
+    // Contiguous, as recordings are: the card is measured, not the FAT allocator
+    bool contiguous = esp_vfs_fat_create_contiguous_file(SD_MOUNT_POINT, SD_SELF_TEST_FILE, bytes, true) == ESP_OK;
+    uint16_t write_max_ms = 0, read_max_ms = 0;
+    int fd = open(SD_SELF_TEST_FILE, contiguous ? O_WRONLY : O_WRONLY | O_CREAT | O_TRUNC);
+    int64_t write_us = fd >= 0 ? Self_Test_Pass(fd, block, blocks, true, &write_max_ms) : -1;
+    if (fd >= 0) {
+        close(fd);
+    }
+    fd = write_us > 0 ? open(SD_SELF_TEST_FILE, O_RDONLY) : -1;
+    int64_t read_us = fd >= 0 ? Self_Test_Pass(fd, block, blocks, false, &read_max_ms) : -1;
+    if (fd >= 0) {
+        close(fd);
+    }
+    unlink(SD_SELF_TEST_FILE);
+    heap_caps_free(block);
+
+    if (write_us < 0 || read_us < 0) {
+        ESP_LOGE(TAG, "%s failed", write_us < 0 ? "Write" : "Read");
+        telemetry_set_storage(&result);
+        vTaskDelete(NULL);
+    }
+    result.write_max_ms = write_max_ms;
+    result.read_max_ms = read_max_ms;
+    result.write_kbps = Self_Test_Rate(bytes, write_us);
+    result.read_kbps = Self_Test_Rate(bytes, read_us);
+    telemetry_set_storage(&result);
+    ESP_LOGI(TAG, "%u-bit %lu kHz%s: write %lu KB/s (slowest block %u ms), read %lu KB/s (%u ms)",
+             result.bus_width, (unsigned long)result.freq_khz, contiguous ? "" : ", fragmented",
+             (unsigned long)result.write_kbps, result.write_max_ms,
+             (unsigned long)result.read_kbps, result.read_max_ms);
+    ESP_LOGI(TAG, "%s for FLAC, %s for recording",
+             result.read_kbps >= SD_SELF_TEST_FLAC_KBPS ? "Fast enough" : "Too slow",
+             result.write_kbps >= SD_SELF_TEST_RECORD_KBPS ? "fast enough" : "too slow");
+    vTaskDelete(NULL);
+}
+
+#endif
+
+void SD_Self_Test_Start(uint8_t bus_width, uint32_t freq_khz)
+{
+    result.bus_width = bus_width;
+    result.freq_khz = freq_khz > UINT16_MAX ? UINT16_MAX : (uint16_t)freq_khz;
+    telemetry_set_storage(&result);
+#if defined(CONFIG_SD_SELF_TEST)
+    xTaskCreate(Self_Test_Task, "SD Self Test", SD_SELF_TEST_STACK_SIZE, NULL, SD_SELF_TEST_PRIORITY, NULL);
+#endif
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "task_plan.h"
+
+/*
+ * Sequential throughput of the mounted SD card (CONFIG_SD_SELF_TEST).
+ *
+ * SD_SELF_TEST_DELAY_MS after boot a low-priority task writes a
+ * CONFIG_SD_SELF_TEST_KB file, preallocated in one contiguous run as the
+ * recorder's are, in SD_SELF_TEST_BLOCK writes from DMA-capable RAM, reads
+ * it back the same way and deletes it. The rates and the slowest block of
+ * each go to the log and to telemetry (telemetry_set_storage()) with the
+ * bus mode, checked against what FLAC playback and a recording need.
+ */
+
+#define SD_SELF_TEST_BLOCK          (32 * 1024)
+#define SD_SELF_TEST_DELAY_MS       5000        // Out of the way of the boot
+#define SD_SELF_TEST_PRIORITY       TASK_PLAN_BACKGROUND_PRIORITY
+#define SD_SELF_TEST_STACK_SIZE     3072
+#define SD_SELF_TEST_FLAC_KBPS      176         // 16-bit 44.1 kHz stereo PCM, more than its FLAC ever reads
+#define SD_SELF_TEST_RECORD_KBPS    64          // The microphone recorder's two-channel WAV
+
+// After the card is mounted; records the bus mode even when the test is off
+void SD_Self_Test_Start(uint8_t bus_width, uint32_t freq_khz);
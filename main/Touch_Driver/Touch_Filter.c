@@ -0,0 +1,69 @@
+#include "Touch_Filter.h"
+#include <math.h>
+#include "sdkconfig.h"
+
+#if CONFIG_TOUCH_FILTER
+#define TOUCH_FILTER_MIN_CUTOFF_HZ  (CONFIG_TOUCH_FILTER_MIN_CUTOFF_DHZ / 10.0f)
+#define TOUCH_FILTER_BETA           (CONFIG_TOUCH_FILTER_BETA_MILLI / 1000.0f)
+
+typedef struct {
+  float value;                   // Filtered position
+  float speed;                   // Filtered px/s
+  float reported;                // Last position handed on
+} touch_axis_t;
+
+typedef struct {
+  touch_axis_t x;
+  touch_axis_t y;
+} touch_track_t;
+
+static touch_track_t tracks[CONFIG_ESP_LCD_TOUCH_MAX_POINTS];
+static uint8_t track_count;
+static int64_t last_us;
+
+static float Filter_Alpha(float cutoff_hz, float dt)
+{
+  float tau = 1.0f / (2.0f * (float)M_PI * cutoff_hz);
+  return 1.0f / (1.0f + tau / dt);
+}
+
+static void Axis_Start(touch_axis_t *axis, uint16_t raw)
+{
+  axis->value = raw;
+  axis->speed = 0;
+  axis->reported = raw;
+}
+
+static uint16_t Axis_Feed(touch_axis_t *axis, uint16_t raw, float dt)
+{
+  float speed = (raw - axis->value) / dt;
+  axis->speed += Filter_Alpha(TOUCH_FILTER_DCUTOFF_HZ, dt) * (speed - axis->speed);
+  float cutoff = TOUCH_FILTER_MIN_CUTOFF_HZ + TOUCH_FILTER_BETA * fabsf(axis->speed);
+  axis->value += Filter_Alpha(cutoff, dt) * (raw - axis->value);
+  if (fabsf(axis->value - axis->reported) > CONFIG_TOUCH_FILTER_DEADBAND_PX) {
+    axis->reported = axis->value;
+  }
+  return (uint16_t)lroundf(axis->reported);
+}
+#endif
+
+void Touch_Filter_Apply(SPD2010_Touch *touch, int64_t time_us)
+{
+#if CONFIG_TOUCH_FILTER
+  uint8_t count = touch->touch_num < CONFIG_ESP_LCD_TOUCH_MAX_POINTS ? touch->touch_num : CONFIG_ESP_LCD_TOUCH_MAX_POINTS;
+  float dt = (time_us - last_us) / 1e6f;
+  last_us = time_us;
+  if (count != track_count || dt <= 0) {
+    for (int i = 0; i < count; i++) {
+      Axis_Start(&tracks[i].x, touch->rpt[i].x);
+      Axis_Start(&tracks[i].y, touch->rpt[i].y);
+    }
+    track_count = count;
+    return;
+  }
+  for (int i = 0; i < count; i++) {
+    touch->rpt[i].x = Axis_Feed(&tracks[i].x, touch->rpt[i].x, dt);
+    touch->rpt[i].y = Axis_Feed(&tracks[i].y, touch->rpt[i].y, dt);
+  }
+#endif
+}
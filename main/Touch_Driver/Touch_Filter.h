@@ -0,0 +1,24 @@
+#pragma once
+#include <stdint.h>
+#include "Touch_SPD2010.h"
+
+/*
+ * Jitter filter between the controller and LVGL (CONFIG_TOUCH_FILTER).
+ *
+ * Each point goes through a One-Euro filter: a low-pass whose cutoff rises
+ * with the point's speed, so a resting finger is smoothed hard while a drag
+ * follows closely. A deadband then holds the reported position until the
+ * filtered one has moved more than CONFIG_TOUCH_FILTER_DEADBAND_PX, so a
+ * finger held still reports exactly the same point and LVGL sees no motion:
+ * no value changes, no redraws. Once outside the deadband the filtered
+ * position is reported as it is, not in steps.
+ *
+ * Points are filtered by their slot in the report; a change in the number
+ * of fingers restarts every slot. Gestures are fed the raw points.
+ *
+ * Touch task only.
+ */
+
+#define TOUCH_FILTER_DCUTOFF_HZ     (1.0f)    // Cutoff of the speed estimate
+
+void Touch_Filter_Apply(SPD2010_Touch *touch, int64_t time_us);
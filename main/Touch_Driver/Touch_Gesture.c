@@ -0,0 +1,173 @@
+#include "Touch_Gesture.h"
+#include <math.h>
+#include <stdlib.h>
+
+typedef enum {
+  GESTURE_IDLE,
+  GESTURE_ONE_FINGER,            // Swipe candidate
+  GESTURE_TWO_FINGERS,           // Not locked yet
+  GESTURE_ROTATING,
+  GESTURE_PINCHING,
+  GESTURE_DONE,                  // Multi-finger contact; waits for all fingers to lift
+} gesture_mode_t;
+
+static touch_gesture_cb_t gesture_cb = NULL;
+
+static gesture_mode_t mode = GESTURE_IDLE;
+static int16_t start_x, start_y, last_x, last_y;
+static int64_t start_us, last_us;
+static float velocity_x, velocity_y;
+static float start_angle, start_dist;   // Two-finger contact at touch down
+static float ref_angle, ref_dist;       // ... at the last event
+
+void Touch_Gesture_Set_Callback(touch_gesture_cb_t callback)
+{
+  gesture_cb = callback;
+}
+
+static void Gesture_Emit(const touch_gesture_t *gesture)
+{
+  touch_gesture_cb_t cb = gesture_cb;
+  if (cb) {
+    cb(gesture);
+  }
+}
+
+// The line through two fingers has no direction and the controller may swap
+// their order between reports, so angles are compared modulo 180 degrees
+static float Angle_Diff(float a, float b)
+{
+  float d = fmodf(a - b + 90.0f, 180.0f);
+  if (d < 0) {
+    d += 180.0f;
+  }
+  return d - 90.0f;
+}
+
+static void Gesture_Check_Swipe(void)
+{
+  int dx = last_x - start_x;
+  int dy = last_y - start_y;
+  int64_t duration_us = last_us - start_us;
+  int length = abs(dx) > abs(dy) ? abs(dx) : abs(dy);
+  if (length < TOUCH_GESTURE_SWIPE_MIN_PX || duration_us <= 0 ||
+      duration_us > TOUCH_GESTURE_SWIPE_MAX_MS * 1000LL ||
+      length * 1000000LL / duration_us < TOUCH_GESTURE_SWIPE_MIN_SPEED) {
+    return;
+  }
+
+  touch_gesture_t gesture = {
+    .type = TOUCH_GESTURE_SWIPE,
+    .velocity_x = (int16_t)velocity_x,
+    .velocity_y = (int16_t)velocity_y,
+  };
+  if (abs(dx) > abs(dy)) {
+    gesture.direction = dx > 0 ? TOUCH_SWIPE_RIGHT : TOUCH_SWIPE_LEFT;
+  } else {
+    gesture.direction = dy > 0 ? TOUCH_SWIPE_DOWN : TOUCH_SWIPE_UP;
+  }
+  Gesture_Emit(&gesture);
+}
+
+static void Gesture_Feed_One(const tp_report_t *pt, int64_t time_us)
+{
+  if (mode == GESTURE_IDLE) {
+    mode = GESTURE_ONE_FINGER;
+    start_x = last_x = pt->x;
+    start_y = last_y = pt->y;
+    start_us = last_us = time_us;
+    velocity_x = velocity_y = 0;
+    return;
+  }
+  if (mode != GESTURE_ONE_FINGER) {
+    return;                      // One finger of a pinch/rotate lifted first
+  }
+
+  int64_t dt_us = time_us - last_us;
+  if (dt_us > 0) {
+    // Smoothed over the last few reports, so the release speed is what counts
+    velocity_x = 0.5f * velocity_x + 0.5f * (pt->x - last_x) * 1e6f / dt_us;
+    velocity_y = 0.5f * velocity_y + 0.5f * (pt->y - last_y) * 1e6f / dt_us;
+  }
+  last_x = pt->x;
+  last_y = pt->y;
+  last_us = time_us;
+}
+
+static void Gesture_Feed_Two(const tp_report_t *a, const tp_report_t *b)
+{
+  float dx = (float)b->x - a->x;
+  float dy = (float)b->y - a->y;
+  float dist = sqrtf(dx * dx + dy * dy);
+  float angle = atan2f(dy, dx) * (180.0f / (float)M_PI);
+  if (dist < 1.0f) {
+    return;
+  }
+
+  touch_gesture_t gesture = {0};
+  switch (mode) {
+  case GESTURE_IDLE:
+  case GESTURE_ONE_FINGER:
+    mode = GESTURE_TWO_FINGERS;
+    start_angle = ref_angle = angle;
+    start_dist = ref_dist = dist;
+    return;
+  case GESTURE_TWO_FINGERS: {
+    float turned = Angle_Diff(angle, start_angle);
+    float ratio = dist / start_dist;
+    if (fabsf(turned) >= TOUCH_GESTURE_ROTATE_START_DEG) {
+      mode = GESTURE_ROTATING;
+      gesture.type = TOUCH_GESTURE_ROTATE;
+      gesture.value = turned;
+      ref_angle = angle;
+    } else if (ratio >= TOUCH_GESTURE_PINCH_START || ratio <= 1.0f / TOUCH_GESTURE_PINCH_START) {
+      mode = GESTURE_PINCHING;
+      gesture.type = TOUCH_GESTURE_PINCH;
+      gesture.value = ratio;
+      ref_dist = dist;
+    } else {
+      return;
+    }
+    break;
+  }
+  case GESTURE_ROTATING: {
+    float turned = Angle_Diff(angle, ref_angle);
+    if (fabsf(turned) < TOUCH_GESTURE_ROTATE_STEP_DEG) {
+      return;
+    }
+    gesture.type = TOUCH_GESTURE_ROTATE;
+    gesture.value = turned;
+    ref_angle = angle;
+    break;
+  }
+  case GESTURE_PINCHING: {
+    float ratio = dist / ref_dist;
+    if (ratio < TOUCH_GESTURE_PINCH_STEP && ratio > 1.0f / TOUCH_GESTURE_PINCH_STEP) {
+      return;
+    }
+    gesture.type = TOUCH_GESTURE_PINCH;
+    gesture.value = ratio;
+    ref_dist = dist;
+    break;
+  }
+  default:
+    return;
+  }
+  Gesture_Emit(&gesture);
+}
+
+void Touch_Gesture_Feed(const SPD2010_Touch *touch, int64_t time_us)
+{
+  if (touch->touch_num == 0) {
+    if (mode == GESTURE_ONE_FINGER) {
+      Gesture_Check_Swipe();
+    }
+    mode = GESTURE_IDLE;
+  } else if (touch->touch_num == 1) {
+    Gesture_Feed_One(&touch->rpt[0], time_us);
+  } else if (touch->touch_num == 2) {
+    Gesture_Feed_Two(&touch->rpt[0], &touch->rpt[1]);
+  } else {
+    mode = GESTURE_DONE;         // Three or more fingers: not a gesture we know
+  }
+}
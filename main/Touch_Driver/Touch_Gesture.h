@@ -0,0 +1,51 @@
+#pragma once
+#include <stdint.h>
+#include "Touch_SPD2010.h"
+
+/*
+ * Gesture recognizer fed by the touch task with every controller sample, so
+ * it sees the full report rate rather than LVGL's 30 ms pointer reads.
+ *   - two fingers turning   TOUCH_GESTURE_ROTATE, value = degrees since the
+ *                           last event (positive clockwise)
+ *   - two fingers spreading TOUCH_GESTURE_PINCH, value = distance ratio since
+ *                           the last event (> 1 spreading)
+ *   - one quick stroke      TOUCH_GESTURE_SWIPE on release, with its direction
+ *                           and release velocity in px/s
+ * A two-finger contact locks into rotate or pinch, whichever crosses its
+ * threshold first, until the fingers lift.
+ */
+
+#define TOUCH_GESTURE_ROTATE_START_DEG      (10.0f)   // Turn needed to lock into rotate
+#define TOUCH_GESTURE_ROTATE_STEP_DEG       (3.0f)    // Smallest rotate event
+#define TOUCH_GESTURE_PINCH_START           (1.15f)   // Distance ratio needed to lock into pinch
+#define TOUCH_GESTURE_PINCH_STEP            (1.03f)   // Smallest pinch event
+#define TOUCH_GESTURE_SWIPE_MIN_PX          (60)      // Shortest stroke that counts as a swipe
+#define TOUCH_GESTURE_SWIPE_MAX_MS          (600)     // Longest one
+#define TOUCH_GESTURE_SWIPE_MIN_SPEED       (300)     // Slowest release, px/s
+
+typedef enum {
+  TOUCH_GESTURE_ROTATE,
+  TOUCH_GESTURE_PINCH,
+  TOUCH_GESTURE_SWIPE,
+} touch_gesture_type_t;
+
+typedef enum {
+  TOUCH_SWIPE_LEFT,
+  TOUCH_SWIPE_RIGHT,
+  TOUCH_SWIPE_UP,
+  TOUCH_SWIPE_DOWN,
+} touch_swipe_dir_t;
+
+typedef struct {
+  touch_gesture_type_t type;
+  float value;                   // Rotate: degrees, pinch: ratio, swipe: unused
+  touch_swipe_dir_t direction;   // Swipe only
+  int16_t velocity_x;            // Swipe only, px/s
+  int16_t velocity_y;
+} touch_gesture_t;
+
+// Runs on the touch task: keep it short and hand the event to another thread
+typedef void (*touch_gesture_cb_t)(const touch_gesture_t *gesture);
+
+void Touch_Gesture_Set_Callback(touch_gesture_cb_t callback);
+void Touch_Gesture_Feed(const SPD2010_Touch *touch, int64_t time_us);   // Touch task only
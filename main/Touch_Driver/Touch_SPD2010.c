@@ -1,31 +1,184 @@
 #include "Touch_SPD2010.h"
+#include "Touch_Gesture.h"
+#include "Touch_Filter.h"
+#include "LVGL_Idle.h"
+#include "LVGL_Latency.h"
+#include <stdatomic.h>
+#include "telemetry_trace.h"
+
+static const char *TAG_TOUCH = "Touch";
 
 SPD2010_Touch touch_data = {0};
-uint8_t Touch_interrupts=0;
+
+typedef struct {
+  uint16_t x[CONFIG_ESP_LCD_TOUCH_MAX_POINTS];
+  uint16_t y[CONFIG_ESP_LCD_TOUCH_MAX_POINTS];
+  uint16_t weight[CONFIG_ESP_LCD_TOUCH_MAX_POINTS];
+  uint8_t touch_num;
+} touch_sample_t;
+
+// Latest sample, written only by the touch task. The sequence is odd while a
+// write is in progress; readers retry until they see the same even value
+// before and after their copy.
+static touch_sample_t touch_sample;
+static atomic_uint touch_sample_seq;
+static TaskHandle_t touch_task_handle = NULL;
+static atomic_bool touch_flip;
+
+#if CONFIG_LVGL_LATENCY_PROBE || CONFIG_ESPCASTER_SOAK
+static portMUX_TYPE inject_lock = portMUX_INITIALIZER_UNLOCKED;
+static SPD2010_Touch inject_touch;          // Under inject_lock
+static bool inject_active;
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 esp_err_t I2C_Read_Touch(uint8_t Driver_addr, uint16_t Reg_addr, uint8_t *Reg_data, uint32_t Length)
 {
-  uint8_t buf_Addr[2];
-  buf_Addr[0] = (uint8_t)(Reg_addr >> 8);
-  buf_Addr[1] = (uint8_t)Reg_addr;
-  return i2c_master_write_read_device(I2C_MASTER_NUM, Driver_addr, buf_Addr, 2, Reg_data, Length, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
+  return I2C_Read16(Driver_addr, Reg_addr, Reg_data, Length);
 }
 esp_err_t I2C_Write_Touch(uint8_t Driver_addr, uint16_t Reg_addr, uint8_t *Reg_data, uint32_t Length)
 {
-  uint8_t buf[Length+2];
-  buf[0] = (uint8_t)(Reg_addr >> 8);
-  buf[1] = (uint8_t)Reg_addr;
-  // Copy Reg_data to buf starting at buf[1]
-  memcpy(&buf[2], Reg_data, Length);
-  return i2c_master_write_to_device(I2C_MASTER_NUM, Driver_addr, buf, Length+2, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
-  }
+  return I2C_Write16(Driver_addr, Reg_addr, Reg_data, Length);
+}
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static void IRAM_ATTR Touch_ISR_Handler(void *arg)
+{
+  LVGL_Latency_Mark(LVGL_LATENCY_TOUCH_INT);
+  BaseType_t task_woken = pdFALSE;
+  vTaskNotifyGiveFromISR(touch_task_handle, &task_woken);
+  if (task_woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+static void Touch_Publish(const SPD2010_Touch *touch)
+{
+  unsigned seq = atomic_load_explicit(&touch_sample_seq, memory_order_relaxed);
+  atomic_store_explicit(&touch_sample_seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  touch_sample.touch_num = touch->touch_num;
+  for (int i = 0; i < touch->touch_num; i++) {
+    touch_sample.x[i] = touch->rpt[i].x;
+    touch_sample.y[i] = touch->rpt[i].y;
+    touch_sample.weight[i] = touch->rpt[i].weight;
+  }
+  atomic_store_explicit(&touch_sample_seq, seq + 2, memory_order_release);
+}
+
+void Touch_Set_Flip(bool flip)
+{
+  atomic_store(&touch_flip, flip);
+}
+
+// Panel coordinates to the picture's, which is turned by 180 degrees when flipped
+static void Touch_Orient(SPD2010_Touch *touch)
+{
+  if (!atomic_load(&touch_flip)) {
+    return;
+  }
+  for (int i = 0; i < touch->touch_num; i++) {
+    uint16_t x = touch->rpt[i].x < EXAMPLE_LCD_WIDTH ? touch->rpt[i].x : EXAMPLE_LCD_WIDTH - 1;
+    uint16_t y = touch->rpt[i].y < EXAMPLE_LCD_HEIGHT ? touch->rpt[i].y : EXAMPLE_LCD_HEIGHT - 1;
+    touch->rpt[i].x = EXAMPLE_LCD_WIDTH - 1 - x;
+    touch->rpt[i].y = EXAMPLE_LCD_HEIGHT - 1 - y;
+  }
+}
+
+#if CONFIG_LVGL_LATENCY_PROBE || CONFIG_ESPCASTER_SOAK
+void Touch_Inject(bool pressed, uint16_t x, uint16_t y)
+{
+  portENTER_CRITICAL(&inject_lock);
+  inject_active = true;
+  inject_touch.touch_num = pressed ? 1 : 0;
+  inject_touch.rpt[0].x = x;
+  inject_touch.rpt[0].y = y;
+  inject_touch.rpt[0].weight = 1;
+  portEXIT_CRITICAL(&inject_lock);
+  if (pressed) {
+    LVGL_Latency_Mark(LVGL_LATENCY_TOUCH_INT);      // As the edge would be
+  }
+  xTaskNotifyGive(touch_task_handle);
+}
+
+// An injected sample in place of the controller's; a release is given once
+static bool Touch_Take_Injected(SPD2010_Touch *touch)
+{
+  portENTER_CRITICAL(&inject_lock);
+  bool active = inject_active;
+  if (active) {
+    touch->touch_num = inject_touch.touch_num;
+    touch->rpt[0] = inject_touch.rpt[0];
+    inject_active = inject_touch.touch_num > 0;
+  }
+  portEXIT_CRITICAL(&inject_lock);
+  return active;
+}
+#else
+static bool Touch_Take_Injected(SPD2010_Touch *touch)
+{
+  return false;
+}
+#endif
+
+static void Touch_Task(void *arg)
+{
+  int startup_reads = TOUCH_STARTUP_READS;
+  while (1) {
+    if (!Touch_Take_Injected(&touch_data)) {
+      Touch_Read_Data();
+      Touch_Orient(&touch_data);                      // Injected points are in the picture's coordinates already
+    }
+    int64_t now_us = esp_timer_get_time();
+    Touch_Gesture_Feed(&touch_data, now_us);          // Raw, so swipe speeds are not smoothed away
+    Touch_Filter_Apply(&touch_data, now_us);
+    Touch_Publish(&touch_data);
+    if (touch_data.touch_num > 0) {
+      LVGL_Latency_Mark(LVGL_LATENCY_TOUCH_READ);
+    } else {
+      LVGL_Latency_Cancel();
+    }
+    if (touch_data.touch_num > 0) {
+      LVGL_Idle_Wake();                               // The indev read timer is held while the GUI sleeps
+    }
+
+    TickType_t wait = portMAX_DELAY;
+    if (touch_data.touch_num > 0 || startup_reads > 0) {
+      wait = pdMS_TO_TICKS(TOUCH_POLL_MS);
+    }
+    if (startup_reads > 0) {
+      startup_reads--;
+    }
+    ulTaskNotifyTake(pdTRUE, wait);
+  }
+}
+
+static void Touch_INT_Init(void)
+{
+  if (xTaskCreatePinnedToCore(Touch_Task, "Touch", TOUCH_TASK_STACK_SIZE, NULL, TOUCH_TASK_PRIORITY, &touch_task_handle, TOUCH_TASK_CORE) != pdPASS) {
+    ESP_LOGE(TAG_TOUCH, "Failed to create touch task");
+    return;
+  }
+  const gpio_config_t int_gpio_config = {
+    .pin_bit_mask = 1ULL << EXAMPLE_PIN_NUM_TOUCH_INT,
+    .mode = GPIO_MODE_INPUT,
+    .pull_up_en = GPIO_PULLUP_ENABLE,
+    .intr_type = GPIO_INTR_NEGEDGE,                       // INT is active low
+  };
+  ESP_ERROR_CHECK(gpio_config(&int_gpio_config));
+  esp_err_t ret = gpio_install_isr_service(0);
+  if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {     // Already installed is fine
+    ESP_LOGE(TAG_TOUCH, "Failed to install GPIO ISR service: %s", esp_err_to_name(ret));
+    return;
+  }
+  gpio_isr_handler_add(EXAMPLE_PIN_NUM_TOUCH_INT, Touch_ISR_Handler, NULL);
+}
+
 uint8_t Touch_Init(void) {
   SPD2010_Touch_Reset();
   SPD2010_Read_cfg();
+  Touch_INT_Init();
   return true;
 }
 /* Reset controller */
@@ -47,7 +200,9 @@ uint16_t SPD2010_Read_cfg(void) {
 void Touch_Read_Data(void) {
   uint8_t touch_cnt = 0;
   SPD2010_Touch touch = {0};
+  TELEMETRY_TRACE_BEGIN(TELEMETRY_TRACE_TOUCH_READ);
   tp_read_data(&touch);
+  TELEMETRY_TRACE_END(TELEMETRY_TRACE_TOUCH_READ);
   
   /* Expect Number of touched points */
   touch_cnt = (touch.touch_num > CONFIG_ESP_LCD_TOUCH_MAX_POINTS ? CONFIG_ESP_LCD_TOUCH_MAX_POINTS : touch.touch_num);
@@ -60,20 +215,24 @@ void Touch_Read_Data(void) {
   }
 }
 bool Touch_Get_xy(uint16_t *x, uint16_t *y, uint16_t *strength, uint8_t *point_num, uint8_t max_point_num){
-  /* Read data from touch controller */
-  Touch_Read_Data();
-  /* Count of points */
-  *point_num = (touch_data.touch_num > max_point_num ? max_point_num : touch_data.touch_num);
-  for (size_t i = 0; i < *point_num; i++) {
-    x[i] = touch_data.rpt[i].x;
-    y[i] = touch_data.rpt[i].y;
-    if (strength) {
-      strength[i] = touch_data.rpt[i].weight;
+  unsigned seq;
+  do {
+    seq = atomic_load_explicit(&touch_sample_seq, memory_order_acquire);
+    if (seq & 1) {
+      continue;                                           // Touch task is mid-write
     }
-  }
-  /* Clear available touch points count */
-  touch_data.touch_num = 0;
-  return (*point_num > 0);;
+    /* Count of points */
+    *point_num = (touch_sample.touch_num > max_point_num ? max_point_num : touch_sample.touch_num);
+    for (size_t i = 0; i < *point_num; i++) {
+      x[i] = touch_sample.x[i];
+      y[i] = touch_sample.y[i];
+      if (strength) {
+        strength[i] = touch_sample.weight[i];
+      }
+    }
+    atomic_thread_fence(memory_order_acquire);
+  } while ((seq & 1) || atomic_load_explicit(&touch_sample_seq, memory_order_relaxed) != seq);
+  return (*point_num > 0);
 }
 
 
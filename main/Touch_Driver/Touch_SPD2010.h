@@ -2,6 +2,7 @@
 #include "Display_SPD2010.h"
 #include "I2C_Driver.h"
 #include "TCA9554PWR.h"
+#include "task_plan.h"
 
 #define SPD2010_ADDR                    (0x53)
 #define EXAMPLE_PIN_NUM_TOUCH_INT       (4)
@@ -9,6 +10,16 @@
 
 
 #define CONFIG_ESP_LCD_TOUCH_MAX_POINTS     (5)     
+
+// The touch task reads the controller only after an INT edge. While a finger
+// is down (and for a few reads after reset, until the controller has started)
+// it also re-reads every TOUCH_POLL_MS, so a missed edge can't leave a stale
+// press behind.
+#define TOUCH_TASK_PRIORITY             TASK_PLAN_TOUCH_PRIORITY
+#define TOUCH_TASK_CORE                 TASK_PLAN_TOUCH_CORE
+#define TOUCH_TASK_STACK_SIZE           (3 * 1024)
+#define TOUCH_POLL_MS                   (20)
+#define TOUCH_STARTUP_READS             (10)
 /****************HYN_REG_MUT_DEBUG_INFO_MODE address start***********/
 #define SPD2010_REG_Status         (NULL)
 
@@ -74,7 +85,12 @@ void Touch_Loop(void);
 uint8_t SPD2010_Touch_Reset(void);
 uint16_t SPD2010_Read_cfg(void); 
 void Touch_Read_Data(void);
+// Latest sample published by the touch task; no I2C traffic, safe from any task
 bool Touch_Get_xy(uint16_t *x, uint16_t *y, uint16_t *strength, uint8_t *point_num, uint8_t max_point_num);
+void Touch_Set_Flip(bool flip);                   // Map points for a picture turned by 180 degrees (LVGL_Orientation)
+// Bench (CONFIG_LVGL_LATENCY_PROBE) and soak test: one point in LVGL's coordinates stands in for the controller's
+// until released, published by the touch task as a read would be
+void Touch_Inject(bool pressed, uint16_t x, uint16_t y);
 
 //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
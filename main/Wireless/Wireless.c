@@ -65,6 +65,7 @@ uint16_t WIFI_Scan(void)
 }
 
 
+#if CONFIG_BT_BLUEDROID_ENABLED
 #define GATTC_TAG "GATTC_TAG"
 #define SCAN_DURATION 5  
 #define MAX_DISCOVERED_DEVICES 100 
@@ -216,4 +217,5 @@ uint16_t BLE_Scan(void)
     if(WiFi_Scan_Finish == 1)
         Scan_finish = 1;
     return BLE_NUM;
-}
\ No newline at end of file
+}
+#endif
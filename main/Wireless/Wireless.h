@@ -1,5 +1,6 @@
 #pragma once
 
+#include "sdkconfig.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "esp_wifi.h"
@@ -9,9 +10,11 @@
 #include <stdio.h>
 #include <string.h>  // For memcpy
 #include "esp_system.h"
+#if CONFIG_BT_BLUEDROID_ENABLED
 #include "esp_bt.h"
 #include "esp_gap_ble_api.h"
 #include "esp_bt_main.h"
+#endif
 
 
 
@@ -22,5 +25,7 @@ extern bool Scan_finish;
 void Wireless_Init(void);
 void WIFI_Init(void *arg);
 uint16_t WIFI_Scan(void);
+#if CONFIG_BT_BLUEDROID_ENABLED     // The BLE scan is Bluedroid's; BLE control uses NimBLE
 void BLE_Init(void *arg);
-uint16_t BLE_Scan(void);
\ No newline at end of file
+uint16_t BLE_Scan(void);
+#endif
\ No newline at end of file
@@ -1,16 +1,71 @@
 #include "Display_SPD2010.h"
 #include "PCF85063.h"
 #include "QMI8658.h"
+#include "QMI8658_FIFO.h"
+#include "QMI8658_Fusion.h"
 #include "SD_MMC.h"
 #include "Wireless.h"
 #include "TCA9554PWR.h"
 #include "LVGL_Example.h"
 #include "BAT_Driver.h"
 #include "PWR_Key.h"
+#include "Power_Manager.h"
+#include "LVGL_Orientation.h"
+#include "LVGL_Idle.h"
+#include "LVGL_Batch.h"
+#include "LVGL_Latency.h"
 #include "PCM5101.h"
 #include "MIC_Speech.h"
+#include "MP3_Benchmark.h"
+#include "ESPCaster_Bench.h"
+#include "OTA_Update.h"
+#include "Asset_Pack.h"
+
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_timer.h"
 
 #include "esp_cast.h"
+#include "config_store.h"
+#include "deferred_log.h"
+#include "gui_event_bus.h"
+#include "telemetry.h"
+#include "mem_tag.h"
+#include "mem_task.h"
+#include "task_plan.h"
+#include "telemetry_trace.h"
+#include "time_service.h"
+#include "traffic_capture.h"
+#include "voice_actions.h"
+
+// LVGL task: below audio playback on its core, so drawing never makes a frame late
+#define LVGL_TASK_STACK_SIZE        (8 * 1024)
+#define LVGL_TASK_PRIORITY          TASK_PLAN_LVGL_PRIORITY
+#define LVGL_TASK_CORE              TASK_PLAN_LVGL_CORE
+#define LVGL_TASK_MAX_SLEEP_MS      500     // lv_timer_handler() reports no timer
+// Cast housekeeping (Spotify periodic requests); its network work runs elsewhere
+#define CAST_TASK_STACK_SIZE        4096
+#define CAST_TASK_PRIORITY          TASK_PLAN_CAST_LOOP_PRIORITY
+#define CAST_TASK_PERIOD_MS         100
+// Driver task: sleeps until the next sensor job is due or the power key
+// interrupt wakes it
+#define DRIVER_BAT_PERIOD_MS        30000
+#define DRIVER_RTC_PERIOD_MS        60000   // datetime; read PCF85063 directly for seconds
+#define DRIVER_IMU_PERIOD_MS        100     // Polled IMU only; the FIFO mode has its own task
+#define DRIVER_KEY_POLL_MS          100     // PWR_Loop long-press timing while the key is held
+// Boot: a dependency graph rather than one chain. app_main brings up power,
+// then the panel with a splash; meanwhile the network task (Wi-Fi, mDNS
+// discovery, then Spotify) runs on core 1 and the driver task mounts the
+// flash FAT and starts the sensors on core 0. The GUI is built once the
+// phases it reads from are done. Each phase is timed into telemetry.
+#define BOOT_READY_STORAGE          BIT0    // Fonts on the flash FAT
+#define BOOT_READY_NETWORK          BIT1    // Wi-Fi manager and the discovery handle
+#define BOOT_READY_SPOTIFY          BIT2    // Controller created, or none configured
+#define BOOT_READY_SENSORS          BIT3
+#define BOOT_READY_CLOCK            BIT4    // System time from the RTC, before anything loads expiries
+#define BOOT_NETWORK_TASK_STACK     8192    // Spotify init ran on the 8 KB main task before
+#define BOOT_NETWORK_TASK_PRIORITY  3
+#define BOOT_NETWORK_TASK_CORE      TASK_PLAN_LVGL_CORE     // Idle until the GUI is built
 
 // Uncomment to enable Spotify integration testing
 // #define ENABLE_SPOTIFY_TESTS
@@ -19,52 +74,330 @@
 extern void start_spotify_integration_tests(void);
 #endif
 
+static EventGroupHandle_t boot_events;
+
+// The PCF85063 keeps UTC
+static const time_service_rtc_t rtc_clock = {
+    .read = PCF85063_Read_UTC,
+    .write = PCF85063_Set_UTC,
+};
+
+typedef struct {
+    void (*run)(void);
+    uint32_t period_ms;
+    int64_t due_us;
+} driver_job_t;
+
+static void Driver_Read_Battery(void)
+{
+    BAT_Get_Volts();
+}
+// Whole-percent changes only, so the GUI redraws at most once per percent
+static void Battery_Changed(const bat_status_t *status)
+{
+    gui_event_t event = {
+        .type = GUI_EVENT_BATTERY,
+        .data.battery = { .percent = status->percent, .minutes_left = status->minutes_left },
+    };
+    gui_event_bus_post(&event);
+}
+
+static driver_job_t driver_jobs[] = {
+    { Driver_Read_Battery, DRIVER_BAT_PERIOD_MS, 0 },
+    { PCF85063_Loop, DRIVER_RTC_PERIOD_MS, 0 },
+#if !CONFIG_QMI8658_FIFO_MODE
+    { QMI8658_Loop, DRIVER_IMU_PERIOD_MS, 0 },
+#endif
+};
+
+#if CONFIG_QMI8658_FIFO_MODE
+static void IMU_Wake_Call(void *arg)
+{
+    lv_disp_trig_activity(NULL);    // Restarts LVGL's inactivity timer, which is what screen-off logic watches
+}
+// Tap or pick-up, on the IMU task
+static void IMU_Wake_Callback(qmi8658_wake_reason_t reason)
+{
+    gui_event_bus_post_call(IMU_Wake_Call, NULL);
+}
+#endif
+#if CONFIG_QMI8658_FUSION
+static void IMU_Face_Call(void *arg)
+{
+    qmi8658_face_t face = (qmi8658_face_t)(intptr_t)arg;
+    if (face != QMI8658_FACE_FLAT) {            // Lying flat keeps the current way
+        LVGL_Orientation_Set(face == QMI8658_FACE_UPSIDE_DOWN);
+    }
+}
+// Fusion motion events, on the IMU task
+static void IMU_Motion_Callback(qmi8658_motion_event_t event, int value)
+{
+    switch (event) {
+    case QMI8658_MOTION_ORIENTATION:
+        gui_event_bus_post_call(IMU_Face_Call, (void *)(intptr_t)value);
+        break;
+    case QMI8658_MOTION_PICKUP:
+        gui_event_bus_post_call(IMU_Wake_Call, NULL);
+        break;
+#if CONFIG_QMI8658_MOTION_GESTURES
+    case QMI8658_MOTION_TILT_RIGHT:
+        voice_actions_post(VOICE_ACTION_VOLUME_UP);
+        break;
+    case QMI8658_MOTION_TILT_LEFT:
+        voice_actions_post(VOICE_ACTION_VOLUME_DOWN);
+        break;
+    case QMI8658_MOTION_SHAKE:
+        voice_actions_post(VOICE_ACTION_NEXT);
+        break;
+#endif
+    default:
+        break;
+    }
+}
+#endif
+// Flash and sensor bring-up, then the sensor jobs; runs beside the display bring-up
 void Driver_Loop(void *parameter)
 {
-    // Wireless_Init();
-    esp_cast_wifi_init_sta();
+    int64_t start_us = esp_timer_get_time();
+    Flash_Searching();
+    Flash_FAT_Mount();              // Fonts and other files, before the GUI looks for them
+#if CONFIG_TRAFFIC_CAPTURE
+    SD_Init();                      // The capture goes to the card, from the first connection on
+    traffic_capture_start(CONFIG_TRAFFIC_CAPTURE_PATH);
+#endif
+    int64_t storage_us = esp_timer_get_time();
+    telemetry_boot_phase(TELEMETRY_BOOT_STORAGE, start_us, storage_us);
+    xEventGroupSetBits(boot_events, BOOT_READY_STORAGE);
+
+    QMI8658_Init();
+#if CONFIG_QMI8658_FIFO_MODE
+    QMI8658_Set_Wake_Callback(IMU_Wake_Callback);
+#endif
+#if CONFIG_QMI8658_FUSION
+    QMI8658_Fusion_Set_Callback(IMU_Motion_Callback);
+#endif
+    telemetry_boot_phase(TELEMETRY_BOOT_SENSORS, storage_us, esp_timer_get_time());
+    xEventGroupSetBits(boot_events, BOOT_READY_SENSORS);
+
+    PWR_Key_Set_Notify_Task(xTaskGetCurrentTaskHandle());
     while(1)
     {
-        QMI8658_Loop();
-        PCF85063_Loop();
-        BAT_Get_Volts();
+        int64_t now_us = esp_timer_get_time();
+        int64_t next_us = now_us + (int64_t)DRIVER_RTC_PERIOD_MS * 1000;
+        for (size_t i = 0; i < sizeof(driver_jobs) / sizeof(driver_jobs[0]); i++) {
+            driver_job_t *job = &driver_jobs[i];
+            if (now_us >= job->due_us) {
+                job->run();
+                job->due_us = now_us + (int64_t)job->period_ms * 1000;
+            }
+            if (job->due_us < next_us) {
+                next_us = job->due_us;
+            }
+        }
+
+        // A key edge woke us, or the key is still held: keep timing the press
         PWR_Loop();
-        vTaskDelay(pdMS_TO_TICKS(100));
+        if (PWR_Key_Pressed()) {
+            int64_t key_us = now_us + DRIVER_KEY_POLL_MS * 1000;
+            if (key_us < next_us) {
+                next_us = key_us;
+            }
+        }
+
+        // Round up so the job is due when we wake
+        int64_t wait_us = next_us - esp_timer_get_time();
+        TickType_t wait = wait_us > 0 ? (TickType_t)((wait_us + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000)) : 0;
+        ulTaskNotifyTake(pdTRUE, wait);
+    }
+    mem_task_delete(NULL);
+}
+// Wi-Fi and mDNS, then Spotify, which reads its configuration from the NVS
+// the Wi-Fi manager opened; neither needs the panel, but the discovery
+// table's ages and the Spotify token expiry need the clock from the RTC
+static void Boot_Network_Task(void *parameter)
+{
+    xEventGroupWaitBits(boot_events, BOOT_READY_CLOCK, pdFALSE, pdTRUE, portMAX_DELAY);
+    int64_t start_us = esp_timer_get_time();
+    esp_cast_wifi_init_sta();
+    time_service_start_sntp();
+    int64_t network_us = esp_timer_get_time();
+    telemetry_boot_phase(TELEMETRY_BOOT_NETWORK, start_us, network_us);
+    xEventGroupSetBits(boot_events, BOOT_READY_NETWORK);
+
+    esp_cast_spotify_auto_init();
+    telemetry_boot_phase(TELEMETRY_BOOT_SPOTIFY, network_us, esp_timer_get_time());
+    xEventGroupSetBits(boot_events, BOOT_READY_SPOTIFY);
+    mem_task_delete(NULL);
+}
+// What the panel shows while the rest of boot runs: drawn from code in
+// flash, so it needs neither the FAT partition nor the fonts on it
+static lv_obj_t *Boot_Splash_Show(void)
+{
+    lv_obj_t *splash = lv_obj_create(lv_scr_act());
+    lv_obj_remove_style_all(splash);
+    lv_obj_set_size(splash, lv_pct(100), lv_pct(100));
+    lv_obj_set_style_bg_color(splash, lv_color_black(), 0);
+    lv_obj_set_style_bg_opa(splash, LV_OPA_COVER, 0);
+    lv_obj_t *label = lv_label_create(splash);
+    lv_label_set_text(label, "ESPCaster");
+    lv_obj_set_style_text_color(label, lv_color_white(), 0);
+    lv_obj_center(label);
+    lv_refr_now(NULL);
+    return splash;
+}
+static void Boot_Log_Phases(void)
+{
+    static const char *const names[TELEMETRY_BOOT_PHASE_COUNT] = {
+        "power", "display", "storage", "sensors", "network", "spotify", "gui", "interactive",
+    };
+    telemetry_boot_t phases[TELEMETRY_BOOT_PHASE_COUNT];
+    telemetry_get_boot(phases);
+    for (size_t i = 0; i < TELEMETRY_BOOT_PHASE_COUNT; i++) {
+        ESP_LOGI("BOOT", "%-11s at %4lu ms, %4lu ms", names[i],
+                 (unsigned long)phases[i].start_ms, (unsigned long)phases[i].duration_ms);
     }
-    vTaskDelete(NULL);
 }
+// Power rails, key, battery and the I2C bus the rest of the board hangs off
 void Driver_Init(void)
 {
+    int64_t start_us = esp_timer_get_time();
+    Power_Init();
     PWR_Init();
     BAT_Init();
+    BAT_Set_Callback(Battery_Changed);
     I2C_Init();
     EXIO_Init();                    // Example Initialize EXIO
-    Flash_Searching();
     PCF85063_Init();
-    QMI8658_Init();
-    xTaskCreatePinnedToCore(
+    time_service_init(&rtc_clock);
+    xEventGroupSetBits(boot_events, BOOT_READY_CLOCK);
+    telemetry_boot_phase(TELEMETRY_BOOT_POWER, start_us, esp_timer_get_time());
+
+    mem_task_create(
         Driver_Loop, 
         "Other Driver task",
         4096, 
         NULL, 
-        3, 
+        TASK_PLAN_DRIVER_PRIORITY, 
         NULL, 
-        0);
+        TASK_PLAN_DRIVER_CORE,
+        MEM_TASK_STACK_INTERNAL);
+}
+// Sleeps until the next LVGL timer is due; a post to the GUI event bus
+// wakes it early. Touch is polled by LVGL's indev timer, which bounds the
+// sleep to its read period. Each pass, the bus included, is timed against
+// the frame budget (telemetry_ui.h).
+void LVGL_Loop(void *parameter)
+{
+    bool interactive = false;
+    gui_event_bus_set_consumer(xTaskGetCurrentTaskHandle());
+    while(1)
+    {
+        Power_Hold(POWER_LOCK_RENDER, true);     // Render at full clock, drop to DFS min while asleep
+        bool timed = interactive;   // The first pass draws the whole GUI: boot time, not a stall
+        if (timed) {
+            telemetry_ui_pass_begin();
+        }
+        TELEMETRY_TRACE_BEGIN(TELEMETRY_TRACE_LVGL_TIMER);
+        uint32_t sleep_ms = lv_timer_handler();
+        TELEMETRY_TRACE_END(TELEMETRY_TRACE_LVGL_TIMER);
+        // The first pass draws the GUI: from here a touch is handled
+        if (!interactive) {
+            interactive = true;
+            telemetry_boot_phase(TELEMETRY_BOOT_INTERACTIVE, 0, esp_timer_get_time());
+            Boot_Log_Phases();
+        }
+        // Everything the controllers posted lands in one layout pass and one dirty area
+        LVGL_Batch_Begin();
+        bool handled = gui_event_bus_process();
+        LVGL_Batch_Commit();
+        if (timed) {
+            telemetry_ui_pass_end();
+        }
+        LVGL_Latency_Log();
+        if (handled) {
+            sleep_ms = 0;
+        }
+        Power_Hold(POWER_LOCK_RENDER, false);
+        // Static screen: hold every LVGL timer until woken, then run them at once
+        if (sleep_ms > 0 && LVGL_Idle_Sleep()) {
+            continue;
+        }
+        if (sleep_ms > LVGL_TASK_MAX_SLEEP_MS) {
+            sleep_ms = LVGL_TASK_MAX_SLEEP_MS;
+        }
+        // Round up: waking before the deadline would only spin on a 100 Hz tick
+        TickType_t ticks = (sleep_ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+        if (sleep_ms > 0) {
+            ulTaskNotifyTake(pdTRUE, ticks);
+        } else {
+            taskYIELD();
+        }
+    }
+    mem_task_delete(NULL);
+}
+void Cast_Loop(void *parameter)
+{
+    while(1)
+    {
+        esp_cast_loop();
+        vTaskDelay(pdMS_TO_TICKS(CAST_TASK_PERIOD_MS));
+    }
+    mem_task_delete(NULL);
 }
 void app_main(void)
 {
-    Driver_Init();
+    deferred_log_init();    // First: from here no log line waits on the console
+    telemetry_init();       // So every driver's counters are kept
+    mem_tag_install_cjson();    // cJSON in PSRAM and counted, before anything parses
+    gui_event_bus_init();   // Before the network task starts WiFi and discovery
+    config_store_init();    // NVS and the stored settings, before any task reads them
+    boot_events = xEventGroupCreate();
+    // Every task here keeps an internal stack: they all reach NVS or the flash FAT
+    mem_task_create(
+        Boot_Network_Task,
+        "Boot network",
+        BOOT_NETWORK_TASK_STACK,
+        NULL,
+        BOOT_NETWORK_TASK_PRIORITY,
+        NULL,
+        BOOT_NETWORK_TASK_CORE,
+        MEM_TASK_STACK_INTERNAL);
+    Driver_Init();          // Starts the driver task on the I2C bus it brings up
 
     // SD_Init();
+    int64_t display_us = esp_timer_get_time();
     LCD_Init();
     // Audio_Init();
     // MIC_Speech_init();
     // Play_Music("/sdcard","AAA.mp3");
     LVGL_Init();   // returns the screen object
+    Asset_Pack_Init();      // Maps flash only; images are read as they are drawn
+    lv_obj_t *splash = Boot_Splash_Show();
+    LCD_Display_On();       // Not before, so the panel never shows uninitialized RAM
+    telemetry_boot_phase(TELEMETRY_BOOT_DISPLAY, display_us, esp_timer_get_time());
+
+    // The GUI reads fonts from the FAT, the discovery handle and the Spotify controller
+    xEventGroupWaitBits(boot_events, BOOT_READY_STORAGE | BOOT_READY_NETWORK | BOOT_READY_SPOTIFY,
+                        pdFALSE, pdTRUE, portMAX_DELAY);
+    int64_t gui_us = esp_timer_get_time();
+    lv_obj_del(splash);
+#if CONFIG_ESPCASTER_BENCH
+    ESPCaster_Bench_Run();      // Owns LVGL and the panel until the LVGL task starts
+#endif
 
 // /********************* Demo *********************/
     // Lvgl_Example1();
+#if CONFIG_LVGL_RUN_BENCHMARK
+    // Compare CONFIG_LVGL_BUFFER_* strategies: FPS per scene, average at the end
+    lv_demo_benchmark();
+#else
     esp_cast_gui_init();
+#endif
+    Power_Start_Profiles(lv_disp_get_default());
+    LVGL_Orientation_Start(lv_disp_get_default());    // Reads Accel, which reads as level until the sensors are up
+    LVGL_Idle_Start(lv_disp_get_default());
+    telemetry_boot_phase(TELEMETRY_BOOT_GUI, gui_us, esp_timer_get_time());
+    OTA_Health_Start();     // Reaching here is half the check; Wi-Fi staying up is the rest
 
     // Test default WiFi functionality (uncomment to test)
     // esp_cast_test_default_wifi();
@@ -94,13 +427,29 @@ void app_main(void)
     // lv_demo_stress();
     // lv_demo_music();
 
-    while (1) {
-        // raise the task priority of LVGL and/or reduce the handler period can improve the performance
-        vTaskDelay(pdMS_TO_TICKS(10));
-        // The task running lv_timer_handler should have lower priority than that running `lv_tick_inc`
-        lv_timer_handler();
-        esp_cast_loop();
-    }
+    // From here on only LVGL_Loop may touch LVGL.
+    // lv_tick_inc runs in the esp_timer task, which is above both.
+    mem_task_create(
+        LVGL_Loop,
+        "LVGL task",
+        LVGL_TASK_STACK_SIZE,
+        NULL,
+        LVGL_TASK_PRIORITY,
+        NULL,
+        LVGL_TASK_CORE,
+        MEM_TASK_STACK_INTERNAL);
+    mem_task_create(
+        Cast_Loop,
+        "Cast task",
+        CAST_TASK_STACK_SIZE,
+        NULL,
+        CAST_TASK_PRIORITY,
+        NULL,
+        TASK_PLAN_BACKGROUND_CORE,
+        MEM_TASK_STACK_INTERNAL);
+#if CONFIG_MP3_RUN_BENCHMARK
+    MP3_Benchmark_Start();      // Alongside the GUI, as playback would run
+#endif
 }
 
 
@@ -0,0 +1,199 @@
+#!/usr/bin/env python3
+"""Pack UI images into an ESPCaster asset pack (see main/Assets/Asset_Pack.h).
+
+    asset_pack.py -o build/assets.bin main/Assets/ui/*.png
+
+Each image becomes an entry named after its file (without the extension) in
+the layout LVGL draws from, so the device maps it from flash and blits it
+without converting a pixel:
+
+    rgb565    opaque: LV_IMG_CF_TRUE_COLOR, 2 bytes a pixel
+    rgb565a   translucent: LV_IMG_CF_TRUE_COLOR_ALPHA, colour then alpha
+    alpha8    masks recoloured by the style: LV_IMG_CF_ALPHA_8BIT
+    indexed   up to 256 colours: LV_IMG_CF_INDEXED_1/2/4/8BIT with its palette
+
+The default picks rgb565 or rgb565a by whether the image has translucent
+pixels. RGB565 is stored byte swapped, as the panel takes it with
+LV_COLOR_16_SWAP; --no-swap for a build without it. An entry is run-length
+coded when that saves at least a quarter; the device expands it into PSRAM
+the first time it is asked for. SVG files are rasterised at their own size
+with cairosvg.
+
+Needs Pillow (pip install pillow).
+"""
+
+import argparse
+import io
+import os
+import struct
+import sys
+
+MAGIC = 0x53414345          # "ECAS"
+VERSION = 1
+FLAG_SWAP16 = 0x01
+ENCODING_RAW, ENCODING_RLE = 0, 1
+NAME_MAX = 24               # With the terminator
+ALIGN = 4
+
+# lv_img_cf_t values in LVGL 8.3
+CF_TRUE_COLOR = 4
+CF_TRUE_COLOR_ALPHA = 5
+CF_INDEXED = {1: 7, 2: 8, 4: 9, 8: 10}
+CF_ALPHA_8BIT = 14
+
+HEADER = struct.Struct("<IBBHI")
+ENTRY = struct.Struct("<%dsIIIHHBBBx" % NAME_MAX)
+
+
+def load(path):
+    try:
+        from PIL import Image
+    except ImportError:
+        sys.exit("asset_pack.py needs Pillow: pip install pillow")
+    if path.lower().endswith(".svg"):
+        try:
+            import cairosvg
+        except ImportError:
+            sys.exit("%s: SVG needs cairosvg: pip install cairosvg" % path)
+        return Image.open(io.BytesIO(cairosvg.svg2png(url=path))).convert("RGBA")
+    return Image.open(path).convert("RGBA")
+
+
+def rgb565(r, g, b, swap):
+    value = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3)
+    return struct.pack(">H" if swap else "<H", value)
+
+
+def convert(image, fmt, swap):
+    """The pixels as LVGL stores them, the lv_img_cf_t, the pixel size for
+    RLE and the format taken."""
+    pixels = list(image.getdata())
+    if fmt == "auto":
+        fmt = "rgb565a" if any(a < 255 for _, _, _, a in pixels) else "rgb565"
+
+    if fmt == "rgb565":
+        return b"".join(rgb565(r, g, b, swap) for r, g, b, _ in pixels), CF_TRUE_COLOR, 2, fmt
+    if fmt == "rgb565a":
+        return b"".join(rgb565(r, g, b, swap) + bytes((a,)) for r, g, b, a in pixels), CF_TRUE_COLOR_ALPHA, 3, fmt
+    if fmt == "alpha8":
+        return bytes(a for _, _, _, a in pixels), CF_ALPHA_8BIT, 1, fmt
+    if fmt == "indexed":
+        palette = sorted(set(pixels))
+        if len(palette) > 256:
+            raise ValueError("%d colours, indexed takes at most 256" % len(palette))
+        bits = next(b for b in (1, 2, 4, 8) if len(palette) <= 1 << b)
+        palette += [(0, 0, 0, 0)] * ((1 << bits) - len(palette))
+        lookup = {colour: i for i, colour in enumerate(palette)}
+        # lv_color32_t: B, G, R, A; then rows of indices, MSB first, each row byte aligned
+        data = bytearray(b"".join(bytes((b, g, r, a)) for r, g, b, a in palette))
+        width = image.width
+        per_byte = 8 // bits
+        for y in range(image.height):
+            row = pixels[y * width:(y + 1) * width]
+            for x in range(0, width, per_byte):
+                byte = 0
+                for i, colour in enumerate(row[x:x + per_byte]):
+                    byte |= lookup[colour] << (8 - bits * (i + 1))
+                data.append(byte)
+        # Packed indices have no pixel to repeat: runs are of bytes
+        return bytes(data), CF_INDEXED[bits], 1, fmt
+    raise ValueError("unknown format %s" % fmt)
+
+
+def rle(data, unit):
+    """Control byte n: below 128, n + 1 literal pixels follow; from 128, the
+    next pixel repeated n - 126 times (2 to 129)."""
+    out = bytearray()
+    count = len(data) // unit
+    pixel = lambda i: data[i * unit:(i + 1) * unit]
+    i = 0
+    literal_start = 0
+
+    def flush_literals(end):
+        start = literal_start
+        while start < end:
+            n = min(end - start, 128)
+            out.append(n - 1)
+            out.extend(data[start * unit:(start + n) * unit])
+            start += n
+
+    while i < count:
+        run = 1
+        while i + run < count and run < 129 and pixel(i + run) == pixel(i):
+            run += 1
+        if run >= 2:
+            flush_literals(i)
+            out.append(run + 126)
+            out.extend(pixel(i))
+            i += run
+            literal_start = i
+        else:
+            i += 1
+    flush_literals(count)
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("images", nargs="+", help="PNG or SVG files")
+    parser.add_argument("-o", "--output", required=True)
+    parser.add_argument("--format", choices=("auto", "rgb565", "rgb565a", "alpha8", "indexed"), default="auto",
+                        help="for every image; a name ending in .alpha8, .indexed, ... before the extension overrides it")
+    parser.add_argument("--no-swap", action="store_true", help="RGB565 in CPU byte order (LV_COLOR_16_SWAP off)")
+    parser.add_argument("--no-rle", action="store_true", help="store every entry raw")
+    parser.add_argument("--limit", type=lambda s: int(s, 0), help="fail if the pack is larger (the partition size)")
+    args = parser.parse_args()
+
+    swap = not args.no_swap
+    entries = []
+    blobs = []
+    sources = {}
+    for path in args.images:
+        name, fmt = os.path.splitext(os.path.basename(path))[0], args.format
+        stem, suffix = os.path.splitext(name)
+        if suffix[1:] in ("rgb565", "rgb565a", "alpha8", "indexed"):
+            name, fmt = stem, suffix[1:]
+        if len(name.encode()) >= NAME_MAX:
+            sys.exit("%s: name longer than %d bytes" % (path, NAME_MAX - 1))
+        if name.encode() in sources:
+            sys.exit("%s: %s is already taken by %s" % (path, name, sources[name.encode()][0]))
+        sources[name.encode()] = (path, fmt)
+
+    # The device looks names up with a binary search
+    offset = HEADER.size + ENTRY.size * len(sources)
+    for key in sorted(sources):
+        name = key.decode()
+        path, fmt = sources[key]
+        image = load(path)
+        try:
+            data, cf, unit, fmt = convert(image, fmt, swap)
+        except ValueError as e:
+            sys.exit("%s: %s" % (path, e))
+        stored, encoding = data, ENCODING_RAW
+        if not args.no_rle:
+            packed = rle(data, unit)
+            if len(packed) * 4 <= len(data) * 3:
+                stored, encoding = packed, ENCODING_RLE
+
+        offset += -offset % ALIGN
+        entries.append(ENTRY.pack(name.encode(), offset, len(stored), len(data),
+                                  image.width, image.height, cf, encoding, unit))
+        blobs.append((offset, stored))
+        offset += len(stored)
+        print("%-24s %4dx%-4d %-7s %7d bytes%s" % (name, image.width, image.height, fmt, len(stored),
+              " (RLE of %d)" % len(data) if encoding == ENCODING_RLE else ""))
+
+    if args.limit is not None and offset > args.limit:
+        sys.exit("pack is %d bytes, the partition takes %d" % (offset, args.limit))
+
+    with open(args.output, "wb") as f:
+        f.write(HEADER.pack(MAGIC, VERSION, FLAG_SWAP16 if swap else 0, len(entries), offset))
+        f.write(b"".join(entries))
+        for blob_offset, blob in blobs:
+            f.write(bytes(blob_offset - f.tell()))
+            f.write(blob)
+    print("%s: %d images, %d bytes" % (args.output, len(entries), offset))
+
+
+if __name__ == "__main__":
+    main()
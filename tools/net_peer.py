@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""Peer for the network bench (CONFIG_ESPCASTER_BENCH_NET, main/Bench/Bench_Net.c).
+
+    net_peer.py
+    net_peer.py --cert peer.crt --key peer.key
+
+Listens on four ports, as BENCH_NET_*_PORT in main/Bench/ESPCaster_Bench.h:
+
+    5001  TCP sink: reads and discards (iperf 2's server does the same)
+    5002  TCP source: sends until the device hangs up
+    5003  TLS sink
+    5004  TLS source
+
+The TLS ports need a certificate; a self-signed one will do:
+
+    openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:P-256 -nodes \\
+        -keyout peer.key -out peer.crt -days 30 -subj /CN=bench
+
+Each connection's rate is printed when it ends, to compare with what the
+device reported. No dependencies beyond the standard library.
+"""
+
+import argparse
+import socket
+import ssl
+import sys
+import threading
+import time
+
+SINK_PORT = 5001
+SOURCE_PORT = 5002
+TLS_SINK_PORT = 5003
+TLS_SOURCE_PORT = 5004
+CHUNK = 16384
+
+
+def sink(conn):
+    total = 0
+    while True:
+        data = conn.recv(CHUNK)
+        if not data:
+            return total
+        total += len(data)
+
+
+def source(conn):
+    block = bytes(CHUNK)
+    total = 0
+    try:
+        while True:
+            conn.sendall(block)
+            total += len(block)
+    except (OSError, ssl.SSLError):
+        return total
+
+
+def serve(port, handler, label, context=None):
+    listener = socket.create_server(("", port), reuse_port=False)
+    print(f"{label} on port {port}")
+    while True:
+        raw, peer = listener.accept()
+
+        def run(raw=raw, peer=peer):
+            start = time.monotonic()
+            try:
+                conn = context.wrap_socket(raw, server_side=True) if context else raw
+                total = handler(conn)
+            except (OSError, ssl.SSLError) as e:
+                print(f"{label} {peer[0]}: {e}")
+                raw.close()
+                return
+            seconds = time.monotonic() - start
+            conn.close()
+            rate = total * 8 / seconds / 1e6 if seconds > 0 else 0
+            print(f"{label} {peer[0]}: {total} bytes in {seconds:.1f} s, {rate:.2f} Mbit/s")
+
+        threading.Thread(target=run, daemon=True).start()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--cert", help="certificate for the TLS ports")
+    parser.add_argument("--key", help="its private key")
+    args = parser.parse_args()
+
+    servers = [(SINK_PORT, sink, "tcp sink", None), (SOURCE_PORT, source, "tcp source", None)]
+    if args.cert and args.key:
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(args.cert, args.key)
+        servers += [(TLS_SINK_PORT, sink, "tls sink", context), (TLS_SOURCE_PORT, source, "tls source", context)]
+    else:
+        print("No --cert/--key: TLS ports not served", file=sys.stderr)
+
+    for port, handler, label, context in servers:
+        threading.Thread(target=serve, args=(port, handler, label, context), daemon=True).start()
+    try:
+        while True:
+            time.sleep(3600)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""Build an ESPCaster OTA package (see main/OTA/OTA_Update.h).
+
+    ota_pack.py build/ESPCaster.bin -o full.ecota
+    ota_pack.py build/ESPCaster.bin --base released/ESPCaster.bin -o delta.ecota
+
+With --base the payload is a patch against that image, which must be the one
+running on the devices: they refuse a patch whose base hash differs from
+their slot. Patches are COPY/INSERT ops found with a block index of the base,
+so code that only moved is copied from flash instead of downloaded. The
+payload is raw deflate unless --store.
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+import zlib
+
+MAGIC = 0x544F4345          # "ECOT"
+VERSION = 1
+KIND_FULL, KIND_DELTA = 0, 1
+COMPRESSION_NONE, COMPRESSION_DEFLATE = 0, 1
+OP_END, OP_COPY, OP_INSERT = 0, 1, 2
+
+BLOCK = 32                  # Bytes hashed per index entry
+INDEX_STEP = 4              # Base offsets indexed; the new image is scanned at every byte
+MIN_COPY = 24               # A shorter match costs more as an op than as inserted bytes
+HEADER = struct.Struct("<IBBBxII32s32s")
+
+
+def image_digest(image):
+    """What esp_partition_get_sha256() reports for an app slot: the appended SHA-256."""
+    if len(image) < 32 or hashlib.sha256(image[:-32]).digest() != image[-32:]:
+        sys.exit("base image has no appended SHA-256 digest; cannot patch against it")
+    return image[-32:]
+
+
+def diff(base, image):
+    index = {}
+    for offset in range(0, len(base) - BLOCK + 1, INDEX_STEP):
+        index.setdefault(base[offset:offset + BLOCK], offset)
+
+    ops = bytearray()
+    pending = bytearray()
+
+    def flush_insert():
+        if pending:
+            ops.extend(struct.pack("<BI", OP_INSERT, len(pending)))
+            ops.extend(pending)
+            pending.clear()
+
+    pos = 0
+    while pos < len(image):
+        match = index.get(image[pos:pos + BLOCK]) if pos + BLOCK <= len(image) else None
+        if match is None:
+            pending.append(image[pos])
+            pos += 1
+            continue
+        # Grow the match both ways; backwards takes bytes back from the pending insert
+        start, src = pos, match
+        while start > pos - len(pending) and src > 0 and image[start - 1] == base[src - 1]:
+            start -= 1
+            src -= 1
+        end = pos + BLOCK
+        while end < len(image) and src + (end - start) < len(base) and image[end] == base[src + end - start]:
+            end += 1
+        if end - start < MIN_COPY:
+            pending.append(image[pos])
+            pos += 1
+            continue
+        del pending[len(pending) - (pos - start):]
+        flush_insert()
+        ops.extend(struct.pack("<BII", OP_COPY, src, end - start))
+        pos = end
+    flush_insert()
+    ops.append(OP_END)
+    return bytes(ops)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("image", help="the new application .bin")
+    parser.add_argument("--base", help="the .bin the devices run, for a delta package")
+    parser.add_argument("--store", action="store_true", help="do not deflate the payload")
+    parser.add_argument("-o", "--output", required=True)
+    args = parser.parse_args()
+
+    with open(args.image, "rb") as f:
+        image = f.read()
+    if not image or image[0] != 0xE9:
+        sys.exit("%s is not an ESP application image" % args.image)
+
+    if args.base:
+        with open(args.base, "rb") as f:
+            base = f.read()
+        kind, base_sha, payload = KIND_DELTA, image_digest(base), diff(base, image)
+    else:
+        kind, base_sha, payload = KIND_FULL, bytes(32), image
+
+    compression = COMPRESSION_NONE
+    if not args.store:
+        deflate = zlib.compressobj(9, zlib.DEFLATED, -15)
+        payload = deflate.compress(payload) + deflate.flush()
+        compression = COMPRESSION_DEFLATE
+
+    header = HEADER.pack(MAGIC, VERSION, kind, compression, len(image), len(payload),
+                         base_sha, hashlib.sha256(image).digest())
+    with open(args.output, "wb") as f:
+        f.write(header)
+        f.write(payload)
+    print("%s: %s package, %d byte image in %d bytes (%.1f%%)" % (
+        args.output, "delta" if kind == KIND_DELTA else "full", len(image), len(header) + len(payload),
+        100.0 * (len(header) + len(payload)) / len(image)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""Turn a soak test log (CONFIG_ESPCASTER_SOAK, main/Cast/soak_test.h) into trends.
+
+    soak_report.py soak.log
+    soak_report.py --baseline before.log after.log
+    soak_report.py --csv trends.csv soak.log
+
+The log is the serial console or the ESPCASTER_SOAK_CSV file; only the
+"SOAK," lines are read. For every column the report gives the first and
+last value, the lowest and the trend, a least-squares slope per hour over
+the samples after --warmup minutes (the first connects and the caches
+filling up are not a leak). Two derived columns follow the heaps:
+
+    internal_frag   1 - largest free block / free, internal RAM
+    psram_frag      the same for PSRAM
+
+With --baseline the trends of both runs are printed side by side, with
+the ones that got worse marked: free and largest-block columns falling
+faster, live bytes and fragmentation rising faster.
+
+--csv writes the samples, derived columns included, for a spreadsheet.
+
+No dependencies beyond the standard library.
+"""
+
+import argparse
+import csv
+import sys
+
+GROWING_IS_WORSE = ("_live", "_frag", "_failures", "lvgl_used")
+FALLING_IS_WORSE = ("_free", "_largest", "_min")
+
+
+def read_log(path):
+    columns = None
+    rows = []
+    with open(path, errors="replace") as f:
+        for line in f:
+            # The console may prefix lines or cut them at a reset
+            start = line.find("SOAK,")
+            if start < 0:
+                continue
+            fields = line[start:].strip().split(",")[1:]
+            if fields and fields[0] == "columns":
+                columns = fields[1:]
+                continue
+            if not fields or fields[0] in ("begin", "end") or columns is None:
+                continue
+            if len(fields) != len(columns):
+                continue
+            try:
+                rows.append([int(v) for v in fields])
+            except ValueError:
+                continue
+    if columns is None:
+        sys.exit(f"{path}: no SOAK,columns line")
+    return columns, rows
+
+
+def add_derived(columns, rows):
+    index = {name: i for i, name in enumerate(columns)}
+    derived = [("internal_frag", "internal_free", "internal_largest"),
+               ("psram_frag", "psram_free", "psram_largest")]
+    derived = [d for d in derived if d[1] in index and d[2] in index]
+    out = []
+    for row in rows:
+        extra = []
+        for _, free, largest in derived:
+            f = row[index[free]]
+            extra.append(1.0 - row[index[largest]] / f if f else 0.0)
+        out.append(row + extra)
+    return columns + [d[0] for d in derived], out
+
+
+def slope_per_hour(xs, ys):
+    n = len(xs)
+    if n < 2:
+        return 0.0
+    mx = sum(xs) / n
+    my = sum(ys) / n
+    sxx = sum((x - mx) ** 2 for x in xs)
+    if sxx == 0:
+        return 0.0
+    return sum((x - mx) * (y - my) for x, y in zip(xs, ys)) / sxx * 3600.0
+
+
+def trends(columns, rows, warmup_s):
+    if not rows:
+        return {}
+    t0 = rows[0][0]
+    steady = [r for r in rows if r[0] - t0 >= warmup_s] or rows
+    xs = [r[0] for r in steady]
+    result = {}
+    for i, name in enumerate(columns[1:], start=1):
+        values = [r[i] for r in rows]
+        result[name] = {
+            "first": values[0],
+            "last": values[-1],
+            "min": min(values),
+            "slope": slope_per_hour(xs, [r[i] for r in steady]),
+        }
+    return result
+
+
+def worse(name, slope, base_slope):
+    if name.endswith(GROWING_IS_WORSE) or name in GROWING_IS_WORSE:
+        return slope > base_slope
+    if name.endswith(FALLING_IS_WORSE):
+        return slope < base_slope
+    return False
+
+
+def fmt(value):
+    if isinstance(value, float) and abs(value) < 10:
+        return f"{value:.4f}"
+    return f"{value:.0f}" if isinstance(value, float) else str(value)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("log")
+    parser.add_argument("--baseline", help="log of the run to compare with")
+    parser.add_argument("--warmup", type=float, default=10, help="minutes left out of the slopes (default 10)")
+    parser.add_argument("--csv", help="write the samples with the derived columns here")
+    args = parser.parse_args()
+
+    columns, rows = add_derived(*read_log(args.log))
+    if not rows:
+        sys.exit(f"{args.log}: no samples")
+    hours = (rows[-1][0] - rows[0][0]) / 3600.0
+    print(f"{args.log}: {len(rows)} samples over {hours:.1f} h")
+    current = trends(columns, rows, args.warmup * 60)
+
+    if args.baseline:
+        base_columns, base_rows = add_derived(*read_log(args.baseline))
+        base = trends(base_columns, base_rows, args.warmup * 60)
+        print(f"{'column':<24}{'baseline/h':>14}{'this/h':>14}")
+        for name, t in current.items():
+            if name not in base:
+                continue
+            mark = "  worse" if worse(name, t["slope"], base[name]["slope"]) else ""
+            print(f"{name:<24}{fmt(base[name]['slope']):>14}{fmt(t['slope']):>14}{mark}")
+    else:
+        print(f"{'column':<24}{'first':>12}{'last':>12}{'min':>12}{'trend/h':>14}")
+        for name, t in current.items():
+            print(f"{name:<24}{fmt(t['first']):>12}{fmt(t['last']):>12}{fmt(t['min']):>12}{fmt(t['slope']):>14}")
+
+    if args.csv:
+        with open(args.csv, "w", newline="") as f:
+            writer = csv.writer(f)
+            writer.writerow(columns)
+            writer.writerows(rows)
+
+
+if __name__ == "__main__":
+    main()